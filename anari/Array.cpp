@@ -3,6 +3,8 @@
 
 
 #include "Array.h"
+// std
+#include <algorithm>
 
 namespace barney_device {
 
@@ -18,13 +20,42 @@ namespace barney_device {
       bnRelease(m_handle);                                                     \
   }                                                                            \
                                                                                \
+  /* apps that changed only part of the array while mapped can tell   */     \
+  /* us so through a (one-shot) "dirtyRange" parameter of [begin,end)  */     \
+  /* element indices, and we upload only those                         */     \
   void Array##DIM::unmap()                                                     \
   {                                                                            \
     helium::Array##DIM::unmap();                                               \
-    if (m_handle)                                                              \
+    uint64_t range[2] = {0, 0};                                                \
+    bool haveRange = getParam("dirtyRange", ANARI_UINT64_VEC2, range);         \
+    if (haveRange)                                                             \
+      removeParam("dirtyRange");                                               \
+    if (!m_handle)                                                             \
+      return;                                                                  \
+    range[1] = std::min<uint64_t>(range[1], totalCapacity());                  \
+    if (haveRange && range[0] < range[1])                                      \
+      bnDataSetRange(m_handle, range[0], range[1] - range[0],                  \
+          (const uint8_t *)data() + range[0] * anari::sizeOf(elementType())); \
+    else if (!haveRange)                                                       \
       bnDataSet(m_handle, totalCapacity(), data());                            \
   }                                                                            \
                                                                                \
+  void Array##DIM::privatize()                                                 \
+  {                                                                            \
+    /* barney already has its own copy of device-resident data, and   */      \
+    /* there's no host copy to be made of it; the app has to keep     */      \
+    /* such arrays alive for as long as they're in use */                     \
+    if (isDeviceMemory(data())) {                                              \
+      reportMessage(ANARI_SEVERITY_WARNING,                                    \
+          "device-resident array released while still in use; "               \
+          "not making a private copy");                                        \
+      return;                                                                  \
+    }                                                                          \
+    helium::Array##DIM::privatize();                                           \
+  }                                                                            \
+                                                                               \
+  /* 'data()' may also be a CUDA device pointer; barney then copies */        \
+  /* device-to-device, without any host staging */                            \
   BNData Array##DIM::barneyData()                                              \
   {                                                                            \
     if (!m_handle) {                                                           \
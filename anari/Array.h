@@ -23,6 +23,7 @@ using ObjectArray = helium::ObjectArray;
     ~Array##DIM() override;                                                    \
                                                                                \
     void unmap() override;                                                     \
+    void privatize() override;                                                 \
                                                                                \
     BNData barneyData();                                                       \
                                                                                \
@@ -9,6 +9,9 @@
 #include "helium/BaseGlobalDeviceState.h"
 #include <memory>
 #include <map>
+#include <list>
+#include <future>
+#include <condition_variable>
 
 namespace barney_device {
 
@@ -51,14 +54,34 @@ namespace barney_device {
     std::map<int,TetheredModel*> activeModels;
     std::mutex mutex;
 
-    int numRenderCallsOutstanding = 0;
+    /*! per tethered device (by slot), whether it has already made
+        its renderFrame() call for the render that's about to be
+        launched; whichever device completes the set - in whatever
+        order they arrive, and from whatever thread - launches it.
+        guarded by 'mutex', as is everything below */
+    std::vector<bool> renderCallArrived;
+    /*! signalled whenever a render got launched, for devices that
+        arrived for the next one before that */
+    std::condition_variable renderLaunched;
+    /*! counts launched renders; lets each frame tell whether it has
+        already waited on 'renderInFlight' */
+    int renderGeneration = 0;
     struct {
       BNCamera camera;
       BNRenderer renderer;
       BNFrameBuffer fb;
       BNModel model;
+      /*! the (slot 0) frame that owns 'fb', and that wants its color
+          channel read back as part of the render */
+      Frame *frame;
     } deferredRenderCall;
 
+    /*! completion of the most recently issued bnRender; bnRender runs
+        asynchronously on a worker thread, every frame on every
+        tethered device waits on this before touching the
+        frame buffer (or flushing any commits) again */
+    std::shared_future<void> renderInFlight;
+
     std::vector<BarneyDevice *> devices;
   };
 
@@ -81,6 +104,15 @@ namespace barney_device {
         B (and vice versa) */
     int nextUniqueModelID = 0;
 
+    /*! worlds that currently have a built barney model, most recently
+        rendered one first. Every world keeps its own model, so
+        switching between worlds doesn't rebuild anything; but if
+        maxResidentWorlds > 0 (device parameter), making a world
+        current evicts the least recently rendered ones beyond that
+        many, and those get rebuilt when they next get rendered */
+    std::list<World *> residentWorlds;
+    int maxResidentWorlds = 0;
+
     bool hasBeenCommitted = false;
 
     // Helper methods //
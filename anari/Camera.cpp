@@ -131,6 +131,9 @@ namespace barney_device {
     m_fovy = getParam<float>("fovy", anari::radians(60.f));
     m_focusDistance = getParam<float>("focusDistance", 0.f);
     m_apertureRadius = getParam<float>("apertureRadius", 0.f);
+    m_stereoMode = getParamString("stereoMode", "none");
+    m_interpupillaryDistance
+      = getParam<float>("interpupillaryDistance", 0.0635f);
   }
 
   void Perspective::finalize()
@@ -142,6 +145,9 @@ namespace barney_device {
     bnSet1f(m_barneyCamera, "focusDistance", m_focusDistance);
     bnSet1f(m_barneyCamera, "apertureRadius", m_apertureRadius);
     bnSet1f(m_barneyCamera, "fovy", anari::degrees(m_fovy));
+    bnSetString(m_barneyCamera, "stereoMode", m_stereoMode.c_str());
+    bnSet1f(m_barneyCamera, "interpupillaryDistance",
+            m_interpupillaryDistance);
     bnCommit(m_barneyCamera);
   }
 
@@ -47,6 +47,8 @@ namespace barney_device {
     float m_aspect{1.f};
     float m_focusDistance = 0.f;
     float m_apertureRadius = 0.f;
+    std::string m_stereoMode = "none";
+    float m_interpupillaryDistance = 0.0635f;
   };
 
   /*! ANARI 'orthographic' camera type - implements an
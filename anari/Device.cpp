@@ -197,9 +197,9 @@ namespace barney_device {
 
   // Frame Rendering ////////////////////////////////////////////////////////////
 
-  ANARIRenderer BarneyDevice::newRenderer(const char *)
+  ANARIRenderer BarneyDevice::newRenderer(const char *type)
   {
-    return (ANARIRenderer) new Renderer(deviceState());
+    return (ANARIRenderer) new Renderer(deviceState(),type);
   }
 
   // Helper/other functions and data members ////////////////////////////////////
@@ -422,6 +422,8 @@ namespace barney_device {
     helium::BaseDevice::deviceCommitParameters();
 
     auto state = deviceState(false);
+    state->maxResidentWorlds
+      = getParam<int>("maxResidentWorlds",state->maxResidentWorlds);
     if (state->hasBeenCommitted) {
       reportMessage(ANARI_SEVERITY_DEBUG, "device committed more than once!");
       return;
@@ -527,6 +529,31 @@ namespace barney_device {
     } else if (prop == "barney" && type == ANARI_BOOL) {
       helium::writeToVoidP(mem, true);
       return 1;
+    } else if (prop == "barney.memoryDeviceCount" && type == ANARI_INT32) {
+      auto state = deviceState();
+      if (!state->tether || !state->tether->context) return 0;
+      helium::writeToVoidP
+        (mem, bnContextGetMemoryInfo(state->tether->context,nullptr,0));
+      return 1;
+    } else if (prop == "barney.memoryInfo" && type == ANARI_UNKNOWN) {
+      // raw array of BNDeviceMemoryInfo, as many as fit into 'size'
+      auto state = deviceState();
+      if (!state->tether || !state->tether->context) return 0;
+      bnContextGetMemoryInfo(state->tether->context,
+                             (BNDeviceMemoryInfo *)mem,
+                             int(size/sizeof(BNDeviceMemoryInfo)));
+      return 1;
+    } else if (prop == "barney.memoryUsed" && type == ANARI_UINT64) {
+      auto state = deviceState();
+      if (!state->tether || !state->tether->context) return 0;
+      BNContext context = state->tether->context;
+      std::vector<BNDeviceMemoryInfo> infos
+        (bnContextGetMemoryInfo(context,nullptr,0));
+      bnContextGetMemoryInfo(context,infos.data(),(int)infos.size());
+      uint64_t used = 0;
+      for (auto &info : infos) used += info.totalUsed;
+      helium::writeToVoidP(mem, used);
+      return 1;
     }
     return 0;
   }
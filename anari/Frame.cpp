@@ -7,6 +7,7 @@
 // std
 #include <algorithm>
 #include <chrono>
+#include <future>
 #include <iostream>
 // cuda
 #if BANARI_HAVE_CUDA
@@ -78,12 +79,17 @@ namespace barney_device {
       getParam<anari::DataType>("channel.objectId", ANARI_UNKNOWN);
     m_channelTypes.normal =
       getParam<anari::DataType>("channel.normal", ANARI_UNKNOWN);
+    m_channelTypes.cost =
+      getParam<anari::DataType>("channel.cost", ANARI_UNKNOWN);
     m_size = getParam<math::uint2>("size", math::uint2(10, 10));
+    m_colorTarget.fd = getParam<int>("colorTarget.fd", -1);
+    m_colorTarget.size = getParam<uint64_t>("colorTarget.size", 0);
     m_displaySize = m_size;  /* updated in finalize() from actual FB when slot==0 */
   }
 
   void Frame::finalize()
   {
+    wait();
     cleanup();
 
     if (!m_renderer) {
@@ -119,11 +125,24 @@ namespace barney_device {
         requiredChannels |= BN_FB_INSTID;
       if (m_channelTypes.normal == ANARI_FLOAT32_VEC3)
         requiredChannels |= BN_FB_NORMAL;
+      if (m_channelTypes.cost == ANARI_UINT32)
+        requiredChannels |= BN_FB_COST;
 
       if (m_bnFrameBuffer) {
         bnSet1i(m_bnFrameBuffer, "denoise", m_renderer->denoise() ? 1 : 0);
         bnSet1i(m_bnFrameBuffer, "fadeOutDenoiser", m_renderer->fadeOutDenoiser() ? 1 : 0);
+        bnSet1i(m_bnFrameBuffer, "denoiseInterval", m_renderer->denoiseInterval());
         bnSet1i(m_bnFrameBuffer, "upscale", m_renderer->upscale() ? 1 : 0);
+        bnSet1i(m_bnFrameBuffer, "dynamicRenderScale",
+                m_renderer->dynamicResolution() ? 1 : 0);
+        bnSet1f(m_bnFrameBuffer, "minRenderScale", m_renderer->minRenderScale());
+        bnSet1i(m_bnFrameBuffer, "temporalReprojection",
+                m_renderer->temporalReprojection() ? 1 : 0);
+        bnSet1i(m_bnFrameBuffer, "maxHistoryLength", m_renderer->maxHistoryLength());
+        bnSet1i(m_bnFrameBuffer, "maxAccumulation", m_renderer->maxAccumulation());
+        bnSet1i(m_bnFrameBuffer, "stopWhenConverged",
+                m_renderer->stopWhenConverged() ? 1 : 0);
+        bnSet1i(m_bnFrameBuffer, "primaryHitCache", m_renderer->primaryHitCache());
         bnCommit(m_bnFrameBuffer);
 
         bnFrameBufferResize(m_bnFrameBuffer,
@@ -131,6 +150,14 @@ namespace barney_device {
                             size.x,
                             size.y,
                             requiredChannels);
+        if (m_colorTarget.fd != m_colorTarget.registeredFD) {
+          /* barney owns every fd it imported, so only ever hand it
+             a new one */
+          bnFrameBufferSetColorTarget(m_bnFrameBuffer,
+                                      m_colorTarget.fd,
+                                      m_colorTarget.size);
+          m_colorTarget.registeredFD = m_colorTarget.fd;
+        }
         int actualW = 0, actualH = 0;
         bnFrameBufferGetSize(m_bnFrameBuffer, &actualW, &actualH);
         m_displaySize.x = static_cast<uint32_t>(actualW);
@@ -152,19 +179,96 @@ namespace barney_device {
     if (type == ANARI_FLOAT32 && name == "duration") {
       if (flags & ANARI_WAIT)
         wait();
-      helium::writeToVoidP(ptr, m_duration);
+      helium::writeToVoidP(ptr, m_duration.load());
+      return true;
+    }
+
+    /* whether accumulation stopped (renderer's maxAccumulation or
+       stopWhenConverged), and frames don't render anything any more */
+    if (type == ANARI_BOOL && name == "converged") {
+      if (flags & ANARI_WAIT)
+        wait();
+      helium::writeToVoidP
+        (ptr, uint32_t(m_bnFrameBuffer && bnFrameBufferIsConverged(m_bnFrameBuffer)));
       return true;
     }
 
+    /* picking: anariSetParameter(frame,"pickPosition",...) - in
+       [0,1]^2 of the frame, no commit needed - then query any of
+       these */
+    if (name == "worldPosition" || name == "depth" ||
+        name == "primitiveId" || name == "objectId" ||
+        name == "instanceId") {
+      BNPickResult picked;
+      if (!pick(picked))
+        return false;
+      if (type == ANARI_FLOAT32_VEC3 && name == "worldPosition") {
+        if (!picked.hit) return false;
+        helium::writeToVoidP(ptr, math::float3(picked.position.x,
+                                               picked.position.y,
+                                               picked.position.z));
+        return true;
+      }
+      if (type == ANARI_FLOAT32 && name == "depth") {
+        if (!picked.hit) return false;
+        helium::writeToVoidP(ptr, picked.t);
+        return true;
+      }
+      if (type == ANARI_UINT32) {
+        int id
+          = (name == "primitiveId") ? picked.primID
+          : (name == "objectId")    ? picked.objID
+          :                           picked.instID;
+        if (id < 0) return false;
+        helium::writeToVoidP(ptr, uint32_t(id));
+        return true;
+      }
+    }
+
     return 0;
   }
 
+  bool Frame::pick(BNPickResult &result)
+  {
+    math::float2 position
+      = getParam<math::float2>("pickPosition", math::float2(-1.f,-1.f));
+    if (position.x < 0.f || position.y < 0.f)
+      return false;
+    if (!m_pick.valid ||
+        position.x != m_pick.position.x ||
+        position.y != m_pick.position.y) {
+      if (!m_bnFrameBuffer || !m_camera)
+        return false;
+      /* the render thread may still be tracing this model */
+      wait();
+      BNModel model = deviceState()->tether->deferredRenderCall.model;
+      if (!model)
+        return false;
+      bn_float2 screenPos = { position.x, position.y };
+      bnPick(model, m_camera->barneyCamera(),
+             (int)m_displaySize.x, (int)m_displaySize.y,
+             &screenPos, 1, &m_pick.result);
+      m_pick.position = position;
+      m_pick.valid    = true;
+    }
+    result = m_pick.result;
+    return true;
+  }
+
   void Frame::renderFrame()
   {
     auto start = std::chrono::steady_clock::now();
 
+    /* the previous frame may still be rendering on the worker
+       thread; that one has to be done before we can flush any
+       commits or touch the frame buffer again */
+    wait();
+    
     auto *state = deviceState();
     state->commitBuffer.flush();
+    /* whatever got picked may have changed with what's about to get
+       committed */
+    m_pick.valid = false;
 
     bool firstFrame = 0;
     if (m_lastCommitFlush < state->commitBuffer.lastObjectFinalization()) {
@@ -196,44 +300,104 @@ namespace barney_device {
     if (m_lastFrameWasFirstFrame && m_channelTypes.depth != ANARI_UNKNOWN
         && !m_didMapChannel.depth)
       reportMessage(ANARI_SEVERITY_PERFORMANCE_WARNING,
-                    "last frame had a depth buffer request, but never mapped it");
+                    "last frame had a depth buffer request, but never mapped it"
+                    " (barney stops producing it until it gets mapped again)");
     if (m_lastFrameWasFirstFrame && m_channelTypes.primID != ANARI_UNKNOWN
         && !m_didMapChannel.primID)
       reportMessage(ANARI_SEVERITY_PERFORMANCE_WARNING,
-                    "last frame had a primID buffer request, but never mapped it");
+                    "last frame had a primID buffer request, but never mapped it"
+                    " (barney stops producing it until it gets mapped again)");
     if (m_lastFrameWasFirstFrame && m_channelTypes.objID != ANARI_UNKNOWN
         && !m_didMapChannel.objID)
       reportMessage(ANARI_SEVERITY_PERFORMANCE_WARNING,
-                    "last frame had a objID buffer request, but never mapped it");
+                    "last frame had a objID buffer request, but never mapped it"
+                    " (barney stops producing it until it gets mapped again)");
     if (m_lastFrameWasFirstFrame && m_channelTypes.instID != ANARI_UNKNOWN
         && !m_didMapChannel.instID)
       reportMessage(ANARI_SEVERITY_PERFORMANCE_WARNING,
-                    "last frame had a instID buffer request, but never mapped it");
+                    "last frame had a instID buffer request, but never mapped it"
+                    " (barney stops producing it until it gets mapped again)");
+
+    auto tether = state->tether;
+    std::unique_lock<std::mutex> lock(tether->mutex);
+    auto &peers = tether->devices;
+    auto &arrived = tether->renderCallArrived;
+    if (arrived.size() != peers.size())
+      arrived.assign(peers.size(),false);
+    /* if this device already is in for the render that's still
+       waiting for its peers, it has to wait for that one to go out
+       before it can sign up for the next */
+    tether->renderLaunched.wait(lock,[&]{ return !arrived[state->slot]; });
 
     if (state->slot == 0) {
-      auto &peers = state->tether->devices;
-      state->tether->numRenderCallsOutstanding = (int)peers.size();
-      state->tether->deferredRenderCall.model = model;
-      state->tether->deferredRenderCall.renderer = m_renderer->barneyRenderer;
-      state->tether->deferredRenderCall.fb = m_bnFrameBuffer;
-      state->tether->deferredRenderCall.camera = m_camera->barneyCamera();
+      tether->deferredRenderCall.model = model;
+      tether->deferredRenderCall.renderer = m_renderer->barneyRenderer;
+      tether->deferredRenderCall.fb = m_bnFrameBuffer;
+      tether->deferredRenderCall.camera = m_camera->barneyCamera();
+      tether->deferredRenderCall.frame = this;
+
+      /* host-side color gets read back right after the render, into
+         the back buffer (the front one may still be looked at by the
+         app) */
+      m_stagedColor.readbackRequested
+        = m_bnFrameBuffer
+        /* color already lands in the app's graphics memory */
+        && m_colorTarget.registeredFD < 0
+        && (m_channelTypes.color == ANARI_UFIXED8_VEC4 ||
+            m_channelTypes.color == ANARI_UFIXED8_RGBA_SRGB ||
+            m_channelTypes.color == ANARI_FLOAT32_VEC4);
+      m_stagedColor.valid[0] = false;
+      m_stagedColor.valid[1] = false;
     }
-    --state->tether->numRenderCallsOutstanding;
-    if (state->tether->numRenderCallsOutstanding == 0) {
-      bnRender(state->tether->deferredRenderCall.renderer,
-               state->tether->deferredRenderCall.model,
-               state->tether->deferredRenderCall.camera,
-               state->tether->deferredRenderCall.fb
-               );
+    arrived[state->slot] = true;
+    if (std::find(arrived.begin(),arrived.end(),false) == arrived.end()) {
+      auto call = tether->deferredRenderCall;
+      Frame *self = this;
+      tether->renderInFlight
+        = std::async(std::launch::async,[call,self,start]() {
+          bnRender(call.renderer,
+                   call.model,
+                   call.camera,
+                   call.fb
+                   );
+          if (call.frame)
+            call.frame->readbackColor();
+          auto end = std::chrono::steady_clock::now();
+          float duration = std::chrono::duration<float>(end - start).count();
+          self->m_duration = duration;
+          if (call.frame)
+            call.frame->m_duration = duration;
+        }).share();
+      ++tether->renderGeneration;
+      arrived.assign(peers.size(),false);
+      tether->renderLaunched.notify_all();
       m_lastFrameWasFirstFrame = firstFrame;
+    } else {
+      auto end = std::chrono::steady_clock::now();
+      m_duration = std::chrono::duration<float>(end - start).count();
     }
+    lock.unlock();
     m_didMapChannel.depth = false;
     m_didMapChannel.primID = false;
     m_didMapChannel.instID = false;
     m_didMapChannel.objID = false;
+  }
 
-    auto end = std::chrono::steady_clock::now();
-    m_duration = std::chrono::duration<float>(end - start).count();
+  void Frame::readbackColor()
+  {
+    if (!m_stagedColor.readbackRequested)
+      return;
+    int back = 1-m_stagedColor.front;
+    int numPixels = m_size.x * m_size.y;
+    if (!m_stagedColor.buffer[back])
+      m_stagedColor.buffer[back]
+        = new uint32_t[numPixels
+                       * (m_channelTypes.color == ANARI_FLOAT32_VEC4 ? 4 : 1)];
+    bnFrameBufferRead(m_bnFrameBuffer,
+                      BN_FB_COLOR,
+                      m_stagedColor.buffer[back],
+                      toBarney(m_channelTypes.color));
+    m_stagedColor.valid[back] = true;
   }
 
   void *Frame::map(std::string_view channel,
@@ -250,122 +414,97 @@ namespace barney_device {
     *height = m_size.y;
     int numPixels = *width * *height;
     if (channel == "channel.color") {
-      if (m_channelBuffers.color)
+      if (m_stagedColor.mapped)
         throw std::runtime_error(
                                  "trying to map color buffer, but color buffer already mapped");
-      m_channelBuffers.color = new uint32_t[numPixels
-                                            * (m_channelTypes.color == ANARI_FLOAT32_VEC4 ? 4 : 1)];
-      bnFrameBufferRead(m_bnFrameBuffer,
-                        BN_FB_COLOR,
-                        m_channelBuffers.color,
-                        toBarney(m_channelTypes.color));
+      int front = m_stagedColor.front;
+      if (!m_stagedColor.buffer[front])
+        m_stagedColor.buffer[front]
+          = new uint32_t[numPixels
+                         * (m_channelTypes.color == ANARI_FLOAT32_VEC4 ? 4 : 1)];
+      if (!m_stagedColor.valid[front]) {
+        // render didn't read this back for us, do it now
+        bnFrameBufferRead(m_bnFrameBuffer,
+                          BN_FB_COLOR,
+                          m_stagedColor.buffer[front],
+                          toBarney(m_channelTypes.color));
+        m_stagedColor.valid[front] = true;
+      }
+      m_stagedColor.mapped = true;
       *pixelType = m_channelTypes.color;
-      return m_channelBuffers.color;
+      return m_stagedColor.buffer[front];
     } else if (channel == "channel.depth") {
-      if (m_channelBuffers.depth)
-        throw std::runtime_error
-          ("trying to map depth buffer, but depth buffer already mapped");
-      m_channelBuffers.depth = new float[numPixels];
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_DEPTH, m_channelBuffers.depth, BN_FLOAT);
       m_didMapChannel.depth = true;
       *pixelType = ANARI_FLOAT32;
-      return m_channelBuffers.depth;
+      return mapChannel(m_channelBuffers.depth,"channel.depth",
+                        BN_FB_DEPTH,BN_FLOAT,sizeof(float),false);
     } else if (channel == "channel.primitiveId") {
-      if (m_channelBuffers.primID)
-        throw std::runtime_error
-          ("trying to map channel.primitiveId, but seems already mapped");
-      m_channelBuffers.primID = new int[numPixels];
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_PRIMID, m_channelBuffers.primID, BN_INT);
       m_didMapChannel.primID = true;
       *pixelType = ANARI_UINT32;
-      return m_channelBuffers.primID;
+      return mapChannel(m_channelBuffers.primID,"channel.primitiveId",
+                        BN_FB_PRIMID,BN_INT,sizeof(int),false);
     } else if (channel == "channel.objectId") {
-      if (m_channelBuffers.objID)
-        throw std::runtime_error
-          ("trying to map channel.objectId, but seems already mapped");
-      m_channelBuffers.objID = new int[numPixels];
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_OBJID, m_channelBuffers.objID, BN_INT);
       m_didMapChannel.objID = true;
       *pixelType = ANARI_UINT32;
-      return m_channelBuffers.objID;
+      return mapChannel(m_channelBuffers.objID,"channel.objectId",
+                        BN_FB_OBJID,BN_INT,sizeof(int),false);
     } else if (channel == "channel.instanceId") {
-      if (m_channelBuffers.instID)
-        throw std::runtime_error
-          ("trying to map channel.instanceId, but seems already mapped");
-      m_channelBuffers.instID = new int[numPixels];
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_INSTID, m_channelBuffers.instID, BN_INT);
       m_didMapChannel.instID = true;
       *pixelType = ANARI_UINT32;
-      return m_channelBuffers.instID;
+      return mapChannel(m_channelBuffers.instID,"channel.instanceId",
+                        BN_FB_INSTID,BN_INT,sizeof(int),false);
     } else if (channel == "channel.normal") {
-      if (m_channelBuffers.normal)
-        throw std::runtime_error
-          ("trying to map channel.normal, but seems already mapped");
-      m_channelBuffers.normal = new float[numPixels * 3];
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_NORMAL, m_channelBuffers.normal, BN_FLOAT3);
       m_didMapChannel.normal = true;
       *pixelType = ANARI_FLOAT32_VEC3;
-      return m_channelBuffers.normal;
+      return mapChannel(m_channelBuffers.normal,"channel.normal",
+                        BN_FB_NORMAL,BN_FLOAT3,3*sizeof(float),false);
+    } else if (channel == "channel.cost") {
+      *pixelType = ANARI_UINT32;
+      return mapChannel(m_channelBuffers.cost,"channel.cost",
+                        BN_FB_COST,BN_INT,sizeof(int),false);
 #if BANARI_HAVE_CUDA
     } else if (channel == "channel.colorCUDA") {
-      if (m_channelBuffers.color)
-        throw std::runtime_error
-          ("trying to map color buffer, but color buffer already mapped");
-      cudaMalloc((void **)&m_channelBuffers.color,
-                 numPixels
-                 * (m_channelTypes.color == ANARI_FLOAT32_VEC4 ? sizeof(math::float4)
-                    : sizeof(uint32_t)));
-      bnFrameBufferRead(m_bnFrameBuffer,
-                        BN_FB_COLOR,
-                        m_channelBuffers.color,
-                        toBarney(m_channelTypes.color));
       *pixelType = m_channelTypes.color;
-      return m_channelBuffers.color;
+      return mapChannel(m_channelBuffers.color,"channel.colorCUDA",
+                        BN_FB_COLOR,toBarney(m_channelTypes.color),
+                        m_channelTypes.color == ANARI_FLOAT32_VEC4
+                        ? sizeof(math::float4) : sizeof(uint32_t),
+                        true);
     } else if (channel == "channel.depthCUDA"
                && m_channelTypes.depth == ANARI_FLOAT32) {
-      if (m_channelBuffers.depth)
-        throw std::runtime_error(
-                                 "trying to map depth buffer, but depth buffer already mapped");
-      cudaMalloc((void **)&m_channelBuffers.depth, numPixels * sizeof(float));
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_DEPTH, m_channelBuffers.depth, BN_FLOAT);
+      m_didMapChannel.depth = true;
       *pixelType = ANARI_FLOAT32;
-      return m_channelBuffers.depth;
+      return mapChannel(m_channelBuffers.depth,"channel.depthCUDA",
+                        BN_FB_DEPTH,BN_FLOAT,sizeof(float),true);
     } else if (channel == "channel.primitiveIdCUDA"
                && m_channelTypes.primID == ANARI_UINT32) {
-      if (m_channelBuffers.primID)
-        throw std::runtime_error
-          ("trying to map primitiveId buffer, but buffer already mapped");
-      cudaMalloc((void **)&m_channelBuffers.primID, numPixels * sizeof(uint32_t));
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_PRIMID, m_channelBuffers.primID, BN_INT);
+      m_didMapChannel.primID = true;
       *pixelType = ANARI_UINT32;
-      return m_channelBuffers.primID;
+      return mapChannel(m_channelBuffers.primID,"channel.primitiveIdCUDA",
+                        BN_FB_PRIMID,BN_INT,sizeof(uint32_t),true);
     } else if (channel == "channel.objectIdCUDA"
                && m_channelTypes.objID == ANARI_UINT32) {
-      if (m_channelBuffers.objID)
-        throw std::runtime_error
-          ("trying to map objectId buffer, but buffer already mapped");
-      cudaMalloc((void **)&m_channelBuffers.objID, numPixels * sizeof(uint32_t));
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_OBJID, m_channelBuffers.objID, BN_INT);
+      m_didMapChannel.objID = true;
       *pixelType = ANARI_UINT32;
-      return m_channelBuffers.objID;
+      return mapChannel(m_channelBuffers.objID,"channel.objectIdCUDA",
+                        BN_FB_OBJID,BN_INT,sizeof(uint32_t),true);
     } else if (channel == "channel.instanceIdCUDA"
                && m_channelTypes.instID == ANARI_UINT32) {
-      if (m_channelBuffers.instID)
-        throw std::runtime_error
-          ("trying to map instanceId buffer, but buffer already mapped");
-      cudaMalloc((void **)&m_channelBuffers.instID, numPixels * sizeof(uint32_t));
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_INSTID, m_channelBuffers.instID, BN_INT);
+      m_didMapChannel.instID = true;
       *pixelType = ANARI_UINT32;
-      return m_channelBuffers.instID;
+      return mapChannel(m_channelBuffers.instID,"channel.instanceIdCUDA",
+                        BN_FB_INSTID,BN_INT,sizeof(uint32_t),true);
     } else if (channel == "channel.normalCUDA"
                && m_channelTypes.normal == ANARI_FLOAT32_VEC3) {
-      if (m_channelBuffers.normal)
-        throw std::runtime_error
-          ("trying to map normal buffer, but buffer already mapped");
-      cudaMalloc((void **)&m_channelBuffers.normal, numPixels * 3 * sizeof(float));
-      bnFrameBufferRead(m_bnFrameBuffer, BN_FB_NORMAL, m_channelBuffers.normal, BN_FLOAT3);
+      m_didMapChannel.normal = true;
       *pixelType = ANARI_FLOAT32_VEC3;
-      return m_channelBuffers.normal;
+      return mapChannel(m_channelBuffers.normal,"channel.normalCUDA",
+                        BN_FB_NORMAL,BN_FLOAT3,3*sizeof(float),true);
+    } else if (channel == "channel.costCUDA"
+               && m_channelTypes.cost == ANARI_UINT32) {
+      *pixelType = ANARI_UINT32;
+      return mapChannel(m_channelBuffers.cost,"channel.costCUDA",
+                        BN_FB_COST,BN_INT,sizeof(uint32_t),true);
 #endif
     } else {
       reportMessage(ANARI_SEVERITY_WARNING,
@@ -381,67 +520,72 @@ namespace barney_device {
 
   void Frame::unmap(std::string_view channel)
   {
-    if (channel == "channel.color") {
-      if (m_channelBuffers.color)
-        delete[] m_channelBuffers.color;
-      m_channelBuffers.color = 0;
-    } else if (channel == "channel.depth" && m_channelBuffers.depth) {
-      if (m_channelBuffers.depth)
-        delete[] m_channelBuffers.depth;
-      m_channelBuffers.depth = 0;
-    } else if (channel == "channel.primitiveId" && m_channelBuffers.primID) {
-      if (m_channelBuffers.primID)
-        delete[] m_channelBuffers.primID;
-      m_channelBuffers.primID = 0;
-    } else if (channel == "channel.objectId" && m_channelBuffers.objID) {
-      if (m_channelBuffers.objID)
-        delete[] m_channelBuffers.objID;
-      m_channelBuffers.objID = 0;
-    } else if (channel == "channel.instanceId" && m_channelBuffers.instID) {
-      if (m_channelBuffers.instID)
-        delete[] m_channelBuffers.instID;
-      m_channelBuffers.instID = 0;
-    } else if (channel == "channel.normal" && m_channelBuffers.normal) {
-      if (m_channelBuffers.normal)
-        delete[] m_channelBuffers.normal;
-      m_channelBuffers.normal = 0;
-    } else if (channel == "channel.colorCUDA") {
-#if BANARI_HAVE_CUDA
-      if (m_channelBuffers.color)
-        cudaFree(m_channelBuffers.color);
-      m_channelBuffers.color = 0;
-#endif
-    } else if (channel == "channel.depthCUDA") {
-#if BANARI_HAVE_CUDA
-      if (m_channelBuffers.depth)
-        cudaFree(m_channelBuffers.depth);
-      m_channelBuffers.depth = 0;
-#endif
-    } else if (channel == "channel.primitiveIdCUDA") {
-#if BANARI_HAVE_CUDA
-      if (m_channelBuffers.primID)
-        cudaFree(m_channelBuffers.primID);
-      m_channelBuffers.primID = 0;
-#endif
-    } else if (channel == "channel.objectIdCUDA") {
-#if BANARI_HAVE_CUDA
-      if (m_channelBuffers.objID)
-        cudaFree(m_channelBuffers.objID);
-      m_channelBuffers.objID = 0;
-#endif
-    } else if (channel == "channel.instanceIdCUDA") {
+    /* buffers stay around for the next map(); all we have to do is
+       allow mapping them again */
+    if (channel == "channel.color")
+      m_stagedColor.mapped = false;
+    else if (channel == "channel.colorCUDA")
+      m_channelBuffers.color.mapped = false;
+    else if (channel == "channel.depth" || channel == "channel.depthCUDA")
+      m_channelBuffers.depth.mapped = false;
+    else if (channel == "channel.primitiveId"
+             || channel == "channel.primitiveIdCUDA")
+      m_channelBuffers.primID.mapped = false;
+    else if (channel == "channel.objectId"
+             || channel == "channel.objectIdCUDA")
+      m_channelBuffers.objID.mapped = false;
+    else if (channel == "channel.instanceId"
+             || channel == "channel.instanceIdCUDA")
+      m_channelBuffers.instID.mapped = false;
+    else if (channel == "channel.normal" || channel == "channel.normalCUDA")
+      m_channelBuffers.normal.mapped = false;
+    else if (channel == "channel.cost" || channel == "channel.costCUDA")
+      m_channelBuffers.cost.mapped = false;
+  }
+
+  void *Frame::mapChannel(ChannelBuffer &buffer,
+                          const char *name,
+                          BNFrameBufferChannel channel,
+                          BNDataType format,
+                          size_t sizeOfPixel,
+                          bool onDevice)
+  {
+    if (buffer.mapped)
+      throw std::runtime_error(std::string("trying to map ")+name
+                               +", but buffer already mapped");
+    size_t numBytes = size_t(m_size.x) * m_size.y * sizeOfPixel;
+    void *&mem = onDevice ? buffer.device : buffer.host;
+    if (!mem) {
 #if BANARI_HAVE_CUDA
-      if (m_channelBuffers.instID)
-        cudaFree(m_channelBuffers.instID);
-      m_channelBuffers.instID = 0;
+      if (onDevice)
+        cudaMalloc(&mem,numBytes);
+      else if (cudaMallocHost(&mem,numBytes) == cudaSuccess)
+        buffer.hostPinned = true;
+      else {
+        /* no (usable) cuda device - eg, cpu backend */
+        cudaGetLastError();
+        mem = nullptr;
+      }
 #endif
-    } else if (channel == "channel.normalCUDA") {
+      if (!mem)
+        mem = new uint8_t[numBytes];
+    }
+    bnFrameBufferRead(m_bnFrameBuffer,channel,mem,format);
+    buffer.mapped = true;
+    return mem;
+  }
+
+  void Frame::freeChannelBuffer(ChannelBuffer &buffer)
+  {
 #if BANARI_HAVE_CUDA
-      if (m_channelBuffers.normal)
-        cudaFree(m_channelBuffers.normal);
-      m_channelBuffers.normal = 0;
+    if (buffer.device)
+      cudaFree(buffer.device);
+    if (buffer.host && buffer.hostPinned)
+      cudaFreeHost(buffer.host);
+    else
 #endif
-    }
+      delete[] (uint8_t*)buffer.host;
+    buffer = ChannelBuffer();
   }
 
   int Frame::frameReady(ANARIWaitMask m)
@@ -456,35 +600,73 @@ namespace barney_device {
 
   void Frame::discard()
   {
-    // no-op (not yet async)
+    // no-op: barney can't abort a render that's in flight
   }
 
   bool Frame::ready() const
   {
-    return true; // not yet async
+    auto tether = deviceState()->tether;
+    std::shared_future<void> inFlight;
+    {
+      std::lock_guard<std::mutex> lock(tether->mutex);
+      inFlight = tether->renderInFlight;
+    }
+    return !inFlight.valid()
+      || inFlight.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
   }
 
-  void Frame::wait() const {}
-
-  void Frame::cleanup()
+  void Frame::wait()
   {
-    delete[] m_channelBuffers.color;
-    m_channelBuffers.color = nullptr;
-
-    delete[] m_channelBuffers.depth;
-    m_channelBuffers.depth = nullptr;
-
-    delete[] m_channelBuffers.primID;
-    m_channelBuffers.primID = nullptr;
-
-    delete[] m_channelBuffers.instID;
-    m_channelBuffers.instID = nullptr;
+    auto tether = deviceState()->tether;
+    std::shared_future<void> inFlight;
+    int generation;
+    {
+      std::lock_guard<std::mutex> lock(tether->mutex);
+      inFlight   = tether->renderInFlight;
+      generation = tether->renderGeneration;
+    }
+    if (inFlight.valid()) {
+      // get(), not wait(), so exceptions from the render thread
+      // propagate to the app - but only once per frame; the other
+      // tethered devices' frames still have to see it complete, so
+      // the tether keeps its future
+      if (generation != m_waitedRenderGeneration) {
+        m_waitedRenderGeneration = generation;
+        inFlight.get();
+      } else
+        inFlight.wait();
+    }
 
-    delete[] m_channelBuffers.objID;
-    m_channelBuffers.objID = nullptr;
+    // if the render read back a new color frame, flip it to the
+    // front - unless the app is still looking at the old one
+    int back = 1-m_stagedColor.front;
+    if (m_stagedColor.valid[back] && !m_stagedColor.mapped) {
+      m_stagedColor.front = back;
+      m_stagedColor.valid[1-back] = false;
+    }
+  }
 
-    delete[] m_channelBuffers.normal;
-    m_channelBuffers.normal = nullptr;
+  void Frame::freeStagedColor()
+  {
+    for (int i=0;i<2;i++) {
+      delete[] m_stagedColor.buffer[i];
+      m_stagedColor.buffer[i] = nullptr;
+      m_stagedColor.valid[i] = false;
+    }
+    m_stagedColor.mapped = false;
+  }
+  
+  void Frame::cleanup()
+  {
+    freeStagedColor();
+    
+    freeChannelBuffer(m_channelBuffers.color);
+    freeChannelBuffer(m_channelBuffers.depth);
+    freeChannelBuffer(m_channelBuffers.primID);
+    freeChannelBuffer(m_channelBuffers.instID);
+    freeChannelBuffer(m_channelBuffers.objID);
+    freeChannelBuffer(m_channelBuffers.normal);
+    freeChannelBuffer(m_channelBuffers.cost);
   }
 
 } // namespace barney_device
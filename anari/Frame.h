@@ -11,6 +11,7 @@
 #include "helium/BaseFrame.h"
 // std
 #include <vector>
+#include <atomic>
 
 namespace barney_device {
 
@@ -43,10 +44,32 @@ namespace barney_device {
     void discard() override;
 
     bool ready() const;
-    void wait() const;
+    void wait();
+
+    /*! called on the render thread, right after bnRender: reads the
+        color channel into the back staging buffer, so a later map()
+        doesn't have to do this readback synchronously */
+    void readbackColor();
 
   private:
     void cleanup();
+    void freeStagedColor();
+    /*! reads given barney channel into given channel buffer's host
+        or device memory (allocating that if required), and returns
+        that memory */
+    void *mapChannel(ChannelBuffer &buffer,
+                     const char *name,
+                     BNFrameBufferChannel channel,
+                     BNDataType format,
+                     size_t sizeOfPixel,
+                     bool onDevice);
+    void freeChannelBuffer(ChannelBuffer &buffer);
+    /*! picks what's under the frame's (uncommitted) 'pickPosition'
+        parameter, through bnPick() with the last rendered model;
+        false if there's no pick position, or nothing to pick in
+        yet. Re-uses the last result until the position changes or a
+        new frame gets rendered */
+    bool pick(BNPickResult &result);
 
     bool        m_valid           {false};
     math::uint2 m_size            { 0,0 };
@@ -54,16 +77,41 @@ namespace barney_device {
         resize). Matches buffer layout so map() reports correct stride. */
     math::uint2 m_displaySize     { 0,0 };
 
+    /*! what map() hands out for one channel. Allocated on the first
+        map after a resize, and then re-used by every later map -
+        host memory is pinned (if we have cuda), so the readback can
+        go straight into it */
+    struct ChannelBuffer {
+      void *host       = nullptr;
+      /*! only for the '...CUDA' channels */
+      void *device     = nullptr;
+      bool  hostPinned = false;
+      bool  mapped     = false;
+    };
     struct {
-      // color cold be uint or float4; if float4 we just allocate
-      // 4uints and store in those
-      uint32_t   *color{nullptr};
-      float      *depth{nullptr};
-      int        *primID{nullptr};
-      int        *instID{nullptr};
-      int        *objID{nullptr};
-      float      *normal{nullptr};
+      /*! only for channel.colorCUDA; host-side color goes through
+          m_stagedColor */
+      ChannelBuffer color;
+      ChannelBuffer depth;
+      ChannelBuffer primID;
+      ChannelBuffer instID;
+      ChannelBuffer objID;
+      ChannelBuffer normal;
+      ChannelBuffer cost;
     } m_channelBuffers;
+    /*! double-buffered host staging for the color channel: the
+        render thread reads frame N+1 into the 'back' one while the
+        app may still look at frame N in the front one. Allocated
+        once per frame size, not per map() */
+    struct {
+      uint32_t *buffer[2]  = {nullptr,nullptr};
+      bool      valid[2]   = {false,false};
+      int       front      = 0;
+      bool      mapped     = false;
+      /*! whether the render issued in renderFrame() should do the
+          readback (only for host-side color formats) */
+      bool      readbackRequested = false;
+    } m_stagedColor;
     struct {
       /* for performance warnings; initialize all to 'true' so they
          won't throw a perf warning on first time renderframe */
@@ -76,6 +124,15 @@ namespace barney_device {
     } m_didMapChannel;
     bool m_lastFrameWasFirstFrame = true;
 
+    /*! graphics api memory the color channel gets rendered into (see
+        BARNEY_FRAME_COLOR_TARGET); 'registeredFD' is the one that
+        barney currently has */
+    struct {
+      int      fd           = -1;
+      uint64_t size         = 0;
+      int      registeredFD = -1;
+    } m_colorTarget;
+
     struct {
       anari::DataType color{ANARI_UNKNOWN};
       anari::DataType depth{ANARI_UNKNOWN};
@@ -83,6 +140,8 @@ namespace barney_device {
       anari::DataType instID{ANARI_UNKNOWN};
       anari::DataType objID{ANARI_UNKNOWN};
       anari::DataType normal{ANARI_UNKNOWN};
+      /*! BARNEY_FRAME_CHANNEL_COST */
+      anari::DataType cost{ANARI_UNKNOWN};
     } m_channelTypes;
 
     helium::ChangeObserverPtr<Renderer> m_renderer;
@@ -91,12 +150,22 @@ namespace barney_device {
 
     helium::TimeStamp m_lastCommitFlush{0};
 
-    mutable float m_duration{0.f};
+    /*! the last pick() */
+    struct {
+      bool         valid = false;
+      math::float2 position { -1.f,-1.f };
+      BNPickResult result;
+    } m_pick;
+
+    /*! written by the render thread once bnRender completes */
+    std::atomic<float> m_duration{0.f};
 
     BNFrameBuffer m_bnFrameBuffer{nullptr};
     // for device tethering, we need this to know whether all devices
     // have 'checked in'
     int m_numTimesRenderFrameHasBeenCalled = 0;
+    /*! the tether's renderGeneration this frame last waited for */
+    int m_waitedRenderGeneration = 0;
   };
 
 } // namespace barney_device
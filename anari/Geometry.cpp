@@ -248,6 +248,8 @@ namespace barney_device {
     m_vertexPosition = getParamObject<Array1D>("vertex.position");
     m_vertexRadius = getParamObject<Array1D>("vertex.radius");
     m_globalRadius = getParam<float>("radius", 0.01f);
+    m_lod = getParam<bool>("lod", false);
+    m_lodThreshold = getParam<float>("lodThreshold", 1.f);
     m_vertexAttributes[0] = getParamObject<Array1D>("vertex.attribute0");
     m_vertexAttributes[1] = getParamObject<Array1D>("vertex.attribute1");
     m_vertexAttributes[2] = getParamObject<Array1D>("vertex.attribute2");
@@ -271,6 +273,8 @@ namespace barney_device {
       bnSetData(geom, "radii", m_vertexRadius->barneyData());
     else
       bnSet1f(geom, "radius", m_globalRadius);
+    bnSet1i(geom, "lod", (int)m_lod);
+    bnSet1f(geom, "lodThreshold", m_lodThreshold);
 
     setAttributes(geom);
   }
@@ -335,45 +339,16 @@ namespace barney_device {
                     "missing required parameter 'vertex.position' on cylinder geometry");
       return;
     }
-
-    m_generatedIndices.clear();
-    if (!m_index) {
-      m_generatedIndices.resize(m_vertexPosition->totalSize() / 2);
-      for (size_t i = 0; i < m_generatedIndices.size(); ++i) {
-        m_generatedIndices[i] = math::uint2((uint32_t)i * 2, (uint32_t)i * 2 + 1);
-      }
-    }
-
-    m_generatedRadii.clear();
-    if (!m_radius) {
-      int numIndices =
-        m_index ? (int)m_index->size() : (int)m_generatedIndices.size();
-      
-      m_generatedRadii.resize(numIndices);
-      for (size_t i = 0; i < numIndices; ++i) {
-        m_generatedRadii[i] = m_globalRadius;
-      }
-    }
   }
 
   void Cylinder::setBarneyParameters(BNGeom geom)
   {
-    int slot = deviceState()->slot;
-    auto context = deviceState()->tether->context;
-
-    int numIndices =
-      m_index ? (int)m_index->size() : (int)m_generatedIndices.size();
-    const bn_int2 *indices = m_index ? (const bn_int2 *)m_index->data()
-      : (const bn_int2 *)m_generatedIndices.data();
-    const float *radii = m_radius ? (const float *)m_radius->data()
-      : (const float *)m_generatedRadii.data();
-
-    BNData _indices = bnDataCreate(context, slot, BN_INT2, numIndices, indices);
-    bnSetAndRelease(geom, "indices", _indices);
-
-    BNData _radii = bnDataCreate(context, slot, BN_FLOAT, numIndices, radii);
-    bnSetAndRelease(geom, "radii", _radii);
-
+    /* barney pairs up consecutive vertices if there's no index, and
+       uses the common radius if there're no radii, so all arrays go
+       in as they are */
+    bnSetData(geom, "indices", m_index ? m_index->barneyData() : nullptr);
+    bnSetData(geom, "radii", m_radius ? m_radius->barneyData() : nullptr);
+    bnSet1f(geom, "radius", m_globalRadius);
     bnSetData(geom, "vertices", m_vertexPosition->barneyData());
 
     setAttributes(geom);
@@ -448,28 +423,12 @@ namespace barney_device {
                     "missing required parameter 'vertex.radius' on cone geometry");
       return;
     }
-
-    m_generatedIndices.clear();
-    if (!m_index) {
-      m_generatedIndices.resize(m_vertexPosition->totalSize() / 2);
-      for (size_t i = 0; i < m_generatedIndices.size(); ++i) {
-        m_generatedIndices[i] = math::uint2((uint32_t)i * 2, (uint32_t)i * 2 + 1);
-      }
-    }
   }
 
   void Cone::setBarneyParameters(BNGeom geom)
   {
-    int slot = deviceState()->slot;
-    auto context = deviceState()->tether->context;
-
-    int numIndices =
-      m_index ? (int)m_index->size() : (int)m_generatedIndices.size();
-    const bn_int2 *indices = m_index ? (const bn_int2 *)m_index->data()
-      : (const bn_int2 *)m_generatedIndices.data();
-    BNData _indices = bnDataCreate(context, slot, BN_INT2, numIndices, indices);
-    bnSetAndRelease(geom, "indices", _indices);
-
+    // barney pairs up consecutive vertices if there's no index
+    bnSetData(geom, "indices", m_index ? m_index->barneyData() : nullptr);
     bnSetData(geom, "vertices", m_vertexPosition->barneyData());
     bnSetData(geom, "radii", m_vertexRadius->barneyData());
 
@@ -548,56 +507,23 @@ namespace barney_device {
                     "missing required parameter 'vertex.position' on curve geometry");
       return;
     }
+    if (!m_index) {
+      reportMessage(ANARI_SEVERITY_WARNING,
+                    "missing required parameter 'primitive.index' on curve geometry");
+      return;
+    }
   }
 
   void Curve::setBarneyParameters(BNGeom geom)
   {
-    int slot = deviceState()->slot;
-    auto context = deviceState()->tether->context;
-
-    int numVertices = (int)m_vertexPosition->totalSize();
-    const bn_float3 *in_vertex = (const bn_float3 *)m_vertexPosition->data();
-  
-    std::vector<math::float4> vertex(numVertices);
-    if (m_vertexRadius && m_vertexRadius->totalSize() > 0) {
-      assert(m_vertexRadius->totalSize() == m_vertexPosition->totalSize());
-      const float *in_radius = (const float *)m_vertexRadius->data();
-      for (int i = 0; i < numVertices; i++)
-        vertex[i] = math::float4(
-                                 in_vertex[i].x, in_vertex[i].y, in_vertex[i].z, in_radius[i]);
-    } else {
-      // Use global radius for all vertices
-      for (int i = 0; i < numVertices; i++)
-        vertex[i] = math::float4(
-                                 in_vertex[i].x, in_vertex[i].y, in_vertex[i].z, m_globalRadius);
-    }
-
-    BNData vertices =
-      bnDataCreate(context, slot, BN_FLOAT4, numVertices, vertex.data());
-    bnSetAndRelease(geom, "vertices", vertices);
-
-    int numIndices = (int)m_index->totalSize();
-    std::vector<math::int2> index(numIndices);
-    const int *in_index = (const int *)m_index->data();
-    for (int i = 0; i < numIndices; i++) {
-      index[i] = math::int2(in_index[i], in_index[i] + 1);
-    }
-
-#if 0
-    // dump geometry to create test cases:
-    std::cout << "std::vector<vec4f> vertices = {" << std::endl;
-    for (auto v : vertex)
-      std::cout << "{"<<v.x<<","<<v.y<<","<<v.z<<","<<v.w<<"}," << std::endl;
-    std::cout << "};" << std::endl;
-    std::cout << "std::vector<vec2i> index = {" << std::endl;
-    for (auto v : index)
-      std::cout << "{"<<v.x<<","<<v.y<<"}," << std::endl;
-    std::cout << "};" << std::endl;
-#endif
-
-    BNData indices = bnDataCreate(
-                                  context, slot, BN_INT2, index.size(), (const int *)index.data());
-    bnSetAndRelease(geom, "indices", indices);
+    /* positions, radii and per-segment first-vertex indices go to
+       barney as they are; it interleaves them into float4 vertices,
+       and expands the indices into pairs, on the device */
+    bnSetData(geom, "positions", m_vertexPosition->barneyData());
+    bool haveRadii = m_vertexRadius && m_vertexRadius->totalSize() > 0;
+    bnSetData(geom, "radii", haveRadii ? m_vertexRadius->barneyData() : nullptr);
+    bnSet1f(geom, "radius", m_globalRadius);
+    bnSetData(geom, "indices", m_index ? m_index->barneyData() : nullptr);
 
     setAttributes(geom);
   }
@@ -620,7 +546,8 @@ namespace barney_device {
     box3 result;
     for (size_t i = 0; i < m_vertexPosition->totalSize(); ++i) {
       math::float3 v = *(m_vertexPosition->beginAs<math::float3>() + i);
-      float r = *(m_vertexRadius->beginAs<float>() + i);
+      float r = m_vertexRadius ? *(m_vertexRadius->beginAs<float>() + i)
+        : m_globalRadius;
       result.insert(math::float3{v.x - r, v.y - r, v.z - r});
       result.insert(math::float3{v.x + r, v.y + r, v.z + r});
     }
@@ -654,32 +581,45 @@ namespace barney_device {
       return;
     }
 
-    m_generatedIndices.clear();
+    std::vector<int> generatedIndices;
     if (!m_index) {
       size_t numQuads = m_vertexPosition->totalSize() / 4;
       for (size_t i = 0; i < numQuads; ++i) {
         // tri1
-        m_generatedIndices.push_back(int(i * 4));
-        m_generatedIndices.push_back(int(i * 4 + 1));
-        m_generatedIndices.push_back(int(i * 4 + 2));
+        generatedIndices.push_back(int(i * 4));
+        generatedIndices.push_back(int(i * 4 + 1));
+        generatedIndices.push_back(int(i * 4 + 2));
         // tri2
-        m_generatedIndices.push_back(int(i * 4));
-        m_generatedIndices.push_back(int(i * 4 + 2));
-        m_generatedIndices.push_back(int(i * 4 + 3));
+        generatedIndices.push_back(int(i * 4));
+        generatedIndices.push_back(int(i * 4 + 2));
+        generatedIndices.push_back(int(i * 4 + 3));
       }
     } else {
       for (size_t i = 0; i < m_index->totalSize(); ++i) {
         math::uint4 index = *(m_index->beginAs<math::uint4>() + i);
         // tri1
-        m_generatedIndices.push_back(int(index.x));
-        m_generatedIndices.push_back(int(index.y));
-        m_generatedIndices.push_back(int(index.z));
+        generatedIndices.push_back(int(index.x));
+        generatedIndices.push_back(int(index.y));
+        generatedIndices.push_back(int(index.z));
         // tri2
-        m_generatedIndices.push_back(int(index.x));
-        m_generatedIndices.push_back(int(index.z));
-        m_generatedIndices.push_back(int(index.w));
+        generatedIndices.push_back(int(index.x));
+        generatedIndices.push_back(int(index.z));
+        generatedIndices.push_back(int(index.w));
       }
     }
+    if (m_generatedIndices)
+      bnRelease(m_generatedIndices);
+    m_generatedIndices = bnDataCreate(deviceState()->tether->context,
+                                      deviceState()->slot,
+                                      BN_INT3,
+                                      generatedIndices.size() / 3,
+                                      generatedIndices.data());
+  }
+
+  Quad::~Quad()
+  {
+    if (m_generatedIndices)
+      bnRelease(m_generatedIndices);
   }
 
   bool Quad::isValid() const
@@ -689,13 +629,7 @@ namespace barney_device {
 
   void Quad::setBarneyParameters(BNGeom geom)
   {
-    int slot = deviceState()->slot;
-    auto context = deviceState()->tether->context;
-
-    int numIndices = (int)(m_generatedIndices.size() / 3);
-    const bn_int3 *indices = (const bn_int3 *)m_generatedIndices.data();
-    BNData _indices = bnDataCreate(context, slot, BN_INT3, numIndices, indices);
-    bnSetAndRelease(geom, "indices", _indices);
+    bnSetData(geom, "indices", m_generatedIndices);
 
     bnSetData(geom, "vertices", m_vertexPosition->barneyData());
     if (m_vertexNormal)
@@ -757,6 +691,7 @@ namespace barney_device {
     m_index = getParamObject<Array1D>("primitive.index");
     m_vertexPosition = getParamObject<Array1D>("vertex.position");
     m_vertexNormal = getParamObject<Array1D>("vertex.normal");
+    m_compactAttributes = getParam<bool>("compactAttributes", false);
     m_vertexAttributes[0] = getParamObject<Array1D>("vertex.attribute0");
     m_vertexAttributes[1] = getParamObject<Array1D>("vertex.attribute1");
     m_vertexAttributes[2] = getParamObject<Array1D>("vertex.attribute2");
@@ -778,13 +713,26 @@ namespace barney_device {
       return;
     }
 
-    m_generatedIndices.clear();
+    if (m_generatedIndices)
+      bnRelease(m_generatedIndices);
+    m_generatedIndices = nullptr;
     if (!m_index) {
-      m_generatedIndices.resize(m_vertexPosition->totalSize());
-      std::iota(m_generatedIndices.begin(), m_generatedIndices.end(), 0);
+      std::vector<int> generatedIndices(m_vertexPosition->totalSize());
+      std::iota(generatedIndices.begin(), generatedIndices.end(), 0);
+      m_generatedIndices = bnDataCreate(deviceState()->tether->context,
+                                        deviceState()->slot,
+                                        BN_INT3,
+                                        generatedIndices.size() / 3,
+                                        generatedIndices.data());
     }
   }
 
+  Triangle::~Triangle()
+  {
+    if (m_generatedIndices)
+      bnRelease(m_generatedIndices);
+  }
+
   bool Triangle::isValid() const
   {
     return m_vertexPosition;
@@ -795,16 +743,17 @@ namespace barney_device {
     int slot = deviceState()->slot;
     auto context = deviceState()->tether->context;
 
-    int numIndices =
-      m_index ? (int)m_index->size() : (int)(m_generatedIndices.size() / 3);
-    const bn_int3 *indices = m_index ? (const bn_int3 *)m_index->data()
-      : (const bn_int3 *)m_generatedIndices.data();
-    BNData _indices = bnDataCreate(context, slot, BN_INT3, numIndices, indices);
-    bnSetAndRelease(geom, "indices", _indices);
+    if (m_index) {
+      BNData _indices = bnDataCreate(context, slot, BN_INT3,
+                                     m_index->size(), m_index->data());
+      bnSetAndRelease(geom, "indices", _indices);
+    } else
+      bnSetData(geom, "indices", m_generatedIndices);
 
     bnSetData(geom, "vertices", m_vertexPosition->barneyData());
     if (m_vertexNormal)
       bnSetData(geom, "normals", m_vertexNormal->barneyData());
+    bnSet1i(geom, "compactAttributes", (int)m_compactAttributes);
 
     setAttributes(geom);
   }
@@ -820,7 +769,16 @@ namespace barney_device {
       return {};
 
     box3 result;
-    if (m_index) {
+    if (isDeviceMemory(m_vertexPosition->data())
+        || (m_index && isDeviceMemory(m_index->data()))) {
+      /* bounds over all vertices are conservative, and don't need
+         the (possibly device-resident) indices */
+      std::vector<math::float3> positions(m_vertexPosition->totalSize());
+      copyToHost(positions.data(), m_vertexPosition->data(),
+                 positions.size() * sizeof(math::float3));
+      for (auto v : positions)
+        result.insert(v);
+    } else if (m_index) {
       std::for_each(m_index->beginAs<math::uint3>(),
                     m_index->beginAs<math::uint3>() + m_index->totalSize(),
                     [&](math::uint3 index) {
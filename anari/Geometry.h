@@ -50,6 +50,8 @@ namespace barney_device {
     helium::ChangeObserverPtr<Array1D> m_vertexPosition;
     helium::ChangeObserverPtr<Array1D> m_vertexRadius;
     float m_globalRadius{0.f};
+    bool m_lod{false};
+    float m_lodThreshold{1.f};
   };
 
   struct IsoSurface : public Geometry
@@ -85,8 +87,6 @@ namespace barney_device {
     helium::ChangeObserverPtr<Array1D> m_radius;
     helium::ChangeObserverPtr<Array1D> m_vertexPosition;
     float m_globalRadius{0.f};
-    std::vector<math::uint2> m_generatedIndices;
-    std::vector<float> m_generatedRadii;
   };
 
   struct Cone : public Geometry
@@ -104,7 +104,6 @@ namespace barney_device {
     helium::ChangeObserverPtr<Array1D> m_index;
     helium::ChangeObserverPtr<Array1D> m_vertexPosition;
     helium::ChangeObserverPtr<Array1D> m_vertexRadius;
-    std::vector<math::uint2> m_generatedIndices;
   };
 
   struct Curve : public Geometry
@@ -128,6 +127,7 @@ namespace barney_device {
   struct Quad : public Geometry
   {
     Quad(BarneyGlobalState *s);
+    ~Quad() override;
     void commitParameters() override;
     void finalize() override;
     bool isValid() const override;
@@ -140,12 +140,16 @@ namespace barney_device {
     helium::ChangeObserverPtr<Array1D> m_index;
     helium::ChangeObserverPtr<Array1D> m_vertexPosition;
     helium::ChangeObserverPtr<Array1D> m_vertexNormal;
-    std::vector<int> m_generatedIndices;
+    /*! the triangle indices generated in finalize(); uploaded right
+        away (and shared by all surfaces using this geometry), so no
+        host copy of them stays around */
+    BNData m_generatedIndices{nullptr};
   };
 
   struct Triangle : public Geometry
   {
     Triangle(BarneyGlobalState *s);
+    ~Triangle() override;
     void commitParameters() override;
     void finalize() override;
     bool isValid() const override;
@@ -160,8 +164,10 @@ namespace barney_device {
     helium::ChangeObserverPtr<Array1D> m_index;
     helium::ChangeObserverPtr<Array1D> m_vertexPosition;
     helium::ChangeObserverPtr<Array1D> m_vertexNormal;
+    bool m_compactAttributes{false};
     std::array<helium::IntrusivePtr<Array1D>, 6> m_faceVaryingAttributes;
-    std::vector<int> m_generatedIndices;
+    /*! same as Quad's, for non-indexed triangles */
+    BNData m_generatedIndices{nullptr};
   };
 
 } // namespace barney_device
@@ -22,6 +22,7 @@ namespace barney_device {
     m_surfaceData = getParamObject<ObjectArray>("surface");
     m_volumeData = getParamObject<ObjectArray>("volume");
     m_lightData = getParamObject<ObjectArray>("light");
+    m_buildQuality = getParamString("buildQuality", "default");
   }
 
   void Group::markFinalized()
@@ -123,12 +124,18 @@ namespace barney_device {
                                (int)barneyGeometries.size(),
                                barneyVolumes.data(),
                                (int)barneyVolumes.size());
+    int buildQuality
+      = m_buildQuality == "fastTrace" ? 1
+      : m_buildQuality == "fastBuild" ? 2
+      : 0;
     if (lightsData) {
       bnSetData(bg, "lights", lightsData);
       bnRelease(lightsData);
-      bnCommit(bg);
     }
-    bnGroupBuild(bg);
+    if (buildQuality)
+      bnSet1i(bg, "buildQuality", buildQuality);
+    if (lightsData || buildQuality)
+      bnCommit(bg);
 
     reportMessage(ANARI_SEVERITY_DEBUG,
                   "barney::Group constructed with %zu surfaces, %zu volumes, and %zu lights",
@@ -29,6 +29,8 @@ namespace barney_device {
     helium::ChangeObserverPtr<ObjectArray> m_surfaceData;
     helium::ChangeObserverPtr<ObjectArray> m_volumeData;
     helium::ChangeObserverPtr<ObjectArray> m_lightData;
+    /*! "default", "fastTrace", or "fastBuild" */
+    std::string m_buildQuality{"default"};
   };
 
 } // namespace barney_device
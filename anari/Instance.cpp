@@ -89,17 +89,21 @@ namespace barney_device {
   {
     math::mat4 xfm = m_transform;
 
-    box3 result = group()->bounds();
-
-    math::float4 lower(result.lower, 1.f);
-    math::float4 upper(result.upper, 1.f);
-
-    lower = mul(xfm, lower);
-    upper = mul(xfm, upper);
-
-    result.lower = math::float3(lower.x, lower.y, lower.z);
-    result.upper = math::float3(upper.x, upper.y, upper.z);
-
+    box3 groupBounds = group()->bounds();
+    if (groupBounds.lower.x > groupBounds.upper.x)
+      return groupBounds;
+
+    // transform all eight corners, so the result stays conservative
+    // under rotations
+    box3 result;
+    for (int i = 0; i < 8; i++) {
+      math::float4 corner((i & 1) ? groupBounds.upper.x : groupBounds.lower.x,
+                          (i & 2) ? groupBounds.upper.y : groupBounds.lower.y,
+                          (i & 4) ? groupBounds.upper.z : groupBounds.lower.z,
+                          1.f);
+      corner = mul(xfm, corner);
+      result.insert(math::float3(corner.x, corner.y, corner.z));
+    }
     return result;
   }
 
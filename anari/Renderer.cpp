@@ -7,10 +7,12 @@
 
 namespace barney_device {
 
-Renderer::Renderer(BarneyGlobalState *s)
+Renderer::Renderer(BarneyGlobalState *s, const char *subtype)
     : Object(ANARI_RENDERER, s), m_backgroundImage(this)
 {
-  barneyRenderer = bnRendererCreate(deviceState()->tether->context, "default");
+  barneyRenderer = bnRendererCreate
+    (deviceState()->tether->context,
+     subtype && std::string(subtype) == "raycast" ? "raycast" : "default");
 }
 
 Renderer::~Renderer()
@@ -25,13 +27,32 @@ void Renderer::commitParameters()
   m_crosshairs = getParam<bool>("crosshairs", false);
   m_denoise = getParam<bool>("denoise", true);
   m_fadeOutDenoiser = getParam<bool>("fadeOutDenoiser", true);
+  m_denoiseInterval = getParam<int>("denoiseInterval", 1);
   m_upscale = getParam<bool>("upscale", false);
+  m_dynamicResolution = getParam<bool>("dynamicResolution", false);
+  m_minRenderScale = getParam<float>("minRenderScale", .33f);
+  m_temporalReprojection = getParam<bool>("temporalReprojection", false);
+  m_maxHistoryLength = getParam<int>("maxHistoryLength", 16);
+  m_maxAccumulation = getParam<int>("maxAccumulation", 0);
+  m_stopWhenConverged = getParam<bool>("stopWhenConverged", false);
+  m_primaryHitCache = getParam<int>("primaryHitCache", 0);
   m_background = getParam<math::float4>("background", math::float4(0, 0, 0, 1));
   m_backgroundImage = getParamObject<Array2D>("background");
   m_cutPlane = getParam<math::float4>("cutPlane", math::float4(0, 0, 0, 0));
+  m_sortRays = getParam<int>("sortRays", 0);
+  m_adaptiveThreshold = getParam<float>("adaptiveThreshold", 0.f);
+  m_adaptiveMinSamples = getParam<int>("adaptiveMinSamples", 16);
+  m_restirDI = getParam<bool>("restirDI", false);
+  m_lowDiscrepancySampling = getParam<bool>("lowDiscrepancySampling", false);
+  m_russianRouletteDepth = getParam<int>("russianRouletteDepth", 0);
+  m_throughputCutoff = getParam<float>("throughputCutoff", 0.f);
+  m_targetFrameTime = getParam<float>("targetFrameTime", 0.f);
+  m_aoSamples = getParam<int>("aoSamples", 0);
+  m_aoRadius = getParam<float>("aoRadius", 1e20f);
 #if BARNEY_USE_MULTI_SCATTERING
   m_maxVolumeBounces = getParam<int>("maxVolumeBounces", 8);
   m_volumeMultiScatter = getParam<bool>("volumeMultiScatter", false);
+  m_volumeGuiding = getParam<float>("volumeGuiding", 0.f);
 #endif
 }
 
@@ -41,9 +62,22 @@ void Renderer::finalize()
   bnSet1i(barneyRenderer, "crosshairs", (int)m_crosshairs);
   bnSet1i(barneyRenderer, "pathsPerPixel", (int)m_pixelSamples);
   bnSet1f(barneyRenderer, "ambientRadiance", m_ambientRadiance);
+  bnSet1i(barneyRenderer, "sortRays", m_sortRays);
+  bnSet1f(barneyRenderer, "adaptiveThreshold", m_adaptiveThreshold);
+  bnSet1i(barneyRenderer, "adaptiveMinSamples", m_adaptiveMinSamples);
+  bnSet1i(barneyRenderer, "restirDI", (int)m_restirDI);
+  bnSet1i(barneyRenderer,
+          "lowDiscrepancySampling",
+          (int)m_lowDiscrepancySampling);
+  bnSet1i(barneyRenderer, "russianRouletteDepth", m_russianRouletteDepth);
+  bnSet1f(barneyRenderer, "throughputCutoff", m_throughputCutoff);
+  bnSet1f(barneyRenderer, "targetFrameTime", m_targetFrameTime);
+  bnSet1i(barneyRenderer, "aoSamples", m_aoSamples);
+  bnSet1f(barneyRenderer, "aoRadius", m_aoRadius);
 #if BARNEY_USE_MULTI_SCATTERING
   bnSet1i(barneyRenderer, "maxVolumeBounces", m_maxVolumeBounces);
   bnSet1i(barneyRenderer, "volumeMultiScatter", (int)m_volumeMultiScatter);
+  bnSet1f(barneyRenderer, "volumeGuiding", m_volumeGuiding);
 #endif
   bnSet4f(barneyRenderer, "cutPlane",
           m_cutPlane.x, m_cutPlane.y, m_cutPlane.z, m_cutPlane.w);
@@ -85,11 +119,51 @@ bool Renderer::fadeOutDenoiser() const
   return m_fadeOutDenoiser;
 }
 
+int Renderer::denoiseInterval() const
+{
+  return m_denoiseInterval;
+}
+
 bool Renderer::upscale() const
 {
   return m_upscale;
 }
 
+bool Renderer::dynamicResolution() const
+{
+  return m_dynamicResolution;
+}
+
+float Renderer::minRenderScale() const
+{
+  return m_minRenderScale;
+}
+
+bool Renderer::temporalReprojection() const
+{
+  return m_temporalReprojection;
+}
+
+int Renderer::maxHistoryLength() const
+{
+  return m_maxHistoryLength;
+}
+
+int Renderer::maxAccumulation() const
+{
+  return m_maxAccumulation;
+}
+
+bool Renderer::stopWhenConverged() const
+{
+  return m_stopWhenConverged;
+}
+
+int Renderer::primaryHitCache() const
+{
+  return m_primaryHitCache;
+}
+
 bool Renderer::isValid() const
 {
   return barneyRenderer != 0;
@@ -12,7 +12,9 @@ namespace barney_device {
 
   struct Renderer : public Object
   {
-    Renderer(BarneyGlobalState *s);
+    /*! "raycast" gets barney's primary-rays-only preview renderer,
+        anything else the path tracer */
+    Renderer(BarneyGlobalState *s, const char *subtype = "default");
     ~Renderer() override;
 
     void commitParameters() override;
@@ -21,7 +23,15 @@ namespace barney_device {
     bool crosshairs() const;
     bool denoise() const;
     bool fadeOutDenoiser() const;
+    int denoiseInterval() const;
     bool upscale() const;
+    bool dynamicResolution() const;
+    float minRenderScale() const;
+    bool temporalReprojection() const;
+    int maxHistoryLength() const;
+    int maxAccumulation() const;
+    bool stopWhenConverged() const;
+    int primaryHitCache() const;
     bool isValid() const override;
 
     BNRenderer barneyRenderer{nullptr};
@@ -34,12 +44,31 @@ namespace barney_device {
     bool m_crosshairs{false};
     bool m_denoise{true};
     bool m_fadeOutDenoiser{true};
+    int m_denoiseInterval{1};
     bool m_upscale{false};
+    bool m_dynamicResolution{false};
+    float m_minRenderScale{.33f};
+    bool m_temporalReprojection{false};
+    int m_maxHistoryLength{16};
+    int m_maxAccumulation{0};
+    bool m_stopWhenConverged{false};
+    int m_primaryHitCache{0};
     anari::math::float4 m_background{0.f, 0.f, 0.f, 1.f};
     anari::math::float4 m_cutPlane{0.f, 0.f, 0.f, -1e30f};
+    int m_sortRays{0};
+    float m_adaptiveThreshold{0.f};
+    int m_adaptiveMinSamples{16};
+    bool m_restirDI{false};
+    bool m_lowDiscrepancySampling{false};
+    int m_russianRouletteDepth{0};
+    float m_throughputCutoff{0.f};
+    float m_targetFrameTime{0.f};
+    int m_aoSamples{0};
+    float m_aoRadius{1e20f};
 #if BARNEY_USE_MULTI_SCATTERING
     int m_maxVolumeBounces{8};
     bool m_volumeMultiScatter{false};
+    float m_volumeGuiding{0.f};
 #endif
     helium::ChangeObserverPtr<Array2D> m_backgroundImage;
   };
@@ -465,6 +465,22 @@ namespace barney_device {
       barneyType = BN_UFIXED8_RGBA;
       sizeOfType = 4;
       break;
+    case ANARI_FLOAT32:
+      barneyType = BN_FLOAT;
+      sizeOfType = 4;
+      break;
+    case ANARI_FLOAT32_VEC2:
+      barneyType = BN_FLOAT2;
+      sizeOfType = 8;
+      break;
+    case ANARI_FLOAT32_VEC3:
+      barneyType = BN_FLOAT3;
+      sizeOfType = 12;
+      break;
+    case ANARI_FLOAT32_VEC4:
+      barneyType = BN_FLOAT4;
+      sizeOfType = 16;
+      break;
     default: throw std::runtime_error
         ("unsupported anari primitive sampler data type #"
          +std::to_string((int)type));
@@ -173,6 +173,8 @@ namespace barney_device {
   {
     m_filter = getParamString("filter", "linear");
     m_data = getParamObject<Array1D>("data");
+    m_partitionCount = getParam<int>("partitionCount", 1);
+    m_partitionIndex = getParam<int>("partitionIndex", 0);
   }
   
   void NanoVDBSpatialField::finalize()
@@ -229,6 +231,8 @@ namespace barney_device {
                              gridHandle.data());
     assert(bd);
     assert(sf);
+    bnSet1i(sf,"partitionCount",m_partitionCount);
+    bnSet1i(sf,"partitionIndex",m_partitionIndex);
     bnSetAndRelease(sf,"data",bd);
     bnCommit(sf);
   }
@@ -517,10 +521,12 @@ namespace barney_device {
     auto *blockBounds = m_params.blockBounds->beginAs<box3i>();
     auto *blockLevels = m_params.blockLevel->beginAs<int>();
 
-    m_generatedBlockOrigins.clear();
-    m_generatedBlockDims.clear();
-    m_generatedBlockLevels.clear();
-    m_generatedBlockOffsets.clear();
+    /* repacked block descriptors only live until they're uploaded */
+    std::vector<math::int3> generatedBlockOrigins;
+    std::vector<math::int3> generatedBlockDims;
+    std::vector<int> generatedBlockLevels;
+    std::vector<uint64_t> generatedBlockOffsets;
+    std::vector<int> generatedRefinements;
 
     m_bounds.invalidate();
 
@@ -531,10 +537,10 @@ namespace barney_device {
 
       math::int3 dims = bounds.upper - bounds.lower + math::int3(1);
 
-      m_generatedBlockOrigins.push_back(bounds.lower);
-      m_generatedBlockDims.push_back(dims);
-      m_generatedBlockLevels.push_back(level);
-      m_generatedBlockOffsets.push_back(dims.x * size_t(dims.y) * dims.z);
+      generatedBlockOrigins.push_back(bounds.lower);
+      generatedBlockDims.push_back(dims);
+      generatedBlockLevels.push_back(level);
+      generatedBlockOffsets.push_back(dims.x * size_t(dims.y) * dims.z);
       maxLevel = std::max(maxLevel, level);
 
       box3 worldBounds;
@@ -547,11 +553,11 @@ namespace barney_device {
       m_bounds.insert(worldBounds);
     }
 
-    m_generatedRefinements.resize(maxLevel+1, 2);
+    generatedRefinements.resize(maxLevel+1, 2);
 
-    std::exclusive_scan(m_generatedBlockOffsets.begin(),
-                        m_generatedBlockOffsets.end(),
-                        m_generatedBlockOffsets.begin(),
+    std::exclusive_scan(generatedBlockOffsets.begin(),
+                        generatedBlockOffsets.end(),
+                        generatedBlockOffsets.begin(),
                         (uint64_t)0);
 
     //=======================================================
@@ -564,7 +570,7 @@ namespace barney_device {
     BNScalarField sf = getBarneyScalarField();
 
     size_t numScalars = m_params.data->size();
-    size_t numLevels = m_generatedRefinements.size();
+    size_t numLevels = generatedRefinements.size();
 
     if (!m_bnData.scalars) {
       m_bnData.scalars =
@@ -576,40 +582,40 @@ namespace barney_device {
 
     if (!m_bnData.blockOrigins) {
       m_bnData.blockOrigins =
-        bnDataCreate(context, slot, BN_INT32_VEC3, numBlocks, m_generatedBlockOrigins.data());
+        bnDataCreate(context, slot, BN_INT32_VEC3, numBlocks, generatedBlockOrigins.data());
     } else {
-      bnDataSet(m_bnData.blockOrigins, numBlocks, m_generatedBlockOrigins.data());
+      bnDataSet(m_bnData.blockOrigins, numBlocks, generatedBlockOrigins.data());
     }
 
 
     if (!m_bnData.blockDims) {
       m_bnData.blockDims =
-        bnDataCreate(context, slot, BN_INT32_VEC3, numBlocks, m_generatedBlockDims.data());
+        bnDataCreate(context, slot, BN_INT32_VEC3, numBlocks, generatedBlockDims.data());
     } else {
-      bnDataSet(m_bnData.blockDims, numBlocks, m_generatedBlockDims.data());
+      bnDataSet(m_bnData.blockDims, numBlocks, generatedBlockDims.data());
     }
 
 
     if (!m_bnData.blockLevels) {
       m_bnData.blockLevels =
-        bnDataCreate(context, slot, BN_INT32, numBlocks, m_generatedBlockLevels.data());
+        bnDataCreate(context, slot, BN_INT32, numBlocks, generatedBlockLevels.data());
     } else {
-      bnDataSet(m_bnData.blockLevels, numBlocks, m_generatedBlockLevels.data());
+      bnDataSet(m_bnData.blockLevels, numBlocks, generatedBlockLevels.data());
     }
 
 
     if (!m_bnData.blockOffsets) {
       m_bnData.blockOffsets =
-        bnDataCreate(context, slot, BN_UINT64, numBlocks, m_generatedBlockOffsets.data());
+        bnDataCreate(context, slot, BN_UINT64, numBlocks, generatedBlockOffsets.data());
     } else {
-      bnDataSet(m_bnData.blockOffsets, numBlocks, m_generatedBlockOffsets.data());
+      bnDataSet(m_bnData.blockOffsets, numBlocks, generatedBlockOffsets.data());
     }
 
     if (!m_bnData.levelRefinements) {
       m_bnData.levelRefinements =
-        bnDataCreate(context, slot, BN_INT32, numLevels, m_generatedRefinements.data());
+        bnDataCreate(context, slot, BN_INT32, numLevels, generatedRefinements.data());
     } else {
-      bnDataSet(m_bnData.levelRefinements, numLevels, m_generatedRefinements.data());
+      bnDataSet(m_bnData.levelRefinements, numLevels, generatedRefinements.data());
     }
 
     bnSetData(sf, "scalars", m_bnData.scalars);
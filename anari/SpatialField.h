@@ -128,12 +128,6 @@ namespace barney_device {
       BNData levelRefinements{nullptr};
     } m_bnData;
 
-    std::vector<math::int3> m_generatedBlockOrigins;
-    std::vector<math::int3> m_generatedBlockDims;
-    std::vector<int> m_generatedBlockLevels;
-    std::vector<uint64_t> m_generatedBlockOffsets;
-    std::vector<int> m_generatedRefinements;
-
     box3 m_bounds;
   };
 
@@ -169,6 +163,10 @@ namespace barney_device {
 
     std::string m_filter;
     helium::ChangeObserverPtr<helium::Array1D> m_data;
+    /*! barney extension: keep only the partitionIndex'th of
+        partitionCount slabs of the grid (for data-parallel rendering) */
+    int m_partitionCount = 1;
+    int m_partitionIndex = 0;
 
     box3 m_bounds;
     math::float3 m_voxelSize;
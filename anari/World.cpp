@@ -5,6 +5,7 @@
 #include "World.h"
 // std
 #include <algorithm>
+#include <cstring>
 #include <map>
 
 namespace barney_device {
@@ -43,6 +44,7 @@ namespace barney_device {
       }
     }
 
+    deviceState()->residentWorlds.remove(this);
     tetheredModel = {};
   }
 
@@ -57,11 +59,7 @@ namespace barney_device {
         deviceState()->commitBuffer.flush();
         makeCurrent();
       }
-      box3 bounds;
-      bounds.invalidate();
-      std::for_each(m_instances.begin(), m_instances.end(), [&](auto *inst) {
-        bounds.insert(inst->bounds());
-      });
+      box3 bounds = this->bounds();
       std::memcpy(ptr, &bounds, sizeof(bounds));
       return true;
     }
@@ -131,6 +129,7 @@ namespace barney_device {
 
   void World::markFinalized()
   {
+    m_lastChange = helium::newTimeStamp();
     deviceState()->markSceneChanged();
     Object::markFinalized();
   }
@@ -139,9 +138,43 @@ namespace barney_device {
   BNModel World::makeCurrent()
   {
     buildBarneyModel();
+    markResident();
     return tetheredModel->model;
   }
 
+  void World::markResident()
+  {
+    auto &resident = deviceState()->residentWorlds;
+    if (!resident.empty() && resident.front() == this)
+      return;
+    resident.remove(this);
+    resident.push_front(this);
+    int maxResident = deviceState()->maxResidentWorlds;
+    while (maxResident > 0 && (int)resident.size() > maxResident) {
+      World *lru = resident.back();
+      resident.pop_back();
+      lru->evict();
+    }
+  }
+
+  void World::evict()
+  {
+    reportMessage(ANARI_SEVERITY_DEBUG,
+                  "barney::World evicting model of least recently used world");
+    auto barneyModel = tetheredModel->model;
+    int  slot    = deviceState()->slot;
+    bnSetInstances(barneyModel, slot, nullptr, nullptr, 0);
+    for (int i = 0; i < Instance::Attributes::count; i++) {
+      if (!m_attributesData[i]) continue;
+      std::string attribName = std::string("attribute") + std::to_string(i);
+      bnSetInstanceAttributes(barneyModel, slot, attribName.c_str(), 0);
+      bnRelease(m_attributesData[i]);
+      m_attributesData[i] = 0;
+      m_uploadedAttributes[i].clear();
+    }
+    m_lastBarneyModelBuild = 0;
+  }
+
   void World::uploadInstanceAttributes(const InstanceAttributes &attributes)
   {
     auto barneyModel = tetheredModel->model;
@@ -149,6 +182,24 @@ namespace barney_device {
     auto context = deviceState()->tether->context;
 
     for (int i = 0; i < Instance::Attributes::count; i++) {
+      auto &uploaded = m_uploadedAttributes[i];
+      if (m_attributesData[i] && uploaded.size() == attributes[i].size()) {
+        // same instances; only re-upload the range that changed, the
+        // array itself (and thus the model) stays as it is
+        size_t begin = 0, end = uploaded.size();
+        auto same = [](const math::float4 &a, const math::float4 &b) {
+          return memcmp(&a, &b, sizeof(a)) == 0;
+        };
+        while (begin < end && same(uploaded[begin], attributes[i][begin]))
+          ++begin;
+        while (end > begin && same(uploaded[end-1], attributes[i][end-1]))
+          --end;
+        if (begin < end)
+          bnDataSetRange(m_attributesData[i], begin, end-begin,
+                         attributes[i].data()+begin);
+        uploaded = attributes[i];
+        continue;
+      }
       if (m_attributesData[i]) {
         bnRelease(m_attributesData[i]);
         m_attributesData[i] = 0;
@@ -156,6 +207,7 @@ namespace barney_device {
       m_attributesData[i] =
         bnDataCreate(context, slot, BN_FLOAT4,
                      attributes[i].size(), attributes[i].data());
+      uploaded = attributes[i];
     }
 
     for (int i = 0; i < Instance::Attributes::count; i++) {
@@ -167,8 +219,7 @@ namespace barney_device {
 
   void World::buildBarneyModel()
   {
-    auto *state = deviceState();
-    if (state->objectUpdates.lastSceneChange <= m_lastBarneyModelBuild)
+    if (m_lastBarneyModelBuild != 0 && m_lastChange <= m_lastBarneyModelBuild)
       return;
 
     bool structural =
@@ -183,7 +234,8 @@ namespace barney_device {
       true
 #else
       m_lastBarneyModelBuild == 0
-      || state->objectUpdates.lastStructuralChange > m_lastBarneyModelBuild
+      || deviceState()->objectUpdates.lastStructuralChange
+         > m_lastBarneyModelBuild
 #endif
         ;
 
@@ -198,6 +250,27 @@ namespace barney_device {
     m_lastBarneyModelBuild = helium::newTimeStamp();
   }
 
+  box3 World::bounds() const
+  {
+    box3 bounds;
+    bounds.invalidate();
+    std::for_each(m_instances.begin(), m_instances.end(), [&](auto *inst) {
+      if (inst && inst->group())
+        bounds.insert(inst->bounds());
+    });
+    return bounds;
+  }
+
+  void World::publishDomainBounds()
+  {
+    box3 bounds = this->bounds();
+    if (bounds.lower.x > bounds.upper.x)
+      return;
+    bnSetDomainBounds(tetheredModel->model, deviceState()->slot,
+                      (const bn_float3 &)bounds.lower,
+                      (const bn_float3 &)bounds.upper);
+  }
+
   void World::fullRebuild()
   {
     auto barneyModel = tetheredModel->model;
@@ -238,6 +311,13 @@ namespace barney_device {
       }
     }
 
+    // build all groups in one go, rather than one after another as
+    // they got created
+    std::vector<BNGroup> uniqueGroups;
+    for (auto &[_, bg] : groupDedup)
+      if (bg) uniqueGroups.push_back(bg);
+    bnGroupsBuild(uniqueGroups.data(),(int)uniqueGroups.size());
+
     assert(barneyModel);
     bnSetInstances(barneyModel, slot,
                    barneyGroups.data(), barneyTransforms.data(),
@@ -247,6 +327,7 @@ namespace barney_device {
       bnRelease(bg);
 
     uploadInstanceAttributes(attributes);
+    publishDomainBounds();
     bnBuild(barneyModel, slot);
   }
 
@@ -285,6 +366,7 @@ namespace barney_device {
     bnUpdateInstanceTransforms(barneyModel, slot,
                                barneyTransforms.data(),
                                (int)barneyTransforms.size());
+    publishDomainBounds();
   }
 
 } // namespace barney_device
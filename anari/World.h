@@ -32,9 +32,21 @@ namespace barney_device {
       = std::array<std::vector<math::float4>, Instance::Attributes::count>;
 
     void buildBarneyModel();
+    /*! moves this world to the front of the device's resident worlds,
+        and evicts those beyond maxResidentWorlds */
+    void markResident();
+    /*! drops our barney model's instances (and with them, unless
+        other worlds share them, the groups' accels and the instance
+        accel), so the next makeCurrent() rebuilds from scratch */
+    void evict();
     void uploadInstanceAttributes(const InstanceAttributes &attributes);
     void fullRebuild();
     void transformOnlyUpdate();
+    /*! world-space bounds of all instances */
+    box3 bounds() const;
+    /*! passes our bounds on to barney, for data-parallel ray
+        routing */
+    void publishDomainBounds();
 
     helium::ChangeObserverPtr<ObjectArray> m_zeroSurfaceData;
     helium::ChangeObserverPtr<ObjectArray> m_zeroVolumeData;
@@ -49,7 +61,16 @@ namespace barney_device {
     TetheredModel::SP tetheredModel;
 
     BNData m_attributesData[Instance::Attributes::count] = {0,0,0,0,0};
+    /*! what's currently in m_attributesData, so unchanged attributes
+        don't get uploaded again */
+    InstanceAttributes m_uploadedAttributes;
     helium::TimeStamp m_lastBarneyModelBuild{0};
+    /*! last time this world (or, through the change observers,
+        anything in it) got finalized; unlike the device-wide
+        lastSceneChange this doesn't move when some other world
+        changes, so going back to a world that is still resident
+        doesn't rebuild it */
+    helium::TimeStamp m_lastChange{0};
   };
 
 } // namespace barney_device
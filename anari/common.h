@@ -12,14 +12,53 @@
 // std
 #include <iostream>
 #include <cassert>
+#include <cstring>
 #include <limits>
 #include <sstream>
 #include <vector>
+// cuda
+#if BANARI_HAVE_CUDA
+#include <cuda_runtime.h>
+#endif
 
 #define BANARI_TRACK_LEAKS(a) /* nothing */
 
 namespace barney_device {
 
+/*! whether given (array) memory is CUDA device memory, on any of
+    this process' GPUs. Barney's data arrays accept those as is, and
+    copy them device-to-device (or peer-to-peer) rather than through
+    the host; but the device itself must not touch them on the host.
+    Managed memory counts as host memory */
+inline bool isDeviceMemory(const void *ptr)
+{
+#if BANARI_HAVE_CUDA
+  if (!ptr)
+    return false;
+  cudaPointerAttributes attributes;
+  if (cudaPointerGetAttributes(&attributes, ptr) != cudaSuccess) {
+    // plain, never-registered host memory on older runtimes
+    (void)cudaGetLastError();
+    return false;
+  }
+  return attributes.type == cudaMemoryTypeDevice;
+#else
+  return false;
+#endif
+}
+
+/*! copies numBytes of (possibly device-resident) memory to the host */
+inline void copyToHost(void *dst, const void *src, size_t numBytes)
+{
+#if BANARI_HAVE_CUDA
+  if (isDeviceMemory(src)) {
+    cudaMemcpy(dst, src, numBytes, cudaMemcpyDeviceToHost);
+    return;
+  }
+#endif
+  std::memcpy(dst, src, numBytes);
+}
+
 enum Attribute {
   Attribute0, Attribute1, Attribute2, Attribute3, Color, None=-1,
 };
@@ -225,6 +264,12 @@ static BNData makeBarneyData(BNContext context,
     if (input->elementType() == ANARI_FLOAT32_VEC4) {
       res = bnDataCreate(context, slot, BN_FLOAT4, input->totalSize(), input->data());
     }
+    else if (isDeviceMemory(input->data())) {
+      warnObject->reportMessage(ANARI_SEVERITY_WARNING,
+                                "device-resident attribute arrays have to be "
+                                "float4, not %s; ignoring",
+                                anari::toString(input->elementType()));
+    }
     else if (convert_to_float4(input, data) && !data.empty()) {
       warnObject->reportMessage(ANARI_SEVERITY_DEBUG,
                                 "makeBarneyData converts %s to float4",
@@ -110,6 +110,8 @@ const char ** query_extensions() {
       "ANARI_KHR_RENDERER_BACKGROUND_IMAGE",
       "ANARI_KHR_SAMPLER_IMAGExD_CLAMP_TO_BORDER",
       "ANARI_NV_FRAME_BUFFERS_CUDA",
+      "ANARI_BARNEY_FRAME_COLOR_TARGET",
+      "ANARI_BARNEY_FRAME_CHANNEL_COST",
       0
    };
    return extensions;
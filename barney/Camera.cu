@@ -24,6 +24,8 @@ namespace BARNEY_NS {
     void commit() override;
     bool set1f(const std::string &member, const float &value) override;
     bool set3f(const std::string &member, const vec3f &value) override;
+    bool setString(const std::string &member,
+                   const std::string &value) override;
     /*! @} */
     // ------------------------------------------------------------------
     
@@ -34,6 +36,11 @@ namespace BARNEY_NS {
     float fovy      = 60.f;
     float focusDistance  = 0.f;
     float apertureRadius = 0.f;
+    /*! as in anari: "none", "left", "right", "sideBySide" or
+        "topBottom"; the latter two render both eyes into the one
+        frame, as a Camera::STEREO */
+    std::string stereoMode = "none";
+    float interpupillaryDistance = 0.0635f;
   };
   
   bool PerspectiveCamera::set1f(const std::string &member, const float &value)
@@ -56,6 +63,22 @@ namespace BARNEY_NS {
       fovy = value;
       return true;
     }
+    if (member == "interpupillaryDistance") {
+      interpupillaryDistance = value;
+      return true;
+    }
+    return false;
+  }
+
+  bool PerspectiveCamera::setString(const std::string &member,
+                                    const std::string &value)
+  {
+    if (Camera::setString(member,value))
+      return true;
+    if (member == "stereoMode") {
+      stereoMode = value;
+      return true;
+    }
     return false;
   }
   
@@ -97,6 +120,17 @@ namespace BARNEY_NS {
     dd.perspective.lens_00 = from;
     dd.perspective.focusDistance = focusDistance;
     dd.perspective.apertureRadius = apertureRadius;
+    dd.perspective.eyeSeparation = interpupillaryDistance;
+    dd.perspective.stereoLayout = Camera::SIDE_BY_SIDE;
+
+    if (stereoMode == "sideBySide" || stereoMode == "topBottom") {
+      dd.type = Camera::STEREO;
+      dd.perspective.stereoLayout
+        = stereoMode == "topBottom"
+        ? Camera::TOP_BOTTOM
+        : Camera::SIDE_BY_SIDE;
+    } else if (stereoMode == "left" || stereoMode == "right")
+      dd = dd.eye(stereoMode == "right");
   }
     
 
@@ -17,8 +17,19 @@ namespace BARNEY_NS {
       UNDEFINED=0,
       PERSPECTIVE,
       ORTHOGRAPHIC,
-      OMNIDIRECTIONAL
+      OMNIDIRECTIONAL,
+      /*! two perspective cameras (one per eye) rendered into the two
+          halves of the same frame, in the same ray queues; uses the
+          'perspective' fields for the center eye (see eye()) */
+      STEREO
     } Type;
+    /*! how a STEREO camera lays out its two eyes in the frame */
+    typedef enum {
+      /*! left eye in the left half of the frame, right one in the right */
+      SIDE_BY_SIDE=0,
+      /*! left eye in the lower half of the frame, right one above it */
+      TOP_BOTTOM
+    } StereoLayout;
     /*! device-data for the camera object; to avoid virtual functions
         this currently uses a 'type'-switch, so the camera code on the
         device will have to 'interpret' what the actual fields
@@ -28,6 +39,28 @@ namespace BARNEY_NS {
       inline DD() : type(UNDEFINED) {};
       inline DD(const DD &) = default;
       inline ~DD() = default;
+
+      /*! for perspective cameras: direction (normalized) of the ray
+          through the center of given pixel, from the lens center;
+          what the first sample of every pixel gets traced with */
+      inline __both__ vec3f centerRayDir(vec2i pixel, vec2i numPixels) const;
+      /*! for perspective cameras: inverts centerRayDir(), ie, finds
+          the pixel through which world-space point P gets seen;
+          false if that's behind the camera, or outside the frame */
+      inline __both__ bool project(vec3f P, vec2i numPixels, vec2i &pixel) const;
+      /*! for stereo cameras: finds the eye (0=left, 1=right) that
+          given pixel of a numPixels frame belongs to, and turns
+          pixel and numPixels into that eye's own sub-image */
+      inline __both__ int stereoEye(vec2i &pixel, vec2i &numPixels) const;
+      /*! for stereo cameras: the plain perspective camera of given
+          eye (0=left, 1=right) */
+      inline __both__ DD eye(int which) const;
+      /*! for all camera types: origin and direction of the ray
+          through given point of a numPixels frame, in [0,1]^2 of
+          that frame, from the lens center (ie, without depth of
+          field); what bnPick() traces. False for undefined cameras */
+      inline __both__ bool centerRay(vec2f screen, vec2i numPixels,
+                                     vec3f &org, vec3f &dir) const;
       
       Type  type = UNDEFINED;
 
@@ -46,6 +79,11 @@ namespace BARNEY_NS {
           float apertureRadius;
           /* distance to focal plane, for DOF */
           float focusDistance;
+          /*! STEREO only: distance between the two eyes' lens
+              centers, along dir_du */
+          float eyeSeparation;
+          /*! STEREO only: a StereoLayout */
+          int   stereoLayout;
         } perspective;
         struct {
           vec3f org_00;
@@ -69,6 +107,117 @@ namespace BARNEY_NS {
     
     DD getDD() { return dd; }
   };
+
+  inline __both__
+  vec3f Camera::DD::centerRayDir(vec2i pixel, vec2i numPixels) const
+  {
+    float image_u = (pixel.x+.5f)/float(numPixels.x);
+    float image_v = (pixel.y+.5f)/float(numPixels.y);
+    float aspect  = numPixels.x / float(numPixels.y);
+    return normalize(perspective.dir_00
+                     + (aspect*(image_u - .5f)) * perspective.dir_du
+                     + (image_v - .5f) * perspective.dir_dv);
+  }
+
+  inline __both__
+  bool Camera::DD::project(vec3f P, vec2i numPixels, vec2i &pixel) const
+  {
+    /* dir = dir_00 + aspect*(u-.5)*dir_du + (v-.5)*dir_dv, with
+       dir_du and dir_dv orthogonal to dir_00 */
+    vec3f D = P-perspective.lens_00;
+    float z = dot(D,perspective.dir_00);
+    if (z <= 0.f) return false;
+    vec3f onPlane
+      = D * (dot(perspective.dir_00,perspective.dir_00)/z)
+      - perspective.dir_00;
+    float aspect = numPixels.x / float(numPixels.y);
+    float image_u
+      = dot(onPlane,perspective.dir_du)
+      / (aspect*dot(perspective.dir_du,perspective.dir_du)) + .5f;
+    float image_v
+      = dot(onPlane,perspective.dir_dv)
+      / dot(perspective.dir_dv,perspective.dir_dv) + .5f;
+    pixel = vec2i(int(floorf(image_u*numPixels.x)),
+                  int(floorf(image_v*numPixels.y)));
+    return
+      pixel.x >= 0 && pixel.x < numPixels.x &&
+      pixel.y >= 0 && pixel.y < numPixels.y;
+  }
+
+  inline __both__
+  int Camera::DD::stereoEye(vec2i &pixel, vec2i &numPixels) const
+  {
+    int which;
+    if (perspective.stereoLayout == TOP_BOTTOM) {
+      numPixels.y = max(1,numPixels.y/2);
+      which = min(pixel.y/numPixels.y,1);
+      pixel.y -= which*numPixels.y;
+    } else {
+      numPixels.x = max(1,numPixels.x/2);
+      which = min(pixel.x/numPixels.x,1);
+      pixel.x -= which*numPixels.x;
+    }
+    return which;
+  }
+
+  inline __both__
+  Camera::DD Camera::DD::eye(int which) const
+  {
+    DD dd = *this;
+    dd.type = PERSPECTIVE;
+    dd.perspective.lens_00
+      += ((which ? .5f : -.5f)*perspective.eyeSeparation)
+      *  normalize(perspective.dir_du);
+    return dd;
+  }
     
-}
+  inline __both__
+  bool Camera::DD::centerRay(vec2f screen, vec2i numPixels,
+                             vec3f &org, vec3f &dir) const
+  {
+    DD camera = *this;
+    if (type == STEREO) {
+      /* same split as stereoEye(), just for a point on the frame
+         rather than a pixel */
+      const bool topBottom = perspective.stereoLayout == TOP_BOTTOM;
+      float &coord = topBottom ? screen.y : screen.x;
+      int   &size  = topBottom ? numPixels.y : numPixels.x;
+      const int which = coord >= .5f;
+      coord = 2.f*coord - which;
+      size  = max(1,size/2);
+      camera = eye(which);
+    }
+    const float aspect = numPixels.x / float(max(1,numPixels.y));
+    if (camera.type == PERSPECTIVE) {
+      const auto &perspective = camera.perspective;
+      org = perspective.lens_00;
+      dir = normalize(perspective.dir_00
+                      + (aspect*(screen.x - .5f)) * perspective.dir_du
+                      + (screen.y - .5f) * perspective.dir_dv);
+      return true;
+    }
+    if (camera.type == ORTHOGRAPHIC) {
+      const auto &orthographic = camera.orthographic;
+      dir = normalize(orthographic.dir);
+      org
+        = orthographic.org_00
+        + ((screen.x-.5f)*orthographic.aspect*orthographic.height)
+        * orthographic.org_du
+        + ((screen.y-.5f)*orthographic.height)
+        * orthographic.org_dv;
+      return true;
+    }
+    if (camera.type == OMNIDIRECTIONAL) {
+      const float phi   = TWO_PI * screen.x;
+      const float theta = ONE_PI * screen.y;
+      org = camera.omni.toWorld.p;
+      dir = xfmVector(camera.omni.toWorld,
+                      vec3f(cosf(phi)*sinf(theta),
+                            sinf(phi)*sinf(theta),
+                            cosf(theta)));
+      return true;
+    }
+    return false;
+  }
 
+}
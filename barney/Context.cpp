@@ -5,6 +5,7 @@
 #include "barney/Context.h"
 #include "barney/DeviceGroup.h"
 #include "barney/fb/FrameBuffer.h"
+#include "barney/fb/FrameProfiler.h"
 #include "barney/GlobalModel.h"
 #include "barney/render/RayQueue.h"
 #include "barney/render/Sampler.h"
@@ -12,6 +13,14 @@
 #include "barney/render/MaterialRegistry.h"
 #include "barney/Camera.h"
 #include "barney/render/Renderer.h"
+#include "barney/volume/StructuredData.h"
+#include "barney/volume/Volume.h"
+#include "barney/geometry/Geometry.h"
+#include "barney/common/AccelCache.h"
+#include "barney/api/DirectFile.h"
+#include "barney/api/MappedFile.h"
+#include <mutex>
+#include <thread>
 
 namespace BARNEY_NS {
   Context::Context(const std::vector<LocalSlot> &localSlots,
@@ -42,31 +51,62 @@ namespace BARNEY_NS {
     havePeerAccess = true;
 #if 1
     std::vector<int> allGPUs;
+    for (int lmsIdx=0;lmsIdx<numSlots;lmsIdx++)
+      for (auto g : localSlots[lmsIdx].gpuIDs) allGPUs.push_back(g);
+
+    /* creating a device (cuda and owl/optix context, streams, trace
+       kernels) mostly waits on the driver, so with many gpus per
+       node do all of them concurrently, each on a thread of its
+       own. Peer access gets enabled alongside; neither depends on
+       the other */
+    allLocalDevices.resize(allGPUs.size());
+    auto createDevice = [&](int localRank) {
+      rtc::Device *rtc = new rtc::Device(allGPUs[localRank]);
+      allLocalDevices[localRank] = new Device(rtc,topo.get(),localRank);
+    };
+    if (allGPUs.size() <= 1 || FromEnv::enabled("serialDeviceInit")) {
+      for (int i=0;i<(int)allGPUs.size();i++)
+        createDevice(i);
+      havePeerAccess = rtc::enablePeerAccess(allGPUs);
+    } else {
+      std::mutex mutex;
+      std::exception_ptr firstError;
+      auto guarded = [&](const std::function<void()> &fct) {
+        try {
+          fct();
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!firstError) firstError = std::current_exception();
+        }
+      };
+      std::vector<std::thread> threads;
+      for (int i=0;i<(int)allGPUs.size();i++)
+        threads.emplace_back([&,i]() { guarded([&]() { createDevice(i); }); });
+      guarded([&]() { havePeerAccess = rtc::enablePeerAccess(allGPUs); });
+      for (auto &thread : threads)
+        thread.join();
+      if (firstError) {
+        for (auto device : allLocalDevices)
+          delete device;
+        std::rethrow_exception(firstError);
+      }
+    }
+
+    int nextLocal = 0;
     for (int lmsIdx=0;lmsIdx<numSlots;lmsIdx++) {
       auto &ls = localSlots[lmsIdx];
       auto &dg = perSlot[lmsIdx];
       dg.context = this;
       dg.modelRankInThisSlot = ls.dataRank;
-      for (auto g : ls.gpuIDs) allGPUs.push_back(g);
-      // havePeerAccess
-      //   = havePeerAccess & rtc::enablePeerAccess(ls.gpuIDs);
 
       std::vector<Device *> slotDevices;
       for (auto gpuID : ls.gpuIDs) {
-        rtc::Device *rtc = new rtc::Device(gpuID);
-        int numDevs = (int)allLocalDevices.size();
-        Device *device 
-          = new Device(rtc,topo.get(),numDevs);
-          
-        slotDevices.push_back(device);
-        allLocalDevices.push_back(device);
+        slotDevices.push_back(allLocalDevices[nextLocal++]);
         dg.gpuIDs.push_back(gpuID);
       }
       dg.devices
-        = std::make_shared<DevGroup>(slotDevices,(int)allLocalDevices.size());
+        = std::make_shared<DevGroup>(slotDevices,nextLocal);
     }
-    havePeerAccess
-      = havePeerAccess & rtc::enablePeerAccess(allGPUs);
 #else
     for (int lmsIdx=0;lmsIdx<numSlots;lmsIdx++) {
       auto &ls = localSlots[lmsIdx];
@@ -93,6 +133,22 @@ namespace BARNEY_NS {
 #endif
     devices = std::make_shared<DevGroup>
       (allLocalDevices,(int)allLocalDevices.size());
+
+    if (FromEnv::get()->measureGpuWeights)
+      measureDeviceWeights();
+    
+    /* a single slot whose devices all ended up in the same island
+       (see LocalContext::makeTopo()) gets split across those */
+    if (numSlots == 1 && perSlot[0].devices->size() > 1) {
+      DevGroup &slotDevices = *perSlot[0].devices;
+      const int island = topo->islandOf[slotDevices[0]->globalRank()];
+      bool oneIsland = true;
+      for (auto device : slotDevices)
+        oneIsland &= (topo->islandOf[device->globalRank()] == island);
+      if (oneIsland)
+        for (int i=0;i<(int)slotDevices.size();i++)
+          slotDevices[i]->partition = { i,(int)slotDevices.size() };
+    }
     if (!havePeerAccess) {
       std::cout << "don't have peer access between GPUs ... this is going to get interesting" << std::endl;
       deviceWeNeedToCopyToForFBMap = allLocalDevices[0];
@@ -109,6 +165,7 @@ namespace BARNEY_NS {
   Context::~Context()
   {
     hostOwnedHandles.clear();
+    multiViewFB.reset();
 
     delete globalTraceImpl;
     globalTraceImpl = 0;
@@ -134,11 +191,37 @@ namespace BARNEY_NS {
   }
   
   
+  int Context::maxRaysActiveLocally()
+  {
+    int maxActive = 0;
+    for (auto device : *devices)
+      maxActive = std::max(maxActive,device->rayQueue->numActiveRays());
+    return maxActive;
+  }
+  
+  void Context::servicePageRequests()
+  {
+    for (auto field : pagedFields)
+      field->servicePageRequests();
+    for (auto texture : streamedTextures)
+      texture->servicePageRequests();
+  }
+
   void Context::finalizeTiles(FrameBuffer *fb)
   {
+    FrameProfiler::Scope profile(fb->profiler,FrameProfiler::FINALIZE_TILES);
     fb->finalizeTiles();
   }
 
+  static bool hasVolumes(GlobalModel *model)
+  {
+    for (auto slot : model->modelSlots)
+      for (auto group : slot->instances.groups)
+        if (group && !group->volumes.empty())
+          return true;
+    return false;
+  }
+
   void Context::renderTiles(Renderer    *renderer,
                             GlobalModel *model,
                             Camera      *camera,
@@ -147,43 +230,446 @@ namespace BARNEY_NS {
     auto _context = this;
     if (!isActiveWorker)
       return;
+    NvtxRange nvtx("renderTiles");
 
-    for (auto device : *devices)
-      device->syncPipelineAndSBT();
+    // compiling programs and pipelines is all host work, and each
+    // device's is independent of the others'
+    devices->forEachDeviceInParallel([](Device *device)
+    { device->syncPipelineAndSBT(); });
+
+    globalTraceImpl->beginFrame(model);
 
     activeCutPlane = renderer->cutPlane;
+    for (auto slot : model->modelSlots)
+      slot->setCutPlane(activeCutPlane);
+#if BARNEY_USE_MULTI_SCATTERING
+    for (auto slot : model->modelSlots)
+      slot->world->volumeGuiding.beginFrame(slot.get(),renderer->volumeGuiding);
+#endif
+    /* the perspective camera's dir_dv spans the whole image height
+       (of one eye, for stereo), at distance |dir_00| */
+    const bool stereo = camera->dd.type == Camera::STEREO;
+    activePixelAngle
+      = (camera->dd.type == Camera::PERSPECTIVE || stereo)
+      ? length(camera->dd.perspective.dir_dv)
+      / (length(camera->dd.perspective.dir_00)
+         *max(1,(fb->views.height ? fb->views.height : fb->renderPixels.y)
+              / ((stereo && camera->dd.perspective.stereoLayout
+                  == Camera::TOP_BOTTOM) ? 2 : 1)))
+      : 0.f;
+    activeProfiler = fb->profiler;
+    if (activeProfiler)
+      activeProfiler->beginFrame();
+    for (auto device : *devices)
+      device->resetCounters();
+    activeSortLast = fb->sortLast;
+    fb->renderingLayers = fb->sortLast;
+    /* volume hits are stochastic, and with several slots (or
+       layers) a camera ray's hit depends on more than its pixel */
+    activePrimaryHitCache
+      = fb->primaryHitCache > 0
+      && !activeSortLast
+      && model->modelSlots.size() == 1
+      && !hasVolumes(model);
+    if (fb->accumID == 0)
+      for (auto device : *devices)
+        fb->getFor(device)->resetPrimaryHitCache();
+    /* tile costs are per frame */
+    if (fb->balanceTiles)
+      for (auto device : *devices)
+        fb->getFor(device)->resetTileCosts();
+    if (fb->activeChannels & BN_FB_COST)
+      for (auto device : *devices)
+        fb->getFor(device)->resetPixelCosts();
+
+    /* with a target frame time, keep adding waves of samples for as
+       long as the next one - assumed to take as long as the last -
+       still fits into the budget. Ranks time differently, so go by
+       the slowest one's times, so all agree on when to stop */
+    const bool   restartedAccumulation = (fb->accumID == 0);
+    const float  budget     = renderer->targetFrameTime;
+    const double frameBegin = getCurrentTime();
+    if (restartedAccumulation)
+      fb->allTilesConverged = false;
+    for (int wave=0;true;wave++) {
+      const double waveBegin = getCurrentTime();
+      /* don't overshoot the frame buffer's sample limit */
+      int numSamples = renderer->pathsPerPixel;
+      if (fb->maxAccumulation > 0)
+        numSamples = std::max(1,std::min(numSamples,
+                                         fb->maxAccumulation-(int)fb->accumID));
+      renderSamples(renderer,model,camera,fb,numSamples);
+      const double now = getCurrentTime();
+      if (wave == 0)
+        /* what the next frame's render scale gets picked by */
+        fb->lastWaveTime = float(1000.*(now-waveBegin));
+      if (budget <= 0.f || fb->isConverged())
+        break;
+      float expected
+        = maxTimeGlobally(float(1000.*((now-frameBegin)+(now-waveBegin))));
+      if (expected > budget)
+        break;
+    }
 
-    // iw - todo: add wave-front-merging here.
-    for (int p=0;p<renderer->pathsPerPixel;p++) {
+    if (activeSortLast) {
+      fb->renderingLayers = false;
+      activeSortLast = false;
+      fb->compositeLayers(model,camera,renderer);
+    }
+    else if (fb->temporalReprojection)
+      for (auto device : *devices)
+        fb->getFor(device)->reprojectHistory(camera->dd,
+                                             restartedAccumulation,
+                                             fb->accumID,
+                                             fb->getAccumScale(),
+                                             fb->maxHistoryLength);
+    activeProfiler = nullptr;
+    activePrimaryHitCache = false;
+  }
 
-      if (FromEnv::get()->logQueues) 
-        std::cout << "#################### RENDER ######################" << std::endl;
-      if (FromEnv::get()->logQueues) 
-        std::cout << "==================== new pixel wave ======================" << std::endl;
-      generateRays(camera,renderer,fb);
-      for (int generation=0;true;generation++) {
-        if (FromEnv::get()->logQueues) 
-          std::cout << "-------------------- new generation " << generation << " ----------------------" << std::endl;
-
-        bool needHitIDs = fb->needHitIDs() && (generation==0);
-        uint32_t rngSeed = fb->accumID*16+generation;
-        traceRaysGlobally(model,rngSeed,needHitIDs);
+  void Context::renderSamples(Renderer    *renderer,
+                              GlobalModel *model,
+                              Camera      *camera,
+                              FrameBuffer *fb,
+                              int          numSamples)
+  {
+
+    // ------------------------------------------------------------------
+    /* wave-front merging: rather than running each of the
+       pathsPerPixel samples as its own generate-trace-shade loop
+       (which leaves us with long tails of almost empty ray queues),
+       we walk a 'virtual tile' cursor over all samples' tiles, and
+       after each bounce re-fill the ray queues with as many new
+       camera rays as they can take. Each camera ray can produce at
+       most two rays (bounce and shadow ray) per shade, so a queue is
+       safe if twice its active plus newly generated rays fit. All
+       values this decision is based on are the same on all devices
+       and ranks, so everybody agrees on when the frame is done. */
+    // ------------------------------------------------------------------
+    const int maxTiles     = maxTilesOnAnyGPU(fb);
+    const int numVirtual   = numSamples * maxTiles;
+    const int queueRoom    = rayQueueCapacity(fb);
+    int       nextVirtual  = 0;
+
+    /* if rays never leave the device that generated them we don't
+       have to know exact ray counts on the host after every bounce;
+       in that case only read them back every rayCountInterval'th
+       generation, and let the kernels use the device-side counts in
+       between */
+    const int rayCountInterval
+      = (perSlot.size() == 1 && mySize() == 1 && !topo->isDataParallel())
+      ? FromEnv::get()->rayCountInterval
+      : 1;
+    bool countsAreExact = true;
+
+    /* same for finishing the last few paths of a frame in one go;
+       with replicated data each rank can do that on its own, the
+       decision to do so is still based on global counts */
+    const int tailThreshold
+      = (perSlot.size() == 1 && !topo->isDataParallel())
+      ? FromEnv::get()->tailThreshold
+      : 0;
+    int lastWaveGeneration = 0;
 
-        shadeRaysLocally(renderer, model, fb, generation, rngSeed);
+    /* across ranks, don't wait for the global ray count after
+       shading: post its reduction, trace the next generation
+       speculatively (ranks that are out of rays just take part in
+       forwarding), and complete the reduction only once that trace
+       is done. If the count turns out to have been zero (and no new
+       camera rays went in since), that trace was empty everywhere
+       and we're done. Not with tail finishing, which needs the
+       count right away */
+    const bool overlapRayCounts
+      = mySize() > 1 && tailThreshold == 0
+      && !FromEnv::enabled("noOverlapRayCounts");
+    bool rayCountPending   = false;
+    int  virtualAtRayCount = 0;
 
-        const int numActiveGlobally = numRaysActiveGlobally();
+    /* adaptive sampling: tiles' error estimates only make sense
+       for what got accumulated since the last reset */
+    const bool adaptive = renderer->adaptiveThreshold > 0.f;
+    if (adaptive && fb->accumID == 0)
+      for (auto device : *devices)
+        fb->getFor(device)->resetConvergence();
+    /* foveated tiles got scaled up for the last frame's accumID;
+       they'll accumulate into plain sums until this frame is done */
+    for (auto device : *devices) {
+      fb->getFor(device)->scaleSparseTiles(fb->accumID,/*toSums*/true);
+      fb->getFor(device)->beginAccumulation(fb->accumID,
+                                            fb->accumID+numSamples,
+                                            adaptive);
+    }
+    
+    if (FromEnv::get()->logQueues) 
+      std::cout << "#################### RENDER ######################" << std::endl;
+    for (int generation=0;true;generation++) {
+      activeGeneration = generation;
+      if (nextVirtual < numVirtual && countsAreExact) {
+        int maxActive
+          = (generation == 0)
+          ? 0
+          : maxRaysActiveGlobally();
+        int numNew
+          = std::min(numVirtual-nextVirtual,
+                     (queueRoom/2-maxActive)/pixelsPerTile);
+        if (generation == 0)
+          /* the first sample of the first frame plain-writes the
+             accum buffer, so no other sample may get shaded in the
+             same pass */
+          numNew = std::min(numNew,maxTiles);
+        if (numNew > 0) {
+          if (FromEnv::get()->logQueues) 
+            std::cout << "==================== new pixel wave ("
+                      << nextVirtual << ".." << (nextVirtual+numNew)
+                      << " of " << numVirtual << ") ======================"
+                      << std::endl;
+          FrameProfiler::Scope profile(activeProfiler,
+                                       FrameProfiler::GENERATE_RAYS);
+          generateRays(camera,renderer,fb,
+                       nextVirtual,nextVirtual+numNew,
+                       /* append: */generation > 0);
+          nextVirtual += numNew;
+          lastWaveGeneration = generation;
+        }
+      }
+      if (FromEnv::get()->logQueues) 
+        std::cout << "-------------------- new generation " << generation << " ----------------------" << std::endl;
+      
+      bool needHitIDs = fb->needHitIDs() && (generation==0);
+      uint32_t rngSeed = fb->accumID*16+generation;
+      bool wereExact = countsAreExact;
+      countsAreExact = ((generation+1) % rayCountInterval) == 0;
+      if (!wereExact && !countsAreExact && nextVirtual == numVirtual
+          && replayBounceGraph(renderer,model,fb,generation,rngSeed))
+        // no new rays, and no counts to read back: this bounce is
+        // exactly the same as the previous one, so just replay it
+        continue;
+      
+      /* primary rays are already coherent (they're generated tile by
+         tile), so only sort secondaries for tracing */
+      {
+        FrameProfiler::Scope profile(activeProfiler,
+                                     FrameProfiler::FORWARD,generation);
+        if ((renderer->sortRays & RayQueue::SORT_FOR_TRACE) && generation > 0)
+          sortRaysLocally(RayQueue::SORT_FOR_TRACE,false);
+        traceRaysGlobally(model,rngSeed,needHitIDs);
+      }
+      if (rayCountPending) {
+        rayCountPending = false;
+        const int numActiveBefore = finishRaysActiveGlobally();
+        if (activeProfiler)
+          activeProfiler->setNumRays(generation-1,numActiveBefore);
         if (FromEnv::get()->logQueues)
           printf("#generation %i num active %s after bounce\n",
-                 generation,prettyNumber(numActiveGlobally).c_str());
-        if (numActiveGlobally > 0)
-          continue;
-    
-        break;
+                 generation-1,prettyNumber(numActiveBefore).c_str());
+        if (numActiveBefore == 0 && virtualAtRayCount == numVirtual)
+          break;
+      }
+      {
+        FrameProfiler::Scope profile(activeProfiler,
+                                     FrameProfiler::SHADE,generation);
+        if (renderer->sortRays & RayQueue::SORT_FOR_SHADE)
+          sortRaysLocally(RayQueue::SORT_FOR_SHADE,needHitIDs);
+        shadeRaysLocally(renderer, model, fb, generation, rngSeed,
+                         countsAreExact);
       }
-      ++ fb->accumID;
+      if (!countsAreExact)
+        // can't tell if we're done, so assume we're not
+        continue;
+
+      if (overlapRayCounts) {
+        startRaysActiveGlobally();
+        rayCountPending   = true;
+        virtualAtRayCount = nextVirtual;
+        continue;
+      }
+      
+      const int numActiveGlobally = numRaysActiveGlobally();
+      if (activeProfiler)
+        activeProfiler->setNumRays(generation,numActiveGlobally);
+      if (FromEnv::get()->logQueues)
+        printf("#generation %i num active %s after bounce\n",
+               generation,prettyNumber(numActiveGlobally).c_str());
+      if (numActiveGlobally > 0 && numActiveGlobally <= tailThreshold
+          && nextVirtual == numVirtual) {
+        /* paths of the last wave get shaded at most MAX_PATH_DEPTH
+           times, plus once more for their last shadow ray */
+        int numLeft
+          = lastWaveGeneration+render::MAX_PATH_DEPTH+2 - (generation+1);
+        if (numLeft > 0) {
+          generation
+            = finishPathsLocally(renderer,model,fb,generation+1,numLeft)-1;
+          if (numRaysActiveGlobally() > 0)
+            // shouldn't happen, but if it does the regular loop
+            // can take over again
+            continue;
+          break;
+        }
+      }
+      if (numActiveGlobally > 0 || nextVirtual < numVirtual)
+        continue;
+      
+      break;
+    }
+    for (auto device : *devices)
+      fb->getFor(device)->scaleSparseTiles(fb->accumID+numSamples,
+                                           /*toSums*/false);
+    if (adaptive)
+      for (auto device : *devices)
+        fb->getFor(device)->updateConvergence(fb->accumID,
+                                              fb->accumID+numSamples,
+                                              renderer->adaptiveThreshold,
+                                              renderer->adaptiveMinSamples);
+    if (adaptive && fb->stopWhenConverged) {
+      int anyNotConverged = 0;
+      for (auto device : *devices) {
+        TiledFB *devFB = fb->getFor(device);
+        if (devFB->readNumConvergedTiles() < devFB->numActiveTilesThisGPU)
+          anyNotConverged = 1;
+      }
+      fb->allTilesConverged = (maxGlobally(anyNotConverged) == 0);
     }
+    if (renderer->restirDI)
+      for (auto device : *devices)
+        fb->getFor(device)->swapReservoirs(camera->dd);
+    fb->accumID += numSamples;
   }
 
+
+  int Context::finishPathsLocally(Renderer *renderer,
+                                  GlobalModel *model,
+                                  FrameBuffer *fb,
+                                  int generation,
+                                  int numGenerations)
+  {
+    /* with no new camera rays coming in, every path has at most one
+       ray that can spawn new rays, and that one spawns at most a
+       bounce and a shadow ray; so no matter how many bounces we do,
+       no queue ever holds more than twice the rays it has now. That
+       is what we size all launches for, kernels read the actual
+       counts from the device */
+    std::vector<int> maxActive(devices->size());
+    for (auto device : *devices) {
+      RayQueue *rayQueue = device->rayQueue;
+      maxActive[device->contextRank()]
+        = std::min(rayQueue->size,2*rayQueue->numActive);
+    }
+    if (FromEnv::get()->logQueues)
+      printf("#bn(%i): finishing paths in %i generations w/o syncs\n",
+             myRank(),numGenerations);
+    for (int i=0;i<numGenerations;i++,generation++) {
+      const bool last = (i == numGenerations-1);
+      uint32_t rngSeed = fb->accumID*16+generation;
+      activeGeneration = generation;
+      traceRaysLocally(model,rngSeed,/*needHitIDs*/false,
+                       /*syncWhenDone*/false);
+      {
+        FrameProfiler::Scope profile(activeProfiler,
+                                     FrameProfiler::SHADE,generation);
+        shadeRaysLocally(renderer,model,fb,generation,rngSeed,
+                         /*readBackNumActive*/last);
+      }
+      if (last) break;
+      for (auto device : *devices)
+        device->rayQueue->numActive = maxActive[device->contextRank()];
+    }
+    return generation+1;
+  }
+
+  bool Context::replayBounceGraph(Renderer *renderer,
+                                  GlobalModel *model,
+                                  FrameBuffer *fb,
+                                  int generation,
+                                  uint32_t rngSeed)
+  {
+    /* a captured bounce has all its launch sizes baked in, so we
+       can only use it once the queue's (upper bound on) active rays
+       is saturated, and kernels read the actual count from the
+       device. We also have to know that no other device (or rank)
+       takes any part in this bounce, and we can't switch between
+       devices while capturing. */
+    if (!FromEnv::enabled("bounceGraphs")) return false;
+#if BARNEY_USE_MULTI_SCATTERING
+    /* the volume guiding grid can get re-allocated between frames,
+       and captured launches would keep the old one's pointers */
+    if (renderer->volumeGuiding > 0.f) return false;
+#endif
+    if (devices->size() != 1 || perSlot.size() != 1 || mySize() != 1)
+      return false;
+    Device   *device   = (*devices)[0];
+    RayQueue *rayQueue = device->rayQueue;
+    if (!device->rtc->canCaptureGraphs()
+        || rayQueue->numActiveIsExact
+        || rayQueue->numActive != rayQueue->size)
+      return false;
+
+    SetActiveGPU forDuration(device);
+    FrameBuffer::BounceGraph *bg = nullptr;
+    for (auto &it : fb->getPLD(device)->bounceGraphs)
+      if (it.graph
+          && it.readRays  == rayQueue->traceAndShadeReadQueue.rays
+          && it.queueSize == rayQueue->size)
+        bg = &it;
+
+    if (!bg) {
+      for (auto &it : fb->getPLD(device)->bounceGraphs)
+        if (!it.graph) { bg = &it; break; }
+      if (!bg) {
+        // queues got re-allocated since we captured those
+        fb->freeBounceGraphs();
+        bg = &fb->getPLD(device)->bounceGraphs[0];
+      }
+      if (FromEnv::get()->logQueues)
+        printf("#bn(%i): ## capturing bounce graph\n",
+               device->globalRank());
+      
+      // no allocations allowed while capturing
+      if (renderer->sortRays) rayQueue->getSortBuckets();
+      allocShadeParams(device);
+      
+      SingleQueue readBefore  = rayQueue->traceAndShadeReadQueue;
+      SingleQueue writeBefore = rayQueue->receiveAndShadeWriteQueue;
+      // events can't be timed from within a graph
+      FrameProfiler *profiler = activeProfiler;
+      activeProfiler = nullptr;
+      device->rtc->beginCapture();
+      if (renderer->sortRays & RayQueue::SORT_FOR_TRACE)
+        sortRaysLocally(RayQueue::SORT_FOR_TRACE,false);
+      traceRaysLocally(model,rngSeed,false,/*syncWhenDone*/false);
+      if (renderer->sortRays & RayQueue::SORT_FOR_SHADE)
+        sortRaysLocally(RayQueue::SORT_FOR_SHADE,false);
+      shadeRaysLocally(renderer,model,fb,generation,rngSeed,false);
+      bg->graph = device->rtc->endCapture();
+      activeProfiler = profiler;
+
+      if (!bg->graph) {
+        // couldn't capture; undo the host-side swaps, and have the
+        // caller do this bounce the regular way
+        rayQueue->traceAndShadeReadQueue    = readBefore;
+        rayQueue->receiveAndShadeWriteQueue = writeBefore;
+        *bg = FrameBuffer::BounceGraph();
+        return false;
+      }
+      bg->readRays   = readBefore.rays;
+      bg->queueSize  = rayQueue->size;
+      bg->readAfter  = rayQueue->traceAndShadeReadQueue;
+      bg->writeAfter = rayQueue->receiveAndShadeWriteQueue;
+    }
+
+    if (FromEnv::get()->logQueues)
+      printf("#bn(%i): ## replaying bounce graph\n",
+             device->globalRank());
+    {
+      /* trace and shade can't be told apart in a graph, so all of it
+         counts as tracing */
+      FrameProfiler::Scope profile(activeProfiler,
+                                   FrameProfiler::TRACE,generation);
+      device->rtc->launchGraph(bg->graph);
+    }
+    rayQueue->traceAndShadeReadQueue    = bg->readAfter;
+    rayQueue->receiveAndShadeWriteQueue = bg->writeAfter;
+    return true;
+  }
     
   /*! trace all rays currently in a ray queue, including forwarding
     if and where applicable, untile every ray in the ray queue as
@@ -193,39 +679,321 @@ namespace BARNEY_NS {
     // if (myRank() == 0) printf("globaltrace....\n");
     if (FromEnv::get()->logQueues) 
       printf("(mr%i) traceRaysGlobally\n",myRank());
+    if (activeSortLast) {
+      /* each device only renders its own data into its layer */
+      traceRaysLocally(model,rngSeed,needHitIDs);
+      return;
+    }
     globalTraceImpl->traceRays(model,rngSeed,needHitIDs);
   }
 
+  void Context::traceQueryRays(GlobalModel *model,
+                               Ray *rays,
+                               HitIDs *hitIDs,
+                               int numRays)
+  {
+    if (!isActiveWorker)
+      return;
+    NvtxRange nvtx("traceQueryRays");
+    devices->forEachDeviceInParallel([](Device *device)
+    { device->syncPipelineAndSBT(); });
+    globalTraceImpl->beginFrame(model);
+    activeGeneration = 0;
+
+    /* every device gets (up to) the same number of rays per round,
+       everywhere: forwarding may have any device's queue receive
+       any other's rays */
+    const int numLocal = (int)devices->size();
+    const int perDevice
+      = maxGlobally(std::min((int)maxQueryRaysPerDevice,
+                             divRoundUp(numRays,numLocal)));
+    if (perDevice == 0)
+      return;
+    for (auto device : *devices) {
+      device->rayQueue->resize(perDevice);
+      device->rayQueue->enableHitIDs();
+    }
+
+    for (int round=0;true;round++) {
+      const int roundBegin = round*numLocal*perDevice;
+      auto rangeOf = [&](int localIdx, int &begin)
+      {
+        begin = roundBegin + localIdx*perDevice;
+        return std::max(0,std::min(perDevice,numRays-begin));
+      };
+      for (int localIdx=0;localIdx<numLocal;localIdx++) {
+        Device *device = (*devices)[localIdx];
+        RayQueue *rayQueue = device->rayQueue;
+        int begin;
+        int count = rangeOf(localIdx,begin);
+        rayQueue->numActive = count;
+        rayQueue->numActiveIsExact = true;
+        if (count == 0) continue;
+        SetActiveGPU forDuration(device);
+        SingleQueue &queue = rayQueue->traceAndShadeReadQueue;
+        device->rtc->copyAsync(queue.rays,rays+begin,count*sizeof(Ray));
+        device->rtc->copyAsync(queue.hitIDs,hitIDs+begin,
+                               count*sizeof(HitIDs));
+      }
+      /* all ranks keep going until the last one's out of rays */
+      if (numRaysActiveGlobally() == 0)
+        break;
+
+      traceRaysGlobally(model,/*rngSeed*/round,/*needHitIDs*/true);
+
+      for (int localIdx=0;localIdx<numLocal;localIdx++) {
+        Device *device = (*devices)[localIdx];
+        int begin;
+        int count = rangeOf(localIdx,begin);
+        if (count == 0) continue;
+        SetActiveGPU forDuration(device);
+        SingleQueue &queue = device->rayQueue->traceAndShadeReadQueue;
+        device->rtc->copyAsync(rays+begin,queue.rays,count*sizeof(Ray));
+        device->rtc->copyAsync(hitIDs+begin,queue.hitIDs,
+                               count*sizeof(HitIDs));
+      }
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        device->rtc->sync();
+      }
+    }
+    /* these rays are done; the next frame starts with empty queues */
+    for (auto device : *devices)
+      device->rayQueue->numActive = 0;
+  }
+
+  /*! a query ray that's ready for tracing, ie, with nothing hit yet */
+  static Ray makeQueryRay(vec3f org, vec3f dir, float tMax, int rayIdx)
+  {
+    Ray ray = {};
+    ray.org      = org;
+    ray.dir      = dir;
+    ray.tMax     = tMax;
+    ray.bsdfType = render::PackedBSDF::NONE;
+    ray.rngSeed.seed(rayIdx,0);
+    return ray;
+  }
+
+  bool Context::pickLocally(GlobalModel *model,
+                            Camera *camera,
+                            vec2i numPixels,
+                            const vec2f *screenPos,
+                            int numPicks,
+                            BNPickResult *results,
+                            bool generateHere)
+  {
+    if (!isActiveWorker)
+      return false;
+    std::vector<Ray>    rays(generateHere ? numPicks : 0);
+    std::vector<HitIDs> hitIDs(rays.size());
+    const Camera::DD cameraDD = camera->getDD();
+    for (int i=0;i<(int)rays.size();i++) {
+      vec3f org, dir;
+      if (!cameraDD.centerRay(screenPos[i],numPixels,org,dir)) {
+        /* nothing to trace, but it still has to take part */
+        org = vec3f(0.f);
+        dir = vec3f(0.f,0.f,1.f);
+      }
+      rays[i] = makeQueryRay(org,dir,1e30f,i);
+    }
+
+    traceQueryRays(model,rays.data(),hitIDs.data(),(int)rays.size());
+
+    for (int i=0;i<(int)rays.size();i++) {
+      const Ray &ray = rays[i];
+      BNPickResult &result = results[i];
+      result = {};
+      result.hit = ray.bsdfType != render::PackedBSDF::NONE;
+      if (result.hit) {
+        const vec3f N = (vec3f)ray.N;
+        result.t        = ray.tMax;
+        result.position = (const bn_float3&)ray.P;
+        result.normal   = (const bn_float3&)N;
+      }
+      result.primID = hitIDs[i].primID;
+      result.objID  = hitIDs[i].objID;
+      result.instID = hitIDs[i].instID;
+    }
+    return generateHere;
+  }
+
+  void Context::queryRays(GlobalModel *model,
+                          const BNRay *queries,
+                          int numRays,
+                          BNRayHit *hits)
+  {
+    /* trace with normalized directions, from where the query's
+       range starts; but report distances in the query's own
+       units */
+    std::vector<Ray>    rays(isActiveWorker ? numRays : 0);
+    std::vector<HitIDs> hitIDs(rays.size());
+    std::vector<float>  dirLength(rays.size());
+    for (int i=0;i<(int)rays.size();i++) {
+      const BNRay &query = queries[i];
+      const vec3f org = (const vec3f&)query.org;
+      const vec3f dir = (const vec3f&)query.dir;
+      const float len = length(dir);
+      const bool  valid = len > 0.f && query.tMax > query.tMin;
+      dirLength[i] = valid ? len : 1.f;
+      rays[i]
+        = valid
+        ? makeQueryRay(org+query.tMin*dir,dir*(1.f/len),
+                       (query.tMax-query.tMin)*len,i)
+        /* never hits anything, but still takes part */
+        : makeQueryRay(org,vec3f(0.f,0.f,1.f),0.f,i);
+    }
+
+    traceQueryRays(model,rays.data(),hitIDs.data(),(int)rays.size());
+
+    for (int i=0;i<numRays;i++) {
+      BNRayHit &hit = hits[i];
+      hit = {};
+      hit.t      = -1.f;
+      hit.primID = hit.objID = hit.instID = -1;
+      if (i >= (int)rays.size()) continue;
+      const Ray &ray = rays[i];
+      if (ray.bsdfType != render::PackedBSDF::NONE) {
+        const vec3f N = (vec3f)ray.N;
+        hit.t      = queries[i].tMin + ray.tMax/dirLength[i];
+        hit.normal = (const bn_float3&)N;
+      }
+      hit.primID = hitIDs[i].primID;
+      hit.objID  = hitIDs[i].objID;
+      hit.instID = hitIDs[i].instID;
+    }
+  }
+
   std::shared_ptr<barney_api::Model> Context::createModel()
   {
     return GlobalModel::create(this);
   }
   
-  std::shared_ptr<barney_api::Renderer> Context::createRenderer()
+  std::shared_ptr<barney_api::Renderer>
+  Context::createRenderer(const std::string &type)
   {
-    return Renderer::create(this);
+    return Renderer::create(this,type);
   }
 
-  void Context::ensureRayQueuesLargeEnoughFor(FrameBuffer *fb)
+  FrameBuffer *Context::getMultiViewFB(FrameBuffer *view, int numViews)
   {
-    if (!isActiveWorker)
-      return;
+    if (!multiViewFB) {
+      multiViewFB = createFrameBuffer();
+      FrameBuffer *fb = (FrameBuffer *)multiViewFB.get();
+      /* every view denoises its own rows, so this one doesn't need
+         a denoiser (nor its full-frame buffers) */
+      delete fb->denoiser;
+      fb->denoiser = 0;
+    }
+    FrameBuffer *fb = (FrameBuffer *)multiViewFB.get();
+    /* sort-last compositing goes by a single camera's visibility
+       order */
+    if (fb->sortLast)
+      return nullptr;
+    const vec2i size(view->numPixels.x,view->numPixels.y*numViews);
+    if (fb->numPixels != size ||
+        fb->colorChannelFormat != view->colorChannelFormat ||
+        fb->channels != view->channels)
+      fb->resize(view->colorChannelFormat,size,view->channels);
+    return fb;
+  }
 
+  int Context::maxTilesOnAnyGPU(FrameBuffer *fb)
+  {
     auto dev0 = (*devices)[0];
     auto devFB = fb->getFor(dev0);
     int numTilesInFrame        = devFB->numTiles.x*devFB->numTiles.y;
+    if (fb->sortLast || fb->sampleParallel)
+      /* every device renders the whole frame */
+      return numTilesInFrame;
+    if (fb->maxTilesPerDevice > 0)
+      /* tiles got re-balanced by cost */
+      return fb->maxTilesPerDevice;
     int numGPUsThatRenderTiles = topo->numWorkerDevices;
-    int maxTilesOnAnyGPU       = divRoundUp(numTilesInFrame,
-                                            numGPUsThatRenderTiles);
-    int upperBoundOnNumRays
-      = maxTilesOnAnyGPU * /* max two rays per pixel*/2 * BARNEY_NS::pixelsPerTile;
+    return divRoundUp(numTilesInFrame,
+                      numGPUsThatRenderTiles);
+  }
+
+  int Context::rayQueueCapacity(FrameBuffer *fb)
+  {
+    /* max two rays per pixel */
+    const int raysPerTile = 2*pixelsPerTile;
+    int capacity = maxTilesOnAnyGPU(fb) * raysPerTile;
+    const int cap = FromEnv::get()->rayQueueCapacity;
+    if (cap > 0)
+      /* always whole tiles, and at least one */
+      capacity = std::min(capacity,std::max(1,cap/raysPerTile)*raysPerTile);
+    return capacity;
+  }
+  
+  void Context::ensureRayQueuesLargeEnoughFor(FrameBuffer *fb)
+  {
+    if (!isActiveWorker)
+      return;
+
+    int upperBoundOnNumRays = rayQueueCapacity(fb);
     for (auto device : *devices) {
       assert(device->rayQueue);
       device->rayQueue->resize(upperBoundOnNumRays);
+      if (fb->needHitIDs())
+        device->rayQueue->enableHitIDs();
     }
     
   }
 
+  int Context::getMemoryInfo(BNDeviceMemoryInfo *infos, int maxInfos)
+  {
+    static_assert(BN_MEMORY_NUM_CATEGORIES <= rtc::MemoryTracker::MAX_CATEGORIES,
+                  "more memory categories than the trackers can tell apart");
+    for (int i=0;i<(int)devices->size() && i<maxInfos;i++) {
+      Device *device = (*devices)[i];
+      auto usage = device->rtc->memory.getUsage();
+      BNDeviceMemoryInfo &info = infos[i];
+      info = {};
+      info.localDeviceID = i;
+      for (int c=0;c<BN_MEMORY_NUM_CATEGORIES;c++)
+        info.used[c] = usage.used[c];
+      info.totalUsed     = usage.total;
+      info.highWaterMark = usage.highWater;
+      device->rtc->getMemInfo(info.freeBytes,info.totalBytes);
+      info.cachedBytes = device->rtc->getCachedMemory();
+    }
+    return (int)devices->size();
+  }
+
+  void Context::resetMemoryHighWater()
+  {
+    for (auto device : *devices)
+      device->rtc->memory.resetHighWater();
+  }
+
+  int Context::getBuildRecords(BNBuildRecord *records, int maxRecords)
+  {
+    return buildLog.get(records,maxRecords);
+  }
+
+  void Context::clearBuildRecords()
+  {
+    buildLog.clear();
+  }
+
+  void Context::commit(barney_api::Object *object)
+  {
+    /* only the objects that models get built from are worth a
+       record; cameras, materials etc get committed all the time */
+    if (auto geom = dynamic_cast<Geometry *>(object)) {
+      BuildLog::Scope scope(BN_BUILD_COMMIT,object,geom->devices.get());
+      object->commit();
+      scope.numPrims = geom->numPrims;
+    } else if (auto sf = dynamic_cast<ScalarField *>(object)) {
+      BuildLog::Scope scope(BN_BUILD_COMMIT,object,sf->devices.get());
+      object->commit();
+    } else if (auto volume = dynamic_cast<Volume *>(object)) {
+      BuildLog::Scope scope(BN_BUILD_COMMIT,object,volume->devices.get());
+      object->commit();
+    } else
+      object->commit();
+  }
+
   int Context::contextSize() const
   {
     return (int)devices->size();
@@ -279,12 +1047,84 @@ namespace BARNEY_NS {
   Context::createTextureData(int slot,
                              BNDataType texelFormat,
                              vec3i dims,
-                             const void *texels)
+                             const void *texels,
+                             bool asyncUpload)
+  {
+    const size_t numBytes = TextureData::numBytesOf(texelFormat,dims);
+    if (numBytes == 0 || FromEnv::enabled("noTextureSharing"))
+      return std::make_shared<TextureData>(this,
+                                           getDevices(slot),
+                                           texelFormat,
+                                           dims,texels,
+                                           asyncUpload);
+    auto &cache = getSlot(slot)->textureData;
+    auto key = std::make_tuple((int)texelFormat,dims.x,dims.y,dims.z,
+                               AccelCache::hash(texels,numBytes));
+    auto it = cache.find(key);
+    if (it != cache.end())
+      if (TextureData::SP shared = it->second.lock())
+        return shared;
+    for (auto expired = cache.begin(); expired != cache.end(); )
+      if (expired->second.expired())
+        expired = cache.erase(expired);
+      else
+        ++expired;
+    TextureData::SP created
+      = std::make_shared<TextureData>(this,
+                                      getDevices(slot),
+                                      texelFormat,
+                                      dims,texels,
+                                      asyncUpload);
+    cache[key] = created;
+    return created;
+  }
+
+  void Context::readReplicated(const char *fileName,
+                               size_t offset,
+                               size_t numBytes,
+                               const std::function<void(const void *)> &use)
+  {
+    barney_api::MappedFile mapped(fileName,offset,numBytes);
+    use(mapped.data);
+  }
+
+  std::shared_ptr<barney_api::TextureData>
+  Context::createTextureDataFromFile(int slot,
+                                     BNDataType texelFormat,
+                                     vec3i dims,
+                                     const char *fileName,
+                                     size_t offset)
   {
-    return std::make_shared<TextureData>(this,
-                                         getDevices(slot),
-                                         texelFormat,
-                                         dims,texels);
+    const size_t numBytes = TextureData::numBytesOf(texelFormat,dims);
+    /* only 3D texture data can get staged in device memory (2D
+       may stay on the host, see TileStreamer) */
+    barney_api::DirectFile direct((numBytes && dims.z > 0) ? fileName : nullptr);
+    if (direct.valid()) {
+      /* the texels never were on the host, so there's nothing to
+         hash for sharing; volume time steps don't repeat, anyway */
+      Device *first = (*getDevices(slot))[0];
+      SetActiveGPU forDuration(first);
+      rtc::Buffer *staging;
+      {
+        MemoryScope memScope(first,BN_MEMORY_TEXTURES);
+        staging = first->rtc->createBuffer(numBytes);
+      }
+      TextureData::SP td;
+      if (direct.read(staging->getDD(),numBytes,offset))
+        td = std::make_shared<TextureData>(this,
+                                           getDevices(slot),
+                                           texelFormat,
+                                           dims,staging->getDD());
+      first->rtc->freeBuffer(staging);
+      if (td) return td;
+      std::cout << "#bn: GPUDirect Storage read of '" << fileName
+                << "' failed; reading it through the host" << std::endl;
+    }
+    /* the texture upload reads the texels (pageable, so
+       synchronously) straight out of the mapping, which can go away
+       right after */
+    barney_api::MappedFile mapped(fileName,offset);
+    return createTextureData(slot,texelFormat,dims,mapped.data);
   }
 
   std::shared_ptr<barney_api::Texture>
@@ -349,6 +1189,14 @@ namespace BARNEY_NS {
                                    geoms,volumes);
   }
 
+  void Context::buildGroups(barney_api::Group **_groups, int numGroups)
+  {
+    std::vector<Group *> groups;
+    for (int i=0;i<numGroups;i++)
+      if (_groups[i]) groups.push_back((Group *)_groups[i]);
+    Group::buildAll(groups.data(),(int)groups.size());
+  }
+
   std::shared_ptr<barney_api::Data>
   Context::createData(int slot,
                       BNDataType dataType)
@@ -7,7 +7,9 @@
 #include "barney/api/Context.h"
 #include "barney/Object.h"
 #include <set>
+#include <tuple>
 #include "barney/WorkerTopo.h"
+#include "barney/common/BuildLog.h"
 
 #define BN_TRACK_LEAKS(a) /* nothing */
 
@@ -21,10 +23,14 @@ namespace BARNEY_NS {
   enum { rayQueueSize = 4*1024*1024 };
 
   struct FrameBuffer;
+  struct FrameProfiler;
   struct GlobalModel;
   struct Camera;
   struct Renderer;
   struct Geometry;
+  struct StructuredData;
+  struct TileStreamer;
+  struct TextureData;
   
   namespace render {
     struct HostMaterial;
@@ -43,6 +49,12 @@ namespace BARNEY_NS {
     std::shared_ptr<render::HostMaterial>     defaultMaterial = 0;
     std::shared_ptr<render::SamplerRegistry>  samplerRegistry = 0;
     std::shared_ptr<render::MaterialRegistry> materialRegistry = 0;
+    /*! texture data created in this slot, by format, dims, and
+        content hash; so apps that create the same texture (say, an
+        env map or colormap) for several objects only get one copy
+        on the devices */
+    std::map<std::tuple<int,int,int,int,uint64_t>,
+             std::weak_ptr<TextureData>> textureData;
   };
 
   struct GlobalTraceImpl;
@@ -76,9 +88,15 @@ namespace BARNEY_NS {
     // virtual FrameBuffer *createFB(int owningRank) = 0;
     std::shared_ptr<barney_api::Model>
     createModel() override;
+
+    int  getMemoryInfo(BNDeviceMemoryInfo *infos, int maxInfos) override;
+    void resetMemoryHighWater() override;
+    int  getBuildRecords(BNBuildRecord *records, int maxRecords) override;
+    void clearBuildRecords() override;
+    void commit(barney_api::Object *object) override;
     
     std::shared_ptr<barney_api::Renderer>
-    createRenderer() override;
+    createRenderer(const std::string &type) override;
 
     std::shared_ptr<barney_api::Volume>
     createVolume(const std::shared_ptr<barney_api::ScalarField> &sf) override;
@@ -87,7 +105,24 @@ namespace BARNEY_NS {
     createTextureData(int slot,
                       BNDataType texelFormat,
                       vec3i dims,
-                      const void *texels) override;
+                      const void *texels,
+                      bool asyncUpload = false) override;
+
+    /*! without MPI, there's only one reader anyway: maps the file */
+    void readReplicated(const char *fileName,
+                        size_t offset,
+                        size_t numBytes,
+                        const std::function<void(const void *)> &use) override;
+
+    /*! 3D texture data gets read through GPUDirect Storage (see
+        DirectFile) into a staging buffer on the slot's first device
+        where possible; everything else goes through a MappedFile */
+    std::shared_ptr<barney_api::TextureData>
+    createTextureDataFromFile(int slot,
+                              BNDataType texelFormat,
+                              vec3i dims,
+                              const char *fileName,
+                              size_t offset) override;
     
     std::shared_ptr<barney_api::ScalarField>
     createScalarField(int slot, const std::string &type) override;
@@ -109,6 +144,8 @@ namespace BARNEY_NS {
                 barney_api::Geometry **geoms, int numGeoms,
                 barney_api::Volume **volumes, int numVolumes) override;
 
+    void buildGroups(barney_api::Group **groups, int numGroups) override;
+
     std::shared_ptr<barney_api::Data>
     createData(int slot,
                BNDataType dataType) override;
@@ -141,38 +178,157 @@ namespace BARNEY_NS {
     // for debugging ...
     virtual void barrier(bool warn=true) {}
     
-    /*! generate a new wave-front of rays */
+    /*! generate a new wave-front of rays, for the virtual tiles
+        [begin,end) (see wave-front merging in renderTiles()) */
     void generateRays(Camera *camera,
                       Renderer *renderer,
-                      FrameBuffer *fb);
+                      FrameBuffer *fb,
+                      int begin,
+                      int end,
+                      bool appendToReadQueue);
     
-    /*! have each *local* GPU trace its current wave-front of rays */
-    void traceRaysLocally(GlobalModel *model, uint32_t rngSeed, bool needHitIDs);
+    /*! have each *local* GPU trace its current wave-front of rays;
+        unless syncWhenDone is false this waits for all of them to
+        finish */
+    void traceRaysLocally(GlobalModel *model, uint32_t rngSeed, bool needHitIDs,
+                          bool syncWhenDone = true);
     
     /*! trace all rays currently in a ray queue, including forwarding
       if and where applicable, untile every ray in the ray queue as
       found its intersection */
     void traceRaysGlobally(GlobalModel *model, uint32_t rngSeed, bool needHitIDs);
 
+    /*! shade all rays in the local ray queues. if readBackNumActive
+        is false this will not sync with the devices, and leave the
+        ray queues' numActive as an upper bound only */
     void shadeRaysLocally(Renderer *renderer,
                           GlobalModel *model,
                           FrameBuffer *fb,
                           int generation,
-                          uint32_t rngSeed);
+                          uint32_t rngSeed,
+                          bool readBackNumActive = true);
+    /*! allocates given device's Device::shadeParams, if it doesn't
+        have them yet; has to happen before any capture that shades */
+    void allocShadeParams(Device *device);
+    /*! re-order each local device's read queue by a key suitable
+        for the following shade or trace pass (see RayQueue::SortFor) */
+    void sortRaysLocally(int sortFor, bool withHitIDs);
+
+    /*! with BARNEY_CONFIG=gpuWeights=auto, times a short compute
+        kernel on every local gpu and sets their tileWeights from
+        that, so mixed-generation gpus get tile (and data) shares
+        that match their speed */
+    void measureDeviceWeights();
+
+    /*! if possible, does one (sort-)trace-(sort-)shade bounce by
+        launching a graph captured from an earlier such bounce
+        (capturing one if we don't have one yet), and returns true;
+        returns false if this bounce has to be done the regular way */
+    bool replayBounceGraph(Renderer *renderer,
+                           GlobalModel *model,
+                           FrameBuffer *fb,
+                           int generation,
+                           uint32_t rngSeed);
+
+    /*! finishes all paths still alive in the local ray queues by
+        doing numGenerations trace-shade bounces back to back, without
+        sorting, syncing, or reading back ray counts in between (only
+        after the last one). Only valid if no ray ever has to leave
+        the device it is on. Returns the generation after the last
+        one it did */
+    int finishPathsLocally(Renderer *renderer,
+                           GlobalModel *model,
+                           FrameBuffer *fb,
+                           int generation,
+                           int numGenerations);
+    
     void finalizeTiles(FrameBuffer *fb);
     
     void renderTiles(Renderer *renderer,
                      GlobalModel *model,
                      Camera      *camera,
                      FrameBuffer *fb);
+    /*! renders (and accumulates) one wave of numSamples samples per
+        pixel; renderTiles() does one or more of those per frame */
+    void renderSamples(Renderer    *renderer,
+                       GlobalModel *model,
+                       Camera      *camera,
+                       FrameBuffer *fb,
+                       int          numSamples);
     
     virtual void render(Renderer    *renderer,
                         GlobalModel *model,
                         Camera      *camera,
                         FrameBuffer *fb) = 0;
 
+    /*! see bnPick() */
+    virtual void pick(GlobalModel *model,
+                      Camera *camera,
+                      vec2i numPixels,
+                      const vec2f *screenPos,
+                      int numPicks,
+                      BNPickResult *results) = 0;
+    /*! traces given (host-side) rays through the same
+        traceRaysGlobally() path camera rays go through, but without
+        shading them: each ray ends up with its closest hit, and
+        hitIDs with the ids of that ray's closest surface. Rays get
+        spread over all local devices, in as many rounds of at most
+        maxQueryRaysPerDevice rays per device as it takes. Collective
+        over all active workers, each of which may have any number
+        of rays (including none) */
+    void traceQueryRays(GlobalModel *model,
+                        Ray *rays,
+                        HitIDs *hitIDs,
+                        int numRays);
+    enum { maxQueryRaysPerDevice = 1<<18 };
+    /*! see bnTraceRays() */
+    void queryRays(GlobalModel *model,
+                   const BNRay *rays,
+                   int numRays,
+                   BNRayHit *hits);
+    /*! generates bnPick()'s rays if generateHere, and traces them
+        with traceQueryRays(). Collective over all active workers;
+        returns whether results got written (ie, whether this
+        generated them) */
+    bool pickLocally(GlobalModel *model,
+                     Camera *camera,
+                     vec2i numPixels,
+                     const vec2f *screenPos,
+                     int numPicks,
+                     BNPickResult *results,
+                     bool generateHere);
+
     void ensureRayQueuesLargeEnoughFor(FrameBuffer *fb);
 
+    /*! has all out-of-core (paged) scalar fields and streamed
+        textures page in the bricks (or tiles) that got requested
+        while rendering the previous frame */
+    void servicePageRequests();
+    /*! scalar fields whose bricks get paged in and out; see
+        StructuredData::bricks */
+    std::set<StructuredData *> pagedFields;
+    /*! textures whose tiles get paged in and out */
+    std::set<TileStreamer *> streamedTextures;
+    /*! see bnContextGetBuildRecords() */
+    BuildLog buildLog;
+
+    /*! the internal frame buffer bnRenderMulti() renders all views
+        into (see FrameBuffer::views), (re-)sized for numViews views
+        like given one; created on first use. Null if that frame
+        buffer type can't render multiple views */
+    FrameBuffer *getMultiViewFB(FrameBuffer *view, int numViews);
+    std::shared_ptr<barney_api::FrameBuffer> multiViewFB;
+
+    /*! upper bound on the number of tiles that any GPU (on any rank)
+        owns in the given frame buffer */
+    int maxTilesOnAnyGPU(FrameBuffer *fb);
+    /*! how many rays every device's ray queues get sized for: two per
+        pixel of all the tiles it may own, unless capped by
+        FromEnv::rayQueueCapacity - in which case renderSamples()'
+        wave-front merging only ever generates rays for as many tiles
+        as fit, and covers the frame in several batches */
+    int rayQueueCapacity(FrameBuffer *fb);
+
     /*! helper function to print a warning when app tries to create an
         object of certain kind and type that barney does not
         support */
@@ -199,6 +355,32 @@ namespace BARNEY_NS {
       may actually need to enter another bounce even if *we* do not have
       any rays */
     virtual int numRaysActiveGlobally() = 0;
+    /*! split-phase version of numRaysActiveGlobally(): start...()
+        posts the reduction (of the current local count), and
+        finish...() returns its result; in between, the caller may do
+        anything that's collective in the same order on all ranks -
+        such as the next trace. Only one may be pending at a time */
+    virtual void startRaysActiveGlobally()
+    { pendingRaysActiveGlobally = numRaysActiveGlobally(); }
+    virtual int finishRaysActiveGlobally()
+    { return pendingRaysActiveGlobally; }
+    int pendingRaysActiveGlobally = 0;
+
+    /*! returns the max number of rays active in any single ray
+        queue, on this rank */
+    int maxRaysActiveLocally();
+    
+    /*! returns the max number of rays active in any single ray queue
+        across all devices and ranks; used to decide how many new
+        camera rays every device can add to its ray queue without
+        overflowing it */
+    virtual int maxRaysActiveGlobally() = 0;
+
+    /*! returns the largest of all ranks' values; used for decisions
+        based on measured times, which every rank has to agree on */
+    virtual float maxTimeGlobally(float time) = 0;
+    /*! largest of all active workers' values */
+    virtual int maxGlobally(int value) = 0;
     
     
     int contextSize() const;
@@ -226,6 +408,23 @@ namespace BARNEY_NS {
     /*! cut plane active during the current renderTiles() call;
         populated from Renderer::cutPlane and read by traceRaysLocally */
     vec4f activeCutPlane{0.f, 0.f, 0.f, -1e30f};
+    /*! pixel angle of the camera in the current renderTiles() call,
+        see OptixGlobals::pixelAngle */
+    float activePixelAngle = 0.f;
+
+    /*! frame buffer's profiler (if any) and the generation being
+        traced during the current renderTiles() call; used by
+        traceRaysLocally to time the local part of global traces */
+    FrameProfiler *activeProfiler = nullptr;
+    int activeGeneration = 0;
+
+    /*! set while the current renderTiles() call renders sort-last
+        compositing layers; rays then never leave the device that
+        generated them, and primary misses stay transparent */
+    bool activeSortLast = false;
+    /*! set while the current renderTiles() call uses (and fills) the
+        frame buffer's primary hit cache */
+    bool activePrimaryHitCache = false;
   };
 
   struct GlobalTraceImpl {
@@ -234,6 +433,10 @@ namespace BARNEY_NS {
     {}
     virtual ~GlobalTraceImpl() = default;
 
+    /*! called (on all active workers) at the start of each frame,
+        before any rays get traced */
+    virtual void beginFrame(GlobalModel *model) {}
+
     virtual void traceRays(GlobalModel *model,
                            uint32_t rngSeed,
                            bool needHitIDs) = 0;
@@ -6,6 +6,9 @@
 #include "barney/render/OptixGlobals.h"
 #include "barney/Context.h"
 #include "barney/render/RayQueue.h"
+#include "barney/common/DeviceCounters.h"
+#include <mutex>
+#include <thread>
 
 namespace BARNEY_NS {
 
@@ -43,7 +46,10 @@ namespace BARNEY_NS {
     if (sbtDirty) {
       rtc->buildSBT();
       sbtDirty = false;
-    }
+    } else
+      // no structural changes, but geometries may have gotten
+      // re-committed; this rewrites only their records, if any
+      rtc->updateSBT();
   }
 
   DevGroup::DevGroup(const std::vector<Device*> &devices,
@@ -52,6 +58,42 @@ namespace BARNEY_NS {
       numLogical(numLogical)
   {}
 
+  std::vector<float> DevGroup::partitionWeights() const
+  {
+    std::vector<float> weights((*this)[0]->partition.size,1.f);
+    for (auto device : *this)
+      weights[device->partition.rank] = device->tileWeight;
+    return weights;
+  }
+
+  void DevGroup::forEachDeviceInParallel(const std::function<void(Device *)> &fct)
+  {
+    if (size() <= 1 || FromEnv::enabled("serialDeviceBuilds")) {
+      for (auto device : *this) {
+        SetActiveGPU forDuration(device);
+        fct(device);
+      }
+      return;
+    }
+    std::mutex mutex;
+    std::exception_ptr firstError;
+    std::vector<std::thread> threads;
+    for (auto device : *this)
+      threads.emplace_back([&,device]() {
+        try {
+          SetActiveGPU forDuration(device);
+          fct(device);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!firstError) firstError = std::current_exception();
+        }
+      });
+    for (auto &thread : threads)
+      thread.join();
+    if (firstError)
+      std::rethrow_exception(firstError);
+  }
+
 
   Device::Device(rtc::Device *rtc,
                  const WorkerTopo *topo,
@@ -64,14 +106,28 @@ namespace BARNEY_NS {
   {
     assert(_localRank == topo->allDevices[_globalRank].local); 
     rayQueue = new RayQueue(this);
+#if BARNEY_RTC_OPTIX
+    if (!FromEnv::get()->pipelineCacheDir.empty())
+      rtc->setPipelineCacheDir(FromEnv::get()->pipelineCacheDir);
+#endif
     traceRays
       = createTrace_traceRays(rtc);
+#if BARNEY_RTC_EMBREE
+    tileWeight = FromEnv::get()->cpuWeight;
+#else
+    NvtxRange::nameStream(rtc->stream,rtc->physicalID,_globalRank);
+    const std::vector<float> &gpuWeights = FromEnv::get()->gpuWeights;
+    if (localRank < (int)gpuWeights.size())
+      tileWeight = gpuWeights[localRank];
+#endif
   }
 
   Device::~Device()
   {
     delete rayQueue;
     delete traceRays;
+    if (counters) rtc->freeBuffer(counters);
+    if (shadeParams) rtc->freeBuffer(shadeParams);
     // geomTypes uses device->freeGeomType(rtc), so must be cleared
     // before rtc is deleted. (Member destructor order would destroy
     // geomTypes after rtc since it's declared before rtc.)
@@ -83,6 +139,47 @@ namespace BARNEY_NS {
     delete rtc;
   }
 
+  uint64_t *Device::countersFor(int generation)
+  {
+    if (!counters) return nullptr;
+    generation = std::max(0,std::min(generation,
+                                     BN_FRAME_STATS_MAX_GENERATIONS-1));
+    return (uint64_t *)counters->getDD()
+      + generation*DeviceCounters::NUM_COUNTERS;
+  }
+
+  void Device::resetCounters()
+  {
+#if BARNEY_DEVICE_COUNTERS
+    const size_t numBytes
+      = BN_FRAME_STATS_MAX_GENERATIONS
+      * DeviceCounters::NUM_COUNTERS*sizeof(uint64_t);
+    if (!counters)
+      counters = rtc->createBuffer(numBytes);
+    rtc->memsetAsync(counters->getDD(),0,numBytes);
+#endif
+  }
+
+  MemoryScope::MemoryScope(Device *device, BNMemoryCategory category)
+  {
+    saved.push_back({device,device->rtc->memory.current});
+    device->rtc->memory.current = category;
+  }
+
+  MemoryScope::MemoryScope(const DevGroup *devices, BNMemoryCategory category)
+  {
+    for (auto device : *devices) {
+      saved.push_back({device,device->rtc->memory.current});
+      device->rtc->memory.current = category;
+    }
+  }
+
+  MemoryScope::~MemoryScope()
+  {
+    for (auto &s : saved)
+      s.first->rtc->memory.current = s.second;
+  }
+
   int Device::globalRank() const
   { return _globalRank; }
   
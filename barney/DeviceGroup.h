@@ -7,8 +7,12 @@
 #include "barney/common/barney-common.h"
 #include "rtcore/AppInterface.h"
 #include "barney/WorkerTopo.h"
+#include "barney/api/Nvtx.h"
+#include <functional>
 
 namespace BARNEY_NS {
+  using barney_api::NvtxRange;
+  using barney_api::Timeline;
   
   struct TiledFB;
   struct RayQueue;
@@ -54,12 +58,38 @@ namespace BARNEY_NS {
     void restoreActive(int old) const  { rtc->restoreActive(old); }
     void syncPipelineAndSBT();
     
+    /*! set on structural changes (instances, accels) that need the
+        whole SBT rebuilt; geometries that merely get re-committed
+        with new data get tracked by the rtc device itself, which
+        then rewrites only their records */
     bool sbtDirty = true;
     
     GeomTypeRegistry geomTypes;
     rtc::Device *const rtc;
     rtc::TraceKernel2D *traceRays = 0;
     RayQueue     *rayQueue = 0;
+    /*! this device's throughput relative to that of a gpu; decides
+        its share of tiles when ranks of different backends render
+        into the same frame buffer */
+    float tileWeight = 1.f;
+    /*! with BARNEY_CONFIG=autoPartition, which of the (spatial) parts
+        of its slot's objects this device holds, out of how many -
+        one per device in the slot; {0,1} otherwise. Objects that
+        can't be split get traced by part 0's device only */
+    PeerGroup partition = { 0, 1 };
+
+    /*! this device's DeviceCounters for given generation (the last
+        one standing in for all after it), or null if this build
+        doesn't count */
+    uint64_t *countersFor(int generation);
+    /*! zeroes all generations' counters, at the start of a frame */
+    void resetCounters();
+    /*! MAX_GENERATIONS x NUM_COUNTERS; only with
+        BARNEY_DEVICE_COUNTERS */
+    rtc::Buffer *counters = 0;
+    /*! device-side copy of the shade kernel's world and renderer
+        descriptors (see Context::allocShadeParams()) */
+    rtc::Buffer *shadeParams = 0;
 
     /*! the _global_ device ID within the worker topo */
     int const _localRank;
@@ -103,10 +133,36 @@ namespace BARNEY_NS {
              int numLogical);
 
     Device *get(int idx) { return (*this)[idx]; }
+
+    /*! calls fct(device) for all devices in this group, each from its
+        own host thread (and with that device active), so blocking
+        per-device work like accel builds overlaps across devices
+        rather than adding up. Runs on the calling thread for single
+        devices, or with BARNEY_CONFIG="serialDeviceBuilds". If any
+        call throws, the (first) exception gets re-thrown here once
+        all are done */
+    void forEachDeviceInParallel(const std::function<void(Device *)> &fct);
+
+    /*! with autoPartition, the weights of this group's spatial parts
+        (by partition rank): their devices' tileWeights, so faster
+        devices get larger parts */
+    std::vector<float> partitionWeights() const;
     
       /*! *TOTAL* number of logical devices in the context;
       *NOT* how many devices there are in this group. */
     int const numLogical;
   };
+
+  /*! attributes all device memory that the given device(s) allocate
+      during the lifetime of this to given category (see
+      bnContextGetMemoryInfo()); scopes nest, so whatever was
+      current before gets restored when this dies */
+  struct MemoryScope {
+    MemoryScope(Device *device, BNMemoryCategory category);
+    MemoryScope(const DevGroup *devices, BNMemoryCategory category);
+    ~MemoryScope();
+  private:
+    std::vector<std::pair<Device *,int>> saved;
+  };
   
 }
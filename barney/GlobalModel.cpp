@@ -3,6 +3,8 @@
 
 
 #include "barney/GlobalModel.h"
+#include "barney/fb/FrameBuffer.h"
+#include "barney/render/Renderer.h"
 
 namespace BARNEY_NS {
 
@@ -34,11 +36,113 @@ namespace BARNEY_NS {
     FrameBuffer *fb = (FrameBuffer *)_fb;
     Camera *camera = (Camera *)_camera;
     assert(fb);
+    /* whatever multi-view frame this may have been part of, this
+       one is its own */
+    fb->views.batch = nullptr;
     Context *context = (Context *)this->context;
+    fb->updateRenderScale(((Renderer*)renderer)->targetFrameTime);
+    fb->updateRegionOfInterest();
+    fb->rebalanceTiles();
+    fb->updateActiveChannels();
+    fb->updateSamplePeriods();
+    /* nothing left to do until accumulation restarts; all ranks
+       agree on that, so no one waits for anybody else */
+    if (fb->isConverged())
+      return;
+    context->servicePageRequests();
     context->ensureRayQueuesLargeEnoughFor(fb);
     context->render((Renderer*)renderer,this,camera,fb);
     if (profHook)
       profHook();
   }
 
+  /*! whether given views can get rendered as one frame; they have to
+      be alike, and nothing may depend on there being only one
+      camera */
+  static bool canRenderAsOne(Renderer *renderer,
+                             const std::vector<FrameBuffer *> &fbs)
+  {
+    if (renderer->restirDI)
+      return false;
+    for (auto fb : fbs) {
+      if (fb->numPixels          != fbs[0]->numPixels ||
+          fb->colorChannelFormat != fbs[0]->colorChannelFormat ||
+          fb->channels           != fbs[0]->channels)
+        return false;
+      if (fb->numPixels.x <= 0 ||
+          fb->renderPixels != fb->numPixels ||
+          fb->dynamicRenderScale ||
+          fb->temporalReprojection ||
+          fb->roi.box != vec4i(0) ||
+          fb->foveation.radius > 0.f ||
+          !fb->foveation.tileRates.empty())
+        return false;
+    }
+    return true;
+  }
+
+  void GlobalModel::renderMulti(barney_api::Renderer          *_renderer,
+                                barney_api::Camera      *const *_cameras,
+                                barney_api::FrameBuffer *const *_fbs,
+                                int numViews)
+  {
+    Context  *context  = (Context *)this->context;
+    Renderer *renderer = (Renderer *)_renderer;
+    std::vector<FrameBuffer *> fbs(numViews);
+    std::vector<Camera::DD>    cameras(numViews);
+    for (int i=0;i<numViews;i++) {
+      fbs[i]     = (FrameBuffer *)_fbs[i];
+      cameras[i] = ((Camera *)_cameras[i])->getDD();
+    }
+    FrameBuffer *batch
+      = (numViews > 1 && canRenderAsOne(renderer,fbs))
+      ? context->getMultiViewFB(fbs[0],numViews)
+      : nullptr;
+    if (!batch) {
+      barney_api::Model::renderMulti(_renderer,_cameras,_fbs,numViews);
+      return;
+    }
+
+    /* every view still decides on its own channels (it's the views
+       the app reads); the frame produces what any of them needs */
+    uint32_t active = 0;
+    bool restart = false;
+    for (int i=0;i<numViews;i++) {
+      fbs[i]->views.batch = batch;
+      fbs[i]->views.index = i;
+      fbs[i]->updateActiveChannels();
+      active |= fbs[i]->activeChannels;
+      restart |= (fbs[i]->accumID == 0);
+    }
+    if (restart)
+      batch->resetAccumulation();
+    batch->rebalanceTiles();
+    batch->setActiveChannels(active);
+    batch->setViews(fbs,cameras);
+    context->servicePageRequests();
+    context->ensureRayQueuesLargeEnoughFor(batch);
+    context->render(renderer,this,(Camera *)_cameras[0],batch);
+    if (profHook)
+      profHook();
+  }
+
+  void GlobalModel::pick(barney_api::Camera *camera,
+                         vec2i numPixels,
+                         const vec2f *screenPos,
+                         int numPicks,
+                         BNPickResult *results)
+  {
+    Context *context = (Context *)this->context;
+    context->pick(this,(Camera *)camera,numPixels,
+                  screenPos,numPicks,results);
+  }
+
+  void GlobalModel::traceRays(const BNRay *rays,
+                              int numRays,
+                              BNRayHit *hits)
+  {
+    Context *context = (Context *)this->context;
+    context->queryRays(this,rays,numRays,hits);
+  }
+
 }
@@ -26,6 +26,18 @@ namespace BARNEY_NS {
     void render(barney_api::Renderer    *renderer,
                 barney_api::Camera      *camera,
                 barney_api::FrameBuffer *fb) override;
+    void renderMulti(barney_api::Renderer          *renderer,
+                     barney_api::Camera      *const *cameras,
+                     barney_api::FrameBuffer *const *fbs,
+                     int numViews) override;
+    void pick(barney_api::Camera *camera,
+              vec2i numPixels,
+              const vec2f *screenPos,
+              int numPicks,
+              BNPickResult *results) override;
+    void traceRays(const BNRay *rays,
+                   int numRays,
+                   BNRayHit *hits) override;
 
     ModelSlot *getSlot(int whichSlot)
     {
@@ -46,6 +58,12 @@ namespace BARNEY_NS {
                                   int numInstances) override
     { getSlot(slot)->updateInstanceTransforms(xfms,numInstances); }
 
+    void updateInstanceTransformsSparse(int slot,
+                                        const int *instIDs,
+                                        const affine3f *xfms,
+                                        int count) override
+    { getSlot(slot)->updateInstanceTransformsSparse(instIDs,xfms,count); }
+
     void setInstanceAttributes(int slot,
                                const std::string &which,
                                Data::SP data) override
@@ -53,6 +71,9 @@ namespace BARNEY_NS {
 
     void build(int slot) override
     { getSlot(slot)->build(); }
+
+    void setDomainBounds(int slot, const box3f &bounds) override
+    { getSlot(slot)->domainBounds = bounds; }
       
   };
 
@@ -4,6 +4,8 @@
 
 #include "barney/ModelSlot.h"
 #include "barney/Context.h"
+#include <algorithm>
+#include <set>
 
 namespace BARNEY_NS {
 
@@ -37,6 +39,16 @@ namespace BARNEY_NS {
   void Group::commit()
   {}
   
+  /*! implements the parameter set/commit paradigm */
+  bool Group::set1i(const std::string &member, const int &value)
+  {
+    if (member == "buildQuality") {
+      buildQuality = (rtc::BuildQuality)value;
+      return true;
+    }
+    return false;
+  }
+  
   /*! implements the parameter set/commit paradigm */
   bool Group::setObject(const std::string &member, const Object::SP &value)
   {
@@ -83,48 +95,141 @@ namespace BARNEY_NS {
       pld->triangleGeoms.clear();
       pld->volumeGeoms.clear();
     }
+    builtTopologyVersions.clear();
   }
   
   void Group::build()
   {
-    freeAllGeoms();
+    Group *self = this;
+    buildAll(&self,1);
+  }
+
+  void Group::buildAll(Group **groups, int numGroups)
+  {
+    std::vector<Group *> toBuild;
+    for (int i=0;i<numGroups;i++)
+      if (groups[i] && std::find(toBuild.begin(),toBuild.end(),groups[i])
+          == toBuild.end())
+        toBuild.push_back(groups[i]);
+    if (toBuild.empty())
+      return;
+
+    for (auto group : toBuild)
+      group->prepareAccels();
 
+    // let each geom build/update itself, but only once, even if it
+    // is shared by several of these groups
+    std::set<Geometry *> builtGeoms;
+    for (auto group : toBuild)
+      for (auto geom : group->geoms)
+        if (geom && builtGeoms.insert(geom.get()).second) {
+          BuildLog::Scope scope(BN_BUILD_GEOMETRY,geom.get(),
+                                geom->devices.get(),geom->numPrims);
+          geom->build();
+        }
+
+    // all groups' (blocking) accel builds go into a single pass over
+    // the devices, so each device's builds overlap with those of the
+    // others, with no barrier after every single group
+    bool sameDevices = true;
+    for (auto group : toBuild)
+      sameDevices = sameDevices && (group->devices == toBuild[0]->devices);
+    if (sameDevices)
+      toBuild[0]->devices->forEachDeviceInParallel([&](Device *device) {
+        for (auto group : toBuild)
+          group->buildAccels(device);
+      });
+    else
+      for (auto group : toBuild)
+        group->devices->forEachDeviceInParallel([&](Device *device) {
+          group->buildAccels(device);
+        });
+
+    for (auto group : toBuild) {
+      group->finishAccels();
+      group->buildVolumes();
+    }
+  }
+
+  void Group::prepareAccels()
+  {
     // ==================================================================
-    // triangles and user geoms - for now always rebuild
+    // triangles and user geoms - refit if all geoms only had their
+    // vertices changed, else rebuild
     // ==================================================================
-    {
-      // first, let them all build/update themselves
-      for (auto geom : geoms) {
-        if (!geom) continue;
-        geom->build();
-      }
-      
-      // now, do our stuff on a per-device basis
-      for (auto device : *devices) {
-        PLD *myPLD = getPLD(device);
-        for (auto geom : geoms) {
-          Geometry::PLD *geomPLD = geom->getPLD(device);
-          for (auto g : geomPLD->triangleGeoms)
-            myPLD->triangleGeoms.push_back(g);
-          for (auto g : geomPLD->userGeoms)
-            myPLD->userGeoms.push_back(g);
-          // for (auto g : geomPLD->userGroups)
-          //   myPLD->volumeGroups.push_back(g);
-        }
+    bounds = box3f();
+    boundsKnown = volumes.empty();
+    for (auto geom : geoms) {
+      if (!geom) continue;
+      if (geom->bounds.empty())
+        boundsKnown = false;
+      bounds.extend(geom->bounds);
+    }
+    
+    pendingTopologyVersions.clear();
+    bool refit = true;
+    for (auto geom : geoms) {
+      pendingTopologyVersions.push_back(geom ? geom->topologyVersion : 0);
+      if (geom && !geom->canRefit())
+        refit = false;
+    }
+    pendingRefit = refit && (pendingTopologyVersions == builtTopologyVersions);
+
+    if (!pendingRefit)
+      freeAllGeoms();
+  }
+
+  void Group::buildAccels(Device *device)
+  {
+    MemoryScope memScope(device,BN_MEMORY_BVHS);
+    NvtxRange nvtx("buildAccels",device->globalRank());
+    size_t numPrims = 0;
+    for (auto geom : geoms)
+      if (geom) numPrims += geom->numPrims;
+    BuildLog::Scope scope(pendingRefit ? BN_BUILD_GROUP_REFIT : BN_BUILD_GROUP,
+                          this,device,numPrims);
+    PLD *myPLD = getPLD(device);
+    if (pendingRefit) {
+      if (myPLD->userGeomGroup)
+        myPLD->userGeomGroup->refitAccel();
+      if (myPLD->triangleGeomGroup)
+        myPLD->triangleGeomGroup->refitAccel();
+      return;
+    }
+
+    // all triangle (and all user) geoms of this group go into a
+    // single multi-input build
+    for (auto geom : geoms) {
+      if (!geom) continue;
+      Geometry::PLD *geomPLD = geom->getPLD(device);
+      for (auto g : geomPLD->triangleGeoms)
+        myPLD->triangleGeoms.push_back(g);
+      for (auto g : geomPLD->userGeoms)
+        myPLD->userGeoms.push_back(g);
+    }
         
-        if (!myPLD->userGeoms.empty()) {
-          myPLD->userGeomGroup
-            = device->rtc->createUserGeomsGroup(myPLD->userGeoms);
-          myPLD->userGeomGroup->buildAccel();
-        }
+    if (!myPLD->userGeoms.empty()) {
+      myPLD->userGeomGroup
+        = device->rtc->createUserGeomsGroup(myPLD->userGeoms,buildQuality);
+      myPLD->userGeomGroup->buildAccel();
+    }
         
-        if (!myPLD->triangleGeoms.empty()) {
-          myPLD->triangleGeomGroup
-            = device->rtc->createTrianglesGroup(myPLD->triangleGeoms);
-          myPLD->triangleGeomGroup->buildAccel();
-        }
-      }
+    if (!myPLD->triangleGeoms.empty()) {
+      myPLD->triangleGeomGroup
+        = device->rtc->createTrianglesGroup(myPLD->triangleGeoms,buildQuality);
+      myPLD->triangleGeomGroup->buildAccel();
     }
+  }
+
+  void Group::finishAccels()
+  {
+    if (!pendingRefit)
+      builtTopologyVersions = pendingTopologyVersions;
+    pendingTopologyVersions.clear();
+  }
+
+  void Group::buildVolumes()
+  {
     // ==================================================================
     // volumes - these may need two passes
     // ==================================================================
@@ -160,8 +265,33 @@ namespace BARNEY_NS {
       // volumes, respectively, that we can now gather here.
       // ------------------------------------------------------------------
       for (auto volume : volumes)
-        if (volume)
+        if (volume) {
+          volume->accel->mergedVolumes.clear();
+          volume->accel->mergedInto = nullptr;
           volume->build(true);
+        }
+
+      // ------------------------------------------------------------------
+      // volumes over the same field (eg, different transfer functions
+      // on the same data) get traced by the first such volume's
+      // accel, with a single traversal of their combined majorants,
+      // rather than each one traversing the same grid by itself
+      // ------------------------------------------------------------------
+      if (!FromEnv::enabled("noMergedVolumes"))
+        for (int i=0;i<(int)volumes.size();i++) {
+          Volume *primary = volumes[i].get();
+          if (!primary || primary->accel->mergedInto) continue;
+          std::vector<Volume *> others;
+          for (int j=i+1;j<(int)volumes.size();j++) {
+            Volume *other = volumes[j].get();
+            if (!other || other->accel->mergedInto) continue;
+            if (others.size()+1 >= VolumeAccel::maxMergedVolumes) break;
+            if (!primary->accel->canMerge(other->accel.get())) continue;
+            other->accel->mergedInto = primary;
+            others.push_back(other);
+          }
+          primary->accel->setMergedVolumes(others);
+        }
 
       // ------------------------------------------------------------------
       // now that all volumes (and their accels) have been built, go
@@ -171,6 +301,12 @@ namespace BARNEY_NS {
       for (auto device : *devices) {
         PLD *myPLD = getPLD(device);
         for (auto volume : volumes) {
+          if (volume->accel->mergedInto)
+            // gets traced by another volume's accel
+            continue;
+          if (device->partition.rank != 0 && !volume->sf->isPartitioned())
+            // not split, so it's all in part 0
+            continue;
           Volume::PLD *volumePLD = volume->getPLD(device);
           // gather all geoms from this group (if any)
           for (auto geom : volumePLD->generatedGeoms)
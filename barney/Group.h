@@ -26,6 +26,7 @@ namespace BARNEY_NS {
     // ------------------------------------------------------------------
     /*! @{ parameter set/commit interface */
     void commit() override;
+    bool set1i(const std::string &member, const int &value) override;
     bool setObject(const std::string &member, const Object::SP &value) override;
     bool setData(const std::string &member,
                  const barney_api::Data::SP &value) override;
@@ -33,6 +34,18 @@ namespace BARNEY_NS {
     // ------------------------------------------------------------------
     
     void build() override;
+    /*! builds all given groups together: every geom that any of
+        them uses gets built only once, and all groups' accels get
+        built in a single pass over the devices */
+    static void buildAll(Group **groups, int numGroups);
+
+    /*! the phases of build(): decide between refit and rebuild
+        (before the geoms build), build or refit one device's accels,
+        and record what was built (after all devices' are done) */
+    void prepareAccels();
+    void buildAccels(Device *device);
+    void finishAccels();
+    void buildVolumes();
 
     void freeAllGeoms();
     void freeAllVolumes();
@@ -46,6 +59,25 @@ namespace BARNEY_NS {
     /*! lights assigned to this group */
     ObjectRefsData::SP lights;
 
+    /*! what the triangle and user geom accels get optimized for; set
+        through "buildQuality" (0=default, 1=fast trace, 2=fast
+        build). Only fast-build accels can get refit in place on all
+        backends, so that's what deforming geometry should use */
+    rtc::BuildQuality buildQuality = rtc::BUILD_QUALITY_DEFAULT;
+
+    /*! each geom's topologyVersion at the time the triangle and
+        user geom accels got last built; empty if they never were */
+    std::vector<int> builtTopologyVersions;
+    /*! what the build in progress refits or rebuilds to */
+    std::vector<int> pendingTopologyVersions;
+    bool pendingRefit = false;
+
+    /*! object-space bounds of all geoms, as of the last build; only
+        valid if boundsKnown, which it isn't if there are volumes, or
+        geoms that don't know their bounds */
+    box3f bounds;
+    bool  boundsKnown = false;
+
 #if 1
     struct /* per logical device */PLD {
       std::vector<rtc::Geom *> triangleGeoms;
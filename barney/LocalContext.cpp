@@ -197,6 +197,12 @@ namespace BARNEY_NS {
   WorkerTopo::SP
   LocalContext::makeTopo(const std::vector<LocalSlot> &localSlots)
   {
+    /* with automatic partitioning, the devices of a single data
+       group each hold a different spatial part of it (see
+       Device::partition), so have to form one island, as if each
+       held a different data rank */
+    const bool autoPartition
+      = localSlots.size() == 1 && FromEnv::enabled("autoPartition");
     std::vector<WorkerTopo::Device> devices;
     for (auto ls : localSlots) {
       for (auto gpuID : ls.gpuIDs) {
@@ -204,9 +210,10 @@ namespace BARNEY_NS {
         dev.local = (int)devices.size();
         dev.worker = 0;
         dev.worldRank = 0;
-        dev.dataRank = ls.dataRank;
+        dev.dataRank = autoPartition ? dev.local : ls.dataRank;
         dev.hostNameHash = getHostNameHash();
         dev.physicalDeviceHash = rtc::getPhysicalDeviceHash(gpuID);
+        dev.numaNode = rtc::getNumaNode(gpuID);
         devices.push_back(dev);
       }
     }
@@ -288,8 +295,9 @@ namespace BARNEY_NS {
 
   LocalContext::~LocalContext()
   {
-    /* not doing anything, but leave this in to ensure that derived
-       classes' destrcutors get called !*/
+    if (Timeline *timeline = Timeline::get())
+      Timeline::write(FromEnv::get()->timelineFile,
+                      timeline->toJson(0,timeline->created));
   }
 
   std::shared_ptr<barney_api::FrameBuffer> LocalContext::createFrameBuffer()
@@ -304,6 +312,21 @@ namespace BARNEY_NS {
     return numRaysActiveLocally();
   }
 
+  int LocalContext::maxRaysActiveGlobally()
+  {
+    return maxRaysActiveLocally();
+  }
+
+  float LocalContext::maxTimeGlobally(float time)
+  {
+    return time;
+  }
+
+  int LocalContext::maxGlobally(int value)
+  {
+    return value;
+  }
+
   void LocalContext::render(Renderer    *renderer,
                             GlobalModel *model,
                             Camera      *camera,
@@ -317,4 +340,14 @@ namespace BARNEY_NS {
     fb->finalizeFrame();
   }
 
+  void LocalContext::pick(GlobalModel *model,
+                          Camera *camera,
+                          vec2i numPixels,
+                          const vec2f *screenPos,
+                          int numPicks,
+                          BNPickResult *results)
+  {
+    pickLocally(model,camera,numPixels,screenPos,numPicks,results,true);
+  }
+
 }
@@ -22,11 +22,20 @@ namespace BARNEY_NS {
     { return "LocalFB{}"; }
 
     int numRaysActiveGlobally() override;
+    int maxRaysActiveGlobally() override;
+    float maxTimeGlobally(float time) override;
+    int maxGlobally(int value) override;
     
     void render(Renderer    *renderer,
                 GlobalModel *model,
                 Camera      *camera,
                 FrameBuffer *fb) override;
+    void pick(GlobalModel *model,
+              Camera *camera,
+              vec2i numPixels,
+              const vec2f *screenPos,
+              int numPicks,
+              BNPickResult *results) override;
 
     int myRank() override { return 0; }
     int mySize() override { return 1; }
@@ -4,10 +4,13 @@
 
 #include "barney/MPIContext.h"
 #include "barney/fb/DistFB.h"
+#include "barney/GlobalModel.h"
 #include "barney/render/RayQueue.h"
 #include "barney/globalTrace/RQSMPI.h"
 #include "barney/globalTrace/All2all.h"
 #include "barney/globalTrace/TwoStage.h"
+#include "barney/globalTrace/Transport.h"
+#include "barney/api/MappedFile.h"
 
 #if 0
 # define LOG_API_ENTRY std::cout << OWL_TERMINAL_BLUE << "#bn: " << __FUNCTION__ << OWL_TERMINAL_DEFAULT << std::endl;
@@ -40,7 +43,90 @@ namespace BARNEY_NS {
 
   
   MPIContext::~MPIContext()
-  {}
+  {
+    writeTimeline();
+    delete progress;
+    delete transport;
+    if (nodeLeaders.comm != MPI_COMM_NULL) nodeLeaders.free();
+    if (nodeComm.comm != MPI_COMM_NULL) nodeComm.free();
+  }
+
+  void MPIContext::readReplicated(const char *fileName,
+                                  size_t offset,
+                                  size_t numBytes,
+                                  const std::function<void(const void *)> &use)
+  {
+    if (nodeComm.comm == MPI_COMM_NULL) {
+      MPI_Comm shared;
+      BN_MPI_CALL(Comm_split_type(workers.comm,MPI_COMM_TYPE_SHARED,
+                                  workers.rank,MPI_INFO_NULL,&shared));
+      nodeComm = barney_api::mpi::Comm(shared);
+      MPI_Comm leaders;
+      BN_MPI_CALL(Comm_split(workers.comm,
+                             nodeComm.rank == 0 ? 0 : MPI_UNDEFINED,
+                             workers.rank,&leaders));
+      nodeLeaders = barney_api::mpi::Comm(leaders);
+    }
+    if (numBytes == 0) {
+      use(nullptr);
+      return;
+    }
+
+    /* one copy per node, in memory all of that node's ranks can see */
+    MPI_Win window;
+    uint8_t *nodeCopy = nullptr;
+    BN_MPI_CALL(Win_allocate_shared(nodeComm.rank == 0 ? (MPI_Aint)numBytes : 0,
+                                    1,MPI_INFO_NULL,nodeComm.comm,
+                                    &nodeCopy,&window));
+    if (nodeComm.rank != 0) {
+      MPI_Aint size;
+      int dispUnit;
+      BN_MPI_CALL(Win_shared_query(window,0,&size,&dispUnit,&nodeCopy));
+    }
+    std::exception_ptr error;
+    if (nodeComm.rank == 0) {
+      /* MPI counts are ints, so broadcast in chunks */
+      const size_t chunkSize = size_t(1)<<30;
+      std::unique_ptr<barney_api::MappedFile> file;
+      if (nodeLeaders.rank == 0)
+        try {
+          file.reset(new barney_api::MappedFile(fileName,offset,numBytes));
+        } catch (...) { error = std::current_exception(); }
+      /* everybody has to learn whether that worked, or they'd all
+         wait for a broadcast that never comes */
+      int ok = !error;
+      BN_MPI_CALL(Bcast(&ok,1,MPI_INT,0,nodeLeaders.comm));
+      if (ok)
+        for (size_t begin=0;begin<numBytes;begin+=chunkSize) {
+          const size_t size = std::min(chunkSize,numBytes-begin);
+          if (file) {
+            memcpy(nodeCopy+begin,file->data+begin,size);
+            file->release(begin,begin+size);
+          }
+          BN_MPI_CALL(Bcast(nodeCopy+begin,(int)size,MPI_BYTE,
+                            0,nodeLeaders.comm));
+        }
+      else if (!error)
+        error = std::make_exception_ptr
+          (std::runtime_error("#bn.mpi: could not read replicated file '"
+                              +std::string(fileName)+"' on first worker"));
+    }
+    int ok = !error;
+    BN_MPI_CALL(Bcast(&ok,1,MPI_INT,0,nodeComm.comm));
+    /* orders the leader's writes before everybody's reads */
+    BN_MPI_CALL(Win_fence(0,window));
+    if (ok)
+      try {
+        use(nodeCopy);
+      } catch (...) { if (!error) error = std::current_exception(); }
+    BN_MPI_CALL(Win_fence(0,window));
+    BN_MPI_CALL(Win_free(&window));
+    if (error)
+      std::rethrow_exception(error);
+    if (!ok)
+      throw std::runtime_error("#bn.mpi: could not read replicated file '"
+                               +std::string(fileName)+"'");
+  }
   
   WorkerTopo::SP
   MPIContext::makeTopo(const barney_api::mpi::Comm &worldComm,
@@ -57,6 +143,7 @@ namespace BARNEY_NS {
         dev.dataRank = ls.dataRank;
         dev.hostNameHash = getHostNameHash();
         dev.physicalDeviceHash = rtc::getPhysicalDeviceHash(gpuID);
+        dev.numaNode = rtc::getNumaNode(gpuID);
         devices.push_back(dev);
       }
     }
@@ -93,6 +180,9 @@ namespace BARNEY_NS {
       std::cerr << "#bn.mpi: WARNING - barney is run in 'true' data parallel mode" << std::endl;
       std::cerr << "#bn.mpi: but user did NOT provide an explicit list of GPU ID(s)." << std::endl;
     }
+    transport = RayTransport::create(this);
+    if (FromEnv::enabled("mpiProgress"))
+      progress = barney_api::mpi::ProgressThread::create(world);
     if (FromEnv::enabled("two-stage") || FromEnv::enabled("two_stage")) {
       std::cout << "ENABLING TwoStage!" << std::endl;
       globalTraceImpl = new TwoStage(this);
@@ -102,6 +192,70 @@ namespace BARNEY_NS {
     } else {
       globalTraceImpl = new RQSMPI(this);
     }
+    alignTimelineClocks();
+  }
+
+  void MPIContext::alignTimelineClocks()
+  {
+    Timeline *timeline = Timeline::get();
+    if (!timeline) return;
+    enum { NUM_ROUND_TRIPS = 8, TAG = 0x71 };
+    MPI_Request req;
+    if (world.rank == 0) {
+      for (int peer=1;peer<world.size;peer++)
+        for (int i=0;i<NUM_ROUND_TRIPS;i++) {
+          int ping;
+          world.recv(peer,TAG,&ping,1,req);
+          world.wait(req);
+          double now = getCurrentTime();
+          world.send(peer,TAG,&now,1,req);
+          world.wait(req);
+        }
+    } else {
+      double bestRoundTrip = INFINITY;
+      for (int i=0;i<NUM_ROUND_TRIPS;i++) {
+        int ping = i;
+        double sent = getCurrentTime();
+        world.send(0,TAG,&ping,1,req);
+        world.wait(req);
+        double theirs;
+        world.recv(0,TAG,&theirs,1,req);
+        world.wait(req);
+        double received = getCurrentTime();
+        if (received-sent >= bestRoundTrip) continue;
+        // assume the reply got sent half-way through the round trip
+        bestRoundTrip = received-sent;
+        timeline->clockOffset = theirs-.5*(sent+received);
+      }
+    }
+    timelineOrigin = timeline->created;
+    BN_MPI_CALL(Bcast(&timelineOrigin,1,MPI_DOUBLE,0,world.comm));
+  }
+
+  void MPIContext::writeTimeline()
+  {
+    Timeline *timeline = Timeline::get();
+    if (!timeline) return;
+    std::string ours = timeline->toJson(world.rank,timelineOrigin);
+    int ourSize = (int)ours.size();
+    std::vector<int> sizes(world.size,0);
+    BN_MPI_CALL(Gather(&ourSize,1,MPI_INT,
+                       sizes.data(),1,MPI_INT,0,world.comm));
+    std::vector<int> offsets(world.size,0);
+    for (int r=1;r<world.size;r++)
+      offsets[r] = offsets[r-1]+sizes[r-1];
+    std::string all(world.rank == 0 ? offsets.back()+sizes.back() : 0,' ');
+    BN_MPI_CALL(Gatherv(ours.data(),ourSize,MPI_CHAR,
+                        (char *)all.data(),sizes.data(),offsets.data(),
+                        MPI_CHAR,0,world.comm));
+    if (world.rank != 0) return;
+    std::string events;
+    for (int r=0;r<world.size;r++) {
+      if (sizes[r] == 0) continue;
+      if (!events.empty()) events += ",\n";
+      events += all.substr(offsets[r],sizes[r]);
+    }
+    Timeline::write(FromEnv::get()->timelineFile,events);
   }
   
   /*! create a frame buffer object suitable to this context */
@@ -115,10 +269,70 @@ namespace BARNEY_NS {
     devices and, where applicable, across all ranks */
   int MPIContext::numRaysActiveGlobally()
   {
+    NvtxRange nvtx("numRaysActiveGlobally");
     assert(isActiveWorker);
     return workers.allReduceAdd(numRaysActiveLocally());
   }
 
+  void MPIContext::startRaysActiveGlobally()
+  {
+    assert(isActiveWorker);
+    assert(raysActiveRequest == MPI_REQUEST_NULL);
+    raysActiveLocally = numRaysActiveLocally();
+    BN_MPI_CALL(Iallreduce(&raysActiveLocally,&raysActiveGlobally,1,
+                           MPI_INT,MPI_SUM,workers.comm,&raysActiveRequest));
+  }
+
+  int MPIContext::finishRaysActiveGlobally()
+  {
+    NvtxRange nvtx("finishRaysActiveGlobally");
+    assert(isActiveWorker);
+    BN_MPI_CALL(Wait(&raysActiveRequest,MPI_STATUS_IGNORE));
+    return raysActiveGlobally;
+  }
+
+  std::vector<box3f> MPIContext::gatherDomainBounds(GlobalModel *model)
+  {
+    /* devices are ordered by worker, so we can gather them in
+       global device order */
+    int numOurs = devices->size();
+    std::vector<box3f> ourBounds(numOurs);
+    for (int slot=0;slot<(int)perSlot.size();slot++)
+      for (auto device : *perSlot[slot].devices)
+        ourBounds[device->localRank()] = model->getSlot(slot)->domainBounds;
+    std::vector<box3f> allBounds(topo->allDevices.size());
+    std::vector<int> recvCounts(workers.size,0);
+    std::vector<int> recvOffsets(workers.size,0);
+    for (auto &dev : topo->allDevices)
+      recvCounts[dev.worker] += sizeof(box3f);
+    for (int w=1;w<workers.size;w++)
+      recvOffsets[w] = recvOffsets[w-1]+recvCounts[w-1];
+    BN_MPI_CALL(Allgatherv(ourBounds.data(),numOurs*sizeof(box3f),MPI_BYTE,
+                           allBounds.data(),recvCounts.data(),recvOffsets.data(),
+                           MPI_BYTE,workers.comm));
+    return allBounds;
+  }
+
+  int MPIContext::maxRaysActiveGlobally()
+  {
+    NvtxRange nvtx("maxRaysActiveGlobally");
+    assert(isActiveWorker);
+    return workers.allReduceMax(maxRaysActiveLocally());
+  }
+
+  float MPIContext::maxTimeGlobally(float time)
+  {
+    NvtxRange nvtx("maxTimeGlobally");
+    assert(isActiveWorker);
+    return workers.allReduceMax(time);
+  }
+
+  int MPIContext::maxGlobally(int value)
+  {
+    assert(isActiveWorker);
+    return workers.allReduceMax(value);
+  }
+
   
   void MPIContext::render(Renderer    *renderer,
                           GlobalModel *model,
@@ -127,6 +341,7 @@ namespace BARNEY_NS {
   {
     auto _context = this;
     DistFB *fb = (DistFB *)_fb;
+    barney_api::mpi::ProgressThread::Scope progressing(progress);
 
     // iw - todo check perf impact of this; check if a allgather and
     // local reduce would be faster
@@ -141,27 +356,52 @@ namespace BARNEY_NS {
     fb->finalizeFrame();
   }
 
+  void MPIContext::pick(GlobalModel *model,
+                        Camera *camera,
+                        vec2i numPixels,
+                        const vec2f *screenPos,
+                        int numPicks,
+                        BNPickResult *results)
+  {
+    barney_api::mpi::ProgressThread::Scope progressing(progress);
+    /* the first worker traces all pick rays; passive ranks (and all
+       other workers) get its results from there */
+    bool generated
+      = pickLocally(model,camera,numPixels,screenPos,numPicks,results,
+                    isActiveWorker && workers.rank == 0);
+    std::vector<int> allGenerated(world.size);
+    world.allGather(allGenerated.data(),(int)generated);
+    std::vector<BNPickResult> allResults(world.size*numPicks);
+    world.allGather(allResults.data(),results,numPicks,sizeof(BNPickResult));
+    for (int rank=0;rank<world.size;rank++)
+      if (allGenerated[rank]) {
+        std::copy(allResults.begin()+rank*numPicks,
+                  allResults.begin()+(rank+1)*numPicks,
+                  results);
+        break;
+      }
+  }
+
   extern "C" {
 # if BARNEY_RTC_EMBREE
     barney_api::Context *
     createMPIContext_embree(barney_api::mpi::Comm world,
-                            barney_api::mpi::Comm workers,
-                            bool isActiveWorker,
                             const std::vector<int> &dgIDs)
     {
       if (FromEnv::get()->logBackend)
         std::cout << "#bn: creating *embree (cpu)* context" << std::endl;
-      assert(dgIDs.size() == 1);
+      assert(dgIDs.size() <= 1);
       std::vector<LocalSlot> localSlots(dgIDs.size());
       for (int lsIdx=0;lsIdx<dgIDs.size();lsIdx++) {
         LocalSlot &slot = localSlots[lsIdx];
         slot.dataRank = dgIDs[lsIdx];
         slot.gpuIDs = { 0 };
       }
+      /* has to match how the gpu backends split the world, so cpu and
+         gpu ranks can work in the same context */
+      barney_api::mpi::Comm workers
+        = world.split(!isPassiveNode(localSlots));
       return new BARNEY_NS::MPIContext(world,workers,localSlots,false);
-      // std::vector<int> gpuIDs = { 0 }; 
-      // return new BARNEY_NS::MPIContext(world,workers,isActiveWorker,
-      //                                  dgIDs,gpuIDs);
     }
 # endif
 # if BARNEY_RTC_OPTIX
@@ -7,8 +7,10 @@
 #include <unistd.h>
 #include "barney/Context.h"
 #include "barney/common/MPIWrappers.h"
+#include "barney/common/MPIProgress.h"
 
 namespace BARNEY_NS {
+  struct RayTransport;
 
   /*! barney context for collaborative MPI-parallel rendering */
   struct MPIContext : public Context
@@ -31,6 +33,12 @@ namespace BARNEY_NS {
                 GlobalModel *model,
                 Camera      *camera,
                 FrameBuffer *fb) override;
+    void pick(GlobalModel *model,
+              Camera *camera,
+              vec2i numPixels,
+              const vec2f *screenPos,
+              int numPicks,
+              BNPickResult *results) override;
 
     /*! gives, for a given worker rank, the rank that this same rank
         has in the parent 'world' communicator */
@@ -48,6 +56,47 @@ namespace BARNEY_NS {
     /*! returns how many rays are active in all ray queues, across all
         devices and, where applicable, across all ranks */
     int numRaysActiveGlobally() override;
+    void startRaysActiveGlobally() override;
+    int finishRaysActiveGlobally() override;
+    /*! send and receive buffers of a pending startRaysActiveGlobally() */
+    int         raysActiveLocally = 0;
+    int         raysActiveGlobally = 0;
+    MPI_Request raysActiveRequest = MPI_REQUEST_NULL;
+    int maxRaysActiveGlobally() override;
+    float maxTimeGlobally(float time) override;
+    int maxGlobally(int value) override;
+
+    /*! reads a file that all workers share once per job rather than
+        once per rank: the first rank on each node gets a node-wide
+        shared-memory buffer, the very first worker maps the file and
+        broadcasts it (in chunks) to all other nodes' first ranks,
+        and then all ranks use() their node's copy. Collective over
+        'workers' */
+    void readReplicated(const char *fileName,
+                        size_t offset,
+                        size_t numBytes,
+                        const std::function<void(const void *)> &use) override;
+    /*! workers on this rank's node, and - on the first rank of each
+        node only - those first ranks of all nodes; created on first
+        use */
+    barney_api::mpi::Comm nodeComm;
+    barney_api::mpi::Comm nodeLeaders;
+
+    /*! gathers the domain bounds (as set through bnSetDomainBounds;
+        empty if never set) of all global devices' model slots, in
+        global device order. Has to be called on all workers */
+    std::vector<box3f> gatherDomainBounds(GlobalModel *model);
+
+    /*! if a timeline is being recorded, estimates how far this
+        rank's clock is off from rank 0's (from the fastest of a few
+        round trips, a la cristian) so all ranks' events line up.
+        Collective over 'world' */
+    void alignTimelineClocks();
+    /*! gathers all ranks' timeline events on rank 0, and writes
+        them out there. Collective over 'world' */
+    void writeTimeline();
+    /*! rank 0's time all timeline events are relative to */
+    double timelineOrigin = 0.;
 
     int myRank() override { return world.rank; }
     int mySize() override { return world.size; }
@@ -58,6 +107,12 @@ namespace BARNEY_NS {
     
     barney_api::mpi::Comm world;
     barney_api::mpi::Comm workers;
+    /*! what the global trace implementations use to move ray and
+        hit buffers between devices */
+    RayTransport *transport = nullptr;
+    /*! if enabled (BARNEY_CONFIG=mpiProgress=1), keeps outstanding
+        non-blocking MPI transfers moving while a frame renders */
+    barney_api::mpi::ProgressThread *progress = nullptr;
     // int numWorkers;
   };
 
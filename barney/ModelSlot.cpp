@@ -5,9 +5,12 @@
 #include "barney/ModelSlot.h"
 #include "barney/GlobalModel.h"
 #include "barney/common/Data.h"
+#include "barney/common/BuildLog.h"
 #include "barney/common/Texture.h"
 #include "barney/light/Light.h"
 #include "barney/geometry/Geometry.h"
+#include "barney/geometry/Triangles.h"
+#include <algorithm>
 
 namespace BARNEY_NS {
 
@@ -87,45 +90,117 @@ namespace BARNEY_NS {
       ;
   }
 
+  void ModelSlot::extractLights(int instID,
+                                std::vector<QuadLight::DD> &quadLights,
+                                std::vector<DirLight::DD> &dirLights,
+                                std::vector<PointLight::DD> &pointLights,
+                                std::pair<EnvMapLight::SP,affine3f> &envLight)
+  {
+    Group *group = instances.groups[instID].get();
+    if (!group)
+      return;
+    const affine3f &xfm = instances.xfms[instID];
+    // emissive meshes are area lights, too
+    for (auto &geom : group->geoms)
+      if (Triangles::SP triangles = geom ? geom->as<Triangles>() : Triangles::SP())
+        triangles->appendEmitters(quadLights,xfm);
+    if (!group->lights)
+      return;
+    for (auto &light : group->lights->items) {
+      if (!light)
+        continue;
+      if (QuadLight::SP quadLight = light->as<QuadLight>()) {
+        quadLights.push_back(quadLight->getDD(xfm));
+        continue;
+      }
+      if (DirLight::SP dirLight = light->as<DirLight>()) {
+        dirLights.push_back(dirLight->getDD(xfm));
+        continue;
+      }
+      if (PointLight::SP pointLight = light->as<PointLight>()) {
+        pointLights.push_back(pointLight->getDD(xfm));
+        continue;
+      }
+      if (EnvMapLight::SP el = light->as<EnvMapLight>()) {
+        envLight = {el, xfm};
+        continue;
+      }
+      throw std::runtime_error("un-handled type of light!?");
+    }
+  }
+  
   void ModelSlot::updateWorldLightsFromInstances()
   {
-    std::vector<QuadLight::DD> quadLights;
-    std::vector<DirLight::DD>  dirLights;
-    std::vector<PointLight::DD> pointLights;
+    auto &quadLights  = lightCache.quadLights;
+    auto &dirLights   = lightCache.dirLights;
+    auto &pointLights = lightCache.pointLights;
+    quadLights.clear();
+    dirLights.clear();
+    pointLights.clear();
     std::pair<EnvMapLight::SP,affine3f> envLight;
 
-    for (int i = 0; i < (int)instances.groups.size(); i++) {
-      Group *group = instances.groups[i].get();
-      if (!group || !group->lights)
-        continue;
-      for (auto &light : group->lights->items) {
-        if (!light)
-          continue;
-        if (QuadLight::SP quadLight = light->as<QuadLight>()) {
-          quadLights.push_back(quadLight->getDD(instances.xfms[i]));
-          continue;
-        }
-        if (DirLight::SP dirLight = light->as<DirLight>()) {
-          dirLights.push_back(dirLight->getDD(instances.xfms[i]));
-          continue;
-        }
-        if (PointLight::SP pointLight = light->as<PointLight>()) {
-          pointLights.push_back(pointLight->getDD(instances.xfms[i]));
-          continue;
-        }
-        if (EnvMapLight::SP el = light->as<EnvMapLight>()) {
-          envLight = {el, instances.xfms[i]};
-          continue;
-        }
-        throw std::runtime_error("un-handled type of light!?");
-      }
+    const int numInstances = (int)instances.groups.size();
+    lightCache.begin.resize(numInstances+1);
+    lightCache.envLightInstance = -1;
+    for (int i = 0; i < numInstances; i++) {
+      lightCache.begin[i] = vec3i((int)quadLights.size(),
+                                  (int)dirLights.size(),
+                                  (int)pointLights.size());
+      EnvMapLight::SP prevEnvLight = envLight.first;
+      extractLights(i,quadLights,dirLights,pointLights,envLight);
+      if (envLight.first != prevEnvLight)
+        lightCache.envLightInstance = i;
     }
+    lightCache.begin[numInstances] = vec3i((int)quadLights.size(),
+                                           (int)dirLights.size(),
+                                           (int)pointLights.size());
     world->set(envLight.first, envLight.second);
     world->set(quadLights);
     world->set(dirLights);
     world->set(pointLights);
   }
 
+  void ModelSlot::updateWorldLightsForInstances(const std::vector<int> &instIDs)
+  {
+    if (lightCache.begin.size() != instances.groups.size()+1)
+      return updateWorldLightsFromInstances();
+    
+    bool quadsChanged = false, dirsChanged = false, pointsChanged = false;
+    for (int instID : instIDs) {
+      const vec3i begin = lightCache.begin[instID];
+      const vec3i end   = lightCache.begin[instID+1];
+      if (begin == end && instID != lightCache.envLightInstance)
+        continue;
+      
+      std::vector<QuadLight::DD>  quadLights;
+      std::vector<DirLight::DD>   dirLights;
+      std::vector<PointLight::DD> pointLights;
+      std::pair<EnvMapLight::SP,affine3f> envLight;
+      extractLights(instID,quadLights,dirLights,pointLights,envLight);
+      if ((int)quadLights.size()  != end.x-begin.x ||
+          (int)dirLights.size()   != end.y-begin.y ||
+          (int)pointLights.size() != end.z-begin.z)
+        // eg, emissive triangles that got scaled down to nothing;
+        // everybody else's lights move around in the arrays
+        return updateWorldLightsFromInstances();
+
+      std::copy(quadLights.begin(),quadLights.end(),
+                lightCache.quadLights.begin()+begin.x);
+      std::copy(dirLights.begin(),dirLights.end(),
+                lightCache.dirLights.begin()+begin.y);
+      std::copy(pointLights.begin(),pointLights.end(),
+                lightCache.pointLights.begin()+begin.z);
+      quadsChanged  |= !quadLights.empty();
+      dirsChanged   |= !dirLights.empty();
+      pointsChanged |= !pointLights.empty();
+      if (instID == lightCache.envLightInstance)
+        world->set(envLight.first, envLight.second);
+    }
+    if (quadsChanged)  world->set(lightCache.quadLights);
+    if (dirsChanged)   world->set(lightCache.dirLights);
+    if (pointsChanged) world->set(lightCache.pointLights);
+  }
+
   void ModelSlot::flattenInstancesForDevice(Device *device,
                                             std::vector<rtc::Group *> *rtcGroups,
                                             std::vector<affine3f> &rtcTransforms,
@@ -135,6 +210,8 @@ namespace BARNEY_NS {
       Group *group = instances.groups[i].get();
       if (!group)
         continue;
+      if (i < (int)culledInstances.size() && culledInstances[i])
+        continue;
       Group::PLD *groupPLD = group->getPLD(device);
 
       auto append = [&](rtc::Group *rtcGroup) {
@@ -165,25 +242,137 @@ namespace BARNEY_NS {
     }
     std::copy(xfms, xfms + numInstances, instances.xfms.data());
 
+    if (computeCulledInstances() != culledInstances) {
+      // moved instances across the cut plane; different instances
+      // in the accels means re-flattening
+      build();
+      return;
+    }
+    
     updateWorldLightsFromInstances();
 
-    for (auto device : *devices) {
+    std::vector<affine3f> rtcTransforms(rtcInstanceSources.size());
+    for (size_t i=0;i<rtcInstanceSources.size();i++)
+      rtcTransforms[i] = instances.xfms[rtcInstanceSources[i]];
+    
+    devices->forEachDeviceInParallel([&](Device *device) {
       PLD *pld = getPLD(device);
       if (!pld->instanceGroup)
-        continue;
-
-      std::vector<affine3f> rtcTransforms;
-      flattenInstancesForDevice(device, nullptr, rtcTransforms, nullptr);
+        return;
 
+      MemoryScope memScope(device,BN_MEMORY_BVHS);
+      NvtxRange nvtx("refitInstanceAccel",device->globalRank());
       pld->instanceGroup->setTransforms(rtcTransforms);
       pld->instanceGroup->refitAccel();
+    });
+  }
+
+  void ModelSlot::updateInstanceTransformsSparse(const int *instIDs,
+                                                 const affine3f *xfms,
+                                                 int count)
+  {
+    const int numInstances = (int)instances.groups.size();
+    std::vector<int> moved;
+    for (int k=0;k<count;k++) {
+      int instID = instIDs[k];
+      if (instID < 0 || instID >= numInstances) {
+        std::cout << "#barney: ignoring transform update for non-existent instance "
+                  << instID << std::endl;
+        continue;
+      }
+      instances.xfms[instID] = xfms[k];
+      moved.push_back(instID);
+    }
+    // if an instance got listed more than once, its last transform wins
+    std::sort(moved.begin(),moved.end());
+    moved.erase(std::unique(moved.begin(),moved.end()),moved.end());
+    if (moved.empty())
+      return;
+
+    if (culledInstances.size() != (size_t)numInstances) {
+      // never built
+      build();
+      return;
+    }
+    for (int instID : moved)
+      if (isCulled(instID) != culledInstances[instID]) {
+        // moved instances across the cut plane; different instances
+        // in the accels means re-flattening
+        build();
+        return;
+      }
+
+    updateWorldLightsForInstances(moved);
+
+    // rtcInstanceSources is sorted, so each moved instance's rtc
+    // instances are one contiguous range in it
+    std::vector<int>      rtcInstIDs;
+    std::vector<affine3f> rtcTransforms;
+    for (int instID : moved) {
+      auto range = std::equal_range(rtcInstanceSources.begin(),
+                                    rtcInstanceSources.end(),
+                                    instID);
+      for (auto it = range.first; it != range.second; ++it) {
+        rtcInstIDs.push_back(int(it-rtcInstanceSources.begin()));
+        rtcTransforms.push_back(instances.xfms[instID]);
+      }
     }
+    if (rtcInstIDs.empty())
+      return;
+    
+    devices->forEachDeviceInParallel([&](Device *device) {
+      PLD *pld = getPLD(device);
+      if (!pld->instanceGroup)
+        return;
+
+      MemoryScope memScope(device,BN_MEMORY_BVHS);
+      NvtxRange nvtx("updateInstanceAccel",device->globalRank());
+      pld->instanceGroup->updateTransforms(rtcInstIDs,rtcTransforms);
+    });
   }
 
+  bool ModelSlot::isCulled(int instID) const
+  {
+    if (cutPlane.w <= -1e28f)
+      return false;
+    Group *group = instances.groups[instID].get();
+    if (!group || !group->boundsKnown || group->bounds.empty())
+      return false;
+    const vec3f N(cutPlane.x,cutPlane.y,cutPlane.z);
+    const box3f &box = group->bounds;
+    for (int c=0;c<8;c++) {
+      vec3f corner((c & 1) ? box.upper.x : box.lower.x,
+                   (c & 2) ? box.upper.y : box.lower.y,
+                   (c & 4) ? box.upper.z : box.lower.z);
+      vec3f P = xfmPoint(instances.xfms[instID],corner);
+      if (dot(N,P) + cutPlane.w >= 0.f)
+        return false;
+    }
+    return true;
+  }
+
+  std::vector<bool> ModelSlot::computeCulledInstances() const
+  {
+    std::vector<bool> culled(instances.groups.size(),false);
+    for (size_t i=0;i<instances.groups.size();i++)
+      culled[i] = isCulled((int)i);
+    return culled;
+  }
+
+  void ModelSlot::setCutPlane(const vec4f &plane)
+  {
+    if (plane == cutPlane)
+      return;
+    cutPlane = plane;
+    if (computeCulledInstances() != culledInstances)
+      build();
+  }
+  
   void ModelSlot::build()
   {
     // Keep light extraction identical to transform-only updates.
     updateWorldLightsFromInstances();
+    culledInstances = computeCulledInstances();
   
     // ==================================================================
     // generate all (per device) instance lists. note each BGGroup can
@@ -193,27 +382,58 @@ namespace BARNEY_NS {
     // ==================================================================
     
     std::vector<int>          inputInstIDs;
-    for (auto device : *devices) {
+    std::vector<std::vector<affine3f>>     rtcTransforms(devices->size());
+    std::vector<std::vector<rtc::Group *>> rtcGroups(devices->size());
+    for (size_t i=0;i<devices->size();i++)
+      flattenInstancesForDevice((*devices)[i],
+                                &rtcGroups[i],
+                                rtcTransforms[i],
+                                i == 0 ? &inputInstIDs : nullptr);
+
+    // flattening is cheap host work; the instance accel builds are
+    // what's worth overlapping across devices
+    devices->forEachDeviceInParallel([&](Device *device) {
       PLD *pld = getPLD(device);
-      std::vector<affine3f>     rtcTransforms;
-      std::vector<rtc::Group *> rtcGroups;
-      bool firstDevice = (device == (*devices)[0]);
-      flattenInstancesForDevice(device,
-                                &rtcGroups,
-                                rtcTransforms,
-                                firstDevice ? &inputInstIDs : nullptr);
-  
+      MemoryScope memScope(device,BN_MEMORY_BVHS);
+      NvtxRange nvtx("buildInstanceAccel",device->globalRank());
+      size_t i
+        = std::find(devices->begin(),devices->end(),device)-devices->begin();
+      BuildLog::Scope scope(BN_BUILD_INSTANCES,this,device,
+                            rtcTransforms[i].size());
       if (pld->instanceGroup) {
         device->rtc->freeGroup(pld->instanceGroup);
         pld->instanceGroup = 0;
       }
       pld->instanceGroup
-        = device->rtc->createInstanceGroup(rtcGroups,
+        = device->rtc->createInstanceGroup(rtcGroups[i],
                                            inputInstIDs,
-                                           rtcTransforms);
+                                           rtcTransforms[i]);
       if (pld->instanceGroup)
         pld->instanceGroup->buildAccel();
+    });
+    rtcInstanceSources = inputInstIDs;
+
+    // ==================================================================
+    // the (barney) instance to user instance ID table that both the
+    // instID frame buffer channel and the instance attributes go
+    // through; with it, instance attributes can stay where they are
+    // across rebuilds, and get changed in place (bnDataSetRange)
+    // ==================================================================
+    std::vector<int> userIDs;
+    PODData::SP ids = world->instanceUserIDs;
+    if (ids && ids->count) {
+      if (ids->type != BN_INT32 && ids->type != BN_UINT32)
+        std::cout << "#barney: ignoring 'instID' instance attribute that is"
+                  << " not an int array" << std::endl;
+      else {
+        std::vector<int> given(ids->count);
+        ids->download((*devices)[0],given.data());
+        userIDs.resize(instances.groups.size());
+        for (size_t i=0;i<userIDs.size();i++)
+          userIDs[i] = i < given.size() ? given[i] : (int)i;
+      }
     }
+    world->setInstIDToUserInstID(userIDs);
   }
 
 }
@@ -35,8 +35,24 @@ namespace BARNEY_NS {
                       const affine3f *xfms,
                       int numInstances);
     void updateInstanceTransforms(const affine3f *xfms, int numInstances);
+    /*! sets the transforms of only the listed instances; re-extracts
+        only their lights, and patches only their entries in the
+        instance accels */
+    void updateInstanceTransformsSparse(const int *instIDs,
+                                        const affine3f *xfms,
+                                        int count);
     void setInstanceAttributes(const std::string &which, const PODData::SP &data);
     void updateWorldLightsFromInstances();
+    /*! same as updateWorldLightsFromInstances(), for when only the
+        listed instances moved */
+    void updateWorldLightsForInstances(const std::vector<int> &instIDs);
+    /*! appends the world-space lights (and emissive triangles) of
+        given instance */
+    void extractLights(int instID,
+                       std::vector<QuadLight::DD> &quadLights,
+                       std::vector<DirLight::DD> &dirLights,
+                       std::vector<PointLight::DD> &pointLights,
+                       std::pair<EnvMapLight::SP,affine3f> &envLight);
     void flattenInstancesForDevice(Device *device,
                                    std::vector<rtc::Group *> *rtcGroups,
                                    std::vector<affine3f> &rtcTransforms,
@@ -62,8 +78,46 @@ namespace BARNEY_NS {
     PLD *getPLD(Device *device);
     std::vector<PLD> perLogical;
 
+    /*! for each rtc instance in (all devices') instance groups, the
+        index of the barney instance it was flattened from; computed
+        in build(), so transform-only updates can just gather the new
+        transforms without re-flattening, once for all devices */
+    std::vector<int> rtcInstanceSources;
+
+    /*! the lights last extracted from the instances, and where in
+        those each instance's own lights start */
+    struct {
+      std::vector<QuadLight::DD>  quadLights;
+      std::vector<DirLight::DD>   dirLights;
+      std::vector<PointLight::DD> pointLights;
+      /*! per instance (plus one past the last), index of its first
+          quad, dir, and point light */
+      std::vector<vec3i>          begin;
+      /*! the instance whose env-map light is the one in use, if any */
+      int                         envLightInstance = -1;
+    } lightCache;
+
     void build();
 
+    /*! culls all instances whose bounds lie entirely on the invisible
+        side of given cut plane (disabled if w <= -1e28) out of the
+        instance accels; rebuilds those only if that changes which
+        instances are in */
+    void setCutPlane(const vec4f &plane);
+    /*! per instance, whether it's on the invisible side of cutPlane */
+    std::vector<bool> computeCulledInstances() const;
+    /*! whether given instance is on the invisible side of cutPlane */
+    bool isCulled(int instID) const;
+    /*! cut plane the instance accels got last culled against */
+    vec4f cutPlane{0.f, 0.f, 0.f, -1e30f};
+    /*! per instance, whether it's currently culled (and thus not in
+        the instance accels) */
+    std::vector<bool> culledInstances;
+
+    /*! world-space bounds of this slot's content, as specified by
+        the app (bnSetDomainBounds); empty if never specified */
+    box3f domainBounds;
+
     // ------------------------------------------------------------------
     // do not change order of these:
     // ------------------------------------------------------------------
@@ -15,6 +15,7 @@ namespace BARNEY_NS {
       physicalHostIndexOf(devices.size()),
       physicalGpuIndexOf(devices.size()),
       rankOnHost(devices.size()),
+      ringRankOf(devices.size(),-1),
       myOffset(myOffset),
       myCount(myCount),
       _worldRank(devices[myOffset].worldRank)
@@ -64,6 +65,24 @@ namespace BARNEY_NS {
     assert(islands.size() > 0);
     for (auto &island : islands) assert(island.size() == islands[0].size());
 
+    /* sort each island's devices by host->numa node->pci address,
+       with gid last to break ties between oversubscribed gpus */
+    for (auto &island : islands) {
+      std::vector<std::tuple</*host*/int,/*numa*/int,/*pci*/size_t,/*gid*/int>> order;
+      for (auto gid : island)
+        order.push_back({physicalHostIndexOf[gid],
+                         allDevices[gid].numaNode,
+                         allDevices[gid].physicalDeviceHash,
+                         gid});
+      std::sort(order.begin(),order.end());
+      std::vector<int> ring;
+      for (auto &o : order) {
+        ringRankOf[std::get<3>(o)] = (int)ring.size();
+        ring.push_back(std::get<3>(o));
+      }
+      rings.push_back(ring);
+    }
+
     std::string tag = "#bn.topo("+std::to_string(_worldRank)+")";
     if (FromEnv::get()->logTopo) {
       std::stringstream ss; 
@@ -105,6 +124,8 @@ namespace BARNEY_NS {
     ss << " island=" << islandOf[gid] << "(rank " << islandRankOf[gid] << ")";
     ss << " hostIdx=" << physicalHostIndexOf[gid];
     ss << " gpuIdx=" << physicalGpuIndexOf[gid];
+    ss << " numa=" << dev.numaNode;
+    ss << " ring=" << ringRankOf[gid];
     // ss << " host:gpuOfs=" << physicalHostIndexOf[gid] << ":" << physicalDeviceIndexOf[gid];
     ss << " phys=" << (int*)dev.hostNameHash << ":" << (int*)dev.physicalDeviceHash;
     return ss.str();
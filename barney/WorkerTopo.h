@@ -40,6 +40,10 @@ namespace BARNEY_NS {
           with same hostnamehash and same physicalDeviceHash WILL mean
           that that gpu is oversubscribed */
       size_t physicalDeviceHash;
+
+      /*! the numa node (cpu socket) that this gpu is attached to, or
+          -1 if unknown */
+      int numaNode;
     };
     WorkerTopo(const std::vector<Device> &devices,
                int myOffset, int myCount);
@@ -85,6 +89,18 @@ namespace BARNEY_NS {
     /*! gives, for each logical device, the how many'eth device in its
       island it is */
     std::vector<int> islandRankOf;
+
+    /*! for each island, the order in which ray queue cycling should
+        pass rays around that island's devices: grouped by host (so
+        there's only one cross-host hop per host), within each host
+        by numa node, and within that by pci address (which tends to
+        put gpus behind the same pcie switch or nvlink bridge next
+        to each other) */
+    std::vector<std::vector<int>> rings;
+
+    /*! gives, for each logical device, its position in its island's
+        ring */
+    std::vector<int> ringRankOf;
     
     
     int worldRank() const { return _worldRank; }
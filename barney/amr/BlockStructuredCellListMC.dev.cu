@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText:
+// Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier:
+// Apache-2.0
+
+/*! \file BlockStructuredCellListMC.dev.cu implements a macro-cell
+    accelerated block-structured amr data type.
+
+    This particular voluem type:
+
+    - uses per-cell lists of overlapping blocks to accelerate
+      point-in-block queries (for the scalar field evaluation)
+
+    - uses macro cells and DDA traversal for domain traversal
+*/
+
+#include "barney/amr/BlockStructuredCellListSampler.h"
+#include "barney/volume/DDA.h"
+#include "rtcore/TraceInterface.h"
+
+RTC_DECLARE_GLOBALS(BARNEY_NS::render::OptixGlobals);
+
+namespace BARNEY_NS {
+
+  struct BlockStructuredCellListMC_Programs {
+    
+    static inline __rtc_device
+    void bounds(const rtc::TraceInterface &ti,
+                const void *geomData,
+                owl::common::box3f &bounds,  
+                const int32_t primID)
+    {
+#if RTC_DEVICE_CODE
+      MCVolumeAccel<BlockStructuredCellListSampler>::boundsProg(ti,geomData,bounds,primID);
+#endif
+    }
+
+    static inline __rtc_device
+    void intersect(rtc::TraceInterface &ti)
+    {
+#if RTC_DEVICE_CODE
+      MCVolumeAccel<BlockStructuredCellListSampler>::isProg(ti);
+#endif
+    }
+    
+    static inline __rtc_device
+    void closestHit(rtc::TraceInterface &ti)
+    { /* nothing to do */ }
+    
+    static inline __rtc_device
+    void anyHit(rtc::TraceInterface &ti)
+    { /* nothing to do */ }
+  };
+
+  using BlockStructuredCellListMC = MCVolumeAccel<BlockStructuredCellListSampler>;
+
+  RTC_EXPORT_USER_GEOM(BlockStructuredCellListMC,
+                       BlockStructuredCellListMC::DD,
+                       BlockStructuredCellListMC_Programs,
+                       false,false);
+}
+
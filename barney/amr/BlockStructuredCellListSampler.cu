@@ -0,0 +1,207 @@
+// SPDX-FileCopyrightText:
+// Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier:
+// Apache-2.0
+
+
+#include "rtcore/ComputeInterface.h"
+#include "barney/amr/BlockStructuredCellListSampler.h"
+
+namespace BARNEY_NS {
+
+  BlockStructuredCellListSampler
+  ::BlockStructuredCellListSampler(BlockStructuredField *field)
+    : field(field),
+      devices(field->devices)
+  {
+    perLogical.resize(devices->numLogical);
+  }
+
+  BlockStructuredCellListSampler::~BlockStructuredCellListSampler()
+  {
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      if (pld->cellBegin) device->rtc->freeMem(pld->cellBegin);
+      if (pld->blockIDs)  device->rtc->freeMem(pld->blockIDs);
+      pld->cellBegin = 0;
+      pld->blockIDs  = 0;
+    }
+  }
+
+  BlockStructuredCellListSampler::PLD *
+  BlockStructuredCellListSampler::getPLD(Device *device)
+  {
+    assert(device);
+    assert(device->contextRank() >= 0);
+    assert(device->contextRank() < perLogical.size());
+    return &perLogical[device->contextRank()];
+  }
+
+  BlockStructuredCellListSampler::DD
+  BlockStructuredCellListSampler::getDD(Device *device)
+  {
+    DD dd;
+    (BlockStructuredField::DD &)dd = field->getDD(device);
+    PLD *pld = getPLD(device);
+    dd.cellDims    = cellDims;
+    dd.cellOrigin  = cellGridBounds.lower;
+    dd.rcpCellSize = vec3f(cellDims) * rcp(cellGridBounds.size());
+    dd.cellBegin   = pld->cellBegin;
+    dd.blockIDs    = pld->blockIDs;
+    return dd;
+  }
+
+  __rtc_global
+  void BSCellList_minBlockSize(const rtc::ComputeInterface &ci,
+                               const box3f *primBounds,
+                               int numBlocks,
+                               float *d_minSize)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= numBlocks) return;
+    rtc::fatomicMin(d_minSize,reduce_min(primBounds[tid].size()));
+#endif
+  }
+
+  /*! range of cells that given block's filter domain overlaps */
+  inline __rtc_device
+  void BSCellList_cellRange(vec3i &lo, vec3i &hi,
+                            box3f domain,
+                            vec3i cellDims,
+                            vec3f cellOrigin,
+                            vec3f rcpCellSize)
+  {
+    lo = vec3i((domain.lower-cellOrigin)*rcpCellSize);
+    hi = vec3i((domain.upper-cellOrigin)*rcpCellSize);
+    lo = min(max(lo,vec3i(0)),cellDims-vec3i(1));
+    hi = min(max(hi,vec3i(0)),cellDims-vec3i(1));
+  }
+
+  __rtc_global
+  void BSCellList_countBlocks(const rtc::ComputeInterface &ci,
+                              const box3f *primBounds,
+                              int numBlocks,
+                              vec3i cellDims,
+                              vec3f cellOrigin,
+                              vec3f rcpCellSize,
+                              int *cellCounts)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= numBlocks) return;
+    vec3i lo, hi;
+    BSCellList_cellRange(lo,hi,primBounds[tid],cellDims,cellOrigin,rcpCellSize);
+    for (int iz=lo.z;iz<=hi.z;iz++)
+      for (int iy=lo.y;iy<=hi.y;iy++)
+        for (int ix=lo.x;ix<=hi.x;ix++)
+          ci.atomicAdd(&cellCounts[ix+cellDims.x*(iy+cellDims.y*iz)],1);
+#endif
+  }
+
+  __rtc_global
+  void BSCellList_writeBlocks(const rtc::ComputeInterface &ci,
+                              const box3f *primBounds,
+                              int numBlocks,
+                              vec3i cellDims,
+                              vec3f cellOrigin,
+                              vec3f rcpCellSize,
+                              int *cellCursors,
+                              int *blockIDs)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= numBlocks) return;
+    vec3i lo, hi;
+    BSCellList_cellRange(lo,hi,primBounds[tid],cellDims,cellOrigin,rcpCellSize);
+    for (int iz=lo.z;iz<=hi.z;iz++)
+      for (int iy=lo.y;iy<=hi.y;iy++)
+        for (int ix=lo.x;ix<=hi.x;ix++) {
+          int pos = ci.atomicAdd(&cellCursors[ix+cellDims.x*(iy+cellDims.y*iz)],1);
+          blockIDs[pos] = tid;
+        }
+#endif
+  }
+
+  void BlockStructuredCellListSampler::build()
+  {
+    int numBlocks = field->numBlocks;
+    for (auto device : *devices) {
+      PLD *pld = getPLD(device);
+      if (pld->cellBegin != nullptr) {
+        /* cell lists already built! */
+        continue;
+      }
+      SetActiveGPU forDuration(device);
+      auto rtc = device->rtc;
+
+      box3f *primBounds
+        = (box3f*)rtc->allocMem(numBlocks*sizeof(box3f));
+      field->computeElementBBs(device,primBounds,nullptr);
+
+      const int bs = 128;
+      const int nb = divRoundUp(numBlocks,bs);
+      if (cellDims == vec3i(0)) {
+        // choose cells about as wide as the finest blocks' domains,
+        // so those overlap only a few cells each, and each cell only
+        // a few blocks
+        cellGridBounds = getBox(field->worldBounds);
+        float minBlockSize = reduce_max(cellGridBounds.size());
+        float *d_minSize = (float*)rtc->allocMem(sizeof(float));
+        rtc->copy(d_minSize,&minBlockSize,sizeof(float));
+        __rtc_launch(rtc,BSCellList_minBlockSize,nb,bs,
+                     primBounds,numBlocks,d_minSize);
+        rtc->copy(&minBlockSize,d_minSize,sizeof(float));
+        rtc->freeMem(d_minSize);
+
+        float maxWidth  = reduce_max(cellGridBounds.size());
+        float cellWidth = max(minBlockSize,maxWidth/maxCellsPerDim);
+        cellDims = max(vec3i(1),vec3i(cellGridBounds.size()/cellWidth));
+        cellDims = min(cellDims,vec3i(maxCellsPerDim));
+      }
+      size_t numCells = owl::common::volume(cellDims);
+      vec3f rcpCellSize = vec3f(cellDims) * rcp(cellGridBounds.size());
+
+      // count blocks per cell, in the first numCells entries
+      pld->cellBegin = (int*)rtc->allocMem((numCells+1)*sizeof(int));
+      rtc->memsetAsync(pld->cellBegin,0,(numCells+1)*sizeof(int));
+      __rtc_launch(rtc,BSCellList_countBlocks,nb,bs,
+                   primBounds,numBlocks,
+                   cellDims,cellGridBounds.lower,rcpCellSize,
+                   pld->cellBegin);
+
+      // turn counts into offsets; this is a one-time build, so doing
+      // the scan on the host is good enough
+      std::vector<int> offsets(numCells+1);
+      rtc->copy(offsets.data(),pld->cellBegin,numCells*sizeof(int));
+      int sum = 0;
+      for (size_t i=0;i<numCells;i++) {
+        int count = offsets[i];
+        offsets[i] = sum;
+        sum += count;
+      }
+      offsets[numCells] = sum;
+      rtc->copy(pld->cellBegin,offsets.data(),(numCells+1)*sizeof(int));
+
+      int *cellCursors = (int*)rtc->allocMem(numCells*sizeof(int));
+      rtc->copy(cellCursors,offsets.data(),numCells*sizeof(int));
+      pld->blockIDs = (int*)rtc->allocMem(std::max(sum,1)*sizeof(int));
+      __rtc_launch(rtc,BSCellList_writeBlocks,nb,bs,
+                   primBounds,numBlocks,
+                   cellDims,cellGridBounds.lower,rcpCellSize,
+                   cellCursors,pld->blockIDs);
+      rtc->sync();
+      rtc->freeMem(cellCursors);
+      rtc->freeMem(primBounds);
+
+      std::cout << OWL_TERMINAL_LIGHT_GREEN
+                << "#bn.bsfield: cell lists built, "
+                << cellDims << " cells, "
+                << prettyNumber(sum) << " block refs"
+                << OWL_TERMINAL_DEFAULT << std::endl;
+    }
+  }
+
+}
+
@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText:
+// Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier:
+// Apache-2.0
+
+
+#pragma once
+
+#include "barney/amr/BlockStructuredField.h"
+#include "barney/volume/MCAccelerator.h"
+
+namespace BARNEY_NS {
+
+  struct BlockStructuredField;
+
+  /*! a block structured amr scalar field sampler that, rather than
+      doing a bvh query per sample, precomputes - for each cell of a
+      uniform grid over the field - the list of blocks whose filter
+      domains overlap that cell. Sampling then is a cell lookup,
+      followed by evaluating only that (usually short) list of
+      blocks */
+  struct BlockStructuredCellListSampler : public ScalarFieldSampler {
+
+    struct DD : public BlockStructuredField::DD {
+#if RTC_DEVICE_CODE
+      inline __rtc_device float sample(vec3f P, bool dbg = false) const;
+#endif
+      vec3i        cellDims;
+      vec3f        cellOrigin;
+      vec3f        rcpCellSize;
+      /*! numCells+1 offsets into blockIDs; cell i's blocks are
+          blockIDs[cellBegin[i]..cellBegin[i+1]) */
+      const int   *cellBegin;
+      const int   *blockIDs;
+    };
+    DD getDD(Device *device);
+
+    /*! per-device data - parent stores the bs-amr field, we just
+      store the cell lists */
+    struct PLD {
+      int *cellBegin = 0;
+      int *blockIDs  = 0;
+    };
+    PLD *getPLD(Device *device);
+    std::vector<PLD> perLogical;
+
+    BlockStructuredCellListSampler(BlockStructuredField *field);
+    ~BlockStructuredCellListSampler();
+
+    /*! builds the string that allows for properly matching optix
+      device progs for this type */
+    inline static std::string typeName() { return "BlockStructured_CellList"; }
+
+    void build() override;
+
+    /*! max cells per dimension of the cell list grid; the actual
+        grid is coarser if the finest blocks are larger than that */
+    enum { maxCellsPerDim = 256 };
+
+    vec3i cellDims { 0,0,0 };
+    box3f cellGridBounds;
+    BlockStructuredField *const field;
+    const DevGroup::SP devices;
+  };
+
+#if RTC_DEVICE_CODE
+  inline __rtc_device
+  float BlockStructuredCellListSampler::DD::sample(vec3f P, bool dbg) const
+  {
+    vec3i cellID = vec3i((P-cellOrigin)*rcpCellSize);
+    cellID = min(max(cellID,vec3i(0)),cellDims-vec3i(1));
+    int cellIdx = cellID.x+cellDims.x*(cellID.y+cellDims.y*cellID.z);
+    int begin = cellBegin[cellIdx];
+    int end   = cellBegin[cellIdx+1];
+
+    float sumWeights = 0.f;
+    float sumWeightedValues = 0.f;
+    for (int i=begin;i<end;i++)
+      addBasisFunctions(sumWeightedValues,sumWeights,blockIDs[i],P);
+    return sumWeights == 0.f ? NAN : (sumWeightedValues  / sumWeights);
+  }
+#endif
+}
+
+
@@ -5,6 +5,7 @@
 
 
 #include "barney/amr/BlockStructuredCuBQLSampler.h"
+#include "barney/common/AccelCache.h"
 
 namespace BARNEY_NS {
 
@@ -57,6 +58,17 @@ namespace BARNEY_NS {
         = (range1f*)device->rtc->allocMem(numPrims*sizeof(range1f));
       field->computeElementBBs(device,primBounds,valueRanges);
       device->rtc->sync();
+
+      uint64_t cacheKey = 0;
+      if (AccelCache::enabled()) {
+        cacheKey = AccelCache::keyFor(device,primBounds,numPrims,
+                                      typeName());
+        if (AccelCache::loadBVH(device,"bsCuBQL",cacheKey,bvh)) {
+          device->rtc->freeMem(primBounds);
+          device->rtc->freeMem(valueRanges);
+          continue;
+        }
+      }
 #if BARNEY_RTC_EMBREE || defined(__HIPCC__)
       cuBQL::cpu::spatialMedian(bvh,
                                 (const cuBQL::box_t<float,3>*)primBounds,
@@ -74,6 +86,8 @@ namespace BARNEY_NS {
                         memResource);
 #endif
       device->rtc->sync();
+      if (AccelCache::enabled())
+        AccelCache::storeBVH(device,"bsCuBQL",cacheKey,bvh);
       device->rtc->freeMem(primBounds);
       device->rtc->freeMem(valueRanges);
     
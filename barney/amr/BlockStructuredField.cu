@@ -10,6 +10,7 @@
 #include "barney/Context.h"
 #include "barney/volume/MCGrid.cuh"
 #include "barney/amr/BlockStructuredCuBQLSampler.h"
+#include "barney/amr/BlockStructuredCellListSampler.h"
 
 namespace BARNEY_NS {
 
@@ -17,6 +18,10 @@ namespace BARNEY_NS {
                        /*name*/BlockStructuredMC,
                        /*geomtype device data */
                        MCVolumeAccel<BlockStructuredCuBQLSampler>::DD,false,false);
+  RTC_IMPORT_USER_GEOM(/*file*/BlockStructuredCellListMC,
+                       /*name*/BlockStructuredCellListMC,
+                       /*geomtype device data */
+                       MCVolumeAccel<BlockStructuredCellListSampler>::DD,false,false);
 
   enum { MC_GRID_SIZE = 256 };
 
@@ -41,33 +46,70 @@ namespace BARNEY_NS {
 
     vec3i numCells = block.dims;
 
-    const box3f worldBox = getBox(field.worldBounds);
+    // consecutive cells mostly fall into the same macro cell(s), so
+    // rather than doing atomics for each cell, accumulate the value
+    // range for as long as the covered cells stay the same, and only
+    // write that out when they change
+    vec3i   currLo(-1), currHi(-1);
+    range1f currRange;
+    auto flush = [&]() {
+      if (currRange.lower > currRange.upper) return;
+      for (int iz=currLo.z;iz<=currHi.z;iz++)
+        for (int iy=currLo.y;iy<=currHi.y;iy++)
+          for (int ix=currLo.x;ix<=currHi.x;ix++) {
+            const size_t cellID
+              = ix
+              + iy * (size_t)grid.dims.x
+              + iz * (size_t)grid.dims.x * (size_t)grid.dims.y;
+            auto &cell = grid.scalarRanges[cellID];
+            rtc::fatomicMin(&cell.lower,currRange.lower);
+            rtc::fatomicMax(&cell.upper,currRange.upper);
+          }
+    };
+    const vec3f rcpSpacing = rcp(grid.gridSpacing);
     for (int z=0;z<numCells.z;z++) {
       for (int y=0;y<numCells.y;y++) {
         for (int x=0;x<numCells.x;x++) {
           const box3f cb3 = block.cellBounds({x,y,z});
           const float scalar = block.getScalar({x,y,z});
-          const box4f cellBounds(vec4f(cb3.lower,scalar),
-                                 vec4f(cb3.upper,scalar));
-          rasterBox(grid,worldBox,cellBounds);
+          vec3i lo = vec3i((cb3.lower-grid.gridOrigin)*rcpSpacing);
+          vec3i hi = vec3i((cb3.upper-grid.gridOrigin)*rcpSpacing);
+          lo = min(max(lo,vec3i(0)),grid.dims-vec3i(1));
+          hi = min(max(hi,vec3i(0)),grid.dims-vec3i(1));
+          if (lo != currLo || hi != currHi) {
+            flush();
+            currLo = lo;
+            currHi = hi;
+            currRange = range1f();
+          }
+          currRange.extend(scalar);
         }
       }
     }
+    flush();
 #endif
   }
   
+  /*! each thread computes the bounds of blocksPerThread consecutive
+      blocks, and only then does the atomics; with one atomic per
+      block all threads would fight over the same few words, which is
+      particularly bad on the cpu backend */
   __rtc_global
   void computeWorldBounds(const rtc::ComputeInterface &ci,
                           box3f *pBounds,
-                          const BlockStructuredField::DD dd)
+                          const BlockStructuredField::DD dd,
+                          int blocksPerThread)
   {
 #if RTC_DEVICE_CODE
     int tid = ci.launchIndex().x;
-    if (tid >= dd.numBlocks)
+    int begin = tid*blocksPerThread;
+    int end   = min(begin+blocksPerThread,dd.numBlocks);
+    if (begin >= end)
       return;
 
-    Block block = Block::getFrom(dd,tid);
-    box3f bb = block.getDomain();
+    box3f bb;
+    for (int blockID=begin;blockID<end;blockID++)
+      bb.extend(Block::getFrom(dd,blockID).getDomain());
     rtc::fatomicMin(&pBounds->lower.x,bb.lower.x);
     rtc::fatomicMin(&pBounds->lower.y,bb.lower.y);
     rtc::fatomicMin(&pBounds->lower.z,bb.lower.z);
@@ -120,7 +162,9 @@ namespace BARNEY_NS {
   
 
   BlockStructuredField::~BlockStructuredField()
-  {}
+  {
+    freeCompact();
+  }
     
 
   
@@ -129,6 +173,8 @@ namespace BARNEY_NS {
     : ScalarField(context,devices)
   {
     perLogical.resize(devices->numLogical);
+    compactBlocks = FromEnv::enabled("amrCompact");
+    halfScalars   = FromEnv::enabled("amrHalfScalars");
   }
 
   BlockStructuredField::DD BlockStructuredField::getDD(Device *device)
@@ -138,14 +184,26 @@ namespace BARNEY_NS {
     // inherited:
     (ScalarField::DD &)dd = ScalarField::getDD(device);
     
+    // any of these may have been dropped in favor of their compact
+    // versions
     dd.perBlock.origins = (const vec3i *)perBlock.origins->getDD(device);
-    dd.perBlock.dims    = (const vec3i *)perBlock.dims->getDD(device);
-    dd.perBlock.levels  = (const int   *)perBlock.levels->getDD(device);
-    dd.perBlock.offsets = (const uint64_t *)perBlock.offsets->getDD(device);
+    dd.perBlock.dims
+      = perBlock.dims ? (const vec3i *)perBlock.dims->getDD(device) : nullptr;
+    dd.perBlock.levels
+      = perBlock.levels ? (const int *)perBlock.levels->getDD(device) : nullptr;
+    dd.perBlock.offsets
+      = perBlock.offsets ? (const uint64_t *)perBlock.offsets->getDD(device) : nullptr;
 
     dd.perLevel.refinements = (const int *)perLevel.refinements->getDD(device);
     
-    dd.scalars      = (const float *)scalars->getDD(device);
+    dd.scalars
+      = scalars ? (const float *)scalars->getDD(device) : nullptr;
+
+    PLD *pld = getPLD(device);
+    dd.compact.dims     = pld->compact.dims;
+    dd.compact.levels   = pld->compact.levels;
+    dd.compact.offsets  = pld->compact.offsets;
+    dd.compact.scalars  = pld->compact.scalars;
     
     dd.numBlocks    = (int)perBlock.origins->count;
 
@@ -154,6 +212,16 @@ namespace BARNEY_NS {
 
   VolumeAccel::SP BlockStructuredField::createAccel(Volume *volume)
   {
+    if (!FromEnv::enabled("amrCuBQL")) {
+      auto sampler
+        = std::make_shared<BlockStructuredCellListSampler>(this);
+      return std::make_shared<MCVolumeAccel<BlockStructuredCellListSampler>>
+        (volume,
+         createGeomType_BlockStructuredCellListMC,
+         sampler);
+    }
+    // alternatively, a bvh over the blocks; slower to sample, but
+    // doesn't need any per-cell lists
     auto sampler
       = std::make_shared<BlockStructuredCuBQLSampler>(this);
     return std::make_shared<MCVolumeAccel<BlockStructuredCuBQLSampler>>
@@ -223,6 +291,143 @@ namespace BARNEY_NS {
     device->sync();
   }
 
+  __rtc_global
+  void BSField_compactBlocks(const rtc::ComputeInterface &ci,
+                             BlockStructuredField::DD field,
+                             uint32_t *dims,
+                             uint8_t  *levels,
+                             uint32_t *offsets,
+                             int      *d_numOverflows)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= field.numBlocks) return;
+
+    vec3i blockDims = field.perBlock.dims[tid];
+    int   level     = field.perBlock.levels[tid];
+    if (reduce_max(blockDims) > 1023 || level > 255)
+      ci.atomicAdd(d_numOverflows,1);
+    dims[tid]    = blockDims.x | (blockDims.y << 10) | (blockDims.z << 20);
+    levels[tid]  = (uint8_t)level;
+    offsets[tid] = (uint32_t)field.perBlock.offsets[tid];
+#endif
+  }
+
+  __rtc_global
+  void BSField_halfScalars(const rtc::ComputeInterface &ci,
+                           const float *scalars,
+                           half *halfScalars,
+                           int numScalars)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= numScalars) return;
+    halfScalars[tid] = to_half(scalars[tid]);
+#endif
+  }
+
+  void BlockStructuredField::freeCompact()
+  {
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      auto &compact = getPLD(device)->compact;
+      if (compact.dims)    device->rtc->freeMem(compact.dims);
+      if (compact.levels)  device->rtc->freeMem(compact.levels);
+      if (compact.offsets) device->rtc->freeMem(compact.offsets);
+      if (compact.scalars) device->rtc->freeMem(compact.scalars);
+      compact.dims    = 0;
+      compact.levels  = 0;
+      compact.offsets = 0;
+      compact.scalars = 0;
+    }
+  }
+
+  void BlockStructuredField::buildCompact()
+  {
+    freeCompact();
+    size_t numScalars = scalars->count;
+    bool doBlocks
+      = compactBlocks
+      // 32-bit offsets can only address that many scalars
+      && numScalars <= (size_t)0xffffffffu;
+    bool doScalars
+      = halfScalars
+      && numScalars <= (size_t)0x7fffffff;
+    if (!doBlocks && !doScalars) return;
+
+    int numOverflows = 0;
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      auto rtc = device->rtc;
+      auto dd = getDD(device);
+      auto &compact = getPLD(device)->compact;
+      if (doBlocks) {
+        compact.dims    = (uint32_t*)rtc->allocMem(numBlocks*sizeof(uint32_t));
+        compact.levels  = (uint8_t *)rtc->allocMem(numBlocks*sizeof(uint8_t));
+        compact.offsets = (uint32_t*)rtc->allocMem(numBlocks*sizeof(uint32_t));
+        int *d_numOverflows = (int*)rtc->allocMem(sizeof(int));
+        rtc->memsetAsync(d_numOverflows,0,sizeof(int));
+        __rtc_launch(rtc,BSField_compactBlocks,
+                     divRoundUp(numBlocks,128),128,
+                     dd,compact.dims,compact.levels,compact.offsets,
+                     d_numOverflows);
+        rtc->copy(&numOverflows,d_numOverflows,sizeof(int));
+        rtc->freeMem(d_numOverflows);
+      }
+      if (doScalars) {
+        compact.scalars = (half*)rtc->allocMem(numScalars*sizeof(half));
+        __rtc_launch(rtc,BSField_halfScalars,
+                     divRoundUp((int)numScalars,1024),1024,
+                     dd.scalars,compact.scalars,(int)numScalars);
+      }
+      rtc->sync();
+    }
+    if (numOverflows) {
+      std::cout << OWL_TERMINAL_YELLOW
+                << "#bn.amr: WARNING - block dims/levels too large for "
+                << "compact blocks, using full-size arrays"
+                << OWL_TERMINAL_DEFAULT << std::endl;
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        auto &compact = getPLD(device)->compact;
+        device->rtc->freeMem(compact.dims);
+        device->rtc->freeMem(compact.levels);
+        device->rtc->freeMem(compact.offsets);
+        compact.dims    = 0;
+        compact.levels  = 0;
+        compact.offsets = 0;
+      }
+      doBlocks = false;
+    }
+    // the compact versions replace the originals, so we no longer
+    // keep those alive
+    if (doBlocks) {
+      perBlock.dims    = 0;
+      perBlock.levels  = 0;
+      perBlock.offsets = 0;
+    }
+    if (doScalars)
+      scalars = 0;
+  }
+
+  bool BlockStructuredField::set1i(const std::string &member,
+                                   const int &value)
+  {
+    if (member == "compactBlocks") {
+      compactBlocks = value;
+      return true;
+    }
+    if (member == "halfScalars") {
+      halfScalars = value;
+      return true;
+    }
+    if (member == "managedMemory") {
+      managedMemory = value;
+      return true;
+    }
+    return false;
+  }
+
   bool BlockStructuredField::setData(const std::string &member,
                                      const std::shared_ptr<Data> &value)
   {
@@ -258,6 +463,17 @@ namespace BARNEY_NS {
   
   void BlockStructuredField::commit()
   {
+    MemoryScope memScope(devices.get(),BN_MEMORY_VOLUME_FIELDS);
+    auto &compact = getPLD((*devices)[0])->compact;
+    if ((compact.dims && !perBlock.dims) || (compact.scalars && !scalars))
+      // already compacted; the app would have to set all arrays
+      // again for us to rebuild
+      return;
+    freeCompact();
+    if (managedMemory && scalars) {
+      scalars->makeManaged();
+      scalars->prefetch();
+    }
     assert(perBlock.origins);
     assert(perBlock.dims);
     assert(perBlock.levels);
@@ -278,15 +494,18 @@ namespace BARNEY_NS {
       auto rtc = dev->rtc;
       box3f *d_worldBounds = (box3f *)rtc->allocMem(sizeof(box3f));
       rtc->copy(d_worldBounds,&worldBounds,sizeof(worldBounds));
+      const int blocksPerThread = 64;
       __rtc_launch(// dev and kernel
                    rtc,computeWorldBounds,
                    // launch config
-                   divRoundUp(numBlocks,128),128,
+                   divRoundUp(divRoundUp(numBlocks,blocksPerThread),128),128,
                    // kernel args
-                   d_worldBounds,getDD(dev));
+                   d_worldBounds,getDD(dev),blocksPerThread);
       rtc->sync();
       rtc->copy(&worldBounds,d_worldBounds,sizeof(worldBounds));
+      rtc->freeMem(d_worldBounds);
     }
     
+    buildCompact();
   }
 }
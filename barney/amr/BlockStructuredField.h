@@ -6,6 +6,7 @@
 
 #include "barney/Object.h"
 #include "barney/ModelSlot.h"
+#include "barney/common/half.h"
 
 namespace BARNEY_NS {
 
@@ -20,6 +21,14 @@ namespace BARNEY_NS {
       // rtc::ComputeKernel1D *computeElementBBs = 0;
       Block *blocks;
       float *scalars;
+      /*! compact per-block encodings, if enabled (see
+          buildCompact()); null otherwise */
+      struct {
+        uint32_t *dims    = 0;
+        uint8_t  *levels  = 0;
+        uint32_t *offsets = 0;
+        half     *scalars = 0;
+      } compact;
     };
     PLD *getPLD(Device *device);
     std::vector<PLD> perLogical;
@@ -46,6 +55,15 @@ namespace BARNEY_NS {
       struct {
         const int   *refinements;
       } perLevel;
+      /*! if non-null, these get used instead of perBlock.dims (packed
+          into 10 bits per dimension), perBlock.levels,
+          perBlock.offsets, and scalars, respectively */
+      struct {
+        const uint32_t *dims;
+        const uint8_t  *levels;
+        const uint32_t *offsets;
+        const half     *scalars;
+      } compact;
       int numBlocks;
     };
 
@@ -74,6 +92,25 @@ namespace BARNEY_NS {
     
     VolumeAccel::SP createAccel(Volume *volume) override;
 
+    bool set1i(const std::string &member,
+               const int &value) override;
+
+    /*! if enabled, builds the compact encodings of the per-block
+        arrays (and, for halfScalars, of the scalars), and drops our
+        references to the full-size arrays they replace */
+    void buildCompact();
+    void freeCompact();
+
+    /*! whether to store per-block dims, levels and offsets in 32, 8,
+        and 32 bits, respectively (falls back to the full-size arrays
+        if the model doesn't fit those) */
+    bool compactBlocks = false;
+    /*! whether to store scalars as fp16 */
+    bool halfScalars   = false;
+    /*! whether to keep the scalars in unified memory (see
+        PODData::makeManaged()); ignored with halfScalars */
+    bool managedMemory = false;
+
     struct {
       PODData::SP/*3i*/ origins    = 0;
       PODData::SP/*3i*/ dims       = 0;
@@ -104,6 +141,8 @@ namespace BARNEY_NS {
     int   level;
     float cellSize;
     const float *scalars;
+    /*! if non-null, fp16 scalars to use instead of 'scalars' */
+    const half  *halfScalars;
   };
   
   
@@ -208,7 +247,7 @@ namespace BARNEY_NS {
       + cellID.x
       + cellID.y * dims.x
       + cellID.z * dims.x*dims.y;
-    return scalars[idx];
+    return halfScalars ? from_half(halfScalars[idx]) : scalars[idx];
   }
 
   inline __rtc_device
@@ -225,7 +264,7 @@ namespace BARNEY_NS {
   {
     range1f range;
     for (int i=0;i<dims.x*dims.y*dims.z;i++)
-      range.extend(scalars[i]);
+      range.extend(halfScalars ? from_half(halfScalars[i]) : scalars[i]);
     return range;
   }
   
@@ -243,11 +282,22 @@ namespace BARNEY_NS {
   {
     Block block;
     block.origin   = dd.perBlock.origins[blockID];
-    block.dims     = dd.perBlock.dims[blockID];
-    block.level    = dd.perBlock.levels[blockID];
+    if (dd.compact.dims) {
+      uint32_t packed = dd.compact.dims[blockID];
+      block.dims   = vec3i(packed & 1023,(packed >> 10) & 1023,packed >> 20);
+      block.level  = dd.compact.levels[blockID];
+    } else {
+      block.dims   = dd.perBlock.dims[blockID];
+      block.level  = dd.perBlock.levels[blockID];
+    }
     block.cellSize = (int)(powf((float)dd.perLevel.refinements[block.level],
                                 (float)block.level));
-    block.scalars  = dd.scalars+dd.perBlock.offsets[blockID];
+    uint64_t offset
+      = dd.compact.offsets
+      ? (uint64_t)dd.compact.offsets[blockID]
+      : dd.perBlock.offsets[blockID];
+    block.scalars     = dd.scalars ? dd.scalars+offset : nullptr;
+    block.halfScalars = dd.compact.scalars ? dd.compact.scalars+offset : nullptr;
     return block;
   }
 #endif
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "barney/api/common.h"
+#include <functional>
 #include <mutex>
 #include <set>
 
@@ -12,6 +13,7 @@ namespace barney_api {
   
   struct Context;
   struct Data;
+  struct SnapshotRecorder;
 
   /*! the base class for _any_ other type of object/actor in the
       barney class hierarchy */
@@ -105,6 +107,19 @@ namespace barney_api {
     virtual ~Data() = default;
     
     virtual void set(const void *data, size_t count) = 0;
+    /*! overwrites items [offset,offset+count) of what got set
+        before, leaving all others (and the size) unchanged */
+    virtual void setRange(size_t offset, const void *data, size_t count) = 0;
+    /*! same as set(), but with the count items read from given file,
+        starting at byte 'offset' */
+    virtual void setFromFile(const char *fileName,
+                             size_t offset,
+                             size_t count) = 0;
+    /*! copies items [offset,offset+count) of what got set into given
+        host memory, no matter whether they got set from host or
+        device memory; false if this kind of array can't */
+    virtual bool readBack(size_t offset, size_t count, void *hostPtr)
+    { return false; }
   };
 
   /*! object that handles a frame buffer object; in particular, the
@@ -126,6 +141,23 @@ namespace barney_api {
                        BNDataType requestedFormat) = 0;
     /** Actual framebuffer dimensions (may differ from resize when e.g. upscaling forces even dims). */
     virtual vec2i getNumPixels() const { return vec2i(-1, -1); }
+    /*! per-stage timings of the last frame; returns false if this
+        frame buffer doesn't collect any */
+    virtual bool  getStats(BNFrameStats &stats) { return false; }
+    /*! device-side counters of the last frame; returns false if
+        this build doesn't count any */
+    virtual bool  getCounters(BNDeviceCounters &counters) { return false; }
+    /*! see bnFrameBufferSetColorTarget() */
+    virtual void  setColorTarget(int fd, size_t numBytes) = 0;
+    /*! see bnFrameBufferGetEncodedSize() */
+    virtual size_t getEncodedSize() { return 0; }
+    /*! see bnFrameBufferIsConverged() */
+    virtual bool  isConverged() { return false; }
+    /*! see bnFrameBufferWriteAsync() */
+    virtual void  writeAsync(const std::string &baseName,
+                             uint32_t channels) = 0;
+    /*! see bnFrameBufferFlushWrites() */
+    virtual int   flushWrites() { return 0; }
   };
   
   struct TextureData : public Object {
@@ -162,13 +194,38 @@ namespace barney_api {
     virtual void updateInstanceTransforms(int slot,
                                           const affine3f *xfms,
                                           int numInstances) = 0;
+    virtual void updateInstanceTransformsSparse(int slot,
+                                                const int *instIDs,
+                                                const affine3f *xfms,
+                                                int count) = 0;
     virtual void setInstanceAttributes(int slot,
                                        const std::string &which,
                                        Data::SP data) = 0;
     virtual void build(int slot) = 0;
+    virtual void setDomainBounds(int slot, const box3f &bounds) {}
     virtual void render(Renderer *renderer,
                         Camera *camera,
                         FrameBuffer *fb) = 0;
+    /*! see bnRenderMulti(); unless overridden, just renders one view
+        after another */
+    virtual void renderMulti(Renderer *renderer,
+                             Camera *const *cameras,
+                             FrameBuffer *const *fbs,
+                             int numViews)
+    {
+      for (int i=0;i<numViews;i++)
+        render(renderer,cameras[i],fbs[i]);
+    }
+    /*! see bnPick() */
+    virtual void pick(Camera *camera,
+                      vec2i numPixels,
+                      const vec2f *screenPos,
+                      int numPicks,
+                      BNPickResult *results) = 0;
+    /*! see bnTraceRays() */
+    virtual void traceRays(const BNRay *rays,
+                           int numRays,
+                           BNRayHit *hits) = 0;
   };
   
   struct Texture : public Object {
@@ -188,6 +245,18 @@ namespace barney_api {
 
     virtual int myRank() = 0;
     virtual int mySize() = 0;
+
+    /*! see bnContextGetMemoryInfo() */
+    virtual int getMemoryInfo(BNDeviceMemoryInfo *infos, int maxInfos)
+    { return 0; }
+    virtual void resetMemoryHighWater() {}
+    /*! see bnContextGetBuildRecords() */
+    virtual int getBuildRecords(BNBuildRecord *records, int maxRecords)
+    { return 0; }
+    virtual void clearBuildRecords() {}
+    /*! commits given object of this context; lets contexts time
+        (some) objects' commits */
+    virtual void commit(Object *object) { object->commit(); }
     
     
     // ------------------------------------------------------------------
@@ -200,7 +269,7 @@ namespace barney_api {
     createModel() = 0;
     
     virtual std::shared_ptr<Renderer>
-    createRenderer() = 0;
+    createRenderer(const std::string &type) = 0;
 
     virtual std::shared_ptr<Camera>
     createCamera(const std::string &type) = 0;
@@ -214,7 +283,26 @@ namespace barney_api {
     createTextureData(int slot,
                       BNDataType texelFormat,
                       vec3i dims,
-                      const void *texels) = 0;
+                      const void *texels,
+                      bool asyncUpload = false) = 0;
+
+    /*! reads bytes [offset,offset+numBytes) of a file that all ranks
+        share, and calls use(bytes) with them; with MPI this is
+        collective, and the file gets read only once (see
+        MPIContext::readReplicated) */
+    virtual void readReplicated(const char *fileName,
+                                size_t offset,
+                                size_t numBytes,
+                                const std::function<void(const void *)> &use) = 0;
+
+    /*! same as createTextureData(), with the texels read from given
+        file, starting at byte 'offset' */
+    virtual std::shared_ptr<TextureData>
+    createTextureDataFromFile(int slot,
+                              BNDataType texelFormat,
+                              vec3i dims,
+                              const char *fileName,
+                              size_t offset) = 0;
     
     virtual std::shared_ptr<ScalarField>
     createScalarField(int slot, const std::string &type) = 0;
@@ -236,6 +324,14 @@ namespace barney_api {
                 Geometry **geoms, int numGeoms,
                 Volume **volumes, int numVolumes) = 0;
 
+    /*! builds all given groups; backends that can share work
+        across groups (or overlap their builds) override this */
+    virtual void buildGroups(Group **groups, int numGroups)
+    {
+      for (int i=0;i<numGroups;i++)
+        if (groups[i]) groups[i]->build();
+    }
+
     virtual std::shared_ptr<Data>
     createData(int slot,
                BNDataType dataType) = 0;
@@ -282,6 +378,11 @@ namespace barney_api {
 
     std::mutex mutex;
     std::map<Object::SP,int> hostOwnedHandles;
+
+    /*! journal of everything done to this context's model-side
+        objects while it records (see bnContextRecordSnapshot());
+        null while it doesn't */
+    std::shared_ptr<SnapshotRecorder> snapshot;
   };
 
   /*! pretty-printer for printf-debugging */
@@ -375,6 +476,62 @@ namespace barney_api {
     bool logConfig  = false;
     bool logBackend = false;
     bool logTopo    = false;
+    /*! print every BNBuildRecord as a json line (see BuildLog) */
+    bool logBuilds  = false;
+    /*! read back ray queue counts only every N'th generation (in
+        between those, kernels use device-side counts); only used
+        where rays never have to be forwarded between devices */
+    int  rayCountInterval = 1;
+    /*! once all samples' rays got generated and no more than this
+        many rays are left in all ray queues, finish the remaining
+        paths without any host syncs (0 = never); only used where
+        rays never have to be forwarded between devices */
+    int  tailThreshold = 0;
+    /*! split each device's ray queue into this many chunks when
+        cycling rays between ranks, so sending one chunk to the next
+        rank overlaps with tracing the next chunk */
+    int  forwardChunks = 1;
+    /*! caps each device's ray queues at (about) this many rays, no
+        matter how many tiles it owns; frames then get rendered in
+        batches of as many tiles as fit (0 = size queues for all
+        tiles at once) */
+    int  rayQueueCapacity = 0;
+    /*! DistFB gathers skip tiles whose (8-bit) colors changed by no
+        more than this many levels since they were last sent to the
+        owner; -1 = always send all tiles */
+    int  gatherDeltaThreshold = -1;
+    /*! once this many samples got accumulated, DistFB gathers send
+        full-precision tiles rather than 8-bit ones (0 = never) */
+    int  losslessGatherAfter = 0;
+    /*! directory for the on-disk accel cache (see AccelCache.h);
+        empty = no caching */
+    std::string accelCacheDir;
+    /*! data arrays of at least that many MB get only one copy per
+        rank's devices (if those all have peer access to each other),
+        on the one with the least data arrays so far, and the others
+        read it from there; 0 = each device has its own copy */
+    int  sharedDataMB = 0;
+    /*! directory for the optix module/pipeline disk cache; empty =
+        optix' own default location */
+    std::string pipelineCacheDir;
+    /*! throughput of a cpu (embree) device relative to a gpu, for
+        splitting tiles between ranks of different backends (see
+        FrameBuffer::rebalanceTiles); 1 = same as a gpu */
+    float cpuWeight = 1.f;
+    /*! throughput of each local gpu (by local device index) relative
+        to the others, for mixed-generation machines: sizes each
+        device's share of tiles and, with autoPartition, of the data;
+        given as "gpuWeights=1,.5", or measured at startup with
+        "gpuWeights=auto". Empty = all the same */
+    std::vector<float> gpuWeights;
+    bool  measureGpuWeights = false;
+    /*! 2D rgba8 texture data larger than this many MB stays on the
+        host, and image samplers stream its tiles through a cache of
+        the same size per device (see TileStreamer); 0 = never */
+    int   streamTexturesMB = 0;
+    /*! where to write a chrome-trace/perfetto json of all ranks'
+        nvtx ranges (see Timeline); empty = don't record one */
+    std::string timelineFile;
   };
   
 }
@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/api/Context.h"
+#include <iostream>
+#include <string>
+#if BARNEY_HAVE_CUFILE
+# include <cuda_runtime.h>
+# include <cufile.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace barney_api {
+
+  /*! a file that gets read straight into device memory through
+      GPUDirect Storage (cuFile), without any host staging; for
+      streaming large arrays, bricks, and grids - eg, the time steps
+      of a time-varying volume - at nvme rather than page-cache
+      bandwidth. Without cuFile support compiled in (BARNEY_GDS), or
+      with BARNEY_CONFIG="noGDS", or if the driver or the file does
+      not support it, valid() is false, and callers go through
+      MappedFile instead */
+  struct DirectFile {
+    /*! a null fileName gives an invalid file, without ever
+        touching the cufile driver */
+    inline DirectFile(const char *fileName);
+    inline ~DirectFile();
+    DirectFile(const DirectFile &) = delete;
+    DirectFile &operator=(const DirectFile &) = delete;
+
+    bool valid() const { return isValid; }
+
+    /*! reads numBytes at given file offset into d_dst (device
+        memory of the currently active gpu), in chunks of at most
+        chunkSize bytes; returns false if any read failed */
+    inline bool read(void *d_dst, size_t numBytes, size_t fileOffset);
+
+    static const size_t chunkSize = size_t(256)<<20;
+  private:
+    bool isValid = false;
+#if BARNEY_HAVE_CUFILE
+    /*! opens the cufile driver the first time around; false if that
+        failed (then it won't be tried again) */
+    static inline bool driverOpen();
+
+    int            fd = -1;
+    CUfileHandle_t handle;
+#endif
+  };
+
+#if BARNEY_HAVE_CUFILE
+  inline bool DirectFile::driverOpen()
+  {
+    static bool isOpen = []() {
+      if (FromEnv::enabled("noGDS")) return false;
+      CUfileError_t rc = cuFileDriverOpen();
+      if (rc.err != CU_FILE_SUCCESS) {
+        if (FromEnv::get()->logConfig)
+          std::cout << "#bn: could not open cufile driver (error "
+                    << (int)rc.err << "); reading files through the host"
+                    << std::endl;
+        return false;
+      }
+      return true;
+    }();
+    return isOpen;
+  }
+
+  inline DirectFile::DirectFile(const char *fileName)
+  {
+    if (!fileName || !driverOpen()) return;
+    fd = open(fileName,O_RDONLY|O_DIRECT);
+    if (fd < 0) return;
+    CUfileDescr_t descr;
+    memset(&descr,0,sizeof(descr));
+    descr.handle.fd = fd;
+    descr.type      = CU_FILE_HANDLE_TYPE_OPAQUE_FD;
+    CUfileError_t rc = cuFileHandleRegister(&handle,&descr);
+    if (rc.err != CU_FILE_SUCCESS) {
+      close(fd);
+      fd = -1;
+      return;
+    }
+    isValid = true;
+  }
+
+  inline DirectFile::~DirectFile()
+  {
+    if (isValid) cuFileHandleDeregister(handle);
+    if (fd >= 0) close(fd);
+  }
+
+  inline bool DirectFile::read(void *d_dst, size_t numBytes, size_t fileOffset)
+  {
+    if (!isValid) return false;
+    size_t done = 0;
+    while (done < numBytes) {
+      const size_t size = std::min(chunkSize,numBytes-done);
+      ssize_t rc = cuFileRead(handle,d_dst,size,
+                              (off_t)(fileOffset+done),(off_t)done);
+      /* short reads past the end of the file are errors, too */
+      if (rc <= 0) return false;
+      done += (size_t)rc;
+    }
+    return true;
+  }
+#else
+  inline DirectFile::DirectFile(const char *fileName) {}
+  inline DirectFile::~DirectFile() {}
+  inline bool DirectFile::read(void *, size_t, size_t) { return false; }
+#endif
+
+}
@@ -0,0 +1,155 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/api/common.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace barney_api {
+
+  /*! read-only memory mapping of bytes [offset,offset+numBytes) of
+      a file, for creating data arrays and texture data straight from
+      the page cache, without first reading them into a host copy
+      that'd then get copied again. numBytes==0 maps everything from
+      offset to the end of the file */
+  struct MappedFile {
+    inline MappedFile(const char *fileName, size_t offset, size_t numBytes=0);
+    inline ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /*! tells the os that bytes [begin,end) (relative to data) won't
+        get read again, so their pages can leave this process' resident
+        set right away rather than accumulating until the unmap */
+    inline void release(size_t begin, size_t end);
+
+    /*! the first requested byte, and how many got mapped */
+    const uint8_t *data = 0;
+    size_t         size = 0;
+  private:
+    void  *base      = 0;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    HANDLE file    = INVALID_HANDLE_VALUE;
+    HANDLE mapping = 0;
+#endif
+  };
+
+#ifdef _WIN32
+  inline MappedFile::MappedFile(const char *fileName,
+                                size_t offset,
+                                size_t numBytes)
+  {
+    file = CreateFileA(fileName,GENERIC_READ,FILE_SHARE_READ,0,
+                       OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,0);
+    if (file == INVALID_HANDLE_VALUE)
+      throw std::runtime_error("#bn: could not open '"
+                               +std::string(fileName)+"'");
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file,&fileSize);
+    if (numBytes == 0 && offset < (size_t)fileSize.QuadPart)
+      numBytes = (size_t)fileSize.QuadPart-offset;
+    if (numBytes == 0 || offset+numBytes > (size_t)fileSize.QuadPart) {
+      CloseHandle(file);
+      throw std::runtime_error("#bn: '"+std::string(fileName)
+                               +"' is too small for requested range");
+    }
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    size_t aligned = offset - offset % si.dwAllocationGranularity;
+    mappedSize = numBytes + (offset-aligned);
+    mapping = CreateFileMappingA(file,0,PAGE_READONLY,0,0,0);
+    if (mapping)
+      base = MapViewOfFile(mapping,FILE_MAP_READ,
+                           DWORD(uint64_t(aligned)>>32),
+                           DWORD(aligned & 0xffffffffull),
+                           mappedSize);
+    if (!base) {
+      if (mapping) CloseHandle(mapping);
+      CloseHandle(file);
+      throw std::runtime_error("#bn: could not map '"
+                               +std::string(fileName)+"'");
+    }
+    data = (const uint8_t *)base + (offset-aligned);
+    size = numBytes;
+  }
+
+  inline MappedFile::~MappedFile()
+  {
+    UnmapViewOfFile(base);
+    CloseHandle(mapping);
+    CloseHandle(file);
+  }
+
+  inline void MappedFile::release(size_t begin, size_t end)
+  {
+    /* views of read-only file mappings can't be partially dropped;
+       the pages stay in the working set until the unmap */
+  }
+#else
+  inline MappedFile::MappedFile(const char *fileName,
+                                size_t offset,
+                                size_t numBytes)
+  {
+    int fd = open(fileName,O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("#bn: could not open '"
+                               +std::string(fileName)+"'");
+    struct stat st;
+    fstat(fd,&st);
+    if (numBytes == 0 && offset < (size_t)st.st_size)
+      numBytes = (size_t)st.st_size-offset;
+    if (numBytes == 0 || offset+numBytes > (size_t)st.st_size) {
+      close(fd);
+      throw std::runtime_error("#bn: '"+std::string(fileName)
+                               +"' is too small for requested range");
+    }
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t aligned = offset - offset % pageSize;
+    mappedSize = numBytes + (offset-aligned);
+    base = mmap(0,mappedSize,PROT_READ,MAP_PRIVATE,fd,(off_t)aligned);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (base == MAP_FAILED) {
+      base = 0;
+      throw std::runtime_error("#bn: could not map '"
+                               +std::string(fileName)+"'");
+    }
+    madvise(base,mappedSize,MADV_SEQUENTIAL);
+    data = (const uint8_t *)base + (offset-aligned);
+    size = numBytes;
+  }
+
+  inline MappedFile::~MappedFile()
+  {
+    if (base) munmap(base,mappedSize);
+  }
+
+  inline void MappedFile::release(size_t begin, size_t end)
+  {
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t lead  = data - (const uint8_t *)base;
+    /* only whole pages; partial ones at either end stay mapped */
+    size_t first = (lead+begin+pageSize-1)/pageSize*pageSize;
+    size_t last  = std::min(lead+end,mappedSize)/pageSize*pageSize;
+    if (last > first)
+      madvise((uint8_t *)base+first,last-first,MADV_DONTNEED);
+  }
+#endif
+
+}
@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/api/Timeline.h"
+#if BARNEY_HAVE_NVTX
+# include <nvtx3/nvToolsExt.h>
+# include <nvtx3/nvToolsExtCudaRt.h>
+# include <string>
+#endif
+
+namespace barney_api {
+
+  /*! names the host code between this range's construction and
+      destruction (in a 'barney' domain) for nsight systems and other
+      nvtx tools. Ranges that are about a given device get that
+      device's color, so each gpu's work can be told apart at a glance;
+      all others get the same neutral one. With no tool attached nvtx
+      calls return right away, so ranges stay compiled in; builds
+      without nvtx (BARNEY_NVTX=OFF, or non-cuda backends) make them
+      no-ops. Either way, ranges also go into the Timeline, if one is
+      being recorded */
+  struct NvtxRange {
+    enum { NO_DEVICE = -1, NO_GENERATION = -1 };
+
+    inline NvtxRange(const char *name,
+                     int deviceRank = NO_DEVICE,
+                     int generation = NO_GENERATION);
+    inline ~NvtxRange();
+    NvtxRange(const NvtxRange &) = delete;
+    NvtxRange &operator=(const NvtxRange &) = delete;
+
+    /*! names a device's stream (and the cuda device itself) as
+        'barney device <rank>', so traces list them as such rather
+        than by their cuda handles */
+    static inline void nameStream(void *cudaStream,
+                                  int cudaDeviceID,
+                                  int deviceRank);
+  private:
+    Timeline *const timeline = Timeline::get();
+    /*! only kept (and copied) if there's a timeline */
+    std::string name;
+    int    deviceRank = NO_DEVICE;
+    int    generation = NO_GENERATION;
+    double begin      = 0.;
+#if BARNEY_HAVE_NVTX
+    static inline nvtxDomainHandle_t domain();
+    static inline uint32_t colorOf(int deviceRank);
+#endif
+  };
+
+#if BARNEY_HAVE_NVTX
+  inline nvtxDomainHandle_t NvtxRange::domain()
+  {
+    static nvtxDomainHandle_t domain = nvtxDomainCreateA("barney");
+    return domain;
+  }
+
+  inline uint32_t NvtxRange::colorOf(int deviceRank)
+  {
+    static const uint32_t palette[] = {
+      0xff76b900, 0xff1f77b4, 0xffff7f0e, 0xffd62728,
+      0xff9467bd, 0xff17becf, 0xffe377c2, 0xffbcbd22
+    };
+    if (deviceRank < 0) return 0xff7f7f7f;
+    return palette[deviceRank % (sizeof(palette)/sizeof(palette[0]))];
+  }
+
+  inline void NvtxRange::nameStream(void *cudaStream,
+                                    int cudaDeviceID,
+                                    int deviceRank)
+  {
+    std::string name = "barney device "+std::to_string(deviceRank);
+    nvtxNameCudaStreamA((cudaStream_t)cudaStream,name.c_str());
+    nvtxNameCudaDeviceA(cudaDeviceID,name.c_str());
+  }
+#else
+  inline void NvtxRange::nameStream(void *, int, int) {}
+#endif
+
+  inline NvtxRange::NvtxRange(const char *name,
+                              int deviceRank,
+                              int generation)
+  {
+#if BARNEY_HAVE_NVTX
+    nvtxEventAttributes_t attribs = {};
+    attribs.version       = NVTX_VERSION;
+    attribs.size          = NVTX_EVENT_ATTRIB_STRUCT_SIZE;
+    attribs.colorType     = NVTX_COLOR_ARGB;
+    attribs.color         = colorOf(deviceRank);
+    attribs.messageType   = NVTX_MESSAGE_TYPE_ASCII;
+    attribs.message.ascii = name;
+    if (generation != NO_GENERATION) {
+      attribs.payloadType    = NVTX_PAYLOAD_TYPE_INT32;
+      attribs.payload.iValue = generation;
+    }
+    nvtxDomainRangePushEx(domain(),&attribs);
+#endif
+    if (!timeline) return;
+    this->name       = name;
+    this->deviceRank = deviceRank;
+    this->generation = generation;
+    this->begin      = getCurrentTime();
+  }
+
+  inline NvtxRange::~NvtxRange()
+  {
+#if BARNEY_HAVE_NVTX
+    nvtxDomainRangePop(domain());
+#endif
+    if (timeline)
+      timeline->record(name,deviceRank,generation,begin,getCurrentTime());
+  }
+
+}
@@ -0,0 +1,363 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/api/Context.h"
+#include "barney/api/MappedFile.h"
+#include <fstream>
+#include <set>
+
+/* scene snapshots (see bnModelSave()/bnModelLoad()): while a context
+   records, every creation, parameter set, commit, and build of a
+   model-side object gets appended to a journal. Saving a model writes
+   the part of that journal the model depends on, with all array and
+   texel payloads in page-aligned chunks; loading maps that file and
+   replays the journal, with each payload getting uploaded straight
+   out of the mapping */
+
+namespace barney_api {
+
+  /*! bytes per item of given (non-object) data type; 0 for object
+      handle types */
+  inline size_t snapshotSizeOf(BNDataType type)
+  {
+    switch (type) {
+    case BN_DATA:
+    case BN_OBJECT:
+    case BN_TEXTURE:
+    case BN_TEXTURE_3D:
+      return 0;
+    case BN_UFIXED8:
+      return 1;
+    case BN_UFIXED16:
+      return 2;
+    case BN_UFIXED8_RGBA:
+    case BN_UFIXED8_RGBA_SRGB:
+      return 4;
+    default:
+      break;
+    }
+    const int t = (int)type;
+    /* scalar types: groups of ten, with the vector width in the last
+       digit */
+    if (t >= BN_INT8 && t <= BN_FLOAT64_VEC4 && (t%10) < 4) {
+      static const size_t scalarSize[10] = { 1,1,2,2,4,4,8,8,4,8 };
+      return scalarSize[(t-BN_INT8)/10] * size_t(t%10+1);
+    }
+    throw std::runtime_error("#bn.snapshot: no size known for data type #"
+                             +std::to_string(t));
+  }
+
+  inline bool isObjectDataType(BNDataType type)
+  {
+    return type == BN_DATA || type == BN_OBJECT
+      ||   type == BN_TEXTURE || type == BN_TEXTURE_3D;
+  }
+
+  /*! size of a texture data's texels, including block-compressed ones */
+  inline size_t snapshotTexelBytes(BNDataType format, vec3i dims)
+  {
+    const size_t w = std::max(dims.x,1);
+    const size_t h = std::max(dims.y,1);
+    const size_t d = std::max(dims.z,1);
+    switch (format) {
+    case BN_BC1_RGBA_UNORM:
+    case BN_BC4_R_UNORM:
+      return ((w+3)/4)*((h+3)/4)*8;
+    case BN_BC3_RGBA_UNORM:
+    case BN_BC5_RG_UNORM:
+    case BN_BC6H_RGB_UFLOAT:
+    case BN_BC7_RGBA_UNORM:
+      return ((w+3)/4)*((h+3)/4)*16;
+    default:
+      return w*h*d*snapshotSizeOf(format);
+    }
+  }
+
+  struct SnapshotOp {
+    typedef enum : uint32_t {
+      CREATE_MODEL=0,
+      CREATE_DATA,
+      CREATE_TEXTURE_DATA,
+      CREATE_TEXTURE,
+      CREATE_SCALAR_FIELD,
+      CREATE_GEOMETRY,
+      CREATE_MATERIAL,
+      CREATE_SAMPLER,
+      CREATE_LIGHT,
+      CREATE_VOLUME,
+      CREATE_GROUP,
+      DATA_SET,
+      DATA_SET_RANGE,
+      SET_PARAM,
+      COMMIT,
+      VOLUME_XF,
+      SET_INSTANCES,
+      UPDATE_INSTANCE_XFMS,
+      SET_INSTANCE_ATTRIBUTES,
+      SET_DOMAIN_BOUNDS,
+      GROUPS_BUILD,
+      MODEL_BUILD,
+      UPDATE_INSTANCE_XFMS_SPARSE
+    } Type;
+
+    /*! what kind of value a SET_PARAM sets */
+    typedef enum : uint32_t {
+      PARAM_STRING=0, PARAM_OBJECT, PARAM_DATA,
+      PARAM_1F, PARAM_2F, PARAM_3F, PARAM_4F,
+      PARAM_1I, PARAM_2I, PARAM_3I, PARAM_4I,
+      PARAM_4X3F, PARAM_4X4F
+    } ParamKind;
+
+    /*! where a payload's bytes come from: owned host copies when
+        recording, or a (file,offset) range for things that got
+        created from files */
+    struct Payload {
+      std::vector<uint8_t> owned;
+      std::string fileName;
+      size_t      fileOffset = 0;
+      size_t      size       = 0;
+    };
+
+    template<typename T>
+    void setValue(const T &v)
+    { bytes.resize(sizeof(T)); memcpy(bytes.data(),&v,sizeof(T)); }
+    template<typename T>
+    T getValue() const
+    {
+      T v;
+      assert(bytes.size() >= sizeof(T));
+      memcpy(&v,bytes.data(),sizeof(T));
+      return v;
+    }
+
+    Type     type;
+    /*! ID of the object this op is done to (0 = none) */
+    uint32_t target  = 0;
+    int32_t  slot    = 0;
+    /*! data type, texel format, or param kind */
+    uint32_t subType = 0;
+    /*! object type, or parameter/attribute name */
+    std::string name;
+    /*! IDs of objects this op refers to (0 = null) */
+    std::vector<uint32_t> refs;
+    /*! small, op-specific values */
+    std::vector<uint8_t>  bytes;
+    Payload               payload;
+  };
+
+  /*! file layout: this header, then all payloads (each starting at a
+      page boundary, so they can get mapped and uploaded in place),
+      then the ops */
+  struct SnapshotHeader {
+    enum { VERSION = 1, ALIGNMENT = 4096 };
+    char     magic[8] = { 'B','N','S','N','A','P','\0','\0' };
+    uint32_t version  = VERSION;
+    uint32_t numOps   = 0;
+    uint64_t opsOffset = 0;
+    uint64_t opsSize   = 0;
+  };
+
+  /*! the journal a recording context keeps; see
+      bnContextRecordSnapshot() */
+  struct SnapshotRecorder {
+    /*! assigns given (newly created) object an ID */
+    uint32_t add(const Object::SP &object);
+    /*! ID of given object, or 0 if it isn't (any longer) known */
+    uint32_t idOf(const Object *object);
+
+    void record(SnapshotOp &&op)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ops.push_back(std::move(op));
+    }
+
+    /*! writes all ops that given model depends on */
+    void save(const Object *model, const std::string &fileName);
+
+    std::mutex mutex;
+    std::vector<SnapshotOp> ops;
+    std::map<const Object *,std::pair<std::weak_ptr<Object>,uint32_t>> ids;
+    /*! item types of all recorded data arrays, for sizing their
+        later set()s */
+    std::map<uint32_t,BNDataType> dataTypes;
+    uint32_t nextID = 1;
+  };
+
+  inline uint32_t SnapshotRecorder::add(const Object::SP &object)
+  {
+    if (!object) return 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t ID = nextID++;
+    ids[object.get()] = { object, ID };
+    return ID;
+  }
+
+  inline uint32_t SnapshotRecorder::idOf(const Object *object)
+  {
+    if (!object) return 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = ids.find(object);
+    if (it == ids.end()) return 0;
+    /* a different object that happens to live where a released one
+       did isn't that object */
+    if (it->second.first.lock().get() != object) {
+      ids.erase(it);
+      return 0;
+    }
+    return it->second.second;
+  }
+
+  inline void SnapshotRecorder::save(const Object *model,
+                                     const std::string &fileName)
+  {
+    const uint32_t modelID = idOf(model);
+    if (!modelID)
+      throw std::runtime_error("#bn.snapshot: model was not created "
+                               "while its context was recording");
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // ------------------------------------------------------------------
+    // find everything the model (transitively) refers to
+    // ------------------------------------------------------------------
+    std::set<uint32_t> needed = { modelID };
+    for (bool changed = true; changed; ) {
+      changed = false;
+      for (auto &op : ops) {
+        bool targetNeeded
+          = op.target ? needed.count(op.target) != 0 : false;
+        if (op.type == SnapshotOp::GROUPS_BUILD || !targetNeeded)
+          continue;
+        for (auto ref : op.refs)
+          if (ref && needed.insert(ref).second)
+            changed = true;
+      }
+    }
+    std::vector<SnapshotOp> toSave;
+    for (auto &op : ops) {
+      if (op.type == SnapshotOp::GROUPS_BUILD) {
+        SnapshotOp build = op;
+        build.refs.clear();
+        for (auto ref : op.refs)
+          if (needed.count(ref)) build.refs.push_back(ref);
+        if (!build.refs.empty()) toSave.push_back(std::move(build));
+      } else if (needed.count(op.target))
+        toSave.push_back(op);
+    }
+
+    // ------------------------------------------------------------------
+    // header, then the payloads
+    // ------------------------------------------------------------------
+    std::ofstream out(fileName,std::ios::binary);
+    if (!out.good())
+      throw std::runtime_error("#bn.snapshot: could not open '"
+                               +fileName+"' for writing");
+    SnapshotHeader header;
+    out.write((const char *)&header,sizeof(header));
+    auto pad = [&]() {
+      static const char zeros[SnapshotHeader::ALIGNMENT] = {};
+      size_t at = (size_t)out.tellp();
+      size_t rem = at % SnapshotHeader::ALIGNMENT;
+      if (rem) out.write(zeros,SnapshotHeader::ALIGNMENT-rem);
+    };
+    std::vector<uint64_t> payloadOffsets(toSave.size(),0);
+    for (size_t i=0;i<toSave.size();i++) {
+      auto &payload = toSave[i].payload;
+      if (payload.size == 0) continue;
+      pad();
+      payloadOffsets[i] = (uint64_t)out.tellp();
+      if (!payload.owned.empty())
+        out.write((const char *)payload.owned.data(),payload.size);
+      else {
+        MappedFile file(payload.fileName.c_str(),
+                        payload.fileOffset,payload.size);
+        out.write((const char *)file.data,payload.size);
+      }
+    }
+
+    // ------------------------------------------------------------------
+    // and the ops
+    // ------------------------------------------------------------------
+    pad();
+    header.opsOffset = (uint64_t)out.tellp();
+    header.numOps    = (uint32_t)toSave.size();
+    auto write32 = [&](uint32_t v) { out.write((const char *)&v,sizeof(v)); };
+    auto write64 = [&](uint64_t v) { out.write((const char *)&v,sizeof(v)); };
+    for (size_t i=0;i<toSave.size();i++) {
+      const auto &op = toSave[i];
+      write32(op.type);
+      write32(op.target);
+      write32((uint32_t)op.slot);
+      write32(op.subType);
+      write32((uint32_t)op.name.size());
+      out.write(op.name.data(),op.name.size());
+      write32((uint32_t)op.refs.size());
+      out.write((const char *)op.refs.data(),op.refs.size()*sizeof(uint32_t));
+      write32((uint32_t)op.bytes.size());
+      out.write((const char *)op.bytes.data(),op.bytes.size());
+      write64(payloadOffsets[i]);
+      write64(op.payload.size);
+    }
+    header.opsSize = (uint64_t)out.tellp() - header.opsOffset;
+    out.seekp(0);
+    out.write((const char *)&header,sizeof(header));
+    if (!out.good())
+      throw std::runtime_error("#bn.snapshot: error writing '"+fileName+"'");
+  }
+
+  /*! a mapped snapshot file, and the ops it holds; payloads refer
+      to ranges of the mapping */
+  struct SnapshotFile {
+    SnapshotFile(const std::string &fileName);
+
+    const uint8_t *payload(const SnapshotOp &op) const
+    { return op.payload.size ? file.data+op.payload.fileOffset : nullptr; }
+
+    MappedFile              file;
+    std::vector<SnapshotOp> ops;
+  };
+
+  inline SnapshotFile::SnapshotFile(const std::string &fileName)
+    : file(fileName.c_str(),0)
+  {
+    SnapshotHeader header, expected;
+    if (file.size < sizeof(header))
+      throw std::runtime_error("#bn.snapshot: '"+fileName+"' is too small");
+    memcpy(&header,file.data,sizeof(header));
+    if (memcmp(header.magic,expected.magic,sizeof(header.magic))
+        || header.version != SnapshotHeader::VERSION
+        || header.opsOffset+header.opsSize > file.size)
+      throw std::runtime_error("#bn.snapshot: '"+fileName
+                               +"' is not a (compatible) barney snapshot");
+    const uint8_t *ptr = file.data+header.opsOffset;
+    const uint8_t *end = ptr+header.opsSize;
+    auto read = [&](void *dst, size_t n) {
+      if (ptr+n > end)
+        throw std::runtime_error("#bn.snapshot: '"+fileName+"' is truncated");
+      memcpy(dst,ptr,n); ptr += n;
+    };
+    auto read32 = [&]() { uint32_t v; read(&v,sizeof(v)); return v; };
+    auto read64 = [&]() { uint64_t v; read(&v,sizeof(v)); return v; };
+    ops.resize(header.numOps);
+    for (auto &op : ops) {
+      op.type    = (SnapshotOp::Type)read32();
+      op.target  = read32();
+      op.slot    = (int32_t)read32();
+      op.subType = read32();
+      op.name.resize(read32());
+      read(&op.name[0],op.name.size());
+      op.refs.resize(read32());
+      read(op.refs.data(),op.refs.size()*sizeof(uint32_t));
+      op.bytes.resize(read32());
+      read(op.bytes.data(),op.bytes.size());
+      op.payload.fileName   = fileName;
+      op.payload.fileOffset = read64();
+      op.payload.size       = read64();
+      if (op.payload.fileOffset+op.payload.size > file.size)
+        throw std::runtime_error("#bn.snapshot: '"+fileName+"' is truncated");
+    }
+  }
+
+}
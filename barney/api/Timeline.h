@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/api/Context.h"
+#include <fstream>
+#include <iostream>
+#include <set>
+
+namespace barney_api {
+
+  /*! if enabled (BARNEY_CONFIG=timeline=<file.json>), records begin
+      and end of every NvtxRange - ie, of all render phases, per rank
+      and per device - for writing out as a chrome-trace/perfetto json
+      once the context gets destroyed. In mpi runs every rank records
+      into its own, with times shifted onto rank 0's clock (see
+      MPIContext::alignTimelineClocks()), and rank 0 writes all ranks'
+      events into a single file */
+  struct Timeline {
+    struct Event {
+      std::string name;
+      /*! global rank of the device this is about; -1 for host-wide
+          ranges */
+      int    device;
+      int    generation;
+      double begin, end;
+    };
+
+    /*! the timeline all ranges get recorded into; null if not
+        enabled */
+    static inline Timeline *get();
+
+    inline void record(const std::string &name, int device, int generation,
+                       double begin, double end);
+    /*! all of this rank's events so far, as comma-separated chrome
+        trace events with pid 'rank', and times relative to 'origin'
+        (on rank 0's clock) */
+    inline std::string toJson(int rank, double origin);
+    /*! writes given comma-separated events into a trace file */
+    static inline void write(const std::string &fileName,
+                             const std::string &events);
+
+    /*! when this timeline got created, on this rank's clock */
+    const double created = getCurrentTime();
+    /*! what to add to this rank's times to get rank 0's */
+    double clockOffset = 0.;
+
+  private:
+    std::mutex         mutex;
+    std::vector<Event> events;
+  };
+
+
+
+  inline Timeline *Timeline::get()
+  {
+    static Timeline *timeline
+      = FromEnv::get()->timelineFile.empty() ? nullptr : new Timeline;
+    return timeline;
+  }
+
+  inline void Timeline::record(const std::string &name,
+                               int device, int generation,
+                               double begin, double end)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back({name,device,generation,begin,end});
+  }
+
+  inline std::string Timeline::toJson(int rank, double origin)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::stringstream ss;
+    ss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+       << ",\"args\":{\"name\":\"rank " << rank << "\"}}";
+    std::set<int> devices;
+    for (auto &event : events) {
+      // host-wide ranges go to thread 0, each device's to its own
+      const int tid = event.device+1;
+      if (devices.insert(tid).second)
+        ss << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << rank
+           << ",\"tid\":" << tid << ",\"args\":{\"name\":\""
+           << (event.device < 0
+               ? std::string("host")
+               : "device "+std::to_string(event.device))
+           << "\"}}";
+      const double ts = (event.begin+clockOffset-origin)*1e6;
+      ss << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\""
+         << ",\"pid\":" << rank << ",\"tid\":" << tid
+         << std::fixed << ",\"ts\":" << ts
+         << ",\"dur\":" << (event.end-event.begin)*1e6
+         << std::defaultfloat;
+      if (event.generation >= 0)
+        ss << ",\"args\":{\"generation\":" << event.generation << "}";
+      ss << "}";
+    }
+    return ss.str();
+  }
+
+  inline void Timeline::write(const std::string &fileName,
+                              const std::string &events)
+  {
+    std::ofstream out(fileName);
+    if (!out.good()) {
+      std::cerr << "#bn: could not write timeline to '"
+                << fileName << "'" << std::endl;
+      return;
+    }
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        << events << "\n]}\n";
+    std::cout << "#bn: timeline written to '" << fileName << "'"
+              << std::endl;
+  }
+
+}
@@ -4,6 +4,9 @@
 
 #include "rtcore/AppInterface.h"
 #include "barney/api/Context.h"
+#include "barney/api/MappedFile.h"
+#include "barney/api/Nvtx.h"
+#include "barney/api/Snapshot.h"
 #if BARNEY_MPI
 # include "barney/common/MPIWrappers.h"
 # include "barney/barney_mpi.h"
@@ -82,6 +85,42 @@ namespace barney_api {
         logBackend = true;
       else if (key == "LOG_TOPO" || key == "log_topo")
         logTopo = true;
+      else if (key == "LOG_BUILDS" || key == "log_builds")
+        logBuilds = true;
+      else if (key == "RAY_COUNT_INTERVAL" || key == "rayCountInterval")
+        rayCountInterval = std::max(1,std::stoi(value));
+      else if (key == "TAIL_THRESHOLD" || key == "tailThreshold")
+        tailThreshold = std::max(0,std::stoi(value));
+      else if (key == "FORWARD_CHUNKS" || key == "forwardChunks")
+        forwardChunks = std::max(1,std::stoi(value));
+      else if (key == "RAY_QUEUE_CAPACITY" || key == "rayQueueCapacity")
+        rayQueueCapacity = std::max(0,std::stoi(value));
+      else if (key == "GATHER_DELTA_THRESHOLD" || key == "gatherDeltaThreshold")
+        gatherDeltaThreshold = std::max(-1,std::stoi(value));
+      else if (key == "LOSSLESS_GATHER_AFTER" || key == "losslessGatherAfter")
+        losslessGatherAfter = std::max(0,std::stoi(value));
+      else if (key == "ACCEL_CACHE" || key == "accelCache")
+        accelCacheDir = value;
+      else if (key == "SHARED_DATA_MB" || key == "sharedDataMB")
+        sharedDataMB = std::max(0,std::stoi(value));
+      else if (key == "PIPELINE_CACHE" || key == "pipelineCache")
+        pipelineCacheDir = value;
+      else if (key == "CPU_WEIGHT" || key == "cpuWeight")
+        cpuWeight = std::max(1e-3f,std::stof(value));
+      else if (key == "GPU_WEIGHTS" || key == "gpuWeights") {
+        if (value == "auto")
+          measureGpuWeights = true;
+        else {
+          std::stringstream ss(value);
+          std::string weight;
+          while (std::getline(ss,weight,','))
+            gpuWeights.push_back(std::max(1e-3f,std::stof(weight)));
+        }
+      }
+      else if (key == "STREAM_TEXTURES_MB" || key == "streamTexturesMB")
+        streamTexturesMB = std::max(0,std::stoi(value));
+      else if (key == "TIMELINE" || key == "timeline")
+        timelineFile = value;
       else
         std::cerr << "Warning: unknown or unrecognized BARNEY_CONFIG key '" << key << "'" << std::endl;
     }
@@ -244,6 +283,163 @@ namespace barney_api {
   }
   // ------------------------------------------------------------------
 
+  // ------------------------------------------------------------------
+  // snapshot recording (see Snapshot.h); all of these do nothing
+  // unless the object's context records
+  // ------------------------------------------------------------------
+
+  /*! records the creation of given object, and returns its ID (0 if
+      nothing got recorded) */
+  inline uint32_t recordCreate(Context *context,
+                               SnapshotOp::Type type,
+                               const Object::SP &object,
+                               int slot,
+                               const std::string &name = "",
+                               std::vector<uint32_t> refs = {})
+  {
+    SnapshotRecorder *rec = context->snapshot.get();
+    if (!rec || !object) return 0;
+    SnapshotOp op;
+    op.type   = type;
+    op.target = rec->add(object);
+    op.slot   = slot;
+    op.name   = name;
+    op.refs   = std::move(refs);
+    uint32_t ID = op.target;
+    rec->record(std::move(op));
+    return ID;
+  }
+
+  /*! records an op on an existing object; returns null if that
+      object isn't getting recorded */
+  inline SnapshotRecorder *recorderFor(const Object *object,
+                                       SnapshotOp &op,
+                                       SnapshotOp::Type type)
+  {
+    SnapshotRecorder *rec = object->getContext()->snapshot.get();
+    if (!rec) return nullptr;
+    op.type   = type;
+    op.target = rec->idOf(object);
+    return op.target ? rec : nullptr;
+  }
+
+  /*! the IDs of given handles; or (for raw-data arrays) a host copy
+      of the items, read back from the data array they just got set
+      into (at given offset) since they may be device memory - see
+      bnDataCreate(); only arrays that can't read back get copied
+      from items directly */
+  inline void recordItems(SnapshotRecorder *rec,
+                          SnapshotOp &op,
+                          Data *data,
+                          size_t offset,
+                          BNDataType type,
+                          const void *items,
+                          size_t count)
+  {
+    if (!items) return;
+    if (isObjectDataType(type)) {
+      for (size_t i=0;i<count;i++)
+        op.refs.push_back(rec->idOf(((Object *const *)items)[i]));
+      return;
+    }
+    op.payload.size = count*snapshotSizeOf(type);
+    op.payload.owned.resize(op.payload.size);
+    if (!data->readBack(offset,count,op.payload.owned.data()))
+      memcpy(op.payload.owned.data(),items,op.payload.size);
+  }
+
+  inline void recordTextureData(Context *context,
+                                const std::shared_ptr<TextureData> &td,
+                                int slot,
+                                BNDataType texelFormat,
+                                vec3i dims,
+                                const void *texels,
+                                const char *fileName = nullptr,
+                                size_t fileOffset = 0)
+  {
+    SnapshotRecorder *rec = context->snapshot.get();
+    if (!rec || !td) return;
+    SnapshotOp op;
+    op.type    = SnapshotOp::CREATE_TEXTURE_DATA;
+    op.target  = rec->add(td);
+    op.slot    = slot;
+    op.subType = texelFormat;
+    op.setValue(dims);
+    if (fileName) {
+      op.payload.fileName   = fileName;
+      op.payload.fileOffset = fileOffset;
+      op.payload.size       = snapshotTexelBytes(texelFormat,dims);
+    } else if (texels) {
+      op.payload.size = snapshotTexelBytes(texelFormat,dims);
+      op.payload.owned.resize(op.payload.size);
+      memcpy(op.payload.owned.data(),texels,op.payload.size);
+    }
+    rec->record(std::move(op));
+  }
+
+  struct SnapshotRange {
+    uint64_t offset;
+    uint64_t count;
+  };
+
+  struct SnapshotTextureParams {
+    int filterMode;
+    int addressModes[3];
+    int colorSpace;
+  };
+
+  inline void recordTexture(Context *context,
+                            const std::shared_ptr<Texture> &tex,
+                            const std::shared_ptr<TextureData> &td,
+                            BNTextureFilterMode  filterMode,
+                            const BNTextureAddressMode addressModes[3],
+                            BNTextureColorSpace  colorSpace)
+  {
+    SnapshotRecorder *rec = context->snapshot.get();
+    if (!rec || !tex) return;
+    SnapshotOp op;
+    op.type   = SnapshotOp::CREATE_TEXTURE;
+    op.refs   = { rec->idOf(td.get()) };
+    op.target = rec->add(tex);
+    SnapshotTextureParams params
+      = { (int)filterMode,
+          { (int)addressModes[0],(int)addressModes[1],(int)addressModes[2] },
+          (int)colorSpace };
+    op.setValue(params);
+    rec->record(std::move(op));
+  }
+
+  template<typename T>
+  inline void recordParam(BNObject target,
+                          const char *param,
+                          SnapshotOp::ParamKind kind,
+                          const T &value)
+  {
+    SnapshotOp op;
+    SnapshotRecorder *rec
+      = recorderFor(checkGet(target),op,SnapshotOp::SET_PARAM);
+    if (!rec) return;
+    op.name    = param;
+    op.subType = kind;
+    op.setValue(value);
+    rec->record(std::move(op));
+  }
+
+  inline void recordParamRef(BNObject target,
+                             const char *param,
+                             SnapshotOp::ParamKind kind,
+                             BNObject value)
+  {
+    SnapshotOp op;
+    SnapshotRecorder *rec
+      = recorderFor(checkGet(target),op,SnapshotOp::SET_PARAM);
+    if (!rec) return;
+    op.name    = param;
+    op.subType = kind;
+    op.refs    = { rec->idOf((Object *)value) };
+    rec->record(std::move(op));
+  }
+
   /*! creates a cudaArray2D of specified size and texels. Can be passed
     to a sampler to create a matching cudaTexture2D, or as a background
     image to a renderer */
@@ -262,6 +458,8 @@ namespace barney_api {
                                      texelFormat,
                                      vec3i(width,height,0),
                                      texels);
+    recordTextureData(context,td,slot,texelFormat,
+                      vec3i(width,height,0),texels);
     return (BNTextureData)context->initReference(td);
   }
   
@@ -279,6 +477,49 @@ namespace barney_api {
                                    texelFormat,
                                    vec3i(width,height,depth),
                                    texels);
+    recordTextureData(context,td,slot,texelFormat,
+                      vec3i(width,height,depth),texels);
+    return (BNTextureData)context->initReference(td);
+  }
+
+  BARNEY_API
+  BNTextureData bnTextureData3DCreateAsync(BNContext _context,
+                                           int slot,
+                                           BNDataType texelFormat,
+                                           int width, int height, int depth,
+                                           const void *texels)
+  {
+    LOG_API_ENTRY;
+    Context *context = checkGet(_context);
+    std::shared_ptr<TextureData> td
+      = context->createTextureData(slot,
+                                   texelFormat,
+                                   vec3i(width,height,depth),
+                                   texels,
+                                   /*asyncUpload*/true);
+    recordTextureData(context,td,slot,texelFormat,
+                      vec3i(width,height,depth),texels);
+    return (BNTextureData)context->initReference(td);
+  }
+
+  BARNEY_API
+  BNTextureData bnTextureData3DCreateFromFile(BNContext _context,
+                                              int slot,
+                                              BNDataType texelFormat,
+                                              int width, int height, int depth,
+                                              const char *fileName,
+                                              size_t offset)
+  {
+    LOG_API_ENTRY;
+    Context *context = checkGet(_context);
+    std::shared_ptr<TextureData> td
+      = context->createTextureDataFromFile(slot,
+                                           texelFormat,
+                                           vec3i(width,height,depth),
+                                           fileName,offset);
+    recordTextureData(context,td,slot,texelFormat,
+                      vec3i(width,height,depth),nullptr,
+                      fileName,offset);
     return (BNTextureData)context->initReference(td);
   }
 
@@ -311,6 +552,9 @@ namespace barney_api {
                                filterMode,
                                addressModes,
                                colorSpace);
+    recordTextureData(context,td,slot,texelFormat,
+                      vec3i(size_x,size_y,0),texels);
+    recordTexture(context,tex,td,filterMode,addressModes,colorSpace);
     return (BNTexture2D)context->initReference(tex);
   }
 
@@ -338,6 +582,10 @@ namespace barney_api {
                                filterMode,
                                addressModes,
                                BN_COLOR_SPACE_LINEAR);
+    recordTextureData(context,td,slot,texelFormat,
+                      vec3i(size_x,size_y,size_z),texels);
+    recordTexture(context,tex,td,filterMode,addressModes,
+                  BN_COLOR_SPACE_LINEAR);
     return (BNTexture3D)context->initReference(tex);
   }
   
@@ -349,16 +597,305 @@ namespace barney_api {
     LOG_API_ENTRY;
     Context *context = checkGet(_context);
     std::shared_ptr<Model> model = context->createModel();
+    recordCreate(context,SnapshotOp::CREATE_MODEL,model,0);
     return (BNModel)context->initReference(model);
   }
 
+  BARNEY_API
+  void bnContextRecordSnapshot(BNContext _context, int enable)
+  {
+    LOG_API_ENTRY;
+    Context *context = checkGet(_context);
+    if (!enable)
+      context->snapshot.reset();
+    else if (!context->snapshot)
+      context->snapshot = std::make_shared<SnapshotRecorder>();
+  }
+
+  BARNEY_API
+  int bnModelSave(BNModel _model, const char *fileName)
+  {
+    LOG_API_ENTRY;
+    try {
+      Model *model = checkGet(_model);
+      SnapshotRecorder *rec = model->getContext()->snapshot.get();
+      if (!rec || !rec->idOf(model))
+        throw std::runtime_error("model was not created while its "
+                                 "context was recording (see "
+                                 "bnContextRecordSnapshot())");
+      rec->save(model,checkGet(fileName));
+      return 1;
+    } catch (std::exception &e) {
+      std::cerr << OWL_TERMINAL_RED << "@bnModelSave: "
+                << e.what() << OWL_TERMINAL_DEFAULT << std::endl;
+      return 0;
+    }
+  }
+
+  BARNEY_API
+  BNModel bnModelLoad(BNContext _context, const char *fileName)
+  {
+    LOG_API_ENTRY;
+    Context *context = checkGet(_context);
+    /* snapshot ID -> object we re-created for it */
+    std::map<uint32_t,BNObject> objects;
+    BNModel model = 0;
+    auto get = [&](uint32_t ID) -> BNObject {
+      if (ID == 0) return 0;
+      auto it = objects.find(ID);
+      if (it == objects.end())
+        throw std::runtime_error("snapshot refers to unknown object #"
+                                 +std::to_string(ID));
+      return it->second;
+    };
+    auto handles = [&](const SnapshotOp &op, size_t begin, size_t end) {
+      std::vector<BNObject> result;
+      for (size_t i=begin;i<end;i++)
+        result.push_back(get(op.refs[i]));
+      return result;
+    };
+    try {
+      SnapshotFile file(checkGet(fileName));
+      for (auto &op : file.ops) {
+        const int slot = op.slot;
+        const char *name = op.name.c_str();
+        BNObject created = 0;
+        switch (op.type) {
+        case SnapshotOp::CREATE_MODEL:
+          created = (BNObject)(model = bnModelCreate(_context));
+          break;
+        case SnapshotOp::CREATE_DATA: {
+          const BNDataType type = (BNDataType)op.subType;
+          const size_t count = op.getValue<uint64_t>();
+          if (isObjectDataType(type)) {
+            std::vector<BNObject> items = handles(op,0,op.refs.size());
+            created = (BNObject)bnDataCreate(_context,slot,type,count,
+                                             items.empty()
+                                             ? nullptr : items.data());
+          } else if (op.payload.size)
+            created = (BNObject)bnDataCreateFromFile
+              (_context,slot,type,count,fileName,op.payload.fileOffset);
+          else
+            created = (BNObject)bnDataCreate(_context,slot,type,count,nullptr);
+        } break;
+        case SnapshotOp::CREATE_TEXTURE_DATA: {
+          const vec3i dims = op.getValue<vec3i>();
+          const BNDataType format = (BNDataType)op.subType;
+          created = op.payload.size
+            ? (BNObject)bnTextureData3DCreateFromFile
+            (_context,slot,format,dims.x,dims.y,dims.z,
+             fileName,op.payload.fileOffset)
+            : (BNObject)bnTextureData3DCreate
+            (_context,slot,format,dims.x,dims.y,dims.z,nullptr);
+        } break;
+        case SnapshotOp::CREATE_TEXTURE: {
+          auto params = op.getValue<SnapshotTextureParams>();
+          std::shared_ptr<TextureData> td
+            = checkGet(get(op.refs[0]))->shared_from_this()->as<TextureData>();
+          BNTextureAddressMode addressModes[3];
+          for (int i=0;i<3;i++)
+            addressModes[i] = (BNTextureAddressMode)params.addressModes[i];
+          std::shared_ptr<Texture> tex
+            = context->createTexture(td,
+                                     (BNTextureFilterMode)params.filterMode,
+                                     addressModes,
+                                     (BNTextureColorSpace)params.colorSpace);
+          recordTexture(context,tex,td,
+                        (BNTextureFilterMode)params.filterMode,
+                        addressModes,
+                        (BNTextureColorSpace)params.colorSpace);
+          created = (BNObject)context->initReference(tex);
+        } break;
+        case SnapshotOp::CREATE_SCALAR_FIELD:
+          created = (BNObject)bnScalarFieldCreate(_context,slot,name);
+          break;
+        case SnapshotOp::CREATE_GEOMETRY:
+          created = (BNObject)bnGeometryCreate(_context,slot,name);
+          break;
+        case SnapshotOp::CREATE_MATERIAL:
+          created = (BNObject)bnMaterialCreate(_context,slot,name);
+          break;
+        case SnapshotOp::CREATE_SAMPLER:
+          created = (BNObject)bnSamplerCreate(_context,slot,name);
+          break;
+        case SnapshotOp::CREATE_LIGHT:
+          created = (BNObject)bnLightCreate(_context,slot,name);
+          break;
+        case SnapshotOp::CREATE_VOLUME:
+          created = (BNObject)bnVolumeCreate(_context,slot,
+                                             (BNScalarField)get(op.refs[0]));
+          break;
+        case SnapshotOp::CREATE_GROUP: {
+          const size_t numGeoms = std::stoul(op.name);
+          std::vector<BNObject> geoms = handles(op,0,numGeoms);
+          std::vector<BNObject> volumes = handles(op,numGeoms,op.refs.size());
+          created = (BNObject)bnGroupCreate(_context,slot,
+                                            (BNGeom*)geoms.data(),
+                                            (int)geoms.size(),
+                                            (BNVolume*)volumes.data(),
+                                            (int)volumes.size());
+        } break;
+        case SnapshotOp::DATA_SET:
+        case SnapshotOp::DATA_SET_RANGE: {
+          const BNDataType type = (BNDataType)op.subType;
+          std::vector<BNObject> items;
+          const void *ptr = file.payload(op);
+          if (isObjectDataType(type)) {
+            items = handles(op,0,op.refs.size());
+            ptr = items.empty() ? nullptr : items.data();
+          }
+          if (op.type == SnapshotOp::DATA_SET)
+            bnDataSet((BNData)get(op.target),op.getValue<uint64_t>(),ptr);
+          else {
+            auto range = op.getValue<SnapshotRange>();
+            bnDataSetRange((BNData)get(op.target),
+                           range.offset,range.count,ptr);
+          }
+        } break;
+        case SnapshotOp::SET_PARAM: {
+          BNObject target = get(op.target);
+          switch (op.subType) {
+          case SnapshotOp::PARAM_STRING:
+            bnSetString(target,name,
+                        std::string(op.bytes.begin(),op.bytes.end()).c_str());
+            break;
+          case SnapshotOp::PARAM_OBJECT:
+            bnSetObject(target,name,get(op.refs[0]));
+            break;
+          case SnapshotOp::PARAM_DATA:
+            bnSetData(target,name,(BNData)get(op.refs[0]));
+            break;
+          case SnapshotOp::PARAM_1F:
+            bnSet1f(target,name,op.getValue<float>());
+            break;
+          case SnapshotOp::PARAM_2F: {
+            auto v = op.getValue<vec2f>();
+            bnSet2f(target,name,v.x,v.y);
+          } break;
+          case SnapshotOp::PARAM_3F: {
+            auto v = op.getValue<vec3f>();
+            bnSet3f(target,name,v.x,v.y,v.z);
+          } break;
+          case SnapshotOp::PARAM_4F: {
+            auto v = op.getValue<vec4f>();
+            bnSet4f(target,name,v.x,v.y,v.z,v.w);
+          } break;
+          case SnapshotOp::PARAM_1I:
+            bnSet1i(target,name,op.getValue<int>());
+            break;
+          case SnapshotOp::PARAM_2I: {
+            auto v = op.getValue<vec2i>();
+            bnSet2i(target,name,v.x,v.y);
+          } break;
+          case SnapshotOp::PARAM_3I: {
+            auto v = op.getValue<vec3i>();
+            bnSet3i(target,name,v.x,v.y,v.z);
+          } break;
+          case SnapshotOp::PARAM_4I: {
+            auto v = op.getValue<vec4i>();
+            bnSet4i(target,name,v.x,v.y,v.z,v.w);
+          } break;
+          case SnapshotOp::PARAM_4X3F: {
+            auto v = op.getValue<BNTransform>();
+            bnSet4x3fv(target,name,&v);
+          } break;
+          case SnapshotOp::PARAM_4X4F: {
+            bn_float4 v[4];
+            memcpy(v,op.bytes.data(),std::min(op.bytes.size(),sizeof(v)));
+            bnSet4x4fv(target,name,v);
+          } break;
+          default:
+            throw std::runtime_error("invalid parameter kind in snapshot");
+          }
+        } break;
+        case SnapshotOp::COMMIT:
+          bnCommit(get(op.target));
+          break;
+        case SnapshotOp::VOLUME_XF: {
+          const vec3f v = op.getValue<vec3f>();
+          /* the mapping is read-only, and small; copy it */
+          std::vector<bn_float4> values(op.payload.size/sizeof(bn_float4));
+          if (!values.empty())
+            memcpy(values.data(),file.payload(op),op.payload.size);
+          bnVolumeSetXF((BNVolume)get(op.target),bn_float2{v.x,v.y},
+                        values.data(),(int)values.size(),v.z);
+        } break;
+        case SnapshotOp::SET_INSTANCES:
+        case SnapshotOp::UPDATE_INSTANCE_XFMS: {
+          std::vector<BNTransform> xfms(op.payload.size/sizeof(BNTransform));
+          if (!xfms.empty())
+            memcpy(xfms.data(),file.payload(op),op.payload.size);
+          if (op.type == SnapshotOp::SET_INSTANCES) {
+            std::vector<BNObject> groups = handles(op,0,op.refs.size());
+            bnSetInstances((BNModel)get(op.target),slot,
+                           (BNGroup*)groups.data(),xfms.data(),
+                           (int)xfms.size());
+          } else
+            bnUpdateInstanceTransforms((BNModel)get(op.target),slot,
+                                       xfms.data(),(int)xfms.size());
+        } break;
+        case SnapshotOp::SET_INSTANCE_ATTRIBUTES:
+          bnSetInstanceAttributes((BNModel)get(op.target),slot,name,
+                                  (BNData)get(op.refs[0]));
+          break;
+        case SnapshotOp::SET_DOMAIN_BOUNDS: {
+          const box3f bounds = op.getValue<box3f>();
+          bnSetDomainBounds((BNModel)get(op.target),slot,
+                            (const bn_float3&)bounds.lower,
+                            (const bn_float3&)bounds.upper);
+        } break;
+        case SnapshotOp::GROUPS_BUILD: {
+          std::vector<BNObject> groups = handles(op,0,op.refs.size());
+          if (!groups.empty())
+            bnGroupsBuild((BNGroup*)groups.data(),(int)groups.size());
+        } break;
+        case SnapshotOp::MODEL_BUILD:
+          bnBuild((BNModel)get(op.target),slot);
+          break;
+        case SnapshotOp::UPDATE_INSTANCE_XFMS_SPARSE: {
+          const int count = op.getValue<int>();
+          std::vector<int>         instIDs(count);
+          std::vector<BNTransform> xfms(count);
+          const uint8_t *payload = (const uint8_t *)file.payload(op);
+          if (count) {
+            memcpy(instIDs.data(),payload,count*sizeof(int));
+            memcpy(xfms.data(),payload+count*sizeof(int),
+                   count*sizeof(BNTransform));
+          }
+          bnUpdateInstanceTransformsSparse((BNModel)get(op.target),slot,
+                                           instIDs.data(),xfms.data(),count);
+        } break;
+        default:
+          throw std::runtime_error("invalid op in snapshot");
+        }
+        if (created)
+          objects[op.target] = created;
+      }
+      if (!model)
+        throw std::runtime_error("snapshot does not contain a model");
+    } catch (std::exception &e) {
+      std::cerr << OWL_TERMINAL_RED << "@bnModelLoad: "
+                << e.what() << OWL_TERMINAL_DEFAULT << std::endl;
+      for (auto it : objects)
+        bnRelease(it.second);
+      return 0;
+    }
+    /* all the objects we created are referenced by the model (or
+       not at all) by now; only hand out the model itself */
+    for (auto it : objects)
+      if (it.second != (BNObject)model)
+        bnRelease(it.second);
+    return model;
+  }
+
   BARNEY_API
   BNRenderer bnRendererCreate(BNContext _context,
-                              const char *ignoreForNow)
+                              const char *type)
   {
     LOG_API_ENTRY;
     Context *context = checkGet(_context);
-    std::shared_ptr<Renderer> renderer = context->createRenderer();
+    std::shared_ptr<Renderer> renderer
+      = context->createRenderer(type ? type : "default");
     return (BNRenderer)context->initReference(renderer);
   }
 
@@ -376,6 +913,14 @@ namespace barney_api {
       ? ((Data *)value)->shared_from_this()->as<Data>()
       : Data::SP{};
     checkGet(model)->setInstanceAttributes(slot,whichAttribute,data);
+    SnapshotOp op;
+    if (SnapshotRecorder *rec
+        = recorderFor(checkGet(model),op,SnapshotOp::SET_INSTANCE_ATTRIBUTES)) {
+      op.slot = slot;
+      op.name = whichAttribute;
+      op.refs = { rec->idOf(data.get()) };
+      rec->record(std::move(op));
+    }
   }
 
   
@@ -391,6 +936,18 @@ namespace barney_api {
                                   (Group **)_groups,
                                   (const affine3f *)xfms,
                                   numInstances);
+    SnapshotOp op;
+    if (SnapshotRecorder *rec
+        = recorderFor(checkGet(model),op,SnapshotOp::SET_INSTANCES)) {
+      op.slot = slot;
+      for (int i=0;i<numInstances;i++)
+        op.refs.push_back(rec->idOf((Object *)_groups[i]));
+      op.payload.size = numInstances*sizeof(BNTransform);
+      op.payload.owned.resize(op.payload.size);
+      if (numInstances)
+        memcpy(op.payload.owned.data(),xfms,op.payload.size);
+      rec->record(std::move(op));
+    }
   }
 
   BARNEY_API
@@ -403,6 +960,62 @@ namespace barney_api {
     checkGet(model)->updateInstanceTransforms(slot,
                                               (const affine3f *)xfms,
                                               numInstances);
+    SnapshotOp op;
+    if (SnapshotRecorder *rec
+        = recorderFor(checkGet(model),op,SnapshotOp::UPDATE_INSTANCE_XFMS)) {
+      op.slot = slot;
+      op.payload.size = numInstances*sizeof(BNTransform);
+      op.payload.owned.resize(op.payload.size);
+      if (numInstances)
+        memcpy(op.payload.owned.data(),xfms,op.payload.size);
+      rec->record(std::move(op));
+    }
+  }
+  
+  BARNEY_API
+  void bnUpdateInstanceTransformsSparse(BNModel model,
+                                        int slot,
+                                        const int *instIDs,
+                                        const BNTransform *xfms,
+                                        int count)
+  {
+    LOG_API_ENTRY;
+    checkGet(model)->updateInstanceTransformsSparse(slot,instIDs,
+                                                    (const affine3f *)xfms,
+                                                    count);
+    SnapshotOp op;
+    if (SnapshotRecorder *rec
+        = recorderFor(checkGet(model),op,SnapshotOp::UPDATE_INSTANCE_XFMS_SPARSE)) {
+      op.slot = slot;
+      op.setValue(count);
+      op.payload.size = count*(sizeof(int)+sizeof(BNTransform));
+      op.payload.owned.resize(op.payload.size);
+      if (count) {
+        memcpy(op.payload.owned.data(),instIDs,count*sizeof(int));
+        memcpy(op.payload.owned.data()+count*sizeof(int),xfms,
+               count*sizeof(BNTransform));
+      }
+      rec->record(std::move(op));
+    }
+  }
+  
+  BARNEY_API
+  void bnSetDomainBounds(BNModel model,
+                         int slot,
+                         bn_float3 lower,
+                         bn_float3 upper)
+  {
+    LOG_API_ENTRY;
+    checkGet(model)->setDomainBounds(slot,
+                                     box3f((const vec3f&)lower,
+                                           (const vec3f&)upper));
+    SnapshotOp op;
+    if (SnapshotRecorder *rec
+        = recorderFor(checkGet(model),op,SnapshotOp::SET_DOMAIN_BOUNDS)) {
+      op.slot = slot;
+      op.setValue(box3f((const vec3f&)lower,(const vec3f&)upper));
+      rec->record(std::move(op));
+    }
   }
   
   BARNEY_API
@@ -434,6 +1047,40 @@ namespace barney_api {
     delete (Context *)context;
   }
 
+  BARNEY_API
+  int bnContextGetMemoryInfo(BNContext context,
+                             BNDeviceMemoryInfo *infos,
+                             int maxInfos)
+  {
+    LOG_API_ENTRY;
+    if (!infos) maxInfos = 0;
+    return checkGet(context)->getMemoryInfo(infos,maxInfos);
+  }
+
+  BARNEY_API
+  void bnContextResetMemoryHighWater(BNContext context)
+  {
+    LOG_API_ENTRY;
+    checkGet(context)->resetMemoryHighWater();
+  }
+
+  BARNEY_API
+  int bnContextGetBuildRecords(BNContext context,
+                               BNBuildRecord *records,
+                               int maxRecords)
+  {
+    LOG_API_ENTRY;
+    if (!records) maxRecords = 0;
+    return checkGet(context)->getBuildRecords(records,maxRecords);
+  }
+
+  BARNEY_API
+  void bnContextClearBuildRecords(BNContext context)
+  {
+    LOG_API_ENTRY;
+    checkGet(context)->clearBuildRecords();
+  }
+
   BARNEY_API
   BNScalarField bnScalarFieldCreate(BNContext _context,
                                     int slot,
@@ -442,6 +1089,7 @@ namespace barney_api {
     Context *context = checkGet(_context);
     std::shared_ptr<ScalarField> sf
       = context->createScalarField(slot,type);
+    recordCreate(context,SnapshotOp::CREATE_SCALAR_FIELD,sf,slot,type);
     return (BNScalarField)context->initReference(sf);
   }
   
@@ -454,6 +1102,7 @@ namespace barney_api {
     Context *context = checkGet(_context);
     std::shared_ptr<Geometry> geom
       = context->createGeometry(slot,type);
+    recordCreate(context,SnapshotOp::CREATE_GEOMETRY,geom,slot,type);
     return (BNGeom)context->initReference(geom);
   }
 
@@ -466,6 +1115,7 @@ namespace barney_api {
     Context *context = checkGet(_context);
     std::shared_ptr<Material> material
       = context->createMaterial(slot,type);
+    recordCreate(context,SnapshotOp::CREATE_MATERIAL,material,slot,type);
     return (BNMaterial)context->initReference(material);
   }
 
@@ -479,6 +1129,7 @@ namespace barney_api {
     std::shared_ptr<Sampler> sampler
       = context->createSampler(slot,type);
     if (!sampler) return 0;
+    recordCreate(context,SnapshotOp::CREATE_SAMPLER,sampler,slot,type);
     return (BNSampler)context->initReference(sampler);
   }
   
@@ -507,6 +1158,16 @@ namespace barney_api {
     checkGet(volume)->setXF(range1f(domain.x,domain.y),
                             _values,numValues,
                             densityAt1);
+    SnapshotOp op;
+    if (SnapshotRecorder *rec
+        = recorderFor(checkGet(volume),op,SnapshotOp::VOLUME_XF)) {
+      op.setValue(vec3f(domain.x,domain.y,densityAt1));
+      op.payload.size = numValues*sizeof(bn_float4);
+      op.payload.owned.resize(op.payload.size);
+      if (numValues)
+        memcpy(op.payload.owned.data(),_values,op.payload.size);
+      rec->record(std::move(op));
+    }
   }
   
   BARNEY_API
@@ -520,6 +1181,9 @@ namespace barney_api {
     std::shared_ptr<ScalarField> sf = checkGetSP(_sf);
     std::shared_ptr<Volume> volume
       = context->createVolume(checkGetSP(_sf));
+    if (SnapshotRecorder *rec = context->snapshot.get())
+      recordCreate(context,SnapshotOp::CREATE_VOLUME,volume,slot,"",
+                   { rec->idOf(sf.get()) });
     return (BNVolume)context->initReference(volume);
   }
 
@@ -532,6 +1196,7 @@ namespace barney_api {
     Context *context = checkGet(_context);
     std::shared_ptr<Light> light
       = context->createLight(slot,type);
+    recordCreate(context,SnapshotOp::CREATE_LIGHT,light,slot,type);
     return (BNLight)context->initReference(light);
   }
 
@@ -547,9 +1212,103 @@ namespace barney_api {
     std::shared_ptr<Data> data
       = context->createData(slot,dataType);
     data->set(items,numItems);
+    if (SnapshotRecorder *rec = context->snapshot.get()) {
+      SnapshotOp op;
+      op.type    = SnapshotOp::CREATE_DATA;
+      op.target  = rec->add(data);
+      op.slot    = slot;
+      op.subType = dataType;
+      op.setValue(uint64_t(numItems));
+      recordItems(rec,op,data.get(),0,dataType,items,numItems);
+      {
+        std::lock_guard<std::mutex> lock(rec->mutex);
+        rec->dataTypes[op.target] = dataType;
+      }
+      rec->record(std::move(op));
+    }
+    return (BNData)context->initReference(data);
+  }
+
+  BARNEY_API
+  BNData bnDataCreateFromFile(BNContext _context,
+                              int slot,
+                              BNDataType dataType,
+                              size_t numItems,
+                              const char *fileName,
+                              size_t offset)
+  {
+    LOG_API_ENTRY;
+    Context *context = checkGet(_context);
+    std::shared_ptr<Data> data
+      = context->createData(slot,dataType);
+    data->setFromFile(fileName,offset,numItems);
+    if (SnapshotRecorder *rec = context->snapshot.get()) {
+      SnapshotOp op;
+      op.type    = SnapshotOp::CREATE_DATA;
+      op.target  = rec->add(data);
+      op.slot    = slot;
+      op.subType = dataType;
+      op.setValue(uint64_t(numItems));
+      op.payload.fileName   = fileName;
+      op.payload.fileOffset = offset;
+      op.payload.size       = numItems*snapshotSizeOf(dataType);
+      {
+        std::lock_guard<std::mutex> lock(rec->mutex);
+        rec->dataTypes[op.target] = dataType;
+      }
+      rec->record(std::move(op));
+    }
     return (BNData)context->initReference(data);
   }
 
+  BARNEY_API
+  BNData bnDataCreateReplicated(BNContext _context,
+                                int slot,
+                                BNDataType dataType,
+                                size_t numItems,
+                                const char *fileName,
+                                size_t offset)
+  {
+    LOG_API_ENTRY;
+    Context *context = checkGet(_context);
+    if (isObjectDataType(dataType))
+      throw std::runtime_error("#bn: bnDataCreateReplicated() can only "
+                               "read arrays of plain data types");
+    BNData data = 0;
+    context->readReplicated(fileName,offset,
+                            numItems*snapshotSizeOf(dataType),
+                            [&](const void *items)
+                            {
+                              data = bnDataCreate(_context,slot,dataType,
+                                                  numItems,items);
+                            });
+    return data;
+  }
+
+  BARNEY_API
+  BNTextureData bnTextureData3DCreateReplicated(BNContext _context,
+                                                int slot,
+                                                BNDataType texelFormat,
+                                                int width, int height, int depth,
+                                                const char *fileName,
+                                                size_t offset)
+  {
+    LOG_API_ENTRY;
+    Context *context = checkGet(_context);
+    BNTextureData td = 0;
+    context->readReplicated(fileName,offset,
+                            snapshotTexelBytes(texelFormat,
+                                               vec3i(width,height,depth)),
+                            [&](const void *texels)
+                            {
+                              td = bnTextureData3DCreate(_context,slot,
+                                                         texelFormat,
+                                                         width,height,depth,
+                                                         texels);
+                            });
+    return td;
+  }
+
   BARNEY_API
   void bnDataSet(BNData _data,
                  size_t numItems,
@@ -557,6 +1316,42 @@ namespace barney_api {
   {
     Data::SP data = checkGetSP(_data);
     data->set(items,(int)numItems);
+    SnapshotOp op;
+    if (SnapshotRecorder *rec
+        = recorderFor(data.get(),op,SnapshotOp::DATA_SET)) {
+      BNDataType type;
+      {
+        std::lock_guard<std::mutex> lock(rec->mutex);
+        type = rec->dataTypes[op.target];
+      }
+      op.subType = type;
+      op.setValue(uint64_t(numItems));
+      recordItems(rec,op,data.get(),0,type,items,numItems);
+      rec->record(std::move(op));
+    }
+  }
+
+  BARNEY_API
+  void bnDataSetRange(BNData _data,
+                      size_t offset,
+                      size_t numItems,
+                      const void *items)
+  {
+    Data::SP data = checkGetSP(_data);
+    data->setRange(offset,items,numItems);
+    SnapshotOp op;
+    if (SnapshotRecorder *rec
+        = recorderFor(data.get(),op,SnapshotOp::DATA_SET_RANGE)) {
+      BNDataType type;
+      {
+        std::lock_guard<std::mutex> lock(rec->mutex);
+        type = rec->dataTypes[op.target];
+      }
+      op.subType = type;
+      op.setValue(SnapshotRange{ uint64_t(offset), uint64_t(numItems) });
+      recordItems(rec,op,data.get(),offset,type,items,numItems);
+      rec->record(std::move(op));
+    }
   }
 
   
@@ -575,6 +1370,15 @@ namespace barney_api {
       group = context->createGroup(slot,
                                    (Geometry **)geoms,numGeoms,
                                    (Volume **)volumes,numVolumes);
+    if (SnapshotRecorder *rec = context->snapshot.get()) {
+      std::vector<uint32_t> refs;
+      for (int i=0;i<numGeoms;i++)
+        refs.push_back(rec->idOf((Object *)geoms[i]));
+      for (int i=0;i<numVolumes;i++)
+        refs.push_back(rec->idOf((Object *)volumes[i]));
+      recordCreate(context,SnapshotOp::CREATE_GROUP,group,slot,
+                   std::to_string(numGeoms),refs);
+    }
     return (BNGroup)context->initReference(group);
     BARNEY_LEAVE(__PRETTY_FUNCTION__,0);
   }
@@ -591,6 +1395,33 @@ namespace barney_api {
       return;
     }
     checkGet(group)->build();
+    if (SnapshotRecorder *rec = checkGet(group)->context->snapshot.get()) {
+      SnapshotOp op;
+      op.type = SnapshotOp::GROUPS_BUILD;
+      op.refs = { rec->idOf(checkGet(group)) };
+      rec->record(std::move(op));
+    }
+    BARNEY_LEAVE(__PRETTY_FUNCTION__,);
+  }
+
+  BARNEY_API
+  void  bnGroupsBuild(BNGroup *groups, int numGroups)
+  {
+    LOG_API_ENTRY;
+    BARNEY_ENTER(__PRETTY_FUNCTION__);
+    std::vector<Group *> toBuild;
+    for (int i=0;i<numGroups;i++)
+      if (groups[i]) toBuild.push_back(checkGet(groups[i]));
+    if (toBuild.empty())
+      return;
+    toBuild[0]->context->buildGroups(toBuild.data(),(int)toBuild.size());
+    if (SnapshotRecorder *rec = toBuild[0]->context->snapshot.get()) {
+      SnapshotOp op;
+      op.type = SnapshotOp::GROUPS_BUILD;
+      for (auto group : toBuild)
+        op.refs.push_back(rec->idOf(group));
+      rec->record(std::move(op));
+    }
     BARNEY_LEAVE(__PRETTY_FUNCTION__,);
   }
   
@@ -601,6 +1432,12 @@ namespace barney_api {
     BARNEY_ENTER(__PRETTY_FUNCTION__);
     LOG_API_ENTRY;
     checkGet(model)->build(slot);
+    SnapshotOp op;
+    if (SnapshotRecorder *rec
+        = recorderFor(checkGet(model),op,SnapshotOp::MODEL_BUILD)) {
+      op.slot = slot;
+      rec->record(std::move(op));
+    }
     BARNEY_LEAVE(__PRETTY_FUNCTION__,);
   }
   
@@ -608,7 +1445,12 @@ namespace barney_api {
   void bnCommit(BNObject target)
   {
     LOG_API_ENTRY;
-    checkGet(target)->commit();
+    auto object = checkGet(target);
+    NvtxRange nvtx(("commit "+object->toString()).c_str());
+    object->getContext()->commit(object);
+    SnapshotOp op;
+    if (SnapshotRecorder *rec = recorderFor(object,op,SnapshotOp::COMMIT))
+      rec->record(std::move(op));
   }
               
   BARNEY_API
@@ -616,6 +1458,17 @@ namespace barney_api {
   {
     if (!checkGet(target)->setString(checkGet(param),value))
       checkGet(target)->warn_unsupported_member(param,"std::string");
+    else {
+      SnapshotOp op;
+      SnapshotRecorder *rec
+        = recorderFor(checkGet(target),op,SnapshotOp::SET_PARAM);
+      if (rec) {
+        op.name    = param;
+        op.subType = SnapshotOp::PARAM_STRING;
+        if (value) op.bytes.assign(value,value+strlen(value));
+        rec->record(std::move(op));
+      }
+    }
   }
 
   BARNEY_API
@@ -627,6 +1480,8 @@ namespace barney_api {
       : Data::SP{};
     if (!checkGet(target)->setData(checkGet(param),data))
       checkGet(target)->warn_unsupported_member(param,"BNData");
+    else
+      recordParamRef(target,param,SnapshotOp::PARAM_DATA,(BNObject)value);
   }
 
   BARNEY_API
@@ -639,6 +1494,8 @@ namespace barney_api {
     bool accepted = checkGet(target)->setObject(checkGet(param),asObject);
     if (!accepted)
       checkGet(target)->warn_unsupported_member(param,"BNObject");
+    else
+      recordParamRef(target,param,SnapshotOp::PARAM_OBJECT,value);
   }
 
   BARNEY_API
@@ -646,6 +1503,8 @@ namespace barney_api {
   {
     if (!checkGet(target)->set1i(checkGet(param),x))
       checkGet(target)->warn_unsupported_member(param,"int");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_1I,x);
   }
 
   BARNEY_API
@@ -653,6 +1512,8 @@ namespace barney_api {
   {
     if (!checkGet(target)->set2i(checkGet(param),vec2i(x,y)))
       checkGet(target)->warn_unsupported_member(param,"vec2i");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_2I,vec2i(x,y));
   }
 
   BARNEY_API
@@ -660,6 +1521,8 @@ namespace barney_api {
   {
     if (!checkGet(target)->set3i(checkGet(param),vec3i(x,y,z)))
       checkGet(target)->warn_unsupported_member(param,"vec3i");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_3I,vec3i(x,y,z));
   }
 
 # ifdef __VECTOR_TYPES__
@@ -668,6 +1531,8 @@ namespace barney_api {
   {
     if (!checkGet(target)->set3i(checkGet(param),(const vec3i&)value))
       checkGet(target)->warn_unsupported_member(param,"vec3i");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_3I,(const vec3i&)value);
   }
 #endif
   
@@ -676,6 +1541,8 @@ namespace barney_api {
   {
     if (!checkGet(target)->set4i(checkGet(param),vec4i(x,y,z,w)))
       checkGet(target)->warn_unsupported_member(param,"vec4i");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_4I,vec4i(x,y,z,w));
   }
 
   BARNEY_API
@@ -683,6 +1550,8 @@ namespace barney_api {
   {
     if (!checkGet(target)->set1f(checkGet(param),value))
       checkGet(target)->warn_unsupported_member(param,"float");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_1F,value);
   }
 
   BARNEY_API
@@ -690,6 +1559,8 @@ namespace barney_api {
   {
     if (!checkGet(target)->set2f(checkGet(param),vec2f(x,y)))
       checkGet(target)->warn_unsupported_member(param,"vec2f");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_2F,vec2f(x,y));
   }
 
   BARNEY_API
@@ -697,6 +1568,8 @@ namespace barney_api {
   {
     if (!checkGet(target)->set3f(checkGet(param),vec3f(x,y,z)))
       checkGet(target)->warn_unsupported_member(param,"vec3f");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_3F,vec3f(x,y,z));
   }
 
   BARNEY_API
@@ -704,6 +1577,8 @@ namespace barney_api {
   {
     if (!checkGet(target)->set4f(checkGet(param),vec4f(x,y,z,w)))
       checkGet(target)->warn_unsupported_member(param,"vec4f");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_4F,vec4f(x,y,z,w));
   }
 
   BARNEY_API
@@ -712,6 +1587,8 @@ namespace barney_api {
     assert(transform);
     if (!checkGet(target)->set4x3f(checkGet(param),*(const affine3f*)transform))
       checkGet(target)->warn_unsupported_member(param,"affine3f");
+    else
+      recordParam(target,param,SnapshotOp::PARAM_4X3F,*(const affine3f*)transform);
   }
 
   BARNEY_API
@@ -720,6 +1597,11 @@ namespace barney_api {
     assert(transform);
     if (!checkGet(target)->set4x4f(checkGet(param),(const vec4f*)transform))
       checkGet(target)->warn_unsupported_member(param,"mat4f");
+    else {
+      struct { vec4f m[4]; } mat;
+      memcpy(&mat,transform,sizeof(mat));
+      recordParam(target,param,SnapshotOp::PARAM_4X4F,mat);
+    }
   }
   
 
@@ -758,6 +1640,20 @@ namespace barney_api {
     checkGet(fb)->read(channel,hostPtr,requestedFormat);
   }
 
+  BARNEY_API
+  void bnFrameBufferSetColorTarget(BNFrameBuffer fb, int fd, size_t numBytes)
+  {
+    LOG_API_ENTRY;
+    checkGet(fb)->setColorTarget(fd,numBytes);
+  }
+
+  BARNEY_API
+  size_t bnFrameBufferGetEncodedSize(BNFrameBuffer fb)
+  {
+    LOG_API_ENTRY;
+    return checkGet(fb)->getEncodedSize();
+  }
+
   BARNEY_API
   void bnFrameBufferGetSize(BNFrameBuffer fb, int *sizeX, int *sizeY)
   {
@@ -767,6 +1663,42 @@ namespace barney_api {
     *sizeY = np.y;
   }
 
+  BARNEY_API
+  int bnFrameBufferGetStats(BNFrameBuffer fb, BNFrameStats *stats)
+  {
+    if (!stats) return 0;
+    return checkGet(fb)->getStats(*stats);
+  }
+
+  BARNEY_API
+  int bnFrameBufferGetCounters(BNFrameBuffer fb, BNDeviceCounters *counters)
+  {
+    if (!counters) return 0;
+    return checkGet(fb)->getCounters(*counters);
+  }
+
+  BARNEY_API
+  int bnFrameBufferIsConverged(BNFrameBuffer fb)
+  {
+    return checkGet(fb)->isConverged();
+  }
+
+  BARNEY_API
+  void bnFrameBufferWriteAsync(BNFrameBuffer fb,
+                               const char *baseName,
+                               uint32_t channels)
+  {
+    LOG_API_ENTRY;
+    checkGet(fb)->writeAsync(checkGet(baseName),channels);
+  }
+
+  BARNEY_API
+  int bnFrameBufferFlushWrites(BNFrameBuffer fb)
+  {
+    LOG_API_ENTRY;
+    return checkGet(fb)->flushWrites();
+  }
+
   BARNEY_API
   void bnAccumReset(BNFrameBuffer fb)
   {
@@ -785,6 +1717,55 @@ namespace barney_api {
     checkGet(model)->render(checkGet(renderer),checkGet(camera),checkGet(fb));
   }
 
+  BARNEY_API
+  void bnRenderMulti(BNRenderer           renderer,
+                     BNModel              model,
+                     const BNCamera      *cameras,
+                     const BNFrameBuffer *fbs,
+                     int                  numViews)
+  {
+    static int numCalls = 0;
+    if (++numCalls < 10)
+      LOG_API_ENTRY;
+    if (numViews <= 0) return;
+    std::vector<Camera *>      viewCameras(numViews);
+    std::vector<FrameBuffer *> viewFBs(numViews);
+    for (int i=0;i<numViews;i++) {
+      viewCameras[i] = checkGet(cameras[i]);
+      viewFBs[i]     = checkGet(fbs[i]);
+    }
+    checkGet(model)->renderMulti(checkGet(renderer),
+                                 viewCameras.data(),viewFBs.data(),
+                                 numViews);
+  }
+
+  BARNEY_API
+  void bnPick(BNModel          model,
+              BNCamera         camera,
+              int              sizeX,
+              int              sizeY,
+              const bn_float2 *screenPos,
+              int              numPicks,
+              BNPickResult    *results)
+  {
+    if (numPicks <= 0) return;
+    assert(screenPos);
+    assert(results);
+    checkGet(model)->pick(checkGet(camera),vec2i(sizeX,sizeY),
+                          (const vec2f *)screenPos,numPicks,results);
+  }
+
+  BARNEY_API
+  void bnTraceRays(BNModel       model,
+                   const BNRay  *rays,
+                   int           numRays,
+                   BNRayHit     *hits)
+  {
+    /* even without rays of our own we have to take part */
+    assert(numRays == 0 || (rays && hits));
+    checkGet(model)->traceRays(rays,std::max(numRays,0),hits);
+  }
+
   BARNEY_API
   BNContext bnContextCreate(/*! how many data slots this context is to
                               offer, and which part(s) of the
@@ -1007,8 +1988,13 @@ namespace barney_api {
     // one will take 2 and 3.
     // ------------------------------------------------------------------
 
+    /* ranks are free to pick different backends - for example, one
+       rank per node driving the node's cpu cores (BARNEY_FORCE_CPU)
+       next to the ones driving its gpus; see 'cpuWeight' for how
+       tiles get split between those */
 #if BARNEY_BACKEND_EMBREE && !(BARNEY_BACKEND_CUDA || BARNEY_BACKEND_OPTIX)
-    // bool forceCPU = true;
+    return (BNContext)createMPIContext_embree(world,
+                                              dataGroupIDs);
 #else
     if (_gpuIDs && numGPUs == 1 && _gpuIDs[0] == -1) {
 # if BARNEY_BACKEND_EMBREE
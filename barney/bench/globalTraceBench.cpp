@@ -0,0 +1,293 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+/*! micro-benchmark for the different global trace (ie, ray
+    forwarding) strategies: sets up an MPIContext with an empty
+    model whose data ranks cover disjoint slabs of the unit cube, fills
+    all ray queues with synthetic rays, and has each GlobalTraceImpl
+    trace those in isolation - no ray generation, no shading, no BVH
+    cost to speak of. Run with the same mpirun/BARNEY_CONFIG setup you
+    would use for rendering, e.g.
+
+    mpirun -n 4 barneyGlobalTraceBench -ndg 4 -n 1000000
+*/
+
+#include "barney/MPIContext.h"
+#include "barney/GlobalModel.h"
+#include "barney/render/RayQueue.h"
+#include "barney/fb/FrameProfiler.h"
+#include "barney/globalTrace/RQSMPI.h"
+#include "barney/globalTrace/RQSLocal.h"
+#include "barney/globalTrace/All2all.h"
+#include "barney/globalTrace/TwoStage.h"
+#include "barney/globalTrace/Transport.h"
+#include <random>
+#include <sstream>
+
+namespace BARNEY_NS {
+
+  struct BenchConfig {
+    /*! rays in each device's queue, every frame */
+    int   numRaysPerDevice = 1<<20;
+    /*! number of different data ranks; rank r holds data rank(s)
+        (r*slotsPerRank+i) % numDataGroups */
+    int   numDataGroups    = -1;
+    int   slotsPerRank     = 1;
+    int   gpusPerSlot      = 1;
+    /*! fraction of rays that get a short tMax, as if they had
+        already hit something close to their origin */
+    float hitFraction      = 0.f;
+    int   numFrames        = 10;
+    std::vector<std::string> impls
+    = { "rqs", "all2all", "two-stage", "local" };
+  };
+
+  void usage(const std::string &error)
+  {
+    if (!error.empty())
+      std::cerr << "error: " << error << "\n\n";
+    std::cerr
+      << "usage: barneyGlobalTraceBench [args]*\n"
+      << "  -n <numRays>        rays per device and frame\n"
+      << "  -ndg <numDG>        number of data ranks (default: #ranks*spr)\n"
+      << "  -spr <numSlots>     model slots (data ranks) per rank\n"
+      << "  -gps <numGPUs>      gpus per model slot\n"
+      << "  -hit <fraction>     fraction of rays with a short tMax\n"
+      << "  -frames <N>         frames to average over\n"
+      << "  -impl <a,b,...>     any of rqs,all2all,two-stage,local\n";
+    exit(error.empty() ? 0 : 1);
+  }
+
+  struct GlobalTraceBench {
+    GlobalTraceBench(MPIContext *context, const BenchConfig &config);
+    ~GlobalTraceBench();
+
+    void run(const std::string &implName);
+
+    void resetRays();
+
+    MPIContext        *const context;
+    BenchConfig        const config;
+    GlobalModel::SP    model;
+    FrameProfiler     *profiler = nullptr;
+    /*! per local device, the rays each frame starts out with */
+    std::vector<Ray *> initialRays;
+  };
+
+  GlobalTraceBench::GlobalTraceBench(MPIContext *context,
+                                     const BenchConfig &config)
+    : context(context),
+      config(config)
+  {
+    model = GlobalModel::create(context);
+    for (int slot=0;slot<(int)context->perSlot.size();slot++) {
+      int dataRank = context->perSlot[slot].modelRankInThisSlot;
+      float x0 = dataRank/float(config.numDataGroups);
+      float x1 = (dataRank+1)/float(config.numDataGroups);
+      model->setDomainBounds(slot,box3f(vec3f(x0,0.f,0.f),vec3f(x1,1.f,1.f)));
+      model->build(slot);
+    }
+
+    std::mt19937 rng(context->myRank());
+    std::uniform_real_distribution<float> uniform(0.f,1.f);
+    /* rays aren't default-constructible on the host, so just fill in
+       a raw array */
+    std::vector<uint8_t> storage(config.numRaysPerDevice*sizeof(Ray));
+    Ray *rays = (Ray *)storage.data();
+    for (auto device : *context->devices) {
+      for (int i=0;i<config.numRaysPerDevice;i++) {
+        Ray &ray = rays[i];
+        memset((void*)&ray,0,sizeof(ray));
+        ray.org = vec3f(uniform(rng),uniform(rng),uniform(rng));
+        vec3f dir;
+        do {
+          dir = 2.f*vec3f(uniform(rng),uniform(rng),uniform(rng))-1.f;
+        } while (dot(dir,dir) > 1.f || dot(dir,dir) < 1e-6f);
+        ray.dir  = normalize(dir);
+        ray.tMax = uniform(rng) < config.hitFraction ? .05f : BARNEY_INF;
+      }
+      SetActiveGPU forDuration(device);
+      device->rayQueue->resize(config.numRaysPerDevice);
+      Ray *d_rays
+        = (Ray*)device->rtc->allocMem(config.numRaysPerDevice*sizeof(Ray));
+      device->rtc->copyAsync(d_rays,rays,
+                             config.numRaysPerDevice*sizeof(Ray));
+      device->rtc->sync();
+      initialRays.push_back(d_rays);
+    }
+    profiler = new FrameProfiler(context->devices);
+  }
+
+  GlobalTraceBench::~GlobalTraceBench()
+  {
+    for (auto device : *context->devices) {
+      SetActiveGPU forDuration(device);
+      device->rtc->freeMem(initialRays[device->localRank()]);
+    }
+    delete profiler;
+  }
+
+  void GlobalTraceBench::resetRays()
+  {
+    for (auto device : *context->devices) {
+      SetActiveGPU forDuration(device);
+      RayQueue *rayQueue = device->rayQueue;
+      device->rtc->copyAsync(rayQueue->traceAndShadeReadQueue.rays,
+                             initialRays[device->localRank()],
+                             config.numRaysPerDevice*sizeof(Ray));
+      rayQueue->numActive = config.numRaysPerDevice;
+      rayQueue->numActiveIsExact = true;
+    }
+    for (auto device : *context->devices)
+      device->rtc->sync();
+  }
+
+  void GlobalTraceBench::run(const std::string &implName)
+  {
+    GlobalTraceImpl *impl = nullptr;
+    if (implName == "rqs")
+      impl = new RQSMPI(context);
+    else if (implName == "all2all")
+      impl = new MPIAll2all(context);
+    else if (implName == "two-stage")
+      impl = new TwoStage(context);
+    else if (implName == "local") {
+      /* RQSLocal can only forward between devices of the same rank */
+      if (context->world.size != 1) {
+        if (context->myRank() == 0)
+          std::cout << "#bn.bench: " << implName
+                    << " : skipped (needs a single rank)" << std::endl;
+        return;
+      }
+      impl = new RQSLocal(context);
+    } else
+      throw std::runtime_error("unknown global trace impl '"+implName+"'");
+
+    GlobalTraceImpl *savedImpl = context->globalTraceImpl;
+    context->globalTraceImpl = impl;
+
+    double sumTime = 0.;
+    double sumTrace = 0.;
+    double sumForward = 0.;
+    size_t sumBytes = 0;
+    /* frame -1 is for warm-up, and doesn't get counted */
+    for (int frame=-1;frame<config.numFrames;frame++) {
+      impl->beginFrame(model.get());
+      resetRays();
+      context->workers.barrier();
+
+      size_t bytesBefore = context->transport->numBytesSent;
+      double t0 = MPI_Wtime();
+      context->activeProfiler = profiler;
+      context->activeGeneration = 0;
+      profiler->beginFrame();
+      {
+        FrameProfiler::Scope profile(profiler,FrameProfiler::FORWARD,0);
+        context->traceRaysGlobally(model.get(),frame,false);
+      }
+      for (auto device : *context->devices)
+        device->rtc->sync();
+      context->activeProfiler = nullptr;
+      context->workers.barrier();
+      double t1 = MPI_Wtime();
+      if (frame < 0) continue;
+
+      BNFrameStats stats;
+      profiler->getStats(stats);
+      sumTime    += t1-t0;
+      sumTrace   += stats.trace[0];
+      sumForward += stats.forward[0];
+      sumBytes   += context->transport->numBytesSent-bytesBefore;
+    }
+    context->globalTraceImpl = savedImpl;
+    delete impl;
+
+    int   numFrames  = std::max(1,config.numFrames);
+    float numRays    = context->workers.allReduceAdd
+      (float(config.numRaysPerDevice)*context->devices->size());
+    float mbPerFrame = context->workers.allReduceAdd
+      (float(sumBytes/double(numFrames)/(1<<20)));
+    float frameTime  = context->workers.allReduceMax(float(sumTime/numFrames));
+    float traceTime
+      = context->workers.allReduceMax(float(sumTrace/numFrames));
+    float forwardTime
+      = context->workers.allReduceMax(float(sumForward/numFrames));
+    if (context->myRank() == 0) {
+      std::stringstream ss;
+      ss << "#bn.bench: " << implName
+         << " : " << prettyNumber((size_t)numRays) << " rays/frame"
+         << ", " << (numRays/frameTime*1e-6f) << " Mrays/s"
+         << ", " << mbPerFrame << " MB/frame on the wire ("
+         << context->transport->name() << ")"
+         << ", frame " << (frameTime*1e3f) << "ms"
+         << " (trace " << traceTime << "ms"
+         << ", forward " << forwardTime << "ms)";
+      std::cout << ss.str() << std::endl;
+    }
+  }
+
+}
+
+int main(int ac, char **av)
+{
+  barney_api::mpi::init(ac,av);
+  barney_api::mpi::Comm world(MPI_COMM_WORLD);
+
+  BARNEY_NS::BenchConfig config;
+  for (int i=1;i<ac;i++) {
+    const std::string arg = av[i];
+    auto next = [&]() -> std::string {
+      if (i+1 >= ac) BARNEY_NS::usage("missing value for '"+arg+"'");
+      return av[++i];
+    };
+    if (arg == "-h" || arg == "--help")
+      BARNEY_NS::usage("");
+    else if (arg == "-n")
+      config.numRaysPerDevice = std::stoi(next());
+    else if (arg == "-ndg")
+      config.numDataGroups = std::stoi(next());
+    else if (arg == "-spr")
+      config.slotsPerRank = std::stoi(next());
+    else if (arg == "-gps")
+      config.gpusPerSlot = std::stoi(next());
+    else if (arg == "-hit")
+      config.hitFraction = std::stof(next());
+    else if (arg == "-frames")
+      config.numFrames = std::stoi(next());
+    else if (arg == "-impl") {
+      config.impls.clear();
+      std::stringstream ss(next());
+      std::string impl;
+      while (std::getline(ss,impl,','))
+        config.impls.push_back(impl);
+    } else
+      BARNEY_NS::usage("unknown arg '"+arg+"'");
+  }
+  if (config.numDataGroups < 1)
+    config.numDataGroups = world.size*config.slotsPerRank;
+
+  std::vector<BARNEY_NS::LocalSlot> localSlots(config.slotsPerRank);
+  for (int slot=0;slot<config.slotsPerRank;slot++) {
+    localSlots[slot].dataRank
+      = (world.rank*config.slotsPerRank+slot) % config.numDataGroups;
+    for (int j=0;j<config.gpusPerSlot;j++)
+      localSlots[slot].gpuIDs.push_back(slot*config.gpusPerSlot+j);
+  }
+  barney_api::mpi::Comm workers = world.split(1);
+  {
+    BARNEY_NS::MPIContext context(world,workers,localSlots,false);
+    if (world.rank == 0)
+      std::cout << "#bn.bench: " << world.size << " ranks, "
+                << context.topo->allDevices.size() << " devices, "
+                << config.numDataGroups << " data ranks, "
+                << config.numRaysPerDevice << " rays per device, "
+                << "hit fraction " << config.hitFraction << std::endl;
+    BARNEY_NS::GlobalTraceBench bench(&context,config);
+    for (auto impl : config.impls)
+      bench.run(impl);
+  }
+  workers.free();
+  barney_api::mpi::finalize();
+  return 0;
+}
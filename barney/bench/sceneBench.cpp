@@ -0,0 +1,715 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+/*! headless standard-scene benchmark: builds one of a handful of
+    procedural, fully reproducible scenes in memory - through the
+    public barney API only, so the same source works against every
+    backend barney got built with - renders a fixed number of frames
+    and prints build/commit/render timings as json. E.g.,
+
+    barneyBench -scene spheres -n 1000000 -res 1920 1080 -frames 32
+    barneyBench -scene structured -n 512 -cpu
+    mpirun -n 4 barneyBench_mpi -scene umesh -n 128
+
+    In the mpi variant every rank is its own data rank, owning the
+    slab [rank/size,(rank+1)/size) of the unit cube in x; what gets
+    generated doesn't depend on the number of ranks, only who owns it
+    does. With -stats barney runs with profiling enabled (which costs
+    a few syncs per frame), and the json also has the total number of
+    rays traced per second, not just primary ones.
+*/
+
+#include "barney/barney.h"
+#if BARNEY_MPI
+# include "barney/barney_mpi.h"
+#endif
+#if BARNEY_HAVE_NANOVDB
+# include <nanovdb/tools/CreatePrimitives.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace barney_bench {
+
+  struct BenchConfig {
+    std::string scene = "spheres";
+    /*! scene size: number of primitives for the surface scenes,
+        cells per dimension for the volume ones, lights for 'lights' */
+    size_t numItems   = 0;
+    int    width       = 1024;
+    int    height      = 1024;
+    int    spp         = 1;
+    int    numFrames   = 16;
+    int    warmUp      = 2;
+    bool   forceCPU    = false;
+    bool   withStats   = false;
+    /*! reads back the color channel after every frame; otherwise
+        only after the last one */
+    bool   readback    = true;
+  };
+
+  void usage(const std::string &error)
+  {
+    if (!error.empty())
+      std::cerr << "error: " << error << "\n\n";
+    std::cerr
+      << "usage: barneyBench [args]*\n"
+      << "  -scene <name>       spheres, curves, triangles, structured, amr,\n"
+      << "                      umesh, nanovdb, or lights\n"
+      << "  -n <size>           primitives, cells per dimension, or lights\n"
+      << "  -res <w> <h>        frame buffer size\n"
+      << "  -spp <N>            paths per pixel\n"
+      << "  -frames <N>         frames to average over\n"
+      << "  -warmup <N>         frames to render before measuring\n"
+      << "  -cpu                use the cpu (embree) backend\n"
+      << "  -stats              profile, and report all rays, not only primary\n"
+      << "  -no-readback        only read the frame buffer after the last frame\n";
+    exit(error.empty() ? 0 : 1);
+  }
+
+  typedef std::chrono::steady_clock Clock;
+
+  inline double msSince(Clock::time_point begin)
+  {
+    return std::chrono::duration<double,std::milli>(Clock::now()-begin).count();
+  }
+
+  inline bn_float3 make3f(float x, float y, float z) { return { x,y,z }; }
+
+  /*! the part of the unit cube this rank holds */
+  struct Region {
+    float x0 = 0.f, x1 = 1.f;
+    bool owns(float x) const { return x >= x0 && (x < x1 || x1 >= 1.f); }
+  };
+
+  /*! smooth, non-trivial field over the unit cube that all volume
+      scenes sample */
+  inline float fieldValue(float x, float y, float z)
+  {
+    const float k = 6.2831853f*3.f;
+    float dx = x-.5f, dy = y-.5f, dz = z-.5f;
+    float r2 = dx*dx+dy*dy+dz*dz;
+    return std::max(0.f,1.f-4.f*r2)
+      * (.5f+.5f*sinf(k*x)*sinf(k*y)*sinf(k*z));
+  }
+
+  struct Scene {
+    std::vector<BNGroup> groups;
+    std::vector<BNTransform> xfms;
+    size_t numPrims = 0;
+  };
+
+  struct SceneBench {
+    SceneBench(BNContext context, const BenchConfig &config,
+               int rank, int size)
+      : context(context), config(config), rank(rank)
+    {
+      region.x0 = rank/float(size);
+      region.x1 = (rank+1)/float(size);
+    }
+
+    /*! creates and commits all objects of the configured scene */
+    void createScene();
+    void build();
+    void render();
+    std::string toJSON(int numRanks) const;
+
+    BNMaterial createMatte(float r, float g, float b);
+    BNGroup    createGeomGroup(BNGeom geom, BNData lights=0);
+    BNGroup    createVolumeGroup(BNScalarField sf);
+    BNData     createData(BNDataType type, size_t n, const void *items)
+    { return bnDataCreate(context,0,type,n,items); }
+    void       addInstance(BNGroup group, float scale=1.f);
+
+    void createSpheres(size_t n);
+    void createCurves(size_t n);
+    void createTriangles(size_t n);
+    void createStructured(int n);
+    void createAMR(int n);
+    void createUMesh(int n);
+    void createNanoVDB(int n);
+    void createLightRoom(int n);
+
+    BNContext   const context;
+    BenchConfig const config;
+    int         const rank;
+    Region      region;
+    Scene       scene;
+    BNModel     model = 0;
+
+    double commitTime = 0.;
+    double buildTime  = 0.;
+    double firstFrameTime = 0.;
+    double frameTime  = 0.;
+    double raysPerFrame = 0.;
+  };
+
+  BNMaterial SceneBench::createMatte(float r, float g, float b)
+  {
+    BNMaterial mat = bnMaterialCreate(context,0,"AnariMatte");
+    bnSet3f(mat,"color",r,g,b);
+    bnCommit(mat);
+    return mat;
+  }
+
+  BNGroup SceneBench::createGeomGroup(BNGeom geom, BNData lights)
+  {
+    BNGroup group = bnGroupCreate(context,0,&geom,1,nullptr,0);
+    if (lights) {
+      bnSetData(group,"lights",lights);
+      bnCommit(group);
+    }
+    bnRelease(geom);
+    return group;
+  }
+
+  BNGroup SceneBench::createVolumeGroup(BNScalarField sf)
+  {
+    BNVolume volume = bnVolumeCreate(context,0,sf);
+    std::vector<bn_float4> colorMap;
+    for (int i=0;i<64;i++) {
+      float t = i/63.f;
+      colorMap.push_back({ t, .3f+.4f*t, 1.f-t, t });
+    }
+    bnVolumeSetXF(volume,{ 0.f,1.f },colorMap.data(),(int)colorMap.size(),
+                  1.f);
+    bnCommit(volume);
+    BNGroup group = bnGroupCreate(context,0,nullptr,0,&volume,1);
+    bnRelease(volume);
+    bnRelease(sf);
+    return group;
+  }
+
+  void SceneBench::addInstance(BNGroup group, float scale)
+  {
+    BNTransform xfm;
+    xfm.l.vx = make3f(scale,0.f,0.f);
+    xfm.l.vy = make3f(0.f,scale,0.f);
+    xfm.l.vz = make3f(0.f,0.f,scale);
+    xfm.p    = make3f(0.f,0.f,0.f);
+    scene.groups.push_back(group);
+    scene.xfms.push_back(xfm);
+  }
+
+  // ------------------------------------------------------------------
+  // surface scenes: 'soups' of n primitives in the unit cube; item i
+  // always comes from the same seed, whichever rank ends up owning it
+  // ------------------------------------------------------------------
+
+  void SceneBench::createSpheres(size_t n)
+  {
+    std::vector<bn_float3> origins;
+    std::vector<float> radii;
+    float r = .5f/cbrtf((float)std::max(n,(size_t)1));
+    for (size_t i=0;i<n;i++) {
+      std::mt19937 rng((uint32_t)i);
+      std::uniform_real_distribution<float> uniform(0.f,1.f);
+      bn_float3 P = make3f(uniform(rng),uniform(rng),uniform(rng));
+      if (!region.owns(P.x)) continue;
+      origins.push_back(P);
+      radii.push_back(r*(.5f+uniform(rng)));
+    }
+    BNGeom geom = bnGeometryCreate(context,0,"spheres");
+    BNData o = createData(BN_FLOAT3,origins.size(),origins.data());
+    BNData rd = createData(BN_FLOAT,radii.size(),radii.data());
+    bnSetData(geom,"origins",o);
+    bnSetData(geom,"radii",rd);
+    bnRelease(o);
+    bnRelease(rd);
+    BNMaterial mat = createMatte(.8f,.6f,.3f);
+    bnSetObject(geom,"material",mat);
+    bnRelease(mat);
+    bnCommit(geom);
+    scene.numPrims = origins.size();
+    addInstance(createGeomGroup(geom));
+  }
+
+  /*! random-walk curves that go through barney's capsules, like
+      ANARI curves do */
+  void SceneBench::createCurves(size_t n)
+  {
+    const int segsPerCurve = 16;
+    size_t numCurves = std::max(n/segsPerCurve,(size_t)1);
+    float step = .5f/cbrtf((float)numCurves);
+    std::vector<bn_float3> positions;
+    std::vector<float> radii;
+    std::vector<int> indices;
+    for (size_t c=0;c<numCurves;c++) {
+      std::mt19937 rng((uint32_t)c);
+      std::uniform_real_distribution<float> uniform(0.f,1.f);
+      bn_float3 P = make3f(uniform(rng),uniform(rng),uniform(rng));
+      if (!region.owns(P.x)) continue;
+      int begin = (int)positions.size();
+      for (int s=0;s<=segsPerCurve;s++) {
+        positions.push_back(P);
+        radii.push_back(.1f*step);
+        if (s < segsPerCurve) indices.push_back(begin+s);
+        P.x += step*(uniform(rng)-.5f);
+        P.y += step*(uniform(rng)-.5f);
+        P.z += step*(uniform(rng)-.5f);
+      }
+    }
+    BNGeom geom = bnGeometryCreate(context,0,"capsules");
+    BNData p = createData(BN_FLOAT3,positions.size(),positions.data());
+    BNData r = createData(BN_FLOAT,radii.size(),radii.data());
+    BNData i = createData(BN_INT,indices.size(),indices.data());
+    bnSetData(geom,"positions",p);
+    bnSetData(geom,"radii",r);
+    bnSetData(geom,"indices",i);
+    bnRelease(p);
+    bnRelease(r);
+    bnRelease(i);
+    BNMaterial mat = createMatte(.3f,.7f,.4f);
+    bnSetObject(geom,"material",mat);
+    bnRelease(mat);
+    bnCommit(geom);
+    scene.numPrims = indices.size();
+    addInstance(createGeomGroup(geom));
+  }
+
+  void SceneBench::createTriangles(size_t n)
+  {
+    float edge = 1.f/cbrtf((float)std::max(n,(size_t)1));
+    std::vector<bn_float3> vertices;
+    std::vector<bn_int3> indices;
+    for (size_t i=0;i<n;i++) {
+      std::mt19937 rng((uint32_t)i);
+      std::uniform_real_distribution<float> uniform(0.f,1.f);
+      bn_float3 P = make3f(uniform(rng),uniform(rng),uniform(rng));
+      if (!region.owns(P.x)) continue;
+      int begin = (int)vertices.size();
+      for (int v=0;v<3;v++)
+        vertices.push_back(make3f(P.x+edge*(uniform(rng)-.5f),
+                                  P.y+edge*(uniform(rng)-.5f),
+                                  P.z+edge*(uniform(rng)-.5f)));
+      indices.push_back({ begin,begin+1,begin+2 });
+    }
+    BNGeom geom = bnGeometryCreate(context,0,"triangles");
+    BNData v = createData(BN_FLOAT3,vertices.size(),vertices.data());
+    BNData i = createData(BN_INT3,indices.size(),indices.data());
+    bnSetData(geom,"vertices",v);
+    bnSetData(geom,"indices",i);
+    bnRelease(v);
+    bnRelease(i);
+    BNMaterial mat = createMatte(.5f,.5f,.8f);
+    bnSetObject(geom,"material",mat);
+    bnRelease(mat);
+    bnCommit(geom);
+    scene.numPrims = indices.size();
+    addInstance(createGeomGroup(geom));
+  }
+
+  // ------------------------------------------------------------------
+  // volume scenes, all sampling the same field over the unit cube at
+  // (about) n^3 cells
+  // ------------------------------------------------------------------
+
+  void SceneBench::createStructured(int n)
+  {
+    n = std::max(n,2);
+    /* one voxel of overlap with the next slab, so there's no gap */
+    int begin = (int)floorf(region.x0*(n-1));
+    int end   = std::min(n-1,(int)ceilf(region.x1*(n-1)));
+    int nx    = end-begin+1;
+    float h   = 1.f/(n-1);
+    std::vector<float> voxels(size_t(nx)*n*n);
+    for (int iz=0;iz<n;iz++)
+      for (int iy=0;iy<n;iy++)
+        for (int ix=0;ix<nx;ix++)
+          voxels[ix+nx*(iy+size_t(n)*iz)]
+            = fieldValue((begin+ix)*h,iy*h,iz*h);
+    BNTextureData td
+      = bnTextureData3DCreate(context,0,BN_FLOAT,nx,n,n,voxels.data());
+    BNScalarField sf = bnScalarFieldCreate(context,0,"structured");
+    bnSetObject(sf,"textureData",td);
+    bnRelease(td);
+    bnSet3i(sf,"dims",nx,n,n);
+    bnSet3f(sf,"gridOrigin",begin*h,0.f,0.f);
+    bnSet3f(sf,"gridSpacing",h,h,h);
+    bnCommit(sf);
+    scene.numPrims = voxels.size();
+    addInstance(createVolumeGroup(sf));
+  }
+
+  /*! two levels: coarse blocks (cell size 2) over all of the domain,
+      and fine ones (cell size 1) over its central eighth. The field
+      lives in finest-cell coordinates, [0,n)^3, and gets scaled into
+      the unit cube by its instance */
+  void SceneBench::createAMR(int n)
+  {
+    const int blockSize = 16;
+    n = std::max(4*blockSize,(n/(4*blockSize))*(4*blockSize));
+    std::vector<bn_int3> origins, dims;
+    std::vector<int> levels;
+    std::vector<uint64_t> offsets;
+    std::vector<float> scalars;
+    auto addBlock = [&](int level, int ox, int oy, int oz) {
+      const int cellSize = 1<<level;
+      float cx = (ox+.5f*blockSize*cellSize)/n;
+      if (!region.owns(cx)) return;
+      origins.push_back({ ox,oy,oz });
+      dims.push_back({ blockSize,blockSize,blockSize });
+      levels.push_back(level);
+      offsets.push_back(scalars.size());
+      for (int iz=0;iz<blockSize;iz++)
+        for (int iy=0;iy<blockSize;iy++)
+          for (int ix=0;ix<blockSize;ix++)
+            scalars.push_back(fieldValue((ox+(ix+.5f)*cellSize)/n,
+                                         (oy+(iy+.5f)*cellSize)/n,
+                                         (oz+(iz+.5f)*cellSize)/n));
+    };
+    const int coarse = 2*blockSize;
+    for (int z=0;z<n;z+=coarse)
+      for (int y=0;y<n;y+=coarse)
+        for (int x=0;x<n;x+=coarse)
+          addBlock(1,x,y,z);
+    for (int z=n/4;z<3*n/4;z+=blockSize)
+      for (int y=n/4;y<3*n/4;y+=blockSize)
+        for (int x=n/4;x<3*n/4;x+=blockSize)
+          addBlock(0,x,y,z);
+    int refinements[2] = { 2,2 };
+
+    BNScalarField sf = bnScalarFieldCreate(context,0,"BlockStructuredAMR");
+    struct { const char *name; BNDataType type; size_t n; const void *v; }
+    arrays[] = {
+      { "scalars",      BN_FLOAT32,      scalars.size(), scalars.data() },
+      { "grid.origins", BN_INT32_VEC3,   origins.size(), origins.data() },
+      { "grid.dims",    BN_INT32_VEC3,   dims.size(),    dims.data()    },
+      { "grid.levels",  BN_INT32,        levels.size(),  levels.data()  },
+      { "grid.offsets", BN_UINT64,       offsets.size(), offsets.data() },
+      { "level.refinements", BN_INT32,   2,              refinements    },
+    };
+    for (auto &a : arrays) {
+      BNData d = createData(a.type,a.n,a.v);
+      bnSetData(sf,a.name,d);
+      bnRelease(d);
+    }
+    bnCommit(sf);
+    scene.numPrims = scalars.size();
+    addInstance(createVolumeGroup(sf),1.f/n);
+  }
+
+  /*! n^3 cubes, each cut into six tets around its main diagonal */
+  void SceneBench::createUMesh(int n)
+  {
+    n = std::max(n,1);
+    const int nv = n+1;
+    std::vector<bn_float3> vertices;
+    std::vector<float> values;
+    for (int iz=0;iz<nv;iz++)
+      for (int iy=0;iy<nv;iy++)
+        for (int ix=0;ix<nv;ix++) {
+          float x = ix/float(n), y = iy/float(n), z = iz/float(n);
+          vertices.push_back(make3f(x,y,z));
+          values.push_back(fieldValue(x,y,z));
+        }
+    static const int tets[6][4] = {
+      { 0,1,3,7 },{ 0,3,2,7 },{ 0,2,6,7 },
+      { 0,6,4,7 },{ 0,4,5,7 },{ 0,5,1,7 }
+    };
+    std::vector<int> indices, cellBegin;
+    std::vector<uint8_t> cellTypes;
+    for (int iz=0;iz<n;iz++)
+      for (int iy=0;iy<n;iy++)
+        for (int ix=0;ix<n;ix++) {
+          if (!region.owns((ix+.5f)/n)) continue;
+          int corner[8];
+          for (int c=0;c<8;c++)
+            corner[c] = (ix+(c&1)) + nv*((iy+((c>>1)&1)) + nv*(iz+(c>>2)));
+          for (auto &tet : tets) {
+            cellBegin.push_back((int)indices.size());
+            cellTypes.push_back(10 /* VTK_TETRA */);
+            for (int v : tet) indices.push_back(corner[v]);
+          }
+        }
+    BNScalarField sf = bnScalarFieldCreate(context,0,"unstructured");
+    struct { const char *name; BNDataType type; size_t n; const void *v; }
+    arrays[] = {
+      { "vertex.position", BN_FLOAT3, vertices.size(),  vertices.data()  },
+      { "vertex.data",     BN_FLOAT,  values.size(),    values.data()    },
+      { "index",           BN_INT,    indices.size(),   indices.data()   },
+      { "cell.index",      BN_INT,    cellBegin.size(), cellBegin.data() },
+      { "cell.type",       BN_UINT8,  cellTypes.size(), cellTypes.data() },
+    };
+    for (auto &a : arrays) {
+      BNData d = createData(a.type,a.n,a.v);
+      bnSetData(sf,a.name,d);
+      bnRelease(d);
+    }
+    bnCommit(sf);
+    scene.numPrims = cellTypes.size();
+    addInstance(createVolumeGroup(sf));
+  }
+
+  /*! a fog-volume sphere per rank, centered in that rank's slab, n
+      voxels across (all ranks together), scaled into the unit cube */
+  void SceneBench::createNanoVDB(int n)
+  {
+#if BARNEY_HAVE_NANOVDB
+    n = std::max(n,8);
+    double cx = .5*(region.x0+region.x1)*n;
+    double radius = .45*std::min(double(region.x1-region.x0),1.)*n;
+    auto grid = nanovdb::tools::createFogVolumeSphere<float>
+      (radius,nanovdb::Vec3d(cx,.5*n,.5*n),1.,3.);
+    BNScalarField sf = bnScalarFieldCreate(context,0,"NanoVDB");
+    BNData d = createData(BN_UINT8,grid.size(),grid.data());
+    bnSetData(sf,"data",d);
+    bnRelease(d);
+    bnCommit(sf);
+    scene.numPrims = grid.size();
+    addInstance(createVolumeGroup(sf),1.f/n);
+#else
+    throw std::runtime_error("barney got built without nanovdb support");
+#endif
+  }
+
+  /*! closed box with a few spheres in it, lit by a n^2 grid of point
+      lights just below its ceiling - for light sampling, not traversal */
+  void SceneBench::createLightRoom(int n)
+  {
+    n = std::max(n,1);
+    std::vector<BNLight> lights;
+    for (int iy=0;iy<n;iy++)
+      for (int ix=0;ix<n;ix++) {
+        std::mt19937 rng((uint32_t)(ix+n*iy));
+        std::uniform_real_distribution<float> uniform(0.f,1.f);
+        BNLight light = bnLightCreate(context,0,"point");
+        bnSet3f(light,"position",(ix+.5f)/n,.95f,(iy+.5f)/n);
+        bnSet3f(light,"color",
+                .5f+.5f*uniform(rng),.5f+.5f*uniform(rng),.5f+.5f*uniform(rng));
+        bnSet1f(light,"intensity",4.f/(n*n));
+        bnCommit(light);
+        lights.push_back(light);
+      }
+    BNData lightsData = createData(BN_OBJECT,lights.size(),lights.data());
+    for (auto light : lights)
+      bnRelease(light);
+
+    /* inward-facing unit cube: 8 vertices, 12 triangles */
+    std::vector<bn_float3> vertices;
+    for (int c=0;c<8;c++)
+      vertices.push_back(make3f(float(c&1),float((c>>1)&1),float(c>>2)));
+    std::vector<bn_int3> indices = {
+      {0,2,1},{1,2,3},{4,5,6},{5,7,6},{0,1,4},{1,5,4},
+      {2,6,3},{3,6,7},{0,4,2},{2,4,6},{1,3,5},{3,7,5}
+    };
+    BNGeom room = bnGeometryCreate(context,0,"triangles");
+    BNData v = createData(BN_FLOAT3,vertices.size(),vertices.data());
+    BNData i = createData(BN_INT3,indices.size(),indices.data());
+    bnSetData(room,"vertices",v);
+    bnSetData(room,"indices",i);
+    bnRelease(v);
+    bnRelease(i);
+    BNMaterial mat = createMatte(.7f,.7f,.7f);
+    bnSetObject(room,"material",mat);
+    bnRelease(mat);
+    bnCommit(room);
+    /* every rank gets the room and the lights, and is responsible
+       for its own slab of spheres */
+    addInstance(createGeomGroup(room,lightsData));
+    bnRelease(lightsData);
+    createSpheres(64);
+    scene.numPrims = (size_t)n*n;
+  }
+
+  void SceneBench::createScene()
+  {
+    auto begin = Clock::now();
+    const std::string &s = config.scene;
+    size_t n = config.numItems;
+    if (s == "spheres")         createSpheres(n ? n : 1000000);
+    else if (s == "curves")     createCurves(n ? n : 1000000);
+    else if (s == "triangles")  createTriangles(n ? n : 1000000);
+    else if (s == "structured") createStructured(n ? (int)n : 256);
+    else if (s == "amr")        createAMR(n ? (int)n : 256);
+    else if (s == "umesh")      createUMesh(n ? (int)n : 64);
+    else if (s == "nanovdb")    createNanoVDB(n ? (int)n : 256);
+    else if (s == "lights")     createLightRoom(n ? (int)n : 16);
+    else usage("unknown scene '"+s+"'");
+    commitTime = msSince(begin);
+  }
+
+  void SceneBench::build()
+  {
+    auto begin = Clock::now();
+    model = bnModelCreate(context);
+    bnGroupsBuild(scene.groups.data(),(int)scene.groups.size());
+    bnSetInstances(model,0,scene.groups.data(),scene.xfms.data(),
+                   (int)scene.groups.size());
+    bnSetDomainBounds(model,0,
+                      make3f(region.x0,0.f,0.f),
+                      make3f(region.x1,1.f,1.f));
+    bnBuild(model,0);
+    buildTime = msSince(begin);
+    for (auto group : scene.groups)
+      bnRelease(group);
+  }
+
+  void SceneBench::render()
+  {
+    BNCamera camera = bnCameraCreate(context,"perspective");
+    bnSet3f(camera,"position",.5f,.5f,config.scene == "lights" ? .05f : -1.2f);
+    bnSet3f(camera,"direction",0.f,0.f,1.f);
+    bnSet3f(camera,"up",0.f,1.f,0.f);
+    bnSet1f(camera,"aspect",config.width/float(config.height));
+    bnSet1f(camera,"fovy",config.scene == "lights" ? 80.f : 45.f);
+    bnCommit(camera);
+
+    BNRenderer renderer = bnRendererCreate(context,"default");
+    bnSet1i(renderer,"pathsPerPixel",config.spp);
+    bnSet1f(renderer,"ambientRadiance",
+            config.scene == "lights" ? 0.f : .8f);
+    bnCommit(renderer);
+
+    BNFrameBuffer fb = bnFrameBufferCreate(context);
+    bnFrameBufferResize(fb,BN_UFIXED8_RGBA,config.width,config.height,
+                        BN_FB_COLOR);
+    std::vector<uint32_t> pixels(size_t(config.width)*config.height);
+
+    double sumTime = 0., sumRays = 0.;
+    for (int frame=-config.warmUp;frame<config.numFrames;frame++) {
+      auto begin = Clock::now();
+      bnRender(renderer,model,camera,fb);
+      if (config.readback || frame == config.numFrames-1)
+        bnFrameBufferRead(fb,BN_FB_COLOR,pixels.data(),BN_UFIXED8_RGBA);
+      double ms = msSince(begin);
+      if (frame == -config.warmUp) firstFrameTime = ms;
+      if (frame < 0) continue;
+      sumTime += ms;
+
+      double rays = double(config.width)*config.height*config.spp;
+      BNFrameStats stats;
+      if (config.withStats && bnFrameBufferGetStats(fb,&stats)) {
+        /* primary rays, plus every generation's survivors */
+        for (int g=0;g<stats.numGenerations
+               && g<BN_FRAME_STATS_MAX_GENERATIONS;g++)
+          if (stats.numRays[g] > 0) rays += stats.numRays[g];
+      }
+      sumRays += rays;
+    }
+    int numFrames = std::max(config.numFrames,1);
+    frameTime    = sumTime/numFrames;
+    raysPerFrame = sumRays/numFrames;
+
+    bnRelease(fb);
+    bnRelease(renderer);
+    bnRelease(camera);
+  }
+
+  std::string SceneBench::toJSON(int numRanks) const
+  {
+    const double primary = double(config.width)*config.height*config.spp;
+    std::stringstream ss;
+    ss << "{\n"
+       << "  \"scene\": \"" << config.scene << "\",\n"
+       << "  \"backend\": \"" << (config.forceCPU ? "cpu" : "default") << "\",\n"
+       << "  \"numRanks\": " << numRanks << ",\n"
+       << "  \"numPrimsRank0\": " << scene.numPrims << ",\n"
+       << "  \"width\": " << config.width << ",\n"
+       << "  \"height\": " << config.height << ",\n"
+       << "  \"spp\": " << config.spp << ",\n"
+       << "  \"frames\": " << config.numFrames << ",\n"
+       << "  \"commitMs\": " << commitTime << ",\n"
+       << "  \"buildMs\": " << buildTime << ",\n"
+       << "  \"firstFrameMs\": " << firstFrameTime << ",\n"
+       << "  \"msPerFrame\": " << frameTime << ",\n"
+       << "  \"primaryMraysPerSec\": " << primary/(frameTime*1e3) << ",\n"
+       << "  \"mraysPerSec\": "
+       << (config.withStats ? raysPerFrame/(frameTime*1e3) : -1.) << "\n"
+       << "}";
+    return ss.str();
+  }
+
+}
+
+int main(int ac, char **av)
+{
+  using namespace barney_bench;
+  BenchConfig config;
+  for (int i=1;i<ac;i++) {
+    const std::string arg = av[i];
+    auto next = [&]() -> std::string {
+      if (i+1 >= ac) usage("missing value for '"+arg+"'");
+      return av[++i];
+    };
+    if (arg == "-h" || arg == "--help")
+      usage("");
+    else if (arg == "-scene")
+      config.scene = next();
+    else if (arg == "-n")
+      config.numItems = std::stoull(next());
+    else if (arg == "-res") {
+      config.width  = std::stoi(next());
+      config.height = std::stoi(next());
+    } else if (arg == "-spp")
+      config.spp = std::stoi(next());
+    else if (arg == "-frames")
+      config.numFrames = std::stoi(next());
+    else if (arg == "-warmup")
+      config.warmUp = std::max(1,std::stoi(next()));
+    else if (arg == "-cpu")
+      config.forceCPU = true;
+    else if (arg == "-stats")
+      config.withStats = true;
+    else if (arg == "-no-readback")
+      config.readback = false;
+    else
+      usage("unknown argument '"+arg+"'");
+  }
+
+  if (config.withStats) {
+    /* has to be in place before the first context gets created */
+    const char *prev = getenv("BARNEY_CONFIG");
+    std::string cfg = prev && *prev ? std::string(prev)+":profile=1" : "profile=1";
+#ifdef _WIN32
+    _putenv_s("BARNEY_CONFIG",cfg.c_str());
+#else
+    setenv("BARNEY_CONFIG",cfg.c_str(),1);
+#endif
+  }
+
+  int rank = 0, size = 1;
+  int gpuCPU = -1;
+#if BARNEY_MPI
+  MPI_Init(&ac,&av);
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Comm_size(MPI_COMM_WORLD,&size);
+  BNContext context
+    = config.forceCPU
+    ? bnMPIContextCreate(MPI_COMM_WORLD,&rank,1,&gpuCPU,1)
+    : bnMPIContextCreate(MPI_COMM_WORLD,&rank,1);
+#else
+  BNContext context
+    = config.forceCPU
+    ? bnContextCreate(nullptr,1,&gpuCPU,1)
+    : bnContextCreate();
+#endif
+  if (!context) {
+    std::cerr << "barneyBench: could not create barney context" << std::endl;
+    return 1;
+  }
+
+  {
+    SceneBench bench(context,config,rank,size);
+    bench.createScene();
+    bench.build();
+    bench.render();
+    if (rank == 0)
+      std::cout << bench.toJSON(size) << std::endl;
+  }
+  bnContextDestroy(context);
+#if BARNEY_MPI
+  MPI_Finalize();
+#endif
+  return 0;
+}
@@ -0,0 +1,574 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+/*! per-sampler volume micro-benchmark: builds a synthetic scalar
+    field of each type (with a controllable fraction of empty space),
+    lets barney build its regular macro-cell accel over it, and then
+    runs - outside of any ray tracing pipeline, on the first device -
+    two isolated kernels over its sampler: plain point sampling at
+    random points inside the field, and the same majorant-DDA plus
+    woodcock loop that MCVolumeAccel::isProg() does, for a fixed set
+    of rays through the field. No ray generation, no shading, no BVH
+    traversal; the numbers are a baseline for changes to samplers and
+    majorant grids, not for frames. E.g.,
+
+    barneyVolumeSamplerBench -field structured,umesh -n 256 -sparsity .5
+
+    Block-structured amr uses whichever sampler barney picks for it;
+    run with BARNEY_CONFIG=amrCuBQL=1 to get the cuBQL one.
+*/
+
+#include "barney/Context.h"
+#include "barney/volume/Volume.h"
+#include "barney/volume/MCAccelerator.h"
+#include "barney/volume/StructuredData.h"
+#include "barney/amr/BlockStructuredCellListSampler.h"
+#include "barney/amr/BlockStructuredCuBQLSampler.h"
+#include "barney/umesh/mc/UMeshCuBQLSampler.h"
+#if BARNEY_HAVE_NANOVDB
+# include "barney/volume/NanoVDB.h"
+# include <nanovdb/tools/GridBuilder.h>
+# include <nanovdb/tools/CreateNanoGrid.h>
+#endif
+#include <sstream>
+
+namespace BARNEY_NS {
+
+  struct SamplerBenchConfig {
+    /*! cells per dimension */
+    int   n          = 128;
+    /*! fraction of the field's 8^3 blocks that are empty */
+    float sparsity   = 0.f;
+    int   numRays    = 1<<20;
+    int   numPoints  = 1<<24;
+    /*! runs of each kernel to average over */
+    int   numRuns    = 10;
+    std::vector<std::string> fields
+    = { "structured", "nanovdb", "amr", "umesh" };
+  };
+
+  void usage(const std::string &error)
+  {
+    if (!error.empty())
+      std::cerr << "error: " << error << "\n\n";
+    std::cerr
+      << "usage: barneyVolumeSamplerBench [args]*\n"
+      << "  -field <a,b,...>    any of structured,nanovdb,amr,umesh\n"
+      << "  -n <cells>          cells per dimension\n"
+      << "  -sparsity <f>       fraction of empty 8^3 blocks, in [0,1]\n"
+      << "  -rays <N>           rays per traversal run\n"
+      << "  -points <N>         point samples per sampling run\n"
+      << "  -runs <N>           runs to average over\n";
+    exit(error.empty() ? 0 : 1);
+  }
+
+  /*! same smooth field as barneyBench's, but with every one of the
+      unit cube's 8^3 blocks that hashes below 'sparsity' zeroed */
+  inline float fieldValue(float x, float y, float z, float sparsity)
+  {
+    int bx = std::min(7,std::max(0,int(8.f*x)));
+    int by = std::min(7,std::max(0,int(8.f*y)));
+    int bz = std::min(7,std::max(0,int(8.f*z)));
+    uint32_t h = (bx*73856093u)^(by*19349663u)^(bz*83492791u);
+    h *= 0x9e3779b1u;
+    if ((h >> 8)*(1.f/(1<<24)) < sparsity)
+      return 0.f;
+    const float k = 6.2831853f*3.f;
+    float dx = x-.5f, dy = y-.5f, dz = z-.5f;
+    float r2 = dx*dx+dy*dy+dz*dz;
+    return std::max(0.f,1.f-4.f*r2)
+      * (.5f+.5f*sinf(k*x)*sinf(k*y)*sinf(k*z));
+  }
+
+  struct BenchRay {
+    vec3f org;
+    vec3f dir;
+  };
+
+  /*! counts how often woodcock sampled the volume */
+  template<typename VolumeDD>
+  struct CountingSampler {
+    inline __rtc_device
+    vec4f sampleAndMap(vec3f P, bool dbg=false) const
+    {
+      (*count)++;
+      return volume->map(sampleWithHint(volume->sfSampler,P,*hint,dbg),dbg);
+    }
+
+    const VolumeDD *volume;
+    int            *hint;
+    int            *count;
+  };
+
+  template<typename SFSampler>
+  __rtc_global
+  void pointSamples(const rtc::ComputeInterface &ci,
+                    const typename MCVolumeAccel<SFSampler>::DD *accel,
+                    float *sink,
+                    int    numThreads,
+                    int    samplesPerThread)
+  {
+    int tid = ci.getThreadIdx().x + ci.getBlockIdx().x * ci.getBlockDim().x;
+    if (tid >= numThreads) return;
+    const auto &volume = accel->volume;
+    const box3f bounds = volume.sfCommon.worldBounds;
+    Random rng(tid,0x5eed);
+    float sum = 0.f;
+    for (int i=0;i<samplesPerThread;i++) {
+      vec3f u(rng(),rng(),rng());
+      vec3f P = bounds.lower + u*bounds.size();
+      float f = volume.sfSampler.sample(P);
+      if (!isnan(f)) sum += f;
+    }
+    sink[tid] = sum;
+  }
+
+  template<typename SFSampler>
+  __rtc_global
+  void traceRays(const rtc::ComputeInterface &ci,
+                 const typename MCVolumeAccel<SFSampler>::DD *accel,
+                 const BenchRay *rays,
+                 int            *numSamples,
+                 float          *tHit,
+                 int             numRays)
+  {
+    int rayID = ci.getThreadIdx().x + ci.getBlockIdx().x * ci.getBlockDim().x;
+    if (rayID >= numRays) return;
+    const auto &self = *accel;
+    const BenchRay ray = rays[rayID];
+
+    const box3f bounds = self.volume.sfCommon.worldBounds;
+    vec3f t_lo = (bounds.lower - ray.org) * rcp(ray.dir);
+    vec3f t_hi = (bounds.upper - ray.org) * rcp(ray.dir);
+    range1f tRange = { max(0.f,reduce_max(min(t_lo,t_hi))),
+                       reduce_min(max(t_lo,t_hi)) };
+    int   count = 0;
+    float hit   = BARNEY_INF;
+    if (tRange.lower < tRange.upper) {
+      vec3f dda_org
+        = (ray.org - self.mcGrid.gridOrigin) * rcp(self.mcGrid.gridSpacing);
+      vec3f dda_dir = ray.dir * rcp(self.mcGrid.gridSpacing);
+      Random rng(rayID,0x7ace);
+      int hint = -1;
+      CountingSampler<Volume::DD<SFSampler>> counting
+        = { &self.volume, &hint, &count };
+      dda::dda3Hierarchical(dda_org,dda_dir,tRange.upper,
+                            vec3ui(self.mcGrid.dims),
+                            MCGrid::cellsPerSuperCell,
+                            vec3ui(self.mcGrid.superDims),
+                            [&](const vec3i &superIdx) -> bool
+                            { return self.mcGrid.superMajorant(superIdx) > 0.f; },
+                            [&](const vec3i &cellIdx, float t0, float t1) -> bool
+                            {
+                              const float majorant = self.mcGrid.majorant(cellIdx);
+                              if (majorant == 0.f) return true;
+                              vec4f   sample = 0.f;
+                              range1f cellRange = { t0,t1 };
+                              if (!Woodcock::sampleRange(sample,counting,
+                                                         ray.org,ray.dir,
+                                                         cellRange,majorant,
+                                                         rng))
+                                return true;
+                              hit = cellRange.upper;
+                              return false;
+                            },
+                            false);
+    }
+    numSamples[rayID] = count;
+    tHit[rayID]       = hit;
+  }
+
+  struct SamplerBench {
+    SamplerBench(BNContext context, const SamplerBenchConfig &config)
+      : context(context), config(config)
+    {}
+
+    /*! creates, commits and builds a volume over a synthetic field of
+        given type, and benchmarks its sampler; returns one json
+        object */
+    std::string run(const std::string &fieldType);
+
+    BNScalarField createStructured();
+    BNScalarField createNanoVDB();
+    BNScalarField createAMR();
+    BNScalarField createUMesh();
+    BNData createData(BNDataType type, size_t n, const void *items)
+    {
+      BNData data = bnDataCreate(context,0,type,n,items);
+      return data;
+    }
+
+    template<typename SFSampler>
+    std::string run(MCVolumeAccel<SFSampler> *accel,
+                    const std::string &samplerName);
+
+    BNContext                context;
+    SamplerBenchConfig const config;
+    size_t                   numCells = 0;
+  };
+
+  BNScalarField SamplerBench::createStructured()
+  {
+    int n = std::max(config.n,2);
+    float h = 1.f/(n-1);
+    std::vector<float> voxels(size_t(n)*n*n);
+    for (int iz=0;iz<n;iz++)
+      for (int iy=0;iy<n;iy++)
+        for (int ix=0;ix<n;ix++)
+          voxels[ix+n*(iy+size_t(n)*iz)]
+            = fieldValue(ix*h,iy*h,iz*h,config.sparsity);
+    BNTextureData td
+      = bnTextureData3DCreate(context,0,BN_FLOAT,n,n,n,voxels.data());
+    BNScalarField sf = bnScalarFieldCreate(context,0,"structured");
+    bnSetObject(sf,"textureData",td);
+    bnRelease(td);
+    bnSet3i(sf,"dims",n,n,n);
+    bnSet3f(sf,"gridOrigin",0.f,0.f,0.f);
+    bnSet3f(sf,"gridSpacing",h,h,h);
+    numCells = voxels.size();
+    return sf;
+  }
+
+  /*! only the non-zero voxels become active, so empty blocks are
+      actually empty in the vdb tree */
+  BNScalarField SamplerBench::createNanoVDB()
+  {
+#if BARNEY_HAVE_NANOVDB
+    int n = std::max(config.n,8);
+    nanovdb::tools::build::Grid<float> grid(0.f);
+    auto acc = grid.getAccessor();
+    numCells = 0;
+    for (int iz=0;iz<n;iz++)
+      for (int iy=0;iy<n;iy++)
+        for (int ix=0;ix<n;ix++) {
+          float f = fieldValue((ix+.5f)/n,(iy+.5f)/n,(iz+.5f)/n,
+                               config.sparsity);
+          if (f == 0.f) continue;
+          acc.setValue(nanovdb::Coord(ix,iy,iz),f);
+          numCells++;
+        }
+    auto handle = nanovdb::tools::createNanoGrid(grid);
+    BNScalarField sf = bnScalarFieldCreate(context,0,"NanoVDB");
+    BNData d = createData(BN_UINT8,handle.size(),handle.data());
+    bnSetData(sf,"data",d);
+    bnRelease(d);
+    return sf;
+#else
+    throw std::runtime_error("barney got built without nanovdb support");
+#endif
+  }
+
+  /*! same two levels as barneyBench's amr scene: coarse blocks over
+      all of the domain, fine ones over its central eighth */
+  BNScalarField SamplerBench::createAMR()
+  {
+    const int blockSize = 16;
+    int n = std::max(4*blockSize,(config.n/(4*blockSize))*(4*blockSize));
+    std::vector<bn_int3> origins, dims;
+    std::vector<int> levels;
+    std::vector<uint64_t> offsets;
+    std::vector<float> scalars;
+    auto addBlock = [&](int level, int ox, int oy, int oz) {
+      const int cellSize = 1<<level;
+      origins.push_back({ ox,oy,oz });
+      dims.push_back({ blockSize,blockSize,blockSize });
+      levels.push_back(level);
+      offsets.push_back(scalars.size());
+      for (int iz=0;iz<blockSize;iz++)
+        for (int iy=0;iy<blockSize;iy++)
+          for (int ix=0;ix<blockSize;ix++)
+            scalars.push_back(fieldValue((ox+(ix+.5f)*cellSize)/n,
+                                         (oy+(iy+.5f)*cellSize)/n,
+                                         (oz+(iz+.5f)*cellSize)/n,
+                                         config.sparsity));
+    };
+    const int coarse = 2*blockSize;
+    for (int z=0;z<n;z+=coarse)
+      for (int y=0;y<n;y+=coarse)
+        for (int x=0;x<n;x+=coarse)
+          addBlock(1,x,y,z);
+    for (int z=n/4;z<3*n/4;z+=blockSize)
+      for (int y=n/4;y<3*n/4;y+=blockSize)
+        for (int x=n/4;x<3*n/4;x+=blockSize)
+          addBlock(0,x,y,z);
+    int refinements[2] = { 2,2 };
+
+    BNScalarField sf = bnScalarFieldCreate(context,0,"BlockStructuredAMR");
+    struct { const char *name; BNDataType type; size_t n; const void *v; }
+    arrays[] = {
+      { "scalars",      BN_FLOAT32,      scalars.size(), scalars.data() },
+      { "grid.origins", BN_INT32_VEC3,   origins.size(), origins.data() },
+      { "grid.dims",    BN_INT32_VEC3,   dims.size(),    dims.data()    },
+      { "grid.levels",  BN_INT32,        levels.size(),  levels.data()  },
+      { "grid.offsets", BN_UINT64,       offsets.size(), offsets.data() },
+      { "level.refinements", BN_INT32,   2,              refinements    },
+    };
+    for (auto &a : arrays) {
+      BNData d = createData(a.type,a.n,a.v);
+      bnSetData(sf,a.name,d);
+      bnRelease(d);
+    }
+    numCells = scalars.size();
+    return sf;
+  }
+
+  /*! n^3 cubes, each cut into six tets; cubes in empty blocks get
+      left out entirely */
+  BNScalarField SamplerBench::createUMesh()
+  {
+    int n = std::max(config.n,1);
+    const int nv = n+1;
+    std::vector<bn_float3> vertices;
+    std::vector<float> values;
+    for (int iz=0;iz<nv;iz++)
+      for (int iy=0;iy<nv;iy++)
+        for (int ix=0;ix<nv;ix++) {
+          float x = ix/float(n), y = iy/float(n), z = iz/float(n);
+          vertices.push_back({ x,y,z });
+          values.push_back(fieldValue(x,y,z,0.f));
+        }
+    static const int tets[6][4] = {
+      { 0,1,3,7 },{ 0,3,2,7 },{ 0,2,6,7 },
+      { 0,6,4,7 },{ 0,4,5,7 },{ 0,5,1,7 }
+    };
+    std::vector<int> indices, cellBegin;
+    std::vector<uint8_t> cellTypes;
+    for (int iz=0;iz<n;iz++)
+      for (int iy=0;iy<n;iy++)
+        for (int ix=0;ix<n;ix++) {
+          if (fieldValue((ix+.5f)/n,(iy+.5f)/n,(iz+.5f)/n,config.sparsity)
+              == 0.f && config.sparsity > 0.f) continue;
+          int corner[8];
+          for (int c=0;c<8;c++)
+            corner[c] = (ix+(c&1)) + nv*((iy+((c>>1)&1)) + nv*(iz+(c>>2)));
+          for (auto &tet : tets) {
+            cellBegin.push_back((int)indices.size());
+            cellTypes.push_back(10 /* VTK_TETRA */);
+            for (int v : tet) indices.push_back(corner[v]);
+          }
+        }
+    BNScalarField sf = bnScalarFieldCreate(context,0,"unstructured");
+    struct { const char *name; BNDataType type; size_t n; const void *v; }
+    arrays[] = {
+      { "vertex.position", BN_FLOAT3, vertices.size(),  vertices.data()  },
+      { "vertex.data",     BN_FLOAT,  values.size(),    values.data()    },
+      { "index",           BN_INT,    indices.size(),   indices.data()   },
+      { "cell.index",      BN_INT,    cellBegin.size(), cellBegin.data() },
+      { "cell.type",       BN_UINT8,  cellTypes.size(), cellTypes.data() },
+    };
+    for (auto &a : arrays) {
+      BNData d = createData(a.type,a.n,a.v);
+      bnSetData(sf,a.name,d);
+      bnRelease(d);
+    }
+    numCells = cellTypes.size();
+    return sf;
+  }
+
+  template<typename SFSampler>
+  std::string SamplerBench::run(MCVolumeAccel<SFSampler> *accel,
+                                const std::string &samplerName)
+  {
+    typedef typename MCVolumeAccel<SFSampler>::DD AccelDD;
+    Device *device = (*accel->devices)[0];
+    SetActiveGPU forDuration(device);
+    auto rtc = device->rtc;
+
+    AccelDD dd = accel->getDD(device);
+    AccelDD *d_dd = (AccelDD *)rtc->allocMem(sizeof(dd));
+    rtc->copy(d_dd,&dd,sizeof(dd));
+
+    // ------------------------------------------------------------------
+    // the same rays every run: from a sphere around the field's
+    // bounds, towards random points inside of it
+    // ------------------------------------------------------------------
+    const box3f bounds = accel->volume->sf->worldBounds;
+    const vec3f center = bounds.center();
+    const float radius = length(bounds.size());
+    std::vector<BenchRay> rays(config.numRays);
+    Random rng(0x13,0x37);
+    for (auto &ray : rays) {
+      vec3f d;
+      do {
+        d = 2.f*vec3f(rng(),rng(),rng())-1.f;
+      } while (dot(d,d) > 1.f || dot(d,d) < 1e-4f);
+      ray.org = center + radius*normalize(d);
+      vec3f target = bounds.lower + vec3f(rng(),rng(),rng())*bounds.size();
+      ray.dir = normalize(target-ray.org);
+    }
+    BenchRay *d_rays = (BenchRay *)rtc->allocMem(rays.size()*sizeof(BenchRay));
+    rtc->copy(d_rays,rays.data(),rays.size()*sizeof(BenchRay));
+    int   *d_numSamples = (int *)rtc->allocMem(rays.size()*sizeof(int));
+    float *d_tHit       = (float *)rtc->allocMem(rays.size()*sizeof(float));
+
+    const int samplesPerThread = 16;
+    const int numThreads = std::max(1,config.numPoints/samplesPerThread);
+    float *d_sink = (float *)rtc->allocMem(numThreads*sizeof(float));
+
+    const int bs = 128;
+    // warm up, so the first run doesn't pay for any lazy setup
+    __rtc_launch(rtc,pointSamples<SFSampler>,divRoundUp(numThreads,bs),bs,
+                 d_dd,d_sink,numThreads,samplesPerThread);
+    __rtc_launch(rtc,traceRays<SFSampler>,divRoundUp(config.numRays,bs),bs,
+                 d_dd,d_rays,d_numSamples,d_tHit,config.numRays);
+    rtc->sync();
+
+    double t0 = getCurrentTime();
+    for (int run=0;run<config.numRuns;run++)
+      __rtc_launch(rtc,pointSamples<SFSampler>,divRoundUp(numThreads,bs),bs,
+                   d_dd,d_sink,numThreads,samplesPerThread);
+    rtc->sync();
+    double pointTime = (getCurrentTime()-t0)/config.numRuns;
+
+    t0 = getCurrentTime();
+    for (int run=0;run<config.numRuns;run++)
+      __rtc_launch(rtc,traceRays<SFSampler>,divRoundUp(config.numRays,bs),bs,
+                   d_dd,d_rays,d_numSamples,d_tHit,config.numRays);
+    rtc->sync();
+    double traceTime = (getCurrentTime()-t0)/config.numRuns;
+
+    std::vector<int>   numSamples(rays.size());
+    std::vector<float> tHit(rays.size());
+    rtc->copy(numSamples.data(),d_numSamples,numSamples.size()*sizeof(int));
+    rtc->copy(tHit.data(),d_tHit,tHit.size()*sizeof(float));
+    size_t totalSamples = 0, numHit = 0;
+    for (size_t i=0;i<rays.size();i++) {
+      totalSamples += numSamples[i];
+      if (tHit[i] < BARNEY_INF) numHit++;
+    }
+
+    rtc->freeMem(d_sink);
+    rtc->freeMem(d_tHit);
+    rtc->freeMem(d_numSamples);
+    rtc->freeMem(d_rays);
+    rtc->freeMem(d_dd);
+
+    const double numPoints = double(numThreads)*samplesPerThread;
+    std::stringstream ss;
+    ss << "{\"sampler\":\"" << samplerName << "\""
+       << ",\"cells\":" << numCells
+       << ",\"mcDims\":[" << dd.mcGrid.dims.x << "," << dd.mcGrid.dims.y
+       << "," << dd.mcGrid.dims.z << "]"
+       << ",\"pointSamplesPerSec\":" << numPoints/pointTime
+       << ",\"raysPerSec\":" << rays.size()/traceTime
+       << ",\"woodcockSamplesPerSec\":" << totalSamples/traceTime
+       << ",\"samplesPerRay\":" << totalSamples/double(rays.size())
+       << ",\"hitFraction\":" << numHit/double(rays.size())
+       << "}";
+    return ss.str();
+  }
+
+  std::string SamplerBench::run(const std::string &fieldType)
+  {
+    BNScalarField sf
+      = (fieldType == "structured") ? createStructured()
+      : (fieldType == "nanovdb")    ? createNanoVDB()
+      : (fieldType == "amr")        ? createAMR()
+      : (fieldType == "umesh")      ? createUMesh()
+      : nullptr;
+    if (!sf)
+      usage("unknown field type '"+fieldType+"'");
+    bnCommit(sf);
+
+    BNVolume bnVolume = bnVolumeCreate(context,0,sf);
+    std::vector<bn_float4> colorMap;
+    for (int i=0;i<64;i++) {
+      float t = i/63.f;
+      colorMap.push_back({ t, .3f+.4f*t, 1.f-t, t });
+    }
+    bnVolumeSetXF(bnVolume,{ 0.f,1.f },colorMap.data(),(int)colorMap.size(),
+                  1.f);
+    bnCommit(bnVolume);
+    BNGroup group = bnGroupCreate(context,0,nullptr,0,&bnVolume,1);
+    bnGroupBuild(group);
+
+    Volume *volume = dynamic_cast<Volume *>((barney_api::Volume *)bnVolume);
+    VolumeAccel *accel = volume ? volume->accel.get() : nullptr;
+    std::string result;
+#define TRY_SAMPLER(Sampler,name)                                    \
+    if (result.empty())                                             \
+      if (auto mc = dynamic_cast<MCVolumeAccel<Sampler> *>(accel))  \
+        result = run(mc,name);
+    TRY_SAMPLER(StructuredDataSampler,"StructuredDataSampler");
+    TRY_SAMPLER(BlockStructuredCellListSampler,"BlockStructuredCellListSampler");
+    TRY_SAMPLER(BlockStructuredCuBQLSampler,"BlockStructuredCuBQLSampler");
+    TRY_SAMPLER(UMeshCuBQLSampler,"UMeshCuBQLSampler");
+#if BARNEY_HAVE_NANOVDB
+# define TRY_NANOVDB(BuildType, Suffix, EnumName)                    \
+    TRY_SAMPLER(NanoVDBDataSampler<BuildType>,"NanoVDBDataSampler<" #Suffix ">");
+    BARNEY_NANOVDB_FLOAT_TYPES(TRY_NANOVDB)
+# undef TRY_NANOVDB
+#endif
+#undef TRY_SAMPLER
+    if (result.empty())
+      std::cerr << "barneyVolumeSamplerBench: '" << fieldType << "' volume got a "
+                << (accel ? accel->toString() : std::string("null"))
+                << " accel, which isn't a macro-cell one; skipping" << std::endl;
+
+    bnRelease(group);
+    bnRelease(bnVolume);
+    bnRelease(sf);
+    if (result.empty())
+      return result;
+    return "{\"field\":\""+fieldType+"\""
+      +",\"n\":"+std::to_string(config.n)
+      +",\"sparsity\":"+std::to_string(config.sparsity)
+      +",\"result\":"+result+"}";
+  }
+
+}
+
+int main(int ac, char **av)
+{
+  using namespace BARNEY_NS;
+  SamplerBenchConfig config;
+  for (int i=1;i<ac;i++) {
+    const std::string arg = av[i];
+    auto next = [&]() -> std::string {
+      if (i+1 >= ac) usage("missing value for '"+arg+"'");
+      return av[++i];
+    };
+    if (arg == "-h" || arg == "--help")
+      usage("");
+    else if (arg == "-field") {
+      config.fields.clear();
+      std::stringstream ss(next());
+      std::string field;
+      while (std::getline(ss,field,','))
+        config.fields.push_back(field);
+    } else if (arg == "-n")
+      config.n = std::stoi(next());
+    else if (arg == "-sparsity")
+      config.sparsity = std::max(0.f,std::min(1.f,std::stof(next())));
+    else if (arg == "-rays")
+      config.numRays = std::max(1,std::stoi(next()));
+    else if (arg == "-points")
+      config.numPoints = std::max(1,std::stoi(next()));
+    else if (arg == "-runs")
+      config.numRuns = std::max(1,std::stoi(next()));
+    else
+      usage("unknown argument '"+arg+"'");
+  }
+
+  BNContext context = bnContextCreate();
+  if (!context) {
+    std::cerr << "barneyVolumeSamplerBench: could not create barney context"
+              << std::endl;
+    return 1;
+  }
+  {
+    SamplerBench bench(context,config);
+    std::cout << "[" << std::endl;
+    bool first = true;
+    for (auto &field : config.fields) {
+      std::string result = bench.run(field);
+      if (result.empty()) continue;
+      std::cout << (first ? "  " : ", ") << result << std::endl;
+      first = false;
+    }
+    std::cout << "]" << std::endl;
+  }
+  bnContextDestroy(context);
+  return 0;
+}
@@ -0,0 +1,132 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/common/AccelCache.h"
+#include "barney/api/Context.h"
+#include <cstdio>
+#include <iomanip>
+#include <random>
+
+namespace BARNEY_NS {
+
+  /*! 'BNAC', and a version that has to get bumped whenever the
+      layout of anything we cache changes */
+  static const uint32_t accelCacheMagic   = 0x43414e42;
+  static const uint32_t accelCacheVersion = 1;
+  
+  uint64_t AccelCache::hash(const void *data, size_t numBytes,
+                            uint64_t seed)
+  {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t h = seed;
+    for (size_t i=0;i<numBytes;i++) {
+      h ^= bytes[i];
+      h *= 0x100000001b3ull;
+    }
+    return h;
+  }
+
+  bool AccelCache::enabled()
+  {
+    return !FromEnv::get()->accelCacheDir.empty();
+  }
+  
+  static std::string accelCacheFileName(const std::string &kind,
+                                        uint64_t key)
+  {
+    std::stringstream ss;
+    ss << FromEnv::get()->accelCacheDir << "/" << kind << "-"
+       << std::hex << std::setw(16) << std::setfill('0') << key
+       << ".bnac";
+    return ss.str();
+  }
+
+  bool AccelCache::load(const std::string &kind, uint64_t key,
+                        std::vector<std::vector<uint8_t>> &blobs)
+  {
+    blobs.clear();
+    if (!enabled()) return false;
+    
+    std::string fileName = accelCacheFileName(kind,key);
+    FILE *file = fopen(fileName.c_str(),"rb");
+    if (!file) return false;
+
+    bool ok = true;
+    uint32_t header[3];
+    uint64_t fileKey = 0;
+    ok = ok && fread(header,sizeof(header),1,file) == 1;
+    ok = ok && fread(&fileKey,sizeof(fileKey),1,file) == 1;
+    ok = ok
+      && header[0] == accelCacheMagic
+      && header[1] == accelCacheVersion
+      && fileKey == key;
+    if (ok) {
+      blobs.resize(header[2]);
+      for (auto &blob : blobs) {
+        uint64_t size = 0;
+        ok = ok && fread(&size,sizeof(size),1,file) == 1;
+        if (!ok) break;
+        blob.resize(size);
+        ok = ok && (size == 0 || fread(blob.data(),size,1,file) == 1);
+      }
+    }
+    fclose(file);
+    if (!ok) {
+      std::cerr << "#bn.cache: could not read '" << fileName
+                << "', ignoring it" << std::endl;
+      blobs.clear();
+      return false;
+    }
+    std::cout << "#bn.cache: loaded " << kind << " from '"
+              << fileName << "'" << std::endl;
+    return true;
+  }
+  
+  void AccelCache::store(const std::string &kind, uint64_t key,
+                         const std::vector<std::vector<uint8_t>> &blobs)
+  {
+    if (!enabled()) return;
+    
+    std::string fileName = accelCacheFileName(kind,key);
+    /* write to a temp file first, then rename, so other ranks (or
+       processes) never see partially written entries */
+    std::stringstream tmpName;
+    tmpName << fileName << ".tmp" << std::hex << std::random_device()();
+    FILE *file = fopen(tmpName.str().c_str(),"wb");
+    if (!file) {
+      std::cerr << "#bn.cache: could not write '" << tmpName.str()
+                << "'" << std::endl;
+      return;
+    }
+    bool ok = true;
+    uint32_t header[3] = { accelCacheMagic, accelCacheVersion,
+                           (uint32_t)blobs.size() };
+    ok = ok && fwrite(header,sizeof(header),1,file) == 1;
+    ok = ok && fwrite(&key,sizeof(key),1,file) == 1;
+    for (auto &blob : blobs) {
+      uint64_t size = blob.size();
+      ok = ok && fwrite(&size,sizeof(size),1,file) == 1;
+      ok = ok && (size == 0 || fwrite(blob.data(),size,1,file) == 1);
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmpName.str().c_str(),fileName.c_str()) != 0) {
+      std::cerr << "#bn.cache: could not write '" << fileName
+                << "'" << std::endl;
+      remove(tmpName.str().c_str());
+    }
+  }
+
+  uint64_t AccelCache::keyFor(Device *device,
+                              const box3f *d_primBounds, int numPrims,
+                              const std::string &config)
+  {
+    std::vector<box3f> primBounds(numPrims);
+    device->rtc->copy(primBounds.data(),d_primBounds,
+                      numPrims*sizeof(box3f));
+    uint64_t key = hash(config.data(),config.size());
+    key = hash(&numPrims,sizeof(numPrims),key);
+    return hash(primBounds.data(),numPrims*sizeof(box3f),key);
+  }
+  
+}
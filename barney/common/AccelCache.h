@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+/*! \file AccelCache.h on-disk cache for acceleration structures that
+    are expensive to build, but depend only on the data they get built
+    over - such as the cuBQL BVHs of the umesh and bs-amr
+    samplers. Enabled through BARNEY_CONFIG="accelCache=<dir>";
+    entries are keyed by a content hash of the build inputs, so stale
+    entries simply never get hit again. */
+#pragma once
+
+#include "barney/DeviceGroup.h"
+
+namespace BARNEY_NS {
+
+  struct AccelCache {
+    /*! 64-bit FNV-1a hash of given bytes, chained onto 'seed' */
+    static uint64_t hash(const void *data, size_t numBytes,
+                         uint64_t seed = 0xcbf29ce484222325ull);
+    
+    /*! whether a cache directory was configured */
+    static bool enabled();
+
+    /*! reads all blobs stored under given kind and key; returns false
+        (and leaves blobs empty) if there is no such entry, or if it
+        could not be read */
+    static bool load(const std::string &kind, uint64_t key,
+                     std::vector<std::vector<uint8_t>> &blobs);
+    
+    /*! stores given blobs under given kind and key; failures only get
+        logged, since the cache is just an optimization */
+    static void store(const std::string &kind, uint64_t key,
+                      const std::vector<std::vector<uint8_t>> &blobs);
+
+    /*! computes the cache key for a bvh over given (device-side)
+        prim bounds, built with given config string */
+    static uint64_t keyFor(Device *device,
+                           const box3f *d_primBounds, int numPrims,
+                           const std::string &config);
+    
+    /*! tries to fill in given cuBQL bvh - with nodes and prim IDs in
+        this device's memory - from the cache */
+    template<typename bvh_t>
+    static bool loadBVH(Device *device, const std::string &kind,
+                        uint64_t key, bvh_t &bvh);
+
+    /*! saves given cuBQL bvh (whose arrays live in this device's
+        memory) to the cache */
+    template<typename bvh_t>
+    static void storeBVH(Device *device, const std::string &kind,
+                         uint64_t key, const bvh_t &bvh);
+  };
+
+  template<typename bvh_t>
+  bool AccelCache::loadBVH(Device *device, const std::string &kind,
+                           uint64_t key, bvh_t &bvh)
+  {
+    using node_t = typename bvh_t::Node;
+    std::vector<std::vector<uint8_t>> blobs;
+    if (!load(kind,key,blobs) || blobs.size() != 2 ||
+        blobs[0].size() % sizeof(node_t) != 0 ||
+        blobs[1].size() % sizeof(uint32_t) != 0)
+      return false;
+    auto rtc = device->rtc;
+    bvh.numNodes = uint32_t(blobs[0].size() / sizeof(node_t));
+    bvh.numPrims = uint32_t(blobs[1].size() / sizeof(uint32_t));
+    bvh.nodes    = (node_t *)rtc->allocMem(blobs[0].size());
+    bvh.primIDs  = (uint32_t *)rtc->allocMem(blobs[1].size());
+    rtc->copy(bvh.nodes,blobs[0].data(),blobs[0].size());
+    rtc->copy(bvh.primIDs,blobs[1].data(),blobs[1].size());
+    return true;
+  }
+
+  template<typename bvh_t>
+  void AccelCache::storeBVH(Device *device, const std::string &kind,
+                            uint64_t key, const bvh_t &bvh)
+  {
+    using node_t = typename bvh_t::Node;
+    std::vector<std::vector<uint8_t>> blobs(2);
+    blobs[0].resize(bvh.numNodes*sizeof(node_t));
+    blobs[1].resize(bvh.numPrims*sizeof(uint32_t));
+    auto rtc = device->rtc;
+    rtc->copy(blobs[0].data(),bvh.nodes,blobs[0].size());
+    rtc->copy(blobs[1].data(),bvh.primIDs,blobs[1].size());
+    store(kind,key,blobs);
+  }
+  
+}
@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/common/BuildLog.h"
+#include "barney/Context.h"
+#include <cstring>
+
+namespace BARNEY_NS {
+
+  static const char *stageName(BNBuildStage stage)
+  {
+    switch (stage) {
+    case BN_BUILD_COMMIT:      return "commit";
+    case BN_BUILD_GEOMETRY:    return "geometry";
+    case BN_BUILD_GROUP:       return "group";
+    case BN_BUILD_GROUP_REFIT: return "groupRefit";
+    case BN_BUILD_VOLUME:      return "volume";
+    case BN_BUILD_INSTANCES:   return "instances";
+    default:                   return "unknown";
+    }
+  }
+
+  BuildLog::Scope::Scope(BNBuildStage stage, barney_api::Object *object,
+                         Device *device, size_t numPrims)
+    : Scope(stage,object,(const DevGroup *)nullptr,numPrims)
+  {
+    record.localDeviceID = device->localRank();
+    before.push_back({device,device->rtc->memory.getUsage()});
+  }
+
+  BuildLog::Scope::Scope(BNBuildStage stage, barney_api::Object *object,
+                         const DevGroup *devices, size_t numPrims)
+    : numPrims(numPrims),
+      log(&((Context *)object->getContext())->buildLog),
+      begin(getCurrentTime())
+  {
+    record = {};
+    record.stage  = stage;
+    record.object = (stage == BN_BUILD_INSTANCES) ? nullptr : (BNObject)object;
+    strncpy(record.name,object->toString().c_str(),sizeof(record.name)-1);
+    record.localDeviceID = -1;
+    if (devices)
+      for (auto device : *devices)
+        before.push_back({device,device->rtc->memory.getUsage()});
+  }
+
+  BuildLog::Scope::~Scope()
+  {
+    record.seconds  = getCurrentTime()-begin;
+    record.numPrims = numPrims;
+    for (auto &b : before) {
+      auto after = b.first->rtc->memory.getUsage();
+      for (int c=0;c<rtc::MemoryTracker::MAX_CATEGORIES;c++) {
+        size_t bytes = after.allocated[c]-b.second.allocated[c];
+        record.allocatedBytes += bytes;
+        if (c == BN_MEMORY_BVHS ||
+            c == BN_MEMORY_VOLUME_ACCELS ||
+            c == BN_MEMORY_MAJORANT_GRIDS)
+          record.accelBytes += bytes;
+      }
+    }
+    log->add(record);
+  }
+
+  void BuildLog::add(const BNBuildRecord &record)
+  {
+    if (FromEnv::get()->logBuilds) {
+      std::stringstream ss;
+      ss << "#bn.build {\"stage\":\"" << stageName(record.stage) << "\""
+         << ",\"name\":\"" << record.name << "\""
+         << ",\"object\":\"" << (const void *)record.object << "\""
+         << ",\"device\":" << record.localDeviceID
+         << ",\"ms\":" << record.seconds*1000.
+         << ",\"prims\":" << record.numPrims
+         << ",\"accelBytes\":" << record.accelBytes
+         << ",\"allocatedBytes\":" << record.allocatedBytes
+         << "}" << std::endl;
+      // one write per line, so concurrent devices' lines don't interleave
+      std::cout << ss.str() << std::flush;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    records.push_back(record);
+    if (records.size() > MAX_RECORDS)
+      records.pop_front();
+  }
+
+  int BuildLog::get(BNBuildRecord *out, int maxRecords)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i=0;i<(int)records.size() && i<maxRecords;i++)
+      out[i] = records[i];
+    return (int)records.size();
+  }
+
+  void BuildLog::clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    records.clear();
+  }
+
+}
@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+/*! \file BuildLog.h records of how long each (re-)commit and accel
+    build took, on which device, over how many prims, and what it
+    allocated; read through bnContextGetBuildRecords(), and printed as
+    json lines as they happen with BARNEY_CONFIG=log_builds */
+#pragma once
+
+#include "barney/DeviceGroup.h"
+#include <deque>
+#include <mutex>
+
+namespace BARNEY_NS {
+
+  struct BuildLog {
+    enum { MAX_RECORDS = 1024 };
+
+    /*! times one build step over its lifetime, and attributes to it
+        whatever its device(s) allocated in the meantime. Records into
+        the build log of the object's context */
+    struct Scope {
+      Scope(BNBuildStage stage, barney_api::Object *object,
+            Device *device, size_t numPrims = 0);
+      Scope(BNBuildStage stage, barney_api::Object *object,
+            const DevGroup *devices, size_t numPrims = 0);
+      ~Scope();
+
+      /*! may still get set (or corrected) before the scope ends */
+      size_t numPrims;
+    private:
+      BuildLog     *const log;
+      BNBuildRecord record;
+      double        begin;
+      std::vector<std::pair<Device *,rtc::MemoryTracker::Usage>> before;
+    };
+
+    void add(const BNBuildRecord &record);
+    int  get(BNBuildRecord *records, int maxRecords);
+    void clear();
+
+  private:
+    std::mutex                mutex;
+    std::deque<BNBuildRecord> records;
+  };
+
+}
@@ -6,6 +6,8 @@
 #include "barney/ModelSlot.h"
 #include "barney/Context.h"
 #include "barney/DeviceGroup.h"
+#include "barney/api/MappedFile.h"
+#include "barney/api/DirectFile.h"
 
 namespace BARNEY_NS {
 
@@ -61,6 +63,13 @@ namespace BARNEY_NS {
       
     case BN_UFIXED8_RGBA:
       return rtc::UCHAR4;
+
+    case BN_BC1_RGBA_UNORM:  return rtc::BC1;
+    case BN_BC3_RGBA_UNORM:  return rtc::BC3;
+    case BN_BC4_R_UNORM:     return rtc::BC4;
+    case BN_BC5_RG_UNORM:    return rtc::BC5;
+    case BN_BC6H_RGB_UFLOAT: return rtc::BC6H;
+    case BN_BC7_RGBA_UNORM:  return rtc::BC7;
       
     default: throw std::runtime_error
         ("un-recognized barney data type #"
@@ -122,6 +131,13 @@ namespace BARNEY_NS {
 
     case BN_UFIXED8_RGBA: 
       return "BN_UFIXED8_RGBA";
+
+    case BN_BC1_RGBA_UNORM:  return "BN_BC1_RGBA_UNORM";
+    case BN_BC3_RGBA_UNORM:  return "BN_BC3_RGBA_UNORM";
+    case BN_BC4_R_UNORM:     return "BN_BC4_R_UNORM";
+    case BN_BC5_RG_UNORM:    return "BN_BC5_RG_UNORM";
+    case BN_BC6H_RGB_UFLOAT: return "BN_BC6H_RGB_UFLOAT";
+    case BN_BC7_RGBA_UNORM:  return "BN_BC7_RGBA_UNORM";
       
     default:
       throw std::runtime_error
@@ -139,6 +155,7 @@ namespace BARNEY_NS {
     case BN_FB_INSTID: return "BN_FB_INSTID";
     case BN_FB_OBJID:  return "BN_FB_OBJID";
     case BN_FB_NORMAL: return "BN_FB_NORMAL";
+    case BN_FB_COST:   return "BN_FB_COST";
     default:
       throw std::runtime_error
         ("#bn internal error: to_string not implemented for "
@@ -213,21 +230,169 @@ namespace BARNEY_NS {
 
   void PODData::download(Device *device, void *hostPtr)
   {
-    void *d_ptr = getPLD(device)->rtcBuffer->getDD();
+    const void *d_ptr = getDD(device);
     auto rtc = device->rtc;
     rtc->copyAsync(hostPtr,d_ptr,numBytes);
     rtc->sync();
   }
   
+  bool PODData::readBack(size_t offset, size_t count, void *hostPtr)
+  {
+    const size_t itemSize = owlSizeOf(type);
+    if (!numBytes || (offset+count)*itemSize > numBytes) return false;
+    /* the first holder is where set() enqueued its upload, so this
+       copy comes after it */
+    Device *device = owner ? owner : (*devices)[0];
+    SetActiveGPU forDuration(device);
+    auto rtc = device->rtc;
+    rtc->copyAsync(hostPtr,
+                   (const uint8_t *)getDD(device)+offset*itemSize,
+                   count*itemSize);
+    rtc->sync();
+    return true;
+  }
+
+  void PODData::place(size_t numBytes)
+  {
+    freeManaged();
+    Context *context = (Context *)getContext();
+    const size_t threshold = size_t(FromEnv::get()->sharedDataMB) << 20;
+    owner = nullptr;
+    if (threshold > 0 && numBytes >= threshold
+        && devices->size() > 1 && context->havePeerAccess) {
+      /* spread shared arrays across the devices' memory, by what
+         they already hold */
+      size_t leastUsed = size_t(-1);
+      for (auto device : *devices) {
+        size_t used
+          = device->rtc->memory.getUsage().used[BN_MEMORY_DATA_ARRAYS];
+        if (used < leastUsed) { leastUsed = used; owner = device; }
+      }
+    }
+    for (auto device : *devices)
+      getPLD(device)->rtcBuffer->resize
+        ((owner && device != owner) ? 1 : numBytes);
+  }
+
+  std::vector<Device *> PODData::holders() const
+  {
+    if (owner) return { owner };
+    return *devices;
+  }
+
+  void PODData::upload(const void *hostData, size_t numBytes, size_t offset)
+  {
+    if (numBytes == 0) return;
+    const std::vector<Device *> targets = holders();
+    Context *context = (Context *)getContext();
+    if (targets.size() == 1 || !context->havePeerAccess
+        || FromEnv::enabled("noPeerUploads")) {
+      for (auto device : targets)
+        getPLD(device)->rtcBuffer->upload(hostData,numBytes,offset);
+      return;
+    }
+    getPLD(targets[0])->rtcBuffer->upload(hostData,numBytes,offset);
+    spread(targets,numBytes,offset);
+  }
+
+  void PODData::spread(const std::vector<Device *> &targets,
+                       size_t numBytes, size_t offset)
+  {
+    auto at = [&](Device *device)
+    { return (uint8_t *)getPLD(device)->rtcBuffer->getDD()+offset; };
+    /* every round, each device that has the data copies it to one
+       that doesn't yet, on its own stream */
+    for (size_t have=1;have<targets.size();have*=2) {
+      const size_t numCopies = std::min(have,targets.size()-have);
+      for (size_t i=0;i<numCopies;i++) {
+        Device *src = targets[i];
+        SetActiveGPU forDuration(src);
+        src->rtc->copyAsync(at(targets[have+i]),at(src),numBytes);
+      }
+      for (size_t i=0;i<numCopies;i++)
+        targets[i]->sync();
+    }
+  }
 
   void PODData::set(const void *_items, size_t count)
   {
+    MemoryScope memScope(devices.get(),BN_MEMORY_DATA_ARRAYS);
     this->count = count;
     this->numBytes = count*owlSizeOf(type);
-    for (auto device : *devices) {
-      getPLD(device)->rtcBuffer->resize(count*owlSizeOf(type));
-      getPLD(device)->rtcBuffer->upload(_items,count*owlSizeOf(type));
+    place(numBytes);
+    upload(_items,numBytes,0);
+  }
+
+  void PODData::setRange(size_t offset, const void *_items, size_t count)
+  {
+    if (offset+count > this->count)
+      throw std::runtime_error("#bn: data range ["+std::to_string(offset)
+                               +","+std::to_string(offset+count)
+                               +") exceeds array of "
+                               +std::to_string(this->count)+" items");
+    const size_t itemSize = owlSizeOf(type);
+    if (managed) {
+      auto rtc = (*devices)[0]->rtc;
+      rtc->copy((uint8_t*)managed+offset*itemSize,_items,count*itemSize);
+      return;
     }
+    upload(_items,count*itemSize,offset*itemSize);
+  }
+
+  void BaseData::setFromFile(const char *fileName,
+                             size_t offset,
+                             size_t count)
+  {
+    throw std::runtime_error("#bn: data of type "+to_string(type)
+                             +" can not be read from a file");
+  }
+
+  void PODData::setFromFile(const char *fileName,
+                            size_t offset,
+                            size_t count)
+  {
+    MemoryScope memScope(devices.get(),BN_MEMORY_DATA_ARRAYS);
+    const size_t itemSize = owlSizeOf(type);
+    const size_t numBytes = count*itemSize;
+    this->count = count;
+    this->numBytes = numBytes;
+    place(numBytes);
+    if (numBytes == 0) return;
+
+    if (readDirect(fileName,offset)) return;
+
+    barney_api::MappedFile file(fileName,offset,numBytes);
+    for (size_t begin=0;begin<numBytes;begin+=uploadChunkSize) {
+      size_t size = std::min(uploadChunkSize,numBytes-begin);
+      upload(file.data+begin,size,begin);
+      file.release(begin,begin+size);
+    }
+  }
+
+  bool PODData::readDirect(const char *fileName, size_t offset)
+  {
+    barney_api::DirectFile file(fileName);
+    if (!file.valid()) return false;
+    const std::vector<Device *> targets = holders();
+    Context *context = (Context *)getContext();
+    const bool viaPeers
+      = targets.size() > 1 && context->havePeerAccess
+      && !FromEnv::enabled("noPeerUploads");
+    for (auto device : targets) {
+      SetActiveGPU forDuration(device);
+      /* pending work on the device's stream may still be reading
+         the buffer's previous contents */
+      device->sync();
+      if (!file.read(getPLD(device)->rtcBuffer->getDD(),numBytes,offset)) {
+        std::cout << "#bn: GPUDirect Storage read of '" << fileName
+                    << "' failed; reading it through the host" << std::endl;
+        return false;
+      }
+      if (viaPeers) break;
+    }
+    if (viaPeers)
+      spread(targets,numBytes,0);
+    return true;
   }
 
   PODData::PODData(Context *context,
@@ -236,6 +401,7 @@ namespace BARNEY_NS {
     : BaseData(context,devices,type)
   {
     perLogical.resize(devices->numLogical);
+    MemoryScope memScope(devices.get(),BN_MEMORY_DATA_ARRAYS);
     for (auto device : *devices) {
       getPLD(device)->rtcBuffer 
         = device->rtc->createBuffer(1);//*owlSizeOf(type),_items);
@@ -248,6 +414,7 @@ namespace BARNEY_NS {
   PODData::~PODData()
   {
     BN_TRACK_LEAKS(std::cout << "#barney: ~PODData is dying" << std::endl);
+    freeManaged();
     for (auto device : *devices)
       device->rtc->freeBuffer(getPLD(device)->rtcBuffer);
   }
@@ -255,12 +422,73 @@ namespace BARNEY_NS {
   const void *PODData::getDD(Device *device) 
   {
     assert(device);
-    PLD *pld = getPLD(device);
+    if (managed) return managed;
+    PLD *pld = getPLD(owner ? owner : device);
     assert(pld);
     assert(pld->rtcBuffer);
     return pld->rtcBuffer->getDD();
   }
+
+  rtc::Buffer *PODData::getBuffer(Device *device)
+  {
+    if (managed) {
+      MemoryScope memScope(devices.get(),BN_MEMORY_DATA_ARRAYS);
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        getPLD(device)->rtcBuffer->resize(numBytes);
+        getPLD(device)->rtcBuffer->upload(managed,numBytes);
+      }
+      freeManaged();
+    }
+    if (owner) {
+      MemoryScope memScope(devices.get(),BN_MEMORY_DATA_ARRAYS);
+      const void *shared = getPLD(owner)->rtcBuffer->getDD();
+      for (auto other : *devices) {
+        if (other == owner) continue;
+        SetActiveGPU forDuration(other);
+        getPLD(other)->rtcBuffer->resize(numBytes);
+        getPLD(other)->rtcBuffer->upload(shared,numBytes);
+      }
+      owner = nullptr;
+    }
+    return getPLD(device)->rtcBuffer;
+  }
   
+  void PODData::makeManaged()
+  {
+    if (managed || numBytes == 0) return;
+    MemoryScope memScope(devices.get(),BN_MEMORY_DATA_ARRAYS);
+    Device *first = (*devices)[0];
+    SetActiveGPU forDuration(first);
+    void *mem = first->rtc->allocManaged(numBytes);
+    first->rtc->copy(mem,getDD(first),numBytes);
+    for (auto device : *devices)
+      getPLD(device)->rtcBuffer->resize(1);
+    owner   = nullptr;
+    managed = mem;
+  }
+
+  void PODData::freeManaged()
+  {
+    if (!managed) return;
+    (*devices)[0]->rtc->freeManaged(managed);
+    managed = nullptr;
+  }
+
+  void PODData::prefetch()
+  {
+    if (!managed) return;
+    for (auto device : *devices) {
+      size_t free = 0, total = 0;
+      device->rtc->getMemInfo(free,total);
+      /* if it doesn't fit, prefetching would only evict the pages
+         other devices' (or this one's) earlier prefetches brought in;
+         rather let sampling page in what it needs */
+      if (numBytes < free)
+        device->rtc->prefetch(managed,numBytes);
+    }
+  }
+
   PODData::PLD *PODData::getPLD(Device *device) 
   {
     assert(device);
@@ -333,5 +561,16 @@ namespace BARNEY_NS {
       items[i] = (((Object **)_items)[i])->shared_from_this();
   }
 
+  void ObjectRefsData::setRange(size_t offset, const void *_items, size_t count)
+  {
+    if (offset+count > this->count)
+      throw std::runtime_error("#bn: data range ["+std::to_string(offset)
+                               +","+std::to_string(offset+count)
+                               +") exceeds array of "
+                               +std::to_string(this->count)+" items");
+    for (size_t i=0;i<count;i++)
+      items[offset+i] = (((Object **)_items)[i])->shared_from_this();
+  }
+
 
 }
@@ -26,6 +26,10 @@ namespace BARNEY_NS {
                                const DevGroup::SP &devices,
                                BNDataType type);
 
+    void setFromFile(const char *fileName,
+                     size_t offset,
+                     size_t count) override;
+
     BNDataType type  = BN_DATA_UNDEFINED;
     size_t     count = 0;
     DevGroup::SP const devices;
@@ -47,9 +51,36 @@ namespace BARNEY_NS {
     virtual ~PODData();
 
     size_t size() const { return numBytes; }
+    /*! where given device reads this array from; that's the owner's
+        buffer if this array is shared */
     const void *getDD(Device *device);
+    /*! given device's own buffer, for apis that have to have their
+        inputs in rtc buffers (e.g., triangle bvh builds); if the
+        array is shared, this first replicates it to all devices */
+    rtc::Buffer *getBuffer(Device *device);
+    /*! moves this array into a single unified-memory allocation that
+        all devices read from, and that may be larger than what they
+        have free (see rtc's allocManaged()), and frees the devices'
+        own copies. Lasts until the array gets set again */
+    void makeManaged();
+    /*! if managed, and it fits into what each device has free right
+        now, has all devices start migrating it in the background */
+    void prefetch();
     void set(const void *data, size_t count) override;
+    void setRange(size_t offset, const void *data, size_t count) override;
+    /*! reads the file straight into device memory if GPUDirect
+        Storage is available, else maps the file, and uploads it to
+        each device in chunks of uploadChunkSize bytes, dropping each
+        chunk's pages once all devices have it; so no more than one
+        chunk of the file ever is resident in this process at any
+        time */
+    void setFromFile(const char *fileName,
+                     size_t offset,
+                     size_t count) override;
     void download(Device *device, void *hostPtr);
+    bool readBack(size_t offset, size_t count, void *hostPtr) override;
+
+    static const size_t uploadChunkSize = size_t(64)<<20;
 
     struct PLD {
       rtc::Buffer *rtcBuffer   = 0;
@@ -57,6 +88,37 @@ namespace BARNEY_NS {
     size_t numBytes = 0;
     PLD *getPLD(Device *device);
     std::vector<PLD> perLogical;
+
+    /*! if non-null, this array is shared: only the owner holds its
+        data, and all other devices read it from there, peer-to-peer
+        (see FromEnv::sharedDataMB) */
+    Device *owner = nullptr;
+    /*! if non-null, the unified-memory allocation all devices read
+        from; allocated through the first device */
+    void   *managed = nullptr;
+
+  private:
+    /*! (re-)sizes all devices' buffers for an array of given size,
+        and decides whether that gets shared, and by whom */
+    void place(size_t numBytes);
+    void freeManaged();
+    /*! the devices whose buffers hold this array's data */
+    std::vector<Device *> holders() const;
+    /*! writes given host data into all holders' buffers, at given
+        offset. With several holders that can access each other's
+        memory, only the first one gets it from the host; it then
+        spreads from device to device in a binary tree, so the host
+        link gets crossed once rather than once per device */
+    void upload(const void *hostData, size_t numBytes, size_t offset);
+    /*! copies bytes [offset,offset+numBytes) from the first of
+        given holders to all others, peer to peer */
+    void spread(const std::vector<Device *> &targets,
+                size_t numBytes, size_t offset);
+    /*! setFromFile() through GPUDirect Storage (see DirectFile):
+        reads the file straight into the (first) holder's buffer,
+        then spreads it from there; false if that is not available
+        for this file, and nothing got read */
+    bool readDirect(const char *fileName, size_t offset);
   };
 
   /*! data array over reference-counted barney object handles (e.g.,
@@ -68,6 +130,7 @@ namespace BARNEY_NS {
                    const DevGroup::SP &devices,
                    BNDataType type);
     void set(const void *data, size_t count) override;
+    void setRange(size_t offset, const void *data, size_t count) override;
     std::vector<Object::SP> items;
   };
 
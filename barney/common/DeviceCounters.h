@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/common/barney-common.h"
+#if !defined(__CUDACC__) && !defined(__HIPCC__)
+# include <atomic>
+#endif
+
+namespace BARNEY_NS {
+
+  /*! opt-in (cmake BARNEY_DEVICE_COUNTERS) statistics that kernels
+      and programs count into while rendering a frame. Every device
+      has NUM_COUNTERS of them per generation (see
+      Device::countersFor()), and reads them back for
+      bnFrameBufferGetCounters(); without that option count()
+      compiles to nothing and all counter pointers are null. Same
+      order as the fields of BNDeviceCounterValues */
+  struct DeviceCounters {
+    typedef enum {
+      RAYS_GENERATED=0,
+      RAYS_TRACED,
+      SHADOW_RAYS,
+      RAYS_SHADED,
+      /*! calls of (user geometry) intersection programs, ie, prims
+          that made it through the bvh traversal */
+      PRIM_TESTS,
+      /*! macro cells stepped through by volume traversal */
+      DDA_CELLS,
+      WOODCOCK_SAMPLES,
+      WOODCOCK_ACCEPTED,
+      NUM_COUNTERS
+    } Which;
+
+    /*! increments counters[which], if enabled (and counters is
+        non-null). On cuda all lanes of a warp that get here count in
+        a single atomic, so 'which' has to be the same for all of
+        them - which it is for the constants all code passes */
+    static inline __rtc_device void count(uint64_t *counters, int which);
+  };
+
+  inline __rtc_device
+  void DeviceCounters::count(uint64_t *counters, int which)
+  {
+#if BARNEY_DEVICE_COUNTERS
+    if (!counters) return;
+# if defined(__CUDA_ARCH__)
+    const unsigned mask = __activemask();
+    unsigned laneID;
+    asm volatile("mov.u32 %0, %%laneid;" : "=r"(laneID));
+    if (laneID == unsigned(__ffs(mask)-1))
+      atomicAdd((unsigned long long *)&counters[which],
+                (unsigned long long)__popc(mask));
+# elif defined(__HIP_DEVICE_COMPILE__)
+    atomicAdd((unsigned long long *)&counters[which],1ull);
+# else
+    ((std::atomic<uint64_t> *)&counters[which])
+      ->fetch_add(1,std::memory_order_relaxed);
+# endif
+#endif
+  }
+
+}
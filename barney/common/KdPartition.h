@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/common/barney-common.h"
+#include <algorithm>
+
+namespace BARNEY_NS {
+
+  /*! splits given points (typically, element centroids) into as
+      many spatially compact parts as there are part weights, with
+      each part getting (nearly) its weight's share of the points;
+      by recursively splitting at the correspondingly weighted
+      median along the widest dimension of the current subset's
+      bounds. Returns, for each point, the part it ended up in */
+  inline std::vector<int> kdPartition(const std::vector<vec3f> &points,
+                                      const std::vector<float> &partWeights)
+  {
+    const int numParts = std::max((int)partWeights.size(),1);
+    std::vector<int> partOf(points.size(),0);
+    std::vector<int> ids(points.size());
+    for (int i=0;i<(int)ids.size();i++) ids[i] = i;
+    auto weightOf = [&](int begin, int end)
+    {
+      double sum = 0.;
+      for (int i=begin;i<end;i++)
+        sum += (i < (int)partWeights.size()) ? partWeights[i] : 1.f;
+      return sum;
+    };
+
+    struct Job { int begin, end, firstPart, numParts; };
+    std::vector<Job> stack = { { 0,(int)ids.size(),0,numParts } };
+    while (!stack.empty()) {
+      Job job = stack.back(); stack.pop_back();
+      if (job.numParts == 1 || job.end - job.begin <= 1) {
+        for (int i=job.begin;i<job.end;i++)
+          partOf[ids[i]] = job.firstPart;
+        continue;
+      }
+      box3f bounds;
+      for (int i=job.begin;i<job.end;i++)
+        bounds.extend(points[ids[i]]);
+      const vec3f size = bounds.size();
+      const int dim
+        = (size.x >= size.y && size.x >= size.z) ? 0 : (size.y >= size.z ? 1 : 2);
+      const int lParts = job.numParts/2;
+      const double total = weightOf(job.firstPart,job.firstPart+job.numParts);
+      const double lShare
+        = total > 0.
+        ? weightOf(job.firstPart,job.firstPart+lParts)/total
+        : double(lParts)/job.numParts;
+      const int mid
+        = job.begin + int((job.end-job.begin)*lShare);
+      std::nth_element(ids.begin()+job.begin,ids.begin()+mid,ids.begin()+job.end,
+                       [&](int a, int b)
+                       { return points[a][dim] < points[b][dim]; });
+      stack.push_back({ job.begin,mid,job.firstPart,lParts });
+      stack.push_back({ mid,job.end,job.firstPart+lParts,job.numParts-lParts });
+    }
+    return partOf;
+  }
+
+  /*! same, with numParts parts of equal weight */
+  inline std::vector<int> kdPartition(const std::vector<vec3f> &points,
+                                      int numParts)
+  {
+    return kdPartition(points,std::vector<float>(std::max(numParts,1),1.f));
+  }
+
+}
@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/common/MPIProgress.h"
+#include <iostream>
+#include <chrono>
+
+namespace barney_api {
+  namespace mpi {
+
+    ProgressThread *ProgressThread::create(const Comm &comm)
+    {
+      int provided = 0;
+      BN_MPI_CALL(Query_thread(&provided));
+      if (provided < MPI_THREAD_MULTIPLE) {
+        if (comm.rank == 0)
+          std::cerr << "#bn.mpi: WARNING - mpi progress thread requested, "
+                    << "but MPI was not initialized with "
+                    << "MPI_THREAD_MULTIPLE; ignoring" << std::endl;
+        return nullptr;
+      }
+      return new ProgressThread(comm);
+    }
+
+    ProgressThread::ProgressThread(const Comm &comm)
+    {
+      BN_MPI_CALL(Comm_dup(comm.comm,&probeComm));
+      thread = std::thread([this](){ run(); });
+    }
+
+    ProgressThread::~ProgressThread()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+      }
+      cv.notify_all();
+      thread.join();
+      MPI_Comm_free(&probeComm);
+    }
+
+    void ProgressThread::begin()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        numActive++;
+      }
+      cv.notify_all();
+    }
+
+    void ProgressThread::end()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      numActive--;
+    }
+
+    void ProgressThread::run()
+    {
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cv.wait(lock,[this](){ return quit || numActive > 0; });
+          if (quit) return;
+        }
+        /* nothing will ever get sent on probeComm, so this probe
+           never matches anything - it's only there to get the MPI
+           library to run its progress engine */
+        int flag = 0;
+        MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,probeComm,&flag,
+                   MPI_STATUS_IGNORE);
+        /* don't compete too much with the render thread for the
+           library's locks */
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+      }
+    }
+
+  }
+}
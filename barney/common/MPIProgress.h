@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/common/MPIWrappers.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+namespace barney_api {
+  namespace mpi {
+
+    /*! background thread that keeps polling the MPI library while
+        the render thread has non-blocking sends and receives in
+        flight. Many MPI stacks only ever move (large, rendezvous)
+        messages forward from inside an MPI call, so without this,
+        transfers that got posted as non-blocking often don't start
+        before the render thread eventually waits on them. The thread
+        only polls between begin() and end(), and sleeps otherwise.
+        Requires MPI_THREAD_MULTIPLE */
+    struct ProgressThread {
+      /*! creates a progress thread if the MPI runtime provides
+          MPI_THREAD_MULTIPLE; else, warns and returns null. Collective
+          over the given comm */
+      static ProgressThread *create(const Comm &comm);
+      ~ProgressThread();
+
+      /*! start polling (calls nest) */
+      void begin();
+      /*! stop polling once matching calls to begin() are all done */
+      void end();
+
+      /*! polls for the duration of its lifetime; no-op if progress
+          thread is null */
+      struct Scope {
+        Scope(ProgressThread *pt) : pt(pt) { if (pt) pt->begin(); }
+        ~Scope() { if (pt) pt->end(); }
+        ProgressThread *const pt;
+      };
+
+    private:
+      ProgressThread(const Comm &comm);
+      void run();
+
+      /*! private duplicate of the context's comm, so our probes can
+          never match (or steal) any of the render thread's messages */
+      MPI_Comm                probeComm = MPI_COMM_NULL;
+      std::thread             thread;
+      std::mutex              mutex;
+      std::condition_variable cv;
+      std::atomic<int>        numActive { 0 };
+      std::atomic<bool>       quit { false };
+    };
+
+  }
+}
@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/common/barney-common.h"
+
+namespace BARNEY_NS {
+
+  /*! device-side view of an array that lives in fixed-size pages,
+      through a page table of (at most) maxPages page pointers. The
+      page table gets allocated once, at full size, so growing the
+      array only ever adds a page and fills in its page table entry:
+      entries never move, and neither does the view itself - anything
+      that got handed a PagedArray stays valid no matter how many
+      entries get added later. See MaterialRegistry and
+      SamplerRegistry */
+  template<typename T>
+  struct PagedArray {
+    enum { log2PageSize = 6,
+           pageSize     = 1<<log2PageSize,
+           maxPages     = 1<<12 };
+
+    inline __rtc_device
+    T &operator[](int i) const
+    { return pages[i >> log2PageSize][i & (pageSize-1)]; }
+
+    T *const *pages;
+  };
+
+}
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/common/barney-common.h"
+#include "barney/common/hostParallel.h"
+
+namespace BARNEY_NS {
+
+  /*! spreads lower 21 bits of x out to every third bit */
+  inline uint64_t mortonSplitBits(uint64_t x)
+  {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x << 8)  & 0x100f00f00f00f00full;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3ull;
+    x = (x | x << 2)  & 0x1249249249249249ull;
+    return x;
+  }
+
+  /*! 63-bit morton code of given point, quantized to 21 bits per
+      axis over given bounds */
+  inline uint64_t mortonCode(vec3f P, const box3f &bounds)
+  {
+    const vec3f scale
+      = vec3f((float)((1<<21)-1))
+      * rcp(max(bounds.size(),vec3f(1e-20f)));
+    const vec3i cell = vec3i((P-bounds.lower)*scale);
+    return
+      mortonSplitBits(cell.x)
+      | mortonSplitBits(cell.y) << 1
+      | mortonSplitBits(cell.z) << 2;
+  }
+
+  /*! returns the indices of given points (typically, primitive
+      centroids) in the order in which a morton curve over their
+      bounds visits them; ie, consecutive entries of the result are
+      (mostly) spatially close */
+  inline std::vector<int> spatialOrder(const std::vector<vec3f> &points)
+  {
+    box3f bounds;
+    for (auto &P : points)
+      bounds.extend(P);
+    std::vector<std::pair<uint64_t,int>> sorted(points.size());
+    hostParallelFor(points.size(),1<<16,[&](size_t begin, size_t end){
+      for (size_t i=begin;i<end;i++)
+        sorted[i] = { mortonCode(points[i],bounds),(int)i };
+    });
+    hostParallelSort(sorted,[](const std::pair<uint64_t,int> &a,
+                               const std::pair<uint64_t,int> &b)
+    { return a.first < b.first; });
+    std::vector<int> order(points.size());
+    for (size_t i=0;i<points.size();i++)
+      order[i] = sorted[i].second;
+    return order;
+  }
+
+}
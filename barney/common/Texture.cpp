@@ -57,22 +57,28 @@ namespace BARNEY_NS {
     case BN_FLOAT:
     case BN_UFIXED8:
     case BN_UFIXED16:
+    case BN_BC4_R_UNORM:
       return 1;
       
     case BN_FLOAT32_VEC2:
     case BN_INT32_VEC2:
     case BN_UINT32_VEC2:
+    case BN_BC5_RG_UNORM:
       return 2;
       
     case BN_FLOAT32_VEC3:
     case BN_INT32_VEC3:
     case BN_UINT32_VEC3:
+    case BN_BC6H_RGB_UFLOAT:
       return 3;
       
     case BN_FLOAT32_VEC4:
     case BN_INT32_VEC4:
     case BN_UINT32_VEC4:
     case BN_UFIXED8_RGBA:
+    case BN_BC1_RGBA_UNORM:
+    case BN_BC3_RGBA_UNORM:
+    case BN_BC7_RGBA_UNORM:
       return 4;
     default:
       BARNEY_NYI();
@@ -91,6 +97,7 @@ namespace BARNEY_NS {
       devices(data->devices),
       data(data)
   {
+    data->waitForUpload();
     perLogical.resize(devices->numLogical);
     rtc::TextureDesc desc;
     desc.filterMode     = toRTC(filterMode);
@@ -108,15 +115,42 @@ namespace BARNEY_NS {
       auto pld = getPLD(device);
       assert(pld);
       pld->rtcTexture
-        = data->getPLD(device)->rtc->createTexture(desc);
+        = data->getRTC(device)->createTexture(desc);
     }
   }
 
+  /*! bytes per texel of the (non-block-compressed) formats that
+      get uploaded as plain host arrays; 0 for all others */
+  static size_t texelBytesOf(BNDataType texelFormat)
+  {
+    switch (texelFormat) {
+    case BN_FLOAT32:      return sizeof(float);
+    case BN_FLOAT32_VEC4: return sizeof(vec4f);
+    case BN_UFIXED8:      return sizeof(uint8_t);
+    case BN_UFIXED16:     return sizeof(uint16_t);
+    case BN_UFIXED8_RGBA: return sizeof(vec4uc);
+    default:              return 0;
+    }
+  }
+
+  size_t TextureData::numBytesOf(BNDataType texelFormat, vec3i dims)
+  {
+    if (texelFormat >= BN_BC1_RGBA_UNORM && texelFormat <= BN_BC7_RGBA_UNORM) {
+      const size_t bytesPerBlock
+        = (texelFormat == BN_BC1_RGBA_UNORM || texelFormat == BN_BC4_R_UNORM)
+        ? 8 : 16;
+      return bytesPerBlock*divRoundUp(dims.x,4)*divRoundUp(dims.y,4);
+    }
+    return texelBytesOf(texelFormat)
+      *dims.x*std::max(dims.y,1)*std::max(dims.z,1);
+  }
+
   TextureData::TextureData(Context *context,
                            const DevGroup::SP &devices,
                            BNDataType texelFormat,
                            vec3i size,
-                           const void *texels)
+                           const void *texels,
+                           bool asyncUpload)
     : barney_api::TextureData(context),
       devices(devices),
       dims(size),
@@ -124,13 +158,58 @@ namespace BARNEY_NS {
       texelFormat(texelFormat)
   {
     perLogical.resize(devices->numLogical);
+    MemoryScope memScope(devices.get(),BN_MEMORY_TEXTURES);
     rtc::DataType format = toRTC(texelFormat);
+    const size_t streamAbove
+      = size_t(FromEnv::get()->streamTexturesMB) << 20;
+    const size_t numBytes = size_t(size.x)*size.y*sizeof(vec4uc);
+    if (streamAbove && texelFormat == BN_UFIXED8_RGBA
+        && size.z == 0 && size.y > 0 && numBytes > streamAbove) {
+      hostTexels.resize(numBytes);
+      memcpy(hostTexels.data(),texels,numBytes);
+      return;
+    }
+    /* with several devices that can access each other's memory the
+       texels cross the host link only once, into a staging buffer on
+       the first device that all devices' arrays then get filled
+       from */
+    Device *first = (*devices)[0];
+    rtc::Buffer *staging = 0;
+    const size_t texelBytes = texelBytesOf(texelFormat);
+    if (!asyncUpload && texelBytes && devices->size() > 1
+        && context->havePeerAccess && !FromEnv::enabled("noPeerUploads")) {
+      SetActiveGPU forDuration(first);
+      staging = first->rtc->createBuffer
+        (texelBytes*size.x*std::max(size.y,1)*std::max(size.z,1),texels);
+      texels = staging->getDD();
+    }
     for (auto device : *devices) {
       auto pld = getPLD(device);
-      pld->rtc
-        = device->rtc->createTextureData(size,format,texels);
+      if (asyncUpload) {
+        pld->uploaded = device->rtc->createEvent();
+        pld->rtc
+          = device->rtc->createTextureDataAsync(size,format,texels,
+                                                pld->uploaded);
+      } else
+        pld->rtc
+          = device->rtc->createTextureData(size,format,texels);
       assert(pld->rtc);
     }
+    if (staging) {
+      SetActiveGPU forDuration(first);
+      first->rtc->freeBuffer(staging);
+    }
+  }
+
+  void TextureData::waitForUpload()
+  {
+    for (auto device : *devices) {
+      auto pld = getPLD(device);
+      if (!pld->uploaded) continue;
+      device->rtc->streamWaitEvent(pld->uploaded);
+      device->rtc->freeEvent(pld->uploaded);
+      pld->uploaded = 0;
+    }
   }
 
   Texture::~Texture()
@@ -147,8 +226,29 @@ namespace BARNEY_NS {
 
   TextureData::~TextureData()
   {
-    for (auto device : *devices)
-      device->rtc->freeTextureData(getPLD(device)->rtc);
+    for (auto device : *devices) {
+      auto pld = getPLD(device);
+      if (pld->uploaded) {
+        // can't free the array while the copy engine still writes it
+        device->rtc->waitForEvent(pld->uploaded);
+        device->rtc->freeEvent(pld->uploaded);
+      }
+      if (pld->rtc)
+        device->rtc->freeTextureData(pld->rtc);
+    }
+  }
+
+  rtc::TextureData *TextureData::getRTC(Device *device)
+  {
+    auto pld = getPLD(device);
+    if (!pld->rtc && hostOnly()) {
+      SetActiveGPU forDuration(device);
+      MemoryScope memScope(device,BN_MEMORY_TEXTURES);
+      pld->rtc
+        = device->rtc->createTextureData(dims,toRTC(texelFormat),
+                                         hostTexels.data());
+    }
+    return pld->rtc;
   }
 
   rtc::TextureObject
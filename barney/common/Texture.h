@@ -20,21 +20,59 @@ namespace BARNEY_NS {
 
     struct PLD {
       rtc::TextureData *rtc = 0;
+      /*! only for async uploads that nobody has waited on yet */
+      rtc::Event       *uploaded = 0;
     };
     PLD *getPLD(Device *device);
     std::vector<PLD> perLogical;
    
+    /*! if asyncUpload is set, the texels only get queued for upload
+        on the devices' copy streams (see
+        rtc::Device::createTextureDataAsync()), and whoever uses the
+        data has to call waitForUpload() first */
     TextureData(Context *context,
                 const DevGroup::SP &devices,
                 BNDataType texelFormat,
                 vec3i size,
-                const void *texels);
+                const void *texels,
+                bool asyncUpload = false);
     virtual ~TextureData();
 
+    /*! makes all work subsequently issued to the devices' (main)
+        streams wait for a pending async upload, without blocking
+        the host; no-op if there isn't one */
+    void waitForUpload();
+
+    /*! the device copy of the texels; for host-only data that gets
+        created (ie, made fully resident) on first use */
+    rtc::TextureData *getRTC(Device *device);
+
     /*! pretty-printer for printf-debugging */
     std::string toString() const override
     { return "TextureData{}"; }
 
+    /*! one of the BN_BC<n>_... formats; those don't get mip levels
+        (on gpus, at least), so get sampled at level 0 only */
+    bool isBlockCompressed() const
+    { return texelFormat >= BN_BC1_RGBA_UNORM
+        &&   texelFormat <= BN_BC7_RGBA_UNORM; }
+
+    /*! 2D rgba8 data larger than BARNEY_CONFIG's streamTexturesMB
+        only stays in host memory; image samplers then stream it
+        through a TileStreamer rather than uploading all of it */
+    bool hostOnly() const { return !hostTexels.empty(); }
+    std::vector<uint8_t> hostTexels;
+
+    /*! size of the host array that texels of given format and dims
+        get created from; 0 for formats this doesn't know */
+    static size_t numBytesOf(BNDataType texelFormat, vec3i dims);
+
+    /*! importance sampling tables built over this data by an env
+        map light (see EnvMapLight::Tables); kept here so all lights
+        using the same data share them, and weak so they don't
+        outlive the last such light */
+    std::weak_ptr<void> envMapTables;
+
     int             numChannels;
     vec3i           dims;
     BNDataType      texelFormat;
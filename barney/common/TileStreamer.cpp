@@ -0,0 +1,255 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/common/TileStreamer.h"
+#include "barney/common/hostParallel.h"
+#include "barney/Context.h"
+#include <algorithm>
+#include <limits>
+
+namespace BARNEY_NS {
+
+  /*! index of texel i in a level of n texels, for given address mode */
+  static int wrapTexel(int i, int n, BNTextureAddressMode mode)
+  {
+    if (i >= 0 && i < n) return i;
+    switch (mode) {
+    case BN_TEXTURE_WRAP:
+      return ((i % n) + n) % n;
+    case BN_TEXTURE_MIRROR: {
+      int p = ((i % (2*n)) + 2*n) % (2*n);
+      return p < n ? p : 2*n-1-p;
+    }
+    default:
+      return std::max(0,std::min(i,n-1));
+    }
+  }
+
+  TileStreamer::PLD *TileStreamer::getPLD(Device *device)
+  {
+    assert(device);
+    assert(device->contextRank() >= 0);
+    assert(device->contextRank() < perLogical.size());
+    return &perLogical[device->contextRank()];
+  }
+
+  TileStreamer::TileStreamer(Context *context,
+                             const DevGroup::SP &devices,
+                             TextureData::SP data,
+                             const BNTextureAddressMode wrapModes[2])
+    : context(context),
+      devices(devices)
+  {
+    assert(data->hostOnly());
+    perLogical.resize(devices->numLogical);
+    MemoryScope memScope(devices.get(),BN_MEMORY_TEXTURES);
+    this->wrapModes[0] = (uint8_t)wrapModes[0];
+    this->wrapModes[1] = (uint8_t)wrapModes[1];
+
+    // ------------------------------------------------------------------
+    // box-filtered mip chain, down to the first level that fits
+    // into a single tile; that one stays resident
+    // ------------------------------------------------------------------
+    std::vector<std::vector<vec4uc>> mips;
+    vec2i dims = { data->dims.x,data->dims.y };
+    mips.push_back(std::vector<vec4uc>((const vec4uc *)data->hostTexels.data(),
+                                       (const vec4uc *)data->hostTexels.data()
+                                       +size_t(dims.x)*dims.y));
+    while (true) {
+      Level level;
+      level.dims      = dims;
+      level.numTiles  = divRoundUp(dims,vec2i(tileSize));
+      level.firstTile = numTiles;
+      numTiles += level.numTiles.x*level.numTiles.y;
+      levels.push_back(level);
+      if (dims.x <= tileSize && dims.y <= tileSize) break;
+
+      const std::vector<vec4uc> &finer = mips.back();
+      vec2i finerDims = dims;
+      dims = max(vec2i(1),dims/2);
+      std::vector<vec4uc> coarser(size_t(dims.x)*dims.y);
+      hostParallelFor(dims.y,16,[&](size_t begin, size_t end){
+        for (int iy=(int)begin;iy<(int)end;iy++)
+          for (int ix=0;ix<dims.x;ix++) {
+            vec4i sum(0);
+            for (int dy=0;dy<2;dy++)
+              for (int dx=0;dx<2;dx++) {
+                int x = std::min(2*ix+dx,finerDims.x-1);
+                int y = std::min(2*iy+dy,finerDims.y-1);
+                sum = sum + vec4i(finer[x+size_t(y)*finerDims.x]);
+              }
+            coarser[ix+size_t(iy)*dims.x] = vec4uc((sum+2)/4);
+          }
+      });
+      mips.push_back(std::move(coarser));
+    }
+
+    // ------------------------------------------------------------------
+    // cut all levels into tiles with borders, in pinned host memory
+    // ------------------------------------------------------------------
+    const size_t texelsPerTile = storedTileSize*storedTileSize;
+    hostTiles
+      = (vec4uc *)(*devices)[0]->rtc->allocHost(numTiles*texelsPerTile
+                                                *sizeof(vec4uc));
+    hostParallelFor(numTiles,64,[&](size_t begin, size_t end){
+      for (int tileID=(int)begin;tileID<(int)end;tileID++) {
+        int l = 0;
+        while (l+1 < (int)levels.size() && levels[l+1].firstTile <= tileID)
+          l++;
+        const Level &level = levels[l];
+        int localID = tileID-level.firstTile;
+        int tx = localID % level.numTiles.x;
+        int ty = localID / level.numTiles.x;
+        vec4uc *out = hostTiles+tileID*texelsPerTile;
+        for (int sy=0;sy<storedTileSize;sy++)
+          for (int sx=0;sx<storedTileSize;sx++) {
+            int x = wrapTexel(tx*tileSize+sx-1,level.dims.x,wrapModes[0]);
+            int y = wrapTexel(ty*tileSize+sy-1,level.dims.y,wrapModes[1]);
+            out[sx+sy*storedTileSize] = mips[l][x+size_t(y)*level.dims.x];
+          }
+      }
+    });
+    mips.clear();
+
+    // ------------------------------------------------------------------
+    // per-device caches; slot 0 permanently holds the coarsest level
+    // ------------------------------------------------------------------
+    const size_t bytesPerTile = texelsPerTile*sizeof(vec4uc);
+    cacheSize
+      = (int)std::min((size_t)numTiles,
+                      std::max((size_t)2,
+                               (size_t(FromEnv::get()->streamTexturesMB)<<20)
+                               /bytesPerTile));
+    const int pinnedTile = levels.back().firstTile;
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      auto rtc = device->rtc;
+      pld->slots.resize(numTiles,-1);
+      pld->slots[pinnedTile] = 0;
+      pld->residentTile.resize(cacheSize,-1);
+      pld->residentTile[0] = pinnedTile;
+      pld->lastUsed.resize(cacheSize,0);
+      pld->lastUsed[0] = std::numeric_limits<int>::max();
+      pld->tileSlots
+        = rtc->createBuffer(numTiles*sizeof(int),pld->slots.data());
+      pld->tileUsage
+        = rtc->createBuffer(numTiles);
+      rtc->memsetAsync(pld->tileUsage->getDD(),0,numTiles);
+      pld->pool
+        = rtc->createBuffer(cacheSize*bytesPerTile);
+      rtc->copyAsync(pld->pool->getDD(),hostTiles+pinnedTile*texelsPerTile,
+                     bytesPerTile);
+      pld->levels
+        = rtc->createBuffer(levels.size()*sizeof(Level),levels.data());
+      rtc->sync();
+    }
+    context->streamedTextures.insert(this);
+
+    if (FromEnv::get()->logConfig)
+      std::cout << "#bn: streaming " << data->dims.x << "x" << data->dims.y
+                << " texture in " << prettyNumber(numTiles)
+                << " tiles, through a cache of " << prettyNumber(cacheSize)
+                << " tiles per device" << std::endl;
+  }
+
+  TileStreamer::~TileStreamer()
+  {
+    context->streamedTextures.erase(this);
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      for (auto buffer : { &pld->tileSlots,
+                           &pld->tileUsage,
+                           &pld->pool,
+                           &pld->levels }) {
+        if (*buffer) device->rtc->freeBuffer(*buffer);
+        *buffer = 0;
+      }
+    }
+    if (hostTiles)
+      (*devices)[0]->rtc->freeHost(hostTiles);
+    hostTiles = 0;
+  }
+
+  TileStreamer::DD TileStreamer::getDD(Device *device)
+  {
+    PLD *pld = getPLD(device);
+    DD dd;
+    dd.tileSlots    = (const int *)pld->tileSlots->getDD();
+    dd.tileUsage    = (uint8_t *)pld->tileUsage->getDD();
+    dd.pool         = (const vec4uc *)pld->pool->getDD();
+    dd.levels       = (const Level *)pld->levels->getDD();
+    dd.numLevels    = (int)levels.size();
+    dd.wrapModes[0] = wrapModes[0];
+    dd.wrapModes[1] = wrapModes[1];
+    return dd;
+  }
+
+  void TileStreamer::servicePageRequests()
+  {
+    const int frameID = ++this->frameID;
+    const size_t texelsPerTile = storedTileSize*storedTileSize;
+    const size_t bytesPerTile  = texelsPerTile*sizeof(vec4uc);
+    std::vector<uint8_t> usage(numTiles);
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      auto rtc = device->rtc;
+      void *d_usage = pld->tileUsage->getDD();
+      rtc->copy(usage.data(),d_usage,numTiles);
+      rtc->memsetAsync(d_usage,0,numTiles);
+
+      /* finest levels come first, but those are also the ones that
+         the coarser fallbacks cover the worst; so page in coarse to
+         fine, growing the image's detail level by level */
+      std::vector<int> wanted;
+      for (int l=(int)levels.size()-1;l>=0;l--) {
+        const Level &level = levels[l];
+        const int end = level.firstTile+level.numTiles.x*level.numTiles.y;
+        for (int tileID=level.firstTile;tileID<end;tileID++) {
+          if (!usage[tileID]) continue;
+          int slot = pld->slots[tileID];
+          if (slot >= 0)
+            pld->lastUsed[slot] = std::max(pld->lastUsed[slot],frameID);
+          else if ((int)wanted.size() < pagesPerFrame)
+            wanted.push_back(tileID);
+        }
+      }
+      if (wanted.empty()) continue;
+
+      // free slots first, then least recently used ones - but never
+      // one that the previous frame still used
+      std::vector<int> victims;
+      for (int slot=0;slot<cacheSize;slot++)
+        if (pld->lastUsed[slot] < frameID)
+          victims.push_back(slot);
+      std::sort(victims.begin(),victims.end(),
+                [&](int a, int b)
+                { return pld->lastUsed[a] < pld->lastUsed[b]; });
+
+      int    *d_slots = (int *)pld->tileSlots->getDD();
+      vec4uc *d_pool  = (vec4uc *)pld->pool->getDD();
+      for (int i=0;i<(int)wanted.size() && i<(int)victims.size();i++) {
+        int tileID  = wanted[i];
+        int slot    = victims[i];
+        int evicted = pld->residentTile[slot];
+        if (evicted >= 0) {
+          pld->slots[evicted] = -1;
+          rtc->copyAsync(d_slots+evicted,&pld->slots[evicted],sizeof(int));
+        }
+        pld->residentTile[slot] = tileID;
+        pld->lastUsed[slot]     = frameID;
+        pld->slots[tileID]      = slot;
+        rtc->copyAsync(d_pool+slot*texelsPerTile,
+                       hostTiles+tileID*texelsPerTile,
+                       bytesPerTile);
+        rtc->copyAsync(d_slots+tileID,&pld->slots[tileID],sizeof(int));
+      }
+    }
+    for (auto device : *devices)
+      device->rtc->sync();
+  }
+
+}
@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/common/Texture.h"
+#include "barney/DeviceGroup.h"
+
+namespace BARNEY_NS {
+
+  /*! virtual texturing for (host-only) 2D rgba8 texture data: the
+      image's mip chain gets split into tiles that live in (pinned)
+      host memory, and every device only keeps a cache of
+      streamTexturesMB worth of them. A sample whose tile isn't
+      resident uses the next coarser level that is - the coarsest
+      level is a single tile that's always resident - and flags the
+      tile it wanted; between frames, servicePageRequests() pages in
+      up to pagesPerFrame of those, evicting the least recently used
+      ones. Same scheme as StructuredData's paged bricks */
+  struct TileStreamer {
+    typedef std::shared_ptr<TileStreamer> SP;
+
+    /*! texels per tile edge, and the same plus a one-texel border
+        on each side, so bilinear filtering never leaves a tile */
+    enum { tileSize = 64, storedTileSize = tileSize+2 };
+
+    struct Level {
+      vec2i dims;
+      vec2i numTiles;
+      /*! index of this level's first tile among all levels' */
+      int   firstTile;
+    };
+
+    struct DD {
+#if RTC_DEVICE_CODE
+      inline __rtc_device vec4f sample(vec2f tc, float lod) const;
+      inline __rtc_device float wrap(float f, int n, int mode) const;
+#endif
+      /*! per tile, its cache slot, or -1 if not resident */
+      const int    *tileSlots;
+      /*! per tile, whether a sample wanted it in this frame */
+      uint8_t      *tileUsage;
+      /*! storedTileSize^2 texels per cache slot */
+      const vec4uc *pool;
+      const Level  *levels;
+      int           numLevels;
+      /*! BNTextureAddressMode, per dimension */
+      uint8_t       wrapModes[2];
+    };
+
+    TileStreamer(Context *context,
+                 const DevGroup::SP &devices,
+                 TextureData::SP data,
+                 const BNTextureAddressMode wrapModes[2]);
+    ~TileStreamer();
+
+    DD getDD(Device *device);
+    /*! pages in (some of) the tiles that samples of the previous
+        frame found missing */
+    void servicePageRequests();
+
+    std::vector<Level> levels;
+    int numTiles      = 0;
+    /*! in tiles, per device */
+    int cacheSize     = 0;
+    int pagesPerFrame = 256;
+    int frameID       = 0;
+    uint8_t wrapModes[2];
+    /*! all levels' tiles, with borders, one after another */
+    vec4uc *hostTiles = 0;
+
+    struct PLD {
+      rtc::Buffer *tileSlots = 0;
+      rtc::Buffer *tileUsage = 0;
+      rtc::Buffer *pool      = 0;
+      rtc::Buffer *levels    = 0;
+      /*! host copy of tileSlots; and per cache slot, the tile in
+          it (or -1), and when it was last used */
+      std::vector<int> slots;
+      std::vector<int> residentTile;
+      std::vector<int> lastUsed;
+    };
+    PLD *getPLD(Device *device);
+    std::vector<PLD> perLogical;
+
+    Context *const context;
+    DevGroup::SP const devices;
+  };
+
+#if RTC_DEVICE_CODE
+  /*! maps texel-space coordinate f into [0,n), the way given
+      address mode does; border gets treated like clamp */
+  inline __rtc_device
+  float TileStreamer::DD::wrap(float f, int n, int mode) const
+  {
+    if (mode == BN_TEXTURE_WRAP)
+      f = f - n*floorf(f/n);
+    else if (mode == BN_TEXTURE_MIRROR) {
+      f = f - 2*n*floorf(f/(2*n));
+      if (f >= n) f = 2*n-f;
+    }
+    return max(0.f,min(f,n-1e-3f));
+  }
+
+  inline __rtc_device
+  vec4f TileStreamer::DD::sample(vec2f tc, float lod) const
+  {
+    int level = max(0,min(int(lod),numLevels-1));
+    for (;level<numLevels;level++) {
+      const Level L = levels[level];
+      float u = wrap(tc.x*L.dims.x,L.dims.x,wrapModes[0]);
+      float v = wrap(tc.y*L.dims.y,L.dims.y,wrapModes[1]);
+      int tx = int(u)/tileSize;
+      int ty = int(v)/tileSize;
+      int tileID = L.firstTile + tx + ty*L.numTiles.x;
+      /* flags it as wanted if it isn't resident, and as used if it
+         is; a racy plain store is fine for that */
+      tileUsage[tileID] = 1;
+      int slot = tileSlots[tileID];
+      if (slot < 0) continue;
+
+      /* position relative to the stored tile, which starts one
+         texel before the tile proper */
+      float fx = u - tx*tileSize + .5f;
+      float fy = v - ty*tileSize + .5f;
+      int ix = int(fx), iy = int(fy);
+      fx -= ix;
+      fy -= iy;
+      const vec4uc *texels
+        = pool + size_t(slot)*(storedTileSize*storedTileSize)
+        + ix + iy*storedTileSize;
+      vec4f v00 = vec4f(texels[0]);
+      vec4f v01 = vec4f(texels[1]);
+      vec4f v10 = vec4f(texels[storedTileSize]);
+      vec4f v11 = vec4f(texels[storedTileSize+1]);
+      vec4f result
+        = (1.f-fy)*((1.f-fx)*v00+fx*v01)
+        + (    fy)*((1.f-fx)*v10+fx*v11);
+      return result * (1.f/255.f);
+    }
+    /* can't happen; the last level is always resident */
+    return vec4f(0.f,0.f,0.f,1.f);
+  }
+#endif
+
+}
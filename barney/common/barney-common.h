@@ -52,6 +52,8 @@
 # endif
 #endif
 
+#include "barney/common/sobol.h"
+
 namespace BARNEY_NS {
   
   using namespace owl::common;
@@ -104,10 +106,31 @@ namespace BARNEY_NS {
     inline __rtc_both Random2(RNGSeed &seed,
                               uint64_t b)
     { this->state = seed.state; seed.next(); this->next(b ? b : 290374); }
+    /*! have the next numDims calls return dimensions firstDim,
+        firstDim+1, ... of the index'th point of an Owen-scrambled
+        Sobol sequence (with per-pixel scramble seed), rather than
+        pseudo-random numbers; any calls after those fall back to the
+        regular pseudo-random sequence */
+    inline __rtc_both void useSobol(uint32_t index, uint32_t scramble,
+                                    int firstDim, int numDims)
+    {
+      sobolIndex = index;
+      sobolScramble = scramble;
+      sobolDim = firstDim;
+      sobolDimsLeft = numDims;
+    }
     inline __rtc_both float operator()()
     {
+      if (sobolDimsLeft > 0) {
+        --sobolDimsLeft;
+        return owenSobol(sobolIndex,sobolDim++,sobolScramble);
+      }
       return (next() & 0x00FFFFFF) * (1.f / (float) 0x01000000);
     };
+    uint32_t sobolIndex    = 0;
+    uint32_t sobolScramble = 0;
+    int      sobolDim      = 0;
+    int      sobolDimsLeft = 0;
   };
 
   
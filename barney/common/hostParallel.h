@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+/*! \file hostParallel.h helpers for the (few) preprocessing steps
+    that run on the host rather than through rtc kernels; these do
+    not depend on tbb, and work the same for all backends */
+#pragma once
+
+#include "barney/common/barney-common.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace BARNEY_NS {
+
+  /*! calls fct(begin,end) for all chunks [begin,end) of (at most)
+      chunkSize items in [0,numItems), from as many host threads as
+      there are cores. Chunks get handed out dynamically, so chunks
+      of uneven cost are fine */
+  template<typename Lambda>
+  inline void hostParallelFor(size_t numItems,
+                              size_t chunkSize,
+                              const Lambda &fct)
+  {
+    chunkSize = std::max(chunkSize,(size_t)1);
+    size_t numChunks = dru(numItems,chunkSize);
+    size_t numThreads
+      = std::min(numChunks,(size_t)std::max(1u,std::thread::hardware_concurrency()));
+    if (numThreads <= 1) {
+      for (size_t begin=0;begin<numItems;begin+=chunkSize)
+        fct(begin,std::min(begin+chunkSize,numItems));
+      return;
+    }
+    std::atomic<size_t> nextChunk { 0 };
+    auto worker = [&]() {
+      while (true) {
+        size_t chunk = nextChunk++;
+        if (chunk >= numChunks) break;
+        size_t begin = chunk*chunkSize;
+        fct(begin,std::min(begin+chunkSize,numItems));
+      }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i=1;i<numThreads;i++)
+      threads.emplace_back(worker);
+    worker();
+    for (auto &t : threads) t.join();
+  }
+
+  /*! sorts given items with given comparison: sorts chunks in
+      parallel, then merges pairs of sorted runs, again in parallel,
+      until only one run is left */
+  template<typename T, typename Less>
+  inline void hostParallelSort(std::vector<T> &items, const Less &less)
+  {
+    const size_t chunkSize = 1<<16;
+    const size_t numItems  = items.size();
+    hostParallelFor(numItems,chunkSize,[&](size_t begin, size_t end){
+      std::sort(items.begin()+begin,items.begin()+end,less);
+    });
+    for (size_t runSize=chunkSize;runSize<numItems;runSize*=2) {
+      size_t numPairs = dru(numItems,2*runSize);
+      hostParallelFor(numPairs,1,[&](size_t pairBegin, size_t pairEnd){
+        for (size_t pair=pairBegin;pair<pairEnd;pair++) {
+          size_t begin = pair*2*runSize;
+          size_t mid   = std::min(begin+runSize,numItems);
+          size_t end   = std::min(begin+2*runSize,numItems);
+          std::inplace_merge(items.begin()+begin,
+                             items.begin()+mid,
+                             items.begin()+end,
+                             less);
+        }
+      });
+    }
+  }
+
+}
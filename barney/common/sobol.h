@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+/* (included from barney-common.h, do not include directly)
+
+   Owen-scrambled Sobol points, after Burley, "Practical Hash-based
+   Owen Scrambling" (JCGT 2020): the first four Sobol dimensions,
+   with both the sample index (shuffling the sequence) and the result
+   (scrambling the points) run through a hash-based nested uniform
+   scramble. Higher dimensions are 'padded' by using another set of
+   scramble seeds for every group of four, so each group is low
+   discrepancy on its own, and uncorrelated with the others */
+
+namespace BARNEY_NS {
+
+  inline __rtc_both uint32_t reverseBits(uint32_t x)
+  {
+    x = ((x & 0xaaaaaaaau) >> 1) | ((x & 0x55555555u) << 1);
+    x = ((x & 0xccccccccu) >> 2) | ((x & 0x33333333u) << 2);
+    x = ((x & 0xf0f0f0f0u) >> 4) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x & 0xff00ff00u) >> 8) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+  }
+
+  /*! Laine-Karras style permutation, in which every bit only depends
+      on the bits below it */
+  inline __rtc_both uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+  {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+  }
+
+  inline __rtc_both uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+  {
+    return reverseBits(laineKarrasPermutation(reverseBits(x),seed));
+  }
+
+  inline __rtc_both uint32_t sobolHashCombine(uint32_t seed, uint32_t v)
+  {
+    return seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+  }
+
+  /*! (unscrambled) dimension dim (0..3) of the index'th Sobol point,
+      as a 0.32 fixed point value */
+  inline __rtc_both uint32_t sobol4(uint32_t index, int dim)
+  {
+    /* Joe-Kuo direction numbers of the first four dimensions */
+    static const uint32_t directions[4][32] = {
+      { 0x80000000u,0x40000000u,0x20000000u,0x10000000u,
+        0x08000000u,0x04000000u,0x02000000u,0x01000000u,
+        0x00800000u,0x00400000u,0x00200000u,0x00100000u,
+        0x00080000u,0x00040000u,0x00020000u,0x00010000u,
+        0x00008000u,0x00004000u,0x00002000u,0x00001000u,
+        0x00000800u,0x00000400u,0x00000200u,0x00000100u,
+        0x00000080u,0x00000040u,0x00000020u,0x00000010u,
+        0x00000008u,0x00000004u,0x00000002u,0x00000001u },
+      { 0x80000000u,0xc0000000u,0xa0000000u,0xf0000000u,
+        0x88000000u,0xcc000000u,0xaa000000u,0xff000000u,
+        0x80800000u,0xc0c00000u,0xa0a00000u,0xf0f00000u,
+        0x88880000u,0xcccc0000u,0xaaaa0000u,0xffff0000u,
+        0x80008000u,0xc000c000u,0xa000a000u,0xf000f000u,
+        0x88008800u,0xcc00cc00u,0xaa00aa00u,0xff00ff00u,
+        0x80808080u,0xc0c0c0c0u,0xa0a0a0a0u,0xf0f0f0f0u,
+        0x88888888u,0xccccccccu,0xaaaaaaaau,0xffffffffu },
+      { 0x80000000u,0xc0000000u,0x60000000u,0x90000000u,
+        0xe8000000u,0x5c000000u,0x8e000000u,0xc5000000u,
+        0x68800000u,0x9cc00000u,0xee600000u,0x55900000u,
+        0x80680000u,0xc09c0000u,0x60ee0000u,0x90550000u,
+        0xe8808000u,0x5cc0c000u,0x8e606000u,0xc5909000u,
+        0x6868e800u,0x9c9c5c00u,0xeeee8e00u,0x5555c500u,
+        0x8000e880u,0xc0005cc0u,0x60008e60u,0x9000c590u,
+        0xe8006868u,0x5c009c9cu,0x8e00eeeeu,0xc5005555u },
+      { 0x80000000u,0xc0000000u,0x20000000u,0x50000000u,
+        0xf8000000u,0x74000000u,0xa2000000u,0x93000000u,
+        0xd8800000u,0x25400000u,0x59e00000u,0xe6d00000u,
+        0x78080000u,0xb40c0000u,0x82020000u,0xc3050000u,
+        0x208f8000u,0x51474000u,0xfbea2000u,0x75d93000u,
+        0xa0858800u,0x914e5400u,0xdbe79e00u,0x25db6d00u,
+        0x58800080u,0xe54000c0u,0x79e00020u,0xb6d00050u,
+        0x800800f8u,0xc00c0074u,0x200200a2u,0x50050093u }
+    };
+    uint32_t x = 0;
+    for (int bit=0;index;index >>= 1, bit++)
+      if (index & 1) x ^= directions[dim][bit];
+    return x;
+  }
+
+  /*! dimension dim (any) of the index'th point of the sequence that
+      given scramble seed picks, in [0,1) */
+  inline __rtc_both float owenSobol(uint32_t index, int dim, uint32_t scramble)
+  {
+    const uint32_t groupSeed = sobolHashCombine(scramble,uint32_t(dim/4));
+    const uint32_t shuffled  = nestedUniformScramble(index,groupSeed);
+    const uint32_t x
+      = nestedUniformScramble(sobol4(shuffled,dim%4),
+                              sobolHashCombine(groupSeed,uint32_t(dim%4)));
+    return (x >> 8) * (1.f / float(1<<24));
+  }
+
+}
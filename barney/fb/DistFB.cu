@@ -4,6 +4,10 @@
 
 #include "barney/fb/DistFB.h"
 #include "barney/MPIContext.h"
+#include "barney/GlobalModel.h"
+#include "barney/Camera.h"
+#include "barney/render/Renderer.h"
+#include "barney/globalTrace/Transport.h"
 #include "rtcore/ComputeInterface.h"
 #include "barney/common/math.h"
 
@@ -50,6 +54,9 @@ namespace BARNEY_NS {
     int iiy = subIdx / tileSize;
     int ix = desc.lower.x + iix;
     int iy = desc.lower.y + iiy;
+    /* display regions: descs are relative to the region, so tiles
+       can start left of or below it */
+    if (ix < 0 || iy < 0) return;
     if (ix >= numPixels.x) return;
     if (iy >= numPixels.y) return;
     int idx = ix + numPixels.x*iy;
@@ -73,7 +80,7 @@ namespace BARNEY_NS {
 
     // and write normal, too, if so required
     if (out_normal && in_normal) {
-      vec3f normal = normalTile.normal[subIdx].get3f();
+      vec3f normal = normalTile.normal[subIdx].get();
       out_normal[idx] = normal;
     }
   }
@@ -104,11 +111,401 @@ namespace BARNEY_NS {
     out_color[tileID].rgba[pixelID]  = make_rgba(color);
     if (out_normal) {
       out_normal[tileID].normal[pixelID]
-        .set(localTiles[tileID].normal[pixelID]);
+        = localTiles[tileID].normal[pixelID];
     }
   }
 #endif
   
+  inline __rtc_device vec4f decompress(const CompressedColorTile &tile,
+                                       int pixelID)
+  {
+    vec4f rgba = from_8bit(tile.rgba[pixelID]);
+    float scale = float(tile.scale[pixelID]);
+    return vec4f(rgba.x*scale,rgba.y*scale,rgba.z*scale,rgba.w);
+  }
+
+  /*! delta gathers: flags every tile that has at least one pixel
+      that differs from what got sent last time by more than
+      'threshold' (8-bit) levels */
+  __rtc_global
+  void _markChangedTiles(const rtc::ComputeInterface &ci,
+                         int                 *changed,
+                         CompressedColorTile *current,
+                         CompressedColorTile *lastSent,
+                         int                  threshold)
+#if !RTC_DEVICE_CODE
+    ;
+#else
+  {
+    int tileID  = ci.getBlockIdx().x;
+    int pixelID = ci.getThreadIdx().x;
+    vec4f diff
+      = decompress(current[tileID],pixelID)
+      - decompress(lastSent[tileID],pixelID);
+    float maxDiff = max(max(fabsf(diff.x),fabsf(diff.y)),
+                        max(fabsf(diff.z),fabsf(diff.w)));
+    if (maxDiff*255.f > threshold)
+      changed[tileID] = 1;
+  }
+#endif
+
+  /*! delta gathers: appends the IDs of all changed tiles (or all
+      tiles, if sendAll is set) to tileIDs; in no particular order */
+  __rtc_global
+  void _compactChangedTiles(const rtc::ComputeInterface &ci,
+                            int *tileIDs,
+                            int *d_count,
+                            int *changed,
+                            int  numTiles,
+                            int  sendAll)
+#if !RTC_DEVICE_CODE
+    ;
+#else
+  {
+    int tileID = ci.getThreadIdx().x + ci.getBlockIdx().x * ci.getBlockDim().x;
+    if (tileID >= numTiles) return;
+    if (!sendAll && !changed[tileID]) return;
+    tileIDs[ci.atomicAdd(d_count,1)] = tileID;
+  }
+#endif
+
+  /*! delta gathers: copies the compressed data of all compacted
+      tiles into the send buffers, and remembers it as last sent */
+  __rtc_global
+  void _copyChangedTiles(const rtc::ComputeInterface &ci,
+                         CompressedColorTile  *out_color,
+                         CompressedNormalTile *out_normal,
+                         CompressedColorTile  *lastSent,
+                         CompressedColorTile  *in_color,
+                         CompressedNormalTile *in_normal,
+                         int *tileIDs,
+                         int *d_count)
+#if !RTC_DEVICE_CODE
+    ;
+#else
+  {
+    int slot    = ci.getBlockIdx().x;
+    int pixelID = ci.getThreadIdx().x;
+    if (slot >= *d_count) return;
+    int tileID = tileIDs[slot];
+    out_color[slot].rgba[pixelID]  = in_color[tileID].rgba[pixelID];
+    out_color[slot].scale[pixelID] = in_color[tileID].scale[pixelID];
+    lastSent[tileID].rgba[pixelID]  = in_color[tileID].rgba[pixelID];
+    lastSent[tileID].scale[pixelID] = in_color[tileID].scale[pixelID];
+    if (out_normal && in_normal)
+      out_normal[slot].normal[pixelID] = in_normal[tileID].normal[pixelID];
+  }
+#endif
+
+  /*! display regions: copies the compressed tiles that go to other
+      ranks' regions into the (rank-grouped) send buffer */
+  __rtc_global
+  void _selectDisplayTiles(const rtc::ComputeInterface &ci,
+                           CompressedColorTile *out_color,
+                           CompressedColorTile *in_color,
+                           int *tileIDs)
+#if !RTC_DEVICE_CODE
+    ;
+#else
+  {
+    int slot    = ci.getBlockIdx().x;
+    int pixelID = ci.getThreadIdx().x;
+    int tileID  = tileIDs[slot];
+    out_color[slot].rgba[pixelID]  = in_color[tileID].rgba[pixelID];
+    out_color[slot].scale[pixelID] = in_color[tileID].scale[pixelID];
+  }
+#endif
+
+  /*! delta gathers, on the owner: copies the tiles that one gpu sent
+      to where they go in the (persistent) gathered tiles */
+  __rtc_global
+  void _scatterChangedTiles(const rtc::ComputeInterface &ci,
+                            CompressedColorTile  *out_color,
+                            CompressedNormalTile *out_normal,
+                            CompressedColorTile  *in_color,
+                            CompressedNormalTile *in_normal,
+                            int *tileIDs)
+#if !RTC_DEVICE_CODE
+    ;
+#else
+  {
+    int slot    = ci.getBlockIdx().x;
+    int pixelID = ci.getThreadIdx().x;
+    int tileID  = tileIDs[slot];
+    out_color[tileID].rgba[pixelID]  = in_color[slot].rgba[pixelID];
+    out_color[tileID].scale[pixelID] = in_color[slot].scale[pixelID];
+    if (out_normal && in_normal)
+      out_normal[tileID].normal[pixelID] = in_normal[slot].normal[pixelID];
+  }
+#endif
+
+  /*! lossless gathers: normalizes a device's accum tiles, so they
+      can get linearized on the owner without knowing accumID */
+  __rtc_global
+  void _normalizeAccumTiles(const rtc::ComputeInterface &ci,
+                            AccumTile *out,
+                            AccumTile *in,
+                            float      accumScale)
+#if !RTC_DEVICE_CODE
+    ;
+#else
+  {
+    int tileID  = ci.getBlockIdx().x;
+    int pixelID = ci.getThreadIdx().x;
+    out[tileID].accum[pixelID]  = vec4f(in[tileID].accum[pixelID])*accumScale;
+    out[tileID].normal[pixelID] = in[tileID].normal[pixelID];
+  }
+#endif
+
+  /*! first tile of the segment of a layer that goes to given device,
+      if tiles get dealt round-robin across numDevices devices */
+  inline __rtc_both int layerSegmentBegin(int numTiles,
+                                          int numDevices,
+                                          int device)
+  {
+    return device*(numTiles/numDevices)+min(device,numTiles%numDevices);
+  }
+
+  /*! copies a device's layer tiles into its send buffer, grouped by
+      the device that owns each tile */
+  __rtc_global
+  void _packLayerTiles(const rtc::ComputeInterface &ci,
+                       LayerTile *out,
+                       AccumTile *accumTiles,
+                       AuxTiles   auxTiles,
+                       int        numTiles,
+                       int        numDevices)
+#if !RTC_DEVICE_CODE
+    ;
+#else
+  {
+    int tileID  = ci.getBlockIdx().x;
+    int pixelID = ci.getThreadIdx().x;
+    if (tileID >= numTiles) return;
+    int owner = tileID % numDevices;
+    LayerTile &lt
+      = out[layerSegmentBegin(numTiles,numDevices,owner)+tileID/numDevices];
+    lt.accum[pixelID]  = accumTiles[tileID].accum[pixelID];
+    lt.normal[pixelID] = accumTiles[tileID].normal[pixelID];
+    lt.depth[pixelID]
+      = auxTiles.depth  ? auxTiles.depth[tileID].f[pixelID]   : BARNEY_INF;
+    lt.primID[pixelID]
+      = auxTiles.primID ? auxTiles.primID[tileID].ui[pixelID] : uint32_t(-1);
+    lt.instID[pixelID]
+      = auxTiles.instID ? auxTiles.instID[tileID].ui[pixelID] : uint32_t(-1);
+    lt.objID[pixelID]
+      = auxTiles.objID  ? auxTiles.objID[tileID].ui[pixelID]  : uint32_t(-1);
+    lt.cost[pixelID]
+      = auxTiles.cost   ? auxTiles.cost[tileID].ui[pixelID]   : 0u;
+  }
+#endif
+
+  /*! blends, for each of this device's own tiles, all devices' layers
+      (which are already in front-to-back order) and the background
+      into the device's accum tiles */
+  __rtc_global
+  void _compositeLayerTiles(const rtc::ComputeInterface &ci,
+                            AccumTile   *accumTiles,
+                            AuxTiles     auxTiles,
+                            TileDesc    *tileDescs,
+                            LayerTile   *layers,
+                            int          numLayers,
+                            int          numTiles,
+                            float        accumScale,
+                            vec2i        fbSize,
+                            render::Renderer::DD renderer)
+#if !RTC_DEVICE_CODE
+    ;
+#else
+  {
+    int tileID  = ci.getBlockIdx().x;
+    int pixelID = ci.getThreadIdx().x;
+    if (tileID >= numTiles) return;
+
+    vec3f    color  = 0.f;
+    float    alpha  = 0.f;
+    vec3f    normal = 0.f;
+    float    depth  = BARNEY_INF;
+    uint32_t primID = uint32_t(-1);
+    uint32_t instID = uint32_t(-1);
+    uint32_t objID  = uint32_t(-1);
+    uint32_t cost   = 0;
+    bool     haveFront = false;
+    for (int layerID=0;layerID<numLayers;layerID++) {
+      const LayerTile &lt = layers[layerID*numTiles+tileID];
+      // every layer's rays count, whether they hit anything or not
+      cost += lt.cost[pixelID];
+      vec4f c = lt.accum[pixelID]*accumScale;
+      if (c.w <= 0.f) continue;
+      if (!haveFront) {
+        haveFront = true;
+        normal = lt.normal[pixelID].get();
+        depth  = lt.depth[pixelID];
+        primID = lt.primID[pixelID];
+        instID = lt.instID[pixelID];
+        objID  = lt.objID[pixelID];
+      }
+      // layers are premultiplied, so this is plain front-to-back 'over'
+      color += (1.f-alpha)*vec3f(c.x,c.y,c.z);
+      alpha += (1.f-alpha)*c.w;
+    }
+
+    // same background that primary rays would have picked up
+    TileDesc desc = tileDescs[tileID];
+    int ix = desc.lower.x + pixelID % tileSize;
+    int iy = desc.lower.y + pixelID / tileSize;
+    const float t = (iy+.5f)/float(fbSize.y);
+    vec4f bgColor
+      = (renderer.bgColor.w >= 0.f)
+      ? renderer.bgColor
+      : ((1.0f - t)*vec4f(0.9f, 0.9f, 0.9f,1.f)
+         + t *      vec4f(0.15f, 0.25f, .8f,1.f));
+    if (renderer.bgTexture) {
+      float bg_u = ((ix+.5f) / float(fbSize.x-1.f));
+      float bg_v = ((iy+.5f) / float(fbSize.y-1.f));
+      bgColor = rtc::tex2D<vec4f>(renderer.bgTexture, bg_u, bg_v);
+    }
+    color += (1.f-alpha)*vec3f(bgColor.x,bgColor.y,bgColor.z);
+    alpha += (1.f-alpha)*bgColor.w;
+
+    // accum tiles store sums over all samples so far
+    accumTiles[tileID].accum[pixelID]  = vec4f(color.x,color.y,color.z,alpha)
+                                       * (1.f/accumScale);
+    accumTiles[tileID].normal[pixelID].set(normal);
+    if (auxTiles.depth)  auxTiles.depth[tileID].f[pixelID]   = depth;
+    if (auxTiles.primID) auxTiles.primID[tileID].ui[pixelID] = primID;
+    if (auxTiles.instID) auxTiles.instID[tileID].ui[pixelID] = instID;
+    if (auxTiles.objID)  auxTiles.objID[tileID].ui[pixelID]  = objID;
+    if (auxTiles.cost)   auxTiles.cost[tileID].ui[pixelID]   = cost;
+  }
+#endif
+
+  /*! front-to-back order of all global devices' domains, as seen
+      from given camera */
+  static std::vector<int> visibilityOrder(const std::vector<box3f> &domains,
+                                          const Camera::DD &camera)
+  {
+    bool  ortho = camera.type == Camera::ORTHOGRAPHIC;
+    vec3f eye
+      = (camera.type == Camera::PERSPECTIVE || camera.type == Camera::STEREO)
+      ? camera.perspective.lens_00
+      : camera.omni.toWorld.p;
+    std::vector<std::pair<vec2f,int>> keys;
+    for (int gid=0;gid<(int)domains.size();gid++) {
+      const box3f &box = domains[gid];
+      vec2f key;
+      if (box.empty())
+        key = vec2f(BARNEY_INF);
+      else if (ortho)
+        key = vec2f(dot(camera.orthographic.dir,box.center()));
+      else {
+        vec3f closest = max(box.lower,min(box.upper,eye));
+        key = vec2f(length(closest-eye),length(box.center()-eye));
+      }
+      keys.push_back({key,gid});
+    }
+    std::sort(keys.begin(),keys.end(),
+              [](const std::pair<vec2f,int> &a, const std::pair<vec2f,int> &b)
+              {
+                if (a.first.x != b.first.x) return a.first.x < b.first.x;
+                if (a.first.y != b.first.y) return a.first.y < b.first.y;
+                return a.second < b.second;
+              });
+    std::vector<int> order;
+    for (auto &key : keys)
+      order.push_back(key.second);
+    return order;
+  }
+
+  void DistFB::compositeLayers(GlobalModel *model,
+                               Camera *camera,
+                               Renderer *renderer)
+  {
+    NvtxRange nvtx("compositeLayers");
+    auto &topo = context->topo;
+    auto &transport = *context->transport;
+    const int numDevices = (int)topo->allDevices.size();
+
+    /* domains are disjoint; since all layers get composited in the
+       same order they don't even have to be convex */
+    std::vector<int> order
+      = visibilityOrder(context->gatherDomainBounds(model),camera->getDD());
+    std::vector<int> slotOf(numDevices);
+    for (int i=0;i<numDevices;i++)
+      slotOf[order[i]] = i;
+
+    int numTiles = 0;
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      TiledFB *layerFB = FrameBuffer::getPLD(device)->layerFB.get();
+      numTiles = layerFB->numActiveTilesThisGPU;
+      if (numTiles == 0) continue;
+      __rtc_launch(device->rtc,
+                   _packLayerTiles,
+                   numTiles,pixelsPerTile,
+                   getPLD(device)->composite.send,
+                   layerFB->accumTiles,
+                   layerFB->auxTiles,
+                   numTiles,numDevices);
+    }
+    for (auto device : *devices)
+      device->rtc->sync();
+
+    auto numTilesOf = [&](int gid)
+    { return numTiles/numDevices + (gid < numTiles%numDevices); };
+    for (auto device : *devices) {
+      auto pld = getPLD(device);
+      int  myGID = device->globalRank();
+      int  numMine = numTilesOf(myGID);
+      if (numMine == 0) continue;
+      for (int src=0;src<numDevices;src++) {
+        LayerTile *recv = pld->composite.recv + slotOf[src]*numMine;
+        if (src == myGID)
+          device->rtc->copyAsync
+            (recv,
+             pld->composite.send+layerSegmentBegin(numTiles,numDevices,myGID),
+             numMine*sizeof(LayerTile));
+        else
+          transport.recv(device,src,recv,numMine*sizeof(LayerTile));
+      }
+    }
+    for (auto device : *devices) {
+      auto pld = getPLD(device);
+      int  myGID = device->globalRank();
+      for (int dst=0;dst<numDevices;dst++) {
+        if (dst == myGID || numTilesOf(dst) == 0) continue;
+        transport.send(device,dst,
+                       pld->composite.send
+                       +layerSegmentBegin(numTiles,numDevices,dst),
+                       numTilesOf(dst)*sizeof(LayerTile));
+      }
+    }
+    transport.flush();
+    for (auto device : *devices)
+      device->rtc->sync();
+
+    float accumScale = getAccumScale();
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      TiledFB *devFB = getFor(device);
+      if (devFB->numActiveTilesThisGPU == 0) continue;
+      __rtc_launch(device->rtc,
+                   _compositeLayerTiles,
+                   devFB->numActiveTilesThisGPU,pixelsPerTile,
+                   devFB->accumTiles,
+                   devFB->auxTiles,
+                   devFB->tileDescs,
+                   getPLD(device)->composite.recv,
+                   numDevices,
+                   devFB->numActiveTilesThisGPU,
+                   accumScale,
+                   devFB->numPixels,
+                   renderer->getDD(device));
+    }
+    for (auto device : *devices)
+      device->rtc->sync();
+  }
+
   /*! read one of the auxiliary (not color or normal) buffers into
     the given (device-writeable) staging area; this will at the
     least incur some reformatting from tiles to linear (if local
@@ -116,6 +513,10 @@ namespace BARNEY_NS {
     one gpu) and possibly some mpi communication (distFB) */
   void DistFB::gatherAuxChannel(BNFrameBufferChannel channel)
   {
+    NvtxRange nvtx("gatherAuxChannel");
+    if (display.active)
+      /* display regions are color only */
+      return;
     // ------------------------------------------------------------------
     // gather all (packed) tiles from all clients
     // ------------------------------------------------------------------
@@ -143,6 +544,9 @@ namespace BARNEY_NS {
       case BN_FB_OBJID:
         aux_recv = gatheredTilesOnOwner.auxChannelTiles.objID;
         break;
+      case BN_FB_COST:
+        aux_recv = gatheredTilesOnOwner.auxChannelTiles.cost;
+        break;
       default:
         throw std::runtime_error("unsupported aux channel in sending aux!?");
       };
@@ -187,6 +591,9 @@ namespace BARNEY_NS {
         case BN_FB_OBJID:
           aux_send = tiledFB->auxTiles.objID;
           break;
+        case BN_FB_COST:
+          aux_send = tiledFB->auxTiles.cost;
+          break;
         default:
           throw std::runtime_error("unsupported aux channel in sending aux!?");
         };
@@ -227,6 +634,7 @@ namespace BARNEY_NS {
     case BN_FB_PRIMID: inTiles = gatheredTilesOnOwner.auxChannelTiles.primID; break;
     case BN_FB_INSTID: inTiles = gatheredTilesOnOwner.auxChannelTiles.instID; break;
     case BN_FB_OBJID:  inTiles = gatheredTilesOnOwner.auxChannelTiles.objID; break;
+    case BN_FB_COST:   inTiles = gatheredTilesOnOwner.auxChannelTiles.cost; break;
     default:
       throw std::runtime_error("writeauxchannel - invalid channel "
                                +std::to_string((int)channel));
@@ -249,6 +657,15 @@ namespace BARNEY_NS {
                                   BNDataType gatherType,
                                   vec3f *linearNormal)
   {
+    NvtxRange nvtx("gatherColorChannel");
+    if (display.active) {
+      gatherDisplayRegions();
+      return;
+    }
+    if (deltaThreshold >= 0 || losslessAfter > 0) {
+      gatherColorChannelWithHeaders(linearColor,gatherType,linearNormal);
+      return;
+    }
     // ------------------------------------------------------------------
     // gather all (packed) tiles from all clients
     // ------------------------------------------------------------------
@@ -299,7 +716,7 @@ namespace BARNEY_NS {
         SetActiveGPU forDuration(device);
         auto tiledFB = getFor(device);
         auto pld = getPLD(device);
-        float accumScale = 1.f/accumID;
+        float accumScale = getAccumScale();
         CompressTiles kernel = {
           pld->localSend.compressedColorTiles,
           pld->localSend.compressedNormalTiles,
@@ -364,6 +781,194 @@ namespace BARNEY_NS {
     }
   }
 
+
+  void DistFB::gatherColorChannelWithHeaders(void *linearColor,
+                                             BNDataType gatherType,
+                                             vec3f *linearNormal)
+  {
+    NvtxRange nvtx("gatherColorChannelWithHeaders");
+    std::vector<MPI_Request> send_requests;
+    if (context->isActiveWorker) {
+      /* only workers know how many samples they have; the owner
+         learns from the headers */
+      const bool lossless = losslessAfter > 0 && accumID >= losslessAfter;
+      float accumScale = getAccumScale();
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        auto tiledFB = getFor(device);
+        auto pld = getPLD(device);
+        int  numTiles = tiledFB->numActiveTilesThisGPU;
+        pld->header = { numTiles, lossless };
+        if (numTiles == 0) continue;
+        if (lossless) {
+          __rtc_launch(device->rtc,
+                       _normalizeAccumTiles,
+                       numTiles,pixelsPerTile,
+                       pld->losslessSend,
+                       tiledFB->accumTiles,
+                       accumScale);
+          continue;
+        }
+        CompressTiles kernel = {
+          pld->localSend.compressedColorTiles,
+          pld->localSend.compressedNormalTiles,
+          tiledFB->accumTiles,
+          accumScale
+        };
+        pld->compressTiles->launch(numTiles,pixelsPerTile,&kernel);
+        if (deltaThreshold < 0) continue;
+
+        auto &delta = pld->delta;
+        device->rtc->memsetAsync(delta.d_count,0,sizeof(int));
+        device->rtc->memsetAsync(delta.changed,0,numTiles*sizeof(int));
+        if (!needFullGather)
+          __rtc_launch(device->rtc,
+                       _markChangedTiles,
+                       numTiles,pixelsPerTile,
+                       delta.changed,
+                       pld->localSend.compressedColorTiles,
+                       delta.lastSent,
+                       deltaThreshold);
+        __rtc_launch(device->rtc,
+                     _compactChangedTiles,
+                     divRoundUp(numTiles,128),128,
+                     delta.tileIDs,
+                     delta.d_count,
+                     delta.changed,
+                     numTiles,
+                     (int)needFullGather);
+        __rtc_launch(device->rtc,
+                     _copyChangedTiles,
+                     numTiles,pixelsPerTile,
+                     delta.color,
+                     delta.normal,
+                     delta.lastSent,
+                     pld->localSend.compressedColorTiles,
+                     pld->localSend.compressedNormalTiles,
+                     delta.tileIDs,
+                     delta.d_count);
+        device->rtc->copyAsync(&pld->header.numTiles,delta.d_count,sizeof(int));
+      }
+      for (auto device : *devices)
+        device->rtc->sync();
+
+      for (auto device : *devices) {
+        auto pld = getPLD(device);
+        const GatherHeader &header = pld->header;
+        int tag = device->contextRank();
+        auto send = [&](auto *tiles) {
+          send_requests.emplace_back();
+          context->world.send(owningRank,tag,tiles,header.numTiles,
+                              send_requests.back());
+        };
+        send_requests.emplace_back();
+        context->world.send(owningRank,tag,&header,1,send_requests.back());
+        if (header.numTiles == 0)
+          continue;
+        if (header.lossless)
+          send(pld->losslessSend);
+        else if (deltaThreshold >= 0) {
+          send(pld->delta.tileIDs);
+          send(pld->delta.color);
+          if (needNormals) send(pld->delta.normal);
+        } else {
+          send(pld->localSend.compressedColorTiles);
+          if (needNormals) send(pld->localSend.compressedNormalTiles);
+        }
+      }
+      /* after a lossless frame the owner's compressed tiles are
+         stale, so the next delta gather has to start over */
+      needFullGather = lossless;
+    }
+
+    if (isOwner) {
+      auto &gathered = gatheredTilesOnOwner;
+      auto &headers  = ownerGather.headers;
+      headers.resize(ownerGather.numGPUs);
+      std::vector<MPI_Request> recv_requests(ownerGather.numGPUs);
+      for (int ggID = 0; ggID < ownerGather.numGPUs; ggID++) {
+        auto thisDev = &context->topo->allDevices[ggID];
+        context->world.recv(thisDev->worldRank,thisDev->local,
+                            &headers[ggID],1,recv_requests[ggID]);
+      }
+      for (auto &req : recv_requests)
+        context->world.wait(req);
+      recv_requests.clear();
+
+      bool lossless = false;
+      for (int ggID = 0; ggID < ownerGather.numGPUs; ggID++) {
+        auto thisDev = &context->topo->allDevices[ggID];
+        const GatherHeader &header = headers[ggID];
+        int first = ownerGather.firstTileOnGPU[ggID];
+        auto recv = [&](auto *tiles) {
+          recv_requests.emplace_back();
+          context->world.recv(thisDev->worldRank,thisDev->local,
+                              tiles+first,header.numTiles,
+                              recv_requests.back());
+        };
+        lossless |= (bool)header.lossless;
+        if (header.numTiles == 0)
+          continue;
+        if (header.lossless)
+          recv(gathered.losslessTiles);
+        else if (deltaThreshold >= 0) {
+          recv(gathered.delta.tileIDs);
+          recv(gathered.delta.color);
+          if (needNormals) recv(gathered.delta.normal);
+        } else {
+          recv(gathered.compressedColorTiles);
+          if (needNormals) recv(gathered.compressedNormalTiles);
+        }
+      }
+      for (auto &req : recv_requests)
+        context->world.wait(req);
+
+      auto device = getDenoiserDevice();
+      SetActiveGPU forDuration(device);
+      if (lossless) {
+        TiledFB::linearizeColorAndNormalTiles(device,
+                                              linearColor,
+                                              gatherType,
+                                              linearNormal,
+                                              1.f,
+                                              gathered.losslessTiles,
+                                              gathered.tileDescs,
+                                              gathered.numActiveTiles,
+                                              numPixels);
+      } else {
+        if (deltaThreshold >= 0)
+          for (int ggID = 0; ggID < ownerGather.numGPUs; ggID++) {
+            int numChanged = headers[ggID].numTiles;
+            int first = ownerGather.firstTileOnGPU[ggID];
+            if (numChanged == 0) continue;
+            __rtc_launch(device->rtc,
+                         _scatterChangedTiles,
+                         numChanged,pixelsPerTile,
+                         gathered.compressedColorTiles+first,
+                         needNormals?gathered.compressedNormalTiles+first:nullptr,
+                         gathered.delta.color+first,
+                         needNormals?gathered.delta.normal+first:nullptr,
+                         gathered.delta.tileIDs+first);
+          }
+        UnpackTiles args = {
+          numPixels,
+          linearColor,
+          gatherType,
+          linearNormal,
+          gathered.compressedColorTiles,
+          gathered.compressedNormalTiles,
+          gathered.tileDescs
+        };
+        getPLD(device)->unpackTiles->launch(gathered.numActiveTiles,
+                                            pixelsPerTile,
+                                            &args);
+      }
+      device->sync();
+    }
+
+    for (auto &req : send_requests)
+      context->world.wait(req);
+  }
   
   DistFB::DistFB(MPIContext *context,
                  const DevGroup::SP &devices)
@@ -391,6 +996,26 @@ namespace BARNEY_NS {
       pld->compressTiles = createCompute_compressTiles(device->rtc);
       pld->unpackTiles = createCompute_unpackTiles(device->rtc);
     }
+
+    if (FromEnv::enabled("composite")) {
+      /* every device has to hold exactly one domain, and every
+         device has to see every domain */
+      auto &topo = context->topo;
+      if (topo->islands.size() == 1 &&
+          topo->isDataParallel() &&
+          topo->islands[0].size() == topo->allDevices.size())
+        sortLast = true;
+      else if (context->myRank() == 0)
+        std::cerr << "#bn.mpi: WARNING - sort-last compositing requested, "
+                  << "but that needs pure data parallel rendering with "
+                  << "one domain per device; ignoring" << std::endl;
+    }
+    /* compositing relies on the round-robin tile split */
+    if (sortLast)
+      balanceTiles = false;
+
+    deltaThreshold = FromEnv::get()->gatherDeltaThreshold;
+    losslessAfter  = FromEnv::get()->losslessGatherAfter;
   }
 
   DistFB::~DistFB()
@@ -426,6 +1051,23 @@ namespace BARNEY_NS {
         device->rtc->freeMem(pld->localSend.compressedNormalTiles);
         pld->localSend.compressedNormalTiles = 0;
       }
+      auto &delta = pld->delta;
+      for (void **mem : { (void**)&delta.lastSent, (void**)&delta.changed,
+                          (void**)&delta.tileIDs, (void**)&delta.color,
+                          (void**)&delta.normal, (void**)&delta.d_count,
+                          (void**)&pld->losslessSend })
+        if (*mem) {
+          device->rtc->freeMem(*mem);
+          *mem = 0;
+        }
+      if (pld->composite.send) {
+        device->rtc->freeMem(pld->composite.send);
+        pld->composite.send = 0;
+      }
+      if (pld->composite.recv) {
+        device->rtc->freeMem(pld->composite.recv);
+        pld->composite.recv = 0;
+      }
     }
     if (isOwner) {
       Device *device = getDenoiserDevice();
@@ -446,6 +1088,10 @@ namespace BARNEY_NS {
         device->rtc->freeMem(gatheredTilesOnOwner.auxChannelTiles.objID);
         gatheredTilesOnOwner.auxChannelTiles.objID = 0;
       }
+      if (gatheredTilesOnOwner.auxChannelTiles.cost) {
+        device->rtc->freeMem(gatheredTilesOnOwner.auxChannelTiles.cost);
+        gatheredTilesOnOwner.auxChannelTiles.cost = 0;
+      }
       if (gatheredTilesOnOwner.tileDescs) {
         device->rtc->freeMem(gatheredTilesOnOwner.tileDescs);
         gatheredTilesOnOwner.tileDescs = 0;
@@ -458,7 +1104,16 @@ namespace BARNEY_NS {
         device->rtc->freeMem(gatheredTilesOnOwner.compressedNormalTiles);
         gatheredTilesOnOwner.compressedNormalTiles = 0;
       }
+      auto &delta = gatheredTilesOnOwner.delta;
+      for (void **mem : { (void**)&delta.tileIDs, (void**)&delta.color,
+                          (void**)&delta.normal,
+                          (void**)&gatheredTilesOnOwner.losslessTiles })
+        if (*mem) {
+          device->rtc->freeMem(*mem);
+          *mem = 0;
+        }
     }
+    freeDisplayData();
   }
 
 
@@ -481,7 +1136,52 @@ namespace BARNEY_NS {
     } else {
       context->world.bc_recv(&this->needNormals,sizeof(this->needNormals));
     }
-    
+    exchangeTileLayout();
+  }
+
+  void DistFB::broadcastActiveChannels(uint32_t &active)
+  {
+    if (isOwner)
+      context->world.bc_send(&active,sizeof(active));
+    else
+      context->world.bc_recv(&active,sizeof(active));
+  }
+
+  bool DistFB::accumulationRestarts()
+  {
+    /* only workers ever accumulate; and if any of them restarts, they
+       all will (see MPIContext::render) */
+    int restarts = context->isActiveWorker && accumID == 0;
+    return context->world.allReduceMax(restarts) != 0;
+  }
+
+  float DistFB::reduceRenderTime(float time)
+  {
+    /* passive ranks don't render, so contribute zero */
+    return context->world.allReduceMax(context->isActiveWorker ? time : 0.f);
+  }
+
+  void DistFB::reduceTileCosts(std::vector<float> &costOfTile)
+  {
+    BN_MPI_CALL(Allreduce(MPI_IN_PLACE,costOfTile.data(),(int)costOfTile.size(),
+                          MPI_FLOAT,MPI_SUM,context->world.comm));
+  }
+
+  void DistFB::reduceDeviceWeights(std::vector<float> &weights)
+  {
+    BN_MPI_CALL(Allreduce(MPI_IN_PLACE,weights.data(),(int)weights.size(),
+                          MPI_FLOAT,MPI_SUM,context->world.comm));
+  }
+
+  void DistFB::tileAssignmentChanged()
+  {
+    freeChannelData();
+    exchangeTileLayout();
+  }
+
+  void DistFB::exchangeTileLayout()
+  {
+    MemoryScope memScope(devices.get(),BN_MEMORY_FRAME_BUFFERS);
     // ------------------------------------------------------------------
     /* allocate compressed tiles mem - one for each tiles in the
        corresponding tiledFB */
@@ -502,8 +1202,41 @@ namespace BARNEY_NS {
         pld->localSend.compressedNormalTiles
           = (CompressedNormalTile*)device->rtc->allocMem
           (tiledFB->numActiveTilesThisGPU*sizeof(CompressedNormalTile));
+      if (deltaThreshold >= 0) {
+        int numTiles = tiledFB->numActiveTilesThisGPU;
+        auto &delta = pld->delta;
+        delta.lastSent
+          = (CompressedColorTile*)device->rtc->allocMem
+          (numTiles*sizeof(CompressedColorTile));
+        delta.color
+          = (CompressedColorTile*)device->rtc->allocMem
+          (numTiles*sizeof(CompressedColorTile));
+        if (needNormals)
+          delta.normal
+            = (CompressedNormalTile*)device->rtc->allocMem
+            (numTiles*sizeof(CompressedNormalTile));
+        delta.changed = (int*)device->rtc->allocMem(numTiles*sizeof(int));
+        delta.tileIDs = (int*)device->rtc->allocMem(numTiles*sizeof(int));
+        delta.d_count = (int*)device->rtc->allocMem(sizeof(int));
+      }
+      if (losslessAfter > 0)
+        pld->losslessSend
+          = (AccumTile*)device->rtc->allocMem
+          (tiledFB->numActiveTilesThisGPU*sizeof(AccumTile));
+      if (sortLast) {
+        int numLayerTiles
+          = FrameBuffer::getPLD(device)->layerFB->numActiveTilesThisGPU;
+        pld->composite.send
+          = (LayerTile*)device->rtc->allocMem(numLayerTiles*sizeof(LayerTile));
+        pld->composite.recv
+          = (LayerTile*)device->rtc->allocMem
+          (device->globalSize()*tiledFB->numActiveTilesThisGPU*sizeof(LayerTile));
+      }
     }
     
+    /* whatever the owner had is no longer valid */
+    needFullGather = true;
+
     std::vector<MPI_Request> recv_requests(ownerGather.numGPUs);
     std::vector<MPI_Request> send_requests(tilesOnGPU.size());
     
@@ -574,6 +1307,22 @@ namespace BARNEY_NS {
           = (CompressedNormalTile *)frontDev->rtc->allocMem
           (sumTiles*sizeof(*gatheredTilesOnOwner.compressedNormalTiles));
 
+      if (deltaThreshold >= 0) {
+        auto &delta = gatheredTilesOnOwner.delta;
+        delta.tileIDs
+          = (int *)frontDev->rtc->allocMem(sumTiles*sizeof(int));
+        delta.color
+          = (CompressedColorTile *)frontDev->rtc->allocMem
+          (sumTiles*sizeof(CompressedColorTile));
+        if (denoiser)
+          delta.normal
+            = (CompressedNormalTile *)frontDev->rtc->allocMem
+            (sumTiles*sizeof(CompressedNormalTile));
+      }
+      if (losslessAfter > 0)
+        gatheredTilesOnOwner.losslessTiles
+          = (AccumTile *)frontDev->rtc->allocMem(sumTiles*sizeof(AccumTile));
+
       if (channels & BN_FB_DEPTH)
         gatheredTilesOnOwner.auxChannelTiles.depth
           = (AuxChannelTile*)frontDev->rtc->allocMem(sumTiles*sizeof(AuxChannelTile));
@@ -586,6 +1335,9 @@ namespace BARNEY_NS {
       if (channels & BN_FB_OBJID)
         gatheredTilesOnOwner.auxChannelTiles.objID
           = (AuxChannelTile*)frontDev->rtc->allocMem(sumTiles*sizeof(AuxChannelTile));
+      if (channels & BN_FB_COST)
+        gatheredTilesOnOwner.auxChannelTiles.cost
+          = (AuxChannelTile*)frontDev->rtc->allocMem(sumTiles*sizeof(AuxChannelTile));
 
       gatheredTilesOnOwner.tileDescs
         = (TileDesc *)frontDev->rtc->allocMem
@@ -631,6 +1383,309 @@ namespace BARNEY_NS {
     if (context->isActiveWorker)
       for (int localID=0;localID<tilesOnGPU.size();localID++)
         context->world.wait(send_requests[localID]);
+
+    exchangeDisplayLayout();
+  }
+
+  bool DistFB::set4i(const std::string &member, const vec4i &value)
+  {
+    if (FrameBuffer::set4i(member,value))
+      return true;
+    if (member == "displayRegion") {
+      display.region = value;
+      return true;
+    }
+    return false;
+  }
+
+  void DistFB::freeDisplayData()
+  {
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      auto &send = getPLD(device)->displaySend;
+      if (send.tileIDs) {
+        device->rtc->freeMem(send.tileIDs);
+        send.tileIDs = 0;
+      }
+      if (send.tiles) {
+        device->rtc->freeMem(send.tiles);
+        send.tiles = 0;
+      }
+      send.begin.clear();
+      send.count.clear();
+      send.descs.clear();
+    }
+    Device *device = getDenoiserDevice();
+    SetActiveGPU forDuration(device);
+    for (void **mem : { (void**)&display.tiles, (void**)&display.tileDescs,
+                        (void**)&display.color })
+      if (*mem) {
+        device->rtc->freeMem(*mem);
+        *mem = 0;
+      }
+    display.numTiles = 0;
+    display.active   = false;
+  }
+
+  void DistFB::exchangeDisplayLayout()
+  {
+    const int numRanks = context->world.size;
+    const int myRank   = context->world.rank;
+    display.regions.resize(numRanks);
+    context->world.allGather(display.regions.data(),&display.region,
+                             1,sizeof(vec4i));
+    bool anyRegion = false;
+    for (auto &r : display.regions) {
+      r = vec4i(std::max(r.x,0),std::max(r.y,0),
+                std::min(r.z,numPixels.x),std::min(r.w,numPixels.y));
+      if (r.z <= r.x || r.w <= r.y)
+        r = vec4i(0);
+      else
+        anyRegion = true;
+    }
+    if (!anyRegion)
+      return;
+    if (renderPixels != numPixels) {
+      if (myRank == 0)
+        std::cerr << "#bn.mpi: WARNING - display regions need rendering at "
+                  << "full resolution; gathering on rank 0 instead"
+                  << std::endl;
+      return;
+    }
+    display.active = true;
+    MemoryScope memScope(devices.get(),BN_MEMORY_FRAME_BUFFERS);
+
+    auto isEmpty = [](const vec4i &r) { return r.z <= r.x; };
+    auto overlaps = [](const vec4i &r, vec2i lower) {
+      return lower.x < r.z && lower.x+tileSize > r.x
+        &&   lower.y < r.w && lower.y+tileSize > r.y;
+    };
+
+    // ------------------------------------------------------------------
+    // sending side: sort this rank's tiles by the regions they go to
+    // ------------------------------------------------------------------
+    if (context->isActiveWorker)
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        TiledFB *tiledFB = getFor(device);
+        auto &send = getPLD(device)->displaySend;
+        std::vector<int> tileIDs = tiledFB->getTileIDs();
+        std::vector<int> sendIDs;
+        send.begin = { 0 };
+        send.count.clear();
+        send.descs.clear();
+        for (int r=0;r<numRanks;r++) {
+          const vec4i region = display.regions[r];
+          if (!isEmpty(region))
+            for (int i=0;i<tiledFB->numActiveTilesThisGPU;i++) {
+              int tileID = tileIDs[i];
+              vec2i lower((tileID % tiledFB->numTiles.x)*tileSize,
+                          (tileID / tiledFB->numTiles.x)*tileSize);
+              if (!overlaps(region,lower)) continue;
+              sendIDs.push_back(i);
+              send.descs.push_back({lower});
+            }
+          send.begin.push_back((int)sendIDs.size());
+          send.count.push_back(send.begin[r+1]-send.begin[r]);
+        }
+        if (sendIDs.empty()) continue;
+        send.tileIDs
+          = (int*)device->rtc->allocMem(sendIDs.size()*sizeof(int));
+        send.tiles
+          = (CompressedColorTile*)device->rtc->allocMem
+          (sendIDs.size()*sizeof(CompressedColorTile));
+        device->rtc->copy(send.tileIDs,sendIDs.data(),
+                          sendIDs.size()*sizeof(int));
+      }
+
+    // ------------------------------------------------------------------
+    // tell every rank with a region how many tiles each gpu sends it,
+    // then which ones
+    // ------------------------------------------------------------------
+    const int numGPUs = (int)context->topo->allDevices.size();
+    const vec4i myRegion = display.regions[myRank];
+    display.numTilesFromGPU.assign(numGPUs,0);
+    display.firstTileFromGPU.assign(numGPUs,0);
+    std::vector<MPI_Request> recv_requests;
+    std::vector<MPI_Request> send_requests;
+    auto waitAll = [&]() {
+      for (auto &req : recv_requests) context->world.wait(req);
+      for (auto &req : send_requests) context->world.wait(req);
+      recv_requests.clear();
+      send_requests.clear();
+    };
+    if (!isEmpty(myRegion))
+      for (int ggID = 0; ggID < numGPUs; ggID++) {
+        auto thisDev = &context->topo->allDevices[ggID];
+        recv_requests.emplace_back();
+        context->world.recv(thisDev->worldRank,thisDev->local,
+                            &display.numTilesFromGPU[ggID],1,
+                            recv_requests.back());
+      }
+    if (context->isActiveWorker)
+      for (auto device : *devices) {
+        auto &send = getPLD(device)->displaySend;
+        for (int r=0;r<numRanks;r++) {
+          if (isEmpty(display.regions[r])) continue;
+          send_requests.emplace_back();
+          context->world.send(r,device->contextRank(),
+                              &send.count[r],1,send_requests.back());
+        }
+      }
+    waitAll();
+
+    for (int ggID = 0; ggID < numGPUs; ggID++) {
+      display.firstTileFromGPU[ggID] = display.numTiles;
+      display.numTiles += display.numTilesFromGPU[ggID];
+    }
+    std::vector<TileDesc> descs(display.numTiles);
+    for (int ggID = 0; ggID < numGPUs; ggID++) {
+      if (display.numTilesFromGPU[ggID] == 0) continue;
+      auto thisDev = &context->topo->allDevices[ggID];
+      recv_requests.emplace_back();
+      context->world.recv(thisDev->worldRank,thisDev->local,
+                          descs.data()+display.firstTileFromGPU[ggID],
+                          display.numTilesFromGPU[ggID],
+                          recv_requests.back());
+    }
+    if (context->isActiveWorker)
+      for (auto device : *devices) {
+        auto &send = getPLD(device)->displaySend;
+        for (int r=0;r<numRanks;r++) {
+          if (send.count[r] == 0) continue;
+          send_requests.emplace_back();
+          context->world.send(r,device->contextRank(),
+                              send.descs.data()+send.begin[r],
+                              send.count[r],send_requests.back());
+        }
+      }
+    waitAll();
+
+    // ------------------------------------------------------------------
+    // receiving side: our region's tiles, and its linear color
+    // ------------------------------------------------------------------
+    if (isEmpty(myRegion))
+      return;
+    for (auto &desc : descs)
+      desc.lower = desc.lower - vec2i(myRegion.x,myRegion.y);
+    Device *frontDev = getDenoiserDevice();
+    SetActiveGPU forDuration(frontDev);
+    display.tiles
+      = (CompressedColorTile*)frontDev->rtc->allocMem
+      (display.numTiles*sizeof(CompressedColorTile));
+    display.tileDescs
+      = (TileDesc*)frontDev->rtc->allocMem(display.numTiles*sizeof(TileDesc));
+    frontDev->rtc->copy(display.tileDescs,descs.data(),
+                        display.numTiles*sizeof(TileDesc));
+    const size_t sizeOfPixel
+      = (colorChannelFormat == BN_FLOAT4) ? sizeof(vec4f) : sizeof(uint32_t);
+    display.color
+      = frontDev->rtc->allocMem(size_t(myRegion.z-myRegion.x)
+                                *(myRegion.w-myRegion.y)*sizeOfPixel);
+  }
+
+  void DistFB::gatherDisplayRegions()
+  {
+    NvtxRange nvtx("gatherDisplayRegions");
+    const int   numRanks = context->world.size;
+    const vec4i myRegion = display.regions[context->world.rank];
+    std::vector<MPI_Request> recv_requests;
+    std::vector<MPI_Request> send_requests;
+
+    for (int ggID = 0; ggID < (int)display.numTilesFromGPU.size(); ggID++) {
+      if (display.numTilesFromGPU[ggID] == 0) continue;
+      auto thisDev = &context->topo->allDevices[ggID];
+      recv_requests.emplace_back();
+      context->world.recv(thisDev->worldRank,thisDev->local,
+                          display.tiles+display.firstTileFromGPU[ggID],
+                          display.numTilesFromGPU[ggID],
+                          recv_requests.back());
+    }
+
+    if (context->isActiveWorker) {
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        auto tiledFB = getFor(device);
+        auto pld = getPLD(device);
+        if (!pld->displaySend.tiles) continue;
+        CompressTiles kernel = {
+          pld->localSend.compressedColorTiles,
+          nullptr,
+          tiledFB->accumTiles,
+          getAccumScale()
+        };
+        pld->compressTiles->launch(tiledFB->numActiveTilesThisGPU,
+                                   pixelsPerTile,&kernel);
+        __rtc_launch(device->rtc,
+                     _selectDisplayTiles,
+                     pld->displaySend.begin.back(),pixelsPerTile,
+                     pld->displaySend.tiles,
+                     pld->localSend.compressedColorTiles,
+                     pld->displaySend.tileIDs);
+      }
+      for (auto device : *devices) {
+        auto &send = getPLD(device)->displaySend;
+        if (!send.tiles) continue;
+        device->sync();
+        for (int r=0;r<numRanks;r++) {
+          if (send.count[r] == 0) continue;
+          send_requests.emplace_back();
+          context->world.send(r,device->contextRank(),
+                              send.tiles+send.begin[r],send.count[r],
+                              send_requests.back());
+        }
+      }
+    }
+    for (auto &req : recv_requests) context->world.wait(req);
+    for (auto &req : send_requests) context->world.wait(req);
+
+    if (display.numTiles == 0)
+      return;
+    UnpackTiles args = {
+      vec2i(myRegion.z-myRegion.x,myRegion.w-myRegion.y),
+      display.color,
+      colorChannelFormat,
+      nullptr,
+      display.tiles,
+      nullptr,
+      display.tileDescs
+    };
+    auto device = getDenoiserDevice();
+    SetActiveGPU forDuration(device);
+    getPLD(device)->unpackTiles->launch(display.numTiles,pixelsPerTile,&args);
+    device->sync();
+  }
+
+  bool DistFB::readDisplayRegion(BNFrameBufferChannel channel,
+                                 void *appMemory,
+                                 BNDataType requestedFormat)
+  {
+    if (!display.active)
+      return false;
+    const vec4i myRegion = display.regions[context->world.rank];
+    const size_t numPixels
+      = size_t(myRegion.z-myRegion.x)*(myRegion.w-myRegion.y);
+    if (numPixels == 0)
+      return true;
+    Device *device = getDenoiserDevice();
+    SetActiveGPU forDuration(device);
+    if (channel == BN_FB_COLOR) {
+      assert(requestedFormat == colorChannelFormat);
+      const size_t sizeOfPixel
+        = (requestedFormat == BN_FLOAT4) ? sizeof(vec4f) : sizeof(uint32_t);
+      device->rtc->copy(appMemory,display.color,numPixels*sizeOfPixel);
+      return true;
+    }
+    /* no aux channels with display regions; report them empty */
+    float    noDepth = BARNEY_INF;
+    uint32_t empty
+      = (channel == BN_FB_DEPTH) ? (const uint32_t &)noDepth
+      : (channel == BN_FB_COST)  ? 0u
+      : uint32_t(-1);
+    std::vector<uint32_t> emptyChannel(numPixels,empty);
+    device->rtc->copy(appMemory,emptyChannel.data(),
+                      emptyChannel.size()*sizeof(uint32_t));
+    return true;
   }
   
   RTC_EXPORT_COMPUTE1D(unpackTiles,UnpackTiles);
@@ -11,33 +11,9 @@ namespace BARNEY_NS {
 
   struct MPIContext;
 
-  /*! for now, do a 48 bit half3 representation; shoul eventually go
-      to 32 or 16, but lets at least try how much this really helps in
-      the denoiser */
-  struct CompressedNormal {
-    inline __both__ vec4f get4f() const
-    { vec3f v = get(); return vec4f(v.x,v.y,v.z,0.f); }
-    inline __both__ vec3f get3f() const
-    { vec3f v = get(); return vec3f(v.x,v.y,v.z); }
-    inline __both__ void set(vec3f v) {
-      if (v == vec3f(0.f)) { x = y = z = 0; return; }
-      v = normalize(v);
-      x = encode(v.x);
-      y = encode(v.y);
-      z = encode(v.z);
-    }
-    inline __both__ vec3f get() const { return vec3f(decode(x),decode(y),decode(z)); }
-  private:
-    inline __both__ int8_t encode(float f) const {
-      f = clamp(f*128.f,-127.f,+127.f);
-      return int8_t(f);
-    }
-    inline __both__ float decode(int8_t i) const {
-      if (i==0) return 0.f;
-      return (i<0) ? (i-.5f)*(1.f/128.f) : (i+.5f)*(1.f/128.f);
-    }
-    int8_t x,y,z;
-  };
+  /*! normals go over the wire in the same (octahedral, 32-bit)
+      form the accum tiles store them in */
+  typedef OctNormal CompressedNormal;
   
   struct CompressedColorTile {
     /*! rgb are ufixed8 and need to be multiplied by scale, a is
@@ -50,6 +26,26 @@ namespace BARNEY_NS {
     CompressedNormal normal[pixelsPerTile];
   };
   
+  /*! one tile of one device's sort-last layer, with everything that
+      compositing needs, in the form it goes over the wire */
+  struct LayerTile {
+    vec4f     accum[pixelsPerTile];
+    OctNormal normal[pixelsPerTile];
+    float     depth[pixelsPerTile];
+    uint32_t primID[pixelsPerTile];
+    uint32_t instID[pixelsPerTile];
+    uint32_t objID[pixelsPerTile];
+    uint32_t cost[pixelsPerTile];
+  };
+  
+  /*! what a device tells the owner ahead of its tiles, if delta or
+      lossless gathers are enabled: how many tiles follow, and in
+      which form */
+  struct GatherHeader {
+    int numTiles;
+    int lossless;
+  };
+
   struct DistFB : public FrameBuffer {
     typedef std::shared_ptr<DistFB> SP;
 
@@ -65,8 +61,43 @@ namespace BARNEY_NS {
         CompressedColorTile  *compressedColorTiles = 0;
         CompressedNormalTile *compressedNormalTiles = 0;
       } localSend;
+      /*! delta gathers only: the compressed tiles as the owner has
+          them now, and the compacted list (and compressed data) of
+          those tiles that changed by more than the threshold */
+      struct {
+        CompressedColorTile  *lastSent = 0;
+        int                  *changed  = 0;
+        int                  *tileIDs  = 0;
+        CompressedColorTile  *color    = 0;
+        CompressedNormalTile *normal   = 0;
+        int                  *d_count  = 0;
+      } delta;
+      /*! lossless gathers only: this device's tiles, normalized but
+          at full precision */
+      AccumTile            *losslessSend = 0;
+      GatherHeader          header;
       rtc::ComputeKernel1D *compressTiles = 0;
       rtc::ComputeKernel1D *unpackTiles = 0;
+      /*! sort-last compositing only: 'send' has all tiles of this
+          device's layer, grouped by the device that owns them;
+          'recv' has, for each of this device's own tiles, the
+          matching layer tile of every device (in global device
+          order) */
+      struct {
+        LayerTile *send = 0;
+        LayerTile *recv = 0;
+      } composite;
+      /*! display regions only: indices of those of this device's
+          (compressed) tiles that overlap any rank's region, grouped
+          by rank - those of rank r being begin[r]..begin[r+1] - and
+          the compressed tiles themselves, in the same order */
+      struct {
+        int                 *tileIDs = 0;
+        CompressedColorTile *tiles   = 0;
+        std::vector<int>      begin;
+        std::vector<int>      count;
+        std::vector<TileDesc> descs;
+      } displaySend;
     };
     PLD *getPLD(Device *device);
     std::vector<PLD> perLogical;
@@ -88,6 +119,14 @@ namespace BARNEY_NS {
     void gatherColorChannel(/*float4 or rgba8*/void *linearColor,
                             BNDataType gatherType,
                             vec3f *linearNormal) override;
+
+    /*! gatherColorChannel() for when delta and/or lossless gathers
+        are enabled: every device first sends a GatherHeader, then
+        either only its changed tiles (plus their tile IDs), or all
+        of its tiles at full precision */
+    void gatherColorChannelWithHeaders(void *linearColor,
+                                       BNDataType gatherType,
+                                       vec3f *linearNormal);
       
     /*! read one of the auxiliary (not color or normal) buffers into
       the given (device-writeable) staging area; this will at the
@@ -95,11 +134,45 @@ namespace BARNEY_NS {
       node), possibly some gpu-gpu transfer (local node w/ more than
       one gpu) and possibly some mpi communication (distFB) */
     void gatherAuxChannel(BNFrameBufferChannel channel) override;
+
+    /*! direct-send compositing: every device sends each of its layer
+        tiles to the device that owns that tile, which then blends all
+        devices' layers in visibility order (and adds the background)
+        into its actual tiles */
+    void compositeLayers(GlobalModel *model,
+                         Camera *camera,
+                         Renderer *renderer) override;
     void writeAuxChannel(void *stagingArea,
                          BNFrameBufferChannel channel) override;
 
     /*! allocated whatever temporary tile memory we may have allocated */
     void freeChannelData();
+
+    /*! (re-)allocates the per-gpu send buffers and the owner's
+        receive buffers for the current tile layout, and tells the
+        owner which gpu has how many - and which - tiles. Has to be
+        called on all ranks */
+    void exchangeTileLayout();
+
+    /*! display regions: tells every rank whose region overlaps
+        which of this rank's tiles, and (re-)allocates the send and
+        receive buffers for those. Has to be called on all ranks */
+    void exchangeDisplayLayout();
+    /*! display regions: routes every tile to the ranks whose region
+        it overlaps, and linearizes into this rank's region */
+    void gatherDisplayRegions();
+    bool readDisplayRegion(BNFrameBufferChannel channel,
+                           void *appMemory,
+                           BNDataType requestedFormat) override;
+    void freeDisplayData();
+    bool set4i(const std::string &member, const vec4i &value) override;
+
+    bool accumulationRestarts() override;
+    float reduceRenderTime(float time) override;
+    void broadcastActiveChannels(uint32_t &active) override;
+    void reduceTileCosts(std::vector<float> &costOfTile) override;
+    void reduceDeviceWeights(std::vector<float> &weights) override;
+    void tileAssignmentChanged() override;
     
     /*! @{ _receive_ staging area for gathering tiles from all
         clients; for every tile that any client sends, this has a
@@ -112,14 +185,60 @@ namespace BARNEY_NS {
       AuxTiles              auxChannelTiles;
       TileDesc             *tileDescs         = 0;
       int                   numActiveTiles    = 0;
+      /*! delta gathers only: where changed tiles get received into,
+          before they get scattered into the compressed tiles */
+      struct {
+        int                  *tileIDs = 0;
+        CompressedColorTile  *color   = 0;
+        CompressedNormalTile *normal  = 0;
+      } delta;
+      /*! lossless gathers only */
+      AccumTile            *losslessTiles     = 0;
     } gatheredTilesOnOwner;
     /*! @} */
 
     struct {
       std::vector<int> numTilesOnGPU;
       std::vector<int> firstTileOnGPU;
+      std::vector<GatherHeader> headers;
       int numGPUs;
     } ownerGather;
+    /*! tiles whose 8-bit colors changed by no more than this many
+        levels since the last gather don't get re-sent
+        (BARNEY_CONFIG=gatherDeltaThreshold=N); -1 = off */
+    int  deltaThreshold = -1;
+    /*! gather full-precision tiles once this many samples got
+        accumulated (BARNEY_CONFIG=losslessGatherAfter=N); 0 = off */
+    int  losslessAfter  = 0;
+    /*! set whenever the owner's compressed tiles are no longer what
+        the workers last sent (new tile layout, or lossless frame in
+        between), so the next delta gather has to send everything */
+    bool needFullGather = true;
+    /*! display-wall output (set4i("displayRegion") on each rank,
+        as lower x,y and upper - exclusive - x,y in pixels; takes
+        effect with the next resize): if any rank has a region, color
+        tiles don't get gathered on the owner, but sent straight from
+        the gpus that rendered them to every rank whose region they
+        overlap, and read() on each rank returns just that region.
+        Tile assignment for rendering stays as is; tiles that
+        straddle two regions get sent to both. Not with denoising,
+        upscaling, or render scales below 1, and only for color */
+    struct {
+      vec4i region = vec4i(0);
+      /*! regions of all ranks, clipped to the frame, as of the last
+          exchangeDisplayLayout() */
+      std::vector<vec4i> regions;
+      bool  active = false;
+      /*! receive side: tiles from all gpus that overlap our region,
+          with their descs relative to the region's lower corner */
+      CompressedColorTile *tiles     = 0;
+      TileDesc            *tileDescs = 0;
+      std::vector<int>     numTilesFromGPU;
+      std::vector<int>     firstTileFromGPU;
+      int                  numTiles  = 0;
+      /*! our region, linear, in colorChannelFormat */
+      void                *color     = 0;
+    } display;
     // (world)rank that owns this frame buffer
     const int  owningRank = 0;
     const bool isOwner;
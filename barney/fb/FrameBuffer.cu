@@ -6,6 +6,9 @@
 #include "barney/common/math.h"
 #include "barney/common/Data.h"
 #include "barney/fb/FrameBuffer.h"
+#include "barney/fb/JpegEncoder.h"
+#include "barney/fb/FrameWriter.h"
+#include "barney/common/DeviceCounters.h"
 #if BARNEY_HAVE_OIDN
 # include <OpenImageDenoise/oidn.h>
 #endif
@@ -35,21 +38,181 @@ namespace BARNEY_NS {
     Device *device = getDenoiserDevice();
     assert(device);
     denoiser = device->rtc->createDenoiser();
+    parallelDenoise
+      = denoiser
+      && FromEnv::enabled("parallelDenoise")
+      && devices->size() > 1
+      && context->havePeerAccess;
     linear_toFixed8 = createCompute_linearToFixed8(device->rtc);
+
+    if (FromEnv::enabled("profile"))
+      profiler = new FrameProfiler(devices);
+    balanceTiles = FromEnv::enabled("balanceTiles");
   }
 
   FrameBuffer::~FrameBuffer()
   {
+    /* finishes all queued writes first */
+    delete writer;
+    writer = 0;
+    setColorTarget(-1,0);
     freeResources();
+    freeDenoiseStrips();
+    for (auto device : *devices) {
+      auto pld = getPLD(device);
+      if (pld->viewCameras)
+        device->rtc->freeBuffer(pld->viewCameras);
+      pld->viewCameras = 0;
+    }
     delete denoiser;
     denoiser = 0;
     delete linear_toFixed8;
     linear_toFixed8 = 0;
+    delete profiler;
+    profiler = 0;
+  }
+
+  bool FrameBuffer::getStats(BNFrameStats &stats)
+  {
+    if (!profiler) return false;
+    profiler->getStats(stats);
+    return true;
+  }
+
+  bool FrameBuffer::getCounters(BNDeviceCounters &result)
+  {
+#if BARNEY_DEVICE_COUNTERS
+    const int maxGens = BN_FRAME_STATS_MAX_GENERATIONS;
+    const int numCounters = DeviceCounters::NUM_COUNTERS;
+    std::vector<uint64_t> sum(maxGens*numCounters,0);
+    std::vector<uint64_t> hostCounters(maxGens*numCounters);
+    for (auto device : *devices) {
+      if (!device->counters) continue;
+      SetActiveGPU forDuration(device);
+      device->rtc->copy(hostCounters.data(),device->counters->getDD(),
+                        hostCounters.size()*sizeof(uint64_t));
+      for (size_t i=0;i<sum.size();i++)
+        sum[i] += hostCounters[i];
+    }
+    /* BNDeviceCounterValues has one field per counter, in enum order */
+    memset(&result,0,sizeof(result));
+    uint64_t *total = (uint64_t *)&result.total;
+    for (int gen=0;gen<maxGens;gen++) {
+      uint64_t *perGen = (uint64_t *)&result.perGeneration[gen];
+      for (int i=0;i<numCounters;i++) {
+        perGen[i] = sum[gen*numCounters+i];
+        total[i] += perGen[i];
+      }
+      if (perGen[DeviceCounters::RAYS_TRACED] ||
+          perGen[DeviceCounters::RAYS_GENERATED])
+        result.numGenerations = gen+1;
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void FrameBuffer::setColorTarget(int fd, size_t numBytes)
+  {
+    if (!isOwner) return;
+    Device *device = getDenoiserDevice();
+    if (colorTarget.ptr) {
+      device->rtc->freeExternalMemory(colorTarget.ptr);
+      colorTarget.ptr = 0;
+      colorTarget.numBytes = 0;
+    }
+    if (fd < 0) return;
+    colorTarget.ptr = device->rtc->importExternalMemory(fd,numBytes);
+    colorTarget.numBytes = numBytes;
+  }
+
+  size_t FrameBuffer::getEncodedSize()
+  {
+    return jpegEncoder ? jpegEncoder->bitstream.size() : 0;
+  }
+
+  uint32_t FrameBuffer::internalChannels() const
+  {
+    return temporalReprojection
+      ? (BN_FB_DEPTH|BN_FB_PRIMID|BN_FB_INSTID)
+      : 0;
   }
 
   bool FrameBuffer::needHitIDs() const
   {
-    return channels & (BN_FB_PRIMID|BN_FB_INSTID|BN_FB_OBJID);
+    return (activeChannels|internalChannels())
+      & (BN_FB_PRIMID|BN_FB_INSTID|BN_FB_OBJID);
+  }
+
+  AuxTiles FrameBuffer::getActiveAuxTiles(Device *device)
+  {
+    AuxTiles auxTiles = getFor(device)->auxTiles;
+    const uint32_t produced = activeChannels|internalChannels();
+    if (!(produced & BN_FB_DEPTH))  auxTiles.depth  = 0;
+    if (!(produced & BN_FB_PRIMID)) auxTiles.primID = 0;
+    if (!(produced & BN_FB_INSTID)) auxTiles.instID = 0;
+    if (!(produced & BN_FB_OBJID))  auxTiles.objID  = 0;
+    if (!(produced & BN_FB_COST))   auxTiles.cost   = 0;
+    return auxTiles;
+  }
+
+  void FrameBuffer::updateActiveChannels()
+  {
+    const uint32_t lazyChannels
+      = BN_FB_DEPTH|BN_FB_PRIMID|BN_FB_INSTID|BN_FB_OBJID;
+    uint32_t active = channels;
+    if (lazyAuxChannels && renderedSinceResize)
+      active &= ~lazyChannels | channelsRead;
+    broadcastActiveChannels(active);
+    renderedSinceResize = true;
+    channelsRead = 0;
+    setActiveChannels(active);
+  }
+
+  void FrameBuffer::setActiveChannels(uint32_t active)
+  {
+    const uint32_t lazyChannels
+      = BN_FB_DEPTH|BN_FB_PRIMID|BN_FB_INSTID|BN_FB_OBJID;
+    if (active & ~activeChannels & lazyChannels)
+      /* ids and depth only get written by a frame's first sample */
+      resetAccumulation();
+    if (FromEnv::get()->logConfig && context->myRank() == 0
+        && (active != activeChannels))
+      std::cout << "#bn: active frame buffer channels now "
+                << (int)active << " (of " << (int)channels << " requested)"
+                << std::endl;
+    activeChannels = active;
+    /* layers get composited into the regular tiles, so both need
+       them */
+    bool tilesMoved = false;
+    for (auto device : *devices) {
+      auto pld = getPLD(device);
+      for (auto tiledFB : { pld->tiledFB.get(), pld->layerFB.get() })
+        if (tiledFB) {
+          tilesMoved |= tiledFB->trimIfPending();
+          tiledFB->allocAuxTiles(activeChannels|internalChannels());
+        }
+    }
+    if (tilesMoved)
+      /* captured bounces would still write the old tiles */
+      freeBounceGraphs();
+  }
+
+  void FrameBuffer::writeAsync(const std::string &baseName,
+                               uint32_t channels)
+  {
+    /* like read(), all other ranks would only get empty channels */
+    if (!isOwner) return;
+    if (!writer)
+      writer = new FrameWriter(getDenoiserDevice(),
+                               writeQueueDepth,writeThreads);
+    writer->queue(this,baseName,channels);
+  }
+
+  int FrameBuffer::flushWrites()
+  {
+    return writer ? writer->flush() : 0;
   }
 
   bool FrameBuffer::set1i(const std::string &member, const int &value)
@@ -66,16 +229,246 @@ namespace BARNEY_NS {
       fadeOutDenoiser = value;
       return true;
     }
+    if (member == "asyncDenoise") {
+      asyncDenoising = value;
+      return true;
+    }
+    if (member == "denoiseInterval") {
+      denoiseInterval = std::max(1,value);
+      return true;
+    }
     if (member == "upscale") {
       enableUpscaling = value;
       return true;
     }
+    if (member == "jpegQuality") {
+      jpegQuality = std::max(1,std::min(100,value));
+      return true;
+    }
+    if (member == "writeQueueDepth") {
+      writeQueueDepth = std::max(1,value);
+      return true;
+    }
+    if (member == "writeThreads") {
+      writeThreads = std::max(1,value);
+      return true;
+    }
+    if (member == "lazyAuxChannels") {
+      lazyAuxChannels = value;
+      return true;
+    }
+    if (member == "temporalReprojection") {
+      temporalReprojection = value;
+      return true;
+    }
+    if (member == "maxHistoryLength") {
+      maxHistoryLength = std::max(1,value);
+      return true;
+    }
+    if (member == "dynamicRenderScale") {
+      dynamicRenderScale = value;
+      return true;
+    }
+    if (member == "maxAccumulation") {
+      maxAccumulation = std::max(0,value);
+      return true;
+    }
+    if (member == "stopWhenConverged") {
+      stopWhenConverged = value;
+      return true;
+    }
+    if (member == "primaryHitCache") {
+      primaryHitCache = std::max(0,value);
+      return true;
+    }
+    if (member == "foveaMaxPeriod") {
+      foveation.maxPeriod = std::max(1,value);
+      foveation.dirty = true;
+      return true;
+    }
     return false;
   }
 
+  bool FrameBuffer::set1f(const std::string &member, const float &value)
+  {
+    if (member == "minRenderScale") {
+      minRenderScale = std::max(.05f,std::min(1.f,value));
+      return true;
+    }
+    if (member == "foveaRadius") {
+      foveation.radius = value;
+      foveation.dirty = true;
+      return true;
+    }
+    return false;
+  }
+
+  bool FrameBuffer::set2f(const std::string &member, const vec2f &value)
+  {
+    if (member == "foveaCenter") {
+      foveation.center = value;
+      foveation.dirty = true;
+      return true;
+    }
+    return false;
+  }
+
+  bool FrameBuffer::set4i(const std::string &member, const vec4i &value)
+  {
+    if (member == "regionOfInterest") {
+      if (value != roi.box)
+        roi.dirty = true;
+      roi.box = value;
+      return true;
+    }
+    return false;
+  }
+
+  bool FrameBuffer::setData(const std::string &member,
+                            const barney_api::Data::SP &value)
+  {
+    if (member == "tileSampleRates") {
+      foveation.tileRates.clear();
+      PODData::SP rates = value ? value->as<PODData>() : PODData::SP();
+      if (rates && rates->count > 0) {
+        if (rates->type != BN_FLOAT)
+          throw std::runtime_error
+            ("frame buffer 'tileSampleRates' have to be BN_FLOAT");
+        foveation.tileRates.resize(rates->count);
+        rates->download(getDenoiserDevice(),foveation.tileRates.data());
+      }
+      foveation.dirty = true;
+      return true;
+    }
+    return false;
+  }
+
+  void FrameBuffer::updateSamplePeriods()
+  {
+    if (!foveation.dirty) return;
+    foveation.dirty = false;
+
+    vec2i numTiles = divRoundUp(renderPixels,vec2i(tileSize));
+    int   maxPeriod = foveation.maxPeriod;
+    std::vector<int> periods;
+    if (!foveation.tileRates.empty()) {
+      if (foveation.tileRates.size() < size_t(numTiles.x)*numTiles.y)
+        throw std::runtime_error
+          ("frame buffer 'tileSampleRates' don't cover all tiles");
+      periods.resize(numTiles.x*numTiles.y);
+      for (int i=0;i<(int)periods.size();i++) {
+        float rate = foveation.tileRates[i];
+        periods[i]
+          = (rate > 0.f)
+          ? std::max(1,std::min(maxPeriod,int(1.f/rate+.5f)))
+          : maxPeriod;
+      }
+    } else if (foveation.radius > 0.f) {
+      periods.resize(numTiles.x*numTiles.y);
+      vec2f center = foveation.center * vec2f(renderPixels);
+      float radius = foveation.radius * renderPixels.y;
+      for (int iy=0;iy<numTiles.y;iy++)
+        for (int ix=0;ix<numTiles.x;ix++) {
+          vec2f tileCenter = (vec2f(ix,iy)+.5f)*float(tileSize);
+          float dist = length(tileCenter-center);
+          int period = 1;
+          while (period < maxPeriod && dist > period*radius)
+            period *= 2;
+          periods[ix+numTiles.x*iy] = std::min(period,maxPeriod);
+        }
+    }
+    for (auto device : *devices)
+      getPLD(device)->tiledFB->setSamplePeriods(periods);
+    resetAccumulation();
+  }
+
+  void FrameBuffer::updateRegionOfInterest()
+  {
+    if (!roi.dirty) return;
+    roi.dirty = false;
+    if (sortLast || sampleParallel) return;
+
+    /* the region is in display pixels, tiles are in render pixels */
+    const vec2i lower(roi.box.x,roi.box.y);
+    const vec2i upper(roi.box.z,roi.box.w);
+    const vec2i renderLower
+      = max(vec2i(0),lower*renderPixels/max(vec2i(1),numPixels));
+    const vec2i renderUpper
+      = min(renderPixels,
+            divRoundUp(upper*renderPixels,max(vec2i(1),numPixels)));
+    const bool  whole
+      = renderUpper.x <= renderLower.x || renderUpper.y <= renderLower.y;
+    if (whole && !roi.active)
+      /* already rendering the whole frame */
+      return;
+
+    /* same round-robin over the hilbert curve resize() uses, just
+       over fewer tiles */
+    const vec2i numTiles = divRoundUp(renderPixels,vec2i(tileSize));
+    const std::vector<int> curve = TiledFB::tileOrder(numTiles);
+    const int numDevices = (*devices)[0]->globalSize();
+    std::vector<int> owners(curve.size(),-1);
+    int numInside = 0;
+    for (auto t : curve) {
+      const vec2i tileLower
+        = vec2i(t % numTiles.x,t / numTiles.x)*tileSize;
+      const vec2i tileUpper = tileLower+vec2i(tileSize);
+      const bool inside
+        = whole ||
+        (tileLower.x < renderUpper.x && tileUpper.x > renderLower.x &&
+         tileLower.y < renderUpper.y && tileUpper.y > renderLower.y);
+      if (inside)
+        owners[t] = (numInside++) % numDevices;
+    }
+
+    roi.active = !whole;
+    if (roi.active) {
+      tileOwners = owners;
+      maxTilesPerDevice = divRoundUp(numInside,numDevices);
+    } else {
+      tileOwners.clear();
+      maxTilesPerDevice = 0;
+    }
+    for (auto device : *devices) {
+      std::vector<int> tileIDs;
+      for (auto t : curve)
+        if (owners[t] == device->globalRank())
+          tileIDs.push_back(t);
+      getPLD(device)->tiledFB->assignTiles(tileIDs);
+    }
+    foveation.dirty = true;
+    tileAssignmentChanged();
+    resetAccumulation();
+  }
+
+  void FrameBuffer::freeBounceGraphs()
+  {
+    for (auto device : *devices) {
+      for (auto &bg : getPLD(device)->bounceGraphs) {
+        device->rtc->freeGraph(bg.graph);
+        bg = BounceGraph();
+      }
+    }
+  }
+
   void FrameBuffer::freeResources()
   {
+    freeBounceGraphs();
+    freeViewStaging();
+    delete jpegEncoder;
+    jpegEncoder = 0;
     Device *device = getDenoiserDevice();
+    if (denoiserPending) {
+      /* may still be reading what we're about to free */
+      denoiser->finish();
+      device->rtc->sync();
+      for (auto &strip : denoiseStrips) {
+        strip.denoiser->finish();
+        strip.device->sync();
+      }
+      denoiserPending = false;
+    }
+    haveDenoisedFrame = false;
     if (linearColorChannel) {
       device->rtc->freeMem(linearColorChannel);
       linearColorChannel = 0;
@@ -88,6 +481,10 @@ namespace BARNEY_NS {
       device->rtc->freeMem(linearNormalChannel);
       linearNormalChannel = 0;
     }
+    if (renderColorChannel) {
+      device->rtc->freeMem(renderColorChannel);
+      renderColorChannel = 0;
+    }
     if (renderAuxChannel) {
       device->rtc->freeMem(renderAuxChannel);
       renderAuxChannel = 0;
@@ -129,108 +526,207 @@ namespace BARNEY_NS {
 #endif
 
   // ------------------------------------------------------------------
-  // Nearest-neighbor 2x upscale kernels (for AI upscaling mode)
-  // Uses 1D flattened indexing to match __rtc_launch convention.
+  // upscale kernels, from render to display resolution (for AI
+  // upscaling and dynamic render scales); nearest-neighbor for aux
+  // data, bilinear for color. Uses 1D flattened indexing to match
+  // __rtc_launch convention.
   // ------------------------------------------------------------------
 
-  /*! 2x nearest-neighbor upscale for uint32 data (depth, primID, etc.) */
+  /*! nearest-neighbor upscale for uint32 data (depth, primID, etc.) */
   __rtc_global
-  void upscale2xUint32Kernel(const rtc::ComputeInterface &ci,
-                             uint32_t *out, vec2i outSize,
-                             const uint32_t *in, vec2i inSize)
+  void upscaleUint32Kernel(const rtc::ComputeInterface &ci,
+                           uint32_t *out, vec2i outSize,
+                           const uint32_t *in, vec2i inSize)
   {
     int tid = ci.getThreadIdx().x + ci.getBlockIdx().x * ci.getBlockDim().x;
     int ox = tid % outSize.x;
     int oy = tid / outSize.x;
     if (oy >= outSize.y) return;
 
-    int ix = min(ox / 2, inSize.x - 1);
-    int iy = min(oy / 2, inSize.y - 1);
+    int ix = min(int((ox+.5f)*inSize.x/outSize.x), inSize.x - 1);
+    int iy = min(int((oy+.5f)*inSize.y/outSize.y), inSize.y - 1);
     out[tid] = in[ix + inSize.x * iy];
   }
 
-  /*! 2x nearest-neighbor upscale for vec3f data (normals) */
+  /*! nearest-neighbor upscale for vec3f data (normals) */
   __rtc_global
-  void upscale2xVec3fKernel(const rtc::ComputeInterface &ci,
-                            vec3f *out, vec2i outSize,
-                            const vec3f *in, vec2i inSize)
+  void upscaleVec3fKernel(const rtc::ComputeInterface &ci,
+                          vec3f *out, vec2i outSize,
+                          const vec3f *in, vec2i inSize)
   {
     int tid = ci.getThreadIdx().x + ci.getBlockIdx().x * ci.getBlockDim().x;
     int ox = tid % outSize.x;
     int oy = tid / outSize.x;
     if (oy >= outSize.y) return;
 
-    int ix = min(ox / 2, inSize.x - 1);
-    int iy = min(oy / 2, inSize.y - 1);
+    int ix = min(int((ox+.5f)*inSize.x/outSize.x), inSize.x - 1);
+    int iy = min(int((oy+.5f)*inSize.y/outSize.y), inSize.y - 1);
     out[tid] = in[ix + inSize.x * iy];
   }
 
-  /*! 2x nearest-neighbor upscale for vec4f data (color); used when AI
-      upscaling is enabled (we use HDR denoiser at half res then upscale ourselves). */
+  /*! bilinear upscale for vec4f data (color); used on the denoiser's
+      output if that ran at render resolution, and on the plain
+      gathered color otherwise */
   __rtc_global
-  void upscale2xVec4fKernel(const rtc::ComputeInterface &ci,
-                            vec4f *out, vec2i outSize,
-                            const vec4f *in, vec2i inSize)
+  void upscaleVec4fKernel(const rtc::ComputeInterface &ci,
+                          vec4f *out, vec2i outSize,
+                          const vec4f *in, vec2i inSize)
   {
     int tid = ci.getThreadIdx().x + ci.getBlockIdx().x * ci.getBlockDim().x;
     int ox = tid % outSize.x;
     int oy = tid / outSize.x;
     if (oy >= outSize.y) return;
 
-    int ix = min(ox / 2, inSize.x - 1);
-    int iy = min(oy / 2, inSize.y - 1);
-    out[tid] = in[ix + inSize.x * iy];
+    float fx = max(0.f,(ox+.5f)*inSize.x/outSize.x - .5f);
+    float fy = max(0.f,(oy+.5f)*inSize.y/outSize.y - .5f);
+    int x0 = min(int(fx), inSize.x - 1);
+    int y0 = min(int(fy), inSize.y - 1);
+    int x1 = min(x0 + 1, inSize.x - 1);
+    int y1 = min(y0 + 1, inSize.y - 1);
+    fx -= x0;
+    fy -= y0;
+    vec4f v00 = in[x0 + inSize.x * y0];
+    vec4f v01 = in[x1 + inSize.x * y0];
+    vec4f v10 = in[x0 + inSize.x * y1];
+    vec4f v11 = in[x1 + inSize.x * y1];
+    out[tid]
+      = (1.f-fy)*((1.f-fx)*v00+fx*v01)
+      + (    fy)*((1.f-fx)*v10+fx*v11);
   }
 
   void FrameBuffer::finalizeTiles()
   {}
 
+  void FrameBuffer::updateRenderScale(float targetFrameTime)
+  {
+    if (numPixels.x <= 0)
+      return;
+    if (settlingRenderScale) {
+      /* the restart we caused by going back to full resolution isn't
+         the app interacting again */
+      settlingRenderScale = false;
+      return;
+    }
+    float scale = 1.f;
+    if (dynamicRenderScale && targetFrameTime > 0.f && accumulationRestarts()) {
+      float waveTime = reduceRenderTime(lastWaveTime);
+      scale = renderScale;
+      if (waveTime > 0.f) {
+        /* render time goes with the number of pixels, ie, with the
+           scale squared. Quantized (down), so small variations in
+           frame time don't re-allocate tiles every frame */
+        const float steps = 12.f;
+        scale = renderScale*sqrtf(targetFrameTime/waveTime);
+        scale = floorf(scale*steps)/steps;
+        scale = std::max(minRenderScale,std::min(1.f,scale));
+      }
+    }
+    if (scale == renderScale)
+      return;
+    if (FromEnv::get()->logConfig && context->myRank() == 0)
+      std::cout << "#bn: render scale now " << scale << std::endl;
+    settlingRenderScale = (scale == 1.f);
+    renderScale = scale;
+    resize(colorChannelFormat,numPixels,channels);
+    resetAccumulation();
+  }
+
   void FrameBuffer::finalizeFrame()
   {
+    if (!views.fbs.empty()) {
+      /* multi-view: the views finalize themselves, from their rows
+         of this frame */
+      for (auto view : views.fbs) {
+        view->accumID = accumID;
+        view->finalizeFrame();
+      }
+      return;
+    }
+    FrameProfiler::Scope profile(profiler,FrameProfiler::LINEARIZE);
     Device *device = getDenoiserDevice();
     SetActiveGPU forDuration(device);
 
     bool doDenoising = (denoiser != 0) && (enableDenoising || enableUpscaling);
+    if (doDenoising && denoiseInterval > 1 && !enableUpscaling) {
+      if (accumID > 1)
+        interactiveFramesSinceDenoise = 0;
+      else if (interactiveFramesSinceDenoise++ % denoiseInterval != 0)
+        doDenoising = false;
+    }
+    denoiseThisFrame = doDenoising;
+    if (isOwner && denoiserPending)
+      /* the previous frame's denoiser run has to be done with its
+         inputs before we gather the new ones */
+      finishDenoising();
 
     bool needNormalChannel = (channels & BN_FB_NORMAL) && linearNormalChannel;
+    /* below display resolution, the plain (non-denoised) color gets
+       gathered as float4 at render resolution, and upscaled from
+       there; so do normals */
+    const bool upscaling = (renderPixels != numPixels);
     void *colorCopyTarget
       = doDenoising
       ? denoiser->in_rgba
-      : linearColorChannel;
+      : (upscaling ? renderColorChannel : linearColorChannel);
     vec3f *normalCopyTarget = nullptr;
     if (doDenoising)
       normalCopyTarget = denoiser->in_normal;
     else if (needNormalChannel)
-      normalCopyTarget = (vec3f*)linearNormalChannel;
+      normalCopyTarget
+        = (vec3f*)(upscaling ? renderNormalChannel : linearNormalChannel);
     BNDataType gatherType
-      = doDenoising
+      = (doDenoising || upscaling)
       ? BN_FLOAT4
       : colorChannelFormat;
 
-    gatherColorChannel(colorCopyTarget,gatherType,normalCopyTarget);
+    gatherColor(colorCopyTarget,gatherType,normalCopyTarget);
 
-    if (doDenoising && needNormalChannel) {
-      if (enableUpscaling && renderPixels != numPixels) {
+    if (needNormalChannel && (doDenoising || upscaling)) {
+      const vec3f *normalSrc
+        = doDenoising ? denoiser->in_normal : (const vec3f*)renderNormalChannel;
+      if (upscaling) {
         int totalOut = numPixels.x * numPixels.y;
         __rtc_launch(device->rtc,
-                     upscale2xVec3fKernel,
+                     upscaleVec3fKernel,
                      divRoundUp(totalOut, 256), 256,
                      (vec3f*)linearNormalChannel, numPixels,
-                     denoiser->in_normal, renderPixels);
+                     normalSrc, renderPixels);
       } else {
-        device->rtc->copy(linearNormalChannel, denoiser->in_normal,
+        device->rtc->copy(linearNormalChannel, normalSrc,
                           renderPixels.x*renderPixels.y*sizeof(vec3f));
       }
     }
+    if (!doDenoising && upscaling)
+      writeColorChannel((const vec4f*)renderColorChannel,renderPixels);
+
+    if (activeChannels & BN_FB_DEPTH)
+      gatherAux(BN_FB_DEPTH);
+    if (activeChannels & BN_FB_PRIMID)
+      gatherAux(BN_FB_PRIMID);
+    if (activeChannels & BN_FB_OBJID)
+      gatherAux(BN_FB_OBJID);
+    if (activeChannels & BN_FB_INSTID)
+      gatherAux(BN_FB_INSTID);
+    if (activeChannels & BN_FB_COST)
+      gatherAux(BN_FB_COST);
+
+    if (isOwner && doDenoising && asyncDenoising)
+      startDenoising();
 
-    if (channels & BN_FB_DEPTH)
-      gatherAuxChannel(BN_FB_DEPTH);
-    if (channels & BN_FB_PRIMID)
-      gatherAuxChannel(BN_FB_PRIMID);
-    if (channels & BN_FB_OBJID)
-      gatherAuxChannel(BN_FB_OBJID);
-    if (channels & BN_FB_INSTID)
-      gatherAuxChannel(BN_FB_INSTID);
+    if (isOwner && colorTarget.ptr) {
+      size_t sizeOfPixel
+        = (colorChannelFormat == BN_FLOAT4)
+        ? sizeof(vec4f)
+        : sizeof(uint32_t);
+      if (colorTarget.numBytes < numPixels.x*numPixels.y*sizeOfPixel)
+        throw std::runtime_error
+          ("registered color target is too small for this frame buffer");
+      readColorChannel(colorTarget.ptr,colorChannelFormat);
+    }
+    if (isOwner && jpegEncoder) {
+      readColorChannel(jpegEncoder->colorStaging,colorChannelFormat);
+      jpegEncoder->encode(jpegQuality);
+    }
   }
 
   /*! gather color (and normal, if required for denoising),
@@ -243,62 +739,326 @@ namespace BARNEY_NS {
     assert(requestedFormat == colorChannelFormat);
     Device *device = getDenoiserDevice();
     SetActiveGPU forDuration(device);
+    NvtxRange nvtx("readColorChannel",device->globalRank());
 
-    bool doDenoising = denoiser != 0 && (enableDenoising || enableUpscaling);
-    if (doDenoising) {
-      float blendFactor = fadeOutDenoiser ? (accumID-1) / (accumID+100.f) : 0.f;
-      device->rtc->sync();
+    if (denoiseThisFrame) {
+      if (!asyncDenoising)
+        startDenoising();
+      /* in async mode, what got started at the end of this frame
+         only gets shown once the next frame gets finalized - unless
+         there's nothing to show yet */
+      if (denoiserPending && (!asyncDenoising || !haveDenoisedFrame))
+        finishDenoising();
+    }
+
+    FrameProfiler::Scope profile(profiler,FrameProfiler::READBACK,-1,device);
+    size_t sizeOfPixel
+      = (requestedFormat == BN_FLOAT4)
+      ? sizeof(vec4f)
+      : sizeof(uint32_t);
+    device->rtc->copy(appMemory,linearColorChannel,
+                      numPixels.x*numPixels.y*sizeOfPixel);
+    device->rtc->sync();
+  }
+
+
+  void FrameBuffer::startDenoising()
+  {
+    Device *device = getDenoiserDevice();
+    SetActiveGPU forDuration(device);
+    NvtxRange nvtx("startDenoising",device->globalRank());
+    float blendFactor = fadeOutDenoiser ? (accumID-1) / (accumID+100.f) : 0.f;
+    if (denoiseStrips.empty())
       denoiser->run(blendFactor);
+    else {
+      /* every strip copies its rows (plus overlap) out of the
+         gathered inputs, and denoises them on its own device */
+      const size_t rowPixels = renderPixels.x;
+      device->rtc->recordEvent(denoiseInputsReady);
+      for (auto &strip : denoiseStrips) {
+        auto rtc = strip.device->rtc;
+        const size_t numRows = strip.inEnd - strip.inBegin;
+        rtc->streamWaitEvent(denoiseInputsReady);
+        rtc->copyAsync(strip.denoiser->in_rgba,
+                       denoiser->in_rgba+strip.inBegin*rowPixels,
+                       numRows*rowPixels*sizeof(vec4f));
+        if (denoiser->in_normal && strip.denoiser->in_normal)
+          rtc->copyAsync(strip.denoiser->in_normal,
+                         denoiser->in_normal+strip.inBegin*rowPixels,
+                         numRows*rowPixels*sizeof(vec3f));
+        strip.denoiser->run(blendFactor);
+      }
+    }
+    denoiserPending = true;
+  }
 
-      // We always use HDR denoiser (no OptiX UPSCALE2X). When enableUpscaling,
-      // denoiser output is at renderPixels; we 2x upscale to linearColorChannel
-      // at numPixels. When not upscaling, denoiser output is at numPixels.
-      vec2i outDims = denoiser->outputDims;
-      vec4f *colorSrc = denoiser->out_rgba;
-      if (enableUpscaling && renderPixels != numPixels && upscaledColorChannel) {
-        int totalOut = numPixels.x * numPixels.y;
-        __rtc_launch(device->rtc,
-                     upscale2xVec4fKernel,
-                     divRoundUp(totalOut, 256), 256,
-                     (vec4f*)upscaledColorChannel, numPixels,
-                     denoiser->out_rgba, renderPixels);
-        device->rtc->sync();
-        colorSrc = (vec4f*)upscaledColorChannel;
-        outDims = numPixels;
+  void FrameBuffer::finishDenoising()
+  {
+    Device *device = getDenoiserDevice();
+    SetActiveGPU forDuration(device);
+    {
+      FrameProfiler::Scope profile(profiler,FrameProfiler::DENOISE,-1,device);
+      if (denoiseStrips.empty())
+        denoiser->finish();
+      else {
+        /* stitch: each strip's own rows (without the overlap) go
+           back into the denoiser device's output */
+        const size_t rowPixels = renderPixels.x;
+        for (auto &strip : denoiseStrips) {
+          auto rtc = strip.device->rtc;
+          strip.denoiser->finish();
+          rtc->copyAsync(denoiser->out_rgba+strip.begin*rowPixels,
+                         strip.denoiser->out_rgba
+                         +(strip.begin-strip.inBegin)*rowPixels,
+                         (strip.end-strip.begin)*rowPixels*sizeof(vec4f));
+          rtc->recordEvent(strip.done);
+          device->rtc->streamWaitEvent(strip.done);
+        }
       }
+    }
+    denoiserPending = false;
 
-      switch(requestedFormat) {
-      case BN_FLOAT4: {
-        device->rtc->copy(appMemory, colorSrc,
-                          outDims.x*outDims.y*sizeof(vec4f));
-      } break;
-      case BN_UFIXED8_RGBA:
-      case BN_UFIXED8_RGBA_SRGB: {
-        bool srgb = (requestedFormat == BN_UFIXED8_RGBA_SRGB);
-        vec2ui bs(8,8);
-        LinearToFixed8 args = {
-          (uint32_t*)linearColorChannel, colorSrc, outDims, srgb
-        };
-        linear_toFixed8->launch(divRoundUp(vec2ui(outDims),bs),bs,&args);
-        device->rtc->copy(appMemory,linearColorChannel,
-                          outDims.x*outDims.y*sizeof(uint32_t));
-      } break;
-      default:
-        throw std::runtime_error
-          ("requested to read color channel in un-supported format #"
-           +std::to_string((int)requestedFormat));
-      };
-    } else {
-      size_t sizeOfPixel
-        = (requestedFormat == BN_FLOAT4)
-        ? sizeof(vec4f)
-        : sizeof(uint32_t);
-      device->rtc->copy(appMemory,linearColorChannel,
-                        numPixels.x*numPixels.y*sizeOfPixel);
+    // We always use HDR denoiser (no OptiX UPSCALE2X). When rendering
+    // below display resolution, denoiser output is at renderPixels,
+    // and gets upscaled to numPixels in writeColorChannel().
+    writeColorChannel(denoiser->out_rgba,denoiser->outputDims);
+    haveDenoisedFrame = true;
+  }
+
+  void FrameBuffer::setViews(const std::vector<FrameBuffer *> &fbs,
+                             const std::vector<Camera::DD> &cameras)
+  {
+    const bool numViewsChanged = (cameras.size() != views.cameras.size());
+    views.fbs     = fbs;
+    views.cameras = cameras;
+    views.height  = fbs.empty() ? 0 : numPixels.y/(int)fbs.size();
+    views.colorType    = BN_DATA_UNDEFINED;
+    views.haveNormal   = false;
+    views.auxGathered  = 0;
+    views.auxInStaging = (BNFrameBufferChannel)0;
+    for (auto device : *devices) {
+      auto pld = getPLD(device);
+      if (pld->viewCameras && numViewsChanged) {
+        device->rtc->freeBuffer(pld->viewCameras);
+        pld->viewCameras = 0;
+      }
+      if (cameras.empty())
+        continue;
+      if (!pld->viewCameras) {
+        MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+        pld->viewCameras
+          = device->rtc->createBuffer(cameras.size()*sizeof(Camera::DD));
+      }
+      /* stream ordered, so the previous frame's rays got generated by
+         the time this lands */
+      device->rtc->copyAsync(pld->viewCameras->getDD(),cameras.data(),
+                             cameras.size()*sizeof(Camera::DD));
     }
-    device->rtc->sync();
   }
 
+  void FrameBuffer::freeViewStaging()
+  {
+    Device *device = getDenoiserDevice();
+    for (void **ptr : { &views.color,(void **)&views.normal,&views.aux })
+      if (*ptr) {
+        device->rtc->freeMem(*ptr);
+        *ptr = 0;
+      }
+    views.colorType    = BN_DATA_UNDEFINED;
+    views.haveNormal   = false;
+    views.auxGathered  = 0;
+    views.auxInStaging = (BNFrameBufferChannel)0;
+  }
+
+  void FrameBuffer::gatherView(int view,
+                               void *linearColor,
+                               BNDataType gatherType,
+                               vec3f *linearNormal)
+  {
+    Device *device = getDenoiserDevice();
+    SetActiveGPU forDuration(device);
+    const size_t numFramePixels = size_t(numPixels.x)*numPixels.y;
+    if (!views.color) {
+      MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+      views.color  = device->rtc->allocMem(numFramePixels*sizeof(vec4f));
+      views.normal = (vec3f*)device->rtc->allocMem(numFramePixels*sizeof(vec3f));
+    }
+    /* every view asks for the same, except if some denoise and
+       others don't; then we have to gather once more */
+    if (views.colorType != gatherType || (linearNormal && !views.haveNormal)) {
+      gatherColorChannel(views.color,gatherType,
+                         linearNormal ? views.normal : nullptr);
+      views.colorType  = gatherType;
+      views.haveNormal = (linearNormal != nullptr);
+    }
+    if (!isOwner)
+      return;
+
+    const size_t numViewPixels = size_t(numPixels.x)*views.height;
+    const size_t sizeOfPixel
+      = (gatherType == BN_FLOAT4)
+      ? sizeof(vec4f)
+      : sizeof(uint32_t);
+    if (linearColor)
+      device->rtc->copyAsync(linearColor,
+                             (const uint8_t*)views.color
+                             +view*numViewPixels*sizeOfPixel,
+                             numViewPixels*sizeOfPixel);
+    if (linearNormal)
+      device->rtc->copyAsync(linearNormal,
+                             views.normal+view*numViewPixels,
+                             numViewPixels*sizeof(vec3f));
+  }
+
+  void FrameBuffer::gatherViewAux(BNFrameBufferChannel channel)
+  {
+    if (views.auxGathered & channel)
+      return;
+    gatherAuxChannel(channel);
+    views.auxGathered |= channel;
+  }
+
+  void FrameBuffer::writeViewAux(int view,
+                                 void *stagingArea,
+                                 BNFrameBufferChannel channel)
+  {
+    Device *device = getDenoiserDevice();
+    SetActiveGPU forDuration(device);
+    if (views.auxInStaging != channel) {
+      if (!views.aux) {
+        MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+        views.aux
+          = device->rtc->allocMem(size_t(numPixels.x)*numPixels.y*sizeof(uint32_t));
+      }
+      writeAuxChannel(views.aux,channel);
+      views.auxInStaging = channel;
+    }
+    const size_t numViewPixels = size_t(numPixels.x)*views.height;
+    device->rtc->copy(stagingArea,
+                      (const uint32_t*)views.aux+view*numViewPixels,
+                      numViewPixels*sizeof(uint32_t));
+  }
+
+  void FrameBuffer::gatherColor(void *linearColor,
+                                BNDataType gatherType,
+                                vec3f *linearNormal)
+  {
+    if (views.batch)
+      views.batch->gatherView(views.index,linearColor,gatherType,linearNormal);
+    else
+      gatherColorChannel(linearColor,gatherType,linearNormal);
+  }
+
+  void FrameBuffer::gatherAux(BNFrameBufferChannel channel)
+  {
+    if (views.batch)
+      views.batch->gatherViewAux(channel);
+    else
+      gatherAuxChannel(channel);
+  }
+
+  void FrameBuffer::writeAux(void *stagingArea,
+                             BNFrameBufferChannel channel)
+  {
+    if (views.batch)
+      views.batch->writeViewAux(views.index,stagingArea,channel);
+    else
+      writeAuxChannel(stagingArea,channel);
+  }
+
+  /*! rows of context each denoise strip gets on either side; the
+      optix denoiser's own tiling uses an overlap of about this size */
+  static const int denoiseStripOverlap = 64;
+
+  void FrameBuffer::resizeDenoiseStrips()
+  {
+    freeDenoiseStrips();
+    const int numRows = renderPixels.y;
+    const int numStrips = std::min((int)devices->size(),
+                                   numRows/denoiseStripOverlap);
+    if (numStrips < 2)
+      return;
+
+    float totalWeight = 0.f;
+    for (int i=0;i<numStrips;i++)
+      totalWeight += (*devices)[i]->tileWeight;
+    Device *owner = getDenoiserDevice();
+    denoiseInputsReady = owner->rtc->createEvent();
+
+    float weightSoFar = 0.f;
+    int begin = 0;
+    for (int i=0;i<numStrips;i++) {
+      Device *device = (*devices)[i];
+      weightSoFar += device->tileWeight;
+      DenoiseStrip strip;
+      strip.device  = device;
+      strip.begin   = begin;
+      strip.end     = (i == numStrips-1)
+        ? numRows
+        : std::max(begin+1,int(numRows*weightSoFar/totalWeight));
+      strip.inBegin = std::max(0,strip.begin-denoiseStripOverlap);
+      strip.inEnd   = std::min(numRows,strip.end+denoiseStripOverlap);
+      begin = strip.end;
+
+      SetActiveGPU forDuration(device);
+      strip.denoiser = device->rtc->createDenoiser();
+      strip.denoiser->upscaleMode = false;
+      strip.denoiser->resize(vec2i(renderPixels.x,strip.inEnd-strip.inBegin));
+      strip.done = device->rtc->createEvent();
+      denoiseStrips.push_back(strip);
+    }
+  }
+
+  void FrameBuffer::freeDenoiseStrips()
+  {
+    for (auto &strip : denoiseStrips) {
+      SetActiveGPU forDuration(strip.device);
+      delete strip.denoiser;
+      strip.device->rtc->freeEvent(strip.done);
+    }
+    denoiseStrips.clear();
+    if (denoiseInputsReady) {
+      getDenoiserDevice()->rtc->freeEvent(denoiseInputsReady);
+      denoiseInputsReady = 0;
+    }
+  }
+
+  void FrameBuffer::writeColorChannel(const vec4f *color, vec2i dims)
+  {
+    Device *device = getDenoiserDevice();
+    const vec4f *colorSrc = color;
+    vec2i outDims = dims;
+    if (dims != numPixels && upscaledColorChannel) {
+      int totalOut = numPixels.x * numPixels.y;
+      __rtc_launch(device->rtc,
+                   upscaleVec4fKernel,
+                   divRoundUp(totalOut, 256), 256,
+                   (vec4f*)upscaledColorChannel, numPixels,
+                   color, dims);
+      colorSrc = (const vec4f*)upscaledColorChannel;
+      outDims = numPixels;
+    }
+
+    switch(colorChannelFormat) {
+    case BN_FLOAT4: {
+      device->rtc->copyAsync(linearColorChannel, colorSrc,
+                             outDims.x*outDims.y*sizeof(vec4f));
+    } break;
+    case BN_UFIXED8_RGBA:
+    case BN_UFIXED8_RGBA_SRGB: {
+      bool srgb = (colorChannelFormat == BN_UFIXED8_RGBA_SRGB);
+      vec2ui bs(8,8);
+      LinearToFixed8 args = {
+        (uint32_t*)linearColorChannel, (vec4f*)colorSrc, outDims, srgb
+      };
+      linear_toFixed8->launch(divRoundUp(vec2ui(outDims),bs),bs,&args);
+    } break;
+    default:
+      throw std::runtime_error
+        ("requested to read color channel in un-supported format #"
+         +std::to_string((int)colorChannelFormat));
+    };
+  }
 
   /*! "finalize" and read the frame buffer. If this function gets
       called with a null hostPtr we will still finalize the frame
@@ -310,6 +1070,9 @@ namespace BARNEY_NS {
   {
     if (!appMemory) return;
 
+    if (readDisplayRegion(channel,appMemory,requestedFormat))
+      return;
+
     if (!isOwner) {
       // iw 'in theory' apps shoudln't even call map on any rank other
       // thank rank 0, but if they do, let's report them valid black,
@@ -324,7 +1087,8 @@ namespace BARNEY_NS {
       if (channel == BN_FB_DEPTH ||
           channel == BN_FB_PRIMID ||
           channel == BN_FB_INSTID ||
-          channel == BN_FB_OBJID) {
+          channel == BN_FB_OBJID ||
+          channel == BN_FB_COST) {
         for (int i=0;i<numPixels;i++)
           ((uint32_t*)appMemory)[i] = 0;
         return;
@@ -350,24 +1114,46 @@ namespace BARNEY_NS {
       return;
     }
 
+    if (channel == BN_FB_COLOR_JPEG) {
+      if (jpegEncoder)
+        memcpy(appMemory,jpegEncoder->bitstream.data(),
+               jpegEncoder->bitstream.size());
+      return;
+    }
+
     if (channel == BN_FB_DEPTH ||
         channel == BN_FB_PRIMID ||
         channel == BN_FB_INSTID ||
-        channel == BN_FB_OBJID) {
-      if (enableUpscaling && renderPixels != numPixels && renderAuxChannel) {
+        channel == BN_FB_OBJID ||
+        channel == BN_FB_COST) {
+      channelsRead |= channel;
+      if (!(activeChannels & channel)) {
+        /* dormant; will get produced again from the next frame on */
+        float    noDepth = BARNEY_INF;
+        uint32_t empty
+          = (channel == BN_FB_DEPTH) ? (const uint32_t &)noDepth
+          : (channel == BN_FB_COST)  ? 0u
+          : uint32_t(-1);
+        std::vector<uint32_t> emptyChannel(numPixels.x*numPixels.y,empty);
+        device->rtc->copy(appMemory,emptyChannel.data(),
+                          emptyChannel.size()*sizeof(uint32_t));
+        return;
+      }
+      if (renderPixels != numPixels && renderAuxChannel) {
         // linearize at render resolution, then upscale to display resolution
-        writeAuxChannel(renderAuxChannel,channel);
+        writeAux(renderAuxChannel,channel);
         int totalOut = numPixels.x * numPixels.y;
         __rtc_launch(device->rtc,
-                     upscale2xUint32Kernel,
+                     upscaleUint32Kernel,
                      divRoundUp(totalOut, 256), 256,
                      (uint32_t*)linearAuxChannel, numPixels,
                      (const uint32_t*)renderAuxChannel, renderPixels);
         device->rtc->sync();
       } else {
-        writeAuxChannel(linearAuxChannel,channel);
+        writeAux(linearAuxChannel,channel);
       }
       // NOTE: depth + id buffers happen to be the same bytes-per-pixel
+      FrameProfiler::Scope profile(profiler,FrameProfiler::READBACK,-1,device);
       device->rtc->copy(appMemory,linearAuxChannel,
                         numPixels.x*numPixels.y*sizeof(uint32_t));
       return;
@@ -375,6 +1161,7 @@ namespace BARNEY_NS {
 
     if (channel == BN_FB_NORMAL && linearNormalChannel) {
       // normals were already linearized (and upscaled if needed) during finalizeFrame()
+      FrameProfiler::Scope profile(profiler,FrameProfiler::READBACK,-1,device);
       device->rtc->copy(appMemory,linearNormalChannel,
                         numPixels.x*numPixels.y*sizeof(vec3f));
       return;
@@ -390,19 +1177,36 @@ namespace BARNEY_NS {
                            uint32_t channels)
   {
     this->channels = channels;
+    this->activeChannels = channels;
+    this->channelsRead = 0;
+    this->renderedSinceResize = false;
     this->colorChannelFormat = colorFormat;
 
     freeResources();
+    MemoryScope memScope(devices.get(),BN_MEMORY_FRAME_BUFFERS);
+    tileOwners.clear();
+    maxTilesPerDevice = 0;
+    /* new tiles, so they need their sample periods (and region of
+       interest) again */
+    foveation.dirty = true;
+    roi.dirty  = roi.active || roi.box != vec4i(0);
+    roi.active = false;
 
     // display resolution - keep exactly as the app requested so the
     // ANARI frame reports the same size back and the pipeline's
     // block-copy fast path is used (no stride mismatch).
     numPixels = size;
 
-    // when upscaling, render at half resolution (ceiling division so
-    // that renderPixels covers at least numPixels/2 in each dim; the
-    // upscale kernel clamps edge pixels with min()).
-    if (enableUpscaling && denoiser) {
+    // with a (dynamic) render scale below one, render at that
+    // fraction of the resolution; else, when upscaling, render at
+    // half resolution (ceiling division so that renderPixels covers
+    // at least numPixels/2 in each dim; the upscale kernels clamp
+    // edge pixels with min()).
+    if (renderScale < 1.f) {
+      renderPixels
+        = max(vec2i(1),vec2i(int(ceilf(numPixels.x*renderScale)),
+                             int(ceilf(numPixels.y*renderScale))));
+    } else if (enableUpscaling && denoiser) {
       renderPixels = vec2i((numPixels.x + 1) / 2, (numPixels.y + 1) / 2);
     } else {
       renderPixels = numPixels;
@@ -410,7 +1214,14 @@ namespace BARNEY_NS {
 
     // tiles render at renderPixels
     for (auto device : *devices) {
-      getFor(device)->resize(channels, renderPixels);
+      getFor(device)->resize(channels|internalChannels(), renderPixels,
+                             /*allTiles*/sampleParallel);
+      if (sortLast) {
+        auto pld = getPLD(device);
+        if (!pld->layerFB)
+          pld->layerFB = TiledFB::create(device,nullptr,this);
+        pld->layerFB->resize(channels, renderPixels, /*allTiles*/true);
+      }
     }
 
     size_t sizeOfPixel
@@ -430,20 +1241,32 @@ namespace BARNEY_NS {
         linearNormalChannel = rtc->allocMem(dpNP * sizeof(vec3f));
 
       // when upscaling, we need render-resolution staging buffers
-      // for aux/normal (tile linearization writes at render res,
-      // then we upscale to display res)
-      if (enableUpscaling && renderPixels != numPixels) {
+      // for color/aux/normal (tile linearization writes at render
+      // res, then we upscale to display res)
+      if (renderPixels != numPixels) {
+        renderColorChannel  = rtc->allocMem(rpNP * sizeof(vec4f));
         renderAuxChannel    = rtc->allocMem(rpNP * sizeof(uint32_t));
         if (channels & BN_FB_NORMAL)
           renderNormalChannel = rtc->allocMem(rpNP * sizeof(vec3f));
         upscaledColorChannel = rtc->allocMem(dpNP * sizeof(vec4f));
       }
 
+      if (channels & BN_FB_COLOR_JPEG) {
+        if (JpegEncoder::available())
+          jpegEncoder = new JpegEncoder(getDenoiserDevice(),
+                                        numPixels,colorFormat);
+        else
+          std::cerr << "#bn: WARNING - jpeg-encoded color requested, but "
+                    << "barney was built without nvjpeg support" << std::endl;
+      }
+
       if (denoiser) {
         // Never use OptiX UPSCALE2X (unreliable); we run HDR denoiser at half res
         // and do 2x upscale ourselves in readColorChannel.
         denoiser->upscaleMode = false;
         denoiser->resize(renderPixels);
+        if (parallelDenoise)
+          resizeDenoiseStrips();
       }
     }
   }
@@ -460,7 +1283,136 @@ namespace BARNEY_NS {
   {
     auto pld = getPLD(device);
     assert(pld);
-    return pld->tiledFB.get();
+    return renderingLayers ? pld->layerFB.get() : pld->tiledFB.get();
+  }
+
+  const std::vector<float> &FrameBuffer::getDeviceWeights()
+  {
+    if (deviceWeights.empty()) {
+      std::vector<float> weights((*devices)[0]->globalSize(),0.f);
+      for (auto device : *devices)
+        weights[device->globalRank()] = device->tileWeight;
+      reduceDeviceWeights(weights);
+      deviceWeights = weights;
+    }
+    return deviceWeights;
+  }
+  
+  void FrameBuffer::rebalanceTiles()
+  {
+    if (sortLast || sampleParallel || roi.active) return;
+    
+    const std::vector<float> &weights = getDeviceWeights();
+    const bool uniformWeights
+      = *std::min_element(weights.begin(),weights.end())
+      == *std::max_element(weights.begin(),weights.end());
+    if (balanceTiles) {
+      if (!accumulationRestarts()) return;
+    } else {
+      /* the weighted split only depends on the frame size, so is
+         done once after every resize */
+      if (uniformWeights || !tileOwners.empty()) return;
+    }
+
+    /* only re-balance if the current assignment is worse than that */
+    const float tolerance = .1f;
+    /* ... and only if the new one gains at least that much */
+    const float minGain   = .05f;
+
+    const int numDevices = (*devices)[0]->globalSize();
+    const std::vector<int> curve
+      = TiledFB::tileOrder(divRoundUp(renderPixels,vec2i(tileSize)));
+    const int numTiles   = (int)curve.size();
+    if (numTiles <= numDevices) return;
+
+    std::vector<float> costOfTile(numTiles,0.f);
+    if (balanceTiles) {
+      for (auto device : *devices) {
+        TiledFB *devFB = getPLD(device)->tiledFB.get();
+        std::vector<int> tileIDs = devFB->getTileIDs();
+        std::vector<int> costs   = devFB->readTileCosts();
+        for (int i=0;i<(int)tileIDs.size();i++)
+          costOfTile[tileIDs[i]] = (float)costs[i];
+      }
+      reduceTileCosts(costOfTile);
+    }
+
+    float totalCost = 0.f;
+    for (auto cost : costOfTile)
+      totalCost += cost;
+    if (totalCost <= 0.f) {
+      /* no costs tracked (yet); with devices of equal weights
+         there's nothing to go by, else assume all tiles cost the
+         same */
+      if (uniformWeights) return;
+      std::fill(costOfTile.begin(),costOfTile.end(),1.f);
+      totalCost = (float)numTiles;
+    }
+    
+    /* a device's 'time' is its load divided by its weight */
+    float sumWeights = 0.f;
+    for (auto w : weights)
+      sumWeights += w;
+    std::vector<float> load(numDevices,0.f);
+    for (int i=0;i<numTiles;i++) {
+      int t = curve[i];
+      int owner = tileOwners.empty() ? (i % numDevices) : tileOwners[t];
+      load[owner] += costOfTile[t];
+    }
+    float avgTime = totalCost / sumWeights;
+    float maxTime = 0.f;
+    for (int d=0;d<numDevices;d++)
+      maxTime = std::max(maxTime,load[d]/weights[d]);
+    if (maxTime <= (1.f+tolerance)*avgTime) return;
+
+    /* longest-processing-time-first: hand out tiles from the most
+       expensive one down, each to the device that would be done with
+       it the earliest. Every rank computes this from the same costs,
+       so everybody ends up with the same assignment */
+    std::vector<int> order(numTiles);
+    for (int t=0;t<numTiles;t++) order[t] = t;
+    std::sort(order.begin(),order.end(),
+              [&](int a, int b) {
+                if (costOfTile[a] != costOfTile[b])
+                  return costOfTile[a] > costOfTile[b];
+                return a < b;
+              });
+    std::vector<float> newLoad(numDevices,0.f);
+    std::vector<int> newOwners(numTiles);
+    for (auto t : order) {
+      int best = 0;
+      float bestTime = INFINITY;
+      for (int d=0;d<numDevices;d++) {
+        float time = (newLoad[d]+costOfTile[t])/weights[d];
+        if (time < bestTime) { bestTime = time; best = d; }
+      }
+      newOwners[t] = best;
+      newLoad[best] += costOfTile[t];
+    }
+    float newMaxTime = 0.f;
+    for (int d=0;d<numDevices;d++)
+      newMaxTime = std::max(newMaxTime,newLoad[d]/weights[d]);
+    if (newMaxTime > (1.f-minGain)*maxTime) return;
+
+    tileOwners = newOwners;
+    std::vector<int> numTilesOf(numDevices,0);
+    for (auto owner : tileOwners)
+      numTilesOf[owner]++;
+    maxTilesPerDevice = *std::max_element(numTilesOf.begin(),numTilesOf.end());
+    for (auto device : *devices) {
+      /* keep each device's tiles in curve order, too */
+      std::vector<int> tileIDs;
+      for (auto t : curve)
+        if (tileOwners[t] == device->globalRank())
+          tileIDs.push_back(t);
+      getPLD(device)->tiledFB->assignTiles(tileIDs);
+    }
+    foveation.dirty = true;
+    tileAssignmentChanged();
+    if (FromEnv::get()->logConfig && context->myRank() == 0)
+      std::cout << "#bn: re-balanced tiles; predicted max load went from "
+                << (maxTime/avgTime) << "x to " << (newMaxTime/avgTime)
+                << "x of average" << std::endl;
   }
 
   Device *FrameBuffer::getDenoiserDevice() const
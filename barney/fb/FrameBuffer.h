@@ -6,10 +6,14 @@
 
 #include "barney/Context.h"
 #include "barney/fb/TiledFB.h"
+#include "barney/fb/FrameProfiler.h"
+#include "barney/render/RayQueue.h"
 
 namespace BARNEY_NS {
 
   struct FrameBuffer;
+  struct JpegEncoder;
+  struct FrameWriter;
 
   struct FrameBuffer : barney_api::FrameBuffer {
 
@@ -32,11 +36,104 @@ namespace BARNEY_NS {
                 vec2i size,
                 uint32_t channels) override;
     vec2i getNumPixels() const override { return numPixels; }
+    bool getStats(BNFrameStats &stats) override;
+    bool getCounters(BNDeviceCounters &counters) override;
+    void setColorTarget(int fd, size_t numBytes) override;
+    size_t getEncodedSize() override;
+    void writeAsync(const std::string &baseName,
+                    uint32_t channels) override;
+    int flushWrites() override;
     void resetAccumulation() override
-    {  /* whatever we may have in compressed tiles is dirty */ accumID = 0; }
+    {
+      /* whatever we may have in compressed tiles is dirty */
+      accumID = 0;
+      /* ... and so is whatever got baked into captured bounces */
+      freeBounceGraphs();
+    }
     void freeResources();
+    void freeBounceGraphs();
 
     bool needHitIDs() const;
+    /*! aux channels the frame buffer needs for itself, on top of
+        what the app asked for; those get produced, but never
+        gathered */
+    uint32_t internalChannels() const;
+    /*! given device's aux tiles, minus those of dormant channels (see
+        activeChannels) */
+    AuxTiles getActiveAuxTiles(Device *device);
+
+    /*! sort-last compositing: after all devices rendered their own
+        domains into their layers, composite those (in visibility
+        order) into the devices' actual tiles. Only frame buffers
+        that set sortLast implement this */
+    virtual void compositeLayers(GlobalModel *model,
+                                 Camera *camera,
+                                 Renderer *renderer) {}
+
+    /*! cost-based tile balancing: if enabled, and if accumulation
+        is about to restart, re-assigns tile ownership so that every
+        global device's share of last frame's shade counts is about
+        proportional to its tileWeight. Only does so if the current
+        assignment is off by more than a tolerance, and the new one
+        is notably better. Without cost tracking, but with devices of
+        different weights (say, a cpu rank next to gpu ranks), splits
+        tiles by weight alone, once per frame size. Has to be called
+        on all ranks, before the frame renders */
+    void rebalanceTiles();
+    /*! every global device's tileWeight; gathered (from all ranks)
+        on first use */
+    const std::vector<float> &getDeviceWeights();
+    /*! decides which of the requested aux channels get produced in
+        the upcoming frame (see activeChannels), based on what the app
+        read since the last one. Has to be called on all ranks, before
+        the frame renders */
+    void updateActiveChannels();
+    /*! makes everybody use the owner's active channels; only the
+        owner knows what the app read */
+    virtual void broadcastActiveChannels(uint32_t &active) {}
+    /*! if the foveation parameters (or the tiles) changed since the
+        last frame, hands every device's tiles their new sample
+        periods, and restarts accumulation. Has to be called before
+        the frame renders */
+    void updateSamplePeriods();
+    /*! if the region of interest changed since the last frame (or
+        the tiles did), deals out only the tiles that overlap it to
+        the devices - or, once it's gone, all tiles again - and
+        restarts accumulation. Has to be called on all ranks, before
+        the frame renders */
+    void updateRegionOfInterest();
+    /*! what accumulated tile values have to be multiplied with to
+        get each pixel's average: 1/accumID for sums, or 1 with
+        half-precision accumulation, where tiles already hold
+        averages */
+    float getAccumScale() const
+    {
+#if BARNEY_HALF_ACCUM
+      return 1.f;
+#else
+      return 1.f/accumID;
+#endif
+    }
+    /*! whether accumulation is about to restart (on any rank) */
+    virtual bool accumulationRestarts() { return accumID == 0; }
+    /*! sums the per-tile costs of all ranks, (in place) */
+    virtual void reduceTileCosts(std::vector<float> &costOfTile) {}
+    /*! sums the per-device weights all ranks filled in for their own
+        devices (in place) */
+    virtual void reduceDeviceWeights(std::vector<float> &weights) {}
+    /*! gets called after the devices' tiled FBs got new tiles */
+    virtual void tileAssignmentChanged() {}
+    /*! the largest of all ranks' given times */
+    virtual float reduceRenderTime(float time) { return time; }
+    /*! dynamic render scale: while accumulation keeps restarting
+        (ie, while interacting), picks the render scale at which one
+        wave of samples should take targetFrameTime milliseconds, as
+        estimated from the last frame's; and goes back to full
+        resolution (restarting accumulation once more) as soon as
+        frames accumulate again. Only does anything if enabled
+        through set1i("dynamicRenderScale"). Has to be called on all
+        ranks, before the frame renders */
+    void updateRenderScale(float targetFrameTime);
 
     void finalizeTiles();
     void finalizeFrame();
@@ -59,6 +156,15 @@ namespace BARNEY_NS {
     virtual void writeAuxChannel(void *stagingArea,
                                  BNFrameBufferChannel channel) = 0;
 
+    /*! if frame buffer output is split into per-rank display
+        regions (see DistFB), reads this rank's region of given
+        channel and returns true; false means read() does the usual
+        full-frame read */
+    virtual bool readDisplayRegion(BNFrameBufferChannel channel,
+                                   void *appMemory,
+                                   BNDataType requestedFormat)
+    { return false; }
+    
     /*! read given frame buffer channel into given application memory
         (which may be either host or device memory), in requested
         format. Requeseted color format (currently) has to match the
@@ -67,9 +173,36 @@ namespace BARNEY_NS {
               void *appDataPtr,
               BNDataType requestedFormat) override;
 
+    /*! one trace-and-shade bounce on one device, captured into a
+        graph so later bounces (and frames) can replay it rather than
+        issue each kernel one by one; see
+        Context::replayBounceGraph(). A captured bounce is only valid
+        for the ray queue layout it got captured with, and only until
+        accumulation gets reset */
+    struct BounceGraph {
+      rtc::Graph *graph     = 0;
+      /*! read queue rays and queue size this got captured for */
+      Ray        *readRays  = 0;
+      int         queueSize = 0;
+      /*! the queues after the bounce (shading and sorting swap them
+          on the host) */
+      SingleQueue readAfter;
+      SingleQueue writeAfter;
+    };
+    
+    /*! the tiles the given device currently renders into: its own
+        tiles, or - while rendering sort-last layers - its layer */
     TiledFB *getFor(Device *device);
     struct PLD {
       TiledFB::SP tiledFB;
+      /*! sort-last compositing only: full-frame layer that this
+          device renders (only) its own data into */
+      TiledFB::SP layerFB;
+      /*! one per parity of the two ray queues */
+      BounceGraph bounceGraphs[2];
+      /*! multi-view rendering only: this device's copy of
+          views.cameras */
+      rtc::Buffer *viewCameras = 0;
     };
     PLD *getPLD(Device *device);
 
@@ -88,9 +221,32 @@ namespace BARNEY_NS {
     /*! staging area for the normal channel (vec3f per pixel) */
     void *linearNormalChannel = 0;
 
+    /*! graphics api memory (on the denoiser device) that every
+        frame's final color gets written into, if the app registered
+        one; see bnFrameBufferSetColorTarget() */
+    struct {
+      void  *ptr      = 0;
+      size_t numBytes = 0;
+    } colorTarget;
+
+    /*! encodes every frame's final color if the app asked for
+        BN_FB_COLOR_JPEG (and barney was built with nvjpeg); only
+        ever exists on the owner */
+    JpegEncoder *jpegEncoder = 0;
+    /*! see set1i("jpegQuality") */
+    int jpegQuality = 90;
+
+    /*! writes frames queued through bnFrameBufferWriteAsync(); only
+        ever exists on the owner, and only once the app queued one */
+    FrameWriter *writer = 0;
+    /*! see set1i("writeQueueDepth") and set1i("writeThreads") */
+    int writeQueueDepth = 3;
+    int writeThreads    = 2;
+
     /*! when upscaling, the render-resolution staging buffers that
-        tile linearization writes into (before nearest-neighbor
-        upscale to the display-resolution linear buffers above) */
+        tile linearization writes into (before the upscale to the
+        display-resolution linear buffers above) */
+    void  *renderColorChannel  = 0;
     void  *renderAuxChannel    = 0;
     void  *renderNormalChannel = 0;
     /*! when upscaling, staging for 2x upscaled color (float4 at numPixels)
@@ -99,12 +255,36 @@ namespace BARNEY_NS {
 
     /*! the channels we're supposed to have (as asked for on the latest resize()) */
     uint32_t   channels = 0;
+    /*! demand-driven aux channels: depth and the ID channels only get
+        produced (hit IDs traced, tiles written, and gathered) while
+        the app keeps reading them. One that didn't get read between
+        two frames goes dormant; reading a dormant channel returns an
+        empty one (depth infinity, IDs -1), and makes it get produced
+        again - with accumulation restarting - from the next frame on.
+        Can be turned off through set1i("lazyAuxChannels",0) */
+    uint32_t   activeChannels  = 0;
+    /*! channels the app read since the last frame */
+    uint32_t   channelsRead    = 0;
+    bool       lazyAuxChannels = true;
+    bool       renderedSinceResize = false;
     BNDataType colorChannelFormat = BN_DATA_UNDEFINED;
     vec2i      numPixels = {-1,-1};
 
     /*! actual render resolution (equals numPixels when not upscaling,
-        numPixels/2 when upscaling) */
+        numPixels/2 when upscaling, and renderScale*numPixels with a
+        render scale below one) */
     vec2i      renderPixels = {-1,-1};
+    /*! fraction of numPixels (per dimension) to render at; only ever
+        below one with dynamicRenderScale, see updateRenderScale() */
+    float      renderScale = 1.f;
+    /*! lowest renderScale updateRenderScale() may go to
+        (set1f("minRenderScale")) */
+    float      minRenderScale = .33f;
+    bool       dynamicRenderScale = false;
+    bool       settlingRenderScale = false;
+    /*! time (in ms) the first wave of samples of the last frame took
+        on this rank; set by Context::renderTiles() */
+    float      lastWaveTime = 0.f;
 
     Device *getDenoiserDevice() const;
 
@@ -115,9 +295,24 @@ namespace BARNEY_NS {
     void readColorChannel(void *appMemory,
                           BNDataType requestedFormat);
 
+    /*! starts the denoiser on the gathered color (and normal) of the
+        current frame; does not block */
+    void startDenoising();
+    /*! waits for the most recently started denoiser run, and
+        (upscales and) converts its result into linearColorChannel */
+    void finishDenoising();
+    /*! (upscales, if dims aren't numPixels, and) converts given
+        float4 color into linearColorChannel */
+    void writeColorChannel(const vec4f *color, vec2i dims);
+
     // ------------------------------------------------------------------
     /*! @{ parameter set/commit interface */
     bool set1i(const std::string &member, const int &value) override;
+    bool set1f(const std::string &member, const float &value) override;
+    bool set2f(const std::string &member, const vec2f &value) override;
+    bool set4i(const std::string &member, const vec4i &value) override;
+    bool setData(const std::string &member,
+                 const barney_api::Data::SP &value) override;
     /*! @} */
     // ------------------------------------------------------------------
 
@@ -129,6 +324,35 @@ namespace BARNEY_NS {
         enableDenoising. */
     rtc::Denoiser *denoiser = 0;
 
+    /*! with BARNEY_CONFIG=parallelDenoise, the frame gets denoised
+        in horizontal strips, one per device of this frame buffer
+        (sized by their tileWeights), each by a denoiser of its own
+        on that device. Every strip's denoiser sees denoiseStripOverlap
+        extra rows on either side, which get discarded when its
+        result gets copied back into the (main) denoiser's out_rgba
+        on the denoiser device. Empty otherwise */
+    struct DenoiseStrip {
+      Device        *device   = 0;
+      rtc::Denoiser *denoiser = 0;
+      /*! frame rows [begin,end) get taken from this strip; its
+          denoiser gets rows [inBegin,inEnd) as input */
+      int begin = 0, end = 0, inBegin = 0, inEnd = 0;
+      /*! recorded on the strip's device once its result got copied
+          back */
+      rtc::Event *done = 0;
+    };
+    std::vector<DenoiseStrip> denoiseStrips;
+    /*! recorded on the denoiser device once the inputs got gathered */
+    rtc::Event *denoiseInputsReady = 0;
+    bool parallelDenoise = false;
+    /*! (re-)creates the strips for the current renderPixels */
+    void resizeDenoiseStrips();
+    void freeDenoiseStrips();
+
+    /*! collects per-stage timings of each frame; null unless
+        profiling is enabled in BARNEY_CONFIG */
+    FrameProfiler *profiler = 0;
+
     /*! whether to "in principle" do denoising. Denoising will still
      require an rtc backend that does have a denoiser (\see denoiser
      field), but this allows a user to disable denoising at runtime */
@@ -136,11 +360,221 @@ namespace BARNEY_NS {
 
     bool fadeOutDenoiser = true;
 
+    /*! if set (set1i("asyncDenoise")), denoising a frame overlaps
+        with rendering the next one: the denoiser gets started at the
+        end of finalizeFrame(), and only gets waited for once the next
+        frame gets finalized - so the color channel always shows the
+        previous frame, at the cost of one frame of latency */
+    bool asyncDenoising = false;
+    /*! while interacting (ie, while every frame restarts
+        accumulation) only denoise every denoiseInterval'th frame
+        (set1i("denoiseInterval")), and show the others as they are;
+        once frames start accumulating, every frame gets denoised
+        again. Doesn't apply when upscaling, which needs the denoiser
+        for every frame */
+    int  denoiseInterval = 1;
+    int  interactiveFramesSinceDenoise = 0;
+    /*! whether the frame currently being finalized gets denoised */
+    bool denoiseThisFrame = false;
+    /*! a denoiser run got started, but its result hasn't been
+        converted into linearColorChannel yet */
+    bool denoiserPending = false;
+    /*! linearColorChannel holds a denoised frame (which it doesn't
+        right after a resize) */
+    bool haveDenoisedFrame = false;
+
+    /*! if set, every device renders the whole frame with only its own
+        data into its layerFB, and those layers then get composited;
+        see compositeLayers(). Set by the frame buffer type that
+        supports it, based on BARNEY_CONFIG=composite=1 */
+    bool sortLast = false;
+    /*! if set, every device owns all of the frame's tiles, and
+        renders them with sample indices of its own (the k'th of n
+        devices takes samples k, n+k, 2n+k, ...); the devices'
+        accumulated tiles then get summed on the owner. For small
+        frames, where splitting tiles leaves each device with too
+        little work to fill it. Set by the frame buffer type that
+        supports it, based on BARNEY_CONFIG=sampleParallel */
+    bool sampleParallel = false;
+    /*! the sample index device's rays of given (per-device) sample
+        get their pixel/lens jitter and random seeds from */
+    int rngSampleID(const Device *device, int sampleID) const
+    {
+      return sampleParallel
+        ? sampleID*(int)devices->size()+device->contextRank()
+        : sampleID;
+    }
+    /*! makes the renderer's low-discrepancy sample indexing and
+        per-pixel scrambles match rngSampleID(): pixel IDs are only
+        unique per device, so unless all devices render the same
+        tiles, their scrambles get salted with the device's rank */
+    void setSampleIndexing(const Device *device,
+                           int &sampleStride,
+                           int &sampleOffset,
+                           uint32_t &scrambleSalt) const
+    {
+      sampleStride = sampleParallel ? (int)devices->size() : 1;
+      sampleOffset = sampleParallel ? device->contextRank() : 0;
+      scrambleSalt = sampleParallel ? 0u : (uint32_t)device->contextRank();
+    }
+    /*! set (by renderTiles) while rendering into the layers; that's
+        when getFor() returns the layers */
+    bool renderingLayers = false;
+
+    /*! whether to track per-tile costs and re-balance tiles based on
+        those (BARNEY_CONFIG=balanceTiles=1); see rebalanceTiles() */
+    bool balanceTiles = false;
+    /*! if tiles got re-balanced, the largest number of tiles any
+        global device owns; 0 for the default round-robin split */
+    int  maxTilesPerDevice = 0;
+    /*! global device that owns each frame tile; empty for the default
+        round-robin split */
+    std::vector<int> tileOwners;
+    /*! see getDeviceWeights(); empty until first used */
+    std::vector<float> deviceWeights;
+
+    /*! foveated rendering: tiles away from where the viewer looks
+        only get every k'th sample (see
+        TiledFB::setSamplePeriods()). Either from a fovea (center in
+        [0,1]^2 frame coordinates, and radius as a fraction of the
+        frame height) - where k doubles every time a tile's distance
+        to the center doubles - or from an app-provided per-tile
+        sample rate in (0,1] ('tileSampleRates', one float per
+        tileSize^2 tile, row-major); in both cases k is capped at
+        maxPeriod. Off unless either a radius or rates got set. Not
+        applied to sort-last layers */
+    struct {
+      vec2f center    = vec2f(.5f,.5f);
+      float radius    = 0.f;
+      int   maxPeriod = 8;
+      std::vector<float> tileRates;
+      bool  dirty     = false;
+    } foveation;
+
+    /*! region of interest (set4i("regionOfInterest"), as lower x,y
+        and upper - exclusive - x,y, in pixels of the frame): only the
+        tiles that overlap it get rendered and finalized, and all
+        other pixels keep whatever they had from earlier frames (or
+        are undefined right after a resize). Changing it restarts
+        accumulation; an empty region, or one that's outside the
+        frame, means the whole frame. Not applied to sort-last layers
+        or sample-parallel rendering, and tiles don't get
+        re-balanced while it's set */
+    struct {
+      vec4i box    = vec4i(0);
+      bool  dirty  = false;
+      /*! whether the current tile assignment is for a region */
+      bool  active = false;
+    } roi;
+
+    /*! temporal reprojection (set1i("temporalReprojection")): rather
+        than starting from scratch, a frame that restarts
+        accumulation blends in whatever of the previous frame's
+        accumulated pixels it can find again - through the depth,
+        primID and instID channels, and both frames' cameras - worth
+        at most maxHistoryLength samples; see
+        TiledFB::reprojectHistory(). Only takes effect with the next
+        resize(), which is when the channels it needs get allocated */
+    bool temporalReprojection = false;
+    int  maxHistoryLength     = 16;
+
+    /*! auto-stop: once a frame has accumulated maxAccumulation
+        samples (set1i("maxAccumulation"), 0 for no limit) - or, with
+        set1i("stopWhenConverged") and a renderer that does adaptive
+        sampling, once all of its tiles have converged - render()
+        returns without launching anything, until accumulation
+        restarts; see isConverged() */
+    int  maxAccumulation   = 0;
+    bool stopWhenConverged = false;
+    /*! set by renderSamples() once every tile (on every rank) has
+        converged; cleared by the next frame that restarts
+        accumulation */
+    bool allTilesConverged = false;
+    bool isConverged() override
+    {
+      return accumID > 0
+        && ((maxAccumulation > 0 && (int)accumID >= maxAccumulation)
+            || allTilesConverged);
+    }
+
+    /*! primary hit cache (set1i("primaryHitCache"), 0 for off):
+        camera rays only ever get jittered to this many different
+        sub-pixel positions, and once a pixel's generation-0 hit for
+        a given position got traced, later samples at that position
+        re-use it rather than tracing (or, data-parallel, forwarding)
+        that ray again. Cached hits are dropped whenever accumulation
+        restarts, so this needs the app to restart accumulation when
+        anything but the sample count changes; see
+        TiledFB::getPrimaryHitCache() */
+    int  primaryHitCache = 0;
+
     /*! whether to use OptiX AI 2x upscaling. When enabled, tiles
         render at half resolution and the denoiser upscales to the
         full display resolution. Requires denoiser support. */
     bool enableUpscaling = false;
 
+    /*! multi-view rendering (bnRenderMulti()): the context renders
+        all views into one internal frame buffer, with the views'
+        frames stacked on top of each other, viewHeight rows each;
+        every device's tiles (and rays) cover all views. That frame
+        buffer's finalizeFrame() then finalizes every view's frame
+        buffer, which take their pixels - color, normal, and aux
+        channels - from their own rows of it */
+    struct {
+      /*! on the internal frame buffer: the views, their cameras
+          (also on every device, in the PLDs' viewCameras), and the
+          height of each */
+      std::vector<FrameBuffer *> fbs;
+      std::vector<Camera::DD>    cameras;
+      int                        height = 0;
+      /*! on the internal frame buffer: all views' linearized color
+          (float4 or the color format; see gatherView()), normal,
+          and aux channel, on the owner. Only gathered once per
+          frame, by whichever view asks first */
+      void      *color  = 0;
+      vec3f     *normal = 0;
+      void      *aux    = 0;
+      BNDataType colorType = BN_DATA_UNDEFINED;
+      bool       haveNormal = false;
+      uint32_t   auxGathered = 0;
+      BNFrameBufferChannel auxInStaging = (BNFrameBufferChannel)0;
+      /*! on a view: the internal frame buffer it got rendered into
+          (by the latest bnRenderMulti(), null after a bnRender()),
+          and which view it is */
+      FrameBuffer *batch = 0;
+      int          index = 0;
+    } views;
+    /*! makes this (internal) frame buffer render given views with
+        given cameras in the next frame; see views */
+    void setViews(const std::vector<FrameBuffer *> &fbs,
+                  const std::vector<Camera::DD> &cameras);
+    void freeViewStaging();
+    /*! on the internal frame buffer: gathers color (and normal) of
+        all views, unless already done this frame, and copies given
+        view's rows out of it; same semantics as
+        gatherColorChannel() */
+    void gatherView(int view,
+                    void *linearColor,
+                    BNDataType gatherType,
+                    vec3f *linearNormal);
+    /*! same for gatherAuxChannel() and writeAuxChannel() */
+    void gatherViewAux(BNFrameBufferChannel channel);
+    void writeViewAux(int view,
+                      void *stagingArea,
+                      BNFrameBufferChannel channel);
+    /*! gatherColorChannel(), gatherAuxChannel() and
+        writeAuxChannel(), or - for a view of a multi-view frame -
+        their counterparts on the internal frame buffer */
+    void gatherColor(void *linearColor,
+                     BNDataType gatherType,
+                     vec3f *linearNormal);
+    void gatherAux(BNFrameBufferChannel channel);
+    void writeAux(void *stagingArea,
+                  BNFrameBufferChannel channel);
+    /*! sets the channels the upcoming frame produces; restarts
+        accumulation if that newly includes any aux channels */
+    void setActiveChannels(uint32_t active);
+
     /*! how many samples per pixels have already been accumulated in
         this frame buffer's accumulation buffer. Note this is counted
         in *samples*, not *frames*. */
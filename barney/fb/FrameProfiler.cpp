@@ -0,0 +1,133 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/fb/FrameProfiler.h"
+
+namespace BARNEY_NS {
+
+  /*! what each stage's nvtx range gets called */
+  static const char *stageNames[FrameProfiler::NUM_STAGES] = {
+    "generateRays", "traceRays", "forwardRays", "shadeRays",
+    "finalizeTiles", "linearize", "denoise", "readback"
+  };
+
+  FrameProfiler::Scope::Scope(FrameProfiler *profiler,
+                              Stage stage,
+                              int generation,
+                              Device *onlyOn)
+    : nvtx(stageNames[stage],
+           onlyOn ? onlyOn->globalRank() : NvtxRange::NO_DEVICE,
+           generation),
+      profiler(profiler)
+  {
+    if (!profiler) return;
+    first = (int)profiler->ranges.size();
+    for (auto device : *profiler->devices) {
+      if (onlyOn && device != onlyOn) continue;
+      SetActiveGPU forDuration(device);
+      Range range;
+      range.stage      = stage;
+      range.generation = generation;
+      range.device     = device;
+      range.begin      = profiler->getEvent(device);
+      range.end        = profiler->getEvent(device);
+      device->rtc->recordEvent(range.begin);
+      profiler->ranges.push_back(range);
+    }
+    end = (int)profiler->ranges.size();
+  }
+
+  FrameProfiler::Scope::~Scope()
+  {
+    if (!profiler) return;
+    for (int i=first;i<end;i++) {
+      Range &range = profiler->ranges[i];
+      SetActiveGPU forDuration(range.device);
+      range.device->rtc->recordEvent(range.end);
+    }
+  }
+
+  FrameProfiler::FrameProfiler(const DevGroup::SP &devices)
+    : devices(devices)
+  {
+    for (auto device : *devices)
+      pools.push_back({device});
+  }
+
+  FrameProfiler::~FrameProfiler()
+  {
+    for (auto &pool : pools) {
+      SetActiveGPU forDuration(pool.device);
+      for (auto event : pool.events)
+        pool.device->rtc->freeEvent(event);
+    }
+  }
+
+  rtc::Event *FrameProfiler::getEvent(Device *device)
+  {
+    for (auto &pool : pools) {
+      if (pool.device != device) continue;
+      if (pool.numUsed == (int)pool.events.size())
+        pool.events.push_back(device->rtc->createEvent());
+      return pool.events[pool.numUsed++];
+    }
+    throw std::runtime_error("#bn: profiling on unknown device");
+  }
+
+  void FrameProfiler::beginFrame()
+  {
+    ranges.clear();
+    numRays.clear();
+    numGenerations = 0;
+    for (auto &pool : pools)
+      pool.numUsed = 0;
+  }
+
+  void FrameProfiler::setNumRays(int generation, int count)
+  {
+    if (generation >= (int)numRays.size())
+      numRays.resize(generation+1,-1);
+    numRays[generation] = count;
+    numGenerations = std::max(numGenerations,generation+1);
+  }
+
+  void FrameProfiler::getStats(BNFrameStats &stats)
+  {
+    const int maxGens = BN_FRAME_STATS_MAX_GENERATIONS;
+    /* devices work in parallel, so each stage took as long as it
+       took on the slowest device */
+    std::vector<float> perDevice(pools.size()*NUM_STAGES*(maxGens+1),0.f);
+    for (auto &range : ranges) {
+      int poolID = 0;
+      while (pools[poolID].device != range.device) poolID++;
+      int gen = std::min(range.generation,maxGens-1)+1;
+      SetActiveGPU forDuration(range.device);
+      perDevice[(poolID*NUM_STAGES+range.stage)*(maxGens+1)+gen]
+        += range.device->rtc->elapsedTime(range.begin,range.end);
+      if (range.generation >= 0)
+        numGenerations = std::max(numGenerations,range.generation+1);
+    }
+    auto time = [&](int stage, int gen) {
+      float t = 0.f;
+      for (int poolID=0;poolID<(int)pools.size();poolID++)
+        t = std::max(t,perDevice[(poolID*NUM_STAGES+stage)*(maxGens+1)+gen+1]);
+      return t;
+    };
+
+    stats.numGenerations = std::min(numGenerations,maxGens);
+    stats.generateRays   = time(GENERATE_RAYS,-1);
+    stats.finalizeTiles  = time(FINALIZE_TILES,-1);
+    stats.linearize      = time(LINEARIZE,-1);
+    stats.denoise        = time(DENOISE,-1);
+    stats.readback       = time(READBACK,-1);
+    for (int gen=0;gen<maxGens;gen++) {
+      stats.trace[gen]   = time(TRACE,gen);
+      /* forwarding got timed including the local trace(s) */
+      stats.forward[gen] = std::max(0.f,time(FORWARD,gen)-stats.trace[gen]);
+      stats.shade[gen]   = time(SHADE,gen);
+      stats.numRays[gen] = gen < (int)numRays.size() ? numRays[gen] : -1;
+    }
+  }
+
+}
@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/DeviceGroup.h"
+
+namespace BARNEY_NS {
+
+  /*! collects per-stage timings of a frame buffer's most recent
+      frame, using events recorded into the devices' streams (so
+      profiling doesn't add any syncs of its own); those events only
+      get resolved once the app asks for them, through
+      bnFrameBufferGetStats(). Only created if profiling is enabled
+      (BARNEY_CONFIG=profile=1) */
+  struct FrameProfiler {
+    typedef enum {
+      GENERATE_RAYS=0, TRACE, FORWARD, SHADE,
+      FINALIZE_TILES, LINEARIZE, DENOISE, READBACK,
+      NUM_STAGES
+    } Stage;
+
+    /*! records a stage's begin on construction, and its end on
+        destruction; either on a given device, or on all of the
+        profiler's devices. No-op if profiler is null */
+    struct Scope {
+      Scope(FrameProfiler *profiler, Stage stage, int generation = -1,
+            Device *onlyOn = nullptr);
+      ~Scope();
+      /*! there even if this frame buffer doesn't profile; costs
+          (close to) nothing if no tool is listening */
+      NvtxRange nvtx;
+      FrameProfiler *const profiler;
+      int first = 0, end = 0;
+    };
+
+    FrameProfiler(const DevGroup::SP &devices);
+    ~FrameProfiler();
+
+    /*! drops everything recorded for the previous frame */
+    void beginFrame();
+    /*! ray count (across all ranks) after given generation */
+    void setNumRays(int generation, int numRays);
+    /*! waits for all events of the current frame, and fills in
+        stats from those */
+    void getStats(BNFrameStats &stats);
+
+  private:
+    rtc::Event *getEvent(Device *device);
+
+    struct Range {
+      Stage       stage;
+      int         generation;
+      Device     *device;
+      rtc::Event *begin;
+      rtc::Event *end;
+    };
+    std::vector<Range> ranges;
+    std::vector<int>   numRays;
+    int                numGenerations = 0;
+
+    /*! events get re-used from one frame to the next */
+    struct Pool {
+      Device *device;
+      std::vector<rtc::Event *> events;
+      int numUsed = 0;
+    };
+    std::vector<Pool> pools;
+
+    DevGroup::SP const devices;
+  };
+
+}
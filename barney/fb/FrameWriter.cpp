@@ -0,0 +1,260 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/fb/FrameWriter.h"
+#include "barney/fb/FrameBuffer.h"
+#include <fstream>
+
+namespace BARNEY_NS {
+
+  namespace {
+    uint32_t crc32(uint32_t crc, const uint8_t *data, size_t numBytes)
+    {
+      static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i=0;i<256;i++) {
+          uint32_t c = i;
+          for (int k=0;k<8;k++)
+            c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+          t[i] = c;
+        }
+        return t;
+      }();
+      crc = ~crc;
+      for (size_t i=0;i<numBytes;i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+      return ~crc;
+    }
+
+    void putU32BE(std::vector<uint8_t> &out, uint32_t v)
+    {
+      out.push_back(uint8_t(v >> 24));
+      out.push_back(uint8_t(v >> 16));
+      out.push_back(uint8_t(v >>  8));
+      out.push_back(uint8_t(v));
+    }
+
+    void putChunk(std::ostream &out, const char *type,
+                  const std::vector<uint8_t> &data)
+    {
+      std::vector<uint8_t> chunk;
+      putU32BE(chunk,(uint32_t)data.size());
+      chunk.insert(chunk.end(),type,type+4);
+      chunk.insert(chunk.end(),data.begin(),data.end());
+      putU32BE(chunk,crc32(0,chunk.data()+4,chunk.size()-4));
+      out.write((const char *)chunk.data(),chunk.size());
+    }
+
+    /*! rgba8 png, top row first. The image data goes into 'stored'
+        (uncompressed) deflate blocks: offline renders get written far
+        more often than they get read, and this way encoding is no
+        more than a copy */
+    bool writePNG(const std::string &fileName,
+                  const uint8_t *rgba, vec2i size)
+    {
+      std::ofstream out(fileName,std::ios::binary);
+      if (!out) return false;
+      static const uint8_t signature[8]
+        = { 0x89,'P','N','G','\r','\n',0x1a,'\n' };
+      out.write((const char *)signature,sizeof(signature));
+
+      std::vector<uint8_t> header;
+      putU32BE(header,size.x);
+      putU32BE(header,size.y);
+      /* 8 bits per channel, rgba, deflate, no filter, no interlace */
+      header.insert(header.end(),{ 8,6,0,0,0 });
+      putChunk(out,"IHDR",header);
+
+      const size_t rowBytes = 1+size_t(size.x)*4;
+      std::vector<uint8_t> raw(rowBytes*size.y);
+      for (int y=0;y<size.y;y++) {
+        uint8_t *row = raw.data()+y*rowBytes;
+        /* filter type 'none' */
+        row[0] = 0;
+        /* barney's rows go bottom up */
+        memcpy(row+1,rgba+size_t(size.y-1-y)*size.x*4,rowBytes-1);
+      }
+      std::vector<uint8_t> zlib = { 0x78, 0x01 };
+      const size_t maxBlock = 0xffff;
+      size_t begin = 0;
+      do {
+        const size_t len = std::min(maxBlock,raw.size()-begin);
+        const bool   last = begin+len >= raw.size();
+        zlib.insert(zlib.end(),{ uint8_t(last ? 1 : 0),
+                                 uint8_t(len), uint8_t(len >> 8),
+                                 uint8_t(~len), uint8_t(~len >> 8) });
+        zlib.insert(zlib.end(),raw.begin()+begin,raw.begin()+begin+len);
+        begin += len;
+      } while (begin < raw.size());
+      uint32_t a = 1, b = 0;
+      for (auto c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+      }
+      putU32BE(zlib,(b << 16) | a);
+      putChunk(out,"IDAT",zlib);
+      putChunk(out,"IEND",{});
+      return (bool)out;
+    }
+
+    /*! pfm, with numChannels (1 or 3) of each pixel's channelStride
+        floats; pfm's rows go bottom up, same as barney's */
+    bool writePFM(const std::string &fileName,
+                  const float *pixels, vec2i size,
+                  int numChannels, int channelStride)
+    {
+      std::ofstream out(fileName,std::ios::binary);
+      if (!out) return false;
+      out << (numChannels == 3 ? "PF" : "Pf") << "\n"
+          << size.x << " " << size.y << "\n"
+          << "-1.0\n";
+      std::vector<float> row(size_t(size.x)*numChannels);
+      for (int y=0;y<size.y;y++) {
+        for (int x=0;x<size.x;x++)
+          for (int c=0;c<numChannels;c++)
+            row[size_t(x)*numChannels+c]
+              = pixels[(size_t(y)*size.x+x)*channelStride+c];
+        out.write((const char *)row.data(),row.size()*sizeof(float));
+      }
+      return (bool)out;
+    }
+  }
+
+  FrameWriter::FrameWriter(Device *device, int numSlots, int numThreads)
+    : device(device),
+      slots(std::max(numSlots,1))
+  {
+    for (int i=0;i<(int)slots.size();i++)
+      freeSlots.push_back(i);
+    for (int i=0;i<std::max(numThreads,1);i++)
+      threads.emplace_back([this]() { run(); });
+  }
+
+  FrameWriter::~FrameWriter()
+  {
+    flush();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+    cv.notify_all();
+    for (auto &thread : threads)
+      thread.join();
+    for (auto &slot : slots) {
+      if (slot.color) device->rtc->freeHost(slot.color);
+      if (slot.depth) device->rtc->freeHost(slot.depth);
+    }
+  }
+
+  void FrameWriter::reserve(void *&mem, size_t &size, size_t numBytes)
+  {
+    if (size >= numBytes) return;
+    if (mem) device->rtc->freeHost(mem);
+    mem  = device->rtc->allocHost(numBytes);
+    size = numBytes;
+  }
+
+  void FrameWriter::queue(FrameBuffer *fb,
+                          const std::string &baseName,
+                          uint32_t channels)
+  {
+    int slotID;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock,[&]() { return !freeSlots.empty(); });
+      slotID = freeSlots.front();
+      freeSlots.pop_front();
+      ++numBusy;
+    }
+    Slot &slot = slots[slotID];
+    slot.baseName    = baseName;
+    slot.numPixels   = fb->numPixels;
+    slot.colorFormat = fb->colorChannelFormat;
+    slot.channels    = channels & (BN_FB_COLOR|BN_FB_DEPTH);
+    const size_t numPixels = size_t(slot.numPixels.x)*slot.numPixels.y;
+    try {
+      if (slot.channels & BN_FB_COLOR) {
+        reserve(slot.color,slot.colorBytes,
+                numPixels*(slot.colorFormat == BN_FLOAT4
+                           ? sizeof(vec4f) : sizeof(uint32_t)));
+        fb->read(BN_FB_COLOR,slot.color,slot.colorFormat);
+      }
+      if (slot.channels & BN_FB_DEPTH) {
+        void *depth = slot.depth;
+        reserve(depth,slot.depthBytes,numPixels*sizeof(float));
+        slot.depth = (float *)depth;
+        fb->read(BN_FB_DEPTH,slot.depth,BN_FLOAT);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      freeSlots.push_back(slotID);
+      --numBusy;
+      cv.notify_all();
+      throw;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.push_back(slotID);
+    }
+    cv.notify_all();
+  }
+
+  int FrameWriter::flush()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock,[&]() { return numBusy == 0; });
+    int failed = numFailed;
+    numFailed = 0;
+    return failed;
+  }
+
+  void FrameWriter::run()
+  {
+    while (true) {
+      int slotID;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock,[&]() { return quit || !pending.empty(); });
+        if (pending.empty()) return;
+        slotID = pending.front();
+        pending.pop_front();
+      }
+      bool ok = write(slots[slotID]);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ok) ++numFailed;
+        freeSlots.push_back(slotID);
+        --numBusy;
+      }
+      cv.notify_all();
+    }
+  }
+
+  bool FrameWriter::write(const Slot &slot)
+  {
+    bool ok = true;
+    if (slot.channels & BN_FB_COLOR) {
+      const std::string fileName
+        = slot.baseName+(slot.colorFormat == BN_FLOAT4 ? ".pfm" : ".png");
+      bool written
+        = (slot.colorFormat == BN_FLOAT4)
+        ? writePFM(fileName,(const float *)slot.color,slot.numPixels,3,4)
+        : writePNG(fileName,(const uint8_t *)slot.color,slot.numPixels);
+      if (!written)
+        std::cerr << "#bn: could not write frame to '"
+                  << fileName << "'" << std::endl;
+      ok &= written;
+    }
+    if (slot.channels & BN_FB_DEPTH) {
+      const std::string fileName = slot.baseName+"_depth.pfm";
+      bool written = writePFM(fileName,slot.depth,slot.numPixels,1,1);
+      if (!written)
+        std::cerr << "#bn: could not write depth to '"
+                  << fileName << "'" << std::endl;
+      ok &= written;
+    }
+    return ok;
+  }
+
+}
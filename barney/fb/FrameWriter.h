@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/DeviceGroup.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace BARNEY_NS {
+  struct FrameBuffer;
+
+  /*! writes finished frames to disk in the background, for offline
+      (batch) rendering: queue() reads the requested channels of a
+      frame buffer's current frame into one of a ring of pinned host
+      buffers - which is all the render thread has to wait for - and
+      a pool of writer threads encodes and writes them while the next
+      frame renders. If all slots of the ring are still waiting to get
+      written, queue() blocks until one frees up. Color gets written as
+      png (8-bit color formats) or pfm (float color), depth as
+      single-channel pfm. Gets created on a frame buffer's first
+      bnFrameBufferWriteAsync() */
+  struct FrameWriter {
+    FrameWriter(Device *device, int numSlots, int numThreads);
+    /*! finishes writing everything that got queued */
+    ~FrameWriter();
+
+    /*! reads given channels (BN_FB_COLOR and/or BN_FB_DEPTH) of fb's
+        current frame, and queues them for writing to
+        '<baseName>.png' (or '.pfm') and '<baseName>_depth.pfm' */
+    void queue(FrameBuffer *fb, const std::string &baseName,
+               uint32_t channels);
+
+    /*! waits until all queued frames got written; returns how many
+        of them failed to write since the last flush() */
+    int flush();
+
+  private:
+    struct Slot {
+      std::string baseName;
+      vec2i       numPixels   = { 0,0 };
+      BNDataType  colorFormat = BN_DATA_UNDEFINED;
+      uint32_t    channels    = 0;
+      /*! pinned host memory, (re-)allocated as frame sizes change */
+      void       *color       = 0;
+      size_t      colorBytes  = 0;
+      float      *depth       = 0;
+      size_t      depthBytes  = 0;
+    };
+    /*! makes sure given pinned buffer has at least numBytes */
+    void reserve(void *&mem, size_t &size, size_t numBytes);
+    /*! writer thread main loop */
+    void run();
+    /*! encodes and writes one slot's frame; false on any error */
+    bool write(const Slot &slot);
+
+    Device *const device;
+    std::vector<Slot>        slots;
+    std::deque<int>          freeSlots;
+    std::deque<int>          pending;
+    /*! slots queued or being written */
+    int                      numBusy   = 0;
+    int                      numFailed = 0;
+    bool                     quit      = false;
+    std::mutex               mutex;
+    std::condition_variable  cv;
+    std::vector<std::thread> threads;
+  };
+
+}
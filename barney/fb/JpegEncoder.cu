@@ -0,0 +1,120 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/fb/JpegEncoder.h"
+#include "barney/common/math.h"
+#include "rtcore/ComputeInterface.h"
+
+#if BARNEY_HAVE_NVJPEG
+#define BN_NVJPEG_CALL(fctCall)                                         \
+  { nvjpegStatus_t rc = nvjpeg##fctCall;                                \
+    if (rc != NVJPEG_STATUS_SUCCESS)                                    \
+      throw std::runtime_error(std::string("#barney.nvjpeg (@")         \
+                               +__PRETTY_FUNCTION__+") : error #"       \
+                               +std::to_string((int)rc)); }
+#endif
+
+namespace BARNEY_NS {
+
+  /*! splits (rgba8 or float4) color into 8-bit r, g, and b planes;
+      float4 color gets srgb encoded on the way */
+  __rtc_global
+  void _toPlanarRGB8(const rtc::ComputeInterface &ci,
+                     uint8_t    *planes,
+                     const void *color,
+                     BNDataType  colorFormat,
+                     int         numPixels)
+#if !RTC_DEVICE_CODE
+    ;
+#else
+  {
+    int tid = ci.getThreadIdx().x + ci.getBlockIdx().x * ci.getBlockDim().x;
+    if (tid >= numPixels) return;
+    uint32_t rgba
+      = (colorFormat == BN_FLOAT4)
+      ? make_rgba(linear_to_srgb(saturate(((const vec4f *)color)[tid])))
+      : ((const uint32_t *)color)[tid];
+    planes[0*numPixels+tid] = uint8_t((rgba >>  0) & 0xff);
+    planes[1*numPixels+tid] = uint8_t((rgba >>  8) & 0xff);
+    planes[2*numPixels+tid] = uint8_t((rgba >> 16) & 0xff);
+  }
+#endif
+
+  bool JpegEncoder::available()
+  {
+#if BARNEY_HAVE_NVJPEG
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  JpegEncoder::JpegEncoder(Device *device,
+                           vec2i numPixels,
+                           BNDataType colorFormat)
+    : device(device),
+      numPixels(numPixels),
+      colorFormat(colorFormat)
+  {
+#if BARNEY_HAVE_NVJPEG
+    SetActiveGPU forDuration(device);
+    size_t numBytes = size_t(numPixels.x)*numPixels.y;
+    colorStaging
+      = device->rtc->allocMem(numBytes*(colorFormat == BN_FLOAT4
+                                        ? sizeof(vec4f)
+                                        : sizeof(uint32_t)));
+    planes = (uint8_t *)device->rtc->allocMem(3*numBytes);
+    cudaStream_t stream = device->rtc->stream;
+    BN_NVJPEG_CALL(CreateSimple(&handle));
+    BN_NVJPEG_CALL(EncoderStateCreate(handle,&state,stream));
+    BN_NVJPEG_CALL(EncoderParamsCreate(handle,&params,stream));
+    BN_NVJPEG_CALL(EncoderParamsSetSamplingFactors(params,NVJPEG_CSS_420,stream));
+#else
+    throw std::runtime_error("#bn: barney was built without nvjpeg support");
+#endif
+  }
+
+  JpegEncoder::~JpegEncoder()
+  {
+#if BARNEY_HAVE_NVJPEG
+    SetActiveGPU forDuration(device);
+    if (params) nvjpegEncoderParamsDestroy(params);
+    if (state)  nvjpegEncoderStateDestroy(state);
+    if (handle) nvjpegDestroy(handle);
+    device->rtc->freeMem(planes);
+    device->rtc->freeMem(colorStaging);
+#endif
+  }
+
+  void JpegEncoder::encode(int quality)
+  {
+#if BARNEY_HAVE_NVJPEG
+    SetActiveGPU forDuration(device);
+    int numPixelsTotal = numPixels.x*numPixels.y;
+    __rtc_launch(device->rtc,
+                 _toPlanarRGB8,
+                 divRoundUp(numPixelsTotal,1024),1024,
+                 planes,colorStaging,colorFormat,numPixelsTotal);
+
+    cudaStream_t stream = device->rtc->stream;
+    nvjpegImage_t image;
+    memset(&image,0,sizeof(image));
+    for (int c=0;c<3;c++) {
+      image.channel[c] = planes+c*size_t(numPixelsTotal);
+      image.pitch[c]   = numPixels.x;
+    }
+    BN_NVJPEG_CALL(EncoderParamsSetQuality(params,quality,stream));
+    BN_NVJPEG_CALL(EncodeImage(handle,state,params,&image,NVJPEG_INPUT_RGB,
+                               numPixels.x,numPixels.y,stream));
+    size_t length = 0;
+    BN_NVJPEG_CALL(EncodeRetrieveBitstream(handle,state,nullptr,&length,stream));
+    bitstream.resize(length);
+    BN_NVJPEG_CALL(EncodeRetrieveBitstream(handle,state,bitstream.data(),
+                                           &length,stream));
+    device->rtc->sync();
+    bitstream.resize(length);
+#endif
+  }
+
+}
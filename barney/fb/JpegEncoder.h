@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/DeviceGroup.h"
+#if BARNEY_HAVE_NVJPEG
+# include <nvjpeg.h>
+#endif
+
+namespace BARNEY_NS {
+
+  /*! encodes a frame's final color into a jpeg bitstream on the gpu
+      (through nvjpeg), so apps that stream frames to remote viewers
+      don't need a full-resolution readback and a cpu-side encode. Only
+      gets created for frame buffers that got resized with the
+      BN_FB_COLOR_JPEG channel, and only if barney was built with
+      BARNEY_NVJPEG */
+  struct JpegEncoder {
+    JpegEncoder(Device *device, vec2i numPixels, BNDataType colorFormat);
+    ~JpegEncoder();
+
+    /*! whether this build of barney can encode at all */
+    static bool available();
+
+    /*! encodes whatever is in colorStaging into 'bitstream' */
+    void encode(int quality);
+
+    Device     *const device;
+    vec2i       const numPixels;
+    BNDataType  const colorFormat;
+
+    /*! device memory that the final color gets read into (in
+        colorFormat) before encoding */
+    void *colorStaging = 0;
+
+    /*! the most recently encoded frame */
+    std::vector<uint8_t> bitstream;
+    
+  private:
+    /*! 8-bit r, g, and b planes - which is what nvjpeg takes */
+    uint8_t *planes = 0;
+#if BARNEY_HAVE_NVJPEG
+    nvjpegHandle_t        handle = 0;
+    nvjpegEncoderState_t  state  = 0;
+    nvjpegEncoderParams_t params = 0;
+#endif
+  };
+
+}
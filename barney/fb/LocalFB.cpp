@@ -9,20 +9,48 @@ namespace BARNEY_NS {
   LocalFB::LocalFB(Context *context,
                    const DevGroup::SP &devices)
     : FrameBuffer(context, devices, true)
-  {}
+  {
+    sampleParallel
+      = FromEnv::enabled("sampleParallel")
+      && devices->size() > 1
+      && context->havePeerAccess;
+  }
 
   void LocalFB::resize(BNDataType colorFormat,
                        vec2i size,
                        uint32_t channels)
   {
-    Device *frontDev = getDenoiserDevice();
     for (auto device : *devices) {
       auto devFB = getFor(device);
     }
     
-    auto rtc = frontDev->rtc;
     FrameBuffer::resize(colorFormat,size,channels);
-    
+    gatherTileDescs();
+
+    if (sampleParallel) {
+      Device *owner = getDenoiserDevice();
+      SetActiveGPU forDuration(owner);
+      MemoryScope memScope(owner,BN_MEMORY_FRAME_BUFFERS);
+      if (sampleSumTiles)
+        owner->rtc->freeMem(sampleSumTiles);
+      if (!sampleSumDone)
+        sampleSumDone = owner->rtc->createEvent();
+      sampleSumTiles
+        = (AccumTile *)owner->rtc->allocMem
+        (getFor(owner)->numActiveTilesThisGPU*sizeof(AccumTile));
+    }
+  }
+
+  void LocalFB::tileAssignmentChanged()
+  {
+    gatherTileDescs();
+  }
+
+  void LocalFB::gatherTileDescs()
+  {
+    Device *frontDev = getDenoiserDevice();
+    MemoryScope memScope(frontDev,BN_MEMORY_FRAME_BUFFERS);
+    auto rtc = frontDev->rtc;
     if (onOwner.tileDescs)
       rtc->freeMem(onOwner.tileDescs);
 
@@ -48,9 +76,35 @@ namespace BARNEY_NS {
   
   LocalFB::~LocalFB()
   {
+    for (auto &done : gatherDone)
+      if (done.second) done.first->rtc->freeEvent(done.second);
     auto frontDev = getDenoiserDevice();
     SetActiveGPU forDuration(frontDev);
     frontDev->rtc->freeMem(onOwner.tileDescs);
+    if (sampleSumTiles)
+      frontDev->rtc->freeMem(sampleSumTiles);
+    if (sampleSumDone)
+      frontDev->rtc->freeEvent(sampleSumDone);
+  }
+
+  void LocalFB::ownerWaitsForGather()
+  {
+    Device *owner = getDenoiserDevice();
+    for (int i=0;i<(int)devices->size();i++) {
+      Device *device = (*devices)[i];
+      /* without peer access, tiles get linearized on the app device */
+      Device *writer = getFor(device)->appDevice;
+      if (!writer) writer = device;
+      if (writer == owner) continue;
+      gatherDone.resize(devices->size(),{nullptr,nullptr});
+      auto &done = gatherDone[i];
+      if (done.first != writer) {
+        if (done.second) done.first->rtc->freeEvent(done.second);
+        done = { writer,writer->rtc->createEvent() };
+      }
+      writer->rtc->recordEvent(done.second);
+      owner->rtc->streamWaitEvent(done.second);
+    }
   }
 
   /*! gather color (and optionally, if not null) linear normal, from
@@ -61,12 +115,40 @@ namespace BARNEY_NS {
                                    BNDataType gatherType,
                                    vec3f *linearNormal)
   {
-    float accumScale = 1.f/accumID;
+    float accumScale = getAccumScale();
+    if (sampleParallel) {
+      /* every device has all tiles, with samples of its own: sum
+         them (straight from the other devices' memory) on the
+         owner, and linearize that */
+      Device  *owner   = getDenoiserDevice();
+      TiledFB *ownerFB = getFor(owner);
+      const int numTiles = ownerFB->numActiveTilesThisGPU;
+      ownerWaitsForGather();
+      owner->rtc->copyAsync(sampleSumTiles,ownerFB->accumTiles,
+                            numTiles*sizeof(AccumTile));
+      for (auto device : *devices)
+        if (device != owner)
+          TiledFB::addAccumTiles(owner,sampleSumTiles,
+                                 getFor(device)->accumTiles,numTiles);
+      TiledFB::linearizeColorAndNormalTiles(owner,linearColor,gatherType,
+                                            linearNormal,
+                                            accumScale/devices->size(),
+                                            sampleSumTiles,
+                                            ownerFB->tileDescs,
+                                            numTiles,
+                                            ownerFB->numPixels);
+      owner->rtc->recordEvent(sampleSumDone);
+      for (auto device : *devices)
+        if (device != owner)
+          device->rtc->streamWaitEvent(sampleSumDone);
+      return;
+    }
     for (auto device : *devices) {
       auto tfb = getFor(device);
       tfb->linearizeColorAndNormal
         (linearColor,gatherType,linearNormal,accumScale);
     }
+    ownerWaitsForGather();
   }
 
   /*! read one of the auxiliary (not color or normal) buffers into
@@ -82,6 +164,13 @@ namespace BARNEY_NS {
   void LocalFB::writeAuxChannel(void *stagingArea,
                                 BNFrameBufferChannel whichChannel) 
   {
+    if (sampleParallel) {
+      /* all devices have all pixels; the owner's will do */
+      Device *owner = getDenoiserDevice();
+      getFor(owner)->linearizeAuxChannel(stagingArea,whichChannel);
+      owner->sync();
+      return;
+    }
     for (auto device : *devices)
       getFor(device)->linearizeAuxChannel(stagingArea,whichChannel);
     for (auto device : *devices)
@@ -49,6 +49,29 @@ namespace BARNEY_NS {
     void writeAuxChannel(void *stagingArea,
                           BNFrameBufferChannel channel) override;
 
+    /*! re-collects all gpus' tile descs after tiles got re-balanced */
+    void tileAssignmentChanged() override;
+
+    /*! (re-)collects all gpus' tile descs into onOwner.tileDescs */
+    void gatherTileDescs();
+
+    /*! makes the owner's stream wait for the linearization work just
+        enqueued on all other devices, without blocking the host; so
+        all devices write their tiles into the owner's linear buffers
+        concurrently, and only the owner's next use waits for all of
+        them */
+    void ownerWaitsForGather();
+    /*! one per device, with the device that created (and records)
+        it; see ownerWaitsForGather() */
+    std::vector<std::pair<Device *,rtc::Event *>> gatherDone;
+
+    /*! with sampleParallel: where the owner sums all devices'
+        accumulated tiles (in the order of its own tiles), and the
+        event the other devices wait for before they may touch
+        their tiles again */
+    AccumTile  *sampleSumTiles = 0;
+    rtc::Event *sampleSumDone  = 0;
+
     struct {
       /*! _all_ tile descriptors across all GPUs - either all GPUs in
         single node (if run non-mpi) or across all nodes */
@@ -6,6 +6,7 @@
 #include "barney/fb/FrameBuffer.h"
 #include "barney/common/math.h"
 #include "rtcore/ComputeInterface.h"
+#include <algorithm>
 
 namespace BARNEY_NS {
 
@@ -33,7 +34,7 @@ namespace BARNEY_NS {
     if (iy >= numPixels.y) return;
     int idx = ix + numPixels.x*iy;
 
-    vec4f color = tile->accum[subIdx] * accumScale;
+    vec4f color = vec4f(tile->accum[subIdx]) * accumScale;
 
     if (colorFormat == BN_FLOAT4) {
       ((vec4f*)out_rgba)[idx] = color;
@@ -46,7 +47,7 @@ namespace BARNEY_NS {
       ;
     
     if (out_normal)
-      out_normal[idx] = tile->normal[subIdx];
+      out_normal[idx] = tile->normal[subIdx].get();
   }
   
 
@@ -62,27 +63,76 @@ namespace BARNEY_NS {
                                         float  accumScale)
   {
     SetActiveGPU forDuration(appDevice?appDevice:device);
-    if (appDevice) {
+    if (appDevice)
+      /* same stream as the linearization below, so no need to wait
+         for it on the host */
       appDevice->rtc->copyAsync(appAccumTiles,accumTiles,
                                 numActiveTilesThisGPU*sizeof(*appAccumTiles));
-      appDevice->rtc->sync();
-    }
+    linearizeColorAndNormalTiles(appDevice?appDevice:device,
+                                 linearColor,
+                                 colorFormat,
+                                 linearNormal,
+                                 accumScale,
+                                 appDevice?appAccumTiles:accumTiles,
+                                 appDevice?appTileDescs:tileDescs,
+                                 numActiveTilesThisGPU,
+                                 numPixels);
+  }
+
+  void TiledFB::linearizeColorAndNormalTiles(Device     *device,
+                                             void       *linearColor,
+                                             BNDataType  colorFormat,
+                                             vec3f      *linearNormal,
+                                             float       accumScale,
+                                             AccumTile  *tilesIn,
+                                             TileDesc   *descsIn,
+                                             int         numTiles,
+                                             vec2i       numPixels)
+  {
+    if (numTiles == 0) return;
+    SetActiveGPU forDuration(device);
     __rtc_launch(// device
-                 (appDevice?appDevice:device)->rtc,
+                 device->rtc,
                  // kernel
                  linearizeColorAndNormalKernel,
                  // launch config
-                 numActiveTilesThisGPU,pixelsPerTile,
+                 numTiles,pixelsPerTile,
                  // args
                  linearColor,
                  colorFormat,
                  linearNormal,
                  accumScale,
-                 appDevice?appTileDescs:tileDescs,
-                 appDevice?appAccumTiles:accumTiles,
+                 descsIn,
+                 tilesIn,
                  numPixels);
   }
 
+  __rtc_global
+  void addAccumTilesKernel(rtc::ComputeInterface ci,
+                           AccumTile       *sum,
+                           const AccumTile *tiles)
+  {
+    int tileIdx = ci.getBlockIdx().x;
+    int subIdx  = ci.getThreadIdx().x;
+    sum[tileIdx].accum[subIdx]
+      = vec4f(sum[tileIdx].accum[subIdx])
+      + vec4f(tiles[tileIdx].accum[subIdx]);
+  }
+
+  void TiledFB::addAccumTiles(Device          *device,
+                              AccumTile       *sum,
+                              const AccumTile *tiles,
+                              int              numTiles)
+  {
+    if (numTiles == 0) return;
+    SetActiveGPU forDuration(device);
+    __rtc_launch(device->rtc,
+                 addAccumTilesKernel,
+                 numTiles,pixelsPerTile,
+                 sum,
+                 tiles);
+  }
+
 
 
   __rtc_global void linearizeAuxTilesKernel(rtc::ComputeInterface ci,
@@ -154,6 +204,10 @@ namespace BARNEY_NS {
       tgt_aux = appDevice?appAuxTiles.objID:auxTiles.objID;
       loc_aux = auxTiles.objID;
       break;
+    case BN_FB_COST:
+      tgt_aux = appDevice?appAuxTiles.cost:auxTiles.cost;
+      loc_aux = auxTiles.cost;
+      break;
     default:
       throw std::runtime_error("unsupported aux channel in sending aux!?");
     };
@@ -202,6 +256,12 @@ namespace BARNEY_NS {
   }
   
   void TiledFB::free()
+  {
+    freeTileState();
+    freeTiles();
+  }
+
+  void TiledFB::freeTiles()
   {
     SetActiveGPU forDuration(device);
     freeAndSetNull(device,tileDescs);
@@ -210,6 +270,7 @@ namespace BARNEY_NS {
     freeAndSetNull(device,auxTiles.instID);
     freeAndSetNull(device,auxTiles.objID);
     freeAndSetNull(device,auxTiles.depth);
+    freeAndSetNull(device,auxTiles.cost);
 
     if (appDevice) {
       SetActiveGPU forDuration(appDevice);
@@ -219,97 +280,765 @@ namespace BARNEY_NS {
       freeAndSetNull(appDevice,appAuxTiles.instID);
       freeAndSetNull(appDevice,appAuxTiles.objID);
       freeAndSetNull(appDevice,appAuxTiles.depth);
+      freeAndSetNull(appDevice,appAuxTiles.cost);
+    }
+    tileCapacity = 0;
+  }
+  
+  void TiledFB::freeTileState()
+  {
+    SetActiveGPU forDuration(device);
+    freeAndSetNull(device,convergenceTiles);
+    freeAndSetNull(device,numConvergedTiles);
+    freeAndSetNull(device,tileCosts);
+    freeAndSetNull(device,samplePeriods);
+    freeAndSetNull(device,sampleWeights);
+    freeAndSetNull(device,reservoirTiles[0]);
+    freeAndSetNull(device,reservoirTiles[1]);
+    freeAndSetNull(device,localTileOf);
+    haveReservoirCamera = false;
+    freeAndSetNull(device,historyTiles[0]);
+    freeAndSetNull(device,historyTiles[1]);
+    haveHistory = false;
+    freeAndSetNull(device,primaryHits);
+    freeAndSetNull(device,primaryHitValid);
+    numPrimaryJitters = 0;
+  }
+
+  ConvergenceTile *TiledFB::getConvergenceTiles()
+  {
+    if (!convergenceTiles) {
+      SetActiveGPU forDuration(device);
+      MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+      convergenceTiles
+        = (ConvergenceTile *)device->rtc->allocMem
+        (numActiveTilesThisGPU*sizeof(ConvergenceTile));
+      resetConvergence();
+    }
+    return convergenceTiles;
+  }
+
+  ReservoirTiles TiledFB::getReservoirTiles()
+  {
+    if (!reservoirTiles[0]) {
+      SetActiveGPU forDuration(device);
+      MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+      size_t numBytes = numActiveTilesThisGPU*sizeof(ReservoirTile);
+      for (int i=0;i<2;i++) {
+        reservoirTiles[i] = (ReservoirTile *)device->rtc->allocMem(numBytes);
+        device->rtc->memsetAsync(reservoirTiles[i],0,numBytes);
+      }
+      haveReservoirCamera = false;
+    }
+    ReservoirTiles rt;
+    rt.prev        = reservoirTiles[0];
+    rt.curr        = reservoirTiles[1];
+    rt.localTileOf = getLocalTileOf();
+    rt.tileDescs   = tileDescs;
+    rt.numTiles    = numTiles;
+    rt.numPixels   = numPixels;
+    rt.prevCamera  = reservoirCamera;
+    rt.havePrev    = haveReservoirCamera;
+    return rt;
+  }
+
+  PrimaryHitCache TiledFB::getPrimaryHitCache(int numJitters)
+  {
+    if (numJitters != numPrimaryJitters) {
+      SetActiveGPU forDuration(device);
+      MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+      freeAndSetNull(device,primaryHits);
+      freeAndSetNull(device,primaryHitValid);
+      size_t numEntries
+        = size_t(numActiveTilesThisGPU)*pixelsPerTile*numJitters;
+      primaryHits
+        = (render::HitOnly *)device->rtc->allocMem
+        (numEntries*sizeof(render::HitOnly));
+      primaryHitValid
+        = (int *)device->rtc->allocMem(numEntries*sizeof(int));
+      numPrimaryJitters = numJitters;
+      resetPrimaryHitCache();
+    }
+    PrimaryHitCache cache;
+    cache.hits       = primaryHits;
+    cache.valid      = primaryHitValid;
+    cache.numJitters = numPrimaryJitters;
+    return cache;
+  }
+
+  void TiledFB::resetPrimaryHitCache()
+  {
+    if (!primaryHitValid) return;
+    SetActiveGPU forDuration(device);
+    device->rtc->memsetAsync(primaryHitValid,0,
+                             size_t(numActiveTilesThisGPU)*pixelsPerTile
+                             *numPrimaryJitters*sizeof(int));
+  }
+
+  const int *TiledFB::getLocalTileOf()
+  {
+    if (!localTileOf) {
+      SetActiveGPU forDuration(device);
+      MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+      std::vector<int> localOf(numTiles.x*numTiles.y,-1);
+      for (int i=0;i<(int)assignedTileIDs.size();i++)
+        localOf[assignedTileIDs[i]] = i;
+      localTileOf = (int *)device->rtc->allocMem(localOf.size()*sizeof(int));
+      device->rtc->copyAsync(localTileOf,localOf.data(),
+                             localOf.size()*sizeof(int));
+      /* host-side table goes out of scope */
+      device->rtc->sync();
     }
+    return localTileOf;
+  }
+
+  void TiledFB::swapReservoirs(const Camera::DD &camera)
+  {
+    if (!reservoirTiles[0]) return;
+    std::swap(reservoirTiles[0],reservoirTiles[1]);
+    reservoirCamera     = camera;
+    haveReservoirCamera = true;
   }
 
+  /*! per pixel: finds where this frame's (first sample's) primary
+      hit was seen in the previous frame, and if that's the same
+      surface there, blends that pixel's history into this one's
+      accumulated values. Writes this pixel's new history either way;
+      a null prevHistory just does the latter */
   __rtc_global
-  void setTileCoordsKernel(rtc::ComputeInterface ci,
-                           TileDesc *tileDescs,
-                           int numActiveTiles,
-                           vec2i numTiles,
-                           int globalIndex,
-                           int globalIndexStep)
+  void reprojectHistoryKernel(rtc::ComputeInterface ci,
+                              AccumTile         *tiles,
+                              AuxTiles           auxTiles,
+                              const TileDesc    *descs,
+                              vec2i              numPixels,
+                              vec2i              numTiles,
+                              Camera::DD         camera,
+                              Camera::DD         prevCamera,
+                              const HistoryTile *prevHistory,
+                              const int         *localTileOf,
+                              HistoryTile       *history,
+                              int                numSamples,
+                              float              accumScale,
+                              int                maxHistory,
+                              bool               restarted)
   {
-    int tid = ci.launchIndex().x;
-    if (tid >= numActiveTiles) return;
+    int tileIdx = ci.getBlockIdx().x;
+    int subIdx  = ci.getThreadIdx().x;
+    TileDesc desc = descs[tileIdx];
+    vec2i pixel(desc.lower.x + (subIdx % tileSize),
+                desc.lower.y + (subIdx / tileSize));
+    if (pixel.x >= numPixels.x) return;
+    if (pixel.y >= numPixels.y) return;
+
+    AccumValue &accum = tiles[tileIdx].accum[subIdx];
+    HistoryPixel &out = history[tileIdx].pixel[subIdx];
+    vec4f color = vec4f(accum) * accumScale;
+    if (!restarted) {
+      /* still accumulating on top of what the last restart blended
+         in; only the color and its worth change */
+      out.color = color;
+      out.count = min(float(maxHistory),numSamples+out.reprojected);
+      return;
+    }
+
+    float depth = auxTiles.depth[tileIdx].f[subIdx];
+    bool  isHit = depth < 1e20f;
+    vec3f P
+      = camera.perspective.lens_00
+      + depth * camera.centerRayDir(pixel,numPixels);
+    vec3f N = tiles[tileIdx].normal[subIdx].get();
+    uint32_t primID = auxTiles.primID[tileIdx].ui[subIdx];
+    uint32_t instID = auxTiles.instID[tileIdx].ui[subIdx];
+
+    float reprojected = 0.f;
+    vec2i prevPixel;
+    if (isHit && prevHistory && prevCamera.project(P,numPixels,prevPixel)) {
+      int frameTile
+        = prevPixel.x/tileSize
+        + (prevPixel.y/tileSize)*numTiles.x;
+      int localTile = localTileOf[frameTile];
+      if (localTile >= 0) {
+        vec2i ofs = prevPixel - descs[localTile].lower;
+        const HistoryPixel &h
+          = prevHistory[localTile].pixel[ofs.x+ofs.y*tileSize];
+        bool sameSurface
+          =  h.count > 0.f
+          && h.primID == primID
+          && h.instID == instID
+          && dot(h.N.get(),N) > .9f
+          && length(h.P-P) < .01f*depth;
+        if (sameSurface) {
+          reprojected = min(h.count,float(maxHistory));
+          color
+            = (reprojected*h.color + float(numSamples)*color)
+            * (1.f/(reprojected+numSamples));
+          accum = color * (1.f/accumScale);
+        }
+      }
+    }
+
+    out.color       = color;
+    out.P           = P;
+    out.N.set(N);
+    out.primID      = primID;
+    out.instID      = instID;
+    out.reprojected = reprojected;
+    out.count
+      = isHit
+      ? min(float(maxHistory),numSamples+reprojected)
+      : 0.f;
+  }
+
+  void TiledFB::reprojectHistory(const Camera::DD &camera,
+                                 bool restarted,
+                                 int numSamples,
+                                 float accumScale,
+                                 int maxHistory)
+  {
+    if (numActiveTilesThisGPU == 0) return;
+    if (!auxTiles.depth || !auxTiles.primID || !auxTiles.instID
+        || camera.type != Camera::PERSPECTIVE) {
+      haveHistory = false;
+      return;
+    }
+    SetActiveGPU forDuration(device);
+    MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+    if (!historyTiles[0]) {
+      size_t numBytes = numActiveTilesThisGPU*sizeof(HistoryTile);
+      for (int i=0;i<2;i++) {
+        historyTiles[i] = (HistoryTile *)device->rtc->allocMem(numBytes);
+        device->rtc->memsetAsync(historyTiles[i],0,numBytes);
+      }
+      haveHistory = false;
+    }
+    /* only a restart reads the previous history (at other pixels),
+       so only then does the new one have to go elsewhere; otherwise
+       every pixel updates its own */
+    if (!haveHistory)
+      restarted = true;
+    __rtc_launch(//device
+                 device->rtc,
+                 // kernel
+                 reprojectHistoryKernel,
+                 // launch config
+                 numActiveTilesThisGPU,pixelsPerTile,
+                 // args
+                 accumTiles,
+                 auxTiles,
+                 tileDescs,
+                 numPixels,
+                 numTiles,
+                 camera,
+                 historyCamera,
+                 (const HistoryTile *)(haveHistory ? historyTiles[0] : 0),
+                 getLocalTileOf(),
+                 restarted ? historyTiles[1] : historyTiles[0],
+                 numSamples,
+                 accumScale,
+                 maxHistory,
+                 restarted);
+    if (restarted)
+      std::swap(historyTiles[0],historyTiles[1]);
+    historyCamera = camera;
+    haveHistory   = true;
+  }
+
+  int *TiledFB::getTileCosts()
+  {
+    if (!tileCosts) {
+      SetActiveGPU forDuration(device);
+      MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+      tileCosts
+        = (int *)device->rtc->allocMem
+        (numActiveTilesThisGPU*sizeof(int));
+      resetTileCosts();
+    }
+    return tileCosts;
+  }
+
+  void TiledFB::resetTileCosts()
+  {
+    if (!tileCosts) return;
+    SetActiveGPU forDuration(device);
+    device->rtc->memsetAsync(tileCosts,0,
+                             numActiveTilesThisGPU*sizeof(int));
+  }
+
+  void TiledFB::resetPixelCosts()
+  {
+    if (!auxTiles.cost) return;
+    SetActiveGPU forDuration(device);
+    device->rtc->memsetAsync(auxTiles.cost,0,
+                             numActiveTilesThisGPU*sizeof(*auxTiles.cost));
+  }
+
+  std::vector<int> TiledFB::readTileCosts()
+  {
+    std::vector<int> costs(numActiveTilesThisGPU,0);
+    if (!tileCosts || costs.empty()) return costs;
+    SetActiveGPU forDuration(device);
+    device->rtc->copyAsync(costs.data(),tileCosts,
+                           numActiveTilesThisGPU*sizeof(int));
+    device->rtc->sync();
+    return costs;
+  }
+
+  void TiledFB::resetConvergence()
+  {
+    if (!convergenceTiles) return;
+    SetActiveGPU forDuration(device);
+    device->rtc->memsetAsync(convergenceTiles,0,
+                             numActiveTilesThisGPU*sizeof(ConvergenceTile));
+  }
+
+  /*! per pixel: either scale up a converged tile's accumulated
+      values, or add this pixel's error estimate to its tile's
+      error sum */
+  __rtc_global
+  void accumulateTileErrorKernel(rtc::ComputeInterface ci,
+                                 ConvergenceTile *convergence,
+                                 AccumTile *tiles,
+                                 TileDesc  *descs,
+                                 vec2i      numPixels,
+                                 int        numSamplesBefore,
+                                 int        numSamplesAfter)
+  {
+    int tileIdx = ci.getBlockIdx().x;
+    int subIdx  = ci.getThreadIdx().x;
+    ConvergenceTile &ct = convergence[tileIdx];
+    AccumValue &accum = tiles[tileIdx].accum[subIdx];
     
-    int tileID = tid * globalIndexStep + globalIndex;
+    if (ct.converged) {
+#if !BARNEY_HALF_ACCUM
+      float scale = numSamplesAfter / float(numSamplesBefore);
+      accum = vec4f(accum) * scale;
+      ct.oddLuminance[subIdx] *= scale;
+#endif
+      return;
+    }
     
-    int tile_x = tileID % numTiles.x;
-    int tile_y = tileID / numTiles.x;
-    tileDescs[tid].lower = vec2i(tile_x*tileSize,tile_y*tileSize);
+    TileDesc desc = descs[tileIdx];
+    int ix = desc.lower.x + (subIdx % tileSize);
+    int iy = desc.lower.y + (subIdx / tileSize);
+    if (ix >= numPixels.x) return;
+    if (iy >= numPixels.y) return;
+
+    int numOddSamples = numSamplesAfter / 2;
+    if (numOddSamples == 0) return;
+    
+    vec4f c = accum;
+    float allAvg = (0.212671f*c.x + 0.715160f*c.y + 0.072169f*c.z);
+#if !BARNEY_HALF_ACCUM
+    allAvg /= numSamplesAfter;
+#endif
+    float oddAvg = ct.oddLuminance[subIdx] / numOddSamples;
+    float error  = fabsf(allAvg-oddAvg) / sqrtf(fmaxf(allAvg,1e-4f));
+    ci.atomicAdd(&ct.errorSum,error);
+    ci.atomicAdd(&ct.numValidPixels,1);
+  }
+
+  /*! per tile: turn the error sum into the tile's error, and
+      decide whether it has converged */
+  __rtc_global
+  void updateConvergenceKernel(rtc::ComputeInterface ci,
+                               ConvergenceTile *convergence,
+                               int numTiles,
+                               int numSamplesAfter,
+                               float threshold,
+                               int minSamples,
+                               int *numConverged)
+  {
+    int tid = ci.launchIndex().x;
+    if (tid >= numTiles) return;
+    ConvergenceTile &ct = convergence[tid];
+    if (!ct.converged) {
+      if (ct.numValidPixels > 0)
+        ct.error = ct.errorSum / ct.numValidPixels;
+      ct.converged
+        = (numSamplesAfter >= minSamples)
+        && (ct.numValidPixels > 0)
+        && (ct.error < threshold);
+      ct.errorSum = 0.f;
+      ct.numValidPixels = 0;
+    }
+    if (ct.converged)
+      ci.atomicAdd(numConverged,1);
+  }
+
+  void TiledFB::updateConvergence(int numSamplesBefore,
+                                  int numSamplesAfter,
+                                  float threshold,
+                                  int minSamples)
+  {
+    if (numActiveTilesThisGPU == 0) return;
+    SetActiveGPU forDuration(device);
+    __rtc_launch(//device
+                 device->rtc,
+                 // kernel
+                 accumulateTileErrorKernel,
+                 // launch config
+                 numActiveTilesThisGPU,pixelsPerTile,
+                 // args
+                 getConvergenceTiles(),
+                 accumTiles,
+                 tileDescs,
+                 numPixels,
+                 numSamplesBefore,
+                 numSamplesAfter);
+    if (!numConvergedTiles) {
+      MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+      numConvergedTiles = (int *)device->rtc->allocMem(sizeof(int));
+    }
+    device->rtc->memsetAsync(numConvergedTiles,0,sizeof(int));
+    __rtc_launch(//device
+                 device->rtc,
+                 // kernel
+                 updateConvergenceKernel,
+                 // launch config
+                 divRoundUp(numActiveTilesThisGPU,128),128,
+                 // args
+                 getConvergenceTiles(),
+                 numActiveTilesThisGPU,
+                 numSamplesAfter,
+                 threshold,
+                 minSamples,
+                 numConvergedTiles);
+  }
+
+  int TiledFB::readNumConvergedTiles()
+  {
+    int count = 0;
+    if (!numConvergedTiles) return count;
+    SetActiveGPU forDuration(device);
+    device->rtc->copyAsync(&count,numConvergedTiles,sizeof(int));
+    device->rtc->sync();
+    return count;
+  }
+
+  void TiledFB::setSamplePeriods(const std::vector<int> &periodOfTile)
+  {
+    SetActiveGPU forDuration(device);
+    MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+    freeAndSetNull(device,samplePeriods);
+    if (periodOfTile.empty() || numActiveTilesThisGPU == 0) return;
+
+    std::vector<int> periods(numActiveTilesThisGPU);
+    for (int i=0;i<numActiveTilesThisGPU;i++)
+      periods[i] = std::max(1,periodOfTile[assignedTileIDs[i]]);
+    samplePeriods
+      = (int *)device->rtc->allocMem(numActiveTilesThisGPU*sizeof(int));
+    device->rtc->copy(samplePeriods,periods.data(),
+                      numActiveTilesThisGPU*sizeof(int));
+  }
+
+  /*! per pixel of a tile that only got every period'th of the
+      numSamples samples: convert between the (scaled-up) values the
+      frame buffer divides by numSamples, and plain sums */
+  __rtc_global
+  void scaleSparseTilesKernel(rtc::ComputeInterface ci,
+                              AccumTile *tiles,
+                              const int *samplePeriods,
+                              int        numSamples,
+                              bool       toSums)
+  {
+    int tileIdx = ci.getBlockIdx().x;
+    int subIdx  = ci.getThreadIdx().x;
+    int period  = samplePeriods[tileIdx];
+    if (period <= 1) return;
+
+    int   numTaken = (numSamples+period-1)/period;
+    float scale
+      = toSums
+      ? numTaken / float(numSamples)
+      : numSamples / float(numTaken);
+    AccumValue &accum = tiles[tileIdx].accum[subIdx];
+    accum = vec4f(accum) * scale;
+  }
+
+  void TiledFB::scaleSparseTiles(int numSamples, bool toSums)
+  {
+#if BARNEY_HALF_ACCUM
+    /* tiles hold per-tile averages; beginAccumulation() already
+       takes care of sparse tiles */
+    return;
+#endif
+    if (!samplePeriods || numSamples <= 0) return;
+    SetActiveGPU forDuration(device);
+    __rtc_launch(//device
+                 device->rtc,
+                 // kernel
+                 scaleSparseTilesKernel,
+                 // launch config
+                 numActiveTilesThisGPU,pixelsPerTile,
+                 // args
+                 accumTiles,
+                 samplePeriods,
+                 numSamples,
+                 toSums);
+  }
+
+#if BARNEY_HALF_ACCUM
+  /*! per pixel: scale a tile's running averages down to make room
+      for this frame's samples, and (on thread 0) store what each of
+      those samples weighs */
+  __rtc_global
+  void beginAccumulationKernel(rtc::ComputeInterface ci,
+                               AccumTile *tiles,
+                               float     *sampleWeights,
+                               const int *samplePeriods,
+                               const ConvergenceTile *convergence,
+                               int        numSamplesBefore,
+                               int        numSamplesAfter)
+  {
+    int tileIdx = ci.getBlockIdx().x;
+    int subIdx  = ci.getThreadIdx().x;
+    /* converged tiles don't get any new samples */
+    if (convergence && convergence[tileIdx].converged) return;
+
+    int period = samplePeriods ? samplePeriods[tileIdx] : 1;
+    int before = (numSamplesBefore+period-1)/period;
+    int after  = (numSamplesAfter+period-1)/period;
+    if (after <= before) return;
+    if (subIdx == 0)
+      sampleWeights[tileIdx] = 1.f/after;
+    if (before == 0) return;
+    AccumValue &accum = tiles[tileIdx].accum[subIdx];
+    accum = vec4f(accum) * (before/float(after));
+  }
+#endif
+
+  void TiledFB::beginAccumulation(int numSamplesBefore,
+                                  int numSamplesAfter,
+                                  bool adaptive)
+  {
+    /* by now this frame's tiles are in use; trim before the next */
+    if (++framesSinceResize == trimAfterFrames)
+      trimPending = true;
+#if BARNEY_HALF_ACCUM
+    if (numActiveTilesThisGPU == 0) return;
+    SetActiveGPU forDuration(device);
+    MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+    if (!sampleWeights)
+      sampleWeights
+        = (float *)device->rtc->allocMem(numActiveTilesThisGPU*sizeof(float));
+    __rtc_launch(//device
+                 device->rtc,
+                 // kernel
+                 beginAccumulationKernel,
+                 // launch config
+                 numActiveTilesThisGPU,pixelsPerTile,
+                 // args
+                 accumTiles,
+                 sampleWeights,
+                 samplePeriods,
+                 adaptive ? getConvergenceTiles() : nullptr,
+                 numSamplesBefore,
+                 numSamplesAfter);
+#endif
+  }
+
+  /*! position of tile (x,y) along a hilbert curve over an n*n grid
+      (n a power of two) */
+  static uint64_t hilbertIndex(int n, int x, int y)
+  {
+    uint64_t d = 0;
+    for (int s=n/2;s>0;s/=2) {
+      int rx = (x & s) > 0;
+      int ry = (y & s) > 0;
+      d += uint64_t(s)*uint64_t(s)*((3*rx)^ry);
+      if (ry == 0) {
+        if (rx == 1) {
+          x = n-1-x;
+          y = n-1-y;
+        }
+        std::swap(x,y);
+      }
+    }
+    return d;
+  }
+
+  std::vector<int> TiledFB::tileOrder(vec2i numTiles)
+  {
+    int n = 1;
+    while (n < numTiles.x || n < numTiles.y) n *= 2;
+    std::vector<std::pair<uint64_t,int>> keys;
+    for (int ty=0;ty<numTiles.y;ty++)
+      for (int tx=0;tx<numTiles.x;tx++)
+        keys.push_back({hilbertIndex(n,tx,ty),tx+numTiles.x*ty});
+    std::sort(keys.begin(),keys.end());
+    std::vector<int> order;
+    for (auto key : keys)
+      order.push_back(key.second);
+    return order;
   }
   
   void TiledFB::resize(uint32_t channels,
-                       vec2i newSize)
+                       vec2i newSize,
+                       bool allTiles)
   {
-    free();
+    freeTileState();
     SetActiveGPU forDuration(device);
 
+    this->channels = channels;
     numPixels = newSize;
     numTiles  = divRoundUp(numPixels,vec2i(tileSize));
-    numActiveTilesThisGPU
-      = device
-      ? divRoundUp(std::max(0,numTiles.x*numTiles.y - device->globalRank()),
-                   device->globalSize())
-      : 0;
-    // ------------------------------------------------------------------
-    // accum tiles
-    // ------------------------------------------------------------------
-    accumTiles
-      = (AccumTile *)device->rtc->allocMem(numActiveTilesThisGPU * sizeof(AccumTile));
-    if (appDevice) {
-      SetActiveGPU forDuration(appDevice);
-      appAccumTiles
-        = (AccumTile *)appDevice->rtc->allocMem(numActiveTilesThisGPU * sizeof(AccumTile));
+    /* tiles get dealt out round-robin over all global devices, in
+       curve order */
+    int tileSetRank = allTiles ? 0 : device->globalRank();
+    int tileSetSize = allTiles ? 1 : device->globalSize();
+    std::vector<int> order = tileOrder(numTiles);
+    std::vector<int> tileIDs;
+    for (int i=tileSetRank;i<(int)order.size();i+=tileSetSize)
+      tileIDs.push_back(order[i]);
+    assignedTileIDs = tileIDs;
+    numActiveTilesThisGPU = (int)tileIDs.size();
+    allocTiles();
+    setTileDescs(tileIDs);
+  }
+
+  void TiledFB::assignTiles(const std::vector<int> &tileIDs)
+  {
+    freeTileState();
+    SetActiveGPU forDuration(device);
+
+    assignedTileIDs = tileIDs;
+    numActiveTilesThisGPU = (int)tileIDs.size();
+    allocTiles();
+    setTileDescs(tileIDs);
+  }
+
+  void TiledFB::setTileDescs(const std::vector<int> &tileIDs)
+  {
+    std::vector<TileDesc> descs(numActiveTilesThisGPU);
+    for (int i=0;i<numActiveTilesThisGPU;i++) {
+      int tileID = tileIDs[i];
+      descs[i].lower = vec2i((tileID % numTiles.x)*tileSize,
+                             (tileID / numTiles.x)*tileSize);
     }
-    // ------------------------------------------------------------------
-    // aux channel tiles
-    // ------------------------------------------------------------------
-    auto alloc = [&](Device *device, AuxChannelTile *&tiles) 
+    device->rtc->copyAsync(tileDescs,descs.data(),
+                           numActiveTilesThisGPU * sizeof(TileDesc));
+    if (appTileDescs)
+      device->rtc->copyAsync(appTileDescs,tileDescs,
+                             numActiveTilesThisGPU * sizeof(TileDesc));
+    /* host-side descs go out of scope */
+    device->rtc->sync();
+  }
+
+  std::vector<int> TiledFB::getTileIDs() const
+  {
+    return assignedTileIDs;
+  }
+
+  void TiledFB::allocAuxTiles(uint32_t produced)
+  {
+    const uint32_t wanted = channels & produced;
+    auto alloc = [&](Device *device, AuxChannelTile *&tiles,
+                     BNFrameBufferChannel channel) 
     {
       assert(device);
+      if (tiles || !(wanted & channel)) return;
+      SetActiveGPU forDuration(device);
+      MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
       tiles = (AuxChannelTile *)device->rtc->allocMem
-        (numActiveTilesThisGPU*sizeof(*tiles));
+        (tileCapacity*sizeof(*tiles));
     };
+    for (auto dev : { device, appDevice }) {
+      if (!dev) continue;
+      AuxTiles &tiles = (dev == device) ? auxTiles : appAuxTiles;
+      alloc(dev,tiles.primID,BN_FB_PRIMID);
+      alloc(dev,tiles.instID,BN_FB_INSTID);
+      alloc(dev,tiles.objID, BN_FB_OBJID);
+      alloc(dev,tiles.depth, BN_FB_DEPTH);
+      alloc(dev,tiles.cost,  BN_FB_COST);
+    }
+  }
 
-    if (channels & BN_FB_PRIMID) alloc(device,auxTiles.primID);
-    if (channels & BN_FB_INSTID) alloc(device,auxTiles.instID);
-    if (channels & BN_FB_OBJID)  alloc(device,auxTiles.objID);
-    if (channels & BN_FB_DEPTH)  alloc(device,auxTiles.depth);
+  bool TiledFB::trimIfPending()
+  {
+    if (!trimPending) return false;
+    trimPending = false;
+    if (tileCapacity == numActiveTilesThisGPU) return false;
+    trimTiles();
+    return true;
+  }
+
+  void TiledFB::allocTiles()
+  {
+    framesSinceResize = 0;
+    trimPending       = false;
+    if (numActiveTilesThisGPU <= tileCapacity
+        && !FromEnv::enabled("noFBCapacity"))
+      /* still fits; keep what we have, trimTiles() will eventually
+         give back what we don't need */
+      return;
+    freeTiles();
+    tileCapacity = numActiveTilesThisGPU;
+    if (tilesEverAllocated && !FromEnv::enabled("noFBCapacity"))
+      /* growing, so likely to grow some more: leave some room */
+      tileCapacity += numActiveTilesThisGPU/2;
+    tilesEverAllocated = true;
+    
+    MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+    // ------------------------------------------------------------------
+    // accum tiles
+    // ------------------------------------------------------------------
+    accumTiles
+      = (AccumTile *)device->rtc->allocMem(tileCapacity * sizeof(AccumTile));
     if (appDevice) {
       SetActiveGPU forDuration(appDevice);
-      if (channels & BN_FB_PRIMID) alloc(appDevice,appAuxTiles.primID);
-      if (channels & BN_FB_INSTID) alloc(appDevice,appAuxTiles.instID);
-      if (channels & BN_FB_OBJID)  alloc(appDevice,appAuxTiles.objID);
-      if (channels & BN_FB_DEPTH)  alloc(appDevice,appAuxTiles.depth);
+      appAccumTiles
+        = (AccumTile *)appDevice->rtc->allocMem(tileCapacity * sizeof(AccumTile));
     }
+    // (aux channel tiles get allocated on demand, in allocAuxTiles())
     
     // ------------------------------------------------------------------
     // tile descs
     // ------------------------------------------------------------------
     tileDescs
-      = (TileDesc *)device->rtc->allocMem(numActiveTilesThisGPU * sizeof(TileDesc));
+      = (TileDesc *)device->rtc->allocMem(tileCapacity * sizeof(TileDesc));
     if (appDevice) {
       SetActiveGPU forDuration(appDevice);
       appTileDescs
-        = (TileDesc *)appDevice->rtc->allocMem(numActiveTilesThisGPU * sizeof(TileDesc));
+        = (TileDesc *)appDevice->rtc->allocMem(tileCapacity * sizeof(TileDesc));
     }
-    __rtc_launch(//device
-                 device->rtc,
-                 // kernel
-                 setTileCoordsKernel,
-                 // launch config,
-                 divRoundUp(numActiveTilesThisGPU,128),128,
-                 // args
-                 tileDescs,
-                 numActiveTilesThisGPU,
-                 numTiles, 
-                 device->globalRank(),
-                 device->globalSize());
-    if (appTileDescs)
-      device->rtc->copyAsync(appTileDescs,tileDescs,
-                             numActiveTilesThisGPU * sizeof(TileDesc));
+  }
+
+  /*! replaces given array of (at least) numItems items by one of
+      exactly numItems, with the same content */
+  template<typename T>
+  void shrinkTo(Device *device, T *&pMem, int numItems)
+  {
+    if (!pMem) return;
+    SetActiveGPU forDuration(device);
+    T *newMem = (T *)device->rtc->allocMem(numItems*sizeof(T));
+    device->rtc->copyAsync(newMem,pMem,numItems*sizeof(T));
+    device->rtc->sync();
+    device->rtc->freeMem(pMem);
+    pMem = newMem;
+  }
+  
+  void TiledFB::trimTiles()
+  {
+    if (tileCapacity == numActiveTilesThisGPU) return;
+    MemoryScope memScope(device,BN_MEMORY_FRAME_BUFFERS);
+    /* ids and depth only get written by a frame's first sample, so
+       aux tiles have to keep their content, too */
+    for (auto dev : { device, appDevice }) {
+      if (!dev) continue;
+      AuxTiles &tiles = (dev == device) ? auxTiles : appAuxTiles;
+      shrinkTo(dev,tiles.primID,numActiveTilesThisGPU);
+      shrinkTo(dev,tiles.instID,numActiveTilesThisGPU);
+      shrinkTo(dev,tiles.objID, numActiveTilesThisGPU);
+      shrinkTo(dev,tiles.depth, numActiveTilesThisGPU);
+      shrinkTo(dev,tiles.cost,  numActiveTilesThisGPU);
+    }
+    shrinkTo(device,accumTiles,numActiveTilesThisGPU);
+    shrinkTo(device,tileDescs,numActiveTilesThisGPU);
+    if (appDevice) {
+      shrinkTo(appDevice,appAccumTiles,numActiveTilesThisGPU);
+      shrinkTo(appDevice,appTileDescs,numActiveTilesThisGPU);
+    }
+    tileCapacity = numActiveTilesThisGPU;
   }
 
 }
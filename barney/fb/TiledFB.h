@@ -7,7 +7,9 @@
 #include "barney/DeviceGroup.h"
 #include "barney/common/half.h"
 #include "barney/render/HitIDs.h"
+#include "barney/render/Ray.h"
 #include "barney/Context.h"
+#include "barney/Camera.h"
 
 namespace BARNEY_NS {
   
@@ -18,9 +20,67 @@ namespace BARNEY_NS {
   };
   
   
+  /*! a unit normal in 32 bits: octahedral mapping, with two 16-bit
+      snorm coordinates. Zero (ie, 'no normal') gets stored through a
+      value the encoding itself never produces */
+  struct OctNormal {
+    inline __both__ void set(vec3f v)
+    {
+      float l1 = fabsf(v.x)+fabsf(v.y)+fabsf(v.z);
+      if (l1 == 0.f) { x = y = zeroCode; return; }
+      float ox = v.x/l1, oy = v.y/l1;
+      if (v.z < 0.f) {
+        float fx = (1.f-fabsf(oy))*copysignf(1.f,ox);
+        float fy = (1.f-fabsf(ox))*copysignf(1.f,oy);
+        ox = fx; oy = fy;
+      }
+      x = encode(ox);
+      y = encode(oy);
+    }
+    inline __both__ vec3f get() const
+    {
+      if (x == zeroCode) return vec3f(0.f);
+      vec3f v(decode(x),decode(y),0.f);
+      v.z = 1.f-fabsf(v.x)-fabsf(v.y);
+      float t = fmaxf(-v.z,0.f);
+      v.x += (v.x >= 0.f) ? -t : t;
+      v.y += (v.y >= 0.f) ? -t : t;
+      return normalize(v);
+    }
+  private:
+    static constexpr int16_t zeroCode = -32768;
+    inline __both__ static int16_t encode(float f)
+    { return int16_t(rintf(fminf(fmaxf(f,-1.f),1.f)*32767.f)); }
+    inline __both__ static float decode(int16_t i)
+    { return float(i)*(1.f/32767.f); }
+    int16_t x, y;
+  };
+
+#if BARNEY_HALF_ACCUM
+  /*! a pixel's accumulated color and alpha, in half precision. Halfs
+      can't hold sums over many samples, so tiles with these store
+      running averages instead; see TiledFB::beginAccumulation() */
+  struct HalfAccum {
+    inline __both__ operator vec4f() const
+    { return vec4f(from_half(rg.x),from_half(rg.y),
+                   from_half(ba.x),from_half(ba.y)); }
+    inline __both__ HalfAccum &operator=(vec4f v)
+    {
+      rg.x = to_half(v.x); rg.y = to_half(v.y);
+      ba.x = to_half(v.z); ba.y = to_half(v.w);
+      return *this;
+    }
+    vec2h rg, ba;
+  };
+  typedef HalfAccum AccumValue;
+#else
+  typedef vec4f     AccumValue;
+#endif
+
   struct AccumTile {
-    vec4f  accum[pixelsPerTile];
-    vec3f  normal[pixelsPerTile];
+    AccumValue accum[pixelsPerTile];
+    /*! written once, by the first sample of each pixel */
+    OctNormal normal[pixelsPerTile];
   };
 
   struct AuxTiles {
@@ -28,12 +88,116 @@ namespace BARNEY_NS {
     AuxChannelTile *primID = 0;
     AuxChannelTile *instID = 0;
     AuxChannelTile *objID  = 0;
+    /*! rays shaded per pixel (BN_FB_COST); cleared every frame */
+    AuxChannelTile *cost   = 0;
   };
 
+  /*! per-tile state for adaptive sampling. We estimate each pixel's
+      error by comparing the average over all its samples to the
+      average over only its odd-numbered samples, and average that
+      over the tile. Once a tile has converged it stops getting new
+      samples; its accumulated values get scaled up instead, so the
+      frame buffer can keep dividing by the same accumID everywhere */
+  struct ConvergenceTile {
+    /*! luminance accumulated from odd-numbered samples only */
+    float oddLuminance[pixelsPerTile];
+    /*! sum of per-pixel errors (and number of valid pixels that
+        went into it) while computing the tile's error */
+    float errorSum;
+    int   numValidPixels;
+    float error;
+    int   converged;
+  };
+  
   /*! describes the lower-left corner of each logical tile */
   struct TileDesc {
     vec2i lower;
   };
+
+  /*! a light sample, stored such that its (unshadowed) contribution
+      can get re-evaluated at any other shading point; see the ReSTIR
+      direct lighting in shadeRays.cu */
+  struct LightVertex {
+    /*! point on the light; or, for infinite lights, direction to it */
+    vec3f     P;
+    /*! the light's normal for area lights; zero for point lights */
+    OctNormal N;
+    /*! emitted radiance for area lights, intensity for point lights,
+        and incoming radiance for infinite lights */
+    vec3h     emission;
+    uint16_t  isInfinite;
+  };
+
+  /*! a pixel's direct lighting reservoir, as kept from one frame to
+      the next */
+  struct Reservoir {
+    LightVertex y;
+    /*! contribution weight of y (what its contribution gets scaled
+        with instead of 1/pdf) */
+    float       W;
+    /*! number of candidates that went into this reservoir; zero
+        means 'empty' */
+    float       M;
+    /*! shading point (and its normal) this reservoir was built for,
+        to tell if it can be re-used for another one */
+    vec3f       P;
+    OctNormal   N;
+  };
+
+  struct ReservoirTile {
+    Reservoir reservoir[pixelsPerTile];
+  };
+
+  /*! what the shade kernel needs for ReSTIR's reuse: the reservoirs
+      of the previous frame (to read) and this frame (to write), and
+      how to find a previous frame's pixel in this gpu's tiles. A
+      null 'curr' means ReSTIR is off */
+  struct ReservoirTiles {
+    const ReservoirTile *prev = 0;
+    ReservoirTile       *curr = 0;
+    /*! for each of the frame's tiles, its index into this gpu's tile
+        arrays; or -1 if some other gpu owns it */
+    const int           *localTileOf = 0;
+    const TileDesc      *tileDescs = 0;
+    vec2i                numTiles;
+    vec2i                numPixels;
+    /*! the camera the previous frame's reservoirs were built with */
+    Camera::DD           prevCamera;
+    int                  havePrev = 0;
+  };
+  
+  /*! what temporal reprojection keeps of a pixel from one frame to
+      the next: its (averaged) color, and what it was a color of */
+  struct HistoryPixel {
+    vec4f     color;
+    /*! world-space primary hit point, and that hit's normal */
+    vec3f     P;
+    OctNormal N;
+    uint32_t  primID;
+    uint32_t  instID;
+    /*! how many samples (capped) color is worth; zero for pixels
+        that can't get reprojected */
+    float     count;
+    /*! how many of those got baked into the pixel's accumulated
+        values by the last reprojection, rather than traced */
+    float     reprojected;
+  };
+
+  struct HistoryTile {
+    HistoryPixel pixel[pixelsPerTile];
+  };
+
+  /*! what camera rays can re-use of earlier samples while
+      accumulating with a static camera: the generation-0 hit of
+      each of this gpu's pixels, for each of numJitters sub-pixel
+      jitter positions (at pixelID*numJitters+jitter). Null hits
+      means the cache is off */
+  struct PrimaryHitCache {
+    render::HitOnly *hits  = 0;
+    /*! non-zero for entries that got written since the last reset */
+    int             *valid = 0;
+    int              numJitters = 0;
+  };
   
   struct TiledFB {
     typedef std::shared_ptr<TiledFB> SP;
@@ -57,9 +221,119 @@ namespace BARNEY_NS {
             FrameBuffer *owner);
     virtual ~TiledFB();
 
+    /*! resize to given frame size; unless allTiles is set (which
+        sort-last compositing layers use) this gpu will only own its
+        share of those tiles */
     void resize(uint32_t channels,
-                vec2i newSize);
+                vec2i newSize,
+                bool allTiles = false);
+    /*! re-assigns which of the (unchanged) frame's tiles this gpu
+        owns, given as frame tile IDs; all tile contents get lost, so
+        this should only be done when accumulation restarts */
+    void assignTiles(const std::vector<int> &tileIDs);
+    /*! frame tile IDs of this gpu's tiles, in the order of its tile
+        arrays */
+    std::vector<int> getTileIDs() const;
+    /*! the order in which a frame's tiles get dealt out
+        (round-robin) to the devices: along a hilbert curve over the tile grid, so each device's
+        tiles - and the blocks that generate rays for consecutive
+        tiles - are close to each other in screen space */
+    static std::vector<int> tileOrder(vec2i numTiles);
     void free();
+    /*! allocates the tiles of those of the given aux channels that
+        this fb has (as of the latest resize()) but that don't have
+        tiles yet; aux tiles only get allocated once a frame actually
+        produces them (see FrameBuffer::activeChannels) */
+    void allocAuxTiles(uint32_t produced);
+    /*! does the trimTiles() that beginAccumulation() asked for, if
+        any; returns whether the tile arrays moved. Has to happen
+        before anything gets handed this frame's tile pointers (see
+        FrameBuffer::setActiveChannels()) */
+    bool trimIfPending();
+
+    /*! returns this gpu's per-tile shade counts (one per ray
+        shaded), allocating (and clearing) them on first use */
+    int *getTileCosts();
+    void resetTileCosts();
+    /*! reads back the shade counts of the frame(s) since the last
+        resetTileCosts(); all zero if costs were never tracked */
+    std::vector<int> readTileCosts();
+    /*! clears the per-pixel BN_FB_COST counts, if that channel exists */
+    void resetPixelCosts();
+
+    /*! returns this gpu's convergence tiles, allocating (and
+        clearing) them on first use */
+    ConvergenceTile *getConvergenceTiles();
+    /*! clears all tiles' convergence state; has to be done whenever
+        accumulation restarts */
+    void resetConvergence();
+    /*! after a frame that took the accumulated sample count from
+        numSamplesBefore to numSamplesAfter: scale up tiles that were
+        already converged (and thus didn't get any new samples), and
+        re-compute the others' error estimates and convergence */
+    void updateConvergence(int numSamplesBefore,
+                           int numSamplesAfter,
+                           float threshold,
+                           int minSamples);
+    /*! how many of this gpu's tiles had converged as of the last
+        updateConvergence() */
+    int readNumConvergedTiles();
+
+    /*! returns what ReSTIR direct lighting needs for this frame,
+        allocating (and clearing) the reservoirs on first use */
+    ReservoirTiles getReservoirTiles();
+    /*! at the end of a frame rendered with given camera: this
+        frame's reservoirs become the next frame's previous ones */
+    void swapReservoirs(const Camera::DD &camera);
+
+    /*! returns the cache of primary hits for given number of jitter
+        positions, (re-)allocating and clearing it if that changed */
+    PrimaryHitCache getPrimaryHitCache(int numJitters);
+    /*! invalidates all cached primary hits; has to be done whenever
+        accumulation restarts */
+    void resetPrimaryHitCache();
+
+    /*! temporal reprojection, at the end of a frame rendered with
+        given camera (and after fb->accumID got updated): if that
+        frame restarted accumulation, blend every pixel that can be
+        found in the previous frame's history with what that one had
+        accumulated, worth at most maxHistory samples, and (either
+        way) store this frame's result as the next one's history.
+        Needs depth, primID and instID tiles, and a perspective
+        camera; and only finds pixels within this gpu's tiles */
+    void reprojectHistory(const Camera::DD &camera,
+                          bool restarted,
+                          int numSamples,
+                          float accumScale,
+                          int maxHistory);
+    /*! for each of the frame's tiles, its index into this gpu's
+        tile arrays or -1; allocated on first use */
+    const int *getLocalTileOf();
+
+        /*! sets how often each of this gpu's tiles gets sampled, given a
+        sample period for each of the frame's tiles (by frame tile
+        ID): a tile with period k only gets every k'th sample. An
+        empty vector means all tiles get all samples */
+    void setSamplePeriods(const std::vector<int> &periodOfTile);
+    /*! tiles that get sampled less often than others (see
+        setSamplePeriods()) keep their accumulated values scaled up
+        to what they'd be with all numSamples samples, so the frame
+        buffer can keep dividing by the same accumID everywhere; this
+        converts those tiles from (toSums) or back to (!toSums) plain
+        sums over the samples they actually got */
+    void scaleSparseTiles(int numSamples, bool toSums);
+
+    /*! with half-precision accumulation (BARNEY_HALF_ACCUM), tiles
+        hold each pixel's running average rather than sums; so before
+        a frame takes a tile from numSamplesBefore to numSamplesAfter
+        samples, its values get scaled down by before/after, and
+        every new sample only adds 1/after of its value (per tile, in
+        sampleWeights). Tiles with sample periods or that already
+        converged count only the samples they actually get. No-op
+        with full-precision accumulation */
+    void beginAccumulation(int numSamplesBefore,
+                           int numSamplesAfter,
+                           bool adaptive);
 
     /*! take this GPU's tiles, and write those tiles' color (and
         optionally normal) channels into the linear frame buffers
@@ -72,6 +346,26 @@ namespace BARNEY_NS {
                                  vec3f *linearNormal,
                                  float  accumScale);
 
+    /*! linearize given array of accum tiles' color (and, if
+        linearNormal isn't null, normal) channels, on given device */
+    static void linearizeColorAndNormalTiles(Device     *device,
+                                             void       *linearColor,
+                                             BNDataType  format,
+                                             vec3f      *linearNormal,
+                                             float       accumScale,
+                                             AccumTile  *tilesIn,
+                                             TileDesc   *descsIn,
+                                             int         numTiles,
+                                             vec2i       numPixels);
+
+    /*! adds given tiles' accumulated colors to those of sum (both
+        numTiles of the same tiles, in the same order), on given
+        device; normals stay as they are in sum */
+    static void addAccumTiles(Device          *device,
+                              AccumTile       *sum,
+                              const AccumTile *tiles,
+                              int              numTiles);
+
     /*! linearize given array's aux tiles, on given device. this can be
       used either for local GPUs on a single node, or on the owner
       after it reveived all worker tiles */
@@ -102,12 +396,72 @@ namespace BARNEY_NS {
     TileDesc          *appTileDescs  = 0;
     AccumTile         *accumTiles    = 0;
     AccumTile         *appAccumTiles = 0;
+    /*! only allocated if the renderer uses adaptive sampling */
+    ConvergenceTile   *convergenceTiles = 0;
+    /*! how many of those have converged; see readNumConvergedTiles() */
+    int               *numConvergedTiles = 0;
+    /*! only allocated if tiles get balanced by cost */
+    int               *tileCosts = 0;
+    /*! only allocated if the frame buffer is foveated; see
+        setSamplePeriods() */
+    int               *samplePeriods = 0;
+    /*! only allocated with half-precision accumulation; see
+        beginAccumulation() */
+    float             *sampleWeights = 0;
+    /*! only allocated with ReSTIR direct lighting; previous and
+        current frame's reservoirs, see getReservoirTiles() */
+    ReservoirTile     *reservoirTiles[2] = { 0,0 };
+    int               *localTileOf = 0;
+    Camera::DD         reservoirCamera;
+    bool               haveReservoirCamera = false;
+    /*! only allocated with temporal reprojection; previous frame's
+        history, and where the next one goes. See reprojectHistory() */
+    HistoryTile       *historyTiles[2] = { 0,0 };
+    Camera::DD         historyCamera;
+    bool               haveHistory = false;
+    /*! only allocated with a primary hit cache; see
+        getPrimaryHitCache() */
+    render::HitOnly   *primaryHits = 0;
+    int               *primaryHitValid = 0;
+    int                numPrimaryJitters = 0;
     AuxTiles           auxTiles;
     AuxTiles           appAuxTiles;
 
     
     FrameBuffer *const owner;
     Device      *const device;
+
+  private:
+    /*! makes sure all tile arrays have room for (at least)
+        numActiveTilesThisGPU tiles. Tile arrays have a capacity:
+        they get re-allocated only to grow (and then with some room
+        to spare), so resizing a window doesn't re-allocate on every
+        single frame */
+    void allocTiles();
+    /*! frees the tile arrays that allocTiles() manages */
+    void freeTiles();
+    /*! frees everything that's only valid for the current tiles -
+        convergence, reservoirs, history, etc */
+    void freeTileState();
+    /*! gives back any tile capacity that's not currently in use;
+        done once the tile count didn't change for trimAfterFrames
+        frames */
+    void trimTiles();
+    enum { trimAfterFrames = 64 };
+    int  tileCapacity      = 0;
+    int  framesSinceResize = 0;
+    bool trimPending       = false;
+    bool tilesEverAllocated = false;
+
+    /*! uploads descs for given tile IDs (which have to be
+        numActiveTilesThisGPU many) */
+    void setTileDescs(const std::vector<int> &tileIDs);
+
+    /*! channels as of the latest resize() */
+    uint32_t         channels = 0;
+    /*! frame tile IDs of this gpu's tiles */
+    std::vector<int> assignedTileIDs;
+  public:
     
     /*! device on which the app runs and will do map(). if null, this
       will be ignored, and the tile finalization operations will just
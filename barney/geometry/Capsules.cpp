@@ -12,11 +12,22 @@ namespace BARNEY_NS {
 
   Capsules::Capsules(Context *context, DevGroup::SP devices)
     : Geometry(context,devices)
-  {}
+  {
+    packed.resize(devices->numLogical);
+  }
+
+  Capsules::~Capsules()
+  {
+    for (auto device : *devices)
+      freePacked(device);
+  }
 
   void Capsules::commit()
   {
+    numPrims = indices ? indices->count : 0;
     for (auto device : *devices) {
+      buildPacked(device);
+      PackedPLD &pk = packed[device->contextRank()];
       PLD *pld = getPLD(device);
       if (pld->userGeoms.empty()) {
         rtc::GeomType *gt
@@ -37,8 +48,14 @@ namespace BARNEY_NS {
 
       Capsules::DD dd;
       Geometry::writeDD(dd,device);
-      dd.vertices  = (vec4f*)(vertices?vertices->getDD(device):0);
-      dd.indices   = (vec2i*)(indices?indices->getDD(device):0);
+      dd.vertices
+        = pk.vertices
+        ? (vec4f*)pk.vertices->getDD()
+        : (vec4f*)(vertices?vertices->getDD(device):0);
+      dd.indices
+        = pk.indices
+        ? (vec2i*)pk.indices->getDD()
+        : (vec2i*)(indices?indices->getDD(device):0);
       // done:
       geom->setDD(&dd);
       
@@ -52,11 +69,31 @@ namespace BARNEY_NS {
       return true;
     
     if (member == "vertices") {
-      vertices = value->as<PODData>();
+      vertices = value ? value->as<PODData>() : PODData::SP();
       return true;
     }
     if (member == "indices") {
-      indices = value->as<PODData>();
+      indices = value ? value->as<PODData>() : PODData::SP();
+      return true;
+    }
+    if (member == "positions") {
+      positions = value ? value->as<PODData>() : PODData::SP();
+      return true;
+    }
+    if (member == "radii") {
+      radii = value ? value->as<PODData>() : PODData::SP();
+      return true;
+    }
+    return false;
+  }
+
+  bool Capsules::set1f(const std::string &member, const float &value)
+  {
+    if (Geometry::set1f(member,value))
+      return true;
+    
+    if (member == "radius") {
+      radius = value;
       return true;
     }
     return false;
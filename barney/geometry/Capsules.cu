@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/geometry/Capsules.h"
+#include "barney/Context.h"
+#include "rtcore/ComputeInterface.h"
+
+namespace BARNEY_NS {
+
+  /*! interleaves separate positions and radii into the float4
+      vertices the capsules' programs read */
+  __rtc_global
+  void Capsules_packVertices(const rtc::ComputeInterface &ci,
+                             vec4f *out,
+                             const vec3f *positions,
+                             const float *radii,
+                             float defaultRadius,
+                             int numVertices)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= numVertices) return;
+    vec3f P = positions[tid];
+    out[tid] = vec4f(P.x,P.y,P.z,radii ? radii[tid] : defaultRadius);
+#endif
+  }
+
+  /*! turns each segment's first vertex into that and the one after
+      it */
+  __rtc_global
+  void Capsules_expandSegments(const rtc::ComputeInterface &ci,
+                               vec2i *out,
+                               const int *firstVertex,
+                               int numSegments)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= numSegments) return;
+    int begin = firstVertex[tid];
+    out[tid] = vec2i(begin,begin+1);
+#endif
+  }
+
+  void Capsules::freePacked(Device *device)
+  {
+    PackedPLD &pk = packed[device->contextRank()];
+    if (pk.vertices) device->rtc->freeBuffer(pk.vertices);
+    if (pk.indices)  device->rtc->freeBuffer(pk.indices);
+    pk.vertices = 0;
+    pk.indices  = 0;
+  }
+
+  void Capsules::buildPacked(Device *device)
+  {
+    freePacked(device);
+    PackedPLD &pk = packed[device->contextRank()];
+    SetActiveGPU forDuration(device);
+    auto rtc = device->rtc;
+
+    int numVertices = positions ? (int)positions->count : 0;
+    if (numVertices > 0) {
+      pk.vertices = rtc->createBuffer(numVertices*sizeof(vec4f));
+      __rtc_launch(rtc,Capsules_packVertices,
+                   divRoundUp(numVertices,128),128,
+                   (vec4f *)pk.vertices->getDD(),
+                   (const vec3f *)positions->getDD(device),
+                   (const float *)(radii?radii->getDD(device):0),
+                   radius,numVertices);
+    }
+
+    int numSegments = indices ? (int)indices->count : 0;
+    if (numSegments > 0
+        && (indices->type == BN_INT32 || indices->type == BN_UINT32)) {
+      pk.indices = rtc->createBuffer(numSegments*sizeof(vec2i));
+      __rtc_launch(rtc,Capsules_expandSegments,
+                   divRoundUp(numSegments,128),128,
+                   (vec2i *)pk.indices->getDD(),
+                   (const int *)indices->getDD(device),
+                   numSegments);
+    }
+    rtc->sync();
+  }
+
+}
@@ -159,6 +159,7 @@ namespace BARNEY_NS {
         = *(Capsules::DD*)ti.getProgramData();
       const OptixGlobals &globals = OptixGlobals::get(ti);
       const World::DD &world = globals.world;
+      DeviceCounters::count(world.counters,DeviceCounters::PRIM_TESTS);
       Ray &ray    = *(Ray*)ti.getPRD();
 
       const vec2i idx = self.indices[primID];
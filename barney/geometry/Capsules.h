@@ -22,6 +22,14 @@ namespace BARNEY_NS {
       position and radii for each capsule.
 
       `float3 vertices[]` position (.xyz) and radius (.w) of each vertex
+
+      Alternatively, vertices can come as separate `float3 positions[]`
+      and (optional) `float radii[]` (else, a common `float radius`),
+      and indices as `int indices[]` that only store each capsule's
+      first vertex, the second being the one after it (which is what
+      ANARI curves do). commit() then builds the above arrays on the
+      device, so apps (and the ANARI layer) don't have to repack
+      their data on the host
   */
   struct Capsules : public Geometry {
     typedef std::shared_ptr<Capsules> SP;
@@ -32,7 +40,7 @@ namespace BARNEY_NS {
     };
     
     Capsules(Context *context, DevGroup::SP devices);
-    virtual ~Capsules() = default;
+    virtual ~Capsules();
     
     /*! pretty-printer for printf-debugging */
     std::string toString() const override
@@ -43,11 +51,28 @@ namespace BARNEY_NS {
     // ------------------------------------------------------------------
     /*! @{ parameter set/commit interface */
     bool setData(const std::string &member, const barney_api::Data::SP &value) override;
+    bool set1f(const std::string &member, const float &value) override;
     /*! @} */
     // ------------------------------------------------------------------
 
+    /*! (re-)builds given device's packed arrays from positions,
+        radii, and/or per-segment indices, as far as those are set;
+        in Capsules.cu */
+    void buildPacked(Device *device);
+    void freePacked(Device *device);
+    
     PODData::SP vertices;
     PODData::SP indices;
+    PODData::SP positions;
+    PODData::SP radii;
+    float       radius = .01f;
+
+    /*! per logical device; whatever buildPacked() made, else null */
+    struct PackedPLD {
+      rtc::Buffer *vertices = 0;
+      rtc::Buffer *indices  = 0;
+    };
+    std::vector<PackedPLD> packed;
   };
 
 }
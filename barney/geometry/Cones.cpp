@@ -23,6 +23,7 @@ namespace BARNEY_NS {
                 << std::endl;
       return;
     }
+    numPrims = indices ? indices->count : vertices->count/2;
     for (auto device : *devices) {
       PLD *pld = getPLD(device);
       if (pld->userGeoms.empty()) {
@@ -55,15 +56,15 @@ namespace BARNEY_NS {
     if (Geometry::setData(member,value))
       return true;
     if (member == "vertices") {
-      vertices = value->as<PODData>();
+      vertices = value ? value->as<PODData>() : PODData::SP();
       return true;
     }
     if (member == "indices") {
-      indices = value->as<PODData>();
+      indices = value ? value->as<PODData>() : PODData::SP();
       return true;
     }
     if (member == "radii") {
-      radii = value->as<PODData>();
+      radii = value ? value->as<PODData>() : PODData::SP();
       return true;
     }
     return false;
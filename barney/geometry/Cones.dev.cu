@@ -66,6 +66,7 @@ namespace BARNEY_NS {
       const int instID = ti.getInstanceID();
       const OptixGlobals &globals = OptixGlobals::get(ti);
       const World::DD &world = globals.world;
+      DeviceCounters::count(world.counters,DeviceCounters::PRIM_TESTS);
         
       render::HitAttributes hitData;
       hitData.primID          = primID;
@@ -16,22 +16,28 @@ namespace BARNEY_NS {
 
   void Cylinders::commit()
   {
+    size_t numCylinders
+      = indices
+      ? indices->count
+      : (vertices ? vertices->count/2 : 0);
+    numPrims = numCylinders;
     for (auto device : *devices) {
       PLD *pld = getPLD(device);
       if (pld->userGeoms.empty()) {
         rtc::GeomType *gt
           = device->geomTypes.get(createGeomType_Cylinders);
         rtc::Geom *geom = gt->createGeom();
-        geom->setPrimCount((int)indices->count);
         pld->userGeoms.push_back(geom);
       }
       rtc::Geom *geom = pld->userGeoms[0];
+      geom->setPrimCount((int)numCylinders);
 
       Cylinders::DD dd;
       Geometry::writeDD(dd,device);
       dd.vertices = (vec3f*)(vertices?vertices->getDD(device):0);
       dd.indices  = (vec2i*)(indices?indices->getDD(device):0);
       dd.radii    = (float*)(radii?radii->getDD(device):0);
+      dd.radius   = radius;
       geom->setDD(&dd);
     }
   } 
@@ -49,6 +55,10 @@ namespace BARNEY_NS {
   {
     if (Geometry::set1f(member,value))
       return true;
+    if (member == "radius") {
+      radius = value;
+      return true;
+    }
     return false;
   }
   
@@ -58,15 +68,15 @@ namespace BARNEY_NS {
     if (Geometry::setData(member,value))
       return true;
     if (member == "vertices") {
-      vertices = value->as<PODData>();
+      vertices = value ? value->as<PODData>() : PODData::SP();
       return true;
     }
     if (member == "indices") {
-      indices = value->as<PODData>();
+      indices = value ? value->as<PODData>() : PODData::SP();
       return true;
     }
     if (member == "radii") {
-      radii = value->as<PODData>();
+      radii = value ? value->as<PODData>() : PODData::SP();
       return true;
     }
     return false;
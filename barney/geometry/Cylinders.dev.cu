@@ -75,11 +75,14 @@ namespace BARNEY_NS {
                 const int32_t primID)
     {
       const Cylinders::DD &geom = *(const Cylinders::DD *)geomData;
-      vec2i idx = geom.indices[primID];
+      vec2i idx
+        = geom.indices
+        ? geom.indices[primID]
+        : vec2i(2*primID,2*primID+1);
       vec3f a = geom.vertices[idx.x];
       vec3f b = geom.vertices[idx.y];
       float ra, rb;
-      ra = rb = geom.radii[primID];
+      ra = rb = geom.radii ? geom.radii[primID] : geom.radius;
       box3f box_a = {a-ra,a+ra};
       box3f box_b = {b-rb,b+rb};
       bounds.lower = min(box_a.lower,box_b.lower);
@@ -110,17 +113,21 @@ namespace BARNEY_NS {
 
       const OptixGlobals &globals = OptixGlobals::get(ti);
       const World::DD &world = globals.world;
+      DeviceCounters::count(world.counters,DeviceCounters::PRIM_TESTS);
 #ifdef NDEBUG
       bool dbg = 0;
 #else
       bool dbg = ray.dbg();
 #endif      
-      const vec2i idx = self.indices[primID];
+      const vec2i idx
+        = self.indices
+        ? self.indices[primID]
+        : vec2i(2*primID,2*primID+1);
       const vec3f v0  = self.vertices[idx.x];
       const vec3f v1  = self.vertices[idx.y];
       
       const float radius
-        = self.radii[primID];
+        = self.radii ? self.radii[primID] : self.radius;
       
       const vec3f ray_org  = ti.getObjectRayOrigin();
       const vec3f ray_dir  = ti.getObjectRayDirection();
@@ -12,7 +12,8 @@ namespace BARNEY_NS {
       one array of int2 where each of the two its specified begin and
       end vertex of a cylinder. radii can either come from a separate
       array (if provided), or, i not, use a common radius specified in
-      this geometry */
+      this geometry. Without indices, vertices 2*i and 2*i+1 form
+      cylinder i */
   struct Cylinders : public Geometry {
     typedef std::shared_ptr<Cylinders> SP;
 
@@ -21,6 +22,8 @@ namespace BARNEY_NS {
       // const vec3f *colors;
       const vec2i *indices;
       const float *radii;
+      /*! used if radii is null */
+      float        radius;
       // int colorPerVertex;
     };
     
@@ -45,6 +48,7 @@ namespace BARNEY_NS {
     PODData::SP vertices;
     PODData::SP indices;
     PODData::SP radii;
+    float       radius = 1.f;
   };
 
 }
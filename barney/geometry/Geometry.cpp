@@ -50,6 +50,7 @@ namespace BARNEY_NS {
       devices(devices)
   {
     perLogical.resize(devices->numLogical);
+    reorderPrims = FromEnv::enabled("reorderPrims");
   }
 
   bool Geometry::set1i(const std::string &member,
@@ -59,6 +60,12 @@ namespace BARNEY_NS {
       userID = value;
       return true; 
     } 
+    if (member == "reorderPrims") {
+      if (reorderPrims != (value != 0))
+        topologyVersion++;
+      reorderPrims = (value != 0);
+      return true;
+    }
     
     return false;
   }
@@ -59,6 +59,34 @@ namespace BARNEY_NS {
     /*! ask this geometry to build whatever owl geoms it needs to build */
     virtual void build() {}
 
+    /*! whether groups can refit (rather than rebuild) their accels
+        over this geometry as long as its topologyVersion didn't
+        change, ie, if only its vertex positions changed */
+    virtual bool canRefit() const { return false; }
+    /*! gets bumped whenever the number or topology of primitives
+        changes */
+    int topologyVersion = 0;
+    /*! whether geometries that support it re-order their primitives
+        along a space-filling curve at commit, so neighboring prims
+        end up close in memory (and in the BVH's leaves); hit prim IDs
+        and per-prim attributes still refer to the app's order. Set
+        through "reorderPrims" (int), default on BARNEY_CONFIG's
+        "reorderPrims" */
+    bool reorderPrims = false;
+    /*! primitives as of the last commit, for build records; 0 if not
+        known */
+    size_t numPrims = 0;
+
+    /*! object-space bounds as of the last commit, for culling whole
+        instances; empty if this geometry doesn't know its bounds, in
+        which case nothing instantiating it ever gets culled */
+    box3f bounds;
+    /*! bounds of given (float3) points, each grown by its (float)
+        radius, or by defaultRadius if radii is null */
+    box3f computePointBounds(const PODData::SP &points,
+                             const PODData::SP &radii,
+                             float defaultRadius);
+
     void setAttributesOn(Geometry::DD &dd,
                          Device *device);
     void writeDD(Geometry::DD &dd,
@@ -105,18 +133,25 @@ namespace BARNEY_NS {
     auto set = [&](vec4f &out,
                    const GeometryAttribute::DD &in,
                    const rtc::float4 *instanceAttribute,
+                   int numInstanceAttributes,
                    bool dbg=false)
     {
       switch(in.scope) {
-      case GeometryAttribute::INVALID:
+      case GeometryAttribute::INVALID: {
         /* if the _geometry_ doesn't have an attribute set, it can
-           still come from an instance */
-        if (instanceAttribute)
-          out = rtc::load(instanceAttribute[hit.instID]);
+           still come from an instance; instance attributes are
+           indexed by user instance ID, if there are any */
+        int attrID
+          = world.instIDToUserInstID
+          ? world.instIDToUserInstID[hit.instID]
+          : hit.instID;
+        if (instanceAttribute
+            && attrID >= 0 && attrID < numInstanceAttributes)
+          out = rtc::load(instanceAttribute[attrID]);
         else 
           /* nothing - leave default */
           ;
-        break;
+      } break;
       case GeometryAttribute::CONSTANT:
         out = in.value;
         // out = rtc::load(in.value);
@@ -136,10 +171,11 @@ namespace BARNEY_NS {
     for (int i=0;i<attributes.count;i++) {
       vec4f     &out = hit.attribute[i];
       const auto &in  = this->attributes.attribute[i];
-      set(out,in,world.instanceAttributes[i]);
+      set(out,in,world.instanceAttributes[i],world.numInstanceAttributes[i]);
     }
-    set(hit.color,this->attributes.colorAttribute,world.instanceAttributes[4],dbg);
-    set(hit.objectNormal,this->attributes.normalAttribute,nullptr,dbg);
+    set(hit.color,this->attributes.colorAttribute,
+        world.instanceAttributes[4],world.numInstanceAttributes[4],dbg);
+    set(hit.objectNormal,this->attributes.normalAttribute,nullptr,0,dbg);
   }
   
 }
@@ -0,0 +1,56 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/geometry/Geometry.h"
+#include "barney/Context.h"
+#include "rtcore/ComputeInterface.h"
+
+namespace BARNEY_NS {
+
+  __rtc_global
+  void Geometry_pointBounds(const rtc::ComputeInterface &ci,
+                            const vec3f *points,
+                            int numPoints,
+                            const float *radii,
+                            float defaultRadius,
+                            box3f *d_bounds)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= numPoints) return;
+    vec3f P = points[tid];
+    float r = radii ? radii[tid] : defaultRadius;
+    rtc::fatomicMin(&d_bounds->lower.x,P.x-r);
+    rtc::fatomicMin(&d_bounds->lower.y,P.y-r);
+    rtc::fatomicMin(&d_bounds->lower.z,P.z-r);
+    rtc::fatomicMax(&d_bounds->upper.x,P.x+r);
+    rtc::fatomicMax(&d_bounds->upper.y,P.y+r);
+    rtc::fatomicMax(&d_bounds->upper.z,P.z+r);
+#endif
+  }
+
+  box3f Geometry::computePointBounds(const PODData::SP &points,
+                                     const PODData::SP &radii,
+                                     float defaultRadius)
+  {
+    box3f bounds;
+    if (!points || points->count == 0)
+      return bounds;
+    Device *device = (*devices)[0];
+    SetActiveGPU forDuration(device);
+    auto rtc = device->rtc;
+    box3f *d_bounds = (box3f*)rtc->allocMem(sizeof(box3f));
+    rtc->copy(d_bounds,&bounds,sizeof(bounds));
+    int numPoints = (int)points->count;
+    __rtc_launch(rtc,Geometry_pointBounds,
+                 divRoundUp(numPoints,128),128,
+                 (const vec3f *)points->getDD(device),numPoints,
+                 (const float *)(radii?radii->getDD(device):0),
+                 defaultRadius,d_bounds);
+    rtc->copy(&bounds,d_bounds,sizeof(bounds));
+    rtc->freeMem(d_bounds);
+    return bounds;
+  }
+  
+}
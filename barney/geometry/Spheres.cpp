@@ -5,42 +5,331 @@
 #include "barney/geometry/Spheres.h"
 #include "barney/ModelSlot.h"
 #include "barney/Context.h"
+#include "barney/common/hostParallel.h"
+#include "barney/common/SpatialOrder.h"
 
 namespace BARNEY_NS {
 
   RTC_IMPORT_USER_GEOM(Spheres,Spheres,Spheres::DD,false,true);
+  RTC_IMPORT_USER_GEOM(Spheres,SpheresLOD,Spheres::DD,false,true);
+#if RTC_HAVE_NATIVE_SPHERES
+  RTC_IMPORT_SPHERES_GEOM(Spheres,NativeSpheres,Spheres::DD,true,true);
+#endif
   
   Spheres::Spheres(Context *context, DevGroup::SP devices)
     : Geometry(context,devices)
-  {}
+  {
+#if RTC_HAVE_NATIVE_SPHERES
+    useNative = !FromEnv::enabled("noNativeSpheres");
+#endif
+  }
+
+  /*! sorts spheres along a 63-bit morton curve, then builds the
+      hierarchy bottom-up: each level merges all (current) nodes whose
+      codes agree in all but the lowest 3*level bits - ie, that fall
+      into the same octree cell. Cells with only a single node don't
+      get a new node, so inner nodes have 2 to 8 children. Stops once
+      there are few enough nodes left, which then become the clusters
+      that the BVH gets built over. */
+  void Spheres::buildLOD()
+  {
+    Device *device = (*devices)[0];
+    const size_t numSpheres = origins->count;
+    std::vector<vec3f> h_origins(numSpheres);
+    origins->download(device,h_origins.data());
+    std::vector<float> h_radii;
+    if (radii) {
+      h_radii.resize(radii->count);
+      radii->download(device,h_radii.data());
+    }
+    std::vector<vec3f> h_colors;
+    if (colors) {
+      h_colors.resize(colors->count);
+      colors->download(device,h_colors.data());
+    }
+    auto radiusOf = [&](int primID)
+    { return primID < (int)h_radii.size() ? h_radii[primID] : defaultRadius; };
+    auto colorOf = [&](int primID)
+    { return primID < (int)h_colors.size() ? h_colors[primID] : vec3f(1.f); };
+
+    box3f bounds;
+    for (auto &org : h_origins)
+      bounds.extend(org);
+    std::vector<std::pair<uint64_t,int>> sorted(numSpheres);
+    hostParallelFor(numSpheres,1<<16,[&](size_t begin, size_t end){
+      for (size_t i=begin;i<end;i++)
+        sorted[i] = { mortonCode(h_origins[i],bounds),(int)i };
+    });
+    hostParallelSort(sorted,[](const std::pair<uint64_t,int> &a,
+                               const std::pair<uint64_t,int> &b)
+    { return a.first < b.first; });
+
+    std::vector<uint64_t> codes(numSpheres);
+    std::vector<int>      refs(numSpheres);
+    for (size_t i=0;i<numSpheres;i++) {
+      codes[i] = sorted[i].first;
+      refs[i]  = ~sorted[i].second;
+    }
+    sorted.clear();
+    sorted.shrink_to_fit();
+
+    std::vector<SpheresLODNode> nodes;
+    std::vector<vec3f>          nodeColors;
+    std::vector<int>            childRefs;
+    auto getChild = [&](int ref, box3f &box, vec4f &proxy, vec3f &color) {
+      if (ref < 0) {
+        int primID = ~ref;
+        float r = radiusOf(primID);
+        box   = box3f(h_origins[primID]-r,h_origins[primID]+r);
+        proxy = vec4f(h_origins[primID],r);
+        color = colorOf(primID);
+      } else {
+        const SpheresLODNode &node = nodes[ref];
+        box   = box3f(node.lower,node.upper);
+        proxy = node.proxy;
+        color = nodeColors[ref];
+      }
+    };
+    
+    const size_t numClusters = std::max((size_t)1,numSpheres/lodClusterSize);
+    for (int level=1;level<=21 && refs.size() > numClusters;level++) {
+      const int shift = 3*level;
+      std::vector<size_t> runBegin;
+      for (size_t i=0;i<refs.size();i++)
+        if (i == 0 || (codes[i]>>shift) != (codes[i-1]>>shift))
+          runBegin.push_back(i);
+      runBegin.push_back(refs.size());
+      const size_t numRuns = runBegin.size()-1;
+
+      std::vector<int>      newRefs(numRuns);
+      std::vector<uint64_t> newCodes(numRuns);
+      const size_t firstNew = nodes.size();
+      for (size_t run=0;run<numRuns;run++) {
+        size_t begin = runBegin[run], end = runBegin[run+1];
+        newCodes[run] = codes[begin];
+        if (end-begin == 1) {
+          newRefs[run] = refs[begin];
+          continue;
+        }
+        SpheresLODNode node;
+        node.childBegin = (int)childRefs.size();
+        node.childCount = (int)(end-begin);
+        newRefs[run] = (int)nodes.size();
+        nodes.push_back(node);
+        for (size_t i=begin;i<end;i++)
+          childRefs.push_back(refs[i]);
+      }
+      nodeColors.resize(nodes.size());
+      const size_t numNew = nodes.size()-firstNew;
+      hostParallelFor(numNew,1024,[&](size_t begin, size_t end){
+        for (size_t nodeID=firstNew+begin;nodeID<firstNew+end;nodeID++) {
+          SpheresLODNode &node = nodes[nodeID];
+          box3f nodeBounds;
+          vec3f sumCenter(0.f), sumColor(0.f);
+          float sumWeight = 0.f;
+          for (int i=0;i<node.childCount;i++) {
+            box3f box; vec4f proxy; vec3f color;
+            getChild(childRefs[node.childBegin+i],box,proxy,color);
+            nodeBounds.extend(box);
+            float weight = proxy.w*proxy.w*proxy.w;
+            sumWeight += weight;
+            sumCenter += weight*vec3f(proxy.x,proxy.y,proxy.z);
+            sumColor  += weight*color;
+          }
+          node.lower = nodeBounds.lower;
+          node.upper = nodeBounds.upper;
+          node.proxy
+            = sumWeight > 0.f
+            ? vec4f(sumCenter/sumWeight,cbrtf(sumWeight))
+            : vec4f(nodeBounds.center(),0.f);
+          nodeColors[nodeID]
+            = sumWeight > 0.f ? sumColor/sumWeight : vec3f(1.f);
+        }
+      });
+      refs.swap(newRefs);
+      codes.swap(newCodes);
+    }
+
+    lodNodes = lodColors = lodChildRefs = {};
+    if (!nodes.empty()) {
+      lodNodes = std::make_shared<PODData>(context,devices,BN_FLOAT4);
+      lodNodes->set(nodes.data(),3*nodes.size());
+      lodChildRefs = std::make_shared<PODData>(context,devices,BN_INT32);
+      lodChildRefs->set(childRefs.data(),childRefs.size());
+      if (colors) {
+        lodColors = std::make_shared<PODData>(context,devices,BN_FLOAT3);
+        lodColors->set(nodeColors.data(),nodeColors.size());
+      }
+    }
+    lodClusterRefs = std::make_shared<PODData>(context,devices,BN_INT32);
+    lodClusterRefs->set(refs.data(),refs.size());
+    
+    std::cout << OWL_TERMINAL_LIGHT_GREEN
+              << "#bn.spheres: lod built, "
+              << prettyNumber(numSpheres) << " spheres, "
+              << prettyNumber(nodes.size()) << " nodes, "
+              << prettyNumber(refs.size()) << " clusters"
+              << OWL_TERMINAL_DEFAULT << std::endl;
+  }
+  
+  void Spheres::buildSorted()
+  {
+    Device *device = (*devices)[0];
+    const size_t numSpheres = origins->count;
+    std::vector<vec3f> h_origins(numSpheres);
+    origins->download(device,h_origins.data());
+    std::vector<int> order = spatialOrder(h_origins);
+
+    std::vector<vec3f> h_sortedOrigins(numSpheres);
+    for (size_t i=0;i<numSpheres;i++)
+      h_sortedOrigins[i] = h_origins[order[i]];
+    sortedOrigins = std::make_shared<PODData>(context,devices,BN_FLOAT3);
+    sortedOrigins->set(h_sortedOrigins.data(),numSpheres);
+    sortedPrimIDs = std::make_shared<PODData>(context,devices,BN_INT32);
+    sortedPrimIDs->set(order.data(),numSpheres);
 
+    sortedRadii = {};
+    if (radii) {
+      std::vector<float> h_radii(radii->count);
+      radii->download(device,h_radii.data());
+      std::vector<float> h_sorted(numSpheres);
+      for (size_t i=0;i<numSpheres;i++)
+        h_sorted[i]
+          = order[i] < (int)h_radii.size() ? h_radii[order[i]] : defaultRadius;
+      sortedRadii = std::make_shared<PODData>(context,devices,BN_FLOAT);
+      sortedRadii->set(h_sorted.data(),numSpheres);
+    }
+    sortedColors = {};
+    if (colors) {
+      std::vector<vec3f> h_colors(colors->count);
+      colors->download(device,h_colors.data());
+      std::vector<vec3f> h_sorted(numSpheres);
+      for (size_t i=0;i<numSpheres;i++)
+        h_sorted[i]
+          = order[i] < (int)h_colors.size() ? h_colors[order[i]] : vec3f(1.f);
+      sortedColors = std::make_shared<PODData>(context,devices,BN_FLOAT3);
+      sortedColors->set(h_sorted.data(),numSpheres);
+    }
+  }
+  
   void Spheres::commit()
   {
     if (!origins) return;
 
+    bounds = computePointBounds(origins,radii,defaultRadius);
+    numPrims = origins->count;
+    if (useLOD)
+      buildLOD();
+    if (reorderPrims && !useLOD)
+      buildSorted();
+    else
+      sortedOrigins = sortedRadii = sortedColors = sortedPrimIDs = {};
+    /* what actually gets traced - either the app's arrays, or their
+       re-ordered copies */
+    PODData::SP traceOrigins = sortedOrigins ? sortedOrigins : origins;
+    PODData::SP traceRadii   = sortedOrigins ? sortedRadii   : radii;
+    PODData::SP traceColors  = sortedOrigins ? sortedColors  : colors;
+    
+#if RTC_HAVE_NATIVE_SPHERES
+    if (useNative && !useLOD) {
+      Device *device = (*devices)[0];
+      std::vector<vec3f> h_origins(traceOrigins->count);
+      traceOrigins->download(device,h_origins.data());
+      std::vector<float> h_radii;
+      if (traceRadii) {
+        h_radii.resize(traceRadii->count);
+        traceRadii->download(device,h_radii.data());
+      }
+      std::vector<vec4f> h_spheres(h_origins.size());
+      for (size_t i=0;i<h_origins.size();i++)
+        h_spheres[i] = vec4f(h_origins[i],
+                             i < h_radii.size() ? h_radii[i] : defaultRadius);
+      originsAndRadii = std::make_shared<PODData>(context,devices,BN_FLOAT4);
+      originsAndRadii->set(h_spheres.data(),h_spheres.size());
+    }
+#endif
+    
     for (auto device : *devices) {
       PLD *pld = getPLD(device);
+#if RTC_HAVE_NATIVE_SPHERES
+      if (useNative && !useLOD) {
+        for (auto geom : pld->userGeoms)
+          device->rtc->freeGeom(geom);
+        pld->userGeoms.clear();
+        if (pld->triangleGeoms.empty()) {
+          rtc::GeomType *gt
+            = device->geomTypes.get(createGeomType_NativeSpheres);
+          pld->triangleGeoms = { gt->createGeom() };
+        }
+        rtc::Geom *geom = pld->triangleGeoms[0];
+        geom->setVertices(originsAndRadii->getBuffer(device),
+                          (int)originsAndRadii->count);
+        
+        Spheres::DD dd;
+        Geometry::writeDD(dd,device);
+        dd.origins = (vec3f*)(traceOrigins->getDD(device));
+        dd.radii   = (float*)(traceRadii?traceRadii->getDD(device):0);
+        dd.colors  = (vec3f*)(traceColors?traceColors->getDD(device):0);
+        dd.defaultRadius = defaultRadius;
+        dd.primIDs
+          = (const int*)(sortedPrimIDs?sortedPrimIDs->getDD(device):0);
+        geom->setDD(&dd);
+        continue;
+      }
+#endif
+      for (auto geom : pld->triangleGeoms)
+        device->rtc->freeGeom(geom);
+      pld->triangleGeoms.clear();
+      if (!pld->userGeoms.empty() && userGeomIsLOD != useLOD) {
+        device->rtc->freeGeom(pld->userGeoms[0]);
+        pld->userGeoms.clear();
+      }
       if (pld->userGeoms.empty()) {
-        int numOrigins = (int)origins->count;
         rtc::GeomType *gt
-          = device->geomTypes.get(createGeomType_Spheres);
-        rtc::Geom *geom = gt->createGeom();
-        geom->setPrimCount(numOrigins);
-        pld->userGeoms.push_back(geom);
+          = device->geomTypes.get(useLOD
+                                  ? createGeomType_SpheresLOD
+                                  : createGeomType_Spheres);
+        pld->userGeoms.push_back(gt->createGeom());
       }
       rtc::Geom *geom = pld->userGeoms[0];
+      geom->setPrimCount(useLOD
+                         ? (int)lodClusterRefs->count
+                         : (int)origins->count);
       
       Spheres::DD dd;
       Geometry::writeDD(dd,device);
-      dd.origins = (vec3f*)(origins->getDD(device));
-      dd.radii   = (float*)(radii?radii->getDD(device):0);
-      dd.colors  = (vec3f*)(colors?colors->getDD(device):0);
+      dd.origins = (vec3f*)(traceOrigins->getDD(device));
+      dd.radii   = (float*)(traceRadii?traceRadii->getDD(device):0);
+      dd.colors  = (vec3f*)(traceColors?traceColors->getDD(device):0);
       dd.defaultRadius = defaultRadius;
+      dd.primIDs
+        = (const int*)(sortedPrimIDs?sortedPrimIDs->getDD(device):0);
+      dd.lodNodes
+        = (const SpheresLODNode*)(lodNodes?lodNodes->getDD(device):0);
+      dd.lodColors
+        = (const vec3f*)(lodColors?lodColors->getDD(device):0);
+      dd.lodChildRefs
+        = (const int*)(lodChildRefs?lodChildRefs->getDD(device):0);
+      dd.lodClusterRefs
+        = (const int*)(lodClusterRefs?lodClusterRefs->getDD(device):0);
+      dd.lodThreshold = lodThreshold;
       // done:
       geom->setDD(&dd);
     }
+    userGeomIsLOD = useLOD;
   } 
 
+  bool Spheres::set1i(const std::string &member, const int &value)
+  {
+    if (Geometry::set1i(member,value))
+      return true;
+    if (member == "lod") {
+      useLOD = (value != 0);
+      return true;
+    }
+    return false;
+  }
+
   bool Spheres::set1f(const std::string &member, const float &value)
   {
     if (Geometry::set1f(member,value))
@@ -49,6 +338,10 @@ namespace BARNEY_NS {
       defaultRadius = value;
       return true;
     }
+    if (member == "lodThreshold") {
+      lodThreshold = value;
+      return true;
+    }
     return false;
   }
   
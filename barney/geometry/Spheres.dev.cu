@@ -41,12 +41,43 @@ namespace BARNEY_NS {
     
     static inline __rtc_device
     void closestHit(rtc::TraceInterface &ti)
+    {
+      auto &ray = *(Ray*)ti.getPRD();
+      /*! isec code has temporarily stored object-space hit position
+        in ray.P, see below! */
+      shade(ti,ray.P);
+    }
+
+    /*! closest-hit shading for given object-space hit position;
+        shared with the native-spheres programs */
+    static inline __rtc_device
+    void shade(rtc::TraceInterface &ti, vec3f objectP)
+    {
+      auto &self = *(Spheres::DD*)ti.getProgramData();
+      int primID = ti.getPrimitiveIndex();
+      shade(ti,objectP,appPrimID(self,primID),
+            self.origins[primID],
+            self.radii?self.radii[primID]:self.defaultRadius,
+            self.colors?&self.colors[primID]:nullptr);
+    }
+    
+    /*! the app's ID for given (possibly re-ordered) sphere */
+    static inline __rtc_device
+    int appPrimID(const Spheres::DD &self, int primID)
+    { return self.primIDs ? self.primIDs[primID] : primID; }
+    
+    /*! closest-hit shading for a hit on given sphere - which for lod
+        spheres may also be a proxy standing in for sphere primID and
+        its neighbors */
+    static inline __rtc_device
+    void shade(rtc::TraceInterface &ti, vec3f objectP,
+               int primID, vec3f objectCenter, float objectRadius,
+               const vec3f *color)
     {
       auto &ray = *(Ray*)ti.getPRD();
       auto &self = *(Spheres::DD*)ti.getProgramData();
       const OptixGlobals &globals = OptixGlobals::get(ti);
       const World::DD &world = globals.world;
-      int primID = ti.getPrimitiveIndex();
       int instID = ti.getInstanceID();
 
 #ifdef NDEBUG
@@ -57,20 +88,12 @@ namespace BARNEY_NS {
       
       float t_hit = ti.getRayTmax(); 
 
-      vec3f org = ti.getWorldRayOrigin(); 
-      vec3f dir = ti.getWorldRayDirection();
-      /*! isec code has temporarily stored object-space hit position
-        in ray.P, see below! */
-      vec3f objectP = ray.P;
       vec3f worldP = ti.transformPointFromObjectToWorldSpace(objectP);
       
-      vec3f objectCenter
-        = self.origins[primID];
       vec3f objectN
         = (objectP == objectCenter)
         ? vec3f(1.f,0.f,0.f)
         : (objectP - objectCenter);
-      float objectRadius = self.radii?self.radii[primID]:self.defaultRadius;
 
       /* shift object-space hit a bit away from the sphere */
       float eps = 1e-6f;
@@ -90,8 +113,8 @@ namespace BARNEY_NS {
       hitData.primID          = primID;
       hitData.instID          = instID;
       hitData.t               = t_hit;
-      if (self.colors)
-        (vec3f&)hitData.color = self.colors[primID];
+      if (color)
+        (vec3f&)hitData.color = *color;
     
       auto interpolator = [&](const GeometryAttribute::DD &attrib,
                               bool faceVarying) -> vec4f
@@ -113,38 +136,31 @@ namespace BARNEY_NS {
       /* nothing - already set in isec */
     }
   
+    /*! ray-sphere test, for hits in (ray_tmin,ray_tmax); if found,
+        returns true, and sets ray_tmax and objectP to the hit */
     static inline __rtc_device
-    void intersect(rtc::TraceInterface &ti)
+    bool intersectSphere(vec3f old_org, vec3f dir,
+                         vec3f center, float radius,
+                         float ray_tmin, float &ray_tmax,
+                         vec3f &objectP)
     {
-      const int primID = ti.getPrimitiveIndex();//optixGetPrimitiveIndex();
-      const auto &self = *(const Spheres::DD*)ti.getProgramData();
-      // = owl::getProgramData<Spheres::DD>();
-      auto &ray = *(Ray*)ti.getPRD();//owl::getPRD<Ray>();
-      
-      vec3f center = self.origins[primID];
-      float radius = self.radii?self.radii[primID]:self.defaultRadius;
-      
       // with "move the origin" trick; see Ray Tracing Gems 2
-      // const vec3f old_org  = optixGetObjectRayOrigin();
-      const vec3f old_org  = ti.getObjectRayOrigin();
-      // const vec3f dir  = optixGetObjectRayDirection();
-      const vec3f dir  = ti.getObjectRayDirection();
       vec3f org = old_org;
       float t_move = max(0.f,length(center - old_org)-3.f*radius);
       org = org + t_move * dir;
-      float t_max = ti.getRayTmax() - t_move;
-      if (t_max < 0.f) return;
+      float t_max = ray_tmax - t_move;
+      if (t_max < 0.f) return false;
     
       float hit_t = t_max;
 
-      float tmin = max(0.f,ti.getRayTmin()-t_move);
+      float tmin = max(0.f,ray_tmin-t_move);
       const vec3f oc = org - center;
       const float a = dot(dir,dir);
       const float b = dot(oc, dir);
       const float c = dot(oc, oc) - radius * radius;
       const float discriminant = b * b - a * c;
     
-      if (discriminant < 0.f) return;
+      if (discriminant < 0.f) return false;
     
       {
         float temp = (-b - sqrtf(discriminant)) / a;
@@ -160,50 +176,283 @@ namespace BARNEY_NS {
       
 
       
-      if (hit_t < t_max) {
-        // "abuse" ray.P to store local sphere coordinate
-        vec3f osPositionOfHit = /*shifted!*/org + /*shifted!*/hit_t*dir;
-        ray.P = osPositionOfHit;
+      if (hit_t >= t_max) return false;
+      
+      objectP  = /*shifted!*/org + /*shifted!*/hit_t*dir;
+      ray_tmax = hit_t + t_move;
+      return true;
+    }
+    
+    static inline __rtc_device
+    void intersect(rtc::TraceInterface &ti)
+    {
+      const int primID = ti.getPrimitiveIndex();//optixGetPrimitiveIndex();
+      const auto &self = *(const Spheres::DD*)ti.getProgramData();
+      // = owl::getProgramData<Spheres::DD>();
+      auto &ray = *(Ray*)ti.getPRD();//owl::getPRD<Ray>();
+      DeviceCounters::count(OptixGlobals::get(ti).world.counters,
+                            DeviceCounters::PRIM_TESTS);
+      
+      vec3f center = self.origins[primID];
+      float radius = self.radii?self.radii[primID]:self.defaultRadius;
+      
+      float hit_t = ti.getRayTmax();
+      vec3f osPositionOfHit;
+      if (!intersectSphere(ti.getObjectRayOrigin(),
+                           ti.getObjectRayDirection(),
+                           center,radius,
+                           ti.getRayTmin(),hit_t,
+                           osPositionOfHit))
+        return;
       
-        hit_t += t_move;
-
-        // Cut-plane: reject hits on the invisible side
-        if (OptixGlobals::hitOnInvisibleSide(
-              OptixGlobals::get(ti), hit_t, ti))
-          return;
-
-        // ------------------------------------------------------------------
-        ti.reportIntersection(hit_t, 0);
-        const OptixGlobals &globals = OptixGlobals::get(ti);
-        if (globals.hitIDs) {
-          /* ID buffer rendering writes IDs no matter what transparency */
-          const World::DD &world = globals.world;
-          float depth = hit_t;
-          int instID    = ti.getInstanceID();
+      // "abuse" ray.P to store local sphere coordinate
+      ray.P = osPositionOfHit;
+      
+      // Cut-plane: reject hits on the invisible side
+      if (OptixGlobals::hitOnInvisibleSide(
+            OptixGlobals::get(ti), hit_t, ti))
+        return;
+
+      // ------------------------------------------------------------------
+      ti.reportIntersection(hit_t, 0);
+      writeHitIDs(ti,hit_t);
+    }
+
+    /*! ID buffer rendering writes IDs no matter what transparency */
+    static inline __rtc_device
+    void writeHitIDs(rtc::TraceInterface &ti, float depth)
+    {
+      const auto &self = *(const Spheres::DD*)ti.getProgramData();
+      writeHitIDs(ti,depth,appPrimID(self,ti.getPrimitiveIndex()));
+    }
+    
+    static inline __rtc_device
+    void writeHitIDs(rtc::TraceInterface &ti, float depth, int primID)
+    {
+      const OptixGlobals &globals = OptixGlobals::get(ti);
+      if (!globals.hitIDs) return;
+      
+      const auto &self = *(const Spheres::DD*)ti.getProgramData();
+      const World::DD &world = globals.world;
+      int instID    = ti.getInstanceID();
         
-          const int rayID
-            = ti.getLaunchIndex().x
-            + ti.getLaunchDims().x
-            * ti.getLaunchIndex().y;
-          if (depth < globals.hitIDs[rayID].depth) {
-            globals.hitIDs[rayID].primID = primID;
-            globals.hitIDs[rayID].instID
-              = world.instIDToUserInstID
-              ? world.instIDToUserInstID[instID]
-              : instID;
-            globals.hitIDs[rayID].instID
-              = 13+world.rank;
-            globals.hitIDs[rayID].objID  = self.userID;
-            globals.hitIDs[rayID].depth  = depth;
+      const int rayID
+        = ti.getLaunchIndex().x
+        + ti.getLaunchDims().x
+        * ti.getLaunchIndex().y;
+      if (depth < globals.hitIDs[rayID].depth) {
+        globals.hitIDs[rayID].primID = primID;
+        globals.hitIDs[rayID].instID
+          = world.instIDToUserInstID
+          ? world.instIDToUserInstID[instID]
+          : instID;
+        globals.hitIDs[rayID].instID
+          = 13+world.rank;
+        globals.hitIDs[rayID].objID  = self.userID;
+        globals.hitIDs[rayID].depth  = depth;
+      }
+    }
+#endif
+  };
+  RTC_EXPORT_USER_GEOM(Spheres,Spheres::DD,SpheresPrograms,false,true);
+
+  /*! programs for lod spheres: each prim is one cluster of the lod
+      hierarchy, and intersecting it means walking that cluster's
+      nodes - down to actual spheres where the ray's footprint is
+      small enough, or stopping at a node's proxy sphere where it
+      isn't */
+  struct SpheresLODPrograms {
+#if RTC_DEVICE_CODE
+    static inline __rtc_device
+    float safeRcp(float f)
+    { return 1.f/(fabsf(f) < 1e-20f ? copysignf(1e-20f,f) : f); }
+
+    /*! primID of given ref; for nodes, the first sphere below it, which
+        is what attributes get looked up for */
+    static inline __rtc_device
+    int primIDOf(const Spheres::DD &self, int ref)
+    {
+      while (ref >= 0)
+        ref = self.lodChildRefs[self.lodNodes[ref].childBegin];
+      return ~ref;
+    }
+    
+    static inline __rtc_device
+    void bounds(const rtc::TraceInterface &rt,
+                const void *geomData,
+                owl::common::box3f &bounds,  
+                const int32_t primID)
+    {
+      const Spheres::DD &self = *(const Spheres::DD *)geomData;
+      int ref = self.lodClusterRefs[primID];
+      if (ref < 0) {
+        vec3f origin = self.origins[~ref];
+        float radius = self.radii?self.radii[~ref]:self.defaultRadius;
+        bounds.lower = origin - radius;
+        bounds.upper = origin + radius;
+      } else {
+        bounds.lower = self.lodNodes[ref].lower;
+        bounds.upper = self.lodNodes[ref].upper;
+      }
+    }
+
+    /*! closest hit in (tmin,t_hit) with the part of given cluster
+        that is fine enough for the ray's footprint; nodes no wider
+        than lodThreshold pixels (at the distance the ray enters
+        them) get intersected as their proxy. Sets hitRef to what
+        got hit */
+    static inline __rtc_device
+    bool intersectCluster(const Spheres::DD &self, int clusterRef,
+                          float pixelAngle,
+                          vec3f org, vec3f dir,
+                          float tmin, float &t_hit,
+                          vec3f &objectP, int &hitRef)
+    {
+      enum { stackSize = 64 };
+      int stack[stackSize];
+      int top = 0;
+      stack[top++] = clusterRef;
+      const vec3f rcpDir
+        = vec3f(safeRcp(dir.x),safeRcp(dir.y),safeRcp(dir.z));
+      const float maxWidthPerT
+        = pixelAngle * self.lodThreshold * length(dir);
+      bool found = false;
+      while (top > 0) {
+        int ref = stack[--top];
+        vec3f center;
+        float radius;
+        if (ref < 0) {
+          center = self.origins[~ref];
+          radius = self.radii?self.radii[~ref]:self.defaultRadius;
+        } else {
+          const SpheresLODNode &node = self.lodNodes[ref];
+          vec3f t_lo = (node.lower - org) * rcpDir;
+          vec3f t_hi = (node.upper - org) * rcpDir;
+          float t0 = max(tmin,reduce_max(min(t_lo,t_hi)));
+          float t1 = min(t_hit,reduce_min(max(t_lo,t_hi)));
+          if (t0 > t1) continue;
+          float width = reduce_max(node.upper - node.lower);
+          /* descend while the node is wider than the footprint; if
+             the stack is full, the proxy has to do */
+          if (width > t0 * maxWidthPerT
+              && top + node.childCount <= stackSize) {
+            for (int i=0;i<node.childCount;i++)
+              stack[top++] = self.lodChildRefs[node.childBegin+i];
+            continue;
           }
+          center = vec3f(node.proxy.x,node.proxy.y,node.proxy.z);
+          radius = node.proxy.w;
+        }
+        if (SpheresPrograms::intersectSphere(org,dir,center,radius,
+                                             tmin,t_hit,objectP)) {
+          hitRef = ref;
+          found  = true;
         }
-        // ------------------------------------------------------------------
+      }
+      return found;
+    }
+
+    /*! closest visible (wrt the cut plane) hit with this prim's
+        cluster, with t < tmax */
+    static inline __rtc_device
+    bool findHit(rtc::TraceInterface &ti, float tmax,
+                 float &t_hit, vec3f &objectP, int &hitRef)
+    {
+      const auto &self = *(const Spheres::DD*)ti.getProgramData();
+      const OptixGlobals &globals = OptixGlobals::get(ti);
+      const int clusterRef = self.lodClusterRefs[ti.getPrimitiveIndex()];
+      const vec3f org = ti.getObjectRayOrigin();
+      const vec3f dir = ti.getObjectRayDirection();
+      float tmin = ti.getRayTmin();
+      while (true) {
+        t_hit = tmax;
+        if (!intersectCluster(self,clusterRef,globals.pixelAngle,
+                              org,dir,tmin,t_hit,objectP,hitRef))
+          return false;
+        if (!OptixGlobals::hitOnInvisibleSide(globals,t_hit,ti))
+          return true;
+        tmin = t_hit;
+      }
+    }
+    
+    static inline __rtc_device
+    void intersect(rtc::TraceInterface &ti)
+    {
+      const auto &self = *(const Spheres::DD*)ti.getProgramData();
+      float t_hit;
+      vec3f objectP;
+      int   hitRef;
+      DeviceCounters::count(OptixGlobals::get(ti).world.counters,
+                            DeviceCounters::PRIM_TESTS);
+      if (!findHit(ti,ti.getRayTmax(),t_hit,objectP,hitRef))
+        return;
+      ti.reportIntersection(t_hit, 0);
+      SpheresPrograms::writeHitIDs(ti,t_hit,primIDOf(self,hitRef));
+    }
 
+    static inline __rtc_device
+    void anyHit(rtc::TraceInterface &ti)
+    {}
+    
+    /*! rather than stashing which sphere or proxy got hit in the ray,
+        re-find it: traversal is deterministic, so asking for the
+        closest hit up to (just past) the reported one gives the same
+        one again */
+    static inline __rtc_device
+    void closestHit(rtc::TraceInterface &ti)
+    {
+      const auto &self = *(const Spheres::DD*)ti.getProgramData();
+      float t_hit;
+      vec3f objectP;
+      int   hitRef;
+      float tmax = ti.getRayTmax();
+      if (!findHit(ti,tmax+max(1e-6f,1e-5f*tmax),t_hit,objectP,hitRef))
+        return;
+      int primID = primIDOf(self,hitRef);
+      if (hitRef < 0)
+        SpheresPrograms::shade
+          (ti,objectP,primID,self.origins[primID],
+           self.radii?self.radii[primID]:self.defaultRadius,
+           self.colors?&self.colors[primID]:nullptr);
+      else {
+        const vec4f proxy = self.lodNodes[hitRef].proxy;
+        SpheresPrograms::shade
+          (ti,objectP,primID,vec3f(proxy.x,proxy.y,proxy.z),proxy.w,
+           self.lodColors?&self.lodColors[hitRef]:nullptr);
       }
     }
 #endif
   };
-  RTC_EXPORT_USER_GEOM(Spheres,Spheres::DD,SpheresPrograms,false,true);
+  RTC_EXPORT_USER_GEOM(SpheresLOD,Spheres::DD,SpheresLODPrograms,false,true);
+
+#if RTC_HAVE_NATIVE_SPHERES
+  /*! programs for spheres that the backend intersects by itself: the
+      cut-plane test and hit IDs move from isec to any-hit, and the
+      object-space hit position gets recomputed from the ray */
+  struct NativeSpheresPrograms {
+# if RTC_DEVICE_CODE 
+    static inline __rtc_device
+    void anyHit(rtc::TraceInterface &ti)
+    {
+      float depth = ti.getRayTmax();
+      if (OptixGlobals::hitOnInvisibleSide(OptixGlobals::get(ti), depth, ti)) {
+        ti.ignoreIntersection();
+        return;
+      }
+      SpheresPrograms::writeHitIDs(ti,depth);
+    }
+    
+    static inline __rtc_device
+    void closestHit(rtc::TraceInterface &ti)
+    {
+      vec3f worldP
+        = ti.getWorldRayOrigin() + ti.getRayTmax() * ti.getWorldRayDirection();
+      SpheresPrograms::shade(ti,ti.transformPointFromWorldToObjectSpace(worldP));
+    }
+# endif
+  };
+  RTC_EXPORT_SPHERES_GEOM(NativeSpheres,Spheres::DD,NativeSpheresPrograms,true,true);
+#endif
 }
 
 
@@ -8,6 +8,36 @@
 
 namespace BARNEY_NS {
 
+  /*! one inner node of a spheres' level-of-detail hierarchy: the
+      bounds of all spheres below it, plus a single proxy sphere
+      (volume-weighted center, volume-preserving radius) that stands
+      in for all of them once they get smaller than a pixel. Child
+      references are either node indices (>=0), or ~primID for
+      actual spheres. Exactly three float4s, so it can get uploaded
+      as a BN_FLOAT4 array */
+  struct SpheresLODNode {
+    vec3f lower;
+    int   childBegin;
+    vec3f upper;
+    int   childCount;
+    vec4f proxy;
+  };
+
+  /*! a set of spheres. Supported settable fields (in addition to
+      the generic geometry ones):
+
+      - "origins" (BNData<float3>), "radii" (BNData<float>),
+        "colors" (BNData<float3>), "radius" (float)
+      - "lod" (int) : if non-zero, the spheres get grouped into a
+        hierarchy of proxy spheres, and only the hierarchy's coarsest
+        clusters go into the BVH. Traversal descends into a cluster
+        only as long as its nodes are larger than the ray's pixel
+        footprint, so both BVH size and traversal cost stop scaling
+        with the raw sphere count. Meant for very large particle
+        data; always uses user geometry, never native spheres.
+      - "lodThreshold" (float) : nodes up to this many pixels wide
+        get replaced by their proxy; default 1
+  */
   struct Spheres : public Geometry {
     typedef std::shared_ptr<Spheres> SP;
 
@@ -16,7 +46,19 @@ namespace BARNEY_NS {
       float       *radii;
       vec3f       *colors;
       float        defaultRadius;
+      /*! only with reorderPrims: app's prim ID of each (re-ordered)
+          sphere; null if spheres are in the app's order */
+      const int   *primIDs;
       // const vec4f *vertexAttribute[5];
+
+      /*! only for lod: the hierarchy, and per-node average colors
+          (null if there are no per-sphere colors) */
+      const SpheresLODNode *lodNodes;
+      const vec3f          *lodColors;
+      const int            *lodChildRefs;
+      /*! one per user-geom prim */
+      const int            *lodClusterRefs;
+      float                 lodThreshold;
     };
 
     Spheres(Context *context, DevGroup::SP devices);
@@ -29,6 +71,7 @@ namespace BARNEY_NS {
     
     // ------------------------------------------------------------------
     /*! @{ parameter set/commit interface */
+    bool set1i(const std::string &member, const int &value) override;
     bool set1f(const std::string &member, const float &value) override;
     bool setData(const std::string &member, const barney_api::Data::SP &value) override;
     bool setObject(const std::string &member, const Object::SP &value) override;
@@ -39,6 +82,41 @@ namespace BARNEY_NS {
     PODData::SP colors  = 0;
     PODData::SP radii   = 0;
     float       defaultRadius = .1f;
+
+    /*! whether, on backends that can intersect spheres natively
+        (RTC_HAVE_NATIVE_SPHERES), we let the backend do that, rather
+        than doing our own intersection in a user geom. Can be
+        disabled through BARNEY_CONFIG="noNativeSpheres" */
+    bool        useNative = false;
+    /*! only for native spheres: (origin,radius) per sphere, in the
+        format the backend wants them in */
+    PODData::SP originsAndRadii = 0;
+
+    /*! with reorderPrims (and no lod, which has its own order):
+        copies of origins, radii, and colors in morton order of the
+        origins, plus the app's prim ID of each */
+    void buildSorted();
+    PODData::SP sortedOrigins;
+    PODData::SP sortedRadii;
+    PODData::SP sortedColors;
+    PODData::SP sortedPrimIDs;
+
+    /*! builds the lod hierarchy (on the host) from current origins,
+        radii, and colors */
+    void buildLOD();
+    
+    /*! on average about this many spheres per lod cluster (ie, per
+        user geom prim) */
+    enum { lodClusterSize = 256 };
+    bool        useLOD = false;
+    float       lodThreshold = 1.f;
+    /*! whether the current user geom got created for lod or regular
+        spheres */
+    bool        userGeomIsLOD = false;
+    PODData::SP lodNodes;
+    PODData::SP lodColors;
+    PODData::SP lodChildRefs;
+    PODData::SP lodClusterRefs;
   };
   
 }
@@ -5,17 +5,36 @@
 #include "barney/geometry/Triangles.h"
 #include "barney/ModelSlot.h"
 #include "barney/Context.h"
+#include "barney/common/KdPartition.h"
+#include "barney/common/SpatialOrder.h"
 
 namespace BARNEY_NS {
 
-  RTC_IMPORT_TRIANGLES_GEOM(Triangles,Triangles,Triangles::DD,true,false);
+  RTC_IMPORT_TRIANGLES_GEOM(Triangles,Triangles,Triangles::DD,true,true);
+  RTC_IMPORT_TRIANGLES_GEOM(Triangles,TrianglesOpaque,Triangles::DD,false,true);
 
   Triangles::Triangles(Context *context, DevGroup::SP devices)
     : Geometry(context,devices)
-  {}
+  {
+    partsPerLogical.resize(devices->numLogical);
+  }
   
   Triangles::~Triangles()
-  {}
+  {
+    freePartitions();
+  }
+  
+  bool Triangles::set1i(const std::string &member,
+                        const int &value)
+  {
+    if (Geometry::set1i(member,value))
+      return true;
+    if (member == "compactAttributes") {
+      useCompactAttributes = (value != 0);
+      return true;
+    }
+    return false;
+  }
   
   /*! handle data arrays for vertices, indices, normals, etc; note
       that 'general' geometry attributes of the ANARI material system
@@ -27,15 +46,20 @@ namespace BARNEY_NS {
       return true;
     
     if (member == "vertices") {
-      vertices = value->as<PODData>();
+      PODData::SP newVertices = value->as<PODData>();
+      if (!vertices || !newVertices || newVertices->count != vertices->count)
+        topologyVersion++;
+      vertices = newVertices;
       return true;
     }
     if (member == "indices") {
       indices = value->as<PODData>();
+      topologyVersion++;
       return true;
     }
     if (member == "normals") {
       normals = value->as<PODData>();
+      octNormals = {};
       return true;
     }
     if (member == "texcoords") {
@@ -46,25 +70,175 @@ namespace BARNEY_NS {
     return false;
   }
   
+  void Triangles::compactAttributes()
+  {
+    if (normals) {
+      Device *device = (*devices)[0];
+      std::vector<vec3f> h_normals(normals->count);
+      normals->download(device,h_normals.data());
+      std::vector<uint32_t> h_encoded(h_normals.size());
+      for (size_t i=0;i<h_normals.size();i++)
+        h_encoded[i] = octEncode(normalize(h_normals[i]));
+      octNormals = std::make_shared<PODData>(context,devices,BN_UINT32);
+      octNormals->set(h_encoded.data(),h_encoded.size());
+      normals = {};
+    }
+  }
+  
+  void Triangles::appendEmitters(std::vector<QuadLight::DD> &lights,
+                                 const affine3f &xfm)
+  {
+    const vec3f emission
+      = material ? material->constantEmission() : vec3f(0.f);
+    if (reduce_max(emission) <= 0.f || !vertices || !indices)
+      return;
+
+    if (hostTriangles.empty()) {
+      Device *device = (*devices)[0];
+      std::vector<vec3f> h_vertices(vertices->count);
+      std::vector<vec3i> h_indices(indices->count);
+      vertices->download(device,h_vertices.data());
+      indices->download(device,h_indices.data());
+      hostTriangles.reserve(3*h_indices.size());
+      for (auto idx : h_indices) {
+        if (reduce_min(idx) < 0 || reduce_max(idx) >= (int)h_vertices.size())
+          continue;
+        hostTriangles.push_back(h_vertices[idx.x]);
+        hostTriangles.push_back(h_vertices[idx.y]);
+        hostTriangles.push_back(h_vertices[idx.z]);
+      }
+    }
+
+    for (size_t i=0;i+2<hostTriangles.size();i+=3) {
+      QuadLight::DD light;
+      light.corner = xfmPoint(xfm,hostTriangles[i+0]);
+      light.edge0  = xfmPoint(xfm,hostTriangles[i+1])-light.corner;
+      light.edge1  = xfmPoint(xfm,hostTriangles[i+2])-light.corner;
+      vec3f N = cross(light.edge0,light.edge1);
+      float twiceArea = length(N);
+      if (!(twiceArea > 0.f)) continue;
+      light.normal     = N * (1.f/twiceArea);
+      light.area       = .5f*twiceArea;
+      light.emission   = emission;
+      light.isTriangle = 1;
+      lights.push_back(light);
+    }
+  }
+  
+  void Triangles::freePartitions()
+  {
+    for (auto device : *devices) {
+      PartPLD &part = partsPerLogical[device->contextRank()];
+      if (part.indices) device->rtc->freeBuffer(part.indices);
+      if (part.primIDs) device->rtc->freeBuffer(part.primIDs);
+      part = PartPLD();
+    }
+    partitionedTopology = -1;
+  }
+
+  void Triangles::buildPartitions()
+  {
+    freePartitions();
+    const int numParts = (*devices)[0]->partition.size;
+    // not worth it (and every part should get at least one)
+    if ((numParts <= 1 && !reorderPrims) || !vertices || !indices
+        || indices->count < (size_t)numParts)
+      return;
+    
+    Device *device = (*devices)[0];
+    std::vector<vec3f> h_vertices(vertices->count);
+    std::vector<vec3i> h_indices(indices->count);
+    vertices->download(device,h_vertices.data());
+    indices->download(device,h_indices.data());
+    std::vector<vec3f> centroids(h_indices.size());
+    for (size_t i=0;i<h_indices.size();i++) {
+      vec3i idx = h_indices[i];
+      if (reduce_min(idx) < 0 || reduce_max(idx) >= (int)h_vertices.size())
+        continue;
+      centroids[i]
+        = (h_vertices[idx.x]+h_vertices[idx.y]+h_vertices[idx.z])*(1.f/3.f);
+    }
+    std::vector<int> partOf
+      = numParts > 1
+      ? kdPartition(centroids,devices->partitionWeights())
+      : std::vector<int>(centroids.size(),0);
+    std::vector<int> order;
+    if (reorderPrims)
+      order = spatialOrder(centroids);
+    else {
+      order.resize(centroids.size());
+      for (size_t i=0;i<order.size();i++) order[i] = (int)i;
+    }
+
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      std::vector<vec3i> partIndices;
+      std::vector<int>   partPrimIDs;
+      for (int primID : order)
+        if (partOf[primID] == device->partition.rank) {
+          partIndices.push_back(h_indices[primID]);
+          partPrimIDs.push_back(primID);
+        }
+      PartPLD &part = partsPerLogical[device->contextRank()];
+      part.numIndices = (int)partIndices.size();
+      part.indices
+        = device->rtc->createBuffer(partIndices.size()*sizeof(vec3i),
+                                    partIndices.data());
+      part.primIDs
+        = device->rtc->createBuffer(partPrimIDs.size()*sizeof(int),
+                                    partPrimIDs.data());
+    }
+    partitionedTopology = topologyVersion;
+  }
+  
   void Triangles::commit() 
   {
+    hostTriangles.clear();
+    if (useCompactAttributes)
+      compactAttributes();
+    bounds = computePointBounds(vertices,{},0.f);
+    numPrims = indices ? indices->count : 0;
+    if (partitionedTopology != topologyVersion)
+      buildPartitions();
+
+    /* opaque meshes don't get an any-hit program at all; switching
+       between the two needs new geoms, and thus a group rebuild */
+    const bool opaque = material && material->isAlwaysOpaque();
+    if (opaque != builtAsOpaque) {
+      for (auto device : *devices) {
+        PLD *pld = getPLD(device);
+        for (auto geom : pld->triangleGeoms)
+          device->rtc->freeGeom(geom);
+        pld->triangleGeoms.clear();
+      }
+      builtAsOpaque = opaque;
+      topologyVersion++;
+    }
+    
     for (auto device : *devices) {
       PLD *pld = getPLD(device);
       if (pld->triangleGeoms.empty()) {
         rtc::GeomType *gt
-          = device->geomTypes.get(createGeomType_Triangles);
+          = device->geomTypes.get(opaque
+                                  ? createGeomType_TrianglesOpaque
+                                  : createGeomType_Triangles);
         rtc::Geom *geom = gt->createGeom();
         pld->triangleGeoms = { geom };
       }
     
       rtc::Geom *geom = pld->triangleGeoms[0];
       rtc::Buffer *verticesBuffer
-        = vertices->getPLD(device)->rtcBuffer;
+        = vertices->getBuffer(device);
       rtc::Buffer *indicesBuffer
-        = indices->getPLD(device)->rtcBuffer;
+        = indices->getBuffer(device);
       
       int numVertices = (int)vertices->count;
       int numIndices  = (int)indices->count;
+      PartPLD &part = partsPerLogical[device->contextRank()];
+      if (part.indices) {
+        indicesBuffer = part.indices;
+        numIndices    = part.numIndices;
+      }
       
       geom->setVertices(verticesBuffer,numVertices);
       geom->setIndices(indicesBuffer,numIndices);
@@ -74,6 +248,10 @@ namespace BARNEY_NS {
       dd.indices   = (vec3i*)indices->getDD(device);
       dd.normals   = (vec3f*)(normals?normals->getDD(device):0);
       dd.texcoords = (vec2f*)(texcoords?texcoords->getDD(device):0);
+      dd.octNormals
+        = (uint32_t*)(octNormals?octNormals->getDD(device):0);
+      dd.partPrimIDs
+        = part.primIDs ? (const int *)part.primIDs->getDD() : nullptr;
 
       // done:
       geom->setDD(&dd);
@@ -12,72 +12,71 @@ namespace BARNEY_NS {
     
   struct TrianglesPrograms {
 #if RTC_DEVICE_CODE
+    /*! ID buffer rendering writes IDs no matter what transparency */
     static inline __rtc_device
-    void closestHit(rtc::TraceInterface &rt)
-    {}
-
-    static inline __rtc_device
-    void anyHit(rtc::TraceInterface &ti)
+    void writeHitIDs(rtc::TraceInterface &ti,
+                     const Triangles::DD &self,
+                     int primID,
+                     float depth)
     {
-      auto &ray = *(Ray *)ti.getPRD();
-
       const OptixGlobals &globals = OptixGlobals::get(ti);
+      if (!globals.hitIDs) return;
       const World::DD &world = globals.world;
-#ifdef NDEBUG
-      bool dbg = false;
-#else
-      bool dbg = ray.dbg();
-#endif
-      // if (dbg) printf("=======================================================\n");
-      auto &self = *(Triangles::DD*)ti.getProgramData();
+      int instID    = ti.getInstanceID();
+      const int rayID
+        = ti.getLaunchIndex().x
+        + ti.getLaunchDims().x
+        * ti.getLaunchIndex().y;
+      if (depth < globals.hitIDs[rayID].depth) {
+        globals.hitIDs[rayID].primID = primID;
+        globals.hitIDs[rayID].instID
+          = world.instIDToUserInstID
+          ? world.instIDToUserInstID[instID]
+          : instID;
+        globals.hitIDs[rayID].objID  = self.userID;
+        globals.hitIDs[rayID].depth  = depth;
+      }
+    }
+
+    /*! the current hit's attributes; only with 'forShading' the
+        (interpolated) shading normal and the texture footprint,
+        which opacity never depends on */
+    static inline __rtc_device
+    render::HitAttributes hitAttributes(rtc::TraceInterface &ti,
+                                        const Triangles::DD &self,
+                                        const Ray &ray,
+                                        int primID,
+                                        bool forShading,
+                                        bool dbg)
+    {
+      const World::DD &world = OptixGlobals::get(ti).world;
       const float u = ti.getTriangleBarycentrics().x;
       const float v = ti.getTriangleBarycentrics().y;
-      int primID    = ti.getPrimitiveIndex();
       int instID    = ti.getInstanceID();
       float depth   = ti.getRayTmax();
-
-      // Cut-plane: reject hits on the invisible side
-      if (OptixGlobals::hitOnInvisibleSide(globals, depth, ti)) {
-        ti.ignoreIntersection();
-        return;
-      }
-
-      // ------------------------------------------------------------------
-      if (globals.hitIDs) {
-        /* ID buffer rendering writes IDs no matter what transparency */
-        const int rayID
-          = ti.getLaunchIndex().x
-          + ti.getLaunchDims().x
-          * ti.getLaunchIndex().y;
-        if (depth < globals.hitIDs[rayID].depth) {
-          globals.hitIDs[rayID].primID = primID;
-          globals.hitIDs[rayID].instID
-            = world.instIDToUserInstID
-            ? world.instIDToUserInstID[instID]
-            : instID;
-          globals.hitIDs[rayID].objID  = self.userID;
-          globals.hitIDs[rayID].depth  = depth;
-        }
-      }
-      // ------------------------------------------------------------------
-
       
       vec3i triangle = self.indices[primID];
       vec3f v0 = self.vertices[triangle.x];
       vec3f v1 = self.vertices[triangle.y];
       vec3f v2 = self.vertices[triangle.z];
       vec3f n = normalize(cross(v1-v0,v2-v0));
-      if (self.normals) {
+      if (!forShading) {
+        /* geometric normal is good enough */
+      } else if (self.normals) {
         vec3f Ns
           = (1.f-u-v) * self.normals[triangle.x]
           + (    u  ) * self.normals[triangle.y]
           + (      v) * self.normals[triangle.z];
         Ns = normalize(Ns);
         n = Ns;
+      } else if (self.octNormals) {
+        vec3f Ns
+          = (1.f-u-v) * octDecode(self.octNormals[triangle.x])
+          + (    u  ) * octDecode(self.octNormals[triangle.y])
+          + (      v) * octDecode(self.octNormals[triangle.z]);
+        n = normalize(Ns);
       }
       const vec3f osN = normalize(n);
-      // n = ti.transformNormalFromObjectToWorldSpace(n);
-      // n = normalize(n);
 
       // ------------------------------------------------------------------
       // get texture coordinates
@@ -109,20 +108,112 @@ namespace BARNEY_NS {
           return ret;
         };
       self.setHitAttributes(hitData,interpolator,world,dbg);
+      if (!forShading)
+        return hitData;
+
+      /* texture footprint: the ray cone's width at the hit, stretched
+         by how grazing the hit is; and for each interpolated
+         attribute, by how much it changes across the triangle
+         relative to the triangle's world-space size */
+      const float coneWidth = ray.coneWidthAt(depth);
+      if (coneWidth > 0.f) {
+        const vec3f e0 = ti.transformVectorFromObjectToWorldSpace(v1-v0);
+        const vec3f e1 = ti.transformVectorFromObjectToWorldSpace(v2-v0);
+        const vec3f Ng = cross(e0,e1);
+        const float worldArea = .5f*length(Ng);
+        if (worldArea > 0.f) {
+          const float cosTheta
+            = fabsf(dot(Ng,ray.dir))/(2.f*worldArea*length(ray.dir));
+          hitData.footprint = coneWidth / max(cosTheta,.05f);
+          for (int i=0;i<self.attributes.count;i++) {
+            const GeometryAttribute::DD &attrib = self.attributes.attribute[i];
+            bool faceVarying = (attrib.scope == GeometryAttribute::FACE_VARYING);
+            if (!faceVarying && attrib.scope != GeometryAttribute::PER_VERTEX)
+              continue;
+            vec3i indices
+              = faceVarying
+              ? (vec3i(3*primID)+vec3i(0,1,2))
+              : triangle;
+            const vec4f value_a = attrib.fromArray.valueAt(indices.x);
+            const vec4f value_b = attrib.fromArray.valueAt(indices.y);
+            const vec4f value_c = attrib.fromArray.valueAt(indices.z);
+            const float attribArea
+              = .5f*fabsf((value_b.x-value_a.x)*(value_c.y-value_a.y)
+                          -(value_b.y-value_a.y)*(value_c.x-value_a.x));
+            hitData.attributeScale[i] = sqrtf(attribArea/worldArea);
+          }
+        }
+      }
       hitData.worldNormal
         = ti.transformNormalFromObjectToWorldSpace
         ((const vec3f&)hitData.objectNormal);
+      return hitData;
+    }
+
+    static inline __rtc_device
+    int primIDOf(rtc::TraceInterface &ti, const Triangles::DD &self)
+    {
+      int primID = ti.getPrimitiveIndex();
+      return self.partPrimIDs ? self.partPrimIDs[primID] : primID;
+    }
+    
+    /*! only runs for the closest accepted hit, so this is the only
+        place that creates the bsdf */
+    static inline __rtc_device
+    void closestHit(rtc::TraceInterface &ti)
+    {
+      auto &ray = *(Ray *)ti.getPRD();
+#ifdef NDEBUG
+      bool dbg = false;
+#else
+      bool dbg = ray.dbg();
+#endif
+      auto &self = *(Triangles::DD*)ti.getProgramData();
+      const World::DD &world = OptixGlobals::get(ti).world;
+      int primID = primIDOf(ti,self);
+      writeHitIDs(ti,self,primID,ti.getRayTmax());
+      render::HitAttributes hitData
+        = hitAttributes(ti,self,ray,primID,/*forShading*/true,dbg);
+      const DeviceMaterial &material
+        = world.materials[self.materialID];
+      material.setHit(ray,hitData,world.samplers,dbg);
+    }
+
+    /*! opacity test only: decides whether to ignore a (potentially)
+        transparent hit, from just the attributes opacity depends
+        on; closestHit() does the rest */
+    static inline __rtc_device
+    void anyHit(rtc::TraceInterface &ti)
+    {
+      auto &ray = *(Ray *)ti.getPRD();
+
+      const OptixGlobals &globals = OptixGlobals::get(ti);
+      const World::DD &world = globals.world;
+#ifdef NDEBUG
+      bool dbg = false;
+#else
+      bool dbg = ray.dbg();
+#endif
+      auto &self = *(Triangles::DD*)ti.getProgramData();
+      int primID  = primIDOf(ti,self);
+      float depth = ti.getRayTmax();
 
+      // Cut-plane: reject hits on the invisible side
+      if (OptixGlobals::hitOnInvisibleSide(globals, depth, ti)) {
+        ti.ignoreIntersection();
+        return;
+      }
+      writeHitIDs(ti,self,primID,depth);
+
+      render::HitAttributes hitData
+        = hitAttributes(ti,self,ray,primID,/*forShading*/false,dbg);
       const DeviceMaterial &material
         = world.materials[self.materialID];
-      
-      PackedBSDF bsdf
-        = material.createBSDF(hitData,world.samplers,dbg);
       float opacity
-        = bsdf.getOpacity(ray.isShadowRay,ray.isInMedium,
-                          ray.dir,hitData.worldNormal,dbg);
+        = material.getOpacity(hitData,world.samplers,ray.isShadowRay,dbg);
 
       if (opacity < 1.f) {
+        const vec3f &osP = hitData.objectPosition;
         ray.rngSeed.next((const uint32_t&)osP.x);
         ray.rngSeed.next((const uint32_t&)osP.y);
         ray.rngSeed.next((const uint32_t&)osP.z);
@@ -132,11 +223,31 @@ namespace BARNEY_NS {
           return;
         }
       }
-      material.setHit(ray,hitData,world.samplers,dbg);
+      if (ray.isShadowRay)
+        /* occlusion queries may never get to closestHit() */
+        ray.setOccluded(depth);
     }
 #endif
   };
+
+  /*! for meshes whose material is always opaque (see
+      HostMaterial::isAlwaysOpaque()): no any-hit program at all, so
+      traversal never has to stop for candidate hits. Rays are
+      already clipped to the cut plane's visible side (see
+      TraceRays::beginTrace()), so there's nothing to reject */
+  struct TrianglesOpaquePrograms {
+#if RTC_DEVICE_CODE
+    static inline __rtc_device
+    void closestHit(rtc::TraceInterface &ti)
+    { TrianglesPrograms::closestHit(ti); }
+
+    static inline __rtc_device
+    void anyHit(rtc::TraceInterface &ti)
+    {}
+#endif
+  };
   
-  RTC_EXPORT_TRIANGLES_GEOM(Triangles,Triangles::DD,TrianglesPrograms,true,false);
+  RTC_EXPORT_TRIANGLES_GEOM(Triangles,Triangles::DD,TrianglesPrograms,true,true);
+  RTC_EXPORT_TRIANGLES_GEOM(TrianglesOpaque,Triangles::DD,TrianglesOpaquePrograms,false,true);
 }
 
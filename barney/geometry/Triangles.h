@@ -5,6 +5,7 @@
 #pragma once
 
 #include "barney/geometry/Geometry.h"
+#include "barney/light/QuadLight.h"
 
 namespace BARNEY_NS {
 
@@ -21,6 +22,11 @@ namespace BARNEY_NS {
       - "indices"   (BNData<int3>)
       - "normals"   (BNData<float3>)
       - "texcoords" (BNData<float2>)
+      - "compactAttributes" (int) : if non-zero, normals get stored
+        octahedral-encoded (32 bits rather than 96 per vertex), and
+        get decoded on the fly in the hit program. The full-precision
+        normals get released after encoding, so memory actually gets freed if the app doesn't
+        hold on to them either.
   */
   struct Triangles : public Geometry {
     typedef std::shared_ptr<Triangles> SP;
@@ -30,6 +36,13 @@ namespace BARNEY_NS {
       const vec3f *vertices;
       const vec3f *normals;
       const vec2f *texcoords;
+      /*! only set with compactAttributes, and if so, used instead of
+          normals */
+      const uint32_t *octNormals;
+      /*! with automatic partitioning, the rtc geom only holds this
+          device's part's triangles; this maps their primitive
+          indices back to the full mesh's. Null if not partitioned */
+      const int *partPrimIDs;
       // const vec4f *vertexAttribute[5];
     };
     
@@ -43,6 +56,10 @@ namespace BARNEY_NS {
     // ------------------------------------------------------------------
     /*! @{ parameter set/commit interface */
     void commit() override;
+    /*! setting new vertices of the same count keeps the topology, so
+        groups can just refit */
+    bool canRefit() const override { return true; }
+    bool set1i(const std::string &member, const int &value) override;
     bool setData(const std::string &member,
                  const barney_api::Data::SP &value) override;
     /*! @} */
@@ -53,6 +70,68 @@ namespace BARNEY_NS {
     PODData::SP normals;
     // TODO: do we still need this in times of ANARI?
     PODData::SP texcoords;
+
+    /*! encodes normals into octNormals, and releases the former */
+    void compactAttributes();
+
+    /*! if this mesh's material has a constant, non-zero emission,
+        appends one triangle light per (non-degenerate) triangle,
+        transformed by given instance transform */
+    void appendEmitters(std::vector<QuadLight::DD> &lights,
+                        const affine3f &xfm);
+    /*! three object-space vertices per triangle, fetched from the
+        device the first time appendEmitters() needs them after a
+        commit */
+    std::vector<vec3f> hostTriangles;
+    
+    bool        useCompactAttributes = false;
+    PODData::SP octNormals;
+
+    /*! with automatic partitioning (see Device::partition), splits
+        the triangles by a k-d split of their centroids, and gives
+        every device the indices of (only) its own part's, plus
+        their primitive IDs; re-done only when the topology
+        changes. With reorderPrims, each part's (or, without
+        partitioning, the single part of all) triangles additionally
+        get sorted along a morton curve of their centroids */
+    void buildPartitions();
+    void freePartitions();
+    struct PartPLD {
+      rtc::Buffer *indices = 0;
+      rtc::Buffer *primIDs = 0;
+      int          numIndices = 0;
+    };
+    std::vector<PartPLD> partsPerLogical;
+    int partitionedTopology = -1;
+    /*! whether the current geoms are of the TrianglesOpaque type,
+        which has no any-hit program (see commit()) */
+    bool builtAsOpaque = false;
   };
 
+  /*! encodes a unit vector into two 16-bit snorms of its octahedral
+      projection, x in the lower and y in the upper half */
+  inline __both__ uint32_t octEncode(vec3f n)
+  {
+    n = n * (1.f/(fabsf(n.x)+fabsf(n.y)+fabsf(n.z)));
+    vec2f e(n.x,n.y);
+    if (n.z < 0.f)
+      e = vec2f((1.f-fabsf(e.y))*(e.x >= 0.f ? 1.f : -1.f),
+                (1.f-fabsf(e.x))*(e.y >= 0.f ? 1.f : -1.f));
+    int ix = int(roundf(clamp(e.x,-1.f,1.f)*32767.f));
+    int iy = int(roundf(clamp(e.y,-1.f,1.f)*32767.f));
+    return (uint32_t(ix) & 0xffffu) | (uint32_t(iy) << 16);
+  }
+
+  /*! inverse of octEncode; returns a (not quite) unit vector */
+  inline __both__ vec3f octDecode(uint32_t bits)
+  {
+    vec2f e(float(int16_t(bits & 0xffffu))*(1.f/32767.f),
+            float(int16_t(bits >> 16))*(1.f/32767.f));
+    vec3f n(e.x,e.y,1.f-fabsf(e.x)-fabsf(e.y));
+    float t = max(-n.z,0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return n;
+  }
+
 }
@@ -4,39 +4,95 @@
 
 #include "barney/MPIContext.h"
 #include "barney/globalTrace/All2all.h"
+#include "barney/globalTrace/Transport.h"
+#include "barney/GlobalModel.h"
 #include "barney/DeviceGroup.h"
 #include "barney/render/RayQueue.h"
 #include "rtcore/ComputeInterface.h"
 
 namespace BARNEY_NS {
 
+  /*! if 'compressed' is set, rayOnly actually points to an array
+      of CompressedRay's (ditto for hitOnly in the kernels below) */
+  inline __rtc_device
+  void writeRayOnly(RayOnly *rayOnly, int idx, const Ray &ray, bool compressed)
+  {
+    if (compressed) {
+      ((CompressedRay*)rayOnly)[idx] = compressRay(ray);
+      return;
+    }
+    rayOnly[idx].org = ray.org;
+    rayOnly[idx].dir = ray.dir;
+    rayOnly[idx].tMax = ray.tMax;
+    rayOnly[idx].coneWidth = ray.coneWidth;
+    rayOnly[idx].coneSpread = ray.coneSpread;
+    rayOnly[idx].isInMedium = ray.isInMedium;
+    rayOnly[idx].isSpecular = ray.isSpecular;
+    rayOnly[idx].isShadowRay = ray.isShadowRay;
+    rayOnly[idx].dbg = ray._dbg;
+  }
+  
   __rtc_global
   void createRayOnly(const rtc::ComputeInterface &ci,
                      RayOnly *rayOnly,
                      Ray *rayQueue,
-                     int N)
+                     int N,
+                     bool compressed)
   {
     int tid = ci.launchIndex().x;
     if (tid >= N) return;
 
-    rayOnly[tid].org = rayQueue[tid].org;
-    rayOnly[tid].dir = rayQueue[tid].dir;
-    rayOnly[tid].tMax = rayQueue[tid].tMax;
-    rayOnly[tid].isInMedium = rayQueue[tid].isInMedium;
-    rayOnly[tid].isSpecular = rayQueue[tid].isSpecular;
-    rayOnly[tid].isShadowRay = rayQueue[tid].isShadowRay;
-    rayOnly[tid].dbg = rayQueue[tid]._dbg;
+    writeRayOnly(rayOnly,tid,rayQueue[tid],compressed);
+  }
+
+  /*! writes each ray into the send buffer segment of every peer
+      whose domain its [0,tMax] segment overlaps; segments are N rays
+      each. For each ray and peer, routeSlots[peer*N+tid] gets where
+      in that peer's segment the ray went (or -1) */
+  __rtc_global
+  void routeRaysToPeers(const rtc::ComputeInterface &ci,
+                        RayOnly *rayOnly,
+                        int *routeSlots,
+                        int *routeCounts,
+                        Ray *rayQueue,
+                        int N,
+                        const box3f *peerBounds,
+                        int islandSize,
+                        bool compressed)
+  {
+    int tid = ci.launchIndex().x;
+    if (tid >= N) return;
+
+    Ray ray = rayQueue[tid];
+    // test along the direction the peer will actually trace
+    vec3f dir = compressed ? compressedDirection(ray) : ray.dir;
+    for (int peer=0;peer<islandSize;peer++) {
+      float t0 = 0.f, t1 = ray.tMax;
+      int slot = -1;
+      /* rays with a cached primary hit don't need anybody else's */
+      if (!ray.preTraced && render::boxTest(t0,t1,peerBounds[peer],ray.org,dir)) {
+        slot = ci.atomicAdd(&routeCounts[peer],1);
+        writeRayOnly(rayOnly,peer*N+slot,ray,compressed);
+      }
+      routeSlots[peer*N+tid] = slot;
+    }
   }
 
   __rtc_global
   void buildHitsOnly(const rtc::ComputeInterface &ci,
                      HitOnly *hitOnly,
                      Ray *rayQueue,
-                     int N)
+                     int N,
+                     bool compressed)
   {
     int tid = ci.launchIndex().x;
     if (tid >= N) return;
 
+    if (compressed) {
+      ((CompressedHit*)hitOnly)[tid] = compressHit(rayQueue[tid]);
+      return;
+    }
+
     hitOnly[tid].tHit = rayQueue[tid].tMax;
     hitOnly[tid].P = rayQueue[tid].P;
     hitOnly[tid].N = rayQueue[tid].N;
@@ -54,19 +110,28 @@ namespace BARNEY_NS {
   void buildStagedRayQueue(const rtc::ComputeInterface &ci,
                            Ray *rayQueue,
                            RayOnly *rayOnly,
-                           int N)
+                           int N,
+                           bool compressed)
   {
     int tid = ci.launchIndex().x;
     if (tid >= N) return;
 
+    if (compressed) {
+      decompressRay(rayQueue[tid],((const CompressedRay*)rayOnly)[tid]);
+      return;
+    }
     rayQueue[tid].org = rayOnly[tid].org;
     rayQueue[tid].dir = rayOnly[tid].dir;
     rayQueue[tid].tMax = rayOnly[tid].tMax;
+    rayQueue[tid].coneWidth = rayOnly[tid].coneWidth;
+    rayQueue[tid].coneSpread = rayOnly[tid].coneSpread;
     rayQueue[tid].isInMedium = rayOnly[tid].isInMedium;
     rayQueue[tid].isSpecular = rayOnly[tid].isSpecular;
     rayQueue[tid].isShadowRay = rayOnly[tid].isShadowRay;
     rayQueue[tid]._dbg = rayOnly[tid].dbg;
+    rayQueue[tid].preTraced = false;
     rayQueue[tid].bsdfType = PackedBSDF::NONE;
+    shadowTransmittance(rayQueue[tid].hitBSDF) = 1.f;
   }
   
   __rtc_global
@@ -74,23 +139,19 @@ namespace BARNEY_NS {
                           Ray *rayQueueThisRank,
                           HitOnly *hitOnlyAllRanks,
                           int nRays,
-                          int islandSize)
+                          int islandSize,
+                          const int *routeSlots,
+                          bool compressed)
   {
     int tid = ci.launchIndex().x;
     if (tid >= nRays) return;
 
     Ray ray = rayQueueThisRank[tid];
-    for (int peer=0;peer<islandSize;peer++) {
-      HitOnly *hit = hitOnlyAllRanks+peer*nRays+tid;
-
-      if (hit->tHit >= ray.tMax) continue;
-
-      ray.tMax     = hit->tHit;
-      ray.bsdfType = hit->bsdfType;
-      ray.hitBSDF  =  hit->hitBSDF;
-      ray.P        =  hit->P;
-      ray.N        =  hit->N;
-    }
+    if (compressed)
+      reduceHitsInto(ray,(const CompressedHit*)hitOnlyAllRanks,
+                     tid,nRays,islandSize,routeSlots);
+    else
+      reduceHitsInto(ray,hitOnlyAllRanks,tid,nRays,islandSize,routeSlots);
     rayQueueThisRank[tid] = ray;
   }
 
@@ -100,6 +161,10 @@ namespace BARNEY_NS {
       context(context)
   {
     opt_mpi = FromEnv::enabled("opt_mpi");
+    compressRays = FromEnv::enabled("compressRays");
+    rayWireSize = compressRays ? sizeof(CompressedRay) : sizeof(RayOnly);
+    hitWireSize = compressRays ? sizeof(CompressedHit) : sizeof(HitOnly);
+    routeRays = FromEnv::enabled("routeRays");
     if (opt_mpi && context->devices->numLogical > 1)
       throw std::runtime_error("opt_mpi_all2all optimization only works for exactly one gpu per rank, and without island parallelism");
     if (opt_mpi)
@@ -113,6 +178,15 @@ namespace BARNEY_NS {
       int myGID = device->globalRank();
       auto &ourDev  = topo->allDevices[myGID];
       pld->perIslandPeer.rayCount.resize(islandSize);
+      pld->perIslandPeer.sendCount.resize(islandSize);
+      if (routeRays) {
+        SetActiveGPU forDuration(device);
+        pld->hostPeerBounds.resize(islandSize);
+        pld->routeCounts
+          = (int *)device->rtc->allocMem(islandSize*sizeof(int));
+        pld->peerBounds
+          = (box3f *)device->rtc->allocMem(islandSize*sizeof(box3f));
+      }
     }
   }
   
@@ -139,6 +213,7 @@ namespace BARNEY_NS {
         if (pld->recv.hitsOnly) rtc->freeMem(pld->recv.hitsOnly);
 
         if (pld->stagedRayQueue) rtc->freeMem(pld->stagedRayQueue);
+        if (pld->routeSlots) rtc->freeMem(pld->routeSlots);
         
         size_t N = ourRequiredQueueSize;
         pld->send.raysOnly = (RayOnly*)rtc->allocMem(N*sizeof(RayOnly));
@@ -146,6 +221,8 @@ namespace BARNEY_NS {
         pld->send.hitsOnly = (HitOnly*)rtc->allocMem(N*sizeof(HitOnly));
         pld->recv.hitsOnly = (HitOnly*)rtc->allocMem(N*sizeof(HitOnly));
         pld->stagedRayQueue = (Ray *)rtc->allocMem(N*sizeof(Ray));
+        if (routeRays)
+          pld->routeSlots = (int *)rtc->allocMem(N*sizeof(int));
         
         pld->currentSize = N;
       }
@@ -156,17 +233,17 @@ namespace BARNEY_NS {
   // many rays (needed to set up the send/receives)
   void MPIAll2all::exchangeHowManyRaysEachDeviceHas()
   {
+    NvtxRange nvtx("exchangeHowManyRaysEachDeviceHas");
     auto &world = context->world;
     auto topo = context->topo;
 
     if (opt_mpi) {
       auto device = context->devices->get(0);
       auto pld = getPLD(device);
-      const int &myRayCount = device->rayQueue->numActive;
-      BN_MPI_CALL(Allgather(&myRayCount,1,MPI_INT,
-                            (int*)pld->perIslandPeer.rayCount.data(),
-                            1,MPI_INT,
-                            world.comm));
+      BN_MPI_CALL(Alltoall((int*)pld->perIslandPeer.sendCount.data(),1,MPI_INT,
+                           (int*)pld->perIslandPeer.rayCount.data(),
+                           1,MPI_INT,
+                           world.comm));
     } else {
       int islandSize = context->topo->islandSize();
       std::vector<MPI_Request> requests;
@@ -177,7 +254,7 @@ namespace BARNEY_NS {
         // pld->perIslandPeer.rayCount.resize(islandSize);
 
         /* iw: use reference here, to make sure the send doesn't use a stack temp */
-        int &myRayCount = device->rayQueue->numActive;
+        std::vector<int> &sendCount = pld->perIslandPeer.sendCount;
         const std::vector<int> &peers
           = topo->islands[topo->islandOf[device->globalRank()]];
         for (auto peer : peers) {
@@ -193,7 +270,7 @@ namespace BARNEY_NS {
           auto &peerDev = topo->allDevices[peer];
           MPI_Request req;
           world.send(peerDev.worldRank,(peerDev.local << 8) + ourDev.local,
-                     &myRayCount,1,req);
+                     &sendCount[topo->islandRankOf[peer]],1,req);
           requests.push_back(req);
           // world.recv(peerDev.worldRank,peerDev.local,
           //            &pld->perIslandPeer.rayCount[topo->islandRankOf[peer]],1,req);
@@ -210,6 +287,7 @@ namespace BARNEY_NS {
                                         uint32_t rngSeed,
                                         bool needHitIDs)
   {
+    NvtxRange nvtx("traceAllReceivedRays");
     auto topo = context->topo;
 
     for (auto device : *context->devices) {
@@ -221,7 +299,8 @@ namespace BARNEY_NS {
                    // args
                    pld->stagedRayQueue,
                    pld->recv.raysOnly,
-                   pld->numRemoteRaysReceived);
+                   pld->numRemoteRaysReceived,
+                   compressRays);
     }
     
     for (auto device : *context->devices) {
@@ -240,27 +319,87 @@ namespace BARNEY_NS {
   }
   
 
-  void MPIAll2all::sendAndReceiveRays()
+  void MPIAll2all::buildRaysToSend()
   {
-    auto topo = context->topo;
-    auto &world = context->world;
-
+    NvtxRange nvtx("buildRaysToSend");
+    int islandSize = context->topo->islandSize();
     for (auto device : *context->devices) {
       SetActiveGPU forDuration(device);
       PLD *pld = getPLD(device);
       int numRays = device->rayQueue->numActive;
       int bs = 128;
       int nb = divRoundUp(numRays,bs);
-      __rtc_launch(device->rtc,
-                   createRayOnly,
-                   nb,bs,
-                   // args
-                   pld->send.raysOnly,
-                   device->rayQueue->traceAndShadeReadQueue.rays,
-                   numRays);
+      if (!routing()) {
+        __rtc_launch(device->rtc,
+                     createRayOnly,
+                     nb,bs,
+                     // args
+                     pld->send.raysOnly,
+                     device->rayQueue->traceAndShadeReadQueue.rays,
+                     numRays,
+                     compressRays);
+        for (auto &sendCount : pld->perIslandPeer.sendCount)
+          sendCount = numRays;
+        continue;
+      }
+      device->rtc->memsetAsync(pld->routeCounts,0,islandSize*sizeof(int));
+      if (numRays > 0)
+        __rtc_launch(device->rtc,
+                     routeRaysToPeers,
+                     nb,bs,
+                     // args
+                     pld->send.raysOnly,
+                     pld->routeSlots,
+                     pld->routeCounts,
+                     device->rayQueue->traceAndShadeReadQueue.rays,
+                     numRays,
+                     pld->peerBounds,
+                     islandSize,
+                     compressRays);
+      device->rtc->copyAsync(pld->perIslandPeer.sendCount.data(),
+                             pld->routeCounts,islandSize*sizeof(int));
     }
+    if (routing())
+      for (auto device : *context->devices)
+        device->rtc->sync();
+  }
+  
+  void MPIAll2all::sendAndReceiveRays()
+  {
+    NvtxRange nvtx("sendAndReceiveRays");
+    auto topo = context->topo;
+    auto &world = context->world;
 
-    if (opt_mpi) {
+    if (opt_mpi && routing()) {
+      auto device = context->devices->get(0);
+      device->rtc->sync();
+      auto pld = getPLD(device);
+
+      int myRayCount = device->rayQueue->numActive;
+      std::vector<int> sendOffsets(world.size);
+      std::vector<int> sendCounts(world.size);
+      std::vector<int> recvOffsets(world.size);
+      std::vector<int> recvCounts(world.size);
+      int recvOfs = 0;
+      for (int peer=0;peer<world.size;peer++) {
+        sendOffsets[peer] = sendSegment(peer,myRayCount)*rayWireSize;
+        sendCounts[peer]  = pld->perIslandPeer.sendCount[peer]*rayWireSize;
+        int recvCount = pld->perIslandPeer.rayCount[peer];
+        recvOffsets[peer] = recvOfs*rayWireSize;
+        recvCounts[peer]  = recvCount*rayWireSize;
+        recvOfs += recvCount;
+      }
+      pld->numRemoteRaysReceived = recvOfs;
+      BN_MPI_CALL(Alltoallv(pld->send.raysOnly,
+                            (const int*)sendCounts.data(),
+                            (const int*)sendOffsets.data(),
+                            MPI_BYTE,
+                            pld->recv.raysOnly,
+                            (const int*)recvCounts.data(),
+                            (const int*)recvOffsets.data(),
+                            MPI_BYTE,
+                            world.comm));
+    } else if (opt_mpi) {
       std::vector<int> recvOffsets(world.size);
       std::vector<int> recvCounts(world.size);
 
@@ -275,13 +414,13 @@ namespace BARNEY_NS {
       int myRayCount = device->rayQueue->numActive;
       // have ray count, can compute send buf and send count:
       const void *sendBuf = pld->send.raysOnly;
-      int sendCount = myRayCount * sizeof(RayOnly);
+      int sendCount = myRayCount * rayWireSize;
       void *recvBuf = pld->recv.raysOnly;
       int recvOfs = 0;
       for (int peer=0;peer<world.size;peer++) {
         int recvCount = pld->perIslandPeer.rayCount[peer];
-        recvOffsets[peer] = recvOfs*sizeof(RayOnly); // BYTES!
-        recvCounts[peer] = recvCount*sizeof(RayOnly); // BYTES!
+        recvOffsets[peer] = recvOfs*rayWireSize; // BYTES!
+        recvCounts[peer] = recvCount*rayWireSize; // BYTES!
         recvOfs += recvCount; // RAYS
       }
       pld->numRemoteRaysReceived = recvOfs;
@@ -291,12 +430,11 @@ namespace BARNEY_NS {
                              MPI_BYTE,
                              world.comm));
     } else {
-      std::vector<MPI_Request> requests;
+      auto &transport = *context->transport;
       for (auto device : *context->devices) {
         device->rtc->sync();
         auto pld = getPLD(device);
         int myGID = device->globalRank();
-        auto &ourDev  = topo->allDevices[myGID];
         
         pld->numRemoteRaysReceived = 0;      
         int myRayCount = device->rayQueue->numActive;
@@ -304,49 +442,46 @@ namespace BARNEY_NS {
           = topo->islands[topo->islandOf[device->globalRank()]];
         int recvOfs = 0;
         for (auto peer : peers) {
-          auto &peerDev = topo->allDevices[peer];
           int peerIslandRank = topo->islandRankOf[peer];
           int recvCount = pld->perIslandPeer.rayCount[peerIslandRank];
           if (peer == device->_globalRank) {
             if (recvCount > 0) {
-              device->rtc->copyAsync(pld->recv.raysOnly+recvOfs,
-                                     pld->send.raysOnly,
-                                     recvCount*sizeof(RayOnly));
+              device->rtc->copyAsync(rayAt(pld->recv.raysOnly,recvOfs),
+                                     rayAt(pld->send.raysOnly,
+                                           sendSegment(peerIslandRank,myRayCount)),
+                                     recvCount*rayWireSize);
             }
           } else {
-            if (recvCount) {
-              MPI_Request req;
-              world.recv(peerDev.worldRank,(ourDev.local << 8) + peerDev.local,
-                         pld->recv.raysOnly+recvOfs,recvCount,req);
-              requests.push_back(req);
-            }
+            if (recvCount)
+              transport.recv(device,peer,
+                             rayAt(pld->recv.raysOnly,recvOfs),
+                             recvCount*rayWireSize);
           }
           recvOfs += recvCount;
         }
         for (auto peer : peers) {
-          auto &peerDev = topo->allDevices[peer];
-          MPI_Request req;
           int peerIslandRank = topo->islandRankOf[peer];
-          int recvCount = pld->perIslandPeer.rayCount[peerIslandRank];
+          int sendCount = pld->perIslandPeer.sendCount[peerIslandRank];
           
           if (peer == device->_globalRank) {
             // this was a memcpy, nothing to do
           } else {
-            if (myRayCount) {
-              world.send(peerDev.worldRank,(peerDev.local << 8) + ourDev.local,
-                         pld->send.raysOnly,myRayCount,req);
-              requests.push_back(req);
-            }
+            if (sendCount)
+              transport.send(device,peer,
+                             rayAt(pld->send.raysOnly,
+                                   sendSegment(peerIslandRank,myRayCount)),
+                             sendCount*rayWireSize);
           }
         }
         pld->numRemoteRaysReceived = recvOfs;
       }
-      BN_MPI_CALL(Waitall(requests.size(),requests.data(),MPI_STATUSES_IGNORE));
+      transport.flush();
     }
   }
   
   void MPIAll2all::sendAndReceiveHits()
   {
+    NvtxRange nvtx("sendAndReceiveHits");
     auto &world = context->world;
     auto topo = context->topo;
 
@@ -359,7 +494,8 @@ namespace BARNEY_NS {
                    // args
                    pld->send.hitsOnly,
                    device->rayQueue->traceAndShadeReadQueue.rays,
-                   pld->numRemoteRaysReceived);
+                   pld->numRemoteRaysReceived,
+                   compressRays);
     }
 
     if (opt_mpi) {
@@ -378,9 +514,10 @@ namespace BARNEY_NS {
       std::vector<int> sendCounts(world.size);
       for (int peer=0;peer<world.size;peer++) {
         int sendCount = pld->perIslandPeer.rayCount[peer];
-        int recvCount = myRayCount;
-        sendOffsets[peer] = sendOfs * sizeof(HitOnly);
-        recvOffsets[peer] = recvOfs * sizeof(HitOnly);
+        // we only get hits back for those rays we sent
+        int recvCount = pld->perIslandPeer.sendCount[peer];
+        sendOffsets[peer] = sendOfs * hitWireSize;
+        recvOffsets[peer] = recvOfs * hitWireSize;
         // if (peer == device->globalRank()) {
         //   if (recvCount > 0)
         //     device->rtc->copyAsync(pld->recv.hitsOnly+recvOfs,
@@ -389,9 +526,9 @@ namespace BARNEY_NS {
         //   sendCounts[peer] = 0;
         //   recvCounts[peer] = 0;
         // } else {
-        sendCounts[peer] = sendCount * sizeof(HitOnly);
-        recvCounts[peer] = recvCount * sizeof(HitOnly);
-        recvOfs += recvCount;
+        sendCounts[peer] = sendCount * hitWireSize;
+        recvCounts[peer] = recvCount * hitWireSize;
+        recvOfs += myRayCount;
         sendOfs += sendCount;
         // }
       }
@@ -405,12 +542,11 @@ namespace BARNEY_NS {
                             MPI_BYTE,
                             world.comm));
     } else {
-      std::vector<MPI_Request> requests;
+      auto &transport = *context->transport;
       for (auto device : *context->devices) {
         device->rtc->sync();
         auto pld = getPLD(device);
         int myGID = device->globalRank();
-        auto &ourDev  = topo->allDevices[myGID];
 
         int myRayCount = pld->savedOriginalRayCount;
         const std::vector<int> &peers
@@ -418,41 +554,38 @@ namespace BARNEY_NS {
         int sendOfs = 0;
         int recvOfs = 0;
         for (auto peer : peers) {
-          auto &peerDev = topo->allDevices[peer];
-          MPI_Request req;
           int peerIslandRank = topo->islandRankOf[peer];
           int sendCount = pld->perIslandPeer.rayCount[peerIslandRank];
-          int recvCount = myRayCount;
+          int recvCount = pld->perIslandPeer.sendCount[peerIslandRank];
           if (peer == device->globalRank()) {
             if (recvCount > 0)
-              device->rtc->copyAsync(pld->recv.hitsOnly+recvOfs,
-                                     pld->send.hitsOnly+sendOfs,
-                                     recvCount*sizeof(HitOnly));
+              device->rtc->copyAsync(hitAt(pld->recv.hitsOnly,recvOfs),
+                                     hitAt(pld->send.hitsOnly,sendOfs),
+                                     recvCount*hitWireSize);
           } else {
-            world.recv(peerDev.worldRank,(ourDev.local << 8)+peerDev.local,
-                       pld->recv.hitsOnly+recvOfs,recvCount,req);
-            requests.push_back(req);
+            transport.recv(device,peer,
+                           hitAt(pld->recv.hitsOnly,recvOfs),
+                           recvCount*hitWireSize);
           }
-          recvOfs += recvCount;
+          // hits from each peer go into their own segment, with room
+          // for all of our rays
+          recvOfs += myRayCount;
           sendOfs += sendCount;
         }
         sendOfs = 0;
         for (auto peer : peers) {
-          auto &peerDev = topo->allDevices[peer];
-          MPI_Request req;
           int peerIslandRank = topo->islandRankOf[peer];
           int sendCount = pld->perIslandPeer.rayCount[peerIslandRank];
           if (peer == device->globalRank()) {
           } else {
-            world.send(peerDev.worldRank,(peerDev.local << 8)+ourDev.local,
-                       pld->send.hitsOnly+sendOfs,sendCount,req);
-            requests.push_back(req);
+            transport.send(device,peer,
+                           hitAt(pld->send.hitsOnly,sendOfs),
+                           sendCount*hitWireSize);
           }
           sendOfs += sendCount;
         }
       }
-      BN_MPI_CALL(Waitall(requests.size(),requests.data(),MPI_STATUSES_IGNORE));
-      requests.clear();
+      transport.flush();
     }
   }
 
@@ -460,6 +593,7 @@ namespace BARNEY_NS {
   // spawend them, and write them into local ray queue.
   void MPIAll2all::mergeReceivedHitsWithOriginalRays()
   {
+    NvtxRange nvtx("mergeReceivedHitsWithOriginalRays");
     // auto &world = context->world;
     auto topo = context->topo;
     int islandSize = context->topo->islandSize();
@@ -475,7 +609,9 @@ namespace BARNEY_NS {
                    pld->savedOriginalRayQueue,
                    pld->recv.hitsOnly,
                    myRayCount,
-                   islandSize);
+                   islandSize,
+                   routing() ? pld->routeSlots : nullptr,
+                   compressRays);
       device->rayQueue->numActive = myRayCount;
       device->rayQueue->traceAndShadeReadQueue.rays = pld->savedOriginalRayQueue;
     }
@@ -485,10 +621,49 @@ namespace BARNEY_NS {
   }
 
   
+  void MPIAll2all::beginFrame(GlobalModel *model)
+  {
+    if (!routeRays) return;
+    auto topo = context->topo;
+
+    /* the app may have changed any slot's bounds since the last
+       frame, so have everybody publish theirs again */
+    std::vector<box3f> allBounds = context->gatherDomainBounds(model);
+
+    /* it takes only one device without bounds to make routing
+       useless; all ranks see the same bounds, so all agree on
+       this */
+    haveAllBounds = true;
+    for (auto &bounds : allBounds)
+      if (bounds.empty()) haveAllBounds = false;
+    if (!haveAllBounds) return;
+
+    for (auto device : *context->devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      const std::vector<int> &peers
+        = topo->islands[topo->islandOf[device->globalRank()]];
+      for (auto peer : peers) {
+        box3f bounds = allBounds[peer];
+        /* pad a bit, so rays that just graze a domain still get
+           sent there */
+        vec3f pad
+          = 1e-3f*bounds.size()
+          + 1e-6f*max(abs(bounds.lower),abs(bounds.upper));
+        bounds.lower = bounds.lower - pad;
+        bounds.upper = bounds.upper + pad;
+        pld->hostPeerBounds[topo->islandRankOf[peer]] = bounds;
+      }
+      device->rtc->copyAsync(pld->peerBounds,pld->hostPeerBounds.data(),
+                             pld->hostPeerBounds.size()*sizeof(box3f));
+    }
+  }
+  
   void MPIAll2all::traceRays(GlobalModel *model, uint32_t rngSeed, bool needHitIDs)
   {
     double t0 = getCurrentTime();
     ensureAllOurQueuesAreLargeEnough();
+    buildRaysToSend();
     exchangeHowManyRaysEachDeviceHas();
     
     sendAndReceiveRays();
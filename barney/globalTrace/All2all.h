@@ -12,6 +12,8 @@ namespace BARNEY_NS {
   struct MPIContext;
   using render::RayOnly;
   using render::HitOnly;
+  using render::CompressedRay;
+  using render::CompressedHit;
   using render::Ray;
   
   struct MPIAll2all : public GlobalTraceImpl
@@ -27,9 +29,21 @@ namespace BARNEY_NS {
       int currentSize = 0;
       struct {
         std::vector<int> rayCount;
+        /*! how many of our rays we send to each peer - all of them
+            unless we route rays */
+        std::vector<int> sendCount;
         // std::vector<int> rayOffset;
       } perIslandPeer;
       int numRemoteRaysReceived;
+
+      /*! for ray routing: which slot in a peer's segment of the send
+          buffer each of our rays went to (-1 if not sent to that
+          peer), how many rays went to each peer, and each island
+          peer's domain bounds */
+      int   *routeSlots  = 0;
+      int   *routeCounts = 0;
+      box3f *peerBounds  = 0;
+      std::vector<box3f> hostPeerBounds;
     };
     
     PLD *getPLD(Device *device);
@@ -39,8 +53,17 @@ namespace BARNEY_NS {
     MPIAll2all(MPIContext *context);
     void traceRays(GlobalModel *model, uint32_t rngSeed, bool needHitIDs) override;
 
+    /*! if we route rays: gathers the domain bounds that all
+        devices' model slots have */
+    void beginFrame(GlobalModel *model) override;
+
     // ====================== helper fcts ======================
 
+    // step 0: write our rays into the send buffer, in wire format;
+    // if we route rays, only to the segments of those peers whose
+    // domain they overlap
+    void buildRaysToSend();
+
     // step 1: have all ranks exchange which (global) device has how
     // many rays (needed to set up the send/receives)
     void exchangeHowManyRaysEachDeviceHas();
@@ -70,6 +93,29 @@ namespace BARNEY_NS {
     // call, instead of doing N indiviusal isends and N
     // indiv. irecvs. only works for one gpu per rank.
     bool opt_mpi;
+    // if set, rays and hits go over the wire as CompressedRay and
+    // CompressedHit (in the same buffers), rather than as RayOnly and
+    // HitOnly
+    bool compressRays;
+    size_t rayWireSize;
+    size_t hitWireSize;
+    // if set, rays only get sent to those peers whose domain bounds
+    // they overlap, with each peer getting its own segment of the
+    // send buffer. Only used if all devices' slots have domain
+    // bounds.
+    bool routeRays;
+    bool haveAllBounds = false;
+    bool routing() const { return routeRays && haveAllBounds; }
+    /*! index of first ray (in our send buffer) that goes to given
+        peer */
+    int sendSegment(int peerIslandRank, int myRayCount) const
+    { return routing() ? peerIslandRank*myRayCount : 0; }
+    /*! address of the idx'th ray (or hit) in a buffer of rays (or
+        hits) in wire format */
+    uint8_t *rayAt(void *buffer, int idx) const
+    { return (uint8_t*)buffer + idx*rayWireSize; }
+    uint8_t *hitAt(void *buffer, int idx) const
+    { return (uint8_t*)buffer + idx*hitWireSize; }
   };
 
 }
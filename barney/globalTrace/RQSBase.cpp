@@ -17,47 +17,18 @@ namespace BARNEY_NS {
   {
     auto topo = context->topo;
     int islandSize = topo->islandSize();
-    bool minimizeNetworkHops = FromEnv::enabled("opt_mpi");
     for (int local = 0; local < perLogical.size(); local++) {
       auto &pld = perLogical[local];
       int myDev = topo->find(context->myRank(),local);
       int myIsland = topo->islandOf[myDev];
-      int myIslandRank = topo->islandRankOf[myDev];
-      int myNext=-1;
-      int myPrev=-1;
-      
-      if (minimizeNetworkHops) {
-        /* make a list of all devices that are in the same island as
-           we are - store that in a tuple with device gid last, and
-           host and gpu index is tuple slots 0 and 1, respectively,
-           such that we can then sort by order host->gpu->devID */
-        std::vector<std::tuple</*host*/int,/*gpu*/int,/*devID*/int>> devsInIsland;
-        for (int devID=0; devID<topo->allDevices.size(); devID++) {
-          auto dev = topo->allDevices[devID];
-          if (topo->islandOf[devID] == myIsland)
-            devsInIsland.push_back({
-                topo->physicalHostIndexOf[devID],
-                topo->physicalGpuIndexOf[devID],
-                devID});
-        }
-        assert(devsInIsland.size() == islandSize);
-        /* sort the devsInIsland tuples. after this sort we should
-           have a list of all devices that is sorted such thatwe have
-           all those device on host 0 first, etc; and those on the
-           same host are sroted by gpu ID. In this order, devices that
-           ARE on the same host will appear next to each other in that
-           sorted list. */
-        std::sort(devsInIsland.begin(),devsInIsland.end());
-        int myIdx = 0;
-        while (std::get<2>(devsInIsland[myIdx]) != myDev) ++myIdx;
-        myNext = std::get<2>(devsInIsland[(myIdx+1)%islandSize]);
-        myPrev = std::get<2>(devsInIsland[(myIdx+islandSize-1)%islandSize]);
-      } else {
-        myNext = topo->islands[myIsland]
-          [(myIslandRank+1) % islandSize];
-        myPrev = topo->islands[myIsland]
-          [(myIslandRank+islandSize-1) % islandSize];
-      }
+      /* pass rays along the island's topology-aware ring, so that as
+         many hops as possible stay within a host, and within a numa
+         node */
+      const std::vector<int> &ring = topo->rings[myIsland];
+      int myRingRank = topo->ringRankOf[myDev];
+      assert(ring.size() == islandSize);
+      int myNext = ring[(myRingRank+1) % islandSize];
+      int myPrev = ring[(myRingRank+islandSize-1) % islandSize];
       
       pld.myDev       = &topo->allDevices[myDev];
       pld.sendPartner = &topo->allDevices[myNext];
@@ -14,9 +14,105 @@ namespace BARNEY_NS {
       assert(gd.worker == 0);
   }
 
+  RQSLocal::~RQSLocal()
+  {
+    for (auto device : *context->devices) {
+      if (device->localRank() >= (int)chunkDone.size()) continue;
+      for (auto event : chunkDone[device->localRank()])
+        device->rtc->freeEvent(event);
+    }
+  }
+
+  /*! first ray of the given chunk, if a queue of numRays rays gets
+      split into numChunks chunks */
+  inline int chunkBegin(int numRays, int chunk, int numChunks)
+  { return int((int64_t)numRays*chunk/numChunks); }
+  
+  void RQSLocal::traceRays(GlobalModel *model,
+                           uint32_t rngSeed,
+                           bool needHitIDs)
+  {
+    const int numChunks = FromEnv::get()->forwardChunks;
+    const int islandSize = context->topo->islandSize();
+    if (numChunks <= 1 || islandSize == 1) {
+      RQSBase::traceRays(model,rngSeed,needHitIDs);
+      return;
+    }
+
+    const int numDevices = (int)context->devices->size();
+    chunkDone.resize(numDevices);
+    for (auto device : *context->devices) {
+      auto &events = chunkDone[device->localRank()];
+      while ((int)events.size() < numChunks+1)
+        events.push_back(device->rtc->createEvent());
+    }
+
+    while (true) {
+      std::vector<int> numOutgoing(numDevices);
+      std::vector<int> numIncoming(numDevices);
+      for (auto device : *context->devices) {
+        int nextID = getPLD(device)->recvPartner->local;
+        numOutgoing[device->localRank()] = device->rayQueue->numActive;
+        numIncoming[nextID] = device->rayQueue->numActive;
+      }
+      
+      for (int chunk=0;chunk<numChunks;chunk++) {
+        std::vector<SingleQueue> saved(numDevices);
+        for (auto device : *context->devices) {
+          auto rayQueue = device->rayQueue;
+          auto &queue = rayQueue->traceAndShadeReadQueue;
+          int count = numOutgoing[device->localRank()];
+          int begin = chunkBegin(count,chunk,numChunks);
+          int end   = chunkBegin(count,chunk+1,numChunks);
+          saved[device->localRank()] = queue;
+          queue.rays += begin;
+          if (queue.hitIDs) queue.hitIDs += begin;
+          rayQueue->numActive = end-begin;
+        }
+        context->traceRaysLocally(model,rngSeed,needHitIDs,false);
+        /* as soon as a chunk is traced the copy engine can send it
+           on, while the sm's already trace the next one */
+        for (auto device : *context->devices) {
+          auto rayQueue = device->rayQueue;
+          rayQueue->traceAndShadeReadQueue = saved[device->localRank()];
+          rayQueue->numActive = numOutgoing[device->localRank()];
+          rtc::Event *traced = chunkDone[device->localRank()][chunk];
+          device->rtc->recordEvent(traced);
+          
+          auto nextDev = (*context->devices)[getPLD(device)->recvPartner->local];
+          auto &src = rayQueue->traceAndShadeReadQueue;
+          auto &dst = nextDev->rayQueue->receiveAndShadeWriteQueue;
+          int count = numOutgoing[device->localRank()];
+          int begin = chunkBegin(count,chunk,numChunks);
+          int end   = chunkBegin(count,chunk+1,numChunks);
+          device->rtc->copyAsyncAfter(traced,dst.rays+begin,src.rays+begin,
+                                      (end-begin)*sizeof(Ray));
+          if (needHitIDs)
+            device->rtc->copyAsyncAfter(traced,dst.hitIDs+begin,
+                                        src.hitIDs+begin,
+                                        (end-begin)*sizeof(*dst.hitIDs));
+        }
+      }
+      
+      for (auto device : *context->devices)
+        device->rtc->recordCopyEvent(chunkDone[device->localRank()][numChunks]);
+      for (auto device : *context->devices) {
+        device->rtc->waitForEvent(chunkDone[device->localRank()][numChunks]);
+        device->rayQueue->swapAfterCycle(numTimesForwarded % islandSize,
+                                         islandSize);
+        device->rayQueue->numActive = numIncoming[device->localRank()];
+      }
+      ++numTimesForwarded;
+      if ((numTimesForwarded % islandSize) == 0)
+        break;
+    }
+  }
+
   bool RQSLocal::forwardRays(bool needHitIDs)
   {
-    const int numSlots = (int)context->perSlot.size();
+    /* one hop per data rank - which, with automatic partitioning,
+       are the devices of a single slot */
+    const int numSlots = context->topo->islandSize();
     if (numSlots == 1) {
       // do NOT copy or swap. rays are in trace queue, which is also
       // the shade read queue, so nothing to do.
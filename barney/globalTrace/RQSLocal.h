@@ -13,11 +13,25 @@ namespace BARNEY_NS {
   struct RQSLocal : public RQSBase
   {
     RQSLocal(Context *context);
+    ~RQSLocal() override;
+
+    /*! if BARNEY_CONFIG=forwardChunks=N (N>1), traces rays in chunks,
+        with each traced chunk getting copied to the next device on
+        the copy engine while the chunks after it still trace; else
+        same as RQSBase::traceRays() */
+    void traceRays(GlobalModel *model,
+                   uint32_t rngSeed,
+                   bool needHitIDs) override;
     
     /*! forward rays (during global trace); returns if _after_ that
         forward the rays need more tracing (true) or whether they're
         done (false) */
     bool forwardRays(bool needHitIDs) override;
+
+    /*! per local device, one event per chunk that signals that
+        chunk's trace is done, plus one more that signals that all
+        its chunks have been copied */
+    std::vector<std::vector<rtc::Event *>> chunkDone;
   };
       
 }
@@ -5,6 +5,7 @@
 #include "barney/globalTrace/RQSMPI.h"
 #include "barney/render/RayQueue.h"
 #include "barney/MPIContext.h"
+#include "barney/globalTrace/Transport.h"
 
 namespace BARNEY_NS {
 
@@ -13,35 +14,27 @@ namespace BARNEY_NS {
         context(context)
   {}
   
-  /*! forward rays (during global trace); returns if _after_ that
-    forward the rays need more tracing (true) or whether they're
-    done (false) */
-  bool RQSMPI::forwardRays(bool needHitIDs)
+  RQSMPI::~RQSMPI()
   {
-    auto topo = context->topo; assert(topo);
+    for (auto device : *context->devices) {
+      if (device->localRank() >= (int)chunkDone.size()) continue;
+      for (auto event : chunkDone[device->localRank()])
+        device->rtc->freeEvent(event);
+    }
+  }
+  
+  /*! exchange how many rays each device is going to send to its
+      send partner, and receive from its receive partner */
+  void RQSMPI::exchangeRayCounts(std::vector<int> &numIncoming,
+                                 std::vector<int> &numOutgoing)
+  {
+    NvtxRange nvtx("exchangeRayCounts");
     auto &workers = context->workers;
     int numDevices = context->devices->size();
     std::vector<MPI_Request> allRequests;
 
-    if (FromEnv::get()->logQueues) 
-      std::cout << "----- forwardRays (islandSize = "
-                << topo->islandSize() << ")"
-                << " -----------" << std::endl;
-    
-    context->syncCheckAll();
-    if (topo->islandSize() == 1) {
-      // do NOT copy or swap. rays are in trace queue, which is also
-      // the shade read queue, so nothing to do.
-      //
-      // no more trace rounds required: return false
-      return false;
-    }
-
-    // ------------------------------------------------------------------
-    // exchange how many we're going to send/recv
-    // ------------------------------------------------------------------
-    std::vector<int> numIncoming(numDevices);
-    std::vector<int> numOutgoing(numDevices);
+    numIncoming.resize(numDevices);
+    numOutgoing.resize(numDevices);
     for (auto &ni : numIncoming) ni = -1;
     for (auto device : *context->devices) {
       const PLD &pld = *getPLD(device);
@@ -90,55 +83,66 @@ namespace BARNEY_NS {
     // }
     allRequests.clear();
     // allStatuses.clear();
+  }
+
+  /*! forward rays (during global trace); returns if _after_ that
+    forward the rays need more tracing (true) or whether they're
+    done (false) */
+  bool RQSMPI::forwardRays(bool needHitIDs)
+  {
+    NvtxRange nvtx("forwardRays");
+    auto topo = context->topo; assert(topo);
+
+    if (FromEnv::get()->logQueues) 
+      std::cout << "----- forwardRays (islandSize = "
+                << topo->islandSize() << ")"
+                << " -----------" << std::endl;
+    
+    context->syncCheckAll();
+    if (topo->islandSize() == 1) {
+      // do NOT copy or swap. rays are in trace queue, which is also
+      // the shade read queue, so nothing to do.
+      //
+      // no more trace rounds required: return false
+      return false;
+    }
+
+    std::vector<int> numIncoming;
+    std::vector<int> numOutgoing;
+    exchangeRayCounts(numIncoming,numOutgoing);
 
     // ------------------------------------------------------------------
     // exchange actual rays
     // ------------------------------------------------------------------
     for (auto device : *context->devices) {
       const PLD &pld = *getPLD(device);
-      int sendWorkerRank  = pld.sendPartner->worker;
-      int sendWorkerLocal = pld.sendPartner->local;
-      int recvWorkerRank  = pld.recvPartner->worker;
-      int recvWorkerLocal = pld.recvPartner->local;
 
       numOutgoing[device->localRank()] = device->rayQueue->numActive;
       if (FromEnv::get()->logQueues)
         std::cout << context->myRank() << ": numOutgoing[" << device->localRank()
                   << "] = " << device->rayQueue->numActive << std::endl;
-      MPI_Request sendReq, recvReq;
-      workers.recv(recvWorkerRank,
-                   recvWorkerLocal,
-                   device->rayQueue->receiveAndShadeWriteQueue.rays,
-                   numIncoming[device->localRank()],
-                   recvReq);
-      workers.send(sendWorkerRank,
-                   sendWorkerLocal,
-                   device->rayQueue->traceAndShadeReadQueue.rays,
-                   numOutgoing[device->localRank()],
-                   sendReq);
-      allRequests.push_back(sendReq);
-      allRequests.push_back(recvReq);
+      auto &transport = *context->transport;
+      transport.recv(device,pld.recvPartner->gid,
+                     device->rayQueue->receiveAndShadeWriteQueue.rays,
+                     numIncoming[device->localRank()]*sizeof(render::Ray));
+      transport.send(device,pld.sendPartner->gid,
+                     device->rayQueue->traceAndShadeReadQueue.rays,
+                     numOutgoing[device->localRank()]*sizeof(render::Ray));
       if (needHitIDs) {
-        workers.recv(recvWorkerRank,
-                     recvWorkerLocal,
-                     device->rayQueue->receiveAndShadeWriteQueue.hitIDs,
-                     numIncoming[device->localRank()],
-                     recvReq);
-        workers.send(sendWorkerRank,
-                     sendWorkerLocal,
-                     device->rayQueue->traceAndShadeReadQueue.hitIDs,
-                     numOutgoing[device->localRank()],
-                     sendReq);
-        allRequests.push_back(sendReq);
-        allRequests.push_back(recvReq);
+        transport.recv(device,pld.recvPartner->gid,
+                       device->rayQueue->receiveAndShadeWriteQueue.hitIDs,
+                       numIncoming[device->localRank()]*sizeof(HitIDs));
+        transport.send(device,pld.sendPartner->gid,
+                       device->rayQueue->traceAndShadeReadQueue.hitIDs,
+                       numOutgoing[device->localRank()]*sizeof(HitIDs));
       }
     }
     if (FromEnv::get()->logQueues)
-      std::cout << "bn(" << context->myRank() << ") 2nd waitall" << std::endl;
-    BN_MPI_CALL(Waitall(allRequests.size(),allRequests.data(),MPI_STATUSES_IGNORE));
+      std::cout << "bn(" << context->myRank() << ") 2nd waitall ("
+                << context->transport->name() << ")" << std::endl;
+    context->transport->flush();
     if (FromEnv::get()->logQueues)
       std::cout << "bn(" << context->myRank() << ") after 2nd waitall" << std::endl; 
-    allRequests.clear();
 
     // ------------------------------------------------------------------
     // now all rays should be exchanged -- swap queues
@@ -153,5 +157,108 @@ namespace BARNEY_NS {
     return (numTimesForwarded % topo->islandSize()) != 0;
   }
 
-}
+  /*! first ray of the given chunk, if a queue of numRays rays gets
+      split into numChunks chunks */
+  inline int chunkBegin(int numRays, int chunk, int numChunks)
+  { return int((int64_t)numRays*chunk/numChunks); }
+  
+  /*! same as RQSBase::traceRays(), but with each device's queue split
+      into chunks: once a chunk has been traced it gets sent on to the
+      next device right away, while the device is still tracing the
+      chunks after it. Each cycle then costs about max(trace,transfer)
+      rather than trace+transfer */
+  void RQSMPI::traceRays(GlobalModel *model,
+                         uint32_t rngSeed,
+                         bool needHitIDs)
+  {
+    auto topo = context->topo;
+    const int numChunks = FromEnv::get()->forwardChunks;
+    const int islandSize = topo->islandSize();
+    if (numChunks <= 1 || islandSize == 1) {
+      RQSBase::traceRays(model,rngSeed,needHitIDs);
+      return;
+    }
+
+    chunkDone.resize(context->devices->size());
+    for (auto device : *context->devices) {
+      auto &events = chunkDone[device->localRank()];
+      while ((int)events.size() < numChunks)
+        events.push_back(device->rtc->createEvent());
+    }
+
+    auto &transport = *context->transport;
+    while (true) {
+      /* tracing doesn't change how many rays there are, so we can
+         tell our partners before we trace */
+      std::vector<int> numIncoming;
+      std::vector<int> numOutgoing;
+      exchangeRayCounts(numIncoming,numOutgoing);
 
+      for (auto device : *context->devices) {
+        const PLD &pld = *getPLD(device);
+        auto &dst = device->rayQueue->receiveAndShadeWriteQueue;
+        int count = numIncoming[device->localRank()];
+        for (int chunk=0;chunk<numChunks;chunk++) {
+          int begin = chunkBegin(count,chunk,numChunks);
+          int end   = chunkBegin(count,chunk+1,numChunks);
+          transport.recv(device,pld.recvPartner->gid,
+                         dst.rays+begin,(end-begin)*sizeof(render::Ray));
+          if (needHitIDs)
+            transport.recv(device,pld.recvPartner->gid,
+                           dst.hitIDs+begin,(end-begin)*sizeof(HitIDs));
+        }
+      }
+
+      /* enqueue all chunks' traces on all devices, with an event
+         after each ... */
+      for (int chunk=0;chunk<numChunks;chunk++) {
+        std::vector<SingleQueue> saved(context->devices->size());
+        for (auto device : *context->devices) {
+          auto rayQueue = device->rayQueue;
+          auto &queue = rayQueue->traceAndShadeReadQueue;
+          int count = numOutgoing[device->localRank()];
+          int begin = chunkBegin(count,chunk,numChunks);
+          int end   = chunkBegin(count,chunk+1,numChunks);
+          saved[device->localRank()] = queue;
+          queue.rays += begin;
+          if (queue.hitIDs) queue.hitIDs += begin;
+          rayQueue->numActive = end-begin;
+        }
+        context->traceRaysLocally(model,rngSeed,needHitIDs,false);
+        for (auto device : *context->devices) {
+          auto rayQueue = device->rayQueue;
+          rayQueue->traceAndShadeReadQueue = saved[device->localRank()];
+          rayQueue->numActive = numOutgoing[device->localRank()];
+          device->rtc->recordEvent(chunkDone[device->localRank()][chunk]);
+        }
+      }
+
+      /* ... and send each chunk as soon as it is done */
+      for (int chunk=0;chunk<numChunks;chunk++)
+        for (auto device : *context->devices) {
+          const PLD &pld = *getPLD(device);
+          auto &src = device->rayQueue->traceAndShadeReadQueue;
+          int count = numOutgoing[device->localRank()];
+          int begin = chunkBegin(count,chunk,numChunks);
+          int end   = chunkBegin(count,chunk+1,numChunks);
+          device->rtc->waitForEvent(chunkDone[device->localRank()][chunk]);
+          transport.send(device,pld.sendPartner->gid,
+                         src.rays+begin,(end-begin)*sizeof(render::Ray));
+          if (needHitIDs)
+            transport.send(device,pld.sendPartner->gid,
+                           src.hitIDs+begin,(end-begin)*sizeof(HitIDs));
+        }
+      transport.flush();
+
+      for (auto device : *context->devices) {
+        device->rayQueue->swapAfterCycle(numTimesForwarded % islandSize,
+                                         islandSize);
+        device->rayQueue->numActive = numIncoming[device->localRank()];
+      }
+      ++numTimesForwarded;
+      if ((numTimesForwarded % islandSize) == 0)
+        break;
+    }
+  }
+
+}
@@ -12,11 +12,26 @@ namespace BARNEY_NS {
   struct RQSMPI : public RQSBase
   {
     RQSMPI(MPIContext *context);
+    ~RQSMPI() override;
+
+    /*! if BARNEY_CONFIG=forwardChunks=N (N>1), traces and forwards
+        rays in chunks, overlapping the two; else same as
+        RQSBase::traceRays() */
+    void traceRays(GlobalModel *model,
+                   uint32_t rngSeed,
+                   bool needHitIDs) override;
     
     /*! forward rays (during global trace); returns true if _after_
       that forward the rays need more tracing (true) or whether
       they're done (false) */
     bool forwardRays(bool needHitIDs) override;
+
+    void exchangeRayCounts(std::vector<int> &numIncoming,
+                           std::vector<int> &numOutgoing);
+
+    /*! per local device, one event per chunk that signals that
+        chunk's trace is done */
+    std::vector<std::vector<rtc::Event *>> chunkDone;
     // int numDifferentModelSlots = -1;
     
     MPIContext *const context;
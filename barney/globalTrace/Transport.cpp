@@ -0,0 +1,177 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/globalTrace/Transport.h"
+#include "barney/MPIContext.h"
+#if BARNEY_HAVE_NCCL
+# include <nccl.h>
+
+#define BN_NCCL_CALL(fctCall)                                           \
+  { ncclResult_t rc = nccl##fctCall;                                    \
+    if (rc != ncclSuccess)                                              \
+      throw std::runtime_error(std::string("#barney.nccl (@")           \
+                               +__PRETTY_FUNCTION__+") : "              \
+                               +ncclGetErrorString(rc)); }
+#endif
+
+namespace BARNEY_NS {
+
+  /*! default transport: non-blocking mpi sends/receives on device
+      pointers, which requires a cuda-aware mpi */
+  struct MPITransport : public RayTransport {
+    MPITransport(MPIContext *context)
+      : context(context)
+    {}
+
+    void send(Device *device, int peerGID,
+              const void *ptr, size_t numBytes) override
+    {
+      auto &ourDev  = context->topo->allDevices[device->globalRank()];
+      auto &peerDev = context->topo->allDevices[peerGID];
+      MPI_Request req;
+      numBytesSent += numBytes;
+      context->world.send(peerDev.worldRank,(peerDev.local << 8)+ourDev.local,
+                          (const uint8_t *)ptr,(int)numBytes,req);
+      requests.push_back(req);
+    }
+
+    void recv(Device *device, int peerGID,
+              void *ptr, size_t numBytes) override
+    {
+      auto &ourDev  = context->topo->allDevices[device->globalRank()];
+      auto &peerDev = context->topo->allDevices[peerGID];
+      MPI_Request req;
+      context->world.recv(peerDev.worldRank,(ourDev.local << 8)+peerDev.local,
+                          (uint8_t *)ptr,(int)numBytes,req);
+      requests.push_back(req);
+    }
+
+    void flush() override
+    {
+      BN_MPI_CALL(Waitall(requests.size(),requests.data(),MPI_STATUSES_IGNORE));
+      requests.clear();
+    }
+
+    const char *name() const override { return "mpi"; }
+
+    MPIContext *const context;
+    std::vector<MPI_Request> requests;
+  };
+
+#if BARNEY_HAVE_NCCL
+  /*! transport that does all ray/hit exchanges through nccl
+      send/recv, using one nccl rank per global device (nccl rank ==
+      device gid). doesn't need a cuda-aware mpi, and gets to use
+      nvlink/nvswitch and gpudirect rdma wherever nccl finds them */
+  struct NCCLTransport : public RayTransport {
+    NCCLTransport(MPIContext *context);
+    ~NCCLTransport() override;
+
+    void send(Device *device, int peerGID,
+              const void *ptr, size_t numBytes) override
+    {
+      if (numBytes == 0) return;
+      numBytesSent += numBytes;
+      perDevice[device->localRank()].ops.push_back
+        ({true,peerGID,(void*)ptr,numBytes});
+    }
+    void recv(Device *device, int peerGID,
+              void *ptr, size_t numBytes) override
+    {
+      if (numBytes == 0) return;
+      perDevice[device->localRank()].ops.push_back
+        ({false,peerGID,ptr,numBytes});
+    }
+    void flush() override;
+
+    const char *name() const override { return "nccl"; }
+
+    struct Op {
+      bool   isSend;
+      int    peer;
+      void  *ptr;
+      size_t numBytes;
+    };
+    struct PerDevice {
+      Device         *device;
+      ncclComm_t      comm = 0;
+      std::vector<Op> ops;
+    };
+    std::vector<PerDevice> perDevice;
+  };
+
+  NCCLTransport::NCCLTransport(MPIContext *context)
+  {
+    ncclUniqueId id;
+    if (context->workers.rank == 0) {
+      BN_NCCL_CALL(GetUniqueId(&id));
+      context->workers.bc_send(&id,sizeof(id));
+    } else
+      context->workers.bc_recv(&id,sizeof(id));
+
+    int numRanks = (int)context->topo->allDevices.size();
+    perDevice.resize(context->devices->size());
+    /* several devices per process have to join the comm within
+       the same group */
+    BN_NCCL_CALL(GroupStart());
+    for (auto device : *context->devices) {
+      SetActiveGPU forDuration(device);
+      auto &pd = perDevice[device->localRank()];
+      pd.device = device;
+      BN_NCCL_CALL(CommInitRank(&pd.comm,numRanks,id,device->globalRank()));
+    }
+    BN_NCCL_CALL(GroupEnd());
+  }
+
+  NCCLTransport::~NCCLTransport()
+  {
+    for (auto &pd : perDevice) {
+      if (!pd.comm) continue;
+      SetActiveGPU forDuration(pd.device);
+      ncclCommDestroy(pd.comm);
+    }
+  }
+
+  void NCCLTransport::flush()
+  {
+    BN_NCCL_CALL(GroupStart());
+    for (auto &pd : perDevice) {
+      SetActiveGPU forDuration(pd.device);
+      cudaStream_t stream = pd.device->rtc->stream;
+      for (auto &op : pd.ops)
+        if (op.isSend) {
+          BN_NCCL_CALL(Send(op.ptr,op.numBytes,ncclChar,
+                            op.peer,pd.comm,stream));
+        } else {
+          BN_NCCL_CALL(Recv(op.ptr,op.numBytes,ncclChar,
+                            op.peer,pd.comm,stream));
+        }
+    }
+    BN_NCCL_CALL(GroupEnd());
+    for (auto &pd : perDevice) {
+      if (pd.ops.empty()) continue;
+      pd.ops.clear();
+      SetActiveGPU forDuration(pd.device);
+      pd.device->rtc->sync();
+    }
+  }
+#endif
+
+  RayTransport *RayTransport::create(MPIContext *context)
+  {
+    if (FromEnv::enabled("nccl")) {
+#if BARNEY_HAVE_NCCL
+      if (context->isActiveWorker)
+        return new NCCLTransport(context);
+#else
+      if (context->myRank() == 0)
+        std::cerr << "#bn.mpi: WARNING - nccl transport requested, but "
+                  << "barney was built without nccl support; using mpi"
+                  << std::endl;
+#endif
+    }
+    return new MPITransport(context);
+  }
+
+}
@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/Context.h"
+
+namespace BARNEY_NS {
+  struct MPIContext;
+
+  /*! moves (device-side) ray and hit buffers between global devices
+      during global ray tracing. sends and receives only get queued
+      up, and get executed - and completed - in flush(); messages
+      between the same pair of devices arrive in the order they got
+      queued in. Peers are identified by their global device ID
+      (WorkerTopo::Device::gid). Ray _counts_ and other small host
+      data still go through plain MPI. */
+  struct RayTransport {
+    virtual ~RayTransport() = default;
+
+    /*! queue a send of given device memory from given local device
+        to given global peer device */
+    virtual void send(Device *device, int peerGID,
+                      const void *ptr, size_t numBytes) = 0;
+    /*! queue a receive of given peer's data into given local
+        device's memory */
+    virtual void recv(Device *device, int peerGID,
+                      void *ptr, size_t numBytes) = 0;
+    /*! executes all queued sends and receives, and waits for them
+        to complete */
+    virtual void flush() = 0;
+
+    /*! short name for logging */
+    virtual const char *name() const = 0;
+
+    /*! how many bytes this rank's devices have sent to other devices
+        so far; only for statistics and benchmarking */
+    size_t numBytesSent = 0;
+
+    /*! creates the transport selected through BARNEY_CONFIG
+        ('nccl=1' for nccl, if barney was built with nccl support;
+        else cuda-aware MPI). Has to be called on all ranks of the
+        context's world */
+    static RayTransport *create(MPIContext *context);
+  };
+
+}
@@ -4,9 +4,11 @@
 
 #include "barney/MPIContext.h"
 #include "barney/globalTrace/TwoStage.h"
+#include "barney/globalTrace/Transport.h"
 #include "barney/DeviceGroup.h"
 #include "barney/render/RayQueue.h"
 #include "rtcore/ComputeInterface.h"
+#include <set>
 
 namespace BARNEY_NS {
 
@@ -54,51 +56,68 @@ namespace BARNEY_NS {
   void buildHitsOnly(const rtc::ComputeInterface &ci,
                       HitOnly *hitOnly,
                       Ray *rayQueue,
-                     int N);
+                     int N,
+                     bool compressed);
+  
+  template<typename HitT>
+  inline __rtc_device
+  void reduceHitsInPlace(HitT *hitOnly,
+                         int tid,
+                         int nRays,
+                         int reduceFactor)
+  {
+    HitT reduced = hitOnly[tid];
+    /* for shadow rays that nobody found occluded, the peers'
+       transmittances multiply; for all other rays this is just
+       unused data */
+    float transmittance = 1.f;
+    for (int peer=0;peer<reduceFactor;peer++) {
+      const HitT &hit = hitOnly[peer*nRays+tid];
+      if (hitBSDFType(hit) == PackedBSDF::NONE)
+        transmittance *= shadowTransmittance(hit.hitBSDF);
+      
+      if (peer == 0 || hit.tHit >= reduced.tHit) continue;
+      
+      reduced = hit;
+    }
+    if (hitBSDFType(reduced) == PackedBSDF::NONE)
+      shadowTransmittance(reduced.hitBSDF) = transmittance;
+    hitOnly[tid] = reduced;
+  }
   
   __rtc_global
   void reduceReceivedHitsKernel_intraNode(const rtc::ComputeInterface &ci,
                                           HitOnly *hitOnly,
                                           int nRays,
-                                          int reduceFactor)
+                                          int reduceFactor,
+                                          bool compressed)
   {
     int tid = ci.launchIndex().x;
     if (tid >= nRays) return;
 
-    HitOnly reduced = hitOnly[tid];
-    for (int peer=1;peer<reduceFactor;peer++) {
-      HitOnly *hit = hitOnly+peer*nRays+tid;
-      
-      if (hit->tHit >= reduced.tHit) continue;
-      
-      reduced = *hit;
-    }
-    hitOnly[tid] = reduced;
-    
+    if (compressed)
+      reduceHitsInPlace((CompressedHit*)hitOnly,tid,nRays,reduceFactor);
+    else
+      reduceHitsInPlace(hitOnly,tid,nRays,reduceFactor);
   }
-  
+
   __rtc_global
   void reduceReceivedHitsKernel_crossNodes(const rtc::ComputeInterface &ci,
                                            Ray *rayQueueThisRank,
                                            HitOnly *hitOnlyAllRanks,
                                            int nRays,
-                                           int reduceFactor)
+                                           int reduceFactor,
+                                           bool compressed)
   {
     int tid = ci.launchIndex().x;
     if (tid >= nRays) return;
     
     Ray ray = rayQueueThisRank[tid];
-    for (int peer=0;peer<reduceFactor;peer++) {
-      HitOnly *hit = hitOnlyAllRanks+peer*nRays+tid;
-
-      if (hit->tHit >= ray.tMax) continue;
-
-      ray.tMax     = hit->tHit;
-      ray.bsdfType = hit->bsdfType;
-      ray.hitBSDF  =  hit->hitBSDF;
-      ray.P        =  hit->P;
-      ray.N        =  hit->N;
-    }
+    if (compressed)
+      reduceHitsInto(ray,(const CompressedHit*)hitOnlyAllRanks,
+                     tid,nRays,reduceFactor);
+    else
+      reduceHitsInto(ray,hitOnlyAllRanks,tid,nRays,reduceFactor);
     rayQueueThisRank[tid] = ray;
   }
   
@@ -107,12 +126,14 @@ namespace BARNEY_NS {
   void createRayOnly(const rtc::ComputeInterface &ci,
                      RayOnly *rayOnly,
                      Ray *rayQueue,
-                     int N);
+                     int N,
+                     bool compressed);
   __rtc_global
   void buildStagedRayQueue(const rtc::ComputeInterface &ci,
                            Ray *rayQueue,
                            RayOnly *rayOnly,
-                           int N);
+                           int N,
+                           bool compressed);
   
   TwoStage::TwoStage(MPIContext *context)
     : GlobalTraceImpl(context),
@@ -121,57 +142,82 @@ namespace BARNEY_NS {
       topo(context->topo.get()),
       logTopo(FromEnv::get()->logTopo),
       logQueues(FromEnv::get()->logQueues),
-      opt_mpi(FromEnv::enabled("opt_mpi"))
+      opt_mpi(FromEnv::enabled("opt_mpi")),
+      compressRays(FromEnv::enabled("compressRays")),
+      rayWireSize(compressRays ? sizeof(CompressedRay) : sizeof(RayOnly)),
+      hitWireSize(compressRays ? sizeof(CompressedHit) : sizeof(HitOnly))
   {
     prof_rank = world.rank;
 #if TWO_STAGE_PROFILE
     profHook = twoStageProfHook;
 #endif
 
-    if (context->devices->size() != 1)
-      throw std::runtime_error
-        ("twostage all2all currently only works for one device per rank");
-    this->device = context->devices->get(0);
-    
-    if (topo->islands.size() != 1)
-      throw std::runtime_error
-        ("twostage all2all currently only works for a single island");
-
-    myGID = device->globalRank();
-    numGlobal = topo->allDevices.size();
+    int numGlobal = (int)topo->allDevices.size();
     global.rayCounts.resize(numGlobal);
-    // sanity check that all physical nodes have same number of GPUs
-    std::map<size_t,int> gpuCountInHost;
-    int numHosts = 0;
-    for (int gid=0; gid<context->topo->allDevices.size(); gid++) {
-      auto &dev = context->topo->allDevices[gid];
-      gpuCountInHost[dev.hostNameHash]++;
-      numHosts = std::max(numHosts,topo->physicalHostIndexOf[gid]+1);
+    hostOf.resize(numGlobal,-1);
+    columnOf.resize(numGlobal,-1);
+
+    // enumerate each island's hosts in order of their physical host
+    // index, and each host's devices in gid order. this allows
+    // oversubscription, because we go by (host:device) rather than
+    // (host:physical gpu)
+    islands.resize(topo->islands.size());
+    for (int i=0;i<(int)topo->islands.size();i++) {
+      Island &island = islands[i];
+      std::map<int,int> hostIndexOf;
+      for (auto gid : topo->islands[i]) {
+        int physicalHost = topo->physicalHostIndexOf[gid];
+        if (hostIndexOf.find(physicalHost) == hostIndexOf.end()) {
+          hostIndexOf[physicalHost] = (int)island.hosts.size();
+          island.hosts.push_back({});
+        }
+        int h = hostIndexOf[physicalHost];
+        hostOf[gid] = h;
+        columnOf[gid] = (int)island.hosts[h].size();
+        island.hosts[h].push_back(gid);
+        island.numColumns
+          = std::max(island.numColumns,(int)island.hosts[h].size());
+      }
+    }
+
+    perDevice.resize(context->devices->size());
+    for (auto device : *context->devices) {
+      PerDevice &pd = perDevice[device->localRank()];
+      pd.device = device;
+      pd.gid    = device->globalRank();
+      pd.island = topo->islandOf[pd.gid];
+      if (pd.island < 0) continue;
+      const Island &island = islands[pd.island];
+      int numOnHost = (int)island.hosts[hostOf[pd.gid]].size();
+      for (int c=columnOf[pd.gid];c<island.numColumns;c+=numOnHost)
+        pd.columns.push_back(c);
     }
-    gpusPerHost = gpuCountInHost.begin()->second;
-    for (auto count : gpuCountInHost)
-      if (count.second != gpusPerHost)
-        throw std::runtime_error
-          ("twostage all2all currently requires same number of GPUs on all ranks");
-    assert(numHosts * gpusPerHost == context->topo->allDevices.size());
-
-    this->hostIdx = topo->physicalHostIndexOf[myGID];
-    // allows oversubscription - we enumerate based on (host:process)
-    // instead of (host.physialGPU)
-    this->gpuIdx = topo->rankOnHost[myGID];
-    _rankOf.resize(numGlobal);
-
-    std::vector<int> logicalGidOfRank(numGlobal);
-    int myLogicalGID = this->hostIdx * gpusPerHost + this->gpuIdx;
-    world.allGather(logicalGidOfRank.data(),&myLogicalGID,1);
-    for (int r=0;r<numGlobal;r++)
-      _rankOf[logicalGidOfRank[r]] = r;
-    this->numHosts = numGlobal / gpusPerHost;
 
     if (opt_mpi) {
-      crossNodes.comm = world.split(this->gpuIdx);
+      // the collectives need one comm rank per device, and the same
+      // number of devices in each cross-node comm. all ranks see the
+      // same topo, so all agree on this
+      bool layoutOK = (islands.size() == 1);
+      std::set<int> worldRanksSeen;
+      for (auto &dev : topo->allDevices)
+        if (!worldRanksSeen.insert(dev.worldRank).second) layoutOK = false;
+      for (auto &host : islands[0].hosts)
+        if ((int)host.size() != islands[0].numColumns) layoutOK = false;
+      if (!layoutOK) {
+        if (world.rank == 0)
+          std::cerr << "#bn.mpi: WARNING - twostage 'opt_mpi' needs a single "
+                    << "island, one gpu per rank, and the same number of gpus "
+                    << "on each host; using point-to-point exchanges instead"
+                    << std::endl;
+        opt_mpi = false;
+      }
+    }
+    
+    if (opt_mpi) {
+      int myGID = perDevice[0].gid;
+      crossNodes.comm = world.split(columnOf[myGID]);
       crossNodes.rayCounts.resize(crossNodes.comm.size);
-      intraNode.comm = world.split(this->hostIdx);
+      intraNode.comm = world.split(hostOf[myGID]);
       intraNode.rayCounts.resize(intraNode.comm.size);
     }
     
@@ -179,48 +225,134 @@ namespace BARNEY_NS {
       world.barrier();
       if (context->myRank() == 0) {
         std::cout << "=========== TwoStage All2all ===========" << std::endl;
-        std::cout << "- num MPI ranks (w/ one gpu each) " << numGlobal << std::endl;
-        std::cout << "- detected num physical hosts " << numHosts << std::endl;
-        std::cout << "- detected num (active) GPUs per host " << gpusPerHost << std::endl;
-        PRINT(numHosts);
-        PRINT(gpusPerHost);
-        for (int h=0;h<numHosts;h++)
-          for (int g=0;g<gpusPerHost;g++) {
-            std::cout << "- gpu on rank " << (rankOf(h,g))
-                      << " is logical h" << h << "g" << g << " {"
-                      << topo->toString(rankOf(h,g)) << "}" << std::endl;
-          }
+        std::cout << "- num devices " << numGlobal
+                  << " in " << islands.size() << " island(s)" << std::endl;
+        for (int i=0;i<(int)islands.size();i++) {
+          auto &island = islands[i];
+          std::cout << "- island " << i << ": " << island.hosts.size()
+                    << " host(s), up to " << island.numColumns
+                    << " gpu(s) per host" << std::endl;
+          for (int h=0;h<(int)island.hosts.size();h++)
+            for (int g=0;g<(int)island.hosts[h].size();g++) {
+              int gid = island.hosts[h][g];
+              std::cout << "  - gpu " << gid
+                        << " is logical h" << h << "g" << g << " {"
+                        << topo->toString(gid) << "}" << std::endl;
+            }
+        }
       }
       world.barrier();
     }
   }
 
+  TwoStage::~TwoStage()
+  {
+    for (auto &pd : perDevice) {
+      if (!pd.device) continue;
+      auto rtc = pd.device->rtc;
+      SetActiveGPU forDuration(pd.device);
+      for (int i=0;i<2;i++)
+        if (pd.raysOnly[i]) rtc->freeMem(pd.raysOnly[i]);
+      for (int i=0;i<2;i++)
+        if (pd.hitsOnly[i]) rtc->freeMem(pd.hitsOnly[i]);
+      if (pd.stagedRayQueue) rtc->freeMem(pd.stagedRayQueue);
+    }
+  }
+
+  TwoStage::PerDevice *TwoStage::getLocal(int gid)
+  {
+    int local = gid - topo->myOffset;
+    if (local < 0 || local >= topo->myCount) return nullptr;
+    return &perDevice[local];
+  }
+
+  int TwoStage::numCrossRaysOf(int gid) const
+  {
+    const Island &island = islands[topo->islandOf[gid]];
+    int numOnHost = (int)island.hosts[hostOf[gid]].size();
+    int sum = 0;
+    for (int c=columnOf[gid];c<island.numColumns;c+=numOnHost)
+      for (int h=0;h<(int)island.hosts.size();h++) {
+        int src = island.deviceAt(h,c);
+        if (src >= 0) sum += global.rayCounts[src];
+      }
+    return sum;
+  }
+
+  int TwoStage::crossOffsetOf(int server, int src) const
+  {
+    const Island &island = islands[topo->islandOf[server]];
+    int numOnHost = (int)island.hosts[hostOf[server]].size();
+    int sum = 0;
+    for (int c=columnOf[server];c<island.numColumns;c+=numOnHost)
+      for (int h=0;h<(int)island.hosts.size();h++) {
+        int peer = island.deviceAt(h,c);
+        if (peer == src) return sum;
+        if (peer >= 0) sum += global.rayCounts[peer];
+      }
+    throw std::runtime_error("#bn.twostage: device is not served by this one");
+  }
+
+  int TwoStage::intraOffsetOf(int gid) const
+  {
+    const Island &island = islands[topo->islandOf[gid]];
+    int sum = 0;
+    for (auto peer : island.hosts[hostOf[gid]]) {
+      if (peer == gid) break;
+      sum += numCrossRaysOf(peer);
+    }
+    return sum;
+  }
+
+  void TwoStage::finishExchange()
+  {
+    NvtxRange nvtx("finishExchange");
+    // completes all transport sends/receives; the copies between
+    // devices of this rank went into the receiving devices' streams
+    context->transport->flush();
+    for (auto &pd : perDevice)
+      pd.device->rtc->sync();
+  }
 
   void TwoStage::ensureAllOurQueuesAreLargeEnough()
   {
-    auto rtc = device->rtc;
-    size_t ourRequiredQueueSize
-      = device->rayQueue->size * numGlobal;
-    if (ourRequiredQueueSize > currentReservedSize) {
+    for (auto &pd : perDevice) {
+      auto device = pd.device;
+      auto rtc = device->rtc;
+      const Island &island = islands[pd.island];
+      int numHosts  = (int)island.hosts.size();
+      int numOnHost = (int)island.hosts[hostOf[pd.gid]].size();
+      // staged queue gets all rays of the island; but on a host with
+      // fewer gpus we may receive more than that in the cross-node
+      // stage (and then get that many hits from each gpu on our
+      // host)
+      int maxQueuesWorth
+        = std::max(topo->islandSize(),
+                   numOnHost*(int)pd.columns.size()*numHosts);
+      size_t ourRequiredQueueSize
+        = device->rayQueue->size * maxQueuesWorth;
+      if (ourRequiredQueueSize <= pd.currentReservedSize) continue;
+      
       if (logQueues) {
-        std::cout << "resizing ray queues from " << currentReservedSize
+        std::cout << "resizing ray queues from " << pd.currentReservedSize
                   << " to " << ourRequiredQueueSize << std::endl;
       }
+      SetActiveGPU forDuration(device);
       for (int i=0;i<2;i++)
-        if (raysOnly[i]) rtc->freeMem(raysOnly[i]);
+        if (pd.raysOnly[i]) rtc->freeMem(pd.raysOnly[i]);
       for (int i=0;i<2;i++)
-        if (hitsOnly[i]) rtc->freeMem(hitsOnly[i]);
+        if (pd.hitsOnly[i]) rtc->freeMem(pd.hitsOnly[i]);
       
-      if (stagedRayQueue) rtc->freeMem(stagedRayQueue);
+      if (pd.stagedRayQueue) rtc->freeMem(pd.stagedRayQueue);
       
       size_t N = ourRequiredQueueSize+1024;
       for (int i=0;i<2;i++)
-        raysOnly[i] = (RayOnly*)rtc->allocMem(N*sizeof(RayOnly));
+        pd.raysOnly[i] = (RayOnly*)rtc->allocMem(N*sizeof(RayOnly));
       for (int i=0;i<2;i++)
-        hitsOnly[i] = (HitOnly*)rtc->allocMem(N*sizeof(HitOnly));
-      stagedRayQueue = (Ray *)rtc->allocMem(N*sizeof(Ray));
+        pd.hitsOnly[i] = (HitOnly*)rtc->allocMem(N*sizeof(HitOnly));
+      pd.stagedRayQueue = (Ray *)rtc->allocMem(N*sizeof(Ray));
       
-      currentReservedSize = N;
+      pd.currentReservedSize = N;
     }
   }
 
@@ -228,37 +360,63 @@ namespace BARNEY_NS {
   // many rays (needed to set up the send/receives)
   void TwoStage::exchangeHowManyRaysEachDeviceHas()
   {
+    NvtxRange nvtx("exchangeHowManyRaysEachDeviceHas");
     ENTER();
 
     if (opt_mpi) {
+      // counts get exchanged within the respective stages' comms
     } else {
-      int myRayCount = device->rayQueue->numActive;
-      world.allGather(global.rayCounts.data(),&myRayCount,1);
+      // devices are ordered by worker, so we can gather them in
+      // global device order
+      auto &workers = context->workers;
+      std::vector<int> ourCounts(perDevice.size());
+      for (auto &pd : perDevice)
+        ourCounts[pd.device->localRank()] = pd.device->rayQueue->numActive;
+      std::vector<int> recvCounts(workers.size,0);
+      std::vector<int> recvOffsets(workers.size,0);
+      for (auto &dev : topo->allDevices)
+        recvCounts[dev.worker]++;
+      for (int w=1;w<workers.size;w++)
+        recvOffsets[w] = recvOffsets[w-1]+recvCounts[w-1];
+      BN_MPI_CALL(Allgatherv(ourCounts.data(),(int)ourCounts.size(),MPI_INT,
+                             global.rayCounts.data(),
+                             recvCounts.data(),recvOffsets.data(),
+                             MPI_INT,workers.comm));
     
       if (logQueues)  {
-        if (myGID == 0) {
+        if (topo->myOffset == 0) {
           std::cout << "ray counts (" << global.rayCounts.size() << "):";
           for (auto rc : global.rayCounts) std::cout << " " << rc;
           std::cout << std::endl;
         }
       }
+      for (auto &pd : perDevice) {
+        pd.numCrossRays = numCrossRaysOf(pd.gid);
+        pd.numIntraRays = 0;
+        for (auto gid : topo->islands[pd.island])
+          pd.numIntraRays += global.rayCounts[gid];
+      }
     }
     LEAVE(1,"exchangeHowManyRaysEachDeviceHas");
   }
   
   
-  /*! in this stage we have all each GPU exchange its rays with
-    all GPUs that have same phsycail ID in all OTHER ranks, but NOT
-    with other GPUs in same rank
+  /*! in this stage each GPU sends its rays to the GPU that serves its
+    column on every host (including its own host, where that's
+    itself), and receives the rays of all columns it serves from
+    all hosts
   */
   void TwoStage::sendAndReceiveRays_crossNodes()
   {
+    NvtxRange nvtx("sendAndReceiveRays_crossNodes");
     ENTER();
     // -----------------------------------------------------------------------------
     // first, create 'raysOnly[]' array, for each local device
     // -----------------------------------------------------------------------------
-    int myRayCount = device->rayQueue->numActive;
-    {
+    for (auto &pd : perDevice) {
+      auto device = pd.device;
+      int myRayCount = device->rayQueue->numActive;
+      if (myRayCount == 0) continue;
       SetActiveGPU forDuration(device);
       int bs = 128;
       int nb = divRoundUp(myRayCount,bs);
@@ -266,32 +424,34 @@ namespace BARNEY_NS {
                    createRayOnly,
                    nb,bs,
                    // args
-                   raysOnly[0],
+                   pd.raysOnly[0],
                    device->rayQueue->traceAndShadeReadQueue.rays,
-                   myRayCount);
+                   myRayCount,
+                   compressRays);
     }
 
 
     if (opt_mpi) {
+      auto &pd = perDevice[0];
+      auto device = pd.device;
+      int myRayCount = device->rayQueue->numActive;
       crossNodes.comm.allGather(crossNodes.rayCounts.data(),&myRayCount,1);
 
-      void *sendBuf = raysOnly[0];
-      int sendCount = myRayCount*sizeof(RayOnly);
-      void *recvBuf = raysOnly[1];
+      void *sendBuf = pd.raysOnly[0];
+      int sendCount = myRayCount*rayWireSize;
+      void *recvBuf = pd.raysOnly[1];
       std::vector<int> recvCounts(crossNodes.comm.size);
       std::vector<int> recvOffsets(crossNodes.comm.size);
       int sumCounts = 0;
       for (int i=0;i<crossNodes.comm.size;i++) {
         recvOffsets[i] = sumCounts;
-        recvCounts[i] = crossNodes.rayCounts[i]*sizeof(RayOnly);
+        recvCounts[i] = crossNodes.rayCounts[i]*rayWireSize;
         sumCounts += recvCounts[i];
       }
-      crossNodes.sumRaysReceived = sumCounts / sizeof(RayOnly);
+      pd.numCrossRays = sumCounts / rayWireSize;
       if (logQueues) 
-        printf("xchg-rays-cross r%i we have %i sumrecv %i first two counts %i %i\n",
-               myGID,myRayCount,crossNodes.sumRaysReceived,
-               crossNodes.rayCounts[0],
-               crossNodes.rayCounts[1]);
+        printf("xchg-rays-cross r%i we have %i sumrecv %i\n",
+               pd.gid,myRayCount,pd.numCrossRays);
       
       device->rtc->sync();
       BN_MPI_CALL(Allgatherv(sendBuf,sendCount,
@@ -300,114 +460,120 @@ namespace BARNEY_NS {
                              MPI_BYTE,
                              crossNodes.comm));
     } else {
-      device->rtc->sync();
-      std::vector<MPI_Request> requests;
-      int recvOfs = 0;
-      for (int h=0;h<numHosts;h++) {
-        MPI_Request req;
-        int recvCount = global.rayCounts[rankOf(h,gpuIdx)];
-        if (logQueues) 
-          printf("splat-cross r%i receiving %i from %i (q 0->1)\n",
-                 myGID,recvCount,rankOf(h,gpuIdx));
-        world.recv(rankOf(h,gpuIdx),0,raysOnly[1]+recvOfs,
-                   recvCount,req);
-        recvOfs += recvCount;
-        requests.push_back(req);
-      }
-      crossNodes.sumRaysReceived = recvOfs;
-      if (logQueues) 
-        printf("splat-cross r%i total received %i\n",
-               myGID,crossNodes.sumRaysReceived);
-    
-      for (int h=0;h<numHosts;h++) {
-        MPI_Request req;
-        if (logQueues) 
-          printf("splat-cross r%i sending %i to %i (q 0->1)\n",
-                 myGID,myRayCount,rankOf(h,gpuIdx));
-        world.send(rankOf(h,gpuIdx),0,raysOnly[0],myRayCount,req);
-        requests.push_back(req);
+      for (auto &pd : perDevice)
+        pd.device->rtc->sync();
+      auto &transport = *context->transport;
+      for (auto &pd : perDevice) {
+        const Island &island = islands[pd.island];
+        int numHosts = (int)island.hosts.size();
+        int recvOfs = 0;
+        for (auto c : pd.columns)
+          for (int h=0;h<numHosts;h++) {
+            int src = island.deviceAt(h,c);
+            if (src < 0) continue;
+            int recvCount = global.rayCounts[src];
+            if (logQueues) 
+              printf("splat-cross r%i receiving %i from %i (q 0->1)\n",
+                     pd.gid,recvCount,src);
+            if (PerDevice *peer = getLocal(src))
+              pd.device->rtc->copyAsync(rayAt(pd.raysOnly[1],recvOfs),
+                                        peer->raysOnly[0],
+                                        recvCount*rayWireSize);
+            else if (recvCount)
+              transport.recv(pd.device,src,rayAt(pd.raysOnly[1],recvOfs),
+                             recvCount*rayWireSize);
+            recvOfs += recvCount;
+          }
+        assert(recvOfs == pd.numCrossRays);
+
+        int myRayCount = global.rayCounts[pd.gid];
+        for (int h=0;h<numHosts;h++) {
+          int dst = island.serverOf(h,columnOf[pd.gid]);
+          if (getLocal(dst) || myRayCount == 0) continue;
+          if (logQueues) 
+            printf("splat-cross r%i sending %i to %i (q 0->1)\n",
+                   pd.gid,myRayCount,dst);
+          transport.send(pd.device,dst,pd.raysOnly[0],
+                         myRayCount*rayWireSize);
+        }
       }
-    
-      BN_MPI_CALL(Waitall(requests.size(),requests.data(),MPI_STATUSES_IGNORE));
+      finishExchange();
     }
-    LEAVE(recvOfs,"sendAndReceiveRays_crossNodes");
+    LEAVE(perDevice[0].numCrossRays,"sendAndReceiveRays_crossNodes");
   }
   
 
-  /*! in this stage we have all each GPU exchange its rays with
-    all GPUs that have same phsycail ID in all OTHER ranks, but NOT
-    with other GPUs in same rank
+  /*! in this stage each GPU sends all the rays it got in the
+    cross-node stage to all other GPUs on the same host, after which
+    every GPU has all rays of its island
   */
   void TwoStage::sendAndReceiveRays_intraNode()
   {
+    NvtxRange nvtx("sendAndReceiveRays_intraNode");
     ENTER();
 
     if (opt_mpi) {
-      int numRaysWeHave = crossNodes.sumRaysReceived;
+      auto &pd = perDevice[0];
+      int numRaysWeHave = pd.numCrossRays;
       intraNode.comm.allGather(intraNode.rayCounts.data(),&numRaysWeHave,1);
 
-      void *sendBuf = raysOnly[1];
-      void *recvBuf = raysOnly[0];
+      void *sendBuf = pd.raysOnly[1];
+      void *recvBuf = pd.raysOnly[0];
 
-      int sendCount = numRaysWeHave*sizeof(RayOnly);
+      int sendCount = numRaysWeHave*rayWireSize;
       std::vector<int> recvCounts(intraNode.comm.size);
       std::vector<int> recvOffsets(intraNode.comm.size);
       int sumCounts = 0;
       for (int i=0;i<intraNode.comm.size;i++) {
         recvOffsets[i] = sumCounts;
-        recvCounts[i] = intraNode.rayCounts[i]*sizeof(RayOnly);
+        recvCounts[i] = intraNode.rayCounts[i]*rayWireSize;
         sumCounts += recvCounts[i];
       }
-      intraNode.sumRaysReceived = sumCounts / sizeof(RayOnly);
+      pd.numIntraRays = sumCounts / rayWireSize;
 
       if (logQueues) 
         printf("xchg-rays-intra r%i we have %i sumrecv %i\n",
-               myGID,numRaysWeHave,intraNode.sumRaysReceived);
-      device->rtc->sync();
+               pd.gid,numRaysWeHave,pd.numIntraRays);
+      pd.device->rtc->sync();
       BN_MPI_CALL(Allgatherv(sendBuf,sendCount,
                              MPI_BYTE,
                              recvBuf,(int*)recvCounts.data(),(int*)recvOffsets.data(),
                              MPI_BYTE,
                              intraNode.comm));
     } else {
-      std::vector<MPI_Request> requests;
-      int recvOfs = 0;
-      for (int g=0;g<gpusPerHost;g++) {
-        MPI_Request req;
-        int raysOnPeer = 0;
-        for (int h=0;h<numHosts;h++)
-          raysOnPeer += global.rayCounts[rankOf(h,g)];
-        if (logQueues) 
-          printf("splat-intra r%i receiving %i from %i (q 1->0)\n",
-                 myGID,raysOnPeer,rankOf(hostIdx,g));
-        world.recv(rankOf(hostIdx,g),0,
-                   raysOnly[0]+recvOfs,raysOnPeer,
-                   req);
-        recvOfs += raysOnPeer;
-        requests.push_back(req);
-      }
-      intraNode.sumRaysReceived = recvOfs;
-      if (logQueues) 
-        printf("splat-intra r%i total received %i\n",
-               myGID,intraNode.sumRaysReceived);
-
-      int numRaysWeHave = 0;
-      for (int h=0;h<numHosts;h++)
-        numRaysWeHave += global.rayCounts[rankOf(h,gpuIdx)];
-      for (int g=0;g<gpusPerHost;g++) {
-        MPI_Request req;
-        if (logQueues) 
-          printf("splat-intra r%i sending %i to %i (q 1->0)\n",
-                 myGID,numRaysWeHave,rankOf(hostIdx,g));
-        world.send(rankOf(hostIdx,g),0,
-                   raysOnly[1],numRaysWeHave,
-                   req);
-        requests.push_back(req);
+      auto &transport = *context->transport;
+      for (auto &pd : perDevice) {
+        const std::vector<int> &onHost = islands[pd.island].hosts[hostOf[pd.gid]];
+        int recvOfs = 0;
+        for (auto src : onHost) {
+          int raysOnPeer = numCrossRaysOf(src);
+          if (logQueues) 
+            printf("splat-intra r%i receiving %i from %i (q 1->0)\n",
+                   pd.gid,raysOnPeer,src);
+          if (PerDevice *peer = getLocal(src))
+            pd.device->rtc->copyAsync(rayAt(pd.raysOnly[0],recvOfs),
+                                      peer->raysOnly[1],
+                                      raysOnPeer*rayWireSize);
+          else if (raysOnPeer)
+            transport.recv(pd.device,src,rayAt(pd.raysOnly[0],recvOfs),
+                           raysOnPeer*rayWireSize);
+          recvOfs += raysOnPeer;
+        }
+        assert(recvOfs == pd.numIntraRays);
+
+        for (auto dst : onHost) {
+          if (getLocal(dst) || pd.numCrossRays == 0) continue;
+          if (logQueues) 
+            printf("splat-intra r%i sending %i to %i (q 1->0)\n",
+                   pd.gid,pd.numCrossRays,dst);
+          transport.send(pd.device,dst,pd.raysOnly[1],
+                         pd.numCrossRays*rayWireSize);
+        }
       }
-      BN_MPI_CALL(Waitall(requests.size(),requests.data(),MPI_STATUSES_IGNORE));
+      finishExchange();
     }
     
-    LEAVE(recvOfs,"sendAndReceiveRays_intraNode");
+    LEAVE(perDevice[0].numIntraRays,"sendAndReceiveRays_intraNode");
   }
 
   
@@ -435,66 +601,83 @@ namespace BARNEY_NS {
                                       uint32_t rngSeed,
                                       bool needHitIDs)
   {
-    
-    SetActiveGPU forDuration(device);
-    int numRaysWeHaveTotal = intraNode.sumRaysReceived;
+    NvtxRange nvtx("traceAllReceivedRays");
+    std::vector<int>   savedOriginalRayCount(perDevice.size());
+    std::vector<Ray *> savedOriginalRayQueue(perDevice.size());
     {
       ENTER();
-      if (logQueues) 
-        printf("buildlocalrays r%i total rays %i (q0)\n",
-               myGID,numRaysWeHaveTotal);
-      __rtc_launch(device->rtc,
-                   buildStagedRayQueue,
-                   divRoundUp(numRaysWeHaveTotal,1024),1024,
-                   // args
-                   stagedRayQueue,
-                   raysOnly[0],
-                   numRaysWeHaveTotal);
-      
-      device->rtc->sync();
-      LEAVE(numRaysWeHaveTotal,"buildStagedRayQueue");
+      for (auto &pd : perDevice) {
+        auto device = pd.device;
+        int numRaysWeHaveTotal = pd.numIntraRays;
+        if (logQueues) 
+          printf("buildlocalrays r%i total rays %i (q0)\n",
+                 pd.gid,numRaysWeHaveTotal);
+        if (numRaysWeHaveTotal > 0) {
+          SetActiveGPU forDuration(device);
+          __rtc_launch(device->rtc,
+                       buildStagedRayQueue,
+                       divRoundUp(numRaysWeHaveTotal,1024),1024,
+                       // args
+                       pd.stagedRayQueue,
+                       pd.raysOnly[0],
+                       numRaysWeHaveTotal,
+                       compressRays);
+        }
+        int local = device->localRank();
+        savedOriginalRayCount[local] = device->rayQueue->numActive;
+        savedOriginalRayQueue[local] = device->rayQueue->traceAndShadeReadQueue.rays;
+        device->rayQueue->traceAndShadeReadQueue.rays = pd.stagedRayQueue;
+        device->rayQueue->numActive = numRaysWeHaveTotal;
+      }
+      LEAVE(perDevice[0].numIntraRays,"buildStagedRayQueue");
     }
     
-    auto savedOriginalRayCount = device->rayQueue->numActive;
-    auto savedOriginalRayQueue = device->rayQueue->traceAndShadeReadQueue.rays;
-    device->rayQueue->traceAndShadeReadQueue.rays = stagedRayQueue;
-    device->rayQueue->numActive = numRaysWeHaveTotal;
-
     {
       ENTER()
-        if (logQueues) 
-          printf("localtrace r%i total rays %i\n",
-                 myGID,numRaysWeHaveTotal);
+      if (logQueues) 
+        printf("localtrace r%i total rays %i\n",
+               perDevice[0].gid,perDevice[0].numIntraRays);
       context->traceRaysLocally(model,rngSeed,needHitIDs);
-      device->rtc->sync();
-      LEAVE(numRaysWeHaveTotal,"localTrace");
+      LEAVE(perDevice[0].numIntraRays,"localTrace");
     }
     
-    if (logQueues) 
-      printf("buildhits r%i total rays %i (q0)\n",
-             myGID,numRaysWeHaveTotal);
     {
       ENTER();
-      __rtc_launch(device->rtc,
-                   buildHitsOnly,
-                   divRoundUp(numRaysWeHaveTotal,1024),1024,
-                   // args
-                   hitsOnly[0],
-                   stagedRayQueue,
-                   numRaysWeHaveTotal);
-      device->rtc->sync();
-      LEAVE(numRaysWeHaveTotal,"buildHitsOnly");
+      for (auto &pd : perDevice) {
+        auto device = pd.device;
+        int numRaysWeHaveTotal = pd.numIntraRays;
+        if (logQueues) 
+          printf("buildhits r%i total rays %i (q0)\n",
+                 pd.gid,numRaysWeHaveTotal);
+        if (numRaysWeHaveTotal > 0) {
+          SetActiveGPU forDuration(device);
+          __rtc_launch(device->rtc,
+                       buildHitsOnly,
+                       divRoundUp(numRaysWeHaveTotal,1024),1024,
+                       // args
+                       pd.hitsOnly[0],
+                       pd.stagedRayQueue,
+                       numRaysWeHaveTotal,
+                       compressRays);
+        }
+        int local = device->localRank();
+        device->rayQueue->numActive = savedOriginalRayCount[local];
+        device->rayQueue->traceAndShadeReadQueue.rays = savedOriginalRayQueue[local];
+      }
+      for (auto &pd : perDevice)
+        pd.device->rtc->sync();
+      LEAVE(perDevice[0].numIntraRays,"buildHitsOnly");
     }
-    device->rayQueue->numActive = savedOriginalRayCount;
-    device->rayQueue->traceAndShadeReadQueue.rays = savedOriginalRayQueue;
   }
   
   void TwoStage::exchangeHits_intraNode()
   {
+    NvtxRange nvtx("exchangeHits_intraNode");
     ENTER();
     if (opt_mpi) {
-      void *sendBuf = hitsOnly[0];
-      void *recvBuf = hitsOnly[1];
+      auto &pd = perDevice[0];
+      void *sendBuf = pd.hitsOnly[0];
+      void *recvBuf = pd.hitsOnly[1];
       std::vector<int> sendOffsets(intraNode.comm.size);
       std::vector<int> sendCounts(intraNode.comm.size);
       std::vector<int> recvOffsets(intraNode.comm.size);
@@ -502,12 +685,12 @@ namespace BARNEY_NS {
       int recvSum = 0;
       int sendSum = 0;
       for (int i=0;i<intraNode.comm.size;i++) {
-        int recvCount = crossNodes.sumRaysReceived;
+        int recvCount = pd.numCrossRays;
         int sendCount = intraNode.rayCounts[i];
-        recvOffsets[i] = recvSum*sizeof(HitOnly);
-        sendOffsets[i] = sendSum*sizeof(HitOnly);
-        recvCounts[i] = recvCount*sizeof(HitOnly);
-        sendCounts[i] = sendCount*sizeof(HitOnly);
+        recvOffsets[i] = recvSum*hitWireSize;
+        sendOffsets[i] = sendSum*hitWireSize;
+        recvCounts[i] = recvCount*hitWireSize;
+        sendCounts[i] = sendCount*hitWireSize;
         sendSum += sendCount;
         recvSum += recvCount;
       }
@@ -521,75 +704,89 @@ namespace BARNEY_NS {
                             MPI_BYTE,
                             intraNode.comm));
     } else {
-      std::vector<MPI_Request> requests;
-      int recvOfs = 0;
-      for (int g=0;g<gpusPerHost;g++) {
-        MPI_Request req;
-        int recvCount = 0;
-        for (int h=0;h<numHosts;h++)
-          recvCount += global.rayCounts[rankOf(h,gpuIdx)];
-        world.recv(rankOf(hostIdx,g),0,
-                   hitsOnly[1]+recvOfs,recvCount,req);
-        if (logQueues) 
-          printf("xchg-intra r%i receiving %i from %i (q0->1)\n",
-                 myGID,recvCount,rankOf(hostIdx,g));
-        requests.push_back(req);
-        recvOfs += recvCount;
-      }
+      auto &transport = *context->transport;
+      for (auto &pd : perDevice) {
+        const std::vector<int> &onHost = islands[pd.island].hosts[hostOf[pd.gid]];
+        // one set of hits for the rays we got in the cross-node
+        // stage, from each gpu on our host
+        int recvCount = pd.numCrossRays;
+        int ourOffset = intraOffsetOf(pd.gid);
+        int recvOfs = 0;
+        for (auto src : onHost) {
+          if (logQueues) 
+            printf("xchg-intra r%i receiving %i from %i (q0->1)\n",
+                   pd.gid,recvCount,src);
+          if (PerDevice *peer = getLocal(src))
+            pd.device->rtc->copyAsync(hitAt(pd.hitsOnly[1],recvOfs),
+                                      hitAt(peer->hitsOnly[0],ourOffset),
+                                      recvCount*hitWireSize);
+          else if (recvCount)
+            transport.recv(pd.device,src,hitAt(pd.hitsOnly[1],recvOfs),
+                           recvCount*hitWireSize);
+          recvOfs += recvCount;
+        }
 
-      // and matching sends
-      int sendOfs = 0;
-      for (int g=0;g<gpusPerHost;g++) {
-        int sendCount = 0;
-        for (int h=0;h<numHosts;h++)
-          sendCount += global.rayCounts[rankOf(h,g)];
-        MPI_Request req;
-        world.send(rankOf(hostIdx,g),0,
-                   hitsOnly[0]+sendOfs,sendCount,req);
-        if (logQueues) 
-          printf("xchg-intra r%i sending %i to %i (q0->1)\n",
-                 myGID,sendCount,rankOf(hostIdx,g));
-        requests.push_back(req);
-        sendOfs += sendCount;
+        // and matching sends
+        for (auto dst : onHost) {
+          if (getLocal(dst)) continue;
+          int sendCount = numCrossRaysOf(dst);
+          if (sendCount == 0) continue;
+          if (logQueues) 
+            printf("xchg-intra r%i sending %i to %i (q0->1)\n",
+                   pd.gid,sendCount,dst);
+          transport.send(pd.device,dst,
+                         hitAt(pd.hitsOnly[0],intraOffsetOf(dst)),
+                         sendCount*hitWireSize);
+        }
       }
-      BN_MPI_CALL(Waitall(requests.size(),requests.data(),MPI_STATUSES_IGNORE));
+      finishExchange();
     }
-    LEAVE(recvOfs,"exchangeHits_intraNode");
+    LEAVE(perDevice[0].numCrossRays,"exchangeHits_intraNode");
   }
 
 
   void TwoStage::reduceHits_intraNode()
   {
+    NvtxRange nvtx("reduceHits_intraNode");
     ENTER();
-    SetActiveGPU forDuration(device);
-    int numUniqueRaysThisGPU = crossNodes.sumRaysReceived;
-    // int g = gpuIdx;
-    // for (int h=0;h<numHosts;h++)
-    //   numUniqueRaysThisGPU += rayCounts[rankOf(h,g)];
-
-    if (logQueues) 
-      printf("r%i intra-reducing %i sets of %i hits (q1)\n",
-             myGID,
-             gpusPerHost,
-             numUniqueRaysThisGPU);
-    __rtc_launch(device->rtc,
-                 reduceReceivedHitsKernel_intraNode,
-                 divRoundUp(numUniqueRaysThisGPU,128),128,
-                 // args
-                 hitsOnly[1],
-                 numUniqueRaysThisGPU,
-                 gpusPerHost);
-    device->rtc->sync();
-    LEAVE(numUniqueRaysThisGPU*gpusPerHost,"reduceHits_intraNode");
+    for (auto &pd : perDevice) {
+      auto device = pd.device;
+      SetActiveGPU forDuration(device);
+      int numUniqueRaysThisGPU = pd.numCrossRays;
+      int reduceFactor
+        = opt_mpi
+        ? intraNode.comm.size
+        : (int)islands[pd.island].hosts[hostOf[pd.gid]].size();
+
+      if (logQueues) 
+        printf("r%i intra-reducing %i sets of %i hits (q1)\n",
+               pd.gid,
+               reduceFactor,
+               numUniqueRaysThisGPU);
+      if (numUniqueRaysThisGPU == 0) continue;
+      __rtc_launch(device->rtc,
+                   reduceReceivedHitsKernel_intraNode,
+                   divRoundUp(numUniqueRaysThisGPU,128),128,
+                   // args
+                   pd.hitsOnly[1],
+                   numUniqueRaysThisGPU,
+                   reduceFactor,
+                   compressRays);
+    }
+    for (auto &pd : perDevice)
+      pd.device->rtc->sync();
+    LEAVE(perDevice[0].numCrossRays,"reduceHits_intraNode");
   }
   
   void TwoStage::exchangeHits_crossNodes()
   {
+    NvtxRange nvtx("exchangeHits_crossNodes");
     ENTER();
     if (opt_mpi) {
-      int myRayCount = device->rayQueue->numActive;
-      void *sendBuf = hitsOnly[1];
-      void *recvBuf = hitsOnly[0];
+      auto &pd = perDevice[0];
+      int myRayCount = pd.device->rayQueue->numActive;
+      void *sendBuf = pd.hitsOnly[1];
+      void *recvBuf = pd.hitsOnly[0];
       std::vector<int> sendOffsets(crossNodes.comm.size);
       std::vector<int> sendCounts(crossNodes.comm.size);
       std::vector<int> recvOffsets(crossNodes.comm.size);
@@ -599,16 +796,16 @@ namespace BARNEY_NS {
       for (int i=0;i<crossNodes.comm.size;i++) {
         int recvCount = myRayCount;
         int sendCount = crossNodes.rayCounts[i];
-        recvOffsets[i] = recvSum*sizeof(HitOnly);
-        sendOffsets[i] = sendSum*sizeof(HitOnly);
-        recvCounts[i] = recvCount*sizeof(HitOnly);
-        sendCounts[i] = sendCount*sizeof(HitOnly);
+        recvOffsets[i] = recvSum*hitWireSize;
+        sendOffsets[i] = sendSum*hitWireSize;
+        recvCounts[i] = recvCount*hitWireSize;
+        sendCounts[i] = sendCount*hitWireSize;
         sendSum += sendCount;
         recvSum += recvCount;
       }
       if (logQueues) 
         printf("xchg-hits-cross r%i myRayCount %i sendSum %i recvSum %i\n",
-               myGID,myRayCount,sendSum,recvSum);
+               pd.gid,myRayCount,sendSum,recvSum);
       BN_MPI_CALL(Alltoallv(sendBuf,
                             (const int*)sendCounts.data(),
                             (const int*)sendOffsets.data(),
@@ -619,73 +816,82 @@ namespace BARNEY_NS {
                             MPI_BYTE,
                             crossNodes.comm));
     } else {
-      std::vector<MPI_Request> requests;
-      int recvOfs = 0;
-      int recvCount = global.rayCounts[rankOf(hostIdx,gpuIdx)];
-      for (int h=0;h<numHosts;h++) {
-        MPI_Request req;
-
-        if (logQueues) 
-          printf("xchg-intra r%i receiving %i from %i (q1->0)\n",
-                 myGID,recvCount,rankOf(h,gpuIdx));
-        world.recv(rankOf(h,gpuIdx),0,
-                   hitsOnly[0]+recvOfs,recvCount,req);
-        requests.push_back(req);
-        recvOfs += recvCount;
-      }
+      auto &transport = *context->transport;
+      for (auto &pd : perDevice) {
+        const Island &island = islands[pd.island];
+        int numHosts = (int)island.hosts.size();
+        // one set of hits for our own rays, from the gpu serving our
+        // column on each host
+        int recvCount = global.rayCounts[pd.gid];
+        int recvOfs = 0;
+        for (int h=0;h<numHosts;h++) {
+          int src = island.serverOf(h,columnOf[pd.gid]);
+          if (logQueues) 
+            printf("xchg-cross r%i receiving %i from %i (q1->0)\n",
+                   pd.gid,recvCount,src);
+          if (PerDevice *peer = getLocal(src))
+            pd.device->rtc->copyAsync(hitAt(pd.hitsOnly[0],recvOfs),
+                                      hitAt(peer->hitsOnly[1],
+                                            crossOffsetOf(src,pd.gid)),
+                                      recvCount*hitWireSize);
+          else if (recvCount)
+            transport.recv(pd.device,src,hitAt(pd.hitsOnly[0],recvOfs),
+                           recvCount*hitWireSize);
+          recvOfs += recvCount;
+        }
 
-      // and matching sends
-      int sendOfs = 0;
-      for (int h=0;h<numHosts;h++) {
-        MPI_Request req;
-        int sendCount = global.rayCounts[rankOf(h,gpuIdx)];
-        if (logQueues) 
-          printf("xchg-intra r%i sending %i to %i (q1->0)\n",
-                 myGID,sendCount,rankOf(h,gpuIdx));
-        world.send(rankOf(h,gpuIdx),0,
-                   hitsOnly[1]+sendOfs,sendCount,req);
-        requests.push_back(req);
-        sendOfs += sendCount;
+        // and matching sends, to everybody whose rays we served
+        int sendOfs = 0;
+        for (auto c : pd.columns)
+          for (int h=0;h<numHosts;h++) {
+            int dst = island.deviceAt(h,c);
+            if (dst < 0) continue;
+            int sendCount = global.rayCounts[dst];
+            if (!getLocal(dst) && sendCount) {
+              if (logQueues) 
+                printf("xchg-cross r%i sending %i to %i (q1->0)\n",
+                       pd.gid,sendCount,dst);
+              transport.send(pd.device,dst,
+                             hitAt(pd.hitsOnly[1],sendOfs),
+                             sendCount*hitWireSize);
+            }
+            sendOfs += sendCount;
+          }
       }
-    
-      BN_MPI_CALL(Waitall(requests.size(),requests.data(),MPI_STATUSES_IGNORE));
+      finishExchange();
     }
-    LEAVE(recvOfs,"exchangeHits_crossNodes");
+    LEAVE(perDevice[0].device->rayQueue->numActive,"exchangeHits_crossNodes");
   }
   
   void TwoStage::reduceHits_crossNodes()
   {
+    NvtxRange nvtx("reduceHits_crossNodes");
     ENTER();
-    SetActiveGPU forDuration(device);
-    if (opt_mpi) {
+    for (auto &pd : perDevice) {
+      auto device = pd.device;
+      SetActiveGPU forDuration(device);
       int numUniqueRaysThisGPU = device->rayQueue->numActive;
+      int reduceFactor
+        = opt_mpi
+        ? crossNodes.comm.size
+        : (int)islands[pd.island].hosts.size();
       if (logQueues) 
         printf("r%i cross-reducing %i sets of %i hits (q0)\n",
-               myGID,numHosts,numUniqueRaysThisGPU);
+               pd.gid,reduceFactor,numUniqueRaysThisGPU);
+      if (numUniqueRaysThisGPU == 0) continue;
       __rtc_launch(device->rtc,
                    reduceReceivedHitsKernel_crossNodes,
                    divRoundUp(numUniqueRaysThisGPU,128),128,
                    // args
                    device->rayQueue->traceAndShadeReadQueue.rays,
-                   hitsOnly[0],
+                   pd.hitsOnly[0],
                    numUniqueRaysThisGPU,
-                   numHosts);
-    } else {
-      int numUniqueRaysThisGPU = global.rayCounts[rankOf(hostIdx,gpuIdx)];
-      if (logQueues) 
-        printf("r%i cross-reducing %i sets of %i hits (q0)\n",
-               myGID,numHosts,numUniqueRaysThisGPU);
-      __rtc_launch(device->rtc,
-                 reduceReceivedHitsKernel_crossNodes,
-                 divRoundUp(numUniqueRaysThisGPU,128),128,
-                 // args
-                 device->rayQueue->traceAndShadeReadQueue.rays,
-                 hitsOnly[0],
-                 numUniqueRaysThisGPU,
-                 numHosts);
+                   reduceFactor,
+                   compressRays);
     }
-    device->rtc->sync();
-    LEAVE(numUniqueRaysThisGPU*numHosts,"reduceHits_crossNodes");
+    for (auto &pd : perDevice)
+      pd.device->rtc->sync();
+    LEAVE(perDevice[0].device->rayQueue->numActive,"reduceHits_crossNodes");
   }
   
 }
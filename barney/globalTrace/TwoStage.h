@@ -12,39 +12,107 @@ namespace BARNEY_NS {
   struct MPIContext;
   using render::RayOnly;
   using render::HitOnly;
+  using render::CompressedRay;
+  using render::CompressedHit;
   using render::Ray;
 
-  /*! for now, only implmenet for
-    a) single device per rank
-    b) single island
-    c) fixed number of ranks per physical host
+  /*! global ray tracing in two stages: rays first get exchanged
+    with the 'same' gpus on all other hosts (cross-node), then
+    between all gpus within each host (intra-node), after which
+    every gpu of an island has all of that island's rays; hits then
+    go back the same way, getting reduced after each stage.
+
+    Works on any number of devices per rank and any number of
+    islands; hosts may have different numbers of gpus. Devices are
+    enumerated by host (using the WorkerTopo's host hashes), and a
+    device's index within its host is its 'column'; on a host with
+    fewer gpus than another, a device serves more than one
+    column. Exchanges between devices of the same rank are direct
+    device-to-device copies (ie, p2p/nvlink if available), all
+    others go through the context's RayTransport.
+
+    The 'opt_mpi' variant (which uses mpi collectives) is only
+    available for a single device per rank, a single island, and
+    the same number of gpus on every host.
   */
   struct TwoStage : public GlobalTraceImpl {
-    int hostIdx;
-    int gpuIdx;
-    int myGID;
+    /*! how the devices of one island are spread across physical
+        hosts */
+    struct Island {
+      /*! global IDs of this island's devices on each host, in gid
+          order */
+      std::vector<std::vector<int>> hosts;
+      /*! max number of this island's devices on any host */
+      int numColumns = 0;
+
+      /*! device in given column on given host, or -1 if that host
+          doesn't have that many devices */
+      int deviceAt(int host, int column) const
+      { return column < (int)hosts[host].size() ? hosts[host][column] : -1; }
+      /*! the device on given host that receives the given column's
+          rays during the cross-node stage */
+      int serverOf(int host, int column) const
+      { return hosts[host][column % hosts[host].size()]; }
+    };
+    std::vector<Island> islands;
+    /*! host (within its island) and column of each global device */
+    std::vector<int> hostOf;
+    std::vector<int> columnOf;
+
+    struct PerDevice {
+      Device *device;
+      int gid;
+      int island;
+      /*! columns this device serves in cross-node stage, starting
+          with its own */
+      std::vector<int> columns;
+      RayOnly *raysOnly[2] = { 0, 0 };
+      HitOnly *hitsOnly[2] = { 0, 0 };
+      Ray *stagedRayQueue = 0;
+      int currentReservedSize = 0;
+      /*! num rays this device has after the cross-node stage */
+      int numCrossRays = 0;
+      /*! num rays this device traces, after both stages */
+      int numIntraRays = 0;
+    };
+    std::vector<PerDevice> perDevice;
+    /*! returns our local device with given gid, or null if that
+        device lives on another rank */
+    PerDevice *getLocal(int gid);
+
+    /*! num rays given device will have after the cross-node stage */
+    int numCrossRaysOf(int gid) const;
+    /*! offset (in rays) at which 'server' stores the rays it receives
+        from 'src' in the cross-node stage */
+    int crossOffsetOf(int server, int src) const;
+    /*! offset (in rays) of given device's cross-node rays within
+        what each device on its host traces */
+    int intraOffsetOf(int gid) const;
 
-    int gpusPerHost;
-    int numGlobal;
-    int numHosts;
-    
-    RayOnly *raysOnly[2] = { 0, 0 };
-    HitOnly *hitsOnly[2] = { 0, 0 };
-    int currentReservedSize = 0;
-    Ray *stagedRayQueue = 0;
-    // Ray *savedOriginalRayQueue;
-    // int  savedOriginalRayCount;
     WorkerTopo *topo;
-    const Device *device;
     MPIContext *const context;
     struct {
       std::vector<int> rayCounts;
     } global;
     const bool logTopo;
     const bool logQueues;
-    const bool opt_mpi;
+    /*! only honored for layouts the collectives can handle; see
+        above */
+    bool opt_mpi;
+    /*! if set, rays and hits go over the wire as CompressedRay and
+        CompressedHit (in the same buffers) */
+    const bool compressRays;
+    const size_t rayWireSize;
+    const size_t hitWireSize;
+    /*! address of the idx'th ray (or hit) in a buffer of rays (or
+        hits) in wire format */
+    uint8_t *rayAt(void *buffer, int idx) const
+    { return (uint8_t*)buffer + idx*rayWireSize; }
+    uint8_t *hitAt(void *buffer, int idx) const
+    { return (uint8_t*)buffer + idx*hitWireSize; }
 
     TwoStage(MPIContext *context);
+    ~TwoStage() override;
     void traceRays(GlobalModel *model, uint32_t rngSeed, bool needHitIDs) override;
     
     void ensureAllOurQueuesAreLargeEnough();
@@ -56,10 +124,9 @@ namespace BARNEY_NS {
     
     void reduceHits_intraNode();
     void reduceHits_crossNodes();
-
-    int rankOf(int hostIdx, int gpuIdx)
-    { return _rankOf[hostIdx*gpusPerHost+gpuIdx]; }
-    std::vector<int> _rankOf;
+    /*! completes one stage's exchange: flushes the transport, and
+        syncs all local devices */
+    void finishExchange();
 
     // step 3: trace all rays on each device
     void traceAllReceivedRays(GlobalModel *model, uint32_t rngSeed, bool needHitIDs);
@@ -67,18 +134,11 @@ namespace BARNEY_NS {
     barney_api::mpi::Comm &world;
 
     // only used for opt_mpi variant:
-    // struct {
-    //   int numRaysReceived;
-    // } bothStages;
     struct {
-      int sumRaysReceived;
-      // opt_mpi only:
       barney_api::mpi::Comm comm;
       std::vector<int> rayCounts;
     } intraNode;
     struct {
-      int sumRaysReceived;
-      // opt_mpi only:
       barney_api::mpi::Comm comm;
       std::vector<int> rayCounts;
     } crossNodes;
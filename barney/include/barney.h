@@ -99,6 +99,17 @@ typedef enum {
   BN_FB_INSTID = (1<<3),
   BN_FB_OBJID  = (1<<4),
   BN_FB_NORMAL = (1<<5),
+  /*! final color, jpeg-encoded on the gpu; only available if barney
+      was built with nvjpeg (BARNEY_NVJPEG). Read through
+      bnFrameBufferRead() into a buffer of at least
+      bnFrameBufferGetEncodedSize() bytes */
+  BN_FB_COLOR_JPEG = (1<<6),
+  /*! per pixel, how many rays (path segments plus shadow rays) got
+      shaded for it during the last frame, summed over all its samples
+      and - with data-parallel rendering - over all ranks; one uint32
+      per pixel, to be read as BN_INT. Meant for viewing where a scene
+      is expensive to render */
+  BN_FB_COST = (1<<7),
 } BNFrameBufferChannel;
 
 typedef enum {
@@ -174,6 +185,19 @@ typedef enum {
   BN_UFIXED8_RGBA_SRGB,
 
   BN_UFIXED16,
+
+  /*! block-compressed 2D texels (texture data only): 4x4 texel
+      blocks of 8 (BC1, BC4) or 16 bytes each, in row-major order;
+      width and height are still given in texels, and get rounded up
+      to full blocks. Saves 4-8x device memory over their
+      uncompressed counterparts on gpus; the cpu backend decodes them
+      on upload, and doesn't support BC6H */
+  BN_BC1_RGBA_UNORM=320,
+  BN_BC3_RGBA_UNORM,
+  BN_BC4_R_UNORM,
+  BN_BC5_RG_UNORM,
+  BN_BC6H_RGB_UFLOAT,
+  BN_BC7_RGBA_UNORM,
   
   BN_RAW_DATA_BASE
 } BNDataType;
@@ -229,6 +253,56 @@ struct BNHardwareInfo {
   int localRank;
 };
 
+#define BN_FRAME_STATS_MAX_GENERATIONS 64
+
+/*! per-stage timings of the last frame rendered into (and read from)
+    a frame buffer, in milliseconds as measured on the device(s); see
+    bnFrameBufferGetStats() */
+struct BNFrameStats {
+  int   numGenerations;
+  float generateRays;
+  float finalizeTiles;
+  float linearize;
+  float denoise;
+  float readback;
+  /*! per generation; forwarding is whatever time tracing a
+      generation took on top of its local trace(s) */
+  float trace[BN_FRAME_STATS_MAX_GENERATIONS];
+  float forward[BN_FRAME_STATS_MAX_GENERATIONS];
+  float shade[BN_FRAME_STATS_MAX_GENERATIONS];
+  /*! rays active (across all ranks) after each generation, or -1
+      where that count didn't get read back */
+  int   numRays[BN_FRAME_STATS_MAX_GENERATIONS];
+};
+
+/*! what the device-side counters of a build with
+    BARNEY_DEVICE_COUNTERS counted; see bnFrameBufferGetCounters() */
+struct BNDeviceCounterValues {
+  uint64_t raysGenerated;
+  /*! rays traced, and how many of those were shadow rays; with
+      multiple slots or ranks a ray counts once per local trace */
+  uint64_t raysTraced;
+  uint64_t shadowRays;
+  uint64_t raysShaded;
+  /*! intersection program calls of user geometries */
+  uint64_t primTests;
+  /*! volume macro cells stepped through */
+  uint64_t ddaCells;
+  /*! woodcock (and ratio tracking) tentative collisions, and how
+      many of those were real; each sample is one query of the
+      volume's field (structured, umesh, amr, ...) */
+  uint64_t woodcockSamples;
+  uint64_t woodcockAccepted;
+};
+
+/*! device counters of the last frame rendered, summed over this
+    rank's devices */
+struct BNDeviceCounters {
+  int numGenerations;
+  struct BNDeviceCounterValues total;
+  struct BNDeviceCounterValues perGeneration[BN_FRAME_STATS_MAX_GENERATIONS];
+};
+
 
 
 // ==================================================================
@@ -251,8 +325,39 @@ BNFrameBuffer bnFrameBufferCreate(BNContext context, int deprecated=0);
 BARNEY_API
 BNModel       bnModelCreate(BNContext ctx);
 
+/*! from now on (enable != 0), or no longer (enable == 0), have the
+    context remember every creation, parameter set, commit and build
+    of model-side objects (arrays, texture data and textures, scalar
+    fields, geometries, materials, samplers, lights, volumes, groups
+    and models), so models created while it records can be saved
+    with bnModelSave(). While recording, the context keeps a host copy
+    of every array and texel payload that did not come from a file */
+BARNEY_API
+void bnContextRecordSnapshot(BNContext context, int enable);
+
+/*! writes everything that given model (created while its context was
+    recording) depends on - objects, parameters, array and texel
+    payloads, and the commits and builds done on them - to a snapshot
+    file that bnModelLoad() can recreate it from. Payloads get stored
+    in page-aligned chunks, so loading maps the file and uploads them
+    straight from the page cache. With MPI contexts each rank saves
+    (and later loads) its own part of the model, so use a different
+    file name per rank. Accels don't get saved; set an accel cache
+    (BARNEY_CONFIG=accelCache=<dir>) to skip re-building those, too.
+    Returns 0 on failure */
+BARNEY_API
+int bnModelSave(BNModel model, const char *fileName);
+
+/*! creates a new model from a bnModelSave() snapshot, re-doing all
+    the commits and builds that it recorded; the returned model is
+    ready to render. Returns 0 on failure */
+BARNEY_API
+BNModel bnModelLoad(BNContext context, const char *fileName);
+
 /*! create a new renderer object. Currently supported types:
-    "pathTracer", "default" (same as pathtracer) */
+    "pathTracer", "default" (same as pathtracer), and "raycast" (a
+    preview renderer that only shades primary hits, with a headlight
+    and no shadow rays or secondary bounces) */
 BARNEY_API
 BNRenderer    bnRendererCreate(BNContext ctx,
                                const char *type BN_IF_CPP(= "default"));
@@ -328,6 +433,114 @@ BNContext bnContextCreate(/*! how many data slots this context is to
 BARNEY_API
 void bnContextDestroy(BNContext context);
 
+/*! what device memory gets used for; see bnContextGetMemoryInfo() */
+typedef enum {
+  BN_MEMORY_OTHER=0,
+  /*! rays, path states, and hit ids of each device's ray queues */
+  BN_MEMORY_RAY_QUEUES,
+  /*! frame buffer tiles, and the linear staging buffers they get
+      gathered into */
+  BN_MEMORY_FRAME_BUFFERS,
+  /*! geometry groups' and instance lists' acceleration structures */
+  BN_MEMORY_BVHS,
+  BN_MEMORY_TEXTURES,
+  /*! data arrays created by the app (bnDataCreate() etc) */
+  BN_MEMORY_DATA_ARRAYS,
+  /*! what scalar fields derive to sample from, e.g., structured
+      volumes' 3D textures */
+  BN_MEMORY_VOLUME_FIELDS,
+  BN_MEMORY_MAJORANT_GRIDS,
+  /*! umesh and amr sampling accels (cuBQL bvhs, AWT, ...) */
+  BN_MEMORY_VOLUME_ACCELS,
+  BN_MEMORY_MATERIALS,
+  BN_MEMORY_NUM_CATEGORIES
+} BNMemoryCategory;
+
+/*! device memory use of one of this rank's devices */
+struct BNDeviceMemoryInfo {
+  /*! this device's index within the context's devices */
+  int    localDeviceID;
+  /*! by BNMemoryCategory */
+  size_t used[BN_MEMORY_NUM_CATEGORIES];
+  size_t totalUsed;
+  /*! most that totalUsed has been since context creation or the
+      last bnContextResetMemoryHighWater() */
+  size_t highWaterMark;
+  /*! as reported by the device (or, on the cpu, the host) right
+      now; this includes whatever other processes use */
+  size_t freeBytes;
+  size_t totalBytes;
+  /*! freed memory that the device's allocator (the gpu's memory
+      pool, or the cpu backend's arena) keeps around for re-use; not
+      part of totalUsed, but not free to others, either */
+  size_t cachedBytes;
+};
+
+/*! fills in memory use of (up to maxInfos of) this rank's devices,
+    and returns how many devices there are. Only counts what barney
+    itself allocated through its backends; BVHs are only accounted
+    for on the optix backend */
+BARNEY_API
+int bnContextGetMemoryInfo(BNContext context,
+                           BNDeviceMemoryInfo *infos,
+                           int maxInfos);
+
+/*! restarts all devices' high-water marks at what they use now */
+BARNEY_API
+void bnContextResetMemoryHighWater(BNContext context);
+
+/*! what part of getting a model ready a BNBuildRecord is about */
+typedef enum {
+  /*! bnCommit() of a geometry, scalar field or volume, including
+      whatever that uploads */
+  BN_BUILD_COMMIT,
+  /*! a geometry's own per-build work (eg, iso-surface accels) */
+  BN_BUILD_GEOMETRY,
+  /*! one device's BVH build over a group's geometries */
+  BN_BUILD_GROUP,
+  /*! same, if only vertices changed and the BVHs got refit */
+  BN_BUILD_GROUP_REFIT,
+  /*! a volume's accel (majorants, object-space clusters, ...) */
+  BN_BUILD_VOLUME,
+  /*! one device's instance BVH, in bnBuild() */
+  BN_BUILD_INSTANCES,
+} BNBuildStage;
+
+/*! timing and size of one build step; see bnContextGetBuildRecords() */
+struct BNBuildRecord {
+  BNBuildStage stage;
+  /*! the object that got built or committed (null for instance
+      builds), and its (truncated) type name */
+  BNObject     object;
+  char         name[48];
+  /*! local device this was done on; -1 for steps that cover all of
+      the object's devices */
+  int          localDeviceID;
+  double       seconds;
+  /*! primitives (or, for BN_BUILD_INSTANCES, instances) involved; 0
+      where not known */
+  size_t       numPrims;
+  /*! what got allocated for BVHs, volume accels and majorant grids
+      during this step (BVHs only count on the optix backend) */
+  size_t       accelBytes;
+  /*! everything that got allocated during this step, including
+      uploaded arrays */
+  size_t       allocatedBytes;
+};
+
+/*! copies (up to maxRecords of) the most recent build records since
+    context creation or the last bnContextClearBuildRecords() into
+    'records', oldest first, and returns how many there are. Barney
+    keeps at most 1024; with BARNEY_CONFIG=log_builds every record
+    also gets printed as a json line as soon as it is done */
+BARNEY_API
+int bnContextGetBuildRecords(BNContext context,
+                             BNBuildRecord *records,
+                             int maxRecords);
+
+BARNEY_API
+void bnContextClearBuildRecords(BNContext context);
+
 /*! decreases (the app's) reference count of said object by one. if
     said refernce count falls to 0 the object handle gets destroyed
     and may no longer be used by the app, and the object referenced to
@@ -364,24 +577,185 @@ void bnFrameBufferResize(BNFrameBuffer fb,
                          int sizeX, int sizeY,
                          uint32_t requiredChannels BN_IF_CPP( = BN_FB_COLOR));
 
+/*! reads given channel of the last rendered frame. With MPI, this
+    is the full frame on rank 0 (and a blank one everywhere else) -
+    unless any rank set an int4 "displayRegion" (lower x,y and upper,
+    exclusive, x,y, in pixels) on the frame buffer before its last
+    resize: then every rank gets just the color of its own region,
+    straight from the gpus that rendered it, with no gather on rank 0
+    (eg, for display walls, where each rank drives one screen). In
+    that mode, pointerToReadDataInto only has to hold that region's
+    pixels, and only BN_FB_COLOR gets produced */
 BARNEY_API
 void bnFrameBufferRead(BNFrameBuffer fb,
                        BNFrameBufferChannel channelToRead,
                        void *pointerToReadDataInto,
                        BNDataType requiredFormat);
 
+/*! registers memory that a graphics api exported as an opaque posix
+    file descriptor - eg, a vulkan buffer, or an opengl buffer object
+    through GL_EXT_memory_object_fd - as this frame buffer's color
+    target: from then on every bnRender() writes the final (and, if
+    enabled, denoised) color channel into that memory, in the color
+    format given to bnFrameBufferResize(), without any readback to
+    the host. numBytes has to cover the full frame buffer; the fd
+    belongs to barney once it got imported. Pass fd=-1 to unregister.
+    Only on gpu backends; only has an effect on the rank that owns
+    the frame buffer */
+BARNEY_API
+void bnFrameBufferSetColorTarget(BNFrameBuffer fb, int fd, size_t numBytes);
+
+/*! size, in bytes, of the most recent frame's encoded color (see
+    BN_FB_COLOR_JPEG); 0 if this frame buffer doesn't encode */
+BARNEY_API
+size_t bnFrameBufferGetEncodedSize(BNFrameBuffer fb);
+
 /*! Return the actual framebuffer dimensions (may differ from resize
     when e.g. AI upscaling forces even dimensions). Use for buffer
     allocation and stride when mapping the color channel. */
 BARNEY_API
 void bnFrameBufferGetSize(BNFrameBuffer fb, int *sizeX, int *sizeY);
 
+/*! fills in per-stage timings of the last frame rendered into this
+    frame buffer (waiting for that frame to complete if required).
+    Timings only get collected if barney runs with
+    BARNEY_CONFIG=profile=1; returns 0 (and leaves stats untouched)
+    otherwise */
+BARNEY_API
+int bnFrameBufferGetStats(BNFrameBuffer fb, BNFrameStats *stats);
+
+/*! reads back the device-side ray and traversal counters of the last
+    frame rendered (with any frame buffer of fb's context). Only
+    available if barney got built with BARNEY_DEVICE_COUNTERS; returns
+    0 (and leaves counters untouched) otherwise */
+BARNEY_API
+int bnFrameBufferGetCounters(BNFrameBuffer fb, BNDeviceCounters *counters);
+
+/*! whether fb's accumulation got stopped, having reached the frame
+    buffer's "maxAccumulation" samples or (with "stopWhenConverged")
+    converged everywhere; bnRender() into it then returns without
+    rendering anything, until accumulation restarts (bnAccumReset(),
+    resize, ...) */
+BARNEY_API
+int bnFrameBufferIsConverged(BNFrameBuffer fb);
+
+/*! for offline rendering: writes given channels (BN_FB_COLOR and/or
+    BN_FB_DEPTH) of the frame last rendered into fb to
+    '<baseName>.png' (8-bit color formats) or '<baseName>.pfm' (float
+    color), and '<baseName>_depth.pfm'. Only the readback happens
+    right away, into pinned host memory; encoding and writing happen
+    on background threads (set1i("writeThreads"), default 2) while
+    the next frame renders. Once set1i("writeQueueDepth") frames
+    (default 3) are waiting to get written, this blocks until one of
+    them is done. Call on all ranks, like bnFrameBufferRead(); only
+    the owner writes */
+BARNEY_API
+void bnFrameBufferWriteAsync(BNFrameBuffer fb,
+                             const char *baseName,
+                             uint32_t channels BN_IF_CPP(= BN_FB_COLOR));
+
+/*! waits until all frames queued through bnFrameBufferWriteAsync()
+    got written, and returns how many of them could not be written
+    since the previous flush */
+BARNEY_API
+int bnFrameBufferFlushWrites(BNFrameBuffer fb);
+
 BARNEY_API
 void bnRender(BNRenderer    renderer,
               BNModel       model,
               BNCamera      camera,
               BNFrameBuffer fb);
 
+/*! renders the same model from numViews cameras, the i'th one into
+    fbs[i], as a single frame: all views' rays share the same
+    wavefronts, so every bounce gets traced and shaded once for all
+    views. Meant for many (small) views of the same model, like light
+    field captures or cave walls. All frame buffers have to be of the
+    same size, color format and channels; if they aren't (or with
+    settings that depend on a single camera, like ReSTIR or temporal
+    reprojection) this falls back to one bnRender() per view. Views
+    accumulate together: if any one of them restarts accumulation,
+    all of them do */
+BARNEY_API
+void bnRenderMulti(BNRenderer           renderer,
+                   BNModel              model,
+                   const BNCamera      *cameras,
+                   const BNFrameBuffer *fbs,
+                   int                  numViews);
+
+/*! what bnPick() found along one pick ray */
+struct BNPickResult {
+  /*! whether the ray hit anything, surface or volume; if not, none
+      of the other fields are valid except the ids */
+  int       hit;
+  /*! distance along the (normalized) ray to the closest hit, and
+      that hit's world-space position and normal; the normal is
+      zero for volume hits */
+  float     t;
+  bn_float3 position;
+  bn_float3 normal;
+  /*! ids of the closest surface along the ray, as the
+      BN_FB_PRIMID/OBJID/INSTID channels would have them for that
+      pixel (ie, regardless of transparency); -1 if there's none */
+  int       primID;
+  int       objID;
+  int       instID;
+};
+
+/*! traces one primary ray per given screen position - in [0,1]^2 of
+    a sizeX*sizeY frame, (0,0) being its lower left - through the
+    model, the same way (and with the same cut plane) the last
+    bnRender() traced its camera rays, including data-parallel
+    forwarding; and returns what each one hit in results[]. Meant for
+    picking and hover highlighting, without rendering (and reading
+    back) a frame's id channels. Pick rays go through the lens
+    center, and don't get shaded, so transparency is the only
+    material property that matters. Collective like bnRender(); all
+    ranks get the same results */
+BARNEY_API
+void bnPick(BNModel          model,
+            BNCamera         camera,
+            int              sizeX,
+            int              sizeY,
+            const bn_float2 *screenPos,
+            int              numPicks,
+            BNPickResult    *results);
+
+/*! one ray for bnTraceRays(); dir doesn't have to be normalized,
+    with tMin and tMax (and the hit's t) all in units of its length */
+struct BNRay {
+  bn_float3 org;
+  float     tMin;
+  bn_float3 dir;
+  float     tMax;
+};
+
+/*! what bnTraceRays() found along one BNRay */
+struct BNRayHit {
+  /*! distance to the closest hit, or -1 if there is none */
+  float     t;
+  /*! the closest hit's normal; zero for volume hits */
+  bn_float3 normal;
+  /*! same as BNPickResult's */
+  int       primID;
+  int       objID;
+  int       instID;
+};
+
+/*! traces given (host-side) rays through the model - closest hit
+    only, no shading - and returns in hits[i] what rays[i] hit; for
+    non-visual queries like sensor simulation or line of sight, on
+    the same acceleration structures (and with the same data-parallel
+    forwarding, and cut plane) that rendering uses. Collective like
+    bnRender(); each rank traces (and gets results for) its own rays,
+    of which it may have none. Rays of passive (ie, display-only)
+    ranks don't get traced, and all miss */
+BARNEY_API
+void bnTraceRays(BNModel       model,
+                 const BNRay  *rays,
+                 int           numRays,
+                 BNRayHit     *hits);
+
 BARNEY_API
 void bnSetInstances(BNModel model,
                     int whichSlot,
@@ -399,8 +773,42 @@ void bnUpdateInstanceTransforms(BNModel model,
                                 BNTransform *instanceTransforms,
                                 int numInstances);
 
-/*! allows for setting one of 5 attribute arrays for the given slot's
-    model. */
+/*! like bnUpdateInstanceTransforms(), but for only the (few) listed
+    instances: instance instanceIDs[i] (its index in what got passed
+    to bnSetInstances) gets transform instanceTransforms[i]. Only
+    those instances' lights get re-extracted, and only their entries
+    in the instance accels get patched, so the cost grows with the
+    number of instances that move rather than with the total. */
+BARNEY_API
+void bnUpdateInstanceTransformsSparse(BNModel model,
+                                      int whichSlot,
+                                      const int *instanceIDs,
+                                      const BNTransform *instanceTransforms,
+                                      int count);
+
+/*! tells barney the world-space bounds of everything in the given
+    slot's model (i.e., in data-parallel rendering, of this rank's
+    part of the data). Optional; if set on all ranks, data-parallel
+    global tracing with BARNEY_CONFIG=all2all,routeRays only sends
+    rays to those ranks whose bounds they actually overlap. Bounds
+    have to be conservative, and get published to the other ranks
+    at the start of the next frame. */
+BARNEY_API
+void bnSetDomainBounds(BNModel model,
+                       int whichSlot,
+                       bn_float3 lower,
+                       bn_float3 upper);
+
+/*! allows for setting one of 5 attribute arrays ("attribute0" to
+    "attribute4", or "color") for the given slot's model, or the
+    "instID" array (BN_INT32, one per instance) of user instance IDs
+    that both the BN_FB_INSTID channel and the attribute arrays go
+    through: with one set, attribute arrays are indexed by user
+    instance ID rather than by instance index. The remap table gets
+    built in bnBuild(); the attribute arrays get used as they are, so
+    they can be changed with bnDataSetRange() without a rebuild.
+    Instances whose ID is past an attribute array's end keep the
+    geometry's default. */
 BARNEY_API
 void bnSetInstanceAttributes(BNModel model,
                              int whichSlot,
@@ -416,7 +824,12 @@ void bnSetInstanceAttributes(BNModel model,
   CUDA array that lies in either device or managed memory.  Note data
   arrays of this type can _not_ be assigned to samplers because these
   need data to be put into cudaArray's (in order to create
-  cudaTextures) */
+  cudaTextures).
+
+  On the GPU backends 'items' may also be a CUDA device pointer, on
+  any GPU of this process; barney then copies device-to-device (or
+  peer-to-peer), without staging through the host. Same for
+  bnDataSet() */
 BARNEY_API
 BNData bnDataCreate(BNContext context,
                     int whichSlot,
@@ -424,11 +837,56 @@ BNData bnDataCreate(BNContext context,
                     size_t numItems,
                     const void *items);
 
+/*! same as bnDataCreate(), but with the numItems items read from
+    given file, starting at byte 'offset'. The file gets memory-mapped
+    and uploaded in chunks straight from the page cache, so there
+    never is a full host copy of the data; meant for large scalar
+    fields and meshes that would otherwise have to get read into
+    memory only for barney to copy them again. Builds with BARNEY_GDS
+    read the file straight into device memory through GPUDirect
+    Storage instead, where driver and file system support that */
+BARNEY_API
+BNData bnDataCreateFromFile(BNContext context,
+                            int whichSlot,
+                            BNDataType dataType,
+                            size_t numItems,
+                            const char *fileName,
+                            size_t offset);
+
+/*! for MPI data-parallel runs: same as bnDataCreateFromFile(), for
+    an array whose file ALL ranks of the context read (materials,
+    textures, replicated geometry). Has to get called on all ranks,
+    in the same order, with the same file, offset and size; the file
+    then gets read only by the first rank, and broadcast from there
+    to one copy in node-wide shared memory per node, so it crosses
+    the file system once per job rather than once per rank. Without
+    MPI this does the same as bnDataCreateFromFile(). Only plain data
+    types */
+BARNEY_API
+BNData bnDataCreateReplicated(BNContext context,
+                              int whichSlot,
+                              BNDataType dataType,
+                              size_t numItems,
+                              const char *fileName,
+                              size_t offset);
+
 BARNEY_API
 void bnDataSet(BNData data,
                size_t numItems,
                const void *items);
 
+/*! overwrites only items [offset,offset+numItems) of given data
+    array, and uploads only those; the array's size stays what the
+    last bnDataCreate() or bnDataSet() made it. Objects that use
+    this data still have to get re-committed to see the change, but
+    since the array stays where it is, geometries can refit rather
+    than rebuild */
+BARNEY_API
+void bnDataSetRange(BNData data,
+                    size_t offset,
+                    size_t numItems,
+                    const void *items);
+
 /*! creates a cudaArray2D of specified size and texels. Can be passed
   to a sampler to create a matching cudaTexture2D, or as a background
   image to a renderer */
@@ -444,6 +902,40 @@ BNTextureData bnTextureData3DCreate(BNContext context,
                                     BNDataType texelFormat,
                                     int width, int height, int depth,
                                     const void *items);
+/*! same as bnTextureData3DCreate, but the upload of the texels only
+  gets queued on a side stream, and overlaps with rendering until the
+  texture data first gets used (eg, when a "structured" field's
+  "textureData" gets set to it). Meant for pre-loading the next time
+  step of a time-varying volume while the current one renders; to
+  fully overlap, 'items' should be pinned host memory, and then has
+  to stay valid until that first use. Pageable items are safe to
+  free right after this returns */
+BARNEY_API
+BNTextureData bnTextureData3DCreateAsync(BNContext context,
+                                         int whichSlot,
+                                         BNDataType texelFormat,
+                                         int width, int height, int depth,
+                                         const void *items);
+/*! same as bnTextureData3DCreate, but with the texels read from
+    given (memory-mapped, or GPUDirect Storage) file, starting at byte
+    'offset' - see bnDataCreateFromFile() */
+BARNEY_API
+BNTextureData bnTextureData3DCreateFromFile(BNContext context,
+                                            int whichSlot,
+                                            BNDataType texelFormat,
+                                            int width, int height, int depth,
+                                            const char *fileName,
+                                            size_t offset);
+
+/*! same as bnTextureData3DCreateFromFile(), for texels that all
+    ranks read - see bnDataCreateReplicated() */
+BARNEY_API
+BNTextureData bnTextureData3DCreateReplicated(BNContext context,
+                                              int whichSlot,
+                                              BNDataType texelFormat,
+                                              int width, int height, int depth,
+                                              const char *fileName,
+                                              size_t offset);
 
 BARNEY_API
 BNLight bnLightCreate(BNContext context,
@@ -457,6 +949,12 @@ BNGroup bnGroupCreate(BNContext context,
                       BNVolume *volumes, int numVolumes);
 BARNEY_API
 void bnGroupBuild(BNGroup group);
+/*! same as calling bnGroupBuild() on each of the given groups (which
+    all have to belong to the same context), but cheaper for many
+    groups: geoms they share get built only once, and all groups'
+    accels get built in one go */
+BARNEY_API
+void bnGroupsBuild(BNGroup *groups, int numGroups);
 
 BARNEY_API
 BNTexture2D
@@ -501,7 +999,10 @@ BNGeom bnGeometryCreate(BNContext context,
 
 
 /*! create a new scalar field of given type. currently supported
-    types: "structured" */
+    types: "structured", "unstructured", "BlockStructuredAMR",
+    "NanoVDB", and "particles" (positions, values, and either
+    per-particle "radii" or a common "radius" of each particle's
+    smoothing kernel support) */
 BARNEY_API
 BNScalarField bnScalarFieldCreate(BNContext context,
                                   int whichSlot,
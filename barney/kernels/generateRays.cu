@@ -14,6 +14,7 @@
 #include "barney/Camera.h"
 #include "barney/render/Renderer.h"
 #include "barney/fb/FrameBuffer.h"
+#include "barney/common/DeviceCounters.h"
 #include "rtcore/ComputeInterface.h"
 
 namespace BARNEY_NS {
@@ -43,11 +44,22 @@ namespace BARNEY_NS {
 
     __rtc_global
     void _generateRays(const rtc::ComputeInterface &rt,
-                       Camera::DD camera,
+                       Camera::DD camera0,
+                       /*! multi-view frames only (else null): one
+                           camera per view, each view being
+                           viewHeight rows of the frame; camera0 is
+                           ignored then */
+                       const Camera::DD *viewCameras,
+                       int viewHeight,
                        Renderer::DD renderer,
-                       /*! a unique random number seed value for pixel
-                         and lens jitter; probably just accumID */
+                       /*! the (per-device) index of the sample
+                         these rays are for */
                        int accumID,
+                       /*! what pixel and lens jitter and random seeds
+                           go by; same as accumID, except with
+                           sample-parallel frame buffers (see
+                           FrameBuffer::rngSampleID()) */
+                       int rngSampleID,
                        /*! full frame buffer size, to check if a given
                          tile's pixel ID is still valid */
                        vec2i fbSize,
@@ -63,36 +75,95 @@ namespace BARNEY_NS {
                          frame buffer owns on this device; rays
                          should only get generated for these tiles */
                        TileDesc *tileDescs,
-                       bool enablePerRayDebug
+                       /*! index of the first tile (in tileDescs) that
+                         this launch generates rays for; blockIdx
+                         is relative to this */
+                       int firstTile,
+                       /*! if non-null, tiles that have converged
+                         (with adaptive sampling) don't get any new
+                         rays */
+                       const ConvergenceTile *convergence,
+                       /*! if non-null, a tile with sample period k
+                         only gets rays for every k'th sample
+                         (foveated rendering) */
+                       const int *samplePeriods,
+                       /*! if on, rngSampleID only picks one of
+                           primaryHits.numJitters jitter positions,
+                           and rays whose hit for that is in the
+                           cache don't get traced */
+                       PrimaryHitCache primaryHits,
+                       bool enablePerRayDebug,
+                       /*! DeviceCounters of this generation, if
+                           counting */
+                       uint64_t *counters
                        )
 #if !RTC_DEVICE_CODE
     ;
 #else
     {
       // ------------------------------------------------------------------
-      int tileID   = rt.getBlockIdx().x;
+      int tileID   = firstTile + rt.getBlockIdx().x;
       int lPixelID = rt.getThreadIdx().x;
+      if (convergence && convergence[tileID].converged)
+        return;
+      if (samplePeriods && (accumID % samplePeriods[tileID]) != 0)
+        return;
 
       vec2i tileOffset = tileDescs[tileID].lower;
       int ix = (lPixelID % tileSize) + tileOffset.x;
       int iy = (lPixelID / tileSize) + tileOffset.y;
+      /* everything that depends on the camera goes by the pixel's
+         view, not the whole frame */
+      const int view
+        = viewCameras ? min(iy,fbSize.y-1)/viewHeight : 0;
+      Camera::DD camera
+        = viewCameras ? viewCameras[view] : camera0;
+      vec2i viewSize
+        = viewCameras ? vec2i(fbSize.x,viewHeight) : fbSize;
+      vec2i viewPixel(ix,iy - view*viewHeight);
+      /* stereo: both eyes' rays go into the same queue, each eye
+         being a plain perspective camera for its half of the frame */
+      if (camera.type == Camera::STEREO)
+        camera = camera.eye(camera.stereoEye(viewPixel,viewSize));
 
       Ray ray;
       PathState state;
       state.misWeight = 0.f;
+      state.accumID   = accumID;
+      state.pathDepth = 0;
       state.pixelID = tileID * (tileSize*tileSize) + rt.getThreadIdx().x;
-      Random rand(unsigned(ix+fbSize.x*accumID),
-                  unsigned(iy+fbSize.y*accumID));
-      ray.rngSeed.seed(ix+accumID*fbSize.x,iy);
+      /* pixel and lens jitter go by the jitter position; everything
+         after the primary hit still by the sample */
+      const int jitterID
+        = primaryHits.numJitters
+        ? (rngSampleID % primaryHits.numJitters)
+        : rngSampleID;
+      Random rand(unsigned(ix+fbSize.x*jitterID),
+                  unsigned(iy+fbSize.y*jitterID));
+      ray.rngSeed.seed(ix+rngSampleID*fbSize.x,iy);
+      if (renderer.lowDiscrepancy)
+        /* dimensions 0,1 for pixel, 2,3 for lens jitter; bounces
+           take it from there (see shadeRays) */
+        rand.useSobol(jitterID,
+                      (uint32_t)hash(hash(renderer.scrambleSalt),
+                                     (uint32_t)state.pixelID),
+                      0,4);
 
-      float pixel_u = ((accumID == 0) ? .5f : rand());
-      float pixel_v = ((accumID == 0) ? .5f : rand());
-      float image_u = ((ix+pixel_u)/float(fbSize.x));
-      float image_v = ((iy+pixel_v)/float(fbSize.y));
-      float aspect = fbSize.x / float(fbSize.y);
+      float pixel_u = ((jitterID == 0) ? .5f : rand());
+      float pixel_v = ((jitterID == 0) ? .5f : rand());
+      float image_u = ((viewPixel.x+pixel_u)/float(viewSize.x));
+      float image_v = ((viewPixel.y+pixel_v)/float(viewSize.y));
+      float aspect = viewSize.x / float(viewSize.y);
+      /* ray cones start out as wide as a pixel; that ignores depth of
+         field, and the omni camera's distortion towards the poles */
+      ray.coneWidth  = 0.f;
+      ray.coneSpread = 0.f;
       if (camera.type == Camera::PERSPECTIVE) {
         auto &perspective = camera.perspective;
         ray.org  = perspective.lens_00;
+        ray.coneSpread
+          = length(perspective.dir_dv)
+          / (viewSize.y*length(perspective.dir_00));
         vec3f ray_dir
           = perspective.dir_00
           + (1.f*aspect*(image_u - .5f)) * perspective.dir_du
@@ -107,7 +178,7 @@ namespace BARNEY_NS {
           vec3f pointOnImagePlane
             = D * (perspective.focusDistance / fabsf(dot(D,lensNormal)));
           float lu, lv;
-          if (accumID == 0) {
+          if (jitterID == 0) {
             lu = lv = 0.f;
           } else {
             while (true) {
@@ -130,6 +201,7 @@ namespace BARNEY_NS {
       } else if (camera.type == Camera::ORTHOGRAPHIC) {
         auto &orthographic = camera.orthographic;
         ray.dir = normalize(orthographic.dir);
+        ray.coneWidth = orthographic.height/viewSize.y;
         ray.org
           = orthographic.org_00
           + ((image_u-.5f)*orthographic.aspect*orthographic.height)
@@ -142,6 +214,7 @@ namespace BARNEY_NS {
           = omni.toWorld.p;
         ray.dir =
           uvToWorld(omni.toWorld,image_u,image_v);
+        ray.coneSpread = ONE_PI/viewSize.y;
        }
       
       ray._dbg        = 0;
@@ -167,6 +240,8 @@ namespace BARNEY_NS {
       ray.clearHit();
       ray.isShadowRay = false;
       ray.isInMedium  = false;
+      ray.preTraced   = false;
+      ray.fromVolume  = false;
       ray.tMax        = 1e30f;
       // Apply cutting plane (disabled if w < -1e28f)
       if (renderer.cutPlane.w > -1e28f) {
@@ -211,7 +286,7 @@ namespace BARNEY_NS {
                (float)ray.dir.y,
                (float)ray.dir.z);
 
-      const float t = (iy+.5f)/float(fbSize.y);
+      const float t = (viewPixel.y+.5f)/float(viewSize.y);
       // for *primary* rays we pre-initialize basecolor to a background
       // color; this way the shaderays function doesn't have to reverse
       // engineer pixel pos etc
@@ -222,11 +297,13 @@ namespace BARNEY_NS {
         : ((1.0f - t)*vec4f(0.9f, 0.9f, 0.9f,1.f)
            + t *      vec4f(0.15f, 0.25f, .8f,1.f));
       if (renderer.bgTexture) {
-        float bg_u = ((ix + pixel_u+.5f) / float(fbSize.x-1.f));
-        float bg_v = ((iy + pixel_v+.5f) / float(fbSize.y-1.f));
+        float bg_u = ((viewPixel.x + pixel_u+.5f) / float(viewSize.x-1.f));
+        float bg_v = ((viewPixel.y + pixel_v+.5f) / float(viewSize.y-1.f));
         vec4f v = rtc::tex2D<vec4f>(renderer.bgTexture, bg_u, bg_v);
         bgColor = v;
       }
+      if (renderer.transparentBackground)
+        bgColor = vec4f(0.f);
       (vec4f&)ray.missColor = bgColor;
       if (1 && ray.dbg()) printf("== spawn ray has bg tex %p bg color %f %f %f %f\n",
                                (void*)renderer.bgTexture,
@@ -235,18 +312,42 @@ namespace BARNEY_NS {
                                bgColor.z,
                                bgColor.w);
       state.throughput = 1.f;
+      if (primaryHits.hits) {
+        int entry = state.pixelID*primaryHits.numJitters+jitterID;
+        if (primaryHits.valid[entry]) {
+          /* misses keep the background color set above */
+          const HitOnly &hit = primaryHits.hits[entry];
+          if (hit.bsdfType != PackedBSDF::NONE)
+            applyHit(ray,hit);
+          ray.preTraced = true;
+        }
+      }
       int pos = rt.atomicAdd(d_count,1);
+      DeviceCounters::count(counters,DeviceCounters::RAYS_GENERATED);
 
       rayQueue.rays[pos] = ray;
       rayQueue.states[pos] = state;
-      rayQueue.hitIDs[pos] = {BARNEY_INF,-1,-1,-1};
+      if (rayQueue.hitIDs)
+        rayQueue.hitIDs[pos] = {BARNEY_INF,-1,-1,-1};
     }
 #endif
   }
   
+  /*! generate camera rays for the range [begin,end) of the
+      'virtual' tile cursor we use for wave-front merging: virtual
+      tile v refers to tile (v % maxTilesOnAnyGPU) of sample (v /
+      maxTilesOnAnyGPU), so all devices can advance the same cursor
+      even if they own different numbers of tiles. Virtual tiles a
+      device doesn't have are simply skipped. If appendToReadQueue is
+      set the new rays get appended to the rays still active in the
+      read queue (ie, refilling a partially drained wave-front);
+      otherwise they go into a fresh write queue as before. */
   void Context::generateRays(Camera *camera,
                              Renderer *renderer,
-                             FrameBuffer *fb)
+                             FrameBuffer *fb,
+                             int begin,
+                             int end,
+                             bool appendToReadQueue)
   {
     auto getPerRayDebug = [&]()
     {
@@ -256,7 +357,7 @@ namespace BARNEY_NS {
     static bool enablePerRayDebug = getPerRayDebug();
     
     assert(fb);
-    int accumID=fb->accumID;
+    const int maxTiles = maxTilesOnAnyGPU(fb);
     // ------------------------------------------------------------------
     // launch all GPUs to do their stuff
     // ------------------------------------------------------------------
@@ -264,45 +365,82 @@ namespace BARNEY_NS {
     for (auto device : *devices) {
       SetActiveGPU forDuration(device);
       TiledFB *devFB = fb->getFor(device);
-      device->rayQueue->resetWriteQueue();
+      Renderer::DD rendererDD = renderer->getDD(device);
+      rendererDD.transparentBackground = activeSortLast;
+      fb->setSampleIndexing(device,
+                            rendererDD.sampleStride,
+                            rendererDD.sampleOffset,
+                            rendererDD.scrambleSalt);
+      rtc::Buffer *viewCamerasBuffer = fb->getPLD(device)->viewCameras;
+      const Camera::DD *viewCameras
+        = (viewCamerasBuffer && !fb->views.fbs.empty())
+        ? (const Camera::DD *)viewCamerasBuffer->getDD()
+        : nullptr;
+      RayQueue *rayQueue = device->rayQueue;
+      if (!appendToReadQueue)
+        rayQueue->resetWriteQueue();
+      SingleQueue &queue
+        = appendToReadQueue
+        ? rayQueue->traceAndShadeReadQueue
+        : rayQueue->receiveAndShadeWriteQueue;
 
       if (FromEnv::get()->logQueues) {
         std::stringstream ss;
         ss  << "#bn(" << myRank() << "): ## ray queue op GENERATE "
-            << device->rayQueue->receiveAndShadeWriteQueue.rays
-            << " + " << device->rayQueue->receiveAndShadeWriteQueue.states
+            << (appendToReadQueue ? "(append) " : "")
+            << queue.rays << " + " << queue.states
             << std::endl;
         std::cout << ss.str();
       }
 
-      __rtc_launch(//device
-                   device->rtc,
-                   //kernel
-                   render::_generateRays,
-                   // launch config
-                   devFB->numActiveTilesThisGPU,pixelsPerTile,
-                   // args
-                   cameraDD,
-                   renderer->getDD(device),
-                   accumID,
-                   fb->renderPixels,
-                   device->rayQueue->_d_nextWritePos,
-                   device->rayQueue->receiveAndShadeWriteQueue,
-                   devFB->tileDescs,
-                   enablePerRayDebug
-                   );
+      for (int v = begin; v < end; ) {
+        int sample    = v / maxTiles;
+        int tileBegin = v % maxTiles;
+        int tileEnd   = std::min(maxTiles,tileBegin+(end-v));
+        int numTiles
+          = std::min(tileEnd,devFB->numActiveTilesThisGPU) - tileBegin;
+        v += tileEnd - tileBegin;
+        if (numTiles <= 0) continue;
+        
+        __rtc_launch(//device
+                     device->rtc,
+                     //kernel
+                     render::_generateRays,
+                     // launch config
+                     numTiles,pixelsPerTile,
+                     // args
+                     cameraDD,
+                     viewCameras,
+                     fb->views.height,
+                     rendererDD,
+                     (int)fb->accumID+sample,
+                     fb->rngSampleID(device,(int)fb->accumID+sample),
+                     fb->renderPixels,
+                     rayQueue->_d_nextWritePos,
+                     queue,
+                     devFB->tileDescs,
+                     tileBegin,
+                     (renderer->adaptiveThreshold > 0.f)
+                     ? devFB->getConvergenceTiles()
+                     : nullptr,
+                     devFB->samplePeriods,
+                     activePrimaryHitCache
+                     ? devFB->getPrimaryHitCache(fb->primaryHitCache)
+                     : PrimaryHitCache(),
+                     enablePerRayDebug,
+                     device->countersFor(activeGeneration)
+                     );
+      }
+      rayQueue->updateNumActiveAsync(/*readBack*/true);
     }
     // ------------------------------------------------------------------
     // wait for all GPUs' completion
     // ------------------------------------------------------------------
     for (auto device : *devices) {
-      SetActiveGPU forDuration(device);
-      device->rtc->sync();
-      device->rayQueue->swapAfterGeneration();
-      device->rayQueue->numActive = device->rayQueue->readNumActive();
+      device->rayQueue->finishReadNumActive();
+      if (!appendToReadQueue)
+        device->rayQueue->swapAfterGeneration();
     }
   }
   
 }
-
-
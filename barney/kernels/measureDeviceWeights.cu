@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/Context.h"
+#include "barney/DeviceGroup.h"
+#include "rtcore/ComputeInterface.h"
+
+namespace BARNEY_NS {
+
+  enum { benchmarkIterations = 1024 };
+  
+  /*! a few independent fma chains per thread; ray tracing isn't
+      fma-bound, but this tracks sm count and clock, which is what
+      tells gpu generations apart */
+  __rtc_global void measureDeviceWeightsKernel(rtc::ComputeInterface ci,
+                                               float *sink)
+  {
+#if RTC_DEVICE_CODE
+    int tid = ci.getThreadIdx().x + ci.getBlockIdx().x*ci.getBlockDim().x;
+    float a = tid*1e-7f, b = a+.5f, c = a+.25f, d = a+.125f;
+    for (int i=0;i<benchmarkIterations;i++) {
+      a = a*.999f+.001f;
+      b = b*.999f+.001f;
+      c = c*.999f+.001f;
+      d = d*.999f+.001f;
+    }
+    // never true, but the compiler can't know that
+    if (a+b+c+d == -1.f) *sink = a;
+#endif
+  }
+  
+  void Context::measureDeviceWeights()
+  {
+#if !BARNEY_RTC_EMBREE
+    const int bs = 256;
+    const int nb = 16*1024;
+    std::vector<float> ms(devices->size());
+    for (int i=0;i<(int)devices->size();i++) {
+      Device *device = (*devices)[i];
+      SetActiveGPU forDuration(device);
+      auto rtc = device->rtc;
+      float *sink = (float *)rtc->allocMem(sizeof(float));
+      rtc::Event *begin = rtc->createEvent();
+      rtc::Event *end   = rtc->createEvent();
+      // warm-up, so clocks are up and the kernel is loaded
+      __rtc_launch(rtc,measureDeviceWeightsKernel,nb,bs,sink);
+      rtc->recordEvent(begin);
+      for (int rep=0;rep<4;rep++)
+        __rtc_launch(rtc,measureDeviceWeightsKernel,nb,bs,sink);
+      rtc->recordEvent(end);
+      ms[i] = std::max(rtc->elapsedTime(begin,end),1e-3f);
+      rtc->freeEvent(begin);
+      rtc->freeEvent(end);
+      rtc->freeMem(sink);
+    }
+    /* relative to the average local gpu, so weights stay comparable
+       to cpuWeight across ranks */
+    float avgThroughput = 0.f;
+    for (auto t : ms) avgThroughput += 1.f/t;
+    avgThroughput /= ms.size();
+    for (int i=0;i<(int)devices->size();i++) {
+      Device *device = (*devices)[i];
+      device->tileWeight = (1.f/ms[i])/avgThroughput;
+      if (FromEnv::get()->logConfig)
+        std::cout << "#bn: measured weight of gpu #" << i
+                  << " = " << device->tileWeight
+                  << " (" << ms[i] << "ms)" << std::endl;
+    }
+#endif
+  }
+
+}
@@ -28,12 +28,26 @@ namespace BARNEY_NS {
 
 #define CLAMP_F_R 13.f
 
+    /*! (runtime) model and renderer features a shade kernel gets
+        compiled for; a kernel without a feature's bit doesn't
+        contain (or allocate registers for) that feature's code, and
+        only gets used for frames that don't need it. See
+        shadeFeaturesFor() for which kernels get used when */
+    enum ShadeFeature {
+      /*! rayCastOnly preview and ambient occlusion modes */
+      SHADE_PREVIEW      = (1<<0),
+      /*! sampling quad, point and directional lights; without it,
+          only the environment (map or ambient) gets sampled */
+      SHADE_LOCAL_LIGHTS = (1<<1),
+      /*! ReSTIR direct lighting (see Renderer::restirDI) */
+      SHADE_RESTIR       = (1<<2),
+      SHADE_ALL          = (1<<3)-1
+    };
+
 
 #if RTC_DEVICE_CODE
     inline __rtc_device float square(float f) { return f*f; }
   
-    
-    enum { MAX_PATH_DEPTH = 10 };
 
     inline __rtc_device
     float safe_eps(float f, vec3f v)
@@ -43,6 +57,37 @@ namespace BARNEY_NS {
     }
 
     
+    /*! picks one quad light through the world's light bvh, in
+        proportion to its estimated contribution to P; for worlds
+        with many quad lights */
+    inline __rtc_device
+    bool sampleAreaLightBVH(Light::Sample &ls,
+                            const render::World::DD &world,
+                            const vec3f P,
+                            const vec3f N,
+                            Random &random,
+                            bool dbg)
+    {
+      float pmf;
+      int lID = world.quadLightBVH.sample(pmf,P,N,random);
+      if (lID < 0 || pmf <= 0.f) return false;
+      const QuadLight::DD &light = world.quadLights[lID];
+      float lu = random();
+      float lv = random();
+      vec3f LP = light.pointAt(lu,lv);
+      vec3f LD = LP-P;
+      ls.distance = length(LD);
+      if (ls.distance < 1e-3f) return false;
+      ls.direction = LD * (1.f/ls.distance);
+      float cosLight = -dot(light.normal,ls.direction);
+      if (cosLight <= 0.f) return false;
+      ls.radiance
+        = light.emission
+        * (light.area * cosLight / square(ls.distance));
+      ls.pdf = pmf;
+      return true;
+    }
+
     inline __rtc_device
     bool sampleAreaLights(Light::Sample &ls,
                           const render::World::DD &world,
@@ -52,6 +97,8 @@ namespace BARNEY_NS {
                           bool dbg)
     {
       if (world.numQuadLights == 0) return false;
+      if (world.quadLightBVH.numNodes)
+        return sampleAreaLightBVH(ls,world,P,N,random,dbg);
       static const int RESERVOIR_SIZE = 8;
       int   lID[RESERVOIR_SIZE];
       float u[RESERVOIR_SIZE];
@@ -73,7 +120,7 @@ namespace BARNEY_NS {
 //                  lID[i],world.numQuadLights,lightArea);
 // #endif
         vec3f LN = light.normal;
-        vec3f LP = light.corner + u[i]*light.edge0 + v[i]*light.edge1;
+        vec3f LP = light.pointAt(u[i],v[i]);
         vec3f lightDir = LP - P;
         float lightDist = length(lightDir);
         if (lightDist < 1e-3f) continue;
@@ -116,7 +163,7 @@ namespace BARNEY_NS {
       if (i == RESERVOIR_SIZE) return false;
     
       light = world.quadLights[lID[i]];
-      vec3f LP = light.corner + u[i]*light.edge0 + v[i]*light.edge1;
+      vec3f LP = light.pointAt(u[i],v[i]);
       vec3f LD = LP-P;
       ls.direction
         = normalize(LD);
@@ -191,6 +238,35 @@ namespace BARNEY_NS {
     }
 
 
+    /*! picks one point light through the world's light bvh, in
+        proportion to its estimated contribution to P; for worlds
+        with many point lights */
+    inline __rtc_device
+    bool samplePointLightBVH(Light::Sample &ls,
+                             const World::DD &world,
+                             const vec3f P,
+                             const vec3f N,
+                             Random &random,
+                             bool dbg)
+    {
+      float pmf;
+      int lID = world.pointLightBVH.sample(pmf,P,N,random);
+      if (lID < 0 || pmf <= 0.f) return false;
+      const PointLight::DD &light = world.pointLights[lID];
+      ls.direction = light.position-P;
+      float dist = length(ls.direction);
+      if (dist <= 0.f) return false;
+      ls.direction = ls.direction * (1.f/dist);
+      if (N != vec3f(0.f) && dot(ls.direction,N) <= 0.f) return false;
+      ls.distance = dist*.9999f;
+      /* same quadratic fall-off as below */
+      ls.radiance
+        = light.radianceTowards(P)
+        * (1.f/(dist*dist*pmf));
+      ls.pdf = BARNEY_INF;
+      return true;
+    }
+
     inline __rtc_device
     bool samplePointLights(Light::Sample &ls,
                          const World::DD &world,
@@ -200,6 +276,8 @@ namespace BARNEY_NS {
                          Random &random,
                          bool dbg)
     {
+      if (world.pointLightBVH.numNodes)
+        return samplePointLightBVH(ls,world,P,N,random,dbg);
       struct {
         // constant term
         const float c0 = 0.f;
@@ -292,6 +370,7 @@ namespace BARNEY_NS {
       return true;
     }
 
+    template<int features>
     inline __rtc_device
     bool sampleLights(Light::Sample &ls,
                       const World::DD &world,
@@ -336,21 +415,22 @@ namespace BARNEY_NS {
       float elsWeight = 0.f;
 #endif
 
-      Light::Sample als;
-      float alsWeight
-        = (sampleAreaLights(als,world,P,Ng,random,dbg)
-           ? (reduce_max(als.radiance)/als.pdf)
-           : 0.f);
-      Light::Sample dls;
-      float dlsWeight
-        = (sampleDirLights(dls,world,renderer,P,Ng,random,dbg)
-           ? (reduce_max(dls.radiance)/* /dls.pdf*/)
-           : 0.f);
-      Light::Sample pls;
-      float plsWeight
-        = (samplePointLights(pls,world,renderer,P,Ng,random,dbg)
-           ? (reduce_max(pls.radiance)/* /dls.pdf*/)
-           : 0.f);
+      Light::Sample als, dls, pls;
+      float alsWeight = 0.f, dlsWeight = 0.f, plsWeight = 0.f;
+      if (features & SHADE_LOCAL_LIGHTS) {
+        alsWeight
+          = (sampleAreaLights(als,world,P,Ng,random,dbg)
+             ? (reduce_max(als.radiance)/als.pdf)
+             : 0.f);
+        dlsWeight
+          = (sampleDirLights(dls,world,renderer,P,Ng,random,dbg)
+             ? (reduce_max(dls.radiance)/* /dls.pdf*/)
+             : 0.f);
+        plsWeight
+          = (samplePointLights(pls,world,renderer,P,Ng,random,dbg)
+             ? (reduce_max(pls.radiance)/* /dls.pdf*/)
+             : 0.f);
+      }
 
       if (dbg) printf("sampling lights dls %f els %f\n",
                       dlsWeight,elsWeight);
@@ -406,6 +486,291 @@ namespace BARNEY_NS {
 
 
 
+    // ==================================================================
+    // ReSTIR direct lighting: for primary hits, draw a few candidate
+    // light samples, pick one of them by resampled importance
+    // sampling, then merge that with the previous frame's reservoirs
+    // at (and around) where this point was in that frame, and store
+    // the result for the next frame to re-use. Only quad, point and
+    // dir lights go through reservoirs; with ReSTIR on, env-light
+    // gets picked up by the bounce rays alone. This is the biased
+    // (1/M-weighted) flavor: candidates from other pixels are only
+    // checked for having about the same surface, not for being
+    // visible from this one
+    // ==================================================================
+    enum { RESTIR_CANDIDATES = 8,
+           /*! number of neighboring pixels to re-use from, in
+               addition to the reprojected one */
+           RESTIR_SPATIAL    = 3,
+           RESTIR_RADIUS     = 8,
+           /*! how many candidates' worth of history a reservoir may
+               carry; keeps it from getting stuck on old samples */
+           RESTIR_MAX_M      = 20*RESTIR_CANDIDATES };
+
+    /*! draws one light sample, with its pdf in area measure (for
+        quad lights) or as a discrete probability (for point and dir
+        lights) */
+    inline __rtc_device
+    bool sampleLightVertex(LightVertex &y,
+                           float &pdf,
+                           const World::DD &world,
+                           const vec3f P,
+                           const vec3f N,
+                           Random &random)
+    {
+      int kinds[3];
+      int numKinds = 0;
+      if (world.numQuadLights)  kinds[numKinds++] = 0;
+      if (world.numPointLights) kinds[numKinds++] = 1;
+      if (world.numDirLights)   kinds[numKinds++] = 2;
+      if (numKinds == 0) return false;
+      int kind = kinds[min(int(random()*numKinds),numKinds-1)];
+      pdf = 1.f/numKinds;
+
+      if (kind == 0) {
+        int lID;
+        float pmf;
+        if (world.quadLightBVH.numNodes) {
+          lID = world.quadLightBVH.sample(pmf,P,N,random);
+          if (lID < 0) return false;
+        } else {
+          lID = min(int(random()*world.numQuadLights),world.numQuadLights-1);
+          pmf = 1.f/world.numQuadLights;
+        }
+        const QuadLight::DD &light = world.quadLights[lID];
+        if (!(light.area > 0.f)) return false;
+        float lu = random();
+        float lv = random();
+        y.P = light.pointAt(lu,lv);
+        y.N.set(light.normal);
+        y.emission   = light.emission;
+        y.isInfinite = 0;
+        pdf *= pmf/light.area;
+      } else if (kind == 1) {
+        int lID;
+        float pmf;
+        if (world.pointLightBVH.numNodes) {
+          lID = world.pointLightBVH.sample(pmf,P,N,random);
+          if (lID < 0) return false;
+        } else {
+          lID = min(int(random()*world.numPointLights),world.numPointLights-1);
+          pmf = 1.f/world.numPointLights;
+        }
+        const PointLight::DD &light = world.pointLights[lID];
+        y.P = light.position;
+        y.N.set(vec3f(0.f));
+        y.emission   = light.radianceTowards(P);
+        y.isInfinite = 0;
+        pdf *= pmf;
+      } else {
+        int lID = min(int(random()*world.numDirLights),world.numDirLights-1);
+        const DirLight::DD &light = world.dirLights[lID];
+        y.P = -light.direction;
+        y.N.set(vec3f(0.f));
+        y.emission   = light.color*light.radiance;
+        y.isInfinite = 1;
+        pdf *= 1.f/world.numDirLights;
+      }
+      return pdf > 0.f;
+    }
+
+    /*! (unshadowed) radiance arriving at P from given light vertex,
+        including the light-side geometry term; plus direction and
+        distance to it */
+    inline __rtc_device
+    vec3f evalLightVertex(const LightVertex &y,
+                          const vec3f P,
+                          vec3f &dir,
+                          float &dist)
+    {
+      if (y.isInfinite) {
+        dir  = y.P;
+        dist = BARNEY_INF;
+        return (vec3f)y.emission;
+      }
+      vec3f LD = y.P-P;
+      dist = length(LD);
+      if (dist < 1e-3f) return vec3f(0.f);
+      dir = LD * (1.f/dist);
+      vec3f LN = y.N.get();
+      /* quadratic fall-off, same as for the regular point light
+         sampling */
+      float cosLight = (LN == vec3f(0.f)) ? 1.f : -dot(LN,dir);
+      if (cosLight <= 0.f) return vec3f(0.f);
+      return (vec3f)y.emission * (cosLight/(dist*dist));
+    }
+
+    /*! the target function we resample for: luminance of the light
+        vertex' unshadowed contribution to this shading point */
+    template<int bsdfTypes>
+    inline __rtc_device
+    float restirTarget(const LightVertex &y,
+                       const PackedBSDF &bsdf,
+                       const DG &dg,
+                       const vec3f N,
+                       bool dbg)
+    {
+      vec3f dir;
+      float dist;
+      vec3f radiance = evalLightVertex(y,dg.P,dir,dist);
+      if (reduce_max(radiance) <= 0.f) return 0.f;
+      float cosSurface = dot(dir,N);
+      if (cosSurface <= 1e-3f) return 0.f;
+      EvalRes f_r = bsdf.eval<bsdfTypes>(dg,dir,dbg);
+      if (!f_r.valid()) return 0.f;
+      float pHat = luminance(f_r.value*radiance) * (ONE_OVER_PI*cosSurface);
+      return (isnan(pHat) || isinf(pHat)) ? 0.f : max(pHat,0.f);
+    }
+
+    struct ReservoirBuilder {
+      inline __rtc_device
+      void add(const LightVertex &c, float w, float cPHat, float cM,
+               Random &random)
+      {
+        M += cM;
+        if (!(w > 0.f)) return;
+        wSum += w;
+        if (random()*wSum < w) { y = c; pHat = cPHat; }
+      }
+      LightVertex y;
+      float pHat = 0.f;
+      float wSum = 0.f;
+      float M    = 0.f;
+    };
+
+    /*! finds the pixel P got seen through in the frame the previous
+        reservoirs got built for */
+    inline __rtc_device
+    bool reprojectToPrevFrame(vec2i &pixel,
+                              const vec3f P,
+                              int pixelID,
+                              const ReservoirTiles &restir)
+    {
+      const Camera::DD &camera = restir.prevCamera;
+      if (camera.type != Camera::PERSPECTIVE) {
+        /* just look at the same pixel, and leave it to
+           canReuse() to reject what isn't the same surface */
+        int tileID  = pixelID / pixelsPerTile;
+        int tileOfs = pixelID % pixelsPerTile;
+        pixel = restir.tileDescs[tileID].lower
+          + vec2i(tileOfs % tileSize,tileOfs / tileSize);
+        return true;
+      }
+      /* invert generateRays() */
+      return camera.project(P,restir.numPixels,pixel);
+    }
+
+    /*! whether a reservoir built for another shading point is close
+        enough - same surface orientation, and (about) the same plane
+        - to be re-used for this one */
+    inline __rtc_device
+    bool canReuse(const Reservoir &q,
+                  const vec3f P,
+                  const vec3f N,
+                  float camDist)
+    {
+      if (!(q.M > 0.f)) return false;
+      if (dot(q.N.get(),N) < .9f) return false;
+      if (fabsf(dot(N,q.P-P)) > .05f*camDist) return false;
+      return true;
+    }
+
+    template<int bsdfTypes>
+    inline __rtc_device
+    void reuseReservoir(ReservoirBuilder &rb,
+                        const Reservoir &q,
+                        const PackedBSDF &bsdf,
+                        const DG &dg,
+                        const vec3f N,
+                        float camDist,
+                        Random &random,
+                        bool dbg)
+    {
+      if (!canReuse(q,dg.P,N,camDist)) return;
+      float M = min(q.M,(float)RESTIR_MAX_M);
+      if (!(q.W > 0.f)) {
+        /* found nothing, but still counts */
+        rb.M += M;
+        return;
+      }
+      float pHat = restirTarget<bsdfTypes>(q.y,bsdf,dg,N,dbg);
+      rb.add(q.y,pHat*q.W*M,pHat,M,random);
+    }
+
+    template<int bsdfTypes>
+    inline __rtc_device
+    bool sampleLightsReSTIR(Light::Sample &ls,
+                            const ReservoirTiles &restir,
+                            const World::DD &world,
+                            const PackedBSDF &bsdf,
+                            const DG &dg,
+                            const vec3f N,
+                            const vec3f camPos,
+                            int pixelID,
+                            Random &random,
+                            bool dbg)
+    {
+      const float camDist = length(dg.P-camPos);
+      ReservoirBuilder rb;
+      for (int i=0;i<RESTIR_CANDIDATES;i++) {
+        LightVertex c;
+        float pdf;
+        if (!sampleLightVertex(c,pdf,world,dg.P,N,random)) {
+          rb.M += 1.f;
+          continue;
+        }
+        float pHat = restirTarget<bsdfTypes>(c,bsdf,dg,N,dbg);
+        rb.add(c,pHat/pdf,pHat,1.f,random);
+      }
+
+      vec2i prevPixel;
+      if (restir.havePrev &&
+          reprojectToPrevFrame(prevPixel,dg.P,pixelID,restir)) {
+        int frameTile
+          = prevPixel.x/tileSize
+          + (prevPixel.y/tileSize)*restir.numTiles.x;
+        int localTile = restir.localTileOf[frameTile];
+        if (localTile >= 0) {
+          /* the reprojected pixel itself (temporal), and a few
+             random ones around it, within the same tile (spatial) */
+          const ReservoirTile &tile = restir.prev[localTile];
+          vec2i lower = restir.tileDescs[localTile].lower;
+          vec2i upper = min(lower+vec2i(tileSize),restir.numPixels)-vec2i(1);
+          for (int i=0;i<=RESTIR_SPATIAL;i++) {
+            vec2i q = prevPixel;
+            if (i > 0) {
+              q.x += int((2.f*random()-1.f)*RESTIR_RADIUS);
+              q.y += int((2.f*random()-1.f)*RESTIR_RADIUS);
+              q = min(max(q,lower),upper);
+            }
+            vec2i ofs = q-lower;
+            reuseReservoir<bsdfTypes>(rb,tile.reservoir[ofs.x+ofs.y*tileSize],
+                           bsdf,dg,N,camDist,random,dbg);
+          }
+        }
+      }
+
+      float W
+        = (rb.pHat > 0.f && rb.M > 0.f)
+        ? rb.wSum/(rb.M*rb.pHat)
+        : 0.f;
+      Reservoir &out
+        = restir.curr[pixelID / pixelsPerTile].reservoir[pixelID % pixelsPerTile];
+      out.y = rb.y;
+      out.W = W;
+      out.M = min(rb.M,(float)RESTIR_MAX_M);
+      out.P = dg.P;
+      out.N.set(N);
+      if (!(W > 0.f)) return false;
+
+      ls.radiance = evalLightVertex(rb.y,dg.P,ls.direction,ls.distance) * W;
+      if (!isinf(ls.distance))
+        ls.distance *= .9999f;
+      /* W already is what a pdf would've been used for */
+      ls.pdf = BARNEY_INF;
+      return true;
+    }
+
     inline __rtc_device
     float schlick(float cosine,
                   float ref_idx)
@@ -464,6 +829,9 @@ namespace BARNEY_NS {
                               const Renderer::DD &renderer,
                               Ray &ray)
     {
+      if (renderer.transparentBackground)
+        // sort-last layer; background gets added after compositing
+        return vec3f(0.f);
       if (world.envMapLight.texture)
         return radianceFromEnv(world,renderer,ray);
       return
@@ -472,7 +840,12 @@ namespace BARNEY_NS {
         (const vec3f&)ray.missColor;
     }
 
-    /*! ugh - that should all go into material::AnariPhysical .... */
+    /*! ugh - that should all go into material::AnariPhysical .... 
+
+        'bsdfTypes' is the mask (see PackedBSDF::typeBit()) of bsdf
+        types that rays can have in the kernel this gets used in, and
+        'features' the ShadeFeature bits that kernel supports */
+    template<int bsdfTypes, int features>
     inline __rtc_device
     void bounce(int rayID,
                 const World::DD &world,
@@ -482,7 +855,8 @@ namespace BARNEY_NS {
                 PathState &state,
                 Ray &shadowRay,
                 PathState &shadowState,
-                int pathDepth)
+                int pathDepth,
+                const ReservoirTiles &restir)
     {
       
       const float EPS = 1e-4f;
@@ -517,6 +891,7 @@ namespace BARNEY_NS {
 # if USE_MIS
             (float)state.misWeight *
 #endif
+            shadowTransmittance(ray.hitBSDF) *
             (vec3f)state.throughput;
           if (dbg)
             printf("_shadow_ ray reaches light: tp %f %f %f misweight %f frag %f %f %f\n",
@@ -608,8 +983,20 @@ namespace BARNEY_NS {
       // ray and shadow ray (if applicable), with proper weights.
       // ==================================================================    
       Random random(ray.rngSeed,(const uint32_t&)ray.tMax);//rayID,ray.rngSeed);
+      if (renderer.lowDiscrepancy)
+        /* eight dimensions per bounce, for light selection, light
+           and BSDF samples; anything past those is pseudo-random */
+        random.useSobol(uint32_t(state.accumID*renderer.sampleStride
+                                 +renderer.sampleOffset),
+                        (uint32_t)hash(hash(renderer.scrambleSalt),
+                                       (uint32_t)state.pixelID),
+                        4+8*pathDepth,8);
       // Random random(ray.rngSeed.next((const uint32_t&)ray.tMax));//rayID,ray.rngSeed);
       const PackedBSDF bsdf = ray.getBSDF();
+      /* both secondary and shadow rays start out as wide as the
+         incoming cone was at the hit point; we don't track surface
+         curvature, so the spread just carries over */
+      const float coneWidthAtHit = ray.coneWidthAt(ray.tMax);
 
 #if BARNEY_USE_MULTI_SCATTERING
       if (isVolumeHit && bsdf.type == PackedBSDF::TYPE_Phase) {
@@ -628,6 +1015,15 @@ namespace BARNEY_NS {
       dg.Ns = Ng;
       dg.wo = -normalize((vec3f)ray.dir);
       dg.insideMedium = ray.isInMedium;
+#if BARNEY_USE_MULTI_SCATTERING
+      /*! volume guiding cell this scatter event is in, if any; then
+          scatter directions (and their pdfs) come from the mixture
+          of learned distribution and phase function */
+      const int guideCell
+        = (isVolumeHit && bsdf.type == PackedBSDF::TYPE_Phase)
+        ? world.volumeGuiding.cellOf(dg.P)
+        : -1;
+#endif
 
       // if the ray is a volume hit we want it offset it into the
       // direction the ray came from (otherwise we have a chance of
@@ -638,6 +1034,58 @@ namespace BARNEY_NS {
       vec3f frontFacingSurfaceOffset
         = (isVolumeHit?dg.wo:Ngff);
 
+      if ((features & SHADE_PREVIEW) && renderer.rayCastOnly) {
+        // ==================================================================
+        // preview renderer: light the hit with a headlight (ie, from
+        // where the ray came from), and be done with this path. bsdf
+        // eval already includes the cosine (and 1/pi for surfaces,
+        // 1/4pi for isotropic phase functions), so scale that back
+        // up to get albedo*cos. (purely specular) glass has nothing
+        // to evaluate, and just gets shaded as white
+        // ==================================================================
+        vec3f headlit
+          = bsdf.type == PackedBSDF::TYPE_Glass
+          ? vec3f(fabsf(dot(dg.wo,Ngff)))
+          : bsdf.eval<bsdfTypes>(dg,dg.wo,dbg).value
+          * (isVolumeHit ? FOUR_PI : ONE_PI);
+        fragment
+          = fragment
+          + incomingThroughput * headlit * renderer.ambientRadiance;
+        ray.tMax = -1.f;
+        return;
+      }
+
+      if ((features & SHADE_PREVIEW) && renderer.aoSamples > 0) {
+        // ==================================================================
+        // ambient occlusion: turn both the shadow ray and the ray
+        // itself into occlusion rays of the hit; each one that gets
+        // through adds its share of ambientRadiance, just like a
+        // shadow ray reaching a light would
+        // ==================================================================
+        const vec3f aoOrg = dg.P + offsetEpsilon*frontFacingSurfaceOffset;
+        const vec3f aoTP
+          = incomingThroughput * (renderer.ambientRadiance/renderer.aoSamples);
+        for (int i=0;i<renderer.aoSamples;i++) {
+          Ray       &aoRay   = i ? ray   : shadowRay;
+          PathState &aoState = i ? state : shadowState;
+          vec3f aoDir
+            = isVolumeHit
+            ? randomDirection(random)
+            : xfmVector(owl::common::frame(Ngff),
+                        cosineSampleHemisphere(vec2f(random(),random())));
+          aoRay.rngSeed    = ray.rngSeed;
+          aoRay.coneWidth  = coneWidthAtHit;
+          aoRay.coneSpread = ray.coneSpread;
+          aoRay._dbg       = ray._dbg;
+          makeShadowRay(aoRay,aoState,aoTP,aoOrg,aoDir,renderer.aoRadius);
+          aoState.pixelID   = state.pixelID;
+          aoState.misWeight = 1.f;
+        }
+        if (renderer.aoSamples < 2)
+          ray.tMax = -1.f;
+        return;
+      }
+
       // ==================================================================
       // FIRST, let us look at generating any shadow rays, if
       // applicable; this way we can later modify the incoming ray in
@@ -651,12 +1099,21 @@ namespace BARNEY_NS {
 #endif
       if (dbg)
         printf("sampling lights with N %f %f %f\n",Ngff.x,Ngff.y,Ngff.z);
-      if (sampleLights(ls,world,renderer,dg.P,Ngff,random,
+      const bool useReSTIR
+        = (features & SHADE_RESTIR)
+        && restir.curr && pathDepth == 0 && !isVolumeHit
+        && (world.numQuadLights+world.numPointLights+world.numDirLights) > 0;
+      const bool haveLightSample
+        = useReSTIR
+        ? sampleLightsReSTIR<bsdfTypes>(ls,restir,world,bsdf,dg,Ngff,ray.org,
+                             state.pixelID,random,dbg)
+        : sampleLights<features>(ls,world,renderer,dg.P,Ngff,random,
 #if USE_MIS
                        lightNeedsMIS,
                        lightIsDirLight,
 #endif
-                       dbg)) {
+                       dbg);
+      if (haveLightSample) {
         if (dbg)
           printf("sample light dir %f %f %f rad %f %f %f pdf %f spike %f\n",
                  ls.direction.x,
@@ -668,7 +1125,7 @@ namespace BARNEY_NS {
                  ls.pdf,
                  reduce_max(ls.radiance)/(isinf(ls.pdf)?1.f:ls.pdf));
         EvalRes f_r
-          = bsdf.eval(dg,ls.direction,dbg);
+          = bsdf.eval<bsdfTypes>(dg,ls.direction,dbg);
         if (dbg) printf("eval light res %f %f %f: %f\n",
                         f_r.value.x,
                         f_r.value.y,
@@ -719,12 +1176,15 @@ namespace BARNEY_NS {
              /* to light */ls.direction,
              /* length   */ls.distance * (1.f-2.f*offsetEpsilon));
           shadowRay.rngSeed = ray.rngSeed;// + 1; random();
+          shadowRay.coneWidth  = coneWidthAtHit;
+          shadowRay.coneSpread = ray.coneSpread;
           ray.rngSeed.next((const uint32_t&)ray.tMax);
           // Random rng(ray.rngSeed.next(hash(ti.getRTCInstanceIndex(),
           //                        ti.getGeometryIndex(),
           //                        ti.getPrimitiveIndex())));
 
           shadowRay._dbg = ray._dbg;
+          shadowRay.fromVolume = isVolumeHit;
           shadowState.pixelID = state.pixelID;
             
           shadowState.misWeight = 1.f;
@@ -733,7 +1193,13 @@ namespace BARNEY_NS {
             float pdf_lightRay_lightDir
               = world.envMapLight.pdf(ls.direction);
             float pdf_scatterRay_lightDir
-              = bsdf.pdf(dg,ls.direction);
+              = bsdf.pdf<bsdfTypes>(dg,ls.direction);
+#if BARNEY_USE_MULTI_SCATTERING
+            if (guideCell >= 0)
+              pdf_scatterRay_lightDir
+                = world.volumeGuiding.scatterPdf(bsdf.data.phase,dg,guideCell,
+                                                 ls.direction,dbg);
+#endif
             // compute MIS weight weight that shadow direction
             shadowState.misWeight
               = pdf_lightRay_lightDir
@@ -761,7 +1227,13 @@ namespace BARNEY_NS {
       ray.tMax = BARNEY_INF;
       
       ScatterResult scatterResult;
-      bsdf.scatter(scatterResult,dg,random,dbg);
+#if BARNEY_USE_MULTI_SCATTERING
+      if (guideCell >= 0)
+        world.volumeGuiding.scatter(scatterResult,bsdf.data.phase,dg,
+                                    guideCell,random,dbg);
+      else
+#endif
+      bsdf.scatter<bsdfTypes>(scatterResult,dg,random,dbg);
 #ifndef NDEBUG
       if (scatterResult.type == ScatterResult::INVALID)
         printf("broken BSDF, doesn't set scatter type!\n");
@@ -808,6 +1280,7 @@ namespace BARNEY_NS {
         state.numDiffuseBounces = state.numDiffuseBounces + 1;
       }
       ray.isSpecular = (scatterResult.type == ScatterResult::SPECULAR);
+      ray.fromVolume = isVolumeHit;
       
       if (dbg)
         printf("offsetting into sign %f, direction %f %f %f\n",
@@ -817,6 +1290,7 @@ namespace BARNEY_NS {
                frontFacingSurfaceOffset.z); 
       ray.org
         = dg.P + scatterResult.offsetDirection * offsetEpsilon*frontFacingSurfaceOffset;
+      ray.coneWidth = coneWidthAtHit;
       // #ifdef CLAMP_F_R
       //       scatterResult.f_r = min(scatterResult.f_r,vec3f(100.f));
       // #endif
@@ -848,6 +1322,26 @@ namespace BARNEY_NS {
 
       state.throughput
         = state.throughput * scatterFactor;
+
+      /* paths that can't contribute anything visible any more only
+         cost queue slots, tracing and shading; cull those outright,
+         and (past the configured depth) randomly terminate the rest
+         with a probability that goes by their throughput, boosting
+         survivors to keep the estimate unbiased */
+      const float maxThroughput = reduce_max((vec3f)state.throughput);
+      if (maxThroughput < renderer.throughputCutoff) {
+        ray.tMax = -1.f;
+        return;
+      }
+      if (renderer.russianRouletteDepth > 0 &&
+          pathDepth >= renderer.russianRouletteDepth) {
+        const float pContinue = min(maxThroughput,.95f);
+        if (random() >= pContinue) {
+          ray.tMax = -1.f;
+          return;
+        }
+        state.throughput = (vec3f)state.throughput * (1.f/pContinue);
+      }
       if (dbg && scatterResult.changedMedium)
         printf("path DID change medium\n");
       if (scatterResult.changedMedium)
@@ -865,7 +1359,11 @@ namespace BARNEY_NS {
       
 #if USE_MIS
       if (lightNeedsMIS && !isinf(scatterResult.pdf)) {
-        float pdf_scatterRay_scatterDir = bsdf.pdf(dg,ray.dir);
+        float pdf_scatterRay_scatterDir = bsdf.pdf<bsdfTypes>(dg,ray.dir);
+#if BARNEY_USE_MULTI_SCATTERING
+        if (guideCell >= 0)
+          pdf_scatterRay_scatterDir = scatterResult.pdf;
+#endif
         float pdf_lightRay_scatterDir   = world.envMapLight.pdf(ray.dir);
         
         state.misWeight
@@ -878,27 +1376,94 @@ namespace BARNEY_NS {
     }
 #endif // device code  
 
+    /*! shades all rays in the read queue; or, if sortBuckets is
+        non-null (ie, the queue got sorted for shading), only those
+        whose sort keys are in [firstKey,lastKey], which are then all
+        known to have one of the 'bsdfTypes' (see
+        PackedBSDF::typeBit()) - the compiler can then strip, and not
+        allocate registers for, all other types' code */
+    /*! the (large) descriptors every shade thread reads; these get
+        uploaded once per shade pass rather than passed by value into
+        every one of its launches */
+    struct ShadeParams {
+      World::DD    world;
+      Renderer::DD renderer;
+    };
+    
+    template<int bsdfTypes, int features>
     __rtc_global void _shadeRays(const rtc::ComputeInterface &rt,
-                                 World::DD world,
-                                 Renderer::DD renderer,
+                                 const ShadeParams *params,
                                  AccumTile *accumTiles,
                                  AuxTiles   auxTiles,
-                                 int accumID,
+                                 /*! if non-null (adaptive sampling),
+                                     odd samples' luminance also
+                                     gets accumulated in here */
+                                 ConvergenceTile *convergence,
+                                 /*! if non-null (tile balancing),
+                                     counts rays shaded per tile */
+                                 int *tileCosts,
+                                 /*! with half-precision accumulation,
+                                     what each new sample weighs in
+                                     each tile's running average */
+                                 const float *sampleWeights,
                                  SingleQueue readQueue,
                                  int numRays,
+                                 /*! if non-null, numRays is only an
+                                     upper bound, and the actual
+                                     count has to be read from here */
+                                 const int *d_numRays,
                                  SingleQueue writeQueue,
                                  int *d_nextWritePos,
-                                 int generation
+                                 /*! reservoirs for ReSTIR direct
+                                     lighting; curr is null if
+                                     that's off */
+                                 ReservoirTiles restir,
+                                 /*! if on, camera rays that did get
+                                     traced go into this */
+                                 PrimaryHitCache primaryHits,
+                                 /*! end offsets of the shade sort's
+                                     buckets, or null if unsorted */
+                                 const int *sortBuckets,
+                                 int firstKey,
+                                 int lastKey
                                  )
-#if !RTC_DEVICE_CODE
-    ;
-#else
     {
+#if RTC_DEVICE_CODE
+      const World::DD    &world    = params->world;
+      const Renderer::DD &renderer = params->renderer;
       int tid = rt.getThreadIdx().x + rt.getBlockIdx().x*rt.getBlockDim().x;
+      if (d_numRays) numRays = *d_numRays;
+      if (sortBuckets) {
+        int begin = firstKey > 0 ? sortBuckets[firstKey-1] : 0;
+        tid += begin;
+        numRays = sortBuckets[lastKey];
+      }
       if (tid >= numRays) return;
+      DeviceCounters::count(world.counters,DeviceCounters::RAYS_SHADED);
 
       Ray ray = readQueue.rays[tid];
       PathState state = readQueue.states[tid];
+      /* with wave-front merging rays of different samples (and thus,
+         accumIDs) and different depths can be in the same queue, so
+         take those from the path, not from the launch */
+      const int accumID    = state.accumID;
+      const int generation = state.pathDepth;
+      if (primaryHits.hits && generation == 0 && !ray.preTraced) {
+        /* same jitter position as generateRays() picked for it */
+        const int jitterID
+          = (accumID*renderer.sampleStride+renderer.sampleOffset)
+          % primaryHits.numJitters;
+        const int entry = state.pixelID*primaryHits.numJitters+jitterID;
+        HitOnly &hit = primaryHits.hits[entry];
+        hit.tHit     = ray.tMax;
+        hit.P        = ray.P;
+        hit.N        = ray.N;
+        hit.bsdfType = ray.bsdfType;
+        hit.hitBSDF  = ray.hitBSDF;
+        primaryHits.valid[entry] = 1;
+      }
+      /* whatever this ray turns into does need tracing */
+      ray.preTraced = false;
 #ifdef NDEBUG
       enum { dbg = false };
 #else
@@ -934,16 +1499,35 @@ namespace BARNEY_NS {
       Ray shadowRay;
       PathState shadowState;
       shadowRay.tMax = -1.f;
+#if BARNEY_USE_MULTI_SCATTERING
+      /* what this ray delivers is what the volume scatter event it
+         came from received from its direction */
+      const bool  trainGuiding = ray.fromVolume;
+      const vec3f trainOrg     = ray.org;
+      const vec3f trainDir     = ray.dir;
+#endif
       
       // bounce that ray on the scene, possibly generating a) a fragment
       // to add to frame buffer; b) a outgoing ray (in-place
       // modification of 'path'); and/or c) a shadow ray
-      bounce(tid,
+      bounce<bsdfTypes,features>(tid,
              world,renderer,
              fragment,
              ray,state,
              shadowRay,shadowState,
-             generation);
+             generation,
+             restir);
+      state.pathDepth = generation+1;
+      shadowState.accumID   = accumID;
+      shadowState.pathDepth = generation+1;
+#if BARNEY_USE_MULTI_SCATTERING
+      if (trainGuiding) {
+        const float value = luminance(fragment);
+        float *bin = world.volumeGuiding.trainingBin(trainOrg,trainDir);
+        if (bin && value > 0.f && !isinf(value))
+          rt.atomicAdd(bin,value);
+      }
+#endif
 
 #ifndef NDEBUG
       if (ray.crosshair && !dbg) {
@@ -970,11 +1554,15 @@ namespace BARNEY_NS {
       // and write the shade fragment, if generated
       int tileID  = int(state.pixelID / pixelsPerTile);
       int tileOfs = int(state.pixelID % pixelsPerTile);
-      vec4f &valueToAccumInto
+      if (tileCosts)
+        rt.atomicAdd(&tileCosts[tileID],1);
+      if (auxTiles.cost)
+        rt.atomicAdd((int*)&auxTiles.cost[tileID].ui[tileOfs],1);
+      AccumValue &valueToAccumInto
         = accumTiles[tileID].accum[tileOfs];
 
 #if DENOISE
-      vec3f &valueToAccumNormalInto
+      OctNormal &valueToAccumNormalInto
         = accumTiles[tileID].normal[tileOfs];
 #endif
       
@@ -994,14 +1582,21 @@ namespace BARNEY_NS {
       // clamping ...
       float clampMax = 10.f*(1+accumID);
       fragment = min(fragment,vec3f(clampMax));
+#if BARNEY_HALF_ACCUM
+      // tiles hold running averages, so every sample only adds its
+      // share of those (see TiledFB::beginAccumulation())
+      const float sampleWeight = sampleWeights[tileID];
+#else
+      const float sampleWeight = 1.f;
+#endif
       
       if (accumID == 0 && generation == 0) {
         // first gen of first frame HAS to plain-write a value so later frames can
         valueToAccumInto = vec4f(fragment.x,fragment.y,
-                                 fragment.z,alpha);
+                                 fragment.z,alpha) * sampleWeight;
       
         // write aux buffers (depth, normal, hitIDs
-        accumTiles[tileID].normal[tileOfs] = incomingN;
+        accumTiles[tileID].normal[tileOfs].set(incomingN);
         if (auxTiles.depth) 
           auxTiles.depth[tileID] . f[tileOfs] = incomingZ;
         if (auxTiles.primID)
@@ -1012,47 +1607,88 @@ namespace BARNEY_NS {
           auxTiles.instID[tileID].ui[tileOfs] = readQueue.hitIDs[tid].instID;
         
       } else {
-#if 1
         if (generation == 0) {
-          if (alpha > 0.f) {
-            rt.atomicAdd(&valueToAccumInto.w,alpha);
-          }
           if (auxTiles.depth && incomingZ < auxTiles.depth[tileID] . f[tileOfs]) {
             auxTiles.depth[tileID] . f[tileOfs] = incomingZ;
           }
         }
+        // we're either an accumulated frame, or a non-primary bounce
+        // of the first frame; either way we'll accumulate color (and,
+        // for primaries, alpha) and ignore anything else.
+        vec3f addColor = max(fragment,vec3f(0.f)) * sampleWeight;
+        float addAlpha
+          = (generation == 0 && alpha > 0.f) ? alpha * sampleWeight : 0.f;
+#if BARNEY_HALF_ACCUM
+        if (addColor.x > 0.f || addColor.y > 0.f)
+          rt.atomicAddHalf2(&valueToAccumInto.rg,addColor.x,addColor.y);
+        if (addColor.z > 0.f || addAlpha > 0.f)
+          rt.atomicAddHalf2(&valueToAccumInto.ba,addColor.z,addAlpha);
 #else
-        if (generation == 0 && alpha > 0.f) 
-          rt.atomicAdd(&valueToAccumInto.w,alpha);
+        if (addAlpha > 0.f)
+          rt.atomicAdd(&valueToAccumInto.w,addAlpha);
+        if (addColor.x > 0.f)
+          rt.atomicAdd(&valueToAccumInto.x,addColor.x);
+        if (addColor.y > 0.f)
+          rt.atomicAdd(&valueToAccumInto.y,addColor.y);
+        if (addColor.z > 0.f)
+          rt.atomicAdd(&valueToAccumInto.z,addColor.z);
 #endif
-        // we're either an accumulated frame, or a non-primary bounce
-        // of the first frame; either way we'll accumulate color and
-        // ignore anything else.
-
-        if (fragment.x > 0.f)
-          rt.atomicAdd(&valueToAccumInto.x,fragment.x);
-        if (fragment.y > 0.f)
-          rt.atomicAdd(&valueToAccumInto.y,fragment.y);
-        if (fragment.z > 0.f)
-          rt.atomicAdd(&valueToAccumInto.z,fragment.z);
       }
-    }
+      if (convergence && (accumID & 1)) {
+        float lum = luminance(fragment);
+        if (lum > 0.f)
+          rt.atomicAdd(&convergence[tileID].oddLuminance[tileOfs],lum);
+      }
 #endif
+    }
   }  
   
   using namespace render;
+
+  /*! which of the specialized shade kernels (see ShadeFeature) given
+      world and renderer need; always SHADE_ALL in builds without
+      BARNEY_SPECIALIZE_SHADE_KERNELS */
+  static int shadeFeaturesFor(const World::DD &world,
+                              const Renderer::DD &renderer,
+                              const ReservoirTiles &restir)
+  {
+#if BARNEY_SPECIALIZE_SHADE_KERNELS
+    /* those modes return before any light sampling (and never have
+       ReSTIR enabled, see Renderer::commit()) */
+    if (renderer.rayCastOnly || renderer.aoSamples > 0)
+      return SHADE_PREVIEW;
+    const bool localLights
+      = (world.numQuadLights+world.numPointLights+world.numDirLights) > 0;
+    /* ReSTIR only ever re-uses samples of local lights */
+    if (!localLights)
+      return 0;
+    return SHADE_LOCAL_LIGHTS | (restir.curr ? SHADE_RESTIR : 0);
+#else
+    return SHADE_ALL;
+#endif
+  }
   
+  void Context::allocShadeParams(Device *device)
+  {
+    if (device->shadeParams) return;
+    MemoryScope memScope(device,BN_MEMORY_RAY_QUEUES);
+    device->shadeParams
+      = device->rtc->createBuffer(sizeof(ShadeParams));
+  }
+
   void Context::shadeRaysLocally(Renderer *renderer,
                                  GlobalModel *model,
                                  FrameBuffer *fb,
                                  int generation,
-                                 uint32_t rngSeed)
+                                 uint32_t rngSeed,
+                                 bool readBackNumActive)
   {
     int slotIdx = 0;
     for (auto slotModel : model->modelSlots) {
       World *world = slotModel->world.get();
       for (auto device : *world->devices) {
         SetActiveGPU forDuration(device);
+        NvtxRange nvtx("shadeRaysLocally",device->globalRank(),generation);
         RayQueue *rayQueue = device->rayQueue;
         device->rayQueue->resetWriteQueue();
         
@@ -1061,10 +1697,26 @@ namespace BARNEY_NS {
         if (numRays == 0) continue;
         int bs = 128;
         int nb = divRoundUp(numRays,bs);
-        World::DD devWorld
-          = world->getDD(device);
-        Renderer::DD devRenderer
-          = renderer->getDD(device);
+        ShadeParams params;
+        params.world = world->getDD(device);
+        params.world.counters = device->countersFor(generation);
+        params.renderer = renderer->getDD(device);
+        params.renderer.transparentBackground = activeSortLast;
+        fb->setSampleIndexing(device,
+                              params.renderer.sampleStride,
+                              params.renderer.sampleOffset,
+                              params.renderer.scrambleSalt);
+        allocShadeParams(device);
+        /* stream ordered, so all of the previous pass's launches have
+           read the old values by the time this lands; a captured copy
+           reads its source whenever the graph gets launched, long
+           after params went out of scope */
+        const void *paramsSrc
+          = device->rtc->isCapturing()
+          ? device->rtc->keepForCapture(&params,sizeof(params))
+          : &params;
+        device->rtc->copyAsync(device->shadeParams->getDD(),paramsSrc,
+                               sizeof(params));
         if (FromEnv::get()->logQueues) {
           std::stringstream ss;
           ss << "#bn" << myRank() << ": ## ray queue kernel SHADE " << std::endl
@@ -1075,35 +1727,134 @@ namespace BARNEY_NS {
           std::cout << ss.str();
         }
         
-        __rtc_launch(//device
-                     device->rtc,
-                     //kernel
-                     _shadeRays,
-                     //config
-                     nb,bs,
-                     //args
-                     devWorld,devRenderer,
-                     devFB->accumTiles,
-                     devFB->auxTiles,
-                     (int)fb->accumID,
-                     rayQueue->traceAndShadeReadQueue,
-                     numRays,
-                     rayQueue->receiveAndShadeWriteQueue,
-                     rayQueue->_d_nextWritePos,
-                     generation
-                     );
+        /* reservoirs are per pixel, so only work if there's a single
+           slot shading those */
+        ReservoirTiles restir
+          = (renderer->restirDI && model->modelSlots.size() == 1)
+          ? devFB->getReservoirTiles()
+          : ReservoirTiles();
+        const int *sortBuckets
+          = rayQueue->sortedForShade
+          ? rayQueue->getSortBuckets()
+          : nullptr;
+        const int features
+          = shadeFeaturesFor(params.world,params.renderer,restir);
+        auto launchKernel
+          = [&](auto bsdfTypes, auto featureBits, int firstKey, int lastKey)
+        {
+          __rtc_launch(//device
+                       device->rtc,
+                       //kernel
+                       (_shadeRays<decltype(bsdfTypes)::value,
+                                   decltype(featureBits)::value>),
+                       //config
+                       nb,bs,
+                       //args
+                       (const ShadeParams *)
+                       device->shadeParams->getDD(),
+                       devFB->accumTiles,
+                       fb->getActiveAuxTiles(device),
+                       (renderer->adaptiveThreshold > 0.f)
+                       ? devFB->getConvergenceTiles()
+                       : nullptr,
+                       fb->balanceTiles
+                       ? devFB->getTileCosts()
+                       : nullptr,
+                       devFB->sampleWeights,
+                       rayQueue->traceAndShadeReadQueue,
+                       numRays,
+                       rayQueue->d_numActiveIfNotExact(),
+                       rayQueue->receiveAndShadeWriteQueue,
+                       rayQueue->_d_nextWritePos,
+                       restir,
+                       activePrimaryHitCache
+                       ? devFB->getPrimaryHitCache(fb->primaryHitCache)
+                       : PrimaryHitCache(),
+                       sortBuckets,firstKey,lastKey);
+        };
+        auto launch = [&](auto bsdfTypes, int firstKey, int lastKey)
+        {
+          switch (features) {
+#if BARNEY_SPECIALIZE_SHADE_KERNELS
+          case SHADE_PREVIEW:
+            launchKernel(bsdfTypes,
+                         std::integral_constant<int,SHADE_PREVIEW>(),
+                         firstKey,lastKey);
+            break;
+          case 0:
+            launchKernel(bsdfTypes,
+                         std::integral_constant<int,0>(),
+                         firstKey,lastKey);
+            break;
+          case SHADE_LOCAL_LIGHTS:
+            launchKernel(bsdfTypes,
+                         std::integral_constant<int,SHADE_LOCAL_LIGHTS>(),
+                         firstKey,lastKey);
+            break;
+          default:
+            launchKernel(bsdfTypes,
+                         std::integral_constant<int,SHADE_LOCAL_LIGHTS
+                         |SHADE_RESTIR>(),
+                         firstKey,lastKey);
+#else
+          default:
+            launchKernel(bsdfTypes,
+                         std::integral_constant<int,SHADE_ALL>(),
+                         firstKey,lastKey);
+#endif
+          }
+        };
+        if (!sortBuckets) {
+          launch(std::integral_constant<int,PackedBSDF::ALL_TYPES>(),0,0);
+          continue;
+        }
+        /* rays are sorted by bsdf type, so each type's range gets its
+           own kernel that only contains that type's code. The ranges
+           are only known on the device, so every launch covers all
+           rays, and threads outside their kernel's range exit right
+           away */
+        auto launchFor = [&](auto bsdfType)
+        {
+          constexpr PackedBSDF::Type type = decltype(bsdfType)::value;
+          launch(std::integral_constant<int,PackedBSDF::typeBit(type)>(),
+                 RayQueue::shadeKeyOf(type),RayQueue::shadeKeyOf(type));
+        };
+        launch(std::integral_constant<int,0>(),
+               RayQueue::SHADE_KEY_SHADOW,RayQueue::SHADE_KEY_FIRST_BSDF);
+        launchFor(std::integral_constant<PackedBSDF::Type,PackedBSDF::TYPE_Phase>());
+        launchFor(std::integral_constant<PackedBSDF::Type,PackedBSDF::TYPE_Glass>());
+        launchFor(std::integral_constant<PackedBSDF::Type,PackedBSDF::TYPE_Lambertian>());
+        launchFor(std::integral_constant<PackedBSDF::Type,PackedBSDF::TYPE_NVisii>());
+        /* whatever else there may be */
+        launch(std::integral_constant<int,PackedBSDF::ALL_TYPES>(),
+               RayQueue::shadeKeyOf(PackedBSDF::TYPE_NVisii)+1,
+               RayQueue::numSortBuckets-1);
       }
       slotIdx++;
     }
 
     // ------------------------------------------------------------------
-    // wait for kernel to complete, and swap queues
+    // enqueue the new ray counts (behind the kernels), then, unless
+    // we're told to skip this, wait for kernel to complete and read
+    // those counts back. this way there's only one sync per device,
+    // and all devices' syncs overlap
     // ------------------------------------------------------------------
+    for (auto device : *devices)
+      device->rayQueue->updateNumActiveAsync(readBackNumActive);
+    
     for (auto device : *devices) {
-      SetActiveGPU forDuration(device);
-      device->rtc->sync();
-      device->rayQueue->swapAfterShade();
-      device->rayQueue->numActive = device->rayQueue->readNumActive();
+      RayQueue *rayQueue = device->rayQueue;
+      rayQueue->sortedForShade = false;
+      rayQueue->swapAfterShade();
+      if (readBackNumActive)
+        rayQueue->finishReadNumActive();
+      else {
+        /* every ray can spawn at most a bounce and a shadow ray;
+           that's all we know without asking the device */
+        rayQueue->numActive
+          = std::min(rayQueue->size,2*rayQueue->numActive);
+        rayQueue->numActiveIsExact = false;
+      }
     }
   }
   
@@ -0,0 +1,168 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/Context.h"
+#include "barney/DeviceGroup.h"
+#include "barney/render/Ray.h"
+#include "barney/render/RayQueue.h"
+#include "rtcore/ComputeInterface.h"
+
+namespace BARNEY_NS {
+  namespace render {
+
+#if RTC_DEVICE_CODE
+    /*! sort key for shading: shadow rays and misses first (those are
+        cheap and uniform), then all rays that hit something, grouped
+        by the type of bsdf they hit */
+    inline __rtc_device
+    int shadeSortKey(const Ray &ray)
+    {
+      if (ray.isShadowRay) return RayQueue::SHADE_KEY_SHADOW;
+      if (!ray.hadHit())   return RayQueue::SHADE_KEY_MISS;
+      return RayQueue::shadeKeyOf(ray.bsdfType);
+    }
+
+    /*! sort key for tracing: quantize the ray direction into one of
+        16x16 cells of an octahedral map, so rays going into similar
+        directions end up next to each other in the queue */
+    inline __rtc_device
+    int traceSortKey(const Ray &ray)
+    {
+      vec3f d = ray.dir;
+      d *= 1.f/(fabsf(d.x)+fabsf(d.y)+fabsf(d.z)+1e-20f);
+      vec2f uv(d.x,d.y);
+      if (d.z < 0.f)
+        uv = vec2f((1.f-fabsf(d.y))*(d.x >= 0.f ? 1.f : -1.f),
+                   (1.f-fabsf(d.x))*(d.y >= 0.f ? 1.f : -1.f));
+      int ix = min(15,max(0,int((uv.x*.5f+.5f)*16.f)));
+      int iy = min(15,max(0,int((uv.y*.5f+.5f)*16.f)));
+      return ix+16*iy;
+    }
+
+    inline __rtc_device
+    int sortKey(const Ray &ray, int sortFor)
+    {
+      return (sortFor == RayQueue::SORT_FOR_SHADE)
+        ? shadeSortKey(ray)
+        : traceSortKey(ray);
+    }
+#endif
+
+    __rtc_global
+    void _countSortKeys(const rtc::ComputeInterface &rt,
+                        SingleQueue queue,
+                        int numRays,
+                        const int *d_numRays,
+                        int sortFor,
+                        int *bucketCounts)
+#if !RTC_DEVICE_CODE
+      ;
+#else
+    {
+      int tid = rt.getThreadIdx().x + rt.getBlockIdx().x*rt.getBlockDim().x;
+      if (d_numRays) numRays = *d_numRays;
+      if (tid >= numRays) return;
+      rt.atomicAdd(&bucketCounts[sortKey(queue.rays[tid],sortFor)],1);
+    }
+#endif
+
+    /*! turns bucket counts into bucket begin offsets. there's only
+        ever a few hundred buckets, so a single thread is good
+        enough */
+    __rtc_global
+    void _scanSortKeys(const rtc::ComputeInterface &rt,
+                       int *bucketCounts)
+#if !RTC_DEVICE_CODE
+      ;
+#else
+    {
+      if (rt.getThreadIdx().x != 0 || rt.getBlockIdx().x != 0) return;
+      int sum = 0;
+      for (int i=0;i<RayQueue::numSortBuckets;i++) {
+        int count = bucketCounts[i];
+        bucketCounts[i] = sum;
+        sum += count;
+      }
+    }
+#endif
+
+    __rtc_global
+    void _scatterSortedRays(const rtc::ComputeInterface &rt,
+                            SingleQueue in,
+                            SingleQueue out,
+                            int numRays,
+                            const int *d_numRays,
+                            int sortFor,
+                            bool withHitIDs,
+                            int *bucketOffsets)
+#if !RTC_DEVICE_CODE
+      ;
+#else
+    {
+      int tid = rt.getThreadIdx().x + rt.getBlockIdx().x*rt.getBlockDim().x;
+      if (d_numRays) numRays = *d_numRays;
+      if (tid >= numRays) return;
+      Ray ray = in.rays[tid];
+      int pos = rt.atomicAdd(&bucketOffsets[sortKey(ray,sortFor)],1);
+      out.rays[pos]   = ray;
+      out.states[pos] = in.states[tid];
+      if (withHitIDs)
+        out.hitIDs[pos] = in.hitIDs[tid];
+    }
+#endif
+  }
+
+  /*! re-orders the rays in every local device's read queue by the
+      given key (a single-digit counting sort), to reduce divergence
+      in the following shade or trace kernel. Rays, their path states
+      and (if requested) hit IDs get moved together; the order of rays
+      that share the same key is arbitrary. */
+  void Context::sortRaysLocally(int sortFor, bool withHitIDs)
+  {
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      RayQueue *rayQueue = device->rayQueue;
+      int numRays = rayQueue->numActive;
+      if (numRays == 0) continue;
+
+      if (FromEnv::get()->logQueues)
+        printf("#bn(%i): ## ray queue kernel SORT (%s)\n",
+               device->globalRank(),
+               sortFor == RayQueue::SORT_FOR_SHADE ? "shade" : "trace");
+
+      int *buckets = rayQueue->getSortBuckets();
+      int bs = 128;
+      int nb = divRoundUp(numRays,bs);
+      device->rtc->memsetAsync(buckets,0,
+                               RayQueue::numSortBuckets*sizeof(int));
+      __rtc_launch(device->rtc,
+                   render::_countSortKeys,
+                   nb,bs,
+                   rayQueue->traceAndShadeReadQueue,
+                   numRays,rayQueue->d_numActiveIfNotExact(),
+                   sortFor,buckets);
+      __rtc_launch(device->rtc,
+                   render::_scanSortKeys,
+                   1,1,
+                   buckets);
+      __rtc_launch(device->rtc,
+                   render::_scatterSortedRays,
+                   nb,bs,
+                   rayQueue->traceAndShadeReadQueue,
+                   rayQueue->receiveAndShadeWriteQueue,
+                   numRays,rayQueue->d_numActiveIfNotExact(),
+                   sortFor,withHitIDs,buckets);
+    }
+    /* no need to sync here: the swap only changes which queue the
+       next kernels get pointed to, and those are ordered behind the
+       scatter on the same stream */
+    for (auto device : *devices) {
+      RayQueue *rayQueue = device->rayQueue;
+      if (rayQueue->numActive == 0) continue;
+      rayQueue->swapAfterSort();
+      rayQueue->sortedForShade = (sortFor == RayQueue::SORT_FOR_SHADE);
+    }
+  }
+
+}
@@ -9,15 +9,19 @@
 #include "barney/render/SamplerRegistry.h"
 #include "barney/render/MaterialRegistry.h"
 #include "barney/render/RayQueue.h"
+#include "barney/fb/FrameProfiler.h"
 #include "rtcore/ComputeInterface.h"
 
 namespace BARNEY_NS {
 
   void Context::traceRaysLocally(GlobalModel *globalModel,
                                  uint32_t rngSeed,
-                                 bool needHitIDs)
+                                 bool needHitIDs,
+                                 bool syncWhenDone)
   {
     double t0 = getCurrentTime();
+    FrameProfiler::Scope profile(activeProfiler,
+                                 FrameProfiler::TRACE,activeGeneration);
     
     // ------------------------------------------------------------------
     // launch all in parallel ...
@@ -27,6 +31,7 @@ namespace BARNEY_NS {
     for (auto model : globalModel->modelSlots) {
       for (auto device : *model->devices) {
         SetActiveGPU forDuration(device);
+        NvtxRange nvtx("traceRaysLocally",device->globalRank(),activeGeneration);
         auto ctx     = model->slotContext;
         dd.rays      = device->rayQueue->traceAndShadeReadQueue.rays;
         dd.hitIDs
@@ -34,9 +39,12 @@ namespace BARNEY_NS {
           ? device->rayQueue->traceAndShadeReadQueue.hitIDs
           : 0;
         dd.numRays   = device->rayQueue->numActive;
+        dd.d_numRays = device->rayQueue->d_numActiveIfNotExact();
         dd.world     = model->world->getDD(device);//,rngSeed);
+        dd.world.counters = device->countersFor(activeGeneration);
         dd.accel     = model->getInstanceAccel(device);
         dd.cutPlane  = activeCutPlane;
+        dd.pixelAngle = activePixelAngle;
 
         if (FromEnv::get()->logQueues) {
           std::stringstream ss;
@@ -69,9 +77,11 @@ namespace BARNEY_NS {
     // ------------------------------------------------------------------
     // ... and sync 'til all are done
     // ------------------------------------------------------------------
-    for (auto device : *devices) {
-      SetActiveGPU forDuration(device);
-      device->rtc->sync();
+    if (syncWhenDone) {
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        device->rtc->sync();
+      }
     }
     if (FromEnv::get()->logQueues) {
       std::stringstream ss;
@@ -16,15 +16,33 @@ namespace BARNEY_NS {
   namespace render {
 
     struct TraceRays {
+      /*! what the hit programs get as per-ray data */
+      typedef Ray PRD;
 #if RTC_DEVICE_CODE
       inline __rtc_device static 
       void run(rtc::TraceInterface &ti);
+      
+      /*! sets up the local ray to trace, and where to trace it;
+          false if this launch index has no ray */
+      inline __rtc_device static 
+      bool beginTrace(rtc::TraceInterface &ti,
+                      Ray &ray,
+                      rtc::TraceRequest &req);
+      /*! writes the result of tracing ray back to the queue;
+          occluded is what traceOcclusion() returned for shadow
+          rays */
+      inline __rtc_device static 
+      void endTrace(rtc::TraceInterface &ti,
+                    Ray &ray,
+                    bool occluded);
 #endif
     };
 
 #if RTC_DEVICE_CODE
     inline __rtc_device 
-    void TraceRays::run(rtc::TraceInterface &ti)
+    bool TraceRays::beginTrace(rtc::TraceInterface &ti,
+                               Ray &ray,
+                               rtc::TraceRequest &req)
     {
       const int rayID
         = ti.getLaunchIndex().x
@@ -33,27 +51,138 @@ namespace BARNEY_NS {
 
       auto &lp = OptixGlobals::get(ti);
 
-      if (rayID >= lp.numRays)
-        return;
+      const int numRays = lp.d_numRays ? *lp.d_numRays : lp.numRays;
+      if (rayID >= numRays)
+        return false;
       
-      Ray &ray = lp.rays[rayID];
+      const Ray &queued = lp.rays[rayID];
+      if (queued.preTraced)
+        return false;
+
+      /* trace a local copy of only the hot part of the ray, so the
+         hit programs work on registers rather than on (strided)
+         global memory, and we never load the hit payload. The
+         bsdfType gets cleared so we can tell if *this* trace found a
+         hit; a ray forwarded from another slot may already have one
+         that we must not overwrite. */
+      ray.org         = queued.org;
+      ray.dir         = queued.dir;
+      ray.tMax        = queued.tMax;
+      ray.coneWidth   = queued.coneWidth;
+      ray.coneSpread  = queued.coneSpread;
+      ray.rngSeed     = queued.rngSeed;
+      ray.bsdfType    = PackedBSDF::NONE;
+      ray.isInMedium  = queued.isInMedium;
+      ray.isSpecular  = queued.isSpecular;
+      ray.isShadowRay = queued.isShadowRay;
+      ray.crosshair   = queued.crosshair;
+      ray._dbg        = queued._dbg;
+      if (ray.isShadowRay)
+        shadowTransmittance(ray.hitBSDF) = shadowTransmittance(queued.hitBSDF);
       
       vec3f dir = ray.dir;
       if (dir.x == 0.f) dir.x = 1e-6f;
       if (dir.y == 0.f) dir.y = 1e-6f;
       if (dir.z == 0.f) dir.z = 1e-6f;
-      ti.traceRay(lp.accel,
-                  ray.org,
-                  dir,
-                  0.f,
-                  ray.tMax,
-                  /* PRD */
-                  (void *)&ray);
+
+      /* hits on the cut plane's invisible side get rejected anyway,
+         so clip the ray to the part on the visible side up front;
+         that way traversal skips whatever's cut away, too. Camera
+         rays already got clipped in generateRays, but bounces and
+         shadow rays didn't */
+      float tMin = 0.f;
+      float tMax = ray.tMax;
+      const vec4f &cp = lp.cutPlane;
+      if (cp.w > -1e28f) {
+        vec3f N = vec3f(cp.x,cp.y,cp.z);
+        float dist_org = dot(N,ray.org) + cp.w;
+        float denom    = dot(N,dir);
+        if (dist_org >= 0.f) {
+          if (denom < 0.f)
+            tMax = min(tMax,-dist_org/denom);
+        } else if (denom > 0.f)
+          tMin = -dist_org/denom;
+        else
+          tMax = 0.f;
+      }
+      req.world = lp.accel;
+      req.org   = ray.org;
+      req.dir   = dir;
+      req.tmin  = tMin;
+      req.tmax  = tMax;
+      /* shadow rays only care whether they're occluded, not by
+         what; so they stop at the first hit, and skip closest-hit
+         shading where the backend allows */
+      req.occlusionOnly = ray.isShadowRay;
+      DeviceCounters::count(lp.world.counters,DeviceCounters::RAYS_TRACED);
+      if (ray.isShadowRay)
+        DeviceCounters::count(lp.world.counters,DeviceCounters::SHADOW_RAYS);
+      return true;
+    }
+
+    inline __rtc_device 
+    void TraceRays::endTrace(rtc::TraceInterface &ti,
+                             Ray &ray,
+                             bool occluded)
+    {
+      const int rayID
+        = ti.getLaunchIndex().x
+        + ti.getLaunchDims().x
+        * ti.getLaunchIndex().y;
+      auto &lp = OptixGlobals::get(ti);
+      Ray &queued = lp.rays[rayID];
+
+      /* the hit that occluded the ray may not have been recorded by
+         its programs (their closest-hit didn't run); where exactly
+         it was doesn't matter, only that it's closer than the
+         light */
+      if (occluded && !ray.hadHit())
+        ray.setOccluded(0.f);
+      
+      queued.rngSeed = ray.rngSeed;
+      if (ray.hadHit()) {
+        queued.tMax     = ray.tMax;
+        queued.bsdfType = ray.bsdfType;
+        if (!ray.isShadowRay) {
+          queued.P       = ray.P;
+          queued.N       = ray.N;
+          queued.hitBSDF = ray.hitBSDF;
+        }
+      } else if (ray.isShadowRay)
+        shadowTransmittance(queued.hitBSDF) = shadowTransmittance(ray.hitBSDF);
+    }
+    
+    inline __rtc_device 
+    void TraceRays::run(rtc::TraceInterface &ti)
+    {
+      Ray ray;
+      rtc::TraceRequest req;
+      if (!beginTrace(ti,ray,req))
+        return;
+      bool occluded = false;
+      if (req.tmin < req.tmax) {
+        if (req.occlusionOnly)
+          occluded = ti.traceOcclusion(req.world,
+                                       req.org,
+                                       req.dir,
+                                       req.tmin,
+                                       req.tmax,
+                                       /* PRD */
+                                       (void *)&ray);
+        else
+          ti.traceRay(req.world,
+                      req.org,
+                      req.dir,
+                      req.tmin,
+                      req.tmax,
+                      /* PRD */
+                      (void *)&ray);
+      }
+      endTrace(ti,ray,occluded);
     }
 #endif
     
   }
   
-  RTC_EXPORT_TRACE2D(traceRays,render::TraceRays);
+  RTC_EXPORT_BATCHED_TRACE2D(traceRays,render::TraceRays);
 }
-
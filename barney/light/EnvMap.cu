@@ -9,86 +9,47 @@
 
 namespace BARNEY_NS {
 
-  RTC_IMPORT_COMPUTE2D(computeWeights_xy);
-  RTC_IMPORT_COMPUTE1D(computeCDFs_doLine);
-  RTC_IMPORT_COMPUTE1D(normalize_cdf_y);
-  
-  EnvMapLight::PLD *EnvMapLight::getPLD(Device *device)
+  EnvMapLight::Tables::PLD *EnvMapLight::Tables::getPLD(Device *device)
   { return &perLogical[device->contextRank()]; }
 
-  /*! computes an importance sampling weight for each pixel; gets
-    called with one thread per pixel, in a 2d launch */
-  struct ComputeWeights_xy {
-    float *allLines_cdf_x;
-    rtc::TextureObject texture;
-    vec2i textureDims;
-
-#if RTC_DEVICE_CODE
-    inline __rtc_device
-    void run(const rtc::ComputeInterface &ci);
-#endif
-  };
-  
-  /*! this kernel does one thread per line, then this one thread does
-    entire line. not great, but we're not doing this per frame,
-    anyway */
-  struct ComputeCDFs_doLine {
-    float *cdf_y;
-    float *allLines_cdf_x;
-    vec2i textureDims;
+  /* the alias table gets built with the 'sweep' method, which
+     assigns light pixels (weight below average) and heavy ones
+     (above average) to each other in index order. Written in terms
+     of prefix sums over the lights' deficits and the heavies'
+     excesses, every pixel can find its alias with a binary search
+     over those sums, so the whole build is parallel except for a
+     scan over per-chunk totals */
+  enum { ENV_ALIAS_CHUNK_SIZE = 1024 };
 
-#if RTC_DEVICE_CODE
-    inline __rtc_device
-    void run(const rtc::ComputeInterface &ci);
-#endif
-  };
-
-  
-  /*! run by a single thread, to normalize the cdf_y */
-  struct Normalize_cdf_y {
-    float       *cdf_y;
-    const float *allLines_cdf_x;
-    vec2i        textureDims;
-    
-#if RTC_DEVICE_CODE
-    inline __rtc_device
-    void run(const rtc::ComputeInterface &ci);
-#endif
+  /*! per-chunk totals, and (after the scan) per-chunk offsets */
+  struct EnvAliasChunk {
+    int    numLights;
+    int    numHeavies;
+    double deficit;
+    double excess;
   };
 
-
-#if RTC_DEVICE_CODE
+  /*! a pixel's weight relative to the average weight; 'scale' is zero
+      for all-black maps, which get sampled uniformly */
   inline __rtc_device
-  void Normalize_cdf_y::run(const rtc::ComputeInterface &ci)
+  float envAliasRelWeight(const float *weights, int i, float scale)
   {
-    if (ci.getThreadIdx().x != 0) return;
-        
-    float sum = 0.f;
-    for (int i=0;i<textureDims.y;i++)
-      sum += cdf_y[i];
-    float rcp_sum = 1.f/sum;
-        
-    sum = 0.f;
-    for (int i=0;i<textureDims.y;i++) {
-      sum += cdf_y[i];
-      cdf_y[i] = sum * rcp_sum;
-    }
-    cdf_y[textureDims.y-1] = 1.f;
+    return scale > 0.f ? weights[i]*scale : 1.f;
   }
-  
-  inline __rtc_device
-  void ComputeWeights_xy::run(const rtc::ComputeInterface &ci)
+
+  /*! importance sampling weight of each pixel, with one thread per
+      pixel; includes the solid angle of the pixel's row */
+  __rtc_global
+  void envMap_computeWeights(const rtc::ComputeInterface &ci,
+                             rtc::TextureObject texture,
+                             vec2i dims,
+                             float *weights)
   {
-    int ix = ci.getThreadIdx().x
-      + ci.getBlockIdx().x
-      * ci.getBlockDim().x;
-    int iy = ci.getThreadIdx().y
-      + ci.getBlockIdx().y
-      * ci.getBlockDim().y;
-        
-    if (ix >= textureDims.x) return;
-    if (iy >= textureDims.y) return;
-        
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= dims.x*dims.y) return;
+    int ix = tid % dims.x;
+    int iy = tid / dims.x;
     auto importance = [&](vec4f v)->float
     { return max(max(v.x,v.y),v.z); };
         
@@ -97,45 +58,160 @@ namespace BARNEY_NS {
       for (int iix=0;iix<=2;iix++) {
         vec4f fromTex
           = rtc::tex2D<vec4f>(texture,
-                              (ix+iix*.5f)/(textureDims.x),
-                              (iy+iiy*.5f)/(textureDims.y));
+                              (ix+iix*.5f)/(dims.x),
+                              (iy+iiy*.5f)/(dims.y));
         weight = max(weight,importance(fromTex));
       }
-        
-    allLines_cdf_x[ix+textureDims.x*iy] = weight;
+    float rel_y = (iy+.5f) / dims.y;
+    const float theta = ONE_PI * rel_y;
+    weights[tid] = weight * sinf(theta);
+#endif
   }
-  
+
+  /*! sum of all weights in each chunk, one thread per chunk */
+  __rtc_global
+  void envMap_chunkSums(const rtc::ComputeInterface &ci,
+                        const float *weights,
+                        int numPixels,
+                        double *chunkSums)
+  {
+#if RTC_DEVICE_CODE
+    const int chunk = ci.launchIndex().x;
+    int begin = chunk*ENV_ALIAS_CHUNK_SIZE;
+    if (begin >= numPixels) return;
+    int end = min(begin+ENV_ALIAS_CHUNK_SIZE,numPixels);
+    double sum = 0.;
+    for (int i=begin;i<end;i++)
+      sum += weights[i];
+    chunkSums[chunk] = sum;
+#endif
+  }
+
+  /*! number of lights and heavies in each chunk, and the sum of
+      their deficits (1-w) and excesses (w-1), respectively */
+  __rtc_global
+  void envMap_chunkStats(const rtc::ComputeInterface &ci,
+                         const float *weights,
+                         int numPixels,
+                         float scale,
+                         EnvAliasChunk *chunks)
+  {
+#if RTC_DEVICE_CODE
+    const int chunk = ci.launchIndex().x;
+    int begin = chunk*ENV_ALIAS_CHUNK_SIZE;
+    if (begin >= numPixels) return;
+    int end = min(begin+ENV_ALIAS_CHUNK_SIZE,numPixels);
+    EnvAliasChunk stats = { 0,0,0.,0. };
+    for (int i=begin;i<end;i++) {
+      float w = envAliasRelWeight(weights,i,scale);
+      if (w <= 1.f) {
+        stats.numLights++;
+        stats.deficit += 1.f-w;
+      } else {
+        stats.numHeavies++;
+        stats.excess += w-1.f;
+      }
+    }
+    chunks[chunk] = stats;
+#endif
+  }
+
+  /*! given each chunk's offsets, writes all lights (and their
+      exclusive prefix sum of deficits) to the front of
+      keys[]/items[], and all heavies (with their inclusive prefix
+      sum of excesses) behind those; one thread per chunk */
+  __rtc_global
+  void envMap_chunkCompact(const rtc::ComputeInterface &ci,
+                           const float *weights,
+                           int numPixels,
+                           float scale,
+                           const EnvAliasChunk *offsets,
+                           int numLightsTotal,
+                           double *keys,
+                           int *items)
+  {
+#if RTC_DEVICE_CODE
+    const int chunk = ci.launchIndex().x;
+    int begin = chunk*ENV_ALIAS_CHUNK_SIZE;
+    if (begin >= numPixels) return;
+    int end = min(begin+ENV_ALIAS_CHUNK_SIZE,numPixels);
+    EnvAliasChunk pos = offsets[chunk];
+    for (int i=begin;i<end;i++) {
+      float w = envAliasRelWeight(weights,i,scale);
+      if (w <= 1.f) {
+        keys[pos.numLights]  = pos.deficit;
+        items[pos.numLights] = i;
+        pos.numLights++;
+        pos.deficit += 1.f-w;
+      } else {
+        pos.excess += w-1.f;
+        keys[numLightsTotal+pos.numHeavies]  = pos.excess;
+        items[numLightsTotal+pos.numHeavies] = i;
+        pos.numHeavies++;
+      }
+    }
+#endif
+  }
+
+  /*! first index in [begin,end) whose key is > (or, if orEqual, >=)
+      the given value; keys are sorted */
   inline __rtc_device
-  void ComputeCDFs_doLine::run(const rtc::ComputeInterface &ci)
+  int envAliasFirstAbove(const double *keys, int begin, int end,
+                         double value, bool orEqual)
   {
-    int tid
-      = ci.getThreadIdx().x
-      + ci.getBlockIdx().x * ci.getBlockDim().x;
-        
-    int y = tid;
-    if (y >= textureDims.y) return;
-    float *thisLine_pdf = allLines_cdf_x + y * textureDims.x;
-        
-    float sum = 0.f;
-    for (int ix=0;ix<textureDims.x;ix++) 
-      sum += thisLine_pdf[ix];
-        
-    float rcp_sum = 1.f/sum;
-    sum = 0.f;
-    for (int ix=0;ix<textureDims.x;ix++) {
-      sum += thisLine_pdf[ix];
-      thisLine_pdf[ix] = sum * rcp_sum;
+    while (begin < end) {
+      int mid = (begin+end)/2;
+      if (orEqual ? (keys[mid] >= value) : (keys[mid] > value))
+        end = mid;
+      else
+        begin = mid+1;
     }
-    thisLine_pdf[textureDims.x-1] = 1.f;
-        
-    float rel_y = (y+.5f) / textureDims.y;
-        
-    const float theta = ONE_PI * rel_y;
-        
-    float relativeWeightOfLine = sum * sinf(theta);
-    cdf_y[y] = relativeWeightOfLine;
+    return begin;
   }
+
+  /*! one thread per light and heavy, in the order written by
+      envMap_chunkCompact(). A light's alias is the first heavy whose
+      (inclusive) excess sum exceeds the light's (exclusive) deficit
+      sum. A heavy gets used up once lights' deficits reach its excess
+      sum, and whatever it's short of 1 then gets filled by the next
+      heavy. Also turns weights into probabilities, in place */
+  __rtc_global
+  void envMap_assignAliases(const rtc::ComputeInterface &ci,
+                            float *weights,
+                            int numPixels,
+                            float scale,
+                            int numLights,
+                            double totalDeficit,
+                            const double *keys,
+                            const int *items,
+                            EnvMapLight::AliasEntry *table)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= numPixels) return;
+    int item = items[tid];
+    float w = envAliasRelWeight(weights,item,scale);
+    EnvMapLight::AliasEntry entry;
+    if (tid < numLights) {
+      int heavy = envAliasFirstAbove(keys,numLights,numPixels,keys[tid],false);
+      entry.prob  = (heavy < numPixels) ? w : 1.f;
+      entry.alias = (heavy < numPixels) ? items[heavy] : item;
+    } else {
+      double excess = keys[tid];
+      int light = envAliasFirstAbove(keys,0,numLights,excess,true);
+      double deficit = (light < numLights) ? keys[light] : totalDeficit;
+      if (tid+1 < numPixels) {
+        entry.prob  = (float)max(0.,min(1.,1.+excess-deficit));
+        entry.alias = items[tid+1];
+      } else {
+        entry.prob  = 1.f;
+        entry.alias = item;
+      }
+    }
+    table[item]   = entry;
+    weights[item] = w * (1.f/numPixels);
 #endif
+  }
   
   EnvMapLight::DD EnvMapLight::getDD(Device *device,
                                      const affine3f &xfm) 
@@ -143,17 +219,15 @@ namespace BARNEY_NS {
     DD dd;
     dd.dims = dims;
     if (texture) {
-      PLD *pld = getPLD(device);
+      Tables::PLD *pld = tables->getPLD(device);
       dd.texture
         = texture->getDD(device);
-      dd.cdf_y
-        = (const float *)pld->cdf_y->getDD();
-      dd.allCDFs_x
-        = (const float *)pld->allCDFs_x->getDD();
+      dd.aliasTable = pld->aliasTable;
+      dd.pmf        = pld->pmf;
     } else {
-      dd.texture = 0;
-      dd.cdf_y = 0;
-      dd.allCDFs_x = 0;
+      dd.texture    = 0;
+      dd.aliasTable = 0;
+      dd.pmf        = 0;
     }
     dd.scale   = params.scale;
     dd.toWorld = toWorld;
@@ -174,105 +248,122 @@ namespace BARNEY_NS {
 #endif
     toLocal    = rcp(toWorld);
     assert(params.texture);
-    texture    = params.texture;
-    computeCDFs();
+    /* the table lives in the map's own space, so it only has to be
+       re-built if the map itself changes, not if it gets rotated */
+    if (params.texture != texture || params.texture->getDims() != dims) {
+      texture = params.texture;
+      computeAliasTable();
+    }
   }
 
-  void EnvMapLight::computeCDFs()
+  void EnvMapLight::computeAliasTable()
   {
     assert(texture);
     dims = texture->getDims();
+    const int numPixels = dims.x*dims.y;
+    const int numChunks = divRoundUp(numPixels,(int)ENV_ALIAS_CHUNK_SIZE);
+
+    std::weak_ptr<void> &shared = texture->data->envMapTables;
+    tables = std::static_pointer_cast<Tables>(shared.lock());
+    if (tables && tables->devices == devices)
+      return;
+    tables = std::make_shared<Tables>(devices);
+    shared = tables;
     
     for (auto device : *devices) {
-      PLD *pld = getPLD(device);
+      SetActiveGPU forDuration(device);
+      MemoryScope memScope(device,BN_MEMORY_TEXTURES);
+      Tables::PLD *pld = tables->getPLD(device);
       auto rtc = device->rtc;
 
-      if (pld->cdf_y)
-        rtc->freeBuffer(pld->cdf_y);
-      pld->cdf_y
-        = rtc->createBuffer(dims.y*sizeof(float));
+      pld->aliasTable
+        = (AliasEntry *)rtc->allocMem(numPixels*sizeof(AliasEntry));
+      pld->pmf
+        = (float *)rtc->allocMem(numPixels*sizeof(float));
       
-      if (pld->allCDFs_x)
-        rtc->freeBuffer(pld->allCDFs_x);
-      pld->allCDFs_x
-        = rtc->createBuffer(dims.x*dims.y*sizeof(float));
+      int bs = 128;
+      int nb = divRoundUp(numPixels,bs);
+      int nbChunks = divRoundUp(numChunks,bs);
+      __rtc_launch(rtc,envMap_computeWeights,nb,bs,
+                   texture->getDD(device),dims,pld->pmf);
 
-      /* computes an importance sampling weight for each pixel; gets
-         called with one thread per pixel, in a 2d launch */
-      {
-        ComputeWeights_xy kernelData = {
-          (float*)pld->allCDFs_x->getDD(),
-          texture->getDD(device),
-          dims
-        };
-        vec2ui bs = 16;
-        vec2ui nb = divRoundUp(vec2ui(dims),bs);
-        pld->computeWeights_xy
-          ->launch(nb,bs,&kernelData);
-      }
-      /* this kernel will do one thread per line, then this one thread does
-         entire line. not great, but we're not doing this per frame,
-         anyway */
-      {
-        ComputeCDFs_doLine kernelData = {
-          (float*)pld->cdf_y->getDD(),
-          (float*)pld->allCDFs_x->getDD(),
-          dims
-        };
-        pld->computeCDFs_doLine
-          ->launch(dims.y,1024,
-                   &kernelData);
-      }
-      /* run by a single thread, to normalize the cdf_y */
-      {
-        Normalize_cdf_y kernelArgs = {
-          (float*)pld->cdf_y->getDD(),
-          (float*)pld->allCDFs_x->getDD(),
-          dims
-        };
-        pld->normalize_cdf_y
-          ->launch(1,1,&kernelArgs);
+      // ------------------------------------------------------------------
+      // total weight; the per-chunk sums are few enough to add up on
+      // the host
+      // ------------------------------------------------------------------
+      double *d_chunkSums = (double *)rtc->allocMem(numChunks*sizeof(double));
+      __rtc_launch(rtc,envMap_chunkSums,nbChunks,bs,
+                   pld->pmf,numPixels,d_chunkSums);
+      std::vector<double> chunkSums(numChunks);
+      rtc->copy(chunkSums.data(),d_chunkSums,numChunks*sizeof(double));
+      rtc->freeMem(d_chunkSums);
+      double sum = 0.;
+      for (auto chunkSum : chunkSums) sum += chunkSum;
+      float scale = sum > 0. ? float(numPixels/sum) : 0.f;
+
+      // ------------------------------------------------------------------
+      // count lights and heavies per chunk, and scan those counts
+      // (and their deficits and excesses) on the host
+      // ------------------------------------------------------------------
+      EnvAliasChunk *d_chunks
+        = (EnvAliasChunk *)rtc->allocMem(numChunks*sizeof(EnvAliasChunk));
+      __rtc_launch(rtc,envMap_chunkStats,nbChunks,bs,
+                   pld->pmf,numPixels,scale,d_chunks);
+      std::vector<EnvAliasChunk> chunks(numChunks);
+      rtc->copy(chunks.data(),d_chunks,numChunks*sizeof(EnvAliasChunk));
+      EnvAliasChunk total = { 0,0,0.,0. };
+      for (auto &chunk : chunks) {
+        EnvAliasChunk count = chunk;
+        chunk = total;
+        total.numLights  += count.numLights;
+        total.numHeavies += count.numHeavies;
+        total.deficit    += count.deficit;
+        total.excess     += count.excess;
       }
-      device->rtc->sync();
+      rtc->copy(d_chunks,chunks.data(),numChunks*sizeof(EnvAliasChunk));
+
+      double *d_keys  = (double *)rtc->allocMem(numPixels*sizeof(double));
+      int    *d_items = (int *)rtc->allocMem(numPixels*sizeof(int));
+      __rtc_launch(rtc,envMap_chunkCompact,nbChunks,bs,
+                   pld->pmf,numPixels,scale,d_chunks,total.numLights,
+                   d_keys,d_items);
+      __rtc_launch(rtc,envMap_assignAliases,nb,bs,
+                   pld->pmf,numPixels,scale,total.numLights,total.deficit,
+                   d_keys,d_items,pld->aliasTable);
+      rtc->sync();
+      rtc->freeMem(d_keys);
+      rtc->freeMem(d_items);
+      rtc->freeMem(d_chunks);
     }
   }
   
   
-  EnvMapLight::EnvMapLight(Context *context,
-                const DevGroup::SP &devices)
-    : Light(context,devices)
+  EnvMapLight::Tables::Tables(const DevGroup::SP &devices)
+    : devices(devices)
   {
     perLogical.resize(devices->numLogical);
+  }
+  
+  EnvMapLight::Tables::~Tables()
+  {
     for (auto device : *devices) {
       PLD *pld = getPLD(device);
       auto rtc = device->rtc;
-      pld->cdf_y
-        = rtc->createBuffer(sizeof(float));
-      pld->allCDFs_x
-        = rtc->createBuffer(sizeof(float));
-      
-      pld->computeWeights_xy
-        = createCompute_computeWeights_xy(rtc);
-      pld->computeCDFs_doLine
-        = createCompute_computeCDFs_doLine(rtc);
-      pld->normalize_cdf_y
-        = createCompute_normalize_cdf_y(rtc);
+      SetActiveGPU forDuration(device);
+      if (pld->aliasTable) rtc->freeMem(pld->aliasTable);
+      if (pld->pmf)        rtc->freeMem(pld->pmf);
     }
   }
+  
+  EnvMapLight::EnvMapLight(Context *context,
+                const DevGroup::SP &devices)
+    : Light(context,devices)
+  {}
 
   EnvMapLight::~EnvMapLight()
   {
     BN_TRACK_LEAKS(std::cout << "#barney: ~EnvMapLight deconstructing"
                    << std::endl);
-    for (auto device : *devices) {
-      PLD *pld = getPLD(device);
-      auto rtc = device->rtc;
-      if (pld->cdf_y)
-        rtc->freeBuffer(pld->cdf_y);
-      
-      if (pld->allCDFs_x)
-        rtc->freeBuffer(pld->allCDFs_x);
-    }
   }
 
   
@@ -329,9 +420,5 @@ namespace BARNEY_NS {
     }
     return false;
   }
-  
-  RTC_EXPORT_COMPUTE2D(computeWeights_xy,ComputeWeights_xy);
-  RTC_EXPORT_COMPUTE1D(computeCDFs_doLine,ComputeCDFs_doLine);
-  RTC_EXPORT_COMPUTE1D(normalize_cdf_y,Normalize_cdf_y);
 }
 
@@ -24,6 +24,14 @@ namespace BARNEY_NS {
     EnvMapLight(Context *context,
                 const DevGroup::SP &devices);
     virtual ~EnvMapLight();
+
+    /*! one entry of the alias table we importance-sample the map's
+        pixels with: pixel i gets picked with probability 'prob',
+        else pixel 'alias' does */
+    struct AliasEntry {
+      float prob;
+      int   alias;
+    };
     
     struct DD {
 #if RTC_DEVICE_CODE
@@ -42,8 +50,10 @@ namespace BARNEY_NS {
       rtc::TextureObject  texture = 0;
       vec2i               dims;
       float               scale;
-      const float        *cdf_y = 0;
-      const float        *allCDFs_x = 0;
+      /*! one entry per pixel; see AliasEntry */
+      const AliasEntry   *aliasTable = 0;
+      /*! each pixel's probability of getting sampled */
+      const float        *pmf = 0;
     };
 
     DD getDD(Device *device, const affine3f &xfm);
@@ -61,20 +71,32 @@ namespace BARNEY_NS {
     /*! @} */
     // ------------------------------------------------------------------
 
-  private:
-    void computeCDFs();
-  public: // =========== PLD STUFF ===========
-    struct PLD {
-      rtc::Buffer  *cdf_y = 0;
-      rtc::Buffer  *allCDFs_x = 0;
+    /*! the importance sampling tables over one map's pixels, on all
+        devices. They only depend on the map's texels, so all lights
+        whose textures share the same TextureData share these, too
+        (see TextureData::envMapTables) */
+    struct Tables {
+      typedef std::shared_ptr<Tables> SP;
+      Tables(const DevGroup::SP &devices);
+      ~Tables();
       
-      rtc::ComputeKernel2D *computeWeights_xy;
-      rtc::ComputeKernel1D *computeCDFs_doLine;
-      rtc::ComputeKernel1D *normalize_cdf_y;
+      struct PLD {
+        AliasEntry *aliasTable = 0;
+        float      *pmf = 0;
+      };
+      PLD *getPLD(Device *device);
+      std::vector<PLD>   perLogical;
+      DevGroup::SP const devices;
     };
-
-    PLD *getPLD(Device *);
-    std::vector<PLD> perLogical;
+    
+  private:
+    /*! (re-)builds the alias table for the current texture - or, if
+        another light already built one for the same data, shares
+        that; only depends on the texture, not on the light's
+        orientation */
+    void computeAliasTable();
+  public:
+    Tables::SP tables;
     
   public: // =========== parameters ===========
     struct {
@@ -94,45 +116,6 @@ namespace BARNEY_NS {
 
 
 #if RTC_DEVICE_CODE
-// #if BARNEY_DEVICE_PROGRAM
-  inline __rtc_device
-  float cdfGetPDF(int position, const float *cdf, int N)
-  {
-    float f_at_position = cdf[position];
-    float f_before_position
-      = position
-      ? cdf[position-1]
-      : 0.f;
-    
-    return N*(f_at_position-f_before_position);
-  }
-
-  inline __rtc_device
-  int sampleCDF(const float *cdf, int N, float v,
-                float &pdf, bool dbg = false)
-  {
-    int begin = 0;
-    int end   = N;
-    while ((end - begin) > 1) {
-      int mid = (begin+end)/2;
-      float f_mid = cdf[mid-1];
-
-      if (v < f_mid)
-        end = mid;
-      else
-        begin = mid;
-    }
-    int position = begin;
-    float f_at_position = cdf[begin];
-    float f_before_position
-      = begin
-      ? cdf[begin-1]
-      : 0.f;
-    
-    pdf = N*(f_at_position-f_before_position);
-    return position;
-  }
-  
   inline __rtc_device float
   EnvMapLight::DD::pdf(vec3f dir, bool dbg) const
   {
@@ -152,14 +135,13 @@ namespace BARNEY_NS {
       return ONE_OVER_FOUR_PI;
     
     vec2i pixel = worldToPixel(dir);
-    float pdf_y = cdfGetPDF(pixel.y,cdf_y,dims.y);
-
-    float pdf_x = cdfGetPDF(pixel.x,allCDFs_x+pixel.y*dims.x,dims.x);
+    float pmf_xy = pmf[pixel.x+dims.x*pixel.y];
 
     float rel_y = (pixel.y+.5f) / dims.y;
     const float theta = ONE_PI * rel_y;
 
-    return pdf_x * pdf_y * 1.f/(TWO_PI*ONE_PI*sinf(theta));
+    return pmf_xy * (float(dims.x)*float(dims.y))
+      * 1.f/(TWO_PI*ONE_PI*sinf(theta));
   }
   
   inline __rtc_device vec2i
@@ -221,28 +203,30 @@ namespace BARNEY_NS {
 #endif
     if (!texture) return {};
 
-    float r_y = r();
-    float r_x = r();
-    float pdf_y;
-    int iy = sampleCDF(cdf_y,dims.y,r_y,pdf_y,dbg);
-    float pdf_x;
-    int ix = sampleCDF(allCDFs_x+dims.x*iy,dims.x,r_x,pdf_x,dbg);
+    /* pick a pixel uniformly (with one random number per axis, a
+       single one doesn't have enough bits for large maps), then
+       either keep it or take its alias */
+    int ix = min(int(r()*dims.x),dims.x-1);
+    int iy = min(int(r()*dims.y),dims.y-1);
+    AliasEntry entry = aliasTable[ix+dims.x*iy];
+    if (r() >= entry.prob) {
+      ix = entry.alias % dims.x;
+      iy = entry.alias / dims.x;
+    }
+    float pmf_xy = pmf[ix+dims.x*iy];
 
-#if 1
     float sx = (ix+r())/dims.x;
     float sy = (iy+r())/dims.y;
-#else
-    float sx = (ix+.5f)/dims.x;
-    float sy = (iy+.5f)/dims.y;
-#endif
     vec4f fromTex = rtc::tex2D<vec4f>(texture,sx,sy);
     sample.radiance = scale * (vec3f&)fromTex;
     sample.direction = uvToWorld(sx,sy);
     
-    float rel_y = sy;
+    /* same as pdf(): the weights the table got built from use the
+       pixel center's solid angle */
+    float rel_y = (iy+.5f)/dims.y;
     const float theta = ONE_PI * rel_y;
     sample.pdf
-      = pdf_x*pdf_y
+      = pmf_xy * (float(dims.x)*float(dims.y))
       * 1.f/(TWO_PI*ONE_PI*sinf(theta));
     
     sample.distance = BARNEY_INF;
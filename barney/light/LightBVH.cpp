@@ -0,0 +1,165 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/light/LightBVH.h"
+#include <algorithm>
+
+namespace BARNEY_NS {
+
+  /*! what the builder needs to know about each light */
+  struct LightBVHPrim {
+    box3f bounds;
+    vec3f centroid;
+    float power;
+    vec3f axis;
+    float thetaO;
+    float thetaE;
+    int   lightID;
+  };
+
+  /*! a cone of directions, as used for bounding emitters' normals */
+  struct NormalCone {
+    vec3f axis;
+    float thetaO;
+    float thetaE;
+  };
+
+  static float angleBetween(vec3f a, vec3f b)
+  {
+    return acosf(std::max(-1.f,std::min(1.f,dot(a,b))));
+  }
+
+  /*! rotates v around (unit) axis k by given angle */
+  static vec3f rotate(vec3f v, vec3f k, float angle)
+  {
+    float c = cosf(angle), s = sinf(angle);
+    return v*c + cross(k,v)*s + k*(dot(k,v)*(1.f-c));
+  }
+
+  static NormalCone merge(NormalCone a, NormalCone b)
+  {
+    if (b.thetaO > a.thetaO) std::swap(a,b);
+    float thetaE = std::max(a.thetaE,b.thetaE);
+    float thetaD = angleBetween(a.axis,b.axis);
+    if (std::min(thetaD+b.thetaO,ONE_PI) <= a.thetaO)
+      return { a.axis,a.thetaO,thetaE };
+    float thetaO = .5f*(a.thetaO+thetaD+b.thetaO);
+    vec3f k = cross(a.axis,b.axis);
+    if (thetaO >= ONE_PI || length(k) < 1e-6f)
+      return { a.axis,ONE_PI,thetaE };
+    vec3f axis = rotate(a.axis,normalize(k),thetaO-a.thetaO);
+    return { normalize(axis),thetaO,thetaE };
+  }
+
+  /*! builds subtree over prims [begin,end) into given node, by
+      splitting at the median along the widest centroid extent */
+  static void buildRec(std::vector<LightBVH::Node> &nodes,
+                       int nodeID,
+                       std::vector<LightBVHPrim> &prims,
+                       int begin, int end)
+  {
+    box3f bounds, centroidBounds;
+    NormalCone cone = { prims[begin].axis,prims[begin].thetaO,prims[begin].thetaE };
+    float power = 0.f;
+    for (int i=begin;i<end;i++) {
+      bounds.extend(prims[i].bounds);
+      centroidBounds.extend(prims[i].centroid);
+      cone = merge(cone,{ prims[i].axis,prims[i].thetaO,prims[i].thetaE });
+      power += prims[i].power;
+    }
+    LightBVH::Node &node = nodes[nodeID];
+    node.lower  = bounds.lower;
+    node.upper  = bounds.upper;
+    node.power  = power;
+    node.axis   = cone.axis;
+    node.thetaO = cone.thetaO;
+    node.thetaE = cone.thetaE;
+    if (end-begin == 1) {
+      node.isLeaf = 1;
+      node.childOrLight = prims[begin].lightID;
+      return;
+    }
+    vec3f extent = centroidBounds.size();
+    int dim
+      = (extent.x >= extent.y && extent.x >= extent.z) ? 0
+      : (extent.y >= extent.z ? 1 : 2);
+    int mid = (begin+end)/2;
+    std::nth_element(prims.begin()+begin,
+                     prims.begin()+mid,
+                     prims.begin()+end,
+                     [dim](const LightBVHPrim &a, const LightBVHPrim &b)
+                     { return a.centroid[dim] < b.centroid[dim]; });
+    int child = (int)nodes.size();
+    node.isLeaf = 0;
+    node.childOrLight = child;
+    /* careful - this invalidates 'node' */
+    nodes.resize(child+2);
+    buildRec(nodes,child+0,prims,begin,mid);
+    buildRec(nodes,child+1,prims,mid,end);
+  }
+
+  static std::vector<LightBVH::Node> buildFrom(std::vector<LightBVHPrim> &prims)
+  {
+    std::vector<LightBVH::Node> nodes;
+    if (prims.size() < LightBVH::minLightsForBVH)
+      return nodes;
+    nodes.reserve(2*prims.size());
+    nodes.resize(1);
+    buildRec(nodes,0,prims,0,(int)prims.size());
+    return nodes;
+  }
+
+  std::vector<LightBVH::Node>
+  LightBVH::build(const std::vector<QuadLight::DD> &lights)
+  {
+    std::vector<LightBVHPrim> prims;
+    for (int i=0;i<(int)lights.size();i++) {
+      const QuadLight::DD &light = lights[i];
+      LightBVHPrim prim;
+      prim.bounds = box3f()
+        .including(light.corner)
+        .including(light.corner+light.edge0)
+        .including(light.corner+light.edge1);
+      if (!light.isTriangle)
+        prim.bounds.extend(light.corner+light.edge0+light.edge1);
+      prim.centroid = prim.bounds.center();
+      prim.power    = light.area * reduce_max(light.emission);
+      prim.axis     = light.normal;
+      prim.thetaO   = 0.f;
+      prim.thetaE   = .5f*ONE_PI;
+      prim.lightID  = i;
+      if (!(prim.power > 0.f)) continue;
+      prims.push_back(prim);
+    }
+    return buildFrom(prims);
+  }
+
+  std::vector<LightBVH::Node>
+  LightBVH::build(const std::vector<PointLight::DD> &lights)
+  {
+    std::vector<LightBVHPrim> prims;
+    for (int i=0;i<(int)lights.size();i++) {
+      const PointLight::DD &light = lights[i];
+      /* same as PointLight::DD::radianceTowards(), which is device
+         only */
+      vec3f intensity
+        = isnan(light.intensity)
+        ? light.color * light.power * ONE_OVER_FOUR_PI
+        : light.color * light.intensity;
+      LightBVHPrim prim;
+      prim.bounds   = box3f(light.position,light.position);
+      prim.centroid = light.position;
+      prim.power    = reduce_max(intensity);
+      /* point lights emit in all directions */
+      prim.axis     = vec3f(0.f,0.f,1.f);
+      prim.thetaO   = ONE_PI;
+      prim.thetaE   = .5f*ONE_PI;
+      prim.lightID  = i;
+      if (!(prim.power > 0.f)) continue;
+      prims.push_back(prim);
+    }
+    return buildFrom(prims);
+  }
+
+}
@@ -0,0 +1,127 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/light/PointLight.h"
+#include "barney/light/QuadLight.h"
+
+namespace BARNEY_NS {
+
+  /*! a bvh over a world's quad (or point) lights, where each node
+      also knows the total power of, and a cone bounding the emission
+      directions of, all lights below it. Lets shading pick a light
+      in proportion to (an estimate of) how much it contributes to a
+      given shading point, by walking down the tree and randomly
+      choosing one child per level, in O(log N) rather than the
+      handful of uniformly-drawn candidates that worlds with only a
+      few lights get */
+  struct LightBVH {
+
+    struct Node {
+      vec3f lower;
+      /*! sum of the (max-channel) power of all lights below */
+      float power;
+      vec3f upper;
+      /*! half-angle of cone around 'axis' that bounds all emitters'
+          normals */
+      float thetaO;
+      vec3f axis;
+      /*! max angle, beyond thetaO, under which any of the emitters
+          still emits; pi/2 for one-sided quads */
+      float thetaE;
+      /*! for inner nodes, the first of two consecutive children;
+          for leaves, the light's index in the world's light array */
+      int   childOrLight;
+      int   isLeaf;
+    };
+
+    struct DD {
+#if RTC_DEVICE_CODE
+      /*! picks a light for shading point P with normal N (or N==0 if
+          there's no surface), and returns its index;
+          'pmf' is the probability with which that light got picked */
+      inline __rtc_device
+      int sample(float &pmf, vec3f P, vec3f N, Random2 &random) const;
+      inline __rtc_device
+      float importance(const Node &node, vec3f P, vec3f N) const;
+#endif
+      const Node *nodes    = nullptr;
+      int         numNodes = 0;
+    };
+
+    /*! below that many lights the regular sampling does just as well,
+        and we don't bother building a tree */
+    enum { minLightsForBVH = 32 };
+
+    /*! builds the (host-side) node array; empty if there's too few
+        lights to be worth it */
+    static std::vector<Node> build(const std::vector<QuadLight::DD> &lights);
+    static std::vector<Node> build(const std::vector<PointLight::DD> &lights);
+  };
+
+#if RTC_DEVICE_CODE
+  inline __rtc_device
+  float LightBVH::DD::importance(const Node &node, vec3f P, vec3f N) const
+  {
+    if (node.power <= 0.f) return 0.f;
+    vec3f center = .5f*(node.lower+node.upper);
+    vec3f toP = P-center;
+    float radius = .5f*length(node.upper-node.lower);
+    float dist2 = dot(toP,toP);
+    /* don't let the 1/d^2 blow up for points inside (or close to)
+       the node; one light per leaf means that's exact at the leaves
+       anyway when the light is further away than its own size */
+    float dist2Clamped = max(dist2,radius*radius);
+    float dist = sqrtf(dist2);
+    float sinThetaU = dist > radius ? radius/dist : 1.f;
+    float thetaU = asinf(min(sinThetaU,1.f));
+
+    /* how far we're outside the emitters' normal cone */
+    float cosOrientation = 1.f;
+    if (node.thetaO < ONE_PI && dist > 0.f) {
+      float theta = acosf(max(-1.f,min(1.f,dot(node.axis,toP)/dist)));
+      float thetaP = max(0.f,theta-node.thetaO-thetaU);
+      if (thetaP >= node.thetaE) return 0.f;
+      cosOrientation = cosf(thetaP);
+    }
+
+    /* and how far the node is below the surface's horizon */
+    float cosIncident = 1.f;
+    if (N != vec3f(0.f) && dist > radius) {
+      float thetaI = acosf(max(-1.f,min(1.f,-dot(N,toP)/dist)));
+      float thetaIP = max(0.f,thetaI-thetaU);
+      if (thetaIP >= .5f*ONE_PI) return 0.f;
+      cosIncident = cosf(thetaIP);
+    }
+    return node.power * cosOrientation * cosIncident / dist2Clamped;
+  }
+
+  inline __rtc_device
+  int LightBVH::DD::sample(float &pmf, vec3f P, vec3f N,
+                           Random2 &random) const
+  {
+    pmf = 1.f;
+    int nodeID = 0;
+    if (importance(nodes[0],P,N) <= 0.f) return -1;
+    while (!nodes[nodeID].isLeaf) {
+      int child = nodes[nodeID].childOrLight;
+      float i0 = importance(nodes[child+0],P,N);
+      float i1 = importance(nodes[child+1],P,N);
+      float sum = i0+i1;
+      if (sum <= 0.f) return -1;
+      float p0 = i0/sum;
+      if (random() < p0) {
+        nodeID = child+0;
+        pmf *= p0;
+      } else {
+        nodeID = child+1;
+        pmf *= 1.f-p0;
+      }
+    }
+    return nodes[nodeID].childOrLight;
+  }
+#endif
+
+}
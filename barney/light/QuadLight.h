@@ -22,6 +22,19 @@ namespace BARNEY_NS {
         from cross(edge0,edge1), but is handle to have in a
         renderer */
       float area;
+      /*! if set, this is the triangle (corner,corner+edge0,
+          corner+edge1) rather than the parallelogram; that's what
+          emissive triangle meshes get registered as */
+      int   isTriangle = 0;
+
+      /*! point on the light for uniformly distributed u,v in [0,1);
+          triangles fold the upper half of the parallelogram back
+          onto the lower one, which keeps the distribution uniform */
+      inline __both__ vec3f pointAt(float u, float v) const
+      {
+        if (isTriangle && u+v > 1.f) { u = 1.f-u; v = 1.f-v; }
+        return corner + u*edge0 + v*edge1;
+      }
     };
 
     typedef std::shared_ptr<QuadLight> SP;
@@ -21,6 +21,11 @@ namespace BARNEY_NS {
       return dd;
     }
 
+    bool AnariMatte::isAlwaysOpaque() const
+    {
+      return color.isValueAtLeast(3,1.f) && opacity.isValueAtLeast(0,1.f);
+    }
+
     bool AnariMatte::setObject(const std::string &member,
                                const Object::SP &value) 
     {
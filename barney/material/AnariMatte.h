@@ -18,8 +18,15 @@ namespace BARNEY_NS {
 #if RTC_DEVICE_CODE
         inline __rtc_device
         PackedBSDF createBSDF(const HitAttributes &hitData,
-                              const Sampler::DD *samplers,
+                              const Sampler::Table &samplers,
                               bool dbg) const;
+        /*! what createBSDF()'s bsdf.getOpacity() would return,
+            without creating the bsdf */
+        inline __rtc_device
+        float getOpacity(const HitAttributes &hitData,
+                         const Sampler::Table &samplers,
+                         bool isShadowRay,
+                         bool dbg) const;
 #endif
         PossiblyMappedParameter::DD color;
         PossiblyMappedParameter::DD opacity;
@@ -41,6 +48,7 @@ namespace BARNEY_NS {
       std::string toString() const override { return "AnariMatte"; }
       
       DeviceMaterial getDD(Device *device) override;
+      bool isAlwaysOpaque() const override;
       
       PossiblyMappedParameter color   = vec3f(.8f);
       PossiblyMappedParameter opacity = 1.f;
@@ -49,7 +57,7 @@ namespace BARNEY_NS {
 #if RTC_DEVICE_CODE
     inline __rtc_device
     PackedBSDF AnariMatte::DD::createBSDF(const HitAttributes &hitData,
-                                          const Sampler::DD *samplers,
+                                          const Sampler::Table &samplers,
                                           bool dbg) const
     {
       vec4f baseColor = this->color.eval(hitData,samplers,dbg);
@@ -74,6 +82,16 @@ namespace BARNEY_NS {
 # endif
       return bsdf;
     }
+
+    inline __rtc_device
+    float AnariMatte::DD::getOpacity(const HitAttributes &hitData,
+                                     const Sampler::Table &samplers,
+                                     bool isShadowRay,
+                                     bool dbg) const
+    {
+      return this->color.eval(hitData,samplers,dbg).w
+        *    this->opacity.eval(hitData,samplers,dbg).x;
+    }
 #endif    
   }
 }
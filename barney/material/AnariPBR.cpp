@@ -28,6 +28,23 @@ namespace BARNEY_NS {
       return dd;
     }
     
+    bool AnariPBR::isAlwaysOpaque() const
+    {
+      return baseColor.isValueAtLeast(3,1.f)
+        &&   opacity.isValueAtLeast(0,1.f)
+        &&   transmission.type == PossiblyMappedParameter::VALUE
+        &&   transmission.value.x <= 0.f;
+    }
+
+    vec3f AnariPBR::constantEmission() const
+    {
+      if (emission.type != PossiblyMappedParameter::VALUE
+          || isnan(emission.value.x))
+        return vec3f(0.f);
+      return max(vec3f(emission.value.x,emission.value.y,emission.value.z),
+                 vec3f(0.f));
+    }
+    
     bool AnariPBR::setObject(const std::string &member, const Object::SP &value) 
     {
       if (HostMaterial::setObject(member,value)) return true;
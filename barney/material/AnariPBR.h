@@ -15,11 +15,14 @@ namespace BARNEY_NS {
 #if RTC_DEVICE_CODE
        inline __rtc_device
         PackedBSDF createBSDF(const HitAttributes &hitData,
-                              const Sampler::DD *samplers,
+                              const Sampler::Table &samplers,
                               bool dbg) const;
+        /*! what createBSDF()'s bsdf.getOpacity() would return,
+            without creating the bsdf */
         inline __rtc_device
         float getOpacity(const HitAttributes &hitData,
-                         const Sampler::DD *samplers,
+                         const Sampler::Table &samplers,
+                         bool isShadowRay,
                          bool dbg) const;
 #endif
         PossiblyMappedParameter::DD baseColor;
@@ -37,6 +40,8 @@ namespace BARNEY_NS {
       std::string toString() const override { return "AnariPBR"; }
       
       DeviceMaterial getDD(Device *device) override;
+      vec3f constantEmission() const override;
+      bool isAlwaysOpaque() const override;
 
       bool setObject(const std::string &member,
                      const Object::SP &value) override;
@@ -61,7 +66,7 @@ namespace BARNEY_NS {
 #if RTC_DEVICE_CODE
     inline __rtc_device
     PackedBSDF AnariPBR::DD::createBSDF(const HitAttributes &hitData,
-                                        const Sampler::DD *samplers,
+                                        const Sampler::Table &samplers,
                                         bool dbg) const
     {
       vec4f baseColor    = this->baseColor   .eval(hitData,samplers,dbg);
@@ -93,6 +98,22 @@ namespace BARNEY_NS {
       bsdf.ior = ior.x;
       return bsdf;
     }
+
+    inline __rtc_device
+    float AnariPBR::DD::getOpacity(const HitAttributes &hitData,
+                                   const Sampler::Table &samplers,
+                                   bool isShadowRay,
+                                   bool dbg) const
+    {
+      vec4f transmission = this->transmission.eval(hitData,samplers,dbg);
+      vec4f ior          = this->ior         .eval(hitData,samplers,dbg);
+      if (ior.x != 1.f && (transmission.x >= 1e-3f))
+        // glass: see Glass::getOpacity()
+        return isShadowRay ? 0.f : 1.f;
+      return (1.f-transmission.x)
+        * this->baseColor.eval(hitData,samplers,dbg).w
+        * this->opacity  .eval(hitData,samplers,dbg).x;
+    }
 #endif
     
   }
@@ -23,17 +23,21 @@ namespace BARNEY_NS {
 #if RTC_DEVICE_CODE
       inline __rtc_device
       PackedBSDF createBSDF(const HitAttributes &hitData,
-                            const Sampler::DD *samplers,
+                            const Sampler::Table &samplers,
                             bool dbg=false) const;
+      /*! what createBSDF()'s bsdf.getOpacity() would return, for
+          any-hit programs that only need to know whether to ignore
+          a hit; skips everything the bsdf needs only for shading */
       inline __rtc_device
       float getOpacity(const HitAttributes &hitData,
-                       const Sampler::DD *samplers,
-                       bool dbg) const;
+                       const Sampler::Table &samplers,
+                       bool isShadowRay,
+                       bool dbg=false) const;
 
       inline __rtc_device
       void setHit(Ray &ray,
                   const HitAttributes &hitData,
-                  const Sampler::DD *samplers,
+                  const Sampler::Table &samplers,
                   bool dbg=false) const;
 #endif      
       Type type;
@@ -42,11 +46,15 @@ namespace BARNEY_NS {
         AnariMatte::DD anariMatte;
       };
     };
+    /*! the registry's array gets read at every hit; with 16-byte
+        parameters the largest material is one 128-byte cache line */
+    static_assert(sizeof(DeviceMaterial) <= 128,
+                  "DeviceMaterial grew beyond a single cache line");
 
 #if RTC_DEVICE_CODE
     inline __rtc_device
     PackedBSDF DeviceMaterial::createBSDF(const HitAttributes &hitData,
-                                          const Sampler::DD *samplers,
+                                          const Sampler::Table &samplers,
                                           bool dbg) const
     {
       if (type == TYPE_AnariMatte)
@@ -61,12 +69,31 @@ namespace BARNEY_NS {
       return packedBSDF::Invalid();
     }
 
+    inline __rtc_device
+    float DeviceMaterial::getOpacity(const HitAttributes &hitData,
+                                     const Sampler::Table &samplers,
+                                     bool isShadowRay,
+                                     bool dbg) const
+    {
+      if (type == TYPE_AnariMatte)
+        return anariMatte.getOpacity(hitData,samplers,isShadowRay,dbg);
+      if (type == TYPE_AnariPBR)
+        return anariPBR.getOpacity(hitData,samplers,isShadowRay,dbg);
+      return 1.f;
+    }
+
     inline __rtc_device
     void DeviceMaterial::setHit(Ray &ray,
                                 const HitAttributes &hitData,
-                                const Sampler::DD *samplers,
+                                const Sampler::Table &samplers,
                                 bool dbg) const
     {
+      if (ray.isShadowRay) {
+        /* all a shadow ray needs to know is that it hit something,
+           so don't bother creating the bsdf */
+        ray.setOccluded(hitData.t);
+        return;
+      }
       ray.setHit(hitData.worldPosition,hitData.worldNormal,
                  hitData.t,createBSDF(hitData,samplers,dbg));
     }
@@ -16,21 +16,18 @@ namespace BARNEY_NS {
     PossiblyMappedParameter::getDD(Device *device) 
     {
       PossiblyMappedParameter::DD dd;
-      dd.type = type;
-      switch(type) {
-      case SAMPLER:
-        dd.samplerID = sampler ? sampler->samplerID : -1;
-        break;
-      case ATTRIBUTE:
-        dd.attribute = attribute;
-        break;
-      case VALUE:
+      if (type == VALUE && !isnan(value.x)) {
         (vec4f&)dd.value = value;
-        break;
-      case INVALID:
-        (vec4f&)dd.value = vec4f(0.f,0.f,0.f,0.f);
-        break;
+        return dd;
       }
+      dd.mapped.nan    = NAN;
+      dd.mapped.type   = (type == VALUE) ? INVALID : type;
+      dd.mapped.index  = -1;
+      dd.mapped.unused = 0;
+      if (type == SAMPLER)
+        dd.mapped.index = sampler ? sampler->samplerID : -1;
+      else if (type == ATTRIBUTE)
+        dd.mapped.index = (int)attribute;
       return dd;
     }
     
@@ -25,18 +25,29 @@ namespace BARNEY_NS {
       PossiblyMappedParameter(float v)
       { type = VALUE; value = vec4f(v,0.f,0.f,1.f); }
       
+      /*! device-side version, packed into a single float4 so a
+          material's parameters (and the sampler IDs among them) sit
+          next to each other rather than each taking 32 bytes: a
+          VALUE is stored as is; for everything else, value.x is a
+          NaN - which a set VALUE never is - and 'mapped' says what
+          it is instead. An unset (NaN) VALUE becomes INVALID */
       struct DD {
 #if RTC_DEVICE_CODE
         inline __rtc_device
         vec4f eval(const HitAttributes &hitData,
-                    const Sampler::DD *samplers,
+                    const Sampler::Table &samplers,
                     bool dbg=false) const;
 #endif
-        Type type;
         union {
-          rtc::float4          value;
-          HitAttributes::Which attribute;
-          int                  samplerID;
+          rtc::float4 value;
+          struct {
+            float nan;
+            int/*Type*/ type;
+            /*! the sampler ID for SAMPLER, HitAttributes::Which
+                for ATTRIBUTE */
+            int   index;
+            int   unused;
+          } mapped;
         };
       };
 
@@ -45,6 +56,12 @@ namespace BARNEY_NS {
       void set(const vec4f &v);
       void set(Sampler::SP sampler);
       void set(const std::string &attributeName);
+
+      /*! whether this is a VALUE whose given component is at least
+          'atLeast' - ie, something a material can decide things on
+          at commit time */
+      bool isValueAtLeast(int component, float atLeast) const
+      { return type == VALUE && value[component] >= atLeast; }
       
       DD getDD(Device *device);
       
@@ -85,6 +102,16 @@ namespace BARNEY_NS {
     
       virtual DeviceMaterial getDD(Device *device) = 0;
 
+      /*! the material's emission if that's the same everywhere on
+          the surface, else (or if it doesn't emit) zero; geometries
+          with such a material get registered as area lights */
+      virtual vec3f constantEmission() const { return vec3f(0.f); }
+
+      /*! whether every hit on this material is opaque, to any ray, no
+          matter what attributes or textures say; geometries with such
+          a material can skip the any-hit opacity test altogether */
+      virtual bool isAlwaysOpaque() const { return false; }
+
       /*! this material's index in the device list of all DeviceMaterials */
       const int materialID;
 
@@ -99,17 +126,17 @@ namespace BARNEY_NS {
 #if RTC_DEVICE_CODE
     inline __rtc_device
     vec4f PossiblyMappedParameter::DD::eval(const HitAttributes &hitData,
-                                            const Sampler::DD *samplers,
+                                            const Sampler::Table &samplers,
                                             bool dbg) const
     {
-      if (type == VALUE) {
-        return isnan(value.x) ? vec4f(0.f,0.f,0.f,1.f) : rtc::load(value);
-      }
-      if (type == ATTRIBUTE) {
-        return hitData.get(attribute,dbg);
+      vec4f v = rtc::load(value);
+      if (!isnan(v.x))
+        return v;
+      if (mapped.type == ATTRIBUTE) {
+        return hitData.get((HitAttributes::Which)mapped.index,dbg);
       } 
-      if (type == SAMPLER) {
-        return samplers[samplerID].eval(hitData,dbg);
+      if (mapped.type == SAMPLER && mapped.index >= 0) {
+        return samplers[mapped.index].eval(hitData,dbg);
       }
       return vec4f(0.f,0.f,0.f,1.f);
     }
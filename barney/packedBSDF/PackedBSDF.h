@@ -24,7 +24,10 @@ namespace BARNEY_NS {
         TYPE_Phase,
         TYPE_Glass,
         TYPE_Lambertian,
-        TYPE_NVisii
+        TYPE_NVisii,
+        /*! what shadow rays get when they hit anything; there's no
+            bsdf data to go with that */
+        TYPE_Occluded
       } Type;
       struct Data {
         union {
@@ -37,6 +40,16 @@ namespace BARNEY_NS {
 
       Type type;
 
+      /*! for code specialized to only some bsdf types: a bit mask of
+          those types, with bit 'typeBit(type)' set for each. The
+          eval/pdf/scatter variants templated over such a mask only
+          compile in the code for the types in the mask (and do
+          nothing for all others), so kernels that know which types
+          they'll see don't pay for the ones they don't */
+      static inline __rtc_both constexpr int typeBit(Type type)
+      { return 1<<int(type); }
+      enum { ALL_TYPES = 0xffff };
+      
 #if RTC_DEVICE_CODE
       inline __rtc_device PackedBSDF();
       inline __rtc_device PackedBSDF(Type type, Data data)
@@ -52,12 +65,15 @@ namespace BARNEY_NS {
       inline __rtc_device PackedBSDF(const packedBSDF::Lambertian  &lambertian)
       { type = TYPE_Lambertian; data.lambertian = lambertian; }
       
+      template<int typeMask=ALL_TYPES>
       inline __rtc_device
       EvalRes eval(render::DG dg, vec3f w_i, bool dbg=false) const;
 
+      template<int typeMask=ALL_TYPES>
       inline __rtc_device
       float pdf(render::DG dg, vec3f w_i, bool dbg=false) const;
       
+      template<int typeMask=ALL_TYPES>
       inline __rtc_device
       void scatter(ScatterResult &scatter,
                    const render::DG &dg,
@@ -74,30 +90,32 @@ namespace BARNEY_NS {
     };
 
 #if RTC_DEVICE_CODE
+    template<int typeMask>
     inline __rtc_device
     EvalRes PackedBSDF::eval(render::DG dg, vec3f w_i, bool dbg) const
     {
-      if (type == TYPE_Phase)
+      if ((typeMask & typeBit(TYPE_Phase)) && type == TYPE_Phase)
         return data.phase.eval(dg,w_i,dbg);
-      if (type == TYPE_NVisii)
+      if ((typeMask & typeBit(TYPE_NVisii)) && type == TYPE_NVisii)
         return data.nvisii.eval(dg,w_i,dbg);
-      if (type == TYPE_Glass)
+      if ((typeMask & typeBit(TYPE_Glass)) && type == TYPE_Glass)
         return data.glass.eval(dg,w_i,dbg);
-      if (type == TYPE_Lambertian)
+      if ((typeMask & typeBit(TYPE_Lambertian)) && type == TYPE_Lambertian)
         return data.lambertian.eval(dg,w_i,dbg);
       return EvalRes();
     }
     
+    template<int typeMask>
     inline __rtc_device
     float PackedBSDF::pdf(render::DG dg, vec3f w_i, bool dbg) const
     {
-      if (type == TYPE_NVisii)
+      if ((typeMask & typeBit(TYPE_NVisii)) && type == TYPE_NVisii)
         return data.nvisii.pdf(dg,w_i,dbg);
-      if (type == TYPE_Glass)
+      if ((typeMask & typeBit(TYPE_Glass)) && type == TYPE_Glass)
         return data.glass.pdf(dg,w_i,dbg);
-      if (type == TYPE_Lambertian)
+      if ((typeMask & typeBit(TYPE_Lambertian)) && type == TYPE_Lambertian)
         return data.lambertian.pdf(dg,w_i,dbg);
-      if (type == TYPE_Phase)
+      if ((typeMask & typeBit(TYPE_Phase)) && type == TYPE_Phase)
         return data.phase.pdf(dg,w_i,dbg);
       return 0.f;
     }
@@ -118,6 +136,7 @@ namespace BARNEY_NS {
       return 1.f;
     }
 
+    template<int typeMask>
     inline __rtc_device
     void PackedBSDF::scatter(ScatterResult &scatter,
                              const render::DG &dg,
@@ -125,13 +144,13 @@ namespace BARNEY_NS {
                              bool dbg) const
     {
       scatter.pdf = 0.f;
-      if (type == TYPE_Phase)
+      if ((typeMask & typeBit(TYPE_Phase)) && type == TYPE_Phase)
         return data.phase.scatter(scatter,dg,random,dbg);
-      if (type == TYPE_NVisii)
+      if ((typeMask & typeBit(TYPE_NVisii)) && type == TYPE_NVisii)
         return data.nvisii.scatter(scatter,dg,random,dbg);
-      if (type == TYPE_Glass)
+      if ((typeMask & typeBit(TYPE_Glass)) && type == TYPE_Glass)
         return data.glass.scatter(scatter,dg,random,dbg);
-      if (type == TYPE_Lambertian)
+      if ((typeMask & typeBit(TYPE_Lambertian)) && type == TYPE_Lambertian)
         return data.lambertian.scatter(scatter,dg,random,dbg);
     }
 #endif
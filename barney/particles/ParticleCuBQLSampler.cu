@@ -0,0 +1,92 @@
+// SPDX-FileCopyrightText:
+// Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier:
+// Apache-2.0
+
+
+#include "barney/particles/ParticleCuBQLSampler.h"
+#include "barney/common/AccelCache.h"
+#include "barney/Context.h"
+
+namespace BARNEY_NS {
+
+  ParticleCuBQLSampler::ParticleCuBQLSampler(ParticleField *field)
+    : field(field),
+      devices(field->devices)
+  {
+    perLogical.resize(devices->numLogical);
+  }
+
+  ParticleCuBQLSampler::PLD *ParticleCuBQLSampler::getPLD(Device *device)
+  {
+    assert(device);
+    assert(device->contextRank() >= 0);
+    assert(device->contextRank() < perLogical.size());
+    return &perLogical[device->contextRank()];
+  }
+
+  ParticleCuBQLSampler::DD ParticleCuBQLSampler::getDD(Device *device)
+  {
+    DD dd;
+    (ParticleField::DD &)dd = field->getDD(device);
+    dd.bvh = getPLD(device)->bvh;
+    return dd;
+  }
+
+  void ParticleCuBQLSampler::build()
+  {
+    int numPrims = field->numParticles;
+    for (auto device : *devices) {
+      PLD *pld = getPLD(device);
+      bvh_t &bvh = pld->bvh;
+      if (bvh.nodes != nullptr) {
+        /* BVH already built! */
+        continue;
+      }
+
+      SetActiveGPU forDuration(device);
+
+      box3f *primBounds
+        = (box3f*)device->rtc->allocMem(numPrims*sizeof(box3f));
+      field->computeElementBBs(device,primBounds,nullptr);
+      device->rtc->sync();
+
+      uint64_t cacheKey = 0;
+      if (AccelCache::enabled()) {
+        cacheKey = AccelCache::keyFor(device,primBounds,numPrims,
+                                      typeName());
+        if (AccelCache::loadBVH(device,"particleCuBQL",cacheKey,bvh)) {
+          device->rtc->freeMem(primBounds);
+          continue;
+        }
+      }
+#if BARNEY_RTC_EMBREE || defined(__HIPCC__)
+      cuBQL::cpu::spatialMedian(bvh,
+                                (const cuBQL::box_t<float,3>*)primBounds,
+                                numPrims,
+                                cuBQL::BuildConfig());
+#else
+      /*! make sure to have cubql use regular device memory, not async
+        mallocs; else we may allocate all memory on the first gpu */
+      cuBQL::DeviceMemoryResource memResource;
+      cuBQL::gpuBuilder(bvh,
+                        (const cuBQL::box_t<float,3>*)primBounds,
+                        numPrims,
+                        cuBQL::BuildConfig(),
+                        0,
+                        memResource);
+#endif
+      device->rtc->sync();
+      if (AccelCache::enabled())
+        AccelCache::storeBVH(device,"particleCuBQL",cacheKey,bvh);
+      device->rtc->freeMem(primBounds);
+
+      if (FromEnv::get()->logConfig)
+        std::cout << OWL_TERMINAL_LIGHT_GREEN
+                  << "#bn.particles: cubql bvh over " << numPrims
+                  << " particles built ..."
+                  << OWL_TERMINAL_DEFAULT << std::endl;
+    }
+  }
+
+}
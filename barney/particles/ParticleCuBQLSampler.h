@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText:
+// Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier:
+// Apache-2.0
+
+
+#pragma once
+
+#include "barney/particles/ParticleField.h"
+#include "barney/volume/MCAccelerator.h"
+#include "barney/common/CuBQL.h"
+#include "cuBQL/traversal/fixedBoxQuery.h"
+
+namespace BARNEY_NS {
+
+  /*! a particle scalar field, with a CuBQL bvh over the particles'
+      support boxes for finding all particles that reach a point */
+  struct ParticleCuBQLSampler : public ScalarFieldSampler {
+    enum { BVH_WIDTH = 4 };
+    using bvh_t  = cuBQL::WideBVH<float,3,BVH_WIDTH>;
+    using node_t = typename bvh_t::Node;
+
+    struct DD : public ParticleField::DD {
+#if RTC_DEVICE_CODE
+      inline __rtc_device float sample(vec3f P, bool dbg = false) const;
+#endif
+      bvh_t bvh;
+    };
+    DD getDD(Device *device);
+
+    /*! per-device data - parent stores the particles, we just store
+      the bvh nodes */
+    struct PLD {
+      bvh_t bvh = { 0,0 };
+    };
+    PLD *getPLD(Device *device);
+    std::vector<PLD> perLogical;
+
+    ParticleCuBQLSampler(ParticleField *field);
+
+    /*! builds the string that allows for properly matching optix
+      device progs for this type */
+    inline static std::string typeName() { return "Particle_CuBQL"; }
+
+    void build() override;
+
+    ParticleField *const field;
+    const DevGroup::SP devices;
+  };
+
+#if RTC_DEVICE_CODE
+  inline __rtc_device
+  float ParticleCuBQLSampler::DD::sample(vec3f P, bool dbg) const
+  {
+    float sumWeights = 0.f;
+    float sumWeightedValues = 0.f;
+    auto lambda = [&](const uint32_t primID) -> int {
+      addKernelWeight(sumWeightedValues,sumWeights,primID,P);
+      return CUBQL_CONTINUE_TRAVERSAL;
+    };
+    cuBQL::box3f box; box.lower = box.upper = to_cubql(P);
+    cuBQL::fixedBoxQuery::forEachPrim(lambda,bvh,box);
+    return sumWeights == 0.f ? NAN : (sumWeightedValues / sumWeights);
+  }
+#endif
+}
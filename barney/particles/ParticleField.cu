@@ -0,0 +1,243 @@
+// SPDX-FileCopyrightText:
+// Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier:
+// Apache-2.0
+
+
+#include "rtcore/ComputeInterface.h"
+
+#include "barney/particles/ParticleField.h"
+#include "barney/Context.h"
+#include "barney/volume/MCGrid.cuh"
+#include "barney/particles/ParticleCuBQLSampler.h"
+
+namespace BARNEY_NS {
+
+  RTC_IMPORT_USER_GEOM(/*file*/ParticleMC,
+                       /*name*/ParticleMC,
+                       /*geomtype device data */
+                       MCVolumeAccel<ParticleCuBQLSampler>::DD,false,false);
+
+  enum { MC_GRID_SIZE = 256 };
+
+  /*! one thread per particle: extends the value range of every
+      macro cell its support box overlaps by the particle's value */
+  __rtc_global
+  void particlesRasterGrid(const rtc::ComputeInterface &ci,
+                           ParticleField::DD field,
+                           MCGrid::DD        grid)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= field.numParticles) return;
+
+    const box3f bounds = field.supportBounds(tid);
+    const float value  = field.values[tid];
+    const vec3f rcpSpacing = rcp(grid.gridSpacing);
+    vec3i lo = vec3i((bounds.lower-grid.gridOrigin)*rcpSpacing);
+    vec3i hi = vec3i((bounds.upper-grid.gridOrigin)*rcpSpacing);
+    lo = min(max(lo,vec3i(0)),grid.dims-vec3i(1));
+    hi = min(max(hi,vec3i(0)),grid.dims-vec3i(1));
+    for (int iz=lo.z;iz<=hi.z;iz++)
+      for (int iy=lo.y;iy<=hi.y;iy++)
+        for (int ix=lo.x;ix<=hi.x;ix++) {
+          const size_t cellID
+            = ix
+            + iy * (size_t)grid.dims.x
+            + iz * (size_t)grid.dims.x * (size_t)grid.dims.y;
+          auto &cell = grid.scalarRanges[cellID];
+          rtc::fatomicMin(&cell.lower,value);
+          rtc::fatomicMax(&cell.upper,value);
+        }
+#endif
+  }
+
+  /*! each thread computes the bounds of particlesPerThread
+      consecutive particles' supports, and only then does the
+      atomics */
+  __rtc_global
+  void particlesWorldBounds(const rtc::ComputeInterface &ci,
+                            box3f *pBounds,
+                            const ParticleField::DD dd,
+                            int particlesPerThread)
+  {
+#if RTC_DEVICE_CODE
+    int tid = ci.launchIndex().x;
+    int begin = tid*particlesPerThread;
+    int end   = min(begin+particlesPerThread,dd.numParticles);
+    if (begin >= end)
+      return;
+
+    box3f bb;
+    for (int pid=begin;pid<end;pid++)
+      bb.extend(dd.supportBounds(pid));
+    rtc::fatomicMin(&pBounds->lower.x,bb.lower.x);
+    rtc::fatomicMin(&pBounds->lower.y,bb.lower.y);
+    rtc::fatomicMin(&pBounds->lower.z,bb.lower.z);
+    rtc::fatomicMax(&pBounds->upper.x,bb.upper.x);
+    rtc::fatomicMax(&pBounds->upper.y,bb.upper.y);
+    rtc::fatomicMax(&pBounds->upper.z,bb.upper.z);
+#endif
+  }
+
+  __rtc_global
+  void particlesComputeElementBBs(const rtc::ComputeInterface &ci,
+                                  box3f         *d_primBounds,
+                                  range1f       *d_primRanges,
+                                  ParticleField::DD field)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= field.numParticles) return;
+
+    d_primBounds[tid] = field.supportBounds(tid);
+    if (d_primRanges) {
+      const float value = field.values[tid];
+      d_primRanges[tid] = range1f(value,value);
+    }
+#endif
+  }
+
+  ParticleField::ParticleField(Context *context,
+                               const DevGroup::SP &devices)
+    : ScalarField(context,devices)
+  {}
+
+  ParticleField::DD ParticleField::getDD(Device *device)
+  {
+    ParticleField::DD dd;
+
+    // inherited:
+    (ScalarField::DD &)dd = ScalarField::getDD(device);
+
+    dd.positions    = (const vec3f *)positions->getDD(device);
+    dd.radii        = radii ? (const float *)radii->getDD(device) : nullptr;
+    dd.values       = (const float *)values->getDD(device);
+    dd.radius       = radius;
+    dd.numParticles = numParticles;
+    return dd;
+  }
+
+  MCGrid::SP ParticleField::buildMCs()
+  {
+    if (mcGrid) return mcGrid;
+
+    mcGrid = std::make_shared<MCGrid>(devices);
+    auto &grid = *mcGrid;
+
+    float maxWidth = reduce_max(worldBounds.size());
+    vec3i dims = 1+vec3i(worldBounds.size() * ((MC_GRID_SIZE-1) / maxWidth));
+    if (FromEnv::get()->logConfig)
+      std::cout << OWL_TERMINAL_BLUE
+                << "#bn.particles: building initial macro cell grid of "
+                << dims << " MCs"
+                << OWL_TERMINAL_DEFAULT << std::endl;
+    grid.resize(dims);
+    grid.gridOrigin  = worldBounds.lower;
+    grid.gridSpacing = worldBounds.size() * rcp(vec3f(dims));
+
+    grid.clearCells();
+
+    for (auto device : *devices) {
+      __rtc_launch(device->rtc,
+                   particlesRasterGrid,
+                   divRoundUp(numParticles,128),128,
+                   this->getDD(device),grid.getDD(device));
+    }
+
+    for (auto device : *devices)
+      device->sync();
+
+    return mcGrid;
+  }
+
+  VolumeAccel::SP ParticleField::createAccel(Volume *volume)
+  {
+    auto sampler
+      = std::make_shared<ParticleCuBQLSampler>(this);
+    return std::make_shared<MCVolumeAccel<ParticleCuBQLSampler>>
+      (volume,
+       createGeomType_ParticleMC,
+       sampler);
+  }
+
+  void ParticleField::computeElementBBs(Device  *device,
+                                        box3f   *d_primBounds,
+                                        range1f *d_primRanges)
+  {
+    int bs = 128;
+    int nb = divRoundUp(numParticles,bs);
+    __rtc_launch(device->rtc, particlesComputeElementBBs,
+                 nb,bs,
+                 d_primBounds,
+                 d_primRanges,
+                 getDD(device));
+    device->sync();
+  }
+
+  bool ParticleField::set1f(const std::string &member,
+                            const float &value)
+  {
+    if (ScalarField::set1f(member,value)) return true;
+
+    if (member == "radius") {
+      radius = value;
+      return true;
+    }
+    return false;
+  }
+
+  bool ParticleField::setData(const std::string &member,
+                              const std::shared_ptr<Data> &value)
+  {
+    if (ScalarField::setData(member,value)) return true;
+
+    if (member == "positions") {
+      positions = value->as<PODData>();
+      return true;
+    }
+    if (member == "radii") {
+      radii = value ? value->as<PODData>() : PODData::SP{};
+      return true;
+    }
+    if (member == "values") {
+      values = value->as<PODData>();
+      return true;
+    }
+    return false;
+  }
+
+  void ParticleField::commit()
+  {
+    MemoryScope memScope(devices.get(),BN_MEMORY_VOLUME_FIELDS);
+    assert(positions);
+    assert(values);
+    numParticles = (int)positions->count;
+    assert(values->count == numParticles);
+    assert(!radii || radii->count == numParticles);
+    if (numParticles == 0) {
+      worldBounds = box3f();
+      return;
+    }
+
+    // ==================================================================
+    // compute world bounds, over the particles' supports
+    // ==================================================================
+    auto dev = (*devices)[0];
+    SetActiveGPU forDuration(dev);
+    auto rtc = dev->rtc;
+    worldBounds = box3f();
+    box3f *d_worldBounds = (box3f *)rtc->allocMem(sizeof(box3f));
+    rtc->copy(d_worldBounds,&worldBounds,sizeof(worldBounds));
+    const int particlesPerThread = 64;
+    __rtc_launch(// dev and kernel
+                 rtc,particlesWorldBounds,
+                 // launch config
+                 divRoundUp(divRoundUp(numParticles,particlesPerThread),128),128,
+                 // kernel args
+                 d_worldBounds,getDD(dev),particlesPerThread);
+    rtc->sync();
+    rtc->copy(&worldBounds,d_worldBounds,sizeof(worldBounds));
+    rtc->freeMem(d_worldBounds);
+  }
+}
@@ -0,0 +1,133 @@
+// SPDX-FileCopyrightText:
+// Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier:
+// Apache-2.0
+
+
+#pragma once
+
+#include "barney/Object.h"
+#include "barney/ModelSlot.h"
+
+namespace BARNEY_NS {
+
+  /*! a scalar field given by particles (eg, from SPH or cosmology
+      codes), each with a position, a (smoothing kernel) support
+      radius, and a value. The field at a point P is the kernel-
+      weighted average of the values of all particles whose support
+      spheres contain P - ie, a normalized (Shepard) kernel
+      interpolation, with the usual cubic spline kernel - and NAN
+      where no particle reaches.
+
+      Since any such average lies within the range of the values
+      averaged, each particle's support box simply extends the value
+      ranges of the macro cells it overlaps, which makes for exact
+      majorants without ever resampling the particles into a grid */
+  struct ParticleField : public ScalarField
+  {
+    typedef std::shared_ptr<ParticleField> SP;
+
+    struct DD : public ScalarField::DD {
+#if RTC_DEVICE_CODE
+      inline __rtc_device float supportRadius(int pid) const;
+      inline __rtc_device box3f supportBounds(int pid) const;
+      /*! adds the kernel-weighted value of given particle at P to
+          sumWeightedValues, and the kernel weight to sumWeights; does
+          nothing if P is outside the particle's support */
+      inline __rtc_device void addKernelWeight(float &sumWeightedValues,
+                                               float &sumWeights,
+                                               int pid,
+                                               vec3f P) const;
+#endif
+      const vec3f *positions;
+      /*! per-particle support radii; if null, all use 'radius' */
+      const float *radii;
+      const float *values;
+      float        radius;
+      int          numParticles;
+    };
+
+    ParticleField(Context *context,
+                  const DevGroup::SP &devices);
+
+    DD getDD(Device *device);
+
+    // ------------------------------------------------------------------
+    /*! @{ parameter set/commit interface */
+    void commit() override;
+    bool setData(const std::string &member,
+                 const std::shared_ptr<Data> &value) override;
+    bool set1f(const std::string &member,
+               const float &value) override;
+    /*! @} */
+    // ------------------------------------------------------------------
+
+    MCGrid::SP buildMCs() override;
+
+    /*! computes, on specified device, the particles' support boxes
+        (and, if d_primRanges is non-null, their value ranges) for
+        cubql bvh construction */
+    void computeElementBBs(Device *device,
+                           box3f *d_primBounds,
+                           range1f *d_primRanges);
+
+    VolumeAccel::SP createAccel(Volume *volume) override;
+
+    PODData::SP/*3f*/ positions    = 0;
+    PODData::SP/*1f*/ radii        = 0;
+    PODData::SP/*1f*/ values       = 0;
+    /*! support radius of all particles, if there're no per-particle
+        radii */
+    float             radius       = 1.f;
+    int               numParticles = 0;
+  };
+
+
+#if RTC_DEVICE_CODE
+  /*! cubic spline (M4) smoothing kernel over q = r/h, with support
+      [0,1), and without its normalization constant - which for
+      kernels of support radius h is proportional to 1/h^3; see
+      addKernelWeight() */
+  inline __rtc_device
+  float sphKernel(float q)
+  {
+    if (q >= 1.f) return 0.f;
+    if (q < .5f) return 1.f - 6.f*q*q + 6.f*q*q*q;
+    const float oneMinusQ = 1.f-q;
+    return 2.f*oneMinusQ*oneMinusQ*oneMinusQ;
+  }
+
+  inline __rtc_device
+  float ParticleField::DD::supportRadius(int pid) const
+  {
+    return radii ? radii[pid] : radius;
+  }
+
+  inline __rtc_device
+  box3f ParticleField::DD::supportBounds(int pid) const
+  {
+    const vec3f P = positions[pid];
+    const float r = supportRadius(pid);
+    return box3f(P-r,P+r);
+  }
+
+  inline __rtc_device
+  void ParticleField::DD::addKernelWeight(float &sumWeightedValues,
+                                          float &sumWeights,
+                                          int pid,
+                                          vec3f P) const
+  {
+    const float h = supportRadius(pid);
+    const vec3f delta = P-positions[pid];
+    const float dist2 = dot(delta,delta);
+    if (!(dist2 < h*h)) return;
+    const float rcp_h = 1.f/h;
+    // particles of different radii have to get weighed with their
+    // kernels' normalization, or small ones wouldn't count
+    const float weight
+      = sphKernel(sqrtf(dist2)*rcp_h) * (rcp_h*rcp_h*rcp_h);
+    sumWeights        += weight;
+    sumWeightedValues += weight*values[pid];
+  }
+#endif
+}
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText:
+// Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier:
+// Apache-2.0
+
+/*! \file ParticleMC.dev.cu implements a macro-cell accelerated
+    particle (SPH) scalar field.
+
+    This particular volume type:
+
+    - uses cubql to find all particles whose support contains a
+      sample point (for the kernel-weighted scalar field evaluation)
+
+    - uses macro cells and DDA traversal for domain traversal
+*/
+
+#include "barney/particles/ParticleCuBQLSampler.h"
+#include "barney/volume/DDA.h"
+#include "rtcore/TraceInterface.h"
+
+RTC_DECLARE_GLOBALS(BARNEY_NS::render::OptixGlobals);
+
+namespace BARNEY_NS {
+
+  struct ParticleMC_Programs {
+
+    static inline __rtc_device
+    void bounds(const rtc::TraceInterface &ti,
+                const void *geomData,
+                owl::common::box3f &bounds,
+                const int32_t primID)
+    {
+#if RTC_DEVICE_CODE
+      MCVolumeAccel<ParticleCuBQLSampler>::boundsProg(ti,geomData,bounds,primID);
+#endif
+    }
+
+    static inline __rtc_device
+    void intersect(rtc::TraceInterface &ti)
+    {
+#if RTC_DEVICE_CODE
+      MCVolumeAccel<ParticleCuBQLSampler>::isProg(ti);
+#endif
+    }
+
+    static inline __rtc_device
+    void closestHit(rtc::TraceInterface &ti)
+    { /* nothing to do */ }
+
+    static inline __rtc_device
+    void anyHit(rtc::TraceInterface &ti)
+    { /* nothing to do */ }
+  };
+
+  using ParticleMC = MCVolumeAccel<ParticleCuBQLSampler>;
+
+  RTC_EXPORT_USER_GEOM(ParticleMC,
+                       ParticleMC::DD,
+                       ParticleMC_Programs,
+                       false,false);
+}
@@ -32,6 +32,9 @@ namespace BARNEY_NS {
         
       inline __rtc_device HitAttributes();
       inline __rtc_device vec4f get(Which attribute, bool dbg=false) const;
+      /*! how much given attribute's x/y changes per unit of
+          world-space distance around the hit point; 0 if not known */
+      inline __rtc_device float scaleOf(Which attribute) const;
       
       vec4f color;
       vec4f attribute[numAttributes];
@@ -44,6 +47,12 @@ namespace BARNEY_NS {
       int   primID;
       int   instID;
       float t;
+      /*! world-space width of the ray's cone at the hit, as seen on
+          the surface; 0 if either the ray or the geometry doesn't
+          provide one. Together with attributeScale[] this is what
+          samplers pick mip levels from */
+      float footprint = 0.f;
+      float attributeScale[numAttributes];
       bool  isShadowRay = false;
     };
 
@@ -56,6 +65,19 @@ namespace BARNEY_NS {
         attribute[i]
           // = vec4f(NAN,NAN,NAN,NAN);
           = vec4f(0.f,0.f,0.f,1.f);
+      for (int i=0;i<numAttributes;i++)
+        attributeScale[i] = 0.f;
+    }
+
+    inline __rtc_device
+    float HitAttributes::scaleOf(Which whichOne) const
+    {
+      if (whichOne >= ATTRIBUTE_0 && whichOne <= ATTRIBUTE_3)
+        return attributeScale[whichOne-ATTRIBUTE_0];
+      if (whichOne == WORLD_POSITION || whichOne == OBJECT_POSITION)
+        /* ignores the instance's scaling for object space */
+        return 1.f;
+      return 0.f;
     }
 
     inline __rtc_device
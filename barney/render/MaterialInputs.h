@@ -28,7 +28,7 @@ namespace BARNEY_NS {
 
       inline __rtc_device
       float4 MaterialInput::eval(const HitAttributes &hitData,
-                                 Sampler::DD *samplers) const
+                                 const Sampler::Table &samplers) const
       {
         if (type == VALUE)
           return value;
@@ -16,41 +16,49 @@ namespace BARNEY_NS {
     MaterialRegistry::MaterialRegistry(const DevGroup::SP &devices)
       : devices(devices)
     {
-      numReserved = 1;
       perLogical.resize(devices->numLogical);
+      MemoryScope memScope(devices.get(),BN_MEMORY_MATERIALS);
       
-      for (auto device : *devices)
-        getPLD(device)->buffer
-          = device->rtc->createBuffer(numReserved*sizeof(DeviceMaterial));
+      const size_t tableSize
+        = PagedArray<DeviceMaterial>::maxPages*sizeof(DeviceMaterial*);
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        PLD *pld = getPLD(device);
+        pld->pageTable = (DeviceMaterial**)device->rtc->allocMem(tableSize);
+        device->rtc->memsetAsync(pld->pageTable,0,tableSize);
+      }
+      grow();
     }
 
     MaterialRegistry::~MaterialRegistry()
     {
-      // owlBufferRelease(buffer);
-      for (auto device : *devices)
-        device->rtc->freeBuffer(getPLD(device)->buffer);
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        PLD *pld = getPLD(device);
+        for (auto page : pld->pages)
+          device->rtc->freeBuffer(page);
+        device->rtc->freeMem(pld->pageTable);
+      }
     }
     
     void MaterialRegistry::grow()
     {
-      size_t oldNumBytes = numReserved * sizeof(DeviceMaterial);
-      numReserved *= 2;
-      size_t newNumBytes = numReserved * sizeof(DeviceMaterial);
+      const int pageID = numReserved / PagedArray<DeviceMaterial>::pageSize;
+      if (pageID >= PagedArray<DeviceMaterial>::maxPages)
+        throw std::runtime_error("#barney: too many materials");
+      MemoryScope memScope(devices.get(),BN_MEMORY_MATERIALS);
       for (auto device : *devices) {
-      // ------------------------------------------------------------------
-      // save old materials
-      // ------------------------------------------------------------------
+        SetActiveGPU forDuration(device);
         PLD *pld = getPLD(device);
-        rtc::Buffer *oldBuffer = pld->buffer;
         auto rtc = device->rtc;
-        
-        rtc::Buffer *newBuffer
-          = rtc->createBuffer(newNumBytes);
-        rtc->copyAsync(newBuffer->getDD(),oldBuffer->getDD(),oldNumBytes);
-        rtc->sync();
-        rtc->freeBuffer(oldBuffer);
-        pld->buffer = newBuffer;
+        rtc::Buffer *page
+          = rtc->createBuffer(PagedArray<DeviceMaterial>::pageSize
+                              *sizeof(DeviceMaterial));
+        pld->pages.push_back(page);
+        DeviceMaterial *pageMem = (DeviceMaterial *)page->getDD();
+        rtc->copy(pld->pageTable+pageID,&pageMem,sizeof(pageMem));
       }
+      numReserved += PagedArray<DeviceMaterial>::pageSize;
     }
 
     int MaterialRegistry::allocate()
@@ -74,10 +82,10 @@ namespace BARNEY_NS {
                                        const DeviceMaterial &dd,
                                        Device *device)
     {
-      // for (auto device : *devices) {
-        PLD *pld = getPLD(device);
-        pld->buffer->upload(&dd,sizeof(dd),sizeof(dd)*materialID);
-      // }
+      PLD *pld = getPLD(device);
+      const int pageID = materialID >> PagedArray<DeviceMaterial>::log2PageSize;
+      const int inPage = materialID & (PagedArray<DeviceMaterial>::pageSize-1);
+      pld->pages[pageID]->upload(&dd,sizeof(dd),sizeof(dd)*inPage);
     }
 
 
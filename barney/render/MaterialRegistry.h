@@ -8,12 +8,17 @@
 // #include "barney/material/Globals.h"
 // #include "barney/render/DeviceMaterial.h"
 #include "barney/render/Sampler.h"
+#include "barney/common/PagedArray.h"
 
 namespace BARNEY_NS {
   namespace render {
 
     struct DeviceMaterial;
     
+    /*! all of a slot's device materials, by material ID. Lives in
+        fixed-size pages (see PagedArray), so adding a material never
+        moves existing ones, and the getDD() that the world hands to
+        all programs never changes */
     struct MaterialRegistry {
       typedef std::shared_ptr<MaterialRegistry> SP;
     
@@ -22,25 +27,26 @@ namespace BARNEY_NS {
       
       int allocate();
       void release(int nowReusableID);
+      /*! adds one page */
       void grow();
 
       void setMaterial(int materialID,
                        const DeviceMaterial &dd,
                        Device *device);
-      // const DeviceMaterial *getPointer(int owlDeviceID) const;
     
       int numReserved = 0;
       int nextFree = 0;
     
       std::stack<int> reusableIDs;
-      // OWLBuffer       buffer = 0;
 
-      DeviceMaterial *getDD(Device *device) 
-      { return (DeviceMaterial *)getPLD(device)->buffer->getDD(); }
+      PagedArray<DeviceMaterial> getDD(Device *device) 
+      { return { getPLD(device)->pageTable }; }
 
       struct PLD {
-        rtc::Buffer *buffer = 0;
-        // Device      *device;
+        /*! PagedArray::maxPages entries, of which the first
+            pages.size() are in use */
+        DeviceMaterial **pageTable = 0;
+        std::vector<rtc::Buffer *> pages;
       };
       PLD *getPLD(Device *device);
       std::vector<PLD> perLogical;
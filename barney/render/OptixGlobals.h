@@ -49,6 +49,10 @@ namespace BARNEY_NS {
 
       /*! number of ryas in the queue */
       int              numRays;
+      /*! if non-null, numRays is only an upper bound on (and launch
+          size for) the number of rays, and the actual count is read
+          from this device-side value */
+      const int       *d_numRays;
 
       /*! this device's world to trace rays into */
       rtc::AccelHandle accel;
@@ -56,6 +60,11 @@ namespace BARNEY_NS {
 
       /*! cutting plane (nx,ny,nz,d); disabled when w <= -1e28 */
       vec4f            cutPlane{0.f, 0.f, 0.f, -1e30f};
+
+      /*! angle (in radians) one pixel of the current camera spans, for
+          estimating ray footprints; 0 if the camera doesn't have a
+          meaningful one (ie, anything but perspective) */
+      float            pixelAngle = 0.f;
     };
   }
 }
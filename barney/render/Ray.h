@@ -15,11 +15,20 @@ namespace BARNEY_NS {
 
 #define NEW_RNG 1
 
+    /*! paths get terminated when shaded at this depth */
+    enum { MAX_PATH_DEPTH = 10 };
+
     struct PathState {
       vec3h    throughput;
       int32_t  pixelID;
       float    misWeight;
       int      numDiffuseBounces;
+      /*! accumID of the sample this path belongs to, and how many
+          bounces it did so far. with wave-front merging the same ray
+          queue can contain paths of different samples and different
+          depths, so this can no longer be a per-launch value */
+      int      accumID;
+      int      pathDepth;
 #if BARNEY_USE_MULTI_SCATTERING
       int      numVolumeBounces;
 #endif
@@ -29,6 +38,10 @@ namespace BARNEY_NS {
       vec3f    org;
       vec3f    dir;
       float    tMax;
+      /*! the ray's cone (see Ray::coneWidth), so rays traced on other
+          ranks still pick the right mip levels */
+      half     coneWidth;
+      half     coneSpread;
       struct {
         uint32_t isInMedium : 1;
         uint32_t isSpecular : 1;
@@ -45,6 +58,30 @@ namespace BARNEY_NS {
       uint16_t bsdfType   : 4;
       PackedBSDF::Data hitBSDF;
     };
+
+    /*! wire format a RayOnly gets compressed to when shipping rays
+        between ranks with BARNEY_CONFIG=compressRays=1: the
+        direction goes into two 14-bit octahedral coordinates, and
+        the ray's four flags into the remaining bits; the cone goes
+        along as is */
+    struct CompressedRay {
+      vec3f    org;
+      float    tMax;
+      uint32_t flagsAndDir;
+      half     coneWidth;
+      half     coneSpread;
+    };
+
+    /*! wire format a HitOnly gets compressed to. The hit point isn't
+        sent at all; the rank that owns the ray recomputes it from
+        its own ray (see applyHit()). The normal goes into two 13-bit
+        octahedral coordinates, and shares its word with the bsdf type
+        and a has-normal bit (volume hits don't have a normal) */
+    struct CompressedHit {
+      float    tHit;
+      uint32_t typeAndNormal;
+      PackedBSDF::Data hitBSDF;
+    };
     
     struct Ray {
 #if RTC_DEVICE_CODE
@@ -63,6 +100,9 @@ namespace BARNEY_NS {
       inline __rtc_device PackedBSDF getBSDF() const;
       inline __rtc_device void setHit(vec3f P, vec3f N, float t,
                                     const PackedBSDF &packedBSDF);
+      /*! marks a shadow ray as occluded at distance t */
+      inline __rtc_device void setOccluded(float t)
+      { bsdfType = PackedBSDF::TYPE_Occluded; tMax = t; }
       
       inline __rtc_device bool hadHit() const { return bsdfType != PackedBSDF::NONE; }
       inline __rtc_device void clearHit(float newTMax = BARNEY_INF)
@@ -71,15 +111,27 @@ namespace BARNEY_NS {
       inline __rtc_device void packNormal(vec3f N);
       inline __rtc_device vec3f unpackNormal() const;
       inline __rtc_device vec3f getN() const  { return unpackNormal(); }
+
+      /*! width of the ray's cone at distance t along the ray */
+      inline __rtc_device float coneWidthAt(float t) const
+      { return (float)coneWidth + t*(float)coneSpread; }
 #endif
 
+      /* the 'hot' part of the ray, which is all that tracing reads
+         (see TraceRays::run()). keep this first, and together, so
+         the trace kernel can fetch it with as few loads as
+         possible */
       vec3f   org;
       vec3f   dir;
       float   tMax;
+      /*! ray cone (for picking texture mip levels): the cone's width
+          at the ray's origin, and how much that grows per unit of
+          distance along the ray. Both zero means no footprint, ie,
+          always the finest level. These fit into what would
+          otherwise be padding before the rng seed */
+      half    coneWidth;
+      half    coneSpread;
       RNGSeed rngSeed;
-
-      vec3f       P;
-      vec3h       N;
       struct {
         uint16_t bsdfType   : 4;
         uint16_t isInMedium : 1;
@@ -87,11 +139,23 @@ namespace BARNEY_NS {
         uint16_t isShadowRay: 1;
         uint16_t crosshair  : 1;
         uint16_t _dbg       : 1;
+        /*! camera ray whose hit already came out of the frame
+            buffer's primary hit cache, so doesn't get traced (see
+            PrimaryHitCache) */
+        uint16_t preTraced  : 1;
+        /*! ray (shadow or bounce) that left a volume scatter event;
+            whatever it delivers trains the volume guiding grid (see
+            VolumeGuiding) */
+        uint16_t fromVolume : 1;
       };
       inline __rtc_device bool dbg() const {
         return _dbg;
       }
-      
+
+      /* the hit part, which tracing only ever writes (and only if
+         it finds a hit), and shading reads */
+      vec3f       P;
+      vec3h       N;
       union {
         PackedBSDF::Data hitBSDF;
         bn_float4 missColor;
@@ -149,6 +213,17 @@ namespace BARNEY_NS {
     }
 #endif
 
+    /*! shadow rays that haven't been found occluded (yet) carry the
+        transmittance of the volumes they've passed so far in the
+        first word of their - otherwise unused - hit bsdf, so it
+        travels along with their hits between ranks (see
+        reduceHitsInto()). Only volumes doing ratio tracking ever
+        lower it below 1 */
+    inline __rtc_device float &shadowTransmittance(PackedBSDF::Data &data)
+    { return *(float *)&data; }
+    inline __rtc_device float shadowTransmittance(const PackedBSDF::Data &data)
+    { return *(const float *)&data; }
+    
     inline __rtc_device
     void makeShadowRay(Ray &ray,
                        PathState &state,
@@ -156,9 +231,12 @@ namespace BARNEY_NS {
     {
       ray.bsdfType = PackedBSDF::NONE;
       ray.isShadowRay = true;
+      ray.preTraced = false;
+      ray.fromVolume = false;
       ray.dir = _dir;
       ray.org = _org;
       ray.tMax = len;
+      shadowTransmittance(ray.hitBSDF) = 1.f;
       state.throughput = _tp;
     }
 
@@ -172,6 +250,152 @@ namespace BARNEY_NS {
       return (vec3f)N;
     }
     
+    /*! maps a unit vector to a point in [-1,1]^2 on the unfolded
+        octahedron, and back */
+    inline __rtc_device vec2f octahedralEncode(vec3f v)
+    {
+      v *= 1.f/(fabsf(v.x)+fabsf(v.y)+fabsf(v.z));
+      if (v.z >= 0.f) return vec2f(v.x,v.y);
+      return vec2f((1.f-fabsf(v.y))*(v.x >= 0.f ? 1.f : -1.f),
+                   (1.f-fabsf(v.x))*(v.y >= 0.f ? 1.f : -1.f));
+    }
+
+    inline __rtc_device vec3f octahedralDecode(vec2f uv)
+    {
+      vec3f v(uv.x,uv.y,1.f-fabsf(uv.x)-fabsf(uv.y));
+      if (v.z < 0.f)
+        v = vec3f((1.f-fabsf(uv.y))*(uv.x >= 0.f ? 1.f : -1.f),
+                  (1.f-fabsf(uv.x))*(uv.y >= 0.f ? 1.f : -1.f),
+                  v.z);
+      return normalize(v);
+    }
+
+    /*! unit vector to 2*numBits bits, and back */
+    inline __rtc_device uint32_t quantizeDirection(vec3f v, int numBits)
+    {
+      const float maxValue = float((1u<<numBits)-1);
+      vec2f uv = octahedralEncode(v);
+      uint32_t u = uint32_t(roundf((min(1.f,max(-1.f,uv.x))*.5f+.5f)*maxValue));
+      uint32_t w = uint32_t(roundf((min(1.f,max(-1.f,uv.y))*.5f+.5f)*maxValue));
+      return u | (w << numBits);
+    }
+    
+    inline __rtc_device vec3f dequantizeDirection(uint32_t bits, int numBits)
+    {
+      const uint32_t mask = (1u<<numBits)-1;
+      const float scale = 2.f/float(mask);
+      return octahedralDecode(vec2f((bits & mask)*scale-1.f,
+                                    ((bits >> numBits) & mask)*scale-1.f));
+    }
+
+    inline __rtc_device CompressedRay compressRay(const Ray &ray)
+    {
+      CompressedRay cr;
+      cr.org  = ray.org;
+      cr.tMax = ray.tMax;
+      cr.coneWidth  = ray.coneWidth;
+      cr.coneSpread = ray.coneSpread;
+      cr.flagsAndDir
+        = (ray.isInMedium  ? 1u : 0u)
+        | (ray.isSpecular  ? 2u : 0u)
+        | (ray.isShadowRay ? 4u : 0u)
+        | (ray._dbg        ? 8u : 0u)
+        | (quantizeDirection(ray.dir,14) << 4);
+      return cr;
+    }
+
+    /*! the direction a ray gets traced with on other ranks once it
+        has gone through compressRay() */
+    inline __rtc_device vec3f compressedDirection(const Ray &ray)
+    {
+      return dequantizeDirection(quantizeDirection(ray.dir,14),14);
+    }
+    
+    inline __rtc_device void decompressRay(Ray &ray, const CompressedRay &cr)
+    {
+      ray.org         = cr.org;
+      ray.tMax        = cr.tMax;
+      ray.dir         = dequantizeDirection(cr.flagsAndDir >> 4,14);
+      ray.isInMedium  = (cr.flagsAndDir & 1) != 0;
+      ray.isSpecular  = (cr.flagsAndDir & 2) != 0;
+      ray.isShadowRay = (cr.flagsAndDir & 4) != 0;
+      ray._dbg        = (cr.flagsAndDir & 8) != 0;
+      ray.preTraced   = false;
+      ray.bsdfType    = PackedBSDF::NONE;
+      ray.coneWidth   = cr.coneWidth;
+      ray.coneSpread  = cr.coneSpread;
+      shadowTransmittance(ray.hitBSDF) = 1.f;
+    }
+
+    inline __rtc_device CompressedHit compressHit(const Ray &ray)
+    {
+      CompressedHit ch;
+      ch.tHit = ray.tMax;
+      ch.typeAndNormal = ray.bsdfType;
+      vec3f N = ray.unpackNormal();
+      if (N != vec3f(0.f))
+        ch.typeAndNormal |= 0x10 | (quantizeDirection(N,13) << 5);
+      ch.hitBSDF = ray.hitBSDF;
+      return ch;
+    }
+    
+    inline __rtc_device int hitBSDFType(const HitOnly &hit)
+    { return hit.bsdfType; }
+    inline __rtc_device int hitBSDFType(const CompressedHit &hit)
+    { return hit.typeAndNormal & 0xf; }
+    
+    /*! hit found by any rank (possibly this one) for a ray that
+        this rank owns */
+    inline __rtc_device void applyHit(Ray &ray, const HitOnly &hit)
+    {
+      ray.tMax     = hit.tHit;
+      ray.bsdfType = hit.bsdfType;
+      ray.hitBSDF  = hit.hitBSDF;
+      ray.P        = hit.P;
+      ray.N        = hit.N;
+    }
+    
+    inline __rtc_device void applyHit(Ray &ray, const CompressedHit &hit)
+    {
+      ray.tMax     = hit.tHit;
+      ray.bsdfType = hit.typeAndNormal & 0xf;
+      ray.hitBSDF  = hit.hitBSDF;
+      /* whoever found this hit traced the compressed ray, so that's
+         where the hit point is */
+      ray.P        = ray.org + hit.tHit * compressedDirection(ray);
+      ray.packNormal((hit.typeAndNormal & 0x10)
+                     ? dequantizeDirection(hit.typeAndNormal >> 5,13)
+                     : vec3f(0.f));
+    }
+
+    /*! merges the closest of the hits that numPeers ranks found for
+        the tid'th ray into that ray; hits are stored peer by peer,
+        nRays each. If slotOf is given, the ray's hit from a given
+        peer is at slotOf[peer*nRays+tid] within that peer's hits, or
+        missing altogether if that is -1 (ie, if the ray never got
+        sent to that peer) */
+    template<typename HitT>
+    inline __rtc_device
+    void reduceHitsInto(Ray &ray,
+                        const HitT *hitsAllPeers,
+                        int tid,
+                        int nRays,
+                        int numPeers,
+                        const int *slotOf = nullptr)
+    {
+      for (int peer=0;peer<numPeers;peer++) {
+        int slot = slotOf ? slotOf[peer*nRays+tid] : tid;
+        if (slot < 0) continue;
+        const HitT &hit = hitsAllPeers[peer*nRays+slot];
+        if (ray.isShadowRay && hitBSDFType(hit) == PackedBSDF::NONE)
+          // each peer traced its part of the ray from a
+          // transmittance of 1, so they all multiply
+          shadowTransmittance(ray.hitBSDF) *= shadowTransmittance(hit.hitBSDF);
+        if (hit.tHit >= ray.tMax) continue;
+        applyHit(ray,hit);
+      }
+    }
+    
     inline __rtc_device
     bool boxTest(vec3f org, vec3f dir,
                  float &t0, float &t1,
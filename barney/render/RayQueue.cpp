@@ -22,14 +22,17 @@ namespace BARNEY_NS {
     traceAndShadeReadQueue.free(rtc);
     receiveAndShadeWriteQueue.free(rtc);
     if (_d_nextWritePos) rtc->freeMem(_d_nextWritePos);
+    if (_d_numActive) rtc->freeMem(_d_numActive);
+    if (_d_sortBuckets) rtc->freeMem(_d_sortBuckets);
     rtc->freeHost(h_numActive);
   }
 
-  void SingleQueue::alloc(rtc::Device *rtc, int size)
+  void SingleQueue::alloc(rtc::Device *rtc, int size, bool withHitIDs)
   {
     rays = (Ray *)rtc->allocMem(size*sizeof(Ray));
     states = (PathState *)rtc->allocMem(size*sizeof(PathState));
-    hitIDs = (HitIDs *)rtc->allocMem(size*sizeof(HitIDs));
+    if (withHitIDs)
+      hitIDs = (HitIDs *)rtc->allocMem(size*sizeof(HitIDs));
   }
   
   void SingleQueue::free(rtc::Device *rtc)
@@ -49,10 +52,30 @@ namespace BARNEY_NS {
     rtc->copyAsync(h_numActive,_d_nextWritePos,sizeof(int));
     rtc->sync();
     numActive = *h_numActive;
+    numActiveIsExact = true;
     if (FromEnv::get()->logQueues)
       printf("#bn: ## ray queue read numactive %i\n",numActive);
     return *h_numActive;
   }
+
+  void RayQueue::updateNumActiveAsync(bool readBack)
+  {
+    SetActiveGPU forDuration(device);
+    auto rtc = device->rtc;
+    rtc->copyAsync(_d_numActive,_d_nextWritePos,sizeof(int));
+    if (readBack)
+      rtc->copyAsync(h_numActive,_d_nextWritePos,sizeof(int));
+  }
+  
+  void RayQueue::finishReadNumActive()
+  {
+    SetActiveGPU forDuration(device);
+    device->rtc->sync();
+    numActive = *h_numActive;
+    numActiveIsExact = true;
+    if (FromEnv::get()->logQueues)
+      printf("#bn: ## ray queue read numactive %i\n",numActive);
+  }
     
   /*! how many rays are active in the *READ* queue */
   int RayQueue::numActiveRays() const
@@ -64,8 +87,9 @@ namespace BARNEY_NS {
   {
     SetActiveGPU forDuration(device);
     auto rtc = device->rtc;
+    // no sync: everything that uses the write position is ordered
+    // behind this on the same stream
     rtc->memsetAsync(_d_nextWritePos,0,sizeof(int));
-    rtc->sync();
   }
     
   void RayQueue::swapAfterGeneration()
@@ -86,6 +110,27 @@ namespace BARNEY_NS {
     std::swap(receiveAndShadeWriteQueue.rays, traceAndShadeReadQueue.rays);
     std::swap(receiveAndShadeWriteQueue.hitIDs, traceAndShadeReadQueue.hitIDs);
   }
+  void RayQueue::swapAfterSort()
+  {
+    if (FromEnv::get()->logQueues)
+      printf("#bn(%i): ## ray queue swap (after sort)\n",
+             device->globalRank());
+    std::swap(receiveAndShadeWriteQueue.rays, traceAndShadeReadQueue.rays);
+    std::swap(receiveAndShadeWriteQueue.states, traceAndShadeReadQueue.states);
+    std::swap(receiveAndShadeWriteQueue.hitIDs, traceAndShadeReadQueue.hitIDs);
+  }
+
+  int *RayQueue::getSortBuckets()
+  {
+    if (!_d_sortBuckets) {
+      SetActiveGPU forDuration(device);
+      MemoryScope memScope(device,BN_MEMORY_RAY_QUEUES);
+      _d_sortBuckets
+        = (int*)device->rtc->allocMem(numSortBuckets*sizeof(int));
+    }
+    return _d_sortBuckets;
+  }
+  
   void RayQueue::swapAfterShade()
   {
     if (FromEnv::get()->logQueues)
@@ -96,11 +141,27 @@ namespace BARNEY_NS {
     std::swap(receiveAndShadeWriteQueue.hitIDs, traceAndShadeReadQueue.hitIDs);
   }
   
+  void RayQueue::enableHitIDs()
+  {
+    if (withHitIDs) return;
+    withHitIDs = true;
+    if (size == 0) return;
+    SetActiveGPU forDuration(device);
+    MemoryScope memScope(device,BN_MEMORY_RAY_QUEUES);
+    for (auto queue : { &traceAndShadeReadQueue, &receiveAndShadeWriteQueue })
+      queue->hitIDs = (HitIDs *)device->rtc->allocMem(size*sizeof(HitIDs));
+  }
+
   void RayQueue::resize(int newSize)
   {
     if (newSize <= size) return;
+    if (size > 0 && !FromEnv::enabled("noFBCapacity"))
+      /* already had to grow before, so likely will again (eg, while
+         a window gets resized): leave some room */
+      newSize = std::max(newSize,size+size/2);
     
     SetActiveGPU forDuration(device);
+    MemoryScope memScope(device,BN_MEMORY_RAY_QUEUES);
     auto rtc = device->rtc;
     traceAndShadeReadQueue.free(rtc);
     receiveAndShadeWriteQueue.free(rtc);
@@ -112,15 +173,19 @@ namespace BARNEY_NS {
 
     if (!_d_nextWritePos) 
       _d_nextWritePos = (int*)rtc->allocMem(sizeof(int)); 
+    if (!_d_numActive) 
+      _d_numActive = (int*)rtc->allocMem(sizeof(int)); 
 
     // traceAndShadeReadQueue = (Ray*)rtc->allocMem(newSize*sizeof(Ray));
     // receiveAndShadeWriteQueue = (Ray*)rtc->allocMem(newSize*sizeof(Ray));
-    traceAndShadeReadQueue.alloc(rtc,newSize);
-    receiveAndShadeWriteQueue.alloc(rtc,newSize);
+    traceAndShadeReadQueue.alloc(rtc,newSize,withHitIDs);
+    receiveAndShadeWriteQueue.alloc(rtc,newSize,withHitIDs);
         
     size = newSize;
 
     resetWriteQueue();
+    rtc->memsetAsync(_d_numActive,0,sizeof(int));
+    rtc->sync();
   }
 }
 
@@ -16,13 +16,15 @@ namespace BARNEY_NS {
   using render::HitOnly;
 
   struct SingleQueue {
-    void alloc(rtc::Device *rtc, int size);
+    void alloc(rtc::Device *rtc, int size, bool withHitIDs);
     void free(rtc::Device *rtc);
     
     /*! the actual rays, will all need to be sent every cycle */
     Ray   *rays   = nullptr;
     
-    /*! must be sent over the network, but only for generation 0 */
+    /*! must be sent over the network, but only for generation 0;
+        null until a frame buffer first asks for an id channel (see
+        RayQueue::enableHitIDs()) */
     HitIDs *hitIDs = nullptr;
     
     /*! information we track per ray, but which will NOT be sent over
@@ -31,6 +33,18 @@ namespace BARNEY_NS {
   };
   
   struct RayQueue {
+    /*! what to (optionally) sort the rays in the read queue for; the
+        values are bits in the renderer's 'sortRays' parameter */
+    typedef enum { SORT_FOR_SHADE=1, SORT_FOR_TRACE=2 } SortFor;
+    enum { numSortBuckets = 256 };
+    /*! sort keys when sorting for shading: shadow rays and misses
+        first, then rays that hit something, by their bsdf's type */
+    enum ShadeSortKey { SHADE_KEY_SHADOW=0,
+                        SHADE_KEY_MISS,
+                        SHADE_KEY_FIRST_BSDF };
+    static inline __rtc_both int shadeKeyOf(int bsdfType)
+    { return SHADE_KEY_FIRST_BSDF+bsdfType; }
+    
     RayQueue(Device *device);
     ~RayQueue();
     int readNumActive();
@@ -53,11 +67,32 @@ namespace BARNEY_NS {
     /*! current write position in the write queue (during shading and
       ray generation) */
     int *_d_nextWritePos  = 0;
+
+    /*! device-side copy of how many rays are active in the *READ*
+        queue; this gets updated in stream order after every
+        generate/shade, so kernels can use it even if the host hasn't
+        read back the count yet (see numActiveIsExact) */
+    int *_d_numActive     = 0;
     
-    /*! how many rays are active in the *READ* queue */
+    /*! how many rays are active in the *READ* queue; if
+        numActiveIsExact is false this is only an upper bound, and
+        kernels have to read the actual count from _d_numActive */
     int  numActive = 0;
+    bool numActiveIsExact = true;
     int  size      = 0;
 
+    /*! enqueues (without syncing) an update of _d_numActive from the
+        write position of the op that just got launched, and, if
+        requested, a read-back of that value to h_numActive. */
+    void updateNumActiveAsync(bool readBack);
+    /*! waits for a previously enqueued read-back, and updates
+        numActive from it */
+    void finishReadNumActive();
+    /*! returns the device-side active count if numActive is only an
+        upper bound, null otherwise */
+    const int *d_numActiveIfNotExact() const
+    { return numActiveIsExact ? nullptr : _d_numActive; }
+
     Device *device = 0;
 
     void resetWriteQueue();
@@ -72,8 +107,26 @@ namespace BARNEY_NS {
     void swapAfterShade();
     void swapAfterGeneration();
     void swapAfterCycle(int cycleID, int numCycles);
-
+    void swapAfterSort();
+
+    /*! device-side counters for sorting rays by key; allocated on
+        first use */
+    int *getSortBuckets();
+    int *_d_sortBuckets = 0;
+    /*! whether the read queue got sorted for shading, in which case
+        the sort buckets' (end) offsets say which range of rays has
+        which shade sort key; gets cleared once those rays got
+        shaded */
+    bool sortedForShade = false;
+
+    /*! makes sure the queues have room for (at least) newSize rays;
+        they never shrink, and grow geometrically */
     void resize(int newSize);
+    /*! makes both queues carry hit IDs from now on; they only get
+        allocated once some frame buffer actually needs them, since
+        most apps never read any id channel */
+    void enableHitIDs();
+    bool withHitIDs = false;
   };
 
 }
@@ -10,8 +10,9 @@ namespace BARNEY_NS {
 
   /*! the base class for _any_ other type of object/actor in the
       barney class hierarchy */
-  Renderer::Renderer(Context *context)
-    : barney_api::Renderer(context)
+  Renderer::Renderer(Context *context, bool rayCastOnly)
+    : barney_api::Renderer(context),
+      rayCastOnly(rayCastOnly)
   {}
 
   /*! pretty-printer for printf-debugging */
@@ -20,19 +21,34 @@ namespace BARNEY_NS {
     return "barney::Renderer";
   }
 
-  Renderer::SP Renderer::create(Context *context)
-  { return std::make_shared<Renderer>(context); }
+  Renderer::SP Renderer::create(Context *context, const std::string &type)
+  { return std::make_shared<Renderer>(context,type == "raycast"); }
 
   void Renderer::commit()
   {
     bgColor         = staged.bgColor;
     ambientRadiance = staged.ambientRadiance;
-    pathsPerPixel   = staged.pathsPerPixel;
+    aoSamples       = std::max(0,staged.aoSamples);
+    aoRadius        = staged.aoRadius;
+    /* two occlusion rays per primary hit and sample, so more than
+       that take more samples */
+    pathsPerPixel
+      = std::max(staged.pathsPerPixel,(aoSamples+1)/2);
     bgTexture       = staged.bgTexture;
     cutPlane        = staged.cutPlane;
+    sortRays        = staged.sortRays;
+    adaptiveThreshold  = staged.adaptiveThreshold;
+    adaptiveMinSamples = staged.adaptiveMinSamples;
+    /* there are no light samples to re-use without light sampling */
+    restirDI           = (rayCastOnly || aoSamples) ? 0 : staged.restirDI;
+    targetFrameTime    = staged.targetFrameTime;
+    lowDiscrepancy     = staged.lowDiscrepancy;
+    russianRouletteDepth = std::max(0,staged.russianRouletteDepth);
+    throughputCutoff     = std::max(0.f,staged.throughputCutoff);
 #if BARNEY_USE_MULTI_SCATTERING
     maxVolumeBounces = staged.maxVolumeBounces;
     volumeMultiScatter = staged.volumeMultiScatter;
+    volumeGuiding = std::min(std::max(0.f,staged.volumeGuiding),.95f);
 #endif
   }
   
@@ -56,6 +72,28 @@ namespace BARNEY_NS {
       staged.ambientRadiance = value;
       return true;
     }
+    if (member == "adaptiveThreshold") {
+      staged.adaptiveThreshold = value;
+      return true;
+    }
+    if (member == "targetFrameTime") {
+      staged.targetFrameTime = value;
+      return true;
+    }
+    if (member == "aoRadius") {
+      staged.aoRadius = value;
+      return true;
+    }
+    if (member == "throughputCutoff") {
+      staged.throughputCutoff = value;
+      return true;
+    }
+#if BARNEY_USE_MULTI_SCATTERING
+    if (member == "volumeGuiding") {
+      staged.volumeGuiding = value;
+      return true;
+    }
+#endif
     return false;
   }
   
@@ -71,6 +109,30 @@ namespace BARNEY_NS {
       staged.crosshairs = value;
       return true;
     }
+    if (member == "sortRays") {
+      staged.sortRays = value;
+      return true;
+    }
+    if (member == "adaptiveMinSamples") {
+      staged.adaptiveMinSamples = value;
+      return true;
+    }
+    if (member == "restirDI") {
+      staged.restirDI = value;
+      return true;
+    }
+    if (member == "aoSamples") {
+      staged.aoSamples = value;
+      return true;
+    }
+    if (member == "lowDiscrepancySampling") {
+      staged.lowDiscrepancy = value;
+      return true;
+    }
+    if (member == "russianRouletteDepth") {
+      staged.russianRouletteDepth = value;
+      return true;
+    }
 #if BARNEY_USE_MULTI_SCATTERING
     if (member == "maxVolumeBounces") {
       staged.maxVolumeBounces = value;
@@ -109,6 +171,16 @@ namespace BARNEY_NS {
     dd.ambientRadiance = ambientRadiance;
     dd.pathsPerPixel = pathsPerPixel;
     dd.cutPlane = cutPlane;
+    dd.transparentBackground = false;
+    dd.rayCastOnly = rayCastOnly;
+    dd.aoSamples = std::min(aoSamples,2);
+    dd.aoRadius = aoRadius;
+    dd.lowDiscrepancy = lowDiscrepancy;
+    dd.sampleStride = 1;
+    dd.sampleOffset = 0;
+    dd.scrambleSalt = 0;
+    dd.russianRouletteDepth = russianRouletteDepth;
+    dd.throughputCutoff = throughputCutoff;
 #if BARNEY_USE_MULTI_SCATTERING
     dd.maxVolumeBounces = maxVolumeBounces;
     dd.volumeMultiScatter = volumeMultiScatter;
@@ -23,19 +23,43 @@ namespace BARNEY_NS {
       float              ambientRadiance;
       int                pathsPerPixel;
       vec4f              cutPlane;
+      /*! if set, primary rays that miss everything are fully
+          transparent (for sort-last layers, which get their
+          background only after compositing) */
+      int                transparentBackground;
+      /*! see Renderer::rayCastOnly */
+      int                rayCastOnly;
+      /*! see Renderer::aoSamples; rays per primary hit, 0 if off */
+      int                aoSamples;
+      float              aoRadius;
+      /*! see Renderer::lowDiscrepancy */
+      int                lowDiscrepancy;
+      /*! global sample index of accumID'th sample is
+          accumID*sampleStride+sampleOffset (differs from accumID for
+          sample-parallel rendering) */
+      int                sampleStride;
+      int                sampleOffset;
+      /*! hashed in with pixel IDs for per-pixel scrambles; see
+          FrameBuffer::setSampleIndexing() */
+      uint32_t           scrambleSalt;
+      /*! see Renderer::russianRouletteDepth, throughputCutoff */
+      int                russianRouletteDepth;
+      float              throughputCutoff;
 #if BARNEY_USE_MULTI_SCATTERING
       int                maxVolumeBounces;
       int                volumeMultiScatter;
 #endif
     };
     
-    Renderer(Context *context);
+    Renderer(Context *context, bool rayCastOnly=false);
     virtual ~Renderer() {}
 
     /*! pretty-printer for printf-debugging */
     std::string toString() const override;
 
-    static SP create(Context *context);
+    /*! "raycast" creates a rayCastOnly renderer; anything else
+        ("default", "pathTracer", ...) the path tracer */
+    static SP create(Context *context, const std::string &type);
 
     DD getDD(Device *device) const;
     
@@ -57,20 +81,84 @@ namespace BARNEY_NS {
       float       ambientRadiance = 1.f;
       int         crosshairs      = 0;
       vec4f       cutPlane        = vec4f(0,0,0,-1e30f);
+      int         sortRays        = 0;
+      float       adaptiveThreshold  = 0.f;
+      int         adaptiveMinSamples = 16;
+      int         restirDI           = 0;
+      float       targetFrameTime    = 0.f;
+      int         aoSamples          = 0;
+      float       aoRadius           = 1e20f;
+      int         lowDiscrepancy     = 0;
+      int         russianRouletteDepth = 0;
+      float       throughputCutoff     = 0.f;
 #if BARNEY_USE_MULTI_SCATTERING
       int         maxVolumeBounces = 8;
       int         volumeMultiScatter = 1;
+      float       volumeGuiding = 0.f;
 #endif
     } staged;
+    /*! "raycast" preview renderer: primary rays only, with hits
+        shaded by a headlight (of ambientRadiance brightness) and
+        volumes by their (stochastically sampled) emission-absorption
+        color; no shadow rays, no light sampling, no bounces. Fixed
+        at creation */
+    const bool  rayCastOnly;
     vec4f       bgColor         = vec4f(0,0,0,1.f);
     Texture::SP bgTexture       = 0;
     int         pathsPerPixel   = 1;
     float       ambientRadiance = 1.f;
     int         crosshairs      = 0;
     vec4f       cutPlane        = vec4f(0,0,0,-1e30f);
+    /*! bitmask of RayQueue::SortFor values; if set, the ray queue
+        gets re-ordered for coherence before shading and/or before
+        tracing secondary rays */
+    int         sortRays        = 0;
+    /*! if > 0, tiles whose estimated (relative) error drops below
+        this stop getting new samples, once they have at least
+        adaptiveMinSamples samples; see TiledFB::ConvergenceTile */
+    float       adaptiveThreshold  = 0.f;
+    int         adaptiveMinSamples = 16;
+    /*! if set, primary hits' direct lighting from quad, point and
+        directional lights uses per-pixel reservoirs that get re-used
+        over time and across neighboring pixels (ReSTIR), rather than
+        sampling lights from scratch for every sample */
+    int         restirDI           = 0;
+    /*! if > 0, a frame keeps rendering more waves of pathsPerPixel
+        samples each for as long as the next one is expected to
+        finish within this many milliseconds (counted from the frame's
+        start); the first wave always gets rendered */
+    float       targetFrameTime    = 0.f;
+    /*! if > 0, ambient occlusion mode: every primary hit casts this
+        many cosine-distributed occlusion rays of (at most) aoRadius
+        length, and its pixel gets ambientRadiance times the fraction
+        that got through; no materials, lights or bounces. Since a
+        hit has only two ray queue slots, more than two of those get
+        spread over as many samples as it takes (see commit()) */
+    int         aoSamples          = 0;
+    float       aoRadius           = 1e20f;
+    /*! if set, pixel jitter, lens, light selection and BSDF samples
+        come from a per-pixel Owen-scrambled Sobol sequence (see
+        sobol.h) rather than from pseudo-random numbers, which
+        converges faster at low sample counts */
+    int         lowDiscrepancy     = 0;
+    /*! if > 0, paths scattering at this or any larger path depth
+        (0 being the primary hit) survive only with a probability of
+        their (max component) throughput, .95 at most, and get
+        weighted up accordingly (russian roulette) */
+    int         russianRouletteDepth = 0;
+    /*! paths whose (max component) throughput drops below this get
+        terminated, at any depth; this one is biased, so it should be
+        well below anything visible */
+    float       throughputCutoff     = 0.f;
 #if BARNEY_USE_MULTI_SCATTERING
     int         maxVolumeBounces = 8;
     int         volumeMultiScatter = 1;
+    /*! if > 0, volume scatter events draw this fraction of their
+        bounce directions from a per-slot grid of directional
+        distributions that gets learned from the radiance earlier
+        frames' volume scatter events received (see VolumeGuiding),
+        rather than from the phase function alone */
+    float       volumeGuiding = 0.f;
 #endif
   };
 
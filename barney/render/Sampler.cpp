@@ -189,10 +189,16 @@ namespace BARNEY_NS {
           device->rtc->freeTexture(pld->rtcTexture);
         pld->rtcTexture = 0;
       }
+      streamer.reset();
 
       if (!textureData) {
         std::cerr << "WARNING: Image Sampler without any texture data?"
                   << std::endl;
+      } else if (numDims == 2 && textureData->hostOnly()) {
+        /* too large to be fully resident; stream it */
+        streamer = std::make_shared<TileStreamer>((Context *)context,
+                                                  devices,textureData,
+                                                  wrapModes);
       } else {
         rtc::TextureDesc desc;
         desc.filterMode = toRTC(filterMode);
@@ -200,12 +206,20 @@ namespace BARNEY_NS {
         desc.addressMode[1] = toRTC(wrapModes[1]);
         desc.addressMode[2] = toRTC(wrapModes[2]);
         desc.borderColor    = borderColor;
+        /* only 2D textures get sampled with a footprint (see
+           Sampler::DD::lodScale) */
+        desc.mipMaps
+          = (numDims == 2) && (filterMode == BN_TEXTURE_LINEAR)
+          && !textureData->isBlockCompressed();
+        /* building mip levels reads the texels on the device */
+        if (desc.mipMaps)
+          textureData->waitForUpload();
         for (auto device : *devices) {
           PLD *pld = getPLD(device);
           if (pld->rtcTexture)
             device->rtc->freeTexture(pld->rtcTexture);
           pld->rtcTexture
-            = textureData->getPLD(device)->rtc->createTexture(desc);
+            = textureData->getRTC(device)->createTexture(desc);
         };
       }
 
@@ -232,13 +246,29 @@ namespace BARNEY_NS {
       memcpy(&dd.inTransform.mat_x,&inTransform,sizeof(inTransform));
 
       PLD *pld = getPLD(device);
-      if (!pld->rtcTexture) {
+      if (streamer) {
+        dd.type        = Sampler::STREAMED_IMAGE2D;
+        dd.streamed    = streamer->getDD(device);
+        dd.numChannels = textureData->numChannels;
+      } else if (!pld->rtcTexture) {
         std::cout << "WARN: NO TEXTURE DATA ON IMAGE SAMPLER!" << std::endl;
         dd.texture = 0;
       } else {
         dd.texture = pld->rtcTexture->getDD();
         dd.numChannels = textureData->numChannels;
       }
+      dd.lodScale = 0.f;
+      if ((numDims == 2 && filterMode == BN_TEXTURE_LINEAR && pld->rtcTexture
+           && !textureData->isBlockCompressed())
+          || streamer) {
+        /* texels per unit of input attribute, averaged over both
+           directions */
+        const vec4f &mx = dd.inTransform.mat_x;
+        const vec4f &my = dd.inTransform.mat_y;
+        float det = fabsf(mx.x*my.y-mx.y*my.x);
+        vec3i dims = textureData->dims;
+        dd.lodScale = sqrtf(float(dims.x)*float(dims.y)*det);
+      }
       return dd;
     }
     
@@ -258,10 +288,93 @@ namespace BARNEY_NS {
     PrimitiveSampler::PrimitiveSampler(SlotContext *slotContext)
       : Sampler(slotContext)
     {
+      perLogical.resize(devices->numLogical);
     }
     
     PrimitiveSampler::~PrimitiveSampler()
-    {}
+    {
+      for (auto device : *devices) {
+        PLD *pld = getPLD(device);
+        if (pld->baked)
+          device->rtc->freeBuffer(pld->baked);
+        pld->baked = 0;
+      }
+    }
+
+    PrimitiveSampler::PLD *PrimitiveSampler::getPLD(Device *device) 
+    {
+      assert(device);
+      assert(device->contextRank() >= 0);
+      assert(device->contextRank() < perLogical.size());
+      return &perLogical[device->contextRank()];
+    }
+
+    /*! host-side version of AttributeArray::DD::valueAt(), plus the
+        ufixed8 type that only the primitive sampler accepts */
+    static bool primitiveValueAt(const uint8_t *array,
+                                 BNDataType type,
+                                 size_t i,
+                                 vec4f &v)
+    {
+      switch (type) {
+      case BN_UFIXED8_RGBA: {
+        vec4uc c = ((const vec4uc *)array)[i];
+        v = vec4f(c)*(1.f/255.f);
+        return true;
+      }
+      case BN_FLOAT:
+        v = vec4f(((const float *)array)[i],0.f,0.f,1.f);
+        return true;
+      case BN_FLOAT2: {
+        vec2f f = ((const vec2f *)array)[i];
+        v = vec4f(f.x,f.y,0.f,1.f);
+        return true;
+      }
+      case BN_FLOAT3: {
+        vec3f f = ((const vec3f *)array)[i];
+        v = vec4f(f.x,f.y,f.z,1.f);
+        return true;
+      }
+      case BN_FLOAT4:
+        v = ((const vec4f *)array)[i];
+        return true;
+      default:
+        return false;
+      }
+    }
+    
+    void PrimitiveSampler::commit()
+    {
+      for (auto device : *devices) {
+        PLD *pld = getPLD(device);
+        if (pld->baked)
+          device->rtc->freeBuffer(pld->baked);
+        pld->baked = 0;
+      }
+
+      if (arrayData && arrayOffset >= 0 && arrayOffset < (int)arrayData->count) {
+        /* data arrays don't keep a host copy, so fetch one from the
+           first device */
+        std::vector<uint8_t> array(arrayData->numBytes);
+        arrayData->download((*devices)[0],array.data());
+
+        const vec4f *M = (const vec4f *)&outTransform;
+        std::vector<vec4f> baked(arrayData->count-arrayOffset);
+        bool supported = true;
+        for (size_t i=0;supported && i<baked.size();i++) {
+          vec4f in;
+          supported = primitiveValueAt(array.data(),arrayType,
+                                       arrayOffset+i,in);
+          baked[i] = outOffset+in.x*M[0]+in.y*M[1]+in.z*M[2]+in.w*M[3];
+        }
+        if (supported)
+          for (auto device : *devices) 
+            getPLD(device)->baked
+              = device->rtc->createBuffer(baked.size()*sizeof(vec4f),
+                                          baked.data());
+      }
+      Sampler::commit();
+    }
     
     bool PrimitiveSampler::setData(const std::string &member,
                                    const std::shared_ptr<Data> &value)
@@ -297,12 +410,19 @@ namespace BARNEY_NS {
       (vec4f&)dd.outTransform.offset = outOffset;
       memcpy(&dd.outTransform.mat_x,&outTransform,sizeof(outTransform));
 
-      dd.arrayData
-        = arrayData
-        ? arrayData->getPLD(device)->rtcBuffer->getDD()
-        : 0;
-      dd.arrayOffset = arrayOffset;
-      dd.arrayType = arrayType;
+      PLD *pld = getPLD(device);
+      if (pld->baked) {
+        dd.arrayData   = pld->baked->getDD();
+        dd.arrayOffset = 0;
+        dd.arrayType   = BN_FLOAT4;
+      } else {
+        dd.arrayData
+          = arrayData
+          ? (void *)arrayData->getDD(device)
+          : 0;
+        dd.arrayOffset = arrayOffset;
+        dd.arrayType = arrayType;
+      }
       
       return dd;
     }
@@ -9,6 +9,8 @@
 #include "barney/common/Data.h"
 #include "barney/common/mat4.h"
 #include "barney/common/math.h"
+#include "barney/common/TileStreamer.h"
+#include "barney/common/PagedArray.h"
 #include <stack>
 #if RTC_DEVICE_CODE
 # include "rtcore/ComputeInterface.h"
@@ -41,6 +43,9 @@ namespace BARNEY_NS {
         IMAGE2D,
         IMAGE3D,
         PRIMITIVE,
+        /*! a 2D image whose texture data is host-only; see
+            TileStreamer */
+        STREAMED_IMAGE2D,
       } Type;
 
       struct DD {
@@ -54,6 +59,8 @@ namespace BARNEY_NS {
           arrayType   = other.arrayType;
           
           texture      = other.texture;
+          lodScale     = other.lodScale;
+          streamed     = other.streamed;
           inAttribute  = other.inAttribute;
           inTransform  = other.inTransform;
           outTransform = other.outTransform;
@@ -64,7 +71,13 @@ namespace BARNEY_NS {
         // image only:
         AttributeTransform inTransform;
         rtc::TextureObject texture;
+        /*! for 2D images: texels per unit of the input attribute,
+            to turn a hit's footprint into a mip level; 0 means the
+            texture doesn't have mips */
+        float              lodScale;
         uint8_t            numChannels;
+        // streamed image only:
+        TileStreamer::DD   streamed;
 
         // primitive sampler only:
         void              *arrayData;
@@ -76,6 +89,8 @@ namespace BARNEY_NS {
         uint8_t       inAttribute;
         AttributeTransform outTransform;
       };
+      /*! all samplers of a slot, by sampler ID; see SamplerRegistry */
+      typedef PagedArray<DD> Table;
 
       virtual DD getDD(Device *device) = 0;
 
@@ -124,6 +139,10 @@ namespace BARNEY_NS {
       DD getDD(Device *device) override;
     };
 
+    /*! sampler that looks up a per-primitive value. The array's
+        values never change between commits, and neither does the
+        out transform, so commit() already converts and transforms
+        them into a float4 array, and eval() does a single fetch */
     struct PrimitiveSampler : public Sampler {
       PrimitiveSampler(SlotContext *slotContext);
       ~PrimitiveSampler() override;
@@ -133,6 +152,7 @@ namespace BARNEY_NS {
       bool setData(const std::string &member,
                    const std::shared_ptr<Data> &value) override;
       bool set1i(const std::string &member, const int   &value) override;
+      void commit() override;
       /*! @} */
       // ------------------------------------------------------------------
       /*! pretty-printer for printf-debugging */
@@ -145,6 +165,14 @@ namespace BARNEY_NS {
       // format of the entries in the array
       BNDataType arrayType;
       int        arrayOffset = 0;
+
+      struct PLD {
+        /*! arrayData from arrayOffset on, with outTransform already
+            applied, as float4s */
+        rtc::Buffer *baked = 0;
+      };
+      PLD *getPLD(Device *device);
+      std::vector<PLD> perLogical;
     };
       
     /*! sampler that operates on rtc-supported texture types; can
@@ -185,6 +213,8 @@ namespace BARNEY_NS {
       BNTextureFilterMode  filterMode { BN_TEXTURE_LINEAR   };
       const int            numDims;
       std::shared_ptr<TextureData> textureData{ 0 };
+      /*! only if textureData is host-only */
+      TileStreamer::SP     streamer;
     };
     
 #if RTC_DEVICE_CODE
@@ -206,7 +236,10 @@ namespace BARNEY_NS {
       if (type == PRIMITIVE) {
         if (!arrayData)
           return vec4f(0.f,0.f,0.f,1.f);
-          
+
+        if (arrayType == BN_FLOAT4)
+          /* baked by PrimitiveSampler::commit() */
+          return ((const vec4f*)arrayData)[arrayOffset+inputs.primID];
         if (arrayType == BN_UFIXED8_RGBA) {
           vec4uc v = ((vec4uc*)arrayData)[arrayOffset+inputs.primID];
           return vec4f(v)*(1.f/255.f);
@@ -223,8 +256,21 @@ namespace BARNEY_NS {
       vec4f fromTex = coord;
       if (type == IMAGE1D) { 
         fromTex = rtc::tex1D<vec4f>(texture,coord.x);
-      } else if (type == IMAGE2D) {
-        fromTex = rtc::tex2D<vec4f>(texture,coord.x,coord.y);
+      } else if (type == IMAGE2D || type == STREAMED_IMAGE2D) {
+        float texelFootprint
+          = inputs.footprint
+          * inputs.scaleOf((AttributeKind)inAttribute)
+          * lodScale;
+        if (type == STREAMED_IMAGE2D)
+          fromTex = streamed.sample(vec2f(coord.x,coord.y),
+                                    texelFootprint > 1.f
+                                    ? log2f(texelFootprint)
+                                    : 0.f);
+        else if (texelFootprint > 1.f)
+          fromTex = rtc::tex2DLod<vec4f>(texture,coord.x,coord.y,
+                                         log2f(texelFootprint));
+        else
+          fromTex = rtc::tex2D<vec4f>(texture,coord.x,coord.y);
       } else if (type == IMAGE3D) {
         fromTex = rtc::tex3D<vec4f>(texture,coord.x,coord.y,coord.z);
       } else
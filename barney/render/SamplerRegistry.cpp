@@ -11,24 +11,27 @@ namespace BARNEY_NS {
     SamplerRegistry::SamplerRegistry(const DevGroup::SP &devices)
       : devices(devices)
     {
-      numReserved = 1;
       perLogical.resize(devices->numLogical);
+      MemoryScope memScope(devices.get(),BN_MEMORY_MATERIALS);
       
+      const size_t tableSize = Sampler::Table::maxPages*sizeof(Sampler::DD*);
       for (auto device : *devices) {
         SetActiveGPU forDuration(device);
-        getPLD(device)->memory
-          = (Sampler::DD*)device->rtc->allocMem(numReserved*sizeof(Sampler::DD));
-
-        if (size_t(getPLD(device)->memory) % 16)
-          throw std::runtime_error("sampler mem not aligned...");
+        PLD *pld = getPLD(device);
+        pld->pageTable = (Sampler::DD**)device->rtc->allocMem(tableSize);
+        device->rtc->memsetAsync(pld->pageTable,0,tableSize);
       }
+      grow();
     }
 
     SamplerRegistry::~SamplerRegistry()
     {
       for (auto device : *devices) {
         SetActiveGPU forDuration(device);
-        device->rtc->freeMem(getPLD(device)->memory);
+        PLD *pld = getPLD(device);
+        for (auto page : pld->pages)
+          device->rtc->freeMem(page);
+        device->rtc->freeMem(pld->pageTable);
       }
     }
      
@@ -39,23 +42,23 @@ namespace BARNEY_NS {
     
     void SamplerRegistry::grow()
     {
-      size_t oldNumBytes = numReserved * sizeof(Sampler::DD);
-      numReserved *= 2;
-      size_t newNumBytes = numReserved * sizeof(Sampler::DD)+128;
-      
+      const int pageID = numReserved / Sampler::Table::pageSize;
+      if (pageID >= Sampler::Table::maxPages)
+        throw std::runtime_error("#barney: too many samplers");
+      MemoryScope memScope(devices.get(),BN_MEMORY_MATERIALS);
       for (auto device : *devices) {
         SetActiveGPU forDuration(device);
-        // ------------------------------------------------------------------
-        // save old samplers
-        // ------------------------------------------------------------------
         PLD *pld = getPLD(device);
         auto rtc = device->rtc;
-        
-        Sampler::DD *oldMem = pld->memory;
-        pld->memory = (Sampler::DD*)rtc->allocMem(newNumBytes);
-        rtc->copy(pld->memory,oldMem,oldNumBytes);
-        rtc->freeMem(oldMem);
+        Sampler::DD *page
+          = (Sampler::DD*)rtc->allocMem(Sampler::Table::pageSize
+                                        *sizeof(Sampler::DD));
+        if (size_t(page) % 16)
+          throw std::runtime_error("sampler mem not aligned...");
+        pld->pages.push_back(page);
+        rtc->copy(pld->pageTable+pageID,&page,sizeof(page));
       }
+      numReserved += Sampler::Table::pageSize;
     }
 
     int SamplerRegistry::allocate()
@@ -80,9 +83,10 @@ namespace BARNEY_NS {
                                 Device *device)
     {
       SetActiveGPU forDuration(device);
-      size_t offset = samplerID*sizeof(dd);
       assert(samplerID >= 0 && samplerID < nextFree);
-      device->rtc->copy(((uint8_t*)getPLD(device)->memory)+offset,
+      const int pageID = samplerID >> Sampler::Table::log2PageSize;
+      const int inPage = samplerID & (Sampler::Table::pageSize-1);
+      device->rtc->copy(getPLD(device)->pages[pageID]+inPage,
                         &dd,sizeof(dd));
     }
     
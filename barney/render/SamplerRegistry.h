@@ -12,6 +12,8 @@ namespace BARNEY_NS {
   
   namespace render {
     
+    /*! all of a slot's samplers' device data, by sampler ID; paged
+        the same way as the MaterialRegistry */
     struct SamplerRegistry {
       typedef std::shared_ptr<SamplerRegistry> SP;
     
@@ -20,19 +22,23 @@ namespace BARNEY_NS {
       
       int allocate();
       void release(int nowReusableID);
+      /*! adds one page */
       void grow();
     
       void setDD(int samplerID, const Sampler::DD &, Device *device);
 
-      Sampler::DD *getDD(Device *device) 
-      { return (Sampler::DD *)getPLD(device)->memory; }
+      Sampler::Table getDD(Device *device) 
+      { return { getPLD(device)->pageTable }; }
 
       int numReserved = 0;
       int nextFree = 0;
       std::stack<int> reusableIDs;
       
       struct PLD {
-        Sampler::DD *memory = 0;
+        /*! Sampler::Table::maxPages entries, of which the first
+            pages.size() are in use */
+        Sampler::DD **pageTable = 0;
+        std::vector<Sampler::DD *> pages;
       };
       PLD *getPLD(Device *);
       std::vector<PLD> perLogical;
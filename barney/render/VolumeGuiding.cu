@@ -0,0 +1,155 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/render/VolumeGuiding.h"
+#include "barney/ModelSlot.h"
+#include "barney/Context.h"
+#if RTC_DEVICE_CODE
+# include "rtcore/ComputeInterface.h"
+#endif
+
+namespace BARNEY_NS {
+  namespace render {
+
+    /*! one thread per cell: folds the cell's training from the last
+        frame into its (decaying) histogram, clears the training, and
+        re-builds the cdf that sampling uses */
+    __rtc_global
+    void volumeGuidingUpdate(rtc::ComputeInterface ci,
+                             float *training,
+                             float *histogram,
+                             float *cdfs,
+                             float decay)
+    {
+#if RTC_DEVICE_CODE
+      const int cell = ci.launchIndex().x;
+      if (cell >= VolumeGuiding::numCells) return;
+      const int numBins = VolumeGuiding::numBins;
+      float *hist = histogram+cell*numBins;
+      float *train = training+cell*numBins;
+      float *cdf = cdfs+cell*numBins;
+      float sum = 0.f;
+      for (int i=0;i<numBins;i++) {
+        hist[i] = decay*hist[i] + train[i];
+        train[i] = 0.f;
+        sum += hist[i];
+        cdf[i] = sum;
+      }
+      const float scale = sum > 0.f ? 1.f/sum : 0.f;
+      for (int i=0;i<numBins;i++)
+        cdf[i] *= scale;
+      // make sure rounding doesn't leave the last entry short of 1,
+      // which is what marks a cell that has data
+      if (sum > 0.f)
+        cdf[numBins-1] = 1.f;
+#endif
+    }
+
+    VolumeGuiding::VolumeGuiding(const DevGroup::SP &devices)
+      : devices(devices)
+    {
+      perLogical.resize(devices->numLogical);
+    }
+
+    VolumeGuiding::~VolumeGuiding()
+    {
+      free();
+    }
+
+    VolumeGuiding::PLD *VolumeGuiding::getPLD(Device *device)
+    {
+      assert(device);
+      assert(device->contextRank() >= 0);
+      assert(device->contextRank() < perLogical.size());
+      return &perLogical[device->contextRank()];
+    }
+
+    void VolumeGuiding::free()
+    {
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        PLD *pld = getPLD(device);
+        auto rtc = device->rtc;
+        if (pld->training)  rtc->freeMem(pld->training);
+        if (pld->histogram) rtc->freeMem(pld->histogram);
+        if (pld->cdfs)      rtc->freeMem(pld->cdfs);
+        *pld = PLD{};
+      }
+      bounds = box3f();
+    }
+
+    void VolumeGuiding::beginFrame(ModelSlot *slot, float fraction)
+    {
+      this->fraction = fraction;
+      if (fraction <= 0.f) {
+        if (!bounds.empty()) free();
+        return;
+      }
+
+      box3f newBounds;
+      for (size_t instID=0;instID<slot->instances.groups.size();instID++) {
+        Group *group = slot->instances.groups[instID].get();
+        if (!group) continue;
+        for (auto volume : group->volumes) {
+          if (!volume || !volume->sf) continue;
+          const box3f box = volume->sf->worldBounds;
+          if (box.empty()) continue;
+          for (int c=0;c<8;c++) {
+            vec3f corner((c & 1) ? box.upper.x : box.lower.x,
+                         (c & 2) ? box.upper.y : box.lower.y,
+                         (c & 4) ? box.upper.z : box.lower.z);
+            newBounds.extend(xfmPoint(slot->instances.xfms[instID],corner));
+          }
+        }
+      }
+      if (newBounds.empty()) {
+        if (!bounds.empty()) free();
+        return;
+      }
+
+      const size_t numBytes = sizeof(float)*numCells*numBins;
+      if (newBounds.lower != bounds.lower || newBounds.upper != bounds.upper) {
+        // volumes moved (or this is the first frame): whatever got
+        // learned so far no longer applies
+        free();
+        bounds = newBounds;
+        for (auto device : *devices) {
+          SetActiveGPU forDuration(device);
+          PLD *pld = getPLD(device);
+          auto rtc = device->rtc;
+          pld->training  = (float *)rtc->allocMem(numBytes);
+          pld->histogram = (float *)rtc->allocMem(numBytes);
+          pld->cdfs      = (float *)rtc->allocMem(numBytes);
+          rtc->memsetAsync(pld->training,0,numBytes);
+          rtc->memsetAsync(pld->histogram,0,numBytes);
+          rtc->memsetAsync(pld->cdfs,0,numBytes);
+        }
+        if (FromEnv::get()->logConfig)
+          std::cout << "#bn: volume guiding grid of " << int(gridRes)
+                    << "^3 cells over " << bounds << std::endl;
+        return;
+      }
+
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        PLD *pld = getPLD(device);
+        __rtc_launch(device->rtc,volumeGuidingUpdate,
+                     divRoundUp((int)numCells,128),128,
+                     pld->training,pld->histogram,pld->cdfs,decay);
+      }
+    }
+
+    VolumeGuiding::DD VolumeGuiding::getDD(Device *device)
+    {
+      PLD *pld = getPLD(device);
+      DD dd;
+      dd.cdfs     = pld->cdfs;
+      dd.training = pld->training;
+      dd.bounds   = bounds;
+      dd.fraction = fraction;
+      return dd;
+    }
+
+  }
+}
@@ -0,0 +1,213 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/DeviceGroup.h"
+#include "barney/render/DG.h"
+#include "barney/packedBSDF/Phase.h"
+
+namespace BARNEY_NS {
+  struct ModelSlot;
+
+  namespace render {
+
+    /*! online-learned path guiding for scattering in volumes: a
+        uniform grid over the world-space bounds of a slot's volumes,
+        each cell holding a histogram over (equal-area cylindrical)
+        directions of the radiance that volume scattering events in
+        that cell received from that direction. It gets trained from
+        what the shadow and bounce rays of volume scatter events
+        deliver to the frame buffer, and decays over frames, so it
+        follows changes to the scene.
+
+        Volume scatter directions then get drawn from either this
+        distribution (with probability 'fraction') or the phase
+        function, and weighted by the pdf of that mixture; since the
+        phase function covers all directions this is unbiased no
+        matter how good or bad the learned distribution is; it only
+        changes variance. Cells that didn't see any training yet just
+        use the phase function. */
+    struct VolumeGuiding {
+      enum { gridRes     = 16,
+             numCells    = gridRes*gridRes*gridRes,
+             binsPerAxis = 8,
+             numBins     = binsPerAxis*binsPerAxis };
+
+      struct DD {
+#if RTC_DEVICE_CODE
+        /*! cell containing given world-space point, or -1 if outside
+            the grid (or if guiding is off) */
+        inline __rtc_device int cellOf(vec3f P) const;
+        /*! fraction of samples that get drawn from the learned
+            distribution in given cell; 0 for cells without any
+            training data */
+        inline __rtc_device float fractionIn(int cell) const;
+        inline __rtc_device float pdf(int cell, vec3f dir) const;
+        inline __rtc_device vec3f sample(int cell, Random &random) const;
+        /*! the training bin that radiance which a volume scatter
+            event at P received from direction dir gets added to (with
+            the compute interface's atomicAdd), or null if P is outside
+            the grid */
+        inline __rtc_device float *trainingBin(vec3f P, vec3f dir) const;
+
+        /*! scatters off given phase function through the mixture of
+            phase function and learned distribution */
+        inline __rtc_device
+        void scatter(ScatterResult &scatter,
+                     const packedBSDF::Phase &phase,
+                     const DG &dg,
+                     int cell,
+                     Random &random,
+                     bool dbg) const;
+        /*! pdf of what scatter() would pick given direction with */
+        inline __rtc_device
+        float scatterPdf(const packedBSDF::Phase &phase,
+                         const DG &dg,
+                         int cell,
+                         vec3f dir,
+                         bool dbg) const;
+#endif
+        /*! per cell, numBins cdf entries of what sampling uses; a
+            cell whose last entry isn't 1 has no data */
+        const float *cdfs     = nullptr;
+        /*! per cell, numBins sums of what got trained this frame */
+        float       *training = nullptr;
+        box3f        bounds;
+        float        fraction = 0.f;
+      };
+
+      VolumeGuiding(const DevGroup::SP &devices);
+      ~VolumeGuiding();
+
+      /*! with fraction > 0, (re-)sets up the grid over given slot's
+          volumes if those moved, and folds what got trained during
+          the last frame into the distributions used for sampling in
+          the next; with fraction 0, releases everything */
+      void beginFrame(ModelSlot *slot, float fraction);
+      void free();
+
+      DD getDD(Device *device);
+
+      /*! how much of a cell's histogram carries over into the next
+          frame, on top of that frame's training */
+      float decay = .9f;
+
+      struct PLD {
+        float *training  = 0;
+        float *histogram = 0;
+        float *cdfs      = 0;
+      };
+      PLD *getPLD(Device *device);
+      std::vector<PLD> perLogical;
+      box3f            bounds;
+      float            fraction = 0.f;
+      DevGroup::SP const devices;
+    };
+
+#if RTC_DEVICE_CODE
+    inline __rtc_device
+    int VolumeGuiding::DD::cellOf(vec3f P) const
+    {
+      if (!cdfs) return -1;
+      const vec3f rel = (P-bounds.lower) * rcp(bounds.size());
+      if (!(rel.x >= 0.f && rel.y >= 0.f && rel.z >= 0.f &&
+            rel.x <  1.f && rel.y <  1.f && rel.z <  1.f))
+        return -1;
+      const vec3i c = min(vec3i(rel*float(gridRes)),vec3i(gridRes-1));
+      return c.x + gridRes*(c.y + gridRes*c.z);
+    }
+
+    /*! bin of given direction: z (ie, cos theta) and phi split up
+        uniformly, so all bins cover the same solid angle */
+    inline __rtc_device
+    int guidingBinOf(vec3f dir)
+    {
+      const float u = .5f*(dir.z+1.f);
+      const float v = (atan2f(dir.y,dir.x)+ONE_PI)*ONE_OVER_TWO_PI;
+      const int   iu = min(int(u*VolumeGuiding::binsPerAxis),
+                           VolumeGuiding::binsPerAxis-1);
+      const int   iv = min(int(v*VolumeGuiding::binsPerAxis),
+                           VolumeGuiding::binsPerAxis-1);
+      return max(iu,0)*VolumeGuiding::binsPerAxis+max(iv,0);
+    }
+
+    inline __rtc_device
+    float VolumeGuiding::DD::fractionIn(int cell) const
+    {
+      if (cell < 0) return 0.f;
+      return cdfs[(cell+1)*numBins-1] == 1.f ? fraction : 0.f;
+    }
+
+    inline __rtc_device
+    float VolumeGuiding::DD::pdf(int cell, vec3f dir) const
+    {
+      const float *cdf = cdfs+cell*numBins;
+      const int bin = guidingBinOf(dir);
+      const float p = cdf[bin] - (bin ? cdf[bin-1] : 0.f);
+      return p * (numBins*ONE_OVER_FOUR_PI);
+    }
+
+    inline __rtc_device
+    vec3f VolumeGuiding::DD::sample(int cell, Random &random) const
+    {
+      const float *cdf = cdfs+cell*numBins;
+      const float r = random();
+      int bin = 0;
+      while (bin < numBins-1 && cdf[bin] <= r)
+        bin++;
+      const float u
+        = ((bin / binsPerAxis) + random()) * (1.f/binsPerAxis);
+      const float v
+        = ((bin % binsPerAxis) + random()) * (1.f/binsPerAxis);
+      const float cosTheta = 2.f*u-1.f;
+      const float sinTheta = sqrtf(max(0.f,1.f-cosTheta*cosTheta));
+      const float phi      = TWO_PI*v-ONE_PI;
+      return vec3f(cosf(phi)*sinTheta,sinf(phi)*sinTheta,cosTheta);
+    }
+
+    inline __rtc_device
+    float *VolumeGuiding::DD::trainingBin(vec3f P, vec3f dir) const
+    {
+      const int cell = cellOf(P);
+      if (cell < 0) return nullptr;
+      return training+cell*numBins+guidingBinOf(normalize(dir));
+    }
+
+    inline __rtc_device
+    float VolumeGuiding::DD::scatterPdf(const packedBSDF::Phase &phase,
+                                        const DG &dg,
+                                        int cell,
+                                        vec3f dir,
+                                        bool dbg) const
+    {
+      const float f = fractionIn(cell);
+      const float phasePdf = phase.pdf(dg,dir,dbg);
+      return f > 0.f
+        ? f*pdf(cell,dir) + (1.f-f)*phasePdf
+        : phasePdf;
+    }
+
+    inline __rtc_device
+    void VolumeGuiding::DD::scatter(ScatterResult &scatter,
+                                    const packedBSDF::Phase &phase,
+                                    const DG &dg,
+                                    int cell,
+                                    Random &random,
+                                    bool dbg) const
+    {
+      const float f = fractionIn(cell);
+      if (f > 0.f && random() < f) {
+        scatter.dir  = sample(cell,random);
+        scatter.type = ScatterResult::VOLUME;
+      } else
+        phase.scatter(scatter,dg,random,dbg);
+      const EvalRes phaseRes = phase.eval(dg,scatter.dir,dbg);
+      scatter.f_r = phaseRes.value;
+      scatter.pdf = scatterPdf(phase,dg,cell,scatter.dir,dbg);
+    }
+#endif
+
+  }
+}
@@ -14,7 +14,8 @@ namespace BARNEY_NS {
 
     World::World(SlotContext *slotContext)
       : devices(slotContext->devices),
-        slotContext(slotContext)
+        slotContext(slotContext),
+        volumeGuiding(slotContext->devices)
     {
       perLogical.resize(devices->numLogical);
       for (auto device : *devices) {
@@ -24,6 +25,8 @@ namespace BARNEY_NS {
         pld->quadLights = 0;
         pld->dirLights = 0;
         pld->pointLights = 0;
+        pld->quadLightBVH = 0;
+        pld->pointLightBVH = 0;
       }
     }
     
@@ -36,6 +39,9 @@ namespace BARNEY_NS {
         if (pld->quadLights)  rtc->freeMem(pld->quadLights);
         if (pld->dirLights)   rtc->freeMem(pld->dirLights);
         if (pld->pointLights) rtc->freeMem(pld->pointLights);
+        if (pld->quadLightBVH)  rtc->freeMem(pld->quadLightBVH);
+        if (pld->pointLightBVH) rtc->freeMem(pld->pointLightBVH);
+        if (pld->instIDToUserInstID) rtc->freeMem(pld->instIDToUserInstID);
       }
     }
 
@@ -60,6 +66,10 @@ namespace BARNEY_NS {
       dd.pointLights
         = (PointLight::DD *)pld->pointLights;
       dd.numPointLights = pld->numPointLights;
+      dd.quadLightBVH.nodes     = pld->quadLightBVH;
+      dd.quadLightBVH.numNodes  = pld->numQuadLightBVHNodes;
+      dd.pointLightBVH.nodes    = pld->pointLightBVH;
+      dd.pointLightBVH.numNodes = pld->numPointLightBVHNodes;
       dd.envMapLight
         = envMapLight.light
         ? envMapLight.light->getDD(device,envMapLight.xfm)
@@ -69,16 +79,40 @@ namespace BARNEY_NS {
       dd.samplers  = slotContext->samplerRegistry->getDD(device);
       dd.materials = slotContext->materialRegistry->getDD(device);
       
-      for (int i=0;i<5;i++)
+      dd.instIDToUserInstID = pld->instIDToUserInstID;
+      dd.volumeGuiding = volumeGuiding.getDD(device);
+      for (int i=0;i<5;i++) {
         dd.instanceAttributes[i]
           = instanceAttributes[i]
           ? (const rtc::float4*)instanceAttributes[i]->getDD(device)
           : nullptr;
+        dd.numInstanceAttributes[i]
+          = instanceAttributes[i]
+          ? (int)instanceAttributes[i]->count
+          : 0;
+      }
       return dd;
     }
 
+    void World::setInstIDToUserInstID(const std::vector<int> &userIDs)
+    {
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        auto pld = getPLD(device);
+        auto rtc = device->rtc;
+        if (pld->instIDToUserInstID) rtc->freeMem(pld->instIDToUserInstID);
+        pld->instIDToUserInstID = 0;
+        if (userIDs.empty())
+          continue;
+        size_t numBytes = userIDs.size()*sizeof(userIDs[0]);
+        pld->instIDToUserInstID = (int*)rtc->allocMem(numBytes);
+        rtc->copy(pld->instIDToUserInstID,userIDs.data(),numBytes);
+      }
+    }
+
     void World::set(const std::vector<QuadLight::DD> &quadLights)
     {
+      std::vector<LightBVH::Node> bvh = LightBVH::build(quadLights);
       for (auto device : *devices) {
         SetActiveGPU forDuration(device);
         auto pld = getPLD(device);
@@ -88,6 +122,15 @@ namespace BARNEY_NS {
         pld->quadLights = (QuadLight::DD*)rtc->allocMem(numBytes);
         rtc->copy(pld->quadLights,quadLights.data(),numBytes);
         pld->numQuadLights = (int)quadLights.size();
+
+        if (pld->quadLightBVH) rtc->freeMem(pld->quadLightBVH);
+        pld->quadLightBVH = 0;
+        numBytes = bvh.size()*sizeof(bvh[0]);
+        if (numBytes) {
+          pld->quadLightBVH = (LightBVH::Node*)rtc->allocMem(numBytes);
+          rtc->copy(pld->quadLightBVH,bvh.data(),numBytes);
+        }
+        pld->numQuadLightBVHNodes = (int)bvh.size();
       }
     }
     
@@ -107,6 +150,7 @@ namespace BARNEY_NS {
 
     void World::set(const std::vector<PointLight::DD> &pointLights)
     {
+      std::vector<LightBVH::Node> bvh = LightBVH::build(pointLights);
       for (auto device : *devices) {
         SetActiveGPU forDuration(device);
         auto pld = getPLD(device);
@@ -116,6 +160,15 @@ namespace BARNEY_NS {
         pld->pointLights = (PointLight::DD*)rtc->allocMem(numBytes);
         rtc->copy(pld->pointLights,pointLights.data(),numBytes);
         pld->numPointLights = (int)pointLights.size();
+
+        if (pld->pointLightBVH) rtc->freeMem(pld->pointLightBVH);
+        pld->pointLightBVH = 0;
+        numBytes = bvh.size()*sizeof(bvh[0]);
+        if (numBytes) {
+          pld->pointLightBVH = (LightBVH::Node*)rtc->allocMem(numBytes);
+          rtc->copy(pld->pointLightBVH,bvh.data(),numBytes);
+        }
+        pld->numPointLightBVHNodes = (int)bvh.size();
       }
     }
 
@@ -5,11 +5,14 @@
 #pragma once
 
 #include "barney/DeviceGroup.h"
+#include "barney/common/DeviceCounters.h"
 #include "barney/render/Sampler.h"
 #include "barney/light/EnvMap.h"
 #include "barney/light/DirLight.h"
 #include "barney/light/PointLight.h"
 #include "barney/light/QuadLight.h"
+#include "barney/light/LightBVH.h"
+#include "barney/render/VolumeGuiding.h"
 
 namespace BARNEY_NS {
   struct SlotContext;
@@ -32,14 +35,29 @@ namespace BARNEY_NS {
         const DirLight::DD  *dirLights     = nullptr;
         int                  numPointLights  = 0;
         const PointLight::DD  *pointLights     = nullptr;
+        /*! light hierarchies for importance-sampling quad and point
+            lights, respectively; empty (numNodes==0) if there're too
+            few of those lights for that to pay off */
+        LightBVH::DD          quadLightBVH;
+        LightBVH::DD          pointLightBVH;
+        /*! per (barney) instance, its user instance ID, as last
+            built from the "instID" instance attribute; null if there
+            is none, in which case user IDs are instance indices */
         int                 *instIDToUserInstID = 0;
         
-        const DeviceMaterial *materials;
-        const Sampler::DD    *samplers;
+        PagedArray<DeviceMaterial> materials;
+        Sampler::Table             samplers;
+        /*! indexed by user instance ID; lookups past the arrays'
+            numInstanceAttributes get the geometry's default */
         const rtc::float4    *instanceAttributes[5];
+        int                   numInstanceAttributes[5];
         EnvMapLight::DD       envMapLight;
         // uint32_t              rngSeed;
         uint32_t              rank;
+        /*! the current generation's DeviceCounters; null unless
+            counting */
+        uint64_t             *counters = nullptr;
+        VolumeGuiding::DD     volumeGuiding;
       };
       struct {
         EnvMapLight::SP light;
@@ -53,6 +71,9 @@ namespace BARNEY_NS {
       void set(const std::vector<DirLight::DD> &dirLights);
       void set(const std::vector<PointLight::DD> &pointLights);
       void set(EnvMapLight::SP envMapLight, const affine3f &xfm);
+      /*! uploads the instance-to-user-ID remap table; an empty one
+          means instance indices are the user IDs */
+      void setInstIDToUserInstID(const std::vector<int> &userIDs);
       
       PODData::SP instanceAttributes[5];
       PODData::SP instanceUserIDs;
@@ -67,12 +88,20 @@ namespace BARNEY_NS {
         int numDirLights = 0;
         PointLight::DD *pointLights = 0;
         int numPointLights = 0;
+        LightBVH::Node *quadLightBVH = 0;
+        int numQuadLightBVHNodes = 0;
+        LightBVH::Node *pointLightBVH = 0;
+        int numPointLightBVHNodes = 0;
+        int *instIDToUserInstID = 0;
       };
       PLD *getPLD(Device *device);
       
       std::vector<PLD> perLogical;
       DevGroup::SP const devices;
       SlotContext *const slotContext;
+      /*! learned directions for scattering in this slot's volumes;
+          see Renderer's "volumeGuiding" */
+      VolumeGuiding      volumeGuiding;
     };
 
   }
@@ -5,10 +5,14 @@
 
 #include "barney/common/barney-common.h"
 #include "barney/umesh/common/UMeshField.h"
+#include "barney/common/hostParallel.h"
 #include "barney/Context.h"
 #include "barney/umesh/mc/UMeshCuBQLSampler.h"
+#include "barney/umesh/iso/UMeshActiveIso.h"
 #include "barney/volume/MCGrid.cuh"
 // #include "barney/umesh/os/AWT.h"
+#include <algorithm>
+#include <limits>
 #if RTC_DEVICE_CODE
 # include "rtcore/ComputeInterface.h"
 # include "rtcore/TraceInterface.h"
@@ -149,10 +153,10 @@ namespace BARNEY_NS {
       } else if (cellIdx < 0 || cellIdx >= mesh.numScalars) {
         return;
       }
-      vec4f a(mesh.vertices[id.x], mesh.scalars[sidx_x]);
-      vec4f b(mesh.vertices[id.y], mesh.scalars[sidx_y]);
-      vec4f c(mesh.vertices[id.z], mesh.scalars[sidx_z]);
-      vec4f d(mesh.vertices[id.w], mesh.scalars[sidx_w]);
+      vec4f a(mesh.vertex(id.x), mesh.scalars[sidx_x]);
+      vec4f b(mesh.vertex(id.y), mesh.scalars[sidx_y]);
+      vec4f c(mesh.vertex(id.z), mesh.scalars[sidx_z]);
+      vec4f d(mesh.vertex(id.w), mesh.scalars[sidx_w]);
       rasterTet<5>(grid, a, b, c, d);
     } else {
       const box4f eltBounds = mesh.cellBounds(cellIdx);
@@ -190,6 +194,13 @@ namespace BARNEY_NS {
     grid.gridOrigin  = worldBounds.lower;
     grid.gridSpacing = worldBounds.size() * rcp(vec3f(dims));
     
+    rasterCells(grid);
+  }
+
+  /*! (re-)computes the given grid's per-cell value ranges from the
+      current scalars */
+  void UMeshField::rasterCells(MCGrid &grid)
+  {
     grid.clearCells();
     
     for (auto device : *devices) 
@@ -207,30 +218,52 @@ namespace BARNEY_NS {
     if (ScalarField::setData(member,value))
       return true;
 
+    /* anything but the scalars changes the mesh itself; re-setting
+       the array a member already has changes nothing */
+    auto setMesh = [&](PODData::SP &array) {
+      PODData::SP newArray = value ? value->as<PODData>() : PODData::SP{};
+      if (newArray == array) return;
+      array = newArray;
+      meshDirty = true;
+    };
+    auto setScalars = [&](bool perVertex) {
+      PODData::SP newScalars = value ? value->as<PODData>() : PODData::SP{};
+      if (newScalars == scalars && perVertex == scalarsArePerVertex)
+        return;
+      if (scalars && newScalars
+          && perVertex == scalarsArePerVertex
+          && newScalars->count == scalars->count)
+        scalarsReplaced = true;
+      else
+        // different kind or size of scalars; the bvhs and quantized
+        // data don't depend on them, but commit's fast path does
+        meshDirty = true;
+      scalars = newScalars;
+      scalarsArePerVertex = perVertex;
+    };
+    
     if (member == "cell.index") {
-      cellOffsets = value->as<PODData>();
+      setMesh(cellOffsets);
       return true;
     }
     if (member == "cell.type") {
-      cellTypes = value->as<PODData>();
+      setMesh(cellTypes);
       return true;
     }
     if (member == "cell.data") {
-      scalars = value->as<PODData>();
-      scalarsArePerVertex = false;
+      setScalars(false);
       return true;
     }
     if (member == "vertex.position") {
-      vertices = value->as<PODData>();
+      setMesh(vertices);
       return true;
     }
     if (member == "vertex.data") {
-      scalars = value->as<PODData>();
-      scalarsArePerVertex = true;
+      setScalars(true);
       return true;
     }
     if (member == "index") {
-      indices = value->as<PODData>();
+      setMesh(indices);
       return true;
     }
 
@@ -320,18 +353,345 @@ namespace BARNEY_NS {
     : ScalarField(context,devices)
   {
     perLogical.resize(devices->numLogical);
+    quantizeVertices = FromEnv::enabled("umeshQuantize");
+    faceNeighborsEnabled = FromEnv::enabled("umeshFaceNeighbors");
+    polyPlanesEnabled = FromEnv::enabled("umeshPolyPlanes");
+  }
+
+  UMeshField::~UMeshField()
+  {
+    freeQuantizedVertices();
+    freeFaceNeighbors();
+    freePolyPlanes();
+  }
+
+  void UMeshField::freePolyPlanes()
+  {
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      if (pld->polyPlaneBegin)
+        device->rtc->freeMem(pld->polyPlaneBegin);
+      if (pld->polyPlanes)
+        device->rtc->freeMem(pld->polyPlanes);
+      pld->polyPlaneBegin = 0;
+      pld->polyPlanes     = 0;
+    }
+  }
+  
+  void UMeshField::buildPolyPlanes()
+  {
+    freePolyPlanes();
+    if (!polyPlanesEnabled) return;
+
+    Device *device = (*devices)[0];
+    std::vector<uint8_t> h_types(cellTypes->count);
+    cellTypes->download(device,h_types.data());
+    if (std::find(h_types.begin(),h_types.end(),(uint8_t)_VTK_POLYHEDRON)
+        == h_types.end())
+      return;
+    
+    std::vector<int>   h_indices(indices->count);
+    std::vector<int>   h_offsets(cellOffsets->count);
+    std::vector<vec3f> h_vertices(vertices->count);
+    indices->download(device,h_indices.data());
+    cellOffsets->download(device,h_offsets.data());
+    vertices->download(device,h_vertices.data());
+    const int numIndices = (int)h_indices.size();
+    const int numVertices = (int)h_vertices.size();
+
+    // one plane per face, through the face centroid, with a normal
+    // from newell's method (which is robust to slightly non-planar
+    // faces), then oriented to face away from the cell's centroid.
+    // cells whose face stream is malformed get no planes, and fall
+    // back to the face stream code path
+    //
+    // cells get processed in parallel chunks, each with its own list
+    // of planes; those then get concatenated
+    const size_t chunkSize = 16*1024;
+    std::vector<int>   begin(numCells+1);
+    std::vector<std::vector<vec4f>> chunkPlanes(dru(numCells,chunkSize));
+    hostParallelFor(numCells,chunkSize,[&](size_t chunkBegin, size_t chunkEnd){
+      std::vector<vec4f> &planes = chunkPlanes[chunkBegin/chunkSize];
+      for (int cellIdx=(int)chunkBegin;cellIdx<(int)chunkEnd;cellIdx++) {
+        begin[cellIdx] = (int)planes.size();
+        if (h_types[cellIdx] != _VTK_POLYHEDRON) continue;
+        int pos = h_offsets[cellIdx];
+        if (pos < 0 || pos >= numIndices) continue;
+        int numFaces = h_indices[pos++];
+        if (numFaces <= 0 || numFaces > umesh_poly_stream::kMaxFaces) continue;
+      
+        bool ok = true;
+        box3f cellBounds;
+        vec3f cellCentroid(0.f);
+        int   numCorners = 0;
+        for (int f=0;ok && f<numFaces;f++) {
+          int numPts = pos < numIndices ? h_indices[pos++] : 0;
+          if (numPts < 3 || numPts > umesh_poly_stream::kMaxPtsPerFace
+              || pos+numPts > numIndices) { ok = false; break; }
+          vec3f N(0.f), faceCentroid(0.f);
+          for (int i=0;i<numPts;i++) {
+            int a = h_indices[pos+i];
+            int b = h_indices[pos+(i+1)%numPts];
+            if (a < 0 || a >= numVertices || b < 0 || b >= numVertices)
+              { ok = false; break; }
+            vec3f va = h_vertices[a], vb = h_vertices[b];
+            N.x += (va.y-vb.y)*(va.z+vb.z);
+            N.y += (va.z-vb.z)*(va.x+vb.x);
+            N.z += (va.x-vb.x)*(va.y+vb.y);
+            faceCentroid += va;
+            cellBounds.extend(va);
+          }
+          pos += numPts;
+          if (!ok) break;
+          cellCentroid += faceCentroid;
+          numCorners   += numPts;
+          faceCentroid *= 1.f/numPts;
+          planes.push_back(vec4f(N,dot(N,faceCentroid)));
+        }
+        if (!ok) {
+          planes.resize(begin[cellIdx]);
+          continue;
+        }
+        cellCentroid *= 1.f/numCorners;
+        // a small tolerance, so neighboring cells' shared faces don't
+        // leave gaps between them
+        float eps = 1e-5f*length(cellBounds.size());
+        for (int i=begin[cellIdx];i<(int)planes.size();i++) {
+          vec4f &plane = planes[i];
+          if (dot(getPos(plane),cellCentroid) > plane.w)
+            plane = -plane;
+          plane.w += eps*length(getPos(plane));
+        }
+      }
+    });
+    // local offsets to global ones
+    std::vector<vec4f> planes;
+    for (size_t chunk=0;chunk<chunkPlanes.size();chunk++) {
+      int base = (int)planes.size();
+      int chunkEnd = std::min((int)((chunk+1)*chunkSize),numCells);
+      for (int cellIdx=int(chunk*chunkSize);cellIdx<chunkEnd;cellIdx++)
+        begin[cellIdx] += base;
+      planes.insert(planes.end(),
+                    chunkPlanes[chunk].begin(),chunkPlanes[chunk].end());
+      chunkPlanes[chunk].clear();
+    }
+    begin[numCells] = (int)planes.size();
+    
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      pld->polyPlaneBegin
+        = (int*)device->rtc->allocMem(begin.size()*sizeof(int));
+      device->rtc->copy(pld->polyPlaneBegin,begin.data(),
+                        begin.size()*sizeof(int));
+      pld->polyPlanes
+        = (vec4f*)device->rtc->allocMem(std::max(planes.size(),(size_t)1)
+                                        *sizeof(vec4f));
+      device->rtc->copy(pld->polyPlanes,planes.data(),
+                        planes.size()*sizeof(vec4f));
+    }
+  }
+
+  void UMeshField::freeFaceNeighbors()
+  {
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      if (pld->faceNeighbors)
+        device->rtc->freeMem(pld->faceNeighbors);
+      pld->faceNeighbors = 0;
+    }
+  }
+  
+  void UMeshField::buildFaceNeighbors()
+  {
+    freeFaceNeighbors();
+    if (!faceNeighborsEnabled) return;
+
+    // this is a one-time operation per mesh, so just do it on the
+    // host: download connectivity from the first device, sort all
+    // tet faces by their (sorted) vertex indices, and pair up
+    // identical ones
+    Device *device = (*devices)[0];
+    std::vector<int>     h_indices(indices->count);
+    std::vector<int>     h_offsets(cellOffsets->count);
+    std::vector<uint8_t> h_types(cellTypes->count);
+    indices->download(device,h_indices.data());
+    cellOffsets->download(device,h_offsets.data());
+    cellTypes->download(device,h_types.data());
+
+    struct Face {
+      vec3i vertices;
+      int   slot;
+    };
+    // four face slots per cell; slots of non-tets stay invalid, and
+    // end up at the end after sorting
+    std::vector<Face> faces(4*(size_t)numCells,
+                            Face{vec3i(std::numeric_limits<int>::max()),-1});
+    hostParallelFor(numCells,16*1024,[&](size_t begin, size_t end){
+      for (int cellIdx=(int)begin;cellIdx<(int)end;cellIdx++) {
+        if (h_types[cellIdx] != _ANARI_TET && h_types[cellIdx] != _VTK_TET)
+          continue;
+        int ofs = h_offsets[cellIdx];
+        if (ofs < 0 || ofs+4 > (int)h_indices.size())
+          continue;
+        const int *ix = h_indices.data()+ofs;
+        for (int f=0;f<4;f++) {
+          int v[3], n = 0;
+          for (int i=0;i<4;i++)
+            if (i != f) v[n++] = ix[i];
+          std::sort(v,v+3);
+          faces[4*cellIdx+f] = {vec3i(v[0],v[1],v[2]),4*cellIdx+f};
+        }
+      }
+    });
+    auto less = [](const Face &a, const Face &b) {
+      if (a.vertices.x != b.vertices.x) return a.vertices.x < b.vertices.x;
+      if (a.vertices.y != b.vertices.y) return a.vertices.y < b.vertices.y;
+      return a.vertices.z < b.vertices.z;
+    };
+    hostParallelSort(faces,less);
+    std::vector<int> neighbors(4*(size_t)numCells,-1);
+    for (size_t i=0;i+1<faces.size();i++) {
+      if (faces[i].slot < 0) break;
+      if (faces[i].vertices != faces[i+1].vertices) continue;
+      neighbors[faces[i].slot]   = faces[i+1].slot/4;
+      neighbors[faces[i+1].slot] = faces[i].slot/4;
+      i++;
+    }
+    
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      pld->faceNeighbors
+        = (int*)device->rtc->allocMem(neighbors.size()*sizeof(int));
+      device->rtc->copy(pld->faceNeighbors,neighbors.data(),
+                        neighbors.size()*sizeof(int));
+    }
+  }
+
+  /*! one thread per cluster of consecutive vertices: computes that
+      cluster's bounds, and quantizes its vertices relative to those */
+  __rtc_global
+  void umeshQuantizeVertices(rtc::ComputeInterface ci,
+                             const vec3f *vertices,
+                             int numVertices,
+                             uint16_t *quantized,
+                             vec3f *clusterOrigins,
+                             vec3f *clusterScales)
+  {
+#if RTC_DEVICE_CODE
+    const int clusterID = ci.launchIndex().x;
+    const int begin = clusterID << UMeshField::vertexClusterBits;
+    if (begin >= numVertices) return;
+    const int end = min(begin+(1<<UMeshField::vertexClusterBits),numVertices);
+    box3f bounds;
+    for (int i=begin;i<end;i++)
+      bounds.extend(vertices[i]);
+    vec3f scale = bounds.size() * (1.f/65535.f);
+    vec3f rcpScale(scale.x > 0.f ? 1.f/scale.x : 0.f,
+                   scale.y > 0.f ? 1.f/scale.y : 0.f,
+                   scale.z > 0.f ? 1.f/scale.z : 0.f);
+    clusterOrigins[clusterID] = bounds.lower;
+    clusterScales[clusterID]  = scale;
+    for (int i=begin;i<end;i++) {
+      vec3f q = (vertices[i]-bounds.lower)*rcpScale;
+      quantized[3*i+0] = (uint16_t)min(65535.f,q.x+.5f);
+      quantized[3*i+1] = (uint16_t)min(65535.f,q.y+.5f);
+      quantized[3*i+2] = (uint16_t)min(65535.f,q.z+.5f);
+    }
+#endif
+  }
+
+  void UMeshField::freeQuantizedVertices()
+  {
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      auto &quantized = getPLD(device)->quantized;
+      if (quantized.vertices)
+        device->rtc->freeMem(quantized.vertices);
+      if (quantized.clusterOrigins)
+        device->rtc->freeMem(quantized.clusterOrigins);
+      if (quantized.clusterScales)
+        device->rtc->freeMem(quantized.clusterScales);
+      quantized.vertices       = 0;
+      quantized.clusterOrigins = 0;
+      quantized.clusterScales  = 0;
+    }
+  }
+  
+  void UMeshField::buildQuantizedVertices()
+  {
+    freeQuantizedVertices();
+    if (!quantizeVertices) return;
+    
+    int numClusters = divRoundUp(numVertices,1<<vertexClusterBits);
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      auto rtc = device->rtc;
+      auto &quantized = getPLD(device)->quantized;
+      quantized.vertices
+        = (uint16_t*)rtc->allocMem(3*numVertices*sizeof(uint16_t));
+      quantized.clusterOrigins
+        = (vec3f*)rtc->allocMem(numClusters*sizeof(vec3f));
+      quantized.clusterScales
+        = (vec3f*)rtc->allocMem(numClusters*sizeof(vec3f));
+      __rtc_launch(rtc,umeshQuantizeVertices,
+                   divRoundUp(numClusters,128),128,
+                   (const vec3f *)vertices->getDD(device),numVertices,
+                   quantized.vertices,
+                   quantized.clusterOrigins,
+                   quantized.clusterScales);
+    }
+    for (auto device : *devices)
+      device->sync();
+    // the quantized vertices replace the full-precision ones, so we
+    // no longer keep those alive
+    vertices = 0;
   }
 
+  bool UMeshField::set1i(const std::string &member,
+                         const int &value)
+  {
+    if (member == "quantizeVertices") {
+      quantizeVertices = value;
+      return true;
+    }
+    if (member == "faceNeighbors") {
+      faceNeighborsEnabled = value;
+      return true;
+    }
+    if (member == "polyPlanes") {
+      polyPlanesEnabled = value;
+      return true;
+    }
+    if (member == "managedMemory") {
+      managedMemory = value;
+      return true;
+    }
+    return false;
+  }
+
+  /*! each thread computes the bounds of cellsPerThread consecutive
+      cells, and only then does the atomics; with one atomic per cell
+      all threads would fight over the same few words, which is
+      particularly bad on the cpu backend */
   __rtc_global
   void computeWorldBounds(rtc::ComputeInterface ci,
                           UMeshField::DD mesh,
-                          box3f *pWorldBounds)
+                          box3f *pWorldBounds,
+                          int cellsPerThread)
   {
 #if RTC_DEVICE_CODE
     int tid = ci.launchIndex().x;
-    if (tid >= mesh.numCells)
+    int begin = tid*cellsPerThread;
+    int end   = min(begin+cellsPerThread,mesh.numCells);
+    if (begin >= end)
       return;
-    box4f bounds = mesh.cellBounds(tid);
+    box3f bounds;
+    for (int cellIdx=begin;cellIdx<end;cellIdx++)
+      bounds.extend(getBox(mesh.cellBounds(cellIdx)));
     rtc::fatomicMin(&pWorldBounds->lower.x,bounds.lower.x);
     rtc::fatomicMin(&pWorldBounds->lower.y,bounds.lower.y);
     rtc::fatomicMin(&pWorldBounds->lower.z,bounds.lower.z); 
@@ -343,6 +703,29 @@ namespace BARNEY_NS {
   
   void UMeshField::commit()
   {
+    MemoryScope memScope(devices.get(),BN_MEMORY_VOLUME_FIELDS);
+    if (managedMemory)
+      for (auto data : { scalars,vertices,indices,cellOffsets })
+        if (data) {
+          data->makeManaged();
+          data->prefetch();
+        }
+    const bool onlyScalarsReplaced = scalarsReplaced && !meshDirty;
+    scalarsReplaced = false;
+    meshDirty       = false;
+    if (onlyScalarsReplaced && mcGrid && mcGrid->built()) {
+      // same mesh, new scalars: bounds, (quantized) vertices, and
+      // the samplers' element bvhs all stay valid; only the macro
+      // cells' value ranges need updating. The volumes' majorants
+      // then get recomputed from those on their next build
+      rasterCells(*mcGrid);
+      return;
+    }
+    if (getPLD((*devices)[0])->quantized.vertices && !vertices)
+      // already quantized; the app would have to set the vertex
+      // array again for us to rebuild
+      return;
+    freeQuantizedVertices();
     assert(indices);
     assert(vertices);
     assert(cellOffsets);
@@ -350,6 +733,7 @@ namespace BARNEY_NS {
     assert(scalars);
     
     this->numCells = (int)cellOffsets->count;
+    this->numVertices = (int)vertices->count;
     for (auto device : *devices) {
       PLD *pld = getPLD(device); 
       auto rtc = device->rtc;
@@ -364,9 +748,10 @@ namespace BARNEY_NS {
       }
       box3f emptyBox;
       rtc->copy(pld->pWorldBounds,&emptyBox,sizeof(emptyBox));
+      const int cellsPerThread = 64;
       __rtc_launch(rtc,computeWorldBounds,
-                   divRoundUp(numCells,128),128,
-                   getDD(device),pld->pWorldBounds);
+                   divRoundUp(divRoundUp(numCells,cellsPerThread),128),128,
+                   getDD(device),pld->pWorldBounds,cellsPerThread);
     }
     
     for (auto device : *devices) {
@@ -381,6 +766,9 @@ namespace BARNEY_NS {
       device->sync();
       assert(!worldBounds.empty());
     }
+    buildFaceNeighbors();
+    buildPolyPlanes();
+    buildQuantizedVertices();
   }
   
 
@@ -388,27 +776,40 @@ namespace BARNEY_NS {
   {
     assert(device);
     UMeshField::DD dd;
-    assert(vertices);
+    assert(vertices || getPLD(device)->quantized.vertices);
     assert(indices);
     (ScalarField::DD &)dd = ScalarField::getDD(device);
-    dd.vertices    = (const vec3f *)vertices->getDD(device);
+    dd.vertices
+      = vertices ? (const vec3f *)vertices->getDD(device) : nullptr;
+    auto &quantized = getPLD(device)->quantized;
+    dd.quantized.vertices       = quantized.vertices;
+    dd.quantized.clusterOrigins = quantized.clusterOrigins;
+    dd.quantized.clusterScales  = quantized.clusterScales;
     dd.scalars     = (const float *)scalars->getDD(device);
     dd.indices     = (const int   *)indices->getDD(device);
     dd.cellOffsets = (const int   *)cellOffsets->getDD(device);
     dd.cellTypes   = (const uint8_t *)cellTypes->getDD(device);
+    dd.faceNeighbors  = getPLD(device)->faceNeighbors;
+    dd.polyPlaneBegin = getPLD(device)->polyPlaneBegin;
+    dd.polyPlanes     = getPLD(device)->polyPlanes;
     dd.scalarsArePerVertex = scalarsArePerVertex;
     dd.numCells    = (int)cellOffsets->count;
-    dd.numVertices = (int)vertices->count;
+    dd.numVertices = numVertices;
     dd.numScalars  = (int)scalars->count;
     dd.numIndices  = (int)indices->count;
     assert(dd.numCells > 0);
-    assert(dd.vertices);
     assert(dd.indices);
     return dd;
   }
   
   IsoSurfaceAccel::SP UMeshField::createIsoAccel(IsoSurface *isoSurface) 
   {
+    /* by default, trace only the elements the surface passes
+       through; BARNEY_CONFIG="umeshIsoMC" goes back to DDA over the
+       macro cells, with cell location through the full element bvh */
+    if (!FromEnv::enabled("umeshIsoMC"))
+      return std::make_shared<UMeshActiveIsoAccel>
+        (isoSurface,shared_from_this()->as<UMeshField>());
     auto sampler = std::make_shared<UMeshCuBQLSampler>(this);
     return std::make_shared<MCIsoSurfaceAccel<UMeshCuBQLSampler>>
       (isoSurface,
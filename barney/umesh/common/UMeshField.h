@@ -35,7 +35,7 @@ namespace BARNEY_NS {
     UMeshField(Context *context,
                const DevGroup::SP &devices);
 
-    virtual ~UMeshField() = default;
+    virtual ~UMeshField();
     
     /*! helper class for representing an N-long integer tuple, to
        represent prism, pyramid, hex, etc elemnet indices */
@@ -51,6 +51,10 @@ namespace BARNEY_NS {
       
       inline __rtc_device box4f cellBounds(uint32_t cellIdx) const;
 
+      /*! position of given vertex, from either the full-precision or
+          the quantized vertex array */
+      inline __rtc_device vec3f vertex(int vtxIdx) const;
+
       /* compute scalar of given umesh element at point P, and return
          that in 'retVal'. returns true if P is inside the elemnt,
          false if outside (in which case retVal is not defined) */
@@ -94,18 +98,52 @@ namespace BARNEY_NS {
       /* compute scalar of given polyhedron in umesh, at point P, and
          return that in 'retVal'. returns true if P is inside the
          element, false if outside (in which case retVal is not
-         defined). Containment uses +X ray parity over face fans (convex /
+         defined). Containment uses precomputed face planes if
+         available, else +X ray parity over face fans (convex /
          well-behaved cells; see `umesh_poly_stream`). Per-vertex scalars use
          inverse-distance weights over face-stream corners. */
       inline __rtc_device bool polyScalar(float &retVal,
                                           uint32_t cellIdx,
                                           vec3f P) const;
+      /*! per-vertex scalar of given polyhedron at P (assumed to be
+          inside), by inverse-distance weights */
+      inline __rtc_device bool polyInterpolate(float &retVal,
+                                               uint32_t cellIdx,
+                                               vec3f P) const;
+
+      /*! starting at tet 'cellIdx', walks through shared faces
+          towards P. returns true - with cellIdx the tet containing P,
+          and retVal its scalar - if found within maxSteps; false if
+          the walk left the tets, or took too long. requires
+          faceNeighbors */
+      inline __rtc_device bool walkToTet(float &retVal,
+                                         int &cellIdx,
+                                         vec3f P,
+                                         int maxSteps = 32) const;
 
       const vec3f       *vertices;
+      /*! if non-null, vertices are stored as 16 bits per coordinate,
+          relative to the bounds of their cluster of
+          (1<<vertexClusterBits) consecutive vertices; and 'vertices'
+          may be null */
+      struct {
+        const uint16_t  *vertices;
+        const vec3f     *clusterOrigins;
+        const vec3f     *clusterScales;
+      } quantized;
       const float       *scalars;
       const int         *indices;
       const int         *cellOffsets;
       const uint8_t     *cellTypes;
+      /*! if non-null, for each tet and each of its faces (face i
+          being the one opposite vertex i), the tet on the other side
+          of that face; -1 if none (or if that's not a tet) */
+      const int         *faceNeighbors;
+      /*! if non-null, (outward) face planes of all polyhedra: those
+          of cell i are polyPlanes[polyPlaneBegin[i]..polyPlaneBegin[i+1]),
+          with (n,d) a plane dot(n,P)=d */
+      const int         *polyPlaneBegin;
+      const vec4f       *polyPlanes;
       int                numCells;
       int                numVertices;
       int                numScalars;
@@ -116,6 +154,7 @@ namespace BARNEY_NS {
     /*! build *initial* macro-cell grid (ie, the scalar field min/max
       ranges, but not yet the majorants) over a umesh */
     void buildInitialMacroCells(MCGrid &grid);
+    void rasterCells(MCGrid &grid);
 
     /*! computes, on specified device, the bounding boxes and - if
       d_primRanges is non-null - the primitmives ranges. d_primBounds
@@ -139,6 +178,11 @@ namespace BARNEY_NS {
     /*! create, fill, and return a macrocell grid for this field */
     MCGrid::SP buildMCs() override;
 
+    /*! with automatic partitioning, every device's cell bvh only
+        holds its own part's cells (see UMeshCuBQLSampler::build()) */
+    bool isPartitioned() const override
+    { return (*devices)[0]->partition.size > 1; }
+
     VolumeAccel::SP createAccel(Volume *volume) override;
     
     /*! creates an acceleration structure for a 'isoSurface' geometry
@@ -149,6 +193,28 @@ namespace BARNEY_NS {
         programs that operate on this type */
     static std::string typeName() { return "UMesh"; };
 
+    bool set1i(const std::string &member,
+               const int &value) override;
+
+    /*! log2 of how many consecutive vertices share one quantization
+        box */
+    enum { vertexClusterBits = 8 };
+    
+    /*! if enabled, builds the quantized vertex array, and drops our
+        reference to the full-precision one */
+    void buildQuantizedVertices();
+    void freeQuantizedVertices();
+
+    /*! if enabled, builds the tets' face neighbor table (on the host,
+        once per mesh) */
+    void buildFaceNeighbors();
+    void freeFaceNeighbors();
+
+    /*! if enabled, precomputes the polyhedra's face planes (on the
+        host, once per mesh) */
+    void buildPolyPlanes();
+    void freePolyPlanes();
+
     /*! @{ set by the user, as paramters */
     PODData::SP scalars;
     PODData::SP indices;
@@ -157,9 +223,39 @@ namespace BARNEY_NS {
     PODData::SP vertices;
     int numCells;
     bool scalarsArePerVertex = false;
+    /*! whether to move scalars, vertices and connectivity into
+        unified memory (see PODData::makeManaged()), so meshes
+        somewhat larger than the gpus' memory still render, if
+        slower */
+    bool managedMemory = false;
+    /*! whether to store vertex positions quantized to 16 bits, see
+        DD::quantized */
+    bool quantizeVertices = false;
+    /*! whether to build DD::faceNeighbors, so consecutive samples
+        can walk from one tet to the next */
+    bool faceNeighborsEnabled = false;
+    /*! whether to build DD::polyPlanes, so containment tests for
+        (convex) polyhedra don't need to parse their face streams */
+    bool polyPlanesEnabled = false;
     /*! @} */
+    /*! whether, since the last commit, the scalars got replaced by
+        an array of the same size and kind */
+    bool scalarsReplaced = false;
+    /*! whether, since the last commit, anything but such a scalar
+        replacement changed; commit() only updates the macro cells
+        for new scalars if nothing did */
+    bool meshDirty       = false;
+    int numVertices = 0;
     struct PLD {
       box3f   *pWorldBounds = 0;
+      int     *faceNeighbors = 0;
+      int     *polyPlaneBegin = 0;
+      vec4f   *polyPlanes = 0;
+      struct {
+        uint16_t *vertices       = 0;
+        vec3f    *clusterOrigins = 0;
+        vec3f    *clusterScales  = 0;
+      } quantized;
     };
     PLD *getPLD(Device *device);
     std::vector<PLD> perLogical;
@@ -265,6 +361,17 @@ namespace BARNEY_NS {
   // IMPLEMENTATION
   // ==================================================================
 
+  inline __rtc_device
+  vec3f UMeshField::DD::vertex(int vtxIdx) const
+  {
+    if (!quantized.vertices)
+      return vertices[vtxIdx];
+    const uint16_t *q = quantized.vertices+3*vtxIdx;
+    const int clusterID = vtxIdx >> vertexClusterBits;
+    return quantized.clusterOrigins[clusterID]
+      + quantized.clusterScales[clusterID]*vec3f(q[0],q[1],q[2]);
+  }
+  
   inline __rtc_device
   box4f UMeshField::DD::cellBounds(uint32_t cellIdx) const
   {
@@ -291,7 +398,7 @@ namespace BARNEY_NS {
           int vtxIdx = 0, si = 0;
           if (!stream.readVertex(vtxIdx, si))
             return box4f{};
-          bb.extend(vec4f(vertices[vtxIdx], scalars[si]));
+          bb.extend(vec4f(vertex(vtxIdx), scalars[si]));
         }
       }
       return bb;
@@ -336,7 +443,7 @@ namespace BARNEY_NS {
       const int si = scalarsArePerVertex ? vtxIdx : sci;
       if (scalarsArePerVertex && (si < 0 || si >= numScalars))
         return box4f{};
-      vec4f v(vertices[vtxIdx], scalars[si]);
+      vec4f v(vertex(vtxIdx), scalars[si]);
       bb.extend(v);
     }
     return bb;
@@ -410,10 +517,10 @@ namespace BARNEY_NS {
       return false;
     }
 
-    vec4f v0(vertices[indices.x],scalars[scalarsArePerVertex?indices.x:cellIdx]);
-    vec4f v1(vertices[indices.y],scalars[scalarsArePerVertex?indices.y:cellIdx]);
-    vec4f v2(vertices[indices.z],scalars[scalarsArePerVertex?indices.z:cellIdx]);
-    vec4f v3(vertices[indices.w],scalars[scalarsArePerVertex?indices.w:cellIdx]);
+    vec4f v0(vertex(indices.x),scalars[scalarsArePerVertex?indices.x:cellIdx]);
+    vec4f v1(vertex(indices.y),scalars[scalarsArePerVertex?indices.y:cellIdx]);
+    vec4f v2(vertex(indices.z),scalars[scalarsArePerVertex?indices.z:cellIdx]);
+    vec4f v3(vertex(indices.w),scalars[scalarsArePerVertex?indices.w:cellIdx]);
 
     float t3 = evalToImplicitPlane(P,v0,v1,v2);
     if (t3 < 0.f) return false;
@@ -451,11 +558,11 @@ namespace BARNEY_NS {
       if (scalarsArePerVertex && (v < 0 || v >= numScalars)) return false;
     }
     if (!scalarsArePerVertex && (int)cellIdx >= numScalars) return false;
-    vec4f v0(vertices[indices[0]],scalars[scalarsArePerVertex?indices[0]:cellIdx]);
-    vec4f v1(vertices[indices[1]],scalars[scalarsArePerVertex?indices[1]:cellIdx]);
-    vec4f v2(vertices[indices[2]],scalars[scalarsArePerVertex?indices[2]:cellIdx]);
-    vec4f v3(vertices[indices[3]],scalars[scalarsArePerVertex?indices[3]:cellIdx]);
-    vec4f v4(vertices[indices[4]],scalars[scalarsArePerVertex?indices[4]:cellIdx]);
+    vec4f v0(vertex(indices[0]),scalars[scalarsArePerVertex?indices[0]:cellIdx]);
+    vec4f v1(vertex(indices[1]),scalars[scalarsArePerVertex?indices[1]:cellIdx]);
+    vec4f v2(vertex(indices[2]),scalars[scalarsArePerVertex?indices[2]:cellIdx]);
+    vec4f v3(vertex(indices[3]),scalars[scalarsArePerVertex?indices[3]:cellIdx]);
+    vec4f v4(vertex(indices[4]),scalars[scalarsArePerVertex?indices[4]:cellIdx]);
     return intersectPyrEXT(retVal, P, v0,v1,v2,v3,v4);
   }
 
@@ -477,12 +584,12 @@ namespace BARNEY_NS {
       if (scalarsArePerVertex && (v < 0 || v >= numScalars)) return false;
     }
     if (!scalarsArePerVertex && (int)cellIdx >= numScalars) return false;
-    vec4f v0(vertices[indices[0]],scalars[scalarsArePerVertex?indices[0]:cellIdx]);
-    vec4f v1(vertices[indices[1]],scalars[scalarsArePerVertex?indices[1]:cellIdx]);
-    vec4f v2(vertices[indices[2]],scalars[scalarsArePerVertex?indices[2]:cellIdx]);
-    vec4f v3(vertices[indices[3]],scalars[scalarsArePerVertex?indices[3]:cellIdx]);
-    vec4f v4(vertices[indices[4]],scalars[scalarsArePerVertex?indices[4]:cellIdx]);
-    vec4f v5(vertices[indices[5]],scalars[scalarsArePerVertex?indices[5]:cellIdx]);
+    vec4f v0(vertex(indices[0]),scalars[scalarsArePerVertex?indices[0]:cellIdx]);
+    vec4f v1(vertex(indices[1]),scalars[scalarsArePerVertex?indices[1]:cellIdx]);
+    vec4f v2(vertex(indices[2]),scalars[scalarsArePerVertex?indices[2]:cellIdx]);
+    vec4f v3(vertex(indices[3]),scalars[scalarsArePerVertex?indices[3]:cellIdx]);
+    vec4f v4(vertex(indices[4]),scalars[scalarsArePerVertex?indices[4]:cellIdx]);
+    vec4f v5(vertex(indices[5]),scalars[scalarsArePerVertex?indices[5]:cellIdx]);
     return intersectPrismEXT(retVal, P, v0,v1,v2,v3,v4,v5);
   }
 
@@ -505,14 +612,14 @@ namespace BARNEY_NS {
       if (scalarsArePerVertex && (v < 0 || v >= numScalars)) return false;
     }
     if (!scalarsArePerVertex && (int)cellIdx >= numScalars) return false;
-    vec4f v0(vertices[indices[0]],scalars[scalarsArePerVertex?indices[0]:cellIdx]);
-    vec4f v1(vertices[indices[1]],scalars[scalarsArePerVertex?indices[1]:cellIdx]);
-    vec4f v2(vertices[indices[2]],scalars[scalarsArePerVertex?indices[2]:cellIdx]);
-    vec4f v3(vertices[indices[3]],scalars[scalarsArePerVertex?indices[3]:cellIdx]);
-    vec4f v4(vertices[indices[4]],scalars[scalarsArePerVertex?indices[4]:cellIdx]);
-    vec4f v5(vertices[indices[5]],scalars[scalarsArePerVertex?indices[5]:cellIdx]);
-    vec4f v6(vertices[indices[6]],scalars[scalarsArePerVertex?indices[6]:cellIdx]);
-    vec4f v7(vertices[indices[7]],scalars[scalarsArePerVertex?indices[7]:cellIdx]);
+    vec4f v0(vertex(indices[0]),scalars[scalarsArePerVertex?indices[0]:cellIdx]);
+    vec4f v1(vertex(indices[1]),scalars[scalarsArePerVertex?indices[1]:cellIdx]);
+    vec4f v2(vertex(indices[2]),scalars[scalarsArePerVertex?indices[2]:cellIdx]);
+    vec4f v3(vertex(indices[3]),scalars[scalarsArePerVertex?indices[3]:cellIdx]);
+    vec4f v4(vertex(indices[4]),scalars[scalarsArePerVertex?indices[4]:cellIdx]);
+    vec4f v5(vertex(indices[5]),scalars[scalarsArePerVertex?indices[5]:cellIdx]);
+    vec4f v6(vertex(indices[6]),scalars[scalarsArePerVertex?indices[6]:cellIdx]);
+    vec4f v7(vertex(indices[7]),scalars[scalarsArePerVertex?indices[7]:cellIdx]);
     return intersectHexEXT(retVal, P, v0,v1,v2,v3,v4,v5,v6,v7, dbg);
   }
 
@@ -522,6 +629,22 @@ namespace BARNEY_NS {
                                   vec3f P) const
   {
     const int offset = cellOffsets[cellIdx];
+    if (polyPlanes && polyPlaneBegin[cellIdx] < polyPlaneBegin[cellIdx+1]) {
+      // containment from precomputed planes; only the per-vertex
+      // interpolation still needs the face stream
+      for (int i=polyPlaneBegin[cellIdx];i<polyPlaneBegin[cellIdx+1];i++) {
+        vec4f plane = polyPlanes[i];
+        if (dot(getPos(plane),P) > plane.w)
+          return false;
+      }
+      if (!scalarsArePerVertex) {
+        if ((int)cellIdx >= numScalars) return false;
+        retVal = scalars[cellIdx];
+        return true;
+      }
+      return polyInterpolate(retVal,cellIdx,P);
+    }
+    
     umesh_poly_stream::FaceStreamReader stream(indices,
                                                numIndices,
                                                numVertices,
@@ -546,14 +669,14 @@ namespace BARNEY_NS {
       if (!stream.readVertex(v1Idx, si1))
         return false;
       (void)si1;
-      vec3f a = vertices[v0Idx];
+      vec3f a = vertex(v0Idx);
       for (int t = 0; t < numPts - 2; t++) {
         int v2Idx = 0, si2 = 0;
         if (!stream.readVertex(v2Idx, si2))
           return false;
         (void)si2;
-        vec3f b = vertices[v1Idx];
-        vec3f c = vertices[v2Idx];
+        vec3f b = vertex(v1Idx);
+        vec3f c = vertex(v2Idx);
         // Moller-Trumbore ray-triangle intersection (ray: P + t*(1,0,0))
         vec3f e1 = b - a;
         vec3f e2 = c - a;
@@ -592,7 +715,15 @@ namespace BARNEY_NS {
       retVal = scalars[cellIdx];
       return true;
     }
-
+    return polyInterpolate(retVal,cellIdx,P);
+  }
+  
+  inline __rtc_device
+  bool UMeshField::DD::polyInterpolate(float &retVal,
+                                       uint32_t cellIdx,
+                                       vec3f P) const
+  {
+    const int offset = cellOffsets[cellIdx];
     umesh_poly_stream::FaceStreamReader idwStream(indices,
                                                 numIndices,
                                                 numVertices,
@@ -612,7 +743,7 @@ namespace BARNEY_NS {
         int vtxIdx = 0, si = 0;
         if (!idwStream.readVertex(vtxIdx, si))
           return false;
-        vec3f vp = vertices[vtxIdx];
+        vec3f vp = vertex(vtxIdx);
         float dist2 = dot(vp - P, vp - P);
         float w = 1.f / fmaxf(dist2, 1e-20f);
         weightSum += w;
@@ -625,4 +756,43 @@ namespace BARNEY_NS {
     return true;
   }
 
+  inline __rtc_device
+  bool UMeshField::DD::walkToTet(float &retVal,
+                                 int &cellIdx,
+                                 vec3f P,
+                                 int maxSteps) const
+  {
+    for (int step=0;step<maxSteps;step++) {
+      if (cellIdx < 0) return false;
+      uint8_t cellType = cellTypes[cellIdx];
+      if (cellType != _ANARI_TET && cellType != _VTK_TET) return false;
+      const int *ix = indices + cellOffsets[cellIdx];
+      vec3f v0 = vertex(ix[0]);
+      vec3f v1 = vertex(ix[1]);
+      vec3f v2 = vertex(ix[2]);
+      vec3f v3 = vertex(ix[3]);
+      // same planes (and orientation) as in tetScalar()
+      float t[4] = {
+        evalToImplicitPlane(P,v1,v3,v2),
+        evalToImplicitPlane(P,v0,v2,v3),
+        evalToImplicitPlane(P,v0,v3,v1),
+        evalToImplicitPlane(P,v0,v1,v2)
+      };
+      int exitFace = 0;
+      for (int i=1;i<4;i++)
+        if (t[i] < t[exitFace]) exitFace = i;
+      if (t[exitFace] >= 0.f) {
+        if (scalarsArePerVertex) {
+          float scale = 1.f/(t[0]+t[1]+t[2]+t[3]);
+          retVal = scale * (t[0]*scalars[ix[0]] + t[1]*scalars[ix[1]]
+                            + t[2]*scalars[ix[2]] + t[3]*scalars[ix[3]]);
+        } else
+          retVal = scalars[cellIdx];
+        return true;
+      }
+      cellIdx = faceNeighbors[4*cellIdx+exitFace];
+    }
+    return false;
+  }
+
 }
@@ -0,0 +1,171 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "barney/umesh/iso/UMeshActiveIso.h"
+#include "barney/Context.h"
+#if RTC_DEVICE_CODE
+# include "rtcore/ComputeInterface.h"
+#endif
+
+namespace BARNEY_NS {
+
+  RTC_IMPORT_USER_GEOM(/*file*/UMeshActiveIso,/*name*/UMeshActiveIso,
+                       /*geomtype device data */
+                       UMeshActiveIsoAccel::DD,false,false);
+
+  __rtc_global
+  void umeshIsoElementRanges(rtc::ComputeInterface ci,
+                             UMeshField::DD mesh,
+                             range1f *elementRanges)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= mesh.numCells) return;
+    elementRanges[tid] = getRange(mesh.cellBounds(tid));
+#endif
+  }
+
+  /*! appends each element whose scalar range contains one of the iso
+      values - either the isoValues array, or, if that's empty, the
+      single isoValue - to activeElements */
+  __rtc_global
+  void umeshIsoActiveElements(rtc::ComputeInterface ci,
+                              const range1f *elementRanges,
+                              int numCells,
+                              float isoValue,
+                              const float *isoValues,
+                              int numIsoValues,
+                              int *activeElements,
+                              int *d_numActive)
+  {
+#if RTC_DEVICE_CODE
+    const int tid = ci.launchIndex().x;
+    if (tid >= numCells) return;
+    const range1f range = elementRanges[tid];
+    bool active
+      = numIsoValues == 0
+      && isoValue >= range.lower && isoValue <= range.upper;
+    for (int i=0;i<numIsoValues && !active;i++)
+      active = isoValues[i] >= range.lower && isoValues[i] <= range.upper;
+    if (active)
+      activeElements[ci.atomicAdd(d_numActive,1)] = tid;
+#endif
+  }
+
+  UMeshActiveIsoAccel::UMeshActiveIsoAccel(IsoSurface *isoSurface,
+                                           const std::shared_ptr<UMeshField> &mesh)
+    : IsoSurfaceAccel(isoSurface),
+      mesh(mesh)
+  {
+    perLogical.resize(devices->numLogical);
+  }
+
+  UMeshActiveIsoAccel::~UMeshActiveIsoAccel()
+  {
+    freeElementData();
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      if (pld->d_numActive)
+        device->rtc->freeMem(pld->d_numActive);
+      pld->d_numActive = 0;
+      // iw - do NOT free the geom we created - geometries free their
+      // own geoms when they die, if we free here we'll get a double
+      // free.
+    }
+  }
+
+  void UMeshActiveIsoAccel::freeElementData()
+  {
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      if (pld->elementRanges)
+        device->rtc->freeMem(pld->elementRanges);
+      if (pld->activeElements)
+        device->rtc->freeMem(pld->activeElements);
+      pld->elementRanges  = 0;
+      pld->activeElements = 0;
+      pld->numActive      = 0;
+    }
+    rangesFor = {};
+  }
+
+  UMeshActiveIsoAccel::DD UMeshActiveIsoAccel::getDD(Device *device)
+  {
+    DD dd;
+    dd.isoSurface     = isoSurface->getDD(device,mesh);
+    dd.activeElements = getPLD(device)->activeElements;
+    return dd;
+  }
+
+  void UMeshActiveIsoAccel::build()
+  {
+    const int numCells = (int)mesh->cellOffsets->count;
+    const bool rangesValid
+      =  rangesFor.scalars  == mesh->scalars.get()
+      && rangesFor.vertices == mesh->vertices.get()
+      && rangesFor.indices  == mesh->indices.get()
+      && rangesFor.numCells == numCells;
+    if (!rangesValid) {
+      freeElementData();
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        PLD *pld = getPLD(device);
+        pld->elementRanges
+          = (range1f*)device->rtc->allocMem(numCells*sizeof(range1f));
+        pld->activeElements
+          = (int*)device->rtc->allocMem(numCells*sizeof(int));
+        __rtc_launch(device->rtc,umeshIsoElementRanges,
+                     divRoundUp(numCells,128),128,
+                     mesh->getDD(device),pld->elementRanges);
+      }
+      rangesFor.scalars  = mesh->scalars.get();
+      rangesFor.vertices = mesh->vertices.get();
+      rangesFor.indices  = mesh->indices.get();
+      rangesFor.numCells = numCells;
+    }
+
+    PODData::SP isoValues = isoSurface->isoValues;
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      if (!pld->d_numActive)
+        pld->d_numActive = (int*)device->rtc->allocMem(sizeof(int));
+      device->rtc->memsetAsync(pld->d_numActive,0,sizeof(int));
+      __rtc_launch(device->rtc,umeshIsoActiveElements,
+                   divRoundUp(numCells,128),128,
+                   pld->elementRanges,numCells,
+                   isoSurface->isoValue,
+                   (const float *)(isoValues ? isoValues->getDD(device) : 0),
+                   int(isoValues ? isoValues->count : 0),
+                   pld->activeElements,pld->d_numActive);
+      device->rtc->copy(&pld->numActive,pld->d_numActive,sizeof(int));
+
+      if (!pld->geom) {
+        rtc::GeomType *gt
+          = device->geomTypes.get(createGeomType_UMeshActiveIso);
+        pld->geom = gt->createGeom();
+      }
+      rtc::Geom *geom = pld->geom;
+      IsoSurface::PLD *isoSurfacePLD = isoSurface->getPLD(device);
+      if (pld->numActive == 0) {
+        // surface doesn't pass through any element; nothing to trace
+        isoSurfacePLD->userGeoms = {};
+        continue;
+      }
+      geom->setPrimCount(pld->numActive);
+      DD dd = getDD(device);
+      geom->setDD(&dd);
+      isoSurfacePLD->userGeoms = { geom };
+    }
+    if (FromEnv::get()->logConfig) {
+      Device *device = (*devices)[0];
+      std::cout << "#bn.umesh: iso-surface over "
+                << getPLD(device)->numActive << " of " << numCells
+                << " elements" << std::endl;
+    }
+  }
+
+}
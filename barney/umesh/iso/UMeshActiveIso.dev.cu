@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+/*! \file UMeshActiveIso.dev.cu implements iso-surfaces over
+    unstructured meshes by intersecting, per ray, only the 'active'
+    elements - those the iso-surface passes through - that the BVH
+    returns; see UMeshActiveIsoAccel */
+
+#include "barney/umesh/iso/UMeshActiveIso.h"
+#include "rtcore/TraceInterface.h"
+
+RTC_DECLARE_GLOBALS(BARNEY_NS::render::OptixGlobals);
+
+namespace BARNEY_NS {
+
+  struct UMeshActiveIso_Programs {
+    static inline __rtc_device
+    void bounds(const rtc::TraceInterface &ti,
+                const void *geomData,
+                owl::common::box3f &bounds,
+                const int32_t primID)
+    {
+#if RTC_DEVICE_CODE
+      UMeshActiveIsoAccel::boundsProg(ti,geomData,bounds,primID);
+#endif
+    }
+
+    static inline __rtc_device
+    void intersect(rtc::TraceInterface &ti)
+    {
+#if RTC_DEVICE_CODE
+      UMeshActiveIsoAccel::isProg(ti);
+#endif
+    }
+
+    static inline __rtc_device
+    void closestHit(rtc::TraceInterface &ti)
+    { /* nothing to do */ }
+
+    static inline __rtc_device
+    void anyHit(rtc::TraceInterface &ti)
+    { /* nothing to do */ }
+  };
+
+  using UMeshActiveIso = UMeshActiveIsoAccel;
+
+  RTC_EXPORT_USER_GEOM(UMeshActiveIso,UMeshActiveIso::DD,
+                       UMeshActiveIso_Programs,false,false);
+}
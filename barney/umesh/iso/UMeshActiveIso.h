@@ -0,0 +1,160 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "barney/umesh/common/UMeshField.h"
+
+namespace BARNEY_NS {
+
+  /*! iso-surface accel over an unstructured mesh that contains only
+      the mesh's 'active' elements - those whose scalar range
+      straddles one of the iso values. At build, a kernel tests each
+      element's (cached) scalar range against the iso values and
+      compacts the active ones into a list, with one user-geom prim -
+      and thus one BVH leaf - per active element. For typical iso
+      values that's a small fraction of the mesh, and rays only ever
+      get to intersect elements that the surface actually passes
+      through. Changing the iso value(s) re-runs only that extraction
+      and the (much smaller) BVH build; the element ranges get
+      recomputed only if the mesh's arrays changed. */
+  struct UMeshActiveIsoAccel : public IsoSurfaceAccel
+  {
+    struct DD {
+      IsoSurface::DD<UMeshField> isoSurface;
+      /*! original mesh element index of each active element, ie,
+          of each prim */
+      const int *activeElements;
+    };
+
+    struct PLD {
+      rtc::Geom *geom           = 0;
+      /*! scalar range of each element of the mesh */
+      range1f   *elementRanges  = 0;
+      /*! room for all of the mesh's elements, of which the first
+          numActive are in use */
+      int       *activeElements = 0;
+      int       *d_numActive    = 0;
+      int        numActive      = 0;
+    };
+    PLD *getPLD(Device *device)
+    { return &perLogical[device->contextRank()]; }
+    std::vector<PLD> perLogical;
+
+    DD getDD(Device *device);
+
+    UMeshActiveIsoAccel(IsoSurface *isoSurface,
+                        const std::shared_ptr<UMeshField> &mesh);
+    ~UMeshActiveIsoAccel() override;
+
+    void build() override;
+
+#if BARNEY_DEVICE_PROGRAM
+    static inline __rtc_device
+    void boundsProg(const rtc::TraceInterface &ti,
+                    const void *geomData,
+                    owl::common::box3f &bounds,
+                    const int32_t primID);
+    static inline __rtc_device
+    void isProg(rtc::TraceInterface &ti);
+#endif
+
+    /*! frees element ranges and active-element lists */
+    void freeElementData();
+
+    const std::shared_ptr<UMeshField> mesh;
+    /*! the mesh arrays the current element ranges got computed
+        from */
+    struct {
+      const void *scalars     = 0;
+      const void *vertices    = 0;
+      const void *indices     = 0;
+      int         numCells    = 0;
+    } rangesFor;
+  };
+
+  // ==================================================================
+  // INLINE IMPLEMENTATION SECTION
+  // ==================================================================
+
+#if BARNEY_DEVICE_PROGRAM && RTC_DEVICE_CODE
+  /*! makes a single umesh element look like a scalar field sampler
+      (that is NaN everywhere outside that element), so the generic
+      iso-segment intersection and gradient code can run on it */
+  struct UMeshElementSampler {
+    inline __rtc_device
+    float sample(vec3f P, bool dbg=false) const
+    {
+      float value;
+      return mesh->eltScalar(value,eltID,P,dbg) ? value : NAN;
+    }
+
+    const UMeshField::DD *mesh;
+    uint32_t              eltID;
+  };
+
+  inline __rtc_device
+  void UMeshActiveIsoAccel::boundsProg(const rtc::TraceInterface &ti,
+                                       const void *geomData,
+                                       owl::common::box3f &bounds,
+                                       const int32_t primID)
+  {
+    const DD &self = *(const DD*)geomData;
+    bounds = getBox(self.isoSurface.sfSampler
+                    .cellBounds(self.activeElements[primID]));
+  }
+
+  inline __rtc_device
+  void UMeshActiveIsoAccel::isProg(rtc::TraceInterface &ti)
+  {
+    const DD &self = *(const DD*)ti.getProgramData();
+    Ray &ray = *(Ray*)ti.getPRD();
+#ifdef NDEBUG
+    const bool dbg = false;
+#else
+    const bool dbg = ray.dbg();
+#endif
+    DeviceCounters::count(render::OptixGlobals::get(ti).world.counters,
+                          DeviceCounters::PRIM_TESTS);
+
+    const UMeshField::DD &mesh = self.isoSurface.sfSampler;
+    const int eltID = self.activeElements[ti.getPrimitiveIndex()];
+    const box3f bounds = getBox(mesh.cellBounds(eltID));
+    range1f tRange = { ti.getRayTmin(), min(ti.getRayTmax(),ray.tMax) };
+
+    vec3f obj_org = ti.getObjectRayOrigin();
+    vec3f obj_dir = ti.getObjectRayDirection();
+    auto objRay = ray;
+    objRay.org = obj_org;
+    objRay.dir = obj_dir;
+    if (!boxTest(objRay,tRange,bounds))
+      return;
+
+    /* the box is all a single element, so the default step count
+       for crossing one macro cell is plenty */
+    UMeshElementSampler elt = { &mesh,(uint32_t)eltID };
+    const int numIsoValues = self.isoSurface.numIsoValues;
+    float tHit = tRange.upper;
+    if (numIsoValues == 0)
+      intersectIsoSegment(elt,obj_org,obj_dir,tRange,
+                          self.isoSurface.isoValue,1.f,tHit,dbg);
+    for (int i=0;i<numIsoValues;i++)
+      intersectIsoSegment(elt,obj_org,obj_dir,tRange,
+                          self.isoSurface.isoValues[i],1.f,tHit,dbg);
+    if (tHit >= tRange.upper) return;
+
+    Random rng(ray.rngSeed,hash(ti.getRTCInstanceIndex(),
+                                ti.getGeometryIndex(),
+                                ti.getPrimitiveIndex()));
+    const vec3f osP = obj_org + tHit * obj_dir;
+    float fP   = elt.sample(osP);
+    vec3f osN  = sampleGradient(elt,osP,length(bounds.size())*.1f,fP);
+    if (osN == vec3f(0.f) || isnan(fP))
+      osN = -normalize(obj_dir);
+    if (shadeIsoSurfaceHit(ti,self.isoSurface,osP,osN,tHit,eltID,rng,dbg))
+      ti.reportIntersection(tHit, 0);
+  }
+#endif
+
+}
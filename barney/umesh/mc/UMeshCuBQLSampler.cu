@@ -5,6 +5,8 @@
 
 
 #include "barney/umesh/mc/UMeshCuBQLSampler.h"
+#include "barney/common/AccelCache.h"
+#include "barney/common/KdPartition.h"
 #include "rtcore/ComputeInterface.h"
 
 namespace BARNEY_NS {
@@ -29,12 +31,21 @@ namespace BARNEY_NS {
     DD dd;
     (UMeshField::DD &)dd = mesh->getDD(device);
     dd.bvh = getPLD(device)->bvh;
+    if (mesh->isPartitioned())
+      // walking from tet to tet could leave this device's part
+      dd.faceNeighbors = 0;
     return dd;
   }
 
   void UMeshCuBQLSampler::build()
   {
     int numCells = mesh->numCells;
+    /* with automatic partitioning, each cell's part - from a k-d
+       split of all cells' centers - and all cells' bounds; each
+       device's bvh then gets built over only its own part's cells,
+       with all others' bounds set to empty */
+    std::vector<int>   cellParts;
+    std::vector<box3f> hostBounds;
     for (auto device : *devices) {
       PLD *pld = getPLD(device);
       if (pld->bvh.nodes != 0) {
@@ -56,6 +67,35 @@ namespace BARNEY_NS {
                               primBounds,valueRanges);
       device->rtc->sync();
 
+      if (mesh->isPartitioned()) {
+        if (cellParts.empty()) {
+          hostBounds.resize(numCells);
+          device->rtc->copy(hostBounds.data(),primBounds,
+                            numCells*sizeof(box3f));
+          std::vector<vec3f> centers(numCells);
+          for (int i=0;i<numCells;i++)
+            centers[i] = hostBounds[i].center();
+          cellParts = kdPartition(centers,devices->partitionWeights());
+        }
+        std::vector<box3f> partBounds = hostBounds;
+        for (int i=0;i<numCells;i++)
+          if (cellParts[i] != device->partition.rank)
+            partBounds[i] = box3f();
+        device->rtc->copy(primBounds,partBounds.data(),
+                          numCells*sizeof(box3f));
+      }
+
+      uint64_t cacheKey = 0;
+      if (AccelCache::enabled()) {
+        cacheKey = AccelCache::keyFor(device,primBounds,numCells,
+                                      typeName());
+        if (AccelCache::loadBVH(device,"umeshCuBQL",cacheKey,pld->bvh)) {
+          device->rtc->freeMem(primBounds);
+          device->rtc->freeMem(valueRanges);
+          continue;
+        }
+      }
+      
 #if BARNEY_RTC_EMBREE || defined(__HIPCC__)
       cuBQL::cpu::spatialMedian(pld->bvh,
                                 (const cuBQL::box_t<float,3>*)primBounds,
@@ -74,6 +114,8 @@ namespace BARNEY_NS {
                         memResource);
 #endif
       device->rtc->sync();
+      if (AccelCache::enabled())
+        AccelCache::storeBVH(device,"umeshCuBQL",cacheKey,pld->bvh);
       device->rtc->freeMem(primBounds);
       device->rtc->freeMem(valueRanges);
     }
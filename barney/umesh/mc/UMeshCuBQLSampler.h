@@ -23,6 +23,10 @@ namespace BARNEY_NS {
     
     struct DD : public UMeshField::DD {
       inline __rtc_device float sample(vec3f P, bool dbg = false) const;
+      /*! same as sample(), but also returns the containing element
+          (or -1) */
+      inline __rtc_device float sample(vec3f P, int &cellIdx,
+                                       bool dbg = false) const;
       
       bvh_t bvh;
     };
@@ -50,21 +54,51 @@ namespace BARNEY_NS {
   
   inline __rtc_device
   float UMeshCuBQLSampler::DD::sample(vec3f P, bool dbg) const
+  {
+    int cellIdx;
+    return sample(P,cellIdx,dbg);
+  }
+  
+  inline __rtc_device
+  float UMeshCuBQLSampler::DD::sample(vec3f P, int &cellIdx, bool dbg) const
   {
     typename bvh_t::box_t box; box.lower = box.upper = to_cubql(P);
 
     float retVal = NAN;
-    auto lambda = [this,P,&retVal,dbg]
+    cellIdx = -1;
+    auto lambda = [this,P,&retVal,&cellIdx,dbg]
       // __rtc_device
       (const uint32_t primID)
     {
-      if (this->eltScalar(retVal,primID,P,dbg))
+      if (this->eltScalar(retVal,primID,P,dbg)) {
+        cellIdx = primID;
         return CUBQL_TERMINATE_TRAVERSAL;
+      }
       return CUBQL_CONTINUE_TRAVERSAL;
     };
     cuBQL::fixedBoxQuery::forEachPrim(lambda,bvh,box);
     return retVal;
   }
+
+  /*! point location for successive samples along a ray: if the mesh
+      has face neighbors, first walks there from the previous
+      sample's tet, and only falls back to a bvh query if that
+      fails. Overload of the generic sampleWithHint() in
+      MCAccelerator.h */
+  inline __rtc_device
+  float sampleWithHint(const UMeshCuBQLSampler::DD &sampler,
+                       vec3f P, int &hint, bool dbg)
+  {
+    if (sampler.faceNeighbors && hint >= 0) {
+      float retVal;
+      int cellIdx = hint;
+      if (sampler.walkToTet(retVal,cellIdx,P)) {
+        hint = cellIdx;
+        return retVal;
+      }
+    }
+    return sampler.sample(P,hint,dbg);
+  }
   
 } // ::BARNEY_NS
 
@@ -71,6 +71,8 @@ namespace BARNEY_NS {
 
     AWTAccel(Volume *volume,
              UMeshField *mesh);
+
+    std::string toString() const override { return "AWTAccel"; }
     
     void build(bool full_rebuild) override;
 
@@ -42,6 +42,8 @@ namespace barney {
     //     mesh(mesh)
     // {}
       static OWLGeomType createGeomType(DevGroup *devGroup);
+
+      std::string toString() const override { return "RTXObjectSpace"; }
     
       void build(bool full_rebuild) override;
       void createClusters();
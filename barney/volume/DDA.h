@@ -204,6 +204,46 @@ namespace BARNEY_NS {
         }
       }
     }
+
+    /*! two-level dda: walks a coarse grid whose cells cover ratio^3
+        cells of the (fine) grid each, and only for those coarse cells
+        that coarseLambda accepts walks the fine cells inside - so
+        whole empty coarse cells get skipped in a single step. 'lambda'
+        gets called exactly like in dda3(). With an empty coarse grid
+        this is just dda3() on the fine grid */
+    template<typename CoarseLambda, typename Lambda>
+    inline __rtc_device void dda3Hierarchical(vec3f org,
+                                              vec3f dir,
+                                              float tMax,
+                                              vec3ui gridSize,
+                                              int ratio,
+                                              vec3ui coarseGridSize,
+                                              const CoarseLambda &coarseLambda,
+                                              const Lambda &lambda,
+                                              bool dbg)
+    {
+      if (coarseGridSize.x == 0) {
+        dda3(org,dir,tMax,gridSize,lambda,dbg);
+        return;
+      }
+      bool wantToGoOn = true;
+      // scaling both origin and direction keeps the ray's t
+      // parameterization the same in both grids
+      const float rcpRatio = 1.f/ratio;
+      dda3(org*rcpRatio,dir*rcpRatio,tMax,coarseGridSize,
+           [&](const vec3i &coarseCell, float t0, float t1) -> bool
+           {
+             if (!coarseLambda(coarseCell))
+               return true;
+             dda3(org+t0*dir,dir,t1-t0,gridSize,
+                  [&](const vec3i &cell, float cell_t0, float cell_t1) -> bool
+                  {
+                    wantToGoOn = lambda(cell,t0+cell_t0,t0+cell_t1);
+                    return wantToGoOn;
+                  },dbg);
+             return wantToGoOn;
+           },dbg);
+    }
   }
 
 }
@@ -28,7 +28,11 @@ namespace BARNEY_NS {
     struct DD 
     {
       Volume::DD<SFSampler> volume;
+      /*! if numMerged > 0, the majorants are the sum over volume and
+          all merged ones */
       MajorantsGrid::DD     mcGrid;
+      int                   numMerged;
+      Volume::DD<SFSampler> merged[maxMergedVolumes-1];
     };
 
     struct PLD {
@@ -44,6 +48,9 @@ namespace BARNEY_NS {
       DD dd;
       dd.volume = volume->getDD(device,sfSampler);
       dd.mcGrid = majorantsGrid->getDD(device);
+      dd.numMerged = 0;
+      for (auto other : mergedVolumes)
+        dd.merged[dd.numMerged++] = other->getDD(device,sfSampler);
       return dd;
     }
 
@@ -52,10 +59,15 @@ namespace BARNEY_NS {
                   const std::shared_ptr<SFSampler> &sfSampler);
     ~MCVolumeAccel() override;
 
+    std::string toString() const override { return "MCVolumeAccel"; }
+
       GeomTypeCreationFct const creatorFct;
     
     void build(bool full_rebuild) override;
 
+    bool canMerge(VolumeAccel *other) const override;
+    void setMergedVolumes(const std::vector<Volume *> &others) override;
+    
 #if BARNEY_USE_MULTI_SCATTERING
     void rebuildMajorantsOnly() override;
 
@@ -142,7 +154,13 @@ namespace BARNEY_NS {
     if (!volume->sf->mcGrid || !volume->sf->mcGrid->built())
       return;
     majorantsGrid->computeMajorants(volume);
+    for (auto other : mergedVolumes)
+      majorantsGrid->addMajorants
+        (((MCVolumeAccel *)other->accel.get())->majorantsGrid.get());
     refreshDeviceData();
+    if (mergedInto)
+      // our majorants are part of the sum of the accel that traces us
+      mergedInto->accel->rebuildMajorantsOnly();
   }
 
   template<typename SFSampler>
@@ -161,6 +179,45 @@ namespace BARNEY_NS {
   }
 #endif
 
+  template<typename SFSampler>
+  bool MCVolumeAccel<SFSampler>::canMerge(VolumeAccel *other) const
+  {
+    auto otherMC = dynamic_cast<MCVolumeAccel *>(other);
+    return otherMC
+      && majorantsGrid
+      && otherMC->volume->sf == volume->sf
+      /* a merged traversal clips all volumes to the primary's box */
+      && otherMC->volume->clipBox.lower == volume->clipBox.lower
+      && otherMC->volume->clipBox.upper == volume->clipBox.upper
+      && otherMC->majorantsGrid
+      && otherMC->majorantsGrid->mcGrid == majorantsGrid->mcGrid;
+  }
+
+  template<typename SFSampler>
+  void MCVolumeAccel<SFSampler>::setMergedVolumes
+  (const std::vector<Volume *> &others)
+  {
+    mergedVolumes = others;
+    if (mergedVolumes.empty())
+      return;
+    assert(mergedVolumes.size() < maxMergedVolumes);
+#if BARNEY_USE_MULTI_SCATTERING
+    majorantsGrid->computeMajorants(volume);
+#else
+    majorantsGrid->computeMajorants(&volume->xf,volume->clipBox);
+#endif
+    for (auto other : mergedVolumes) {
+      auto otherMC = (MCVolumeAccel *)other->accel.get();
+      majorantsGrid->addMajorants(otherMC->majorantsGrid.get());
+    }
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      DD dd = getDD(device);
+      getPLD(device)->geom->setDD(&dd);
+      device->sbtDirty = true;
+    }
+  }
+  
   template<typename SFSampler>
   void MCVolumeAccel<SFSampler>::build(bool full_rebuild) 
   {
@@ -171,7 +228,7 @@ namespace BARNEY_NS {
 #if BARNEY_USE_MULTI_SCATTERING
     majorantsGrid->computeMajorants(volume);
 #else
-    majorantsGrid->computeMajorants(&volume->xf);
+    majorantsGrid->computeMajorants(&volume->xf,volume->clipBox);
 #endif
     sfSampler->build();
     
@@ -213,6 +270,7 @@ namespace BARNEY_NS {
   void MCIsoSurfaceAccel<SFSampler>::build() 
   {
     mcGrid = isoSurface->sf->getMCs();
+    mcGrid->buildSuperCells();
     sfSampler->build();
     
     for (auto device : *devices) {
@@ -313,6 +371,113 @@ namespace BARNEY_NS {
   // ------------------------------------------------------------------
 
 #if BARNEY_DEVICE_PROGRAM && RTC_DEVICE_CODE
+  /*! object-space gradient of given sampler's field at P (which has
+      value fP), by central differences over +/-delta; zero if it
+      can't be determined. Samplers that can do better (eg, from a
+      precomputed gradient texture) provide an overload for their DD
+      type, which gets picked up through ADL */
+  template<typename SamplerDD>
+  inline __rtc_device
+  vec3f sampleGradient(const SamplerDD &sampler,
+                       vec3f P, float delta, float fP)
+  {
+    float fPx0 = sampler.sample(P+vec3f(-delta,0.f,0.f));
+    float fPx1 = sampler.sample(P+vec3f(+delta,0.f,0.f));
+    float fPy0 = sampler.sample(P+vec3f(0.f,-delta,0.f));
+    float fPy1 = sampler.sample(P+vec3f(0.f,+delta,0.f));
+    float fPz0 = sampler.sample(P+vec3f(0.f,0.f,-delta));
+    float fPz1 = sampler.sample(P+vec3f(0.f,0.f,+delta));
+    float dx = 2.f;
+    float dy = 2.f;
+    float dz = 2.f;
+    if (isnan(fPx0)) { dx -= 1.f; fPx0 = fP; }
+    if (isnan(fPx1)) { dx -= 1.f; fPx1 = fP; }
+    if (isnan(fPy0)) { dy -= 1.f; fPy0 = fP; }
+    if (isnan(fPy1)) { dy -= 1.f; fPy1 = fP; }
+    if (isnan(fPz0)) { dz -= 1.f; fPz0 = fP; }
+    if (isnan(fPz1)) { dz -= 1.f; fPz1 = fP; }
+    return vec3f(dx == 0.f ? 0.f : (fPx1-fPx0) / dx,
+                 dy == 0.f ? 0.f : (fPy1-fPy0) / dy,
+                 dz == 0.f ? 0.f : (fPz1-fPz0) / dz);
+  }
+  
+  /*! samples given sampler at P, where 'hint' is whatever the
+      sampler has stored there for the previous sample along the same
+      ray (or -1 for the first), and may be updated. Generic version
+      ignores the hint; samplers whose point location can start from
+      where the previous sample was found (such as walking an
+      unstructured mesh's face neighbors) provide an overload for
+      their DD type, which gets picked up through ADL */
+  template<typename SamplerDD>
+  inline __rtc_device
+  float sampleWithHint(const SamplerDD &sampler,
+                       vec3f P, int &hint, bool dbg)
+  {
+    return sampler.sample(P,dbg);
+  }
+
+  /*! a volume that, for successive samples along one ray, passes a
+      point location hint from one sample to the next; see
+      sampleWithHint() */
+  template<typename VolumeDD>
+  struct HintedVolumeSampler {
+    inline __rtc_device
+    vec4f sampleAndMap(vec3f P, bool dbg=false) const
+    { return volume->map(sampleWithHint(volume->sfSampler,P,*hint,dbg),dbg); }
+
+    const VolumeDD *volume;
+    int            *hint;
+  };
+  
+  /*! makes an accel's volume plus the ones merged into it look like
+      a single volume whose density is the sum of theirs: samples the
+      (shared) field once per point, and maps that through each of
+      those volumes, remembering each one's sample so a collision can
+      later be attributed to one of them */
+  template<typename VolumeDD>
+  struct MergedVolumesSampler {
+    inline __rtc_device
+    const VolumeDD &get(int i) const
+    { return i == 0 ? *primary : merged[i-1]; }
+    
+    inline __rtc_device
+    vec4f sampleAndMap(vec3f P, bool dbg=false) const
+    {
+      float f = sampleWithHint(primary->sfSampler,P,*hint,dbg);
+      float sum = 0.f;
+      for (int i=0;i<=numMerged;i++) {
+        samples[i] = get(i).map(f,dbg);
+        sum += samples[i].w;
+      }
+      return vec4f(getPos(samples[0]),sum);
+    }
+
+    /*! picks one of the volumes, with probability proportional to
+        its share of the last sample's density */
+    inline __rtc_device
+    int pick(float r) const
+    {
+      float sum = 0.f;
+      for (int i=0;i<=numMerged;i++)
+        sum += samples[i].w;
+      r *= sum;
+      int which = 0;
+      for (int i=0;i<=numMerged;i++) {
+        if (samples[i].w <= 0.f) continue;
+        which = i;
+        if ((r -= samples[i].w) < 0.f) break;
+      }
+      return which;
+    }
+
+    const VolumeDD *primary;
+    const VolumeDD *merged;
+    int             numMerged;
+    /*! per volume, its mapped value at the last sampled point */
+    vec4f          *samples;
+    int            *hint;
+  };
+  
   template<typename SFSampler>
   inline __rtc_device
   void MCVolumeAccel<SFSampler>::boundsProg(const rtc::TraceInterface &ti,
@@ -322,6 +487,9 @@ namespace BARNEY_NS {
   {
     const DD &self = *(DD*)geomData;
     bounds = self.volume.sfCommon.worldBounds;
+    if (!self.volume.clipBox.empty())
+      bounds = box3f(max(bounds.lower,self.volume.clipBox.lower),
+                     min(bounds.upper,self.volume.clipBox.upper));
   }
   
   template<typename SFSampler>
@@ -335,6 +503,116 @@ namespace BARNEY_NS {
     bounds = self.isoSurface.sfCommon.worldBounds;
   }
   
+  /*! finds the first crossing of isoValue along the ray segment
+      org+t*dir, t in tRange, that crosses (roughly) numMCsCrossed
+      macro cells' widths; if found, returns true and lowers tHit to
+      it. Generic version: marches a number of steps proportional to
+      the segment's length, and refines linearly. Samplers that know
+      their native cells provide an overload for their DD type, which
+      gets picked up through ADL */
+  template<typename SamplerDD>
+  inline __rtc_device
+  bool intersectIsoSegment(const SamplerDD &sampler,
+                           vec3f org, vec3f dir,
+                           range1f tRange,
+                           float isoValue,
+                           float numMCsCrossed,
+                           float &tHit,
+                           bool dbg)
+  {
+    int numSteps = clamp(int(ceilf(10.f*numMCsCrossed)),2,32);
+    float tt1 = tRange.lower;
+    float ff1 = sampler.sample(org + tt1 * dir,dbg);
+    for (int i=1;i<=numSteps;i++) {
+      float tt0 = tt1;
+      float ff0 = ff1;
+      tt1 = lerp_l(i/float(numSteps),tRange.lower,tRange.upper);
+      ff1 = sampler.sample(org + tt1 * dir,dbg);
+      if (isnan(ff0) || isnan(ff1)) continue;
+      
+      if (dbg)
+        printf(" ... t [%f %f] v [ %f %f ]
+",tt0,tt1,ff0,ff1);
+      if (isoValue < min(ff0,ff1) || isoValue > max(ff0,ff1))
+        continue;
+      float t = (ff1 == ff0) ? 0.f : (isoValue - ff0) / (ff1-ff0);
+      tHit = min(tHit,lerp_l(t,tt0,tt1));
+      return true;
+    }
+    return false;
+  }
+  
+  /*! shades an iso-surface hit at object-space position osP with
+      (unnormalized) object-space normal osN, and writes its hit IDs;
+      shared by all iso-surface accels. Returns false if the hit got
+      rejected by the material's opacity */
+  template<typename IsoSurfaceDD>
+  inline __rtc_device
+  bool shadeIsoSurfaceHit(rtc::TraceInterface &ti,
+                          const IsoSurfaceDD &iso,
+                          vec3f osP, vec3f osN,
+                          float tHit, int primID,
+                          Random &rng, bool dbg)
+  {
+    const render::World::DD &world = render::OptixGlobals::get(ti).world;
+    Ray &ray = *(Ray*)ti.getPRD();
+    vec3f n = ti.transformNormalFromObjectToWorldSpace(osN);
+    int instID    = ti.getInstanceID();
+    
+    render::HitAttributes hitData;
+    hitData.worldPosition   = ti.transformPointFromObjectToWorldSpace(osP);
+    hitData.worldNormal     = normalize(n);
+    hitData.objectPosition  = osP;
+    hitData.objectNormal    = make_vec4f(normalize(osN));
+    hitData.primID          = primID;
+    hitData.instID          = instID;
+    hitData.t               = tHit;
+    hitData.isShadowRay     = ray.isShadowRay;
+    float u = 0.f;
+    float v = 0.f;
+    auto interpolator
+      = [u,v,dbg](const GeometryAttribute::DD &attrib,
+                  bool faceVarying) -> vec4f
+      {
+        return vec4f(1.f);
+      };
+    iso.setHitAttributes(hitData,interpolator,world,dbg);
+
+    const DeviceMaterial &material
+      = world.materials[iso.materialID];
+      
+    PackedBSDF bsdf
+      = material.createBSDF(hitData,world.samplers,dbg);
+    float opacity
+      = bsdf.getOpacity(ray.isShadowRay,ray.isInMedium,
+                        ray.dir,hitData.worldNormal,ray.dbg());
+    if (opacity < 1.f) {
+      if (rng() > opacity) {
+        return false;
+      }
+    }
+    material.setHit(ray,hitData,world.samplers,dbg);
+
+    // Write hit IDs for AOV channels
+    const render::OptixGlobals &globals = render::OptixGlobals::get(ti);
+    if (globals.hitIDs) {
+      const int rayID
+        = ti.getLaunchIndex().x
+        + ti.getLaunchDims().x
+        * ti.getLaunchIndex().y;
+      if (tHit < globals.hitIDs[rayID].depth) {
+        globals.hitIDs[rayID].primID = primID;
+        globals.hitIDs[rayID].instID
+          = globals.world.instIDToUserInstID
+          ? globals.world.instIDToUserInstID[instID]
+          : instID;
+        globals.hitIDs[rayID].objID  = iso.userID;
+        globals.hitIDs[rayID].depth  = tHit;
+      }
+    }
+    return true;
+  }
+  
   template<typename SFSampler>
   inline __rtc_device
   void MCIsoSurfaceAccel<SFSampler>::isProg(rtc::TraceInterface &ti)
@@ -342,7 +620,6 @@ namespace BARNEY_NS {
     const void *pd = ti.getProgramData();
            
     const DD &self = *(typename MCIsoSurfaceAccel<SFSampler>::DD*)pd;
-    const render::World::DD &world = render::OptixGlobals::get(ti).world;
     // ray in world space
     Ray &ray = *(Ray*)ti.getPRD();
 #ifdef NDEBUG
@@ -398,76 +675,45 @@ namespace BARNEY_NS {
                                      ti.getPrimitiveIndex())));
 #endif
     
+    const float isoValue = self.isoSurface.isoValue;
     float tHit = ray.tMax;
-    dda::dda3(dda_org,dda_dir,tRange.upper,
+    uint64_t *counters = OptixGlobals::get(ti).world.counters;
+    dda::dda3Hierarchical(dda_org,dda_dir,tRange.upper,
               vec3ui(self.mcGrid.dims),
+              MCGrid::cellsPerSuperCell,
+              vec3ui(self.mcGrid.superDims),
+              [&](const vec3i &superIdx) -> bool
+              {
+                range1f valueRange = self.mcGrid.superRange(superIdx);
+                return
+                  isoValue >= valueRange.lower &&
+                  isoValue <= valueRange.upper;
+              },
               [&](const vec3i &cellIdx, float t0, float t1) -> bool
               {
-                float _t0 = t0;
-                float _t1 = t1;
-                range1f tRange = range1f {t0,min(t1,ray.tMax)};
-                if (tRange.lower >= tRange.upper) return true;
+                if (t0 >= min(t1,ray.tMax)) return true;
+                DeviceCounters::count(counters,DeviceCounters::DDA_CELLS);
                 
                 range1f valueRange = self.mcGrid.scalarRange(cellIdx);
-                
-                // scalar values at begin/end of current ray segment
-                // (NOT sorted by value as valuerange is!)
-                float ff0 = 0.f, ff1 = 0.f;
                 if (dbg) printf("dda %i %i %i [%f %f] -> [%f %f]\n",
                                 cellIdx.x,
                                 cellIdx.y,
                                 cellIdx.z,
-                                tRange.lower,
-                                tRange.upper,
+                                t0,t1,
                                 valueRange.lower,
                                 valueRange.upper);
-                auto overlaps = [&](float isoValue)
-                {
-                  return
-                    isoValue >= valueRange.lower &&
-                    isoValue <= valueRange.upper;
-                };
-                if (!overlaps(self.isoSurface.isoValue))
+                if (isoValue < valueRange.lower ||
+                    isoValue > valueRange.upper)
                   return true;
 
-                auto intersect = [&](float isoValue)
-                {
-                  float t = (isoValue - ff0) / (ff1-ff0);
-                  t = lerp_l(t,tRange.lower,tRange.upper);
-                  tHit = min(tHit,t);
-                };
-                  
-
-                float tt1 = t0;
-                vec3f P = obj_org + tt1 * obj_dir;
-                ff1 = self.isoSurface.sfSampler.sample(P,dbg);
-                int numSteps = 10; 
-                for (int i=1;i<=numSteps;i++) {
-                  float tt0 = tt1;
-                  ff0 = ff1;
-                  tt1 = lerp_l(i/float(numSteps),_t0,_t1);
-                  P = obj_org + tt1 * obj_dir;
-                  ff1 = self.isoSurface.sfSampler.sample(P,dbg);
-                  if (isnan(ff0) || isnan(ff1)) continue;
-                  
-                  valueRange.lower = min(ff0,ff1);
-                  valueRange.upper = max(ff0,ff1);
-                  tRange = range1f{tt0,tt1};
-                  
-                  if (dbg)
-                    printf(" ... t [%f %f] v [ %f %f ]\n",
-                           tRange.lower,
-                           tRange.upper,
-                           valueRange.lower,
-                           valueRange.upper);
-                  if (overlaps(self.isoSurface.isoValue)) {
-                    intersect(self.isoSurface.isoValue);
-                    if (tHit < ray.tMax) {
-                      return false;
-                    }
-                  }
-                }
-
+                float numMCsCrossed = length(dda_dir) * (t1-t0);
+                if (intersectIsoSegment(self.isoSurface.sfSampler,
+                                        obj_org,obj_dir,
+                                        range1f{t0,t1},
+                                        isoValue,numMCsCrossed,
+                                        tHit,dbg)
+                    && tHit < ray.tMax)
+                  return false;
                 return true;
               },
               /*NO debug:*/false
@@ -478,92 +724,16 @@ namespace BARNEY_NS {
     // get texture coordinates
     // ------------------------------------------------------------------
     const vec3f osP  = obj_org + tHit * obj_dir;
-    vec3f P  = ti.transformPointFromObjectToWorldSpace(osP);
-#if 1
     float delta
       = length(bounds.size()) * .1f
       / float(self.mcGrid.dims.x+self.mcGrid.dims.y+self.mcGrid.dims.z);
     
     float fP   = self.isoSurface.sfSampler.sample(osP);
-    float fPx0 = self.isoSurface.sfSampler.sample(osP+vec3f(-delta,0.f,0.f));
-    float fPx1 = self.isoSurface.sfSampler.sample(osP+vec3f(+delta,0.f,0.f));
-    float fPy0 = self.isoSurface.sfSampler.sample(osP+vec3f(0.f,-delta,0.f));
-    float fPy1 = self.isoSurface.sfSampler.sample(osP+vec3f(0.f,+delta,0.f));
-    float fPz0 = self.isoSurface.sfSampler.sample(osP+vec3f(0.f,0.f,-delta));
-    float fPz1 = self.isoSurface.sfSampler.sample(osP+vec3f(0.f,0.f,+delta));
-    float dx = 2.f;
-    float dy = 2.f;
-    float dz = 2.f;
-    if (isnan(fPx0)) { dx -= 1.f; fPx0 = fP; }
-    if (isnan(fPx1)) { dx -= 1.f; fPx1 = fP; }
-    if (isnan(fPy0)) { dy -= 1.f; fPy0 = fP; }
-    if (isnan(fPy1)) { dy -= 1.f; fPy1 = fP; }
-    if (isnan(fPz0)) { dz -= 1.f; fPz0 = fP; }
-    if (isnan(fPz1)) { dz -= 1.f; fPz1 = fP; }
-    vec3f osN(dx == 0.f ? 0.f : (fPx1-fPx0) / dx,
-              dy == 0.f ? 0.f : (fPy1-fPy0) / dy,
-              dz == 0.f ? 0.f : (fPz1-fPz0) / dz);
+    vec3f osN  = sampleGradient(self.isoSurface.sfSampler,osP,delta,fP);
     if (osN == vec3f(0.f))
       osN = -normalize(obj_dir);
-    vec3f n = ti.transformNormalFromObjectToWorldSpace(osN);
-#else
-    vec3f osN = - normalize(obj_dir);
-    vec3f n   = - normalize(obj_dir);
-#endif
-    int primID    = ti.getPrimitiveIndex();
-    int instID    = ti.getInstanceID();
-    
-    render::HitAttributes hitData;
-    hitData.worldPosition   = ti.transformPointFromObjectToWorldSpace(osP);
-    hitData.worldNormal     = normalize(n);
-    hitData.objectPosition  = osP;
-    hitData.objectNormal    = make_vec4f(normalize(osN));
-    hitData.primID          = primID;
-    hitData.instID          = instID;
-    hitData.t               = tHit;
-    hitData.isShadowRay     = ray.isShadowRay;
-    float u = 0.f;
-    float v = 0.f;
-    auto interpolator
-      = [u,v,dbg](const GeometryAttribute::DD &attrib,
-                  bool faceVarying) -> vec4f
-      {
-        return vec4f(1.f);
-      };
-    self.isoSurface.setHitAttributes(hitData,interpolator,world,dbg);
-
-    const DeviceMaterial &material
-      = world.materials[self.isoSurface.materialID];
-      
-    PackedBSDF bsdf
-      = material.createBSDF(hitData,world.samplers,dbg);
-    float opacity
-      = bsdf.getOpacity(ray.isShadowRay,ray.isInMedium,
-                        ray.dir,hitData.worldNormal,ray.dbg());
-    if (opacity < 1.f) {
-      if (rng() > opacity) {
-        return;
-      }
-    }
-    material.setHit(ray,hitData,world.samplers,dbg);
-
-    // Write hit IDs for AOV channels
-    const render::OptixGlobals &globals = render::OptixGlobals::get(ti);
-    if (globals.hitIDs) {
-      const int rayID
-        = ti.getLaunchIndex().x
-        + ti.getLaunchDims().x
-        * ti.getLaunchIndex().y;
-      if (tHit < globals.hitIDs[rayID].depth) {
-        globals.hitIDs[rayID].primID = primID;
-        globals.hitIDs[rayID].instID
-          = globals.world.instIDToUserInstID
-          ? globals.world.instIDToUserInstID[instID]
-          : instID;
-        globals.hitIDs[rayID].objID  = self.isoSurface.userID;
-        globals.hitIDs[rayID].depth  = tHit;
-      }
-    }
+    shadeIsoSurfaceHit(ti,self.isoSurface,osP,osN,tHit,
+                       ti.getPrimitiveIndex(),rng,dbg);
   }
   
   template<typename SFSampler>
@@ -595,6 +765,12 @@ namespace BARNEY_NS {
 
     if (!boxTest(objRay,tRange,bounds))
       return;
+    /* cells entirely outside the clip box have zero majorants
+       already; this clips those that are partly inside, for all
+       cells at once */
+    if (!self.volume.clipBox.empty() &&
+        !boxTest(objRay,tRange,self.volume.clipBox))
+      return;
     
     // ------------------------------------------------------------------
     // compute ray in macro cell grid space 
@@ -610,25 +786,81 @@ namespace BARNEY_NS {
 
     Random rng(ray.rngSeed,hash(ti.getRTCInstanceIndex(),
                                 ti.getGeometryIndex(),0));
-    dda::dda3(dda_org,dda_dir,tRange.upper,
+    int hint = -1;
+    HintedVolumeSampler<Volume::DD<SFSampler>> hinted
+      = { &self.volume, &hint };
+    vec4f mergedSamples[maxMergedVolumes];
+    MergedVolumesSampler<Volume::DD<SFSampler>> merged
+      = { &self.volume, self.merged, self.numMerged, mergedSamples, &hint };
+    uint64_t *counters = OptixGlobals::get(ti).world.counters;
+    dda::dda3Hierarchical(dda_org,dda_dir,tRange.upper,
               vec3ui(self.mcGrid.dims),
+              MCGrid::cellsPerSuperCell,
+              vec3ui(self.mcGrid.superDims),
+              [&](const vec3i &superIdx) -> bool
+              { return self.mcGrid.superMajorant(superIdx) > 0.f; },
               [&](const vec3i &cellIdx, float t0, float t1) -> bool
               {
+                DeviceCounters::count(counters,DeviceCounters::DDA_CELLS);
                 const float majorant = self.mcGrid.majorant(cellIdx);
                 
                 if (majorant == 0.f) return true;
                 
                 vec4f   sample = 0.f;
                 range1f tRange = {t0,min(t1,ray.tMax)};
-                if (!Woodcock::sampleRange(sample,
-                                           self.volume,
-                                           obj_org,
-                                           obj_dir,
-                                           tRange,
-                                           majorant,
-                                           rng,
-                                           dbg)) 
+                if (ray.isShadowRay && self.volume.ratioTracking) {
+                  float &transmittance = shadowTransmittance(ray.hitBSDF);
+                  if (self.numMerged == 0
+                      ? Woodcock::ratioTrack(transmittance,
+                                             hinted,
+                                             obj_org,
+                                             obj_dir,
+                                             tRange,
+                                             majorant,
+                                             rng,
+                                             dbg,
+                                             counters)
+                      : Woodcock::ratioTrack(transmittance,
+                                             merged,
+                                             obj_org,
+                                             obj_dir,
+                                             tRange,
+                                             majorant,
+                                             rng,
+                                             dbg,
+                                             counters))
+                    return true;
+                  // russian roulette killed it; that's occlusion
+                  ray.setOccluded(tRange.upper);
+                  ti.reportIntersection(tRange.upper, 0);
+                  return false;
+                }
+                if (self.numMerged == 0
+                    ? !Woodcock::sampleRange(sample,
+                                             hinted,
+                                             obj_org,
+                                             obj_dir,
+                                             tRange,
+                                             majorant,
+                                             rng,
+                                             dbg,
+                                             counters)
+                    : !Woodcock::sampleRange(sample,
+                                             merged,
+                                             obj_org,
+                                             obj_dir,
+                                             tRange,
+                                             majorant,
+                                             rng,
+                                             dbg,
+                                             counters))
                   return true;
+                // with merged volumes, the collision belongs to one
+                // of those, in proportion to their densities
+                int which = self.numMerged == 0 ? 0 : merged.pick(rng());
+                const Volume::DD<SFSampler> &hitVolume = merged.get(which);
+                if (self.numMerged > 0)
+                  sample = mergedSamples[which];
                 if (dbg) printf("woodcock hit sample %f %f %f:%f\n",
                                 sample.x,
                                 sample.y,
@@ -640,12 +872,12 @@ namespace BARNEY_NS {
 #if BARNEY_USE_MULTI_SCATTERING
                 vec3f tint = getPos(sample);
                 vec3f emission = vec3f(0.f);
-                float hitScatteringAlbedo = self.volume.scatteringAlbedo;
-                if (self.volume.principled.enabled) {
-                  float scalar = self.volume.sampleScalar(P_obj, dbg);
-                  vec3f sigma_s = principledSigmaS(scalar, self.volume.principled);
-                  vec3f sigma_a = principledSigmaA(scalar, self.volume.principled);
-                  vec4f tf = self.volume.xf.map(scalar, dbg);
+                float hitScatteringAlbedo = hitVolume.scatteringAlbedo;
+                if (hitVolume.principled.enabled) {
+                  float scalar = hitVolume.sampleScalar(P_obj, dbg);
+                  vec3f sigma_s = principledSigmaS(scalar, hitVolume.principled);
+                  vec3f sigma_a = principledSigmaA(scalar, hitVolume.principled);
+                  vec4f tf = hitVolume.xf.map(scalar, dbg);
                   if (tf.w > 0.f) {
                     sigma_s = sigma_s * tf.w;
                     sigma_a = sigma_a * tf.w;
@@ -660,20 +892,20 @@ namespace BARNEY_NS {
                     tint = ms > 0.f ? sigma_s / ms : tint;
                     hitScatteringAlbedo = reduce_max(sigma_s) / sigma_t;
                   }
-                  emission = principledEmission(scalar, self.volume.principled);
+                  emission = principledEmission(scalar, hitVolume.principled);
                 }
                 if (reduce_max(emission) > 0.f) {
                   ray.setVolumeHitWithEmission(P,
                                                tRange.upper,
                                                tint,
-                                               self.volume.anisotropy,
+                                               hitVolume.anisotropy,
                                                hitScatteringAlbedo,
                                                emission);
                 } else {
                   ray.setVolumeHit(P,
                                    tRange.upper,
                                    tint,
-                                   self.volume.anisotropy,
+                                   hitVolume.anisotropy,
                                    hitScatteringAlbedo);
                 }
 #else
@@ -695,7 +927,7 @@ namespace BARNEY_NS {
                       = globals.world.instIDToUserInstID
                       ? globals.world.instIDToUserInstID[ti.getInstanceID()]
                       : ti.getInstanceID();
-                    globals.hitIDs[rayID].objID  = self.volume.userID;
+                    globals.hitIDs[rayID].objID  = hitVolume.userID;
                     globals.hitIDs[rayID].depth  = tRange.upper;
                   }
                 }
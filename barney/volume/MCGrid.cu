@@ -13,12 +13,14 @@ namespace BARNEY_NS {
       devices(mcGrid->devices)
   {
     perLogical.resize(devices->numLogical);
+    MemoryScope memScope(devices.get(),BN_MEMORY_MAJORANT_GRIDS);
     for (auto device : *devices) {
       PLD *pld = getPLD(device);
       auto rtc = device->rtc;
       SetActiveGPU forDuration(device);
 
       pld->majorantsBuffer    = rtc->createBuffer(sizeof(float));
+      pld->superMajorantsBuffer = rtc->createBuffer(sizeof(float));
     }
   }
 
@@ -31,6 +33,10 @@ namespace BARNEY_NS {
         device->rtc->freeBuffer(pld->majorantsBuffer);
         pld->majorantsBuffer = 0;
       }
+      if (pld->superMajorantsBuffer) {
+        device->rtc->freeBuffer(pld->superMajorantsBuffer);
+        pld->superMajorantsBuffer = 0;
+      }
     }
   }
   
@@ -38,12 +44,14 @@ namespace BARNEY_NS {
     : devices(devices)
   {
     perLogical.resize(devices->numLogical);
+    MemoryScope memScope(devices.get(),BN_MEMORY_MAJORANT_GRIDS);
     for (auto device : *devices) {
       PLD *pld = getPLD(device);
       auto rtc = device->rtc;
       SetActiveGPU forDuration(device);
 
       pld->scalarRangesBuffer = rtc->createBuffer(sizeof(range1f));
+      pld->superRangesBuffer  = rtc->createBuffer(sizeof(range1f));
     }
   }
 
@@ -56,6 +64,14 @@ namespace BARNEY_NS {
         device->rtc->freeBuffer(pld->scalarRangesBuffer);
         pld->scalarRangesBuffer = 0;
       }
+      if (pld->superRangesBuffer) {
+        device->rtc->freeBuffer(pld->superRangesBuffer);
+        pld->superRangesBuffer = 0;
+      }
+      if (pld->valueMasksBuffer) {
+        device->rtc->freeBuffer(pld->valueMasksBuffer);
+        pld->valueMasksBuffer = 0;
+      }
     }
   }
 
@@ -70,6 +86,98 @@ namespace BARNEY_NS {
     grid.scalarRanges[ix] = { +BARNEY_INF, -BARNEY_INF };
   }
   
+  /*! reduces the cells' ranges (and, if majorants is non-null, the
+      cells' majorants) of each super-cell */
+  __rtc_global
+  void reduceSuperCells(const rtc::ComputeInterface &ci,
+                        MajorantsGrid::DD grid)
+  {
+    int ix = ci.getThreadIdx().x
+      +ci.getBlockIdx().x*ci.getBlockDim().x;
+    vec3i superDims = grid.superDims;
+    if (ix >= superDims.x*superDims.y*superDims.z) return;
+    vec3i superID(ix % superDims.x,
+                  (ix / superDims.x) % superDims.y,
+                  ix / (superDims.x*superDims.y));
+    vec3i begin = superID*int(MCGrid::cellsPerSuperCell);
+    vec3i end   = min(begin+vec3i(MCGrid::cellsPerSuperCell),grid.dims);
+    range1f range = { +BARNEY_INF, -BARNEY_INF };
+    float   maj   = 0.f;
+    for (int cz=begin.z;cz<end.z;cz++)
+      for (int cy=begin.y;cy<end.y;cy++)
+        for (int cx=begin.x;cx<end.x;cx++) {
+          int cellIdx = cx+grid.dims.x*(cy+grid.dims.y*cz);
+          if (grid.majorants)
+            maj = max(maj,grid.majorants[cellIdx]);
+          else {
+            range1f cellRange = grid.scalarRanges[cellIdx];
+            range.lower = min(range.lower,cellRange.lower);
+            range.upper = max(range.upper,cellRange.upper);
+          }
+        }
+    if (grid.majorants)
+      grid.superMajorants[ix] = maj;
+    else
+      grid.superRanges[ix] = range;
+  }
+  
+  void MCGrid::buildSuperCells()
+  {
+    size_t numSuperCells = owl::common::volume(superDims);
+    if (numSuperCells == 0) return;
+    const int bs = 128;
+    const int nb = (int)dru(numSuperCells,bs);
+    for (auto device : *devices) {
+      MajorantsGrid::DD dd;
+      (MCGrid::DD&)dd = getDD(device);
+      dd.majorants      = nullptr;
+      dd.superMajorants = nullptr;
+      __rtc_launch(device->rtc,
+                   reduceSuperCells,
+                   nb,bs,
+                   dd);
+    }
+    for (auto device : *devices) 
+      device->sync();
+  }
+  
+  void MajorantsGrid::computeSuperMajorants()
+  {
+    size_t numSuperCells = owl::common::volume(mcGrid->superDims);
+    if (numSuperCells == 0) return;
+    const int bs = 128;
+    const int nb = (int)dru(numSuperCells,bs);
+    for (auto device : *devices) {
+      auto dd = getDD(device);
+      __rtc_launch(device->rtc,
+                   reduceSuperCells,
+                   nb,bs,
+                   dd);
+    }
+    for (auto device : *devices) 
+      device->sync();
+  }
+  
+  void MCGrid::enableValueMasks(range1f valueRange)
+  {
+    MemoryScope memScope(devices.get(),BN_MEMORY_MAJORANT_GRIDS);
+    this->valueRange = valueRange;
+    size_t numCells = owl::common::volume(dims);
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      auto rtc = device->rtc;
+      if (pld->valueMasksBuffer)
+        rtc->freeBuffer(pld->valueMasksBuffer);
+      pld->valueMasksBuffer
+        = rtc->createBuffer(sizeof(uint32_t)*numCells);
+      rtc->memsetAsync(pld->valueMasksBuffer->getDD(),0,
+                       sizeof(uint32_t)*numCells);
+    }
+    for (auto device : *devices) 
+      device->sync();
+  }
+  
   /*! re-set all cells' ranges to "infinite empty" */
   void MCGrid::clearCells()
   {
@@ -104,14 +212,32 @@ namespace BARNEY_NS {
       +ci.getBlockIdx().x*ci.getBlockDim().x;
     if (ix >= grid.dims.x*grid.dims.y*grid.dims.z) return;
     range1f scalarRange = grid.scalarRanges[ix];
+    auto majorantOf = [&](range1f range) -> float
+    {
 #if BARNEY_USE_MULTI_SCATTERING
-    const float tfMaj = xf.majorant(scalarRange);
-    const float maj = principled.enabled
-      ? principledMajorant(scalarRange, principled) * tfMaj
-      : tfMaj;
+      const float tfMaj = xf.majorant(range);
+      return principled.enabled
+        ? principledMajorant(range, principled) * tfMaj
+        : tfMaj;
 #else
-    const float maj = xf.majorant(scalarRange);
+      return xf.majorant(range);
 #endif
+    };
+    float maj = 0.f;
+    if (grid.valueMasks) {
+      // only the value bins the cell's values actually cover can
+      // contribute, which is a lot tighter for spiky transfer
+      // functions than the cell's whole range
+      uint32_t mask = grid.valueMasks[ix];
+      for (int bin=0;bin<MCGrid::numValueBins;bin++) {
+        if (!(mask & (1u<<bin))) continue;
+        range1f binRange = grid.binRange(bin);
+        binRange.lower = max(binRange.lower,scalarRange.lower);
+        binRange.upper = min(binRange.upper,scalarRange.upper);
+        maj = max(maj,majorantOf(binRange));
+      }
+    } else
+      maj = majorantOf(scalarRange);
     grid.majorants[ix] = maj;
   }
   
@@ -142,9 +268,12 @@ namespace BARNEY_NS {
     }
     for (auto device : *devices) 
       device->sync();
+    clipMajorants(volume->clipBox);
+    computeSuperMajorants();
   }
 #else
-  void MajorantsGrid::computeMajorants(TransferFunction *xf)
+  void MajorantsGrid::computeMajorants(TransferFunction *xf,
+                                       const box3f &clipBox)
   {
     if (dims != mcGrid->dims)
       resize(mcGrid->dims); 
@@ -169,12 +298,84 @@ namespace BARNEY_NS {
     }
     for (auto device : *devices) 
       device->sync();
+    clipMajorants(clipBox);
+    computeSuperMajorants();
   }
 #endif
+
+  __rtc_global
+  void clipMCs(const rtc::ComputeInterface &ci,
+               MajorantsGrid::DD grid,
+               box3f clipBox)
+  {
+    int ix = ci.getThreadIdx().x
+      +ci.getBlockIdx().x*ci.getBlockDim().x;
+    if (ix >= grid.dims.x*grid.dims.y*grid.dims.z) return;
+    vec3i cellID(ix % grid.dims.x,
+                 (ix / grid.dims.x) % grid.dims.y,
+                 ix / (grid.dims.x*grid.dims.y));
+    vec3f lower = grid.gridOrigin + vec3f(cellID)*grid.gridSpacing;
+    vec3f upper = lower + grid.gridSpacing;
+    if (lower.x > clipBox.upper.x || upper.x < clipBox.lower.x ||
+        lower.y > clipBox.upper.y || upper.y < clipBox.lower.y ||
+        lower.z > clipBox.upper.z || upper.z < clipBox.lower.z)
+      grid.majorants[ix] = 0.f;
+  }
+
+  void MajorantsGrid::clipMajorants(const box3f &clipBox)
+  {
+    if (clipBox.empty())
+      return;
+    size_t numCells = owl::common::volume(dims);
+    if (numCells == 0) return;
+    const int bs = 1024;
+    const int nb = (int)dru(numCells,bs);
+    for (auto device : *devices) {
+      auto dd = getDD(device);
+      __rtc_launch(device->rtc,
+                   clipMCs,
+                   nb,bs,
+                   dd,clipBox);
+    }
+    for (auto device : *devices) 
+      device->sync();
+  }
+  
+  __rtc_global
+  void addMCs(const rtc::ComputeInterface &ci,
+              MajorantsGrid::DD grid,
+              const float *otherMajorants)
+  {
+    int ix = ci.getThreadIdx().x
+      +ci.getBlockIdx().x*ci.getBlockDim().x;
+    if (ix >= grid.dims.x*grid.dims.y*grid.dims.z) return;
+    grid.majorants[ix] += otherMajorants[ix];
+  }
+  
+  void MajorantsGrid::addMajorants(MajorantsGrid *other)
+  {
+    assert(other);
+    assert(other->dims == dims);
+    size_t numCells = owl::common::volume(dims);
+    if (numCells == 0) return;
+    const int bs = 1024;
+    const int nb = (int)dru(numCells,bs);
+    for (auto device : *devices) {
+      auto dd = getDD(device);
+      __rtc_launch(device->rtc,
+                   addMCs,
+                   nb,bs,
+                   dd,other->getDD(device).majorants);
+    }
+    for (auto device : *devices) 
+      device->sync();
+    computeSuperMajorants();
+  }
   
   /*! allocate memory for the given grid */
   void MajorantsGrid::resize(vec3i dims)
   {
+    MemoryScope memScope(devices.get(),BN_MEMORY_MAJORANT_GRIDS);
     assert(dims.x > 0);
     assert(dims.y > 0);
     assert(dims.z > 0);
@@ -183,15 +384,20 @@ namespace BARNEY_NS {
     mcGrid->resize(dims);
     this->dims = dims;
     size_t numCells = owl::common::volume(dims);
+    size_t numSuperCells
+      = std::max(owl::common::volume(mcGrid->superDims),(size_t)1);
     
     for (auto device : *devices) {
       SetActiveGPU forDuration(device);
       PLD *pld = getPLD(device);
       auto rtc = device->rtc;
       rtc->freeBuffer(pld->majorantsBuffer);
+      rtc->freeBuffer(pld->superMajorantsBuffer);
       
       pld->majorantsBuffer
         = rtc->createBuffer(sizeof(float)*numCells);
+      pld->superMajorantsBuffer
+        = rtc->createBuffer(sizeof(float)*numSuperCells);
     }
     for (auto device : *devices) 
       device->sync();
@@ -200,6 +406,7 @@ namespace BARNEY_NS {
   /*! allocate memory for the given grid */
   void MCGrid::resize(vec3i dims)
   {
+    MemoryScope memScope(devices.get(),BN_MEMORY_MAJORANT_GRIDS);
     assert(dims.x > 0);
     assert(dims.y > 0);
     assert(dims.z > 0);
@@ -207,13 +414,28 @@ namespace BARNEY_NS {
       return;
     this->dims = dims;
     size_t numCells = owl::common::volume(dims);
+    // small grids are cheap enough to traverse as they are
+    superDims
+      = (reduce_max(dims) > cellsPerSuperCell)
+      ? divRoundUp(dims,vec3i(cellsPerSuperCell))
+      : vec3i(0);
+    size_t numSuperCells
+      = std::max(owl::common::volume(superDims),(size_t)1);
     for (auto device : *devices) {
       SetActiveGPU forDuration(device);
       PLD *pld = getPLD(device);
       auto rtc = device->rtc;
       rtc->freeBuffer(pld->scalarRangesBuffer);
+      rtc->freeBuffer(pld->superRangesBuffer);
+      if (pld->valueMasksBuffer) {
+        // masks are for the old cells; fields have to re-enable them
+        rtc->freeBuffer(pld->valueMasksBuffer);
+        pld->valueMasksBuffer = 0;
+      }
       pld->scalarRangesBuffer
         = rtc->createBuffer(sizeof(range1f)*numCells);
+      pld->superRangesBuffer
+        = rtc->createBuffer(sizeof(range1f)*numSuperCells);
     }
     for (auto device : *devices) 
       device->sync();
@@ -233,6 +455,14 @@ namespace BARNEY_NS {
     dd.dims = dims;
     dd.gridOrigin = gridOrigin;
     dd.gridSpacing = gridSpacing;
+    dd.superRanges
+      = (range1f*)pld->superRangesBuffer->getDD();
+    dd.superDims = superDims;
+    dd.valueMasks
+      = pld->valueMasksBuffer
+      ? (uint32_t*)pld->valueMasksBuffer->getDD()
+      : nullptr;
+    dd.valueRange = valueRange;
     return dd;
   }
 
@@ -247,6 +477,8 @@ namespace BARNEY_NS {
     PLD *pld = getPLD(device);
     dd.majorants
       = (float *)pld->majorantsBuffer->getDD();
+    dd.superMajorants
+      = (float *)pld->superMajorantsBuffer->getDD();
     return dd;
   }
   
@@ -34,6 +34,10 @@ namespace BARNEY_NS {
       majorants. */
   struct MCGrid {
     typedef std::shared_ptr<MCGrid> SP;
+
+    /*! number of value bins in a cell's value mask; see
+        enableValueMasks() */
+    enum { numValueBins = 32 };
     
     /*! device data for this class - grid of per-cell ranges, grid of
       majorants, and dimensionality of grid */
@@ -44,6 +48,14 @@ namespace BARNEY_NS {
       vec3i    dims;
       vec3f    gridOrigin;
       vec3f    gridSpacing;
+      /*! per super-cell, the union of its cells' ranges; see
+          MCGrid::superDims */
+      range1f *superRanges;
+      vec3i    superDims;
+      /*! if non-null, per cell, a bit per value bin (of valueRange)
+          that any of the cell's (interpolated) values falls into */
+      uint32_t *valueMasks;
+      range1f   valueRange;
 
 #if RTC_DEVICE_CODE
       inline __rtc_device
@@ -51,6 +63,39 @@ namespace BARNEY_NS {
       {
         return scalarRanges[cellID.x+dims.x*(cellID.y+dims.y*cellID.z)];
       }
+
+      /*! bits of all value bins that given range overlaps */
+      inline __rtc_device
+      uint32_t valueMask(range1f r) const
+      {
+        if (r.lower > r.upper) return 0u;
+        float scale = numValueBins / max(valueRange.span(),1e-20f);
+        int lo = clamp(int((r.lower-valueRange.lower)*scale),
+                       0,int(numValueBins)-1);
+        int hi = clamp(int((r.upper-valueRange.lower)*scale),
+                       0,int(numValueBins)-1);
+        return (0xffffffffu >> (31-hi)) & (0xffffffffu << lo);
+      }
+
+      /*! range of values of given value bin */
+      inline __rtc_device
+      range1f binRange(int bin) const
+      {
+        float width = valueRange.span() / numValueBins;
+        range1f r;
+        r.lower = (bin == 0)
+          ? -BARNEY_INF : valueRange.lower+bin*width;
+        r.upper = (bin == numValueBins-1)
+          ? +BARNEY_INF : valueRange.lower+(bin+1)*width;
+        return r;
+      }
+
+      inline __rtc_device
+      range1f superRange(vec3i superID) const
+      {
+        return superRanges[superID.x
+                           +superDims.x*(superID.y+superDims.y*superID.z)];
+      }
       
       inline __rtc_device int numCells() const
       { return dims.x*dims.y*dims.z; }
@@ -92,6 +137,22 @@ namespace BARNEY_NS {
 
     /*! re-set all cells' ranges to "infinite empty" */
     void clearCells();
+
+    /*! computes the super-cells' ranges from the current cells'
+        ranges; no-op if the grid is too small to have super-cells */
+    void buildSuperCells();
+
+    /*! allocates (cleared) per-cell value masks over numValueBins
+        bins of given range, for a scalar field to fill in. With those,
+        majorants get computed from only the bins a cell covers,
+        rather than its whole range; fields that don't fill them in
+        just get range-based majorants */
+    void enableValueMasks(range1f valueRange);
+
+    /*! how many cells (per dimension) go into a super-cell of the
+        second, coarser level, which lets traversal skip larger empty
+        regions in a single step (see dda::dda3Hierarchical) */
+    enum { cellsPerSuperCell = 8 };
     
     /*! checks if this macro-cell grid has already been
       allocated/built - mostly for sanity checking nd debugging */
@@ -100,6 +161,10 @@ namespace BARNEY_NS {
     struct PLD {
       /* buffer of range1f's, the min/max scalar values per cell */
       rtc::Buffer *scalarRangesBuffer = 0;
+      /* same, per super-cell */
+      rtc::Buffer *superRangesBuffer  = 0;
+      /* uint32_t per cell, if value masks are enabled */
+      rtc::Buffer *valueMasksBuffer   = 0;
     };
     PLD *getPLD(Device *device) 
     { return &perLogical[device->localRank()]; } 
@@ -107,6 +172,10 @@ namespace BARNEY_NS {
 
     
     vec3i     dims { 0,0,0 };
+    /*! dimensions of the super-cell grid; all 0 if the grid is
+        small enough to not need one */
+    vec3i     superDims { 0,0,0 };
+    range1f   valueRange;
     vec3f     gridOrigin;
     vec3f     gridSpacing;
     const DevGroup::SP devices;
@@ -118,17 +187,28 @@ namespace BARNEY_NS {
     typedef std::shared_ptr<MajorantsGrid> SP;
     struct DD : public MCGrid::DD {
       float *majorants;
+      /*! per super-cell, the largest majorant of its cells */
+      float *superMajorants;
       
       inline __rtc_device
       float majorant(vec3i cellID) const
       {
         return majorants[cellID.x+dims.x*(cellID.y+dims.y*cellID.z)];
       }
+
+      inline __rtc_device
+      float superMajorant(vec3i superID) const
+      {
+        return superMajorants[superID.x
+                              +superDims.x*(superID.y+superDims.y*superID.z)];
+      }
     };
 
     struct PLD {
       /* buffer of floats, the actual per-cell majorants */
       rtc::Buffer *majorantsBuffer = 0;
+      /* same, per super-cell */
+      rtc::Buffer *superMajorantsBuffer = 0;
     };
     PLD *getPLD(Device *device) 
     { return &perLogical[device->localRank()]; } 
@@ -138,13 +218,21 @@ namespace BARNEY_NS {
     ~MajorantsGrid();
 
     /*! given the current per-cell scalar ranges, map each such cell's
-        range through the transfer functoin to compute a majorant */
+        range through the transfer functoin to compute a majorant;
+        cells entirely outside the (object-space) clip box, unless
+        that is empty, get a majorant of 0 */
 #if BARNEY_USE_MULTI_SCATTERING
     void computeMajorants(Volume *volume);
 #else
-    void computeMajorants(TransferFunction *xf);
+    void computeMajorants(TransferFunction *xf,
+                          const box3f &clipBox = box3f());
 #endif
 
+    /*! adds another grid's majorants (over the same macro cells) to
+        ours, so a single traversal can sample the sum of several
+        volumes' densities */
+    void addMajorants(MajorantsGrid *other);
+
     /*! allocate memory for the given grid */
     void resize(vec3i dims);
     
@@ -152,6 +240,13 @@ namespace BARNEY_NS {
       devices in the devgroup that this gris is in */
     DD getDD(Device *device);
 
+  private:
+    /*! zeroes the majorants of all cells outside given box */
+    void clipMajorants(const box3f &clipBox);
+    /*! reduces the cells' majorants to the super-cells' */
+    void computeSuperMajorants();
+  public:
+
     vec3i dims { 0, 0, 0 };
     MCGrid::SP const mcGrid;
     const DevGroup::SP devices;
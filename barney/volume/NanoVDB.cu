@@ -12,6 +12,7 @@
 #include "barney/common/Texture.h"
 #include "rtcore/ComputeInterface.h"
 #include "barney/volume/MCGrid.cuh"
+#include <nanovdb/tools/CreateNanoGrid.h>
 
 namespace BARNEY_NS {
 
@@ -24,40 +25,244 @@ namespace BARNEY_NS {
   BARNEY_NANOVDB_FLOAT_TYPES(NANOVDB_IMPORT_GEOM)
 #undef NANOVDB_IMPORT_GEOM
 
+  /*! the macro cells are aligned with (multiples of) the vdb leaf
+      nodes; this rasters the index-space box [lo,hi) of voxels with
+      given value range into all cells whose samples can see any of
+      those voxels (ie, grown by one voxel for the trilinear filter) */
+  inline __rtc_device
+  void NanoVDBData_rasterIndexBox(MCGrid::DD mcGrid,
+                                  vec3i cellOriginIdx,
+                                  int cellVoxels,
+                                  vec3i lo, vec3i hi,
+                                  range1f valueRange)
+  {
+    vec3i cellLo = (lo-1-cellOriginIdx)/cellVoxels;
+    vec3i cellHi = (hi  -cellOriginIdx)/cellVoxels;
+    cellLo = min(max(cellLo,vec3i(0)),mcGrid.dims-vec3i(1));
+    cellHi = min(max(cellHi,vec3i(0)),mcGrid.dims-vec3i(1));
+    for (int iz=cellLo.z;iz<=cellHi.z;iz++)
+      for (int iy=cellLo.y;iy<=cellHi.y;iy++)
+        for (int ix=cellLo.x;ix<=cellHi.x;ix++) {
+          const size_t cellID
+            = ix
+            + iy * (size_t)mcGrid.dims.x
+            + iz * (size_t)mcGrid.dims.x * (size_t)mcGrid.dims.y;
+          auto &cell = mcGrid.scalarRanges[cellID];
+          rtc::fatomicMin(&cell.lower,valueRange.lower);
+          rtc::fatomicMax(&cell.upper,valueRange.upper);
+        }
+  }
+  
+  /*! every voxel that isn't in a leaf or tile has the background
+      value, so that's where all cells start out */
   template<typename BuildType>
   __rtc_global
-  void NanoVDBData_computeMCs(const rtc::ComputeInterface &ci,
-                              MCGrid::DD mcGrid,
-                              NanoVDBData::DD dd)
+  void NanoVDBData_fillBackground(const rtc::ComputeInterface &ci,
+                                  MCGrid::DD mcGrid,
+                                  NanoVDBData::DD dd)
   {
+#if RTC_DEVICE_CODE
     using GridT = typename nanovdb::Grid<nanovdb::NanoTree<BuildType>>;
-
-    vec3i mcDims = mcGrid.dims;
     int tid = ci.launchIndex().x;
-    if (tid >= mcDims.x*mcDims.y*mcDims.z) return;
-    vec3i mcID(tid  %  mcDims.x,
-               (tid /  mcDims.x) % mcDims.y,
-               tid  / (mcDims.x  * mcDims.y));
+    if (tid >= mcGrid.dims.x*mcGrid.dims.y*mcGrid.dims.z) return;
+    GridT *gridPtr = (GridT *)dd.gridData;
+    float background = gridPtr->tree().background();
+    mcGrid.scalarRanges[tid] = { background,background };
+#endif
+  }
 
-    if (mcID.x >= mcGrid.dims.x) return;
-    if (mcID.y >= mcGrid.dims.y) return;
-    if (mcID.z >= mcGrid.dims.z) return;
+  /*! one thread per leaf node: computes the range of that leaf's
+      (active and inactive) values, and rasters it */
+  template<typename BuildType>
+  __rtc_global
+  void NanoVDBData_rasterLeaves(const rtc::ComputeInterface &ci,
+                                MCGrid::DD mcGrid,
+                                NanoVDBData::DD dd,
+                                int numLeaves,
+                                vec3i cellOriginIdx,
+                                int cellVoxels)
+  {
+#if RTC_DEVICE_CODE
+    using GridT = typename nanovdb::Grid<nanovdb::NanoTree<BuildType>>;
+    using LeafT = typename GridT::TreeType::LeafNodeType;
+    int tid = ci.launchIndex().x;
+    if (tid >= numLeaves) return;
+    GridT *gridPtr = (GridT *)dd.gridData;
+    const LeafT *leaf = gridPtr->tree().getFirstLeaf()+tid;
 
-    vec3i lo = dd.indexBounds.lower+(vec3i(mcID)*dd.gridSize) / mcGrid.dims;
-    vec3i hi = dd.indexBounds.lower+(vec3i(mcID+1)*dd.gridSize) / mcGrid.dims;
-    nanovdb::CoordBBox bbox({lo.x,lo.y,lo.z},
-                            {hi.x+1,hi.y+1,hi.z+1});
+    range1f valueRange;
+    for (uint32_t i=0;i<LeafT::NUM_VALUES;i++)
+      valueRange.extend(leaf->getValue(i));
+    auto origin = leaf->origin();
+    vec3i lo(origin[0],origin[1],origin[2]);
+    NanoVDBData_rasterIndexBox(mcGrid,cellOriginIdx,cellVoxels,
+                               lo,lo+vec3i(LeafT::DIM),valueRange);
+#endif
+  }
 
+  /*! one thread per table entry of all internal nodes of given
+      level (1=lower, 2=upper); entries that are tiles (rather than
+      children) have a constant value over the tile's entire box */
+  template<typename BuildType, int LEVEL>
+  __rtc_global
+  void NanoVDBData_rasterTiles(const rtc::ComputeInterface &ci,
+                               MCGrid::DD mcGrid,
+                               NanoVDBData::DD dd,
+                               int numNodes,
+                               vec3i cellOriginIdx,
+                               int cellVoxels)
+  {
+#if RTC_DEVICE_CODE
+    using GridT = typename nanovdb::Grid<nanovdb::NanoTree<BuildType>>;
+    using NodeT = typename nanovdb::NodeTrait<typename GridT::TreeType,LEVEL>::type;
+    using ChildT = typename NodeT::ChildNodeType;
+    int tid = ci.launchIndex().x;
+    if (tid >= numNodes*int(NodeT::SIZE)) return;
     GridT *gridPtr = (GridT *)dd.gridData;
-    auto acc = gridPtr->getAccessor();
+    const NodeT *node
+      = gridPtr->tree().template getFirstNode<LEVEL>()+(tid / NodeT::SIZE);
+    uint32_t n = uint32_t(tid % NodeT::SIZE);
+    if (node->isChild(n)) return;
+
+    float value = node->getValue(n);
+    if (value == float(gridPtr->tree().background()))
+      // already in all cells
+      return;
+    auto ijk = node->offsetToGlobalCoord(n);
+    vec3i lo(ijk[0],ijk[1],ijk[2]);
+    NanoVDBData_rasterIndexBox(mcGrid,cellOriginIdx,cellVoxels,
+                               lo,lo+vec3i(ChildT::DIM),{value,value});
+#endif
+  }
+  
+  /*! finds the [lo,hi) index range along given axis of the
+      partIndex'th of partCount slabs of the grid that have (roughly)
+      the same number of active voxels; slabs get cut only at
+      lower-internal-node boundaries */
+  template<typename BuildType>
+  vec2i NanoVDBData_findSlab(const nanovdb::GridHandle<> &handle,
+                             int axis, box3i indexBounds,
+                             int partCount, int partIndex)
+  {
+    using GridT  = typename nanovdb::Grid<nanovdb::NanoTree<BuildType>>;
+    using TreeT  = typename GridT::TreeType;
+    using LeafT  = typename TreeT::LeafNodeType;
+    using LowerT = typename TreeT::LowerNodeType;
+    using UpperT = typename TreeT::UpperNodeType;
+    const TreeT &tree = handle.grid<BuildType>()->tree();
+    const int slabWidth = LowerT::DIM;
+    const int base = indexBounds.lower[axis] & ~(slabWidth-1);
+    const int numSlabs
+      = divRoundUp(indexBounds.upper[axis]+1-base,slabWidth);
+    std::vector<double> activeInSlab(numSlabs,0.);
+    auto addActive = [&](int coord, double count) {
+      int slab = std::min(std::max((coord-base)/slabWidth,0),numSlabs-1);
+      activeInSlab[slab] += count;
+    };
+    for (uint32_t i=0;i<tree.nodeCount(0);i++) {
+      const LeafT *leaf = tree.getFirstLeaf()+i;
+      addActive(leaf->origin()[axis],leaf->valueMask().countOn());
+    }
+    for (uint32_t i=0;i<tree.nodeCount(1);i++) {
+      const LowerT *lower = tree.getFirstLower()+i;
+      for (uint32_t n=0;n<LowerT::SIZE;n++)
+        if (!lower->isChild(n) && lower->isActive(n))
+          addActive(lower->offsetToGlobalCoord(n)[axis],
+                    double(LeafT::NUM_VALUES));
+    }
+    for (uint32_t i=0;i<tree.nodeCount(2);i++) {
+      const UpperT *upper = tree.getFirstUpper()+i;
+      for (uint32_t n=0;n<UpperT::SIZE;n++)
+        if (!upper->isChild(n) && upper->isActive(n))
+          // a tile of an upper node is as wide as an entire slab
+          addActive(upper->offsetToGlobalCoord(n)[axis],
+                    double(LowerT::NUM_VALUES));
+    }
+
+    double total = 0.;
+    for (auto count : activeInSlab) total += count;
+    if (total == 0.)
+      return partIndex == 0
+        ? vec2i(base,base+numSlabs*slabWidth)
+        : vec2i(0,0);
+    // slab range [begin,end) whose prefix sums are closest to
+    // partIndex/partCount and (partIndex+1)/partCount of the total
+    int begin = -1, end = numSlabs;
+    double sum = 0.;
+    for (int i=0;i<numSlabs;i++) {
+      if (begin < 0 && sum >= total*partIndex/partCount)
+        begin = i;
+      sum += activeInSlab[i];
+      if (sum >= total*(partIndex+1)/partCount && partIndex+1 < partCount) {
+        end = i+1;
+        break;
+      }
+    }
+    if (begin < 0 || begin >= end)
+      // nothing left for this part
+      return vec2i(0,0);
+    return vec2i(base+begin*slabWidth,base+end*slabWidth);
+  }
 
-    range1f scalarRange;
-    for (nanovdb::CoordBBox::Iterator iter = bbox.begin(); iter; ++iter) {
-      float value = acc.getValue(*iter);
-      scalarRange.extend(value);
+  /*! creates a new grid (of the same type) that contains only the
+      given grid's active voxels and tiles in the slab [lo,hi) along
+      given axis, plus one voxel either side of it for interpolation
+      across slab boundaries */
+  template<typename BuildType>
+  nanovdb::GridHandle<> NanoVDBData_extractSlab(const nanovdb::GridHandle<> &handle,
+                                                int axis, vec2i slab)
+  {
+    using GridT  = typename nanovdb::Grid<nanovdb::NanoTree<BuildType>>;
+    using TreeT  = typename GridT::TreeType;
+    using LeafT  = typename TreeT::LeafNodeType;
+    using LowerT = typename TreeT::LowerNodeType;
+    using UpperT = typename TreeT::UpperNodeType;
+    using SubGridT = nanovdb::tools::build::Grid<float>;
+    const GridT *grid = handle.grid<BuildType>();
+    const TreeT &tree = grid->tree();
+    
+    SubGridT subGrid(tree.background(),grid->gridName(),grid->gridClass());
+    subGrid.mMap = grid->map();
+    auto acc = subGrid.getAccessor();
+    const int lo = slab.x-1;
+    const int hi = slab.y+1;
+    auto overlaps = [&](int begin, int width)
+    { return begin < hi && begin+width > lo; };
+    auto fillTile = [&](nanovdb::Coord origin, int width, float value) {
+      nanovdb::CoordBBox box(origin,origin+nanovdb::Coord(width-1));
+      box.min()[axis] = std::max(box.min()[axis],lo);
+      box.max()[axis] = std::min(box.max()[axis],hi-1);
+      for (auto iter = box.begin(); iter; ++iter)
+        acc.setValue(*iter,value);
+    };
+    
+    for (uint32_t i=0;i<tree.nodeCount(0);i++) {
+      const LeafT *leaf = tree.getFirstLeaf()+i;
+      if (!overlaps(leaf->origin()[axis],LeafT::DIM)) continue;
+      for (uint32_t n=0;n<LeafT::NUM_VALUES;n++) {
+        if (!leaf->isActive(n)) continue;
+        nanovdb::Coord ijk = leaf->offsetToGlobalCoord(n);
+        if (ijk[axis] < lo || ijk[axis] >= hi) continue;
+        acc.setValue(ijk,leaf->getValue(n));
+      }
+    }
+    for (uint32_t i=0;i<tree.nodeCount(1);i++) {
+      const LowerT *lower = tree.getFirstLower()+i;
+      if (!overlaps(lower->origin()[axis],LowerT::DIM)) continue;
+      for (uint32_t n=0;n<LowerT::SIZE;n++)
+        if (!lower->isChild(n) && lower->isActive(n))
+          fillTile(lower->offsetToGlobalCoord(n),LeafT::DIM,
+                   lower->getValue(n));
+    }
+    for (uint32_t i=0;i<tree.nodeCount(2);i++) {
+      const UpperT *upper = tree.getFirstUpper()+i;
+      if (!overlaps(upper->origin()[axis],UpperT::DIM)) continue;
+      for (uint32_t n=0;n<UpperT::SIZE;n++)
+        if (!upper->isChild(n) && upper->isActive(n))
+          fillTile(upper->offsetToGlobalCoord(n),LowerT::DIM,
+                   upper->getValue(n));
     }
-    int cellIdx = mcID.x + mcGrid.dims.x * (mcID.y + mcGrid.dims.y * (mcID.z));
-    mcGrid.scalarRanges[cellIdx] = scalarRange;
+    return nanovdb::tools::createNanoGrid<SubGridT,BuildType>(subGrid);
   }
   
   NanoVDBData::NanoVDBData(Context *context,
@@ -76,32 +281,72 @@ namespace BARNEY_NS {
   {
 #if BARNEY_HAVE_NANOVDB
     MCGrid::SP mcGrid = std::make_shared<MCGrid>(devices);
-#if 1
-    vec3i mcDims = divRoundUp(gridSize,vec3i(16));
-#else
-    vec3i mcDims = vec3i(64);
-#endif
+
+    // rather than a grid of arbitrary resolution that we'd have to
+    // compute by iterating over all voxels, use cells that are
+    // aligned with the vdb's own leaf nodes, and fill those in from
+    // the leaves and tiles; all the (often many) parts of the grid
+    // without any of those are background. If the leaf-sized cells
+    // would be too many, use multiples thereof.
+    int cellVoxels = 8;
+    vec3i cellOriginIdx, mcDims;
+    if (indexBounds.empty()) {
+      // empty partition of a partitioned grid
+      mcGrid->resize(vec3i(1));
+      mcGrid->clearCells();
+      mcGrid->gridOrigin  = vec3f(0.f);
+      mcGrid->gridSpacing = vec3f(1.f);
+      return mcGrid;
+    }
+    while (true) {
+      cellOriginIdx = vec3i(indexBounds.lower.x & ~(cellVoxels-1),
+                            indexBounds.lower.y & ~(cellVoxels-1),
+                            indexBounds.lower.z & ~(cellVoxels-1));
+      mcDims = divRoundUp(indexBounds.upper+vec3i(1)-cellOriginIdx,
+                          vec3i(cellVoxels));
+      if ((size_t)mcDims.x*(size_t)mcDims.y*(size_t)mcDims.z <= maxMacroCells)
+        break;
+      cellVoxels *= 2;
+    }
     mcGrid->resize(mcDims);
-    mcGrid->gridOrigin = worldBounds.lower;
-    mcGrid->gridSpacing = worldBounds.size() * rcp(vec3f(mcDims));
+    mcGrid->gridOrigin
+      = worldBounds.lower + vec3f(cellOriginIdx-indexBounds.lower)*voxelSize;
+    mcGrid->gridSpacing = vec3f(float(cellVoxels))*voxelSize;
     
-    mcGrid->clearCells();
     for (auto device : *devices) {
-      size_t lc64 = (size_t)mcDims.x*(size_t)mcDims.y*(size_t)mcDims.z;
-      int lc = int(lc64);
-      assert(lc == lc64);
+      SetActiveGPU forDuration(device);
+      int lc = mcDims.x*mcDims.y*mcDims.z;
       int bs = 128;
       int nb = divRoundUp(lc,bs);
+      int nbLeaves = divRoundUp(numLeafNodes,bs);
+      // tiles get one thread per internal node table entry
+      int nbLower  = divRoundUp(numLowerNodes*4096,bs);
+      int nbUpper  = divRoundUp(numUpperNodes*32768,bs);
 
       auto mcDD = mcGrid->getDD(device);
       auto dd = getDD(device);
 
       switch (gridType) {
-#define LAUNCH_MC(BuildType, Suffix, EnumName) \
-      case nanovdb::GridType::EnumName: \
-        __rtc_launch(device->rtc, \
-                     (NanoVDBData_computeMCs<BuildType>), \
-                     nb,bs, mcDD, dd); \
+#define LAUNCH_MC(BuildType, Suffix, EnumName)                          \
+      case nanovdb::GridType::EnumName:                                 \
+        __rtc_launch(device->rtc,                                       \
+                     (NanoVDBData_fillBackground<BuildType>),           \
+                     nb,bs, mcDD, dd);                                  \
+        if (numLeafNodes > 0)                                           \
+          __rtc_launch(device->rtc,                                     \
+                       (NanoVDBData_rasterLeaves<BuildType>),           \
+                       nbLeaves,bs, mcDD, dd, numLeafNodes,             \
+                       cellOriginIdx,cellVoxels);                       \
+        if (numLowerNodes > 0)                                          \
+          __rtc_launch(device->rtc,                                     \
+                       (NanoVDBData_rasterTiles<BuildType,1>),          \
+                       nbLower,bs, mcDD, dd, numLowerNodes,             \
+                       cellOriginIdx,cellVoxels);                       \
+        if (numUpperNodes > 0)                                          \
+          __rtc_launch(device->rtc,                                     \
+                       (NanoVDBData_rasterTiles<BuildType,2>),          \
+                       nbUpper,bs, mcDD, dd, numUpperNodes,             \
+                       cellOriginIdx,cellVoxels);                       \
         break;
       BARNEY_NANOVDB_FLOAT_TYPES(LAUNCH_MC)
 #undef LAUNCH_MC
@@ -126,7 +371,7 @@ namespace BARNEY_NS {
     assert(sf);
     assert(sf->data);
     dd.nvdbGrid    = (NVDBGridT*)sf->data->getDD(device);
-    dd.indexBounds = sf->indexBounds;
+    dd.indexBounds = sf->sampleBounds;
 
     assert(dd.nvdbGrid);
     return dd;
@@ -189,6 +434,21 @@ namespace BARNEY_NS {
     if (member == "data") {
       data = value->as<PODData>();
       assert(data);
+      dataIsPartition = false;
+      return true;
+    }
+    return false;
+  }
+
+  bool NanoVDBData::set1i(const std::string &member,
+                          const int &value) 
+  {
+    if (member == "partitionCount") {
+      partitionCount = std::max(value,1);
+      return true;
+    }
+    if (member == "partitionIndex") {
+      partitionIndex = std::max(value,0);
       return true;
     }
     return false;
@@ -197,6 +457,12 @@ namespace BARNEY_NS {
   // ==================================================================
   void NanoVDBData::commit() 
   {
+    MemoryScope memScope(devices.get(),BN_MEMORY_VOLUME_FIELDS);
+    if (dataIsPartition)
+      // 'data' already is our part of the original grid, and all
+      // values derived from it are still valid
+      return;
+    
     // Data might not be aligned, make sure we get something that works for
     // nanovdb.
     size_t numBytes = data->size();
@@ -214,14 +480,10 @@ namespace BARNEY_NS {
       = box3f(vec3f(boundsMin[0], boundsMin[1], boundsMin[2]),
               vec3f(boundsMax[0], boundsMax[1], boundsMax[2]));
     (nanovdb::CoordBBox&)indexBounds = gridMetadata->indexBBox();
+    sampleBounds = indexBounds;
     nanovdb::Vec3d nvVoxelSize = gridMetadata->voxelSize();
     voxelSize = vec3f((const vec3d&)nvVoxelSize);
     
-    auto nvGridSize = gridMetadata->indexBBox().dim();
-    gridSize.x = nvGridSize[0];
-    gridSize.y = nvGridSize[1];
-    gridSize.z = nvGridSize[2];
-    
     gridType = gridMetadata->gridType();
     bool supported = false;
 #define CHECK_TYPE(BuildType, Suffix, EnumName) \
@@ -231,6 +493,65 @@ namespace BARNEY_NS {
     if (!supported)
       throw std::runtime_error
         ("barney::NanoVDBData: unsupported grid type");
+
+    if (partitionCount > 1) {
+      // keep only our slab (along the longest axis) of the grid;
+      // that replaces the app's data, so that - once the app
+      // releases its own handle - the full grid no longer needs to
+      // be on our devices
+      vec3i fullSize = indexBounds.size()+vec3i(1);
+      int axis = fullSize.x >= fullSize.y
+        ? (fullSize.x >= fullSize.z ? 0 : 2)
+        : (fullSize.y >= fullSize.z ? 1 : 2);
+      vec2i slab(0,0);
+      switch (gridType) {
+#define PARTITION(BuildType, Suffix, EnumName)                          \
+      case nanovdb::GridType::EnumName:                                 \
+        slab = NanoVDBData_findSlab<BuildType>                          \
+          (gridHandle,axis,indexBounds,partitionCount,                  \
+           std::min(partitionIndex,partitionCount-1));                  \
+        gridHandle = NanoVDBData_extractSlab<BuildType>                 \
+          (gridHandle,axis,slab);                                       \
+        break;
+      BARNEY_NANOVDB_FLOAT_TYPES(PARTITION)
+#undef PARTITION
+      default: break;
+      }
+      // clip our bounds to the slab (the extracted grid's halo
+      // voxels are only there to be interpolated with), but still
+      // clamp samples as if this was the whole grid
+      int lo = std::max(slab.x,indexBounds.lower[axis]);
+      int hi = std::min(slab.y-1,indexBounds.upper[axis]);
+      float worldLo = worldBounds.lower[axis];
+      worldBounds.lower[axis] = worldLo
+        + (lo  -sampleBounds.lower[axis])*voxelSize[axis];
+      worldBounds.upper[axis] = worldLo
+        + (hi+1-sampleBounds.lower[axis])*voxelSize[axis];
+      indexBounds.lower[axis] = lo;
+      indexBounds.upper[axis] = hi;
+      if (lo > hi) {
+        // empty part
+        worldBounds = box3f();
+        indexBounds = box3i();
+      }
+      gridSize = indexBounds.empty() ? vec3i(0) : indexBounds.size()+vec3i(1);
+
+      auto part = std::make_shared<PODData>(context,devices,BN_UINT8);
+      part->set(gridHandle.data(),gridHandle.size());
+      data = part;
+      dataIsPartition = true;
+      gridMetadata = gridHandle.gridMetaData();
+      std::cout << OWL_TERMINAL_LIGHT_GREEN
+                << "#bn.nanovdb: partition " << partitionIndex
+                << " of " << partitionCount << ": index range ["
+                << lo << ".." << hi << "] along axis " << axis << ", "
+                << prettyNumber(gridHandle.size()) << "B"
+                << OWL_TERMINAL_DEFAULT << std::endl;
+    }
+    
+    numLeafNodes  = gridMetadata->nodeCount(0);
+    numLowerNodes = gridMetadata->nodeCount(1);
+    numUpperNodes = gridMetadata->nodeCount(2);
   }
   
 }
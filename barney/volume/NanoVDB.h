@@ -54,6 +54,7 @@ namespace BARNEY_NS {
     // ------------------------------------------------------------------
     /*! @{ parameter set/commit interface */
     bool setData(const std::string &member, const Data::SP &value) override;
+    bool set1i(const std::string &member, const int &value) override;
     void commit() override;
     /*! @} */
     // ------------------------------------------------------------------
@@ -63,11 +64,36 @@ namespace BARNEY_NS {
     IsoSurfaceAccel::SP createIsoAccel(IsoSurface *isoSurface) override;
     MCGrid::SP buildMCs() override;
 
+    /*! upper limit for the number of (vdb-leaf aligned) macro cells;
+        larger grids use cells of several leaves' width */
+    enum { maxMacroCells = 1<<22 };
+    
     PODData::SP data;
+    /*! index range of the voxels this field covers; only a slab of
+        the grid if partitioned */
     box3i indexBounds;
+    /*! index range samples get clamped to: the entire grid's, even
+        if partitioned */
+    box3i sampleBounds;
     vec3f voxelSize;
     vec3i gridSize;
     nanovdb::GridType gridType;
+    /*! number of leaf, lower, and upper nodes in the vdb tree */
+    int numLeafNodes  = 0;
+    int numLowerNodes = 0;
+    int numUpperNodes = 0;
+
+    /*! if partitionCount > 1, this field keeps only the
+        partitionIndex'th of partitionCount slabs of the grid, with
+        about the same number of active voxels each. This allows for
+        data-parallel rendering of grids too large for a single gpu,
+        with each data rank creating this field from the same grid,
+        with its own partitionIndex */
+    int  partitionCount  = 1;
+    int  partitionIndex  = 0;
+    /*! whether 'data' got replaced with our partition of the app's
+        grid */
+    bool dataIsPartition = false;
   };
 
   /*! sampler object for a StructuredData object, using a 3d texture */
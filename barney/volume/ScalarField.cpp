@@ -10,6 +10,7 @@
 #include "barney/volume/StructuredData.h"
 #include "barney/umesh/common/UMeshField.h"
 #include "barney/amr/BlockStructuredField.h"
+#include "barney/particles/ParticleField.h"
 #include "barney/volume/NanoVDB.h"
 
 namespace BARNEY_NS {
@@ -53,6 +54,11 @@ namespace BARNEY_NS {
           return std::make_shared<BlockStructuredField>(ctx, devs); 
         });
       
+      registry.registerType("particles", 
+        [](Context* ctx, const DevGroup::SP& devs) { 
+          return std::make_shared<ParticleField>(ctx, devs); 
+        });
+      
       registry.registerType("NanoVDB", 
         [](Context* ctx, const DevGroup::SP& devs) -> ScalarField::SP {
 #if BARNEY_HAVE_NANOVDB
@@ -56,6 +56,12 @@ namespace BARNEY_NS {
     /*! create, fill, and return a macrocell grid for this field */
     virtual MCGrid::SP buildMCs();
 
+    /*! whether this field's devices each only sample their own part
+        of it (see Device::partition); fields that don't get split
+        get traced by the first part's device only, or data-parallel
+        rendering would count their density once per device */
+    virtual bool isPartitioned() const { return false; }
+
     MCGrid::SP  mcGrid;
     box3f       worldBounds;
     
@@ -5,6 +5,7 @@
 #include "barney/Context.h"
 #include "barney/volume/StructuredData.h"
 #include "barney/common/Texture.h"
+#include "barney/common/KdPartition.h"
 #include "rtcore/ComputeInterface.h"
 
 namespace BARNEY_NS {
@@ -60,20 +61,487 @@ namespace BARNEY_NS {
 #endif
   }
 
+
+  /*! compute kernel that computes, for each macro cell, the value
+      mask of all the values its cells can interpolate to, from each
+      of those cells' own (8-vertex) value range */
+  __rtc_global
+  void StructuredData_computeValueMasks(const rtc::ComputeInterface &ci,
+                                        /* kernel ARGS */
+                                        MCGrid::DD mcGrid,
+                                        vec3i numScalars,
+                                        StructuredDataSampler::DD sampler)
+  {
+#if RTC_DEVICE_CODE
+    vec3i mcDims = mcGrid.dims;
+    int tid = ci.launchIndex().x;
+    if (tid >= mcDims.x*mcDims.y*mcDims.z) return;
+    vec3i mcID(tid % mcDims.x,
+               (tid / mcDims.x) % mcDims.y,
+               tid / (mcDims.x*mcDims.y));
+    
+    uint32_t mask = 0u;
+    for (int iz=0;iz<cellsPerMC;iz++)
+      for (int iy=0;iy<cellsPerMC;iy++)
+        for (int ix=0;ix<cellsPerMC;ix++) {
+          vec3i cellID = mcID*int(cellsPerMC) + vec3i(ix,iy,iz);
+          if (cellID.x >= numScalars.x-1) continue;
+          if (cellID.y >= numScalars.y-1) continue;
+          if (cellID.z >= numScalars.z-1) continue;
+          range1f cellRange;
+          for (int c=0;c<8;c++)
+            cellRange.extend
+              (sampler.scalar(cellID+vec3i(c&1,(c>>1)&1,c>>2)));
+          mask |= mcGrid.valueMask(cellRange);
+        }
+    int mcIdx = mcID.x + mcGrid.dims.x*(mcID.y+mcGrid.dims.y*(mcID.z));
+    mcGrid.valueMasks[mcIdx] = mask;
+#endif
+  }
+  
+  /*! compute kernel that computes, per scalar, the (normalized,
+      index-space) central-difference gradient, and stores it as
+      rgba8 (with [-1,1] mapped to [0,1]) */
+  __rtc_global
+  void StructuredData_computeGradients(const rtc::ComputeInterface &ci,
+                                       /* kernel ARGS */
+                                       uint32_t *gradients,
+                                       vec3i numScalars,
+                                       StructuredDataSampler::DD sampler)
+  {
+#if RTC_DEVICE_CODE
+    int tid = ci.launchIndex().x;
+    if (tid >= numScalars.x*numScalars.y*numScalars.z) return;
+    vec3i scalarID(tid % numScalars.x,
+                   (tid / numScalars.x) % numScalars.y,
+                   tid / (numScalars.x*numScalars.y));
+    vec3f g;
+    for (int d=0;d<3;d++) {
+      vec3i lo = scalarID, hi = scalarID;
+      if (lo[d] > 0)               lo[d]--;
+      if (hi[d] < numScalars[d]-1) hi[d]++;
+      g[d] = (hi[d] == lo[d])
+        ? 0.f
+        : (sampler.scalar(hi)-sampler.scalar(lo)) / float(hi[d]-lo[d]);
+    }
+    float len = length(g);
+    if (len > 0.f) g = g * (1.f/len);
+    vec3i q = vec3i((g*.5f+vec3f(.5f))*255.f+vec3f(.5f));
+    gradients[tid]
+      = uint32_t(q.x) | (uint32_t(q.y) << 8) | (uint32_t(q.z) << 16)
+      | (255u << 24);
+#endif
+  }
+  
+  /*! compute kernel that copies the scalars of each non-constant
+      brick - one brick per block - from the dense texture into that
+      brick's slot in the brick pool; quantizing them relative to
+      the brick's range if brickScales is non-null */
+  __rtc_global
+  void StructuredData_fillBricks(const rtc::ComputeInterface &ci,
+                                 /* kernel ARGS */
+                                 void *pool,
+                                 const int *brickOfSlot,
+                                 vec3i numBricks,
+                                 vec3i numScalars,
+                                 int bytesPerScalar,
+                                 const float *brickLowers,
+                                 const float *brickScales,
+                                 rtc::TextureObject scalars)
+  {
+#if RTC_DEVICE_CODE
+    const int S = StructuredData::cellsPerBrick+1;
+    int slot = ci.getBlockIdx().x;
+    int brickIdx = brickOfSlot[slot];
+    vec3i brickID(brickIdx % numBricks.x,
+                  (brickIdx / numBricks.x) % numBricks.y,
+                  brickIdx / (numBricks.x*numBricks.y));
+    for (int i=ci.getThreadIdx().x;i<S*S*S;i+=ci.getBlockDim().x) {
+      vec3i local(i % S,(i / S) % S,i / (S*S));
+      vec3i scalarID
+        = min(brickID*int(StructuredData::cellsPerBrick)+local,
+              numScalars-vec3i(1));
+      float f = rtc::tex3D<float>(scalars,
+                                  (float)scalarID.x,
+                                  (float)scalarID.y,
+                                  (float)scalarID.z);
+      if (brickScales)
+        f = (f - brickLowers[brickIdx]) / brickScales[brickIdx];
+      size_t idx = size_t(slot)*(S*S*S)+i;
+      switch (bytesPerScalar) {
+      case 1:
+        ((uint8_t *)pool)[idx] = (uint8_t)(f*255.f+.5f);
+        break;
+      case 2:
+        ((uint16_t *)pool)[idx] = (uint16_t)(f*65535.f+.5f);
+        break;
+      default:
+        ((float *)pool)[idx] = f;
+      }
+    }
+#endif
+  }
   
   StructuredData::StructuredData(Context *context,
                                  const DevGroup::SP &devices)
     : ScalarField(context,devices)
-  {}
+  {
+    perLogical.resize(devices->numLogical);
+    bricks.enabled = FromEnv::enabled("bricked");
+    gradientsEnabled = FromEnv::enabled("gradients");
+  }
+
+  StructuredData::~StructuredData()
+  {
+    freeBricks();
+  }
+
+  StructuredData::PLD *StructuredData::getPLD(Device *device)
+  {
+    return &perLogical[device->localRank()];
+  }
+
+  void StructuredData::freeBricks()
+  {
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      for (auto buffer : { &pld->brickSlots,
+                           &pld->brickValues,
+                           &pld->brickScales,
+                           &pld->brickPool,
+                           &pld->brickCoarse,
+                           &pld->brickUsage }) {
+        if (*buffer) device->rtc->freeBuffer(*buffer);
+        *buffer = 0;
+      }
+      pld->slots.clear();
+      pld->residentBrick.clear();
+      pld->lastUsed.clear();
+    }
+    if (bricks.hostPool) {
+      (*devices)[0]->rtc->freeHost(bricks.hostPool);
+      bricks.hostPool = 0;
+    }
+    ((Context *)context)->pagedFields.erase(this);
+    bricks.dims = vec3i(0);
+    bricks.numStored = 0;
+    bricks.cacheSize = 0;
+    bricks.ranges.clear();
+    bricks.poolIndex.clear();
+    bricks.partitioned = false;
+    bricks.partOf.clear();
+  }
+
+  void StructuredData::buildBricks()
+  {
+    freeBricks();
+    bricks.dims = divRoundUp(numCells,vec3i(cellsPerBrick));
+    size_t numBricks64 = owl::common::volume(bricks.dims);
+    int numBricks = (int)numBricks64;
+    if (numBricks != numBricks64)
+      throw std::runtime_error("number of bricks cannot be expressed in a 32-bit value");
+
+    // brick ranges are the same as macro cell ranges, so compute
+    // them the same way - on one device, they're the same everywhere
+    bricks.ranges.resize(numBricks);
+    {
+      Device *device = (*devices)[0];
+      SetActiveGPU forDuration(device);
+      rtc::Buffer *rangesBuffer
+        = device->rtc->createBuffer(numBricks*sizeof(range1f));
+      MCGrid::DD dd;
+      dd.scalarRanges = (range1f*)rangesBuffer->getDD();
+      dd.dims         = bricks.dims;
+      int bs = 128;
+      int nb = divRoundUp(numBricks,bs);
+      __rtc_launch(device->rtc,
+                   StructuredData_computeMCs,
+                   nb,bs,
+                   dd,
+                   numScalars,
+                   textureNN->getDD(device));
+      device->rtc->copy(bricks.ranges.data(),dd.scalarRanges,
+                        numBricks*sizeof(range1f));
+      device->rtc->freeBuffer(rangesBuffer);
+    }
+
+    std::vector<int>   slots(numBricks);
+    std::vector<float> values(numBricks,0.f);
+    std::vector<float> scales(numBricks,0.f);
+    std::vector<int>   brickOfSlot;
+    for (int brickIdx=0;brickIdx<numBricks;brickIdx++) {
+      const range1f range = bricks.ranges[brickIdx];
+      values[brickIdx] = range.lower;
+      scales[brickIdx] = range.upper - range.lower;
+      if (range.lower == range.upper) {
+        slots[brickIdx]  = constantBrick;
+      } else {
+        slots[brickIdx] = (int)brickOfSlot.size();
+        brickOfSlot.push_back(brickIdx);
+      }
+    }
+    bricks.numStored = (int)brickOfSlot.size();
+
+    const int S = cellsPerBrick+1;
+    const size_t brickBytes = size_t(S*S*S)*bricks.bytesPerScalar;
+    const size_t residentBytes = size_t(bricks.residentMB) << 20;
+    bricks.cacheSize
+      = (residentBytes && residentBytes/brickBytes < (size_t)bricks.numStored)
+      ? std::max((int)(residentBytes/brickBytes),1)
+      : 0;
+    const bool paging = bricks.cacheSize > 0;
+    const int numParts = (*devices)[0]->partition.size;
+    bricks.partitioned = numParts > 1 && !paging;
+    if (bricks.partitioned) {
+      std::vector<vec3f> centers(numBricks);
+      for (int brickIdx=0;brickIdx<numBricks;brickIdx++)
+        centers[brickIdx]
+          = vec3f(brickIdx % bricks.dims.x,
+                  (brickIdx / bricks.dims.x) % bricks.dims.y,
+                  brickIdx / (bricks.dims.x*bricks.dims.y));
+      bricks.partOf = kdPartition(centers,devices->partitionWeights());
+    }
+    std::vector<float> coarse;
+    if (paging) {
+      bricks.poolIndex = slots;
+      for (int brickIdx=0;brickIdx<numBricks;brickIdx++) {
+        if (slots[brickIdx] != constantBrick)
+          slots[brickIdx] = nonResidentBrick;
+        coarse.push_back(values[brickIdx]+.5f*scales[brickIdx]);
+      }
+    }
+    
+    size_t poolSize
+      = std::max((size_t)(paging ? bricks.cacheSize : bricks.numStored)
+                 *brickBytes,
+                 (size_t)1);
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      auto rtc = device->rtc;
+      std::vector<int> partSlots, partBrickOfSlot;
+      if (bricks.partitioned) {
+        // same as above, for only this device's bricks
+        partSlots.resize(numBricks);
+        for (int brickIdx=0;brickIdx<numBricks;brickIdx++) {
+          if (bricks.partOf[brickIdx] != device->partition.rank)
+            partSlots[brickIdx] = outsideBrick;
+          else if (slots[brickIdx] == constantBrick)
+            partSlots[brickIdx] = constantBrick;
+          else {
+            partSlots[brickIdx] = (int)partBrickOfSlot.size();
+            partBrickOfSlot.push_back(brickIdx);
+          }
+        }
+      }
+      const std::vector<int> &mySlots
+        = bricks.partitioned ? partSlots : slots;
+      const std::vector<int> &myBrickOfSlot
+        = bricks.partitioned ? partBrickOfSlot : brickOfSlot;
+      pld->brickSlots
+        = rtc->createBuffer(numBricks*sizeof(int),mySlots.data());
+      pld->brickValues
+        = rtc->createBuffer(numBricks*sizeof(float),values.data());
+      if (bricks.quantizeBits)
+        pld->brickScales
+          = rtc->createBuffer(numBricks*sizeof(float),scales.data());
+      pld->brickPool
+        = rtc->createBuffer(bricks.partitioned
+                            ? std::max(myBrickOfSlot.size()*brickBytes,
+                                       (size_t)1)
+                            : poolSize);
+      if (paging) {
+        std::vector<uint8_t> unused(numBricks,0);
+        pld->brickCoarse
+          = rtc->createBuffer(numBricks*sizeof(float),coarse.data());
+        pld->brickUsage
+          = rtc->createBuffer(numBricks,unused.data());
+        pld->slots = slots;
+        pld->residentBrick.assign(bricks.cacheSize,-1);
+        pld->lastUsed.assign(bricks.cacheSize,-1);
+        continue;
+      }
+      if (myBrickOfSlot.empty()) continue;
+      rtc::Buffer *brickOfSlotBuffer
+        = rtc->createBuffer(myBrickOfSlot.size()*sizeof(int),
+                            myBrickOfSlot.data());
+      __rtc_launch(rtc,
+                   StructuredData_fillBricks,
+                   (int)myBrickOfSlot.size(),128,
+                   pld->brickPool->getDD(),
+                   (const int *)brickOfSlotBuffer->getDD(),
+                   bricks.dims,
+                   numScalars,
+                   bricks.bytesPerScalar,
+                   (const float *)pld->brickValues->getDD(),
+                   pld->brickScales
+                   ? (const float *)pld->brickScales->getDD()
+                   : (const float *)nullptr,
+                   textureNN->getDD(device));
+      rtc->sync();
+      rtc->freeBuffer(brickOfSlotBuffer);
+    }
+
+    if (paging) {
+      // fill the host pool, staging chunks of bricks through the
+      // first device; the bricks get paged in on demand
+      Device *device = (*devices)[0];
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      auto rtc = device->rtc;
+      bricks.hostPool
+        = (uint8_t *)rtc->allocHost(bricks.numStored*brickBytes);
+      rtc::Buffer *brickOfSlotBuffer
+        = rtc->createBuffer(brickOfSlot.size()*sizeof(int),
+                            brickOfSlot.data());
+      const int chunkSize = std::min(bricks.numStored,1<<14);
+      rtc::Buffer *chunk = rtc->createBuffer(chunkSize*brickBytes);
+      for (int begin=0;begin<bricks.numStored;begin+=chunkSize) {
+        int count = std::min(chunkSize,bricks.numStored-begin);
+        __rtc_launch(rtc,
+                     StructuredData_fillBricks,
+                     count,128,
+                     chunk->getDD(),
+                     (const int *)brickOfSlotBuffer->getDD()+begin,
+                     bricks.dims,
+                     numScalars,
+                     bricks.bytesPerScalar,
+                     (const float *)pld->brickValues->getDD(),
+                     pld->brickScales
+                     ? (const float *)pld->brickScales->getDD()
+                     : (const float *)nullptr,
+                     textureNN->getDD(device));
+        rtc->copy(bricks.hostPool+begin*brickBytes,chunk->getDD(),
+                  count*brickBytes);
+      }
+      rtc->freeBuffer(chunk);
+      rtc->freeBuffer(brickOfSlotBuffer);
+      ((Context *)context)->pagedFields.insert(this);
+    }
+
+    if (FromEnv::get()->logConfig) {
+      size_t denseSize
+        = owl::common::volume(numScalars)*bricks.inputBytesPerScalar;
+      std::cout << "#bn: structured data stored in "
+                << prettyNumber(bricks.numStored) << " of "
+                << prettyNumber(numBricks) << " bricks ("
+                << ((poolSize+numBricks*(sizeof(int)+sizeof(float)))>>20)
+                << "MB instead of " << (denseSize>>20) << "MB per device)"
+                << std::endl;
+      if (bricks.partitioned)
+        std::cout << "#bn: ... split into " << numParts
+                  << " parts, one per device" << std::endl;
+      if (paging)
+        std::cout << "#bn: ... paging those through a cache of "
+                  << prettyNumber(bricks.cacheSize) << " bricks per device"
+                  << std::endl;
+    }
+    
+    // the dense texture isn't needed any more; it'll go away once
+    // the app drops its handle, too
+    texture.reset();
+    textureNN.reset();
+    scalars.reset();
+  }
+
+
+  void StructuredData::servicePageRequests()
+  {
+    if (!bricks.cacheSize) return;
+    const int frameID = ++bricks.frameID;
+    const int S = cellsPerBrick+1;
+    const size_t brickBytes = size_t(S*S*S)*bricks.bytesPerScalar;
+    const int numBricks = (int)bricks.poolIndex.size();
+    std::vector<uint8_t> usage(numBricks);
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      PLD *pld = getPLD(device);
+      auto rtc = device->rtc;
+      void *d_usage = pld->brickUsage->getDD();
+      rtc->copy(usage.data(),d_usage,numBricks);
+      rtc->memsetAsync(d_usage,0,numBricks);
 
+      std::vector<int> wanted;
+      for (int brickIdx=0;brickIdx<numBricks;brickIdx++) {
+        if (!usage[brickIdx]) continue;
+        int slot = pld->slots[brickIdx];
+        if (slot >= 0)
+          pld->lastUsed[slot] = frameID;
+        else if ((int)wanted.size() < bricks.pagesPerFrame)
+          wanted.push_back(brickIdx);
+      }
+      if (wanted.empty()) continue;
+
+      // free slots first, then least recently used ones - but never
+      // one that the previous frame still used
+      std::vector<int> victims;
+      for (int slot=0;slot<bricks.cacheSize;slot++)
+        if (pld->lastUsed[slot] < frameID)
+          victims.push_back(slot);
+      std::sort(victims.begin(),victims.end(),
+                [&](int a, int b)
+                { return pld->lastUsed[a] < pld->lastUsed[b]; });
+
+      int *d_slots = (int *)pld->brickSlots->getDD();
+      uint8_t *d_pool = (uint8_t *)pld->brickPool->getDD();
+      for (int i=0;i<(int)wanted.size() && i<(int)victims.size();i++) {
+        int brickIdx = wanted[i];
+        int slot     = victims[i];
+        int evicted  = pld->residentBrick[slot];
+        if (evicted >= 0) {
+          pld->slots[evicted] = nonResidentBrick;
+          rtc->copyAsync(d_slots+evicted,&pld->slots[evicted],sizeof(int));
+        }
+        pld->residentBrick[slot] = brickIdx;
+        pld->lastUsed[slot]      = frameID;
+        pld->slots[brickIdx]     = slot;
+        rtc->copyAsync(d_pool+slot*brickBytes,
+                       bricks.hostPool
+                       +bricks.poolIndex[brickIdx]*brickBytes,
+                       brickBytes);
+        rtc->copyAsync(d_slots+brickIdx,&pld->slots[brickIdx],sizeof(int));
+      }
+    }
+    for (auto device : *devices)
+      device->rtc->sync();
+  }
 
   MCGrid::SP StructuredData::buildMCs() 
   {
     MCGrid::SP mcGrid = std::make_shared<MCGrid>(devices);
     vec3i mcDims = divRoundUp(numCells,vec3i(cellsPerMC));
     mcGrid->resize(mcDims);
+    computeMCs(mcGrid);
+    return mcGrid;
+  }
+  
+  void StructuredData::computeMCs(MCGrid::SP mcGrid) 
+  {
+    vec3i mcDims = mcGrid->dims;
     mcGrid->gridOrigin = worldBounds.lower;
     mcGrid->gridSpacing = vec3f(cellsPerMC) * this->gridSpacing;
+    if (!bricks.ranges.empty()) {
+      // bricks are macro cells, and already know their ranges
+      for (auto device : *devices) {
+        SetActiveGPU forDuration(device);
+        std::vector<range1f> partRanges;
+        if (bricks.partitioned) {
+          // other parts' macro cells are empty space on this device
+          partRanges = bricks.ranges;
+          for (size_t i=0;i<partRanges.size();i++)
+            if (bricks.partOf[i] != device->partition.rank)
+              partRanges[i] = range1f();
+        }
+        device->rtc->copy(mcGrid->getDD(device).scalarRanges,
+                          bricks.partitioned
+                          ? partRanges.data()
+                          : bricks.ranges.data(),
+                          bricks.ranges.size()*sizeof(range1f));
+      }
+      buildValueMasks(mcGrid,bricks.ranges);
+      return;
+    }
     for (auto device : *devices) {
       size_t lc64 = (size_t)mcDims.x*(size_t)mcDims.y*(size_t)mcDims.z;
       int lc = (int)lc64;
@@ -91,17 +559,93 @@ namespace BARNEY_NS {
     }
     for (auto device : *devices)
       device->sync();
-    return mcGrid;
+    {
+      std::vector<range1f> ranges(owl::common::volume(mcDims));
+      Device *device = (*devices)[0];
+      SetActiveGPU forDuration(device);
+      device->rtc->copy(ranges.data(),mcGrid->getDD(device).scalarRanges,
+                        ranges.size()*sizeof(range1f));
+      buildValueMasks(mcGrid,ranges);
+    }
+  }
+
+  void StructuredData::buildValueMasks(MCGrid::SP mcGrid,
+                                       const std::vector<range1f> &mcRanges)
+  {
+    // while paging, most bricks only have their coarse value around,
+    // which would give masks that are too tight
+    if (bricks.cacheSize > 0) return;
+    if (FromEnv::enabled("noValueMasks")) return;
+    
+    range1f valueRange;
+    for (auto r : mcRanges) {
+      if (r.lower > r.upper) continue;
+      valueRange.lower = std::min(valueRange.lower,r.lower);
+      valueRange.upper = std::max(valueRange.upper,r.upper);
+    }
+    if (!(valueRange.lower < valueRange.upper)) return;
+    
+    mcGrid->enableValueMasks(valueRange);
+    vec3i mcDims = mcGrid->dims;
+    int lc = (int)owl::common::volume(mcDims);
+    StructuredDataSampler sampler(this);
+    for (auto device : *devices) {
+      SetActiveGPU forDuration(device);
+      int bs = 128;
+      int nb = divRoundUp(lc,bs);
+      __rtc_launch(device->rtc,
+                   StructuredData_computeValueMasks,
+                   nb,bs,
+                   mcGrid->getDD(device),
+                   numScalars,
+                   sampler.getDD(device));
+    }
+    for (auto device : *devices)
+      device->sync();
   }
   
   StructuredDataSampler::DD StructuredDataSampler::getDD(Device *device)
   {
     DD dd;
-    dd.texObj = sf->texture->getDD(device);
-    assert(dd.texObj);
     dd.cellGridOrigin  = sf->gridOrigin;
     dd.cellGridSpacing = sf->gridSpacing;
     dd.numCells        = sf->numCells;
+    StructuredData::PLD *pld = sf->getPLD(device);
+    if (pld->brickSlots) {
+      dd.texObj         = {};
+      dd.brickSlots     = (const int *)pld->brickSlots->getDD();
+      dd.brickValues    = (const float *)pld->brickValues->getDD();
+      dd.brickScales
+        = pld->brickScales
+        ? (const float *)pld->brickScales->getDD()
+        : nullptr;
+      dd.brickPool      = pld->brickPool->getDD();
+      dd.brickCoarse
+        = pld->brickCoarse
+        ? (const float *)pld->brickCoarse->getDD()
+        : nullptr;
+      dd.brickUsage
+        = pld->brickUsage
+        ? (uint8_t *)pld->brickUsage->getDD()
+        : nullptr;
+      dd.numBricks      = sf->bricks.dims;
+      dd.bytesPerScalar = sf->bricks.bytesPerScalar;
+    } else {
+      dd.texObj = sf->texture->getDD(device);
+      assert(dd.texObj);
+      dd.brickSlots     = nullptr;
+      dd.brickValues    = nullptr;
+      dd.brickScales    = nullptr;
+      dd.brickPool      = nullptr;
+      dd.brickCoarse    = nullptr;
+      dd.brickUsage     = nullptr;
+      dd.numBricks      = vec3i(0);
+      dd.bytesPerScalar = 0;
+    }
+    dd.gradients
+      = sf->gradientTexture
+      ? sf->gradientTexture->getDD(device)
+      : (rtc::TextureObject)0;
     return dd;
   }
   
@@ -138,6 +682,33 @@ namespace BARNEY_NS {
     return false;
   }
 
+  // ==================================================================
+  bool StructuredData::set1i(const std::string &member,
+                             const int &value) 
+  {
+    if (member == "bricked") {
+      bricks.enabled = value;
+      return true;
+    }
+    if (member == "quantizeBits") {
+      bricks.quantizeBits = (value == 8 || value == 16) ? value : 0;
+      return true;
+    }
+    if (member == "residentMB") {
+      bricks.residentMB = std::max(value,0);
+      return true;
+    }
+    if (member == "gradients") {
+      gradientsEnabled = value;
+      return true;
+    }
+    if (member == "pagesPerFrame") {
+      bricks.pagesPerFrame = std::max(value,1);
+      return true;
+    }
+    return false;
+  }
+
   // ==================================================================
   bool StructuredData::set3i(const std::string &member,
                              const vec3i &value) 
@@ -155,7 +726,13 @@ namespace BARNEY_NS {
                                  const Object::SP &value) 
   {
     if (member == "textureData") {
-      scalars = value->as<TextureData>();
+      freeBricks();
+      TextureData::SP newScalars = value->as<TextureData>();
+      newTimeStep
+        =  scalars && newScalars
+        && newScalars->dims == scalars->dims
+        && newScalars->texelFormat == scalars->texelFormat;
+      scalars = newScalars;
       BNTextureAddressMode addressModes[3] = {
         BN_TEXTURE_CLAMP,BN_TEXTURE_CLAMP,BN_TEXTURE_CLAMP
       };
@@ -175,8 +752,86 @@ namespace BARNEY_NS {
   // ==================================================================
   void StructuredData::commit() 
   {
+    MemoryScope memScope(devices.get(),BN_MEMORY_VOLUME_FIELDS);
     worldBounds.lower = gridOrigin;
     worldBounds.upper = gridOrigin + gridSpacing * vec3f(numCells);
+
+    buildBricksIfRequested();
+    if (newTimeStep && mcGrid
+        && mcGrid->dims == divRoundUp(numCells,vec3i(cellsPerMC)))
+      computeMCs(mcGrid);
+    newTimeStep = false;
+    buildGradients();
+  }
+
+  void StructuredData::buildGradients()
+  {
+    if (!gradientsEnabled || bricks.cacheSize > 0 || !scalars) {
+      gradientTexture.reset();
+      return;
+    }
+    // computed on one device, and then uploaded like any other
+    // texture; that's a round trip through the host, but only once
+    // per (time step of a) field
+    size_t numGradients64 = owl::common::volume(numScalars);
+    int numGradients = (int)numGradients64;
+    if (numGradients != numGradients64)
+      throw std::runtime_error("number of scalars cannot be expressed in a 32-bit value");
+    std::vector<uint32_t> gradients(numGradients);
+    {
+      Device *device = (*devices)[0];
+      SetActiveGPU forDuration(device);
+      gradientTexture.reset();
+      rtc::Buffer *buffer
+        = device->rtc->createBuffer(numGradients*sizeof(uint32_t));
+      int bs = 128;
+      int nb = divRoundUp(numGradients,bs);
+      __rtc_launch(device->rtc,
+                   StructuredData_computeGradients,
+                   nb,bs,
+                   (uint32_t*)buffer->getDD(),
+                   numScalars,
+                   StructuredDataSampler(this).getDD(device));
+      device->rtc->copy(gradients.data(),buffer->getDD(),
+                        numGradients*sizeof(uint32_t));
+      device->rtc->freeBuffer(buffer);
+    }
+    TextureData::SP data
+      = std::make_shared<TextureData>((Context*)context,devices,
+                                      BN_UFIXED8_RGBA,numScalars,
+                                      gradients.data());
+    BNTextureAddressMode addressModes[3] = {
+      BN_TEXTURE_CLAMP,BN_TEXTURE_CLAMP,BN_TEXTURE_CLAMP
+    };
+    gradientTexture
+      = std::make_shared<Texture>((Context*)context,data,
+                                  BN_TEXTURE_LINEAR,
+                                  addressModes,
+                                  BN_COLOR_SPACE_LINEAR);
+  }
+
+  void StructuredData::buildBricksIfRequested()
+  {
+    // bricks get built from the texture only once; after that the
+    // texture is gone
+    // bricks are also how automatic partitioning splits the field
+    // across devices
+    const bool partition = (*devices)[0]->partition.size > 1;
+    if (!(bricks.enabled || bricks.quantizeBits || bricks.residentMB
+          || partition)
+        || !textureNN) return;
+    if (scalars->numChannels != 1) return;
+    switch (scalars->texelFormat) {
+    case BN_FLOAT:    bricks.inputBytesPerScalar = 4; break;
+    case BN_UFIXED8:  bricks.inputBytesPerScalar = 1; break;
+    case BN_UFIXED16: bricks.inputBytesPerScalar = 2; break;
+    default: return;
+    }
+    bricks.bytesPerScalar
+      = bricks.quantizeBits
+      ? bricks.quantizeBits/8
+      : bricks.inputBytesPerScalar;
+    buildBricks();
   }
   
 }
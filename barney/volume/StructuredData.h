@@ -29,6 +29,34 @@ namespace BARNEY_NS {
 
       - "gridSpacing" (float3) : world-space spacing of the scalar
       grid positions
+
+      - "bricked" (int) : whether to store the scalars in sparse
+      bricks (see \ref bricks); defaults to BARNEY_CONFIG's
+      'bricked'
+
+      - "quantizeBits" (int) : if 8 or 16, bricks store their scalars
+      quantized to that many bits, relative to each brick's own
+      scalar range (implies "bricked"); 0 (default) keeps the
+      scalars' format
+
+      - "residentMB" (int) : if non-zero (and smaller than all
+      bricks), bricks get paged in and out of a cache of that many
+      MB per device (implies "bricked"; see \ref bricks)
+
+      - "pagesPerFrame" (int) : how many bricks each device may page
+      in between two frames (default 1024)
+
+      - "gradients" (int) : if non-zero, precomputes a (quantized,
+      4 bytes per scalar) gradient texture, so iso-surface normals
+      take a single texture fetch instead of six extra samples;
+      defaults to BARNEY_CONFIG's 'gradients'. Not while paging
+
+      For time-varying data, "textureData" can get replaced by one
+      of the same dims and format at any time; ideally one created
+      with bnTextureData3DCreateAsync() a few frames earlier, so
+      the upload already overlapped with rendering. Committing then
+      only refreshes the existing macro cells in place (volumes'
+      majorants get recomputed on their next build)
   */
   struct StructuredData : public ScalarField
   {
@@ -44,10 +72,11 @@ namespace BARNEY_NS {
     */
     StructuredData(Context *context,
                    const DevGroup::SP &devices);
-    virtual ~StructuredData() = default;
+    virtual ~StructuredData();
 
     // ------------------------------------------------------------------
     /*! @{ parameter set/commit interface */
+    bool set1i(const std::string &member, const int &value) override;
     bool set3i(const std::string &member, const vec3i &value) override;
     bool set3f(const std::string &member, const vec3f &value) override;
     bool setObject(const std::string &member, const Object::SP &value) override;
@@ -64,10 +93,117 @@ namespace BARNEY_NS {
     
     /*! create, fill, and return a macrocell grid for this field */
     MCGrid::SP buildMCs() override;
+    bool isPartitioned() const override { return bricks.partitioned; }
+    /*! (re-)computes given macro cell grid's ranges (and value
+        masks) from the current scalars */
+    void computeMCs(MCGrid::SP mcGrid);
+
+    /*! splits the (dense) scalars texture into bricks, and drops
+        the texture afterwards */
+    void buildBricks();
+    void freeBricks();
+    /*! builds the bricks if any brick related parameters ask for
+        them (and there's a texture to build them from) */
+    void buildBricksIfRequested();
+    /*! (re-)computes the gradient texture, if "gradients" asks for
+        one; else drops it */
+    void buildGradients();
+    /*! enables and fills in the macro cells' value masks (see
+        MCGrid::enableValueMasks()), given the macro cells' ranges */
+    void buildValueMasks(MCGrid::SP mcGrid,
+                         const std::vector<range1f> &mcRanges);
+    /*! pages in (some of) the bricks that samples of the previous
+        frame found missing; only does anything if paging */
+    void servicePageRequests();
 
     TextureData::SP scalars;
     Texture::SP  texture;
     Texture::SP  textureNN;
+    /*! set when "textureData" got replaced by one of the same shape
+        (eg, the next step of a time series); commit() then just
+        refreshes the existing macro cells rather than having them
+        (and everything built on them) rebuilt from scratch */
+    bool         newTimeStep = false;
+    /*! per scalar, rgb8 of the normalized central-difference
+        gradient (in index space, mapped from [-1,1] to [0,1]) */
+    Texture::SP  gradientTexture;
+    bool         gradientsEnabled = false;
+
+    /*! bricks of cellsPerBrick^3 cells each - the same as a macro
+        cell - so a brick's scalar range is also its macro cell's */
+    enum { cellsPerBrick = 8 };
+    /*! special brick slots; outsideBrick is for bricks in other
+        devices' parts, with automatic partitioning */
+    enum { constantBrick = -1, nonResidentBrick = -2, outsideBrick = -3 };
+    
+    /*! sparse bricked storage: bricks whose scalars are all the same
+        (eg, empty space) only store that one value; all others store
+        their (cellsPerBrick+1)^3 scalars - including the ones they
+        share with their neighbors, so interpolating never needs more
+        than a single brick - in a pool of such bricks. The sampler
+        resolves bricks on the fly, with software trilinear
+        interpolation. Only for single-channel scalars */
+    struct {
+      bool  enabled        = false;
+      vec3i dims           { 0,0,0 };
+      int   numStored      = 0;
+      int   bytesPerScalar = 0;
+      /*! bytes per scalar of the (dense) input */
+      int   inputBytesPerScalar = 0;
+      /*! fixed-rate compression: 8 or 16 if pool scalars get
+          quantized within each brick's range, else 0 */
+      int   quantizeBits   = 0;
+      /*! per brick, the range of its scalars */
+      std::vector<range1f> ranges;
+
+      /*! out-of-core paging: the pool lives in (pinned) host memory,
+          and every device only keeps a cache of residentMB worth of
+          bricks. A sample that hits a brick that isn't resident uses
+          the midpoint of the brick's range instead, and flags the
+          brick; between frames, servicePageRequests() pages in up to
+          pagesPerFrame of those, evicting the least recently used
+          ones - so the image converges as the bricks arrive */
+      int   residentMB     = 0;
+      int   pagesPerFrame  = 1024;
+      /*! in bricks; 0 if not paging */
+      int   cacheSize      = 0;
+      uint8_t *hostPool    = 0;
+      /*! per brick, where it is in hostPool (or constantBrick) */
+      std::vector<int> poolIndex;
+      int   frameID        = 0;
+
+      /*! with automatic partitioning (and not paging), every device
+          only stores the bricks of its own part - from a k-d split
+          of the brick grid - and samples NaN everywhere else. The
+          bricks already include the scalars they share with their
+          neighbors, so that's all the ghost layer interpolating
+          across a part's boundary needs */
+      bool  partitioned    = false;
+      /*! per brick, the part it is in */
+      std::vector<int> partOf;
+    } bricks;
+    
+    struct PLD {
+      /*! per brick, its slot in the pool, or -1 if constant */
+      rtc::Buffer *brickSlots  = 0;
+      /*! per brick, the value of a constant brick (or the lower end
+          of its range) */
+      rtc::Buffer *brickValues = 0;
+      /*! per brick, the width of its range; only if quantizing */
+      rtc::Buffer *brickScales = 0;
+      rtc::Buffer *brickPool   = 0;
+      /*! only if paging: per brick, the value to use while not
+          resident, and whether a sample wanted it */
+      rtc::Buffer *brickCoarse = 0;
+      rtc::Buffer *brickUsage  = 0;
+      /*! only if paging: host copy of brickSlots, and per cache
+          slot, the brick in it (or -1), and when it was last used */
+      std::vector<int> slots;
+      std::vector<int> residentBrick;
+      std::vector<int> lastUsed;
+    };
+    PLD *getPLD(Device *device);
+    std::vector<PLD> perLogical;
 
     BNDataType scalarType = BN_DATA_UNDEFINED;
     vec3i numScalars  { 0,0,0 };
@@ -87,10 +223,32 @@ namespace BARNEY_NS {
       inline __rtc_device float sample(const vec3f P, bool dbg=false) const;
 #endif
       
+#if RTC_DEVICE_CODE
+      inline __rtc_device float brickScalar(size_t idx) const;
+      /*! the scalar at given grid vertex; for non-resident bricks
+          that's only the brick's coarse value */
+      inline __rtc_device float scalar(vec3i scalarID) const;
+#endif
+      
       rtc::TextureObject texObj;
       vec3f cellGridOrigin;
       vec3f cellGridSpacing;
       vec3i numCells;
+      /*! if non-null, the field is stored in sparse bricks (and
+          texObj isn't used); see StructuredData::bricks */
+      const int   *brickSlots;
+      const float *brickValues;
+      /*! if non-null, pool scalars are quantized; their value is
+          brickValues[b] + brickScales[b] * (normalized pool scalar) */
+      const float *brickScales;
+      const void  *brickPool;
+      /*! if non-null, see StructuredData::gradientTexture */
+      rtc::TextureObject gradients;
+      /*! only if paging; see StructuredData::PLD */
+      const float *brickCoarse;
+      uint8_t     *brickUsage;
+      vec3i        numBricks;
+      int          bytesPerScalar;
     };
 
     void build() override {}
@@ -110,9 +268,217 @@ namespace BARNEY_NS {
     if (rel.x >= numCells.x) return NAN;
     if (rel.y >= numCells.y) return NAN;
     if (rel.z >= numCells.z) return NAN;
+    if (brickSlots) {
+      const int S = StructuredData::cellsPerBrick+1;
+      vec3i cellID = min(vec3i(rel),numCells-vec3i(1));
+      vec3f frac   = rel - vec3f(cellID);
+      vec3i brickID = cellID / vec3i(StructuredData::cellsPerBrick);
+      int brickIdx
+        = brickID.x+numBricks.x*(brickID.y+numBricks.y*brickID.z);
+      int slot = brickSlots[brickIdx];
+      if (slot == StructuredData::outsideBrick)
+        return NAN;
+      if (slot == StructuredData::constantBrick)
+        return brickValues[brickIdx];
+      if (brickUsage && !brickUsage[brickIdx])
+        brickUsage[brickIdx] = 1;
+      if (slot == StructuredData::nonResidentBrick)
+        return brickCoarse[brickIdx];
+      vec3i local = cellID - brickID*vec3i(StructuredData::cellsPerBrick);
+      size_t base
+        = size_t(slot)*(S*S*S) + local.x + S*(local.y + S*local.z);
+      float f000 = brickScalar(base);
+      float f001 = brickScalar(base+1);
+      float f010 = brickScalar(base+S);
+      float f011 = brickScalar(base+S+1);
+      float f100 = brickScalar(base+S*S);
+      float f101 = brickScalar(base+S*S+1);
+      float f110 = brickScalar(base+S*S+S);
+      float f111 = brickScalar(base+S*S+S+1);
+      float f00 = f000 + frac.x*(f001-f000);
+      float f01 = f010 + frac.x*(f011-f010);
+      float f10 = f100 + frac.x*(f101-f100);
+      float f11 = f110 + frac.x*(f111-f110);
+      float f0  = f00 + frac.y*(f01-f00);
+      float f1  = f10 + frac.y*(f11-f10);
+      float f   = f0 + frac.z*(f1-f0);
+      // de-quantizing is linear, so can be done after interpolation
+      if (brickScales)
+        f = brickValues[brickIdx] + brickScales[brickIdx]*f;
+      return f;
+    }
     float f = rtc::tex3D<float>(texObj,rel.x+.5f,rel.y+.5f,rel.z+.5f);
     return f;
   }
+
+  inline __rtc_device
+  float StructuredDataSampler::DD::scalar(vec3i scalarID) const
+  {
+    if (!brickSlots)
+      return rtc::tex3D<float>(texObj,
+                               scalarID.x+.5f,scalarID.y+.5f,scalarID.z+.5f);
+    const int S = StructuredData::cellsPerBrick+1;
+    // vertices on a brick's upper faces are stored in the lower
+    // neighbor, too, so can always read them from there
+    vec3i brickID = min(scalarID / vec3i(StructuredData::cellsPerBrick),
+                        numBricks-vec3i(1));
+    int brickIdx
+      = brickID.x+numBricks.x*(brickID.y+numBricks.y*brickID.z);
+    int slot = brickSlots[brickIdx];
+    if (slot == StructuredData::constantBrick ||
+        slot == StructuredData::outsideBrick)
+      return brickValues[brickIdx];
+    if (slot == StructuredData::nonResidentBrick)
+      return brickCoarse[brickIdx];
+    vec3i local = scalarID - brickID*vec3i(StructuredData::cellsPerBrick);
+    float f = brickScalar(size_t(slot)*(S*S*S)
+                          + local.x + S*(local.y + S*local.z));
+    if (brickScales)
+      f = brickValues[brickIdx] + brickScales[brickIdx]*f;
+    return f;
+  }
+
+  /*! reads a pool scalar, normalizing fixed-point ones the same way
+      a texture would */
+  inline __rtc_device
+  float StructuredDataSampler::DD::brickScalar(size_t idx) const
+  {
+    switch (bytesPerScalar) {
+    case 1:
+      return ((const uint8_t *)brickPool)[idx] * (1.f/255.f);
+    case 2:
+      return ((const uint16_t *)brickPool)[idx] * (1.f/65535.f);
+    default:
+      return ((const float *)brickPool)[idx];
+    }
+  }
+#endif
+
+#if BARNEY_DEVICE_PROGRAM && RTC_DEVICE_CODE
+  /*! gradient from the precomputed gradient texture, if there is
+      one; see MCAccelerator.h's sampleGradient() */
+  inline __rtc_device
+  vec3f sampleGradient(const StructuredDataSampler::DD &sampler,
+                       vec3f P, float delta, float fP)
+  {
+    if (!sampler.gradients)
+      return sampleGradient<StructuredDataSampler::DD>(sampler,P,delta,fP);
+    vec3f rel = (P - sampler.cellGridOrigin) * rcp(sampler.cellGridSpacing);
+    vec4f g = rtc::tex3D<vec4f>(sampler.gradients,
+                                rel.x+.5f,rel.y+.5f,rel.z+.5f);
+    return (2.f*vec3f(g.x,g.y,g.z)-vec3f(1.f)) * rcp(sampler.cellGridSpacing);
+  }
+
+  /*! first root of the trilinear interpolant of a cell's corner
+      values f[] (minus isoValue) along local ray p+t*d, t in
+      [t0,t1]. Along a ray the interpolant is a cubic; splitting
+      [t0,t1] at its extrema leaves up to three monotonic pieces,
+      and the first of those whose ends' signs differ gets refined
+      by regula falsi */
+  inline __rtc_device
+  bool intersectTrilinear(const float f[8], float isoValue,
+                          vec3f p, vec3f d, float t0, float t1,
+                          float &tHit)
+  {
+    float c[4] = { -isoValue, 0.f, 0.f, 0.f };
+    for (int i=0;i<8;i++) {
+      // each corner's weight is a product of three linear
+      // functions of t, (A + t B) per axis
+      float ax = (i&1)      ? p.x : 1.f-p.x, bx = (i&1)      ? d.x : -d.x;
+      float ay = ((i>>1)&1) ? p.y : 1.f-p.y, by = ((i>>1)&1) ? d.y : -d.y;
+      float az = (i>>2)     ? p.z : 1.f-p.z, bz = (i>>2)     ? d.z : -d.z;
+      c[0] += f[i] * (ax*ay*az);
+      c[1] += f[i] * (bx*ay*az + ax*by*az + ax*ay*bz);
+      c[2] += f[i] * (bx*by*az + bx*ay*bz + ax*by*bz);
+      c[3] += f[i] * (bx*by*bz);
+    }
+    auto g = [&](float t) { return ((c[3]*t+c[2])*t+c[1])*t+c[0]; };
+
+    // extrema, ie, roots of g' = 3c3 t^2 + 2c2 t + c1, sorted
+    float splits[4] = { t0, t1, t1, t1 };
+    int numSplits = 1;
+    float qa = 3.f*c[3], qb = 2.f*c[2], qc = c[1];
+    if (fabsf(qa) > 1e-12f) {
+      float disc = qb*qb - 4.f*qa*qc;
+      if (disc > 0.f) {
+        float sq = sqrtf(disc);
+        float e0 = (-qb - sq) / (2.f*qa);
+        float e1 = (-qb + sq) / (2.f*qa);
+        if (e0 > e1) { float tmp = e0; e0 = e1; e1 = tmp; }
+        if (e0 > t0 && e0 < t1) splits[numSplits++] = e0;
+        if (e1 > t0 && e1 < t1) splits[numSplits++] = e1;
+      }
+    } else if (fabsf(qb) > 1e-12f) {
+      float e = -qc / qb;
+      if (e > t0 && e < t1) splits[numSplits++] = e;
+    }
+    splits[numSplits] = t1;
+    
+    for (int piece=0;piece<numSplits;piece++) {
+      float ta = splits[piece],   ga = g(ta);
+      float tb = splits[piece+1], gb = g(tb);
+      if (ga == 0.f) { tHit = ta; return true; }
+      if ((ga < 0.f) == (gb < 0.f)) continue;
+      for (int it=0;it<8;it++) {
+        float tm = ta - ga * (tb-ta) / (gb-ga);
+        float gm = g(tm);
+        if ((gm < 0.f) == (ga < 0.f)) { ta = tm; ga = gm; }
+        else                          { tb = tm; gb = gm; }
+      }
+      tHit = ta - ga * (tb-ta) / (gb-ga);
+      return true;
+    }
+    return false;
+  }
+  
+  /*! voxel-exact iso-surface intersection: walks the native cells
+      of the segment, skips those whose corners' range doesn't
+      contain the iso-value, and solves for the trilinear
+      interpolant's root in all others. Falls back to the generic
+      version while paging, where non-resident cells would only have
+      their coarse value */
+  inline __rtc_device
+  bool intersectIsoSegment(const StructuredDataSampler::DD &sampler,
+                           vec3f org, vec3f dir,
+                           range1f tRange,
+                           float isoValue,
+                           float numMCsCrossed,
+                           float &tHit,
+                           bool dbg)
+  {
+    if (sampler.brickUsage)
+      return intersectIsoSegment<StructuredDataSampler::DD>
+        (sampler,org,dir,tRange,isoValue,numMCsCrossed,tHit,dbg);
+    
+    const vec3f rcpSpacing = rcp(sampler.cellGridSpacing);
+    const vec3f P = (org + tRange.lower*dir - sampler.cellGridOrigin) * rcpSpacing;
+    const vec3f D = dir * rcpSpacing;
+    bool found = false;
+    dda::dda3(P,D,tRange.upper-tRange.lower,vec3ui(sampler.numCells),
+              [&](const vec3i &cellID, float t0, float t1) -> bool
+              {
+                // dda3() keeps walking past tMax, with empty segments
+                if (t0 >= t1) return false;
+                float f[8];
+                float lo = +BARNEY_INF, hi = -BARNEY_INF;
+                for (int i=0;i<8;i++) {
+                  f[i] = sampler.scalar(cellID+vec3i(i&1,(i>>1)&1,i>>2));
+                  lo = min(lo,f[i]);
+                  hi = max(hi,f[i]);
+                }
+                if (!(isoValue >= lo && isoValue <= hi))
+                  return true;
+                float t;
+                if (!intersectTrilinear(f,isoValue,P-vec3f(cellID),D,
+                                        t0,t1,t))
+                  return true;
+                tHit  = min(tHit,tRange.lower+t);
+                found = true;
+                return false;
+              },
+              /*NO debug:*/false);
+    return found;
+  }
 #endif
 }
 
@@ -9,6 +9,7 @@
 #include "barney/common/math.h"
 #else
 #include "barney/volume/ScalarField.h"
+#include "barney/common/BuildLog.h"
 #endif
 
 namespace BARNEY_NS {
@@ -31,6 +32,7 @@ namespace BARNEY_NS {
 
   void Volume::commit()
   {
+    MemoryScope memScope(devices.get(),BN_MEMORY_VOLUME_ACCELS);
     if (!accel)
       return;
     if (needsMajorantRebuild && sf->mcGrid && sf->mcGrid->built()) {
@@ -47,6 +49,10 @@ namespace BARNEY_NS {
       userID = value;
       return true; 
     }
+    if (member == "ratioTracking") {
+      ratioTracking = value;
+      return true;
+    }
     if (member == "principledVolume") {
       principled.enabled = value ? 1 : 0;
       needsMajorantRebuild = true;
@@ -111,6 +117,16 @@ namespace BARNEY_NS {
   bool Volume::set3f(const std::string &member,
                      const vec3f &value)
   {
+    if (member == "clipBoxLower") {
+      clipBox.lower = value;
+      needsMajorantRebuild = true;
+      return true;
+    }
+    if (member == "clipBoxUpper") {
+      clipBox.upper = value;
+      needsMajorantRebuild = true;
+      return true;
+    }
     if (member == "principledScatterColor") {
       principled.scatterColor = max(value, vec3f(0.f));
       needsMajorantRebuild = true;
@@ -151,10 +167,29 @@ namespace BARNEY_NS {
       userID = value;
       return true; 
     } 
+    if (member == "ratioTracking") {
+      ratioTracking = value;
+      return true;
+    }
     
     return false;
   }
 
+  bool Volume::set3f(const std::string &member,
+                     const vec3f &value)
+  {
+    /* the majorants pick this up with the next build */
+    if (member == "clipBoxLower") {
+      clipBox.lower = value;
+      return true;
+    }
+    if (member == "clipBoxUpper") {
+      clipBox.upper = value;
+      return true;
+    }
+    return false;
+  }
+
 #endif
   
   inline ScalarField::SP assertNotNull(const ScalarField::SP &s)
@@ -171,13 +206,17 @@ namespace BARNEY_NS {
   {
     accel = sf->createAccel(this);
     perLogical.resize(devices->numLogical);
+    ratioTracking = FromEnv::enabled("ratioTracking");
   }
 
   const TransferFunction *VolumeAccel::getXF() const { return &volume->xf; }
   
   void Volume::build(bool full_rebuild)
   {
+    MemoryScope memScope(devices.get(),BN_MEMORY_VOLUME_ACCELS);
+    NvtxRange nvtx("buildVolumeAccel");
     assert(accel);
+    BuildLog::Scope scope(BN_BUILD_VOLUME,this,devices.get());
     accel->build(full_rebuild);
 #if BARNEY_USE_MULTI_SCATTERING
     needsMajorantRebuild = false;
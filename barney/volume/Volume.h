@@ -9,6 +9,7 @@
 #include "barney/volume/TransferFunction.h"
 #include "barney/volume/ScalarField.h"
 #include "barney/barneyConfig.h"
+#include "barney/common/DeviceCounters.h"
 #if BARNEY_USE_MULTI_SCATTERING
 #include "barney/volume/PrincipledVolume.h"
 #endif
@@ -30,9 +31,16 @@ namespace BARNEY_NS {
     
     typedef std::shared_ptr<VolumeAccel> SP;
 
+    /*! max number of volumes - its own plus merged ones - a single
+        accel traverses */
+    enum { maxMergedVolumes = 4 };
+
     VolumeAccel(Volume *volume);
     virtual ~VolumeAccel() = default;
 
+    /*! pretty-printer for printf-debugging (and build records) */
+    virtual std::string toString() const { return "VolumeAccel"; }
+
     virtual void build(bool full_rebuild) = 0;
 
 #if BARNEY_USE_MULTI_SCATTERING
@@ -41,6 +49,19 @@ namespace BARNEY_NS {
 #endif
 
     const TransferFunction *getXF() const;
+
+    /*! whether given other volume's accel can get traced as part of this
+        one's, with a combined majorant; see setMergedVolumes() */
+    virtual bool canMerge(VolumeAccel *other) const;
+    /*! sets the (already built) volumes that this accel traverses in
+        addition to its own, in one pass; their own accels don't get
+        traced at all. Called by Group::build() */
+    virtual void setMergedVolumes(const std::vector<Volume *> &others);
+    
+    /*! volumes whose collisions this accel takes care of, too */
+    std::vector<Volume *> mergedVolumes;
+    /*! if non-null, this volume gets traced by that volume's accel */
+    Volume      *mergedInto = nullptr;
     
     Volume      *const volume = 0;
     const DevGroup::SP devices;
@@ -65,7 +86,14 @@ namespace BARNEY_NS {
       inline __rtc_device
       vec4f sampleAndMap(vec3f point, bool dbg=false) const
       {
-        float f = sfSampler.sample(point,dbg);
+        return map(sfSampler.sample(point,dbg),dbg);
+      }
+
+      /*! maps an already sampled scalar through this volume's
+          transfer function (and principled params, if enabled) */
+      inline __rtc_device
+      vec4f map(float f, bool dbg=false) const
+      {
         if (isnan(f)) return vec4f(0.f);
 #if BARNEY_USE_MULTI_SCATTERING
         if (principled.enabled) {
@@ -96,6 +124,12 @@ namespace BARNEY_NS {
       float                         scatteringAlbedo;
 #endif
       int                           userID;
+      /*! whether shadow rays estimate this volume's transmittance
+          (see Woodcock::ratioTrack()) rather than delta tracking it */
+      int                           ratioTracking;
+      /*! object-space box outside of which the volume is clipped
+          away; empty if not clipped */
+      box3f                         clipBox;
     };
     
     template<typename SFSampler>
@@ -106,6 +140,8 @@ namespace BARNEY_NS {
       dd.sfSampler = sampler->getDD(device);
       dd.xf = xf.getDD(device);
       dd.userID = userID;
+      dd.ratioTracking = ratioTracking;
+      dd.clipBox = clipBox;
 #if BARNEY_USE_MULTI_SCATTERING
       dd.principled = principled.getDD(device);
       dd.anisotropy = anisotropy;
@@ -120,7 +156,7 @@ namespace BARNEY_NS {
 
     /*! pretty-printer for printf-debugging */
     std::string toString() const override
-    { return "Volume{}"; }
+    { return accel ? "Volume{"+accel->toString()+"}" : "Volume{}"; }
 
     static SP create(ScalarField::SP sf)
     {
@@ -148,6 +184,8 @@ namespace BARNEY_NS {
 #else
     bool set1i(const std::string &member,
                const int   &value) override;
+    bool set3f(const std::string &member,
+               const vec3f &value) override;
 #endif
                
     ScalarField::SP  sf;
@@ -161,6 +199,11 @@ namespace BARNEY_NS {
 #endif
     DevGroup::SP const devices;
     int userID = 0;
+    bool ratioTracking = false;
+    /*! object-space clip box ("clipBoxLower"/"clipBoxUpper"); empty
+        (the default) if not clipped. Gets folded into the majorants,
+        so clipped-away cells cost nothing to traverse */
+    box3f clipBox;
     
     struct PLD {
       std::vector<rtc::Group *> generatedGroups;
@@ -194,7 +237,8 @@ namespace BARNEY_NS {
                      range1f &tRange,
                      float majorant,
                      Random &rand,
-                     bool dbg=false) 
+                     bool dbg=false,
+                     uint64_t *counters=nullptr) 
     {
       float t = tRange.lower;
       while (true) {
@@ -207,6 +251,7 @@ namespace BARNEY_NS {
 
         vec3f P = org+t*dir;
         sample = sfSampler.sampleAndMap(P,dbg);
+        DeviceCounters::count(counters,DeviceCounters::WOODCOCK_SAMPLES);
         // if (dbg) printf("sample at t %f, P= %f %f %f -> %f %f %f : %f\n",
         //                 t,
         //                 P.x,P.y,P.z,
@@ -215,11 +260,55 @@ namespace BARNEY_NS {
         //                 sample.z,
         //                 sample.w);
         if (sample.w >= rand()*majorant) {
+          DeviceCounters::count(counters,DeviceCounters::WOODCOCK_ACCEPTED);
           tRange.upper = t;
           return true;
         }
       }
     }
+
+    /*! ratio tracking over a given parameter range: rather than
+        stopping at the first real collision, multiplies given
+        transmittance by the null-collision probability at each
+        tentative one, so shadow rays get a fractional visibility
+        instead of a binary one. Once transmittance gets low, russian
+        roulette either terminates it - returning false, and
+        tRange.upper being where - or boosts it back up */
+    template<typename VolumeDD>
+    static inline __rtc_device
+    bool ratioTrack(float &transmittance,
+                    const VolumeDD &sfSampler,
+                    vec3f org, vec3f dir,
+                    range1f &tRange,
+                    float majorant,
+                    Random &rand,
+                    bool dbg=false,
+                    uint64_t *counters=nullptr) 
+    {
+      const float rrThreshold = .1f;
+      float t = tRange.lower;
+      while (true) {
+        float r = rand();
+        float dt = - fastLog(1.f-r)/majorant;
+        t += dt;
+        if (t >= tRange.upper)
+          return true;
+
+        vec3f P = org+t*dir;
+        vec4f sample = sfSampler.sampleAndMap(P,dbg);
+        DeviceCounters::count(counters,DeviceCounters::WOODCOCK_SAMPLES);
+        transmittance *= max(0.f,1.f - sample.w/majorant);
+        if (transmittance < rrThreshold) {
+          float survive = transmittance/rrThreshold;
+          if (rand() >= survive) {
+            transmittance = 0.f;
+            tRange.upper = t;
+            return false;
+          }
+          transmittance = rrThreshold;
+        }
+      }
+    }
   };
 
   inline VolumeAccel::VolumeAccel(Volume *volume)
@@ -230,6 +319,12 @@ namespace BARNEY_NS {
     assert(volume->sf);
   }
 
+  inline bool VolumeAccel::canMerge(VolumeAccel *other) const
+  { return false; }
+  
+  inline void VolumeAccel::setMergedVolumes(const std::vector<Volume *> &others)
+  { assert(others.empty()); }
+  
 #if BARNEY_USE_MULTI_SCATTERING
   inline void VolumeAccel::rebuildMajorantsOnly() {}
 
@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace rtc {
+
+  /*! bookkeeping of what a device's buffers, raw allocations,
+      texture data and accels take up, by the category that was
+      'current' when each got allocated. rtc doesn't know what
+      categories mean; the app sets current before it allocates
+      things (and an allocation keeps its category until it gets
+      freed) */
+  struct MemoryTracker {
+    enum { MAX_CATEGORIES = 16 };
+
+    struct Usage {
+      size_t used[MAX_CATEGORIES] = {};
+      size_t total     = 0;
+      /*! most that total has been since the last resetHighWater() */
+      size_t highWater = 0;
+      /*! all bytes ever allocated, by category; never goes down, so
+          the difference between two usages is what got allocated in
+          between */
+      size_t allocated[MAX_CATEGORIES] = {};
+    };
+
+    inline void allocated(int category, size_t numBytes);
+    inline void freed(int category, size_t numBytes);
+    /*! same, for allocations that only get freed by address; those
+        to the current category */
+    inline void allocated(const void *ptr, size_t numBytes);
+    inline void freed(const void *ptr);
+
+    inline Usage getUsage();
+    inline void  resetHighWater();
+
+    /*! what allocations get attributed to from now on */
+    int current = 0;
+
+  private:
+    std::mutex mutex;
+    Usage      usage;
+    std::map<const void *,std::pair<int,size_t>> byAddress;
+  };
+
+  inline void MemoryTracker::allocated(int category, size_t numBytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    category = std::max(0,std::min(category,(int)MAX_CATEGORIES-1));
+    usage.used[category] += numBytes;
+    usage.allocated[category] += numBytes;
+    usage.total += numBytes;
+    usage.highWater = std::max(usage.highWater,usage.total);
+  }
+
+  inline void MemoryTracker::freed(int category, size_t numBytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    category = std::max(0,std::min(category,(int)MAX_CATEGORIES-1));
+    usage.used[category] -= std::min(usage.used[category],numBytes);
+    usage.total -= std::min(usage.total,numBytes);
+  }
+
+  inline void MemoryTracker::allocated(const void *ptr, size_t numBytes)
+  {
+    if (!ptr) return;
+    int category = current;
+    allocated(category,numBytes);
+    std::lock_guard<std::mutex> lock(mutex);
+    byAddress[ptr] = { category,numBytes };
+  }
+
+  inline void MemoryTracker::freed(const void *ptr)
+  {
+    std::pair<int,size_t> alloc;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = byAddress.find(ptr);
+      if (it == byAddress.end()) return;
+      alloc = it->second;
+      byAddress.erase(it);
+    }
+    freed(alloc.first,alloc.second);
+  }
+
+  inline MemoryTracker::Usage MemoryTracker::getUsage()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return usage;
+  }
+
+  inline void MemoryTracker::resetHighWater()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    usage.highWater = usage.total;
+  }
+
+}
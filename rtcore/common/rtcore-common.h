@@ -48,8 +48,23 @@ namespace rtc {
     FLOAT4,
       
     USHORT=40,
+
+    /*! block-compressed 2D formats: 4x4 texels per 8 (BC1, BC4) or
+        16 byte block, blocks in row-major order */
+    BC1=50,
+    BC3,
+    BC4,
+    BC5,
+    BC6H,
+    BC7,
   } DataType;
 
+  inline bool isBlockCompressed(DataType format)
+  { return format >= BC1 && format <= BC7; }
+
+  inline size_t numBytesPerBlock(DataType format)
+  { return (format == BC1 || format == BC4) ? 8 : 16; }
+
   typedef enum {
     WRAP,CLAMP,BORDER,MIRROR,
   } AddressMode;
@@ -61,6 +76,16 @@ namespace rtc {
   typedef enum {
     COLOR_SPACE_LINEAR, COLOR_SPACE_SRGB,
   } ColorSpace;
+
+  /*! what a geometry group's acceleration structure should be
+      optimized for: the backend's default, trace performance (for
+      large, static data), or build time (for geometry that changes
+      every frame) */
+  typedef enum {
+    BUILD_QUALITY_DEFAULT=0,
+    BUILD_QUALITY_FAST_TRACE,
+    BUILD_QUALITY_FAST_BUILD,
+  } BuildQuality;
   
   struct TextureDesc {
     FilterMode filterMode = FILTER_MODE_LINEAR;
@@ -68,10 +93,29 @@ namespace rtc {
     vec4f borderColor          = {0.f,0.f,0.f,0.f};
     bool normalizedCoords      = true;
     ColorSpace colorSpace      = COLOR_SPACE_LINEAR;
+    /*! if set, and if the data is 2D, the texture gets a full chain
+        of (box-filtered) mip levels that tex2DLod() can pick from;
+        those get generated from the data the first time any texture
+        over that data asks for them */
+    bool mipMaps               = false;
   };
 
   typedef struct _TextureObject *TextureObject;
   typedef struct _AccelHandle   *AccelHandle;
+
+  /*! a single ray to trace, as set up by a batched trace kernel's
+      beginTrace() (see RTC_EXPORT_BATCHED_TRACE2D); the prd is whatever
+      that kernel passes along with it */
+  struct TraceRequest {
+    AccelHandle world;
+    vec3f       org;
+    vec3f       dir;
+    float       tmin;
+    float       tmax;
+    /*! only find out whether anything gets hit, through
+        traceOcclusion() rather than traceRay() */
+    bool        occlusionOnly;
+  };
 }
 
 
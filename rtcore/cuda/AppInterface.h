@@ -22,6 +22,7 @@ namespace rtc {
 
     using rtc::cuda_common::enablePeerAccess;
     using rtc::cuda_common::getPhysicalDeviceHash;
+    using rtc::cuda_common::getNumaNode;
     
     using rtc::cuda_common::ComputeKernel1D;
     using rtc::cuda_common::ComputeKernel2D;
@@ -18,6 +18,7 @@ namespace rtc {
       
       SetActiveGPU forDuration(device);
       BARNEY_CUDA_CALL(Malloc((void**)&d_data,numBytes));
+      device->memory.allocated(d_data,numBytes);
       if (initValues)
         BARNEY_CUDA_CALL(Memcpy(d_data,initValues,numBytes,cudaMemcpyDefault));
       BARNEY_CUDA_SYNC_CHECK();
@@ -26,6 +27,7 @@ namespace rtc {
     Buffer::~Buffer()
     {
       if (!d_data) return;
+      device->memory.freed(d_data);
       BARNEY_CUDA_CALL_NOTHROW(Free(d_data));
     }
     
@@ -40,9 +42,12 @@ namespace rtc {
     void Buffer::resize(size_t numBytes)
     {
       SetActiveGPU forDuration(device);
-      if (d_data) 
+      if (d_data) {
+        device->memory.freed(d_data);
         BARNEY_CUDA_CALL(Free(d_data));
+      }
       BARNEY_CUDA_CALL(Malloc((void**)&d_data,numBytes));
+      device->memory.allocated(d_data,numBytes);
     }
     
   }
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "rtcore/cudaCommon/Device.h"
+#include <set>
 
 namespace rtc {
   namespace cuda {
@@ -16,12 +17,15 @@ namespace rtc {
     struct Geom;
     struct GeomType;
     struct Group;
+    struct GeomGroup;
     struct Denoiser;
 
     struct TraceKernel2D;
 
     using rtc::cuda_common::Texture;
     using rtc::cuda_common::TextureData;
+    using rtc::cuda_common::Graph;
+    using rtc::cuda_common::Event;
     
     using cuda_common::float2;
     using cuda_common::float3;
@@ -44,15 +48,21 @@ namespace rtc {
       
       void destroy();
 
+      /*! whether work issued to this device can be captured into a
+          graph (see cuda_common::Device::beginCapture()) */
+      bool canCaptureGraphs() const { return true; }
+
       void freeGeomType(GeomType *);
 
       void freeGeom(Geom *);
       
       Group *
-      createTrianglesGroup(const std::vector<Geom *> &geoms);
+      createTrianglesGroup(const std::vector<Geom *> &geoms,
+                           BuildQuality quality = BUILD_QUALITY_DEFAULT);
       
       Group *
-      createUserGeomsGroup(const std::vector<Geom *> &geoms);
+      createUserGeomsGroup(const std::vector<Geom *> &geoms,
+                           BuildQuality quality = BUILD_QUALITY_DEFAULT);
 
       Group *
       createInstanceGroup(const std::vector<Group *> &groups,
@@ -62,6 +72,14 @@ namespace rtc {
       void freeGroup(Group *);
       void buildPipeline();
       void buildSBT();
+      /*! re-uploads only the sbt records of geoms whose data changed */
+      void updateSBT();
+
+      /*! all live geom groups, for updateSBT() to go through */
+      std::set<GeomGroup *> geomGroups;
+      /*! whether some geom's setDD() changed its data since the last
+          updateSBT() */
+      bool sbtRecordsDirty = false;
       Buffer *createBuffer(size_t numBytes,
                            const void *initValues = 0);
       void freeBuffer(Buffer *);
@@ -75,6 +93,7 @@ namespace rtc {
       ~Denoiser() = default;
       void resize(vec2i dims) { outputDims = dims; }
       void run(float blendFactor) {}
+      void finish() {}
       Device* const device;
 
       vec4f *in_rgba = 0;
@@ -19,7 +19,11 @@ namespace rtc {
     
     void Geom::setDD(const void *dd)
     {
+      if (memcmp(data.data(),dd,data.size()) == 0)
+        return;
       memcpy(data.data(),dd,data.size());
+      ++version;
+      gt->device->sbtRecordsDirty = true;
     }
 
     TrianglesGeom::TrianglesGeom(GeomType *gt)
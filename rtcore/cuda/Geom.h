@@ -41,6 +41,9 @@ namespace rtc {
       
       GeomType *const gt;
       std::vector<uint8_t> data;
+      /*! bumped whenever setDD() changes data, so groups can tell
+          which of their SBT records are stale */
+      uint64_t version = 0;
     };
 
     struct TrianglesGeom : public Geom {
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "rtcore/cudaCommon/Device.h"
+#include "rtcore/cuda/QuantizedBVH.h"
 #include <cuBQL/bvh.h>
 
 namespace rtc {
@@ -12,6 +13,13 @@ namespace rtc {
     
     using cuBQL::bvh3f;
 
+    /*! node type of all (top and bottom level) bvhs of this backend */
+#if RTC_CUDA_BVH_WIDTH == 2
+    typedef cuBQL::bvh3f::Node BVHNode;
+#else
+    typedef QuantizedNode<RTC_CUDA_BVH_WIDTH> BVHNode;
+#endif
+
     struct Device;
     
     struct Group {
@@ -20,11 +28,15 @@ namespace rtc {
       virtual void buildAccel() = 0;
       virtual void refitAccel() { buildAccel(); }
       virtual void setTransforms(const std::vector<affine3f> &) {}
+      /*! sets the transforms of only the listed instances, and updates
+          the accel for them */
+      virtual void updateTransforms(const std::vector<int> &which,
+                                    const std::vector<affine3f> &newXfms) {}
       AccelHandle getDD() const { return (AccelHandle)d_accel; }
 
       Device *const device;
       void *d_accel = 0;
-      cuBQL::bvh3f::Node *bvhNodes = 0;
+      BVHNode *bvhNodes = 0;
     };
 
     struct GeomGroup : public Group {
@@ -34,7 +46,7 @@ namespace rtc {
         // 0..8b
         uint8_t *sbt;
         // 8..16b
-        cuBQL::bvh3f::Node *bvhNodes;
+        BVHNode *bvhNodes;
         // 16..24b
         Prim *prims;
         // 24..28b
@@ -49,11 +61,21 @@ namespace rtc {
       ~GeomGroup();
       const std::vector<Geom *> geoms;
 
+      /*! re-uploads the records of those geoms whose data changed
+          since the sbt got written */
+      void updateSBTRecords();
+      
       uint8_t *sbt          = 0;
       size_t   sbtEntrySize = 0;
+      /*! per geom, the Geom::version its record in sbt was written
+          from */
+      std::vector<uint64_t> sbtVersions;
       
       int    numPrims = 0;
       Prim  *prims    = 0;
+      /*! fast-trace builds with SAH, fast-build ones without; the
+          default is what each group type did before */
+      BuildQuality buildQuality = BUILD_QUALITY_DEFAULT;
     };
 
     struct InstanceGroup : public Group {
@@ -64,7 +86,9 @@ namespace rtc {
         uint32_t ID;
       };
       struct DeviceRecord {
-        cuBQL::bvh3f bvh;
+        BVHNode        *bvhNodes;
+        /*! maps top-level leaf slots to instance IDs */
+        uint32_t       *primIDs;
         InstanceRecord *instanceRecords;
       };
 
@@ -75,10 +99,17 @@ namespace rtc {
       ~InstanceGroup();
       void buildAccel() override;
       void setTransforms(const std::vector<affine3f> &newXfms) override;
+      /*! scatters the new transforms straight into the existing
+          device-side instance records, then rebuilds only the
+          (instance) bvh over them */
+      void updateTransforms(const std::vector<int> &which,
+                            const std::vector<affine3f> &newXfms) override;
+      /*! builds the bvh over the current d_instanceRecords */
+      void buildInstanceBVH();
 
       DeviceRecord   *d_deviceRecord = 0;
       InstanceRecord *d_instanceRecords = 0;
-      bvh3f bvh = { 0,0,0,0 };
+      uint32_t       *primIDs = 0;
       const std::vector<Group *>  groups;
       const std::vector<int>      instanceIDs;
       std::vector<affine3f> xfms;
@@ -103,12 +103,41 @@ namespace rtc {
       vec3f transformVectorFromWorldToObjectSpace(vec3f v) const;
       
       inline __device__
+      /*! traces given ray, calling the any-hit programs for all
+          candidate hits and the closest-hit program for the closest
+          accepted one; if terminateOnFirstHit is set, traversal
+          stops at the first accepted hit (which is what occlusion
+          rays need), and the closest-hit program gets called for
+          that one */
       void traceRay(rtc::AccelHandle world,
                     vec3f org,
                     vec3f dir,
                     float t0,
                     float t1,
-                    void *prdPtr);
+                    void *prdPtr,
+                    bool terminateOnFirstHit = false);
+
+      inline __device__
+      /*! occlusion query: calls the any-hit programs until the first
+          accepted hit, and skips the closest-hit program; returns
+          whether there was such a hit */
+      bool traceOcclusion(rtc::AccelHandle world,
+                          vec3f org,
+                          vec3f dir,
+                          float t0,
+                          float t1,
+                          void *prdPtr);
+
+      inline __device__
+      /*! the traversal part of traceRay(), which leaves the accepted
+          hit (if any) in 'accepted' and 'acceptedSBT' */
+      void traverse(rtc::AccelHandle world,
+                    vec3f org,
+                    vec3f dir,
+                    float t0,
+                    float t1,
+                    void *prdPtr,
+                    bool terminateOnFirstHit);
       
       inline __device__
       bool intersectTriangle(const vec3f v0,const vec3f v1,const vec3f v2, bool dbg=false);
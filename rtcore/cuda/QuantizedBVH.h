@@ -0,0 +1,309 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "rtcore/cudaCommon/Device.h"
+#include <string.h>
+
+/*! BVH width the software (cuBQL) backend traverses. Anything wider
+    than binary gets collapsed into W-wide nodes with quantized child
+    bounds; HIP builds stay binary since cuBQL's wide gpu builder is
+    not available there */
+#if defined(BARNEY_CUBQL_BVH_WIDTH) && (BARNEY_CUBQL_BVH_WIDTH > 2) && !BARNEY_HAVE_HIP
+# define RTC_CUDA_BVH_WIDTH BARNEY_CUBQL_BVH_WIDTH
+#else
+# define RTC_CUDA_BVH_WIDTH 2
+#endif
+
+namespace rtc {
+  namespace cuda {
+
+    /*! 2^e as a float, for e in [-126,127]; built from the bits so
+        host and device agree exactly */
+    inline __rtc_both float exp2i(int e)
+    {
+      uint32_t bits = uint32_t(e+127) << 23;
+      float f;
+      memcpy(&f,&bits,sizeof(f));
+      return f;
+    }
+
+    /*! a W-wide BVH node with its children's boxes stored as 8-bit
+        offsets on a per-node, per-axis power-of-two grid, after Ylitie
+        et al., "Efficient Incoherent Ray Traversal on GPUs Through
+        Compressed Wide BVHs" (HPG 2017). Valid children come first;
+        a child with count==0 is an inner node (child[] is its node
+        index), otherwise a leaf of count prims starting at child[]
+        (64 bytes for W=4) */
+    template<int W>
+    struct QuantizedNode {
+      enum { MIN_EXPONENT = -126, MAX_EXPONENT = 127 };
+
+      inline __rtc_both box3f childBounds(int i) const;
+      inline __rtc_both box3f bounds() const;
+
+      /*! encode given children; the quantized boxes always contain
+          the input ones */
+      inline __rtc_both void encode(const box3f   *boxes,
+                                    const uint32_t *offsets,
+                                    const uint32_t *counts,
+                                    int numValid);
+
+      vec3f    origin;
+      int8_t   exponent[3];
+      uint8_t  numChildren;
+      uint8_t  lower[3][W];
+      uint8_t  upper[3][W];
+      uint16_t count[W];
+      uint32_t child[W];
+    };
+
+    template<int W>
+    inline __rtc_both box3f QuantizedNode<W>::childBounds(int i) const
+    {
+      const vec3f scale(exp2i(exponent[0]),
+                        exp2i(exponent[1]),
+                        exp2i(exponent[2]));
+      box3f bb;
+      bb.lower = origin + scale * vec3f(lower[0][i],lower[1][i],lower[2][i]);
+      bb.upper = origin + scale * vec3f(upper[0][i],upper[1][i],upper[2][i]);
+      return bb;
+    }
+
+    template<int W>
+    inline __rtc_both box3f QuantizedNode<W>::bounds() const
+    {
+      box3f bb;
+      for (int i=0;i<numChildren;i++)
+        bb.extend(childBounds(i));
+      return bb;
+    }
+
+    template<int W>
+    inline __rtc_both void QuantizedNode<W>::encode(const box3f   *boxes,
+                                                    const uint32_t *offsets,
+                                                    const uint32_t *counts,
+                                                    int numValid)
+    {
+      box3f nodeBounds;
+      for (int i=0;i<numValid;i++)
+        nodeBounds.extend(boxes[i]);
+      if (numValid == 0)
+        nodeBounds = box3f(vec3f(0.f),vec3f(0.f));
+
+      origin = nodeBounds.lower;
+      numChildren = (uint8_t)numValid;
+      for (int a=0;a<3;a++) {
+        const float lo = (&nodeBounds.lower.x)[a];
+        const float hi = (&nodeBounds.upper.x)[a];
+        int e = MIN_EXPONENT;
+        if (hi > lo) {
+          frexpf((hi-lo)*(1.f/255.f),&e);
+          e = max((int)MIN_EXPONENT,min((int)MAX_EXPONENT,e));
+        }
+        /* the origin has been rounded to float, so make sure the
+           grid still reaches the top of the box */
+        while (e < (int)MAX_EXPONENT && lo + 255.f*exp2i(e) < hi) e++;
+        exponent[a] = (int8_t)e;
+
+        const float scale = exp2i(e);
+        const float rcpScale = 1.f/scale;
+        for (int i=0;i<W;i++) {
+          if (i >= numValid) {
+            lower[a][i] = upper[a][i] = 0;
+            continue;
+          }
+          const float blo = (&boxes[i].lower.x)[a];
+          const float bhi = (&boxes[i].upper.x)[a];
+          int qlo = max(0,min(255,(int)floorf((blo-lo)*rcpScale)));
+          int qhi = max(0,min(255,(int)ceilf ((bhi-lo)*rcpScale)));
+          while (qlo > 0   && lo + qlo*scale > blo) --qlo;
+          while (qhi < 255 && lo + qhi*scale < bhi) ++qhi;
+          lower[a][i] = (uint8_t)qlo;
+          upper[a][i] = (uint8_t)qhi;
+        }
+      }
+      for (int i=0;i<W;i++) {
+        child[i] = i < numValid ? offsets[i] : 0u;
+        count[i] = i < numValid ? (uint16_t)counts[i] : (uint16_t)0;
+      }
+    }
+
+    /*! per-level index of the child that the traversal is currently
+        descending into, for restarting the traversal from the root
+        without a full stack (Laine, "Restart Trail for Stackless BVH
+        Traversal", HPG 2010, generalized to sorted wide nodes as in
+        Vaidyanathan et al., HPG 2019) */
+    template<int W>
+    struct RestartTrail {
+      enum {
+        /* we need to store 0..W, inclusive */
+        BITS      = (W < 4) ? 2 : ((W < 8) ? 3 : 4),
+        PER_WORD  = 64/BITS,
+        NUM_WORDS = 2,
+        MAX_DEPTH = NUM_WORDS*PER_WORD
+      };
+
+      inline __device__ int get(int level) const
+      {
+        const int shift = BITS*(level%PER_WORD);
+        return int((word[level/PER_WORD] >> shift) & ((1ull<<BITS)-1));
+      }
+      inline __device__ void set(int level, int k)
+      {
+        const int shift = BITS*(level%PER_WORD);
+        uint64_t &w = word[level/PER_WORD];
+        w = (w & ~(((1ull<<BITS)-1) << shift)) | (uint64_t(k) << shift);
+      }
+      /*! reset given level and all deeper ones */
+      inline __device__ void clearFrom(int level)
+      {
+        for (int i=0;i<NUM_WORDS;i++) {
+          const int begin = i*PER_WORD;
+          if (level <= begin)
+            word[i] = 0;
+          else if (level < begin+PER_WORD)
+            word[i] &= (1ull << (BITS*(level-begin))) - 1;
+        }
+      }
+
+      uint64_t word[NUM_WORDS] = { 0, 0 };
+    };
+
+    /*! ordered traversal of a quantized W-wide bvh: children are
+        visited front to back, and leaves get handed to
+        leaf(offset,count) (which returns true to terminate the
+        traversal) as soon as they come up.
+
+        Rather than a full per-thread stack this uses a short ring
+        buffer of nodes that still have children left, plus a restart
+        trail: if that buffer had to drop entries, the traversal
+        restarts from the root and follows the trail down to where it
+        left off. Since children are sorted by entry distance, and a
+        shrinking tMax only ever culls a suffix of that order, a
+        node's first k hit children are the same every time it gets
+        visited. Subtrees deeper than the trail can record get
+        skipped */
+    template<int W, typename LeafLambda>
+    inline __device__
+    void traverseQuantized(const QuantizedNode<W> *nodes,
+                           const vec3f org,
+                           const vec3f rcpDir,
+                           const float tMin,
+                           const float &tMax,
+                           const LeafLambda &leaf)
+    {
+      struct StackEntry {
+        uint32_t node;
+        uint32_t level;
+      };
+      enum {
+        SHORT_STACK = 4,
+        MAX_DEPTH   = RestartTrail<W>::MAX_DEPTH
+      };
+      StackEntry stack[SHORT_STACK];
+      int  stackTop  = 0;
+      int  stackSize = 0;
+      /* false once the short stack has dropped an entry */
+      bool stackComplete = true;
+      RestartTrail<W> trail;
+
+      if (!nodes) return;
+      uint32_t nodeID = 0;
+      int      level  = 0;
+      while (true) {
+        const QuantizedNode<W> &node = nodes[nodeID];
+        const vec3f scale(exp2i(node.exponent[0]),
+                          exp2i(node.exponent[1]),
+                          exp2i(node.exponent[2]));
+        const vec3f nodeOrg = (node.origin - org) * rcpDir;
+        const vec3f nodeScale = scale * rcpDir;
+
+        // ------------------------------------------------------------------
+        // test all children, and insertion-sort the hit ones by distance
+        // ------------------------------------------------------------------
+        float    hitT[W];
+        uint32_t hitChild[W];
+        uint16_t hitCount[W];
+        int numHits = 0;
+        for (int i=0;i<node.numChildren;i++) {
+          const vec3f lo
+            = nodeOrg + nodeScale * vec3f(node.lower[0][i],
+                                          node.lower[1][i],
+                                          node.lower[2][i]);
+          const vec3f hi
+            = nodeOrg + nodeScale * vec3f(node.upper[0][i],
+                                          node.upper[1][i],
+                                          node.upper[2][i]);
+          const float t0 = max(tMin,reduce_max(min(lo,hi)));
+          const float t1 = min(tMax,reduce_min(max(lo,hi)));
+          if (t0 > t1) continue;
+          int j = numHits++;
+          for (;j > 0 && hitT[j-1] > t0;--j) {
+            hitT[j]     = hitT[j-1];
+            hitChild[j] = hitChild[j-1];
+            hitCount[j] = hitCount[j-1];
+          }
+          hitT[j]     = t0;
+          hitChild[j] = node.child[i];
+          hitCount[j] = node.count[i];
+        }
+
+        // ------------------------------------------------------------------
+        // go on from where the trail says this node left off: leaves
+        // get intersected right away, the first inner node gets
+        // descended into
+        // ------------------------------------------------------------------
+        bool descended = false;
+        for (int i=trail.get(level);i<numHits;i++) {
+          if (hitT[i] > tMax) break;
+          if (hitCount[i] != 0) {
+            if (leaf(hitChild[i],(int)hitCount[i])) return;
+            continue;
+          }
+          if (level+1 >= (int)MAX_DEPTH) continue;
+          trail.set(level,i);
+          if (i+1 < numHits) {
+            stack[stackTop] = { nodeID, (uint32_t)level };
+            stackTop = (stackTop+1) % SHORT_STACK;
+            if (stackSize < SHORT_STACK)
+              ++stackSize;
+            else
+              stackComplete = false;
+          }
+          nodeID = hitChild[i];
+          ++level;
+          descended = true;
+          break;
+        }
+        if (descended) continue;
+
+        // ------------------------------------------------------------------
+        // this node is done; go back up to the deepest node that
+        // still has children left, from the short stack if we can,
+        // or else by restarting from the root
+        // ------------------------------------------------------------------
+        if (level == 0) return;
+        if (stackSize > 0) {
+          stackTop = (stackTop+SHORT_STACK-1) % SHORT_STACK;
+          --stackSize;
+          const StackEntry entry = stack[stackTop];
+          trail.clearFrom(entry.level+1);
+          trail.set(entry.level,trail.get(entry.level)+1);
+          nodeID = entry.node;
+          level  = entry.level;
+          continue;
+        }
+        if (stackComplete) return;
+        trail.clearFrom(level);
+        trail.set(level-1,trail.get(level-1)+1);
+        nodeID = 0;
+        level  = 0;
+        stackComplete = true;
+      }
+    }
+
+  }
+}
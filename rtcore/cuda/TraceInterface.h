@@ -23,11 +23,16 @@ namespace rtc {
 
     inline __device__ float fabsf(float f) { return f < 0.f ? -f : f; }
     inline __device__ float mmax(float a, float b) { return a>b ? a:b; }
-// #if BARNEY_CUBQL_BVH_WIDTH == 2
     using bvh_t = cuBQL::bvh3f;
-// #else
-//     using bvh_t = cuBQL::WideBVH<float,3,BARNEY_CUBQL_BVH_WIDTH>;
-// #endif
+
+    /*! reciprocal that stays finite for (near-)zero components */
+    inline __device__ vec3f safeRcp(vec3f v)
+    {
+      if (fabsf(v.x) < 1e-6f) v.x = copysignf(1e-6f,v.x);
+      if (fabsf(v.y) < 1e-6f) v.y = copysignf(1e-6f,v.y);
+      if (fabsf(v.z) < 1e-6f) v.z = copysignf(1e-6f,v.z);
+      return rcp(v);
+    }
 
         inline __device__
     bool TraceInterface::intersectTriangle(const vec3f v0,
@@ -105,7 +110,43 @@ namespace rtc {
                                   vec3f dir,
                                   float t0,
                                   float t1,
-                                  void *prdPtr)
+                                  void *prdPtr,
+                                  bool terminateOnFirstHit)
+    {
+      traverse(_world,org,dir,t0,t1,prdPtr,terminateOnFirstHit);
+      if (acceptedSBT && acceptedSBT->ch) {
+        InstanceGroup::DeviceRecord *model
+          = (InstanceGroup::DeviceRecord *)_world;
+        current = accepted;
+        this->geomData = (acceptedSBT+1);
+        // Restore currentInstance for closestHit transform calls:
+        // leaveBlas() zeroed it, but closestHit needs it for
+        // object-to-world space transforms.
+        this->currentInstance = model->instanceRecords + accepted.instID;
+        acceptedSBT->ch(*this);
+      }
+    }
+
+    inline __device__
+    bool TraceInterface::traceOcclusion(rtc::AccelHandle _world,
+                                        vec3f org,
+                                        vec3f dir,
+                                        float t0,
+                                        float t1,
+                                        void *prdPtr)
+    {
+      traverse(_world,org,dir,t0,t1,prdPtr,true);
+      return acceptedSBT != 0;
+    }
+
+    inline __device__
+    void TraceInterface::traverse(rtc::AccelHandle _world,
+                                  vec3f org,
+                                  vec3f dir,
+                                  float t0,
+                                  float t1,
+                                  void *prdPtr,
+                                  bool terminateOnFirstHit)
     {
       bool dbg = false;
       
@@ -207,13 +248,14 @@ namespace rtc {
           accepted.instID = current.instID;
           accepted.triangleBarycentrics = current.triangleBarycentrics;
           acceptedSBT = header;
+          if (terminateOnFirstHit)
+            // shrink the query interval to nothing, so the traversal
+            // doesn't visit anything else
+            return -INFINITY;
         }
         return accepted.tMax;
       };
-      auto enterBlas = [&,this,model]
-        (cuBQL::ray3f &out_ray,
-         cuBQL::bvh3f &out_bvh,
-         int instID) 
+      auto enterInstance = [&,this,model](int instID)
       {
         this->current.instID  = instID;
         this->currentInstance = model->instanceRecords+current.instID;
@@ -221,6 +263,17 @@ namespace rtc {
           = xfmPoint(currentInstance->worldToObjectXfm,world.org);
         this->object.dir
           = xfmVector(currentInstance->worldToObjectXfm,world.dir);
+      };
+      auto leaveBlas = [this]() -> void {
+        currentInstance = 0;
+      };
+#if RTC_CUDA_BVH_WIDTH == 2
+      auto enterBlas = [&,this]
+        (cuBQL::ray3f &out_ray,
+         cuBQL::bvh3f &out_bvh,
+         int instID) 
+      {
+        enterInstance(instID);
         if (0 && dbg) {
           printf("xfm world %f %f %f : %f %f %f\n",
                  world.org.x,
@@ -242,22 +295,44 @@ namespace rtc {
         out_bvh = {0,0,0,0};
         out_bvh.nodes = currentInstance->group.bvhNodes;
       };
-      auto leaveBlas = [this]() -> void {
-        currentInstance = 0;
-      };
 
+      cuBQL::bvh3f tlas = {0,0,0,0};
+      tlas.nodes   = model->bvhNodes;
+      tlas.primIDs = model->primIDs;
       ::cuBQL::shrinkingRayQuery::twoLevel::forEachPrim
-          (enterBlas,leaveBlas,intersectPrim,model->bvh,ray);
-
-      if (acceptedSBT && acceptedSBT->ch) {
-        current = accepted;
-        this->geomData = (acceptedSBT+1);
-        // Restore currentInstance for closestHit transform calls:
-        // leaveBlas() zeroed it, but closestHit needs it for
-        // object-to-world space transforms.
-        this->currentInstance = model->instanceRecords + accepted.instID;
-        acceptedSBT->ch(*this);
-      }
+          (enterBlas,leaveBlas,intersectPrim,tlas,ray);
+#else
+      // ------------------------------------------------------------------
+      // quantized wide bvhs: ordered traversal of the instance bvh,
+      // and of each instance's bvh in its own object space
+      // ------------------------------------------------------------------
+      bool terminated = false;
+      auto blasLeaf = [&](uint32_t offset, int count) -> bool
+      {
+        for (int i=0;i<count;i++) {
+          ray.tMax = accepted.tMax;
+          if (intersectPrim(offset+i) == -INFINITY)
+            return terminated = true;
+        }
+        return false;
+      };
+      auto tlasLeaf = [&,this,model](uint32_t offset, int count) -> bool
+      {
+        for (int i=0;i<count && !terminated;i++) {
+          enterInstance(model->primIDs[offset+i]);
+          (vec3f&)ray.origin    = object.org;
+          (vec3f&)ray.direction = object.dir;
+          traverseQuantized(currentInstance->group.bvhNodes,
+                            object.org,safeRcp(object.dir),
+                            tMin,accepted.tMax,blasLeaf);
+          leaveBlas();
+        }
+        return terminated;
+      };
+      traverseQuantized(model->bvhNodes,
+                        world.org,safeRcp(world.dir),
+                        tMin,accepted.tMax,tlasLeaf);
+#endif
     }
 // #else
 //     inline __device__
@@ -505,9 +580,18 @@ namespace rtc {
   }
 }
 
+/*! trace kernels get launched in 16x16 blocks; asking for a few of
+    those to be resident per SM keeps the compiler from trading
+    occupancy for registers in the (software) traversal loop */
+#define RTC_CUDA_TRACE_BLOCK_SIZE 256
+#ifndef RTC_CUDA_TRACE_MIN_BLOCKS
+# define RTC_CUDA_TRACE_MIN_BLOCKS 4
+#endif
+
 #if RTC_DEVICE_CODE
 # define RTC_CUDA_TRACEKERNEL(name,Class)                       \
-  __global__                                                    \
+  __global__ __launch_bounds__(RTC_CUDA_TRACE_BLOCK_SIZE,       \
+                               RTC_CUDA_TRACE_MIN_BLOCKS)       \
   void rtc_cuda_run_##name(::rtc::cuda::TraceInterface ti)      \
   {                                                             \
     Class::run(ti);                                             \
@@ -536,3 +620,7 @@ namespace rtc {
   
 
 
+
+/*! only the embree backend traces batched kernels in packets */
+#define RTC_EXPORT_BATCHED_TRACE2D(name,Class)                  \
+  RTC_EXPORT_TRACE2D(name,Class)
@@ -30,6 +30,10 @@ namespace rtc {
                                const void *kernelData)
     {
       SetActiveGPU forDuration(device);
+      if (device->capturing)
+        /* the captured copy reads from kernelData when the graph
+           gets launched, which will be long after we returned */
+        kernelData = device->keepForCapture(kernelData,sizeOfLP);
       BARNEY_CUDA_CALL(MemcpyAsync(d_lpData,kernelData,
                                    sizeOfLP,cudaMemcpyDefault,device->stream));
       // device->sync();
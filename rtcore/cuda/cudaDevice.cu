@@ -44,15 +44,21 @@ namespace rtc {
     }
       
     Group *
-    Device::createTrianglesGroup(const std::vector<Geom *> &geoms)
+    Device::createTrianglesGroup(const std::vector<Geom *> &geoms,
+                                 BuildQuality quality)
     {
-      return new TrianglesGeomGroup(this,geoms);
+      GeomGroup *gg = new TrianglesGeomGroup(this,geoms);
+      gg->buildQuality = quality;
+      return gg;
     }
       
     Group *
-    Device::createUserGeomsGroup(const std::vector<Geom *> &geoms)
+    Device::createUserGeomsGroup(const std::vector<Geom *> &geoms,
+                                 BuildQuality quality)
     {
-      return new UserGeomGroup(this,geoms);
+      GeomGroup *gg = new UserGeomGroup(this,geoms);
+      gg->buildQuality = quality;
+      return gg;
     }
     
     Group *
@@ -69,6 +75,19 @@ namespace rtc {
     
     void Device::buildSBT()
     {
+      /* there's no global sbt, the groups write their own when they
+         get built; all that's left to do is to catch up with geoms
+         whose data changed since */
+      updateSBT();
+    }
+    
+    void Device::updateSBT()
+    {
+      if (!sbtRecordsDirty)
+        return;
+      for (auto gg : geomGroups)
+        gg->updateSBTRecords();
+      sbtRecordsDirty = false;
     }
 
   }    
@@ -45,9 +45,8 @@ namespace rtc {
     InstanceGroup::~InstanceGroup()
     {
       SetActiveGPU forDuration(device);
-      cuBQL::DeviceMemoryResource memResource;
-      if (bvh.nodes)
-        cuBQL::cuda::free(bvh,device->stream,memResource);
+      if (primIDs)
+        BARNEY_CUDA_CALL_NOTHROW(Free(primIDs));
       if (d_instanceRecords)
         BARNEY_CUDA_CALL_NOTHROW(Free(d_instanceRecords));
       if (d_deviceRecord)
@@ -58,10 +57,13 @@ namespace rtc {
                          const std::vector<Geom *> &geoms)
       : Group(device),
         geoms(geoms)
-    {}
+    {
+      device->geomGroups.insert(this);
+    }
 
     GeomGroup::~GeomGroup()
     {
+      device->geomGroups.erase(this);
       SetActiveGPU forDuration(device);
       if (sbt)
         BARNEY_CUDA_CALL_NOTHROW(Free(sbt));
@@ -70,6 +72,24 @@ namespace rtc {
       // bvhNodes is freed by ~Group()
     }
 
+    void GeomGroup::updateSBTRecords()
+    {
+      if (!sbt || sbtVersions.size() != geoms.size())
+        return;
+      SetActiveGPU forDuration(device);
+      for (int i=0;i<(int)geoms.size();i++) {
+        Geom *geom = geoms[i];
+        if (geom->version == sbtVersions[i])
+          continue;
+        /* only the geom's data is in there; the header stays valid */
+        BARNEY_CUDA_CALL(MemcpyAsync(sbt+i*sbtEntrySize+sizeof(Geom::SBTHeader),
+                                     geom->data.data(),geom->data.size(),
+                                     cudaMemcpyDefault,device->stream));
+        sbtVersions[i] = geom->version;
+      }
+      device->sync();
+    }
+
     TrianglesGeomGroup::TrianglesGeomGroup(Device *device,
                                            const std::vector<Geom *> &geoms)
       : GeomGroup(device, geoms)
@@ -132,10 +152,128 @@ namespace rtc {
 
       box3f bounds;
       InstanceGroup::InstanceRecord inst = instances[tid];
+#if RTC_CUDA_BVH_WIDTH == 2
       bounds = (const box3f&)inst.group.bvhNodes[0].bounds;
+#else
+      bounds = inst.group.bvhNodes[0].bounds();
+#endif
       instBounds[tid] = xfmBounds(inst.objectToWorldXfm,bounds);
     }
 
+    __global__
+    void scatterInstanceTransforms(InstanceGroup::InstanceRecord *instances,
+                                   const int      *which,
+                                   const affine3f *xfms,
+                                   int             count)
+    {
+      int tid = threadIdx.x+blockIdx.x*blockDim.x;
+      if (tid >= count) return;
+
+      InstanceGroup::InstanceRecord &inst = instances[which[tid]];
+      inst.objectToWorldXfm = xfms[tid];
+      inst.worldToObjectXfm = rcp(xfms[tid]);
+    }
+
+#if RTC_CUDA_BVH_WIDTH > 2
+    typedef typename cuBQL::WideBVH<float,3,RTC_CUDA_BVH_WIDTH>::Node WideNode;
+
+    __global__
+    void quantizeNodes(BVHNode *out,
+                       const WideNode *in,
+                       int numNodes)
+    {
+      int tid = threadIdx.x+blockIdx.x*blockDim.x;
+      if (tid >= numNodes) return;
+
+      enum { W = RTC_CUDA_BVH_WIDTH };
+      box3f    boxes[W];
+      uint32_t offsets[W];
+      uint32_t counts[W];
+      int numValid = 0;
+      for (int i=0;i<W;i++) {
+        const auto &child = in[tid].children[i];
+        if (!child.valid) continue;
+        boxes[numValid]   = (const box3f&)child.bounds;
+        offsets[numValid] = (uint32_t)child.offset;
+        counts[numValid]  = (uint32_t)child.count;
+        ++numValid;
+      }
+      out[tid].encode(boxes,offsets,counts,numValid);
+    }
+#endif
+
+    /*! builds a bvh over the given (device) boxes, and returns its
+        nodes and the order in which its leaves reference the boxes;
+        both get allocated with cudaMalloc, and are owned by the
+        caller. Wider-than-binary builds get collapsed by cuBQL, and
+        then quantized */
+    void buildBVH(Device *device,
+                  const box3f *d_boxes,
+                  int numBoxes,
+                  cuBQL::BuildConfig buildConfig,
+                  BVHNode *&nodes,
+                  uint32_t *&primIDs)
+    {
+      cuBQL::DeviceMemoryResource memResource;
+#if FORCE_HOST_BUILDER
+# if RTC_CUDA_BVH_WIDTH != 2
+#  error "FORCE_HOST_BUILDER only supports binary BVHs"
+# endif
+      cuBQL::bvh3f bvh;
+      BARNEY_CUDA_SYNC_CHECK();
+      std::vector<cuBQL::box3f> h_boxes(numBoxes);
+      BARNEY_CUDA_CALL(Memcpy(h_boxes.data(),
+                              d_boxes,
+                              numBoxes*sizeof(*d_boxes),
+                              cudaMemcpyDefault));
+      BARNEY_CUDA_SYNC_CHECK();
+      cuBQL::cpuBuilder(bvh,
+                        (const cuBQL::box_t<float,3>*)h_boxes.data(),
+                        numBoxes,
+                        buildConfig);
+      BARNEY_CUDA_CALL(Malloc((void **)&nodes,
+                              bvh.numNodes*sizeof(*nodes)));
+      BARNEY_CUDA_CALL(Memcpy(nodes,bvh.nodes,
+                              bvh.numNodes*sizeof(*nodes),
+                              cudaMemcpyDefault));
+      BARNEY_CUDA_CALL(Malloc((void **)&primIDs,
+                              numBoxes*sizeof(*primIDs)));
+      BARNEY_CUDA_CALL(Memcpy(primIDs,bvh.primIDs,
+                              numBoxes*sizeof(*primIDs),
+                              cudaMemcpyDefault));
+      BARNEY_CUDA_SYNC_CHECK();
+      delete[] bvh.nodes;
+      delete[] bvh.primIDs;
+#elif RTC_CUDA_BVH_WIDTH == 2
+      cuBQL::bvh3f bvh;
+      cuBQL::gpuBuilder(bvh,
+                        (const cuBQL::box_t<float,3>*)d_boxes,
+                        numBoxes,
+                        buildConfig,
+                        device->stream,
+                        memResource);
+      device->sync();
+      nodes   = bvh.nodes;
+      primIDs = bvh.primIDs;
+#else
+      cuBQL::WideBVH<float,3,RTC_CUDA_BVH_WIDTH> bvh;
+      cuBQL::gpuBuilder(bvh,
+                        (const cuBQL::box_t<float,3>*)d_boxes,
+                        numBoxes,
+                        buildConfig,
+                        device->stream,
+                        memResource);
+      device->sync();
+      int numNodes = bvh.numNodes;
+      BARNEY_CUDA_CALL(Malloc((void **)&nodes,numNodes*sizeof(*nodes)));
+      quantizeNodes<<<divRoundUp(numNodes,128),128,0,device->stream>>>
+        (nodes,bvh.nodes,numNodes);
+      device->sync();
+      BARNEY_CUDA_CALL(Free(bvh.nodes));
+      primIDs = bvh.primIDs;
+#endif
+    }
+
     void InstanceGroup::setTransforms(const std::vector<affine3f> &newXfms)
     {
       xfms = newXfms;
@@ -172,6 +310,44 @@ namespace rtc {
       }
       h_instances.clear();
       device->sync();
+
+      buildInstanceBVH();
+    }
+
+    void InstanceGroup::updateTransforms(const std::vector<int> &which,
+                                         const std::vector<affine3f> &newXfms)
+    {
+      assert(which.size() == newXfms.size());
+      for (size_t i=0;i<which.size();i++)
+        xfms[which[i]] = newXfms[i];
+      if (!d_instanceRecords)
+        return buildAccel();
+      if (which.empty())
+        return;
+      
+      SetActiveGPU forDuration(device);
+      int count = (int)which.size();
+      int      *d_which = 0;
+      affine3f *d_xfms  = 0;
+      BARNEY_CUDA_CALL(Malloc((void **)&d_which,count*sizeof(int)));
+      BARNEY_CUDA_CALL(Malloc((void **)&d_xfms,count*sizeof(affine3f)));
+      BARNEY_CUDA_CALL(Memcpy(d_which,which.data(),count*sizeof(int),
+                              cudaMemcpyDefault));
+      BARNEY_CUDA_CALL(Memcpy(d_xfms,newXfms.data(),count*sizeof(affine3f),
+                              cudaMemcpyDefault));
+      scatterInstanceTransforms<<<divRoundUp(count,128),128,0,device->stream>>>
+        (d_instanceRecords,d_which,d_xfms,count);
+      device->sync();
+      BARNEY_CUDA_CALL(Free(d_which));
+      BARNEY_CUDA_CALL(Free(d_xfms));
+
+      buildInstanceBVH();
+    }
+
+    void InstanceGroup::buildInstanceBVH()
+    {
+      SetActiveGPU forDuration(device);
+      int numInstances = groups.size();
       
       // ------------------------------------------------------------------
       // compute bounds for bvh constuction
@@ -188,54 +364,17 @@ namespace rtc {
       // ------------------------------------------------------------------
       // build the bvh
       // ------------------------------------------------------------------
-      cuBQL::DeviceMemoryResource memResource;
-      if (bvh.nodes) {
-        cuBQL::cuda::free(bvh,device->stream,memResource);
-        bvh.nodes = 0;
-        bvh.primIDs = 0;
+      if (bvhNodes) {
+        BARNEY_CUDA_CALL(Free(bvhNodes));
+        bvhNodes = 0;
+      }
+      if (primIDs) {
+        BARNEY_CUDA_CALL(Free(primIDs));
+        primIDs = 0;
       }
       cuBQL::BuildConfig buildConfig;
       buildConfig.maxAllowedLeafSize = 1;
-#if FORCE_HOST_BUILDER
-      BARNEY_CUDA_SYNC_CHECK();
-      int numPrims = numInstances;
-      std::vector<cuBQL::box3f> h_boxes(numPrims);
-      BARNEY_CUDA_CALL(Memcpy(h_boxes.data(),
-                              instBounds,
-                              numPrims*sizeof(*instBounds),
-                              cudaMemcpyDefault));
-      BARNEY_CUDA_SYNC_CHECK();
-      cuBQL::cpuBuilder(bvh,
-                        (const cuBQL::box_t<float,3>*)h_boxes.data(),
-                        numPrims,
-                        buildConfig);
-      typedef typename cuBQL::BinaryBVH<float,3>::node_t node3f;
-      node3f *d_nodes;
-      BARNEY_CUDA_CALL(Malloc((void **)&d_nodes,
-                              bvh.numNodes*sizeof(*d_nodes)));
-      BARNEY_CUDA_CALL(Memcpy(d_nodes,bvh.nodes,
-                              bvh.numNodes*sizeof(*d_nodes),
-                              cudaMemcpyDefault));
-      BARNEY_CUDA_SYNC_CHECK();
-      uint32_t *d_primIDs;
-      BARNEY_CUDA_CALL(Malloc((void **)&d_primIDs,
-                              numPrims*sizeof(*d_primIDs)));
-      BARNEY_CUDA_CALL(Memcpy(d_primIDs,bvh.primIDs,
-                              numPrims*sizeof(*d_primIDs),
-                              cudaMemcpyDefault));
-      BARNEY_CUDA_SYNC_CHECK();
-
-      delete[] bvh.nodes; bvh.nodes = d_nodes;
-      delete[] bvh.primIDs; bvh.primIDs = d_primIDs;
-      
-#else
-      cuBQL::gpuBuilder(bvh,
-                        (const cuBQL::box_t<float,3>*)instBounds,
-                        numInstances,
-                        buildConfig,
-                        device->stream,
-                        memResource);
-#endif
+      buildBVH(device,instBounds,numInstances,buildConfig,bvhNodes,primIDs);
       device->sync();
       BARNEY_CUDA_CALL(Free(instBounds));
       
@@ -243,8 +382,8 @@ namespace rtc {
       // allocate device descriptor
       // ------------------------------------------------------------------
       DeviceRecord dd;
-      dd.bvh.nodes = bvh.nodes;
-      dd.bvh.primIDs = bvh.primIDs;
+      dd.bvhNodes = bvhNodes;
+      dd.primIDs = primIDs;
       dd.instanceRecords = d_instanceRecords;
 
       if (!d_deviceRecord)
@@ -297,6 +436,9 @@ namespace rtc {
       if (sbt) BARNEY_CUDA_CALL(Free(sbt));
       BARNEY_CUDA_CALL(Malloc((void**)&sbt,hostSBT.size()));
       BARNEY_CUDA_CALL(Memcpy(sbt,hostSBT.data(),hostSBT.size(),cudaMemcpyDefault));
+      sbtVersions.resize(geoms.size());
+      for (int i=0;i<geoms.size();i++)
+        sbtVersions[i] = geoms[i]->version;
       
       // ------------------------------------------------------------------
       // count prims and alloc geom/prim descriptors
@@ -348,68 +490,29 @@ namespace rtc {
         BARNEY_CUDA_CALL(Free(this->bvhNodes));
         this->bvhNodes = 0;
       }
-      cuBQL::bvh3f bvh;
+      uint32_t *primIDs = 0;
       cuBQL::BuildConfig buildConfig;
-#if FORCE_HOST_BUILDER
-      BARNEY_CUDA_SYNC_CHECK();
-      std::vector<cuBQL::box3f> h_boxes(numPrims);
-      BARNEY_CUDA_CALL(Memcpy(h_boxes.data(),
-                              primBounds,
-                              numPrims*sizeof(*primBounds),
-                              cudaMemcpyDefault));
-      BARNEY_CUDA_SYNC_CHECK();
-      cuBQL::cpuBuilder(bvh,
-                        (const cuBQL::box_t<float,3>*)h_boxes.data(),
-                        numPrims,
-                        buildConfig);
-      typedef typename cuBQL::BinaryBVH<float,3>::node_t node3f;
-      node3f *d_nodes;
-      BARNEY_CUDA_CALL(Malloc((void **)&d_nodes,
-                              bvh.numNodes*sizeof(*d_nodes)));
-      BARNEY_CUDA_CALL(Memcpy(d_nodes,bvh.nodes,
-                              bvh.numNodes*sizeof(*d_nodes),
-                              cudaMemcpyDefault));
-      uint32_t *d_primIDs;
-      BARNEY_CUDA_CALL(Malloc((void **)&d_primIDs,
-                              numPrims*sizeof(*d_primIDs)));
-      BARNEY_CUDA_CALL(Memcpy(d_primIDs,bvh.primIDs,
-                              numPrims*sizeof(*d_primIDs),
-                              cudaMemcpyDefault));
-      BARNEY_CUDA_SYNC_CHECK();
-      delete[] bvh.nodes; bvh.nodes = d_nodes;
-      delete[] bvh.primIDs; bvh.primIDs = d_primIDs;
-#else
       buildConfig.maxAllowedLeafSize = 4;
-      cuBQL::DeviceMemoryResource memResource;
-
-      BARNEY_CUDA_SYNC_CHECK();
-      
-      cuBQL::gpuBuilder(bvh,
-                        (const cuBQL::box_t<float,3>*)primBounds,
-                        numPrims,
-                        buildConfig,
-                        device->stream,
-                        memResource);
-      device->sync();
-#endif
+      if (buildQuality == BUILD_QUALITY_FAST_TRACE)
+        buildConfig.enableSAH();
+      buildBVH(device,primBounds,numPrims,buildConfig,
+               this->bvhNodes,primIDs);
       BARNEY_CUDA_CALL(Free(primBounds));
       
       // ------------------------------------------------------------------
       // reorder prims, store bvh, and release what we no longer need
       // ------------------------------------------------------------------
-      this->bvhNodes = bvh.nodes;
       GeomGroup::Prim *reorderedPrims = 0;
       BARNEY_CUDA_CALL(Malloc((void**)&reorderedPrims,numPrims*sizeof(GeomGroup::Prim)));
       reorderPrims
         <<<divRoundUp(numPrims,128),128,0,device->stream>>>
-        (reorderedPrims,prims,bvh.primIDs,numPrims);
+        (reorderedPrims,prims,primIDs,numPrims);
       
       device->sync();
       BARNEY_CUDA_CALL(Free(prims));
       this->prims = reorderedPrims;
 
-      BARNEY_CUDA_CALL(Free(bvh.primIDs));
-      bvh.primIDs = 0;
+      BARNEY_CUDA_CALL(Free(primIDs));
     }
     
 
@@ -451,6 +554,9 @@ namespace rtc {
       if (sbt) BARNEY_CUDA_CALL(Free(sbt));
       BARNEY_CUDA_CALL(Malloc((void**)&sbt,hostSBT.size()));
       BARNEY_CUDA_CALL(Memcpy(sbt,hostSBT.data(),hostSBT.size(),cudaMemcpyDefault));
+      sbtVersions.resize(geoms.size());
+      for (int i=0;i<geoms.size();i++)
+        sbtVersions[i] = geoms[i]->version;
       
       // ------------------------------------------------------------------
       // count prims and alloc geom/prim descriptors
@@ -497,68 +603,30 @@ namespace rtc {
         BARNEY_CUDA_CALL(Free(this->bvhNodes));
         this->bvhNodes = 0;
       }
-      cuBQL::bvh3f bvh;
-      cuBQL::DeviceMemoryResource memResource;
+      uint32_t *primIDs = 0;
       cuBQL::BuildConfig buildConfig;
       buildConfig.maxAllowedLeafSize = 4;
-      buildConfig.enableSAH();
+      if (buildQuality != BUILD_QUALITY_FAST_BUILD)
+        buildConfig.enableSAH();
       // buildConfig.makeLeafThreshold = 4;
-#if FORCE_HOST_BUILDER
-      BARNEY_CUDA_SYNC_CHECK();
-      std::vector<cuBQL::box3f> h_boxes(numPrims);
-      BARNEY_CUDA_CALL(Memcpy(h_boxes.data(),
-                              primBounds,
-                              numPrims*sizeof(*primBounds),
-                              cudaMemcpyDefault));
-      BARNEY_CUDA_SYNC_CHECK();
-      cuBQL::cpuBuilder(bvh,
-                        (const cuBQL::box_t<float,3>*)h_boxes.data(),
-                        numPrims,
-                        buildConfig);
-      typedef typename cuBQL::BinaryBVH<float,3>::node_t node3f;
-      node3f *d_nodes;
-      BARNEY_CUDA_CALL(Malloc((void **)&d_nodes,
-                              bvh.numNodes*sizeof(*d_nodes)));
-      BARNEY_CUDA_CALL(Memcpy(d_nodes,bvh.nodes,
-                              bvh.numNodes*sizeof(*d_nodes),
-                              cudaMemcpyDefault));
-      uint32_t *d_primIDs;
-      BARNEY_CUDA_CALL(Malloc((void **)&d_primIDs,
-                              numPrims*sizeof(*d_primIDs)));
-      BARNEY_CUDA_CALL(Memcpy(d_primIDs,bvh.primIDs,
-                              numPrims*sizeof(*d_primIDs),
-                              cudaMemcpyDefault));
-
-      delete[] bvh.nodes; bvh.nodes = d_nodes;
-      delete[] bvh.primIDs; bvh.primIDs = d_primIDs;
-      
-#else
-      cuBQL::gpuBuilder(bvh,
-                        (const cuBQL::box_t<float,3>*)primBounds,
-                        numPrims,
-                        buildConfig,
-                        device->stream,
-                        memResource);
-      device->sync();
-#endif
+      buildBVH(device,primBounds,numPrims,buildConfig,
+               this->bvhNodes,primIDs);
       BARNEY_CUDA_CALL(Free(primBounds));
       
       // ------------------------------------------------------------------
       // reorder prims, store bvh, and release what we no longer need
       // ------------------------------------------------------------------
-      this->bvhNodes = bvh.nodes;
       GeomGroup::Prim *reorderedPrims = 0;
       BARNEY_CUDA_CALL(Malloc((void**)&reorderedPrims,numPrims*sizeof(GeomGroup::Prim)));
       reorderPrims
         <<<divRoundUp(numPrims,1024),1024,0,device->stream>>>
-        (reorderedPrims,prims,bvh.primIDs,numPrims);
+        (reorderedPrims,prims,primIDs,numPrims);
       
       device->sync();
       BARNEY_CUDA_CALL(Free(prims));
       this->prims = reorderedPrims;
-      bvh.primIDs = 0;
 
-      BARNEY_CUDA_CALL(Free(bvh.primIDs));
+      BARNEY_CUDA_CALL(Free(primIDs));
     }
     
     UserGeomGroup::UserGeomGroup(Device *device,
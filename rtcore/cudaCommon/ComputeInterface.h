@@ -11,6 +11,11 @@
 #pragma once
 
 #include "rtcore/cudaCommon/cuda-common.h"
+#if defined(__HIPCC__)
+#  include <hip/hip_fp16.h>
+#elif defined(__CUDACC__)
+#  include <cuda_fp16.h>
+#endif
 
 namespace rtc {
   namespace cuda_common {
@@ -33,6 +38,11 @@ namespace rtc {
     template<typename T> inline __device__
     T tex2D(rtc::TextureObject to, float x, float y);
 
+    /* same as tex2D, but from given (fractional) mip level; only
+       for textures created with TextureDesc::mipMaps */
+    template<typename T> inline __device__
+    T tex2DLod(rtc::TextureObject to, float x, float y, float lod);
+
     /* texturing wrappers; can only be instantiated for 'flaot' and
        'vec4f' types */
     template<typename T> inline __device__
@@ -57,6 +67,8 @@ namespace rtc {
       { return ::atomicAdd(ptr,inc); }
       inline __device__ float atomicAdd(float *ptr, float inc) const
       { return ::atomicAdd(ptr,inc); }
+      /*! atomically adds (x,y) to the pair of halfs at ptr */
+      inline __device__ void atomicAddHalf2(void *ptr, float x, float y) const;
 #endif
     };
     
@@ -65,6 +77,24 @@ namespace rtc {
     // ==================================================================
 // #if RTC_DEVICE_CODE
 #if defined(__CUDACC__) || defined(__HIPCC__)
+    inline __device__
+    void ComputeInterface::atomicAddHalf2(void *ptr, float x, float y) const
+    {
+#if defined(__HIPCC__)
+      unsigned int *word = (unsigned int *)ptr;
+      unsigned int current = *(volatile unsigned int *)word;
+      while (true) {
+        float2 f = __half22float2((const __half2 &)current);
+        __half2 sum = __floats2half2_rn(f.x+x,f.y+y);
+        unsigned int was = ::atomicCAS(word,current,(const unsigned int &)sum);
+        if (was == current) break;
+        current = was;
+      }
+#else
+      ::atomicAdd((__half2 *)ptr,__floats2half2_rn(x,y));
+#endif
+    }
+
     // ------------------------------------------------------------------
     // cuda texturing
     // ------------------------------------------------------------------
@@ -100,6 +130,14 @@ namespace rtc {
       return load(v);
     }
 
+    template<> inline __device__
+    vec4f tex2DLod<vec4f>(rtc::TextureObject to, float x, float y, float lod)
+    {
+      cudaTextureObject_t texObj = (const cudaTextureObject_t&)to;
+      ::float4 v = ::tex2DLod<::float4>(texObj,x,y,lod);
+      return load(v);
+    }
+
     template<> inline __device__
     vec4f tex3D<vec4f>(rtc::TextureObject to, float x, float y, float z)
     {
@@ -5,6 +5,7 @@
 #include "rtcore/cudaCommon/Device.h"
 #include "rtcore/cudaCommon/Texture.h"
 #include "rtcore/cudaCommon/TextureData.h"
+#include <thread>
 
 namespace rtc {
   namespace cuda_common {
@@ -37,13 +38,70 @@ namespace rtc {
       int saved = setActive();
       BARNEY_CUDA_CALL(StreamCreateWithFlags(&stream,cudaStreamNonBlocking));
       // BARNEY_CUDA_CALL(StreamCreate(&stream));
+      BARNEY_CUDA_CALL(StreamCreateWithFlags(&copyStream,cudaStreamNonBlocking));
+      createMemPool();
       restoreActive(saved);
     }
 
     Device::~Device()
     {
+      if (memPool) {
+        cudaStreamSynchronize(stream);
+        cudaMemPoolDestroy(memPool);
+      }
+      cudaStreamDestroy(copyStream);
       cudaStreamDestroy(stream);
     }
+
+    void Device::createMemPool()
+    {
+      int supported = 0;
+      cudaDeviceGetAttribute(&supported,cudaDevAttrMemoryPoolsSupported,
+                             physicalID);
+      if (!supported || getenv("BARNEY_GPU_NO_POOL")) return;
+
+      cudaMemPoolProps props = {};
+      props.allocType     = cudaMemAllocationTypePinned;
+      props.location.type = cudaMemLocationTypeDevice;
+      props.location.id   = physicalID;
+      if (cudaMemPoolCreate(&memPool,&props) != cudaSuccess) {
+        cudaGetLastError();
+        memPool = 0;
+        return;
+      }
+      const char *cacheMB = getenv("BARNEY_GPU_POOL_CACHE_MB");
+      uint64_t threshold = (cacheMB ? std::stoull(cacheMB) : 1024ull) << 20;
+      BARNEY_CUDA_CALL(MemPoolSetAttribute
+                       (memPool,cudaMemPoolAttrReleaseThreshold,&threshold));
+
+      /* cudaMalloc'ed memory is visible to every peer that enabled
+         peer access; pool memory only to those the pool grants
+         access to */
+      int numGPUs = 0;
+      BARNEY_CUDA_CALL(GetDeviceCount(&numGPUs));
+      std::vector<cudaMemAccessDesc> access;
+      for (int peer=0;peer<numGPUs;peer++) {
+        int canAccess = 0;
+        if (peer == physicalID) continue;
+        cudaDeviceCanAccessPeer(&canAccess,peer,physicalID);
+        if (!canAccess) continue;
+        cudaMemAccessDesc desc = {};
+        desc.location.type = cudaMemLocationTypeDevice;
+        desc.location.id   = peer;
+        desc.flags         = cudaMemAccessFlagsProtReadWrite;
+        access.push_back(desc);
+      }
+      if (!access.empty() &&
+          cudaMemPoolSetAccess(memPool,access.data(),access.size())
+          != cudaSuccess) {
+        cudaGetLastError();
+        std::cerr << "#rtc.cuda: could not share gpu " << physicalID
+                  << "'s memory pool with its peers; using cudaMalloc"
+                  << std::endl;
+        cudaMemPoolDestroy(memPool);
+        memPool = 0;
+      }
+    }
     
     int Device::setActive() const
     {
@@ -66,10 +124,25 @@ namespace rtc {
       if (!numBytes) return nullptr;
       SetActiveGPU forDuration(this);
       void *ptr = 0;
-      // BARNEY_CUDA_CALL(MallocManaged((void **)&ptr,numBytes));
-      BARNEY_CUDA_CALL(Malloc((void **)&ptr,numBytes));
+      if (memPool) {
+        cudaError_t rc
+          = cudaMallocFromPoolAsync(&ptr,numBytes,memPool,stream);
+        if (rc == cudaErrorMemoryAllocation) {
+          /* whatever the pool still holds on to may be just what's
+             missing; hand it back, and try once more */
+          cudaGetLastError();
+          BARNEY_CUDA_CALL(StreamSynchronize(stream));
+          BARNEY_CUDA_CALL(MemPoolTrimTo(memPool,0));
+          rc = cudaMallocFromPoolAsync(&ptr,numBytes,memPool,stream);
+        }
+        BARNEY_CUDA_CHECK(rc);
+        BARNEY_CUDA_CALL(StreamSynchronize(stream));
+      } else {
+        BARNEY_CUDA_CALL(Malloc((void **)&ptr,numBytes));
+        BARNEY_CUDA_SYNC_CHECK();
+      }
       assert(ptr);
-      BARNEY_CUDA_SYNC_CHECK();
+      memory.allocated(ptr,numBytes);
       return ptr;
     }
     
@@ -93,8 +166,73 @@ namespace rtc {
     {
       if (!mem) return;
       SetActiveGPU forDuration(this);
+      if (memPool) {
+        BARNEY_CUDA_CALL(FreeAsync(mem,stream));
+      } else {
+        BARNEY_CUDA_CALL(Free(mem));
+        BARNEY_CUDA_SYNC_CHECK();
+      }
+      memory.freed(mem);
+    }
+
+    void *Device::allocManaged(size_t numBytes)
+    {
+      if (!numBytes) return nullptr;
+      SetActiveGPU forDuration(this);
+      void *ptr = 0;
+      BARNEY_CUDA_CALL(MallocManaged(&ptr,numBytes));
+#if CUDART_VERSION >= 13000
+      cudaMemLocation location = {};
+      location.type = cudaMemLocationTypeDevice;
+      location.id   = physicalID;
+      BARNEY_CUDA_CALL(MemAdvise(ptr,numBytes,cudaMemAdviseSetReadMostly,
+                                 location));
+#else
+      BARNEY_CUDA_CALL(MemAdvise(ptr,numBytes,cudaMemAdviseSetReadMostly,
+                                 physicalID));
+#endif
+      memory.allocated(ptr,numBytes);
+      return ptr;
+    }
+
+    void Device::freeManaged(void *mem)
+    {
+      if (!mem) return;
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL(StreamSynchronize(stream));
       BARNEY_CUDA_CALL(Free(mem));
-      BARNEY_CUDA_SYNC_CHECK();
+      memory.freed(mem);
+    }
+
+    void Device::prefetch(const void *mem, size_t numBytes)
+    {
+      if (!mem || !numBytes) return;
+      SetActiveGPU forDuration(this);
+#if CUDART_VERSION >= 13000
+      cudaMemLocation location = {};
+      location.type = cudaMemLocationTypeDevice;
+      location.id   = physicalID;
+      BARNEY_CUDA_CALL(MemPrefetchAsync(mem,numBytes,location,0,stream));
+#else
+      BARNEY_CUDA_CALL(MemPrefetchAsync(mem,numBytes,physicalID,stream));
+#endif
+    }
+
+    void Device::getMemInfo(size_t &free, size_t &total)
+    {
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL(MemGetInfo(&free,&total));
+    }
+
+    size_t Device::getCachedMemory()
+    {
+      if (!memPool) return 0;
+      uint64_t reserved = 0, used = 0;
+      BARNEY_CUDA_CALL(MemPoolGetAttribute
+                       (memPool,cudaMemPoolAttrReservedMemCurrent,&reserved));
+      BARNEY_CUDA_CALL(MemPoolGetAttribute
+                       (memPool,cudaMemPoolAttrUsedMemCurrent,&used));
+      return size_t(reserved-std::min(reserved,used));
     }
       
     void Device::memsetAsync(void *mem,int value, size_t numBytes) 
@@ -119,6 +257,161 @@ namespace rtc {
       BARNEY_CUDA_SYNC_CHECK();
     }
 
+    void Device::beginCapture()
+    {
+      assert(!capturing);
+      SetActiveGPU forDuration(this);
+      capturing = new Graph;
+      BARNEY_CUDA_CALL(StreamBeginCapture(stream,
+                                          cudaStreamCaptureModeThreadLocal));
+    }
+    
+    Graph *Device::endCapture()
+    {
+      assert(capturing);
+      SetActiveGPU forDuration(this);
+      Graph *result = capturing;
+      capturing = nullptr;
+      
+      cudaGraph_t graph = 0;
+      cudaError_t rc = cudaStreamEndCapture(stream,&graph);
+      if (rc == cudaSuccess && graph)
+        rc = cudaGraphInstantiateWithFlags(&result->exec,graph,0);
+      if (graph)
+        cudaGraphDestroy(graph);
+      if (rc != cudaSuccess || !result->exec) {
+        // clear the error so it doesn't show up in the next check
+        cudaGetLastError();
+        freeGraph(result);
+        return nullptr;
+      }
+      return result;
+    }
+    
+    void Device::launchGraph(Graph *graph)
+    {
+      assert(graph);
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL(GraphLaunch(graph->exec,stream));
+    }
+    
+    void *Device::importExternalMemory(int fd, size_t numBytes)
+    {
+      SetActiveGPU forDuration(this);
+      cudaExternalMemoryHandleDesc handleDesc;
+      memset(&handleDesc,0,sizeof(handleDesc));
+      handleDesc.type      = cudaExternalMemoryHandleTypeOpaqueFd;
+      handleDesc.handle.fd = fd;
+      handleDesc.size      = numBytes;
+      cudaExternalMemory_t extMem;
+      BARNEY_CUDA_CALL(ImportExternalMemory(&extMem,&handleDesc));
+
+      cudaExternalMemoryBufferDesc bufferDesc;
+      memset(&bufferDesc,0,sizeof(bufferDesc));
+      bufferDesc.offset = 0;
+      bufferDesc.size   = numBytes;
+      void *ptr = 0;
+      BARNEY_CUDA_CALL(ExternalMemoryGetMappedBuffer(&ptr,extMem,&bufferDesc));
+      externalMemory[ptr] = extMem;
+      return ptr;
+    }
+
+    void Device::freeExternalMemory(void *ptr)
+    {
+      auto it = externalMemory.find(ptr);
+      if (it == externalMemory.end()) return;
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL_NOTHROW(Free(ptr));
+      BARNEY_CUDA_CALL_NOTHROW(DestroyExternalMemory(it->second));
+      externalMemory.erase(it);
+    }
+
+    void Device::freeGraph(Graph *graph)
+    {
+      if (!graph) return;
+      SetActiveGPU forDuration(this);
+      if (graph->exec)
+        BARNEY_CUDA_CALL_NOTHROW(GraphExecDestroy(graph->exec));
+      for (auto mem : graph->hostData)
+        BARNEY_CUDA_CALL_NOTHROW(FreeHost(mem));
+      delete graph;
+    }
+    
+    const void *Device::keepForCapture(const void *data, size_t numBytes)
+    {
+      assert(capturing);
+      void *copy = 0;
+      BARNEY_CUDA_CALL(MallocHost(&copy,numBytes));
+      memcpy(copy,data,numBytes);
+      capturing->hostData.push_back(copy);
+      return copy;
+    }
+
+    Event *Device::createEvent()
+    {
+      SetActiveGPU forDuration(this);
+      Event *event = new Event;
+      BARNEY_CUDA_CALL(EventCreateWithFlags(&event->event,cudaEventDefault));
+      return event;
+    }
+    
+    void Device::freeEvent(Event *event)
+    {
+      if (!event) return;
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL_NOTHROW(EventDestroy(event->event));
+      delete event;
+    }
+    
+    void Device::recordEvent(Event *event)
+    {
+      assert(event);
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL(EventRecord(event->event,stream));
+    }
+    
+    void Device::waitForEvent(Event *event)
+    {
+      assert(event);
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL(EventSynchronize(event->event));
+    }
+    
+    void Device::streamWaitEvent(Event *event)
+    {
+      assert(event);
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL(StreamWaitEvent(stream,event->event,0));
+    }
+    
+    void Device::copyAsyncAfter(Event *after, void *dst, const void *src,
+                                size_t numBytes)
+    {
+      if (numBytes == 0) return;
+      SetActiveGPU forDuration(this);
+      if (after)
+        BARNEY_CUDA_CALL(StreamWaitEvent(copyStream,after->event,0));
+      BARNEY_CUDA_CALL(MemcpyAsync(dst,src,numBytes,cudaMemcpyDefault,
+                                   copyStream));
+    }
+    
+    void Device::recordCopyEvent(Event *event)
+    {
+      assert(event);
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL(EventRecord(event->event,copyStream));
+    }
+    
+    float Device::elapsedTime(Event *begin, Event *end)
+    {
+      assert(begin && end);
+      SetActiveGPU forDuration(this);
+      BARNEY_CUDA_CALL(EventSynchronize(end->event));
+      float ms = 0.f;
+      BARNEY_CUDA_CALL(EventElapsedTime(&ms,begin->event,end->event));
+      return ms;
+    }
+
     void Device::freeTextureData(TextureData *td)
     {
       if (td) delete td;
@@ -138,6 +431,16 @@ namespace rtc {
       return new TextureData(this,dims,format,texels);
     }
 
+    TextureData *
+    Device::createTextureDataAsync(vec3i dims,
+                                   rtc::DataType format,
+                                   const void *texels,
+                                   Event *uploaded) 
+    {
+      SetActiveGPU forDuration(this);
+      return new TextureData(this,dims,format,texels,uploaded);
+    }
+
     Texture *TextureData::createTexture(const TextureDesc &desc) 
     {
       SetActiveGPU forDuration(device);
@@ -148,7 +451,7 @@ namespace rtc {
         successful, else if at least one pair does not work */
     bool enablePeerAccess(const std::vector<int> &gpuIDs)
     {
-      if (gpuIDs.size() == 1) return true;
+      if (gpuIDs.size() <= 1) return true;
 #define LOG(a) ss << "#bn." << a << std::endl;
 
       std::stringstream ss;
@@ -164,47 +467,63 @@ namespace rtc {
       }
       LOG("enabling peer access:");
       
-      bool successful = true;
-
-      for (auto gpuID : gpuIDs) {
-        SetActiveGPU forLifeTime(gpuID);
-        ss << " - device #" << gpuID << " : ";
-        int cuda_i = gpuID; 
-        for (int j=0;j<deviceCount;j++) {
-          int cuda_j = gpuIDs[j];
-          if (cuda_i == cuda_j) {
-            ss << " ."; 
-          } else {
+      /* each device enables its own peers, so do all of them at the
+         same time; lines get collected per device to keep the log in
+         order */
+      std::vector<std::string> lines(deviceCount);
+      std::vector<int> deviceSuccessful(deviceCount,1);
+      std::vector<std::exception_ptr> errors(deviceCount);
+      auto enableFrom = [&](int i) {
+        try {
+          const int cuda_i = gpuIDs[i];
+          SetActiveGPU forLifeTime(cuda_i);
+          std::stringstream line;
+          line << " - device #" << cuda_i << " : ";
+          for (int j=0;j<deviceCount;j++) {
+            int cuda_j = gpuIDs[j];
+            if (cuda_i == cuda_j) {
+              line << " .";
+              continue;
+            }
             int canAccessPeer = 0;
             cudaError_t rc = cudaDeviceCanAccessPeer(&canAccessPeer, cuda_i,cuda_j);
-            if (rc != cudaSuccess) {
-              PRINT(rc);
-              PRINT(std::to_string(rc));
+            if (rc != cudaSuccess)
               throw std::runtime_error("cuda error in cudaDeviceCanAccessPeer: "
                                        +std::to_string(rc));
-            }
             if (!canAccessPeer) {
-              // huh. this can happen if you have differnt device
-              // types (in my case, a 2070 and a rtx 8000).
-              // nvm - yup, this isn't an error. Expect certain configs to not allow peer access.
-              // disabling this, as it's concerning end users.
-              // std::cerr << "cannot not enable peer access!? ... skipping..." << std::endl;
-              successful = false;
-              ss << " !"; 
+              // this can happen if you have different device types
+              // (eg, a 2070 and a rtx 8000); expect certain configs
+              // to not allow peer access, this isn't an error
+              deviceSuccessful[i] = 0;
+              line << " !";
               continue;
             }
-            
             rc = cudaDeviceEnablePeerAccess(cuda_j,/* flags - must be 0 */0);
             if (rc == cudaErrorPeerAccessAlreadyEnabled) {
               auto ignore = cudaGetLastError();
             } else if (rc != cudaSuccess)
               throw std::runtime_error("cuda error in cudaDeviceEnablePeerAccess: "
                                        +std::to_string(rc));
-            ss << " +";
+            line << " +";
           }
+          lines[i] = line.str();
+        } catch (...) {
+          errors[i] = std::current_exception();
         }
-        ss << "\n";
-        // LOG(ss.str());
+      };
+      std::vector<std::thread> threads;
+      for (int i=1;i<deviceCount;i++)
+        threads.emplace_back(enableFrom,i);
+      enableFrom(0);
+      for (auto &thread : threads)
+        thread.join();
+      for (auto &error : errors)
+        if (error) std::rethrow_exception(error);
+
+      bool successful = true;
+      for (int i=0;i<deviceCount;i++) {
+        ss << lines[i] << "\n";
+        successful = successful && deviceSuccessful[i];
       }
       std::cout << ss.str();
       return successful;
@@ -220,6 +539,27 @@ namespace rtc {
         throw std::runtime_error("could not query cuda Device properties");
       return ((props.pciDomainID * 256 + props.pciBusID) * 256) + props.pciDeviceID;
     }
+
+    int getNumaNode(int gpuID)
+    {
+      cudaDeviceProp props;
+      cudaError_t rc = cudaGetDeviceProperties(&props, gpuID);
+      if (rc != cudaSuccess)
+        throw std::runtime_error("could not query cuda Device properties");
+#ifdef __linux__
+      char path[128];
+      snprintf(path,sizeof(path),"/sys/bus/pci/devices/%04x:%02x:%02x.0/numa_node",
+               props.pciDomainID,props.pciBusID,props.pciDeviceID);
+      FILE *file = fopen(path,"r");
+      if (!file) return -1;
+      int numaNode = -1;
+      if (fscanf(file,"%i",&numaNode) != 1) numaNode = -1;
+      fclose(file);
+      return numaNode;
+#else
+      return -1;
+#endif
+    }
     
   }
 }
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "rtcore/cudaCommon/cuda-common.h"
+#include "rtcore/common/MemoryTracker.h"
 
 namespace rtc {
   namespace cuda_common {
@@ -18,6 +19,21 @@ namespace rtc {
     void checkHip();
     void hipCheck();
     
+    /*! an instantiated (cuda-)graph of work captured from a device's
+        stream, plus copies of all host data the captured work reads
+        from (which has to live as long as the graph does) */
+    struct Graph {
+      cudaGraphExec_t     exec = 0;
+      std::vector<void *> hostData;
+    };
+
+    /*! a marker that can get recorded into a device's stream;
+        elapsedTime() between two of those tells how long the work
+        issued in between took on the device */
+    struct Event {
+      cudaEvent_t event = 0;
+    };
+    
     struct SetActiveGPU {
       SetActiveGPU(const Device *device);
       SetActiveGPU(int gpuID);
@@ -41,10 +57,92 @@ namespace rtc {
       void *allocHost(size_t numBytes);
       void freeHost(void *mem);
       void memsetAsync(void *mem,int value, size_t size);
+      /*! device memory comes from (and gets returned to) this
+          device's memory pool, in order with everything enqueued
+          into 'stream'. Allocating waits for that stream only (not
+          the whole gpu, like cudaMalloc), so the memory can get used
+          from anywhere once this returns; freeing doesn't wait at
+          all, so whoever frees memory that work on streams other
+          than 'stream' may still use has to order that work with
+          'stream' first.
+
+          Configured through the environment:
+          BARNEY_GPU_POOL_CACHE_MB - how much freed memory the pool
+            keeps around for re-use (default 1024) rather than
+            releasing it back to the driver at the next sync
+          BARNEY_GPU_NO_POOL - use plain (synchronous) cudaMalloc
+            and cudaFree, as on devices without memory pool support
+      */
       void *allocMem(size_t numBytes);
       void freeMem(void *mem);
       void sync();
+
+      /*! unified (managed) memory, for data that may be larger than
+          what the gpu has free: it gets paged in on demand, and is
+          marked read-mostly, so every gpu that reads it gets its own
+          copy of the pages it touches. Gets tracked like allocMem()'s,
+          but has to be freed through freeManaged() */
+      void *allocManaged(size_t numBytes);
+      void freeManaged(void *mem);
+      /*! asynchronously (in 'stream') migrates given range of managed
+          memory to this gpu */
+      void prefetch(const void *mem, size_t numBytes);
+
+      /*! what the gpu has free, and in total, right now */
+      void getMemInfo(size_t &free, size_t &total);
+      /*! freed memory that the pool keeps around for re-use */
+      size_t getCachedMemory();
+
+      /*! starts capturing all work subsequently issued to this
+          device into a graph (rather than executing it). No syncs or
+          memory allocations may happen until endCapture() */
+      void beginCapture();
+      /*! ends a capture started by beginCapture(), and returns an
+          executable graph, or null if the captured work could not be
+          turned into a graph */
+      Graph *endCapture();
+      void launchGraph(Graph *graph);
+      void freeGraph(Graph *graph);
+
+      /*! returns a copy of given host data that will live as long as
+          the graph currently being captured; kernels that upload
+          host data have to use this when capturing != nullptr */
+      const void *keepForCapture(const void *data, size_t numBytes);
+      bool isCapturing() const { return capturing != nullptr; }
+
+      Event *createEvent();
+      void freeEvent(Event *event);
+      /*! enqueues the event into this device's stream (no sync) */
+      void recordEvent(Event *event);
+      /*! blocks the host until everything enqueued before the event
+          has completed */
+      void waitForEvent(Event *event);
+      /*! makes all work subsequently enqueued into this device's
+          stream wait for given event (without blocking the host) */
+      void streamWaitEvent(Event *event);
+      /*! same as copyAsync(), but on the copy stream, once
+          everything enqueued into the main stream before 'after'
+          (if non-null) is done; so the copy overlaps with whatever
+          the main stream does after that */
+      void copyAsyncAfter(Event *after, void *dst, const void *src,
+                          size_t numBytes);
+      /*! enqueues the event into this device's copy stream */
+      void recordCopyEvent(Event *event);
+      /*! returns the time (in milliseconds) between the given two
+          events, waiting for 'end' to complete if it hasn't yet */
+      float elapsedTime(Event *begin, Event *end);
+
+      /*! maps memory that some other api (eg, vulkan, or opengl
+          through GL_EXT_memory_object_fd) exported as an opaque
+          posix file descriptor into this device's address space, and
+          returns a device pointer to it. The fd belongs to the
+          import from then on */
+      void *importExternalMemory(int fd, size_t numBytes);
+      void freeExternalMemory(void *ptr);
       
+      /*! creates memPool, if possible and not disabled */
+      void createMemPool();
+
       /*! sets this gpu as active, and returns physical ID of GPU that
         was active before */
       int setActive() const;
@@ -55,12 +153,38 @@ namespace rtc {
       TextureData *createTextureData(vec3i dims,
                                      rtc::DataType format,
                                      const void *texels);
+      /*! same as createTextureData(), but only queues the upload of
+          the texels on this device's copy stream, so it overlaps with
+          whatever runs in the main stream; 'uploaded' gets recorded
+          once the upload is done, and has to be waited on (see
+          streamWaitEvent()) before the data gets used. Pageable
+          texels are staged before this returns, pinned ones have to
+          stay valid until the upload is done */
+      TextureData *createTextureDataAsync(vec3i dims,
+                                          rtc::DataType format,
+                                          const void *texels,
+                                          Event *uploaded);
       
       void freeTextureData(TextureData *);
       void freeTexture(Texture *);
       
       cudaStream_t stream = 0;
+      /*! side stream for uploads that should overlap with rendering */
+      cudaStream_t copyStream = 0;
       int const physicalID;
+      
+      /*! graph currently being captured, if any */
+      Graph *capturing = nullptr;
+
+      /*! device memory that got allocated through this device */
+      MemoryTracker memory;
+      /*! where allocMem() allocates from; null if pools aren't
+          supported (or got disabled), in which case it's plain
+          cudaMalloc */
+      cudaMemPool_t memPool = 0;
+
+      /*! imported external memory, by mapped device pointer */
+      std::map<void *,cudaExternalMemory_t> externalMemory;
     };
 
     /*! enable peer access between these gpus, and return truea if
@@ -69,6 +193,10 @@ namespace rtc {
 
     /*! get a unique hash for a given physical device. */
     size_t getPhysicalDeviceHash(int gpuID);
+
+    /*! numa node (ie, cpu socket) that given gpu's pcie link hangs
+        off of, or -1 if that can't be determined */
+    int getNumaNode(int gpuID);
     
 
   }
@@ -39,10 +39,19 @@ namespace rtc {
     {
       SetActiveGPU forDuration(device);
         
+      if (desc.mipMaps)
+        data->buildMipMaps();
+      const bool useMips = desc.mipMaps && data->mipArray;
+      
       cudaResourceDesc resourceDesc;
       memset(&resourceDesc,0,sizeof(resourceDesc));
-      resourceDesc.resType         = cudaResourceTypeArray;
-      resourceDesc.res.array.array = data->array;
+      if (useMips) {
+        resourceDesc.resType           = cudaResourceTypeMipmappedArray;
+        resourceDesc.res.mipmap.mipmap = data->mipArray;
+      } else {
+        resourceDesc.resType         = cudaResourceTypeArray;
+        resourceDesc.res.array.array = data->array;
+      }
       
       cudaTextureDesc textureDesc;
       memset(&textureDesc,0,sizeof(textureDesc));
@@ -56,6 +65,11 @@ namespace rtc {
       textureDesc.borderColor[2]   = desc.borderColor.z;
       textureDesc.borderColor[3]   = desc.borderColor.w;
       textureDesc.normalizedCoords = desc.normalizedCoords;
+      if (useMips) {
+        textureDesc.mipmapFilterMode    = toCUDA(desc.filterMode);
+        textureDesc.minMipmapLevelClamp = 0.f;
+        textureDesc.maxMipmapLevelClamp = float(data->numMipLevels-1);
+      }
       
       BARNEY_CUDA_CALL(CreateTextureObject(&textureObject,
                                            &resourceDesc,
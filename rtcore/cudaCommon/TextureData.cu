@@ -8,10 +8,65 @@
 namespace rtc {
   namespace cuda_common {
 
+    /*! converts a filtered (and, for fixed-point formats, normalized)
+        value back to a texel of given type */
+    template<typename T> inline __device__ T toTexel(float4 v);
+    template<> inline __device__ float toTexel<float>(float4 v)
+    { return v.x; }
+    template<> inline __device__ float4 toTexel<float4>(float4 v)
+    { return v; }
+    inline __device__ unsigned char toUnorm8(float f)
+    { return (unsigned char)(fminf(fmaxf(f,0.f),1.f)*255.f+.5f); }
+    template<> inline __device__ uint8_t toTexel<uint8_t>(float4 v)
+    { return toUnorm8(v.x); }
+    template<> inline __device__ uchar4 toTexel<uchar4>(float4 v)
+    { return make_uchar4(toUnorm8(v.x),toUnorm8(v.y),
+                         toUnorm8(v.z),toUnorm8(v.w)); }
+    template<> inline __device__ uint16_t toTexel<uint16_t>(float4 v)
+    { return (uint16_t)(fminf(fmaxf(v.x,0.f),1.f)*65535.f+.5f); }
+
+    /*! one thread per texel of the coarser level: with linear
+        filtering, a fetch right between four texels of the finer
+        level is the average of those four */
+    template<typename T>
+    __global__
+    void downsampleMipLevel(cudaTextureObject_t finer,
+                            cudaSurfaceObject_t coarser,
+                            int width, int height)
+    {
+      int ix = threadIdx.x+blockIdx.x*blockDim.x;
+      int iy = threadIdx.y+blockIdx.y*blockDim.y;
+      if (ix >= width || iy >= height) return;
+      float4 v = ::tex2D<float4>(finer,(ix+.5f)/width,(iy+.5f)/height);
+      surf2Dwrite(toTexel<T>(v),coarser,ix*(int)sizeof(T),iy);
+    }
+    
+    /*! channel descriptor for one of the BCn formats; the arrays
+        themselves get allocated in texels, but copied in blocks */
+    inline cudaChannelFormatDesc blockCompressedChannelDesc(rtc::DataType format)
+    {
+      switch (format) {
+      case rtc::BC1:
+        return cudaCreateChannelDesc(8,8,8,8,cudaChannelFormatKindUnsignedBlockCompressed1);
+      case rtc::BC3:
+        return cudaCreateChannelDesc(8,8,8,8,cudaChannelFormatKindUnsignedBlockCompressed3);
+      case rtc::BC4:
+        return cudaCreateChannelDesc(8,0,0,0,cudaChannelFormatKindUnsignedBlockCompressed4);
+      case rtc::BC5:
+        return cudaCreateChannelDesc(8,8,0,0,cudaChannelFormatKindUnsignedBlockCompressed5);
+      case rtc::BC6H:
+        return cudaCreateChannelDesc(16,16,16,0,cudaChannelFormatKindUnsignedBlockCompressed6H);
+      case rtc::BC7:
+      default:
+        return cudaCreateChannelDesc(8,8,8,8,cudaChannelFormatKindUnsignedBlockCompressed7);
+      }
+    }
+    
     TextureData::TextureData(Device *device,
                              vec3i dims,
                              rtc::DataType format,
-                             const void *texels)
+                             const void *texels,
+                             Event *uploaded)
       : device(device), dims(dims), format(format)
     {
       SetActiveGPU forDuration(device);
@@ -49,14 +104,34 @@ namespace rtc {
         readMode     = cudaReadModeNormalizedFloat;
         numScalarsPerTexel = 1;
         break;
+      case rtc::BC1:
+      case rtc::BC3:
+      case rtc::BC4:
+      case rtc::BC5:
+      case rtc::BC6H:
+      case rtc::BC7:
+        desc         = blockCompressedChannelDesc(format);
+        /* bc6h decodes to (half) floats, all others are unorm */
+        readMode
+          = (format == rtc::BC6H)
+          ? cudaReadModeElementType
+          : cudaReadModeNormalizedFloat;
+        /* not meaningful per texel; see numBytesPerBlock() */
+        sizeOfScalar = 0;
+        numScalarsPerTexel = 0;
+        break;
       case rtc::FLOAT3:
         throw std::runtime_error("float3 textures not allowed in barney::rtc::cuda");
       default:
         PRINT(std::to_string((int)format));
         assert(0);
       };
+      channelDesc = desc;
+      sizeOfTexel = sizeOfScalar*numScalarsPerTexel;
 
       if (dims.z != 0) {
+        if (isBlockCompressed(format))
+          throw std::runtime_error("block-compressed texture formats are 2D only");
         unsigned int padded_x = (unsigned)dims.x;
         unsigned int padded_y = std::max(1u,(unsigned)dims.y);
         unsigned int padded_z = std::max(1u,(unsigned)dims.z);
@@ -71,19 +146,49 @@ namespace rtc {
                                 (size_t)padded_y);
         copyParms.dstArray = array;
         copyParms.extent   = extent;
-        copyParms.kind     = cudaMemcpyHostToDevice;
-        BARNEY_CUDA_CALL(Memcpy3D(&copyParms));
+        // 'default' kind: texels may also sit on a (peer) device
+        copyParms.kind     = cudaMemcpyDefault;
+        if (uploaded)
+          BARNEY_CUDA_CALL(Memcpy3DAsync(&copyParms,device->copyStream));
+        else
+          BARNEY_CUDA_CALL(Memcpy3D(&copyParms));
       } else if (dims.y != 0) {
         BARNEY_CUDA_CALL(MallocArray(&array,&desc,dims.x,dims.y,0));
-        BARNEY_CUDA_CALL(Memcpy2DToArray(array,0,0,
-                                         (void *)texels,
-                                         (size_t)dims.x*sizeOfScalar*numScalarsPerTexel,
-                                         (size_t)dims.x*sizeOfScalar*numScalarsPerTexel,
-                                         (size_t)dims.y,
-                                         cudaMemcpyHostToDevice));
+        size_t pitch = (size_t)dims.x*sizeOfScalar*numScalarsPerTexel;
+        size_t numRows = (size_t)dims.y;
+        if (isBlockCompressed(format)) {
+          /* compressed arrays get copied as rows of blocks */
+          pitch   = (size_t)divRoundUp(dims.x,4)*numBytesPerBlock(format);
+          numRows = (size_t)divRoundUp(dims.y,4);
+        }
+        if (uploaded)
+          BARNEY_CUDA_CALL(Memcpy2DToArrayAsync(array,0,0,
+                                                (void *)texels,
+                                                pitch,pitch,
+                                                numRows,
+                                                cudaMemcpyDefault,
+                                                device->copyStream));
+        else
+          BARNEY_CUDA_CALL(Memcpy2DToArray(array,0,0,
+                                           (void *)texels,
+                                           pitch,pitch,
+                                           numRows,
+                                           cudaMemcpyDefault));
       } else {
         assert(0);
       }
+      if (uploaded)
+        BARNEY_CUDA_CALL(EventRecord(uploaded->event,device->copyStream));
+
+      size_t numTexels
+        = (size_t)dims.x*std::max(1,dims.y)*std::max(1,dims.z);
+      trackedBytes
+        = isBlockCompressed(format)
+        ? (size_t)divRoundUp(dims.x,4)*divRoundUp(dims.y,4)
+        * numBytesPerBlock(format)
+        : numTexels*sizeOfTexel;
+      memoryCategory = device->memory.current;
+      device->memory.allocated(memoryCategory,trackedBytes);
     }
 
     TextureData::~TextureData()
@@ -91,6 +196,109 @@ namespace rtc {
       SetActiveGPU forDuration(device);
       BARNEY_CUDA_CALL_NOTHROW(FreeArray(array));
       array = 0;
+      if (mipArray)
+        BARNEY_CUDA_CALL_NOTHROW(FreeMipmappedArray(mipArray));
+      mipArray = 0;
+      device->memory.freed(memoryCategory,trackedBytes);
+    }
+
+    void TextureData::buildMipMaps()
+    {
+      if (mipArray || dims.z != 0 || dims.y == 0) return;
+      /* can't write compressed levels through surfaces; such
+         textures simply only have level 0 */
+      if (isBlockCompressed(format)) return;
+      SetActiveGPU forDuration(device);
+      
+      numMipLevels = 1;
+      while ((1<<numMipLevels) <= std::max(dims.x,dims.y))
+        numMipLevels++;
+      cudaExtent extent{(size_t)dims.x,(size_t)dims.y,0};
+      BARNEY_CUDA_CALL(MallocMipmappedArray(&mipArray,&channelDesc,extent,
+                                            numMipLevels,
+                                            cudaArraySurfaceLoadStore));
+      size_t mipBytes = 0;
+      for (vec2i d = { dims.x,dims.y };;d = max(vec2i(1),d/2)) {
+        mipBytes += (size_t)d.x*d.y*sizeOfTexel;
+        if (d == vec2i(1)) break;
+      }
+      trackedBytes += mipBytes;
+      device->memory.allocated(memoryCategory,mipBytes);
+      
+      cudaArray_t level0;
+      BARNEY_CUDA_CALL(GetMipmappedArrayLevel(&level0,mipArray,0));
+      cudaMemcpy3DParms copyParms;
+      memset(&copyParms,0,sizeof(copyParms));
+      copyParms.srcArray = array;
+      copyParms.dstArray = level0;
+      copyParms.extent   = make_cudaExtent(dims.x,dims.y,1);
+      copyParms.kind     = cudaMemcpyDeviceToDevice;
+      BARNEY_CUDA_CALL(Memcpy3DAsync(&copyParms,device->stream));
+
+      std::vector<cudaTextureObject_t> finers;
+      std::vector<cudaSurfaceObject_t> coarsers;
+      vec2i levelDims = { dims.x,dims.y };
+      for (int level=1;level<numMipLevels;level++) {
+        cudaArray_t finer, coarser;
+        BARNEY_CUDA_CALL(GetMipmappedArrayLevel(&finer,mipArray,level-1));
+        BARNEY_CUDA_CALL(GetMipmappedArrayLevel(&coarser,mipArray,level));
+        levelDims = max(vec2i(1),levelDims/2);
+
+        cudaResourceDesc resourceDesc;
+        memset(&resourceDesc,0,sizeof(resourceDesc));
+        resourceDesc.resType         = cudaResourceTypeArray;
+        resourceDesc.res.array.array = finer;
+        cudaTextureDesc textureDesc;
+        memset(&textureDesc,0,sizeof(textureDesc));
+        textureDesc.addressMode[0]   = cudaAddressModeClamp;
+        textureDesc.addressMode[1]   = cudaAddressModeClamp;
+        textureDesc.filterMode       = cudaFilterModeLinear;
+        textureDesc.readMode         = readMode;
+        textureDesc.normalizedCoords = true;
+        cudaTextureObject_t finerTex;
+        BARNEY_CUDA_CALL(CreateTextureObject(&finerTex,&resourceDesc,
+                                             &textureDesc,0));
+        resourceDesc.res.array.array = coarser;
+        cudaSurfaceObject_t coarserSurf;
+        BARNEY_CUDA_CALL(CreateSurfaceObject(&coarserSurf,&resourceDesc));
+        finers.push_back(finerTex);
+        coarsers.push_back(coarserSurf);
+
+        dim3 bs(16,16);
+        dim3 nb(divRoundUp(levelDims.x,16),divRoundUp(levelDims.y,16));
+        switch (format) {
+        case rtc::FLOAT:
+          downsampleMipLevel<float><<<nb,bs,0,device->stream>>>
+            (finerTex,coarserSurf,levelDims.x,levelDims.y);
+          break;
+        case rtc::FLOAT4:
+          downsampleMipLevel<float4><<<nb,bs,0,device->stream>>>
+            (finerTex,coarserSurf,levelDims.x,levelDims.y);
+          break;
+        case rtc::UCHAR:
+          downsampleMipLevel<uint8_t><<<nb,bs,0,device->stream>>>
+            (finerTex,coarserSurf,levelDims.x,levelDims.y);
+          break;
+        case rtc::UCHAR4:
+          downsampleMipLevel<uchar4><<<nb,bs,0,device->stream>>>
+            (finerTex,coarserSurf,levelDims.x,levelDims.y);
+          break;
+        case rtc::USHORT:
+          downsampleMipLevel<uint16_t><<<nb,bs,0,device->stream>>>
+            (finerTex,coarserSurf,levelDims.x,levelDims.y);
+          break;
+        default:
+          assert(0);
+        }
+      }
+      /* each level reads the one before, so they have to run in
+         order anyway; only wait once, at the end, before we can
+         release the temporary texture and surface objects */
+      BARNEY_CUDA_CALL(StreamSynchronize(device->stream));
+      for (auto tex : finers)
+        BARNEY_CUDA_CALL_NOTHROW(DestroyTextureObject(tex));
+      for (auto surf : coarsers)
+        BARNEY_CUDA_CALL_NOTHROW(DestroySurfaceObject(surf));
     }
     
   }
@@ -11,20 +11,41 @@ namespace rtc {
     
     struct Device;
     struct Texture;
+    struct Event;
     
     struct TextureData// : public rtc::TextureData
     {
+      /*! if 'uploaded' is non-null the upload goes through the
+          device's copy stream, and records that event when done */
       TextureData(Device *device,
                   vec3i dims,
                   rtc::DataType format,
-                  const void *texels);
+                  const void *texels,
+                  Event *uploaded = nullptr);
       virtual ~TextureData();
       
       Texture *
       createTexture(const rtc::TextureDesc &desc);
+
+      /*! builds mipArray, unless that already exists: level 0 is a
+          copy of 'array', and every further level a 2x2 box filter
+          of the one above, down to 1x1. Only for 2D data; gets
+          called when the first texture with TextureDesc::mipMaps
+          gets created. Block-compressed data only ever has level
+          0 */
+      void buildMipMaps();
       
       cudaArray_t array;
+      /*! full mip chain, for textures that asked for one; 'array'
+          stays around for all others */
+      cudaMipmappedArray_t mipArray = 0;
+      int                  numMipLevels = 0;
+      cudaChannelFormatDesc channelDesc;
+      size_t              sizeOfTexel = 0;
       cudaTextureReadMode readMode;
+      /*! what got reported to device->memory, for which category */
+      size_t              trackedBytes   = 0;
+      int                 memoryCategory = 0;
       const vec3i dims;
       const DataType format;
       Device *const device;
@@ -38,6 +38,7 @@ using cudaError_t = hipError_t;
 #define cudaSetDevice              hipSetDevice
 #define cudaGetDevice              hipGetDevice
 #define cudaGetDeviceCount         hipGetDeviceCount
+#define cudaDeviceGetAttribute     hipDeviceGetAttribute
 #define cudaGetDeviceProperties    hipGetDeviceProperties
 #define cudaDeviceProp             hipDeviceProp_t
 #define cudaDeviceSynchronize      hipDeviceSynchronize
@@ -51,6 +52,33 @@ using cudaStream_t = hipStream_t;
 #define cudaStreamSynchronize      hipStreamSynchronize
 #define cudaStreamDestroy          hipStreamDestroy
 
+using cudaGraph_t     = hipGraph_t;
+using cudaGraphExec_t = hipGraphExec_t;
+#define cudaStreamBeginCapture          hipStreamBeginCapture
+#define cudaStreamEndCapture            hipStreamEndCapture
+#define cudaStreamCaptureModeThreadLocal hipStreamCaptureModeThreadLocal
+#define cudaGraphInstantiateWithFlags   hipGraphInstantiateWithFlags
+#define cudaGraphLaunch                 hipGraphLaunch
+#define cudaGraphDestroy                hipGraphDestroy
+#define cudaGraphExecDestroy            hipGraphExecDestroy
+
+using cudaEvent_t = hipEvent_t;
+#define cudaEventDefault           hipEventDefault
+#define cudaEventCreateWithFlags   hipEventCreateWithFlags
+#define cudaEventDestroy           hipEventDestroy
+#define cudaEventRecord            hipEventRecord
+#define cudaEventSynchronize       hipEventSynchronize
+#define cudaEventElapsedTime       hipEventElapsedTime
+#define cudaStreamWaitEvent        hipStreamWaitEvent
+
+using cudaExternalMemory_t = hipExternalMemory_t;
+#define cudaExternalMemoryHandleDesc        hipExternalMemoryHandleDesc
+#define cudaExternalMemoryBufferDesc        hipExternalMemoryBufferDesc
+#define cudaExternalMemoryHandleTypeOpaqueFd hipExternalMemoryHandleTypeOpaqueFd
+#define cudaImportExternalMemory            hipImportExternalMemory
+#define cudaExternalMemoryGetMappedBuffer   hipExternalMemoryGetMappedBuffer
+#define cudaDestroyExternalMemory           hipDestroyExternalMemory
+
 // ------------------------------------------------------------------
 // memory
 // ------------------------------------------------------------------
@@ -58,6 +86,7 @@ using cudaStream_t = hipStream_t;
 #define cudaMallocManaged     hipMallocManaged
 #define cudaMallocHost        hipHostMalloc
 #define cudaFree              hipFree
+#define cudaMemGetInfo        hipMemGetInfo
 #define cudaFreeHost          hipHostFree
 #define cudaMemcpy            hipMemcpy
 #define cudaMemcpyAsync       hipMemcpyAsync
@@ -66,6 +95,30 @@ using cudaStream_t = hipStream_t;
 #define cudaMemcpyHostToDevice  hipMemcpyHostToDevice
 #define cudaMemcpyDeviceToHost  hipMemcpyDeviceToHost
 
+// stream-ordered memory pools
+using cudaMemPool_t        = hipMemPool_t;
+using cudaMemPoolProps     = hipMemPoolProps;
+using cudaMemAccessDesc    = hipMemAccessDesc;
+#define cudaMemPoolCreate          hipMemPoolCreate
+#define cudaMemPoolDestroy         hipMemPoolDestroy
+#define cudaMemPoolSetAttribute    hipMemPoolSetAttribute
+#define cudaMemPoolGetAttribute    hipMemPoolGetAttribute
+#define cudaMemPoolSetAccess       hipMemPoolSetAccess
+#define cudaMemPoolTrimTo          hipMemPoolTrimTo
+#define cudaMallocFromPoolAsync    hipMallocFromPoolAsync
+#define cudaFreeAsync              hipFreeAsync
+#define cudaMemAdvise              hipMemAdvise
+#define cudaMemAdviseSetReadMostly hipMemAdviseSetReadMostly
+#define cudaMemPrefetchAsync       hipMemPrefetchAsync
+#define cudaMemAllocationTypePinned      hipMemAllocationTypePinned
+#define cudaMemLocationTypeDevice        hipMemLocationTypeDevice
+#define cudaMemAccessFlagsProtReadWrite  hipMemAccessFlagsProtReadWrite
+#define cudaMemPoolAttrReleaseThreshold  hipMemPoolAttrReleaseThreshold
+#define cudaMemPoolAttrReservedMemCurrent hipMemPoolAttrReservedMemCurrent
+#define cudaMemPoolAttrUsedMemCurrent    hipMemPoolAttrUsedMemCurrent
+#define cudaDevAttrMemoryPoolsSupported  hipDeviceAttributeMemoryPoolsSupported
+#define cudaErrorMemoryAllocation        hipErrorOutOfMemory
+
 // ------------------------------------------------------------------
 // textures and arrays (cudaArray-backed, no pitched 2D binds)
 // ------------------------------------------------------------------
@@ -79,6 +132,8 @@ using cudaMemcpy3DParms     = hipMemcpy3DParms;
 using cudaTextureFilterMode  = hipTextureFilterMode;
 using cudaTextureAddressMode = hipTextureAddressMode;
 using cudaTextureReadMode    = hipTextureReadMode;
+using cudaMipmappedArray_t   = hipMipmappedArray_t;
+using cudaSurfaceObject_t    = hipSurfaceObject_t;
 
 #define cudaCreateChannelDesc      hipCreateChannelDesc
 #define cudaCreateTextureObject    hipCreateTextureObject
@@ -87,8 +142,25 @@ using cudaTextureReadMode    = hipTextureReadMode;
 #define cudaMalloc3DArray          hipMalloc3DArray
 #define cudaFreeArray              hipFreeArray
 #define cudaMemcpy2DToArray        hipMemcpy2DToArray
+#define cudaMemcpy2DToArrayAsync   hipMemcpy2DToArrayAsync
 #define cudaMemcpy3D               hipMemcpy3D
+#define cudaMemcpy3DAsync          hipMemcpy3DAsync
 #define make_cudaPitchedPtr        make_hipPitchedPtr
+#define make_cudaExtent            make_hipExtent
+#define cudaMallocMipmappedArray   hipMallocMipmappedArray
+#define cudaFreeMipmappedArray     hipFreeMipmappedArray
+#define cudaGetMipmappedArrayLevel hipGetMipmappedArrayLevel
+#define cudaCreateSurfaceObject    hipCreateSurfaceObject
+#define cudaDestroySurfaceObject   hipDestroySurfaceObject
+#define cudaArraySurfaceLoadStore  hipArraySurfaceLoadStore
+#define cudaMemcpyDeviceToDevice   hipMemcpyDeviceToDevice
+#define cudaResourceTypeMipmappedArray hipResourceTypeMipmappedArray
+#define cudaChannelFormatKindUnsignedBlockCompressed1  hipChannelFormatKindUnsignedBlockCompressed1
+#define cudaChannelFormatKindUnsignedBlockCompressed3  hipChannelFormatKindUnsignedBlockCompressed3
+#define cudaChannelFormatKindUnsignedBlockCompressed4  hipChannelFormatKindUnsignedBlockCompressed4
+#define cudaChannelFormatKindUnsignedBlockCompressed5  hipChannelFormatKindUnsignedBlockCompressed5
+#define cudaChannelFormatKindUnsignedBlockCompressed6H hipChannelFormatKindUnsignedBlockCompressed6H
+#define cudaChannelFormatKindUnsignedBlockCompressed7  hipChannelFormatKindUnsignedBlockCompressed7
 
 #define cudaResourceTypeArray      hipResourceTypeArray
 #define cudaReadModeElementType    hipReadModeElementType
@@ -0,0 +1,217 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "rtcore/embree/Allocator.h"
+#include "rtcore/embree/ComputeInterface.h"
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+namespace rtc {
+  namespace embree {
+
+#ifdef __linux__
+    /* from <numaif.h>; spelled out so we don't need libnuma */
+    enum { BARNEY_MPOL_INTERLEAVE = 3 };
+
+    /*! parses /sys/devices/system/node/online (eg, "0-3,6") into a
+        node bit mask; empty if there's only a single node anyway */
+    static std::vector<unsigned long> onlineNumaNodes()
+    {
+      std::vector<unsigned long> mask;
+      std::ifstream in("/sys/devices/system/node/online");
+      std::string list;
+      if (!(in >> list)) return mask;
+      int numNodes = 0;
+      std::stringstream ss(list);
+      std::string range;
+      while (std::getline(ss,range,',')) {
+        int lo = 0, hi = 0;
+        size_t dash = range.find('-');
+        lo = hi = std::stoi(range.substr(0,dash));
+        if (dash != std::string::npos)
+          hi = std::stoi(range.substr(dash+1));
+        for (int node=lo;node<=hi;node++) {
+          const int bitsPerWord = 8*sizeof(unsigned long);
+          if (node/bitsPerWord >= (int)mask.size())
+            mask.resize(node/bitsPerWord+1,0);
+          mask[node/bitsPerWord] |= 1ul<<(node%bitsPerWord);
+          numNodes++;
+        }
+      }
+      if (numNodes < 2) mask.clear();
+      return mask;
+    }
+#endif
+
+    MemoryArena::MemoryArena(LaunchSystem *ls)
+      : ls(ls)
+    {
+      const char *numa = getenv("BARNEY_CPU_NUMA");
+#ifdef __linux__
+      if (numa && std::string(numa) == "interleave") {
+        numaNodeMask = onlineNumaNodes();
+        interleave = !numaNodeMask.empty();
+      }
+#endif
+      useHugeTLB = getenv("BARNEY_CPU_HUGETLB") != nullptr;
+      const char *cacheMB = getenv("BARNEY_CPU_ARENA_CACHE_MB");
+      maxBytesCached = (cacheMB ? std::stoull(cacheMB) : 1024ull) << 20;
+    }
+
+    MemoryArena::~MemoryArena()
+    {
+      trim();
+      /* whatever's still live got leaked by the user; the process'
+         exit will take care of that */
+    }
+
+    size_t MemoryArena::sizeClassOf(size_t numBytes)
+    {
+      size_t size = divRoundUp(numBytes,hugePageSize)*hugePageSize;
+      size_t pow2 = hugePageSize;
+      while (2*pow2 <= size) pow2 *= 2;
+      size_t step = std::max(pow2/4,hugePageSize);
+      return divRoundUp(size,step)*step;
+    }
+
+    void *MemoryArena::mapPages(size_t numBytes, bool &hugeTLB)
+    {
+#ifdef __linux__
+      void *mem = MAP_FAILED;
+      hugeTLB = false;
+      if (useHugeTLB) {
+        /* only works if the admin reserved enough huge pages; if not,
+           silently fall back to transparent ones */
+        mem = mmap(nullptr,numBytes,PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+        hugeTLB = (mem != MAP_FAILED);
+      }
+      if (mem == MAP_FAILED) {
+        /* over-allocate by a huge page, then cut off the unaligned
+           ends, so transparent huge pages can back all of it */
+        size_t mappedBytes = numBytes+hugePageSize;
+        uint8_t *raw = (uint8_t *)mmap(nullptr,mappedBytes,
+                                       PROT_READ|PROT_WRITE,
+                                       MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+        if ((void*)raw == MAP_FAILED)
+          return nullptr;
+        uint8_t *aligned
+          = (uint8_t *)(divRoundUp((size_t)raw,hugePageSize)*hugePageSize);
+        if (aligned > raw)
+          munmap(raw,aligned-raw);
+        if (raw+mappedBytes > aligned+numBytes)
+          munmap(aligned+numBytes,(raw+mappedBytes)-(aligned+numBytes));
+        mem = aligned;
+        madvise(mem,numBytes,MADV_HUGEPAGE);
+      }
+      if (interleave)
+        syscall(SYS_mbind,mem,numBytes,(int)BARNEY_MPOL_INTERLEAVE,
+                numaNodeMask.data(),
+                (unsigned long)(8*sizeof(unsigned long)*numaNodeMask.size()+1),
+                0u);
+      return mem;
+#else
+      hugeTLB = false;
+      return malloc(numBytes);
+#endif
+    }
+
+    void MemoryArena::unmapPages(void *mem, size_t numBytes, bool hugeTLB)
+    {
+#ifdef __linux__
+      munmap(mem,numBytes);
+#else
+      ::free(mem);
+#endif
+    }
+
+    void *MemoryArena::alloc(size_t numBytes)
+    {
+      if (!numBytes) return nullptr;
+      if (numBytes < minLargeSize)
+        return malloc(numBytes);
+
+      const size_t sizeClass = sizeClassOf(numBytes);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cached.find(sizeClass);
+        if (it != cached.end() && !it->second.empty()) {
+          auto recycled = it->second.back();
+          it->second.pop_back();
+          numBytesCached -= sizeClass;
+          live[recycled.first] = recycled.second;
+          /* re-used pages stay where they were first placed; for
+             same-sized buffers that's where they're needed */
+          return recycled.first;
+        }
+      }
+
+      Mapping mapping;
+      mapping.numBytes = sizeClass;
+      void *mem = mapPages(sizeClass,mapping.hugeTLB);
+      if (!mem) {
+        /* maybe we're holding on to what's needed */
+        trim();
+        mem = mapPages(sizeClass,mapping.hugeTLB);
+      }
+      if (!mem)
+        throw std::runtime_error("out of memory allocating "
+                                 +prettyNumber(numBytes)+"B");
+      /* fresh pages haven't been faulted in yet; have the workers do
+         that, so each worker's share of the buffer lands on its numa
+         node */
+      if (!interleave)
+        ls->firstTouch(mem,sizeClass);
+      std::lock_guard<std::mutex> lock(mutex);
+      live[mem] = mapping;
+      return mem;
+    }
+
+    void MemoryArena::free(void *mem)
+    {
+      if (!mem) return;
+      Mapping mapping;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = live.find(mem);
+        if (it == live.end()) {
+          /* not one of ours, so it came from malloc */
+          ::free(mem);
+          return;
+        }
+        mapping = it->second;
+        live.erase(it);
+        if (numBytesCached+mapping.numBytes <= maxBytesCached) {
+          cached[mapping.numBytes].push_back({mem,mapping});
+          numBytesCached += mapping.numBytes;
+          return;
+        }
+      }
+      unmapPages(mem,mapping.numBytes,mapping.hugeTLB);
+    }
+
+    size_t MemoryArena::cachedBytes()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return numBytesCached;
+    }
+
+    void MemoryArena::trim()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto &sizeClass : cached)
+        for (auto &buffer : sizeClass.second)
+          unmapPages(buffer.first,buffer.second.numBytes,
+                     buffer.second.hugeTLB);
+      cached.clear();
+      numBytesCached = 0;
+    }
+
+  }
+}
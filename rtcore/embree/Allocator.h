@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "rtcore/embree/embree-common.h"
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rtc {
+  namespace embree {
+
+    struct LaunchSystem;
+
+    /*! the cpu backend's 'device' memory. Small allocations simply go
+        to malloc; large ones (ray queues, frame buffer tiles, volume
+        data, ...) get mapped directly, 2MB-aligned and with huge pages
+        requested, and get placed across numa nodes as configured.
+        Freed large buffers get rounded to a size class and kept for
+        re-use (up to some limit), since barney frees and re-allocates
+        the same sizes over and over on every resize.
+
+        Configured through the environment:
+        BARNEY_CPU_NUMA=interleave - interleave large buffers' pages
+          across all numa nodes (default: first touch, by the workers
+          that will later process them)
+        BARNEY_CPU_HUGETLB - use explicit (reserved) huge pages rather
+          than transparent ones, if any are available
+        BARNEY_CPU_ARENA_CACHE_MB - how much freed memory to keep
+          around for re-use (default 1024)
+    */
+    struct MemoryArena {
+      MemoryArena(LaunchSystem *ls);
+      ~MemoryArena();
+
+      void *alloc(size_t numBytes);
+      void free(void *mem);
+
+      /*! releases all cached (ie, freed but kept) memory */
+      void trim();
+      /*! how much freed memory is currently being kept for re-use */
+      size_t cachedBytes();
+
+      /*! allocations smaller than that go to plain malloc */
+      static constexpr size_t minLargeSize = size_t(1)<<20;
+      static constexpr size_t hugePageSize = size_t(2)<<20;
+
+      /*! rounds given size up to a multiple of the huge page size,
+          and then to one of four steps between powers of two; so at
+          most 25% get wasted, and "about the same" sizes get to
+          re-use each other's memory */
+      static size_t sizeClassOf(size_t numBytes);
+
+    private:
+      void *mapPages(size_t numBytes, bool &hugeTLB);
+      void unmapPages(void *mem, size_t numBytes, bool hugeTLB);
+
+      struct Mapping {
+        size_t numBytes;
+        bool   hugeTLB;
+      };
+
+      std::mutex mutex;
+      /*! all large allocations currently handed out, by address */
+      std::unordered_map<void *,Mapping> live;
+      /*! freed large allocations, by size class */
+      std::map<size_t,std::vector<std::pair<void *,Mapping>>> cached;
+      size_t numBytesCached = 0;
+      size_t maxBytesCached = 0;
+
+      bool interleave = false;
+      bool useHugeTLB = false;
+      /*! bit mask of the online numa nodes, for interleaving */
+      std::vector<unsigned long> numaNodeMask;
+      LaunchSystem *const ls;
+    };
+
+  }
+}
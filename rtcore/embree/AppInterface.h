@@ -19,6 +19,9 @@ namespace rtc {
     
     /*! get a unique hash for a given physical device. */
     size_t getPhysicalDeviceHash(int gpuID);
+
+    /*! numa node of given device; always -1 on the cpu */
+    int getNumaNode(int gpuID);
     
   }
 }
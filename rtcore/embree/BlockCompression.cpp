@@ -0,0 +1,367 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "rtcore/embree/BlockCompression.h"
+
+namespace rtc {
+  namespace embree {
+
+    /*! one decoded 4x4 block, texels in row-major order */
+    typedef uint8_t DecodedBlock[16][4];
+
+    /*! the bits of a (up to 128-bit) block, read lsb-first */
+    struct BlockBits {
+      BlockBits(const uint8_t *block)
+      {
+        memcpy(&lo,block,8);
+        memcpy(&hi,block+8,8);
+      }
+      uint32_t read(int numBits)
+      {
+        uint32_t result = 0;
+        for (int i=0;i<numBits;i++,pos++) {
+          uint64_t word = (pos < 64) ? lo : hi;
+          result |= uint32_t((word >> (pos & 63)) & 1) << i;
+        }
+        return result;
+      }
+      uint64_t lo, hi;
+      int      pos = 0;
+    };
+
+    // ==================================================================
+    // BC1-BC5
+    // ==================================================================
+
+    static void expand565(uint16_t c, uint8_t rgba[4])
+    {
+      int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+      rgba[0] = uint8_t((r << 3) | (r >> 2));
+      rgba[1] = uint8_t((g << 2) | (g >> 4));
+      rgba[2] = uint8_t((b << 3) | (b >> 2));
+      rgba[3] = 255;
+    }
+
+    /*! the 8-byte color part of BC1 and BC3; BC3 always uses the
+        four-color palette, BC1 only if c0 > c1 */
+    static void decodeColorBlock(const uint8_t *block,
+                                 DecodedBlock out,
+                                 bool alwaysFourColors)
+    {
+      uint16_t c0 = uint16_t(block[0] | (block[1] << 8));
+      uint16_t c1 = uint16_t(block[2] | (block[3] << 8));
+      uint8_t palette[4][4];
+      expand565(c0,palette[0]);
+      expand565(c1,palette[1]);
+      for (int c=0;c<3;c++) {
+        int p0 = palette[0][c], p1 = palette[1][c];
+        if (alwaysFourColors || c0 > c1) {
+          palette[2][c] = uint8_t((2*p0+p1+1)/3);
+          palette[3][c] = uint8_t((p0+2*p1+1)/3);
+        } else {
+          palette[2][c] = uint8_t((p0+p1+1)/2);
+          palette[3][c] = 0;
+        }
+      }
+      palette[2][3] = 255;
+      palette[3][3] = (alwaysFourColors || c0 > c1) ? 255 : 0;
+
+      uint32_t indices
+        = uint32_t(block[4])
+        | uint32_t(block[5]) << 8
+        | uint32_t(block[6]) << 16
+        | uint32_t(block[7]) << 24;
+      for (int i=0;i<16;i++)
+        memcpy(out[i],palette[(indices >> (2*i)) & 3],4);
+    }
+
+    /*! the 8-byte single-channel block of BC4 (and of BC3's alpha,
+        and each of BC5's two channels) */
+    static void decodeChannelBlock(const uint8_t *block,
+                                   DecodedBlock out,
+                                   int channel)
+    {
+      int r0 = block[0], r1 = block[1];
+      uint8_t palette[8];
+      palette[0] = uint8_t(r0);
+      palette[1] = uint8_t(r1);
+      if (r0 > r1) {
+        for (int i=2;i<8;i++)
+          palette[i] = uint8_t(((8-i)*r0+(i-1)*r1+3)/7);
+      } else {
+        for (int i=2;i<6;i++)
+          palette[i] = uint8_t(((6-i)*r0+(i-1)*r1+2)/5);
+        palette[6] = 0;
+        palette[7] = 255;
+      }
+      uint64_t indices = 0;
+      for (int i=0;i<6;i++)
+        indices |= uint64_t(block[2+i]) << (8*i);
+      for (int i=0;i<16;i++)
+        out[i][channel] = palette[(indices >> (3*i)) & 7];
+    }
+
+    // ==================================================================
+    // BC7
+    // ==================================================================
+
+    struct BC7Mode {
+      int numSubsets;
+      int partitionBits;
+      int rotationBits;
+      int indexSelectionBits;
+      int colorBits;
+      int alphaBits;
+      int endpointPBits;
+      int sharedPBits;
+      int indexBits;
+      int secondaryIndexBits;
+    };
+
+    static const BC7Mode bc7Modes[8] = {
+      { 3,4,0,0,4,0,1,0,3,0 },
+      { 2,6,0,0,6,0,0,1,3,0 },
+      { 3,6,0,0,5,0,0,0,2,0 },
+      { 2,6,0,0,7,0,1,0,2,0 },
+      { 1,0,2,1,5,6,0,0,2,3 },
+      { 1,0,2,0,7,8,0,0,2,2 },
+      { 1,0,0,0,7,7,1,0,4,0 },
+      { 2,6,0,0,5,5,1,0,2,0 },
+    };
+
+    /*! subset of each texel (bit i for texel i), per partition */
+    static const uint16_t bc7Partitions2[64] = {
+      0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+      0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+      0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+      0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+      0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+      0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+      0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+      0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+    };
+
+    /*! subset of each texel (bits 2i,2i+1 for texel i), per
+        partition */
+    static const uint32_t bc7Partitions3[64] = {
+      0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8,
+      0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+      0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090,
+      0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+      0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0,
+      0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+      0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400,
+      0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+      0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424,
+      0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+      0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0,
+      0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+      0xaa444444, 0x54a854a8, 0x95809580, 0x96969600,
+      0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+      0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000,
+      0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+    };
+
+    /*! texels whose index has an implicit zero msb: texel 0 for the
+        first subset, and these for the others */
+    static const uint8_t bc7Anchors2[64] = {
+      15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+      15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+      15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+       6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+    };
+    static const uint8_t bc7Anchors3a[64] = {
+       3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+       3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+       8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+       3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+    };
+    static const uint8_t bc7Anchors3b[64] = {
+      15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+      15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+      15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+      15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+    };
+
+    static int bc7Interpolate(int e0, int e1, int index, int indexBits)
+    {
+      static const int weights2[4]
+        = { 0,21,43,64 };
+      static const int weights3[8]
+        = { 0,9,18,27,37,46,55,64 };
+      static const int weights4[16]
+        = { 0,4,9,13,17,21,26,30,34,38,43,47,51,55,60,64 };
+      int w
+        = (indexBits == 2) ? weights2[index]
+        : (indexBits == 3) ? weights3[index]
+        : weights4[index];
+      return ((64-w)*e0 + w*e1 + 32) >> 6;
+    }
+
+    /*! expands a 'precision'-bit endpoint component to 8 bits */
+    static int bc7Unquantize(int v, int precision)
+    {
+      v = v << (8-precision);
+      return v | (v >> precision);
+    }
+
+    static void decodeBC7(const uint8_t *block, DecodedBlock out)
+    {
+      int mode = 0;
+      while (mode < 8 && !(block[0] & (1<<mode)))
+        mode++;
+      if (mode == 8) {
+        /* reserved; decodes to transparent black */
+        memset(out,0,sizeof(DecodedBlock));
+        return;
+      }
+      const BC7Mode &m = bc7Modes[mode];
+      BlockBits bits(block);
+      bits.read(mode+1);
+      int partition      = bits.read(m.partitionBits);
+      int rotation       = bits.read(m.rotationBits);
+      int indexSelection = bits.read(m.indexSelectionBits);
+
+      const int numEndpoints = 2*m.numSubsets;
+      int endpoints[6][4];
+      for (int c=0;c<3;c++)
+        for (int e=0;e<numEndpoints;e++)
+          endpoints[e][c] = bits.read(m.colorBits);
+      for (int e=0;e<numEndpoints;e++)
+        endpoints[e][3] = m.alphaBits ? bits.read(m.alphaBits) : 255;
+
+      int colorPrecision = m.colorBits;
+      int alphaPrecision = m.alphaBits;
+      if (m.endpointPBits) {
+        for (int e=0;e<numEndpoints;e++) {
+          int p = bits.read(1);
+          for (int c=0;c<3;c++)
+            endpoints[e][c] = (endpoints[e][c] << 1) | p;
+          if (m.alphaBits)
+            endpoints[e][3] = (endpoints[e][3] << 1) | p;
+        }
+        colorPrecision++;
+        if (m.alphaBits) alphaPrecision++;
+      }
+      if (m.sharedPBits) {
+        for (int s=0;s<m.numSubsets;s++) {
+          int p = bits.read(1);
+          for (int e=2*s;e<2*s+2;e++)
+            for (int c=0;c<3;c++)
+              endpoints[e][c] = (endpoints[e][c] << 1) | p;
+        }
+        colorPrecision++;
+      }
+      for (int e=0;e<numEndpoints;e++) {
+        for (int c=0;c<3;c++)
+          endpoints[e][c] = bc7Unquantize(endpoints[e][c],colorPrecision);
+        if (m.alphaBits)
+          endpoints[e][3] = bc7Unquantize(endpoints[e][3],alphaPrecision);
+      }
+
+      auto subsetOf = [&](int i) -> int {
+        if (m.numSubsets == 2) return (bc7Partitions2[partition] >> i) & 1;
+        if (m.numSubsets == 3) return (bc7Partitions3[partition] >> (2*i)) & 3;
+        return 0;
+      };
+      auto isAnchor = [&](int i) -> bool {
+        if (i == 0) return true;
+        if (m.numSubsets == 2)
+          return i == bc7Anchors2[partition];
+        if (m.numSubsets == 3)
+          return i == bc7Anchors3a[partition] || i == bc7Anchors3b[partition];
+        return false;
+      };
+      int indices[16], secondaryIndices[16];
+      for (int i=0;i<16;i++)
+        indices[i] = bits.read(m.indexBits-(isAnchor(i)?1:0));
+      if (m.secondaryIndexBits)
+        for (int i=0;i<16;i++)
+          secondaryIndices[i] = bits.read(m.secondaryIndexBits-(i==0?1:0));
+
+      for (int i=0;i<16;i++) {
+        const int *e0 = endpoints[2*subsetOf(i)+0];
+        const int *e1 = endpoints[2*subsetOf(i)+1];
+        int colorIndex = indices[i], colorIndexBits = m.indexBits;
+        int alphaIndex = indices[i], alphaIndexBits = m.indexBits;
+        if (m.secondaryIndexBits) {
+          if (indexSelection) {
+            colorIndex     = secondaryIndices[i];
+            colorIndexBits = m.secondaryIndexBits;
+          } else {
+            alphaIndex     = secondaryIndices[i];
+            alphaIndexBits = m.secondaryIndexBits;
+          }
+        }
+        for (int c=0;c<3;c++)
+          out[i][c] = uint8_t(bc7Interpolate(e0[c],e1[c],colorIndex,colorIndexBits));
+        out[i][3] = uint8_t(bc7Interpolate(e0[3],e1[3],alphaIndex,alphaIndexBits));
+        if (rotation)
+          std::swap(out[i][3],out[i][rotation-1]);
+      }
+    }
+
+    // ==================================================================
+
+    DataType decodedFormatOf(DataType format)
+    {
+      return (format == BC4) ? UCHAR : UCHAR4;
+    }
+
+    std::vector<uint8_t> decodeBlocks(DataType format,
+                                      vec2i dims,
+                                      const void *blocks)
+    {
+      if (format == BC6H)
+        throw std::runtime_error
+          ("BC6H textures are not supported on the cpu backend");
+      const int numChannels = (decodedFormatOf(format) == UCHAR) ? 1 : 4;
+      std::vector<uint8_t> texels(size_t(dims.x)*dims.y*numChannels);
+      const int numBlocksX = divRoundUp(dims.x,4);
+      const int numBlocksY = divRoundUp(dims.y,4);
+      const size_t blockSize = numBytesPerBlock(format);
+      const uint8_t *block = (const uint8_t *)blocks;
+      for (int by=0;by<numBlocksY;by++)
+        for (int bx=0;bx<numBlocksX;bx++,block+=blockSize) {
+          DecodedBlock decoded;
+          switch (format) {
+          case BC1:
+            decodeColorBlock(block,decoded,false);
+            break;
+          case BC3:
+            decodeColorBlock(block+8,decoded,true);
+            decodeChannelBlock(block,decoded,3);
+            break;
+          case BC4:
+            decodeChannelBlock(block,decoded,0);
+            break;
+          case BC5:
+            decodeChannelBlock(block,decoded,0);
+            decodeChannelBlock(block+8,decoded,1);
+            for (int i=0;i<16;i++) {
+              decoded[i][2] = 0;
+              decoded[i][3] = 255;
+            }
+            break;
+          case BC7:
+            decodeBC7(block,decoded);
+            break;
+          default:
+            throw std::runtime_error("not a block-compressed format");
+          }
+          /* blocks along the right and bottom edges may stick out of
+             the image */
+          for (int iy=0;iy<4;iy++)
+            for (int ix=0;ix<4;ix++) {
+              int x = 4*bx+ix, y = 4*by+iy;
+              if (x >= dims.x || y >= dims.y) continue;
+              memcpy(&texels[(x+size_t(y)*dims.x)*numChannels],
+                     decoded[ix+4*iy],numChannels);
+            }
+        }
+      return texels;
+    }
+
+  }
+}
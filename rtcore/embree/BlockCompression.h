@@ -0,0 +1,26 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "rtcore/embree/embree-common.h"
+
+namespace rtc {
+  namespace embree {
+
+    /*! the (uncompressed) format that decodeBlocks() turns given
+        block-compressed format into: UCHAR for BC4, UCHAR4 for all
+        others (with BC5's blue and alpha set to 0 and 1) */
+    DataType decodedFormatOf(DataType format);
+
+    /*! decodes a 2D image of BCn blocks (see rtc::BC1 etc) into
+        plain texels of decodedFormatOf(format). The cpu backend
+        does all of its sampling on those; only saves the app from
+        having to ship both versions. BC6H isn't supported yet */
+    std::vector<uint8_t> decodeBlocks(DataType format,
+                                      vec2i dims,
+                                      const void *blocks);
+
+  }
+}
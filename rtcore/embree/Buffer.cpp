@@ -10,21 +10,22 @@ namespace rtc {
     Buffer::Buffer(Device *device,
                    size_t numBytes,
                    const void *initMem)
+      : device(device)
     {
-      mem = numBytes?malloc(numBytes):nullptr;
+      mem = device->allocMem(numBytes);
       if (initMem)
         memcpy(mem,initMem,numBytes);
     }
     
     Buffer::~Buffer()
     {
-      if (mem) free(mem);
+      device->freeMem(mem);
     }
 
     void Buffer::resize(size_t numBytes)
     {
-      if (mem) free(mem);
-      mem = numBytes?malloc(numBytes):nullptr;
+      device->freeMem(mem);
+      mem = device->allocMem(numBytes);
     }
     
     void *Buffer::getDD() const
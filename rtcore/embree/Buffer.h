@@ -22,6 +22,7 @@ namespace rtc {
 
       void *getDD() const;
       void *mem = 0;
+      Device *const device;
     };
 
   }
@@ -7,75 +7,251 @@
 #include <owl/common/parallel/parallel_for.h>
 #include <mutex>
 #include <thread>
-#include <condition_variable>
-#include <barrier>
+#include <algorithm>
+#ifdef __linux__
+# include <sched.h>
+# include <pthread.h>
+#endif
 #include "rtcore/embree/TraceInterface.h"
 
 namespace rtc {
   namespace embree {
 
-    int numThreads() {
-      int nt = std::thread::hardware_concurrency();
-#if 0
-      int maxNumThreads = 1;
-#else
-      int maxNumThreads = 1<<30;
+    /*! the cpus this process may run on - which, when run through
+        mpirun with binding, is only this rank's share of the node */
+    static std::vector<int> availableCPUs()
+    {
+      std::vector<int> cpus;
+#ifdef __linux__
+      cpu_set_t mask;
+      if (sched_getaffinity(0,sizeof(mask),&mask) == 0)
+        for (int i=0;i<CPU_SETSIZE;i++)
+          if (CPU_ISSET(i,&mask)) cpus.push_back(i);
 #endif
-      return std::min(nt,maxNumThreads);
+      if (cpus.empty())
+        for (int i=0;i<(int)std::thread::hardware_concurrency();i++)
+          cpus.push_back(i);
+      if (cpus.empty())
+        cpus.push_back(0);
+      return cpus;
     }
+
+    static void pinThisThread(int cpu)
+    {
+#ifdef __linux__
+      cpu_set_t mask;
+      CPU_ZERO(&mask);
+      CPU_SET(cpu,&mask);
+      pthread_setaffinity_np(pthread_self(),sizeof(mask),&mask);
+#endif
+    }
+
+    /*! one round of polling; every once in a while gives up the
+        core, in case whoever we wait for shares it with us */
+    static inline void backOff(int spins)
+    {
+      if (spins % 64 == 0)
+        std::this_thread::yield();
+#if defined(__x86_64__) || defined(__i386__)
+      else
+        __builtin_ia32_pause();
+#endif
+    }
+
+    /*! how long to poll for the next launch (or for a launch to
+        complete) before going to sleep; that way back-to-back small
+        launches don't pay for waking up threads */
+    enum { numSpinsBeforeSleep = 1<<12 };
+
+    static inline uint64_t packRange(int begin, int end)
+    { return (uint64_t(uint32_t(end))<<32) | uint64_t(uint32_t(begin)); }
     
     LaunchSystem::LaunchSystem()
-      : barrier(numThreads()+1,[]() noexcept {})
     {
-      threads.reserve(numThreads());
-      for (int i=0;i<numThreads();i++)
-        threads.emplace_back([this](){ this->threadFct(); });
+      std::vector<int> cpus = availableCPUs();
+      numWorkers = (int)cpus.size();
+      queues = std::vector<Queue>(numWorkers);
+      const bool pin = getenv("BARNEY_CPU_NO_PINNING") == nullptr;
+      threads.reserve(numWorkers);
+      for (int i=0;i<numWorkers;i++) {
+        int cpu = cpus[i];
+        threads.emplace_back([this,i,cpu,pin](){
+          if (pin) pinThisThread(cpu);
+          this->threadFct(i);
+        });
+      }
+    }
 
-      barrier.arrive_and_wait();
+    LaunchSystem::~LaunchSystem()
+    {
+      quit = true;
+      launchID++;
+      launchID.notify_all();
+      for (auto &thread : threads)
+        thread.join();
     }
     
-    void LaunchSystem::launchAndWait(int numTotal, Task *task)
+    bool LaunchSystem::takeFront(Queue &queue, int maxCount,
+                                 int &begin, int &end)
     {
-      // enqueue job
-      std::lock_guard<std::mutex> lock(mutex);
+      uint64_t range = queue.range.load(std::memory_order_relaxed);
+      while (true) {
+        int b = int(uint32_t(range));
+        int e = int(range>>32);
+        if (b >= e) return false;
+        int n = std::min(maxCount,e-b);
+        if (queue.range.compare_exchange_weak(range,packRange(b+n,e))) {
+          begin = b;
+          end   = b+n;
+          return true;
+        }
+      }
+    }
+    
+    bool LaunchSystem::stealBack(Queue &queue, int maxCount,
+                                 int &begin, int &end)
+    {
+      uint64_t range = queue.range.load(std::memory_order_relaxed);
+      while (true) {
+        int b = int(uint32_t(range));
+        int e = int(range>>32);
+        if (b >= e) return false;
+        int n = std::min(maxCount,(e-b+1)/2);
+        if (queue.range.compare_exchange_weak(range,packRange(b,e-n))) {
+          begin = e-n;
+          end   = e;
+          return true;
+        }
+      }
+    }
+
+    void LaunchSystem::work(int workerID, bool allowStealing)
+    {
+      int begin, end;
+      while (true) {
+        if (workerID >= 0)
+          while (takeFront(queues[workerID],chunkSize,begin,end))
+            for (int i=begin;i<end;i++)
+              task->run(i);
+        if (!allowStealing)
+          return;
+
+        /* start with the next workers; with pinning those are the
+           ones most likely on the same socket. Workers put what
+           they steal into their own queue, so that can get stolen
+           from again; the launching thread only helps out with
+           single chunks */
+        bool stole = false;
+        for (int d=1;d<=numWorkers && !stole;d++) {
+          int victim = (workerID+d+numWorkers) % numWorkers;
+          if (victim == workerID) continue;
+          stole = stealBack(queues[victim],
+                            workerID >= 0 ? (1<<30) : chunkSize,
+                            begin,end);
+        }
+        if (!stole)
+          return;
+        if (workerID >= 0)
+          queues[workerID].range.store(packRange(begin,end));
+        else
+          for (int i=begin;i<end;i++)
+            task->run(i);
+      }
+    }
+    
+    void LaunchSystem::launchAndWait(int numTotal, Task *task,
+                                     bool allowStealing)
+    {
+      if (numTotal <= 0)
+        return;
+      if (numTotal == 1 && allowStealing) {
+        /* waking up workers costs more than running a single job */
+        task->run(0);
+        return;
+      }
       
-      // workers are waiting on barrier here
+      std::lock_guard<std::mutex> lock(mutex);
       this->task = task;
-      this->numJobs.total = numTotal;
-      this->numJobs.taken = 0;
-      
-      this->barrier.arrive_and_wait();
-      // workers do the work here
+      this->allowStealing = allowStealing;
+      /* small enough chunks to balance well, but large enough that
+         workers don't keep hitting their queue's cache line */
+      /* reserved workers stay out of it, but firstTouch() needs
+         everybody */
+      this->numActive
+        = allowStealing ? numWorkers-numReserved : numWorkers;
+      this->chunkSize = std::max(1,numTotal/(16*numActive));
+      for (int i=0;i<numWorkers;i++) {
+        int begin = int((int64_t(numTotal)*std::min(i,numActive))/numActive);
+        int end   = int((int64_t(numTotal)*std::min(i+1,numActive))/numActive);
+        queues[i].range.store(packRange(begin,end),std::memory_order_relaxed);
+      }
+      numBusy = numWorkers;
+      launchID++;
+      if (numSleeping > 0)
+        launchID.notify_all();
+
+      if (allowStealing)
+        work(-1,true);
 
-      this->barrier.arrive_and_wait();
+      int spins = 0;
+      int busy;
+      while ((busy = numBusy) != 0) {
+        if (++spins < numSpinsBeforeSleep) { backOff(spins); continue; }
+        launcherSleeping = true;
+        numBusy.wait(busy);
+      }
+      launcherSleeping = false;
     }
 
+    void LaunchSystem::firstTouch(void *mem, size_t numBytes)
+    {
+      uint8_t *bytes = (uint8_t *)mem;
+      const size_t numParts = numWorkers;
+      TaskWrapper task([&](int part)
+      {
+        size_t begin = (numBytes*part)/numParts;
+        size_t end   = (numBytes*(part+1))/numParts;
+        memset(bytes+begin,0,end-begin);
+      });
+      /* without stealing, part i gets done by worker i */
+      launchAndWait(numWorkers,&task,false);
+    }
+    
     LaunchSystem *createLaunchSystem() { return new LaunchSystem; }
     
-    void LaunchSystem::threadFct()
+    void LaunchSystem::threadFct(int workerID)
     {
-      barrier.arrive_and_wait();
+      uint32_t seen = 0;
       while (true) {
-
         // ------------------------------------------------------------------
         // wait for control thread to submit work
         // ------------------------------------------------------------------
-        barrier.arrive_and_wait();
+        uint32_t current;
+        int spins = 0;
+        while ((current = launchID) == seen) {
+          /* reserved workers don't spin on cores the denoiser uses */
+          const bool reserved = workerID >= numWorkers-numReserved;
+          if (!reserved && ++spins < numSpinsBeforeSleep)
+            { backOff(spins); continue; }
+          numSleeping++;
+          launchID.wait(seen);
+          numSleeping--;
+        }
+        seen = current;
+        if (quit)
+          return;
         
         // ------------------------------------------------------------------
         // run the actual task
         // ------------------------------------------------------------------
-        while (true) {
-          int tid = numJobs.taken++;
-          if (tid >= numJobs.total)
-            break;
-          task->run(tid);
-        }
+        if (workerID < numActive)
+          work(workerID,allowStealing);
         
         // ------------------------------------------------------------------
-        // wait for all to be done
+        // signal we're done
         // ------------------------------------------------------------------
-        barrier.arrive_and_wait();
+        if (numBusy.fetch_sub(1) == 1 && launcherSleeping)
+          numBusy.notify_one();
       }
     }
     
@@ -110,8 +286,7 @@ namespace rtc {
            ci.blockIdx = bid;
            ci.blockDim = vec3ui(blockSize,1u,1u);
            ci.threadIdx = vec3ui(0);
-           for (ci.threadIdx.x=0;ci.threadIdx.x<blockSize;ci.threadIdx.x++)
-             computeFct(ci,dd);
+           blockFct(ci,dd);
          });
     }
     
@@ -128,9 +303,7 @@ namespace rtc {
            ci.blockIdx = bid;
            ci.blockDim = vec3ui(blockSize.x,blockSize.y,1);
            ci.threadIdx = vec3ui(0);
-           for (ci.threadIdx.y=0;ci.threadIdx.y<blockSize.y;ci.threadIdx.y++)
-             for (ci.threadIdx.x=0;ci.threadIdx.x<blockSize.x;ci.threadIdx.x++)
-               computeFct(ci,dd);
+           blockFct(ci,dd);
          });
     }
 
@@ -147,10 +320,7 @@ namespace rtc {
            ci.blockIdx = bid;
            ci.blockDim = vec3ui(blockSize);
            ci.threadIdx = vec3ui(0);
-           for (ci.threadIdx.z=0;ci.threadIdx.z<blockSize.z;ci.threadIdx.z++)
-             for (ci.threadIdx.y=0;ci.threadIdx.y<blockSize.y;ci.threadIdx.y++)
-               for (ci.threadIdx.x=0;ci.threadIdx.x<blockSize.x;ci.threadIdx.x++)
-                 computeFct(ci,dd);
+           blockFct(ci,dd);
          });
     }
       
@@ -158,6 +328,17 @@ namespace rtc {
     void TraceKernel2D::launch(vec2i launchDims,
                                const void *dd) 
     {
+      /* packets only pay off if neighboring launch indices trace
+         similar rays; allow for turning them off to compare */
+      static const bool usePackets = (getenv("BARNEY_EMBREE_NO_PACKETS") == nullptr);
+      if (batchFct && usePackets) {
+        parallel_for_3D
+          (device,vec3ui(owl::common::divRoundUp(launchDims.x,(int)packetWidth),launchDims.y,1),
+           [&](vec3ui bid) {
+             batchFct(bid.x*packetWidth,bid.y,launchDims,dd);
+           });
+        return;
+      }
       parallel_for_3D
         (device,vec3ui(launchDims.x,launchDims.y,1),
          [&](vec3ui bid) {
@@ -6,9 +6,12 @@
 
 #include "rtcore/embree/Device.h"
 #include "rtcore/embree/Texture.h"
+#include "rtcore/embree/Float16.h"
 #include <atomic>
+#include <cstring>
 #include <thread>
-#include <barrier>
+#include <mutex>
+#include <vector>
 
 namespace rtc {
   namespace embree {
@@ -58,6 +61,20 @@ namespace rtc {
 
 
     
+    template<typename T>
+    inline __rtc_device T tex2DLod(rtc::TextureObject to,
+                                   float x, float y, float lod);
+
+    template<>
+    inline __rtc_device vec4f tex2DLod<vec4f>(rtc::TextureObject to,
+                                              float x, float y, float lod)
+    {
+      return ((TextureSampler *)to)->tex2DLod({x,y},lod);
+    }
+
+
+
+    
     template<typename T>
     inline __rtc_device T tex3D(rtc::TextureObject to,
                                 float x, float y, float z);
@@ -100,6 +117,21 @@ namespace rtc {
       
       inline float atomicAdd(float *ptr, float inc) const
       { return ((std::atomic<float> *)ptr)->fetch_add(inc); }
+
+      /*! atomically adds (x,y) to the pair of halfs at ptr */
+      inline void atomicAddHalf2(void *ptr, float x, float y) const
+      {
+        std::atomic<uint32_t> *word = (std::atomic<uint32_t> *)ptr;
+        uint32_t current = word->load();
+        while (true) {
+          float16_t h[2];
+          memcpy(h,&current,sizeof(current));
+          float16_t sum[2] = { float(h[0])+x, float(h[1])+y };
+          uint32_t next;
+          memcpy(&next,sum,sizeof(next));
+          if (word->compare_exchange_weak(current,next)) break;
+        }
+      }
       
       vec3ui threadIdx;
       vec3ui blockIdx;
@@ -139,22 +171,79 @@ namespace rtc {
       const T t;
     };
     
+    /*! runs the jobs of a launch on a pool of (pinned) worker
+        threads. Every launch's jobs get split into one contiguous
+        range per worker; workers take chunks from the front of their
+        own range, and once that is empty steal half of what is left
+        of someone else's, from the back. Without stealing, worker i
+        always gets the same i'th part of a launch, which is what
+        firstTouch() relies on */
     struct LaunchSystem {
       LaunchSystem();
-      void launchAndWait(int numTotal, Task *task);
-      void threadFct();
+      ~LaunchSystem();
+      
+      /*! runs jobs 0..numTotal-1 of given task. Without stealing
+          the jobs get split exactly as described above (only needed
+          for firstTouch) */
+      void launchAndWait(int numTotal, Task *task,
+                         bool allowStealing = true);
+      
+      /*! touches (zeroes) the pages of given freshly allocated memory
+          from the workers that - for launches over that memory - will
+          work on them, so they end up on those workers' numa
+          nodes */
+      void firstTouch(void *mem, size_t numBytes);
+      
+      void threadFct(int workerID);
 
-      std::vector<std::thread> threads;
+      /*! keeps the last numThreads workers out of (stealing) launches
+          for as long as somebody else - the denoiser - is using their
+          cores; cleared again with numThreads=0 */
+      void reserveThreads(int numThreads)
+      { numReserved = std::max(0,std::min(numThreads,numWorkers-1)); }
+
+      /*! one worker's range of not yet taken job IDs, packed into a
+          single word as (end<<32)|begin so both the owner and thieves
+          can update it with a single CAS */
+      struct alignas(64) Queue {
+        std::atomic<uint64_t> range { 0 };
+      };
 
-      struct {
-        volatile int total = 0;
-        std::atomic<int> taken;
-      } numJobs;
+      /*! takes a chunk of at most maxCount jobs from the front of
+          given queue; false if that was empty */
+      static bool takeFront(Queue &queue, int maxCount,
+                            int &begin, int &end);
+      /*! steals the back half (but at most maxCount jobs) of given
+          queue */
+      static bool stealBack(Queue &queue, int maxCount,
+                            int &begin, int &end);
+      
+      /*! runs jobs from given worker's own queue (if any), then - if
+          so allowed - steals from the others */
+      void work(int workerID, bool allowStealing);
+      
+      std::vector<std::thread> threads;
+      std::vector<Queue>       queues;
+      int                      numWorkers = 0;
       
       Task *volatile task = 0;
-
+      int            chunkSize = 1;
+      bool           allowStealing = true;
+      /*! workers 0..numActive-1 take part in the current launch */
+      int            numActive = 0;
+      std::atomic<int> numReserved { 0 };
+      
+      /*! bumped for every launch; workers wait on this */
+      alignas(64) std::atomic<uint32_t> launchID { 0 };
+      /*! how many workers are still busy with the current launch;
+          the launching thread waits on this */
+      alignas(64) std::atomic<int>      numBusy { 0 };
+      /*! so we only pay for notify()s if somebody actually sleeps */
+      std::atomic<int>  numSleeping { 0 };
+      std::atomic<bool> launcherSleeping { false };
+      bool quit = false;
+      
       std::mutex mutex;
-      std::barrier<void(*)() noexcept> barrier;
     };
 
     
@@ -170,6 +259,16 @@ namespace rtc {
   }
 }
 
+/*! hint that a block's thread loop has no loop-carried dependencies,
+    so the compiler can vectorize it once run() is inlined into it */
+#if defined(__clang__)
+# define RTC_EMBREE_SIMD_LOOP _Pragma("clang loop vectorize(enable) interleave(enable)")
+#elif defined(__GNUC__)
+# define RTC_EMBREE_SIMD_LOOP _Pragma("GCC ivdep")
+#else
+# define RTC_EMBREE_SIMD_LOOP
+#endif
+
 # define __rtc_global /*static*/
 # define __rtc_launch(dev,kernel,nb,bs,...)                             \
   {                                                                     \
@@ -181,8 +280,9 @@ namespace rtc {
       ci.gridDim = {(unsigned)nb,1u,1u};                                \
       ci.blockDim = {(unsigned)bs,1u,1u};                               \
       ci.blockIdx = {(unsigned)taskID,0u,0u};                           \
-      ci.threadIdx = {0u,0u,0u};                                        \
-      for (ci.threadIdx.x=0;ci.threadIdx.x<(uint32_t)bs;ci.threadIdx.x++){ \
+      RTC_EMBREE_SIMD_LOOP                                              \
+      for (uint32_t tx=0;tx<(uint32_t)bs;tx++) {                        \
+        ci.threadIdx = {tx,0u,0u};                                      \
         kernel(ci,__VA_ARGS__);                                         \
       }                                                                 \
     });                                                                 \
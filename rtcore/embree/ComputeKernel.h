@@ -10,14 +10,18 @@
 namespace rtc {
   namespace embree {
 
+    /*! runs all threads of the block that ci's blockIdx/blockDim
+        describe */
+    typedef void (*BlockFct)(rtc::embree::ComputeInterface &ci,
+                             const void *pKernelData);
+    
     struct ComputeKernel1D {
       // void (*launch)(unsigned int nb, unsigned int bs,
       //                const void *pKernelData) = 0;
       void launch(unsigned int nb, unsigned int bs,
                   const void *pKernelData);
       Device *device;
-      void (*computeFct)(rtc::embree::ComputeInterface &ci,
-                        const void *pKernelData) = 0;
+      BlockFct blockFct = 0;
     };
     struct ComputeKernel2D {
       // void (*launch)(vec2ui nb, vec2ui bs,
@@ -28,8 +32,7 @@ namespace rtc {
       //                    const void *pKernelData)
       // { launch(vec2ui(nb),vec2ui(bs),pKernelData); }
       Device *device;
-      void (*computeFct)(rtc::embree::ComputeInterface &ci,
-                        const void *pKernelData) = 0;
+      BlockFct blockFct = 0;
     };
     struct ComputeKernel3D {
       // void (*launch)(vec3ui nb, vec3ui bs,
@@ -40,19 +43,28 @@ namespace rtc {
       //                    const void *pKernelData)
       // { launch(vec3ui(nb),vec3ui(bs),pKernelData); }
       Device *device;
-      void (*computeFct)(rtc::embree::ComputeInterface &ci,
-                        const void *pKernelData) = 0;
+      BlockFct blockFct = 0;
     };
 
 
   }
 }
 
+/* the exported functions run an entire block each, so the kernel's
+   run() gets inlined into the thread loop rather than being called on
+   every single thread through a function pointer */
 #define RTC_EXPORT_COMPUTE1D(name,ClassName)                            \
   void rtc_embree_compute_##name(rtc::embree::ComputeInterface &ci,     \
                                  const void *pData)                     \
   {                                                                     \
-    ((ClassName *)pData)->run(ci);                                      \
+    ClassName *kernel = (ClassName *)pData;                             \
+    const unsigned bsx = ci.blockDim.x;                                 \
+    RTC_EMBREE_SIMD_LOOP                                                \
+    for (unsigned tx=0;tx<bsx;tx++) {                                   \
+      rtc::embree::ComputeInterface lane = ci;                          \
+      lane.threadIdx = {tx,0u,0u};                                      \
+      kernel->run(lane);                                                \
+    }                                                                   \
   }                                                                     \
                                                                         \
   rtc::ComputeKernel1D *createCompute_##name(rtc::Device *dev)          \
@@ -62,7 +74,16 @@ namespace rtc {
   void rtc_embree_compute_##name(rtc::embree::ComputeInterface &ci,     \
                                  const void *pData)                     \
   {                                                                     \
-    ((ClassName *)pData)->run(ci);                                      \
+    ClassName *kernel = (ClassName *)pData;                             \
+    const unsigned bsx = ci.blockDim.x;                                 \
+    for (unsigned ty=0;ty<ci.blockDim.y;ty++) {                         \
+      RTC_EMBREE_SIMD_LOOP                                              \
+      for (unsigned tx=0;tx<bsx;tx++) {                                 \
+        rtc::embree::ComputeInterface lane = ci;                        \
+        lane.threadIdx = {tx,ty,0u};                                    \
+        kernel->run(lane);                                              \
+      }                                                                 \
+    }                                                                   \
   }                                                                     \
                                                                         \
   rtc::ComputeKernel2D *createCompute_##name(rtc::Device *dev)          \
@@ -72,7 +93,17 @@ namespace rtc {
   void rtc_embree_compute_##name(rtc::embree::ComputeInterface &ci,     \
                                  const void *pData)                     \
   {                                                                     \
-    ((ClassName *)pData)->run(ci);                                      \
+    ClassName *kernel = (ClassName *)pData;                             \
+    const unsigned bsx = ci.blockDim.x;                                 \
+    for (unsigned tz=0;tz<ci.blockDim.z;tz++)                           \
+      for (unsigned ty=0;ty<ci.blockDim.y;ty++) {                       \
+        RTC_EMBREE_SIMD_LOOP                                            \
+        for (unsigned tx=0;tx<bsx;tx++) {                               \
+          rtc::embree::ComputeInterface lane = ci;                      \
+          lane.threadIdx = {tx,ty,tz};                                  \
+          kernel->run(lane);                                            \
+        }                                                               \
+      }                                                                 \
   }                                                                     \
                                                                         \
   rtc::ComputeKernel3D *createCompute_##name(rtc::Device *dev)          \
@@ -3,6 +3,7 @@
 
 
 #include "rtcore/embree/Denoiser.h"
+#include "rtcore/embree/ComputeInterface.h"
 
 #if BARNEY_OIDN_CPU
 
@@ -12,15 +13,31 @@ namespace rtc {
     DenoiserOIDN::DenoiserOIDN(Device *device)
       : Denoiser(device)
     {
+      const char *fromEnv = getenv("BARNEY_CPU_DENOISER_THREADS");
+      numThreads
+        = fromEnv
+        ? std::max(1,atoi(fromEnv))
+        : std::max(1,device->ls->numWorkers/4);
       oidnDevice = 
         oidnNewDevice(OIDN_DEVICE_TYPE_CPU);
+      oidnSetDeviceInt(oidnDevice,"numThreads",numThreads);
+      /* our workers are already pinned; oidn pinning its threads
+         too would have them fight over the same cores */
+      oidnSetDeviceBool(oidnDevice,"setAffinity",false);
       oidnCommitDevice(oidnDevice);
       
       filter = oidnNewFilter(oidnDevice,"RT");
+      executor = std::thread([this](){ executorFct(); });
     }
 
     DenoiserOIDN::~DenoiserOIDN()
     {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+      }
+      cv.notify_all();
+      executor.join();
       freeMem();
       oidnReleaseFilter(filter);
       oidnReleaseDevice(oidnDevice);
@@ -28,21 +45,55 @@ namespace rtc {
 
     void DenoiserOIDN::freeMem()
     {
-      if (out_rgba)  { free(out_rgba);  out_rgba = 0; }
-      if (in_rgba)   { free(in_rgba);   in_rgba = 0; }
-      if (in_normal) { free(in_normal); in_normal = 0; }
+      if (out_rgba)  { rtc->freeMem(out_rgba);  out_rgba = 0; }
+      if (in_rgba)   { rtc->freeMem(in_rgba);   in_rgba = 0; }
+      if (in_normal) { rtc->freeMem(in_normal); in_normal = 0; }
     }
     
     void DenoiserOIDN::resize(vec2i size)
     {
+      finish();
       freeMem();
-      out_rgba  = (vec4f*)malloc(size.x*size.y*sizeof(vec4f));
-      in_rgba   = (vec4f*)malloc(size.x*size.y*sizeof(vec4f));
-      in_normal = (vec3f*)malloc(size.x*size.y*sizeof(vec3f));
+      out_rgba  = (vec4f*)rtc->allocMem(size.x*size.y*sizeof(vec4f));
+      in_rgba   = (vec4f*)rtc->allocMem(size.x*size.y*sizeof(vec4f));
+      in_normal = (vec3f*)rtc->allocMem(size.x*size.y*sizeof(vec3f));
       this->numPixels = size;
     }
     
     void DenoiserOIDN::run(float blendFactor)
+    {
+      /* a previous run may still be going if nobody waited for it */
+      finish();
+      rtc->ls->reserveThreads(numThreads);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = true;
+      }
+      cv.notify_all();
+    }
+
+    void DenoiserOIDN::finish()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock,[this](){ return !pending; });
+    }
+
+    void DenoiserOIDN::executorFct()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true) {
+        cv.wait(lock,[this](){ return pending || quit; });
+        if (quit) return;
+        lock.unlock();
+        execute();
+        rtc->ls->reserveThreads(0);
+        lock.lock();
+        pending = false;
+        cv.notify_all();
+      }
+    }
+
+    void DenoiserOIDN::execute()
     {
       oidnSetSharedFilterImage(filter,"color",in_rgba,
                                OIDN_FORMAT_FLOAT3,numPixels.x,numPixels.y,0,
@@ -8,6 +8,9 @@
 
 #if BARNEY_OIDN_CPU
 # include <OpenImageDenoise/oidn.h>
+# include <condition_variable>
+# include <mutex>
+# include <thread>
 #endif
 
 namespace rtc {
@@ -18,6 +21,9 @@ namespace rtc {
       virtual ~Denoiser() = default;
       virtual void resize(vec2i dims) = 0;
       virtual void run(float blendFactor) = 0;
+      /*! runs happen right when they get issued on the cpu, so
+          there's nothing to wait for */
+      virtual void finish() {}
 
       vec4f *out_rgba  = 0;
       vec4f *in_rgba   = 0;
@@ -30,7 +36,13 @@ namespace rtc {
     };
     
 #if BARNEY_OIDN_CPU
-    /*! oidn-based CPU denoiser */
+    /*! oidn-based CPU denoiser. Runs get executed on a thread of
+        their own, so denoising a frame can overlap with rendering the
+        next one (the frame buffer's asyncDenoise mode); run() only
+        hands the job over, finish() waits for it. OIDN gets its own
+        share of the cores (BARNEY_CPU_DENOISER_THREADS, default a
+        quarter), and while it runs the launch system leaves that many
+        of its workers idle, so the two don't oversubscribe */
     struct DenoiserOIDN : public Denoiser
     {
       DenoiserOIDN(Device *device);
@@ -38,14 +50,25 @@ namespace rtc {
       
       void resize(vec2i size) override;
       void run(float blendFactor) override;
+      void finish() override;
       
     private:
       void freeMem();
+      /*! the actual oidn filter run, on the executor thread */
+      void execute();
+      void executorFct();
 
       vec2i         numPixels { 0,0 };
+      int           numThreads = 1;
       
       OIDNDevice oidnDevice = 0;
       OIDNFilter filter = 0;
+
+      std::thread             executor;
+      std::mutex              mutex;
+      std::condition_variable cv;
+      bool                    pending = false;
+      bool                    quit    = false;
     };
 #endif
   }
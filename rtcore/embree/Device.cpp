@@ -11,6 +11,15 @@
 #include "rtcore/embree/Denoiser.h"
 #include "rtcore/embree/TraceInterface.h"
 #include "rtcore/embree/ComputeInterface.h"
+#include "rtcore/embree/Allocator.h"
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <unistd.h>
+#endif
 
 namespace rtc {
   namespace embree {
@@ -18,6 +27,9 @@ namespace rtc {
     /*! get a unique hash for a given physical device. */
     size_t getPhysicalDeviceHash(int gpuID)
     { return (size_t)gpuID; }
+
+    int getNumaNode(int gpuID)
+    { return -1; }
     
     // ------------------------------------------------------------------
     // rt core interface
@@ -60,20 +72,37 @@ namespace rtc {
         hook in any-hit program on top of embree hardcoded
         triangles. User geoms will NOT use this function, and will
         handle ah programs directly in their embree isec callback */
+    static bool anyHitOne(TraceInterface *ti, RTCRay *ray, RTCHit *hit);
+    
     void intersectionFilter(const RTCFilterFunctionNArguments* args)
     {
       /* avoid crashing when debug visualizations are used */
       if (args->context == nullptr) return;
 
-      assert(args->N == 1);
       int* valid = args->valid;
-      if (valid[0] != -1) return;
-      
-      RTCRay* ray = (RTCRay*)args->ray;
-      RTCHit* hit = (RTCHit*)args->hit;
-  
       TraceInterface *ti = (TraceInterface *)args->context;
+      if (!ti->packetLanes) {
+        assert(args->N == 1);
+        if (valid[0] != -1) return;
+        if (!anyHitOne(ti,(RTCRay*)args->ray,(RTCHit*)args->hit))
+          valid[0] = 0;
+        return;
+      }
+      
+      for (unsigned i=0;i<args->N;i++) {
+        if (valid[i] != -1) continue;
+        RTCRay ray;
+        RTCHit hit;
+        loadLane(ray,hit,args->ray,args->hit,args->N,i);
+        if (!anyHitOne(ti->packetLanes[i],&ray,&hit))
+          valid[i] = 0;
+      }
+    }
 
+    /*! runs the any-hit program (if any) for a single ray's candidate
+        hit; returns false if that got ignored */
+    static bool anyHitOne(TraceInterface *ti, RTCRay *ray, RTCHit *hit)
+    {
       int primID = hit->primID;
       int geomID = hit->geomID;
       int instIdx = hit->instID[0];
@@ -96,10 +125,42 @@ namespace rtc {
     
         gt->ah(*ti);
 
-        if (ti->ignoreThisHit) {
-          valid[0] = 0;
-          return;
-        } 
+        if (ti->ignoreThisHit)
+          return false;
+      }
+      return true;
+    }
+
+    /*! the filter to trace given world with: none at all if no
+        geometry in it has an any-hit program to run */
+    static inline RTCFilterFunctionN filterFor(const InstanceGroup *ig)
+    { return ig->needsFilter ? intersectionFilter : nullptr; }
+
+    /*! runs the closest-hit program (if any) for a single ray's final
+        hit */
+    static void closestHitOne(TraceInterface *ti,
+                              InstanceGroup *ig,
+                              RTCRayHit &rayHit)
+    {
+      int primID = rayHit.hit.primID;
+      int geomID = rayHit.hit.geomID;
+      int instIdx = rayHit.hit.instID[0];
+    
+      GeomGroup *group = (GeomGroup *)ig->groups[instIdx];
+      Geom *geom = (Geom *)group->geoms[geomID];
+      GeomType *gt = geom->type;
+      if (gt->ch) {
+        ti->geomData = (void*)geom->programData.data();
+        ti->primID = primID;
+        ti->geomID = geomID;
+        ti->instIdx = instIdx;
+        ti->triangleBarycentrics = { rayHit.hit.u,rayHit.hit.v };
+        ti->objectToWorldXfm = &ig->xfms[instIdx];
+        ti->worldToObjectXfm = &ig->inverseXfms[instIdx];
+        ti->embreeRay = &rayHit.ray;
+        ti->embreeHit = &rayHit.hit;
+    
+        gt->ch(*ti);
       }
     }
 
@@ -109,7 +170,8 @@ namespace rtc {
                                   vec3f rayDirection,
                                   float tmin,
                                   float tmax,
-                                  void *prdPtr) 
+                                  void *prdPtr,
+                                  bool terminateOnFirstHit) 
     {
       InstanceGroup *ig = (InstanceGroup *)world;
       RTCScene embreeScene = ig->embreeScene;
@@ -157,42 +219,222 @@ namespace rtc {
       RTCIntersectArguments iargs;
       rtcInitIntersectArguments(&iargs);
       iargs.context = &ti->embreeRayQueryContext;
-#if 0
-#define FEATURE_MASK                                    \
-      RTC_FEATURE_FLAG_TRIANGLE |                       \
-        RTC_FEATURE_FLAG_FILTER_FUNCTION_IN_ARGUMENTS
+      iargs.feature_mask = ig->featureMask;
+      iargs.filter = filterFor(ig);
 
+      rtcIntersect1(embreeScene,&rayHit,&iargs);
+      if ((int)rayHit.hit.geomID >= 0)
+        closestHitOne(ti,ig,rayHit);
+    }
 
-      iargs.feature_mask = (RTCFeatureFlags) (FEATURE_MASK);
-#endif
-      iargs.filter = intersectionFilter;
+    bool TraceInterface::traceOcclusion(rtc::AccelHandle world,
+                                        vec3f rayOrigin,
+                                        vec3f rayDirection,
+                                        float tmin,
+                                        float tmax,
+                                        void *prdPtr)
+    {
+      InstanceGroup *ig = (InstanceGroup *)world;
+      assert(ig->embreeScene);
+      this->world = ig;
+      this->worldOrigin = rayOrigin;
+      this->worldDirection = rayDirection;
+      this->prd = prdPtr;
+      this->instIDs = ig->instIDs.data();
+
+      RTCRay ray;
+      ray.org_x = rayOrigin.x;
+      ray.org_y = rayOrigin.y;
+      ray.org_z = rayOrigin.z;
+      ray.tnear = tmin;
+      ray.dir_x = rayDirection.x;
+      ray.dir_y = rayDirection.y;
+      ray.dir_z = rayDirection.z;
+      ray.time  = 0.f;
+      ray.tfar  = tmax;
+      ray.mask  = -1;
+      ray.flags = 0;
+      this->embreeRay = &ray;
+      this->embreeHit = nullptr;
+      
+      rtcInitRayQueryContext(&embreeRayQueryContext);
+      RTCOccludedArguments oargs;
+      rtcInitOccludedArguments(&oargs);
+      oargs.context = &embreeRayQueryContext;
+      oargs.feature_mask = ig->featureMask;
+      oargs.filter = filterFor(ig);
+      rtcOccluded1(ig->embreeScene,&ray,&oargs);
+      /* embree marks occluded rays with tfar=-inf */
+      return ray.tfar == -INFINITY;
+    }
 
-      rtcIntersect1(embreeScene,&rayHit,&iargs);
-      if ((int)rayHit.hit.geomID >= 0) {
-    
-        int primID = rayHit.hit.primID;
-        int geomID = rayHit.hit.geomID;
-        int instIdx = rayHit.hit.instID[0];
-    
-        GeomGroup *group = (GeomGroup *)ig->groups[instIdx];
-        Geom *geom = (Geom *)group->geoms[geomID];
-        GeomType *gt = geom->type;
-        if (gt->ch) {
-
-          ti->geomData = (void*)geom->programData.data();
-          ti->primID = primID;
-          ti->geomID = geomID;
-          ti->instIdx = instIdx;
-          ti->triangleBarycentrics = { rayHit.hit.u,rayHit.hit.v };
-          ti->objectToWorldXfm = &ig->xfms[instIdx];
-          ti->worldToObjectXfm = &ig->inverseXfms[instIdx];
-          ti->embreeRay = &rayHit.ray;
-          ti->embreeHit = &rayHit.hit;
+    /*! occlusion part of tracePacket(), for the lanes marked in
+        'traced' */
+    static void occlusionPacket(TraceInterface *lanes,
+                                const TraceRequest *requests,
+                                void *const *prds,
+                                const bool *traced,
+                                bool *occluded)
+    {
+      InstanceGroup *ig = nullptr;
+      alignas(64) RTCRay16 ray;
+      alignas(64) int valid[packetWidth];
+      TraceInterface *lanePtrs[packetWidth];
+      for (int lane=0;lane<packetWidth;lane++) {
+        lanePtrs[lane] = &lanes[lane];
+        valid[lane] = traced[lane] ? -1 : 0;
+        if (!traced[lane]) continue;
+        
+        const TraceRequest &req = requests[lane];
+        ig = (InstanceGroup *)req.world;
+        TraceInterface &ti = lanes[lane];
+        ti.world          = ig;
+        ti.worldOrigin    = req.org;
+        ti.worldDirection = req.dir;
+        ti.prd            = prds[lane];
+        ti.instIDs        = ig->instIDs.data();
+        
+        ray.org_x[lane] = req.org.x;
+        ray.org_y[lane] = req.org.y;
+        ray.org_z[lane] = req.org.z;
+        ray.tnear[lane] = req.tmin;
+        ray.dir_x[lane] = req.dir.x;
+        ray.dir_y[lane] = req.dir.y;
+        ray.dir_z[lane] = req.dir.z;
+        ray.time[lane]  = 0.f;
+        ray.tfar[lane]  = req.tmax;
+        ray.mask[lane]  = -1;
+        ray.id[lane]    = lane;
+        ray.flags[lane] = 0;
+      }
+
+      TraceInterface packet;
+      packet.packetLanes = lanePtrs;
+      packet.world = ig;
+      rtcInitRayQueryContext(&packet.embreeRayQueryContext);
+      
+      RTCOccludedArguments oargs;
+      rtcInitOccludedArguments(&oargs);
+      oargs.context = &packet.embreeRayQueryContext;
+      oargs.feature_mask = ig->featureMask;
+      oargs.filter = filterFor(ig);
+      rtcOccluded16(valid,ig->embreeScene,&ray,&oargs);
+      for (int lane=0;lane<packetWidth;lane++)
+        if (traced[lane])
+          occluded[lane] = (ray.tfar[lane] == -INFINITY);
+    }
     
-          gt->ch(*ti);
+    void tracePacket(TraceInterface *lanes,
+                     const TraceRequest *requests,
+                     void *const *prds,
+                     const bool *active,
+                     bool *occluded)
+    {
+      bool traced[packetWidth];
+      bool occlusionTraced[packetWidth];
+      int  numTraced = 0;
+      int  numOcclusion = 0;
+      int  first     = -1;
+      bool sameWorld = true;
+      for (int lane=0;lane<packetWidth;lane++) {
+        const TraceRequest &req = requests[lane];
+        occluded[lane] = false;
+        traced[lane] = active[lane] && req.tmin < req.tmax;
+        occlusionTraced[lane] = traced[lane] && req.occlusionOnly;
+        if (!traced[lane]) continue;
+        if (first < 0)
+          first = lane;
+        else if (req.world != requests[first].world)
+          sameWorld = false;
+        numTraced++;
+        if (req.occlusionOnly) numOcclusion++;
+      }
+      if (numTraced == 0)
+        return;
+      if (numTraced == 1 || !sameWorld) {
+        for (int lane=0;lane<packetWidth;lane++) {
+          if (!traced[lane]) continue;
+          const TraceRequest &req = requests[lane];
+          if (req.occlusionOnly)
+            occluded[lane]
+              = lanes[lane].traceOcclusion(req.world,req.org,req.dir,
+                                           req.tmin,req.tmax,prds[lane]);
+          else
+            lanes[lane].traceRay(req.world,req.org,req.dir,
+                                 req.tmin,req.tmax,prds[lane]);
         }
+        return;
+      }
+
+      /* shadow rays and the others mostly come in separate launches,
+         but either way each kind gets a packet query of its own */
+      if (numOcclusion > 0)
+        occlusionPacket(lanes,requests,prds,occlusionTraced,occluded);
+      if (numOcclusion == numTraced)
+        return;
+      for (int lane=0;lane<packetWidth;lane++)
+        traced[lane] = traced[lane] && !occlusionTraced[lane];
+
+      InstanceGroup *ig = (InstanceGroup *)requests[first].world;
+      assert(ig->embreeScene);
+      alignas(64) RTCRayHit16 rayHit;
+      alignas(64) int valid[packetWidth];
+      TraceInterface *lanePtrs[packetWidth];
+      for (int lane=0;lane<packetWidth;lane++) {
+        lanePtrs[lane] = &lanes[lane];
+        valid[lane] = traced[lane] ? -1 : 0;
+        if (!traced[lane]) continue;
+        
+        const TraceRequest &req = requests[lane];
+        TraceInterface &ti = lanes[lane];
+        ti.world          = ig;
+        ti.worldOrigin    = req.org;
+        ti.worldDirection = req.dir;
+        ti.prd            = prds[lane];
+        ti.instIDs        = ig->instIDs.data();
+        
+        rayHit.ray.org_x[lane] = req.org.x;
+        rayHit.ray.org_y[lane] = req.org.y;
+        rayHit.ray.org_z[lane] = req.org.z;
+        rayHit.ray.tnear[lane] = req.tmin;
+        rayHit.ray.dir_x[lane] = req.dir.x;
+        rayHit.ray.dir_y[lane] = req.dir.y;
+        rayHit.ray.dir_z[lane] = req.dir.z;
+        rayHit.ray.time[lane]  = 0.f;
+        rayHit.ray.tfar[lane]  = req.tmax;
+        rayHit.ray.mask[lane]  = -1;
+        rayHit.ray.id[lane]    = lane;
+        rayHit.ray.flags[lane] = 0;
+        rayHit.hit.Ng_x[lane]  = 0.f;
+        rayHit.hit.Ng_y[lane]  = 0.f;
+        rayHit.hit.Ng_z[lane]  = 0.f;
+        rayHit.hit.primID[lane]    = RTC_INVALID_GEOMETRY_ID;
+        rayHit.hit.geomID[lane]    = RTC_INVALID_GEOMETRY_ID;
+        rayHit.hit.instID[0][lane] = RTC_INVALID_GEOMETRY_ID;
       }
+
+      /* the programs run with the lanes' own interfaces; this one
+         only carries the query context */
+      TraceInterface packet;
+      packet.packetLanes = lanePtrs;
+      packet.world = ig;
+      rtcInitRayQueryContext(&packet.embreeRayQueryContext);
       
+      RTCIntersectArguments iargs;
+      rtcInitIntersectArguments(&iargs);
+      iargs.context = &packet.embreeRayQueryContext;
+      iargs.feature_mask = ig->featureMask;
+      iargs.filter = filterFor(ig);
+      rtcIntersect16(valid,ig->embreeScene,&rayHit,&iargs);
+      
+      for (int lane=0;lane<packetWidth;lane++) {
+        if (!traced[lane] || (int)rayHit.hit.geomID[lane] < 0) continue;
+        RTCRayHit single;
+        loadLane(single.ray,single.hit,
+                 (RTCRayN*)&rayHit.ray,(RTCHitN*)&rayHit.hit,
+                 packetWidth,lane);
+        closestHitOne(&lanes[lane],ig,single);
+      }
     }
       
     
@@ -213,12 +455,44 @@ namespace rtc {
         embreeDevice = rtcNewDevice("verbose=0");
       }
       ls = createLaunchSystem();
+      arena = new MemoryArena(ls);
     }
 
     Device::~Device()
     {
-      // todo: shut down launch system
       destroy();
+      delete arena;
+      delete ls;
+    }
+
+    void *Device::allocMem(size_t numBytes)
+    {
+      void *mem = arena->alloc(numBytes);
+      memory.allocated(mem,numBytes);
+      return mem;
+    }
+
+    void Device::freeMem(void *mem)
+    {
+      memory.freed(mem);
+      arena->free(mem);
+    }
+
+    void Device::getMemInfo(size_t &free, size_t &total)
+    {
+#ifdef _WIN32
+      MEMORYSTATUSEX status;
+      status.dwLength = sizeof(status);
+      GlobalMemoryStatusEx(&status);
+      free  = (size_t)status.ullAvailPhys;
+      total = (size_t)status.ullTotalPhys;
+#elif defined(_SC_AVPHYS_PAGES)
+      const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+      free  = (size_t)sysconf(_SC_AVPHYS_PAGES)*pageSize;
+      total = (size_t)sysconf(_SC_PHYS_PAGES)*pageSize;
+#else
+      free = total = 0;
+#endif
     }
 
     Denoiser *Device::createDenoiser()
@@ -243,12 +517,22 @@ namespace rtc {
     // ------------------------------------------------------------------
 
     Group *
-    Device::createTrianglesGroup(const std::vector<Geom *> &geoms)
-    { return new TrianglesGroup(this,geoms); }
+    Device::createTrianglesGroup(const std::vector<Geom *> &geoms,
+                                 BuildQuality quality)
+    {
+      GeomGroup *gg = new TrianglesGroup(this,geoms);
+      gg->buildQuality = quality;
+      return gg;
+    }
     
     Group *
-    Device::createUserGeomsGroup(const std::vector<Geom *> &geoms) 
-    { return new UserGeomGroup(this,geoms); }
+    Device::createUserGeomsGroup(const std::vector<Geom *> &geoms,
+                                 BuildQuality quality) 
+    {
+      GeomGroup *gg = new UserGeomGroup(this,geoms);
+      gg->buildQuality = quality;
+      return gg;
+    }
       
     Group *
     Device::createInstanceGroup(const std::vector<Group *>  &groups,
@@ -275,7 +559,12 @@ namespace rtc {
     TextureData *Device::createTextureData(vec3i dims,
                                                 rtc::DataType format,
                                                 const void *texels) 
-    { return new TextureData(this,dims,format,texels); }
+    {
+      TextureData *td = new TextureData(this,dims,format,texels);
+      td->memoryCategory = memory.current;
+      memory.allocated(td->memoryCategory,td->data.size());
+      return td;
+    }
 
     Buffer *Device::createBuffer(size_t numBytes,
                                       const void *initValues) 
@@ -285,6 +574,7 @@ namespace rtc {
 
     void Device::freeTextureData(TextureData *td) 
     {
+      if (td) memory.freed(td->memoryCategory,td->data.size());
       delete (TextureData*)td;
     }
       
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "rtcore/embree/embree-common.h"
+#include "rtcore/common/MemoryTracker.h"
 
 #define RTC_DEVICE_CODE 1
 
@@ -13,10 +14,14 @@ namespace rtc {
 
     struct LaunchSystem;
     LaunchSystem *createLaunchSystem();
+    struct MemoryArena;
 
 
     /*! get a unique hash for a given physical device. */
     size_t getPhysicalDeviceHash(int gpuID);
+
+    /*! numa node of given device; always -1 on the cpu */
+    int getNumaNode(int gpuID);
     
     struct Device;
     struct Denoiser;
@@ -26,6 +31,13 @@ namespace rtc {
     struct GeomType;
     struct TextureData;
     struct Texture;
+    struct Graph;
+
+    /*! all work on the cpu is done by the time it returns, so an
+        event is just a timestamp of when it got recorded */
+    struct Event {
+      double time = 0.;
+    };
 
     struct ComputeKernel1D;
     struct ComputeKernel2D;
@@ -34,17 +46,26 @@ namespace rtc {
     struct TraceInterface;
     
     typedef void (*TraceKernelFct)(rtc::embree::TraceInterface &);
+    /*! runs a batched trace kernel for launch indices
+        (ix0..ix0+packetWidth-1,iy), tracing their rays as one packet */
+    typedef void (*TraceBatchFct)(int ix0, int iy,
+                                  vec2i launchDims,
+                                  const void *kernelData);
     
     struct TraceKernel2D {
       TraceKernel2D(Device *device,
-                    TraceKernelFct kernelFct)
+                    TraceKernelFct kernelFct,
+                    TraceBatchFct batchFct = nullptr)
         : device(device),
-          kernelFct(kernelFct)
+          kernelFct(kernelFct),
+          batchFct(batchFct)
       {}
       
       void launch(vec2i launchDims,
                   const void *kernelData);
       TraceKernelFct const kernelFct;
+      /*! only for kernels exported with RTC_EXPORT_BATCHED_TRACE2D */
+      TraceBatchFct  const batchFct;
       Device *const device;
     };
     
@@ -65,23 +86,70 @@ namespace rtc {
       void copy(void *dst, const void *src, size_t numBytes)
       { memcpy(dst,src,numBytes); }
       
+      /*! host and 'device' memory are the same thing here; both
+          come from the same arena */
       void *allocHost(size_t numBytes)
-      { return numBytes?malloc(numBytes):0; }
+      { return allocMem(numBytes); }
       
       void freeHost(void *mem)
-      { if(mem) free(mem); }
+      { freeMem(mem); }
       
       void memsetAsync(void *mem,int value, size_t size)
       { if (size) memset(mem,value,size); }
       
-      void *allocMem(size_t numBytes)
-      { return numBytes?malloc(numBytes):nullptr; }
+      /*! large buffers (ray queues, frame buffers, ...) come from
+          the device's MemoryArena: huge-page backed, numa-placed, and
+          recycled once freed */
+      void *allocMem(size_t numBytes);
       
-      void freeMem(void *mem)
-      { if (mem) free(mem); }
+      void freeMem(void *mem);
       
       void sync()
       {/*no-op*/}
+
+      /*! what the host has free, and in total, right now */
+      /*! host memory is all the same; see cuda_common::Device */
+      void *allocManaged(size_t numBytes) { return allocMem(numBytes); }
+      void freeManaged(void *mem) { freeMem(mem); }
+      void prefetch(const void *mem, size_t numBytes) {}
+      void getMemInfo(size_t &free, size_t &total);
+      /*! freed memory that the arena keeps around for re-use */
+      size_t getCachedMemory() { return arena->cachedBytes(); }
+
+      /*! memory that got allocated through this device */
+      MemoryTracker memory;
+
+      /*! all work on the cpu happens right when it gets issued, so
+          there's nothing we could capture into a graph */
+      bool canCaptureGraphs() const { return false; }
+      void beginCapture() {}
+      Graph *endCapture() { return nullptr; }
+      void launchGraph(Graph *graph) {}
+      void freeGraph(Graph *graph) {}
+      bool isCapturing() const { return false; }
+      const void *keepForCapture(const void *data, size_t numBytes)
+      { return data; }
+
+      Event *createEvent() { return new Event; }
+      void freeEvent(Event *event) { delete event; }
+      void recordEvent(Event *event) { event->time = getCurrentTime(); }
+      void waitForEvent(Event *event) {}
+      void streamWaitEvent(Event *event) {}
+      void copyAsyncAfter(Event *after, void *dst, const void *src,
+                          size_t numBytes)
+      { memcpy(dst,src,numBytes); }
+      void recordCopyEvent(Event *event) { recordEvent(event); }
+      float elapsedTime(Event *begin, Event *end)
+      { return float(1000.*(end->time-begin->time)); }
+
+      /*! there's no gpu memory to share with a graphics api */
+      void *importExternalMemory(int fd, size_t numBytes)
+      {
+        throw std::runtime_error
+          ("importing external (graphics api) memory is not supported "
+           "on the cpu backend");
+      }
+      void freeExternalMemory(void *ptr) {}
       
       /*! sets this gpu as active, and returns physical ID of GPU that
         was active before */
@@ -95,6 +163,12 @@ namespace rtc {
       TextureData *createTextureData(vec3i dims,
                                      rtc::DataType format,
                                      const void *texels);
+      /*! there's no copy engine to overlap with; just uploads */
+      TextureData *createTextureDataAsync(vec3i dims,
+                                          rtc::DataType format,
+                                          const void *texels,
+                                          Event *uploaded)
+      { recordEvent(uploaded); return createTextureData(dims,format,texels); }
       void freeTextureData(TextureData *td);
       void freeTexture(Texture *tex);
       
@@ -127,6 +201,8 @@ namespace rtc {
 
       void buildPipeline();
       void buildSBT();
+      /*! geoms' data gets read where it is, so nothing to update */
+      void updateSBT() {}
 
       // ------------------------------------------------------------------
       // geomtype stuff
@@ -144,10 +220,12 @@ namespace rtc {
       // group/accel stuff
       // ------------------------------------------------------------------
       Group *
-      createTrianglesGroup(const std::vector<Geom *> &geoms);
+      createTrianglesGroup(const std::vector<Geom *> &geoms,
+                           BuildQuality quality = BUILD_QUALITY_DEFAULT);
       
       Group *
-      createUserGeomsGroup(const std::vector<Geom *> &geoms);
+      createUserGeomsGroup(const std::vector<Geom *> &geoms,
+                           BuildQuality quality = BUILD_QUALITY_DEFAULT);
       
       Group *
       createInstanceGroup(const std::vector<Group *>  &groups,
@@ -157,6 +235,7 @@ namespace rtc {
       void freeGroup(Group *group);
 
       LaunchSystem *ls = 0;
+      MemoryArena  *arena = 0;
       RTCDevice embreeDevice = 0;
     };
     
@@ -171,3 +250,13 @@ namespace rtc {
 #define RTC_EXPORT_TRACE2D(name,Class)                                  \
   rtc::TraceKernel2D *createTrace_##name(rtc::Device *device)     \
   { return new ::rtc::TraceKernel2D(device,Class::run); }
+
+/*! same as RTC_EXPORT_TRACE2D, for kernels whose Class - in addition
+    to run() - splits into beginTrace(ti,prd,req), which sets up the
+    one ray to trace, and endTrace(ti,prd,occluded), which handles the
+    result, with typedef'ed Class::PRD. Lets us trace a launch's rays
+    in packets. */
+#define RTC_EXPORT_BATCHED_TRACE2D(name,Class)                          \
+  rtc::TraceKernel2D *createTrace_##name(rtc::Device *device)     \
+  { return new ::rtc::TraceKernel2D(device,Class::run,            \
+                                    ::rtc::embree::traceBatch<Class>); }
@@ -4,6 +4,9 @@
 
 
 #include "Float16.h"
+#if defined(__F16C__)
+# include <immintrin.h>
+#endif
 
 namespace math
 {
@@ -230,4 +233,15 @@ float float16ToFloat32(uint16_t value)
     return result.f;
 }
 
+void float16ToFloat32x8(const uint16_t *in, float *out)
+{
+#if defined(__F16C__)
+    __m128i h = _mm_loadu_si128((const __m128i *)in);
+    _mm256_storeu_ps(out, _mm256_cvtph_ps(h));
+#else
+    for (int i = 0; i < 8; ++i)
+        out[i] = float16ToFloat32(in[i]);
+#endif
+}
+
 } // namespace math
@@ -4,6 +4,7 @@
 
 #include "rtcore/embree/GeomType.h"
 #include "rtcore/embree/Triangles.h"
+#include "rtcore/embree/Spheres.h"
 #include "rtcore/embree/UserGeom.h"
 
 namespace rtc {
@@ -39,6 +40,14 @@ namespace rtc {
     {
     }
     
+    SpheresGeomType::SpheresGeomType(Device *device,
+                                     size_t sizeOfProgramData,
+                                     AnyHitFct     ah,
+                                     ClosestHitFct ch)
+      : GeomType(device,sizeOfProgramData,ah,ch)
+    {
+    }
+    
     UserGeomType::UserGeomType(Device *device,
                                size_t sizeOfProgramData,
                                BoundsFct     bounds,
@@ -69,9 +78,15 @@ namespace rtc {
     TrianglesGeomType::~TrianglesGeomType()
     {}
     
+    SpheresGeomType::~SpheresGeomType()
+    {}
+    
     Geom *TrianglesGeomType::createGeom()
     { return new TrianglesGeom(this); }
 
+    Geom *SpheresGeomType::createGeom()
+    { return new SpheresGeom(this); }
+
     Geom *UserGeomType::createGeom()
     { return new UserGeom(this); }
     
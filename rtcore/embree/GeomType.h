@@ -45,6 +45,19 @@ namespace rtc {
       Geom *createGeom() override;
     };
 
+    /*! native (ie, embree-intersected) spheres; see SpheresGeom */
+    struct SpheresGeomType : public GeomType
+    {
+      SpheresGeomType(Device       *device,
+                      size_t        sizeOfProgramData,
+                      AnyHitFct     ah,
+                      ClosestHitFct ch);
+      
+      virtual ~SpheresGeomType();
+      
+      Geom *createGeom() override;
+    };
+
     struct UserGeomType : public GeomType
     {
       UserGeomType(Device       *device,
@@ -71,6 +84,14 @@ namespace rtc {
 #define RTC_IMPORT_TRIANGLES_GEOM(moduleName,typeName,DD,has_ah,has_ch) \
   extern rtc::GeomType *createGeomType_##typeName(rtc::Device *);
 
+/*! this backend can intersect spheres natively; geoms created from
+    a RTC_EXPORT_SPHERES_GEOM type take (x,y,z,radius) vec4f's
+    through setVertices(), and go into triangles groups */
+#define RTC_HAVE_NATIVE_SPHERES 1
+
+#define RTC_IMPORT_SPHERES_GEOM(moduleName,typeName,DD,has_ah,has_ch)   \
+  extern rtc::GeomType *createGeomType_##typeName(rtc::Device *);
+
 
 
 #define RTC_EXPORT_USER_GEOM(name,DD,Programs,has_ah,has_ch)    \
@@ -96,6 +117,16 @@ namespace rtc {
        has_ch?Programs::closestHit:0);                                  \
   }
 
+#define RTC_EXPORT_SPHERES_GEOM(name,DD,Programs,has_ah,has_ch)         \
+  rtc::GeomType *createGeomType_##name(rtc::Device *device)             \
+  {                                                                     \
+    return new rtc::embree::SpheresGeomType                             \
+      (device,                                                          \
+       sizeof(DD),                                                      \
+       has_ah?Programs::anyHit:0,                                       \
+       has_ch?Programs::closestHit:0);                                  \
+  }
+
 
 
 
@@ -6,6 +6,7 @@
 #include "rtcore/embree/Device.h"
 #include "rtcore/embree/Triangles.h"
 #include "rtcore/embree/UserGeom.h"
+#include "rtcore/embree/Spheres.h"
 // 
 #include "rtcore/embree/TraceInterface.h"
 
@@ -31,16 +32,16 @@ namespace rtc {
       bounds_o->upper_z = bounds.upper.z;
     }
 
-    void virtualIntersect(const RTCIntersectFunctionNArguments* args)
+    /*! runs a user geom's intersect (and any-hit) program for a
+        single ray; returns +1 if that found - and accepted - a hit,
+        0 if it found one that got ignored, and -1 if it found none */
+    static int intersectOne(TraceInterface *ti,
+                            UserGeom *user,
+                            RTCRayHit *rayHit,
+                            unsigned int primID,
+                            unsigned int geomID,
+                            int instIdx)
     {
-      int *valid = args->valid;
-      void *ptr  = args->geometryUserPtr;
-      UserGeom *user = (UserGeom *)ptr;
-      RTCRayHit *rayHit = (RTCRayHit*)args->rayhit;
-      unsigned int primID = args->primID;
-      unsigned int geomID = args->geomID;
-      int instIdx = args->context->instID[0];
-      TraceInterface *ti = (TraceInterface *)args->context;
       ti->primID = primID;
       ti->geomID = geomID;
       ti->instIdx = instIdx;
@@ -49,7 +50,6 @@ namespace rtc {
       ti->embreeHit = &rayHit->hit;
 
       InstanceGroup *ig = ti->world;
-      Group *group = (embree::Group*)ig->groups[instIdx];
       ti->objectToWorldXfm = &ig->xfms[instIdx];
       ti->worldToObjectXfm = &ig->inverseXfms[instIdx];
       
@@ -59,22 +59,83 @@ namespace rtc {
       ti->isec_t = INFINITY;
       type->intersect(*ti);
       // check if isec did 'save' a hit
-      if (ti->isec_t < INFINITY) {
-        float save_t = ti->embreeRay->tfar;
-        ti->embreeRay->tfar = ti->isec_t;
-        ti->ignoreThisHit = false;
-        if (type->ah) 
-          type->ah(*ti);
-        if (!ti->ignoreThisHit) {
-          // "accept" this hit
-          rayHit->hit.primID    = ti->primID;
-          rayHit->hit.geomID    = ti->geomID;
-          rayHit->hit.instID[0] = ti->instIdx;
-          args->valid[0] = -1;
-        } else {
-          ti->embreeRay->tfar = save_t;
-          args->valid[0] = 0;
-        }
+      if (!(ti->isec_t < INFINITY))
+        return -1;
+      
+      float save_t = ti->embreeRay->tfar;
+      ti->embreeRay->tfar = ti->isec_t;
+      ti->ignoreThisHit = false;
+      if (type->ah) 
+        type->ah(*ti);
+      if (ti->ignoreThisHit) {
+        ti->embreeRay->tfar = save_t;
+        return 0;
+      }
+      // "accept" this hit
+      rayHit->hit.primID    = ti->primID;
+      rayHit->hit.geomID    = ti->geomID;
+      rayHit->hit.instID[0] = ti->instIdx;
+      return +1;
+    }
+    
+    void virtualIntersect(const RTCIntersectFunctionNArguments* args)
+    {
+      int *valid = args->valid;
+      void *ptr  = args->geometryUserPtr;
+      UserGeom *user = (UserGeom *)ptr;
+      unsigned int primID = args->primID;
+      unsigned int geomID = args->geomID;
+      int instIdx = args->context->instID[0];
+      TraceInterface *ti = (TraceInterface *)args->context;
+      if (!ti->packetLanes) {
+        int result = intersectOne(ti,user,(RTCRayHit*)args->rayhit,
+                                  primID,geomID,instIdx);
+        if (result >= 0)
+          valid[0] = result ? -1 : 0;
+        return;
+      }
+
+      /* ray packet: run the programs lane by lane, each with its own
+         lane's interface */
+      const unsigned N = args->N;
+      RTCRayN *rays = RTCRayHitN_RayN(args->rayhit,N);
+      RTCHitN *hits = RTCRayHitN_HitN(args->rayhit,N);
+      for (unsigned i=0;i<N;i++) {
+        if (valid[i] != -1) continue;
+        RTCRayHit single;
+        loadLane(single.ray,single.hit,rays,hits,N,i);
+        int result = intersectOne(ti->packetLanes[i],user,&single,
+                                  primID,geomID,instIdx);
+        if (result > 0)
+          storeLane(rays,hits,N,i,single.ray,single.hit);
+        if (result >= 0)
+          valid[i] = result ? -1 : 0;
+      }
+    }
+
+    /*! occlusion queries' version of virtualIntersect: runs the same
+        intersect and any-hit programs, and marks rays that found an
+        accepted hit as occluded (tfar=-inf), which ends their
+        traversal */
+    void virtualOccluded(const RTCOccludedFunctionNArguments* args)
+    {
+      const int *valid = args->valid;
+      UserGeom *user = (UserGeom *)args->geometryUserPtr;
+      unsigned int primID = args->primID;
+      unsigned int geomID = args->geomID;
+      int instIdx = args->context->instID[0];
+      TraceInterface *ti = (TraceInterface *)args->context;
+      const unsigned N = args->N;
+      for (unsigned i=0;i<N;i++) {
+        if (valid[i] != -1) continue;
+        RTCRayHit single;
+        loadLane(single.ray,args->ray,N,i);
+        single.hit.primID    = RTC_INVALID_GEOMETRY_ID;
+        single.hit.geomID    = RTC_INVALID_GEOMETRY_ID;
+        single.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+        TraceInterface *lane = ti->packetLanes ? ti->packetLanes[i] : ti;
+        if (intersectOne(lane,user,&single,primID,geomID,instIdx) > 0)
+          RTCRayN_tfar(args->ray,N,i) = -INFINITY;
       }
     }
 
@@ -88,6 +149,36 @@ namespace rtc {
         instIDs(instIDs)
     {}
 
+    RTCScene GeomGroup::newScene()
+    {
+      embree::Device *device = (embree::Device *)this->device;
+      RTCScene scene = rtcNewScene(device->embreeDevice);
+      switch (buildQuality) {
+      case BUILD_QUALITY_FAST_TRACE:
+        rtcSetSceneFlags(scene,RTC_SCENE_FLAG_COMPACT);
+        rtcSetSceneBuildQuality(scene,RTC_BUILD_QUALITY_HIGH);
+        break;
+      case BUILD_QUALITY_FAST_BUILD:
+        rtcSetSceneFlags(scene,RTC_SCENE_FLAG_DYNAMIC);
+        rtcSetSceneBuildQuality(scene,RTC_BUILD_QUALITY_LOW);
+        break;
+      default:
+        break;
+      }
+      return scene;
+    }
+    
+    /*! per-geometry build quality to go with the one of the scene; for
+        the default we leave embree's (medium) */
+    static inline void setGeometryBuildQuality(RTCGeometry eg,
+                                               BuildQuality quality)
+    {
+      if (quality == BUILD_QUALITY_FAST_TRACE)
+        rtcSetGeometryBuildQuality(eg,RTC_BUILD_QUALITY_HIGH);
+      else if (quality == BUILD_QUALITY_FAST_BUILD)
+        rtcSetGeometryBuildQuality(eg,RTC_BUILD_QUALITY_LOW);
+    }
+    
     void UserGeomGroup::buildAccel() 
     {
       if (embreeScene) {
@@ -96,7 +187,7 @@ namespace rtc {
       }
 
       embree::Device *device = (embree::Device *)this->device;
-      embreeScene = rtcNewScene(device->embreeDevice);
+      embreeScene = newScene();
       for (auto geom : geoms) {
         UserGeom *user = (UserGeom *)geom;
         RTCGeometry eg
@@ -108,6 +199,8 @@ namespace rtc {
       
         rtcSetGeometryEnableFilterFunctionFromArguments(eg,true);
         rtcSetGeometryIntersectFunction(eg,virtualIntersect);
+        rtcSetGeometryOccludedFunction(eg,virtualOccluded);
+        setGeometryBuildQuality(eg,buildQuality);
         rtcCommitGeometry(eg);
         rtcAttachGeometry(embreeScene,eg);
         rtcEnableGeometry(eg);
@@ -115,6 +208,28 @@ namespace rtc {
         rtcReleaseGeometry(eg);
       }
       rtcCommitScene(embreeScene);
+
+      builtCounts.clear();
+      for (auto geom : geoms)
+        builtCounts.push_back(((UserGeom *)geom)->primCount);
+    }
+
+    void UserGeomGroup::refitAccel() 
+    {
+      std::vector<int> counts;
+      for (auto geom : geoms)
+        counts.push_back(((UserGeom *)geom)->primCount);
+      if (!embreeScene || counts != builtCounts)
+        return buildAccel();
+      
+      rtcSetSceneFlags(embreeScene,
+                       rtcGetSceneFlags(embreeScene)|RTC_SCENE_FLAG_DYNAMIC);
+      for (int geomID=0;geomID<(int)geoms.size();geomID++) {
+        RTCGeometry eg = rtcGetGeometry(embreeScene,geomID);
+        rtcSetGeometryBuildQuality(eg,RTC_BUILD_QUALITY_REFIT);
+        rtcCommitGeometry(eg);
+      }
+      rtcCommitScene(embreeScene);
     }
 
 
@@ -124,6 +239,16 @@ namespace rtc {
     {}
 
   
+    /*! vertex and index (or sphere) counts of a triangles group's
+        geom, to check if a refit is possible */
+    static inline vec2i builtinPrimCounts(Geom *geom)
+    {
+      if (SpheresGeom *spheres = dynamic_cast<SpheresGeom *>(geom))
+        return { spheres->numSpheres,0 };
+      TrianglesGeom *triangles = (TrianglesGeom *)geom;
+      return { triangles->numVertices,triangles->numIndices };
+    }
+    
     void TrianglesGroup::buildAccel() 
     {
       if (embreeScene) {
@@ -132,8 +257,25 @@ namespace rtc {
       }
     
       embree::Device *device = (embree::Device *)this->device;
-      embreeScene = rtcNewScene(device->embreeDevice);
+      embreeScene = newScene();
       for (auto geom : geoms) {
+        if (SpheresGeom *spheres = dynamic_cast<SpheresGeom *>(geom)) {
+          RTCGeometry eg
+            = rtcNewGeometry(device->embreeDevice,
+                             RTC_GEOMETRY_TYPE_SPHERE_POINT);
+          rtcSetSharedGeometryBuffer(eg, RTC_BUFFER_TYPE_VERTEX, 0,
+                                     RTC_FORMAT_FLOAT4,
+                                     spheres->spheres, 0,
+                                     sizeof(vec4f), spheres->numSpheres);
+          rtcSetGeometryEnableFilterFunctionFromArguments(eg,geom->type->ah != 0);
+          setGeometryBuildQuality(eg,buildQuality);
+          rtcCommitGeometry(eg);
+          rtcAttachGeometry(embreeScene,eg);
+          rtcEnableGeometry(eg);
+          rtcReleaseGeometry(eg);
+          continue;
+        }
+        
         TrianglesGeom *triangles = (TrianglesGeom *)geom;
         assert(triangles);
         RTCGeometry eg
@@ -157,7 +299,10 @@ namespace rtc {
                              vertexBuffer, 0,
                              sizeof(vec3f), triangles->numVertices);
         
-        rtcSetGeometryEnableFilterFunctionFromArguments(eg,true);
+        /* without an any-hit program, embree can skip calling into
+           the filter for each candidate hit */
+        rtcSetGeometryEnableFilterFunctionFromArguments(eg,triangles->type->ah != 0);
+        setGeometryBuildQuality(eg,buildQuality);
         rtcCommitGeometry(eg);
         rtcAttachGeometry(embreeScene,eg);
         rtcEnableGeometry(eg);
@@ -167,6 +312,43 @@ namespace rtc {
         rtcReleaseGeometry(eg);
       }
       rtcCommitScene(embreeScene);
+
+      builtCounts.clear();
+      for (auto geom : geoms)
+        builtCounts.push_back(builtinPrimCounts(geom));
+    }
+
+    void TrianglesGroup::refitAccel() 
+    {
+      std::vector<vec2i> counts;
+      for (auto geom : geoms)
+        counts.push_back(builtinPrimCounts(geom));
+      if (!embreeScene || counts != builtCounts)
+        return buildAccel();
+
+      rtcSetSceneFlags(embreeScene,
+                       rtcGetSceneFlags(embreeScene)|RTC_SCENE_FLAG_DYNAMIC);
+      for (int geomID=0;geomID<(int)geoms.size();geomID++) {
+        RTCGeometry eg = rtcGetGeometry(embreeScene,geomID);
+        /* the app may have handed us a new vertex array, so re-bind
+           rather than just flag the old one as modified */
+        if (SpheresGeom *spheres = dynamic_cast<SpheresGeom *>(geoms[geomID]))
+          rtcSetSharedGeometryBuffer(eg, RTC_BUFFER_TYPE_VERTEX, 0,
+                                     RTC_FORMAT_FLOAT4,
+                                     spheres->spheres, 0,
+                                     sizeof(vec4f), spheres->numSpheres);
+        else {
+          TrianglesGeom *triangles = (TrianglesGeom *)geoms[geomID];
+          rtcSetSharedGeometryBuffer(eg, RTC_BUFFER_TYPE_VERTEX, 0,
+                                     RTC_FORMAT_FLOAT3,
+                                     triangles->vertices, 0,
+                                     sizeof(vec3f), triangles->numVertices);
+        }
+        rtcUpdateGeometryBuffer(eg, RTC_BUFFER_TYPE_VERTEX, 0);
+        rtcSetGeometryBuildQuality(eg,RTC_BUILD_QUALITY_REFIT);
+        rtcCommitGeometry(eg);
+      }
+      rtcCommitScene(embreeScene);
     }
 
 
@@ -183,6 +365,27 @@ namespace rtc {
       xfms = newXfms;
     }
 
+    /*! a top-level scene's flags and build quality: one whose
+        transforms keep changing gets built for fast refits, a static
+        one for fast traversal */
+    static void setInstanceSceneFlags(RTCScene scene, bool dynamic)
+    {
+      static const bool robust = getenv("BARNEY_EMBREE_ROBUST") != nullptr;
+      RTCSceneFlags flags = RTC_SCENE_FLAG_NONE;
+      if (dynamic)
+        flags = flags | RTC_SCENE_FLAG_DYNAMIC;
+      /* instances of very different scales (or far away from the
+         origin) can make embree's faster, less conservative
+         traversal miss hits */
+      if (robust)
+        flags = flags | RTC_SCENE_FLAG_ROBUST;
+      rtcSetSceneFlags(scene,flags);
+      rtcSetSceneBuildQuality(scene,
+                              dynamic
+                              ? RTC_BUILD_QUALITY_LOW
+                              : RTC_BUILD_QUALITY_HIGH);
+    }
+    
     void InstanceGroup::buildAccel()
     {
       embree::Device *device = (embree::Device *)this->device;
@@ -199,6 +402,7 @@ namespace rtc {
       for (auto &xfm : inverseXfms) xfm = rcp(xfm);
     
       embreeScene = rtcNewScene(device->embreeDevice);
+      setInstanceSceneFlags(embreeScene,transformsAreDynamic);
       for (int instIdx=0;instIdx<groups.size();instIdx++) {
         embree::Group *group = (embree::Group *)groups[instIdx];
         RTCGeometry geom
@@ -212,6 +416,88 @@ namespace rtc {
         rtcAttachGeometry(embreeScene,geom);
         rtcCommitGeometry(geom);
         rtcEnableGeometry(geom);
+        /* the scene holds on to it */
+        rtcReleaseGeometry(geom);
+      }
+      rtcCommitScene(embreeScene);
+      builtNumInstances = (int)groups.size();
+      updateTraceFeatures();
+    }
+
+    void InstanceGroup::updateTraceFeatures()
+    {
+      int features = RTC_FEATURE_FLAG_INSTANCE;
+      needsFilter = false;
+      for (auto group : groups) {
+        if (dynamic_cast<UserGeomGroup *>(group)) {
+          features |= RTC_FEATURE_FLAG_USER_GEOMETRY_CALLBACK_IN_GEOMETRY;
+          continue;
+        }
+        for (auto geom : ((GeomGroup *)group)->geoms) {
+          features
+            |= dynamic_cast<SpheresGeom *>(geom)
+            ? RTC_FEATURE_FLAG_SPHERE_POINT
+            : RTC_FEATURE_FLAG_TRIANGLE;
+          if (geom->type->ah)
+            needsFilter = true;
+        }
+      }
+      if (needsFilter)
+        features |= RTC_FEATURE_FLAG_FILTER_FUNCTION_IN_ARGUMENTS;
+      featureMask = (RTCFeatureFlags)features;
+    }
+    
+    void InstanceGroup::refitAccel()
+    {
+      if (!embreeScene
+          || builtNumInstances != (int)groups.size()
+          || xfms.size() != groups.size())
+        return buildAccel();
+
+      inverseXfms = xfms;
+      for (auto &xfm : inverseXfms) xfm = rcp(xfm);
+      
+      /* from now on this is an animated scene, so have embree build
+         it for that */
+      if (!transformsAreDynamic) {
+        transformsAreDynamic = true;
+        setInstanceSceneFlags(embreeScene,true);
+      }
+      for (int instIdx=0;instIdx<(int)groups.size();instIdx++) {
+        embree::Group *group = (embree::Group *)groups[instIdx];
+        RTCGeometry geom = rtcGetGeometry(embreeScene,instIdx);
+        /* the instanced group may have gotten rebuilt into a new
+           scene since */
+        rtcSetGeometryInstancedScene(geom,group->embreeScene);
+        rtcSetGeometryTransform(geom,0,RTC_FORMAT_FLOAT3X4_COLUMN_MAJOR,
+                                &xfms[instIdx]);
+        rtcCommitGeometry(geom);
+      }
+      rtcCommitScene(embreeScene);
+      /* instanced groups may have been rebuilt with other geoms */
+      updateTraceFeatures();
+    }
+
+    void InstanceGroup::updateTransforms(const std::vector<int> &which,
+                                         const std::vector<affine3f> &newXfms)
+    {
+      for (size_t i=0;i<which.size();i++)
+        xfms[which[i]] = newXfms[i];
+      if (!embreeScene
+          || builtNumInstances != (int)groups.size()
+          || inverseXfms.size() != groups.size())
+        return refitAccel();
+
+      if (!transformsAreDynamic) {
+        transformsAreDynamic = true;
+        setInstanceSceneFlags(embreeScene,true);
+      }
+      for (int instIdx : which) {
+        inverseXfms[instIdx] = rcp(xfms[instIdx]);
+        RTCGeometry geom = rtcGetGeometry(embreeScene,instIdx);
+        rtcSetGeometryTransform(geom,0,RTC_FORMAT_FLOAT3X4_COLUMN_MAJOR,
+                                &xfms[instIdx]);
+        rtcCommitGeometry(geom);
       }
       rtcCommitScene(embreeScene);
     }
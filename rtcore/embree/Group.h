@@ -14,9 +14,13 @@ namespace rtc {
         : device(device)
       {}
       virtual ~Group() = default;
-      void refitAccel() { buildAccel(); }
+      virtual void refitAccel() { buildAccel(); }
       virtual void buildAccel() = 0;
       virtual void setTransforms(const std::vector<affine3f> &) {}
+      /*! sets the transforms of only the listed instances, and updates
+          the accel for them */
+      virtual void updateTransforms(const std::vector<int> &which,
+                                    const std::vector<affine3f> &newXfms) {}
       
       rtc::AccelHandle getDD() const
       {
@@ -40,8 +44,13 @@ namespace rtc {
       
       Geom *getGeom(int geomID) 
       { assert(geomID >= 0 && geomID < geoms.size()); return geoms[geomID]; }
+
+      /*! creates a new (empty) scene with flags and build quality
+          matching this group's buildQuality */
+      RTCScene newScene();
       
       std::vector<Geom *> geoms;
+      BuildQuality buildQuality = BUILD_QUALITY_DEFAULT;
     };
       
     struct TrianglesGroup : public GeomGroup {
@@ -49,7 +58,13 @@ namespace rtc {
                      const std::vector<Geom *> &geoms);
       
       void buildAccel() override;
+      /*! re-binds the (possibly moved) vertex buffers and re-commits
+          the existing scene; falls back to a rebuild if the number of
+          vertices or triangles changed */
+      void refitAccel() override;
       
+      /*! per geom, the vertex and index counts it got built with */
+      std::vector<vec2i> builtCounts;
     };
   
     struct UserGeomGroup : public GeomGroup {
@@ -59,6 +74,12 @@ namespace rtc {
       {}
 
       void buildAccel() override;
+      /*! re-queries all prims' bounds, and re-commits the existing
+          scene; falls back to a rebuild if prim counts changed */
+      void refitAccel() override;
+
+      /*! per geom, the prim count it got built with */
+      std::vector<int> builtCounts;
     };
   
     struct InstanceGroup : public Group {
@@ -70,12 +91,39 @@ namespace rtc {
       GeomGroup *getGroup(int groupID);
 
       void buildAccel() override;
+      /*! updates the existing instances' transforms (and instanced
+          scenes) in place, and re-commits; falls back to a rebuild if
+          the number of instances changed */
+      void refitAccel() override;
       void setTransforms(const std::vector<affine3f> &newXfms) override;
+      /*! re-sets and re-commits only the listed instances' geometries,
+          then re-commits the scene */
+      void updateTransforms(const std::vector<int> &which,
+                            const std::vector<affine3f> &newXfms) override;
     
       std::vector<Group*>   groups;
       std::vector<affine3f> xfms;
       std::vector<affine3f> inverseXfms;
       std::vector<int>      instIDs;
+      /*! number of instances the current scene got built with */
+      int  builtNumInstances = 0;
+      /*! set once transforms got updated, at which point we assume
+          they'll keep getting updated */
+      bool transformsAreDynamic = false;
+
+      /*! recomputes featureMask and needsFilter from the kinds of
+          geometry (and programs) the instanced groups contain */
+      void updateTraceFeatures();
+      /*! the embree features that tracing this world needs, so
+          embree can pick traversal kernels that support only those -
+          for pure triangle scenes: instances and triangles, plus
+          filter functions only if some geometry has an any-hit
+          program */
+      RTCFeatureFlags featureMask = RTC_FEATURE_FLAG_ALL;
+      /*! whether any (triangles or spheres) geometry needs its any-hit
+          program run through our intersection filter; user geometries
+          run theirs from their own intersect callbacks */
+      bool needsFilter = true;
     };
     
   }
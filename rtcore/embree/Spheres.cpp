@@ -0,0 +1,33 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "rtcore/embree/Spheres.h"
+
+namespace rtc {
+  namespace embree {
+
+    SpheresGeom::SpheresGeom(SpheresGeomType *type)
+      : Geom(type)
+    {}
+    
+    /*! only for user geoms */
+    void SpheresGeom::setPrimCount(int primCount)
+    {
+      throw std::runtime_error("setPrimCount only makes sense for user geoms");
+    }
+    
+    void SpheresGeom::setVertices(Buffer *vertices,
+                                  int numVertices)
+    {
+      this->spheres = (vec4f*)((Buffer *)vertices)->mem;
+      this->numSpheres = numVertices;
+    }
+    
+    void SpheresGeom::setIndices(Buffer *indices, int numIndices)
+    {
+      throw std::runtime_error("setIndices does not make sense for spheres");
+    }
+
+  }
+}
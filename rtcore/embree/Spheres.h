@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "rtcore/embree/Buffer.h"
+#include "rtcore/embree/GeomType.h"
+#include "rtcore/embree/Geom.h"
+
+namespace rtc {
+  namespace embree {
+
+    struct SpheresGeomType;
+    
+    /*! spheres that get intersected by embree's own
+        RTC_GEOMETRY_TYPE_SPHERE_POINT code, rather than through a
+        user geom intersection callback. Lives in triangles groups,
+        and gets its any-hit program called through the same filter
+        function as triangles do */
+    struct SpheresGeom : public Geom
+    {
+      SpheresGeom(SpheresGeomType *type);
+
+      /*! only for user geoms */
+      void setPrimCount(int primCount) override;
+      /*! sets the (x,y,z,radius) vec4f's of all spheres */
+      void setVertices(Buffer *vertices, int numVertices) override;
+      void setIndices(Buffer *indices, int numIndices) override;
+
+      int    numSpheres = 0;
+      vec4f *spheres    = 0;
+    };
+    
+  }
+}
+
@@ -3,6 +3,10 @@
 
 
 #include "rtcore/embree/Texture.h"
+#include "rtcore/embree/Float16.h"
+#include "rtcore/embree/BlockCompression.h"
+#include <limits>
+#include <type_traits>
 
 namespace rtc {
   namespace embree {
@@ -105,8 +109,17 @@ namespace rtc {
                              const void *texels)
       : device(device),
         dims(dims),
-        format(format)
+        format(isBlockCompressed(format) ? decodedFormatOf(format) : format)
     {
+      /* we only ever sample uncompressed texels, so decode right here */
+      std::vector<uint8_t> decoded;
+      if (isBlockCompressed(format)) {
+        if (dims.z != 0)
+          throw std::runtime_error("block-compressed texture formats are 2D only");
+        decoded = decodeBlocks(format,vec2i(dims.x,dims.y),texels);
+        texels  = decoded.data();
+        format  = this->format;
+      }
       // cudaChannelFormatDesc desc;
       size_t sizeOfScalar;
       size_t numScalarsPerTexel;
@@ -145,11 +158,48 @@ namespace rtc {
         assert(0);
       };
 
+      this->sizeOfScalar = sizeOfScalar;
+      this->numScalarsPerTexel = numScalarsPerTexel;
+      
       size_t padded_x = (unsigned)dims.x;
       size_t padded_y = std::max(1u,(unsigned)dims.y);
       size_t padded_z = std::max(1u,(unsigned)dims.z);
-      data.resize(padded_x*padded_y*padded_z*numScalarsPerTexel*sizeOfScalar);
-      memcpy(data.data(),texels,data.size());
+      size_t numTexels = padded_x*padded_y*padded_z;
+
+      const bool isVolume
+        = dims.z > 1 && numScalarsPerTexel == 1;
+      bricked
+        = isVolume && getenv("BARNEY_EMBREE_LINEAR_TEXTURES") == nullptr;
+      halfFloat
+        = isVolume && format == rtc::FLOAT
+        && getenv("BARNEY_EMBREE_HALF_VOLUMES") != nullptr;
+      if (!bricked && !halfFloat) {
+        data.resize(numTexels*numScalarsPerTexel*sizeOfScalar);
+        memcpy(data.data(),texels,data.size());
+        return;
+      }
+
+      const size_t storedSize = halfFloat ? sizeof(uint16_t) : sizeOfScalar;
+      if (bricked) {
+        numBricks = divRoundUp(dims,vec3i(brickSize));
+        data.resize(size_t(numBricks.x)*numBricks.y*numBricks.z
+                    *(brickSize*brickSize*brickSize)*storedSize);
+      } else
+        data.resize(numTexels*storedSize);
+      
+      const uint8_t *in = (const uint8_t *)texels;
+      for (int iz=0;iz<dims.z;iz++)
+        for (int iy=0;iy<dims.y;iy++)
+          for (int ix=0;ix<dims.x;ix++) {
+            size_t inIdx = ix+size_t(dims.x)*(iy+size_t(dims.y)*iz);
+            size_t outIdx = texelIndex(ix,iy,iz);
+            if (halfFloat)
+              ((uint16_t*)data.data())[outIdx]
+                = float32ToFloat16(((const float *)in)[inIdx]);
+            else
+              memcpy(data.data()+outIdx*storedSize,
+                     in+inIdx*storedSize,storedSize);
+          }
     }
 
     Texture *TextureData::createTexture(const rtc::TextureDesc &desc) 
@@ -169,61 +219,192 @@ namespace rtc {
     {};
 
 
+    /*! the texel at given index of given texels, as float4; or
+        given border color if the index is negative */
     template<typename T>
-    vec4f getTexel(TextureData *data,
+    vec4f getTexel(const uint8_t *texels,
                     const rtc::TextureDesc &desc,
                     int64_t idx)
     {
-      printf("gettexel not implemented for type... %i == %i\n",(int)data->format,
-             (int)rtc::UCHAR4);
+      printf("gettexel not implemented for this texel type\n");
       return vec4f(0.f);
     }
     
     template<>
-    vec4f getTexel<vec4f>(TextureData *data,
+    vec4f getTexel<vec4f>(const uint8_t *texels,
                            const rtc::TextureDesc &desc,
                            int64_t idx)
     {
       if (idx < 0) return desc.borderColor;
-      vec4f v = ((const vec4f*)data->data.data())[idx];
+      vec4f v = ((const vec4f*)texels)[idx];
       return v;
     }
     
     template<>
-    vec4f getTexel<float>(TextureData *data,
+    vec4f getTexel<float>(const uint8_t *texels,
                            const rtc::TextureDesc &desc,
                            int64_t idx)
     {
       if (idx < 0) return desc.borderColor;
-      float v = ((const float*)data->data.data())[idx];
+      float v = ((const float*)texels)[idx];
       return vec4f(v);
     }
     
     
     template<>
-    vec4f getTexel<vec4uc>(TextureData *data,
+    vec4f getTexel<vec4uc>(const uint8_t *texels,
                             const rtc::TextureDesc &desc,
                             int64_t idx)
     {
-      // printf("gettexel uchar4 data %p idx %li, eltsize %li\n",data,idx,
-      //        sizeof(vec4uc),data);
       if (idx < 0) return desc.borderColor;
-      vec4uc v = ((const vec4uc*)data->data.data())[idx];
+      vec4uc v = ((const vec4uc*)texels)[idx];
       vec4f  vf = vec4f(v);
       return vf * 1.f/255.f;
     }
 
     template<>
-    vec4f getTexel<unsigned char>(TextureData *data,
+    vec4f getTexel<unsigned char>(const uint8_t *texels,
                                   const rtc::TextureDesc &desc,
                                   int64_t idx)
     {
       if (idx < 0) return desc.borderColor;
-      unsigned char v = ((const unsigned char*)data->data.data())[idx];
+      unsigned char v = ((const unsigned char*)texels)[idx];
       vec4f  vf = vec4f(v);
       return vf * 1.f/255.f;
     }
 
+    template<>
+    vec4f getTexel<uint16_t>(const uint8_t *texels,
+                             const rtc::TextureDesc &desc,
+                             int64_t idx)
+    {
+      if (idx < 0) return desc.borderColor;
+      uint16_t v = ((const uint16_t*)texels)[idx];
+      return vec4f(v * (1.f/65535.f));
+    }
+
+    template<>
+    vec4f getTexel<float16_t>(const uint8_t *texels,
+                              const rtc::TextureDesc &desc,
+                              int64_t idx)
+    {
+      if (idx < 0) return desc.borderColor;
+      uint16_t v = ((const uint16_t*)texels)[idx];
+      return vec4f(float16ToFloat32(v));
+    }
+
+    /*! inverse of getTexel(), for writing filtered values */
+    template<typename T> inline T toTexel(vec4f v);
+    template<> inline vec4f toTexel<vec4f>(vec4f v) { return v; }
+    template<> inline float toTexel<float>(vec4f v) { return v.x; }
+    inline unsigned char toUnorm8(float f)
+    { return (unsigned char)(clamp(f,0.f,1.f)*255.f+.5f); }
+    template<> inline unsigned char toTexel<unsigned char>(vec4f v)
+    { return toUnorm8(v.x); }
+    template<> inline vec4uc toTexel<vec4uc>(vec4f v)
+    { return vec4uc(toUnorm8(v.x),toUnorm8(v.y),toUnorm8(v.z),toUnorm8(v.w)); }
+    template<> inline uint16_t toTexel<uint16_t>(vec4f v)
+    { return (uint16_t)(clamp(v.x,0.f,1.f)*65535.f+.5f); }
+
+    /*! 2x2 box filter of a finer level into the next coarser one;
+        for odd sizes the last row/column of the finer level gets
+        (re-)used as its own neighbor */
+    template<typename T>
+    void downsampleMipLevel(const uint8_t *finer, vec2i finerDims,
+                            TextureData::MipLevel &coarser)
+    {
+      coarser.dims = max(vec2i(1),finerDims/2);
+      coarser.texels.resize(size_t(coarser.dims.x)*coarser.dims.y*sizeof(T));
+      T *out = (T *)coarser.texels.data();
+      rtc::TextureDesc desc;
+      for (int iy=0;iy<coarser.dims.y;iy++)
+        for (int ix=0;ix<coarser.dims.x;ix++) {
+          int x0 = std::min(2*ix,finerDims.x-1), x1 = std::min(2*ix+1,finerDims.x-1);
+          int y0 = std::min(2*iy,finerDims.y-1), y1 = std::min(2*iy+1,finerDims.y-1);
+          vec4f sum
+            = getTexel<T>(finer,desc,x0+int64_t(finerDims.x)*y0)
+            + getTexel<T>(finer,desc,x1+int64_t(finerDims.x)*y0)
+            + getTexel<T>(finer,desc,x0+int64_t(finerDims.x)*y1)
+            + getTexel<T>(finer,desc,x1+int64_t(finerDims.x)*y1);
+          out[ix+size_t(coarser.dims.x)*iy] = toTexel<T>(.25f*sum);
+        }
+    }
+
+    template<typename T>
+    void buildMipLevels(TextureData *data)
+    {
+      const uint8_t *finer = data->data.data();
+      vec2i finerDims = { data->dims.x,data->dims.y };
+      while (finerDims.x > 1 || finerDims.y > 1) {
+        data->mipLevels.emplace_back();
+        auto &coarser = data->mipLevels.back();
+        downsampleMipLevel<T>(finer,finerDims,coarser);
+        finer     = coarser.texels.data();
+        finerDims = coarser.dims;
+      }
+    }
+    
+    void TextureData::buildMipMaps()
+    {
+      if (!mipLevels.empty() || dims.z != 0 || dims.y == 0) return;
+      switch (format) {
+      case rtc::UCHAR:  buildMipLevels<unsigned char>(this); break;
+      case rtc::UCHAR4: buildMipLevels<vec4uc>(this); break;
+      case rtc::FLOAT4: buildMipLevels<vec4f>(this); break;
+      case rtc::FLOAT:  buildMipLevels<float>(this); break;
+      case rtc::USHORT: buildMipLevels<uint16_t>(this); break;
+      default: break;
+      }
+    }
+    
+    /*! the 8 corner values of a trilinear fetch from a
+        single-channel texture, as floats; corner (dx,dy,dz) goes to
+        v[dx+2*dy+4*dz] */
+    template<typename T>
+    inline void fetchCorners(const TextureData *data,
+                             const int ix[2], const int iy[2], const int iz[2],
+                             float v[8])
+    {
+      const T *texels = (const T *)data->data.data();
+      for (int i=0;i<8;i++)
+        v[i] = (float)texels[data->texelIndex(ix[i&1],iy[(i>>1)&1],iz[i>>2])];
+      if constexpr (std::is_integral<T>::value) {
+        const float scale = 1.f/float(std::numeric_limits<T>::max());
+        for (int i=0;i<8;i++) v[i] *= scale;
+      }
+    }
+    
+    template<>
+    inline void fetchCorners<float16_t>(const TextureData *data,
+                                        const int ix[2], const int iy[2], const int iz[2],
+                                        float v[8])
+    {
+      const uint16_t *texels = (const uint16_t *)data->data.data();
+      uint16_t h[8];
+      for (int i=0;i<8;i++)
+        h[i] = texels[data->texelIndex(ix[i&1],iy[(i>>1)&1],iz[i>>2])];
+      float16ToFloat32x8(h,v);
+    }
+
+    /*! trilinear interpolation of 8 corner values as produced by
+        fetchCorners(); written so the compiler can do the z (and y)
+        steps as vector ops */
+    inline float trilerp(const float v[8], float fx, float fy, float fz)
+    {
+      float c[4];
+      for (int i=0;i<4;i++)
+        c[i] = v[i] + fz*(v[i+4]-v[i]);
+      float c0 = c[0] + fy*(c[2]-c[0]);
+      float c1 = c[1] + fy*(c[3]-c[1]);
+      return c0 + fx*(c1-c0);
+    }
+
+    template<typename T>
+    struct IsScalarTexel { enum { value = 0 }; };
+    template<> struct IsScalarTexel<float>         { enum { value = 1 }; };
+    template<> struct IsScalarTexel<float16_t>     { enum { value = 1 }; };
+    template<> struct IsScalarTexel<unsigned char> { enum { value = 1 }; };
+    template<> struct IsScalarTexel<uint16_t>      { enum { value = 1 }; };
     
     template<typename T>
     struct TextureSamplerT<T,rtc::FILTER_MODE_POINT>
@@ -237,14 +418,14 @@ namespace rtc {
       {
         int size = data->dims.x;
         int ix = uint32_t(tc * size) % (uint32_t)size;
-        return getTexel<T>(data,desc,ix);
+        return getTexel<T>(data->data.data(),desc,ix);
       }
       vec4f tex2D(vec2f tc) override
       {
         vec2i size = {data->dims.x,data->dims.y};
         int ix = uint32_t(fabsf(tc.x) * size.x) % (uint32_t)size.x;
         int iy = uint32_t(fabsf(tc.y) * size.y) % (uint32_t)size.y;
-        return getTexel<T>(data,desc,ix+iy*size.x);
+        return getTexel<T>(data->data.data(),desc,ix+iy*size.x);
       }
       vec4f tex3D(vec3f tc) override
       {
@@ -259,20 +440,13 @@ namespace rtc {
           uint32_t lx = (uint32_t)clamp(tc.x,0.f,Nx-1.f);
           uint32_t ly = (uint32_t)clamp(tc.y,0.f,Ny-1.f);
           uint32_t lz = (uint32_t)clamp(tc.z,0.f,Nz-1.f);
-          auto pixelAddress = [](int ix, int iy, int iz, int Nx, int Ny) {
-            return (std::min(ix,std::min(iy,iz)) == -1)
-              ? size_t(-1)
-              : (ix+size_t(Nx)*(iy+size_t(Ny)*(iz)));
-          };
-
-          int64_t i = pixelAddress(lx,ly,lz,
-                                   data->dims.x,data->dims.y);
-          return getTexel<T>(data,desc,i);
+          int64_t i = data->texelIndex(lx,ly,lz);
+          return getTexel<T>(data->data.data(),desc,i);
         }
         vec2i size = {data->dims.x,data->dims.y};
         int ix = uint32_t(fabsf(tc.x) * size.x) % (uint32_t)size.x;
         int iy = uint32_t(fabsf(tc.y) * size.y) % (uint32_t)size.y;
-        return getTexel<T>(data,desc,ix+iy*size.x);
+        return getTexel<T>(data->data.data(),desc,ix+iy*size.x);
       }
     };
 
@@ -290,36 +464,65 @@ namespace rtc {
       {
         int size = data->dims.x;
         int ix = uint32_t(tc * size) % (uint32_t)size;
-        return getTexel<T>(data,desc,ix);
+        return getTexel<T>(data->data.data(),desc,ix);
+      }
+      /*! bilinear fetch from a 2D level with given texels and
+          size; normalized coordinates only */
+      vec4f bilerp(const uint8_t *texels, vec2i size, vec2f tc)
+      {
+        LerpAddresses lx,ly;
+        computeAddress(lx,desc.addressMode[0],tc.x,size.x);
+        computeAddress(ly,desc.addressMode[1],tc.y,size.y);
+
+        auto pixelAddress = [](int ix, int iy, int size) {
+          return (std::min(ix,iy) == -1) ? -1 : (ix+iy*size);
+        };
+        int i00 = pixelAddress(lx.idx0,ly.idx0,size.x);
+        int i01 = pixelAddress(lx.idx1,ly.idx0,size.x);
+        int i10 = pixelAddress(lx.idx0,ly.idx1,size.x);
+        int i11 = pixelAddress(lx.idx1,ly.idx1,size.x);
+
+        vec4f v00 = getTexel<T>(texels,desc,i00);
+        vec4f v01 = getTexel<T>(texels,desc,i01);
+        vec4f v10 = getTexel<T>(texels,desc,i10);
+        vec4f v11 = getTexel<T>(texels,desc,i11);
+
+        vec4f v0 = lerp_l(lx.f,v00,v01);
+        vec4f v1 = lerp_l(lx.f,v10,v11);
+        return lerp_l(ly.f,v0,v1);
       }
+      
       vec4f tex2D(vec2f tc) override
       {
         if (desc.normalizedCoords == false) {
           return vec4f(0.f,0.f,0.f,0.f);
         } else {
-          LerpAddresses lx,ly;
-          computeAddress(lx,desc.addressMode[0],tc.x,data->dims.x);
-          computeAddress(ly,desc.addressMode[1],tc.y,data->dims.y);
-
-          auto pixelAddress = [](int ix, int iy, int size) {
-            return (std::min(ix,iy) == -1) ? -1 : (ix+iy*size);
-          };
-          int i00 = pixelAddress(lx.idx0,ly.idx0,data->dims.x);
-          int i01 = pixelAddress(lx.idx1,ly.idx0,data->dims.x);
-          int i10 = pixelAddress(lx.idx0,ly.idx1,data->dims.x);
-          int i11 = pixelAddress(lx.idx1,ly.idx1,data->dims.x);
-
-          vec4f v00 = getTexel<T>(data,desc,i00);
-          vec4f v01 = getTexel<T>(data,desc,i01);
-          vec4f v10 = getTexel<T>(data,desc,i10);
-          vec4f v11 = getTexel<T>(data,desc,i11);
-
-          vec4f v0 = lerp_l(lx.f,v00,v01);
-          vec4f v1 = lerp_l(lx.f,v10,v11);
-          return lerp_l(ly.f,v0,v1);
+          return bilerp(data->data.data(),{data->dims.x,data->dims.y},tc);
         }
       }
 
+      /*! trilinear: bilinear in the two closest mip levels, and
+          linear between those */
+      vec4f tex2DLod(vec2f tc, float lod) override
+      {
+        const int numLevels = 1+(int)data->mipLevels.size();
+        if (!desc.mipMaps || numLevels == 1 || !(lod > 0.f))
+          return tex2D(tc);
+        lod = std::min(lod,float(numLevels-1));
+        int   level = int(lod);
+        float f     = lod-level;
+        vec4f v0 = sampleLevel(level,tc);
+        if (f == 0.f || level+1 >= numLevels) return v0;
+        return lerp_l(f,v0,sampleLevel(level+1,tc));
+      }
+
+      vec4f sampleLevel(int level, vec2f tc)
+      {
+        if (level == 0) return tex2D(tc);
+        const TextureData::MipLevel &mip = data->mipLevels[level-1];
+        return bilerp(mip.texels.data(),mip.dims,tc);
+      }
+
 
       inline void lerpCoords_notNormalized(vec2i &out_coords,
                                            float &out_f,
@@ -374,30 +577,35 @@ namespace rtc {
           int iy1 = ly.y;
           int iz0 = lz.x;
           int iz1 = lz.y;
-        
-          auto pixelAddress = [](int ix, int iy, int iz, int Nx, int Ny) {
-            return (std::min(ix,std::min(iy,iz)) == -1)
-              ? size_t(-1)
-              : (ix+size_t(Nx)*(iy+size_t(Ny)*(iz)));
-          };
-
-          int64_t i000 = pixelAddress(ix0,iy0,iz0,Nx,Ny);
-          int64_t i001 = pixelAddress(ix1,iy0,iz0,Nx,Ny);
-          int64_t i010 = pixelAddress(ix0,iy1,iz0,Nx,Ny);
-          int64_t i011 = pixelAddress(ix1,iy1,iz0,Nx,Ny);
-          int64_t i100 = pixelAddress(ix0,iy0,iz1,Nx,Ny);
-          int64_t i101 = pixelAddress(ix1,iy0,iz1,Nx,Ny);
-          int64_t i110 = pixelAddress(ix0,iy1,iz1,Nx,Ny);
-          int64_t i111 = pixelAddress(ix1,iy1,iz1,Nx,Ny);
+
+          if constexpr (IsScalarTexel<T>::value) {
+            /* the common case for volumes: fetch all eight corners
+               into one array, and interpolate that */
+            const int ix[2] = { ix0,ix1 };
+            const int iy[2] = { iy0,iy1 };
+            const int iz[2] = { iz0,iz1 };
+            float v[8];
+            fetchCorners<T>(data,ix,iy,iz,v);
+            return vec4f(trilerp(v,fx,fy,fz));
+          }
+          
+          int64_t i000 = data->texelIndex(ix0,iy0,iz0);
+          int64_t i001 = data->texelIndex(ix1,iy0,iz0);
+          int64_t i010 = data->texelIndex(ix0,iy1,iz0);
+          int64_t i011 = data->texelIndex(ix1,iy1,iz0);
+          int64_t i100 = data->texelIndex(ix0,iy0,iz1);
+          int64_t i101 = data->texelIndex(ix1,iy0,iz1);
+          int64_t i110 = data->texelIndex(ix0,iy1,iz1);
+          int64_t i111 = data->texelIndex(ix1,iy1,iz1);
       
-          vec4f v000 = getTexel<T>(data,desc,i000);
-          vec4f v001 = getTexel<T>(data,desc,i001);
-          vec4f v010 = getTexel<T>(data,desc,i010);
-          vec4f v011 = getTexel<T>(data,desc,i011);
-          vec4f v100 = getTexel<T>(data,desc,i100);
-          vec4f v101 = getTexel<T>(data,desc,i101);
-          vec4f v110 = getTexel<T>(data,desc,i110);
-          vec4f v111 = getTexel<T>(data,desc,i111);
+          vec4f v000 = getTexel<T>(data->data.data(),desc,i000);
+          vec4f v001 = getTexel<T>(data->data.data(),desc,i001);
+          vec4f v010 = getTexel<T>(data->data.data(),desc,i010);
+          vec4f v011 = getTexel<T>(data->data.data(),desc,i011);
+          vec4f v100 = getTexel<T>(data->data.data(),desc,i100);
+          vec4f v101 = getTexel<T>(data->data.data(),desc,i101);
+          vec4f v110 = getTexel<T>(data->data.data(),desc,i110);
+          vec4f v111 = getTexel<T>(data->data.data(),desc,i111);
       
           vec4f v00 = lerp_l(fx,v000,v001);
           vec4f v01 = lerp_l(fx,v010,v011);
@@ -443,8 +651,13 @@ namespace rtc {
         return createSampler<vec4f>(data,desc);
         break;
       case rtc::FLOAT:
+        if (data->halfFloat)
+          return createSampler<float16_t>(data,desc);
         return createSampler<float>(data,desc);
         break;
+      case rtc::USHORT:
+        return createSampler<uint16_t>(data,desc);
+        break;
       default:
         throw std::runtime_error("sampler channel desc not implemented");
       } 
@@ -454,6 +667,8 @@ namespace rtc {
     Texture::Texture(TextureData *const data,
                      const rtc::TextureDesc &desc)
     {
+      if (desc.mipMaps)
+        data->buildMipMaps();
       sampler = createSampler(data,desc);
     }
 
@@ -23,6 +23,9 @@ namespace rtc {
       
       virtual vec4f tex1D(float x) = 0;
       virtual vec4f tex2D(vec2f tc) = 0;
+      /*! from given (fractional) mip level; samplers or data without
+          mips just use the finest level */
+      virtual vec4f tex2DLod(vec2f tc, float lod) { return tex2D(tc); }
       virtual vec4f tex3D(vec3f tc) = 0;
       
       TextureData     *const data;
@@ -36,15 +39,62 @@ namespace rtc {
                   rtc::DataType format,
                   const void *texels);
       Texture *createTexture(const rtc::TextureDesc &desc);
+
+      /*! fills mipLevels, unless that's been done before; only for
+          2D data (see TextureDesc::mipMaps) */
+      void buildMipMaps();
+
+      /*! index (in texels) of given texel within data */
+      inline size_t texelIndex(int ix, int iy, int iz) const;
+      
+      /*! edge length of the bricks that 3D textures get stored in;
+          4^3 one-byte texels fill exactly one cache line */
+      enum { brickSize = 4 };
       
       size_t sizeOfScalar;
       size_t numScalarsPerTexel;
       const vec3i dims;
       const DataType format;
+      /*! if set, data stores brickSize^3 bricks - bricks as well as
+          texels within a brick in x-fastest order - rather than a
+          plain x-fastest array. A trilinear fetch then mostly stays
+          within one brick, rather than touching four rows that are up
+          to a whole slice apart. Only for single-channel 3D
+          textures */
+      bool  bricked = false;
+      vec3i numBricks { 0,0,0 };
+      /*! if set, (single-channel, 3D) FLOAT data is stored as fp16,
+          which halves the memory traffic of volume sampling at the
+          cost of precision; opt-in through
+          BARNEY_EMBREE_HALF_VOLUMES */
+      bool  halfFloat = false;
       std::vector<uint8_t> data;
+      /*! what data's size got reported to device->memory as */
+      int memoryCategory = 0;
+      /*! all mip levels but the finest (which is 'data'), from finer
+          to coarser; same texel format as data, never bricked */
+      struct MipLevel {
+        vec2i                dims;
+        std::vector<uint8_t> texels;
+      };
+      std::vector<MipLevel> mipLevels;
       Device *const device;
     };
 
+    inline size_t TextureData::texelIndex(int ix, int iy, int iz) const
+    {
+      if (!bricked)
+        return ix+size_t(dims.x)*(iy+size_t(dims.y)*iz);
+      size_t brickID
+        = (ix/brickSize)
+        + size_t(numBricks.x)*((iy/brickSize)
+                               + size_t(numBricks.y)*(iz/brickSize));
+      int inBrick
+        = (ix%brickSize)
+        + brickSize*((iy%brickSize)+brickSize*(iz%brickSize));
+      return brickID*(brickSize*brickSize*brickSize)+inBrick;
+    }
+
 
     struct Texture
     {
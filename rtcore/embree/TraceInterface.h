@@ -37,15 +37,35 @@ namespace rtc {
       vec3f transformNormalFromWorldToObjectSpace(vec3f v) const;
       vec3f transformPointFromWorldToObjectSpace(vec3f v) const;
       vec3f transformVectorFromWorldToObjectSpace(vec3f v) const;
+      /*! terminateOnFirstHit is only a hint here, so we always find
+          the closest hit; rays that only need to know whether they're
+          occluded should use traceOcclusion() */
       void  traceRay(rtc::AccelHandle world,
                      vec3f org,
                      vec3f dir,
                      float t0,
                      float t1,
-                     void *prdPtr);
+                     void *prdPtr,
+                     bool terminateOnFirstHit = false);
+      /*! occlusion query (rtcOccluded1): intersect and any-hit
+          programs run as usual, traversal stops at the first accepted
+          hit, and no closest-hit program runs at all. Returns whether
+          there was such a hit - which the caller then has to record
+          in the prd itself, since the hit programs that usually do
+          that may not have run */
+      bool  traceOcclusion(rtc::AccelHandle world,
+                           vec3f org,
+                           vec3f dir,
+                           float t0,
+                           float t1,
+                           void *prdPtr);
 
       /* this HAS to be the first entry! :*/
       RTCRayQueryContext embreeRayQueryContext;
+      /*! only set on the (otherwise unused) interface whose context
+          a packet query runs with: the interfaces of the packet's
+          lanes, which the per-lane programs then run with */
+      TraceInterface *const *packetLanes = nullptr;
       vec3i     launchIndex;
       vec3i     launchDimensions;
       bool      ignoreThisHit;
@@ -72,6 +92,102 @@ namespace rtc {
       InstanceGroup  *world;
     };
 
+    /*! copies lane i of a ray packet of size N into a single ray */
+    inline void loadLane(RTCRay &ray, RTCRayN *rays,
+                         unsigned N, unsigned i)
+    {
+      ray.org_x     = RTCRayN_org_x(rays,N,i);
+      ray.org_y     = RTCRayN_org_y(rays,N,i);
+      ray.org_z     = RTCRayN_org_z(rays,N,i);
+      ray.tnear     = RTCRayN_tnear(rays,N,i);
+      ray.dir_x     = RTCRayN_dir_x(rays,N,i);
+      ray.dir_y     = RTCRayN_dir_y(rays,N,i);
+      ray.dir_z     = RTCRayN_dir_z(rays,N,i);
+      ray.time      = RTCRayN_time(rays,N,i);
+      ray.tfar      = RTCRayN_tfar(rays,N,i);
+      ray.mask      = RTCRayN_mask(rays,N,i);
+      ray.id        = RTCRayN_id(rays,N,i);
+      ray.flags     = RTCRayN_flags(rays,N,i);
+    }
+
+    /*! copies lane i of a ray/hit packet of size N into a single ray
+        and hit */
+    inline void loadLane(RTCRay &ray, RTCHit &hit,
+                         RTCRayN *rays, RTCHitN *hits,
+                         unsigned N, unsigned i)
+    {
+      loadLane(ray,rays,N,i);
+      hit.Ng_x      = RTCHitN_Ng_x(hits,N,i);
+      hit.Ng_y      = RTCHitN_Ng_y(hits,N,i);
+      hit.Ng_z      = RTCHitN_Ng_z(hits,N,i);
+      hit.u         = RTCHitN_u(hits,N,i);
+      hit.v         = RTCHitN_v(hits,N,i);
+      hit.primID    = RTCHitN_primID(hits,N,i);
+      hit.geomID    = RTCHitN_geomID(hits,N,i);
+      hit.instID[0] = RTCHitN_instID(hits,N,i,0);
+    }
+
+    /*! writes a single ray's tfar and hit back into lane i of a
+        ray/hit packet of size N */
+    inline void storeLane(RTCRayN *rays, RTCHitN *hits,
+                          unsigned N, unsigned i,
+                          const RTCRay &ray, const RTCHit &hit)
+    {
+      RTCRayN_tfar(rays,N,i)     = ray.tfar;
+      RTCHitN_Ng_x(hits,N,i)     = hit.Ng_x;
+      RTCHitN_Ng_y(hits,N,i)     = hit.Ng_y;
+      RTCHitN_Ng_z(hits,N,i)     = hit.Ng_z;
+      RTCHitN_u(hits,N,i)        = hit.u;
+      RTCHitN_v(hits,N,i)        = hit.v;
+      RTCHitN_primID(hits,N,i)   = hit.primID;
+      RTCHitN_geomID(hits,N,i)   = hit.geomID;
+      RTCHitN_instID(hits,N,i,0) = hit.instID[0];
+    }
+    
+    /*! how many rays get traced together (rtcIntersect16) by batched
+        trace kernels */
+    enum { packetWidth = 16 };
+
+    /*! traces the requests of all active lanes (with non-empty
+        [tmin,tmax)) as a single packet, and runs the closest hit
+        programs for those that hit something; lanes[i] has to be set
+        up with the launch index and kernel data of the ray it
+        traces. Lanes with occlusionOnly requests get traced as an
+        occlusion packet of their own, and report back through
+        occluded[] (see traceOcclusion()) */
+    void tracePacket(TraceInterface *lanes,
+                     const TraceRequest *requests,
+                     void *const *prds,
+                     const bool *active,
+                     bool *occluded);
+    
+    template<typename Class>
+    void traceBatch(int ix0, int iy,
+                    vec2i launchDims,
+                    const void *lpData)
+    {
+      TraceInterface lanes[packetWidth];
+      typename Class::PRD prds[packetWidth];
+      void *prdPtrs[packetWidth];
+      TraceRequest requests[packetWidth];
+      bool active[packetWidth];
+      bool occluded[packetWidth];
+      for (int lane=0;lane<packetWidth;lane++) {
+        TraceInterface &ti = lanes[lane];
+        ti.launchIndex = vec3i(ix0+lane,iy,0);
+        ti.launchDimensions = {launchDims.x,launchDims.y,1};
+        ti.lpData = lpData;
+        prdPtrs[lane] = &prds[lane];
+        active[lane]
+          = ix0+lane < launchDims.x
+          && Class::beginTrace(ti,prds[lane],requests[lane]);
+      }
+      tracePacket(lanes,requests,prdPtrs,active,occluded);
+      for (int lane=0;lane<packetWidth;lane++)
+        if (active[lane])
+          Class::endTrace(lanes[lane],prds[lane],occluded[lane]);
+    }
+
 
 
     inline void TraceInterface::ignoreIntersection() 
@@ -14,6 +14,7 @@ namespace rtc {
     using cuda_common::ComputeInterface;
     using cuda_common::tex1D;
     using cuda_common::tex2D;
+    using cuda_common::tex2DLod;
     using cuda_common::tex3D;
     using cuda_common::fatomicMin;
     using cuda_common::fatomicMax;
@@ -78,11 +78,21 @@ namespace rtc {
     void Device::freeGeom(Geom *g)
     { delete g; }
 
-    Group *Device::createTrianglesGroup(const std::vector<Geom *> &geoms)
-    { return new TrianglesGeomGroup(this,geoms); }
+    Group *Device::createTrianglesGroup(const std::vector<Geom *> &geoms,
+                                        BuildQuality quality)
+    {
+      GeomGroup *gg = new TrianglesGeomGroup(this,geoms);
+      gg->buildQuality = quality;
+      return gg;
+    }
 
-    Group *Device::createUserGeomsGroup(const std::vector<Geom *> &geoms)
-    { return new UserGeomGroup(this,geoms); }
+    Group *Device::createUserGeomsGroup(const std::vector<Geom *> &geoms,
+                                        BuildQuality quality)
+    {
+      GeomGroup *gg = new UserGeomGroup(this,geoms);
+      gg->buildQuality = quality;
+      return gg;
+    }
 
     Group *Device::createInstanceGroup(const std::vector<Group *> &groups,
                                        const std::vector<int>      &instIDs,
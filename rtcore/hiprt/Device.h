@@ -34,6 +34,8 @@ namespace rtc {
 
     using rtc::cuda_common::Texture;
     using rtc::cuda_common::TextureData;
+    using rtc::cuda_common::Graph;
+    using rtc::cuda_common::Event;
 
     using cuda_common::float2;
     using cuda_common::float3;
@@ -51,6 +53,10 @@ namespace rtc {
       std::string toString() const
       { return "rtc::hiprt::Device(physical="+std::to_string(physicalID)+")"; }
 
+      /*! whether work issued to this device can be captured into a
+          graph (see cuda_common::Device::beginCapture()) */
+      bool canCaptureGraphs() const { return true; }
+
       /*! the HIPRT context, created over this Device's HIP device + stream;
           shared by every Group's BVH build and the trace kernels so they see
           the same device pointers (binding to this Device's HIP context avoids
@@ -60,14 +66,18 @@ namespace rtc {
       void freeGeomType(GeomType *);
       void freeGeom(Geom *);
 
-      Group *createTrianglesGroup(const std::vector<Geom *> &geoms);
-      Group *createUserGeomsGroup(const std::vector<Geom *> &geoms);
+      Group *createTrianglesGroup(const std::vector<Geom *> &geoms,
+                                  BuildQuality quality = BUILD_QUALITY_DEFAULT);
+      Group *createUserGeomsGroup(const std::vector<Geom *> &geoms,
+                                  BuildQuality quality = BUILD_QUALITY_DEFAULT);
       Group *createInstanceGroup(const std::vector<Group *> &groups,
                                  const std::vector<int>      &instIDs,
                                  const std::vector<affine3f> &xfms);
       void freeGroup(Group *);
       void buildPipeline();
       void buildSBT();
+      /*! geom records get written when their groups get built */
+      void updateSBT() {}
       Buffer *createBuffer(size_t numBytes, const void *initValues = 0);
       void freeBuffer(Buffer *);
       Denoiser *createDenoiser();
@@ -82,6 +92,7 @@ namespace rtc {
       ~Denoiser() = default;
       void resize(vec2i dims) { outputDims = dims; }
       void run(float blendFactor) {}
+      void finish() {}
       Device* const device;
 
       vec4f *in_rgba = 0;
@@ -114,11 +114,26 @@ namespace rtc {
       return gg->numPrims;
     }
 
-    static void buildHiprtGeometry(GeomGroup *gg, hiprtGeometryBuildInput &bi)
+    // same policy as the optix backend: only fast-build groups - which is
+    // what geometry that changes every frame should ask for - get refit in
+    // place (hiprtBuildOperationUpdate). All others are considered static,
+    // get HIPRT's high quality (SAH/spatial split) builder, and refits are
+    // rebuilds.
+    static bool allowsUpdate(BuildQuality quality)
+    {
+      return quality == BUILD_QUALITY_FAST_BUILD;
+    }
+
+    static void buildHiprtGeometry(GeomGroup *gg, hiprtGeometryBuildInput &bi,
+                                   bool update)
     {
       Device *device = gg->device;
       hiprtBuildOptions bo{};
-      bo.buildFlags = hiprtBuildFlagBitPreferFastBuild;
+      bo.buildFlags
+        = allowsUpdate(gg->buildQuality)
+        ? hiprtBuildFlagBitPreferFastBuild
+        : hiprtBuildFlagBitPreferHighQualityBuild;
+      update = update && gg->geom && gg->builtPrims == gg->numPrims;
 
       size_t tempSize = 0;
       HC(hiprtGetGeometryBuildTemporaryBufferSize(device->hiprtCtx,bi,bo,tempSize));
@@ -128,10 +143,16 @@ namespace rtc {
         if (tempSize) BARNEY_CUDA_CALL(Malloc(&gg->d_buildTmp,tempSize));
         gg->buildTmpSize = tempSize;
       }
-      if (gg->geom) { hiprtDestroyGeometry(device->hiprtCtx,gg->geom); gg->geom=nullptr; }
-      HC(hiprtCreateGeometry(device->hiprtCtx,bi,bo,gg->geom));
-      HC(hiprtBuildGeometry(device->hiprtCtx,hiprtBuildOperationBuild,bi,bo,
-                            gg->d_buildTmp,device->stream,gg->geom));
+      if (!update) {
+        if (gg->geom) { hiprtDestroyGeometry(device->hiprtCtx,gg->geom); gg->geom=nullptr; }
+        HC(hiprtCreateGeometry(device->hiprtCtx,bi,bo,gg->geom));
+      }
+      HC(hiprtBuildGeometry(device->hiprtCtx,
+                            update
+                            ? hiprtBuildOperationUpdate
+                            : hiprtBuildOperationBuild,
+                            bi,bo,gg->d_buildTmp,device->stream,gg->geom));
+      gg->builtPrims = gg->numPrims;
       device->sync();
     }
 
@@ -141,9 +162,10 @@ namespace rtc {
       : GeomGroup(device,geoms)
     {}
 
-    void TrianglesGeomGroup::buildAccel()
+    void TrianglesGeomGroup::build(bool refit)
     {
       SetActiveGPU forDuration(device);
+      const bool update = refit && allowsUpdate(buildQuality);
       GeomGroup_buildSBTandPrims(this,/*isTriangles*/true);
 
       // concatenate all geoms' triangles into one vertex+index buffer; HIPRT
@@ -163,12 +185,18 @@ namespace rtc {
         for (auto t : idx) hostIdx.push_back(vec3i{t.x+base,t.y+base,t.z+base});
       }
 
-      if (d_vertices) { BARNEY_CUDA_CALL(Free(d_vertices)); d_vertices=nullptr; }
-      if (d_indices)  { BARNEY_CUDA_CALL(Free(d_indices));  d_indices=nullptr; }
-      BARNEY_CUDA_CALL(Malloc(&d_vertices,hostVerts.size()*sizeof(vec3f)));
+      // a BLAS that gets updated in place keeps referencing the buffers it
+      // got built over, so only re-allocate those if their sizes changed
+      if (!update || hostVerts.size() != builtVertices
+          || hostIdx.size() != (size_t)builtPrims) {
+        if (d_vertices) { BARNEY_CUDA_CALL(Free(d_vertices)); d_vertices=nullptr; }
+        if (d_indices)  { BARNEY_CUDA_CALL(Free(d_indices));  d_indices=nullptr; }
+        BARNEY_CUDA_CALL(Malloc(&d_vertices,hostVerts.size()*sizeof(vec3f)));
+        BARNEY_CUDA_CALL(Malloc(&d_indices,hostIdx.size()*sizeof(vec3i)));
+        builtVertices = hostVerts.size();
+      }
       BARNEY_CUDA_CALL(Memcpy(d_vertices,hostVerts.data(),
                               hostVerts.size()*sizeof(vec3f),cudaMemcpyDefault));
-      BARNEY_CUDA_CALL(Malloc(&d_indices,hostIdx.size()*sizeof(vec3i)));
       BARNEY_CUDA_CALL(Memcpy(d_indices,hostIdx.data(),
                               hostIdx.size()*sizeof(vec3i),cudaMemcpyDefault));
 
@@ -184,7 +212,7 @@ namespace rtc {
       bi.type = hiprtPrimitiveTypeTriangleMesh;
       bi.primitive.triangleMesh = mesh;
       bi.geomType = 0;
-      buildHiprtGeometry(this,bi);
+      buildHiprtGeometry(this,bi,update);
     }
 
     GeomGroup::DeviceRecord TrianglesGeomGroup::getRecord()
@@ -202,16 +230,22 @@ namespace rtc {
       : GeomGroup(device,geoms)
     {}
 
-    void UserGeomGroup::buildAccel()
+    void UserGeomGroup::build(bool refit)
     {
       SetActiveGPU forDuration(device);
+      const int prevPrims = numPrims;
       GeomGroup_buildSBTandPrims(this,/*isTriangles*/false);
+      const bool update
+        = refit && allowsUpdate(buildQuality) && d_aabbs && numPrims == prevPrims;
 
       // per-prim AABBs via each geom type's bounds kernel, concatenated in geom
       // order; HIPRT builds an AABB-list BLAS over them and calls the func-table
       // intersect thunk (see TraceKernel.cpp) per candidate prim.
-      box3f *d_bounds = nullptr;
-      if (numPrims) BARNEY_CUDA_CALL(Malloc((void**)&d_bounds,numPrims*sizeof(box3f)));
+      // (updates write the new bounds over the old ones, which the BLAS
+      // keeps referencing)
+      box3f *d_bounds = update ? (box3f *)d_aabbs : nullptr;
+      if (numPrims && !update)
+        BARNEY_CUDA_CALL(Malloc((void**)&d_bounds,numPrims*sizeof(box3f)));
       size_t ofs = 0;
       for (size_t i=0;i<geoms.size();i++) {
         UserGeom *geom = (UserGeom*)geoms[i];
@@ -228,8 +262,10 @@ namespace rtc {
       // HIPRT's AABB list wants packed (lower.xyz, upper.xyz) float pairs; owl's
       // box3f is exactly {vec3f lower; vec3f upper;} so the layout already
       // matches a hiprtFloat4-pair-free tight 6-float AABB.
-      if (d_aabbs) { BARNEY_CUDA_CALL(Free(d_aabbs)); d_aabbs=nullptr; }
-      d_aabbs = d_bounds; // box3f == 6 contiguous floats per prim
+      if (!update) {
+        if (d_aabbs) { BARNEY_CUDA_CALL(Free(d_aabbs)); d_aabbs=nullptr; }
+        d_aabbs = d_bounds; // box3f == 6 contiguous floats per prim
+      }
 
       hiprtAABBListPrimitive list{};
       list.aabbCount  = (uint32_t)numPrims;
@@ -240,7 +276,7 @@ namespace rtc {
       bi.type = hiprtPrimitiveTypeAABBList;
       bi.primitive.aabbList = list;
       bi.geomType = 0;
-      buildHiprtGeometry(this,bi);
+      buildHiprtGeometry(this,bi,update);
     }
 
     GeomGroup::DeviceRecord UserGeomGroup::getRecord()
@@ -275,10 +311,22 @@ namespace rtc {
     void InstanceGroup::setTransforms(const std::vector<affine3f> &newXfms)
     { xfms = newXfms; }
 
-    void InstanceGroup::buildAccel()
+    void InstanceGroup::updateTransforms(const std::vector<int> &which,
+                                         const std::vector<affine3f> &newXfms)
+    {
+      for (size_t i=0;i<which.size();i++)
+        xfms[which[i]] = newXfms[i];
+      build(/*update*/true);
+    }
+
+    void InstanceGroup::build(bool update)
     {
       SetActiveGPU forDuration(device);
       int numInstances = (int)groups.size();
+      // instances (and thus the groups' BLASes) never change, only their
+      // transforms do; so a refit can update the scene in place, over the
+      // same buffers, as long as there is one
+      update = update && scene && builtInstances == numInstances;
 
       // per-instance shading records (transforms + the group's SBT/prim record).
       std::vector<InstanceRecord> hostRecs(numInstances);
@@ -305,18 +353,20 @@ namespace rtc {
         hostFrames[i].matrix[2][2]=m.l.vz.z; hostFrames[i].matrix[2][3]=m.p.z;
       }
 
-      if (d_instanceRecords) { BARNEY_CUDA_CALL(Free(d_instanceRecords)); d_instanceRecords=nullptr; }
-      if (numInstances) {
-        BARNEY_CUDA_CALL(Malloc((void**)&d_instanceRecords,numInstances*sizeof(InstanceRecord)));
+      if (!update) {
+        if (d_instanceRecords) { BARNEY_CUDA_CALL(Free(d_instanceRecords)); d_instanceRecords=nullptr; }
+        if (numInstances)
+          BARNEY_CUDA_CALL(Malloc((void**)&d_instanceRecords,numInstances*sizeof(InstanceRecord)));
+        if (d_instances) { BARNEY_CUDA_CALL(Free(d_instances)); d_instances=nullptr; }
+        if (d_frames)    { BARNEY_CUDA_CALL(Free(d_frames));    d_frames=nullptr; }
+        BARNEY_CUDA_CALL(Malloc(&d_instances,numInstances*sizeof(hiprtInstance)));
+        BARNEY_CUDA_CALL(Malloc(&d_frames,numInstances*sizeof(hiprtFrameMatrix)));
+      }
+      if (numInstances)
         BARNEY_CUDA_CALL(Memcpy(d_instanceRecords,hostRecs.data(),
                                 numInstances*sizeof(InstanceRecord),cudaMemcpyDefault));
-      }
-      if (d_instances) { BARNEY_CUDA_CALL(Free(d_instances)); d_instances=nullptr; }
-      if (d_frames)    { BARNEY_CUDA_CALL(Free(d_frames));    d_frames=nullptr; }
-      BARNEY_CUDA_CALL(Malloc(&d_instances,numInstances*sizeof(hiprtInstance)));
       BARNEY_CUDA_CALL(Memcpy(d_instances,hostInst.data(),
                               numInstances*sizeof(hiprtInstance),cudaMemcpyDefault));
-      BARNEY_CUDA_CALL(Malloc(&d_frames,numInstances*sizeof(hiprtFrameMatrix)));
       BARNEY_CUDA_CALL(Memcpy(d_frames,hostFrames.data(),
                               numInstances*sizeof(hiprtFrameMatrix),cudaMemcpyDefault));
 
@@ -327,6 +377,8 @@ namespace rtc {
       si.instanceFrames            = d_frames;
       si.frameType                 = hiprtFrameTypeMatrix;
 
+      // scenes get refit whenever instance transforms change, so (like the
+      // optix backend's instance groups) they're built for updates
       hiprtBuildOptions bo{};
       bo.buildFlags = hiprtBuildFlagBitPreferFastBuild;
       size_t tempSize = 0;
@@ -337,10 +389,16 @@ namespace rtc {
         if (tempSize) BARNEY_CUDA_CALL(Malloc(&d_sceneTmp,tempSize));
         sceneTmpSize = tempSize;
       }
-      if (scene) { hiprtDestroyScene(device->hiprtCtx,scene); scene=nullptr; }
-      HC(hiprtCreateScene(device->hiprtCtx,si,bo,scene));
-      HC(hiprtBuildScene(device->hiprtCtx,hiprtBuildOperationBuild,si,bo,
-                         d_sceneTmp,device->stream,scene));
+      if (!update) {
+        if (scene) { hiprtDestroyScene(device->hiprtCtx,scene); scene=nullptr; }
+        HC(hiprtCreateScene(device->hiprtCtx,si,bo,scene));
+      }
+      HC(hiprtBuildScene(device->hiprtCtx,
+                         update
+                         ? hiprtBuildOperationUpdate
+                         : hiprtBuildOperationBuild,
+                         si,bo,d_sceneTmp,device->stream,scene));
+      builtInstances = numInstances;
       device->sync();
 
       DeviceRecord dd;
@@ -21,6 +21,10 @@ namespace rtc {
       virtual void buildAccel() = 0;
       virtual void refitAccel() { buildAccel(); }
       virtual void setTransforms(const std::vector<affine3f> &) {}
+      /*! sets the transforms of only the listed instances, and updates
+          the accel for them */
+      virtual void updateTransforms(const std::vector<int> &which,
+                                    const std::vector<affine3f> &newXfms) {}
       AccelHandle getDD() const { return (AccelHandle)d_accel; }
 
       Device *const device;
@@ -58,9 +62,13 @@ namespace rtc {
       size_t   sbtEntrySize = 0;
       int      numPrims     = 0;
       Prim    *prims        = 0;
+      BuildQuality buildQuality = BUILD_QUALITY_DEFAULT;
 
       // HIPRT BLAS for this group, plus the reused build-temp scratch.
       hiprtGeometry geom      = nullptr;
+      // prim count geom got built over; refits can only update the BLAS
+      // in place if that didn't change
+      int           builtPrims = 0;
       void         *d_buildTmp = nullptr;
       size_t        buildTmpSize = 0;
       // device-side geometry inputs HIPRT references during traversal
@@ -93,8 +101,16 @@ namespace rtc {
                     const std::vector<int>      &instanceIDs,
                     const std::vector<affine3f> &xfms);
       ~InstanceGroup();
-      void buildAccel() override;
+      void buildAccel() override { build(/*update*/false); }
+      /*! with the same instances, updates the scene in place
+          (hiprtBuildOperationUpdate) for the latest setTransforms() */
+      void refitAccel() override { build(/*update*/true); }
       void setTransforms(const std::vector<affine3f> &newXfms) override;
+      /*! patches the listed transforms, then does the same in-place
+          scene update as refitAccel() */
+      void updateTransforms(const std::vector<int> &which,
+                            const std::vector<affine3f> &newXfms) override;
+      void build(bool update);
 
       DeviceRecord   *d_deviceRecord    = 0;
       InstanceRecord *d_instanceRecords = 0;
@@ -102,6 +118,7 @@ namespace rtc {
       hiprtScene scene        = nullptr;
       void      *d_sceneTmp   = nullptr;
       size_t     sceneTmpSize = 0;
+      int        builtInstances = 0;
       void      *d_instances  = nullptr;
       void      *d_frames     = nullptr;
 
@@ -112,13 +129,19 @@ namespace rtc {
 
     struct TrianglesGeomGroup : public GeomGroup {
       TrianglesGeomGroup(Device *device, const std::vector<Geom *> &geoms);
-      void buildAccel() override;
+      void buildAccel() override { build(/*refit*/false); }
+      void refitAccel() override { build(/*refit*/true); }
+      void build(bool refit);
       DeviceRecord getRecord() override;
+      // vertex count d_vertices got allocated for
+      size_t builtVertices = 0;
     };
 
     struct UserGeomGroup : public GeomGroup {
       UserGeomGroup(Device *device, const std::vector<Geom *> &geoms);
-      void buildAccel() override;
+      void buildAccel() override { build(/*refit*/false); }
+      void refitAccel() override { build(/*refit*/true); }
+      void build(bool refit);
       DeviceRecord getRecord() override;
     };
 
@@ -94,7 +94,21 @@ namespace rtc {
       inline __device__ vec3f transformPointFromWorldToObjectSpace(vec3f v) const;
       inline __device__ vec3f transformVectorFromWorldToObjectSpace(vec3f v) const;
 
+      /*! terminateOnFirstHit is only a hint here; we always fold
+          all hits and end up with the closest one */
       inline __device__ void traceRay(rtc::AccelHandle world,
+                                      vec3f org, vec3f dir,
+                                      float t0, float t1, void *prdPtr,
+                                      bool terminateOnFirstHit = false);
+      /*! occlusion query: folds hits (running intersect and any-hit
+          programs) like traceRay(), but skips the closest-hit
+          program; returns whether anything got accepted */
+      inline __device__ bool traceOcclusion(rtc::AccelHandle world,
+                                            vec3f org, vec3f dir,
+                                            float t0, float t1,
+                                            void *prdPtr);
+      /*! the traversal part of traceRay() */
+      inline __device__ void traverse(rtc::AccelHandle world,
                                       vec3f org, vec3f dir,
                                       float t0, float t1, void *prdPtr);
 
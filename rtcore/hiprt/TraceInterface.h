@@ -163,6 +163,46 @@ namespace rtc {
 
     inline __device__
     void TraceInterface::traceRay(rtc::AccelHandle _world,
+                                  vec3f org,
+                                  vec3f dir,
+                                  float t0,
+                                  float t1,
+                                  void *prdPtr,
+                                  bool terminateOnFirstHit)
+    {
+#if RTC_DEVICE_CODE
+      traverse(_world,org,dir,t0,t1,prdPtr);
+      if (acceptedSBT && acceptedSBT->ch) {
+        InstanceGroup::DeviceRecord *model
+          = (InstanceGroup::DeviceRecord *)_world;
+        current = accepted;
+        this->geomData = (acceptedSBT+1);
+        currentInstance = model->instanceRecords + accepted.instID;
+        object.org = xfmPoint (currentInstance->worldToObjectXfm, world.org);
+        object.dir = xfmVector(currentInstance->worldToObjectXfm, world.dir);
+        acceptedSBT->ch(*this);
+      }
+#endif
+    }
+
+    inline __device__
+    bool TraceInterface::traceOcclusion(rtc::AccelHandle _world,
+                                        vec3f org,
+                                        vec3f dir,
+                                        float t0,
+                                        float t1,
+                                        void *prdPtr)
+    {
+#if RTC_DEVICE_CODE
+      traverse(_world,org,dir,t0,t1,prdPtr);
+      return acceptedSBT != 0;
+#else
+      return false;
+#endif
+    }
+
+    inline __device__
+    void TraceInterface::traverse(rtc::AccelHandle _world,
                                   vec3f org,
                                   vec3f dir,
                                   float t0,
@@ -213,15 +253,6 @@ namespace rtc {
       // hit is the final one (or invalid). All shading state lives in this
       // TraceInterface (the payload), not in a kernel-stack array.
       (void)hit;
-
-      if (acceptedSBT && acceptedSBT->ch) {
-        current = accepted;
-        this->geomData = (acceptedSBT+1);
-        currentInstance = model->instanceRecords + accepted.instID;
-        object.org = xfmPoint (currentInstance->worldToObjectXfm, world.org);
-        object.dir = xfmVector(currentInstance->worldToObjectXfm, world.dir);
-        acceptedSBT->ch(*this);
-      }
 #endif
     }
 
@@ -284,3 +315,7 @@ namespace rtc {
          dim3{(unsigned)bs.x,(unsigned)bs.y,1u},                       \
          0,device->stream>>>(ti);                                       \
   }
+
+/*! only the embree backend traces batched kernels in packets */
+#define RTC_EXPORT_BATCHED_TRACE2D(name,Class)                          \
+  RTC_EXPORT_TRACE2D(name,Class)
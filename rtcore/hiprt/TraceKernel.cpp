@@ -103,6 +103,10 @@ namespace rtc {
     void TraceKernel2D::launch(vec2i launchDims, const void *kernelData)
     {
       SetActiveGPU forDuration(device);
+      if (device->capturing)
+        /* the captured copy reads from kernelData when the graph
+           gets launched, which will be long after we returned */
+        kernelData = device->keepForCapture(kernelData,sizeOfLP);
       BARNEY_CUDA_CALL(MemcpyAsync(d_lpData,kernelData,sizeOfLP,
                                    cudaMemcpyDefault,device->stream));
       traceLaunchFct(device,launchDims,d_lpData);
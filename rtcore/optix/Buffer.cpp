@@ -14,10 +14,14 @@ namespace rtc {
       : device(device)
     {
       owl = owlDeviceBufferCreate(device->owl,OWL_BYTE,size,initData);
+      numBytes = size;
+      memoryCategory = device->memory.current;
+      device->memory.allocated(memoryCategory,numBytes);
     }
 
     Buffer::~Buffer()
     {
+      device->memory.freed(memoryCategory,numBytes);
       owlBufferRelease(owl);
     }
     
@@ -27,6 +31,9 @@ namespace rtc {
     void Buffer::resize(size_t newNumBytes)
     {
       owlBufferResize(owl,newNumBytes);
+      device->memory.freed(memoryCategory,numBytes);
+      numBytes = newNumBytes;
+      device->memory.allocated(memoryCategory,numBytes);
     }
     
   }
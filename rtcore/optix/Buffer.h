@@ -29,6 +29,9 @@ namespace rtc {
 
       optix::Device *const device;      
       OWLBuffer owl;
+      /*! what got reported to device->memory, for which category */
+      size_t numBytes       = 0;
+      int    memoryCategory = 0;
     };
 
     inline void Buffer::uploadAsync(const void *hostPtr,
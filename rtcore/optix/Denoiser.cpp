@@ -24,6 +24,13 @@ namespace rtc {
       denoiserOptions.denoiseAlpha
         = OPTIX_DENOISER_ALPHA_MODE_COPY;
 
+      BARNEY_CUDA_CALL(StreamCreateWithFlags(&denoiserStream,
+                                             cudaStreamNonBlocking));
+      BARNEY_CUDA_CALL(EventCreateWithFlags(&inputsReady,
+                                            cudaEventDisableTiming));
+      BARNEY_CUDA_CALL(EventCreateWithFlags(&outputReady,
+                                            cudaEventDisableTiming));
+
       currentUpscaleMode = upscaleMode;
       OptixDenoiserModelKind modelKind
         = upscaleMode
@@ -80,6 +87,19 @@ namespace rtc {
     Optix8Denoiser::~Optix8Denoiser()
     {
       SetActiveGPU forDuration(device);
+      if (denoiserStream) {
+        BARNEY_CUDA_CALL_NOTHROW(StreamSynchronize(denoiserStream));
+        BARNEY_CUDA_CALL_NOTHROW(StreamDestroy(denoiserStream));
+        denoiserStream = 0;
+      }
+      if (inputsReady) {
+        BARNEY_CUDA_CALL_NOTHROW(EventDestroy(inputsReady));
+        inputsReady = 0;
+      }
+      if (outputReady) {
+        BARNEY_CUDA_CALL_NOTHROW(EventDestroy(outputReady));
+        outputReady = 0;
+      }
       if (denoiser) {
         optixDenoiserDestroy(denoiser);
         denoiser = {};
@@ -112,6 +132,9 @@ namespace rtc {
     
     void Optix8Denoiser::resize(vec2i numPixels)
     {
+      // a run still in flight may be using what we're about to free
+      BARNEY_CUDA_CALL(StreamSynchronize(denoiserStream));
+
       // If upscale mode changed, destroy and recreate the denoiser
       recreateIfNeeded();
 
@@ -179,7 +202,7 @@ namespace rtc {
       // it would treat input as that size and produce 4x, and we'd only read
       // the top-left quarter.
       res = optixDenoiserSetup(denoiser,
-                         0,
+                         denoiserStream,
                          numPixels.x,
                          numPixels.y,
                          (CUdeviceptr)denoiserState,
@@ -233,7 +256,9 @@ namespace rtc {
       /// the unmodified input. Values between 0 and 1 will linearly interpolate between the denoised
       /// and unmodified input.
       denoiserParams.blendFactor      = blendFactor;
-      cudaStream_t denoiserStream = 0;
+      // inputs got written on the device's stream
+      BARNEY_CUDA_CALL(EventRecord(inputsReady,device->stream));
+      BARNEY_CUDA_CALL(StreamWaitEvent(denoiserStream,inputsReady,0));
       OptixResult res = optixDenoiserInvoke
         (
          denoiser,
@@ -255,7 +280,14 @@ namespace rtc {
         available = false;
         return;
       }
-      cudaStreamSynchronize(denoiserStream);
+      BARNEY_CUDA_CALL(EventRecord(outputReady,denoiserStream));
+    }
+
+    void Optix8Denoiser::finish()
+    {
+      if (!available) return;
+      SetActiveGPU forDuration(device);
+      BARNEY_CUDA_CALL(StreamWaitEvent(device->stream,outputReady,0));
     }
     
 #endif
@@ -15,7 +15,14 @@ namespace rtc {
       Denoiser(Device* device) : device(device) {}
       virtual ~Denoiser() = default;
       virtual void resize(vec2i dims) = 0;
+      /*! starts denoising in_rgba (and in_normal) into out_rgba. This
+          only gets enqueued - after all work already issued to the
+          device's stream - and does not block the host; the result
+          is only valid once finish() got called */
       virtual void run(float blendFactor) = 0;
+      /*! makes the device's stream wait for the most recent run() to
+          complete (again without blocking the host) */
+      virtual void finish() {}
       vec4f *out_rgba  = 0;
       vec4f *in_rgba   = 0;
       vec3f *in_normal = 0;
@@ -40,6 +47,7 @@ namespace rtc {
       virtual ~Optix8Denoiser();
       void resize(vec2i dims) override;
       void run(float blendFactor) override;
+      void finish() override;
       
       vec2i                numPixels;
       OptixDenoiser        denoiser = {};
@@ -48,6 +56,14 @@ namespace rtc {
       void                *denoiserState   = 0;
       OptixDenoiserSizes   denoiserSizes;
 
+      /*! denoising runs on a stream of its own, so rendering the
+          next frame on this same device can overlap with it */
+      cudaStream_t         denoiserStream = 0;
+      /*! marks the denoiser's inputs as being written (on the
+          device's stream), and its output being done, respectively */
+      cudaEvent_t          inputsReady = 0;
+      cudaEvent_t          outputReady = 0;
+
       /*! tracks the mode the OptixDenoiser was created with, so we
           know when to destroy + recreate */
       bool currentUpscaleMode = false;
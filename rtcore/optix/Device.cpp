@@ -69,12 +69,38 @@ namespace rtc {
     void Device::buildPipeline() 
     {
       if (!programsDirty) return;
+      owlBuildPrograms(owl);
       owlBuildPipeline(owl);
+      programsDirty = false;
+    }
+
+    void Device::setPipelineCacheDir(const std::string &dir)
+    {
+      OptixDeviceContext optixContext = owlContextGetOptixContext(owl,0);
+      OptixResult rc
+        = optixDeviceContextSetCacheLocation(optixContext,dir.c_str());
+      if (rc == OPTIX_SUCCESS)
+        rc = optixDeviceContextSetCacheEnabled(optixContext,1);
+      if (rc != OPTIX_SUCCESS)
+        std::cerr << "#rtc.optix: could not use '" << dir
+                  << "' as pipeline cache (optix error " << (int)rc
+                  << "); using optix' default cache" << std::endl;
     }
       
     void Device::buildSBT() 
     {
       owlBuildSBT(owl);
+      sbtRecordsDirty = false;
+    }
+
+    void Device::updateSBT() 
+    {
+      if (!sbtRecordsDirty)
+        return;
+      /* owl can't rewrite single records, but raygen and miss
+         records never depend on geoms' data */
+      owlBuildSBT(owl,OWL_SBT_HITGROUPS);
+      sbtRecordsDirty = false;
     }
       
     // ==================================================================
@@ -126,7 +152,6 @@ namespace rtc {
       rg = owlRayGenCreate(device->owl,mod,
                            kernelName.c_str(),
                            0,rg_args,-1);
-      owlBuildPrograms(device->owl);
       
       OWLVarDecl lp_args[]
         = {
@@ -136,17 +161,36 @@ namespace rtc {
       lp = owlParamsCreate(device->owl,sizeOfLP,lp_args,-1);
       lpStream = owlParamsGetCudaStream(lp,0);
       device->programsDirty = true;
+
+      SetActiveGPU forDuration(device);
+      BARNEY_CUDA_CALL(EventCreateWithFlags(&launchReady,
+                                            cudaEventDisableTiming));
+      BARNEY_CUDA_CALL(EventCreateWithFlags(&launchDone,
+                                            cudaEventDisableTiming));
+    }
+
+    TraceKernel2D::~TraceKernel2D()
+    {
+      SetActiveGPU forDuration(device);
+      BARNEY_CUDA_CALL_NOTHROW(StreamSynchronize(lpStream));
+      BARNEY_CUDA_CALL_NOTHROW(EventDestroy(launchReady));
+      BARNEY_CUDA_CALL_NOTHROW(EventDestroy(launchDone));
     }
     
     void TraceKernel2D::launch(vec2i dims,
                                const void *kernelData)
     {
       SetActiveGPU forDuration(device);
-      BARNEY_CUDA_CALL(StreamSynchronize(/*inherited!*/device->stream));
-
+      /* owl copies the params into host memory of its own, and
+         uploads them on lpStream; so all we have to order is the
+         launch itself */
       owlParamsSetRaw(lp,"raw",kernelData,0);
       if (dims.x > 0 && dims.y > 0) {
+        BARNEY_CUDA_CALL(EventRecord(launchReady,/*inherited!*/device->stream));
+        BARNEY_CUDA_CALL(StreamWaitEvent(lpStream,launchReady,0));
         owlAsyncLaunch2D(rg,dims.x,dims.y,lp);
+        BARNEY_CUDA_CALL(EventRecord(launchDone,lpStream));
+        BARNEY_CUDA_CALL(StreamWaitEvent(device->stream,launchDone,0));
         device->activeTraceStreams.push_back(lpStream);
       }
     }
@@ -159,28 +203,58 @@ namespace rtc {
       delete group;
     }
 
+    /*! whether geometry accels can get built for refitting
+        (OPTIX_BUILD_OPERATION_UPDATE); only fast-build ones - which
+        is what geometry that changes every frame should ask for. All
+        others are considered static, and refits are rebuilds */
+    static bool allowsUpdate(BuildQuality quality)
+    {
+      return quality == BUILD_QUALITY_FAST_BUILD;
+    }
+    
+    /*! optix build flags for given build quality. Static accels get
+        compacted (owl runs the compacted-size query, compact, and
+        free-the-original steps for groups with ALLOW_COMPACTION),
+        unless BARNEY_NO_ACCEL_COMPACTION is set; accels that allow
+        updates never do, since compaction and frequent refits don't
+        go together */
+    static unsigned int buildFlagsFor(BuildQuality quality)
+    {
+      if (allowsUpdate(quality))
+        return OPTIX_BUILD_FLAG_PREFER_FAST_BUILD
+          |    OPTIX_BUILD_FLAG_ALLOW_UPDATE;
+      static const bool noCompaction
+        = getenv("BARNEY_NO_ACCEL_COMPACTION") != nullptr;
+      return OPTIX_BUILD_FLAG_PREFER_FAST_TRACE
+        | (noCompaction ? 0 : OPTIX_BUILD_FLAG_ALLOW_COMPACTION);
+    }
+    
     Group *
-    Device::createTrianglesGroup(const std::vector<Geom *> &geoms)
+    Device::createTrianglesGroup(const std::vector<Geom *> &geoms,
+                                 BuildQuality quality)
     {
       std::vector<OWLGeom> owlGeoms;
       for (auto geom : geoms)
         owlGeoms.push_back(((Geom *)geom)->owl);
       OWLGroup g = owlTrianglesGeomGroupCreate(owl,
                                                owlGeoms.size(),
-                                               owlGeoms.data());
-      return new Group(this,g);
+                                               owlGeoms.data(),
+                                               buildFlagsFor(quality));
+      return new Group(this,g,allowsUpdate(quality));
     }
 
     Group *
-    Device::createUserGeomsGroup(const std::vector<Geom *> &geoms)
+    Device::createUserGeomsGroup(const std::vector<Geom *> &geoms,
+                                 BuildQuality quality)
     {
       std::vector<OWLGeom> owlGeoms;
       for (auto geom : geoms)
         owlGeoms.push_back(((Geom *)geom)->owl);
       OWLGroup g = owlUserGeomGroupCreate(owl,
                                           owlGeoms.size(),
-                                          owlGeoms.data());
-      return new Group(this,g);
+                                          owlGeoms.data(),
+                                          buildFlagsFor(quality));
+      return new Group(this,g,allowsUpdate(quality));
     }
 
     Group *
@@ -201,7 +275,7 @@ namespace rtc {
                                  OWL_MATRIX_FORMAT_OWL,
                                  owl::InstanceGroup::defaultBuildFlags
                                  | OPTIX_BUILD_FLAG_ALLOW_UPDATE);
-      Group *gg = new Group(this,g);
+      Group *gg = new Group(this,g,true);
       return gg;
     }
 
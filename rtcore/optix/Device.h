@@ -21,6 +21,8 @@ namespace rtc {
 
     using rtc::cuda_common::Texture;
     using rtc::cuda_common::TextureData;
+    using rtc::cuda_common::Graph;
+    using rtc::cuda_common::Event;
     
     using cuda_common::float2;
     using cuda_common::float3;
@@ -39,6 +41,12 @@ namespace rtc {
                     const std::string &ptxCode,
                     const std::string &kernelName,
                     size_t sizeOfLP);
+      ~TraceKernel2D();
+      /*! the launch runs on the launch params' stream, but is
+          stream-ordered with the device's: it starts after all work
+          issued to that so far, and all work issued to it afterwards
+          waits for the launch. Doesn't block the host, so launches of
+          several (logical) devices on the same gpu can overlap */
       void launch(vec2i launchDims,
                   const void *kernelData);
       Device *const device;
@@ -46,6 +54,8 @@ namespace rtc {
       OWLRayGen rg;
       OWLParams lp;
       cudaStream_t lpStream;
+      cudaEvent_t  launchReady = 0;
+      cudaEvent_t  launchDone  = 0;
     };
     
     struct Device : public cuda_common::Device {
@@ -64,6 +74,11 @@ namespace rtc {
       /*! returns a string that describes what kind of compute device
           this is (eg, "optix" vs "embree" */
       std::string traceType() const { return "optix"; }
+
+      /*! owl launches trace kernels on its own stream (and syncs
+          before doing so), so work on this device can't get captured
+          into graphs */
+      bool canCaptureGraphs() const { return false; }
       
       // ==================================================================
       // denoiser
@@ -101,8 +116,20 @@ namespace rtc {
       // rt pipeline/sbtstuff
       // ------------------------------------------------------------------
 
+      /*! builds all programs that got added since the last call
+          (geom types and trace kernels only mark programs as dirty,
+          so creating several of them compiles only once), and the
+          pipeline over them */
       void buildPipeline();
+      /*! (re-)builds the whole SBT; for structural changes */
       void buildSBT();
+      /*! rewrites only the hit group records, if any geom's data
+          changed since the last build/update */
+      void updateSBT();
+      /*! has optix keep its compiled modules and pipelines in given
+          directory, so later runs on the same machine (or those
+          sharing the directory) can skip compiling them */
+      void setPipelineCacheDir(const std::string &dir);
 
       // ------------------------------------------------------------------
       // geomtype stuff
@@ -135,10 +162,12 @@ namespace rtc {
       // group/accel stuff
       // ------------------------------------------------------------------
       Group *
-      createTrianglesGroup(const std::vector<Geom *> &geoms);
+      createTrianglesGroup(const std::vector<Geom *> &geoms,
+                           BuildQuality quality = BUILD_QUALITY_DEFAULT);
       
       Group *
-      createUserGeomsGroup(const std::vector<Geom *> &geoms);
+      createUserGeomsGroup(const std::vector<Geom *> &geoms,
+                           BuildQuality quality = BUILD_QUALITY_DEFAULT);
 
       Group *
       createInstanceGroup(const std::vector<Group *>  &groups,
@@ -153,6 +182,9 @@ namespace rtc {
 
       std::vector<cudaStream_t> activeTraceStreams;
       bool programsDirty = true;
+      /*! whether some geom's setDD() changed its record since the
+          last buildSBT()/updateSBT() */
+      bool sbtRecordsDirty = false;
     };
 
   }
@@ -192,6 +224,10 @@ namespace rtc {
     rg->run(rtcore);                                          \
   }
 
+/*! only the embree backend traces batched kernels in packets */
+# define RTC_EXPORT_BATCHED_TRACE2D(name,RayGenType)             \
+  RTC_EXPORT_TRACE2D(name,RayGenType)
+
 #define RTC_IMPORT_TRACE2D(fileNameBase,kernelName,sizeOfLP)          \
   extern "C" char fileNameBase##_ptx[];                                 \
   rtc::TraceKernel2D *createTrace_##kernelName(rtc::Device *device)     \
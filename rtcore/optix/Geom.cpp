@@ -26,7 +26,13 @@ namespace rtc {
 
     void Geom::setDD(const void *dd)
     {
+      const uint8_t *bytes = (const uint8_t *)dd;
+      if (this->dd.size() == gt->sizeOfDD
+          && memcmp(this->dd.data(),bytes,gt->sizeOfDD) == 0)
+        return;
+      this->dd.assign(bytes,bytes+gt->sizeOfDD);
       owlGeomSetRaw(owl,"raw",dd);
+      gt->device->sbtRecordsDirty = true;
     }
 
     TrianglesGeom::TrianglesGeom(GeomType *gt,
@@ -57,8 +63,9 @@ namespace rtc {
                              numIndices,sizeof(int3),0);
     }
 
-    GeomType::GeomType(optix::Device *device)
-      : device(device)
+    GeomType::GeomType(optix::Device *device, size_t sizeOfDD)
+      : device(device),
+        sizeOfDD(sizeOfDD)
     {
       device->programsDirty = true;
     }
@@ -74,7 +81,7 @@ namespace rtc {
                                          const std::string &typeName,
                                          size_t sizeOfDD,
                                          bool has_ah, bool has_ch)
-      : GeomType(device)
+      : GeomType(device,sizeOfDD)
     {
       OWLVarDecl vars[] = {
         {"raw",(OWLDataType)(OWL_USER_TYPE_BEGIN+sizeOfDD),0},
@@ -84,16 +91,13 @@ namespace rtc {
                              sizeOfDD,vars,-1);
       
       const char *ptx = ptxCode.c_str();
-      OWLModule module = owlModuleCreate
-        (device->owl,ptx);
+      module = owlModuleCreate(device->owl,ptx);
       if (has_ch)
         owlGeomTypeSetClosestHit(gt,/*ray type*/0,module,
                                  typeName.c_str());
       if (has_ah)
         owlGeomTypeSetAnyHit(gt,/*ray type*/0,module,
                              typeName.c_str());
-      owlBuildPrograms(device->owl);
-      owlModuleRelease(module);
     }
 
     UserGeomType::UserGeomType(optix::Device *device,
@@ -101,7 +105,7 @@ namespace rtc {
                                const std::string &typeName,
                                size_t sizeOfDD,
                                bool has_ah, bool has_ch)
-      : GeomType(device)
+      : GeomType(device,sizeOfDD)
     {
       OWLVarDecl vars[] = {
         {"raw",(OWLDataType)(OWL_USER_TYPE_BEGIN+sizeOfDD),0},
@@ -112,8 +116,7 @@ namespace rtc {
       
       const char *ptx = ptxCode.c_str();
 
-      OWLModule module = owlModuleCreate
-        (device->owl,ptx);
+      module = owlModuleCreate(device->owl,ptx);
       if (has_ch)
         owlGeomTypeSetClosestHit(gt,/*ray type*/0,module,
                                  typeName.c_str());
@@ -124,8 +127,6 @@ namespace rtc {
                                typeName.c_str());
       owlGeomTypeSetIntersectProg(gt,/*ray type*/0,module,
                                   typeName.c_str());
-      owlBuildPrograms(device->owl);
-      owlModuleRelease(module);
     }
     
     Geom *TrianglesGeomType::createGeom()
@@ -25,6 +25,9 @@ namespace rtc {
       
       GeomType *const gt;
       OWLGeom   const owl;
+      /*! what got last set through setDD(), so re-setting the same
+          data doesn't dirty the SBT */
+      std::vector<uint8_t> dd;
     };
 
     struct TrianglesGeom : public optix::Geom {
@@ -47,13 +50,17 @@ namespace rtc {
     };
     
     struct GeomType {
-      GeomType(optix::Device *device);
+      GeomType(optix::Device *device, size_t sizeOfDD);
       virtual ~GeomType();
       
       virtual Geom *createGeom() = 0;
       
       OWLGeomType gt = 0;
+      /*! kept alive (rather than released right away) because it
+          only gets compiled in the device's next buildPipeline() */
+      OWLModule   module = 0;
       optix::Device *const device;
+      size_t         const sizeOfDD;
     };
     struct TrianglesGeomType : public GeomType
     {
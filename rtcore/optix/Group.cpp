@@ -8,9 +8,10 @@
 namespace rtc {
   namespace optix {
 
-    Group::Group(optix::Device *device, OWLGroup owl)
+    Group::Group(optix::Device *device, OWLGroup owl, bool allowUpdate)
       : device(device),
-        owl(owl)
+        owl(owl),
+        allowUpdate(allowUpdate)
     {}
     
     rtc::AccelHandle Group::getDD() const
@@ -20,14 +21,29 @@ namespace rtc {
       return (const rtc::AccelHandle &)handle;
     }
     
+    void Group::trackAccelSize()
+    {
+      size_t memFinal = 0, memPeak = 0;
+      owlGroupGetAccelSize(owl,&memFinal,&memPeak);
+      device->memory.freed(memoryCategory,accelBytes);
+      accelBytes     = memFinal;
+      memoryCategory = device->memory.current;
+      device->memory.allocated(memoryCategory,accelBytes);
+    }
+    
     void Group::buildAccel()
     {
       owlGroupBuildAccel(owl);
+      trackAccelSize();
     }
     
     void Group::refitAccel()
     {
-      owlGroupRefitAccel(owl);
+      if (allowUpdate)
+        owlGroupRefitAccel(owl);
+      else
+        owlGroupBuildAccel(owl);
+      trackAccelSize();
     }
 
     void Group::setTransforms(const std::vector<affine3f> &xfms)
@@ -37,5 +53,18 @@ namespace rtc {
                                     OWL_MATRIX_FORMAT_OWL);
     }
 
+    void Group::updateTransforms(const std::vector<int> &which,
+                                 const std::vector<affine3f> &xfms)
+    {
+      /* owl keeps the optix instances on the host, and uploads them
+         as part of the refit; what we can save is touching all the
+         others' transforms */
+      for (size_t i=0;i<which.size();i++)
+        owlInstanceGroupSetTransform(owl, which[i],
+                                     (const float *)&xfms[i],
+                                     OWL_MATRIX_FORMAT_OWL);
+      refitAccel();
+    }
+
   }
 }
@@ -12,16 +12,33 @@ namespace rtc {
     struct Device;
 
     struct Group {
-      Group(optix::Device *device, OWLGroup owlGroup);
-      virtual ~Group() { owlGroupRelease(owl); }
+      Group(optix::Device *device, OWLGroup owlGroup,
+            bool allowUpdate = false);
+      virtual ~Group()
+      {
+        device->memory.freed(memoryCategory,accelBytes);
+        owlGroupRelease(owl);
+      }
       
       rtc::AccelHandle getDD() const;
       void buildAccel();
       void refitAccel();
       void setTransforms(const std::vector<affine3f> &xfms);
+      /*! sets the transforms of only the listed instances, and refits */
+      void updateTransforms(const std::vector<int> &which,
+                            const std::vector<affine3f> &xfms);
       
       OWLGroup const owl;
       optix::Device *const device;
+      /*! whether this got created with OPTIX_BUILD_FLAG_ALLOW_UPDATE,
+          and can thus get refit; otherwise refits are rebuilds */
+      bool const allowUpdate;
+      /*! size of the last built accel, as reported to device->memory;
+          the category is whatever was current when it got built */
+      size_t accelBytes     = 0;
+      int    memoryCategory = 0;
+    private:
+      void trackAccelSize();
     };
 
   }
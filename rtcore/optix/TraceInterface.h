@@ -108,13 +108,17 @@ namespace rtc {
                                       vec3f dir,
                                       float t0,
                                       float t1,
-                                      void *prdPtr) 
+                                      void *prdPtr,
+                                      bool terminateOnFirstHit = false) 
       {
         unsigned int           p0 = 0;
         unsigned int           p1 = 0;
         owl::packPointer(prdPtr,p0,p1);
         
-        uint32_t rayFlags = 0u;
+        uint32_t rayFlags
+          = terminateOnFirstHit
+          ? OPTIX_RAY_FLAG_TERMINATE_ON_FIRST_HIT
+          : 0u;
         owl::Ray ray(org,dir,t0,t1);
         optixTrace((const OptixTraversableHandle &)world,
                    (const ::float3&)ray.origin,
@@ -130,6 +134,23 @@ namespace rtc {
                    p0,
                    p1);
       }
+
+      /*! occlusion query: stops at the first accepted hit. optix
+          gives us no way of telling whether there was one other than
+          through a hit program, so the closest-hit program still runs
+          on that first hit (and has to record it), and this always
+          returns false; see the embree backend for what the return
+          value means */
+      inline __device__ bool traceOcclusion(rtc::AccelHandle world,
+                                            vec3f org,
+                                            vec3f dir,
+                                            float t0,
+                                            float t1,
+                                            void *prdPtr)
+      {
+        traceRay(world,org,dir,t0,t1,prdPtr,true);
+        return false;
+      }
 #endif
     };
 
@@ -0,0 +1,162 @@
+# SPDX-FileCopyrightText:
+# Copyright (c) 2025 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+# SPDX-License-Identifier:
+# Apache-2.0
+
+# performance regression test: renders barneyBench's standard scenes
+# for a fixed number of frames, and compares frame times and ray
+# throughput against baselines stored per gpu architecture (so that
+# numbers from one machine only ever get compared to the same kind of
+# machine). Prints a pass/fail line per scene, and exits with non-zero
+# status if any of them regressed by more than the tolerance.
+#
+#   python3 perfRegression.py --bench <build>/barneyBench
+#   python3 perfRegression.py --bench <build>/barneyBench --update
+#
+# --update (re-)records the current machine's baselines, for all
+# scenes that were run; scenes without a baseline get reported as
+# 'new', not as failures.
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+# scene, size, and extra args; sizes are chosen so that each scene
+# takes a noticeable but short time per frame on a single gpu
+perf_cases = [
+    ('spheres',    1000000, []),
+    ('triangles',  1000000, []),
+    ('curves',      100000, []),
+    ('structured',     256, []),
+    ('amr',            256, []),
+    ('umesh',           64, []),
+    ('nanovdb',        256, []),
+    ('lights',          64, []),
+]
+
+# what gets compared, and whether larger values are better
+perf_metrics = [
+    ('msPerFrame',  False),
+    ('buildMs',     False),
+    ('mraysPerSec', True),
+]
+
+default_baselines = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                 'perf_baselines.json')
+
+def get_arch(force_cpu):
+    """ name of the architecture baselines get stored under: the
+    first gpu's name plus compute capability, or 'cpu' """
+    if force_cpu:
+        return 'cpu'
+    try:
+        out = subprocess.check_output(
+            ['nvidia-smi','--query-gpu=name,compute_cap',
+             '--format=csv,noheader'],text=True)
+        name,cc = [s.strip() for s in out.splitlines()[0].split(',')]
+        return f'{name} (sm_{cc.replace(".","")})'
+    except (OSError,subprocess.CalledProcessError,IndexError,ValueError):
+        return 'unknown'
+
+def run_case(args, scene, n, extra):
+    cmd = [args.bench,'-scene',scene,'-n',str(n),
+           '-res',str(args.res[0]),str(args.res[1]),
+           '-frames',str(args.frames),'-warmup',str(args.warmup),
+           '-stats','-no-readback'] + extra
+    if args.cpu:
+        cmd.append('-cpu')
+    proc = subprocess.run(cmd,capture_output=True,text=True)
+    if proc.returncode != 0:
+        raise RuntimeError(f'{" ".join(cmd)} failed:\n{proc.stderr}')
+    # barney itself may print log lines, the json is the last
+    # {...} block
+    lines = proc.stdout.splitlines()
+    begins = [i for i,line in enumerate(lines) if line.startswith('{')]
+    if not begins:
+        raise RuntimeError(f'no json in output of {" ".join(cmd)}')
+    return json.loads('\n'.join(lines[begins[-1]:]))
+
+def compare(result, baseline, tolerance):
+    """ returns list of (metric, value, baseline, relative change,
+    regressed) """
+    rows = []
+    for metric, higher_is_better in perf_metrics:
+        if metric not in result or metric not in baseline:
+            continue
+        value, ref = float(result[metric]), float(baseline[metric])
+        if ref <= 0.:
+            continue
+        change = (value-ref)/ref
+        regressed = (change < -tolerance) if higher_is_better \
+            else (change > tolerance)
+        rows.append((metric,value,ref,change,regressed))
+    return rows
+
+def main():
+    parser = argparse.ArgumentParser(description='barney performance regression test')
+    parser.add_argument('--bench',default='barneyBench',
+                        help='barneyBench executable to run')
+    parser.add_argument('--baselines',default=default_baselines,
+                        help='json file with per-architecture baselines')
+    parser.add_argument('--tolerance',type=float,default=.1,
+                        help='relative slow-down that counts as a regression')
+    parser.add_argument('--frames',type=int,default=32)
+    parser.add_argument('--warmup',type=int,default=4)
+    parser.add_argument('--res',type=int,nargs=2,default=(1024,1024))
+    parser.add_argument('--scene',action='append',
+                        help='only run given scene(s)')
+    parser.add_argument('--cpu',action='store_true',
+                        help='run on the cpu (embree) backend')
+    parser.add_argument('--update',action='store_true',
+                        help='store this run as the baseline')
+    args = parser.parse_args()
+
+    baselines = {}
+    if os.path.exists(args.baselines):
+        with open(args.baselines) as f:
+            baselines = json.load(f)
+    arch = get_arch(args.cpu)
+    arch_baselines = baselines.setdefault(arch,{})
+    print(f'@perf: architecture "{arch}", tolerance {args.tolerance*100:.0f}%')
+
+    num_failed = 0
+    for scene, n, extra in perf_cases:
+        if args.scene and scene not in args.scene:
+            continue
+        key = f'{scene}-{n}-{args.res[0]}x{args.res[1]}'
+        try:
+            result = run_case(args,scene,n,extra)
+        except RuntimeError as e:
+            print(f'@perf: FAIL {key}: {e}')
+            num_failed += 1
+            continue
+        if args.update:
+            arch_baselines[key] = { m: result[m] for m,_ in perf_metrics
+                                    if m in result }
+            print(f'@perf: RECORDED {key}')
+            continue
+        if key not in arch_baselines:
+            print(f'@perf: NEW {key} (no baseline; run with --update to record)')
+            continue
+        rows = compare(result,arch_baselines[key],args.tolerance)
+        failed = any(r[4] for r in rows)
+        num_failed += failed
+        print(f'@perf: {"FAIL" if failed else "PASS"} {key}')
+        for metric, value, ref, change, regressed in rows:
+            print(f'@perf:     {metric:12s} {value:10.3f} (baseline {ref:10.3f},'
+                  f' {change*100:+6.1f}%){"  <-- regressed" if regressed else ""}')
+
+    if args.update:
+        with open(args.baselines,'w') as f:
+            json.dump(baselines,f,indent=2,sort_keys=True)
+            f.write('\n')
+        print(f'@perf: baselines written to {args.baselines}')
+        return 0
+    print(f'@perf: {"FAILED" if num_failed else "PASSED"}'
+          f' ({num_failed} regressed or failed)')
+    return 1 if num_failed else 0
+
+if __name__ == '__main__':
+    sys.exit(main())